@@ -471,6 +471,9 @@ macro(DeployUnix TARGET)
 		
 		# install LUT		
 		install(FILES "${PROJECT_SOURCE_DIR}/resources/lut/lut_lin_tables.tar.xz" DESTINATION "share/hyperhdr/lut" COMPONENT "HyperHDR")
+		if(ENABLE_WEB_BUNDLE)
+			install(FILES "${EXECUTABLE_OUTPUT_PATH}/hyperhdr-www.bundle" DESTINATION "share/hyperhdr" COMPONENT "HyperHDR")
+		endif()
 		install(FILES "${PROJECT_SOURCE_DIR}/LICENSE" DESTINATION "share/hyperhdr" COMPONENT "HyperHDR")
 		install(FILES "${PROJECT_SOURCE_DIR}/3RD_PARTY_LICENSES" DESTINATION "share/hyperhdr" COMPONENT "HyperHDR")
 	else()
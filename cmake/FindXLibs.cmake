@@ -24,6 +24,27 @@ if(XLibs_FOUND)
 	set(XLibs_INCLUDE_DIRS ${SCREEN_X11_INCLUDE_DIR} )
 	set(XLibs_LIBRARIES ${SCREEN_X11_LIBRARY} )
 	set(XLibs_DEFINITIONS -DHAS_XLIBS=1)
+
+	# optional: shared memory capture
+	find_path(SCREEN_XSHM_INCLUDE_DIR NAMES X11/extensions/XShm.h PATHS ${PCM_X11_INCLUDEDIR})
+	find_library(SCREEN_XEXT_LIBRARY NAMES Xext PATHS ${PCM_X11_LIBDIR})
+	if(SCREEN_XSHM_INCLUDE_DIR AND SCREEN_XEXT_LIBRARY)
+		list(APPEND XLibs_LIBRARIES ${SCREEN_XEXT_LIBRARY} )
+		list(APPEND XLibs_DEFINITIONS -DHAS_XSHM=1)
+
+		# optional: damage tracking, requires the shared memory capture
+		find_path(SCREEN_XDAMAGE_INCLUDE_DIR NAMES X11/extensions/Xdamage.h PATHS ${PCM_X11_INCLUDEDIR})
+		find_library(SCREEN_XDAMAGE_LIBRARY NAMES Xdamage PATHS ${PCM_X11_LIBDIR})
+		find_library(SCREEN_XFIXES_LIBRARY NAMES Xfixes PATHS ${PCM_X11_LIBDIR})
+		if(SCREEN_XDAMAGE_INCLUDE_DIR AND SCREEN_XDAMAGE_LIBRARY AND SCREEN_XFIXES_LIBRARY)
+			list(APPEND XLibs_LIBRARIES ${SCREEN_XDAMAGE_LIBRARY} ${SCREEN_XFIXES_LIBRARY} )
+			list(APPEND XLibs_DEFINITIONS -DHAS_XDAMAGE=1)
+		else()
+			message( STATUS "libxdamage-dev not found: X11 grabber will capture every frame")
+		endif()
+	else()
+		message( STATUS "libxext-dev not found: X11 grabber will not use the shared memory")
+	endif()
 else()
 	message( FATAL_ERROR "Could not found libx11-dev ( ${SCREEN_X11_INCLUDE_DIR}, ${SCREEN_X11_LIBRARY} )" )
 endif()
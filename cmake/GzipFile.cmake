@@ -0,0 +1,4 @@
+# Writes the gzip variant of a file: cmake -DINPUT=<file> -DOUTPUT=<file.gz> -P GzipFile.cmake
+get_filename_component(OUTPUT_DIR "${OUTPUT}" DIRECTORY)
+file(MAKE_DIRECTORY "${OUTPUT_DIR}")
+file(ARCHIVE_CREATE OUTPUT "${OUTPUT}" PATHS "${INPUT}" FORMAT raw COMPRESSION GZip)
@@ -0,0 +1,147 @@
+# The profile guided release build: the instrumented binary is trained on the benchmark (and optionally
+# a raw capture replay), then the same build folder is rebuilt with the profile and LTO and packaged.
+#
+#   cmake -DBUILD_DIR=<folder> [-DTRAINING_CAPTURE=<recording>] [-DTRAINING_SECONDS=60]
+#         [-DCONFIGURE_ARGS="-DPLATFORM=rpi;..."] [-DBASELINE=ON] [-DPACKAGE=ON] -P cmake/PgoBuild.cmake
+#
+# Run it on the architecture of the package (or its emulator): the profile of another machine doesn't fit.
+# With BASELINE the plain release build is measured too and the speedup of every benchmark is reported.
+cmake_minimum_required(VERSION 3.18)
+
+get_filename_component(SOURCE_DIR "${CMAKE_CURRENT_LIST_DIR}/.." ABSOLUTE)
+
+if (NOT BUILD_DIR)
+	message(FATAL_ERROR "Usage: cmake -DBUILD_DIR=<folder> -P cmake/PgoBuild.cmake")
+endif()
+get_filename_component(BUILD_DIR "${BUILD_DIR}" ABSOLUTE)
+
+if (NOT DEFINED BASELINE)
+	set(BASELINE ON)
+endif()
+if (NOT DEFINED PACKAGE)
+	set(PACKAGE ON)
+endif()
+if (NOT TRAINING_SECONDS)
+	set(TRAINING_SECONDS 60)
+endif()
+
+set(PROFILE_DIR "${BUILD_DIR}/pgo-profile")
+
+function(run_step description)
+	message(STATUS "PGO: ${description}")
+	execute_process(COMMAND ${ARGN} RESULT_VARIABLE result)
+	if (NOT result EQUAL 0)
+		message(FATAL_ERROR "PGO: ${description} failed (${result})")
+	endif()
+endfunction()
+
+function(find_binary folder output)
+	foreach(candidate "${folder}/bin/hyperhdr" "${folder}/bin/hyperhdr.exe" "${folder}/bin/hyperhdr.app/Contents/MacOS/hyperhdr")
+		if (EXISTS "${candidate}")
+			set(${output} "${candidate}" PARENT_SCOPE)
+			return()
+		endif()
+	endforeach()
+	message(FATAL_ERROR "PGO: no hyperhdr binary in ${folder}/bin")
+endfunction()
+
+function(run_benchmark folder output)
+	find_binary("${folder}" binary)
+	message(STATUS "PGO: benchmark of ${binary}")
+	execute_process(COMMAND "${binary}" --benchmark OUTPUT_FILE "${output}" RESULT_VARIABLE result)
+	if (NOT result EQUAL 0)
+		message(FATAL_ERROR "PGO: the benchmark failed (${result})")
+	endif()
+endfunction()
+
+function(build folder)
+	run_step("build of ${folder}" ${CMAKE_COMMAND} --build "${folder}" --config Release --parallel)
+endfunction()
+
+# plain release build for the comparison
+if (BASELINE)
+	run_step("configure the baseline" ${CMAKE_COMMAND} -S "${SOURCE_DIR}" -B "${BUILD_DIR}-baseline" -DCMAKE_BUILD_TYPE=Release -DHYPERHDR_PGO=OFF ${CONFIGURE_ARGS})
+	build("${BUILD_DIR}-baseline")
+	run_benchmark("${BUILD_DIR}-baseline" "${BUILD_DIR}-baseline/benchmark.txt")
+endif()
+
+# the instrumented build, GCC finds the profile by the object paths so the optimized build reuses the folder
+file(REMOVE_RECURSE "${PROFILE_DIR}")
+run_step("configure the instrumented build" ${CMAKE_COMMAND} -S "${SOURCE_DIR}" -B "${BUILD_DIR}" -DCMAKE_BUILD_TYPE=Release -DHYPERHDR_PGO=GENERATE "-DPGO_PROFILE_DIR=${PROFILE_DIR}" ${CONFIGURE_ARGS})
+build("${BUILD_DIR}")
+
+# training: the kernels of every pixel format, mapping type and adjustment...
+find_binary("${BUILD_DIR}" instrumented)
+run_step("training on the benchmark" "${instrumented}" --benchmark)
+
+# ...and the whole pipeline (decoding, mapping, smoothing, devices) on a real recording
+if (TRAINING_CAPTURE)
+	find_program(TIMEOUT_COMMAND timeout)
+	if (NOT TIMEOUT_COMMAND)
+		message(FATAL_ERROR "PGO: the replay training needs the 'timeout' command")
+	endif()
+
+	message(STATUS "PGO: training on the replay of ${TRAINING_CAPTURE} for ${TRAINING_SECONDS} s")
+	file(MAKE_DIRECTORY "${BUILD_DIR}/pgo-userdata")
+	# the daemon writes its profile when it exits on SIGTERM, 124 is the exit code of the timeout
+	execute_process(COMMAND "${TIMEOUT_COMMAND}" --signal=TERM "${TRAINING_SECONDS}" "${instrumented}"
+		--replay-capture "${TRAINING_CAPTURE}" --replay-speed 0 --replay-loop -u "${BUILD_DIR}/pgo-userdata"
+		RESULT_VARIABLE result)
+	if (NOT result EQUAL 0 AND NOT result EQUAL 124)
+		message(FATAL_ERROR "PGO: the replay training failed (${result})")
+	endif()
+endif()
+
+# Clang writes raw profiles, they are merged for the optimized build
+file(GLOB rawProfiles "${PROFILE_DIR}/*.profraw")
+if (rawProfiles)
+	find_program(LLVM_PROFDATA NAMES llvm-profdata)
+	if (NOT LLVM_PROFDATA)
+		message(FATAL_ERROR "PGO: llvm-profdata is required to merge the Clang profiles")
+	endif()
+	run_step("merge of the profiles" "${LLVM_PROFDATA}" merge "-output=${PROFILE_DIR}/hyperhdr.profdata" ${rawProfiles})
+endif()
+
+# the optimized build
+run_step("configure the optimized build" ${CMAKE_COMMAND} -S "${SOURCE_DIR}" -B "${BUILD_DIR}" -DHYPERHDR_PGO=USE "-DPGO_PROFILE_DIR=${PROFILE_DIR}")
+build("${BUILD_DIR}")
+run_benchmark("${BUILD_DIR}" "${BUILD_DIR}/benchmark.txt")
+
+# the report: the average time per call of every benchmark and the speedup against the baseline
+if (BASELINE)
+	file(STRINGS "${BUILD_DIR}-baseline/benchmark.txt" baselineLines REGEX "us/iter")
+	file(STRINGS "${BUILD_DIR}/benchmark.txt" optimizedLines REGEX "us/iter")
+
+	set(report "benchmark\tbaseline [us]\tpgo+lto [us]\tspeedup\n")
+	foreach(line ${optimizedLines})
+		if (line MATCHES "^([^ ]+) +([0-9.]+) us/iter")
+			set(name "${CMAKE_MATCH_1}")
+			set(optimized "${CMAKE_MATCH_2}")
+
+			foreach(baseLine ${baselineLines})
+				if (baseLine MATCHES "^([^ ]+) +([0-9.]+) us/iter" AND CMAKE_MATCH_1 STREQUAL name)
+					set(baseline "${CMAKE_MATCH_2}")
+					# math() is integer only: the speedup in percent of the baseline time
+					string(REPLACE "." "" baselineFixed "${baseline}")
+					string(REPLACE "." "" optimizedFixed "${optimized}")
+					if (optimizedFixed GREATER 0)
+						math(EXPR percent "(${baselineFixed} * 100) / ${optimizedFixed}")
+						math(EXPR whole "${percent} / 100")
+						math(EXPR fraction "${percent} % 100")
+						if (fraction LESS 10)
+							set(fraction "0${fraction}")
+						endif()
+						string(APPEND report "${name}\t${baseline}\t${optimized}\t${whole}.${fraction}x\n")
+					endif()
+				endif()
+			endforeach()
+		endif()
+	endforeach()
+
+	file(WRITE "${BUILD_DIR}/pgo-report.txt" "${report}")
+	message(STATUS "PGO: speedup of the optimized build (${BUILD_DIR}/pgo-report.txt)\n${report}")
+endif()
+
+if (PACKAGE)
+	run_step("package" ${CMAKE_COMMAND} --build "${BUILD_DIR}" --config Release --target package)
+endif()
@@ -0,0 +1,71 @@
+# Profile guided optimization of the release build, driven by cmake/PgoBuild.cmake
+#   HYPERHDR_PGO=GENERATE  the instrumented binary, every run writes its profile to PGO_PROFILE_DIR
+#   HYPERHDR_PGO=USE       the binary optimized with the collected profile and link time optimization
+# The profile belongs to the sources and the compiler it was collected with, a stale one only loses the gain.
+
+set(HYPERHDR_PGO "OFF" CACHE STRING "Profile guided optimization: OFF, GENERATE or USE")
+set_property(CACHE HYPERHDR_PGO PROPERTY STRINGS OFF GENERATE USE)
+set(PGO_PROFILE_DIR "${CMAKE_BINARY_DIR}/pgo-profile" CACHE PATH "The folder of the collected profile")
+
+if (HYPERHDR_PGO STREQUAL "OFF")
+	return()
+endif()
+
+colorMe("HYPERHDR_PGO = " ${HYPERHDR_PGO})
+
+if (CMAKE_CXX_COMPILER_ID MATCHES "MSVC")
+	message(WARNING "HYPERHDR_PGO is supported for GCC and Clang only, the option is ignored")
+	return()
+endif()
+
+if (CMAKE_CXX_COMPILER_ID MATCHES "Clang")
+	set(PGO_CLANG ON)
+endif()
+
+if (HYPERHDR_PGO STREQUAL "GENERATE")
+	file(MAKE_DIRECTORY "${PGO_PROFILE_DIR}")
+
+	if (PGO_CLANG)
+		# every process writes its own raw profile, llvm-profdata merges them
+		set(PGO_FLAGS "-fprofile-instr-generate=${PGO_PROFILE_DIR}/hyperhdr-%p.profraw")
+	else()
+		set(PGO_FLAGS "-fprofile-generate -fprofile-dir=${PGO_PROFILE_DIR} -fprofile-update=atomic")
+	endif()
+
+	set(CMAKE_C_FLAGS "${CMAKE_C_FLAGS} ${PGO_FLAGS}")
+	set(CMAKE_CXX_FLAGS "${CMAKE_CXX_FLAGS} ${PGO_FLAGS}")
+	set(CMAKE_EXE_LINKER_FLAGS "${CMAKE_EXE_LINKER_FLAGS} ${PGO_FLAGS}")
+	set(CMAKE_SHARED_LINKER_FLAGS "${CMAKE_SHARED_LINKER_FLAGS} ${PGO_FLAGS}")
+
+elseif (HYPERHDR_PGO STREQUAL "USE")
+	if (PGO_CLANG)
+		if (NOT EXISTS "${PGO_PROFILE_DIR}/hyperhdr.profdata")
+			message(FATAL_ERROR "No merged profile in ${PGO_PROFILE_DIR}, run the training with cmake/PgoBuild.cmake first")
+		endif()
+		set(PGO_FLAGS "-fprofile-instr-use=${PGO_PROFILE_DIR}/hyperhdr.profdata -Wno-profile-instr-unprofiled -Wno-profile-instr-out-of-date")
+	else()
+		if (NOT EXISTS "${PGO_PROFILE_DIR}")
+			message(FATAL_ERROR "No profile in ${PGO_PROFILE_DIR}, run the training with cmake/PgoBuild.cmake first")
+		endif()
+		set(PGO_FLAGS "-fprofile-use -fprofile-dir=${PGO_PROFILE_DIR} -fprofile-correction -Wno-missing-profile")
+
+		# the code paths the training didn't reach are optimized as usual (GCC 10)
+		CHECK_CXX_COMPILER_FLAG("-fprofile-partial-training" COMPILER_SUPPORTS_PARTIAL_TRAINING)
+		if (COMPILER_SUPPORTS_PARTIAL_TRAINING)
+			set(PGO_FLAGS "${PGO_FLAGS} -fprofile-partial-training")
+		endif()
+	endif()
+
+	set(CMAKE_C_FLAGS "${CMAKE_C_FLAGS} ${PGO_FLAGS}")
+	set(CMAKE_CXX_FLAGS "${CMAKE_CXX_FLAGS} ${PGO_FLAGS}")
+
+	# the branch layout from the profile pays off most across the modules
+	include(CheckIPOSupported)
+	check_ipo_supported(RESULT PGO_LTO_SUPPORTED OUTPUT PGO_LTO_ERROR LANGUAGES C CXX)
+	if (PGO_LTO_SUPPORTED)
+		set(CMAKE_INTERPROCEDURAL_OPTIMIZATION ON)
+		colorMe("Link time optimization = ON")
+	else()
+		message(WARNING "Link time optimization is not supported: ${PGO_LTO_ERROR}")
+	endif()
+endif()
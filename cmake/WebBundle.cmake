@@ -0,0 +1,49 @@
+# Packs the web UI into one indexed file: cmake -DROOT=<www> -DWORK_DIR=<dir> -DOUTPUT=<bundle> -P WebBundle.cmake
+# The text header lists every asset: "path<TAB>offset<TAB>size<TAB>gzip offset<TAB>gzip size", it ends with an empty line.
+# The offsets count from the end of the header, the data of the assets and their gzip variants follow in that order.
+file(GLOB_RECURSE assets RELATIVE "${ROOT}" "${ROOT}/*")
+list(SORT assets)
+
+file(MAKE_DIRECTORY "${WORK_DIR}")
+set(header "${WORK_DIR}/header.txt")
+file(WRITE "${header}" "HYPERHDR-WWW 1\n")
+
+set(parts "")
+set(offset 0)
+
+foreach(asset ${assets})
+	set(input "${ROOT}/${asset}")
+	file(SIZE "${input}" size)
+	list(APPEND parts "${input}")
+
+	set(dataOffset ${offset})
+	math(EXPR offset "${offset} + ${size}")
+
+	# the text assets are also stored precompressed, StaticFileServing sends them to the clients that accept gzip
+	set(gzipOffset 0)
+	set(gzipSize 0)
+	if (asset MATCHES "\\.(js|css|html|json|svg)$")
+		set(gzFile "${WORK_DIR}/gzip/${asset}.gz")
+		get_filename_component(gzDir "${gzFile}" DIRECTORY)
+		file(MAKE_DIRECTORY "${gzDir}")
+		file(ARCHIVE_CREATE OUTPUT "${gzFile}" PATHS "${input}" FORMAT raw COMPRESSION GZip)
+		file(SIZE "${gzFile}" compressed)
+
+		if (compressed LESS size)
+			list(APPEND parts "${gzFile}")
+			set(gzipOffset ${offset})
+			set(gzipSize ${compressed})
+			math(EXPR offset "${offset} + ${compressed}")
+		endif()
+	endif()
+
+	file(APPEND "${header}" "/${asset}\t${dataOffset}\t${size}\t${gzipOffset}\t${gzipSize}\n")
+endforeach()
+
+file(APPEND "${header}" "\n")
+
+execute_process(COMMAND ${CMAKE_COMMAND} -E cat "${header}" ${parts} OUTPUT_FILE "${OUTPUT}" RESULT_VARIABLE result)
+
+if (NOT result EQUAL 0)
+	message(FATAL_ERROR "Could not write the web UI bundle ${OUTPUT}")
+endif()
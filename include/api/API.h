@@ -41,6 +41,8 @@ public:
 		QString format;
 		QString imgName;
 		QByteArray data;
+		/// the base64 form of the data, setImage decodes it straight to the buffer that needs it
+		QString encoded;
 	};
 
 	struct EffectCmdData
@@ -425,4 +427,7 @@ private:
 
 	// current instance index
 	quint8 _currInstanceIndex;
+
+	/// the decoded JPEG before its reduction to the size of the led mappings
+	std::vector<uint8_t> _imageDecodeBuffer;
 };
@@ -0,0 +1,98 @@
+#pragma once
+
+#include <QObject>
+#include <QByteArray>
+#include <QString>
+#include <QJsonObject>
+#include <QJsonArray>
+#include <QMutex>
+
+#include <deque>
+#include <list>
+#include <functional>
+
+#include <utils/Logger.h>
+#include <utils/MemoryAccounting.h>
+
+class QTcpSocket;
+
+///
+/// The outgoing messages of one JsonAPI client (JSON server or websocket). A message goes straight to the socket
+/// while the socket keeps up, otherwise it waits here instead of growing the Qt buffer of the socket without a limit.
+/// Every stream has its own policy: the led colors and the image keep the latest frame only, the log keeps
+/// a bounded backlog and the replies are never dropped.
+///
+class ClientSendQueue : public QObject
+{
+	Q_OBJECT
+
+public:
+	enum Stream { REPLY = 0, LED_COLORS, IMAGE, LOG, STREAMS };
+
+	ClientSendQueue(QTcpSocket* socket, Logger* log, const QString& client, QObject* parent);
+	~ClientSendQueue() override;
+
+	/// the stream of a JsonAPI message by its command
+	static Stream streamOf(const QJsonObject& message);
+
+	///
+	/// @brief Send the encoded message or queue it by the policy of its stream
+	/// @param stream  The stream of the message
+	/// @param data    The bytes for the socket, the websocket frames included
+	/// @param sent    Called once the message is handed to the socket or replaced by a newer one
+	///
+	void send(Stream stream, const QByteArray& data, const std::function<void()>& sent = nullptr);
+
+	/// the messages and the bytes waiting here, not in the socket
+	int depth() const;
+	qint64 queuedBytes() const;
+
+	/// the messages of the stream waiting here
+	int pending(Stream stream) const;
+
+	/// the messages the latest-wins and the bounded streams dropped
+	qint64 dropped() const;
+
+	/// the congestion state, the queue and the socket buffer of the session
+	QJsonObject toJson() const;
+
+	/// the last state of every session, it can be called from any thread
+	static QJsonArray sessionsToJson();
+
+private slots:
+	void flush();
+
+private:
+	struct Message
+	{
+		Stream					stream;
+		QByteArray				data;
+		std::function<void()>	sent;
+	};
+
+	bool write(Message& message);
+	void updateState();
+
+	QTcpSocket*		_socket;
+	Logger*			_log;
+	QString			_client;
+
+	std::deque<Message>	_queue;
+	qint64			_queuedBytes;
+	int				_pending[STREAMS];
+	qint64			_dropped;
+	bool			_congested;
+
+	MemoryAccounting::Tag	_memory;
+
+	/// the state for the other threads, updated when the queue changes
+	QJsonObject		_snapshot;
+
+	static QMutex					_sessionsLock;
+	static std::list<ClientSendQueue*>	_sessions;
+
+	/// the socket buffer above it holds the new messages here
+	static constexpr qint64 HIGH_WATER = 256 * 1024;
+	/// the log batches kept for a slow client, the oldest are dropped above it
+	static constexpr int LOG_BACKLOG = 256;
+};
@@ -0,0 +1,78 @@
+#pragma once
+
+/* ImageStreamEncoder.h
+*
+*  MIT License
+*
+*  Copyright (c) 2023 awawa-dev
+*
+*  Project homesite: https://github.com/awawa-dev/HyperHDR
+*
+*  Permission is hereby granted, free of charge, to any person obtaining a copy
+*  of this software and associated documentation files (the "Software"), to deal
+*  in the Software without restriction, including without limitation the rights
+*  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+*  copies of the Software, and to permit persons to whom the Software is
+*  furnished to do so, subject to the following conditions:
+*
+*  The above copyright notice and this permission notice shall be included in all
+*  copies or substantial portions of the Software.
+
+*  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+*  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+*  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+*  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+*  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+*  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+*  SOFTWARE.
+*/
+
+
+#include <QThread>
+#include <QMutex>
+#include <QWaitCondition>
+#include <QByteArray>
+
+#include <functional>
+#include <vector>
+
+#include <utils/ColorRgb.h>
+#include <utils/Image.h>
+
+///
+/// JPEG encoder of the live image stream, one per client: the newest frame replaces the one still waiting,
+/// it is subsampled to the preview size and encoded with the requested quality on the thread of the encoder.
+/// The result is handed to the deliver function from that thread.
+///
+class ImageStreamEncoder : public QThread
+{
+public:
+	typedef std::function<void(const QByteArray& jpeg)> DeliverFunc;
+
+	/// the bounds of the preview, larger frames are subsampled by an integer step
+	static constexpr int PREVIEW_MAX_WIDTH = 1280;
+	static constexpr int PREVIEW_MAX_HEIGHT = 720;
+
+	ImageStreamEncoder(const DeliverFunc& deliver);
+	~ImageStreamEncoder();
+
+	void queue(const Image<ColorRgb>& image, int quality);
+
+protected:
+	void run() override;
+
+private:
+	QByteArray encode(const Image<ColorRgb>& image, int quality);
+
+	DeliverFunc		_deliver;
+	/// the subsampled preview, reused
+	std::vector<uint8_t> _preview;
+	void*			_compressor;
+
+	QMutex			_mutex;
+	QWaitCondition	_condition;
+	Image<ColorRgb>	_image;
+	int				_quality;
+	bool			_hasImage;
+	bool			_quit;
+};
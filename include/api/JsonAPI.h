@@ -9,12 +9,16 @@
 
 // qt includes
 #include <QJsonObject>
+#include <QJsonArray>
 #include <QString>
 #include <QSemaphore>
 #include <QNetworkReply>
 
+#include <memory>
+
 class QTimer;
 class JsonCB;
+class ImageStreamEncoder;
 class AuthManager;
 
 class JsonAPI : public API
@@ -32,6 +36,7 @@ public:
 	/// @param noListener  if true, this instance won't listen for hyperHDR push events
 	///
 	JsonAPI(QString peerAddress, Logger* log, bool localConnection, QObject* parent, bool noListener = false);
+	~JsonAPI() override;
 
 	///
 	/// Handle an incoming JSON message
@@ -65,9 +70,24 @@ public slots:
 
 	void releaseLock();
 
+	///
+	/// @brief The binary image frame has left the socket: the pace and the quality of the stream follow the drain time
+	///
+	void releaseImageStream();
+
+	///
+	/// @brief A delta frame of the binary led stream was dropped for a slow client: the next frame carries all the leds
+	///
+	void resyncLedStream();
+
 	hyperhdr::Components getActiveComponent();
 
 private slots:
+	///
+	/// @brief Send the collected log messages as one message
+	///
+	void flushLogBatch();
+
 	///
 	/// @brief Handle emits from API of a new Token request.
 	/// @param  id      The id of the request
@@ -97,6 +117,11 @@ private slots:
 
 	void handleLedColorsTimer();
 
+	///
+	/// @brief Sends the led colors as a binary frame, returns false when the frame would not fit the format
+	///
+	bool streamLedcolorsBinary(const std::vector<ColorRgb>& ledColors);
+
 	void lutDownloaded(QNetworkReply* reply, int hardware_brightness, int hardware_contrast, int hardware_saturation, qint64 time);
 
 signals:
@@ -105,6 +130,16 @@ signals:
 	///
 	void callbackMessage(QJsonObject);
 
+	///
+	/// Signal emits with a binary message, only a transport that connects it can carry one (WebSocket)
+	///
+	void callbackBinaryMessage(QByteArray);
+
+	///
+	/// Signal emits with a JPEG frame of the binary image stream, answered by releaseImageStream()
+	///
+	void callbackBinaryImage(QByteArray);
+
 	///
 	/// Signal emits whenever a JSON-message should be forwarded
 	///
@@ -128,6 +163,11 @@ private:
 	/// flag to determine state of log streaming
 	bool _streaming_logging_activated;
 
+	/// the log messages waiting for the next batch, the ones below the level of the client are never collected
+	std::vector<Logger::T_LOG_MESSAGE> _logBatch;
+	Logger::LogLevel _logMinLevel;
+	QTimer* _logBatchTimer;
+
 	/// timer for led color refresh
 	QTimer* _ledStreamTimer;
 
@@ -137,9 +177,43 @@ private:
 	/// the current streaming led values
 	std::vector<ColorRgb> _currentLedValues;
 
+	/// the led stream is sent as binary frames (WebSocket only), optionally as the changes to the last frame
+	bool _ledStreamBinary;
+	bool _ledStreamDelta;
+
+	/// the last led values sent in a binary frame, the base of the next delta
+	std::vector<ColorRgb> _lastStreamedLeds;
+
 	// when the last image was send to protect buffer overflow
 	uint64_t _lastSendImage;
 
+	/// the image stream is sent as binary JPEG frames encoded off the API thread (WebSocket only)
+	bool _imageStreamBinary;
+	std::unique_ptr<ImageStreamEncoder> _imageStreamEncoder;
+	/// a frame is encoded or still on the way to the client
+	bool _imageStreamBusy;
+	int _imageStreamQuality;
+	qint64 _imageStreamInterval;
+	qint64 _imageStreamSent;
+
+	/// the replies of the batch that is executed, nullptr outside of a batch
+	QJsonArray* _batchReplies;
+	/// an atomic batch saves the collected settings once at the end
+	bool _batchAtomic;
+	QJsonObject _batchConfig;
+	/// the replies of the deferred setconfig commands, they fail when the final save does
+	QList<int> _batchConfigReplies;
+
+	/// the serverinfo sent to this client: the last value of every top-level key and the version of its
+	/// last change (an undefined value marks a removed key)
+	struct ServerInfoEntry
+	{
+		QJsonValue value;
+		qint64 version;
+	};
+	QMap<QString, ServerInfoEntry> _serverInfoSent;
+	qint64 _serverInfoVersion;
+
 	QSemaphore _semaphore;
 
 	///
@@ -150,6 +224,18 @@ private:
 	///
 	bool handleInstanceSwitch(quint8 instance = 0, bool forced = false);
 
+	///
+	/// Dispatch a validated and authorized command to its handler
+	///
+	void handleCommand(const QJsonObject& message, const QString& command, int tan);
+
+	///
+	/// Handle an incoming JSON Batch message: the commands are executed in order and answered with one reply
+	///
+	/// @param message the incoming message
+	///
+	void handleBatchCommand(const QJsonObject& message, const QString& command, int tan);
+
 	///
 	/// Handle an incoming JSON Color message
 	///
@@ -185,6 +271,14 @@ private:
 	///
 	void handleServerInfoCommand(const QJsonObject& message, const QString& command, int tan);
 
+	///
+	/// @brief Track the changes of the serverinfo of this client
+	/// @param info   the complete serverinfo
+	/// @param since  the version known by the client, -1 for the complete serverinfo
+	/// @return the keys changed after 'since' with the list of the removed keys, or the complete serverinfo
+	///
+	QJsonObject trackServerInfo(const QJsonObject& info, qint64 since);
+
 	///
 	/// Handle an incoming JSON Clear message
 	///
@@ -290,6 +384,22 @@ private:
 
 	void handleBenchmarkCommand(const QJsonObject& message, const QString& command, int tan);
 
+	void handleReplayCommand(const QJsonObject& message, const QString& command, int tan);
+
+	void handleCaptureRecordingCommand(const QJsonObject& message, const QString& command, int tan);
+
+	///
+	/// @brief Start or stop the recorder of the pipeline events, or get its events as a Chrome trace
+	/// @param message the incoming message
+	///
+	void handleEventTraceCommand(const QJsonObject& message, const QString& command, int tan);
+
+	///
+	/// @brief Get the memory held by the subsystems, dump also writes the breakdown to the log
+	/// @param message the incoming message
+	///
+	void handleMemoryAccountingCommand(const QJsonObject& message, const QString& command, int tan);
+
 	void handleLutInstallCommand(const QJsonObject& message, const QString& command, int tan);
 
 	void handleSmoothingCommand(const QJsonObject& message, const QString& command, int tan);
@@ -309,8 +419,15 @@ private:
 
 	void handleLoadSignalCalibration(const QJsonObject& message, const QString& command, int tan);
 
+	void handleVideoTunerCommand(const QJsonObject& message, const QString& command, int tan);
+
 	void handlePerformanceCounters(const QJsonObject& message, const QString& command, int tan);
 
+	///
+	/// Send a reply or collect it when a batch is executed
+	///
+	void sendReply(const QJsonObject& reply);
+
 	///
 	/// Send a standard reply indicating success
 	///
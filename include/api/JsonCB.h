@@ -3,6 +3,10 @@
 // qt incl
 #include <QJsonObject>
 #include <QList>
+#include <QHash>
+#include <QVariant>
+
+#include <functional>
 
 #include <utils/Components.h>
 #include <utils/settings.h>
@@ -17,6 +21,7 @@ class HyperHdrInstance;
 class ComponentRegister;
 class BonjourBrowserWrapper;
 class PriorityMuxer;
+class QTimer;
 
 class JsonCB : public QObject
 {
@@ -123,6 +128,11 @@ private slots:
 
 	void handleBenchmarkUpdate(int status, QString message);
 
+	///
+	/// @brief Handle the statistics at the end of the latency benchmark
+	///
+	void handleBenchmarkStats(const QJsonObject& stats);
+
 	void handleLutCalibrationUpdate(const QJsonObject& data);
 
 	void handlePerformanceUpdate(const QJsonObject& data);
@@ -134,6 +144,33 @@ private:
 	QStringList _availableCommands;
 	/// contains active subscriptions
 	QStringList _subscribedCommands;
-	/// construct callback msg
-	void doCallback(const QString& cmd, const QVariant& data);
+	/// construct callback msg, with the count of the updates merged into it
+	void doCallback(const QString& cmd, const QVariant& data, int suppressed = 0);
+
+	///
+	/// @brief The events that only report the latest state are coalesced: the first one of a burst is sent at once,
+	/// the next ones in the window of the event are merged into one update built when the window closes
+	/// @param cmd      The event
+	/// @param builder  Builds the data of the update, an invalid QVariant sends nothing
+	/// @param key      The events of the same kind with different keys (ex. the components) are coalesced separately
+	///
+	void doCallbackCoalesced(const QString& cmd, const std::function<QVariant()>& builder, const QString& key = QString());
+	void flushCoalesced(const QString& id, const QString& cmd);
+	/// the pending updates of an unsubscribed event are dropped
+	void dropCoalesced(const QString& cmd);
+
+	QVariant getPriorityInfo();
+	QVariant getAdjustmentInfo();
+	QVariant getInstanceInfo();
+
+	struct Coalescing
+	{
+		QTimer* timer = nullptr;
+		std::function<QVariant()> pending;
+		int suppressed = 0;
+	};
+
+	/// the coalescing window of an event [ms]
+	QHash<QString, int> _coalescingWindows;
+	QHash<QString, Coalescing> _coalescing;
 };
@@ -6,6 +6,9 @@
 //qt
 #include <QMap>
 #include <QVector>
+#include <QStringList>
+
+#include <vector>
 
 class AuthTable;
 class MetaTable;
@@ -24,6 +27,8 @@ private:
 	AuthManager(QObject* parent = nullptr, bool readonlyMode = false);
 
 public:
+	~AuthManager() override;
+
 	struct AuthDefinition
 	{
 		QString id;
@@ -218,7 +223,18 @@ signals:
 	///
 	void tokenChange(QVector<AuthManager::AuthDefinition>);
 
+private slots:
+	///
+	/// @brief Write the collected 'last_use' times of the tokens and users to the database
+	///
+	void flushTokenUse();
+
 private:
+	///
+	/// @brief Load the tokens from the database, the cache serves the authorization checks without a query
+	///
+	void loadTokens();
+
 	///
 	/// @brief Increment counter for token/user auth
 	/// @param user If true we increment USER auth instead of token
@@ -258,6 +274,24 @@ private:
 	// Contains timestamps of failed token login attempts
 	QVector<uint64_t> _tokenAuthAttempts;
 
+	/// The cached token records, only the hash of a token is kept
+	struct TokenEntry
+	{
+		QByteArray	hash;
+		QString		id;
+		QString		comment;
+		QString		lastUse;
+		bool		used;
+	};
+	std::vector<TokenEntry> _tokens;
+
+	/// The cached user tokens and the users that used them since the last write
+	QMap<QString, QByteArray> _userTokens;
+	QStringList _usedUsers;
+
+	/// Timer for the delayed write of the 'last_use' times
+	QTimer* _tokenUseTimer;
+
 private slots:
 	///
 	/// @brief Check timeout of pending requests
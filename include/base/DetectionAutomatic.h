@@ -4,10 +4,12 @@
 #include <QList>
 #include <QRectF>
 #include <cstdint>
+#include <cstddef>
 #include <vector>
 
 #include <utils/ColorRgb.h>
 #include <utils/Image.h>
+#include <utils/ImageView.h>
 #include <utils/FrameDecoder.h>
 #include <utils/Logger.h>
 #include <utils/Components.h>
@@ -86,9 +88,21 @@ private:
 		QString getSignature();
 	} calibrationData, checkData;
 
+	/// the calibration points as byte offsets in the frame and their packed colors, rebuilt when the layout changes
+	struct SampleSet
+	{
+		std::vector<ptrdiff_t>	offsets;
+		std::vector<uint8_t>	reference;
+		std::vector<uint8_t>	samples;
+		ptrdiff_t				lineStride = 0;
+		unsigned				pixelStride = 0;
+	};
+
+	void buildSamples(SampleSet& set, const std::vector<calibrationPoint>& points, const ImageView<ColorRgb>& image);
+
 	void calibrateFrame(Image<ColorRgb>& image);
 	void saveResult();
-	bool checkSignal(Image<ColorRgb>& image);
+	bool checkSignal(const ImageView<ColorRgb>& image);
 	void resetStats();
 
 	bool _saveResources;
@@ -100,4 +114,6 @@ private:
 	qint64 _offSignalTime;
 	qint64 _onSignalTime;
 	int _backupDecimation;
+	SampleSet _sdrSamples;
+	SampleSet _hdrSamples;
 };
@@ -4,9 +4,12 @@
 #include <QList>
 #include <QRectF>
 #include <cstdint>
+#include <cstddef>
+#include <vector>
 
 #include <utils/ColorRgb.h>
 #include <utils/Image.h>
+#include <utils/ImageView.h>
 #include <utils/FrameDecoder.h>
 #include <utils/Logger.h>
 #include <utils/Components.h>
@@ -20,13 +23,20 @@ public:
 
 	bool getDetectionManualSignal();
 
-	bool checkSignalDetectionManual(Image<ColorRgb>& image);
+	/// the last frames were all below the threshold, a single frame with the signal clears it
+	bool isManualSignalLost() const;
+
+	bool checkSignalDetectionManual(const ImageView<ColorRgb>& image);
 
 	void setSignalThreshold(double redSignalThreshold, double greenSignalThreshold, double blueSignalThreshold, int noSignalCounterThreshold);
 
 	void setSignalDetectionOffset(double horizontalMin, double verticalMin, double horizontalMax, double verticalMax);
 
+	QRectF getSignalDetectionArea() const;
+
 private:
+	void buildSampleRows(const ImageView<ColorRgb>& image);
+
 	Logger*		_log;
 	double		_x_frac_min;
 	double		_y_frac_min;
@@ -38,4 +48,13 @@ private:
 
 	bool		_noSignalDetected;
 	int			_noSignalCounter;
+
+	/// the rows of the detection area as byte offsets in the frame, rebuilt when the geometry changes
+	std::vector<ptrdiff_t> _sampleRows;
+	unsigned	_sampleX;
+	unsigned	_samplePixels;
+	unsigned	_sampleWidth;
+	unsigned	_sampleHeight;
+	ptrdiff_t	_sampleLineStride;
+	unsigned	_samplePixelStride;
 };
@@ -0,0 +1,78 @@
+#pragma once
+
+#include <QString>
+#include <QByteArray>
+
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include <utils/Image.h>
+#include <blackborder/BlackBorderDetector.h>
+
+///
+/// Immutable analysis of one captured frame, shared by all the instances that process it.
+/// Every part is computed on the first request, by whichever instance asks first, and the
+/// others reuse the result. The contexts are handed out by HyperHdrIManager::getFrameContext.
+///
+class FrameContext
+{
+public:
+	FrameContext(const Image<ColorRgb>& image, int expectedConsumers);
+
+	const Image<ColorRgb>& image() const;
+
+	///
+	/// @brief The context belongs to this frame (the same shared image data and capture time)
+	///
+	bool isFrame(const Image<ColorRgb>& image) const;
+
+	///
+	/// @brief The previous frame was processed by more than one instance, so the shared parts pay off
+	///
+	bool isShared() const;
+
+	void addConsumer();
+
+	int getConsumers() const;
+
+	///
+	/// @brief The raw border found by the detector (before the blur and the consistency filter of the instance)
+	/// @param mode       Detection mode of BlackBorderProcessor
+	/// @param threshold  The threshold of the detector, part of the key
+	///
+	hyperhdr::BlackBorder getBlackBorder(const QString& mode, double threshold, const hyperhdr::BlackBorderDetector& detector) const;
+
+	///
+	/// @brief Summed-area table of the whole frame: (width + 1) x (height + 1) RGB sums, the first row and column are zero.
+	/// The sums wrap around, the sum of the four corners of a rectangle is still exact.
+	///
+	const std::vector<uint32_t>& getIntegralImage() const;
+
+	///
+	/// @brief JPEG preview of the frame (every second line, half size above 1920 pixels from the frame pyramid) for the image streams
+	///
+	QByteArray getPreviewJpeg() const;
+
+private:
+	struct BorderEntry
+	{
+		QString mode;
+		double threshold;
+		hyperhdr::BlackBorder border;
+	};
+
+	Image<ColorRgb>		_image;
+	int					_expectedConsumers;
+	std::atomic<int>	_consumers;
+
+	mutable std::mutex	_borderLock;
+	mutable std::vector<BorderEntry> _borders;
+
+	mutable std::once_flag _integralOnce;
+	mutable std::vector<uint32_t> _integral;
+
+	mutable std::once_flag _previewOnce;
+	mutable QByteArray	_preview;
+};
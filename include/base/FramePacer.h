@@ -0,0 +1,35 @@
+#pragma once
+
+#include <QtGlobal>
+
+class PreciseTimer;
+class WriteCadence;
+
+///
+/// Times the smoothing output to the cadence of the led device. With a refresh timer the device writes
+/// the last colors in fixed slots: the smoothing ticks are phase locked to land just before them, so a
+/// frame neither waits for the next slot nor is overwritten before it. A device that writes every frame
+/// gets no intermediate frame while the previous write is still in progress, it would only replace it.
+///
+class FramePacer
+{
+public:
+	FramePacer();
+
+	void reset();
+
+	/// the time [ns] the tick took to produce and send its frame, the margin before the slot follows it
+	void addProcessingTime(qint64 duration);
+
+	/// called on every tick: moves the following ticks of the timer towards the write slots of the device
+	void pace(PreciseTimer* timer, const WriteCadence* cadence);
+
+	/// false when the device is busy with the previous frame until after the next tick
+	bool isDeviceReady(const PreciseTimer* timer, const WriteCadence* cadence) const;
+
+private:
+	qint64 lead() const;
+
+	/// smoothed processing time of a tick [ns]
+	qint64	_processing;
+};
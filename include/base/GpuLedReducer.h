@@ -0,0 +1,54 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include <utils/ColorRgb.h>
+#include <utils/ImageView.h>
+#include <utils/Logger.h>
+
+///
+/// Computes the led colors on the GPU with a GLES 3.1 compute shader: the frame is uploaded as a texture,
+/// one work group reduces the rectangle of one led and only the color sums are read back.
+/// The EGL context is current only during a call, so the reducer can move between threads, but it is not
+/// reentrant. Without ENABLE_GLES_COMPUTE the initialization always fails and the callers use the CPU.
+///
+class GpuLedReducer
+{
+public:
+	GpuLedReducer(Logger* log);
+	~GpuLedReducer();
+
+	bool init();
+	void release();
+	bool isReady() const;
+
+	///
+	/// The exact mean color of every led rectangle, the same result as the integral mapping of ImageToLedsMap
+	///
+	/// @param[in]  areas  x0, y0, x1, y1 of the rectangle [x0, x1) x [y0, y1) for each led, an empty one gives black
+	/// @param[out] colors The led colors
+	/// @return false for a frame that can't be uploaded (ex. a pixel stride other than RGB) or a GPU error
+	///
+	bool reduce(const ImageView<ColorRgb>& image, const std::vector<int32_t>& areas, std::vector<ColorRgb>& colors);
+
+private:
+	bool initContext();
+	bool initProgram();
+	bool upload(const ImageView<ColorRgb>& image);
+
+	Logger*		_log;
+
+	/// EGLDisplay and EGLContext, the GL headers stay out of this header
+	void*		_display;
+	void*		_context;
+	bool		_ready;
+
+	unsigned	_program;
+	unsigned	_texture;
+	unsigned	_areasBuffer;
+	unsigned	_sumsBuffer;
+	unsigned	_textureWidth;
+	unsigned	_textureHeight;
+	size_t		_buffersSize;
+};
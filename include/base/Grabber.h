@@ -5,15 +5,22 @@
 #include <QRectF>
 #include <cstdint>
 #include <QJsonObject>
+#include <QJsonDocument>
 
 #include <utils/ColorRgb.h>
 #include <utils/Image.h>
 #include <utils/FrameDecoder.h>
+#include <utils/StripedDecoder.h>
+#include <utils/CacheMissCounter.h>
+#include <utils/CompactLut.h>
+#include <utils/LutRegistry.h>
 #include <utils/Logger.h>
 #include <utils/Components.h>
 #include <base/DetectionManual.h>
 #include <base/DetectionAutomatic.h>
 #include <utils/PerformanceCounters.h>
+#include <utils/CaptureRecorder.h>
+#include <utils/LatencyHistogram.h>
 
 #include <QMultiMap>
 #include <QSemaphore>
@@ -56,6 +63,11 @@ public:
 
 	virtual void alternativeCaching(bool alternative);
 
+	///
+	/// @brief Centre part of the frame (relative to the cropped frame) that no consumer reads, empty when the whole frame is needed
+	///
+	void setUnusedArea(const QRectF& unusedArea);
+
 	bool trySetWidthHeight(int width, int height);
 
 	bool trySetInput(int input);
@@ -93,6 +105,27 @@ public:
 
 	void setQFrameDecimation(int setQframe);
 
+	void setLutCompactGrid(int gridSize);
+
+	void setDecodeTargetWidth(int targetWidth);
+
+	void setDecodeStripes(int stripes);
+
+	void setMjpegScale(int scale);
+
+	void setHardwareMjpeg(bool enabled);
+
+	void setStreamingIo(const QString& method);
+
+	void setLatencyBudget(int budget);
+
+	void setCaptureThread(bool enabled, bool realtime);
+
+	///
+	/// @brief Decode only a few probe frames per second while the signal detection reports no signal
+	///
+	void setDeepIdle(bool enabled);
+
 	void unblockAndRestart(bool running);
 
 	void setBlocked();
@@ -117,6 +150,31 @@ public:
 
 	QString	getConfigurationPath();
 
+	///
+	/// @brief Benchmark the video modes of the current device that reach the target rate and pick the cheapest one
+	/// @param targetFps  The LED update rate that the selected mode must deliver
+	/// @param duration   The measurement time per video mode [seconds]
+	///
+	QJsonDocument startModeTuning(int targetFps, int duration);
+
+	QJsonDocument stopModeTuning(bool restore = true);
+
+	QJsonDocument getModeTuningInfo();
+
+	///
+	/// @brief With the automatic video encoding: measure the pixel formats of the started mode and keep the cheapest one
+	///
+	void setAutoFormatSelection(bool enabled);
+
+	///
+	/// @brief Record the raw buffers of the driver (see CaptureRecording.h), they can be played back by the "replay" grabber
+	/// @param fileName   The recording
+	/// @param maxFrames  The recording is finished after this number of frames
+	/// @return Empty on success, else the reason
+	///
+	QString startCaptureRecording(const QString& fileName, int maxFrames);
+	void stopCaptureRecording();
+
 	struct DevicePropertiesItem
 	{
 		int		x, y, fps, fps_a, fps_b, input;
@@ -163,6 +221,76 @@ signals:
 protected:
 	void loadLutFile(PixelFormat color, const QList<QString>& files);
 
+	///
+	/// @brief The LUT for the next frame, the decoders keep the handle until the frame is ready
+	///
+	LutHandle currentLut() const;
+
+	void compactLutBuffer();
+
+	///
+	/// @brief The processing parameters of the frames, not the format of the device: the settings replace them as a whole
+	/// between two frames while the stream keeps running
+	///
+	struct ProcessingConfig
+	{
+		quint64	version = 0;
+		int		cropLeft = 0, cropRight = 0, cropTop = 0, cropBottom = 0;
+		int		hdrToneMappingEnabled = 0;
+		int		decodeTargetWidth = 0;
+		int		decodeStripes = 0;
+	};
+
+	typedef std::shared_ptr<const ProcessingConfig> ProcessingHandle;
+
+	///
+	/// @brief The processing parameters for the next frame, read by the capture with an atomic load
+	///
+	ProcessingHandle currentProcessing() const;
+
+	///
+	/// @brief Called by the setters: swaps the snapshot for the next frames. While the configuration is reloaded
+	/// it waits for unblockAndRestart, so the new settings don't reach a frame one by one
+	///
+	void publishProcessing();
+
+	///
+	/// @brief Apply the brightness, contrast, saturation and hue to the running device
+	/// @return false if the grabber must be restarted for them
+	///
+	virtual bool applyDeviceControls();
+
+	///
+	/// @brief Called by the grabbers when the device is started: with the automatic encoding and the format selection enabled,
+	/// the pixel format of the device signature is read from the cache or every format of the mode is measured
+	///
+	void selectPixelFormat();
+
+	///
+	/// @brief The internal YUV to RGB table when there is no LUT file: a compact grid is sampled directly,
+	/// the full table is mapped from its copy in the configuration folder, which is generated once
+	///
+	void loadInternalLut();
+
+private:
+	void loadLutTables(PixelFormat color, const QList<QString>& files);
+
+	///
+	/// @brief Swap the snapshot of the loaded table for the next frames
+	///
+	void publishLut();
+
+protected:
+
+	int getMjpegScale();
+
+	/// the frame skipping and the qframe of the settings, raised while the quality governor is at the frame decimation step
+	/// or when the deep idle probes the lost signal
+	int getEffectiveDecimation();
+	bool getEffectiveQFrame();
+
+	void reportCacheMisses();
+
 	void processSystemFrameBGRA(uint8_t* source, int lineSize = 0);
 
 	void processSystemFrameBGR(uint8_t* source, int lineSize = 0);
@@ -227,8 +355,13 @@ protected:
 		int64_t			frameBegin;
 		int   			averageFrame;
 		unsigned int	badFrame, goodFrame, segment;
+		// frames dropped by the newest-frame-wins policy
+		unsigned int	queueFullFrame, staleFrame, overBudgetFrame;
 	} frameStat;
 
+	// distribution of the decoding time of the frames counted in frameStat
+	LatencyHistogram	_decodingLatency;
+
 	volatile uint64_t   _currentFrame;
 
 	QString		_deviceName;
@@ -236,6 +369,20 @@ protected:
 	PixelFormat	_enc;
 	int			_brightness, _contrast, _saturation, _hue;
 	bool		_qframe;
+	int			_decodeTargetWidth;
+	int			_decodeStripes;
+	int			_mjpegScale;
+	bool		_hardwareMjpeg;
+	QString		_mjpegDecoder;
+	QString		_streamingIo;
+	QString		_streamingIoInUse;
+	int			_latencyBudget;
+	bool		_deepIdle;
+	bool		_idleProbing;
+	bool		_autoFormatSelection;
+	bool		_dedicatedCapture;
+	bool		_realtimeCapture;
+	int64_t		_lutCacheMisses;
 	bool		_blocked;
 	bool		_restartNeeded;
 	bool		_initialized;
@@ -245,8 +392,17 @@ protected:
 	int			_actualWidth, _actualHeight, _actualFPS;
 	QString		_actualDeviceName;
 
-	uint8_t*	_lutBuffer;
+	const uint8_t*	_lutBuffer;
+	std::shared_ptr<const LutTable> _lutTable;
 	bool		_lutBufferInit;
+	int			_lutCompactGrid;
+	CompactLut	_compactLut;
+	uint32_t	_lutFastCRC;
+	/// read by the capture with an atomic load, replaced by loadLutFile
+	LutHandle	_lutHandle;
+	/// read by the capture with an atomic load, replaced by publishProcessing
+	ProcessingHandle	_processingHandle;
+	quint64		_processingVersion;
 
 	int			_lineLength;
 	int			_frameByteSize;
@@ -254,6 +410,58 @@ protected:
 	bool		_signalDetectionEnabled;
 	bool		_signalAutoDetectionEnabled;
 	QSemaphore  _synchro;
+
+	QRectF		_unusedArea;
+
+	CaptureRecorder	_captureRecorder;
+
+	///
+	/// @brief The part of the unused area that can be skipped by the decoder: the signal detection reads the frame too
+	///
+	QRectF getSkippedArea();
+
+private:
+	void nextModeTuningStep();
+
+	void finishModeTuning();
+
+	void applyVideoMode(int width, int height, int fps, PixelFormat format, int decimation);
+
+	void finishFormatSelection();
+
+	// frame statistics that survive the periodic reset of frameStat
+	uint64_t	_totalGoodFrames;
+	int64_t		_totalFrameTime;
+
+	struct ModeTuningCandidate
+	{
+		int			width = 0, height = 0, fps = 0;
+		PixelFormat	format = PixelFormat::NO_CHANGE;
+		bool		measured = false, meetsTarget = false;
+		double		rate = 0, frameTime = 0, cost = 0;
+		int			decimation = 1;
+	};
+
+	struct
+	{
+		bool		active = false;
+		int			generation = 0;
+		int			targetFps = 0;
+		int			duration = 0;
+		int			current = -1;
+		int			selected = -1;
+		QList<ModeTuningCandidate> candidates;
+
+		int			width = 0, height = 0, fps = 0, decimation = 1;
+		PixelFormat	format = PixelFormat::NO_CHANGE;
+
+		/// the device signature when only the pixel formats of the started mode are measured
+		QString		formatSignature;
+
+		uint64_t	startFrames = 0;
+		int64_t		startFrameTime = 0;
+		int64_t		startTime = 0;
+	} _modeTuning;
 };
 
 bool sortDevicePropertiesItem(const Grabber::DevicePropertiesItem& v1, const Grabber::DevicePropertiesItem& v2);
@@ -6,6 +6,9 @@
 #include <QString>
 #include <QStringList>
 #include <QMultiMap>
+#include <QMap>
+#include <QMutex>
+#include <QRectF>
 
 #include <utils/Logger.h>
 #include <utils/Components.h>
@@ -33,6 +36,26 @@ public:
 	static	GrabberWrapper* instance;
 	static	GrabberWrapper* getInstance() { return instance; }
 
+	///
+	/// @brief Assign the instances to the additional grabbers, the other instances use the main grabber
+	/// @param routing  The instance index -> additional grabber name map
+	///
+	static	void setRouting(const QMap<int, QString>& routing);
+
+	///
+	/// @brief Check if the images of the grabber are meant for the instance
+	///
+	static	bool isRouted(int instanceIndex, const QString& grabberName);
+
+	///
+	/// @brief Revive the grabber that is assigned to the instance
+	///
+	static	void reviveRouted(int instanceIndex);
+
+	QString getGrabberName() const;
+
+	void setAdditional(bool additional);
+
 	QMap<Grabber::currentVideoModeInfo, QString> getVideoCurrentMode() const;
 
 	bool isCEC();
@@ -63,8 +86,19 @@ public slots:
 	QJsonDocument stopCalibration();
 	QJsonDocument getCalibrationInfo();
 
+	QJsonDocument startModeTuning(int targetFps, int duration);
+	QJsonDocument stopModeTuning();
+	QJsonDocument getModeTuningInfo();
+
+	QString startCaptureRecording(QString fileName, int maxFrames);
+	void stopCaptureRecording();
+
+	void setRegionDecoding(bool enabled);
+
 private slots:
 	void handleSourceRequest(hyperhdr::Components component, int instanceIndex, bool listen);
+	void handleRegionRequest(int instanceIndex, const QRectF& unusedArea);
+	void handleLightSleep(bool sleep);
 
 signals:
 	///
@@ -98,6 +132,14 @@ public slots:
 protected:
 	DetectionAutomatic::calibrationPoint parsePoint(int width, int height, QJsonObject element, bool& ok);
 
+	bool servesInstance(int instanceIndex) const;
+
+	void updateRouting();
+
+	void updateUnusedArea();
+
+	void resumeAfterSleep(int attempt);
+
 	QString		_grabberName;
 
 	Logger*		_log;
@@ -111,9 +153,20 @@ protected:
 	bool		_autoResume;
 	bool		_isPaused;
 	bool		_pausingModeEnabled;
+	bool		_deepIdle;
+	bool		_lightSleep;
 
 	int			_benchmarkStatus;
 	QString		_benchmarkMessage;
 	QList<int>	_running_clients;
 	QList<int>	_paused_clients;
+	bool		_additional;
+
+	QMap<int, QRectF>	_unusedAreas;
+	bool				_regionDecoding;
+
+	static QMutex					_routingLock;
+	static QList<int>				_requested_clients;
+	static QMap<int, QString>		_routing;
+	static QList<GrabberWrapper*>	_registry;
 };
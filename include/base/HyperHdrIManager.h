@@ -8,6 +8,12 @@
 // qt
 #include <QMap>
 
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include <base/FrameContext.h>
+
 class HyperHdrInstance;
 class InstanceTable;
 
@@ -45,9 +51,22 @@ public:
 	QString getRootPath() { return _rootPath; }
 	bool areInstancesReady();
 
+	///
+	/// @brief Get the shared analysis of the frame, all the instances that process the same image get the same context.
+	/// Thread safe, the context lives as long as one of the instances holds it.
+	///
+	std::shared_ptr<FrameContext> getFrameContext(const Image<ColorRgb>& image);
+
 public slots:
 	void setSmoothing(int time);
 
+	///
+	/// @brief Handle the global settings shared by all the instances
+	/// @param type   settingType from enum
+	/// @param config configuration object
+	///
+	void handleSettingsUpdate(settings::type type, const QJsonDocument& config);
+
 	bool isCEC();
 
 	void setSignalStateByCEC(bool enable);
@@ -98,6 +117,11 @@ public slots:
 	///
 	void toggleStateAllInstances(bool pause = false);
 
+	///
+	/// @brief The system goes to sleep or wakes up. The light sleep stops only the capture streams and the LED output,
+	/// the full one disables all the components of the instances and restores them 3 seconds after the wake-up
+	/// @param wakeUp  True when the system wakes up
+	///
 	void hibernate(bool wakeUp);
 
 	///
@@ -211,6 +235,24 @@ private:
 	bool	_readonlyMode;
 	int		_fireStarter;
 
+	/// The start requests of the queued instances [ms] for the startup timing report
+	QMap<quint8, qint64> _startTimes;
+	qint64	_startAllTime;
+
+	/// The HDR state of the grabber handed to the instances spawned by startAll, -1 otherwise
+	int		_startupHdrState;
+
+	/// Only the streams and the output stop when the system goes to sleep (general settings)
+	bool	_lightSleepEnabled;
+	/// The system sleeps in the light mode
+	bool	_isLightSleeping;
+
 	/// All pending requests
 	QMap<quint8, PendingRequests> _pendingRequests;
+
+	/// The contexts of the frames being processed, the references are weak so the frame buffers are not kept alive
+	std::mutex _frameContextLock;
+	std::vector<std::weak_ptr<FrameContext>> _frameContexts;
+	std::weak_ptr<FrameContext> _newestFrameContext;
+	int		_recentFrameConsumers;
 };
@@ -19,9 +19,12 @@
 #include <utils/Image.h>
 #include <utils/ColorRgb.h>
 #include <utils/Components.h>
+#include <utils/LedFramePool.h>
+#include <utils/LatencyHistogram.h>
 
 
 #include <base/LedString.h>
+#include <base/LedColorPipeline.h>
 #include <base/PriorityMuxer.h>
 #include <base/ColorAdjustment.h>
 #include <base/ComponentRegister.h>
@@ -39,6 +42,7 @@
 class ImageProcessor;
 class MessageForwarder;
 class LinearSmoothing;
+class PresentationScheduler;
 class EffectEngine;
 class MultiColorAdjustment;
 class ColorAdjustment;
@@ -46,8 +50,10 @@ class SettingsManager;
 class BGEffectHandler;
 class VideoControl;
 class SystemControl;
+class GlobalInputChannel;
 class BoblightServer;
 class RawUdpServer;
+class LedFrameReplay;
 class LedDeviceWrapper;
 class ImageProcessingUnit;
 class Logger;
@@ -80,6 +86,11 @@ public:
 
 	ImageProcessor* getImageProcessor() const { return _imageProcessor; }
 
+	///
+	/// @brief True when the input image is streamed to the clients or forwarded, not only mapped to the LEDs
+	///
+	bool isImageConsumed();
+
 	///
 	/// @brief Get instance index of this instance
 	/// @return The index of this instance
@@ -103,6 +114,11 @@ public:
 	///
 	QString getActiveDeviceType() const;
 
+	///
+	/// @brief The write timing of the current led device for the smoothing, nullptr without a device
+	///
+	std::shared_ptr<WriteCadence> getWriteCadence() const;
+
 	ImageProcessor* getImageProcessor();
 
 	void updateLedsValues(int priority, const std::vector<ColorRgb>& ledColors);
@@ -121,6 +137,14 @@ public slots:
 
 	void saveCalibration(QString saveData);
 
+	///
+	/// @brief Play a recording of the "recorder" LED device back as an input
+	/// @return Empty on success, else the reason
+	///
+	QString startReplay(QString fileName, double speed, int priority);
+
+	void stopReplay();
+
 	void saveGrabberParams(int hardware_brightness, int hardware_contrast, int hardware_saturation);
 
 	///
@@ -131,7 +155,17 @@ public slots:
 
 	void requestForColors();
 
-	void updateResult(std::vector<ColorRgb> _ledBuffer);
+	void updateResult(const std::vector<ColorRgb>& ledColors, const FrameTrace& trace);
+
+	///
+	/// @brief Hands the final colors over to the led device thread in a pooled frame, after the A/V sync delay when it's set
+	///
+	void writeLedDeviceData(const std::vector<ColorRgb>& ledValues, const FrameTrace& trace);
+
+	///
+	/// @brief The frame is due: called by writeLedDeviceData or later by the presentation scheduler
+	///
+	void presentLedDeviceData(const std::vector<ColorRgb>& ledValues, const FrameTrace& trace);
 
 	///
 	/// Returns the number of attached leds
@@ -156,9 +190,10 @@ public slots:
 	/// @param  ledColors    The colors
 	/// @param  timeout_ms   The new timeout (defaults to -1 endless)
 	/// @param  clearEffect  Should be true when NOT called from an effect
+	/// @param  captureTimestamp  The capture time of the colors (InternalClock::now), 0 if unknown
 	/// @return              True on success, false when priority is not found
 	///
-	bool setInput(int priority, const std::vector<ColorRgb>& ledColors, int timeout_ms = -1, bool clearEffect = true);
+	bool setInput(int priority, const std::vector<ColorRgb>& ledColors, int timeout_ms = -1, bool clearEffect = true, int64_t captureTimestamp = 0);
 
 	///
 	/// @brief   Update the current image of a priority (prev registered with registerInput())
@@ -426,14 +461,20 @@ signals:
 
 	///
 	/// @brief Emits whenever new data should be pushed to the LedDeviceWrapper which forwards it to the threaded LedDevice
+	/// @param trace the stages passed by the source frame, with its capture time
 	///
-	void ledDeviceData(const std::vector<ColorRgb>& ledValues);
+	void ledDeviceData(const LedFrame& ledValues, const FrameTrace& trace);
 
 	///
 	/// @brief Emits whenever new untransformed ledColos data is available, reflects the current visible device
 	///
 	void rawLedColors(const std::vector<ColorRgb>& ledValues);
 
+	///
+	/// @brief The same untransformed colors for the render nodes, with the capture time of the source frame (0 if unknown)
+	///
+	void renderNodeColors(const std::vector<ColorRgb>& ledValues, int64_t captureTimestamp);
+
 	///
 	/// @brief Emits before thread quit is requested
 	///
@@ -461,6 +502,11 @@ private slots:
 
 	void handlePriorityChangedLedDevice(const quint8& priority);
 
+	///
+	///	@brief Takes the colors computed by the processing thread
+	///
+	void handleProcessedResult();
+
 private:
 	friend class HyperHdrIManager;
 
@@ -477,6 +523,9 @@ private:
 
 	std::unique_ptr<ImageProcessingUnit> _imageProcessingUnit;
 
+	/// The image to leds stage runs here, not delayed by the settings, the API calls and the timers of the instance thread
+	QThread*							_processingThread;
+
 	/// Settings manager of this instance
 	SettingsManager*		_settingsManager;
 
@@ -486,6 +535,9 @@ private:
 	/// The specifiation of the led frame construction and picture integration
 	LedString		_ledString;
 
+	/// The masking of the disabled leds and the color order of _ledString
+	LedColorPipeline	_ledPipeline;
+
 	/// Image Processor
 	ImageProcessor* _imageProcessor;
 
@@ -501,6 +553,9 @@ private:
 	/// The smoothing LedDevice
 	LinearSmoothing*	_smoothing;
 
+	/// Holds the frames after the smoothing for the A/V sync delay
+	PresentationScheduler*	_presentation;
+
 	/// Effect engine
 	EffectEngine*		_effectEngine;
 
@@ -523,12 +578,22 @@ private:
 
 	SystemControl*	_systemControl;
 
+	/// the global input of the network sources that target this instance
+	GlobalInputChannel*	_globalInput;
+
 	/// buffer for leds (with adjustment)
 	std::vector<ColorRgb>	_globalLedBuffer;
 
+	/// working buffer of updateResult, kept to reuse its capacity
+	std::vector<ColorRgb>	_ledBuffer;
+
+	/// the frames for the led device thread
+	LedFramePool			_ledFramePool;
+
 	/// Boblight instance
 	BoblightServer*			_boblightServer;
 	RawUdpServer*			_rawUdpServer;
+	LedFrameReplay*			_ledFrameReplay;
 
 	QString					_name;
 
@@ -539,4 +604,23 @@ private:
 		qint64		statBegin = 0;
 		uint32_t	total = 0;
 	} _computeStats;
+
+	/// the time from the queueing of a frame to the adjusted LED colors (mapping and adjustments) [100us]
+	LatencyHistogram		_processingLatency;
+
+	/// the sections of getJsonInfo(true) that are built again only after a change of their source
+	enum JsonInfoSection
+	{
+		JSON_INFO_ADJUSTMENT = 0x1,
+		JSON_INFO_EFFECTS = 0x2,
+		JSON_INFO_COMPONENTS = 0x4,
+		JSON_INFO_LEDS = 0x8,
+		JSON_INFO_ALL = 0xF
+	};
+
+	QJsonObject				_jsonInfoCache;
+	int						_jsonInfoDirty;
+
+	/// the time of the first LED frame is reported once for the startup timing
+	bool					_firstLedFrame;
 };
@@ -1,5 +1,7 @@
 #pragma once
 
+#include <atomic>
+
 class ImageProcessingUnit : public QObject
 {
 	Q_OBJECT
@@ -8,8 +10,21 @@ public:
 	ImageProcessingUnit(HyperHdrInstance* hyperhdr);
 	~ImageProcessingUnit();
 
+	/// frames older than the budget [ms] (since the capture or the arrival) are dropped while the source is streaming, 0 = unlimited
+	static void setLatencyBudget(int budget);
+
+	/// frame queue counters since the last call: queued, overwritten by a newer one before processing, processed, waited longer than the budget
+	void takeQueueCounters(qint64& received, qint64& coalesced, qint64& processed, qint64& overBudget);
+
+	/// processed and over budget frames of all the instances since the last call, for the quality governor
+	static void takeBudgetCounters(qint64& processed, qint64& overBudget);
+
+	/// called from the instance thread when resultReadySignal arrives: hands the newest computed colors to the instance
+	void deliverResult();
+
 signals:
-	void dataReadySignal(std::vector<ColorRgb> result);
+	void dataReadySignal(const std::vector<ColorRgb>& result, const FrameTrace& trace);
+	void resultReadySignal();
 	void processImageSignal();
 	void queueImageSignal(int priority, const Image<ColorRgb>& image);
 	void clearQueueImageSignal();
@@ -20,7 +35,52 @@ private slots:
 	void processImage();
 
 private:
+	void releaseFrame();
+
+	/// one slot mailbox: the producer swaps in the newest frame, the processing thread takes it out
+	struct PendingFrame
+	{
+		int				priority;
+		Image<ColorRgb>	image;
+		qint64			queuedTime;
+		qint64			previousQueuedTime;
+		int				generation;
+		FrameTrace		trace;
+	};
+
+	/// the same in the other direction: the processing thread publishes the result, the instance thread takes it
+	struct PendingResult
+	{
+		int						priority;
+		std::vector<ColorRgb>	colors;
+		FrameTrace				trace;
+		bool					notify;
+		int						generation;
+	};
+
+	void publishResult(const PendingResult& result);
+
 	int	_priority;
 	HyperHdrInstance*	_hyperhdr;
 	Image<ColorRgb>		_frameBuffer;
+	qint64				_frameQueuedTime;
+	qint64				_previousQueuedTime;
+	std::atomic<PendingFrame*>	_mailbox;
+	std::atomic<PendingResult*>	_result;
+	/// bumped by clearQueueImage: the results of the frames taken before are outdated
+	std::atomic<int>	_generation;
+	std::atomic<qint64>	_lastQueuedTime;
+	std::atomic<qint64>	_receivedFrames;
+	std::atomic<qint64>	_coalescedFrames;
+	std::atomic<qint64>	_processedFrames;
+	std::atomic<qint64>	_overBudgetFrames;
+	int					_lastPriority;
+	qint64				_lastResultTime;
+
+	/// the colors of a static image are sent again after this period [ms]
+	static constexpr qint64 KEEP_ALIVE_MS = 1000;
+
+	static std::atomic<int> _latencyBudget;
+	static std::atomic<qint64> _budgetProcessedFrames;
+	static std::atomic<qint64> _budgetOverFrames;
 };
@@ -1,11 +1,16 @@
 #pragma once
 
 #include <QString>
+#include <QMutex>
 
+#include <atomic>
 #include <memory>
+#include <list>
+#include <vector>
 
 // Utils includes
 #include <utils/Image.h>
+#include <utils/ImageView.h>
 
 #include <base/LedString.h>
 #include <base/ImageToLedsMap.h>
@@ -19,6 +24,8 @@
 
 class HyperHdrInstance;
 class ImageProcessingUnit;
+class FrameContext;
+class GpuLedReducer;
 
 ///
 /// The ImageProcessor translates an RGB-image to RGB-values for the LEDs. The processing is
@@ -60,6 +67,9 @@ public:
 	/// Returns state of black border detector
 	bool blackBorderDetectorEnabled() const;
 
+	/// Returns the part of the frames that the black border detector analyzes now
+	double getBlackBorderAnalysisRate() const;
+
 	/// Returns the current _mappingType
 	int getLedMappingType() const;
 
@@ -68,6 +78,33 @@ public:
 
 	void setSparseProcessing(bool sparseProcessing);
 
+	///
+	/// @brief The number of leds from which the colors are computed on the shared thread pool, 0 = never
+	///
+	void setParallelThreshold(int parallelThreshold);
+
+	///
+	/// @brief Compute the integral mapping on the GPU when the build and the system support it
+	///
+	void setGpuProcessing(bool gpuProcessing);
+
+	///
+	/// @brief The grabbers must deliver the whole frame while the image is streamed or forwarded
+	///
+	void setFullFrameRequired(bool required);
+
+	///
+	/// @brief The part of the shared frame used by this instance, cut from each side [percent]
+	///
+	void setCrop(int left, int right, int top, int bottom);
+
+	bool hasCrop() const;
+
+	///
+	/// @brief The view of the part of the frame used by this instance, without a copy
+	///
+	ImageView<ColorRgb> cropView(const Image<ColorRgb>& image) const;
+
 public slots:
 
 	void setBlackbarDetectDisable(bool enable);
@@ -84,7 +121,10 @@ public:
 	///
 	void setSize(const Image<ColorRgb>& image);
 
-	void verifyBorder(const Image<ColorRgb>& image);
+	///
+	/// Runs the black border detection, the raw detection result is shared through the frame context when given
+	///
+	void verifyBorder(const ImageView<ColorRgb>& image, const FrameContext* context = nullptr);
 
 	///
 	/// Get the hscan and vscan parameters for a single led
@@ -104,8 +144,22 @@ private:
 		const unsigned horizontalBorder,
 		const unsigned verticalBorder);
 
+	///
+	/// @brief Called by the processing thread for every frame: a mapping finished on the thread pool replaces the current one
+	///
+	void adoptBuiltMapping();
+
+	void publishUnusedArea();
+
+	/// registers the image size the led areas need, the network sources reduce their images to it
+	void publishIngestSize();
+
+	/// Called by the processing thread: the reducer for the current mapping, created on the first use, nullptr for the CPU
+	GpuLedReducer* getGpuReducer();
+
 private slots:
 	void handleSettingsUpdate(settings::type type, const QJsonDocument& config);
+	void qualityLevelChanged(int level);
 
 private:
 	Logger* _log;
@@ -122,9 +176,87 @@ private:
 	int _mappingType;
 
 	bool _sparseProcessing;
+	/// the sparse processing of the settings, the quality governor may enable it temporarily
+	bool _sparseSetting;
+
+	int _parallelThreshold;
+
+	bool _gpuProcessing;
+	bool _gpuFailed;
+	std::unique_ptr<GpuLedReducer> _gpuReducer;
+
+	/// The part of the image that is not used by the led areas, published to the grabbers
+	QRectF _unusedArea;
+
+	bool _fullFrameRequired;
+
+	/// The crop of the frame for this instance [percent]
+	int _cropLeft, _cropRight, _cropTop, _cropBottom;
+
+	/// Everything the led mapping is built from, except the led layout that clears the cache
+	struct MappingKey
+	{
+		unsigned width, height, horizontalBorder, verticalBorder;
+		int mappingType;
+		bool sparseProcessing;
+		int parallelThreshold;
+
+		bool operator==(const MappingKey& other) const
+		{
+			return width == other.width && height == other.height &&
+				horizontalBorder == other.horizontalBorder && verticalBorder == other.verticalBorder &&
+				mappingType == other.mappingType && sparseProcessing == other.sparseProcessing &&
+				parallelThreshold == other.parallelThreshold;
+		}
+	};
+
+	std::shared_ptr<hyperhdr::ImageToLedsMap> findCachedMapping(const MappingKey& key);
+
+	void cacheMapping(const MappingKey& key, const std::shared_ptr<hyperhdr::ImageToLedsMap>& mapping);
+
+	/// a mapping that is not cached is built on the thread pool, the current one serves the frames until it's ready
+	void requestMapping(const MappingKey& key);
+
+	///
+	/// The state shared with the build task, it outlives the processor when the task is still running
+	///
+	struct MappingBuild
+	{
+		QMutex	lock;
+		bool	running = false;
+		/// the newest request, the task builds it next when it differs from the finished one
+		MappingKey	requested{};
+		/// the led layout of the requests, the generation discards the mappings of a previous layout
+		std::vector<Led>	leds;
+		quint64		generation = 0;
+
+		std::shared_ptr<hyperhdr::ImageToLedsMap> ready;
+		MappingKey	readyKey{};
+		quint64		readyGeneration = 0;
+		std::atomic<bool>	hasReady{ false };
+	};
+
+	/// runs on the thread pool until the newest request is built
+	static void buildMappings(const std::shared_ptr<MappingBuild>& build, Logger* log, quint8 instanceIndex);
+
+	std::shared_ptr<MappingBuild> _mappingBuild;
+
+	/// the geometry of the last request, served by _imageToLedColors once it's built
+	MappingKey _wantedKey;
+
+	/// Ready mappings for the recent geometries (ex. a black border that comes and goes), most recent first
+	std::list<std::pair<MappingKey, std::shared_ptr<hyperhdr::ImageToLedsMap>>> _mappingCache;
+	qint64 _mappingCacheHits;
+	qint64 _mappingCacheMisses;
+
+	/// The memory limit of the cached mappings [bytes]
+	static constexpr size_t MAPPING_CACHE_LIMIT = 32 * 1024 * 1024;
 
 	// lut advanced operator
 	uint16_t advanced[256];
 
+	/// The processing thread holds it for a frame, the setters called from the instance thread wait for it
+	mutable QMutex _lock;
+
 	quint8 _instanceIndex;
 };
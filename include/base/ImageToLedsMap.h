@@ -6,14 +6,21 @@
 #include <sstream>
 #include <math.h>
 #include <algorithm>
+#include <functional>
 
+#include <QRectF>
 
 #include <utils/Image.h>
+#include <utils/ImageView.h>
 #include <utils/Logger.h>
+#include <utils/MemoryAccounting.h>
 
 
 #include <base/LedString.h>
 
+class FrameContext;
+class GpuLedReducer;
+
 namespace hyperhdr
 {
 
@@ -32,6 +39,7 @@ namespace hyperhdr
 		/// The mapping is created purely on size (width and height). The given borders are excluded
 		/// from indexing.
 		///
+		/// @param[in] parallelThreshold From this number of leds the colors are computed on the shared thread pool (0 = never)
 		/// @param[in] width            The width of the indexed image
 		/// @param[in] height           The width of the indexed image
 		/// @param[in] horizontalBorder The size of the horizontal border (0=no border)
@@ -42,6 +50,7 @@ namespace hyperhdr
 			Logger* _log,
 			const int mappingType,
 			const bool sparseProcessing,
+			const int parallelThreshold,
 			const unsigned width,
 			const unsigned height,
 			const unsigned horizontalBorder,
@@ -66,14 +75,67 @@ namespace hyperhdr
 		unsigned horizontalBorder() const;
 		unsigned verticalBorder() const;
 
-		std::vector<ColorRgb> Process(const Image<ColorRgb>& image, uint16_t* advanced);
+		///
+		/// Returns the centre part of the image that none of the led areas reads, relative to the
+		/// image size. The led areas are assigned to the nearest edge, so everything outside of the
+		/// rectangle is a full-length band along the edges. Empty when the whole image is needed.
+		///
+		QRectF getUnusedArea() const;
+
+		///
+		/// Returns the memory held by the mapping [bytes]
+		///
+		size_t memoryUsage() const;
+
+		///
+		/// Calculates the colors of the leds. The view can be strided (ex. a foreign capture buffer),
+		/// for non-packed layouts the indices are remapped once and cached.
+		/// The tiles under the led areas are hashed on every frame: with reuse enabled only the leds
+		/// whose tiles changed are computed again, the others keep the colors of the previous frame.
+		///
+		/// @param[in]  reuse     Allow the colors of the previous frame, false forces the full computation
+		/// @param[out] unchanged None of the tiles changed since the previous frame
+		/// @param[in]  context   The shared analysis of the frame (optional), its integral image replaces the own tables when shared
+		/// @param[in]  gpu       The GPU reducer for the integral mapping (optional), the CPU computes the colors when it fails
+		///
+		std::vector<ColorRgb> Process(const ImageView<ColorRgb>& image, uint16_t* advanced, bool reuse, bool& unchanged, const FrameContext* context = nullptr, GpuLedReducer* gpu = nullptr);
 
 	private:
-		std::vector<ColorRgb> getMeanLedColor(const Image<ColorRgb>& image) const;
+		///
+		/// Samples of one image row: count pixels starting at the byte offset, step bytes apart.
+		/// The low weight flag marks the half of the weighted edge leds that lies away from the edge.
+		///
+		struct ColorSpan
+		{
+			int32_t		offset;
+			uint16_t	count;
+			uint16_t	step;
+			bool		lowWeight;
+		};
+
+		const std::vector<std::vector<ColorSpan>>& getColorsMap(const ImageView<ColorRgb>& image);
+
+		std::vector<ColorRgb> getMeanLedColor(const uint8_t* imgData, const std::vector<std::vector<ColorSpan>>& colorsMap, const uint8_t* dirty) const;
+
+		std::vector<ColorRgb> getUniLedColor(const ImageView<ColorRgb>& image) const;
+
+		std::vector<ColorRgb> getMeanAdvLedColor(const uint8_t* imgData, const std::vector<std::vector<ColorSpan>>& colorsMap, uint16_t* lut, const uint8_t* dirty) const;
+
+		std::vector<ColorRgb> getIntegralLedColor(const ImageView<ColorRgb>& image, const FrameContext* context);
 
-		std::vector<ColorRgb> getUniLedColor(const Image<ColorRgb>& image) const;
+		std::vector<ColorRgb> getDominantLedColor(const uint8_t* imgData, const std::vector<std::vector<ColorSpan>>& colorsMap, const uint8_t* dirty) const;
 
-		std::vector<ColorRgb> getMeanAdvLedColor(const Image<ColorRgb>& image, uint16_t* lut) const;
+		void buildIntegralStrips(int32_t scanTop, int32_t scanBottom, int32_t scanLeft, int32_t scanRight);
+
+		void buildChunks(int threads);
+
+		void buildTiles(const std::vector<std::vector<int32_t>>& ledRects);
+
+		/// Hashes the active tiles of the image, returns the number of the tiles that changed
+		size_t hashTiles(const ImageView<ColorRgb>& image);
+
+		/// Calls reduce for the led ranges of _chunks, in parallel when there is more than one
+		void reduceLeds(const std::function<void(size_t, size_t)>& reduce) const;
 
 		/// The width of the indexed image
 		const unsigned _width;
@@ -86,18 +148,74 @@ namespace hyperhdr
 
 		int _mappingType;
 
-		/// The absolute indices into the image for each led
-		std::vector<std::vector<int32_t>> _colorsMap;
+		/// The sampled row spans of the image for each led
+		std::vector<std::vector<ColorSpan>> _colorsMap;
 		std::vector<int> _colorsGroups;
 
+		/// The spans remapped for the last non-packed image layout
+		std::vector<std::vector<ColorSpan>> _stridedColorsMap;
+		ptrdiff_t _stridedLineStride;
+		unsigned  _stridedPixelStride;
+
 		int _groupMin;
 		int _groupMax;
 
-		ColorRgb calcMeanColor(const Image<ColorRgb>& image, const std::vector<int32_t>& colors) const;
+		/// The part of the image that is not used by any led
+		QRectF _unusedArea;
+
+		/// Summed-area table of a part of the image: (width + 1) x (height + 1) RGB sums, the first row and column are zero
+		struct IntegralStrip
+		{
+			int32_t x0, y0, x1, y1;
+			std::vector<uint32_t> table;
+		};
+
+		/// The led rectangle [x0, x1) x [y0, y1) and the strip that contains it, -1 for the leds without area
+		struct IntegralArea
+		{
+			int		strip;
+			int		edge;
+			int32_t	x0, y0, x1, y1;
+		};
+
+		/// The tables are rebuilt on every frame only for the edge bands that contain the led areas
+		std::vector<IntegralStrip> _integralStrips;
+		std::vector<IntegralArea>  _integralAreas;
+
+		/// x0, y0, x1, y1 of every integral area for the GPU reducer, zeros for the leds without area
+		std::vector<int32_t> _gpuAreas;
+
+		/// Boundaries of the led ranges of about the same pixel cost, empty when the leds are processed inline
+		std::vector<size_t> _chunks;
+
+		/// Change detection on a grid of TILE_SIZE x TILE_SIZE tiles, only the tiles under the led areas are hashed
+		static constexpr unsigned TILE_SIZE = 32;
+		unsigned _tileColumns;
+		std::vector<uint32_t> _tiles;
+		std::vector<uint64_t> _tileHashes;
+		std::vector<uint8_t>  _tileChanged;
+		bool _tilesValid;
+
+		/// The covering tiles of each led: positions in _tiles from _ledTilesBegin[i] to _ledTilesBegin[i + 1]
+		std::vector<uint32_t> _ledTilesBegin;
+		std::vector<uint32_t> _ledTiles;
+		std::vector<uint8_t>  _ledDirty;
+
+		/// The led colors of the previous frame before the group averaging
+		std::vector<ColorRgb> _previousColors;
+
+		/// memoryUsage() of the map, updated when the index is built or remapped
+		MemoryAccounting::Tag _memory;
+
+		ColorRgb calcMeanColor(const uint8_t* imgData, const std::vector<ColorSpan>& colors) const;
+
+		/// squares: the lut holds i * i, the packed spans skip the lookup then
+		ColorRgb calcMeanAdvColor(const uint8_t* imgData, const std::vector<ColorSpan>& colors, uint16_t* lut, bool squares) const;
 
-		ColorRgb calcMeanAdvColor(const Image<ColorRgb>& image, const std::vector<int32_t>& colors, uint16_t* lut) const;
+		ColorRgb calcMeanColor(const ImageView<ColorRgb>& image) const;
 
-		ColorRgb calcMeanColor(const Image<ColorRgb>& image) const;
+		/// The mean color of the most populated bin of a 4 x 4 x 4 RGB histogram of the area
+		ColorRgb calcDominantColor(const uint8_t* imgData, const std::vector<ColorSpan>& colors) const;
 	};
 
 }
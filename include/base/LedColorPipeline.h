@@ -0,0 +1,39 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include <utils/ColorRgb.h>
+#include <base/LedString.h>
+
+///
+/// Whole buffer stages for the led colors on the way from the image mapping to the device.
+/// The per led decisions (disabled leds, color order) are resolved once in configure(),
+/// so the loops are branch free and the compiler can vectorize them.
+///
+class LedColorPipeline
+{
+public:
+	LedColorPipeline();
+
+	/// must be called again when the led layout or the color order changes
+	void configure(const LedString& ledString);
+
+	bool hasDisabled() const;
+
+	/// the disabled leds become black
+	void maskDisabled(std::vector<ColorRgb>& colors) const;
+
+	/// reorder the color channels for the device
+	void applyColorOrder(std::vector<ColorRgb>& colors) const;
+
+private:
+	template<int R, int G, int B>
+	static void permute(ColorRgb* colors, size_t count);
+
+	/// 0x00 for every channel of a disabled led, 0xFF otherwise
+	std::vector<uint8_t> _mask;
+	ColorOrder _colorOrder;
+	bool _hasDisabled;
+};
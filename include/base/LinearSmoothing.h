@@ -2,6 +2,7 @@
 
 // STL includes
 #include <vector>
+#include <atomic>
 
 // Qt includes
 #include <QVector>
@@ -9,11 +10,12 @@
 // hyperhdr incluse
 #include <leddevice/LedDevice.h>
 #include <utils/Components.h>
+#include <base/FramePacer.h>
 
 // settings
 #include <utils/settings.h>
 
-class QTimer;
+class PreciseTimer;
 class Logger;
 class HyperHdrInstance;
 
@@ -33,17 +35,19 @@ public:
 	LinearSmoothing(const QJsonDocument& config, HyperHdrInstance* hyperhdr);
 	~LinearSmoothing();
 
-	/// LED values as input for the smoothing filter
-	///
-	/// @param ledValues The color-value per led
-	/// @return Zero on success else negative
-	///	
-
 	void setEnable(bool enable);
 	bool pause() const;
 	bool enabled() const;
 
-	void updateLedValues(const std::vector<ColorRgb>& ledValues);
+	/// LED values as input for the smoothing filter
+	///
+	/// @param ledValues The color-value per led
+	/// @param trace     The stages passed by the source frame, with its capture time
+	///
+	void updateLedValues(const std::vector<ColorRgb>& ledValues, const FrameTrace& trace);
+
+	/// the update timers of all the instances tick in the same phase of one shared clock instead of following their led devices
+	static void setSharedClock(bool enabled);
 
 public slots:
 	///
@@ -99,6 +103,9 @@ private:
 	void setupAdvColor(int64_t deltaTime, float& kOrg, float& kMin, float& kMid, float& kAbove, float& kMax);
 	inline uint8_t computeAdvColor(int limitMin, int limitAverage, int limitMax, float kMin, float kMid, float kAbove, float kMax, int color);
 
+	/// the signed step for every difference between the target and the previous color, index = difference + 255
+	void setupStepTable(bool correction, int64_t deltaTime);
+
 	///
 	/// @brief Add a new smoothing cfg which can be used with selectConfig()
 	/// @param   settlingTime_ms       The buffer time
@@ -117,6 +124,15 @@ private:
 
 	void LinearSmoothingProcessing(bool correction);
 
+	/// alpha-beta filter of every color channel, updated with the new target at its capture time
+	void PredictiveSetup();
+
+	/// the filtered colors extrapolated to the current time, that compensates the latency since the capture
+	void PredictiveProcessing();
+
+	/// once per performance counters period: the delivery jitter of the update timer
+	void reportTimerStats();
+
 	void DebugOutput();
 
 	/// Logger instance
@@ -131,8 +147,28 @@ private:
 	/// The time after which the updated led values have been fully applied (msec)
 	int64_t _settlingTime;
 
-	/// The Qt timer object
-	QTimer* _timer;
+	/// The update timer
+	PreciseTimer* _timer;
+	int64_t _timerStatsToken;
+
+	/// aligns the ticks to the write slots of the led device
+	FramePacer _pacer;
+
+	/// the output converged to a static input: the update timer is stopped until the input changes
+	bool _idle;
+
+	/// the phase alignment of the update timer, follows _sharedClock on the next update
+	bool _sharedClockActive;
+	static std::atomic<bool> _sharedClock;
+
+	/// state of the predictive smoothing: position and velocity [per ms] of every channel
+	std::vector<float> _predictedValues;
+	std::vector<float> _predictedVelocity;
+	int64_t _predictionTime;
+	int64_t _predictionArrival;
+	int64_t _predictionInterval;
+	double _predictionAlpha;
+	double _predictionBeta;
 
 	/// The target led data
 	std::vector<ColorRgb> _targetValues;
@@ -141,6 +177,9 @@ private:
 	std::vector<ColorRgb> _previousValues;
 	std::vector<int64_t>  _previousTimeouts;
 
+	/// built once per update by setupStepTable, the per led loop only looks it up
+	int16_t _stepTable[511];
+
 	/// Flag for dis/enable continuous output to led device regardless there is new data or not
 	bool _continuousOutput;
 
@@ -154,12 +193,15 @@ private:
 
 	int64_t _targetTime;
 
+	/// the trace of the source frame of the target led data, with its capture time
+	FrameTrace _targetTrace;
+
 	int64_t _previousTime;
 
 	/// Flag for pausing
 	bool _pause;
 
-	enum class SmoothingType { Linear = 0, Alternative = 1 };
+	enum class SmoothingType { Linear = 0, Alternative = 1, Predictive = 2 };
 
 	class SmoothingCfg
 	{
@@ -172,6 +214,8 @@ private:
 		int			  _antiFlickeringTreshold;
 		int			  _antiFlickeringStep;
 		int64_t		  _antiFlickeringTimeout;
+		double		  _predictionAlpha;
+		double		  _predictionBeta;
 
 		SmoothingCfg();
 
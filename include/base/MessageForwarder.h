@@ -13,6 +13,7 @@
 #include <QJsonObject>
 #include <QJsonArray>
 #include <QJsonDocument>
+#include <QMutex>
 
 // Utils includes
 #include <utils/ColorRgb.h>
@@ -26,6 +27,7 @@
 // Forward declaration
 class HyperHdrInstance;
 class QTcpSocket;
+class QUdpSocket;
 class FlatBufferConnection;
 class MessageForwarderHelper;
 
@@ -74,11 +76,53 @@ private slots:
 	void forwardFlatbufferMessage(const QString& name, const Image<ColorRgb>& image);
 
 	///
-	/// @brief Forward message to a single json slave
-	/// @param message The JSON message to send
-	/// @param socket The TCP-Socket with the connection to the slave
+	/// @brief Send the colors of the instance to the render nodes of its zone
+	/// @param ledColors The untransformed colors
+	/// @param captureTimestamp The capture time of the source frame, 0 if unknown
+	///
+	void forwardRenderNodeColors(const std::vector<ColorRgb>& ledColors, int64_t captureTimestamp);
+
+private:
+	/// a json slave with its own persistent connection
+	struct JsonTarget
+	{
+		QString		host;
+		quint16		port;
+		QTcpSocket*	socket;
+		/// the messages that wait for the connection, the oldest one is dropped when it is full
+		QList<QByteArray>	queue;
+		/// the send time of the messages that wait for their reply [ms]
+		QList<qint64>		inFlight;
+		QByteArray	receiveBuffer;
+		qint64		sent;
+		qint64		dropped;
+		qint64		lagSum;
+		qint64		lagMax;
+	};
+
+	///
+	/// @brief Forward message to a single json slave, it waits in the queue of the target while the slave connects
+	/// @param target The slave
+	/// @param message The serialized JSON message
+	///
+	void sendJsonMessage(JsonTarget* target, const QByteArray& message);
+
+	///
+	/// @brief Consume the replies of a json slave and measure the lag of the messages
+	///
+	void readJsonReplies(JsonTarget* target);
+
+	void clearJsonTargets();
+
+	///
+	/// @brief Report the forwarding lag of the json slaves to the performance counters
+	///
+	void reportJsonTargets();
+
+	///
+	/// @brief Start or stop the render node stream, the target is "address:port" (usually a multicast group)
 	///
-	void sendJsonMessage(const QJsonObject& message, QTcpSocket* socket);
+	void setRenderNodeTarget(bool enable, const QString& target, int zone);
 
 private:
 	/// Hyperhdr instance
@@ -92,10 +136,20 @@ private:
 
 	// JSON connection for forwarding
 	QStringList   _jsonSlaves;
+	QList<JsonTarget*> _jsonTargets;
+	qint64		  _lastJsonReport;
 
 	/// Proto connection for forwarding
 	QStringList _flatSlaves;
 
+	/// the render node stream: the colors of the zone of this instance, split into datagrams of one reused buffer
+	QUdpSocket*	_renderNodeSocket;
+	QHostAddress	_renderNodeAddress;
+	quint16		_renderNodePort;
+	uint8_t		_renderNodeZone;
+	uint16_t	_renderNodeSequence;
+	std::vector<uint8_t>	_renderNodePacket;
+
 	/// Flag if forwarder is enabled
 	bool _forwarder_enabled = true;
 
@@ -104,26 +158,43 @@ private:
 	MessageForwarderHelper* _messageForwarderHelper;
 };
 
+///
+/// Forwards the images to the flatbuffer slaves on its own thread. Only the newest image waits for the thread,
+/// then every slave sends it when its previous image is answered, so a slow slave skips frames without holding up the others.
+///
 class MessageForwarderHelper : public QObject
 {
 	Q_OBJECT
 
 private:
 	QList<FlatBufferConnection*> _forwardClients;
-	bool _free;
+	QStringList _forwardNames;
+	int _instance;
+	qint64 _lastReport;
+
+	/// latest wins, guarded by the lock
+	QMutex _pendingLock;
+	Image<ColorRgb> _pendingImage;
+	bool _scheduled;
+
+	void reportClients();
 
 public:
-	MessageForwarderHelper();
+	MessageForwarderHelper(int instance);
 
 	~MessageForwarderHelper();
 
+	///
+	/// @brief Replace the image that waits for the thread of the helper, called from the instance
+	///
+	void queueImage(const Image<ColorRgb>& image);
+
 signals:
-	void addClient(const QString& origin, const QString& address, int priority, bool skipReply);
+	void addClient(const QString& origin, const QString& address, int priority, bool skipReply, int maxWidth, int format, int quality);
 	void clearClients();
 
 public slots:
-	bool isFree();
-	void forwardImage(const Image<ColorRgb>& image);
-	void addClientHandler(const QString& origin, const QString& address, int priority, bool skipReply);
+	void forwardImage();
+	void addClientHandler(const QString& origin, const QString& address, int priority, bool skipReply, int maxWidth, int format, int quality);
 	void clearClientsHandler();
 };
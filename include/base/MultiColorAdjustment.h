@@ -55,9 +55,38 @@ public:
 	///
 	void applyAdjustment(std::vector<ColorRgb>& ledColors);
 
+	///
+	/// The adjustments were modified: the lookup tables are baked again before the next frame
+	///
+	void invalidateTables();
+
 	static MultiColorAdjustment* createLedColorsAdjustment(quint8 instance, int ledCnt, const QJsonObject& colorConfig);
 
 private:
+	/// Number of the nodes of the saturation/luminance grid on every axis
+	static constexpr int GRID_NODES = 33;
+
+	///
+	/// One adjustment baked into lookup tables. The float HSL round trip of the classic config goes to a 3D grid
+	/// with trilinear interpolation. The rest of the chain is replaced by the exact tables per channel when it's
+	/// separable (every output channel depends only on the same input channel), otherwise it's computed directly.
+	///
+	struct AdjustmentTable
+	{
+		ColorAdjustment* adjustment = nullptr;
+		bool satLumGrid = false;
+		bool channels = false;
+		uint8_t channel[3][256];
+		std::vector<uint8_t> grid;
+	};
+
+	/// The original adjustment chain for one color, satLumDone: the saturation/luminance step is already applied
+	static void adjustColor(ColorAdjustment* adjustment, ColorRgb& color, bool satLumDone);
+	static uint8_t gridNode(int index);
+
+	void bakeTables();
+	void applyGrid(const AdjustmentTable& table, ColorRgb& color) const;
+
 	/// List with transform ids
 	QStringList _adjustmentIds;
 
@@ -67,6 +96,14 @@ private:
 	/// List with a pointer to the ColorAdjustment for each individual led
 	std::vector<ColorAdjustment*> _ledAdjustments;
 
+	/// The baked tables of _adjustment and a pointer to the table for each individual led
+	std::vector<AdjustmentTable> _tables;
+	std::vector<AdjustmentTable*> _ledTables;
+	bool _tablesValid;
+
+	uint8_t _gridCell[256];
+	uint16_t _gridFraction[256];
+
 	// logger instance
 	Logger* _log;
 };
@@ -0,0 +1,94 @@
+#pragma once
+
+// STL includes
+#include <vector>
+
+// Qt includes
+#include <QObject>
+#include <QJsonDocument>
+
+// hyperhdr includes
+#include <utils/ColorRgb.h>
+#include <utils/FrameTrace.h>
+#include <utils/settings.h>
+
+class PreciseTimer;
+class Logger;
+class HyperHdrInstance;
+
+///
+/// Holds the led frames after the smoothing until their presentation time: the capture time of the source frame
+/// plus the configured A/V sync delay, so the leds don't run ahead of a TV that adds its own processing time.
+/// The intermediate frames of the smoothing share the capture time of their target: they keep the offset of
+/// that target and follow each other with their own spacing. The frames are copied into a small preallocated
+/// ring and released by a PreciseTimer that wakes up for the next due frame only. With no delay the frames
+/// are not touched at all.
+///
+class PresentationScheduler : public QObject
+{
+	Q_OBJECT
+
+public:
+	/// @param config    The configuration document smoothing
+	/// @param hyperhdr  The HyperHDR parent instance
+	///
+	PresentationScheduler(const QJsonDocument& config, HyperHdrInstance* hyperhdr);
+	~PresentationScheduler();
+
+	/// the A/V sync delay [ms], 0 when the frames are written right away
+	int delay() const;
+
+	///
+	/// @brief Queue the frame for its presentation time
+	/// @return false when there is no delay: the caller writes the frame itself
+	///
+	bool schedule(const std::vector<ColorRgb>& ledValues, const FrameTrace& trace);
+
+	/// drop the waiting frames, ex. when the led device is disabled
+	void clear();
+
+public slots:
+	///
+	/// @brief Handle settings update from HyperHDR Settingsmanager emit or this constructor
+	/// @param type   settingyType from enum
+	/// @param config configuration object
+	///
+	void handleSettingsUpdate(settings::type type, const QJsonDocument& config);
+
+private slots:
+	void release();
+
+private:
+	void setDelay(int delay);
+
+	/// wake up for the oldest waiting frame
+	void arm(qint64 now);
+
+	struct Slot
+	{
+		std::vector<ColorRgb>	colors;
+		FrameTrace				trace;
+		/// the presentation time [ns] of PreciseTimer::now
+		qint64					showAt = 0;
+	};
+
+	/// 0.5 s of frames at 120 Hz
+	static constexpr size_t RING_SIZE = 64;
+
+	HyperHdrInstance*	_hyperhdr;
+	Logger*				_log;
+	PreciseTimer*		_timer;
+
+	int					_delay;
+
+	std::vector<Slot>	_ring;
+	size_t				_head;
+	size_t				_count;
+
+	/// the capture time of the last source frame and the time it already spent in the pipeline [ms]
+	int64_t				_captureTimestamp;
+	int64_t				_captureAge;
+
+	/// frames released before their time because the ring was full
+	qint64				_overflow;
+};
@@ -3,6 +3,8 @@
 // STL includes
 #include <vector>
 #include <cstdint>
+#include <queue>
+#include <functional>
 
 // QT includes
 #include <QMap>
@@ -15,6 +17,7 @@
 #include <utils/ColorRgb.h>
 #include <utils/Image.h>
 #include <utils/Components.h>
+#include <utils/MemoryAccounting.h>
 
 // global defines
 #define SMOOTHING_MODE_DEFAULT 0
@@ -43,7 +46,7 @@ public:
 		int64_t timeoutTime_ms;
 		/// The colors for each led of the channel
 		std::vector<ColorRgb> ledColors;
-		/// The raw Image (size should be preprocessed!)
+		/// The raw Image (size should be preprocessed!), only a small preview while the input is hidden
 		Image<ColorRgb> image;
 		/// The component
 		hyperhdr::Components componentId;
@@ -75,7 +78,7 @@ public:
 	~PriorityMuxer() override;
 
 	///
-	/// @brief Start/Stop the PriorityMuxer update timer; On disabled no priority and timeout updates will be performend
+	/// @brief Start/Stop the PriorityMuxer timeout timer; On disabled no timeouts will be performed
 	/// @param  enable  The new state
 	///
 	void setEnable(bool enable);
@@ -239,11 +242,28 @@ private slots:
 
 	///
 	/// Updates the current time. Channels with a configured time out will be checked and cleared if
-	/// required.
+	/// required. Then the visible priority is evaluated again and the timer is set to the next timeout.
 	///
 	void setCurrentTime();
 
 private:
+	///
+	/// @brief Queue the timeout of an input, the timer is set earlier if it's the next one
+	/// @param priority The priority of the input
+	/// @param previous The previous timeout of the input
+	///
+	void queueTimeout(int priority, int64_t previous);
+
+	///
+	/// @brief Account the images and the colors held by the inputs, a few inputs are summed on every update
+	///
+	void updateMemory();
+
+	///
+	/// @brief Set the timer to the next timeout or to the next second of a running timed color or effect
+	///
+	void scheduleTimeout(int64_t now, bool timedRunner);
+
 	///
 	/// @brief Get the component of the given priority
 	/// @return The component
@@ -274,7 +294,19 @@ private:
 	// Reflect the state of auto select
 	bool _sourceAutoSelectEnabled;
 
-	// Timer to update Muxer times independent
+	/// The timeouts (absolute time, priority) ordered by the time. An entry is only removed by the timer:
+	/// an input cleared meanwhile or with a later timeout (queued again then) is skipped
+	std::priority_queue<std::pair<int64_t, int>, std::vector<std::pair<int64_t, int>>, std::greater<std::pair<int64_t, int>>> _timeouts;
+
+	/// An empty image for the inputs of colors, shared instead of allocated on every update
+	Image<ColorRgb> _emptyImage;
+
+	/// the images may be shared with their sender (implicit sharing), they are counted as held by the muxer
+	MemoryAccounting::Tag _memory;
+
+	bool _enabled;
+
+	// Single shot timer of the next timeout
 	QTimer* _updateTimer;
 
 	QTimer* _timer;
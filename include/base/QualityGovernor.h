@@ -0,0 +1,82 @@
+#pragma once
+
+#include <QObject>
+#include <QTimer>
+
+#include <atomic>
+#include <memory>
+
+#include <utils/Logger.h>
+#include <utils/SystemPerformanceCounters.h>
+
+///
+/// @brief Lowers the quality of the processing step by step when the system is overloaded: the CPU
+/// usage, the CPU temperature or the share of the frames that miss the latency budget stays above its
+/// limit. The steps are cumulative and they are taken back in the reverse order when the pressure is gone:
+///   1. sparse processing of the LED areas
+///   2. every second frame is skipped and the frames are decoded in a quarter of their size (qframe)
+///   3. the MJPEG frames are decoded in a smaller DCT scale
+///   4. the image stream of the web clients is refreshed at most 5 times per second
+///
+/// The level is a global atomic: the grabbers, the processors and the API read it when they need it,
+/// so the settings of the user are never overwritten. Every transition is logged and reported to the
+/// performance counters.
+///
+class QualityGovernor : public QObject
+{
+	Q_OBJECT
+
+public:
+	enum Level { FULL_QUALITY = 0, SPARSE_PROCESSING, FRAME_DECIMATION, MJPEG_SCALE, IMAGE_STREAM_RATE, MAX_LEVEL = IMAGE_STREAM_RATE };
+
+	static QualityGovernor* getInstance();
+
+	/// the current level, 0 when the governor is disabled
+	static int level()
+	{
+		return _level;
+	}
+
+	static bool isActive(Level step)
+	{
+		return _level >= static_cast<int>(step);
+	}
+
+public slots:
+	///
+	/// @brief Enable the governor and set its limits, the level goes back to full quality when it is disabled
+	/// @param enabled            Watch the system
+	/// @param cpuLimit           CPU usage of the system [%]
+	/// @param temperatureLimit   CPU temperature [°C]
+	///
+	void configure(bool enabled, int cpuLimit, int temperatureLimit);
+
+signals:
+	void levelChanged(int level);
+
+private slots:
+	void poll();
+
+private:
+	QualityGovernor();
+
+	void setLevel(int level, const QString& reason);
+	void report();
+
+	static std::unique_ptr<QualityGovernor> _instance;
+	static std::atomic<int> _level;
+
+	Logger*		_log;
+	QTimer		_timer;
+	SystemPerformanceCounters _system;
+
+	bool		_enabled;
+	int			_cpuLimit;
+	int			_temperatureLimit;
+
+	/// consecutive polls with and without pressure, a step needs a few of them in a row
+	int			_pressurePolls;
+	int			_reliefPolls;
+	qint64		_lastReportToken;
+	QString		_lastReason;
+};
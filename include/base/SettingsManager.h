@@ -56,6 +56,14 @@ signals:
 	void settingsChanged(settings::type type, const QJsonDocument& data);
 
 private:
+	/// the hash of the schema, a new schema validates all the sections again
+	static QString schemaHash();
+
+	static QString sectionHash(const QJsonValue& section);
+
+	/// store the hashes of the validated sections for the next start
+	void saveValidation();
+
 	/// Logger instance
 	Logger* _log;
 
@@ -1,5 +1,7 @@
 #pragma once
 
+#include <atomic>
+
 #include <QString>
 #include <QSemaphore>
 #include <QJsonObject>
@@ -7,12 +9,21 @@
 #include <QColor>
 #include <effectengine/AnimationBaseMusic.h>
 #include <utils/settings.h>
+#include <utils/OnsetDetector.h>
 
 #define SOUNDCAP_N_WAVE      1024
 #define SOUNDCAP_LOG2_N_WAVE 10
+#define SOUNDCAP_SAMPLE_RATE 22050
 
 #define SOUNDCAP_RESULT_RES 8
 
+// the onset detection: a transform of 512 samples every 256 samples (11.6ms)
+#define SOUNDCAP_ONSET_WINDOW 512
+#define SOUNDCAP_ONSET_HOP    256
+
+// the published analyses, a reader copies the newest one while the older are written again
+#define SOUNDCAP_SNAPSHOTS 4
+
 class SoundCaptureResult
 {
 	friend class  SoundCapture;
@@ -36,6 +47,12 @@ class SoundCaptureResult
 
 	MovingTarget mtWorking, mtInternal;
 
+	/// the onsets found since the start, the time and the strength of the last one
+	uint32_t _beatCount;
+	int64_t  _beatTime;
+	float    _beatStrength;
+	/// the last onset was found in the samples of this analysis
+	bool     _newBeat;
 
 public:
 	SoundCaptureResult();
@@ -62,6 +79,15 @@ public:
 
 	bool GetStats(uint32_t& scaledAverage, uint32_t& currentMax, QColor& averageColor, QColor* fastColor = NULL, QColor* slowColor = NULL);
 
+	///
+	/// @brief The beat events: an onset newer than lastBeat
+	/// @param lastBeat the count of the last onset seen by the effect, updated
+	/// @param time the time of the onset [ms, InternalClock]
+	/// @param strength 0..1
+	/// @return true if there is a new onset
+	///
+	bool GetBeat(uint32_t& lastBeat, int64_t& time, float& strength) const;
+
 private:
 	bool hasMiddleAverage(int middle);
 
@@ -89,13 +115,21 @@ protected:
 	QString          _selectedDevice;
 	static bool		 _isRunning;
 	QList<uint32_t>  _instances;
-	static uint32_t  _resultIndex;
+	/// the snapshot last published, 0 before the first one
+	static std::atomic<uint32_t>	_resultIndex;
+	/// the working copy of the capture thread
 	static SoundCaptureResult   _resultFFT;
 
+	/// reported by the backends that measure them: the jitter of the capture periods [us] and the overruns
+	static std::atomic<qint64>		_periodJitter;
+	static std::atomic<uint32_t>	_overruns;
+
 public:
 	static SoundCapture* getInstance();
 
-	SoundCaptureResult* hasResult(uint32_t& lastIndex);
+	/// copies a new analysis to the effect, the result belongs to the effect
+	/// @return NULL if nothing new was published since lastIndex
+	SoundCaptureResult* hasResult(AnimationBaseMusic* effect, uint32_t& lastIndex);
 	SoundCaptureResult* hasResult(AnimationBaseMusic* effect, uint32_t& lastIndex, bool* newAverage, bool* newSlow, bool* newFast, int* isMulti);
 	void				ForcedClose();
 
@@ -119,13 +153,19 @@ private:
 	static bool			_noSoundWarning;
 	static bool			_soundDetectedInfo;
 
+	/// guards the capture instances, the results are published without it
 	static QSemaphore   _semaphore;
 
+	static SoundCaptureResult	_snapshots[SOUNDCAP_SNAPSHOTS];
 
-	// FFT
-	static int16_t  _imgBuffer[SOUNDCAP_N_WAVE * 2];
-	static int16_t  _lutSin[SOUNDCAP_N_WAVE - SOUNDCAP_N_WAVE / 4];
+	/// called by the capture thread
+	static void publishResult();
+	static bool readResult(AnimationBaseMusic* effect, uint32_t& lastIndex);
 
-	static inline int16_t  FIX_MPY(int16_t  a, int16_t  b);
-	static int32_t fix_fft(int16_t fr[], int16_t fi[], int16_t exp, bool inverse);
+
+	// FFT
+	static float	_spectrum[SOUNDCAP_N_WAVE / 2];
+	/// the duration of the last transform [us]
+	static std::atomic<qint64>	_analysisTime;
+	static OnsetDetector		_onsetDetector;
 };
@@ -6,6 +6,8 @@
 #include <QString>
 #include <QStringList>
 #include <QMultiMap>
+#include <QMap>
+#include <QRectF>
 
 #include <utils/Logger.h>
 #include <utils/Components.h>
@@ -43,6 +45,8 @@ public slots:
 
 private slots:
 	void handleSourceRequest(hyperhdr::Components component, int hyperHdrInd, bool listen);
+	void handleRegionRequest(int hyperHdrInd, const QRectF& unusedArea);
+	void handleLightSleep(bool sleep);
 
 signals:
 	///
@@ -63,6 +67,8 @@ public slots:
 protected:
 	virtual QString getGrabberInfo();
 
+	void updateUnusedArea();
+
 	QString		_grabberName;
 
 	Logger*		_log;
@@ -70,4 +76,10 @@ protected:
 	bool		_configLoaded;
 
 	Grabber*	_grabber;
+
+	/// Unused part of the frame reported by each instance
+	QMap<int, QRectF> _unusedAreas;
+
+	/// Stopped by the light sleep of the system
+	bool		_lightSleep;
 };
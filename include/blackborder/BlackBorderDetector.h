@@ -2,7 +2,7 @@
 #pragma once
 
 // Utils includes
-#include <utils/Image.h>
+#include <utils/ImageView.h>
 
 namespace hyperhdr
 {
@@ -56,21 +56,25 @@ namespace hyperhdr
 
 		///
 		/// default detection mode (3lines 4side detection)
-		BlackBorder process(const Image<ColorRgb>& image) const;
+		BlackBorder process(const ImageView<ColorRgb>& image) const;
 
 		///
 		/// classic detection mode (topleft single line mode)
-		BlackBorder process_classic(const Image<ColorRgb>& image) const;
+		BlackBorder process_classic(const ImageView<ColorRgb>& image) const;
 
 
 		///
 		/// osd detection mode (find x then y at detected x to avoid changes by osd overlays)
-		BlackBorder process_osd(const Image<ColorRgb>& image) const;
+		BlackBorder process_osd(const ImageView<ColorRgb>& image) const;
 
 
 		///
 		/// letterbox detection mode (5lines top-bottom only detection)
-		BlackBorder process_letterbox(const Image<ColorRgb>& image) const;
+		BlackBorder process_letterbox(const ImageView<ColorRgb>& image) const;
+
+		///
+		/// histogram detection mode (non-black pixel counts of every row and column of a decimated plane)
+		BlackBorder process_histogram(const ImageView<ColorRgb>& image) const;
 
 
 
@@ -2,6 +2,9 @@
 
 // QT includes
 #include <QJsonObject>
+#include <QMutex>
+
+#include <atomic>
 
 // util
 #include <utils/Logger.h>
@@ -12,6 +15,7 @@
 #include "BlackBorderDetector.h"
 
 class HyperHdrInstance;
+class FrameContext;
 
 namespace hyperhdr
 {
@@ -55,11 +59,17 @@ namespace hyperhdr
 		/// updates the current border accordingly. If the current border is updated the method call
 		/// will return true else false
 		///
-		/// @param image The image to process
+		/// @param image   The image to process
+		/// @param context The shared analysis of the frame: the instances with the same detector settings scan it once
 		///
 		/// @return True if a different border was detected than the current else false
 		///
-		bool process(const Image<ColorRgb>& image);
+		bool process(const ImageView<ColorRgb>& image, const FrameContext* context = nullptr);
+
+		///
+		/// The part of the frames that is analyzed now: 1 after a change, down to 1 / ANALYSIS_MAX_INTERVAL for a stable border
+		///
+		double getAnalysisRate() const;
 
 	private slots:
 		///
@@ -87,8 +97,12 @@ namespace hyperhdr
 		///
 		bool updateBorder(const BlackBorder& newDetectedBorder);
 
+		int sampleLuma(const ImageView<ColorRgb>& image) const;
+
+		void updateAnalysisStats(bool analyzed);
+
 		/// flag for black-border detector usage
-		bool _enabled;
+		std::atomic<bool> _enabled;
 
 		/// The number of unknown-borders detected before it becomes the current border
 		unsigned _unknownSwitchCnt;
@@ -125,5 +139,23 @@ namespace hyperhdr
 		/// Reflect the last component state request from user (comp change)
 		bool _userEnabled;
 
+		/// Adaptive rate: the interval doubles after ANALYSIS_STABLE_RUNS analyses that confirm the current border
+		static constexpr int ANALYSIS_MAX_INTERVAL = 8;
+		static constexpr int ANALYSIS_STABLE_RUNS = 10;
+		static constexpr int ANALYSIS_LUMA_JUMP = 24;
+
+		std::atomic<int> _analysisInterval;
+		int _framesToSkip;
+		int _stableAnalyses;
+		int _previousLuma;
+
+		/// process() runs on the image processing thread, the settings come from the instance thread
+		QMutex _lock;
+
+		/// Per minute statistics of the analyzed frames
+		int64_t _statsBegin;
+		int _statsFrames;
+		int _statsAnalyses;
+
 	};
 } // end namespace hyperhdr
@@ -69,6 +69,7 @@ signals:
 
 private:
 	void gotMessage(QList<DiscoveryRecord>& target, DiscoveryRecord message);
+	void publishHosts();
 	void cleanUp(QList<DiscoveryRecord>& target);
 
 	// contains all current active service sessions
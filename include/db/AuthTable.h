@@ -118,6 +118,19 @@ public:
 	///
 	const QVector<QVariantMap> getTokenList();
 
+	///
+	/// @brief Get the 'token' hash, 'id', 'comment' and 'last_use' of all the token records, the user records are skipped
+	/// @return            A vector of all lists
+	///
+	const QVector<QVariantMap> getTokenRecords();
+
+	///
+	/// @brief      Write the 'last_use' of a token record
+	/// @param[in]  tokenHash  The token hash
+	/// @param[in]  lastUse    The time of the last use (ISO date)
+	///
+	void updateTokenUsed(const QByteArray& tokenHash, const QString& lastUse);
+
 	///
 	/// @brief      Test if id exists
 	/// @param[in]  id      The id
@@ -134,6 +134,19 @@ public:
 
 	bool migrateColumn(QString newColumn, QString oldColumn);
 
+	///
+	/// @brief Group the following writes of this thread into one transaction until the matching commitTransaction().
+	///        Nested calls (ex. updateRecord inside a batch) join the outer transaction
+	/// @return             True on success else false
+	///
+	bool startTransaction() const;
+
+	///
+	/// @brief End the transaction of startTransaction(), the data is committed by the outermost call
+	/// @return             True on success else false
+	///
+	bool commitTransaction() const;
+
 public slots:
 	const QJsonObject getBackup();
 	QString restoreBackup(const QJsonObject& backupData);
@@ -152,6 +165,9 @@ private:
 	/// addBindValue to query given by QVariantList
 	void doAddBindValue(QSqlQuery& query, const QVariantList& variants) const;
 
+	/// the prepared statement of the SQL for the connection of this thread, it's prepared once and reused
+	QSqlQuery& getQuery(const QSqlDatabase& idb, const QString& sql) const;
+
 	static QString _rootPath;
 	static QThreadStorage<QSqlDatabase> _databasePool;
 };
@@ -2,6 +2,8 @@
 
 #include <db/DBManager.h>
 
+#include <QMutex>
+
 ///
 /// @brief settings table db interface
 ///
@@ -52,6 +54,18 @@ public:
 
 	bool isSettingGlobal(const QString& type) const;
 
+	///
+	/// @brief Drop the cached settings after the table was rewritten directly (ex. backup restore)
+	///
+	static void clearCache();
+
 private:
+	/// the key of the cached record: the type for the global settings, the type and the instance otherwise
+	QString cacheKey(const QString& type) const;
+
 	const quint8 _hyperhdr_inst;
+
+	/// write-through cache of the 'config' column shared by all the tables, the reads don't touch the DB
+	static QMutex _cacheLock;
+	static QMap<QString, QString> _cache;
 };
@@ -17,6 +17,14 @@ public:
 	virtual bool Play(QPainter* painter) = 0;
 	virtual void Init(QImage& hyperImage, int hyperLatchTime) = 0;
 	virtual bool hasLedData(QVector<ColorRgb>& buffer);
+	/// the effect writes the colors of the leds itself: render() replaces Play() and hasLedData()
+	virtual bool hasLedRender();
+	/// writes the count colors of the leds directly, the time is the InternalClock [ms]
+	/// @return false to show the (empty) image instead, like hasLedData()
+	virtual bool render(ColorRgb* leds, int count, qint64 time);
+	/// the images of the effect repeat after this number of frames, so they are recorded once and
+	/// played back by EffectFrameCache. 0 for an effect that is not periodic or deterministic
+	virtual int  getPeriodFrames();
 	bool		 isStop();
 	void		 SetSleepTime(int sleepTime);
 	int			 GetSleepTime();
@@ -1,7 +1,11 @@
 #pragma once
 
+#include <memory>
+
 #include <effectengine/AnimationBase.h>
 
+class SoundCaptureResult;
+
 struct MovingTarget
 {
 	QColor	_averageColor;
@@ -30,15 +34,19 @@ class AnimationBaseMusic : public AnimationBase
 
 public:
 	AnimationBaseMusic(QString name);
+	~AnimationBaseMusic();
 	static QJsonObject GetArgs();
 
 	bool isSoundEffect() override;
 
-	void store(MovingTarget* source);
-	void restore(MovingTarget* target);
+	/// the analyses published by SoundCapture that the effect has not read
+	uint32_t getMissedResults() const;
 
 private:
-	MovingTarget _myTarget;
+	friend class SoundCapture;
 
+	/// the copy of the last analysis read by the effect
+	std::unique_ptr<SoundCaptureResult> _soundResult;
+	uint32_t _missedResults;
 };
 
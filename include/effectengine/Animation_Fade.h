@@ -14,7 +14,8 @@ public:
 		int hyperLatchTime) override;
 
 	bool Play(QPainter* painter) override;
-	bool hasLedData(QVector<ColorRgb>& buffer) override;
+	bool hasLedRender() override;
+	bool render(ColorRgb* leds, int count, qint64 time) override;
 
 private:
 
@@ -1,6 +1,7 @@
 #pragma once
 
 #include <effectengine/AnimationBase.h>
+#include <effectengine/EffectMath.h>
 class Animation_MoodBlobs : public AnimationBase
 {
 	Q_OBJECT
@@ -16,6 +17,8 @@ public:
 	bool hasLedData(QVector<ColorRgb>& buffer) override;
 
 private:
+	void buildColorData(double baseHue);
+
 	int    hyperledCount;
 	bool   fullColorWheelAvailable;
 	double baseColorChangeIncreaseValue;
@@ -30,6 +33,9 @@ private:
 	Point3dhsv baseHsv;
 
 	QVector<Point3d> colorData;
+	std::vector<double> hueWave;
+	std::vector<double> amplitudeWave;
+	EffectMath::HueTable hueTable;
 
 protected:
 	double rotationTime;
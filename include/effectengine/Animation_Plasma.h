@@ -23,6 +23,7 @@ public:
 		int hyperLatchTime) override;
 
 	bool Play(QPainter* painter) override;
+	int  getPeriodFrames() override;
 
 	static EffectDefinition getDefinition();
 
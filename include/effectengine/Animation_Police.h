@@ -15,7 +15,8 @@ public:
 		int hyperLatchTime) override;
 
 	bool Play(QPainter* painter) override;
-	bool hasLedData(QVector<ColorRgb>& buffer) override;
+	bool hasLedRender() override;
+	bool render(ColorRgb* leds, int count, qint64 time) override;
 
 protected:
 
@@ -25,5 +26,7 @@ protected:
 	bool    reverse;
 	int		colorsCount;
 	int		increment;
+	/// the pattern of the leds, shown rotated by the shift
 	QVector<ColorRgb> ledData;
+	int		shift;
 };
@@ -25,6 +25,7 @@ public:
 		int hyperLatchTime) override;
 
 	bool Play(QPainter* painter) override;
+	int  getPeriodFrames() override;
 
 private:
 
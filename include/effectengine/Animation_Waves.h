@@ -14,6 +14,7 @@ public:
 		int hyperLatchTime) override;
 
 	bool Play(QPainter* painter) override;
+	int  getPeriodFrames() override;
 
 private:
 
@@ -1,7 +1,7 @@
 #pragma once
 
 // Qt includes
-#include <QThread>
+#include <QObject>
 #include <QJsonObject>
 #include <QSize>
 #include <QImage>
@@ -12,11 +12,12 @@
 
 #include <atomic>
 #include <effectengine/AnimationBase.h>
+#include <effectengine/EffectFrameCache.h>
 
 class HyperHdrInstance;
 class Logger;
 
-class Effect : public QThread
+class Effect : public QObject
 {
 	Q_OBJECT
 
@@ -34,7 +35,14 @@ public:
 
 	~Effect() override;
 
-	void run() override;
+	/// the effect is stepped by the EffectScheduler
+	void start();
+	/// blocks until the effect has finished
+	void wait();
+
+	/// one frame of the effect, the first call prepares it
+	/// @return the time of the next step (InternalClock [ms]) or -1 when the effect has finished
+	qint64 step();
 
 	int  getPriority() const;
 	void requestInterruption();
@@ -51,9 +59,18 @@ public:
 signals:
 	void setInput(int priority, const std::vector<ColorRgb>& ledColors, int timeout_ms, bool clearEffect);
 	void setInputImage(int priority, const Image<ColorRgb>& image, int timeout_ms, bool clearEffect);
+	void finished();
 
 private:
+	bool begin();
+	void end();
+	bool isVisible(int visiblePriority) const;
+	/// the fps and the render time [us] are sent to PerformanceCounters once a minute
+	void reportStats();
 	bool ImageShow();
+	void recordFrame(const Image<ColorRgb>& image);
+	/// a free buffer of the size of the led grid for hasOwnImage()
+	Image<ColorRgb>& getOwnImage();
 	bool LedShow();
 
 	HyperHdrInstance*	_hyperhdr;
@@ -75,6 +92,32 @@ private:
 	QPainter*			_painter;
 	AnimationBase*		_effect;
 	QVector<ColorRgb>	_ledBuffer;
+	/// the colors sent to the instance, written by render() or copied from hasLedData()
+	std::vector<ColorRgb>	_ledColors;
 	uint32_t			_soundHandle;
 	std::atomic<int>	_ledCount;
+	bool				_started;
+	bool				_playing;
+	/// the deadline of the next frame (InternalClock [ms]), -1 while the effect is parked
+	qint64				_nextTime;
+	const int			_reportId;
+
+	/// the frames of a periodic effect: recorded on the first period, unless the cache has them already
+	QString					_cacheKey;
+	EffectFrameCache::Frames	_recording;
+	EffectFrameCache::Frames	_cachedFrames;
+	int						_cachedIndex;
+
+	Image<ColorRgb>			_ownImages[2];
+	int						_ownImageIndex;
+
+	struct EffectStats
+	{
+		qint64	token = -1;
+		qint64	begin = 0;
+		qint64	frames = 0;
+		qint64	renderSum = 0;
+		qint64	renderMax = 0;
+		qint64	late = 0;
+	} _stats;
 };
@@ -5,6 +5,8 @@
 #include <effectengine/EffectDefinition.h>
 #include <utils/settings.h>
 
+#include <mutex>
+
 class EffectDBHandler : public QObject
 {
 	Q_OBJECT
@@ -15,7 +17,7 @@ private:
 
 public:
 	static EffectDBHandler* getInstance();
-	std::list<EffectDefinition> getEffects() const;
+	std::list<EffectDefinition> getEffects();
 
 public slots:
 	void handleSettingsUpdate(settings::type type, const QJsonDocument& config);
@@ -31,6 +33,8 @@ private:
 	Logger* _log;
 	const QString	_rootPath;
 
-	// available effects
+	// available effects, collected on the first request (the instances ask for them from their own threads)
+	std::mutex					_effectsLock;
+	bool						_effectsLoaded;
 	std::list<EffectDefinition> _availableEffects;
 };
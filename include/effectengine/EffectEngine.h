@@ -60,7 +60,7 @@ public slots:
 	/// Clear all effects
 	void allChannelsCleared();
 
-	std::list<EffectDefinition> getEffects() const;
+	std::list<EffectDefinition> getEffects();
 
 	std::list<ActiveEffectDefinition> getActiveEffects() const;
 
@@ -77,6 +77,9 @@ private slots:
 	void handleUpdatedEffectList();
 
 private:
+	/// Collect the effect definitions and register their smoothing configs, on the first use
+	void loadEffects();
+
 	/// Run the specified effect on the given priority channel and optionally specify a timeout
 	int runEffectScript(
 		const QString& name
@@ -93,6 +96,8 @@ private:
 
 	std::list<EffectDefinition> _availableEffects;
 
+	bool _effectsLoaded;
+
 	std::list<Effect*> _activeEffects;
 
 	std::list<ActiveEffectDefinition> _cachedActiveEffects;
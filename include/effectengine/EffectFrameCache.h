@@ -0,0 +1,50 @@
+#pragma once
+
+#include <QByteArray>
+#include <QJsonObject>
+#include <QList>
+#include <QMap>
+#include <QMutex>
+#include <QSize>
+#include <QString>
+
+///
+/// The images of one period of the periodic effects (AnimationBase::getPeriodFrames), shared by all the
+/// instances. The first run of an effect records its frames, then every run with the same name,
+/// arguments and image size plays them back instead of painting them again.
+///
+class EffectFrameCache
+{
+public:
+	struct Frames
+	{
+		QSize		size;
+		int			count = 0;
+		/// RGB888 images one after another
+		QByteArray	data;
+
+		bool isValid() const { return count > 0; }
+		const uint8_t* frame(int index) const { return reinterpret_cast<const uint8_t*>(data.constData()) + static_cast<size_t>(index) * size.width() * size.height() * 3; }
+	};
+
+	/// the memory of all the recordings, the least recently used are dropped above it
+	static const int MAX_CACHE_SIZE = 16 * 1024 * 1024;
+
+	static EffectFrameCache* getInstance();
+
+	static QString makeKey(const QString& name, const QJsonObject& args, const QSize& size);
+
+	/// @return the frames of the key or invalid Frames
+	Frames find(const QString& key);
+
+	void insert(const QString& key, const Frames& frames);
+
+private:
+	EffectFrameCache();
+
+	QMutex					_mutex;
+	QMap<QString, Frames>	_frames;
+	/// the most recently used at the end
+	QList<QString>			_usage;
+	int						_size;
+};
@@ -0,0 +1,74 @@
+#pragma once
+
+#include <cstdint>
+#include <cmath>
+#include <vector>
+
+#include <utils/ColorRgb.h>
+#include <utils/ColorSys.h>
+
+/**
+ * Batched math of the effects that compute a value for every led or pixel of a frame.
+ *
+ * sinSeries replaces one std::sin per element: the angles of an arithmetic series are a rotation of
+ * the first one, so every element costs four multiplications. The error grows with the index by about
+ * one ulp per step (below 1e-12 for 10000 elements), far below the 8 bit resolution of the colors.
+ *
+ * HueTable replaces one ColorSys::hsv2rgb (a QColor conversion) per element with the same colors
+ * computed once for the 360 hues of a saturation and value.
+ */
+namespace EffectMath
+{
+	/// out[i] = sin(phase + i * step) for i in [0, count)
+	inline void sinSeries(double phase, double step, int count, double* out)
+	{
+		const double stepSin = std::sin(step);
+		const double stepCos = std::cos(step);
+		double s = std::sin(phase);
+		double c = std::cos(phase);
+
+		for (int i = 0; i < count; i++)
+		{
+			out[i] = s;
+
+			const double next = s * stepCos + c * stepSin;
+			c = c * stepCos - s * stepSin;
+			s = next;
+		}
+	}
+
+	class HueTable
+	{
+	public:
+		HueTable() :
+			_saturation(0),
+			_value(0)
+		{
+		}
+
+		/// the colors of the hues 0..359, unchanged for the same saturation and value
+		void build(uint8_t saturation, uint8_t value)
+		{
+			if (!_colors.empty() && _saturation == saturation && _value == value)
+				return;
+
+			_saturation = saturation;
+			_value = value;
+			_colors.resize(360);
+
+			for (int hue = 0; hue < 360; hue++)
+				ColorSys::hsv2rgb(hue, saturation, value, _colors[hue].red, _colors[hue].green, _colors[hue].blue);
+		}
+
+		/// the hue must be in [0, 360)
+		const ColorRgb& operator[](int hue) const
+		{
+			return _colors[hue];
+		}
+
+	private:
+		uint8_t					_saturation;
+		uint8_t					_value;
+		std::vector<ColorRgb>	_colors;
+	};
+}
@@ -0,0 +1,53 @@
+#pragma once
+
+#include <list>
+
+#include <QMutex>
+#include <QWaitCondition>
+#include <QVector>
+
+class Effect;
+class EffectWorker;
+
+///
+/// The effects of all the instances are stepped by a small shared pool of threads instead of a thread
+/// per effect. Every effect tells the deadline of its next step, the idle workers sleep until the
+/// earliest one. An effect is stepped by one worker at a time, so its state needs no locking.
+///
+class EffectScheduler
+{
+public:
+	static EffectScheduler* getInstance();
+
+	/// the first step of the effect is run as soon as possible
+	void add(Effect* effect);
+
+	/// the next step of the effect is run now, ex. to let an interrupted effect finish at once
+	void wake(Effect* effect);
+
+	/// blocks until the last step of the effect has finished
+	void waitFor(Effect* effect);
+
+private:
+	friend class EffectWorker;
+
+	struct Entry
+	{
+		Effect*	effect;
+		/// InternalClock [ms]
+		qint64	deadline;
+		bool	busy;
+		bool	woken;
+	};
+
+	EffectScheduler();
+	~EffectScheduler();
+
+	void work();
+
+	QMutex					_mutex;
+	QWaitCondition			_condition;
+	std::list<Entry>		_entries;
+	QVector<EffectWorker*>	_workers;
+	bool					_quit;
+};
@@ -8,13 +8,18 @@
 #include <QLocalSocket>
 #include <QTimer>
 #include <QMap>
+#include <QSharedMemory>
 
 #include <utils/Image.h>
 #include <utils/ColorRgb.h>
 #include <utils/Logger.h>
+#include <utils/LatencyHistogram.h>
 
 #include <flatbuffers/flatbuffers.h>
 
+#include <memory>
+#include <vector>
+
 namespace hyperhdrnet
 {
 	struct Reply;
@@ -31,6 +36,20 @@ class FlatBufferConnection : public QObject
 	Q_OBJECT
 
 public:
+	/// the encoding of the image requests, the LZ4 and JPEG images need a receiver that knows those image types
+	enum class ImageFormat { RAW = 0, LZ4 = 1, JPEG = 2 };
+
+	/// the image counters since the previous call, the lag is the time from setImage to the reply [ms]
+	struct ForwardStats
+	{
+		qint64	sent = 0;
+		qint64	dropped = 0;
+		qint64	rejected = 0;
+		double	lagAverage = 0;
+		qint64	lagMax = 0;
+		LatencyHistogram lag;
+	};
+
 	///
 	/// @brief Constructor
 	/// @param address The address of the Hyperhdr server (for example "192.168.0.32:19444)
@@ -78,6 +97,19 @@ public:
 	///
 	void sendMessage(const uint8_t* buffer, uint32_t size);
 
+	///
+	/// @brief The encoding of the images sent through the TCP socket
+	/// @param maxWidth  Wider images are downscaled by an integer factor, 0 keeps the size
+	/// @param format    The image type of the requests
+	/// @param quality   The JPEG quality 1 .. 100
+	///
+	void setImageEncoding(int maxWidth, ImageFormat format, int quality);
+
+	///
+	/// @brief The counters of the images since the previous call, then they are cleared
+	///
+	ForwardStats takeForwardStats();
+
 public slots:
 	///
 	/// @brief Set the leds according to the given image
@@ -96,6 +128,11 @@ private slots:
 	///
 	void readData();
 
+	///
+	/// @brief Send the image that waits, once the reply of the one in flight arrived and the socket drained
+	///
+	void flushPending();
+
 signals:
 
 	///
@@ -114,6 +151,30 @@ private:
 	///
 	bool parseReply(const hyperhdrnet::Reply* reply);
 
+	///
+	/// @brief Create the shared memory for the frames of the domain socket connection and offer it to the server
+	/// @param slotSize The size of the current frame
+	/// @return true if the request was sent
+	///
+	bool requestSharedMemory(size_t slotSize);
+
+	void releaseSharedMemory();
+
+	///
+	/// @brief The bytes that the socket did not hand over to the system yet
+	///
+	qint64 bytesToWrite() const;
+
+	///
+	/// @brief Encode and send the image now, it is in flight until the reply
+	///
+	void sendImage(const Image<ColorRgb>& image, uint64_t offered);
+
+	///
+	/// @brief The image reduced to the maximum width, or the image itself
+	///
+	const Image<ColorRgb>& downscale(const Image<ColorRgb>& image);
+
 private:
 	/// The TCP-Socket with the connection to the server
 	QTcpSocket*		_socket;
@@ -137,6 +198,36 @@ private:
 	flatbuffers::FlatBufferBuilder _builder;
 
 	bool	 _registered;
+	bool	 _skipReply;
 	bool	 _sent;
 	uint64_t _lastSendImage;
+
+	enum SharedMemoryState { SHARED_OFF, SHARED_REQUESTED, SHARED_ACTIVE, SHARED_REFUSED };
+
+	/// the slots are written in turn, a frame larger than the slots goes through the socket
+	std::unique_ptr<QSharedMemory> _sharedMemory;
+	SharedMemoryState	_sharedState;
+	uint32_t			_sharedSlotSize;
+	uint32_t			_sharedSlot;
+
+	/// latest wins: the newest image waits for the reply of the one in flight and for the socket to drain
+	Image<ColorRgb>	_pendingImage;
+	bool			_hasPending;
+	uint64_t		_pendingTime;
+	/// the time setImage got the image in flight, 0 if none
+	uint64_t		_inFlightTime;
+
+	int				_maxWidth;
+	ImageFormat		_format;
+	int				_quality;
+	Image<ColorRgb>	_scaled;
+	std::vector<uint8_t> _compressed;
+	void*			_jpegEncoder;
+
+	qint64			_statSent;
+	qint64			_statDropped;
+	qint64			_statLagSum;
+	qint64			_statLagMax;
+	qint64			_statRejected;
+	LatencyHistogram _statLag;
 };
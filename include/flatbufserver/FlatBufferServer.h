@@ -4,6 +4,8 @@
 #include <utils/Logger.h>
 #include <utils/settings.h>
 #include <utils/Image.h>
+#include <utils/CompactLut.h>
+#include <utils/LutRegistry.h>
 
 // qt
 #include <QVector>
@@ -17,7 +19,7 @@ class NetOrigin;
 #define HYPERHDR_DOMAIN_SERVER QStringLiteral("hyperhdr-domain")
 
 ///
-/// @brief A TcpServer to receive images of different formats with Google Flatbuffer
+/// Images will be forwarded to the target instances of the settings, all HyperHdr instances by default
 /// Images will be forwarded to all HyperHdr instances
 ///
 class FlatBufferServer : public QObject
@@ -31,7 +33,7 @@ public:
 	static FlatBufferServer* getInstance() { return instance; }
 
 signals:
-	void hdrToneMappingChanged(int mode, uint8_t* lutBuffer);
+	void hdrToneMappingChanged(int mode, LutHandle lut);
 	void HdrChanged(int mode);
 
 public slots:
@@ -84,6 +86,7 @@ private:
 	/// @brief Load LUT file
 	///
 	void loadLutFile();
+	void loadLutTables(const QList<QString>& files);
 
 	void setupClient(FlatBufferClient* client);
 
@@ -104,8 +107,13 @@ private:
 	// tone mapping
 	int			_hdrToneMappingMode;
 	int			_realHdrToneMappingMode;
-	uint8_t*	_lutBuffer;
+	const uint8_t*	_lutBuffer;
+	std::shared_ptr<const LutTable> _lutTable;
 	bool		_lutBufferInit;
+	int			_lutCompactGrid;
+	CompactLut	_compactLut;
+	/// the table of the clients, every frame keeps the one it was queued with
+	LutHandle	_lutHandle;
 	QString		_configurationPath;
 	QString		_userLutFile;
 };
@@ -0,0 +1,60 @@
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+
+/**
+ * The shared memory transport of the local (domain socket) flatbuffer clients. The client creates the segment
+ * (QSharedMemory) and sends its key in the SharedMemory request. Then a frame is written to
+ * a free slot and only the SharedImage request with the slot number goes through the socket. The server copies
+ * the slot straight into its frame and the reply to the request releases the slot: the replies come in the order
+ * of the requests.
+ *
+ * The segment is the Header at offset 0, then the slots of slotSize bytes from DATA_OFFSET. A slot holds the RGB
+ * data of one image without padding. All values are in the byte order of the host.
+ */
+namespace FlatBufferSharedMemory
+{
+	constexpr char     MAGIC[8] = { 'H', 'H', 'D', 'R', 'S', 'H', 'M', 'R' };
+	constexpr uint32_t VERSION = 1;
+	constexpr size_t   DATA_OFFSET = 64;
+
+	struct Header
+	{
+		char     magic[8];
+		uint32_t version;
+		uint32_t slots;
+		uint32_t slotSize;
+		uint32_t reserved;
+	};
+
+	static_assert(sizeof(Header) <= DATA_OFFSET, "the header overlaps the slots");
+
+	inline size_t segmentSize(uint32_t slots, uint32_t slotSize)
+	{
+		return DATA_OFFSET + static_cast<size_t>(slots) * slotSize;
+	}
+
+	inline size_t slotOffset(uint32_t slot, uint32_t slotSize)
+	{
+		return DATA_OFFSET + static_cast<size_t>(slot) * slotSize;
+	}
+
+	inline Header makeHeader(uint32_t slots, uint32_t slotSize)
+	{
+		Header header;
+		memcpy(header.magic, MAGIC, sizeof(MAGIC));
+		header.version = VERSION;
+		header.slots = slots;
+		header.slotSize = slotSize;
+		header.reserved = 0;
+		return header;
+	}
+
+	/// the slots must fit in the mapped size of the segment
+	inline bool isValid(const Header& header, size_t mappedSize)
+	{
+		return memcmp(header.magic, MAGIC, sizeof(MAGIC)) == 0 && header.version == VERSION &&
+			header.slots > 0 && header.slotSize > 0 && segmentSize(header.slots, header.slotSize) <= mappedSize;
+	}
+}
@@ -40,7 +40,8 @@ public:
 		unsigned	__cropLeft, unsigned  __cropTop,
 		unsigned	__cropBottom, unsigned __cropRight,
 		quint64		__currentFrame, qint64 __frameBegin,
-		int			__hdrToneMappingEnabled, uint8_t* __lutBuffer, bool __qframe);
+		int			__hdrToneMappingEnabled, const LutHandle& __lut,
+		bool __qframe, int __decodeTargetWidth, int __decodeStripes);
 
 	void startOnThisThread();
 	void run() override;
@@ -77,8 +78,13 @@ private:
 	quint64		_currentFrame;
 	qint64		_frameBegin;
 	uint8_t	    _hdrToneMappingEnabled;
-	uint8_t*    _lutBuffer;
+	/// keeps the table of the frame alive until it's decoded
+	LutHandle         _lut;
+	const uint8_t*    _lutBuffer;
+	const CompactLut* _compactLut;
 	bool		_qframe;
+	int			_decodeTargetWidth;
+	int			_decodeStripes;
 };
 
 class AVFWorkerManager : public  QObject
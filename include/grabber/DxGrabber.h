@@ -29,6 +29,9 @@
 #include <QImage>
 #include <QColor>
 
+// frame N is mapped while frame N+1 is copied by the GPU
+#define DX_STAGING_TEXTURES 3
+
 
 class DxGrabber : public Grabber
 {
@@ -79,6 +82,16 @@ private:
 
 	bool init_device(QString selectedDeviceName);
 
+	bool createMipTexture();
+
+	bool createSourceTexture(int index, int level);
+
+	bool mapSourceTexture(int index);
+
+	int  getMipLevel();
+
+	void processScaledFrameBGRA(uint8_t* source, int lineSize, int level);
+
 private:
 	QString					_configurationPath;
 	QTimer					_timer;
@@ -90,7 +103,24 @@ private:
 	bool					_alternative;
 	ID3D11Device*			_d3dDevice;
 	ID3D11DeviceContext*	_d3dContext;
-	ID3D11Texture2D*		_sourceTexture;
+	ID3D11Texture2D*		_sourceTexture[DX_STAGING_TEXTURES];
+	ID3D11Texture2D*		_mipTexture;
+	ID3D11ShaderResourceView* _mipView;
+	int						_mipLevels;
+	int						_sourceLevel[DX_STAGING_TEXTURES];
+	bool					_sourceReady[DX_STAGING_TEXTURES];
+	int						_sourceIndex;
+	int						_sourceLatest;
+	int						_desktopWidth;
+	int						_desktopHeight;
 	IDXGIOutputDuplication* _d3dDuplicate;
 	Image<ColorRgb>			_cacheImage;
+
+	struct
+	{
+		qint64	token = 0;
+		qint64	total = 0;
+		qint64	maximum = 0;
+		int		frames = 0;
+	} _stallStat;
 };
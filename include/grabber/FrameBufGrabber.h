@@ -38,6 +38,7 @@ public:
 
 	void setCropping(unsigned cropLeft, unsigned cropRight, unsigned cropTop, unsigned cropBottom) override;
 
+
 	bool isActivated();
 
 	void stateChanged(bool state);
@@ -68,10 +69,29 @@ private:
 	bool init() override;
 
 	void uninit() override;
+
+	bool mapMemory(size_t size);
+
+	void unmapMemory();
+
+	void processRegionFrame(uint8_t* source, int lineSize, int bitsPerPixel);
+
+	void decodeRegion(Image<ColorRgb>& image, int targetSizeX, int targetSizeY, int startX, int startY, uint8_t* source, int lineSize, int bitsPerPixel, int division);
 		
 private:
 	QString		_configurationPath;
 	QTimer		_timer;
 	QSemaphore	_semaphore;
 	int			_handle;
+
+	// the framebuffer stays mapped while the grabber is running
+	uint8_t*	_memHandle;
+	size_t		_memSize;
+
+	struct
+	{
+		qint64	token = 0;
+		qint64	sampled = 0;
+		qint64	total = 0;
+	} _regionStat;
 };
@@ -79,6 +79,8 @@ private:
 
 	bool init_device(QString selectedDeviceName, DevicePropertiesItem props);
 
+	bool setDecodedOutput(int width, int height);
+
 	void uninit_device();
 
 	void start_capturing();
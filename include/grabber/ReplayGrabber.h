@@ -0,0 +1,104 @@
+#pragma once
+
+#include <QThread>
+#include <QMutex>
+#include <QSemaphore>
+
+#include <base/Grabber.h>
+#include <utils/CaptureRecording.h>
+
+class ReplayGrabber;
+
+///
+/// Reads the recording, keeps the recorded pace (or not) and decodes the frames for the grabber.
+/// At most two decoded frames wait for the grabber's thread, so without pacing the replay runs
+/// exactly as fast as the processing takes the frames.
+///
+class ReplayThread : public QThread
+{
+	Q_OBJECT
+
+public:
+	ReplayThread(ReplayGrabber* grabber, Logger* log, const QString& fileName, double speed, bool loop);
+	~ReplayThread();
+
+	void stopReplay();
+
+	///
+	/// @brief The grabber has taken a frame, the next one can be decoded
+	///
+	void frameDone();
+
+signals:
+	void newFrame(unsigned int workerIndex, Image<ColorRgb> image, quint64 sourceCount, qint64 _frameBegin);
+	void newFrameError(unsigned int workerIndex, QString error, quint64 sourceCount);
+
+protected:
+	void run() override;
+
+private:
+	bool waitUntil(int64_t due);
+
+	ReplayGrabber*	_grabber;
+	Logger*			_log;
+	QString			_fileName;
+	double			_speed;
+	bool			_loop;
+	QSemaphore		_slots;
+};
+
+///
+/// Plays a raw capture recording (see CaptureRecording.h) back as a video grabber, so the frames go through
+/// the same decoding, signal detection and GrabberWrapper path as the frames of the recorded device.
+///
+class ReplayGrabber : public Grabber
+{
+	Q_OBJECT
+
+	friend class ReplayThread;
+
+public:
+	///
+	/// @param fileName  The recording
+	/// @param speed     Factor of the recorded speed, 0 = as fast as the processing takes the frames
+	/// @param loop      Start again at the end of the recording
+	///
+	ReplayGrabber(const QString& fileName, double speed, bool loop, const QString& configurationPath);
+
+	~ReplayGrabber();
+
+	void setHdrToneMappingEnabled(int mode) override;
+
+public slots:
+
+	bool start() override;
+
+	void stop() override;
+
+	void newWorkerFrame(unsigned int workerIndex, Image<ColorRgb> image, quint64 sourceCount, qint64 _frameBegin) override;
+
+	void newWorkerFrameError(unsigned int workerIndex, QString error, quint64 sourceCount) override;
+
+private:
+	bool init() override;
+
+	void uninit() override;
+
+	void loadLutFile(PixelFormat color);
+
+	///
+	/// @brief Decode a recorded buffer on the replay thread
+	/// @return Empty on success, else the reason
+	///
+	QString decodeFrame(const CaptureRecording::Record& record, const uint8_t* data, Image<ColorRgb>& image);
+
+	QString			_fileName;
+	double			_speed;
+	bool			_loop;
+	ReplayThread*	_thread;
+	// the replay thread and the LUT reload on the grabber's thread
+	QMutex			_decodeLock;
+	bool			_lutYuv;
+	std::vector<uint8_t> _jpegBuffer;
+	void*			_decompress;
+};
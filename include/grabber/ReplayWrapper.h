@@ -0,0 +1,15 @@
+#pragma once
+
+#include <base/GrabberWrapper.h>
+#include <grabber/ReplayGrabber.h>
+
+class ReplayWrapper : public GrabberWrapper
+{
+	Q_OBJECT
+
+public:
+	ReplayWrapper(const QString& fileName, double speed, bool loop, const QString& configurationPath);
+
+private:
+	ReplayGrabber _grabber;
+};
@@ -26,9 +26,19 @@ class SoundCapLinux : public SoundCapture
 
 			snd_pcm_t*				_handle;
 			snd_async_handler_t*	_pcmCallback;	
+			/// the samples are analysed in the mmap area, else they are read to _soundBuffer
+			bool					_mmap;
+			/// samples of a period split by the end of the mmap area, gathered in _soundBuffer
+			snd_pcm_uframes_t		_pending;
+			/// the end of the last period [ns]
+			qint64					_lastPeriod;
 
 	private:
 			static void RecordCallback(snd_async_handler_t* audioHandler);
 
+			void	ReadPeriods();
+			void	Analise(int16_t* samples);
+			bool	Recover(int status);
+
 			static int16_t    _soundBuffer[(1<<SOUNDCAPLINUX_BUF_LENP)*2];			
 };
@@ -2,7 +2,10 @@
 
 #include <base/SoundCapture.h>
 #include <windows.h>
-#include "mmsystem.h"
+#include <mmdeviceapi.h>
+#include <audioclient.h>
+
+#include <thread>
 
 #define SOUNDCAPWINDOWS_BUF_LENP 10
 class SoundCapWindows : public SoundCapture
@@ -17,10 +20,28 @@ private:
 	void    Start() override;
 	void    Stop() override;
 
-	static void CALLBACK soundInProc(HWAVEIN hwi, UINT uMsg, DWORD dwInstance, DWORD dwParam1, DWORD dwParam2);
-	static int16_t    _bufferIndex;
-	static int16_t    _soundBuffer[(1 << SOUNDCAPWINDOWS_BUF_LENP) + 64];
-	static WAVEHDR    _header;
-	static HWAVEIN    _hWaveIn;
-};
+	/// the capture thread: opens the endpoint and waits for the events of the audio engine
+	void	Capture();
+	bool	OpenStream(IMMDeviceEnumerator* enumerator, IAudioClient** client, IAudioCaptureClient** capture, WAVEFORMATEX** format);
+	void	ReadPackets(IAudioCaptureClient* capture, const WAVEFORMATEX* format);
+	void	AddFrames(const BYTE* data, UINT32 frames, const WAVEFORMATEX* format, bool silent);
+	void	Analise();
 
+	std::thread		_thread;
+	/// signalled by Stop
+	HANDLE			_stopEvent;
+	/// signalled by the capture thread when the stream is running or failed to start
+	HANDLE			_readyEvent;
+	/// signalled by the audio engine for every period of samples
+	HANDLE			_dataEvent;
+	bool			_startResult;
+	/// the resampling to SOUNDCAP_SAMPLE_RATE: the phase and the sum of the frames of the next sample
+	UINT32			_phase;
+	float			_sum;
+	int				_sumCount;
+	int				_pending;
+	/// the end of the last period [ns]
+	qint64			_lastPeriod;
+
+	int16_t			_soundBuffer[1 << SOUNDCAPWINDOWS_BUF_LENP];
+};
@@ -11,6 +11,8 @@
 #include <QRectF>
 #include <QMap>
 #include <QMultiMap>
+#include <QThread>
+#include <QMutex>
 
 // util includes
 #include <utils/PixelFormat.h>
@@ -23,10 +25,37 @@
 #include <QColor>
 #include <turbojpeg.h>
 
+class V4L2Grabber;
+
+///
+/// Optional capture thread: blocks in epoll on the V4L2 descriptor and dequeues every frame as soon as the driver
+/// completes it, so the capture jitter doesn't depend on the load of the grabber's event loop.
+///
+class V4L2CaptureThread : public QThread
+{
+public:
+	V4L2CaptureThread(V4L2Grabber* grabber, Logger* log, int fileDescriptor, bool realtime);
+	~V4L2CaptureThread();
+
+	void stopCapture();
+
+protected:
+	void run() override;
+
+private:
+	V4L2Grabber* _grabber;
+	Logger*		_log;
+	int			_fileDescriptor;
+	int			_wakeupDescriptor;
+	bool		_realtime;
+};
+
 class V4L2Grabber : public Grabber
 {
 	Q_OBJECT
 
+	friend class V4L2CaptureThread;
+
 public:
 	struct HyperHdrFormat
 	{
@@ -48,13 +77,15 @@ public slots:
 
 	void stop() override;
 
-	void newWorkerFrame(unsigned int workerIndex, Image<ColorRgb> image, quint64 sourceCount, qint64 _frameBegin) override;
+	void newWorkerFrame(unsigned int bufferIndex, Image<ColorRgb> image, quint64 sourceCount, qint64 _frameBegin) override;
 
-	void newWorkerFrameError(unsigned int workerIndex, QString error, quint64 sourceCount) override;
+	void newWorkerFrameError(unsigned int bufferIndex, QString error, quint64 sourceCount) override;
 
 private slots:
 	int read_frame();
 
+	void streamBroken();
+
 private:
 	QString GetSharedLut();
 
@@ -70,7 +101,21 @@ private:
 
 	void close_device();
 
-	bool init_mmap();
+	bool init_buffers();
+
+	bool init_mmap(bool exportDmaBuf);
+
+	bool init_userptr(size_t bufferSize);
+
+	bool init_dmabuf(size_t bufferSize);
+
+	bool request_buffers(uint32_t memory, uint32_t& count);
+
+	void sync_dmabuf(const v4l2_buffer* buf, bool start);
+
+	int queue_buffer(unsigned int index);
+
+	void requeueWorkerBuffer(unsigned int bufferIndex, quint64 sourceCount);
 
 	bool init_device(QString selectedDeviceName, DevicePropertiesItem props);
 
@@ -100,16 +145,37 @@ private:
 
 	bool setControl(__u32 controlId, __s32 newValue);
 
+	///
+	/// @brief Set the brightness, contrast, saturation and hue of the user (0 = the default of the device)
+	/// @return false if a supported control was refused
+	///
+	bool setVideoControls(const DeviceProperties& device);
+
+	bool applyDeviceControls() override;
+
 private:
 
 	struct buffer
 	{
-		void* start;
-		size_t  length;
+		void* start = nullptr;
+		size_t  length = 0;
+		// exported by the driver (MMAP) or imported from a DMA heap (DMABUF), -1 if none
+		int		dmabufFd = -1;
+		// capture time of the frame that is currently in the buffer
+		int64_t	timestamp = 0;
+		// the buffer was dequeued (FrameTrace::now)
+		int64_t	dequeued = 0;
 	};
 
 	int                 _fileDescriptor;
 	std::vector<buffer> _buffers;
-	QSocketNotifier*	_streamNotifier;	
+	uint32_t            _memoryType;
+	QSocketNotifier*	_streamNotifier;
+	V4L2CaptureThread*	_captureThread;
+	// the capture thread and the LUT reload on the grabber's thread
+	QMutex				_captureLock;
 	V4L2WorkerManager   _V4L2WorkerManager;
+	QString				_hwMjpegDevice;
+	// the version of the processing parameters of the last dispatched frame
+	quint64				_appliedProcessing;
 };
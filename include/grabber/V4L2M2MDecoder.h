@@ -0,0 +1,84 @@
+#pragma once
+
+// stl includes
+#include <atomic>
+#include <cstdint>
+#include <cstddef>
+
+// Qt includes
+#include <QString>
+#include <QMutex>
+
+///
+/// Hardware MJPEG decoder using a V4L2 memory-to-memory JPEG device (e.g. Raspberry Pi, Rockchip, i.MX).
+/// The frame is decoded to NV12 which is then processed by the regular NV12 LUT path of FrameDecoder.
+/// One instance per worker thread, the device supports a separate decoding context for every open handle.
+///
+class V4L2M2MDecoder
+{
+public:
+	V4L2M2MDecoder();
+	~V4L2M2MDecoder();
+
+	///
+	/// Looks for a M2M device that accepts MJPEG/JPEG and produces NV12. The result of the probe is cached.
+	/// @return the device path or an empty string if there is no such device
+	///
+	static QString findDevice();
+
+	///
+	/// Disables the hardware decoder for all the workers after a failure, the workers fall back to turbojpeg.
+	/// The grabber enables it again when the device is reinitialized.
+	///
+	static void setDisabled(bool disabled);
+
+	static bool isDisabled();
+
+	bool open(const QString& device);
+
+	void close();
+
+	bool decode(const uint8_t* jpeg, size_t size, int width, int height);
+
+	const uint8_t* data() const;
+
+	int lineLength() const;
+
+	/// height of the luma plane in the output buffer, may be aligned above the frame height by the driver
+	int planeHeight() const;
+
+private:
+	struct MappedBuffer
+	{
+		void*	start;
+		size_t	length;
+	};
+
+	bool configure(int width, int height);
+
+	void release();
+
+	bool queueBuffer(uint32_t type, size_t bytesUsed);
+
+	bool dequeueBuffer(uint32_t type, uint32_t& flags);
+
+	int xioctl(unsigned long request, void* arg);
+
+	static bool probeDevice(const QString& device, uint32_t& jpegFormat);
+
+	int				_fd;
+	bool			_mplane;
+	bool			_streaming;
+	uint32_t		_jpegFormat;
+	int				_width;
+	int				_height;
+	int				_lineLength;
+	int				_planeHeight;
+	MappedBuffer	_output;
+	MappedBuffer	_capture;
+
+	static QMutex				_probeLocker;
+	static bool					_probed;
+	static QString				_device;
+	static std::atomic<bool>	_disabled;
+};
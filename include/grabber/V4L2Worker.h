@@ -4,6 +4,7 @@
 #include <vector>
 #include <map>
 #include <atomic>
+#include <deque>
 
 // Qt includes
 #include <QObject>
@@ -12,12 +13,16 @@
 #include <QMap>
 #include <QMultiMap>
 #include <QThread>
+#include <QMutex>
+#include <QWaitCondition>
 
 // util includes
 #include <utils/PixelFormat.h>
 #include <base/Grabber.h>
 #include <utils/Components.h>
 #include <linux/videodev2.h>
+#include <grabber/V4L2M2MDecoder.h>
+#include <utils/FrameRing.h>
 
 // general JPEG decoder includes
 #include <QImage>
@@ -27,6 +32,24 @@
 #include <turbojpeg.h>
 
 
+/// decoding job of a single captured V4L2 buffer
+struct V4L2WorkerJob
+{
+	unsigned int	bufferIndex;
+	PixelFormat		pixelFormat;
+	uint8_t*		sharedData;
+	int				size, width, height, lineLength;
+	unsigned		cropLeft, cropTop, cropBottom, cropRight;
+	quint64			currentFrame;
+	qint64			frameBegin;
+	int				hdrToneMappingEnabled;
+	LutHandle		lut;
+	bool			qframe;
+	int				decodeTargetWidth, decodeStripes, mjpegScale;
+	QString			hwMjpegDevice;
+	QRectF			skippedArea;
+};
+
 /// MT worker for V4L2 devices
 class V4L2WorkerManager;
 class V4L2Worker : public  QThread
@@ -35,41 +58,35 @@ class V4L2Worker : public  QThread
 		friend class V4L2WorkerManager;
 
 public:
-	void setup(
-		unsigned int _workerIndex, v4l2_buffer* __v4l2Buf,
-		PixelFormat __pixelFormat,
-		uint8_t* __sharedData,
-		int			__size, int __width, int __height, int __lineLength,
-		unsigned	__cropLeft, unsigned  __cropTop,
-		unsigned	__cropBottom, unsigned __cropRight,
-		quint64		__currentFrame, qint64 __frameBegin,
-		int			__hdrToneMappingEnabled, uint8_t* __lutBuffer, bool __qframe);
+	void setup(const V4L2WorkerJob& job);
 
 	void startOnThisThread();
 	void run() override;
 
-	v4l2_buffer* GetV4L2Buffer();
-	bool isBusy();
-	void noBusy();
-
-	V4L2Worker();
+	V4L2Worker(V4L2WorkerManager* manager, unsigned int workerIndex);
 	~V4L2Worker();
 
 signals:
-	void newFrame(unsigned int workerIndex, Image<ColorRgb> data, quint64 sourceCount, qint64 _frameBegin);
-	void newFrameError(unsigned int workerIndex, QString, quint64 sourceCount);
+	void newFrame(unsigned int bufferIndex, Image<ColorRgb> data, quint64 sourceCount, qint64 _frameBegin);
+	void newFrameError(unsigned int bufferIndex, QString, quint64 sourceCount);
 
 private:
 	void runMe();
 	void process_image_jpg_mt();
+	bool process_image_jpg_hw();
+	Image<ColorRgb> acquireFrame(unsigned width, unsigned height);
+	uint8_t* getJpegBuffer(size_t size);
 
+	V4L2WorkerManager* _manager;
 	tjhandle 	_decompress;
+	V4L2M2MDecoder* _hwDecoder;
+	FrameRing*  _frameRing;
+	std::vector<uint8_t> _jpegBuffer;
 
 	static	std::atomic<bool> _isActive;
-	std::atomic<bool>   _isBusy;
-	QSemaphore	        _semaphore;
+	std::atomic<int64_t>	_busyTime;
 	unsigned int 	    _workerIndex;
-	struct v4l2_buffer  _v4l2Buf;
+	unsigned int		_bufferIndex;
 	PixelFormat			_pixelFormat;
 	uint8_t*    _sharedData;
 	int			_size;
@@ -84,10 +101,22 @@ private:
 	quint64		_currentFrame;
 	qint64		_frameBegin;
 	uint8_t	    _hdrToneMappingEnabled;
-	uint8_t*    _lutBuffer;
+	/// keeps the table of the frame alive until it's decoded
+	LutHandle         _lut;
+	const uint8_t*    _lutBuffer;
+	const CompactLut* _compactLut;
 	bool		_qframe;
+	int			_decodeTargetWidth;
+	int			_decodeStripes;
+	int			_mjpegScale;
+	QString		_hwMjpegDevice;
+	QRectF		_skippedArea;
 };
 
+///
+/// Persistent worker threads fed by a bounded job queue: the capture thread submits the frames and the first idle worker takes
+/// the oldest one. Decoding finishes out of order, acceptFrame() lets only frames newer than the last emitted one through.
+///
 class V4L2WorkerManager : public  QObject
 {
 	Q_OBJECT
@@ -101,7 +130,44 @@ public:
 	void Stop();
 	void Start();
 
+	/// @return false if the queue is full: the frame is dropped and its buffer must be requeued by the caller
+	bool submit(const V4L2WorkerJob& job);
+
+	/// buffers of the jobs that were still waiting in the queue when the workers were stopped
+	std::vector<unsigned int> takeDroppedBuffers();
+
+	/// reorder stage: false for the frames older than the last accepted one
+	bool acceptFrame(quint64 sourceCount);
+
+	void resetOrder();
+
+	QString getStats();
+
 	// MT workers
 	unsigned int	workersCount;
 	V4L2Worker** workers;
+
+	// output frames shared by the workers
+	FrameRing		frameRing;
+
+private:
+	friend class V4L2Worker;
+
+	bool takeJob(V4L2WorkerJob& job);
+
+	QMutex			_queueLock;
+	QWaitCondition	_queueCondition;
+	std::deque<V4L2WorkerJob> _queue;
+	std::vector<unsigned int> _droppedBuffers;
+
+	bool			_orderValid;
+	quint64			_lastFrame;
+
+	// stats
+	uint64_t		_submitted;
+	uint64_t		_queueDepth;
+	int				_peakQueueDepth;
+	uint64_t		_queueFull;
+	uint64_t		_staleFrames;
+	int64_t			_statsBegin;
 };
@@ -68,6 +68,8 @@ private:
 	void uninit() override;
 	
 	bool init_device(int _display);
+
+	void processDamagedFrameBGRA(uint8_t* source, int lineSize, bool changed, int damageTop, int damageBottom);
 		
 private:
 	QString					_configurationPath;
@@ -77,4 +79,17 @@ private:
 	void*					_library;
 	int						_actualDisplay;
 	struct x11Handle*		_handle;
+
+	// the previous frame is refreshed only in the damaged rows
+	Image<ColorRgb>			_lastFrame;
+	qint64					_lastFrameTime;
+	int						_lastFrameGeometry[5];
+
+	struct
+	{
+		qint64	token = 0;
+		int		full = 0;
+		int		partial = 0;
+		int		skipped = 0;
+	} _captureStat;
 };
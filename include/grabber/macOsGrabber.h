@@ -4,6 +4,7 @@
 #include <vector>
 #include <map>
 #include <chrono>
+#include <atomic>
 
 // Qt includes
 #include <QObject>
@@ -38,10 +39,16 @@ public:
 
 	void setCropping(unsigned cropLeft, unsigned cropRight, unsigned cropTop, unsigned cropBottom) override;
 
+	void processStreamFrame(uint8_t* source, int width, int height, int lineSize);
+
 private slots:
 
 	void grabFrame();
 
+	void streamStopped();
+
+	void cacheHandler(const Image<ColorRgb>& image);
+
 public slots:
 
 	bool start() override;
@@ -68,6 +75,10 @@ private:
 	bool init_device(QString selectedDeviceName);
 
 	void processFrame(int8_t* source);
+
+	void startStream();
+
+	void stopStream();
 		
 private:
 	QString					_configurationPath;
@@ -75,4 +86,11 @@ private:
 	QSemaphore				_semaphore;
 
 	CGDirectDisplayID		_actualDisplay;
+
+	// ScreenCaptureKit stream: the legacy CoreGraphics capture is used until it starts
+	void*					_streamHandler;
+	std::atomic<bool>		_streamActive;
+	int						_streamScale;
+	Image<ColorRgb>			_lastFrame;
+	qint64					_lastFrameTime;
 };
@@ -4,6 +4,7 @@ struct PipewireImage
 	bool	isError;
 	int		width, height;
 	bool	isOrderRgb;
+	int		scale;
 	unsigned char* data;
 };
 extern "C" const char* getPipewireToken();
@@ -13,4 +14,5 @@ extern "C" void initPipewireDisplay(const char* restorationToken);
 extern "C" void uniniPipewireDisplay();
 extern "C" PipewireImage getFramePipewire();
 extern "C" void releaseFramePipewire();
+extern "C" void setTargetWidthPipewire(int width);
 
@@ -18,9 +18,16 @@ struct x11Handle
 	int   index;
 	void* handle;
 	void* image;
+	void* capture;
 	int width;
 	int height;
 	int size;
+	int lineSize;
+	// 0 if the damage tracking reports no change since the previous frame
+	int changed;
+	// the rows changed since the previous frame
+	int damageTop;
+	int damageBottom;
 };
 
 extern "C" struct x11Displays* enumerateX11Displays();
@@ -0,0 +1,43 @@
+#pragma once
+
+#include <QString>
+#include <QJsonArray>
+#include <QHostAddress>
+#include <QMap>
+
+#include <functional>
+
+///
+/// @brief The results of the network scans of the LED devices (SSDP, the Cololight broadcast...). A scan runs
+/// in the background and its result is kept: the discovery of the device configuration gets the last result
+/// instantly and only the very first search of a kind waits for its scan. The searches requested recently are
+/// rescanned with the periodic mDNS scan of DiscoveryWrapper, so the cache stays fresh while the UI is open.
+///
+/// The scanner is called on a worker thread: it must not touch the device that requested it.
+///
+class DiscoveryCache
+{
+public:
+	typedef std::function<QJsonArray()> Scanner;
+
+	///
+	/// @brief Get the devices found by the search, a result older than the refresh age is rescanned in the background
+	/// @param search   The name of the search (ex. "ssdp:nanoleaf")
+	/// @param scanner  The blocking scan, it returns the devices as the discover() of the LED device does
+	/// @return The devices from the last scan
+	///
+	static QJsonArray get(const QString& search, const Scanner& scanner);
+
+	/// rescan the searches that were requested in the last minutes and got stale
+	static void refresh();
+
+	/// the host names of the mDNS records and their addresses, published by DiscoveryWrapper when they change
+	static void setHosts(const QMap<QString, QString>& mdnsHosts);
+
+	///
+	/// @brief Find the address of a host in the cached scans and the mDNS records, no DNS query is sent
+	/// @param host  The host name (ex. "nanoleaf-panel" or "wled-kitchen.local")
+	/// @return The address or a null address when the host is unknown
+	///
+	static QHostAddress resolve(const QString& host);
+};
@@ -0,0 +1,112 @@
+#pragma once
+
+#include <QObject>
+#include <QString>
+#include <QJsonObject>
+#include <QTimer>
+
+#include <atomic>
+#include <memory>
+#include <vector>
+
+#include <utils/ColorRgb.h>
+#include <utils/LatencyHistogram.h>
+#include <utils/Logger.h>
+
+class QSerialPort;
+
+///
+/// @brief The glass-to-LED latency of the test flashes of the benchmark page. The browser shows a color
+/// and sends the benchmark command (requested), the grabber finds the color at the center of the frame
+/// (captured), the LED device writes colors that match it (written) and a photodiode in front of the
+/// LEDs, when one is connected, sees them change (lit). The flash is completed at its last stage so the
+/// page shows the next color only then, and the stages of all flashes are collected into distributions.
+///
+/// The photodiode is read from a serial port: every byte it sends is a change of the light it sees
+/// (ex. an Arduino that writes a character when the output of its comparator toggles). A flash whose light
+/// does not cross the threshold of the sensor is completed without the light stage.
+///
+class LatencyBenchmark : public QObject
+{
+	Q_OBJECT
+
+public:
+	enum TestColor { NONE = -1, BLACK = 0, WHITE, RED, GREEN, BLUE };
+
+	static LatencyBenchmark* getInstance();
+
+	static TestColor parseColor(const QString& name);
+
+	///
+	/// @brief The thresholds of the grabber benchmark, for a captured pixel or the mean color of the LEDs
+	///
+	static bool matches(TestColor color, const ColorRgb& pixel);
+
+	///
+	/// @brief Called by the LED devices after every write, only a flash waiting for the LEDs costs more than a load
+	/// @param ledValues The colors that were written
+	/// @param time When the write ended [ns, PreciseTimer::now]
+	///
+	static void checkWrite(const std::vector<ColorRgb>& ledValues, qint64 time);
+
+public slots:
+	///
+	/// @brief Start a new benchmark, the previous statistics are cleared
+	/// @param leds        Complete the flashes when the LEDs get the color, else when the grabber sees it
+	/// @param photodiode  The serial port of the light sensor, empty for none
+	///
+	void begin(bool leds, QString photodiode);
+
+	void request(int status, QString color, qint64 time);
+	void captured(int status, QString color, qint64 time);
+	void written(int status, qint64 time);
+
+	///
+	/// @brief End the benchmark: the statistics are sent with statsUpdated
+	///
+	void finish();
+
+signals:
+	void flashCompleted(int status, QString message);
+	void statsUpdated(QJsonObject stats);
+
+private slots:
+	void sensorData();
+	void flashTimeout();
+
+private:
+	LatencyBenchmark();
+
+	void complete(bool lost);
+	void closeSensor();
+
+	struct Flash
+	{
+		int		status = -1;
+		QString	color;
+		qint64	requested = 0;
+		qint64	captured = 0;
+		qint64	written = 0;
+		qint64	lit = 0;
+	};
+
+	static std::unique_ptr<LatencyBenchmark> _instance;
+
+	/// the flash waiting for the LEDs: the color and the status, written by the LED thread that sees it first
+	static std::atomic<int>	_watchColor;
+	static std::atomic<int>	_watchStatus;
+
+	Logger*			_log;
+	bool			_leds;
+	QSerialPort*	_sensor;
+	QTimer			_timeout;
+	Flash			_flash;
+
+	int				_flashes;
+	int				_lost;
+	int				_unconfirmed;
+	LatencyHistogram _capture;
+	LatencyHistogram _processing;
+	LatencyHistogram _light;
+	LatencyHistogram _total;
+};
@@ -15,14 +15,20 @@
 #include <map>
 #include <algorithm>
 #include <atomic>
+#include <memory>
 
 // Utility includes
 #include <utils/ColorRgb.h>
 #include <utils/ColorRgbw.h>
+#include <utils/LedFramePool.h>
 #include <utils/Logger.h>
 #include <functional>
 #include <utils/Components.h>
 #include <utils/PerformanceCounters.h>
+#include <utils/LatencyHistogram.h>
+#include <utils/PreciseTimer.h>
+#include <utils/WriteCadence.h>
+#include <utils/FrameTrace.h>
 
 class LedDevice;
 
@@ -161,15 +167,36 @@ public slots:
 	///
 	virtual void stop();
 
+	///
+	/// @brief The light sleep of the system: the LEDs go dark and the writes stop, but the device stays open
+	/// and switched on, so its session (ex. the DTLS stream of the Hue) is reused when the system wakes up.
+	/// A session that didn't survive the sleep fails on the next write and takes the usual error and retry path.
+	///
+	/// @param[in] sleep True when the system goes to sleep, false when it wakes up
+	///
+	void lightSleep(bool sleep);
+
 	///
 	/// @brief Update the color values of the device's LEDs.
 	///
 	/// Handles refreshing of LEDs.
 	///
-	/// @param[in] ledValues The color per LED
+	/// @param[in] ledValues The color per LED, the frame is shared with the sender
+	/// @param[in] trace The stages passed by the source frame, with its capture time
 	/// @return Zero on success else negative (i.e. device is not ready)
 	///
-	virtual int updateLeds(std::vector<ColorRgb> ledValues);
+	virtual int updateLeds(const LedFrame& ledValues, const FrameTrace& trace);
+
+	///
+	/// @brief Hand over a new frame from the instance thread, thread safe.
+	///
+	/// The frame waits in a one slot mailbox for updateLeds in the device thread: a newer frame replaces
+	/// the waiting one (coalesced), so a slow device never works through a backlog of outdated colors.
+	///
+	/// @param[in] ledValues The color per LED, the frame is shared with the sender
+	/// @param[in] trace The stages passed by the source frame, with its capture time
+	///
+	void queueLeds(const LedFrame& ledValues, const FrameTrace& trace);
 
 	///
 	/// @brief Get the currently defined RefreshTime.
@@ -190,6 +217,11 @@ public slots:
 	///
 	QString getActiveDeviceType() const;
 
+	///
+	/// @brief The observed timing of the writes, shared with the smoothing of the instance
+	///
+	std::shared_ptr<WriteCadence> getWriteCadence() const;
+
 	///
 	/// @brief Get the LED-Device component's state.
 	///
@@ -245,6 +277,8 @@ signals:
 
 	void newCounter(PerformanceReport pr);
 
+	void ledsQueued();
+
 protected:
 
 	///
@@ -287,6 +321,21 @@ protected:
 	///
 	virtual int writeBlack(int numberOfBlack = 2);
 
+	///
+	/// @brief The protocol can show the colors already sent on a separate trigger (ex. E1.31 synchronization),
+	/// used by the shared presentation clock. Then write() keeps the colors for the trigger while _presentationSync is set.
+	///
+	/// @return True, if writeSyncTrigger is supported
+	///
+	virtual bool hasSyncTrigger() const { return false; }
+
+	///
+	/// @brief Shows the colors of the last write at once
+	///
+	/// @return Zero on success, else negative
+	///
+	virtual int writeSyncTrigger() { return 0; }
+
 	///
 	/// @brief Power-/turn on the LED-device.
 	///
@@ -356,13 +405,16 @@ protected:
 
 	/// Timer object which makes sure that LED data is written at a minimum rate
 	/// e.g. some devices will switch off when they do not receive data at least every 15 seconds
-	QTimer* _refreshTimer;
+	PreciseTimer* _refreshTimer;
 
 	// Device configuration parameters
 
 	/// Refresh interval in milliseconds
 	int _refreshTimerInterval_ms;
 
+	/// Refresh interval in milliseconds while the colors don't change, 0 = the normal refresh interval
+	int _idleRefreshInterval_ms;
+
 	/// Number of hardware LEDs supported by device.
 	uint _ledCount;
 	uint _ledRGBCount;
@@ -390,6 +442,9 @@ protected:
 	/// Is the device in error state and stopped?
 	bool _isDeviceInError;
 
+	/// Is the output paused by the light sleep of the system?
+	bool _isLightSleep;
+
 	bool	_retryMode;
 	int		_maxRetry;
 	int		_currentRetry;
@@ -405,6 +460,11 @@ protected slots:
 	///
 	int rewriteLEDs();
 
+	///
+	/// @brief Pass the frame waiting in the mailbox to updateLeds
+	///
+	void processQueuedLeds();
+
 	///
 	/// @brief Set device in error state
 	///
@@ -417,6 +477,16 @@ protected:
 	void disableDevice(bool toEmit);	
 	void startRefreshTimer();
 
+	/// for a device that sends in the background: write() only queues the frame, the end of the transfer is reported by writeCompleted()
+	void setAsyncWrites(bool asyncWrites);
+	void writeCompleted();
+
+	/// for a device that learns the delivery of its packets (ex. from the acknowledgements of the receiver): the loss counts for the adaptive refresh
+	void reportDeliveryLoss(int delivered, int lost);
+
+	/// the data packets of this write wait for writeSyncTrigger of the shared presentation clock
+	bool	_presentationSync;
+
 private:
 
 	/// @brief Stop refresh cycle
@@ -425,11 +495,72 @@ private:
 	/// Is last write refreshing enabled?
 	bool	_isRefreshEnabled;
 
+	/// the refresh timer runs at the idle interval, the time of the last change of the colors
+	bool	_isRefreshIdle;
+	int64_t _lastChangeTime;
+
 	bool	_newFrame2Send;
 	int64_t _newFrame2SendTime;
 
-	/// Last LED values written
-	std::vector<ColorRgb> _lastLedValues;
+	/// Last LED values written, shared with the sender of the frame (not modified in place)
+	LedFrame _lastLedValues;
+
+	/// one slot mailbox of queueLeds: the instance thread swaps in the newest frame, the device thread takes it out
+	struct PendingLeds
+	{
+		LedFrame	ledValues;
+		FrameTrace	trace;
+	};
+
+	std::atomic<PendingLeds*>	_ledMailbox;
+	/// frames replaced in the mailbox before the device thread took them
+	std::atomic<qint64>			_coalescedFrames;
+
+	/// Trace of the source frame of the last LED values, the capture time and the adjustment stage of the last measured write
+	FrameTrace	_lastLedTrace;
+	qint64	_measuredTimestamp;
+	int64_t	_measuredTrace;
+
+	/// adapts the refresh interval to the measured write capacity of the device
+	void adaptRefreshTime(int writeResult);
+
+	/// the refresh interval follows the duration and the errors of the writes within these bounds [ms]
+	bool	_adaptiveRefresh;
+	int		_adaptiveRefreshMin_ms;
+	int		_adaptiveRefreshMax_ms;
+
+	struct
+	{
+		qint64	windowBegin = 0;
+		int		writes = 0;
+		int		errors = 0;
+		/// packets reported by reportDeliveryLoss
+		int		delivered = 0;
+		int		lost = 0;
+		/// windows after a slowdown before the interval may be shortened again
+		int		hold = 0;
+	} _adaptive;
+
+	/// adds the stages of the first write of a frame to the distributions
+	void addTrace(const FrameTrace& trace);
+	QString traceToString() const;
+
+	/// latency of every stage of the pipeline since the previous stage that the frame passed, and of the whole pipeline
+	std::vector<LatencyHistogram> _stageLatency;
+	LatencyHistogram _pipelineLatency;
+
+	/// glass-to-wire latency of the current statistics period
+	LatencyHistogram _latency;
+
+	/// wall time of the write() calls of the current statistics period, 100us resolution
+	LatencyHistogram _writeTime;
+
+	/// updated by every write of the last colors, read by the instance thread
+	std::shared_ptr<WriteCadence> _writeCadence;
+	bool	_asyncWrites;
+
+	/// the SMOOTHED stamp of the last frame presented by the shared clock
+	int64_t	_presentedTrace;
 
 	struct
 	{
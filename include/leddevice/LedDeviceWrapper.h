@@ -4,10 +4,14 @@
 // util
 #include <utils/Logger.h>
 #include <utils/ColorRgb.h>
+#include <utils/LedFramePool.h>
 #include <utils/Components.h>
+#include <utils/WriteCadence.h>
 
 #include <QMutex>
 
+#include <memory>
+
 class LedDevice;
 class HyperHdrInstance;
 
@@ -61,9 +65,22 @@ public:
 	///
 	unsigned int getLedCount() const;
 
+	///
+	/// @brief The write timing of the current device, nullptr without a device
+	///
+	std::shared_ptr<WriteCadence> getWriteCadence() const;
+
 	void identifyLed(const QJsonObject& params);
 
 public slots:
+	///
+	/// @brief Hand over new colors to the device thread, called from the instance thread
+	///
+	/// @param[in] ledValues  The RGB-color per led
+	/// @param[in] trace      The stages passed by the source frame, with its capture time
+	///
+	void updateLeds(const LedFrame& ledValues, const FrameTrace& trace);
+
 	///
 	/// @brief Handle new component state request
 	/// @param component  The comp from enum
@@ -72,15 +89,6 @@ public slots:
 	void handleComponentState(hyperhdr::Components component, bool state);
 
 signals:
-	///
-	/// PIPER signal for Hyperhdr -> LedDevice
-	///
-	/// @param[in] ledValues  The RGB-color per led
-	///
-	/// @return Zero on success else negative
-	///
-	int updateLeds(std::vector<ColorRgb> ledValues);	
-
 	void stopLedDevice();
 
 private slots:
@@ -109,6 +117,8 @@ private:
 	HyperHdrInstance* _hyperhdr;
 	// Pointer of current led device
 	LedDevice*		  _ledDevice;
+	// Write timing of the current led device
+	std::shared_ptr<WriteCadence> _writeCadence;
 	// the enable state
 	bool              _enabled;
 };
@@ -11,6 +11,8 @@
 #include <utils/settings.h>
 #include <qmqtt.h>
 
+class JsonAPI;
+
 class mqtt : public QObject
 {
 	Q_OBJECT
@@ -31,13 +33,17 @@ private slots:
 	void error(const QMQTT::ClientError error);
 	void received(const QMQTT::Message& message);
 
-signals:
-	void jsonCommander(QString command);
+	///
+	/// @brief Publish a reply of the JSON API to the response topic
+	///
+	void publishReply(QJsonObject reply);
 
 private:
 
 	/// Logger instance
-	int			_jsonPort;
 	Logger*		_log;
 	QMQTT::Client*	_clientInstance;
+
+	/// the commands are handled in the process, the replies come back with callbackMessage
+	JsonAPI*	_jsonAPI;
 };
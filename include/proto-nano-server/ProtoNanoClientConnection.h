@@ -34,6 +34,7 @@
 #include <utils/Image.h>
 #include <utils/ColorRgb.h>
 #include <utils/Components.h>
+#include <utils/FrameRing.h>
 
 
 class QTcpSocket;
@@ -105,6 +106,18 @@ private slots:
 	void disconnected();
 
 private:
+	///
+	/// @brief The destination of the image data: a frame of the ring sized from the width and height fields,
+	/// which precede the data in the message, so the pixels are decoded straight into it
+	///
+	struct ImageTarget
+	{
+		FrameRing*					ring;
+		const proto_ImageRequest*	request;
+		Image<ColorRgb>				image;
+		bool						sizeMismatch;
+	};
+
 	void handleImageCommand(const proto_ImageRequest& message, Image<ColorRgb>& image);
 
 	void handleClearCommand(const proto_ClearRequest& message);
@@ -130,4 +143,5 @@ private:
 	int			_timeout;
 	int			_priority;
 	QByteArray	_receiveBuffer;
+	FrameRing	_frameRing;
 };
@@ -0,0 +1,56 @@
+#pragma once
+
+/* Base64.h
+*
+*  MIT License
+*
+*  Copyright (c) 2023 awawa-dev
+*
+*  Project homesite: https://github.com/awawa-dev/HyperHDR
+*
+*  Permission is hereby granted, free of charge, to any person obtaining a copy
+*  of this software and associated documentation files (the "Software"), to deal
+*  in the Software without restriction, including without limitation the rights
+*  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+*  copies of the Software, and to permit persons to whom the Software is
+*  furnished to do so, subject to the following conditions:
+*
+*  The above copyright notice and this permission notice shall be included in all
+*  copies or substantial portions of the Software.
+
+*  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+*  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+*  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+*  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+*  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+*  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+*  SOFTWARE.
+*/
+
+#include <QString>
+
+#include <cstdint>
+
+///
+/// Strict base64 decoder for the image data of the JSON API: it reads the UTF-16 characters of the
+/// message string directly and writes the bytes to the final buffer, without the intermediate copies of
+/// QByteArray::fromBase64. Only the padded form without whitespace is accepted, the caller falls back to
+/// QByteArray::fromBase64 for anything else.
+///
+namespace Base64
+{
+	///
+	/// @brief The size of the decoded data
+	/// @param encoded  The base64 string
+	/// @return The number of bytes, -1 if the length or the padding is not the strict form
+	///
+	int decodedSize(const QString& encoded);
+
+	///
+	/// @brief Decodes the base64 string
+	/// @param encoded  The base64 string
+	/// @param target   The buffer of decodedSize(encoded) bytes
+	/// @return false on a character that is not base64, the target is then partly written
+	///
+	bool decode(const QString& encoded, uint8_t* target);
+}
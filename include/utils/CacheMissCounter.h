@@ -0,0 +1,29 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+
+///
+/// Measures the CPU cache misses of the calling thread in its scope (Linux perf events) and accumulates them process-wide.
+/// Used to compare the LUT memory layouts on the target hardware. Does nothing when perf events are not available
+/// (other systems, or restricted by kernel.perf_event_paranoid).
+///
+class CacheMissCounter
+{
+public:
+	CacheMissCounter();
+	~CacheMissCounter();
+
+	///
+	/// Returns the average number of the cache misses per measured scope since the previous call and resets the statistics
+	/// @return false if nothing was measured
+	///
+	static bool takeAverage(uint64_t& average);
+
+private:
+	int			_fd;
+
+	static std::atomic<bool>		_available;
+	static std::atomic<uint64_t>	_misses;
+	static std::atomic<uint64_t>	_samples;
+};
@@ -0,0 +1,65 @@
+#pragma once
+
+#include <QThread>
+#include <QMutex>
+#include <QWaitCondition>
+#include <QFile>
+#include <QByteArray>
+
+#include <atomic>
+#include <vector>
+
+#include <utils/Logger.h>
+#include <utils/PixelFormat.h>
+
+///
+/// Records the raw buffers of a video grabber (see CaptureRecording.h) for the "replay" grabber.
+/// The capture thread only copies the buffer, the file is written by this thread: when the disk does not
+/// keep up the frames are dropped, so the recording never slows down the capture.
+///
+class CaptureRecorder : public QThread
+{
+public:
+	CaptureRecorder(Logger* log);
+	~CaptureRecorder() override;
+
+	///
+	/// @brief Start a recording, a running one is finished first
+	/// @param fileName   The recording
+	/// @param maxFrames  The recording is finished after this number of frames
+	/// @return Empty on success, else the reason
+	///
+	QString start(const QString& fileName, int maxFrames);
+
+	///
+	/// @brief Write the queued frames and close the recording
+	///
+	void stop();
+
+	bool isActive() const
+	{
+		return _active.load(std::memory_order_relaxed);
+	}
+
+	///
+	/// @brief Queue a buffer of the driver, it is copied
+	///
+	void record(PixelFormat pixelFormat, int width, int height, int lineLength, const uint8_t* data, int size);
+
+private:
+	void run() override;
+
+	Logger*				_log;
+	std::atomic<bool>	_active;
+	QMutex				_mutex;
+	QWaitCondition		_condition;
+	QFile				_file;
+	std::vector<QByteArray> _pending;
+	int					_maxFrames;
+	qint64				_frames;
+	qint64				_dropped;
+	qint64				_bytes;
+	int64_t				_firstFrameTime;
+	bool				_finishing;
+	bool				_failed;
+};
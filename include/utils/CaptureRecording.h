@@ -0,0 +1,70 @@
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+
+/**
+ * Raw capture recording, written by CaptureRecorder from the buffers of the video grabbers and played
+ * back by the "replay" grabber.
+ *
+ * The file is a Header followed by records of variable size, so it is read sequentially: a Record with
+ * the time of the frame [ns] since the first frame, the pixel format (PixelFormat value) and the geometry
+ * reported by the driver, then the raw buffer padded to 8 bytes.
+ * All values are little endian (the byte order of the supported targets).
+ */
+namespace CaptureRecording
+{
+	constexpr char     MAGIC[8] = { 'H', 'H', 'D', 'R', 'R', 'A', 'W', 'V' };
+	constexpr uint32_t VERSION = 1;
+
+	/// the largest accepted buffer: 8K at 4 bytes per pixel
+	constexpr uint32_t MAX_FRAME_SIZE = 7680 * 4320 * 4;
+
+	struct Header
+	{
+		char     magic[8];
+		uint32_t version;
+		uint32_t reserved;
+		/// wall clock time of the first frame [ms since epoch]
+		int64_t  startTime;
+	};
+
+	struct Record
+	{
+		int64_t  time;
+		uint32_t pixelFormat;
+		uint32_t width;
+		uint32_t height;
+		uint32_t lineLength;
+		uint32_t size;
+		uint32_t reserved;
+	};
+
+	static_assert(sizeof(Header) == 24, "unexpected padding of the recording header");
+	static_assert(sizeof(Record) == 32, "unexpected padding of the recording record");
+
+	inline size_t paddedSize(uint32_t size)
+	{
+		return (static_cast<size_t>(size) + 7) & ~static_cast<size_t>(7);
+	}
+
+	inline Header makeHeader(int64_t startTime)
+	{
+		Header header;
+		memcpy(header.magic, MAGIC, sizeof(MAGIC));
+		header.version = VERSION;
+		header.reserved = 0;
+		header.startTime = startTime;
+		return header;
+	}
+
+	inline bool isValid(const Header& header)
+	{
+		return memcmp(header.magic, MAGIC, sizeof(MAGIC)) == 0 && header.version == VERSION;
+	}
+
+	inline bool isValid(const Record& record)
+	{
+		return record.width > 0 && record.height > 0 && record.size > 0 && record.size <= MAX_FRAME_SIZE && record.time >= 0;
+	}
+}
@@ -3,6 +3,7 @@
 // STL includes
 #include <cstdint>
 #include <iostream>
+#include <vector>
 #include <utils/ColorRgb.h>
 #include <QString>
 
@@ -93,4 +94,7 @@ namespace RGBW {
 
 	WhiteAlgorithm stringToWhiteAlgorithm(const QString& str);
 	void Rgb_to_Rgbw(ColorRgb input, ColorRgbw* output, WhiteAlgorithm algorithm);
+
+	/// the whole buffer at once, the output is resized to the input
+	void Rgb_to_Rgbw(const std::vector<ColorRgb>& input, std::vector<ColorRgbw>& output, WhiteAlgorithm algorithm);
 }
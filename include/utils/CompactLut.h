@@ -0,0 +1,105 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+///
+/// Compact replacement for the full 256x256x256 LUT (LUT_FILE_SIZE bytes).
+/// The table is resampled to a small 3D grid and every lookup is tetrahedral-interpolated in fixed point.
+/// Coordinates follow the order of LUT_INDEX: the first one is the fastest changing axis of the full table.
+///
+class CompactLut
+{
+public:
+	static const int DEFAULT_GRID = 33;
+	static const int MIN_GRID = 9;
+	static const int MAX_GRID = 129;
+
+	CompactLut();
+
+	///
+	/// Builds the grid from the full LUT table
+	/// @param lutBuffer  The full table (LUT_FILE_SIZE bytes)
+	/// @param gridSize   Number of nodes per axis
+	/// @return true if the grid has been built
+	///
+	bool build(const uint8_t* lutBuffer, int gridSize = DEFAULT_GRID);
+
+	///
+	/// Builds the grid from the conversion itself, only the nodes are evaluated (ex. the internal YUV to RGB table)
+	/// @param sample     Writes the RGB color of the input coordinates in the order of LUT_INDEX
+	/// @param gridSize   Number of nodes per axis
+	/// @return true if the grid has been built
+	///
+	bool build(const std::function<void(uint8_t x, uint8_t y, uint8_t z, uint8_t* rgb)>& sample, int gridSize = DEFAULT_GRID);
+
+	void clear();
+
+	bool isValid() const;
+
+	int gridSize() const;
+
+	size_t memorySize() const;
+
+	static bool isSupportedGrid(int gridSize);
+
+	inline void lookup(uint8_t x, uint8_t y, uint8_t z, uint8_t* rgb) const
+	{
+		uint32_t fx = _frac[x], fy = _frac[y], fz = _frac[z];
+		const uint8_t* c000 = &_table[_offsetX[x] + _offsetY[y] + _offsetZ[z]];
+		const uint8_t *c1, *c2;
+		uint32_t w0, w1, w2, w3;
+
+		if (fx >= fy)
+		{
+			if (fy >= fz)
+			{
+				c1 = c000 + _strideX; c2 = c1 + _strideY;
+				w0 = 256 - fx; w1 = fx - fy; w2 = fy - fz; w3 = fz;
+			}
+			else if (fx >= fz)
+			{
+				c1 = c000 + _strideX; c2 = c1 + _strideZ;
+				w0 = 256 - fx; w1 = fx - fz; w2 = fz - fy; w3 = fy;
+			}
+			else
+			{
+				c1 = c000 + _strideZ; c2 = c1 + _strideX;
+				w0 = 256 - fz; w1 = fz - fx; w2 = fx - fy; w3 = fy;
+			}
+		}
+		else
+		{
+			if (fz >= fy)
+			{
+				c1 = c000 + _strideZ; c2 = c1 + _strideY;
+				w0 = 256 - fz; w1 = fz - fy; w2 = fy - fx; w3 = fx;
+			}
+			else if (fz >= fx)
+			{
+				c1 = c000 + _strideY; c2 = c1 + _strideZ;
+				w0 = 256 - fy; w1 = fy - fz; w2 = fz - fx; w3 = fx;
+			}
+			else
+			{
+				c1 = c000 + _strideY; c2 = c1 + _strideX;
+				w0 = 256 - fy; w1 = fy - fx; w2 = fx - fz; w3 = fz;
+			}
+		}
+
+		const uint8_t* c111 = c000 + _strideX + _strideY + _strideZ;
+
+		rgb[0] = uint8_t((w0 * c000[0] + w1 * c1[0] + w2 * c2[0] + w3 * c111[0] + 128) >> 8);
+		rgb[1] = uint8_t((w0 * c000[1] + w1 * c1[1] + w2 * c2[1] + w3 * c111[1] + 128) >> 8);
+		rgb[2] = uint8_t((w0 * c000[2] + w1 * c1[2] + w2 * c2[2] + w3 * c111[2] + 128) >> 8);
+	}
+
+private:
+	std::vector<uint8_t> _table;
+	int			_gridSize;
+	uint32_t	_strideX, _strideY, _strideZ;
+	uint32_t	_offsetX[256], _offsetY[256], _offsetZ[256];
+	uint16_t	_frac[256];
+};
@@ -0,0 +1,83 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+
+#include <QJsonObject>
+#include <QString>
+
+/**
+ * Recorder of the begin/end events of the pipeline (capture workers, instance threads, smoothing ticks, LED device
+ * writes) for a Chrome trace (chrome://tracing, ui.perfetto.dev). The events are written to a ring preallocated
+ * by start(), so a long session keeps only the newest ones. When the recorder is stopped an instrumented scope
+ * costs one load of the flag and a branch.
+ * The names of the events are not copied: use string literals.
+ */
+class EventTracer
+{
+public:
+	static constexpr int DEFAULT_CAPACITY = 1 << 18;
+
+	///
+	/// @brief Start a new recording, the ring is allocated once with the capacity of the first start
+	/// @return the capacity of the ring [events]
+	///
+	static int start(int capacity = DEFAULT_CAPACITY);
+
+	static void stop();
+
+	static inline bool isEnabled()
+	{
+		return _enabled.load(std::memory_order_acquire);
+	}
+
+	///
+	/// @brief Record an event of the current thread
+	/// @param phase 'B' begin, 'E' end, 'i' instant
+	/// @param name  A string literal
+	/// @param argument An optional value shown with the event (ex. the frame number), negative when not used
+	///
+	static void record(char phase, const char* name, int64_t argument = -1);
+
+	///
+	/// @brief The recorded events in the Chrome trace event format, with the names of the threads
+	///
+	static QJsonObject toChromeTrace();
+
+	static QString getStats();
+
+private:
+	static std::atomic<bool> _enabled;
+};
+
+class EventTraceScope
+{
+public:
+	explicit EventTraceScope(const char* name, int64_t argument = -1)
+		: _name(EventTracer::isEnabled() ? name : nullptr)
+	{
+		if (_name != nullptr)
+			EventTracer::record('B', _name, argument);
+	}
+
+	~EventTraceScope()
+	{
+		if (_name != nullptr)
+			EventTracer::record('E', _name);
+	}
+
+	EventTraceScope(const EventTraceScope&) = delete;
+	EventTraceScope& operator=(const EventTraceScope&) = delete;
+
+private:
+	const char* _name;
+};
+
+#define TRACE_EVENT_JOIN2(a, b) a##b
+#define TRACE_EVENT_JOIN(a, b) TRACE_EVENT_JOIN2(a, b)
+
+// traces the rest of the enclosing scope
+#define TRACE_SCOPE(name) EventTraceScope TRACE_EVENT_JOIN(_traceScope, __LINE__)(name)
+#define TRACE_SCOPE_ARG(name, argument) EventTraceScope TRACE_EVENT_JOIN(_traceScope, __LINE__)(name, static_cast<int64_t>(argument))
+
+#define TRACE_INSTANT(name) { if (EventTracer::isEnabled()) EventTracer::record('i', name); }
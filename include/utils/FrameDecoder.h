@@ -1,12 +1,26 @@
 #pragma once
 
+#include <QRectF>
+
 #include <utils/PixelFormat.h>
 #include <utils/Image.h>
 #include <utils/ColorRgb.h>
+#include <utils/CompactLut.h>
+#include <HyperhdrConfig.h>
 
 
 // some stuff for HDR tone mapping
-#define LUT_INDEX(y,u,v) ((y + (u<<8) + (v<<16))*3)
+// the layout of lut_lin_tables.3d: y is the fastest changing coordinate
+#define LUT_LINEAR_INDEX(y,u,v) ((y + (u<<8) + (v<<16))*3)
+
+#ifdef USE_BLOCKED_LUT
+	// cache-blocked in-memory layout of 16x16x16 bricks: the low nibbles of y, u, v address the entry inside the brick
+	// and the high nibbles select the brick, so the chroma changes within a scanline stay in the same few kilobytes
+	#define LUT_BLOCKED(i) (((i) & 0xF0000F) | (((i) & 0xF00) >> 4) | (((i) & 0xF0000) >> 8) | (((i) & 0xF0) << 8) | (((i) & 0xF000) << 4))
+	#define LUT_INDEX(y,u,v) (LUT_BLOCKED((y) + ((u)<<8) + ((v)<<16))*3)
+#else
+	#define LUT_INDEX(y,u,v) LUT_LINEAR_INDEX(y,u,v)
+#endif
 
 class FrameDecoder
 {
@@ -14,32 +28,69 @@ public:
 	static void processImage(
 		int _cropLeft, int _cropRight, int _cropTop, int _cropBottom,
 		const uint8_t* data, int width, int height, int lineLength,
-		const PixelFormat pixelFormat, const uint8_t* lutBuffer, Image<ColorRgb>& outputImage);
+		const PixelFormat pixelFormat, const uint8_t* lutBuffer, Image<ColorRgb>& outputImage,
+		const CompactLut* compactLut = nullptr);
+
+	static void processImageDownscaled(
+		int _cropLeft, int _cropRight, int _cropTop, int _cropBottom,
+		const uint8_t* data, int width, int height, int lineLength,
+		const PixelFormat pixelFormat, const uint8_t* lutBuffer, int factor, Image<ColorRgb>& outputImage,
+		const CompactLut* compactLut = nullptr);
+
+	// decodes like processImageDownscaled but leaves the skipped area (relative to the cropped frame) untouched,
+	// one pixel of margin absorbs the rounding of the led areas
+	static void processImageRegion(
+		int _cropLeft, int _cropRight, int _cropTop, int _cropBottom,
+		const uint8_t* data, int width, int height, int lineLength,
+		const PixelFormat pixelFormat, const uint8_t* lutBuffer, int factor,
+		const QRectF& skippedArea, Image<ColorRgb>& outputImage,
+		const CompactLut* compactLut = nullptr);
+
+	static int getDownscaleFactor(int width, int height, int targetWidth, bool qframe);
+
+	// returns the denominator of the libjpeg-turbo scaling factor (1, 2, 4 or 8), requestedScale = 0 selects it from the target width
+	static int getMjpegScale(int width, int height, int targetWidth, bool qframe, int requestedScale);
+
+	// decodes the output rows [firstRow, lastRow) of an already sized image, the format and the LUT are validated by the caller
+	static void processImageRows(
+		int _cropLeft, int _cropTop,
+		const uint8_t* data, int height, int lineLength,
+		const PixelFormat pixelFormat, const uint8_t* lutBuffer, Image<ColorRgb>& outputImage,
+		int firstRow, int lastRow, const CompactLut* compactLut = nullptr);
 
 	static void processQImage(
 		const uint8_t* data, int width, int height, int lineLength,
-		const PixelFormat pixelFormat, const uint8_t* lutBuffer, Image<ColorRgb>& outputImage);
+		const PixelFormat pixelFormat, const uint8_t* lutBuffer, Image<ColorRgb>& outputImage,
+		const CompactLut* compactLut = nullptr);
 
 	static void processSystemImageBGRA(Image<ColorRgb>& image, int targetSizeX, int targetSizeY,
 									   int startX, int startY,
 									   uint8_t* source, int _actualWidth, int _actualHeight,
-									   int division, uint8_t* _lutBuffer, int lineSize = 0);
+									   int division, const uint8_t* _lutBuffer, int lineSize = 0);
 
 	static void processSystemImageBGR(Image<ColorRgb>& image, int targetSizeX, int targetSizeY,
 										int startX, int startY,
 										uint8_t* source, int _actualWidth, int _actualHeight,
-										int division, uint8_t* _lutBuffer, int lineSize = 0);
+										int division, const uint8_t* _lutBuffer, int lineSize = 0);
 
 	static void processSystemImageBGR16(Image<ColorRgb>& image, int targetSizeX, int targetSizeY,
 										int startX, int startY,
 										uint8_t* source, int _actualWidth, int _actualHeight,
-										int division, uint8_t* _lutBuffer, int lineSize = 0);
+										int division, const uint8_t* _lutBuffer, int lineSize = 0);
 
 	static void processSystemImageRGBA(Image<ColorRgb>& image, int targetSizeX, int targetSizeY,
 									   int startX, int startY,
 									   uint8_t* source, int _actualWidth, int _actualHeight,
-									   int division, uint8_t* _lutBuffer, int lineSize = 0);
+									   int division, const uint8_t* _lutBuffer, int lineSize = 0);
+
+	static void applyLUT(uint8_t* _source, unsigned int width, unsigned int height, const uint8_t* lutBuffer, const int _hdrToneMappingEnabled,
+		const CompactLut* compactLut = nullptr);
+
+	static const char* getSimdKernelName();
+
+	static const char* getLutLayoutName();
 
-	static void applyLUT(uint8_t* _source, unsigned int width, unsigned int height, const uint8_t* lutBuffer, const int _hdrToneMappingEnabled);
+	// copies a table section of lut_lin_tables.3d (256x256x256x3 bytes) to the in-memory layout used by LUT_INDEX
+	static void convertLinearLut(const uint8_t* linear, uint8_t* dest);
 };
 
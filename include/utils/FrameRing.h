@@ -0,0 +1,40 @@
+#pragma once
+
+#include <vector>
+
+#include <QString>
+#include <QMutex>
+
+#include <utils/ColorRgb.h>
+#include <utils/Image.h>
+
+// slots kept busy by the consumers: queued signals, PriorityMuxer, ImageProcessingUnit, LED streaming
+#define FrameRingConsumerSlots 6
+
+/**
+ * Fixed ring of preallocated capture frames. A slot is free when the ring holds the only reference to its
+ * image: the atomic refcount of the shared image data drops when the last consumer (PriorityMuxer,
+ * ImageProcessingUnit...) replaces the frame, so nothing has to be returned explicitly. When every slot
+ * is still in use the caller gets a new image and the stall is recorded.
+ */
+class FrameRing
+{
+public:
+	FrameRing();
+
+	void init(int slots);
+	void clear();
+
+	Image<ColorRgb> acquire(unsigned width, unsigned height);
+
+	QString getStats();
+
+private:
+	QMutex  _mutex;
+	std::vector<Image<ColorRgb>> _slots;
+	size_t   _next;
+	uint64_t _acquired;
+	uint64_t _stalls;
+	uint64_t _occupancy;
+	int      _peakOccupancy;
+};
@@ -0,0 +1,57 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+
+/**
+ * The moments a frame passed the stages of the pipeline, carried with the frame from the grabber to the LED device
+ * that collects the latency of every stage. A stamp is in microseconds of the steady clock (the clock of PreciseTimer),
+ * 0 when the frame didn't pass the stage (ex. the colors of an effect were never captured or decoded).
+ */
+struct FrameTrace
+{
+	enum Stage
+	{
+		/// the frame was taken from the capture device
+		DEQUEUED = 0,
+		/// the frame was decoded to RGB
+		DECODED,
+		/// accepted for the visible priority and queued for the mapping
+		QUEUED,
+		/// mapped to the colors of the LEDs (ImageProcessingUnit::processImage)
+		MAPPED,
+		/// the adjustments were applied (HyperHdrInstance::updateResult)
+		ADJUSTED,
+		/// handed over to the LED device, after the smoothing when it is enabled
+		SMOOTHED,
+		WRITE_BEGIN,
+		WRITE_END,
+		STAGES
+	};
+
+	/// capture time of the source frame (InternalClock::now), 0 if unknown: the glass-to-wire latency is measured from it
+	int64_t timestamp;
+	int64_t stamps[STAGES];
+
+	FrameTrace() : timestamp(0)
+	{
+		for (int64_t& stamp : stamps)
+			stamp = 0;
+	}
+
+	void mark(Stage stage)
+	{
+		stamps[stage] = now();
+	}
+
+	static int64_t now()
+	{
+		return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+	}
+
+	static const char* stageName(int stage)
+	{
+		static const char* names[STAGES] = { "dequeue", "decode", "queue", "mapping", "adjustment", "smoothing", "write begin", "write" };
+		return (stage >= 0 && stage < STAGES) ? names[stage] : "unknown";
+	}
+};
@@ -7,6 +7,28 @@
 
 // qt
 #include <QObject>
+#include <QRectF>
+#include <QMutex>
+#include <QList>
+#include <QMap>
+
+///
+/// The global input signals of one instance. The network sources don't broadcast their images to all the instances:
+/// GlobalSignals emits them only on the channels of the instances that the source targets.
+///
+class GlobalInputChannel : public QObject
+{
+	Q_OBJECT
+
+public:
+	explicit GlobalInputChannel(QObject* parent = nullptr) : QObject(parent) {}
+
+signals:
+	void registerGlobalInput(int priority, hyperhdr::Components component, const QString& origin, const QString& owner, unsigned smooth_cfg);
+	void clearGlobalInput(int priority, bool forceClearAll);
+	void setGlobalImage(int priority, const Image<ColorRgb>& image, int timeout_ms, bool clearEffect);
+	void setGlobalColor(int priority, const std::vector<ColorRgb>& ledColor, int timeout_ms, const QString& origin, bool clearEffects);
+};
 
 ///
 /// Singleton instance for simple signal sharing across threads, should be never used with Qt:DirectConnection!
@@ -28,6 +50,47 @@ public:
 	GlobalSignals(GlobalSignals const&) = delete;
 	void operator=(GlobalSignals const&) = delete;
 
+	///
+	/// @brief Set the instances that receive the global input of a source, thread safe
+	/// @param component  The source (ex. COMP_FLATBUFSERVER)
+	/// @param instances  The indexes of the target instances, empty for all instances
+	///
+	void setGlobalInputTargets(hyperhdr::Components component, const QList<int>& instances);
+
+	///
+	/// @brief Register the global input channel of an instance, thread safe
+	/// @param instance  The index of the instance
+	/// @param channel   The channel, connected to the instance with Qt::QueuedConnection
+	///
+	void subscribeGlobalInput(int instance, GlobalInputChannel* channel);
+
+	///
+	/// @brief Remove the channel of an instance, nothing is emitted on it after the return
+	/// @param instance  The index of the instance
+	/// @param channel   The channel registered by subscribeGlobalInput
+	///
+	void unsubscribeGlobalInput(int instance, GlobalInputChannel* channel);
+
+	///
+	/// @brief Deliver the global input of a source to its target instances, thread safe
+	///
+	/// Same parameters as the signals below that are emitted afterwards for the other listeners (ex. the LUT calibration).
+	/// @param component  The source of the input
+	///
+	void routeRegisterInput(int priority, hyperhdr::Components component, const QString& origin = "External", const QString& owner = "", unsigned smooth_cfg = 0);
+	void routeClearInput(hyperhdr::Components component, int priority, bool forceClearAll = false);
+	void routeImage(hyperhdr::Components component, int priority, const Image<ColorRgb>& image, int timeout_ms, bool clearEffect = true);
+	void routeColor(hyperhdr::Components component, int priority, const std::vector<ColorRgb>& ledColor, int timeout_ms, const QString& origin = "External", bool clearEffects = true);
+
+private:
+	/// the channels of the instances targeted by the source, call with the lock held
+	QList<GlobalInputChannel*> targetChannels(hyperhdr::Components component) const;
+
+	/// the emits on the channels only post the events: the lock keeps a channel alive until they are posted
+	QMutex _routeLock;
+	QMap<int, GlobalInputChannel*> _channels;
+	QMap<int, QList<int>> _targets;
+
 signals:
 	///////////////////////////////////////
 	////////////////// TO /////////////////
@@ -101,4 +164,18 @@ signals:
 	///
 	void requestSource(hyperhdr::Components component, int hyperHdrInd, bool listen);
 
+	///
+	/// @brief Tell the system and video grabbers which part of the frame the instance doesn't use
+	/// @param hyperhdrInd The HyperHDR instance index as identifier
+	/// @param unusedArea  The unused centre of the frame relative to its size, empty when the whole frame is needed
+	///
+	void requestCaptureRegion(int hyperHdrInd, const QRectF& unusedArea);
+
+	///
+	/// @brief The light sleep of the system: the grabbers stop their streams and the LED devices their output,
+	/// the instances, their mappings and LUTs, the opened devices stay as they are for a quick wake-up
+	/// @param sleep  True when the system goes to sleep, false when it wakes up
+	///
+	void lightSleep(bool sleep);
+
 };
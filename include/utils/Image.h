@@ -2,6 +2,7 @@
 
 #include <QExplicitlySharedDataPointer>
 #include <utils/ImageData.h>
+#include <utils/FrameTrace.h>
 
 template <typename ColorSpace>
 class Image
@@ -83,6 +84,47 @@ public:
 	///
 	void clear();
 
+	///
+	/// @return true if other Image instances point to the same data
+	///
+	bool isShared() const;
+
+	///
+	/// Capture time of the frame (InternalClock::now), 0 if unknown.
+	/// Shared with the other Image instances that point to the same data.
+	///
+	int64_t timestamp() const;
+
+	void setTimestamp(int64_t timestamp);
+
+	///
+	/// @brief Set the capture stages of the trace (FrameTrace::now), shared like the timestamp
+	/// @param dequeued  The frame was taken from the capture device
+	/// @param decoded   The frame was decoded
+	///
+	void setCaptureTrace(int64_t dequeued, int64_t decoded);
+
+	///
+	/// @return A new trace of the frame with its timestamp and capture stages
+	///
+	FrameTrace trace() const;
+
+	///
+	/// The HDR tone mapping of the source that is applied to the LED colors instead of the pixels,
+	/// nullptr if the pixels are already final. Shared like the timestamp.
+	///
+	const std::shared_ptr<const LutSnapshot>& deferredToneMapping() const;
+
+	void setDeferredToneMapping(const std::shared_ptr<const LutSnapshot>& lut);
+
+	///
+	/// The reduced copies of the frame built by ImagePyramid::attach, nullptr if there are none.
+	/// Shared like the timestamp.
+	///
+	const std::shared_ptr<const ImagePyramid>& pyramid() const;
+
+	void setPyramid(const std::shared_ptr<const ImagePyramid>& pyramid);
+
 private:
 	QExplicitlySharedDataPointer<ImageData<ColorSpace>>  _d_ptr;
 };
@@ -7,6 +7,11 @@
 // QT includes
 #include <QSharedData>
 
+#include <memory>
+
+class LutSnapshot;
+class ImagePyramid;
+
 #if defined(_MSC_VER)
 	#include <BaseTsd.h>
 	typedef SSIZE_T ssize_t;
@@ -45,6 +50,24 @@ public:
 
 	void clear();
 
+	int64_t timestamp() const;
+
+	void setTimestamp(int64_t timestamp);
+
+	int64_t dequeuedTime() const;
+
+	int64_t decodedTime() const;
+
+	void setCaptureTrace(int64_t dequeued, int64_t decoded);
+
+	const std::shared_ptr<const LutSnapshot>& deferredToneMapping() const;
+
+	void setDeferredToneMapping(const std::shared_ptr<const LutSnapshot>& lut);
+
+	const std::shared_ptr<const ImagePyramid>& pyramid() const;
+
+	void setPyramid(const std::shared_ptr<const ImagePyramid>& pyramid);
+
 	bool checkSignal(int x, int y, int r, int g, int b, int tolerance);
 
 	void fastBox(uint16_t x1, uint16_t y1, uint16_t x2, uint16_t y2, uint8_t r, uint8_t g, uint8_t b);
@@ -75,5 +98,18 @@ private:
 
 	size_t   _bufferSize;
 
+	/// capture time of the frame (InternalClock::now), 0 if unknown
+	int64_t  _timestamp;
+
+	/// the capture stages of FrameTrace, 0 if unknown
+	int64_t  _dequeuedTime;
+	int64_t  _decodedTime;
+
+	/// the LUT that is still to be applied, to the LED colors, nullptr if the pixels are final
+	std::shared_ptr<const LutSnapshot> _deferredLut;
+
+	/// the reduced copies of the frame from ImagePyramid::attach, nullptr if there are none
+	std::shared_ptr<const ImagePyramid> _pyramid;
+
 	static VideoMemoryManager videoCache;
 };
@@ -0,0 +1,100 @@
+#pragma once
+
+/* ImageIngest.h
+*
+*  MIT License
+*
+*  Copyright (c) 2023 awawa-dev
+*
+*  Project homesite: https://github.com/awawa-dev/HyperHDR
+*
+*  Permission is hereby granted, free of charge, to any person obtaining a copy
+*  of this software and associated documentation files (the "Software"), to deal
+*  in the Software without restriction, including without limitation the rights
+*  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+*  copies of the Software, and to permit persons to whom the Software is
+*  furnished to do so, subject to the following conditions:
+*
+*  The above copyright notice and this permission notice shall be included in all
+*  copies or substantial portions of the Software.
+
+*  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+*  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+*  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+*  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+*  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+*  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+*  SOFTWARE.
+*/
+
+#include <QMutex>
+
+#include <map>
+#include <vector>
+
+#include <utils/Image.h>
+#include <utils/ColorRgb.h>
+#include <utils/CompactLut.h>
+#include <utils/LutRegistry.h>
+
+///
+/// Process-wide registry of the image size that the led mappings need. The network sources (flatbuffer,
+/// proto, JSON image) reduce a received image to it right away: the LUT, the muxer and the mapping work
+/// with the small image and a stored preview stays small too.
+///
+class ImageIngest
+{
+public:
+	/// the owner of the size that keeps the full frames, ex. the LUT calibration
+	static constexpr int FULL_FRAME_OWNER = -1;
+
+	/// the HDR tone mapping mode that maps the LED colors: the mean of the source pixels is tone mapped,
+	/// a small error of the mean-based mappings for a LUT that runs on a few hundred colors instead of the frame
+	static constexpr int LED_TONE_MAPPING = 3;
+
+	///
+	/// @brief Registers the size needed by an owner (the index of an instance)
+	/// @param owner   The owner
+	/// @param width   The width needed, 0 removes the owner
+	/// @param height  The height needed
+	///
+	static void setRequiredSize(int owner, int width, int height);
+
+	///
+	/// @brief The box filter factor for a received image, so it still covers the largest registered size
+	/// @return 1 for the full size
+	///
+	static int getFactor(int width, int height);
+
+	///
+	/// @brief Reduces a received RGB image by a box filter, the LUT is applied to the source pixels before they are averaged
+	/// @param source       The RGB data, width * height * 3 bytes
+	/// @param factor       The factor from getFactor
+	/// @param lutBuffer    The LUT of the HDR tone mapping
+	/// @param hdrToneMappingEnabled  The mode of the tone mapping, 0 = off
+	/// @param output       The result, already sized to width / factor x height / factor
+	///
+	static void reduce(const uint8_t* source, unsigned width, unsigned height, int factor, const uint8_t* lutBuffer, int hdrToneMappingEnabled,
+		const CompactLut* compactLut, Image<ColorRgb>& output);
+
+	///
+	/// @brief The same with the LUT of a source. In the LED_TONE_MAPPING mode the pixels are only reduced,
+	/// the LUT goes with the image and is applied to the LED colors by applyDeferred
+	///
+	static void reduce(const uint8_t* source, unsigned width, unsigned height, int factor, const LutHandle& lut, int hdrToneMappingEnabled,
+		Image<ColorRgb>& output);
+
+	///
+	/// @brief Applies the deferred tone mapping of the frame to its LED colors
+	///
+	static void applyDeferred(const Image<ColorRgb>& image, std::vector<ColorRgb>& colors);
+
+	///
+	/// @brief The frame as it's shown to the user: a tone mapped copy if the LUT was deferred, else the frame itself
+	///
+	static Image<ColorRgb> resolveDeferred(const Image<ColorRgb>& image);
+
+private:
+	static QMutex _locker;
+	static std::map<int, std::pair<int, int>> _sizes;
+};
@@ -0,0 +1,51 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <vector>
+
+#include <utils/Image.h>
+#include <utils/ColorRgb.h>
+
+///
+/// The frame reduced by 2, 4 and 8 (box filter), attached to the frame by the grabber wrappers and shared by
+/// all its consumers: the muxer preview, the image streams and the flatbuffer forwarding take the level that
+/// fits them instead of subsampling the full frame again. A level is only built while a consumer asked for it
+/// in the last seconds, a frame without its level is reduced by the consumer as before.
+///
+class ImagePyramid
+{
+public:
+	/// the levels 1/2, 1/4 and 1/8 of the frame
+	static constexpr int LEVELS = 3;
+
+	///
+	/// @brief Builds the levels that the consumers asked for recently and attaches them to the frame,
+	/// the 1/2 level is the only pass over the frame, the next ones are reduced from the previous level
+	/// @param image  The decoded frame, the copy of the handle shares the pyramid with the source
+	///
+	static void attach(const Image<ColorRgb>& image);
+
+	///
+	/// @brief The largest power of two of the factor that is available as a level of the frame
+	/// @param image   The frame
+	/// @param factor  The integer reduction the consumer needs, on return what remains to be applied to the result
+	/// @return The level or the frame itself
+	///
+	static Image<ColorRgb> level(const Image<ColorRgb>& image, int& factor);
+
+	ImagePyramid(const Image<ColorRgb>& image, int levels);
+
+	int levelCount() const;
+
+	/// @param level  1 for the half of the frame... up to levelCount()
+	const Image<ColorRgb>& get(int level) const;
+
+private:
+	static std::atomic<int64_t> _requested[LEVELS];
+
+	std::vector<Image<ColorRgb>> _levels;
+	int64_t		_timestamp;
+	unsigned	_width;
+	unsigned	_height;
+};
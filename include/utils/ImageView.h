@@ -0,0 +1,83 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <utils/Image.h>
+
+///
+/// Non-owning, read-only view of an image stored in a foreign buffer (flatbuffer payload, mmap'd capture buffer,
+/// mapped texture...) with arbitrary line and pixel strides. The line stride can be negative for bottom-up buffers:
+/// rawMem() always points to the first (top) row. The memory must outlive the view and use the ColorSpace byte order.
+///
+template <typename ColorSpace>
+class ImageView
+{
+public:
+	ImageView(const uint8_t* data, unsigned width, unsigned height, ptrdiff_t lineStride = 0, unsigned pixelStride = sizeof(ColorSpace)) :
+		_data(data),
+		_width(width),
+		_height(height),
+		_lineStride((lineStride != 0) ? lineStride : static_cast<ptrdiff_t>(width) * pixelStride),
+		_pixelStride(pixelStride)
+	{
+	}
+
+	ImageView(const Image<ColorSpace>& image) :
+		ImageView(image.rawMem(), image.width(), image.height())
+	{
+	}
+
+	unsigned width() const
+	{
+		return _width;
+	}
+
+	unsigned height() const
+	{
+		return _height;
+	}
+
+	ptrdiff_t lineStride() const
+	{
+		return _lineStride;
+	}
+
+	unsigned pixelStride() const
+	{
+		return _pixelStride;
+	}
+
+	/// true if the layout is the same as the one of Image<ColorSpace>
+	bool isPacked() const
+	{
+		return _pixelStride == sizeof(ColorSpace) && _lineStride == static_cast<ptrdiff_t>(_width) * _pixelStride;
+	}
+
+	const uint8_t* rawMem() const
+	{
+		return _data;
+	}
+
+	/// the lowest address of the view, it differs from rawMem() only for the negative line stride
+	const uint8_t* memoryBase() const
+	{
+		return (_lineStride < 0 && _height > 0) ? _data + (static_cast<ptrdiff_t>(_height) - 1) * _lineStride : _data;
+	}
+
+	const uint8_t* row(unsigned y) const
+	{
+		return _data + static_cast<ptrdiff_t>(y) * _lineStride;
+	}
+
+	const ColorSpace& operator()(unsigned x, unsigned y) const
+	{
+		return *reinterpret_cast<const ColorSpace*>(row(y) + static_cast<size_t>(x) * _pixelStride);
+	}
+
+private:
+	const uint8_t* _data;
+	unsigned       _width;
+	unsigned       _height;
+	ptrdiff_t      _lineStride;
+	unsigned       _pixelStride;
+};
@@ -0,0 +1,52 @@
+#pragma once
+
+#include <cstdint>
+
+#include <QString>
+#include <QJsonObject>
+
+// HDR-histogram style buckets: the values below 2 * LatencyHistogramSubBuckets are counted exactly, every
+// following power of two is split into LatencyHistogramSubBuckets buckets, so a percentile is at most ~3% too high
+#define LatencyHistogramSubBuckets 32
+#define LatencyHistogramBuckets (2 * LatencyHistogramSubBuckets + (31 - 6 + 1) * LatencyHistogramSubBuckets)
+
+/**
+ * Distribution of a latency (ex. the glass-to-wire latency from the capture of the frame to the moment its colors
+ * are written to the LED device) collected over one statistics period. Not thread-safe: owned by a single thread.
+ * The values are added and returned in the units of the resolution, ex. 100us for the duration of the writes.
+ * The tail is kept with the same relative precision as the common values, a stall of seconds is not clipped.
+ */
+class LatencyHistogram
+{
+public:
+	explicit LatencyHistogram(int resolution_us = 1000);
+
+	void add(int64_t latency);
+	void clear();
+
+	/// adds the values of other, a distribution of the same resolution
+	void merge(const LatencyHistogram& other);
+
+	uint64_t count() const;
+	double   average() const;
+	int      percentile(int percent) const;
+	int      maximum() const;
+	int      resolution() const;
+
+	QString  toString() const;
+
+	///
+	/// @brief The distribution for the performance reports: count, avg, p50, p90, p99 and max [ms]
+	///
+	QJsonObject toJson() const;
+
+private:
+	static int bucketIndex(uint32_t value);
+	static uint32_t bucketUpperBound(int index);
+
+	uint32_t _buckets[LatencyHistogramBuckets];
+	uint64_t _count;
+	uint64_t _sum;
+	int      _maximum;
+	int      _resolution_us;
+};
@@ -0,0 +1,29 @@
+#pragma once
+
+#include <memory>
+#include <vector>
+
+#include <utils/ColorRgb.h>
+
+/// The led colors handed over to the led device thread: the mailbox of the device holds only the reference
+typedef std::shared_ptr<const std::vector<ColorRgb>> LedFrame;
+
+/**
+ * Small pool of preallocated led frames, the same idea as FrameRing: a frame is free again when the pool
+ * holds the only reference to it, so the receiver doesn't have to return anything explicitly. In the steady
+ * state (the led device takes the frames as fast as they come) the hand over doesn't allocate.
+ * Not thread safe: the frames are made by the thread of the owner only.
+ */
+class LedFramePool
+{
+public:
+	LedFramePool();
+
+	LedFrame make(const std::vector<ColorRgb>& colors);
+
+private:
+	/// one frame on the way to the device, one kept by the device for the refresh and one spare
+	static constexpr size_t POOL_SIZE = 3;
+
+	std::vector<std::shared_ptr<std::vector<ColorRgb>>> _frames;
+};
@@ -0,0 +1,49 @@
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+
+/**
+ * Binary LED frame recording, written by the "recorder" LED device and played back by LedFrameReplay.
+ *
+ * The file is a Header followed by fixed size records, so a mapped file is indexed directly:
+ * record i starts at sizeof(Header) + i * recordSize(ledCount). A record is the time of the frame [ns]
+ * since the first frame of the recording, then the RGB bytes of all LEDs padded to 8 bytes.
+ * All values are little endian (the byte order of the supported targets).
+ */
+namespace LedFrameRecording
+{
+	constexpr char     MAGIC[8] = { 'H', 'H', 'D', 'R', 'L', 'E', 'D', 'S' };
+	constexpr uint32_t VERSION = 1;
+
+	struct Header
+	{
+		char     magic[8];
+		uint32_t version;
+		uint32_t ledCount;
+		/// wall clock time of the first frame [ms since epoch]
+		int64_t  startTime;
+	};
+
+	static_assert(sizeof(Header) == 24, "unexpected padding of the recording header");
+
+	inline size_t recordSize(uint32_t ledCount)
+	{
+		return sizeof(int64_t) + ((static_cast<size_t>(ledCount) * 3 + 7) & ~static_cast<size_t>(7));
+	}
+
+	inline Header makeHeader(uint32_t ledCount, int64_t startTime)
+	{
+		Header header;
+		memcpy(header.magic, MAGIC, sizeof(MAGIC));
+		header.version = VERSION;
+		header.ledCount = ledCount;
+		header.startTime = startTime;
+		return header;
+	}
+
+	inline bool isValid(const Header& header)
+	{
+		return memcmp(header.magic, MAGIC, sizeof(MAGIC)) == 0 && header.version == VERSION && header.ledCount > 0;
+	}
+}
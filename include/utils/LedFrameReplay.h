@@ -0,0 +1,90 @@
+#pragma once
+
+/* LedFrameReplay.h
+*
+*  MIT License
+*
+*  Copyright (c) 2023 awawa-dev
+*
+*  Project homesite: https://github.com/awawa-dev/HyperHDR
+*
+*  Permission is hereby granted, free of charge, to any person obtaining a copy
+*  of this software and associated documentation files (the "Software"), to deal
+*  in the Software without restriction, including without limitation the rights
+*  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+*  copies of the Software, and to permit persons to whom the Software is
+*  furnished to do so, subject to the following conditions:
+*
+*  The above copyright notice and this permission notice shall be included in all
+*  copies or substantial portions of the Software.
+
+*  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+*  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+*  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+*  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+*  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+*  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+*  SOFTWARE.
+*/
+
+// utils
+#include <utils/Logger.h>
+#include <utils/ColorRgb.h>
+
+// qt
+#include <QFile>
+
+#include <vector>
+
+class HyperHdrInstance;
+class QTimer;
+
+///
+/// Plays a recording of the "recorder" LED device (see LedFrameRecording.h) back as an input of the
+/// instance, so a captured session goes again through the smoothing and the LED device, optionally faster.
+/// The recording is mapped, a frame is only copied when it is sent; a late replay skips to the newest due frame.
+///
+class LedFrameReplay : public QObject
+{
+	Q_OBJECT
+
+public:
+	LedFrameReplay(HyperHdrInstance* hyperhdr, QObject* parent = nullptr);
+	~LedFrameReplay() override;
+
+	///
+	/// @brief Start the replay, a running one is stopped
+	/// @param fileName  The recording
+	/// @param speed     Factor of the recorded speed (0.1 - 10)
+	/// @param priority  The priority of the input
+	/// @return Empty on success, else the reason
+	///
+	QString start(const QString& fileName, double speed, int priority);
+
+	void stop();
+
+	bool isActive() const;
+
+private slots:
+	void playNext();
+
+private:
+	const uchar* record(qint64 index) const;
+	int64_t frameTime(qint64 index) const;
+
+	HyperHdrInstance*	_hyperhdr;
+	Logger*				_log;
+	QTimer*				_timer;
+	QFile				_file;
+	const uchar*		_data;
+	uint32_t			_ledCount;
+	size_t				_recordSize;
+	qint64				_frames;
+	qint64				_next;
+	double				_speed;
+	int					_priority;
+	int64_t				_startTime;
+	qint64				_played;
+	qint64				_skipped;
+	std::vector<ColorRgb>	_colors;
+};
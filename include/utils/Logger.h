@@ -2,6 +2,7 @@
 
 #include <utils/InternalClock.h>
 #include <utils/Macros.h>
+#include <utils/MemoryAccounting.h>
 
 // QT includes
 #include <QObject>
@@ -10,10 +11,12 @@
 #include <QAtomicInteger>
 #include <QList>
 #include <QMutex>
+#include <QReadWriteLock>
 
 // stl includes
 #include <stdio.h>
 #include <stdarg.h>
+#include <atomic>
 
 #ifdef _WIN32
 	#include <stdexcept>
@@ -21,7 +24,19 @@
 #define THREAD_ID QSTRING_CSTR(QString().asprintf("%p", QThread::currentThreadId()))
 
 #define QSTRING_CSTR(str) str.toLocal8Bit().constData()
-#define LOG_MESSAGE(severity, logger, ...)   (logger)->Message(severity, __FILE__, __FUNCTION__, __LINE__, __VA_ARGS__)
+
+// the lowest level that is compiled in, ex. -DLOG_COMPILE_MIN_LEVEL=2 removes all the Debug calls from the binary
+#ifndef LOG_COMPILE_MIN_LEVEL
+	#define LOG_COMPILE_MIN_LEVEL 1
+#endif
+
+// the level check is inlined: a disabled message costs one compare and its arguments are not evaluated
+#define LOG_MESSAGE(severity, logger, ...) \
+	do { \
+		auto _logTarget = (logger); \
+		if ((severity) >= LOG_COMPILE_MIN_LEVEL && _logTarget->isEnabled(severity)) \
+			_logTarget->Message(severity, __FILE__, __FUNCTION__, __LINE__, __VA_ARGS__); \
+	} while (0)
 
 // standard log messages
 #define Debug(logger, ...)   LOG_MESSAGE(Logger::DEBUG  , logger, __VA_ARGS__)
@@ -35,8 +50,68 @@
 #define WarningIf(condition, logger, ...) if (condition) Warning(logger, __VA_ARGS__)
 #define ErrorIf(condition, logger, ...)   if (condition) Error(logger,   __VA_ARGS__)
 
+// rate limited log messages for the per-frame paths: one message of the call site per LOG_THROTTLE_INTERVAL [ms],
+// the next one that passes tells how many were suppressed
+#define LOG_THROTTLE_INTERVAL 10000
+
+#define LOG_THROTTLED(severity, logger, ...) \
+	do { \
+		auto _logTarget = (logger); \
+		if ((severity) >= LOG_COMPILE_MIN_LEVEL && _logTarget->isEnabled(severity)) \
+		{ \
+			static LogThrottle _logThrottle; \
+			int _logSuppressed = 0; \
+			if (_logThrottle.allow(LOG_THROTTLE_INTERVAL, _logSuppressed)) \
+			{ \
+				if (_logSuppressed > 0) \
+					_logTarget->Message(severity, __FILE__, __FUNCTION__, __LINE__, "The next message was suppressed %d times in the last %d seconds", _logSuppressed, LOG_THROTTLE_INTERVAL / 1000); \
+				_logTarget->Message(severity, __FILE__, __FUNCTION__, __LINE__, __VA_ARGS__); \
+			} \
+		} \
+	} while (0)
+
+#define DebugThrottled(logger, ...)   LOG_THROTTLED(Logger::DEBUG  , logger, __VA_ARGS__)
+#define InfoThrottled(logger, ...)    LOG_THROTTLED(Logger::INFO   , logger, __VA_ARGS__)
+#define WarningThrottled(logger, ...) LOG_THROTTLED(Logger::WARNING, logger, __VA_ARGS__)
+#define ErrorThrottled(logger, ...)   LOG_THROTTLED(Logger::ERRORR , logger, __VA_ARGS__)
+
 // ================================================================
 
+///
+/// @brief The state of a rate limited call site, constant initialized so the static of the macro costs no guard
+///
+class LogThrottle
+{
+public:
+	constexpr LogThrottle() : _next(0), _suppressed(0) {}
+
+	///
+	/// @param interval     The minimum time between two messages [ms]
+	/// @param suppressed   The number of the messages suppressed since the previous one
+	/// @return true if the message can be written
+	///
+	bool allow(int interval, int& suppressed)
+	{
+		const qint64 now = InternalClock::now();
+		qint64 next = _next.load(std::memory_order_relaxed);
+
+		if (now < next || !_next.compare_exchange_strong(next, now + interval, std::memory_order_relaxed))
+		{
+			_suppressed.fetch_add(1, std::memory_order_relaxed);
+			return false;
+		}
+
+		suppressed = _suppressed.exchange(0, std::memory_order_relaxed);
+		return true;
+	}
+
+private:
+	std::atomic<qint64> _next;
+	std::atomic<int>    _suppressed;
+};
+
+class LogWriter;
+
 class Logger : public QObject
 {
 	Q_OBJECT
@@ -77,7 +152,21 @@ public:
 	static LogLevel getLogLevel(const QString& name = "");
 	static QString getLastError();
 
+	///
+	/// @brief Wait until the logger thread has written the queued messages (ex. before a crash exit)
+	///
+	static void flush();
+
 	void     Message(LogLevel level, const char* sourceFile, const char* func, unsigned int line, const char* fmt, ...);
+
+	///
+	/// @brief The level filter of the LOG_MESSAGE macros, the global level if it's set else the level of the logger
+	///
+	inline bool isEnabled(LogLevel level) const
+	{
+		return static_cast<int>(level) >= _effectiveLevel.load(std::memory_order_relaxed);
+	}
+
 	void     setMinLevel(LogLevel level);
 	LogLevel getMinLevel() const;
 	QString  getName() const;
@@ -94,9 +183,12 @@ protected:
 	~Logger() override;
 
 private:
+	friend class LogWriter;
+
 	void write(const Logger::T_LOG_MESSAGE& message);
+	void updateEffectiveLevel();
 
-	static QMutex                 _mapLock;
+	static QReadWriteLock         _mapLock;
 	static QMap<QString, Logger*> _loggerMap;
 	static QAtomicInteger<int>    GLOBAL_MIN_LOG_LEVEL;
 	static QString                _lastError;
@@ -106,8 +198,9 @@ private:
 	const bool                   _syslogEnabled;
 	const unsigned               _loggerId;
 
-	/* Only non-const member, hence the atomic */
+	/* Only non-const members, hence the atomics */
 	QAtomicInteger<int> _minLevel;
+	std::atomic<int>    _effectiveLevel;
 };
 
 class LoggerManager : public QObject
@@ -131,6 +224,7 @@ protected:
 	QList<Logger::T_LOG_MESSAGE>   _logMessageBuffer;
 	const int                      _loggerMaxMsgBufferSize;
 	bool						   _enable;
+	MemoryAccounting::Tag          _memory;
 };
 
 Q_DECLARE_METATYPE(Logger::T_LOG_MESSAGE)
@@ -34,6 +34,9 @@
 #include <QString>
 
 #include <algorithm>
+#include <atomic>
+#include <functional>
+#include <vector>
 
 #include <utils/Image.h>
 #include <utils/Components.h>
@@ -119,16 +122,28 @@ signals:
 	void assign(hyperhdr::Components defaultComp, int checksum, ColorRgb startColor, ColorRgb endColor, bool limitedRange, double saturation, double luminance, double gammaR, double gammaG, double gammaB, int coef);
 	void stop();
 	void lutCalibrationUpdate(const QJsonObject& data);
+	void patchesSampled(int width, int height, const std::vector<ColorRgb>& patches);
 
 public slots:
+	///
+	/// The image slots are connected directly: they run in the thread that produced the frame and sample
+	/// only the patches of the test board, the calibrator gets the small grid with patchesSampled.
+	///
 	void assignHandler(hyperhdr::Components defaultComp, int checksum, ColorRgb startColor, ColorRgb endColor, bool limitedRange, double saturation, double luminance, double gammaR, double gammaG, double gammaB, int coef);
 	void stopHandler();
 	void setVideoImage(const QString& name, const Image<ColorRgb>& image);
 	void setSystemImage(const QString& name, const Image<ColorRgb>& image);
 	void setGlobalInputImage(int priority, const Image<ColorRgb>& image, int timeout_ms, bool clearEffect = true);
 
+private slots:
+	void handlePatches(int width, int height, const std::vector<ColorRgb>& patches);
+
 private:
-	void handleImage(const Image<ColorRgb>& image);
+	///
+	/// @brief The mean of the 3x3 pixels at the center of every board cell, row by row. Thread-safe.
+	/// A frame is skipped while the calibrator isn't waiting for one or is still busy with the previous grid.
+	///
+	void samplePatches(const Image<ColorRgb>& image);
 	bool increaseColor(ColorRgb& color);
 	void storeColor(const ColorRgb& inputColor, const ColorRgb& color);
 	bool finalize(bool fastTrack = false);
@@ -152,6 +167,9 @@ private:
 	QString colorToQStr(capColors index);
 	QString colorToQStr(ColorRgb color);
 	QString calColorToQStr(capColors index);
+	static const int BOARD_WIDTH = 128;
+	static const int BOARD_HEIGHT = 72;
+
 	void	displayPreCalibrationInfo();
 	void	displayPostCalibrationInfo();
 	double	fineTune(double& optimalRange, double& optimalScale, int& optimalWhite, int& optimalStrategy);
@@ -159,6 +177,12 @@ private:
 	double	getError(ColorRgb first, ColorStat second);
 	void	applyFilter();
 
+	///
+	/// @brief Run job(slice) for every slice of the stage on the global thread pool, the calling thread takes part.
+	/// The slices must write disjoint parts of the LUT. The progress is reported with lutCalibrationUpdate.
+	///
+	void	parallelSlices(const QString& stage, int count, const std::function<void(int)>& job);
+
 	Logger* _log;
 	bool	_mjpegCalibration;
 	bool	_finish;
@@ -180,6 +204,8 @@ private:
 	ColorRgb _maxColor;
 	ColorStat _colorBalance[26];
 	uint8_t* _lutBuffer;
+	std::atomic<bool> _waiting;
+	std::atomic<bool> _patchesPending;
 
 	static ColorRgb primeColors[];
 
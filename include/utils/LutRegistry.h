@@ -0,0 +1,97 @@
+#pragma once
+
+#include <cstdint>
+#include <map>
+#include <vector>
+#include <memory>
+#include <functional>
+
+#include <QString>
+#include <QFile>
+#include <QMutex>
+
+#include <utils/MemoryAccounting.h>
+#include <utils/CompactLut.h>
+
+class Logger;
+
+///
+/// One section of the LUT file (or a generated table) shared by all consumers.
+/// File sections are memory-mapped read-only when possible, otherwise they are read into a private buffer.
+/// The data is always followed by at least 4 readable bytes, the decoders use unaligned 32-bit loads.
+///
+class LutTable
+{
+public:
+	~LutTable();
+
+	const uint8_t* data() const;
+
+	qint64 size() const;
+
+	bool isMapped() const;
+
+private:
+	friend class LutRegistry;
+
+	LutTable();
+
+	QFile		_file;
+	uint8_t*	_mapped;
+	uint8_t*	_buffer;
+	qint64		_size;
+	/// the mapped sections are counted too: the pages read by the decoders stay resident
+	MemoryAccounting::Tag _memory;
+};
+
+///
+/// The LUT used to decode the frames: the full table or its compact grid, immutable once it's published.
+/// Every frame keeps the snapshot it was dispatched with, so a new table takes effect on the next frame
+/// while the frames in flight finish with the previous one, which is released with the last of them.
+///
+class LutSnapshot
+{
+public:
+	LutSnapshot(const std::shared_ptr<const LutTable>& table, const CompactLut& compactLut);
+
+	/// the full table, nullptr when the compact grid is used
+	const uint8_t* buffer() const;
+
+	/// the compact grid, nullptr when the full table is used
+	const CompactLut* compactLut() const;
+
+private:
+	std::shared_ptr<const LutTable> _table;
+	CompactLut _compactLut;
+};
+
+typedef std::shared_ptr<const LutSnapshot> LutHandle;
+
+///
+/// Process-wide, reference counted registry of the LUT tables.
+/// The same section of the same file is loaded only once and released when the last consumer drops its pointer.
+///
+class LutRegistry
+{
+public:
+	///
+	/// Returns the shared table for the requested section of the LUT file
+	/// @param fileName  The LUT file
+	/// @param offset    Offset of the section (multiple of LUT_FILE_SIZE)
+	/// @param size      Size of the section
+	/// @param log       Logger of the consumer
+	/// @return the table or nullptr if the file can not be read
+	///
+	static std::shared_ptr<const LutTable> acquire(const QString& fileName, qint64 offset, qint64 size, Logger* log);
+
+	///
+	/// Returns the shared table built by the generator (e.g. internal YUV to RGB conversion)
+	/// @param keep  Keep the table until the end of the process, it's not generated again when the consumers come back
+	///
+	static std::shared_ptr<const LutTable> acquireGenerated(const QString& name, qint64 size, const std::function<void(uint8_t*)>& generator, bool keep = false);
+
+private:
+	static QMutex _locker;
+	static std::map<QString, std::weak_ptr<const LutTable>> _tables;
+	static std::vector<std::shared_ptr<const LutTable>> _kept;
+};
@@ -0,0 +1,67 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+#include <QJsonObject>
+#include <QString>
+
+/**
+ * Process-wide accounting of the memory held by the major subsystems, to tell where a growing RSS comes from.
+ * Every subsystem reports the bytes it takes and gives back, the counters keep the bytes held, the peak and
+ * the number of the allocations. The counters are lock-free: an update costs a few atomic adds, the subsystems
+ * report the buffers they own (ex. a whole index or a frame buffer), not every small allocation.
+ */
+class MemoryAccounting
+{
+public:
+	enum Subsystem { LUT = 0, VIDEO_BUFFERS, VIDEO_CACHE, LED_MAPPING, MUXER, LOG_BUFFER, WEB_SESSIONS, SUBSYSTEMS };
+
+	static void allocated(Subsystem subsystem, size_t bytes);
+	static void released(Subsystem subsystem, size_t bytes);
+
+	static QString subsystemName(Subsystem subsystem);
+
+	///
+	/// @brief The breakdown: bytes held, peak and allocations per second of every subsystem and their total.
+	/// The rate covers the last complete second, so the readers don't disturb each other.
+	///
+	static QJsonObject toJson();
+
+	static QString toString();
+
+	///
+	/// The bytes held by one owner (ex. a LUT table or a led index) of the subsystem, released with the owner.
+	/// A copy of the owner is accounted for as a copy of its memory.
+	///
+	class Tag
+	{
+	public:
+		explicit Tag(Subsystem subsystem);
+		Tag(const Tag& other);
+		Tag& operator=(const Tag& other);
+		~Tag();
+
+		///
+		/// @brief The current size of the memory of the owner, a growth counts as an allocation
+		///
+		void set(size_t bytes);
+
+		size_t bytes() const;
+
+	private:
+		Subsystem	_subsystem;
+		size_t		_bytes;
+	};
+
+private:
+	struct Counters
+	{
+		std::atomic<int64_t>	held;
+		std::atomic<int64_t>	peak;
+		std::atomic<uint64_t>	allocations;
+	};
+
+	static Counters _counters[SUBSYSTEMS];
+};
@@ -0,0 +1,64 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include <utils/RealFft.h>
+
+/**
+ * Onset detection by the spectral flux: the sum of the rises of the log magnitudes from the previous hop.
+ * The samples are transformed in windows of windowSize every hop samples, much shorter than the capture
+ * buffer, so an onset gets the time of its hop. A flux above the median of the last flux values times
+ * a factor is an onset when it is a local peak and the previous onset is older than the minimum gap.
+ * The peak is confirmed by the next hop, so the delay is one hop.
+ */
+class OnsetDetector
+{
+public:
+	struct Onset
+	{
+		/// the end of the hop of the peak [ms, InternalClock]
+		int64_t time;
+		/// 0..1, how far the flux exceeds the threshold
+		float	strength;
+	};
+
+	/// @param windowSize power of 2, the transform size
+	/// @param hop samples between two transforms, windowSize must be a multiple of it
+	/// @param sampleRate samples per second
+	OnsetDetector(int windowSize, int hop, int sampleRate);
+
+	void reset();
+
+	int hopTime() const;
+
+	///
+	/// @brief Feed the next captured samples
+	/// @param samples the samples, a multiple of the hop
+	/// @param count number of samples
+	/// @param endTime time of the last sample [ms]
+	/// @param onset the strongest onset of the samples
+	/// @return true if an onset was found
+	///
+	bool process(const int16_t* samples, int count, int64_t endTime, Onset& onset);
+
+private:
+	float flux();
+	float threshold();
+
+	int					_windowSize;
+	int					_hop;
+	int					_sampleRate;
+	RealFft				_fft;
+	/// the last windowSize samples
+	std::vector<int16_t>	_window;
+	std::vector<float>	_magnitudes, _previous;
+	/// the last flux values for the threshold, a ring
+	std::vector<float>	_history;
+	std::vector<float>	_sorted;
+	int					_historyPos;
+	int					_historyCount;
+	float				_lastFlux, _peakFlux, _peakThreshold;
+	int64_t				_peakTime;
+	int64_t				_lastOnset;
+};
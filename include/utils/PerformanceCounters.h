@@ -9,7 +9,7 @@
 
 class Logger;
 
-enum class PerformanceReportType { VIDEO_GRABBER = 1, INSTANCE = 2, LED = 3, CPU_USAGE = 4, RAM_USAGE = 5, CPU_TEMPERATURE = 6, SYSTEM_UNDERVOLTAGE = 7, UNKNOWN = 8 };
+enum class PerformanceReportType { VIDEO_GRABBER = 1, INSTANCE = 2, LED = 3, CPU_USAGE = 4, RAM_USAGE = 5, CPU_TEMPERATURE = 6, SYSTEM_UNDERVOLTAGE = 7, FRAME_POOL = 8, FRAME_DROPS = 9, LATENCY = 10, FRAME_QUEUE = 11, SMOOTHING_TIMER = 12, REFRESH_TIMER = 13, FORWARDER = 14, EFFECT = 15, PIPELINE = 16, THREAD_USAGE = 17, QUALITY_GOVERNOR = 18, UNKNOWN = 19 };
 
 struct PerformanceReport
 {
@@ -22,6 +22,10 @@ struct PerformanceReport
 	qint64	param4 = 0;
 	qint64	timeStamp = 0;
 	qint64	token = 0;
+	/// optional distribution of the measured values, ex. the duration of the LED device writes
+	QString detail;
+	/// optional latency distribution (LatencyHistogram::toJson), ex. the decoding time of the captured frames
+	QJsonObject histogram;
 
 	PerformanceReport(int _type, qint64 _token, QString _name, double _param1, qint64 _param2, qint64 _param3, qint64 _param4, int _id = -1);
 
@@ -47,6 +51,7 @@ private:
 	Logger* _log;
 	QList<PerformanceReport> _reports;
 	SystemPerformanceCounters _system;
+	QList<SystemPerformanceCounters::ThreadUsage> _threadUsage;
 	qint64 _lastRead;
 	qint64 _lastNetworkScan;
 
@@ -57,6 +62,14 @@ public:
 	static PerformanceCounters* getInstance();
 	static qint64 currentToken();
 
+public slots:
+
+	///
+	/// @brief The last reports in the OpenMetrics text format for the /metrics endpoint of the web server.
+	/// The counters of the reports cover the last complete statistics period (1 minute), so they are gauges.
+	///
+	QString getOpenMetrics();
+
 private slots:
 
 	void receive(PerformanceReport pr);
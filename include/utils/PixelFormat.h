@@ -12,6 +12,8 @@ enum class PixelFormat {
 	I420,
 	NV12,
 	MJPEG,
+	P010,
+	Y210,
 	NO_CHANGE
 };
 
@@ -44,6 +46,14 @@ inline PixelFormat parsePixelFormat(const QString& pixelFormat)
 	{
 		return PixelFormat::MJPEG;
 	}
+	else if (format.compare("p010") == 0)
+	{
+		return PixelFormat::P010;
+	}
+	else if (format.compare("y210") == 0)
+	{
+		return PixelFormat::Y210;
+	}
 
 	// return the default NO_CHANGE
 	return PixelFormat::NO_CHANGE;
@@ -76,6 +86,14 @@ inline QString pixelFormatToString(const PixelFormat& pixelFormat)
 	{
 		return "mjpeg";
 	}
+	else if (pixelFormat == PixelFormat::P010)
+	{
+		return "p010";
+	}
+	else if (pixelFormat == PixelFormat::Y210)
+	{
+		return "y210";
+	}
 
 	// return the default NO_CHANGE
 	return "NO_CHANGE";
@@ -0,0 +1,86 @@
+#pragma once
+
+#include <atomic>
+
+#include <QObject>
+
+///
+/// A drop-in for the periodic QTimer of the smoothing and the led device refresh. The ticks are scheduled
+/// by one shared high priority thread with absolute deadlines (no drift) and high resolution sleeps,
+/// then delivered to the thread of the timer as a queued call: a tick that is still waiting for a busy
+/// event loop is not queued again. The delivery delay of every tick is measured.
+///
+class PreciseTimer : public QObject
+{
+	Q_OBJECT
+
+public:
+	/// delivery delay of the ticks since the last call [us]
+	struct JitterStats
+	{
+		qint64	ticks = 0;
+		double	average = 0;
+		qint64	max = 0;
+		qint64	missed = 0;
+	};
+
+	PreciseTimer(QObject* parent = nullptr);
+	~PreciseTimer();
+
+	void setInterval(int interval);
+	int interval() const;
+
+	void start();
+	void stop();
+	bool isActive() const;
+
+	/// [ms] to the next tick, -1 when stopped
+	int remainingTime() const;
+
+	/// the clock of the deadlines [ns]
+	static qint64 now();
+
+	/// the deadline of the next tick [ns], -1 when stopped
+	qint64 nextTick() const;
+
+	/// moves the next tick and the whole schedule after it, ex. to follow the cadence of a device
+	/// (ignored by a phase aligned timer)
+	void shiftSchedule(qint64 shift);
+
+	/// the ticks fall on the whole multiples of the interval of the shared clock: timers with the same
+	/// or a multiple interval are woken up together in one pass of the scheduling thread
+	void setPhaseAligned(bool aligned);
+	bool isPhaseAligned() const;
+
+	/// the counters since the previous call, then they are cleared
+	JitterStats takeJitterStats();
+
+signals:
+	void timeout();
+	void tickSignal(qint64 deadline, int generation);
+
+private slots:
+	void handleTick(qint64 deadline, int generation);
+
+private:
+	friend class PreciseTimerThread;
+
+	/// the first deadline after start [ns], requires the mutex of the scheduling thread
+	qint64 firstDeadline() const;
+
+	/// guarded by the mutex of the scheduling thread
+	int		_interval;
+	bool	_active;
+	bool	_aligned;
+	qint64	_deadline;
+	qint64	_missed;
+	/// bumped by start and stop: the ticks of the previous schedule are ignored
+	int		_generation;
+
+	/// a tick is on the way to the event loop of the timer
+	std::atomic<bool>	_pending;
+
+	qint64	_ticks;
+	qint64	_delaySum;
+	qint64	_delayMax;
+};
@@ -0,0 +1,52 @@
+#pragma once
+
+#include <atomic>
+#include <memory>
+#include <vector>
+
+#include <QtGlobal>
+#include <QMutex>
+
+class WriteCadence;
+
+///
+/// The presentation clock shared by the led devices of all the instances, so the zones of one scene that are
+/// split between devices with different network stacks change their colors together. A frame is presented
+/// at the time it left the smoothing (the ticks of the shared smoothing clock fall together) plus the group
+/// latency: the slowest write of the devices that joined the clock. A device with a sync trigger in its
+/// protocol (E1.31 synchronization, DDP push, ArtSync) sends its colors right away and only the trigger at
+/// that time, the other devices start their write earlier by their own measured write duration.
+/// The times are in ns of PreciseTimer::now().
+///
+class PresentationClock
+{
+public:
+	static void setEnabled(bool enabled);
+	static bool isEnabled();
+
+	/// the device takes part in the group latency with the write cadence it measures
+	static void join(const std::shared_ptr<WriteCadence>& cadence);
+	static void leave(const std::shared_ptr<WriteCadence>& cadence);
+
+	///
+	/// @brief The presentation time of a frame
+	///
+	/// @param[in]  smoothedStamp  The SMOOTHED stamp of the frame trace [us], 0 = the frame is presented from now
+	/// @param[out] target         The time the colors of all the devices should change
+	/// @return false when there is nothing to align: the clock is disabled or only one device joined it
+	///
+	static bool presentationTime(int64_t smoothedStamp, qint64& target);
+
+	/// a high resolution sleep of the device thread, limited to MAX_WAIT
+	static void sleepUntil(qint64 deadline);
+
+private:
+	/// added to the slowest write: the scheduling of the device threads
+	static constexpr qint64 MARGIN = 1000000;
+	/// a stalled device must not hold the others for long
+	static constexpr qint64 MAX_WAIT = 50000000;
+
+	static std::atomic<bool> _enabled;
+	static QMutex _lock;
+	static std::vector<std::weak_ptr<WriteCadence>> _members;
+};
@@ -31,9 +31,13 @@
 #include <utils/Logger.h>
 #include <utils/settings.h>
 
+#include <utils/ColorRgb.h>
+
 // qt
 #include <QVector>
 
+#include <vector>
+
 class QUdpSocket;
 class NetOrigin;
 class HyperHdrInstance;
@@ -72,6 +76,26 @@ private:
 	///
 	void stopServer();
 
+	///
+	/// @brief Receives the rest of the burst after the first datagram, recvmmsg on Linux
+	///
+	void receiveBurst();
+
+	///
+	/// @brief Counts the datagram in the receive buffer and keeps it as the newest frame when it is valid
+	///
+	void acceptDatagram(int slot, qint64 length);
+
+	///
+	/// @brief The render node mode: adds the part of a frame of the zone, a complete frame replaces the previous one
+	///
+	void acceptNodeDatagram(const uint8_t* data, qint64 length);
+
+	///
+	/// @brief Reports and clears the datagram counters
+	///
+	void reportStatistics();
+
 private:
 	QUdpSocket*		_server;
 	Logger*			_log;
@@ -82,4 +106,29 @@ private:
 	HyperHdrInstance*		_hyperhdr;
 	const QJsonDocument		_config;
 	QTimer*					_inactiveTimer;
+
+	/// receive buffers of one burst, MAX_BATCH slots of BUFFER_SIZE bytes
+	std::vector<uint8_t>	_buffer;
+	/// the slot of the newest valid frame of the burst, -1 if none
+	int						_newestSlot;
+	qint64					_newestLength;
+	/// reused for every frame, the size follows the datagrams
+	std::vector<ColorRgb>	_ledColors;
+
+	/// the render node mode: the frames of one zone of the capture host, usually from a multicast group
+	bool					_renderNode;
+	QString					_renderNodeGroup;
+	int						_renderNodeZone;
+	/// the frame whose parts are arriving, then the capture time of the newest complete frame
+	std::vector<ColorRgb>	_nodeFrame;
+	int						_nodeSequence;
+	/// the LEDs of the frame already received and their count
+	std::vector<bool>		_nodeCovered;
+	unsigned				_nodeReceived;
+	bool					_nodeComplete;
+	int64_t					_nodeCaptureTimestamp;
+
+	quint64					_received;
+	quint64					_coalesced;
+	quint64					_malformed;
 };
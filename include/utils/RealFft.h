@@ -0,0 +1,37 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+/**
+ * Float FFT of real samples with a Hann window. The samples are packed as a complex signal of half the
+ * length, transformed by an iterative radix-2 FFT with precomputed twiddles and bit reversal, and then
+ * split into the spectrum of the real input. The tables are built once for the size.
+ */
+class RealFft
+{
+public:
+	/// @param size power of 2, at least 4
+	explicit RealFft(int size);
+
+	int size() const;
+
+	///
+	/// @brief Magnitudes of the bins 0..size/2-1 of the windowed samples
+	/// @param samples size samples
+	/// @param out size/2 magnitudes. A sine in the middle of a bin gives a quarter of its amplitude there
+	///            and an eighth in both neighbours: the sum over a band is half of the amplitude, like the
+	///            former fixed-point transform without a window
+	///
+	void magnitudes(const int16_t* samples, float* out);
+
+private:
+	int					_size;
+	std::vector<float>	_window;
+	std::vector<int>	_bitReverse;
+	/// e^(-2 pi i k / (size/2)) of the complex transform
+	std::vector<float>	_twiddleRe, _twiddleIm;
+	/// e^(-2 pi i k / size) of the split into the real spectrum
+	std::vector<float>	_splitRe, _splitIm;
+	std::vector<float>	_re, _im;
+};
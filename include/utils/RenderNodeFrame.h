@@ -0,0 +1,73 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+/**
+ * The datagram of the render node stream: the colors of one zone computed by the capture host (MessageForwarder)
+ * for a lightweight output node that only runs the smoothing and its LED device (RawUdpServer in the render node mode).
+ * The stream is usually sent to a multicast group shared by all the nodes, a node keeps the frames of its zone only.
+ * A frame with more LEDs than fit one datagram is split into parts, every part carries the offset of its first LED.
+ * A node shows the frame once its parts cover every LED, a repeated part doesn't complete it.
+ * The host and the nodes don't share a clock: instead of the capture time a frame carries the time it already spent
+ * in the pipeline of the host, so the node can still present it against the capture (ex. with the A/V sync delay).
+ * The numbers are big endian.
+ */
+namespace RenderNodeFrame
+{
+	/// "HRN1", zone, reserved, sequence, capture age [ms], LED count of the frame, offset of the first LED of the part
+	const unsigned HEADER_SIZE = 14;
+	/// fits a standard ethernet frame
+	const unsigned MAX_DATAGRAM_SIZE = 1472;
+	const unsigned MAX_LEDS_PER_DATAGRAM = (MAX_DATAGRAM_SIZE - HEADER_SIZE) / 3;
+	/// the source frame has no capture time (ex. an effect of the host)
+	const uint16_t UNKNOWN_AGE = 0xffff;
+
+	struct Header
+	{
+		uint8_t		zone = 0;
+		uint16_t	sequence = 0;
+		uint16_t	captureAge = UNKNOWN_AGE;
+		uint16_t	ledCount = 0;
+		uint16_t	offset = 0;
+	};
+
+	inline void writeHeader(uint8_t* packet, const Header& header)
+	{
+		packet[0] = 'H';
+		packet[1] = 'R';
+		packet[2] = 'N';
+		packet[3] = '1';
+		packet[4] = header.zone;
+		packet[5] = 0;
+		packet[6] = static_cast<uint8_t>(header.sequence >> 8);
+		packet[7] = static_cast<uint8_t>(header.sequence);
+		packet[8] = static_cast<uint8_t>(header.captureAge >> 8);
+		packet[9] = static_cast<uint8_t>(header.captureAge);
+		packet[10] = static_cast<uint8_t>(header.ledCount >> 8);
+		packet[11] = static_cast<uint8_t>(header.ledCount);
+		packet[12] = static_cast<uint8_t>(header.offset >> 8);
+		packet[13] = static_cast<uint8_t>(header.offset);
+	}
+
+	///
+	/// @brief Parse the header of a received datagram
+	/// @return the number of LEDs in the part, 0 if the datagram is malformed
+	///
+	inline unsigned readHeader(const uint8_t* packet, size_t length, Header& header)
+	{
+		if (length < HEADER_SIZE || (length - HEADER_SIZE) % 3 != 0 || memcmp(packet, "HRN1", 4) != 0)
+			return 0;
+
+		header.zone = packet[4];
+		header.sequence = static_cast<uint16_t>((packet[6] << 8) | packet[7]);
+		header.captureAge = static_cast<uint16_t>((packet[8] << 8) | packet[9]);
+		header.ledCount = static_cast<uint16_t>((packet[10] << 8) | packet[11]);
+		header.offset = static_cast<uint16_t>((packet[12] << 8) | packet[13]);
+
+		const unsigned leds = static_cast<unsigned>((length - HEADER_SIZE) / 3);
+
+		return (leds > 0 && header.offset + leds <= header.ledCount) ? leds : 0;
+	}
+}
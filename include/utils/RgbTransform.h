@@ -11,6 +11,9 @@
 ///
 class RgbTransform
 {
+	/// compares the fixed point and the float saturation/luminance paths
+	friend class RgbTransformTest;
+
 public:
 	///
 	/// Default constructor
@@ -138,6 +141,12 @@ private:
 	void rgb2hsl(uint8_t red, uint8_t green, uint8_t blue, uint16_t& hue, float& saturation, float& luminance);
 	void hsl2rgb(uint16_t hue, float saturation, float luminance, uint8_t& red, uint8_t& green, uint8_t& blue);
 
+	/// integer version of the HSL saturation/luminance step, differs from the float one by at most 5 levels (mostly 0 or 1)
+	void transformSatLumFixed(uint8_t& red, uint8_t& green, uint8_t& blue) const;
+
+	/// refresh the Q16 gains and select the fixed point path when the gains are in the verified range
+	void updateSatLumFixed();
+
 	/// backlight variables
 	bool      _backLightEnabled, _backlightColored;
 	double    _backlightThreshold;
@@ -157,6 +166,10 @@ private:
 		, _brightness_cmy
 		, _brightness_w;
 
+	/// the gains in 16.16 fixed point for transformSatLumFixed
+	bool      _satLumFixed;
+	int32_t   _saturationGainQ16, _luminanceGainQ16, _luminanceMinimumQ16;
+
 	/// Logger instance
 	Logger* _log;
 
@@ -0,0 +1,30 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+
+#include <utils/ColorRgb.h>
+
+///
+/// Vectorized compares of the samples of a frame for the signal detection. The callers precompute
+/// where the samples are when the geometry changes, a frame costs only the compares then.
+///
+class SampleCompare
+{
+public:
+	///
+	/// @brief Every pixel of a packed RGB row is at most the threshold in each channel
+	///
+	static bool rowBelow(const uint8_t* rgb, int pixels, const ColorRgb& threshold);
+
+	///
+	/// @brief Copies the RGB pixels at the byte offsets from the base to 4 byte quads (the 4th byte is 0)
+	///
+	static void gather(const uint8_t* base, const ptrdiff_t* offsets, int count, uint8_t* quads);
+
+	///
+	/// @brief The number of quads whose sum of absolute differences to the reference is above the tolerance
+	///
+	static int countAbove(const uint8_t* quads, const uint8_t* reference, int count, int tolerance);
+};
@@ -0,0 +1,25 @@
+#pragma once
+
+#include <utils/PixelFormat.h>
+#include <utils/Image.h>
+#include <utils/ColorRgb.h>
+#include <utils/CompactLut.h>
+
+///
+/// Decodes one uncompressed frame (YUYV, NV12, I420) in horizontal stripes on a persistent, process-wide thread pool.
+/// The calling thread decodes the first stripe and returns when all stripes are ready.
+/// When the pool is already busy with another frame or the format is not supported, the frame is decoded on the calling thread.
+///
+class StripedDecoder
+{
+public:
+	static const int MAX_STRIPES = 16;
+
+	static bool isSupported(PixelFormat pixelFormat);
+
+	static void processImage(int stripes,
+		int _cropLeft, int _cropRight, int _cropTop, int _cropBottom,
+		const uint8_t* data, int width, int height, int lineLength,
+		const PixelFormat pixelFormat, const uint8_t* lutBuffer, Image<ColorRgb>& outputImage,
+		const CompactLut* compactLut = nullptr);
+};
@@ -5,6 +5,7 @@
 #include <QDateTime>
 #include <QJsonObject>
 #include <QString>
+#include <QMap>
 
 #include <algorithm>
 
@@ -43,11 +44,79 @@ class SystemPerformanceCounters
 		int64_t physicalMemory = -1;
 	#endif
 
+	public:
+		/// the values of the last getCPU, getRAM and getTEMP calls for the metrics, negative when unknown
+		struct Readings
+		{
+			double	cpuUsage = -1;
+			qint64	ramUsed = -1;
+			qint64	ramTotal = -1;
+			double	temperature = -1;
+		};
+
+		/// CPU usage of a thread of the process since the previous getThreads call
+		struct ThreadUsage
+		{
+			QString	name;
+			qint64	id = 0;
+			/// percent of one core
+			double	usage = 0;
+		};
+
+	private:
+		Readings readings;
+
+		struct ThreadTime
+		{
+			QString	name;
+			qint64	time = 0;
+		};
+
+		/// CPU time [ns] of the threads at the previous getThreads call
+		QMap<qint64, ThreadTime> threadTimes;
+		qint64 threadTimeStamp = 0;
+
+		QList<ThreadUsage> updateThreadUsage(const QMap<qint64, ThreadTime>& current, qint64 timeStamp)
+		{
+			QList<ThreadUsage> result;
+			const double elapsed = static_cast<double>(timeStamp - threadTimeStamp);
+
+			if (threadTimeStamp > 0 && elapsed > 0)
+				for (auto thread = current.constBegin(); thread != current.constEnd(); ++thread)
+				{
+					auto previous = threadTimes.constFind(thread.key());
+					if (previous == threadTimes.constEnd())
+						continue;
+
+					ThreadUsage usage;
+					usage.name = thread.value().name;
+					usage.id = thread.key();
+					usage.usage = std::min(std::max((thread.value().time - previous.value().time) * 100.0 / elapsed, 0.0), 100.0);
+					result.append(usage);
+				}
+
+			threadTimes = current;
+			threadTimeStamp = timeStamp;
+
+			return result;
+		}
+
 	public:
 		~SystemPerformanceCounters();
 
+		const Readings& getReadings() const
+		{
+			return readings;
+		}
+
 		QString getCPU();
 		QString getRAM();
 		QString getTEMP();
 		QString getUNDERVOLATGE();
+
+		///
+		/// @brief The CPU usage of the threads of HyperHDR (Linux, macOS). Qt gives the object name of a QThread
+		/// to the system thread, so the names are kept below 16 characters (ex. LedDevice0, V4L2Worker1, WebServer)
+		///
+		QList<ThreadUsage> getThreads();
 };
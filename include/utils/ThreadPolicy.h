@@ -0,0 +1,48 @@
+#pragma once
+
+#include <QJsonObject>
+#include <QList>
+#include <QString>
+
+class QThread;
+
+///
+/// The placement and the scheduling of the threads by their role, configured in the general settings.
+/// For every role: the CPUs the threads may run on ("0-3,6", empty for all) and the policy ("default",
+/// "low", "high", "fifo" or "rr"). The policy of a thread is applied by the thread itself when it starts,
+/// so a change affects the threads started afterwards. A policy the system refuses (ex. no permission
+/// for the realtime one) falls back to the high priority of QThread.
+///
+/// Linux supports everything, Windows the CPU mask and the priorities (the realtime ones are
+/// THREAD_PRIORITY_TIME_CRITICAL), macOS only the scheduling policy.
+///
+class ThreadPolicy
+{
+public:
+	enum class Role { CAPTURE = 0, PROCESSING = 1, OUTPUT = 2, NETWORK = 3 };
+
+	///
+	/// @brief Read the roles from the general settings
+	///
+	static void setConfig(const QJsonObject& config);
+
+	///
+	/// @brief Apply the policy of the role to the calling thread
+	///
+	static void apply(Role role);
+
+	///
+	/// @brief Apply the policy of the role to the thread when it starts, call before QThread::start
+	///
+	static void attach(QThread* thread, Role role);
+
+private:
+	struct Setting
+	{
+		QList<int>	cpus;
+		QString		policy;
+	};
+
+	static QList<int> parseCpus(const QString& cpus);
+	static Setting getSetting(Role role);
+};
@@ -1,14 +1,26 @@
 #pragma once
 #include <cstdint>
 #include <stdlib.h>
+#include <atomic>
 
 #include <QString>
-#include <QStack>
 #include <QMutex>
 #include <QMutexLocker>
 
 #define VideoMemoryManagerBufferSize 8
+#define VideoMemoryManagerSizeClasses 64
+#define VideoMemoryManagerThreadCache 2
+#define VideoMemoryManagerCacheLimit (96 * 1024 * 1024)
+// every buffer (except 1x1 images) starts at this alignment and is followed by the same amount of padding
+#define VideoMemoryManagerAlignment 64
+#define VideoMemoryManagerHugePageSize (2 * 1024 * 1024)
 
+/**
+ * Frame buffer pool shared by all ImageData instances.
+ * Requests are rounded up to size classes (4 classes per power of two, starting above 4kB) so frames
+ * of different resolutions can be cached at the same time. Released buffers go first to a small
+ * per-thread cache and then to a lock-free global depot. The total footprint of the cached buffers is capped.
+ */
 class VideoMemoryManager
 {
 public:
@@ -21,18 +33,40 @@ public:
 	uint8_t* request(size_t size);
 
 	static void enableCache(bool frameCache);
+	static void enableHugePages(bool hugePages);
+
+	static uint8_t* allocateMemory(size_t size);
+	static void     freeMemory(uint8_t* buffer);
 
 private:
-	void releaseBuffer();
-
-	QStack<uint8_t*> _stack;
-	size_t           _currentSize;
-	int              _prevSize;
-	int              _hits;
-	bool             _needed;
-	bool             _prevNeeded;
-	int              _bufferLimit;
-	QMutex           _locker;
-
-	static bool      _enabled, _dirty;
+	struct ThreadCache
+	{
+		VideoMemoryManager* owner = nullptr;
+		uint8_t* buffers[VideoMemoryManagerSizeClasses][VideoMemoryManagerThreadCache];
+		int      count[VideoMemoryManagerSizeClasses] = {};
+		int      total = 0;
+
+		void flush();
+		~ThreadCache();
+	};
+
+	static int    sizeClass(size_t size);
+	static size_t classSize(int index);
+
+	uint8_t* takeFromDepot(int index);
+	void     releaseToDepot(int index, uint8_t* buffer);
+	void     releaseBuffer();
+
+	std::atomic<uint8_t*>  _depot[VideoMemoryManagerSizeClasses][VideoMemoryManagerBufferSize];
+	std::atomic<int>       _requests[VideoMemoryManagerSizeClasses];
+	std::atomic<uint64_t>  _hits;
+	std::atomic<uint64_t>  _misses;
+	std::atomic<size_t>    _footprint;
+	size_t                 _currentSize;
+	int                    _bufferLimit;
+
+	static thread_local ThreadCache _threadCache;
+	static std::atomic<bool> _enabled;
+	static std::atomic<bool> _hugePages;
+	static std::atomic<int>  _hugePageBuffers;
 };
@@ -0,0 +1,51 @@
+#pragma once
+
+#include <atomic>
+
+#include <QtGlobal>
+
+///
+/// The write timing of one led device as it is observed by the device thread, read without locking
+/// by the smoothing of the instance. The times are in ns of PreciseTimer::now().
+///
+class WriteCadence
+{
+public:
+	WriteCadence();
+
+	/// the refresh timer of the device drives the writes, 0 = every frame is written when it arrives
+	void setRefreshInterval(int interval);
+
+	void writeStarted(qint64 now);
+	void writeFinished(qint64 now);
+	void reset();
+
+	///
+	/// The next write slot of a device with the refresh timer
+	///
+	/// @param[in]  now    The current time
+	/// @param[out] slot   The start of the next write after now
+	/// @param[out] period The learned period between the writes
+	/// @return false until the period is learned or when the writes follow the frames
+	///
+	bool nextSlot(qint64 now, qint64& slot, qint64& period) const;
+
+	/// for a device that writes every frame: the end of the write in progress, 0 when it's not learned
+	qint64 readyTime() const;
+
+	/// the smoothed duration of a write [ns], 0 until a write has finished
+	qint64 duration() const;
+
+private:
+	/// writes needed before the estimates are used
+	static constexpr int LEARNING_WRITES = 8;
+
+	std::atomic<qint64>	_refreshInterval;
+	/// smoothed phase and period of the write starts
+	std::atomic<qint64>	_phase;
+	std::atomic<qint64>	_period;
+	/// smoothed duration of a write
+	std::atomic<qint64>	_duration;
+	std::atomic<qint64>	_lastStart;
+	std::atomic<int>	_samples;
+};
@@ -0,0 +1,78 @@
+#pragma once
+
+#include <QJsonObject>
+#include <QJsonValue>
+#include <QJsonArray>
+#include <QString>
+#include <QVector>
+
+/// A flat object schema (ex. a JSON-RPC command) compiled once into a table of its properties, so
+/// the validation does not walk the schema tree again. It only tells if the object is valid: the
+/// messages of a rejected object come from QJsonSchemaChecker.
+///
+/// Only a schema of an object of plain properties is compiled, with the keywords:
+/// - type (string, number, integer, double, boolean, object, array, null, any)
+/// - required
+/// - minimum, maximum
+/// - minLength, maxLength
+/// - minItems, maxItems, items (with a type only)
+/// - enum
+/// - additionalProperties (false)
+/// Any other schema leaves isCompiled() false and stays with QJsonSchemaChecker.
+
+class QJsonSchemaCompiled
+{
+public:
+	QJsonSchemaCompiled();
+
+	///
+	/// @param schema The schema to compile
+	///
+	explicit QJsonSchemaCompiled(const QJsonObject& schema);
+
+	///
+	/// @return true if the schema is supported and validate() can be used
+	///
+	bool isCompiled() const;
+
+	///
+	/// @brief Validate a JSON object, the result matches QJsonSchemaChecker::validate for a compiled schema
+	/// @param value The JSON object to check
+	/// @return true when the object is valid
+	///
+	bool validate(const QJsonObject& value) const;
+
+private:
+	enum class Type { ANY, STRING, NUMBER, INTEGER, BOOLEAN, OBJECT, ARRAY, NULLTYPE };
+
+	struct Property
+	{
+		QString		name;
+		bool		hasType = false;
+		Type		type = Type::ANY;
+		bool		required = false;
+		bool		hasMinimum = false;
+		double		minimum = 0;
+		bool		hasMaximum = false;
+		double		maximum = 0;
+		int			minLength = -1;
+		int			maxLength = -1;
+		int			minItems = -1;
+		int			maxItems = -1;
+		bool		hasItems = false;
+		Type		itemType = Type::ANY;
+		bool		hasEnum = false;
+		QJsonArray	enumValues;
+	};
+
+	static bool parseType(const QJsonValue& schema, Type& type);
+	static bool checkType(const QJsonValue& value, Type type);
+
+	bool compileProperty(const QString& name, const QJsonObject& schema);
+	bool checkProperty(const Property& property, const QJsonValue& value) const;
+
+private:
+	QVector<Property>	_properties;
+	bool				_additionalProperties;
+	bool				_compiled;
+};
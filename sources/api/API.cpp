@@ -20,12 +20,15 @@
 #include <QTimer>
 #include <QNetworkReply>
 #include <QFile>
+#include <QSaveFile>
 #include <base/GrabberWrapper.h>
 #include <base/SystemWrapper.h>
 #include <utils/jsonschema/QJsonSchemaChecker.h>
 #include <HyperhdrConfig.h>
 #include <utils/SysInfo.h>
 #include <utils/ColorSys.h>
+#include <utils/ImageIngest.h>
+#include <utils/Base64.h>
 #include <flatbufserver/FlatBufferServer.h>
 
 // bonjour wrapper
@@ -42,8 +45,104 @@
 	#include <lzma.h>
 #endif
 
+#if defined(ENABLE_V4L2) || defined(ENABLE_MF)
+	#include <turbojpeg.h>
+	#define API_TURBOJPEG
+#endif
+
 using namespace hyperhdr;
 
+namespace
+{
+	/// the strict base64 form is decoded in one pass, anything else (ex. with line breaks) by Qt
+	void decodeImageData(API::ImageCmdData& data)
+	{
+		const int size = Base64::decodedSize(data.encoded);
+
+		if (size >= 0)
+		{
+			data.data.resize(size);
+			if (Base64::decode(data.encoded, reinterpret_cast<uint8_t*>(data.data.data())))
+				return;
+		}
+
+		data.data = QByteArray::fromBase64(data.encoded.toUtf8());
+	}
+
+#ifdef API_TURBOJPEG
+	///
+	/// @brief Decodes a JPEG straight to RGB, the DCT scaling brings it within the limit and the result is reduced
+	/// to the size of the led mappings
+	/// @return false to leave the image to QImage, ex. when no scaling factor of turbojpeg fits in the limit
+	///
+	bool decodeJpeg(const QByteArray& data, int limit, std::vector<uint8_t>& buffer, Image<ColorRgb>& image)
+	{
+		const unsigned char* jpeg = reinterpret_cast<const unsigned char*>(data.constData());
+
+		if (data.size() < 4 || jpeg[0] != 0xFF || jpeg[1] != 0xD8)
+			return false;
+
+		tjhandle decompress = tjInitDecompress();
+		if (decompress == nullptr)
+			return false;
+
+		int width = 0, height = 0, subsamp = 0;
+		bool result = false;
+
+		if ((tjDecompressHeader2(decompress, const_cast<unsigned char*>(jpeg), data.size(), &width, &height, &subsamp) == 0 ||
+			tjGetErrorCode(decompress) != TJERR_FATAL) && width > 0 && height > 0)
+		{
+			// the largest reduction of the DCT that fits in the limit
+			tjscalingfactor sca{ 0, 0 };
+			int scalingFactorsCount = 0;
+			tjscalingfactor* scalingFactors = tjGetScalingFactors(&scalingFactorsCount);
+
+			for (int i = 0; scalingFactors != nullptr && i < scalingFactorsCount; i++)
+			{
+				const tjscalingfactor& factor = scalingFactors[i];
+				if (factor.num <= factor.denom && TJSCALED(width, factor) <= limit && TJSCALED(height, factor) <= limit &&
+					(sca.denom == 0 || factor.num * sca.denom > sca.num * factor.denom))
+					sca = factor;
+			}
+
+			if (sca.denom > 0)
+			{
+				const int scaledWidth = TJSCALED(width, sca);
+				const int scaledHeight = TJSCALED(height, sca);
+				const int factor = ImageIngest::getFactor(scaledWidth, scaledHeight);
+
+				// without a reduction the RGB goes straight to the image
+				uint8_t* target;
+				if (factor == 1)
+				{
+					image = Image<ColorRgb>(scaledWidth, scaledHeight);
+					target = image.rawMem();
+				}
+				else
+				{
+					buffer.resize(static_cast<size_t>(scaledWidth) * scaledHeight * 3);
+					target = buffer.data();
+				}
+
+				if (tjDecompress2(decompress, jpeg, data.size(), target, scaledWidth, 0, scaledHeight, TJPF_RGB, TJFLAG_FASTDCT | TJFLAG_FASTUPSAMPLE) == 0 ||
+					tjGetErrorCode(decompress) != TJERR_FATAL)
+				{
+					if (factor > 1)
+					{
+						image = Image<ColorRgb>(scaledWidth / factor, scaledHeight / factor);
+						ImageIngest::reduce(buffer.data(), scaledWidth, scaledHeight, factor, nullptr, 0, nullptr, image);
+					}
+					result = true;
+				}
+			}
+		}
+
+		tjDestroy(decompress);
+		return result;
+	}
+#endif
+}
+
 API::API(Logger* log, bool localConnection, QObject* parent)
 	: QObject(parent)
 {
@@ -195,74 +294,91 @@ bool API::setImage(ImageCmdData& data, hyperhdr::Components comp, QString& reply
 	// truncate name length
 	data.imgName.truncate(16);
 
+	Image<ColorRgb> image;
+	bool ready = false;
+
 	if (data.format == "auto")
 	{
-		QImage img = QImage::fromData(data.data);
-		if (img.isNull())
-		{
-			replyMsg = "Failed to parse picture, the file might be corrupted";
-			return false;
-		}
+		if (!data.encoded.isEmpty())
+			decodeImageData(data);
+
+		// check for requested scale, at most 2000
+		const int limit = (data.scale > 24) ? qMin(data.scale, 2000) : 2000;
+
+#ifdef API_TURBOJPEG
+		ready = decodeJpeg(data.data, limit, _imageDecodeBuffer, image);
+#endif
 
-		// check for requested scale
-		if (data.scale > 24)
+		if (!ready)
 		{
-			if (img.height() > data.scale)
-			{
-				img = img.scaledToHeight(data.scale);
-			}
-			if (img.width() > data.scale)
+			QImage img = QImage::fromData(data.data);
+			if (img.isNull())
 			{
-				img = img.scaledToWidth(data.scale);
+				replyMsg = "Failed to parse picture, the file might be corrupted";
+				return false;
 			}
-		}
 
-		// check if we need to force a scale
-		if (img.width() > 2000 || img.height() > 2000)
-		{
-			data.scale = 2000;
-			if (img.height() > data.scale)
+			if (img.height() > limit)
 			{
-				img = img.scaledToHeight(data.scale);
+				img = img.scaledToHeight(limit);
 			}
-			if (img.width() > data.scale)
+			if (img.width() > limit)
 			{
-				img = img.scaledToWidth(data.scale);
+				img = img.scaledToWidth(limit);
 			}
-		}
 
-		data.width = img.width();
-		data.height = img.height();
+			data.width = img.width();
+			data.height = img.height();
 
-		// extract image
-		img = img.convertToFormat(QImage::Format_ARGB32_Premultiplied);
-		data.data.clear();
-		data.data.reserve(img.width() * img.height() * 3);
-		for (int i = 0; i < img.height(); ++i)
-		{
-			const QRgb* scanline = reinterpret_cast<const QRgb*>(img.scanLine(i));
-			for (int j = 0; j < img.width(); ++j)
+			// extract image
+			img = img.convertToFormat(QImage::Format_ARGB32_Premultiplied);
+			data.data.clear();
+			data.data.reserve(img.width() * img.height() * 3);
+			for (int i = 0; i < img.height(); ++i)
 			{
-				data.data.append((char)qRed(scanline[j]));
-				data.data.append((char)qGreen(scanline[j]));
-				data.data.append((char)qBlue(scanline[j]));
+				const QRgb* scanline = reinterpret_cast<const QRgb*>(img.scanLine(i));
+				for (int j = 0; j < img.width(); ++j)
+				{
+					data.data.append((char)qRed(scanline[j]));
+					data.data.append((char)qGreen(scanline[j]));
+					data.data.append((char)qBlue(scanline[j]));
+				}
 			}
 		}
 	}
 	else
 	{
-		// check consistency of the size of the received data
-		if (data.data.size() != data.width * data.height * 3)
+		const qint64 expectedSize = static_cast<qint64>(data.width) * data.height * 3;
+
+		// raw RGB of the full size is decoded straight into the image
+		if (!data.encoded.isEmpty() && Base64::decodedSize(data.encoded) == expectedSize && expectedSize > 0 &&
+			ImageIngest::getFactor(data.width, data.height) == 1)
 		{
-			replyMsg = "Size of image data does not match with the width and height";
-			return false;
+			image = Image<ColorRgb>(data.width, data.height);
+			ready = Base64::decode(data.encoded, image.rawMem());
 		}
-	}
 
-	// copy image
-	Image<ColorRgb> image(data.width, data.height);
-	memcpy(image.rawMem(), data.data.data(), data.data.size());
+		if (!ready)
+		{
+			if (!data.encoded.isEmpty())
+				decodeImageData(data);
+
+			// check consistency of the size of the received data
+			if (data.data.size() != expectedSize)
+			{
+				replyMsg = "Size of image data does not match with the width and height";
+				return false;
+			}
+		}
+	}
 
+	if (!ready)
+	{
+		// copy image, reduced to the size of the led mappings
+		const int factor = ImageIngest::getFactor(data.width, data.height);
+		image = Image<ColorRgb>(data.width / factor, data.height / factor);
+		ImageIngest::reduce(reinterpret_cast<const uint8_t*>(data.data.constData()), data.width, data.height, factor, nullptr, 0, nullptr, image);
+	}
 
 	QUEUE_CALL_4(_hyperhdr, registerInput, int, data.priority, hyperhdr::Components, comp, QString, data.origin, QString, data.imgName);
 	QUEUE_CALL_3(_hyperhdr, setInputImage, int, data.priority, Image<ColorRgb>, image, int64_t, data.duration);
@@ -429,8 +545,9 @@ QString API::installLut(QNetworkReply* reply, QString fileName, int hardware_bri
 	{
 		QByteArray downloadedData = reply->readAll();
 
-		QFile file(fileName);
-		if (file.open(QIODevice::WriteOnly | QIODevice::Truncate))
+		// grabbers can memory-map the current LUT file: replace it atomically instead of truncating
+		QSaveFile file(fileName);
+		if (file.open(QIODevice::WriteOnly))
 		{
 			size_t outSize = 67174456;
 			uint8_t* outBuf = reinterpret_cast<uint8_t*>(malloc(outSize));
@@ -487,9 +604,10 @@ QString API::installLut(QNetworkReply* reply, QString fileName, int hardware_bri
 				if (time != 0)
 					file.setFileTime(QDateTime::fromMSecsSinceEpoch(time), QFileDevice::FileModificationTime);
 
-				file.close();
 				if (error != nullptr)
-					file.remove();
+					file.cancelWriting();
+				else if (!file.commit())
+					error = QString("Could not save %1: %2").arg(fileName).arg(file.errorString());
 
 				lzma_end(&strm);
 				free(outBuf);
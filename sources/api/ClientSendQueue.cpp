@@ -0,0 +1,221 @@
+#include <api/ClientSendQueue.h>
+
+#include <QTcpSocket>
+#include <QMutexLocker>
+
+QMutex ClientSendQueue::_sessionsLock;
+std::list<ClientSendQueue*> ClientSendQueue::_sessions;
+
+ClientSendQueue::ClientSendQueue(QTcpSocket* socket, Logger* log, const QString& client, QObject* parent)
+	: QObject(parent)
+	, _socket(socket)
+	, _log(log)
+	, _client(client)
+	, _queue()
+	, _queuedBytes(0)
+	, _pending{}
+	, _dropped(0)
+	, _congested(false)
+	, _memory(MemoryAccounting::WEB_SESSIONS)
+{
+	connect(_socket, &QTcpSocket::bytesWritten, this, &ClientSendQueue::flush);
+
+	QMutexLocker locker(&_sessionsLock);
+	_snapshot = toJson();
+	_sessions.push_back(this);
+}
+
+ClientSendQueue::~ClientSendQueue()
+{
+	QMutexLocker locker(&_sessionsLock);
+	_sessions.remove(this);
+}
+
+ClientSendQueue::Stream ClientSendQueue::streamOf(const QJsonObject& message)
+{
+	const QString command = message["command"].toString();
+
+	if (command.endsWith("-ledstream-update"))
+		return LED_COLORS;
+	if (command.endsWith("-imagestream-update"))
+		return IMAGE;
+	if (command == "logging-update")
+		return LOG;
+
+	return REPLY;
+}
+
+void ClientSendQueue::send(Stream stream, const QByteArray& data, const std::function<void()>& sent)
+{
+	if (_socket == nullptr || _socket->state() != QAbstractSocket::ConnectedState)
+	{
+		if (sent)
+			sent();
+		return;
+	}
+
+	Message message{ stream, data, sent };
+
+	// the socket keeps up: nothing waits here
+	if (_queue.empty() && _socket->bytesToWrite() < HIGH_WATER)
+	{
+		write(message);
+		return;
+	}
+
+	if (stream == LED_COLORS || stream == IMAGE)
+	{
+		// latest wins: the waiting frame is replaced in its place
+		for (auto& waiting : _queue)
+			if (waiting.stream == stream)
+			{
+				_queuedBytes += message.data.size() - waiting.data.size();
+				if (waiting.sent)
+					waiting.sent();
+				waiting = std::move(message);
+				_dropped++;
+				updateState();
+				return;
+			}
+	}
+	else if (stream == LOG && _pending[LOG] >= LOG_BACKLOG)
+	{
+		// the oldest log message makes room
+		for (auto it = _queue.begin(); it != _queue.end(); ++it)
+			if (it->stream == LOG)
+			{
+				_queuedBytes -= it->data.size();
+				if (it->sent)
+					it->sent();
+				_queue.erase(it);
+				_pending[LOG]--;
+				_dropped++;
+				break;
+			}
+	}
+
+	_queuedBytes += message.data.size();
+	_pending[stream]++;
+	_queue.push_back(std::move(message));
+
+	updateState();
+}
+
+void ClientSendQueue::flush()
+{
+	if (_queue.empty())
+		return;
+
+	while (!_queue.empty() && _socket->bytesToWrite() < HIGH_WATER)
+	{
+		Message message = std::move(_queue.front());
+		_queue.pop_front();
+		_queuedBytes -= message.data.size();
+		_pending[message.stream]--;
+
+		if (!write(message))
+		{
+			// the socket is gone, release the rest
+			for (auto& waiting : _queue)
+				if (waiting.sent)
+					waiting.sent();
+			_queue.clear();
+			_queuedBytes = 0;
+			for (int i = 0; i < STREAMS; i++)
+				_pending[i] = 0;
+			break;
+		}
+	}
+
+	updateState();
+}
+
+bool ClientSendQueue::write(Message& message)
+{
+	bool result = true;
+
+	if (_socket->state() != QAbstractSocket::ConnectedState)
+	{
+		result = false;
+	}
+	else if (_socket->write(message.data) != message.data.size())
+	{
+		Error(_log, "Error writing bytes to socket of %s: %s", QSTRING_CSTR(_client), QSTRING_CSTR(_socket->errorString()));
+		result = false;
+	}
+
+	if (message.sent)
+		message.sent();
+
+	return result;
+}
+
+void ClientSendQueue::updateState()
+{
+	_memory.set(static_cast<size_t>(_queuedBytes));
+
+	{
+		QMutexLocker locker(&_sessionsLock);
+		_snapshot = toJson();
+	}
+
+	const bool congested = !_queue.empty();
+
+	if (congested != _congested)
+	{
+		_congested = congested;
+
+		if (_congested)
+			Debug(_log, "Client %s is slow: %lld bytes wait in the socket, the streams keep their latest frames", QSTRING_CSTR(_client), _socket->bytesToWrite());
+		else
+			Debug(_log, "Client %s caught up: %lld messages dropped so far", QSTRING_CSTR(_client), _dropped);
+	}
+}
+
+int ClientSendQueue::depth() const
+{
+	return static_cast<int>(_queue.size());
+}
+
+qint64 ClientSendQueue::queuedBytes() const
+{
+	return _queuedBytes;
+}
+
+int ClientSendQueue::pending(Stream stream) const
+{
+	return _pending[stream];
+}
+
+qint64 ClientSendQueue::dropped() const
+{
+	return _dropped;
+}
+
+QJsonObject ClientSendQueue::toJson() const
+{
+	QJsonObject info;
+
+	info["client"] = _client;
+	info["depth"] = depth();
+	info["queuedBytes"] = _queuedBytes;
+	info["socketBytes"] = (_socket != nullptr) ? _socket->bytesToWrite() : 0;
+	info["replies"] = _pending[REPLY];
+	info["ledColors"] = _pending[LED_COLORS];
+	info["image"] = _pending[IMAGE];
+	info["log"] = _pending[LOG];
+	info["dropped"] = _dropped;
+
+	return info;
+}
+
+QJsonArray ClientSendQueue::sessionsToJson()
+{
+	QMutexLocker locker(&_sessionsLock);
+
+	QJsonArray sessions;
+	for (const ClientSendQueue* session : _sessions)
+		sessions.append(session->_snapshot);
+
+	return sessions;
+}
@@ -0,0 +1,173 @@
+/* ImageStreamEncoder.cpp
+*
+*  MIT License
+*
+*  Copyright (c) 2023 awawa-dev
+*
+*  Project homesite: https://github.com/awawa-dev/HyperHDR
+*
+*  Permission is hereby granted, free of charge, to any person obtaining a copy
+*  of this software and associated documentation files (the "Software"), to deal
+*  in the Software without restriction, including without limitation the rights
+*  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+*  copies of the Software, and to permit persons to whom the Software is
+*  furnished to do so, subject to the following conditions:
+*
+*  The above copyright notice and this permission notice shall be included in all
+*  copies or substantial portions of the Software.
+
+*  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+*  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+*  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+*  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+*  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+*  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+*  SOFTWARE.
+*/
+
+
+#include <algorithm>
+
+#include <api/ImageStreamEncoder.h>
+#include <utils/ImageIngest.h>
+#include <utils/ImagePyramid.h>
+
+#include "HyperhdrConfig.h"
+
+#if defined(ENABLE_V4L2) || defined(ENABLE_MF)
+	#include <turbojpeg.h>
+	#define IMAGESTREAM_TURBOJPEG
+#else
+	#include <QImage>
+	#include <QBuffer>
+#endif
+
+ImageStreamEncoder::ImageStreamEncoder(const DeliverFunc& deliver) :
+	_deliver(deliver),
+	_compressor(nullptr),
+	_quality(0),
+	_hasImage(false),
+	_quit(false)
+{
+}
+
+ImageStreamEncoder::~ImageStreamEncoder()
+{
+	{
+		QMutexLocker locker(&_mutex);
+		_quit = true;
+		_condition.wakeAll();
+	}
+	wait();
+}
+
+void ImageStreamEncoder::queue(const Image<ColorRgb>& image, int quality)
+{
+	QMutexLocker locker(&_mutex);
+
+	_image = image;
+	_quality = quality;
+	_hasImage = true;
+	_condition.wakeAll();
+}
+
+void ImageStreamEncoder::run()
+{
+	while (true)
+	{
+		Image<ColorRgb> image;
+		int quality;
+
+		{
+			QMutexLocker locker(&_mutex);
+
+			while (!_hasImage && !_quit)
+				_condition.wait(&_mutex);
+
+			if (_quit)
+				break;
+
+			image = _image;
+			quality = _quality;
+			_image = Image<ColorRgb>();
+			_hasImage = false;
+		}
+
+		QByteArray jpeg = encode(image, quality);
+
+		if (!jpeg.isEmpty())
+			_deliver(jpeg);
+	}
+
+#ifdef IMAGESTREAM_TURBOJPEG
+	if (_compressor != nullptr)
+		tjDestroy(static_cast<tjhandle>(_compressor));
+	_compressor = nullptr;
+#endif
+}
+
+QByteArray ImageStreamEncoder::encode(const Image<ColorRgb>& image, int quality)
+{
+	const int width = image.width();
+	const int height = image.height();
+
+	if (width <= 1 || height <= 1)
+		return QByteArray();
+
+	// nearest neighbour is enough for a preview and keeps the aspect of the frame
+	int step = std::max(std::max((width + PREVIEW_MAX_WIDTH - 1) / PREVIEW_MAX_WIDTH, (height + PREVIEW_MAX_HEIGHT - 1) / PREVIEW_MAX_HEIGHT), 1);
+	const int previewWidth = width / step;
+	const int previewHeight = height / step;
+
+	// the level of the frame pyramid does the power of two part of the reduction,
+	// a deferred tone mapping is applied to the level instead of the full frame
+	const Image<ColorRgb> level = ImageIngest::resolveDeferred(ImagePyramid::level(image, step));
+	const uint8_t* source = level.rawMem();
+
+	if (step > 1)
+	{
+		_preview.resize(static_cast<size_t>(previewWidth) * previewHeight * 3);
+
+		uint8_t* target = _preview.data();
+		for (int y = 0; y < previewHeight; y++)
+		{
+			const uint8_t* line = level.rawMem() + static_cast<size_t>(y) * step * level.width() * 3;
+			for (int x = 0; x < previewWidth; x++, line += step * 3, target += 3)
+			{
+				target[0] = line[0];
+				target[1] = line[1];
+				target[2] = line[2];
+			}
+		}
+
+		source = _preview.data();
+	}
+
+#ifdef IMAGESTREAM_TURBOJPEG
+	if (_compressor == nullptr)
+		_compressor = tjInitCompress();
+
+	unsigned char* jpegBuffer = nullptr;
+	unsigned long jpegSize = 0;
+	QByteArray jpeg;
+
+	if (_compressor != nullptr &&
+		tjCompress2(static_cast<tjhandle>(_compressor), source, previewWidth, previewWidth * 3, previewHeight, TJPF_RGB,
+			&jpegBuffer, &jpegSize, TJSAMP_420, quality, TJFLAG_FASTDCT) == 0)
+		jpeg = QByteArray(reinterpret_cast<const char*>(jpegBuffer), static_cast<int>(jpegSize));
+
+	if (jpegBuffer != nullptr)
+		tjFree(jpegBuffer);
+
+	return jpeg;
+#else
+	QByteArray jpeg;
+	QBuffer buffer(&jpeg);
+	QImage jpgImage(source, previewWidth, previewHeight, previewWidth * 3, QImage::Format_RGB888);
+
+	buffer.open(QIODevice::WriteOnly);
+	jpgImage.save(&buffer, "jpg", quality);
+
+	return jpeg;
+#endif
+}
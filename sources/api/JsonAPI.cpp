@@ -17,22 +17,33 @@
 #include <QHostInfo>
 #include <QMultiMap>
 #include <QDir>
+#include <QFileInfo>
+#include <QMetaMethod>
+#include <QMutex>
+#include <QMutexLocker>
+#include <QHash>
 
 #include <leddevice/LedDeviceWrapper.h>
 #include <leddevice/LedDevice.h>
 #include <leddevice/LedDeviceFactory.h>
+#include <leddevice/LatencyBenchmark.h>
 #include "../leddevice/dev_net/ProviderRestApi.h"
 
 #include <base/GrabberWrapper.h>
+#include <base/QualityGovernor.h>
 #include <base/SystemWrapper.h>
 #include <base/SoundCapture.h>
 #include <utils/jsonschema/QJsonUtils.h>
 #include <utils/jsonschema/QJsonSchemaChecker.h>
+#include <utils/jsonschema/QJsonSchemaCompiled.h>
 #include <HyperhdrConfig.h>
 #include <utils/SysInfo.h>
 #include <utils/ColorSys.h>
 #include <utils/JsonUtils.h>
 #include <utils/PerformanceCounters.h>
+#include <utils/EventTracer.h>
+#include <utils/MemoryAccounting.h>
+#include <utils/PreciseTimer.h>
 #include <utils/LutCalibrator.h>
 
 // bonjour wrapper
@@ -45,6 +56,8 @@
 
 // api includes
 #include <api/JsonCB.h>
+#include <api/ImageStreamEncoder.h>
+#include <api/ClientSendQueue.h>
 
 // auth manager
 #include <base/AuthManager.h>
@@ -53,6 +66,81 @@
 
 using namespace hyperhdr;
 
+namespace
+{
+	// binary image stream: at most 20 fps, the link to the client stays idle at least half of the time
+	const qint64 IMAGE_STREAM_MIN_INTERVAL = 50;
+	const qint64 IMAGE_STREAM_MAX_INTERVAL = 1000;
+
+	// the quality governor limits the stream to 5 fps when the system is overloaded
+	const qint64 IMAGE_STREAM_GOVERNOR_INTERVAL = 200;
+
+	// a frame that drains slower lowers the quality, a faster one raises it
+	const qint64 IMAGE_STREAM_SLOW_DRAIN = 100;
+	const qint64 IMAGE_STREAM_FAST_DRAIN = 25;
+	const int IMAGE_STREAM_MIN_QUALITY = 30;
+	const int IMAGE_STREAM_MAX_QUALITY = 85;
+	const int IMAGE_STREAM_DEFAULT_QUALITY = 70;
+
+	// the log messages of a client are sent together: after this time [ms] or at this count, whatever comes first
+	const int LOG_BATCH_INTERVAL = 40;
+	const int LOG_BATCH_SIZE = 200;
+
+	/// the commands sent many times per second by the integrations: a message accepted by the compiled
+	/// schema skips QJsonSchemaChecker (a rejected one is checked again for the error messages)
+	bool isHotCommand(const QString& command)
+	{
+		return command == "color" || command == "image" || command == "clear";
+	}
+
+	struct CommandSchema
+	{
+		QJsonObject			schema;
+		QJsonSchemaCompiled	compiled;
+	};
+
+	/// the schemas are read from the resources and compiled once, then shared by all the clients
+	bool getCommandSchema(const QString& schemaPath, CommandSchema& commandSchema, Logger* log)
+	{
+		static QMutex cacheLock;
+		static QHash<QString, CommandSchema> cache;
+
+		QMutexLocker locker(&cacheLock);
+
+		auto cached = cache.constFind(schemaPath);
+		if (cached != cache.constEnd())
+		{
+			commandSchema = cached.value();
+			return true;
+		}
+
+		QJsonObject schema;
+		if (!JsonUtils::readFile(schemaPath, schema, log))
+			return false;
+
+		commandSchema.schema = schema;
+		commandSchema.compiled = QJsonSchemaCompiled(schema);
+		cache.insert(schemaPath, commandSchema);
+		return true;
+	}
+
+	bool validateCommand(const QString& ident, const QJsonObject& message, const QString& schemaPath, Logger* log)
+	{
+		CommandSchema commandSchema;
+		if (!getCommandSchema(schemaPath, commandSchema, log))
+			return false;
+
+		return JsonUtils::validate(ident, message, commandSchema.schema, log);
+	}
+
+	bool isValidHotCommand(const QString& command, const QJsonObject& message, Logger* log)
+	{
+		CommandSchema commandSchema;
+		return isHotCommand(command) && getCommandSchema(QString(":schema-%1").arg(command), commandSchema, log) &&
+			commandSchema.compiled.validate(message);
+	}
+}
+
 JsonAPI::JsonAPI(QString peerAddress, Logger* log, bool localConnection, QObject* parent, bool noListener)
 	: API(log, localConnection, parent), _semaphore(1)
 {
@@ -60,15 +148,36 @@ JsonAPI::JsonAPI(QString peerAddress, Logger* log, bool localConnection, QObject
 	_peerAddress = peerAddress;
 	_jsonCB = new JsonCB(this);
 	_streaming_logging_activated = false;
+	_logMinLevel = Logger::DEBUG;
+	_logBatchTimer = new QTimer(this);
+	_logBatchTimer->setSingleShot(true);
+	_logBatchTimer->setInterval(LOG_BATCH_INTERVAL);
 	_ledStreamTimer = new QTimer(this);
 	_lastSendImage = InternalClock::now();
 	_colorsStreamingInterval = 50;
+	_ledStreamBinary = false;
+	_ledStreamDelta = false;
+	_imageStreamBinary = false;
+	_imageStreamBusy = false;
+	_imageStreamQuality = IMAGE_STREAM_DEFAULT_QUALITY;
+	_imageStreamInterval = IMAGE_STREAM_MIN_INTERVAL;
+	_imageStreamSent = 0;
+	_batchReplies = nullptr;
+	_batchAtomic = false;
+	_serverInfoVersion = 0;
 
 	connect(_ledStreamTimer, &QTimer::timeout, this, &JsonAPI::handleLedColorsTimer, Qt::UniqueConnection);
+	connect(_logBatchTimer, &QTimer::timeout, this, &JsonAPI::flushLogBatch);
 
 	Q_INIT_RESOURCE(JSONRPC_schemas);
 }
 
+JsonAPI::~JsonAPI()
+{
+	// stops the encoder before the object that receives its frames is gone
+	_imageStreamEncoder.reset();
+}
+
 void JsonAPI::handleMessage(const QString& messageString, const QString& httpAuthHeader)
 {
 	try
@@ -86,19 +195,23 @@ void JsonAPI::handleMessage(const QString& messageString, const QString& httpAut
 		if (message.value("tan") != QJsonValue::Undefined)
 			tan = message["tan"].toInt();
 
-		// check basic message
-		if (!JsonUtils::validate(ident, message, ":schema", _log))
-		{
-			sendErrorReply("Errors during message validation, please consult the HyperHDR Log.", "" /*command*/, tan);
-			return;
-		}
-
-		// check specific message
 		const QString command = message["command"].toString();
-		if (!JsonUtils::validate(ident, message, QString(":schema-%1").arg(command), _log))
+
+		if (!isValidHotCommand(command, message, _log))
 		{
-			sendErrorReply("Errors during specific message validation, please consult the HyperHDR Log", command, tan);
-			return;
+			// check basic message
+			if (!validateCommand(ident, message, ":schema", _log))
+			{
+				sendErrorReply("Errors during message validation, please consult the HyperHDR Log.", "" /*command*/, tan);
+				return;
+			}
+
+			// check specific message
+			if (!validateCommand(ident, message, QString(":schema-%1").arg(command), _log))
+			{
+				sendErrorReply("Errors during specific message validation, please consult the HyperHDR Log", command, tan);
+				return;
+			}
 		}
 
 		// client auth before everything else but not for http
@@ -136,76 +249,13 @@ void JsonAPI::handleMessage(const QString& messageString, const QString& httpAut
 			sendErrorReply("Not ready", command, tan);
 			return;
 		}
+		else if (command == "batch")
+		{
+			handleBatchCommand(message, command, tan);
+		}
 		else
 		{
-			// switch over all possible commands and handle them
-			if (command == "color")
-				handleColorCommand(message, command, tan);
-			else if (command == "image")
-				handleImageCommand(message, command, tan);
-			else if (command == "effect")
-				handleEffectCommand(message, command, tan);
-			else if (command == "sysinfo")
-				handleSysInfoCommand(message, command, tan);
-			else if (command == "serverinfo")
-				handleServerInfoCommand(message, command, tan);
-			else if (command == "clear")
-				handleClearCommand(message, command, tan);
-			else if (command == "adjustment")
-				handleAdjustmentCommand(message, command, tan);
-			else if (command == "sourceselect")
-				handleSourceSelectCommand(message, command, tan);
-			else if (command == "config")
-				handleConfigCommand(message, command, tan);
-			else if (command == "componentstate")
-				handleComponentStateCommand(message, command, tan);
-			else if (command == "ledcolors")
-				handleLedColorsCommand(message, command, tan);
-			else if (command == "logging")
-				handleLoggingCommand(message, command, tan);
-			else if (command == "processing")
-				handleProcessingCommand(message, command, tan);
-			else if (command == "videomodehdr")
-				handleVideoModeHdrCommand(message, command, tan);
-			else if (command == "lut-calibration")
-				handleLutCalibrationCommand(message, command, tan);
-			else if (command == "instance")
-				handleInstanceCommand(message, command, tan);
-			else if (command == "leddevice")
-				handleLedDeviceCommand(message, command, tan);
-			else if (command == "save-db")
-				handleSaveDB(message, command, tan);
-			else if (command == "load-db")
-				handleLoadDB(message, command, tan);
-			else if (command == "tunnel")
-				handleTunnel(message, command, tan);
-			else if (command == "signal-calibration")
-				handleLoadSignalCalibration(message, command, tan);
-			else if (command == "performance-counters")
-				handlePerformanceCounters(message, command, tan);
-			else if (command == "clearall")
-				handleClearallCommand(message, command, tan);
-			else if (command == "help")
-				handleHelpCommand(message, command, tan);
-			else if (command == "video-crop")
-				handleCropCommand(message, command, tan);
-			else if (command == "video-controls")
-				handleVideoControlsCommand(message, command, tan);
-			else if (command == "benchmark")
-				handleBenchmarkCommand(message, command, tan);
-			else if (command == "lut-install")
-				handleLutInstallCommand(message, command, tan);
-			else if (command == "smoothing")
-				handleSmoothingCommand(message, command, tan);
-			else if (command == "current-state")
-				handleCurrentStateCommand(message, command, tan);
-			else if (command == "transform" || command == "correction" || command == "temperature")
-				sendErrorReply("The command " + command + "is deprecated, please use the HyperHDR Web Interface to configure", command, tan);
-			// END
-
-			// handle not implemented commands
-			else
-				handleNotImplemented(command, tan);
+			handleCommand(message, command, tan);
 		}
 	}
 	catch (...)
@@ -214,6 +264,176 @@ void JsonAPI::handleMessage(const QString& messageString, const QString& httpAut
 	}
 }
 
+void JsonAPI::handleCommand(const QJsonObject& message, const QString& command, int tan)
+{
+	// switch over all possible commands and handle them
+	if (command == "color")
+		handleColorCommand(message, command, tan);
+	else if (command == "image")
+		handleImageCommand(message, command, tan);
+	else if (command == "effect")
+		handleEffectCommand(message, command, tan);
+	else if (command == "sysinfo")
+		handleSysInfoCommand(message, command, tan);
+	else if (command == "serverinfo")
+		handleServerInfoCommand(message, command, tan);
+	else if (command == "clear")
+		handleClearCommand(message, command, tan);
+	else if (command == "adjustment")
+		handleAdjustmentCommand(message, command, tan);
+	else if (command == "sourceselect")
+		handleSourceSelectCommand(message, command, tan);
+	else if (command == "config")
+		handleConfigCommand(message, command, tan);
+	else if (command == "componentstate")
+		handleComponentStateCommand(message, command, tan);
+	else if (command == "ledcolors")
+		handleLedColorsCommand(message, command, tan);
+	else if (command == "logging")
+		handleLoggingCommand(message, command, tan);
+	else if (command == "processing")
+		handleProcessingCommand(message, command, tan);
+	else if (command == "videomodehdr")
+		handleVideoModeHdrCommand(message, command, tan);
+	else if (command == "lut-calibration")
+		handleLutCalibrationCommand(message, command, tan);
+	else if (command == "instance")
+		handleInstanceCommand(message, command, tan);
+	else if (command == "leddevice")
+		handleLedDeviceCommand(message, command, tan);
+	else if (command == "save-db")
+		handleSaveDB(message, command, tan);
+	else if (command == "load-db")
+		handleLoadDB(message, command, tan);
+	else if (command == "tunnel")
+		handleTunnel(message, command, tan);
+	else if (command == "signal-calibration")
+		handleLoadSignalCalibration(message, command, tan);
+	else if (command == "video-tuner")
+		handleVideoTunerCommand(message, command, tan);
+	else if (command == "performance-counters")
+		handlePerformanceCounters(message, command, tan);
+	else if (command == "clearall")
+		handleClearallCommand(message, command, tan);
+	else if (command == "help")
+		handleHelpCommand(message, command, tan);
+	else if (command == "video-crop")
+		handleCropCommand(message, command, tan);
+	else if (command == "video-controls")
+		handleVideoControlsCommand(message, command, tan);
+	else if (command == "benchmark")
+		handleBenchmarkCommand(message, command, tan);
+	else if (command == "replay")
+		handleReplayCommand(message, command, tan);
+	else if (command == "capture-recording")
+		handleCaptureRecordingCommand(message, command, tan);
+	else if (command == "event-trace")
+		handleEventTraceCommand(message, command, tan);
+	else if (command == "memory-accounting")
+		handleMemoryAccountingCommand(message, command, tan);
+	else if (command == "lut-install")
+		handleLutInstallCommand(message, command, tan);
+	else if (command == "smoothing")
+		handleSmoothingCommand(message, command, tan);
+	else if (command == "current-state")
+		handleCurrentStateCommand(message, command, tan);
+	else if (command == "transform" || command == "correction" || command == "temperature")
+		sendErrorReply("The command " + command + "is deprecated, please use the HyperHDR Web Interface to configure", command, tan);
+	// END
+
+	// handle not implemented commands
+	else
+		handleNotImplemented(command, tan);
+}
+
+void JsonAPI::handleBatchCommand(const QJsonObject& message, const QString& command, int tan)
+{
+	const QString ident = "JsonRpc@" + _peerAddress;
+	const QJsonArray commands = message["commands"].toArray();
+	const bool atomic = message["atomic"].toBool(false);
+	QStringList errors;
+
+	// the commands are validated up front: an atomic batch is refused as a whole
+	for (int i = 0; i < commands.size(); i++)
+	{
+		const QJsonObject entry = commands[i].toObject();
+		const QString entryCommand = entry["command"].toString();
+		QString error;
+
+		if (!isValidHotCommand(entryCommand, entry, _log) &&
+			(!validateCommand(ident, entry, ":schema", _log) ||
+			!validateCommand(ident, entry, QString(":schema-%1").arg(entryCommand), _log)))
+			error = "Errors during message validation, please consult the HyperHDR Log";
+		else if (entryCommand == "batch" || entryCommand == "authorize")
+			error = "The command " + entryCommand + " is not allowed in a batch";
+
+		if (atomic && !error.isEmpty())
+		{
+			sendErrorReply(QString("Command %1 of the batch: %2").arg(i).arg(error), command, tan);
+			return;
+		}
+
+		errors.append(error);
+	}
+
+	QJsonArray replies;
+
+	_batchReplies = &replies;
+	_batchAtomic = atomic;
+	_batchConfig = QJsonObject();
+	_batchConfigReplies.clear();
+
+	for (int i = 0; i < commands.size(); i++)
+	{
+		const QJsonObject entry = commands[i].toObject();
+		const QString entryCommand = entry["command"].toString();
+		const int entryTan = entry["tan"].toInt(tan);
+
+		try
+		{
+			if (!errors[i].isEmpty())
+				sendErrorReply(errors[i], entryCommand, entryTan);
+			else
+				handleCommand(entry, entryCommand, entryTan);
+		}
+		catch (...)
+		{
+			sendErrorReply("Exception", entryCommand, entryTan);
+		}
+	}
+
+	// the settings of an atomic batch are saved together: every changed type is announced once
+	if (!_batchConfig.isEmpty() && !(API::isHyperhdrEnabled() && API::saveSettings(_batchConfig)))
+	{
+		for (int index : _batchConfigReplies)
+		{
+			QJsonObject failed = replies[index].toObject();
+			failed["success"] = false;
+			failed["error"] = "Save settings failed";
+			replies[index] = failed;
+		}
+	}
+
+	_batchReplies = nullptr;
+	_batchAtomic = false;
+	_batchConfig = QJsonObject();
+	_batchConfigReplies.clear();
+
+	bool success = true;
+	for (const auto& entry : replies)
+		success = success && entry.toObject()["success"].toBool(false);
+
+	QJsonObject reply;
+	reply["success"] = success;
+	reply["command"] = command;
+	reply["tan"] = tan;
+	reply["info"] = replies;
+	if (!success)
+		reply["error"] = "One or more commands of the batch failed";
+
+	emit callbackMessage(reply);
+}
+
 void JsonAPI::initialize()
 {
 	// init API, REQUIRED!
@@ -280,7 +500,7 @@ void JsonAPI::handleImageCommand(const QJsonObject& message, const QString& comm
 	idata.scale = message["scale"].toInt(-1);
 	idata.format = message["format"].toString();
 	idata.imgName = message["name"].toString("");
-	idata.data = QByteArray::fromBase64(QByteArray(message["imagedata"].toString().toUtf8()));
+	idata.encoded = message["imagedata"].toString();
 	QString replyMsg;
 
 	if (!API::setImage(idata, COMP_IMAGE, replyMsg))
@@ -485,7 +705,9 @@ void JsonAPI::handleServerInfoCommand(const QJsonObject& message, const QString&
 			//     END    //
 			////////////////
 
-			sendSuccessDataReply(QJsonDocument(info), command, tan);
+			qint64 since = (message.contains("since")) ? message["since"].toVariant().toLongLong() : -1;
+
+			sendSuccessDataReply(QJsonDocument(trackServerInfo(info, since)), command, tan);
 		}
 		else
 			sendSuccessReply(command, tan);
@@ -524,6 +746,55 @@ void JsonAPI::handleServerInfoCommand(const QJsonObject& message, const QString&
 	}
 }
 
+QJsonObject JsonAPI::trackServerInfo(const QJsonObject& info, qint64 since)
+{
+	const qint64 next = _serverInfoVersion + 1;
+	bool changed = false;
+
+	for (auto it = info.constBegin(); it != info.constEnd(); ++it)
+	{
+		auto sent = _serverInfoSent.find(it.key());
+		if (sent == _serverInfoSent.end() || sent->value != it.value())
+		{
+			_serverInfoSent[it.key()] = ServerInfoEntry{ it.value(), next };
+			changed = true;
+		}
+	}
+
+	for (auto sent = _serverInfoSent.begin(); sent != _serverInfoSent.end(); ++sent)
+		if (!sent->value.isUndefined() && !info.contains(sent.key()))
+		{
+			*sent = ServerInfoEntry{ QJsonValue(QJsonValue::Undefined), next };
+			changed = true;
+		}
+
+	if (changed)
+		_serverInfoVersion = next;
+
+	// unknown version (ex. the client of a restarted server): the complete serverinfo
+	if (since < 0 || since > _serverInfoVersion)
+	{
+		QJsonObject complete = info;
+		complete["version"] = _serverInfoVersion;
+		return complete;
+	}
+
+	QJsonObject changes;
+	QJsonArray removed;
+	for (auto sent = _serverInfoSent.constBegin(); sent != _serverInfoSent.constEnd(); ++sent)
+		if (sent->version > since)
+		{
+			if (sent->value.isUndefined())
+				removed.append(sent.key());
+			else
+				changes[sent.key()] = sent->value;
+		}
+
+	changes["version"] = _serverInfoVersion;
+	changes["removed"] = removed;
+	return changes;
+}
+
 void JsonAPI::handleClearCommand(const QJsonObject& message, const QString& command, int tan)
 {
 	emit forwardJsonMessage(message);
@@ -550,7 +821,7 @@ void JsonAPI::handleHelpCommand(const QJsonObject& message, const QString& comma
 {
 	QJsonObject req;
 
-	req["available_commands"] = "color, image, effect, serverinfo, clear, clearall, adjustment, sourceselect, config, componentstate, ledcolors, logging, processing, sysinfo, videomodehdr, videomode, video-crop, authorize, instance, leddevice, transform, correction, temperature, help";
+	req["available_commands"] = "color, image, effect, serverinfo, clear, clearall, adjustment, sourceselect, config, componentstate, ledcolors, logging, processing, sysinfo, videomodehdr, videomode, video-crop, authorize, instance, leddevice, transform, correction, temperature, help, batch";
 	sendSuccessDataReply(QJsonDocument(req), command, tan);
 }
 
@@ -579,8 +850,19 @@ void JsonAPI::handleBenchmarkCommand(const QJsonObject& message, const QString&
 		{
 			emit GrabberWrapper::getInstance()->benchmarkUpdate(status, "pong");
 		}
+		else if (subc == "start")
+		{
+			QUEUE_CALL_2(LatencyBenchmark::getInstance(), begin, bool, message["leds"].toBool(false), QString, message["photodiode"].toString().trimmed());
+		}
+		else if (subc == "stop")
+		{
+			GrabberWrapper::getInstance()->benchmarkCapture(status, subc);
+			QUEUE_CALL_0(LatencyBenchmark::getInstance(), finish);
+		}
 		else
 		{
+			// the flash is shown now: the start of its latency
+			QUEUE_CALL_3(LatencyBenchmark::getInstance(), request, int, status, QString, subc, qint64, PreciseTimer::now());
 			GrabberWrapper::getInstance()->benchmarkCapture(status, subc);
 		}
 	}
@@ -588,6 +870,136 @@ void JsonAPI::handleBenchmarkCommand(const QJsonObject& message, const QString&
 	sendSuccessReply(command, tan);
 }
 
+void JsonAPI::handleReplayCommand(const QJsonObject& message, const QString& command, int tan)
+{
+	const QString& subc = message["subcommand"].toString().trimmed();
+
+	if (subc == "start")
+	{
+		if (!_adminAuthorized)
+		{
+			sendErrorReply("No Authorization", command, tan);
+			return;
+		}
+
+		// only the recordings of the configuration folder can be replayed, the name is relative to it
+		const QString folder = QDir::cleanPath(_instanceManager->getRootPath() + QDir::separator() + "recordings");
+		const QString name = message["file"].toString();
+		QString fileName = QDir::cleanPath(folder + QDir::separator() + name);
+
+		const QString canonicalFolder = QFileInfo(folder).canonicalFilePath();
+		const QString canonicalFile = QFileInfo(fileName).canonicalFilePath();
+
+		if (name.isEmpty() || QDir::isAbsolutePath(name) || name.contains("..") ||
+			canonicalFolder.isEmpty() || !canonicalFile.startsWith(canonicalFolder + "/"))
+		{
+			sendErrorReply(QString("The recording must be a file of the folder: %1").arg(folder), command, tan);
+			return;
+		}
+
+		fileName = canonicalFile;
+		double speed = message["speed"].toDouble(1.0);
+		int priority = message["priority"].toInt(150);
+		QString error;
+
+		SAFE_CALL_3_RET(_hyperhdr, startReplay, QString, error, QString, fileName, double, speed, int, priority);
+
+		if (!error.isEmpty())
+		{
+			sendErrorReply(error, command, tan);
+			return;
+		}
+	}
+	else
+	{
+		QTimer::singleShot(0, _hyperhdr, [=]() { _hyperhdr->stopReplay(); });
+	}
+
+	sendSuccessReply(command, tan);
+}
+
+void JsonAPI::handleCaptureRecordingCommand(const QJsonObject& message, const QString& command, int tan)
+{
+	const QString& subc = message["subcommand"].toString().trimmed();
+
+	if (GrabberWrapper::getInstance() == nullptr)
+	{
+		sendErrorReply("No grabbers available", command, tan);
+		return;
+	}
+
+	if (subc == "start")
+	{
+		if (!_adminAuthorized)
+		{
+			sendErrorReply("No Authorization", command, tan);
+			return;
+		}
+
+		QString fileName = message["file"].toString(QDir::cleanPath(_instanceManager->getRootPath() + QDir::separator() + "capture_recording.raw"));
+		int frames = message["frames"].toInt(600);
+		QString error;
+
+		SAFE_CALL_2_RET((GrabberWrapper::getInstance()), startCaptureRecording, QString, error, QString, fileName, int, frames);
+
+		if (!error.isEmpty())
+		{
+			sendErrorReply(error, command, tan);
+			return;
+		}
+	}
+	else
+	{
+		GrabberWrapper* grabber = GrabberWrapper::getInstance();
+		QTimer::singleShot(0, grabber, [grabber]() { grabber->stopCaptureRecording(); });
+	}
+
+	sendSuccessReply(command, tan);
+}
+
+void JsonAPI::handleEventTraceCommand(const QJsonObject& message, const QString& command, int tan)
+{
+	const QString& subc = message["subcommand"].toString().trimmed();
+
+	if (subc == "start")
+	{
+		if (!_adminAuthorized)
+		{
+			sendErrorReply("No Authorization", command, tan);
+			return;
+		}
+
+		int capacity = EventTracer::start(message["capacity"].toInt(EventTracer::DEFAULT_CAPACITY));
+		Info(_log, "The event trace is recording, the newest %i events are kept", capacity);
+	}
+	else if (subc == "stop")
+	{
+		EventTracer::stop();
+		Info(_log, "%s", QSTRING_CSTR(EventTracer::getStats()));
+	}
+	else
+	{
+		sendSuccessDataReply(QJsonDocument(EventTracer::toChromeTrace()), command + "-" + subc, tan);
+		return;
+	}
+
+	sendSuccessReply(command + "-" + subc, tan);
+}
+
+void JsonAPI::handleMemoryAccountingCommand(const QJsonObject& message, const QString& command, int tan)
+{
+	const QString& subc = message["subcommand"].toString().trimmed();
+
+	if (subc == "dump")
+		Info(_log, "%s", QSTRING_CSTR(MemoryAccounting::toString()));
+
+	// the messages that wait for the slow clients are not in the socket buffers yet
+	QJsonObject info = MemoryAccounting::toJson();
+	info["sendQueues"] = ClientSendQueue::sessionsToJson();
+
+	sendSuccessDataReply(QJsonDocument(info), command + "-" + subc, tan);
+}
+
 void JsonAPI::lutDownloaded(QNetworkReply* reply, int hardware_brightness, int hardware_contrast, int hardware_saturation, qint64 time)
 {
 	QString fileName = QDir::cleanPath(_instanceManager->getRootPath() + QDir::separator() + "lut_lin_tables.3d");
@@ -763,6 +1175,45 @@ void JsonAPI::handlePerformanceCounters(const QJsonObject& message, const QStrin
 		sendErrorReply("Unknown subcommand", command, tan);
 }
 
+void JsonAPI::handleVideoTunerCommand(const QJsonObject& message, const QString& command, int tan)
+{
+	QJsonDocument retVal;
+	QString subcommand = message["subcommand"].toString("");
+	QString full_command = command + "-" + subcommand;
+
+	if (GrabberWrapper::getInstance() == nullptr)
+	{
+		sendErrorReply("No grabbers available", command, tan);
+		return;
+	}
+
+	if (subcommand == "start")
+	{
+		if (_adminAuthorized)
+		{
+			int targetFps = message["targetFps"].toInt(25);
+			int duration = message["duration"].toInt(4);
+
+			SAFE_CALL_2_RET((GrabberWrapper::getInstance()), startModeTuning, QJsonDocument, retVal, int, targetFps, int, duration);
+			sendSuccessDataReply(retVal, full_command, tan);
+		}
+		else
+			sendErrorReply("No Authorization", command, tan);
+	}
+	else if (subcommand == "stop")
+	{
+		SAFE_CALL_0_RET((GrabberWrapper::getInstance()), stopModeTuning, QJsonDocument, retVal);
+		sendSuccessDataReply(retVal, full_command, tan);
+	}
+	else if (subcommand == "get-info")
+	{
+		SAFE_CALL_0_RET((GrabberWrapper::getInstance()), getModeTuningInfo, QJsonDocument, retVal);
+		sendSuccessDataReply(retVal, full_command, tan);
+	}
+	else
+		sendErrorReply("Unknown subcommand", command, tan);
+}
+
 void JsonAPI::handleLoadSignalCalibration(const QJsonObject& message, const QString& command, int tan)
 {
 	QJsonDocument retVal;
@@ -833,6 +1284,18 @@ void JsonAPI::handleConfigSetCommand(const QJsonObject& message, const QString&
 	if (message.contains("config"))
 	{
 		QJsonObject config = message["config"].toObject();
+
+		// saved once at the end of an atomic batch
+		if (_batchReplies != nullptr && _batchAtomic)
+		{
+			for (auto it = config.begin(); it != config.end(); ++it)
+				_batchConfig[it.key()] = it.value();
+
+			_batchConfigReplies.append(_batchReplies->size());
+			sendSuccessReply(command, tan);
+			return;
+		}
+
 		if (API::isHyperhdrEnabled())
 		{
 			if (API::saveSettings(config))
@@ -935,6 +1398,11 @@ void JsonAPI::handleLedColorsCommand(const QJsonObject& message, const QString&
 		_streaming_leds_reply["command"] = command + "-ledstream-update";
 		_streaming_leds_reply["tan"] = tan;
 
+		// binary frames need a transport that can send them
+		_ledStreamBinary = message["binary"].toBool(false) && isSignalConnected(QMetaMethod::fromSignal(&JsonAPI::callbackBinaryMessage));
+		_ledStreamDelta = _ledStreamBinary && message["delta"].toBool(false);
+		_lastStreamedLeds.clear();
+
 		connect(_hyperhdr, &HyperHdrInstance::rawLedColors, this, &JsonAPI::handleLedColorsIncoming, Qt::UniqueConnection);
 
 		if (!_ledStreamTimer->isActive() || _ledStreamTimer->interval() != _colorsStreamingInterval)
@@ -953,6 +1421,22 @@ void JsonAPI::handleLedColorsCommand(const QJsonObject& message, const QString&
 		_streaming_image_reply["command"] = command + "-imagestream-update";
 		_streaming_image_reply["tan"] = tan;
 
+		// binary frames need a transport that can send them
+		_imageStreamBinary = message["binary"].toBool(false) && isSignalConnected(QMetaMethod::fromSignal(&JsonAPI::callbackBinaryImage));
+		_imageStreamBusy = false;
+
+		if (_imageStreamBinary && _imageStreamEncoder == nullptr)
+		{
+			_imageStreamEncoder = std::unique_ptr<ImageStreamEncoder>(new ImageStreamEncoder(
+				[this](const QByteArray& jpeg) {
+					QMetaObject::invokeMethod(this, [this, jpeg]() {
+						_imageStreamSent = InternalClock::now();
+						emit callbackBinaryImage(jpeg);
+					}, Qt::QueuedConnection);
+				}));
+			_imageStreamEncoder->start();
+		}
+
 		connect(_hyperhdr, &HyperHdrInstance::onCurrentImage, this, &JsonAPI::setImage, Qt::UniqueConnection);
 
 		emit _hyperhdr->onCurrentImage();
@@ -960,6 +1444,7 @@ void JsonAPI::handleLedColorsCommand(const QJsonObject& message, const QString&
 	else if (subcommand == "imagestream-stop")
 	{
 		disconnect(_hyperhdr, &HyperHdrInstance::onCurrentImage, this, 0);
+		_imageStreamBinary = false;
 	}
 	else
 	{
@@ -982,6 +1467,10 @@ void JsonAPI::handleLoggingCommand(const QJsonObject& message, const QString& co
 
 		if (subcommand == "start")
 		{
+			// the messages below the level are dropped before they are serialized
+			const QString level = message["level"].toString("debug");
+			_logMinLevel = (level == "error") ? Logger::ERRORR : (level == "warning") ? Logger::WARNING : (level == "info") ? Logger::INFO : Logger::DEBUG;
+
 			if (!_streaming_logging_activated)
 			{
 				_streaming_logging_reply["command"] = command + "-update";
@@ -995,6 +1484,8 @@ void JsonAPI::handleLoggingCommand(const QJsonObject& message, const QString& co
 			{
 				disconnect(LoggerManager::getInstance(), &LoggerManager::newLogMessage, this, &JsonAPI::incommingLogMessage);
 				_streaming_logging_activated = false;
+				_logBatchTimer->stop();
+				_logBatch.clear();
 				Debug(_log, "log streaming deactivated for client  %s", _peerAddress.toStdString().c_str());
 			}
 		}
@@ -1195,6 +1686,9 @@ void JsonAPI::handleLedDeviceCommand(const QJsonObject& message, const QString&
 
 void JsonAPI::streamLedcolorsUpdate(const std::vector<ColorRgb>& ledColors)
 {
+	if (_ledStreamBinary && streamLedcolorsBinary(ledColors))
+		return;
+
 	QJsonObject result;
 	QJsonArray leds;
 
@@ -1210,10 +1704,97 @@ void JsonAPI::streamLedcolorsUpdate(const std::vector<ColorRgb>& ledColors)
 	emit callbackMessage(_streaming_leds_reply);
 }
 
+bool JsonAPI::streamLedcolorsBinary(const std::vector<ColorRgb>& ledColors)
+{
+	// big endian: 'L', type (0 = all the leds, 1 = delta), led count (uint16)
+	// then RGB of all the leds or the changed runs: first led (uint16), length (uint16), RGB of the run
+	const size_t count = ledColors.size();
+
+	if (count > 0xFFFF)
+		return false;
+
+	auto appendWord = [](QByteArray& buffer, size_t value) {
+		buffer.append(static_cast<char>((value >> 8) & 0xFF));
+		buffer.append(static_cast<char>(value & 0xFF));
+	};
+
+	QByteArray frame;
+	frame.reserve(static_cast<int>(4 + count * 3));
+	frame.append('L');
+	frame.append(static_cast<char>(0));
+	appendWord(frame, count);
+
+	if (_ledStreamDelta && _lastStreamedLeds.size() == count)
+	{
+		QByteArray delta = frame;
+		delta[1] = 1;
+
+		for (size_t i = 0; i < count; )
+		{
+			if (_lastStreamedLeds[i] == ledColors[i])
+			{
+				i++;
+				continue;
+			}
+
+			// a single unchanged led costs less than the header of a new run
+			size_t end = i + 1;
+			while (end < count && (_lastStreamedLeds[end] != ledColors[end] ||
+				(end + 1 < count && _lastStreamedLeds[end + 1] != ledColors[end + 1])))
+				end++;
+
+			appendWord(delta, i);
+			appendWord(delta, end - i);
+			delta.append(reinterpret_cast<const char*>(&ledColors[i]), static_cast<int>((end - i) * 3));
+			i = end;
+		}
+
+		// nothing has changed
+		if (delta.size() == 4)
+			return true;
+
+		if (delta.size() < static_cast<int>(4 + count * 3))
+		{
+			_lastStreamedLeds = ledColors;
+			emit callbackBinaryMessage(delta);
+			return true;
+		}
+	}
+
+	frame.append(reinterpret_cast<const char*>(ledColors.data()), static_cast<int>(count * 3));
+
+	if (_ledStreamDelta)
+		_lastStreamedLeds = ledColors;
+
+	emit callbackBinaryMessage(frame);
+	return true;
+}
+
 void JsonAPI::setImage()
 {
 	uint64_t _currentTime = InternalClock::now();
 
+	if (QualityGovernor::isActive(QualityGovernor::IMAGE_STREAM_RATE) && _currentTime - _lastSendImage < (uint64_t)IMAGE_STREAM_GOVERNOR_INTERVAL)
+		return;
+
+	if (_imageStreamBinary)
+	{
+		// the next frame waits for the previous one to drain (or for a lost client for 2 seconds)
+		if ((_imageStreamBusy && _currentTime - _lastSendImage < 2000) || _currentTime - _lastSendImage < (uint64_t)_imageStreamInterval)
+			return;
+
+		const PriorityMuxer* muxer = this->_hyperhdr->getMuxerInstance();
+		const Image<ColorRgb>& image = muxer->getInputInfo(muxer->getCurrentPriority()).image;
+
+		if (image.width() <= 1 || image.height() <= 1)
+			return;
+
+		_lastSendImage = _currentTime;
+		_imageStreamBusy = true;
+		_imageStreamEncoder->queue(image, _imageStreamQuality);
+		return;
+	}
+
 	if (!_semaphore.tryAcquire() && (_lastSendImage < _currentTime && (_currentTime - _lastSendImage < 2000)))
 		return;
 
@@ -1231,17 +1812,8 @@ void JsonAPI::setImage()
 		return;
 	}
 
-	QImage jpgImage((const uchar*)image.rawMem(), image.width(), image.height() / 2, 6 * image.width(), QImage::Format_RGB888);
-	QByteArray ba;
-	QBuffer buffer(&ba);
-	buffer.open(QIODevice::WriteOnly);
-
-	if (image.width() > 1920)
-	{
-		jpgImage = jpgImage.scaled(image.width() / 2, image.height() / 2);
-	}
-
-	jpgImage.save(&buffer, "jpg");
+	// the clients of all the instances that show the same frame share one encoded preview
+	QByteArray ba = (_instanceManager != nullptr) ? _instanceManager->getFrameContext(image)->getPreviewJpeg() : FrameContext(image, 1).getPreviewJpeg();
 
 	QJsonObject result;
 	result["image"] = "data:image/jpg;base64," + QString(ba.toBase64());
@@ -1257,30 +1829,67 @@ void JsonAPI::releaseLock()
 		_semaphore.release();
 }
 
-void JsonAPI::incommingLogMessage(const Logger::T_LOG_MESSAGE& msg)
+void JsonAPI::releaseImageStream()
 {
-	QJsonObject result, message;
-	QJsonArray messageArray;
+	if (!_imageStreamBusy)
+		return;
+
+	const qint64 drain = InternalClock::now() - _imageStreamSent;
+
+	if (drain > IMAGE_STREAM_SLOW_DRAIN)
+		_imageStreamQuality = qMax(_imageStreamQuality - 10, IMAGE_STREAM_MIN_QUALITY);
+	else if (drain < IMAGE_STREAM_FAST_DRAIN)
+		_imageStreamQuality = qMin(_imageStreamQuality + 5, IMAGE_STREAM_MAX_QUALITY);
+
+	_imageStreamInterval = qBound(IMAGE_STREAM_MIN_INTERVAL, 2 * drain, IMAGE_STREAM_MAX_INTERVAL);
+	_imageStreamBusy = false;
+}
+
+void JsonAPI::resyncLedStream()
+{
+	_lastStreamedLeds.clear();
+}
 
+void JsonAPI::incommingLogMessage(const Logger::T_LOG_MESSAGE& msg)
+{
 	if (!_streaming_logging_activated)
 	{
+		// the first batch carries the history
 		_streaming_logging_activated = true;
 		const QList<Logger::T_LOG_MESSAGE>* logBuffer = LoggerManager::getInstance()->getLogMessageBuffer();
 		for (int i = 0; i < logBuffer->length(); i++)
-		{
-			message["appName"] = logBuffer->at(i).appName;
-			message["loggerName"] = logBuffer->at(i).loggerName;
-			message["function"] = logBuffer->at(i).function;
-			message["line"] = QString::number(logBuffer->at(i).line);
-			message["fileName"] = logBuffer->at(i).fileName;
-			message["message"] = logBuffer->at(i).message;
-			message["levelString"] = logBuffer->at(i).levelString;
-			message["utime"] = QString::number(logBuffer->at(i).utime);
-
-			messageArray.append(message);
-		}
+			if (logBuffer->at(i).level >= _logMinLevel)
+				_logBatch.push_back(logBuffer->at(i));
+
+		flushLogBatch();
+		return;
 	}
-	else
+
+	if (msg.level < _logMinLevel)
+		return;
+
+	_logBatch.push_back(msg);
+
+	if (_logBatch.size() >= static_cast<size_t>(LOG_BATCH_SIZE))
+		flushLogBatch();
+	else if (!_logBatchTimer->isActive())
+		_logBatchTimer->start();
+}
+
+void JsonAPI::flushLogBatch()
+{
+	_logBatchTimer->stop();
+
+	if (_logBatch.empty() || !_streaming_logging_activated)
+	{
+		_logBatch.clear();
+		return;
+	}
+
+	QJsonObject result, message;
+	QJsonArray messageArray;
+
+	for (const auto& msg : _logBatch)
 	{
 		message["appName"] = msg.appName;
 		message["loggerName"] = msg.loggerName;
@@ -1294,6 +1903,8 @@ void JsonAPI::incommingLogMessage(const Logger::T_LOG_MESSAGE& msg)
 		messageArray.append(message);
 	}
 
+	_logBatch.clear();
+
 	result.insert("messages", messageArray);
 	_streaming_logging_reply["result"] = result;
 
@@ -1429,7 +2040,7 @@ void JsonAPI::handleTunnel(const QJsonObject& message, const QString& command, i
 			else
 				reply["info"] = doc.object();
 
-			emit callbackMessage(reply);
+			sendReply(reply);
 		}
 		else
 			sendErrorReply("Service not supported", full_command, tan);
@@ -1526,7 +2137,7 @@ void JsonAPI::handleSysInfoCommand(const QJsonObject&, const QString& command, i
 
 	// send the result
 	result["info"] = info;
-	emit callbackMessage(result);
+	sendReply(result);
 }
 
 void JsonAPI::handleAdjustmentCommand(const QJsonObject& message, const QString& command, int tan)
@@ -1886,6 +2497,15 @@ void JsonAPI::handleNotImplemented(const QString& command, int tan)
 	sendErrorReply("Command not implemented", command, tan);
 }
 
+void JsonAPI::sendReply(const QJsonObject& reply)
+{
+	// the replies of a batch are collected into one
+	if (_batchReplies != nullptr)
+		_batchReplies->append(reply);
+	else
+		emit callbackMessage(reply);
+}
+
 void JsonAPI::sendSuccessReply(const QString& command, int tan)
 {
 	// create reply
@@ -1895,7 +2515,7 @@ void JsonAPI::sendSuccessReply(const QString& command, int tan)
 	reply["tan"] = tan;
 
 	// send reply
-	emit callbackMessage(reply);
+	sendReply(reply);
 }
 
 void JsonAPI::sendSuccessDataReply(const QJsonDocument& doc, const QString& command, int tan)
@@ -1909,7 +2529,7 @@ void JsonAPI::sendSuccessDataReply(const QJsonDocument& doc, const QString& comm
 	else
 		reply["info"] = doc.object();
 
-	emit callbackMessage(reply);
+	sendReply(reply);
 }
 
 void JsonAPI::sendErrorReply(const QString& error, const QString& command, int tan)
@@ -1922,5 +2542,5 @@ void JsonAPI::sendErrorReply(const QString& error, const QString& command, int t
 	reply["tan"] = tan;
 
 	// send reply
-	emit callbackMessage(reply);
+	sendReply(reply);
 }
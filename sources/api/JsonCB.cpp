@@ -3,6 +3,7 @@
 #include <api/JsonCB.h>
 #include <base/HyperHdrInstance.h>
 #include <base/GrabberWrapper.h>
+#include <leddevice/LatencyBenchmark.h>
 #include <base/HyperHdrIManager.h>
 #include <base/ComponentRegister.h>
 #include <base/PriorityMuxer.h>
@@ -13,15 +14,34 @@
 #include <flatbufserver/FlatBufferServer.h>
 
 #include <QVariant>
+#include <QTimer>
 
 using namespace hyperhdr;
 
+namespace
+{
+	// a burst of the state updates (ex. the muxer during an effect or a source switch) is sent once per window [ms]
+	const int PRIORITIES_WINDOW = 100;
+	const int ADJUSTMENT_WINDOW = 100;
+	const int STATE_WINDOW = 50;
+}
+
 JsonCB::JsonCB(QObject* parent)
 	: QObject(parent)
 	, _hyperhdr(nullptr)
 {
 	_availableCommands << "components-update" << "performance-update" << "sessions-update" << "priorities-update" << "imageToLedMapping-update" << "grabberstate-update" << "lut-calibration-update"
 		<< "adjustment-update" << "videomodehdr-update" << "settings-update" << "leds-update" << "instance-update" << "token-update" << "benchmark-update";
+
+	// only the events that carry the complete latest state, the others (progress, benchmark...) are sent as they come
+	_coalescingWindows["priorities-update"] = PRIORITIES_WINDOW;
+	_coalescingWindows["adjustment-update"] = ADJUSTMENT_WINDOW;
+	_coalescingWindows["components-update"] = STATE_WINDOW;
+	_coalescingWindows["imageToLedMapping-update"] = STATE_WINDOW;
+	_coalescingWindows["videomodehdr-update"] = STATE_WINDOW;
+	_coalescingWindows["grabberstate-update"] = STATE_WINDOW;
+	_coalescingWindows["leds-update"] = STATE_WINDOW;
+	_coalescingWindows["instance-update"] = STATE_WINDOW;
 }
 
 void JsonCB::setSubscriptionsTo(HyperHdrInstance* hyperhdr)
@@ -54,7 +74,10 @@ bool JsonCB::subscribeFor(const QString& type, bool unsubscribe)
 		return false;
 
 	if (unsubscribe)
+	{
 		_subscribedCommands.removeAll(type);
+		dropCoalesced(type);
+	}
 	else
 		_subscribedCommands << type;
 
@@ -181,9 +204,17 @@ bool JsonCB::subscribeFor(const QString& type, bool unsubscribe)
 	if (type == "benchmark-update" && GrabberWrapper::instance != nullptr)
 	{
 		if (unsubscribe)
+		{
 			disconnect(GrabberWrapper::instance, &GrabberWrapper::benchmarkUpdate, this, &JsonCB::handleBenchmarkUpdate);
+			disconnect(LatencyBenchmark::getInstance(), &LatencyBenchmark::flashCompleted, this, &JsonCB::handleBenchmarkUpdate);
+			disconnect(LatencyBenchmark::getInstance(), &LatencyBenchmark::statsUpdated, this, &JsonCB::handleBenchmarkStats);
+		}
 		else
+		{
 			connect(GrabberWrapper::instance, &GrabberWrapper::benchmarkUpdate, this, &JsonCB::handleBenchmarkUpdate, Qt::UniqueConnection);
+			connect(LatencyBenchmark::getInstance(), &LatencyBenchmark::flashCompleted, this, &JsonCB::handleBenchmarkUpdate, Qt::UniqueConnection);
+			connect(LatencyBenchmark::getInstance(), &LatencyBenchmark::statsUpdated, this, &JsonCB::handleBenchmarkStats, Qt::UniqueConnection);
+		}
 	}
 
 	return true;
@@ -207,11 +238,14 @@ void JsonCB::resetSubscriptions()
 	}
 }
 
-void JsonCB::doCallback(const QString& cmd, const QVariant& data)
+void JsonCB::doCallback(const QString& cmd, const QVariant& data, int suppressed)
 {
 	QJsonObject obj;
 	obj["command"] = cmd;
 
+	if (suppressed > 0)
+		obj["suppressed"] = suppressed;
+
 	if (data.userType() == QMetaType::QJsonArray)
 		obj["data"] = data.toJsonArray();
 	else
@@ -220,13 +254,84 @@ void JsonCB::doCallback(const QString& cmd, const QVariant& data)
 	emit newCallback(obj);
 }
 
+void JsonCB::doCallbackCoalesced(const QString& cmd, const std::function<QVariant()>& builder, const QString& key)
+{
+	const int window = _coalescingWindows.value(cmd, 0);
+
+	if (window <= 0)
+	{
+		const QVariant data = builder();
+		if (data.isValid())
+			doCallback(cmd, data);
+		return;
+	}
+
+	const QString id = key.isEmpty() ? cmd : cmd + "/" + key;
+	Coalescing& entry = _coalescing[id];
+
+	if (entry.timer == nullptr)
+	{
+		entry.timer = new QTimer(this);
+		entry.timer->setSingleShot(true);
+		entry.timer->setInterval(window);
+		connect(entry.timer, &QTimer::timeout, this, [this, id, cmd]() { flushCoalesced(id, cmd); });
+	}
+
+	// inside the window: the section is only built once, with the final state, when the window closes
+	if (entry.timer->isActive())
+	{
+		if (entry.pending)
+			entry.suppressed++;
+		entry.pending = builder;
+		return;
+	}
+
+	entry.timer->start();
+
+	const QVariant data = builder();
+	if (data.isValid())
+		doCallback(cmd, data);
+}
+
+void JsonCB::flushCoalesced(const QString& id, const QString& cmd)
+{
+	auto it = _coalescing.find(id);
+
+	if (it == _coalescing.end() || !it->pending)
+		return;
+
+	const std::function<QVariant()> builder = it->pending;
+	const int suppressed = it->suppressed;
+
+	it->pending = nullptr;
+	it->suppressed = 0;
+
+	// the trailing update opens a new window, a burst that continues is still merged
+	it->timer->start();
+
+	const QVariant data = builder();
+	if (data.isValid())
+		doCallback(cmd, data, suppressed);
+}
+
+void JsonCB::dropCoalesced(const QString& cmd)
+{
+	for (auto it = _coalescing.begin(); it != _coalescing.end(); ++it)
+		if (it.key() == cmd || it.key().startsWith(cmd + "/"))
+		{
+			it->timer->stop();
+			it->pending = nullptr;
+			it->suppressed = 0;
+		}
+}
+
 void JsonCB::handleComponentState(hyperhdr::Components comp, bool state)
 {
 	QJsonObject data;
 	data["name"] = componentToIdString(comp);
 	data["enabled"] = state;
 
-	doCallback("components-update", QVariant(data));
+	doCallbackCoalesced("components-update", [data]() { return QVariant(data); }, data["name"].toString());
 }
 
 #ifdef ENABLE_BONJOUR
@@ -252,16 +357,20 @@ void JsonCB::handleComponentState(hyperhdr::Components comp, bool state)
 #endif
 
 void JsonCB::handlePriorityUpdate()
+{
+	doCallbackCoalesced("priorities-update", [this]() { return getPriorityInfo(); });
+}
+
+QVariant JsonCB::getPriorityInfo()
 {
 	QJsonObject info;
-	QJsonArray priorities;
 
 	if (_hyperhdr == nullptr)
-		return;
+		return QVariant();
 
 	SAFE_CALL_1_RET(_hyperhdr, getJsonInfo, QJsonObject, info, bool, false);
 
-	doCallback("priorities-update", QVariant(info));
+	return QVariant(info);
 }
 
 void JsonCB::handleImageToLedsMappingChange(int mappingType)
@@ -269,13 +378,18 @@ void JsonCB::handleImageToLedsMappingChange(int mappingType)
 	QJsonObject data;
 	data["imageToLedMappingType"] = ImageProcessor::mappingTypeToStr(mappingType);
 
-	doCallback("imageToLedMapping-update", QVariant(data));
+	doCallbackCoalesced("imageToLedMapping-update", [data]() { return QVariant(data); });
 }
 
 void JsonCB::handleAdjustmentChange()
+{
+	doCallbackCoalesced("adjustment-update", [this]() { return getAdjustmentInfo(); });
+}
+
+QVariant JsonCB::getAdjustmentInfo()
 {
 	if (_hyperhdr == nullptr)
-		return;
+		return QVariant();
 
 	QJsonArray adjustmentArray;
 	for (const QString& adjustmentId : _hyperhdr->getAdjustmentIds())
@@ -342,14 +456,14 @@ void JsonCB::handleAdjustmentChange()
 		adjustmentArray.append(adjustment);
 	}
 
-	doCallback("adjustment-update", QVariant(adjustmentArray));
+	return QVariant(adjustmentArray);
 }
 
 void JsonCB::handleVideoModeHdrChange(int hdr)
 {
 	QJsonObject data;
 	data["videomodehdr"] = hdr;
-	doCallback("videomodehdr-update", QVariant(data));
+	doCallbackCoalesced("videomodehdr-update", [data]() { return QVariant(data); });
 }
 
 void JsonCB::handleGrabberStateChange(QString device, QString videoMode)
@@ -357,7 +471,7 @@ void JsonCB::handleGrabberStateChange(QString device, QString videoMode)
 	QJsonObject data;
 	data["device"] = device;
 	data["videoMode"] = videoMode;
-	doCallback("grabberstate-update", QVariant(data));
+	doCallbackCoalesced("grabberstate-update", [data]() { return QVariant(data); });
 }
 
 void JsonCB::handleSettingsChange(settings::type type, const QJsonDocument& data)
@@ -377,11 +491,16 @@ void JsonCB::handleLedsConfigChange(settings::type type, const QJsonDocument& da
 	{
 		QJsonObject dat;
 		dat[typeToString(type)] = data.array();
-		doCallback("leds-update", QVariant(dat));
+		doCallbackCoalesced("leds-update", [dat]() { return QVariant(dat); });
 	}
 }
 
 void JsonCB::handleInstanceChange()
+{
+	doCallbackCoalesced("instance-update", [this]() { return getInstanceInfo(); });
+}
+
+QVariant JsonCB::getInstanceInfo()
 {
 	QJsonArray arr;
 
@@ -394,7 +513,7 @@ void JsonCB::handleInstanceChange()
 		obj.insert("running", entry["running"].toBool());
 		arr.append(obj);
 	}
-	doCallback("instance-update", QVariant(arr));
+	return QVariant(arr);
 }
 
 void JsonCB::handleTokenChange(const QVector<AuthManager::AuthDefinition>& def)
@@ -419,6 +538,15 @@ void JsonCB::handleBenchmarkUpdate(int status, QString message)
 	doCallback("benchmark-update", QVariant(dat));
 }
 
+void JsonCB::handleBenchmarkStats(const QJsonObject& stats)
+{
+	QJsonObject dat;
+	dat["status"] = -1;
+	dat["message"] = QString("stats");
+	dat["stats"] = stats;
+	doCallback("benchmark-update", QVariant(dat));
+}
+
 void JsonCB::handleLutCalibrationUpdate(const QJsonObject& data)
 {
 	doCallback("lut-calibration-update", QVariant(data));
@@ -7,9 +7,29 @@
 // qt
 #include <QJsonObject>
 #include <QTimer>
+#include <QDateTime>
 
 AuthManager* AuthManager::manager = nullptr;
 
+namespace
+{
+	// the 'last_use' times are written together, not on every authorization
+	const int TOKEN_USE_WRITE_INTERVAL = 60000;
+
+	// the time doesn't depend on the position of the first difference
+	bool constantTimeEquals(const QByteArray& a, const QByteArray& b)
+	{
+		if (a.size() != b.size())
+			return false;
+
+		unsigned char diff = 0;
+		for (int i = 0; i < a.size(); i++)
+			diff |= static_cast<unsigned char>(a[i] ^ b[i]);
+
+		return diff == 0;
+	}
+}
+
 AuthManager::AuthManager(QObject* parent, bool readonlyMode)
 	: QObject(parent)
 	, _authTable(new AuthTable("", this, readonlyMode))
@@ -18,6 +38,10 @@ AuthManager::AuthManager(QObject* parent, bool readonlyMode)
 	, _authRequired(true)
 	, _timer(new QTimer(this))
 	, _authBlockTimer(new QTimer(this))
+	, _tokens()
+	, _userTokens()
+	, _usedUsers()
+	, _tokenUseTimer(new QTimer(this))
 {
 	AuthManager::manager = this;
 
@@ -35,6 +59,11 @@ AuthManager::AuthManager(QObject* parent, bool readonlyMode)
 	_authBlockTimer->setInterval(60000);
 	connect(_authBlockTimer, &QTimer::timeout, this, &AuthManager::checkAuthBlockTimeout);
 
+	// setup tokenUseTimer
+	_tokenUseTimer->setInterval(TOKEN_USE_WRITE_INTERVAL);
+	_tokenUseTimer->setSingleShot(true);
+	connect(_tokenUseTimer, &QTimer::timeout, this, &AuthManager::flushTokenUse);
+
 	// init with default user and password
 	if (!_authTable->userExist(DEFAULT_CONFIG_USER))
 	{
@@ -43,6 +72,49 @@ AuthManager::AuthManager(QObject* parent, bool readonlyMode)
 
 	// update HyperHDR user token on startup
 	_authTable->setUserToken(DEFAULT_CONFIG_USER);
+
+	loadTokens();
+}
+
+AuthManager::~AuthManager()
+{
+	flushTokenUse();
+}
+
+void AuthManager::loadTokens()
+{
+	// the pending times would be lost with the old records
+	flushTokenUse();
+
+	_tokens.clear();
+	for (const auto& record : _authTable->getTokenRecords())
+	{
+		TokenEntry entry;
+		entry.hash = record["token"].toByteArray();
+		entry.id = record["id"].toString();
+		entry.comment = record["comment"].toString();
+		entry.lastUse = record["last_use"].toString();
+		entry.used = false;
+		_tokens.push_back(entry);
+	}
+
+	_userTokens.clear();
+}
+
+void AuthManager::flushTokenUse()
+{
+	_tokenUseTimer->stop();
+
+	for (auto& entry : _tokens)
+		if (entry.used)
+		{
+			_authTable->updateTokenUsed(entry.hash, entry.lastUse);
+			entry.used = false;
+		}
+
+	for (const auto& user : _usedUsers)
+		_authTable->updateUserUsed(user);
+	_usedUsers.clear();
 }
 
 const QString AuthManager::loadPipewire()
@@ -56,6 +128,7 @@ AuthManager::AuthDefinition AuthManager::createToken(const QString& comment)
 	const QString id = QUuid::createUuid().toString().mid(1, 36).left(5);
 
 	_authTable->createToken(token, comment, id);
+	loadTokens();
 
 	AuthDefinition def;
 	def.comment = comment;
@@ -73,18 +146,14 @@ void AuthManager::savePipewire(const QString& wToken)
 
 QVector<AuthManager::AuthDefinition> AuthManager::getTokenList() const
 {
-	QVector<QVariantMap> vector = _authTable->getTokenList();
 	QVector<AuthManager::AuthDefinition> finalVec;
-	for (const auto& entry : vector)
+	for (const auto& entry : _tokens)
 	{
 		AuthDefinition def;
-		def.comment = entry["comment"].toString();
-		def.id = entry["id"].toString();
-		def.lastUse = entry["last_use"].toString();
-
-		// don't add empty ids
-		if (!entry["id"].toString().isEmpty())
-			finalVec.append(def);
+		def.comment = entry.comment;
+		def.id = entry.id;
+		def.lastUse = entry.lastUse;
+		finalVec.append(def);
 	}
 	return finalVec;
 }
@@ -124,12 +193,25 @@ bool AuthManager::isTokenAuthorized(const QString& token)
 	if (isTokenAuthBlocked())
 		return false;
 
-	if (!_authTable->tokenExist(token))
+	// every record is compared, a match doesn't stop the loop
+	const QByteArray hash = _authTable->hashToken(token);
+	TokenEntry* found = nullptr;
+	for (auto& entry : _tokens)
+		if (constantTimeEquals(entry.hash, hash))
+			found = &entry;
+
+	if (found == nullptr)
 	{
 		setAuthBlock();
 		return false;
 	}
-	// timestamp update
+
+	// timestamp update, written later
+	found->lastUse = QDateTime::currentDateTimeUtc().toString(Qt::ISODate);
+	found->used = true;
+	if (!_tokenUseTimer->isActive())
+		_tokenUseTimer->start();
+
 	tokenChange(getTokenList());
 	return true;
 }
@@ -139,11 +221,23 @@ bool AuthManager::isUserTokenAuthorized(const QString& usr, const QString& token
 	if (isUserAuthBlocked())
 		return false;
 
-	if (!_authTable->isUserTokenAuthorized(usr, token))
+	if (!_userTokens.contains(usr))
+		_userTokens[usr] = _authTable->getUserToken(usr);
+
+	const QByteArray& userToken = _userTokens[usr];
+
+	if (userToken.isEmpty() || !constantTimeEquals(userToken, token.toUtf8()))
 	{
 		setAuthBlock(true);
 		return false;
 	}
+
+	// timestamp update, written later
+	if (!_usedUsers.contains(usr))
+		_usedUsers.append(usr);
+	if (!_tokenUseTimer->isActive())
+		_tokenUseTimer->start();
+
 	return true;
 }
 
@@ -192,6 +286,7 @@ void AuthManager::handlePendingTokenRequest(const QString& id, bool accept)
 		{
 			const QString token = QUuid::createUuid().toString().remove("{").remove("}");
 			_authTable->createToken(token, def.comment, id);
+			loadTokens();
 			emit tokenResponse(true, def.caller, token, def.comment, id, def.tan);
 			emit tokenChange(getTokenList());
 		}
@@ -220,6 +315,7 @@ bool AuthManager::renameToken(const QString& id, const QString& comment)
 {
 	if (_authTable->renameToken(id, comment))
 	{
+		loadTokens();
 		emit tokenChange(getTokenList());
 		return true;
 	}
@@ -230,6 +326,7 @@ bool AuthManager::deleteToken(const QString& id)
 {
 	if (_authTable->deleteToken(id))
 	{
+		loadTokens();
 		emit tokenChange(getTokenList());
 		return true;
 	}
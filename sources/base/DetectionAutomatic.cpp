@@ -28,7 +28,9 @@
 #include <base/Grabber.h>
 #include <base/GrabberWrapper.h>
 #include <base/HyperHdrIManager.h>
+#include <utils/SampleCompare.h>
 #include <cmath>
+#include <cstdlib>
 
 DetectionAutomatic::DetectionAutomatic() :
 	_log(Logger::getInstance("SIGNAL_AUTO")),
@@ -444,6 +446,26 @@ void DetectionAutomatic::setAutomaticCalibrationData(QString signature, int qual
 	checkData.height = height;
 	checkData.sdrPoint = sdrVec;
 	checkData.hdrPoint = hdrVec;
+	_sdrSamples.lineStride = _hdrSamples.lineStride = 0;
+}
+
+void DetectionAutomatic::buildSamples(SampleSet& set, const std::vector<calibrationPoint>& points, const ImageView<ColorRgb>& image)
+{
+	set.lineStride = image.lineStride();
+	set.pixelStride = image.pixelStride();
+	set.offsets.clear();
+	set.reference.clear();
+
+	for (const auto& v : points)
+	{
+		set.offsets.push_back(static_cast<ptrdiff_t>(v.y) * set.lineStride + static_cast<ptrdiff_t>(v.x) * set.pixelStride);
+		set.reference.push_back(static_cast<uint8_t>(v.r));
+		set.reference.push_back(static_cast<uint8_t>(v.g));
+		set.reference.push_back(static_cast<uint8_t>(v.b));
+		set.reference.push_back(0);
+	}
+
+	set.samples.resize(set.reference.size());
 }
 
 void DetectionAutomatic::resetStats()
@@ -453,7 +475,7 @@ void DetectionAutomatic::resetStats()
 	_onSignalTime = 0;
 }
 
-bool DetectionAutomatic::checkSignal(Image<ColorRgb>& image)
+bool DetectionAutomatic::checkSignal(const ImageView<ColorRgb>& image)
 {
 	int hdrMode = GrabberWrapper::getInstance()->getHdrToneMappingEnabled();
 
@@ -502,15 +524,17 @@ bool DetectionAutomatic::checkSignal(Image<ColorRgb>& image)
 	}
 
 	std::vector<DetectionAutomatic::calibrationPoint>& data = (hdrMode == 0) ? checkData.sdrPoint : checkData.hdrPoint;
-	int _on = 0, _off = 0;
+	SampleSet& samples = (hdrMode == 0) ? _sdrSamples : _hdrSamples;
 
-	for (const auto& v : data)
-	{
-		if (!image.checkSignal(v.x, v.y, v.r, v.g, v.b, _errorTolerance))
-			_off++;
-		else
-			_on++;
-	}
+	if (samples.lineStride != image.lineStride() || samples.pixelStride != image.pixelStride())
+		buildSamples(samples, data, image);
+
+	const int count = static_cast<int>(samples.offsets.size());
+
+	SampleCompare::gather(image.rawMem(), samples.offsets.data(), count, samples.samples.data());
+
+	int _off = SampleCompare::countAbove(samples.samples.data(), samples.reference.data(), count, _errorTolerance);
+	int _on = count - _off;
 
 	int finalQuality = (_on * checkData.quality) / (_on + _off);
 	bool hasSignal = (finalQuality <= _modelTolerance);
@@ -1,5 +1,6 @@
 
 #include <base/Grabber.h>
+#include <utils/SampleCompare.h>
 
 DetectionManual::DetectionManual() :
 	_log(Logger::getInstance("SIGNAL_OLD"))
@@ -11,14 +12,22 @@ DetectionManual::DetectionManual() :
 	, _noSignalThresholdColor(ColorRgb{ 0,0,0 })
 	, _noSignalDetected(false)
 	, _noSignalCounter(0)
+	, _sampleX(0)
+	, _samplePixels(0)
+	, _sampleWidth(0)
+	, _sampleHeight(0)
+	, _sampleLineStride(0)
+	, _samplePixelStride(0)
 {
 
 };
 
-bool DetectionManual::checkSignalDetectionManual(Image<ColorRgb>& image)
+void DetectionManual::buildSampleRows(const ImageView<ColorRgb>& image)
 {
-	// check signal (only in center of the resulting image, because some grabbers have noise values along the borders)
-	bool noSignal = true;
+	_sampleWidth = image.width();
+	_sampleHeight = image.height();
+	_sampleLineStride = image.lineStride();
+	_samplePixelStride = image.pixelStride();
 
 	// top left
 	unsigned xOffset = image.width() * _x_frac_min;
@@ -28,13 +37,32 @@ bool DetectionManual::checkSignalDetectionManual(Image<ColorRgb>& image)
 	unsigned xMax = image.width() * _x_frac_max;
 	unsigned yMax = image.height() * _y_frac_max;
 
+	_sampleX = xOffset;
+	_samplePixels = (xMax > xOffset) ? xMax - xOffset : 0;
+	_sampleRows.clear();
+
+	for (unsigned y = yOffset; _samplePixels > 0 && y < yMax; ++y)
+		_sampleRows.push_back(static_cast<ptrdiff_t>(y) * _sampleLineStride + static_cast<ptrdiff_t>(xOffset) * _samplePixelStride);
+}
+
+bool DetectionManual::checkSignalDetectionManual(const ImageView<ColorRgb>& image)
+{
+	// check signal (only in center of the resulting image, because some grabbers have noise values along the borders)
+	bool noSignal = true;
+
+	if (_sampleWidth != image.width() || _sampleHeight != image.height() ||
+		_sampleLineStride != image.lineStride() || _samplePixelStride != image.pixelStride())
+		buildSampleRows(image);
 
-	for (unsigned x = xOffset; noSignal && x < xMax; ++x)
+	const uint8_t* base = image.rawMem();
+
+	for (size_t row = 0; noSignal && row < _sampleRows.size(); ++row)
 	{
-		for (unsigned y = yOffset; noSignal && y < yMax; ++y)
-		{
-			noSignal &= (ColorRgb&)image(x, y) <= _noSignalThresholdColor;
-		}
+		if (_samplePixelStride == sizeof(ColorRgb))
+			noSignal = SampleCompare::rowBelow(base + _sampleRows[row], _samplePixels, _noSignalThresholdColor);
+		else
+			for (unsigned x = 0; noSignal && x < _samplePixels; ++x)
+				noSignal = *reinterpret_cast<const ColorRgb*>(base + _sampleRows[row] + static_cast<ptrdiff_t>(x) * _samplePixelStride) <= _noSignalThresholdColor;
 	}
 
 	if (noSignal)
@@ -81,11 +109,22 @@ void DetectionManual::setSignalDetectionOffset(double horizontalMin, double vert
 	_y_frac_min = verticalMin;
 	_x_frac_max = horizontalMax;
 	_y_frac_max = verticalMax;
+	_sampleWidth = _sampleHeight = 0;
 
 	Debug(_log, "Signal detection area set to: %f,%f x %f,%f", _x_frac_min, _y_frac_min, _x_frac_max, _y_frac_max);
 }
 
+QRectF DetectionManual::getSignalDetectionArea() const
+{
+	return QRectF(QPointF(_x_frac_min, _y_frac_min), QPointF(_x_frac_max, _y_frac_max));
+}
+
 bool DetectionManual::getDetectionManualSignal()
 {
 	return !_noSignalDetected;
 }
+
+bool DetectionManual::isManualSignalLost() const
+{
+	return _noSignalCounter >= _noSignalCounterThreshold;
+}
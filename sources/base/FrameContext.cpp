@@ -0,0 +1,162 @@
+/* FrameContext.cpp
+*
+*  MIT License
+*
+*  Copyright (c) 2023 awawa-dev
+*
+*  Project homesite: https://github.com/awawa-dev/HyperHDR
+*
+*  Permission is hereby granted, free of charge, to any person obtaining a copy
+*  of this software and associated documentation files (the "Software"), to deal
+*  in the Software without restriction, including without limitation the rights
+*  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+*  copies of the Software, and to permit persons to whom the Software is
+*  furnished to do so, subject to the following conditions:
+*
+*  The above copyright notice and this permission notice shall be included in all
+*  copies or substantial portions of the Software.
+
+*  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+*  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+*  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+*  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+*  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+*  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+*  SOFTWARE.
+ */
+
+#include <base/FrameContext.h>
+#include <utils/ImageIngest.h>
+#include <utils/ImagePyramid.h>
+
+#include <QImage>
+#include <QBuffer>
+
+using namespace hyperhdr;
+
+FrameContext::FrameContext(const Image<ColorRgb>& image, int expectedConsumers)
+	: _image(image)
+	, _expectedConsumers(expectedConsumers)
+	, _consumers(1)
+	, _borders()
+	, _integral()
+	, _preview()
+{
+}
+
+const Image<ColorRgb>& FrameContext::image() const
+{
+	return _image;
+}
+
+bool FrameContext::isFrame(const Image<ColorRgb>& image) const
+{
+	return _image.rawMem() == image.rawMem() && _image.width() == image.width() && _image.height() == image.height() &&
+		_image.timestamp() == image.timestamp();
+}
+
+bool FrameContext::isShared() const
+{
+	return _expectedConsumers > 1;
+}
+
+void FrameContext::addConsumer()
+{
+	_consumers++;
+}
+
+int FrameContext::getConsumers() const
+{
+	return _consumers;
+}
+
+BlackBorder FrameContext::getBlackBorder(const QString& mode, double threshold, const BlackBorderDetector& detector) const
+{
+	// the instances with the same settings wait for the first one instead of repeating the scan
+	std::lock_guard<std::mutex> lockGuard(_borderLock);
+
+	for (const BorderEntry& entry : _borders)
+		if (entry.threshold == threshold && entry.mode == mode)
+			return entry.border;
+
+	BlackBorder border;
+
+	if (mode == "classic")
+		border = detector.process_classic(_image);
+	else if (mode == "osd")
+		border = detector.process_osd(_image);
+	else if (mode == "letterbox")
+		border = detector.process_letterbox(_image);
+	else if (mode == "histogram")
+		border = detector.process_histogram(_image);
+	else
+		border = detector.process(_image);
+
+	_borders.push_back({ mode, threshold, border });
+
+	return border;
+}
+
+const std::vector<uint32_t>& FrameContext::getIntegralImage() const
+{
+	std::call_once(_integralOnce, [this]() {
+		const size_t width = _image.width();
+		const size_t height = _image.height();
+		const size_t tableLine = (width + 1) * 3;
+
+		_integral.assign(tableLine * (height + 1), 0);
+
+		for (size_t y = 0; y < height; y++)
+		{
+			const uint8_t* source = _image.rawMem() + y * width * 3;
+			const uint32_t* above = _integral.data() + y * tableLine + 3;
+			uint32_t* current = _integral.data() + (y + 1) * tableLine + 3;
+			uint32_t sumRed = 0, sumGreen = 0, sumBlue = 0;
+
+			for (size_t x = 0; x < width; x++, source += 3, above += 3, current += 3)
+			{
+				sumRed += source[0];
+				sumGreen += source[1];
+				sumBlue += source[2];
+
+				current[0] = above[0] + sumRed;
+				current[1] = above[1] + sumGreen;
+				current[2] = above[2] + sumBlue;
+			}
+		}
+	});
+
+	return _integral;
+}
+
+QByteArray FrameContext::getPreviewJpeg() const
+{
+	std::call_once(_previewOnce, [this]() {
+		if (_image.width() <= 1 || _image.height() <= 1)
+			return;
+
+		// the half of a large frame comes from its pyramid when it has one, else it's scaled here
+		const int wanted = (_image.width() > 1920) ? 2 : 1;
+		int factor = wanted;
+		const Image<ColorRgb> level = ImagePyramid::level(_image, factor);
+		const bool halved = (factor < wanted);
+
+		// the only full frame tone mapping of a source that maps the LED colors (a level is mapped instead)
+		const Image<ColorRgb> image = ImageIngest::resolveDeferred(level);
+
+		// every second line of the frame, the level already has the size of the preview
+		QImage jpgImage((const uchar*)image.rawMem(), image.width(), (halved) ? image.height() : image.height() / 2,
+			((halved) ? 3 : 6) * image.width(), QImage::Format_RGB888);
+		QBuffer buffer(&_preview);
+		buffer.open(QIODevice::WriteOnly);
+
+		if (factor > 1)
+		{
+			jpgImage = jpgImage.scaled(_image.width() / 2, _image.height() / 2);
+		}
+
+		jpgImage.save(&buffer, "jpg");
+	});
+
+	return _preview;
+}
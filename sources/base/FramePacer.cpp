@@ -0,0 +1,107 @@
+/* FramePacer.cpp
+*
+*  MIT License
+*
+*  Copyright (c) 2023 awawa-dev
+*
+*  Project homesite: https://github.com/awawa-dev/HyperHDR
+*
+*  Permission is hereby granted, free of charge, to any person obtaining a copy
+*  of this software and associated documentation files (the "Software"), to deal
+*  in the Software without restriction, including without limitation the rights
+*  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+*  copies of the Software, and to permit persons to whom the Software is
+*  furnished to do so, subject to the following conditions:
+*
+*  The above copyright notice and this permission notice shall be included in all
+*  copies or substantial portions of the Software.
+
+*  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+*  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+*  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+*  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+*  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+*  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+*  SOFTWARE.
+*/
+
+
+#include <base/FramePacer.h>
+#include <utils/PreciseTimer.h>
+#include <utils/WriteCadence.h>
+
+namespace
+{
+	/// the queued delivery to the device thread before its write [ns]
+	const qint64 DELIVERY_MARGIN = 1000000;
+
+	/// smaller errors are the jitter of the ticks and of the writes [ns]
+	const qint64 ALIGNED = 250000;
+}
+
+FramePacer::FramePacer() :
+	_processing(0)
+{
+}
+
+void FramePacer::reset()
+{
+	_processing = 0;
+}
+
+void FramePacer::addProcessingTime(qint64 duration)
+{
+	_processing = (_processing <= 0) ? duration : _processing + (duration - _processing) / 8;
+}
+
+qint64 FramePacer::lead() const
+{
+	return DELIVERY_MARGIN + 2 * _processing;
+}
+
+void FramePacer::pace(PreciseTimer* timer, const WriteCadence* cadence)
+{
+	if (timer == nullptr || cadence == nullptr)
+		return;
+
+	const qint64 nextTick = timer->nextTick();
+	const qint64 interval = static_cast<qint64>(timer->interval()) * 1000000;
+	qint64 slot = 0, period = 0;
+
+	if (nextTick < 0 || interval <= 0 || !cadence->nextSlot(nextTick, slot, period))
+		return;
+
+	// one tick before every slot is enough: the smaller of the two periods is the one to lock to
+	const qint64 modulus = qMin(interval, period);
+	const qint64 multiple = qMax(interval, period);
+
+	// without a common cadence (ex. 16ms and 20ms) there is no phase to keep, every tick would only chase the next slot
+	const qint64 rest = multiple % modulus;
+	if (qMin(rest, modulus - rest) > modulus / 20)
+		return;
+
+	qint64 error = (slot - lead() - nextTick) % modulus;
+	if (error > modulus / 2)
+		error -= modulus;
+	else if (error <= -modulus / 2)
+		error += modulus;
+
+	if (error > ALIGNED || error < -ALIGNED)
+	{
+		// a quarter of the error per tick, the interval changes by an eighth at most: no visible jump
+		const qint64 limit = interval / 8;
+		timer->shiftSchedule(qBound(-limit, error / 4, limit));
+	}
+}
+
+bool FramePacer::isDeviceReady(const PreciseTimer* timer, const WriteCadence* cadence) const
+{
+	if (timer == nullptr || cadence == nullptr)
+		return true;
+
+	const qint64 readyTime = cadence->readyTime();
+	const qint64 nextTick = timer->nextTick();
+
+	// the frame of the next tick would also arrive before the write ends and replace this one
+	return readyTime <= 0 || nextTick < 0 || readyTime <= nextTick + lead();
+}
@@ -0,0 +1,407 @@
+/* GpuLedReducer.cpp
+*
+*  MIT License
+*
+*  Copyright (c) 2023 awawa-dev
+*
+*  Project homesite: https://github.com/awawa-dev/HyperHDR
+*
+*  Permission is hereby granted, free of charge, to any person obtaining a copy
+*  of this software and associated documentation files (the "Software"), to deal
+*  in the Software without restriction, including without limitation the rights
+*  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+*  copies of the Software, and to permit persons to whom the Software is
+*  furnished to do so, subject to the following conditions:
+*
+*  The above copyright notice and this permission notice shall be included in all
+*  copies or substantial portions of the Software.
+
+*  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+*  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+*  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+*  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+*  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+*  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+*  SOFTWARE.
+ */
+
+#include <cstring>
+
+#include <base/GpuLedReducer.h>
+
+#ifdef ENABLE_GLES_COMPUTE
+
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+#include <GLES3/gl31.h>
+
+#ifndef EGL_PLATFORM_SURFACELESS_MESA
+	#define EGL_PLATFORM_SURFACELESS_MESA 0x31DD
+#endif
+
+namespace
+{
+	// one work group per led: the lanes walk the pixels of the rectangle, the partial sums are reduced in the shared memory
+	const char* computeShader =
+		"#version 310 es\n"
+		"layout(local_size_x = 64) in;\n"
+		"uniform highp sampler2D frame;\n"
+		"layout(std430, binding = 0) readonly buffer Areas { ivec4 areas[]; };\n"
+		"layout(std430, binding = 1) writeonly buffer Sums { uvec4 sums[]; };\n"
+		"shared uvec3 partial[64];\n"
+		"void main() {\n"
+		"	uint led = gl_WorkGroupID.x;\n"
+		"	uint lane = gl_LocalInvocationID.x;\n"
+		"	ivec4 area = areas[led];\n"
+		"	int width = max(area.z - area.x, 0);\n"
+		"	int count = width * max(area.w - area.y, 0);\n"
+		"	uvec3 sum = uvec3(0u);\n"
+		"	for (int i = int(lane); i < count; i += 64) {\n"
+		"		ivec2 position = ivec2(area.x + i % width, area.y + i / width);\n"
+		"		sum += uvec3(texelFetch(frame, position, 0).rgb * 255.0 + 0.5);\n"
+		"	}\n"
+		"	partial[lane] = sum;\n"
+		"	barrier();\n"
+		"	for (uint step = 32u; step > 0u; step >>= 1u) {\n"
+		"		if (lane < step)\n"
+		"			partial[lane] += partial[lane + step];\n"
+		"		barrier();\n"
+		"	}\n"
+		"	if (lane == 0u)\n"
+		"		sums[led] = uvec4(partial[0], uint(count));\n"
+		"}\n";
+
+	bool hasExtension(const char* extensions, const char* name)
+	{
+		if (extensions == nullptr)
+			return false;
+
+		size_t len = strlen(name);
+		for (const char* pos = strstr(extensions, name); pos != nullptr; pos = strstr(pos + len, name))
+			if ((pos == extensions || pos[-1] == ' ') && (pos[len] == ' ' || pos[len] == '\0'))
+				return true;
+
+		return false;
+	}
+}
+
+GpuLedReducer::GpuLedReducer(Logger* log) :
+	_log(log),
+	_display(EGL_NO_DISPLAY),
+	_context(EGL_NO_CONTEXT),
+	_ready(false),
+	_program(0),
+	_texture(0),
+	_areasBuffer(0),
+	_sumsBuffer(0),
+	_textureWidth(0),
+	_textureHeight(0),
+	_buffersSize(0)
+{
+}
+
+GpuLedReducer::~GpuLedReducer()
+{
+	release();
+}
+
+bool GpuLedReducer::isReady() const
+{
+	return _ready;
+}
+
+bool GpuLedReducer::init()
+{
+	if (_ready)
+		return true;
+
+	const char* clientExtensions = eglQueryString(EGL_NO_DISPLAY, EGL_EXTENSIONS);
+	auto getPlatformDisplay = reinterpret_cast<PFNEGLGETPLATFORMDISPLAYEXTPROC>(eglGetProcAddress("eglGetPlatformDisplayEXT"));
+	EGLDisplay display = EGL_NO_DISPLAY;
+
+	// no window system is needed, the headless boards have none
+	if (getPlatformDisplay != nullptr && hasExtension(clientExtensions, "EGL_MESA_platform_surfaceless"))
+		display = getPlatformDisplay(EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, nullptr);
+
+	if (display == EGL_NO_DISPLAY)
+		display = eglGetDisplay(EGL_DEFAULT_DISPLAY);
+
+	EGLint major = 0, minor = 0;
+	if (display == EGL_NO_DISPLAY || !eglInitialize(display, &major, &minor))
+	{
+		Warning(_log, "Could not initialize the EGL display, the led colors are computed on the CPU");
+		return false;
+	}
+
+	_display = display;
+
+	if (!hasExtension(eglQueryString(display, EGL_EXTENSIONS), "EGL_KHR_surfaceless_context") || !initContext())
+	{
+		Warning(_log, "EGL %d.%d: could not create a surfaceless GLES 3.1 context, the led colors are computed on the CPU", major, minor);
+		release();
+		return false;
+	}
+
+	if (!initProgram())
+	{
+		Warning(_log, "Could not build the GLES compute shader, the led colors are computed on the CPU");
+		release();
+		return false;
+	}
+
+	Info(_log, "The led colors are computed on the GPU: %s (EGL %d.%d)", reinterpret_cast<const char*>(glGetString(GL_RENDERER)), major, minor);
+
+	eglMakeCurrent(display, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+
+	_ready = true;
+	return true;
+}
+
+bool GpuLedReducer::initContext()
+{
+	const EGLint configAttribs[] = {
+		EGL_RENDERABLE_TYPE, EGL_OPENGL_ES3_BIT_KHR,
+		EGL_NONE
+	};
+	const EGLint contextAttribs[] = {
+		EGL_CONTEXT_MAJOR_VERSION_KHR, 3,
+		EGL_CONTEXT_MINOR_VERSION_KHR, 1,
+		EGL_NONE
+	};
+	EGLDisplay display = static_cast<EGLDisplay>(_display);
+	EGLConfig config = EGL_NO_CONFIG_KHR;
+	EGLint configs = 0;
+
+	if (!eglBindAPI(EGL_OPENGL_ES_API))
+		return false;
+
+	// nothing is rendered: a display without the configs (ex. a render node only) can still give a context
+	if ((!eglChooseConfig(display, configAttribs, &config, 1, &configs) || configs < 1) &&
+		!hasExtension(eglQueryString(display, EGL_EXTENSIONS), "EGL_KHR_no_config_context"))
+		return false;
+
+	if (configs < 1)
+		config = EGL_NO_CONFIG_KHR;
+
+	_context = eglCreateContext(display, config, EGL_NO_CONTEXT, contextAttribs);
+	if (_context == EGL_NO_CONTEXT)
+		return false;
+
+	return eglMakeCurrent(display, EGL_NO_SURFACE, EGL_NO_SURFACE, static_cast<EGLContext>(_context));
+}
+
+bool GpuLedReducer::initProgram()
+{
+	GLuint shader = glCreateShader(GL_COMPUTE_SHADER);
+	GLint status = GL_FALSE;
+
+	glShaderSource(shader, 1, &computeShader, nullptr);
+	glCompileShader(shader);
+	glGetShaderiv(shader, GL_COMPILE_STATUS, &status);
+
+	if (status != GL_TRUE)
+	{
+		char log[512] = {};
+		glGetShaderInfoLog(shader, sizeof(log) - 1, nullptr, log);
+		Error(_log, "Compute shader compilation failed: %s", log);
+		glDeleteShader(shader);
+		return false;
+	}
+
+	_program = glCreateProgram();
+	glAttachShader(_program, shader);
+	glLinkProgram(_program);
+	glDeleteShader(shader);
+	glGetProgramiv(_program, GL_LINK_STATUS, &status);
+
+	if (status != GL_TRUE)
+		return false;
+
+	glGenBuffers(1, &_areasBuffer);
+	glGenBuffers(1, &_sumsBuffer);
+
+	return glGetError() == GL_NO_ERROR;
+}
+
+bool GpuLedReducer::upload(const ImageView<ColorRgb>& image)
+{
+	// the rows are uploaded as they are, only the RGB pixel layout fits the texture
+	if (image.pixelStride() != 3)
+		return false;
+
+	if (_texture == 0 || _textureWidth != image.width() || _textureHeight != image.height())
+	{
+		if (_texture != 0)
+			glDeleteTextures(1, &_texture);
+
+		glGenTextures(1, &_texture);
+		glBindTexture(GL_TEXTURE_2D, _texture);
+		glTexStorage2D(GL_TEXTURE_2D, 1, GL_RGB8, image.width(), image.height());
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+
+		_textureWidth = image.width();
+		_textureHeight = image.height();
+	}
+	else
+		glBindTexture(GL_TEXTURE_2D, _texture);
+
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+
+	if (image.lineStride() > 0 && image.lineStride() % 3 == 0)
+	{
+		// a padded line is skipped by the row length, the whole frame goes in one call
+		glPixelStorei(GL_UNPACK_ROW_LENGTH, static_cast<GLint>(image.lineStride() / 3));
+		glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, image.width(), image.height(), GL_RGB, GL_UNSIGNED_BYTE, image.rawMem());
+		glPixelStorei(GL_UNPACK_ROW_LENGTH, 0);
+	}
+	else
+	{
+		for (unsigned y = 0; y < image.height(); y++)
+			glTexSubImage2D(GL_TEXTURE_2D, 0, 0, y, image.width(), 1, GL_RGB, GL_UNSIGNED_BYTE, image.row(y));
+	}
+
+	return true;
+}
+
+bool GpuLedReducer::reduce(const ImageView<ColorRgb>& image, const std::vector<int32_t>& areas, std::vector<ColorRgb>& colors)
+{
+	const size_t leds = areas.size() / 4;
+
+	if (!_ready || leds == 0 || image.width() == 0 || image.height() == 0)
+		return false;
+
+	EGLDisplay display = static_cast<EGLDisplay>(_display);
+
+	if (!eglMakeCurrent(display, EGL_NO_SURFACE, EGL_NO_SURFACE, static_cast<EGLContext>(_context)))
+		return false;
+
+	bool result = upload(image);
+
+	if (result)
+	{
+		if (_buffersSize != leds)
+		{
+			glBindBuffer(GL_SHADER_STORAGE_BUFFER, _sumsBuffer);
+			glBufferData(GL_SHADER_STORAGE_BUFFER, leds * 4 * sizeof(uint32_t), nullptr, GL_DYNAMIC_READ);
+			_buffersSize = leds;
+		}
+
+		glBindBuffer(GL_SHADER_STORAGE_BUFFER, _areasBuffer);
+		glBufferData(GL_SHADER_STORAGE_BUFFER, leds * 4 * sizeof(int32_t), areas.data(), GL_DYNAMIC_DRAW);
+
+		glUseProgram(_program);
+		glActiveTexture(GL_TEXTURE0);
+		glBindTexture(GL_TEXTURE_2D, _texture);
+		glUniform1i(glGetUniformLocation(_program, "frame"), 0);
+		glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, _areasBuffer);
+		glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 1, _sumsBuffer);
+
+		glDispatchCompute(static_cast<GLuint>(leds), 1, 1);
+		glMemoryBarrier(GL_BUFFER_UPDATE_BARRIER_BIT);
+
+		// only the sums of the leds come back
+		glBindBuffer(GL_SHADER_STORAGE_BUFFER, _sumsBuffer);
+		const uint32_t* sums = static_cast<const uint32_t*>(glMapBufferRange(GL_SHADER_STORAGE_BUFFER, 0, leds * 4 * sizeof(uint32_t), GL_MAP_READ_BIT));
+
+		if (sums != nullptr)
+		{
+			colors.resize(leds);
+
+			for (size_t i = 0; i < leds; i++, sums += 4)
+			{
+				if (sums[3] > 0)
+					colors[i] = ColorRgb{ uint8_t(sums[0] / sums[3]), uint8_t(sums[1] / sums[3]), uint8_t(sums[2] / sums[3]) };
+				else
+					colors[i] = ColorRgb::BLACK;
+			}
+
+			glUnmapBuffer(GL_SHADER_STORAGE_BUFFER);
+		}
+
+		result = (sums != nullptr && glGetError() == GL_NO_ERROR);
+	}
+
+	eglMakeCurrent(display, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+
+	return result;
+}
+
+void GpuLedReducer::release()
+{
+	EGLDisplay display = static_cast<EGLDisplay>(_display);
+
+	if (display != EGL_NO_DISPLAY)
+	{
+		if (_context != EGL_NO_CONTEXT)
+		{
+			eglMakeCurrent(display, EGL_NO_SURFACE, EGL_NO_SURFACE, static_cast<EGLContext>(_context));
+
+			if (_texture != 0)
+				glDeleteTextures(1, &_texture);
+			if (_areasBuffer != 0)
+				glDeleteBuffers(1, &_areasBuffer);
+			if (_sumsBuffer != 0)
+				glDeleteBuffers(1, &_sumsBuffer);
+			if (_program != 0)
+				glDeleteProgram(_program);
+
+			eglMakeCurrent(display, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+			eglDestroyContext(display, static_cast<EGLContext>(_context));
+		}
+	}
+
+	_display = EGL_NO_DISPLAY;
+	_context = EGL_NO_CONTEXT;
+	_ready = false;
+	_program = 0;
+	_texture = 0;
+	_areasBuffer = 0;
+	_sumsBuffer = 0;
+	_textureWidth = 0;
+	_textureHeight = 0;
+	_buffersSize = 0;
+}
+
+#else
+
+GpuLedReducer::GpuLedReducer(Logger* log) :
+	_log(log),
+	_display(nullptr),
+	_context(nullptr),
+	_ready(false),
+	_program(0),
+	_texture(0),
+	_areasBuffer(0),
+	_sumsBuffer(0),
+	_textureWidth(0),
+	_textureHeight(0),
+	_buffersSize(0)
+{
+}
+
+GpuLedReducer::~GpuLedReducer()
+{
+}
+
+bool GpuLedReducer::isReady() const
+{
+	return false;
+}
+
+bool GpuLedReducer::init()
+{
+	Warning(_log, "HyperHDR was built without the GLES compute support, the led colors are computed on the CPU");
+	return false;
+}
+
+void GpuLedReducer::release()
+{
+}
+
+bool GpuLedReducer::reduce(const ImageView<ColorRgb>&, const std::vector<int32_t>&, std::vector<ColorRgb>&)
+{
+	return false;
+}
+
+#endif
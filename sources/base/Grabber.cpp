@@ -26,14 +26,112 @@
  */
 
 #include <base/Grabber.h>
+#include <base/QualityGovernor.h>
 #include <utils/ColorSys.h>
 #include <QFile>
+#include <QSaveFile>
 #include <QJsonArray>
+#include <QJsonDocument>
+#include <QTimer>
+#include <QThreadPool>
+#include <QRunnable>
+#include <QSemaphore>
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+
+#include <utils/InternalClock.h>
 
 const QString Grabber::AUTO_SETTING = QString("auto");
 const int	  Grabber::AUTO_INPUT = -1;
 const int	  Grabber::AUTO_FPS = 0;
 
+namespace
+{
+	uint32_t calculateLutFastCRC(const uint8_t* lutBuffer)
+	{
+		uint32_t checkSum = 0;
+		for (int i = 0; i < 256; i += 2)
+			for (int j = 32; j <= 160; j += 64)
+			{
+				checkSum ^= *(reinterpret_cast<const uint32_t*>(&(lutBuffer[LUT_INDEX(j, i, (255 - i))])));
+			}
+		return checkSum;
+	}
+
+	// the same probe for the internal YUV to RGB table: every 32-bit read is the entry and the red of the next y
+	uint32_t calculateInternalLutFastCRC()
+	{
+		uint32_t checkSum = 0;
+		for (int i = 0; i < 256; i += 2)
+			for (int j = 32; j <= 160; j += 64)
+			{
+				uint8_t entries[6];
+				uint32_t value;
+
+				ColorSys::yuv2rgb(j, i, 255 - i, entries[0], entries[1], entries[2]);
+				ColorSys::yuv2rgb(j + 1, i, 255 - i, entries[3], entries[4], entries[5]);
+				memcpy(&value, entries, sizeof(value));
+				checkSum ^= value;
+			}
+		return checkSum;
+	}
+
+	class InternalLutTask : public QRunnable
+	{
+	public:
+		InternalLutTask(const std::function<void()>& work, QSemaphore* done)
+			: _work(work), _done(done)
+		{
+		}
+
+		void run() override
+		{
+			_work();
+			_done->release();
+		}
+
+	private:
+		const std::function<void()>& _work;
+		QSemaphore* _done;
+	};
+
+	///
+	/// Fills the internal YUV to RGB table on the global thread pool, the calling thread takes part.
+	/// The v slices are contiguous in both layouts, the threads don't share the cache lines.
+	///
+	void generateInternalLut(uint8_t* lutBuffer, bool linearLayout)
+	{
+		std::atomic<int> next(0);
+
+		const std::function<void()> work = [&]()
+		{
+			for (int v = next++; v < 256; v = next++)
+				for (int u = 0; u < 256; u++)
+					for (int y = 0; y < 256; y++)
+					{
+						uint32_t ind_lutd = (linearLayout) ? LUT_LINEAR_INDEX(y, u, v) : LUT_INDEX(y, u, v);
+						ColorSys::yuv2rgb(y, u, v,
+							lutBuffer[ind_lutd],
+							lutBuffer[ind_lutd + 1],
+							lutBuffer[ind_lutd + 2]);
+					}
+		};
+
+		const int workers = qMax(QThreadPool::globalInstance()->maxThreadCount() - 1, 0);
+		QSemaphore done;
+
+		for (int i = 0; i < workers; i++)
+		{
+			InternalLutTask* task = new InternalLutTask(work, &done);
+			task->setAutoDelete(true);
+			QThreadPool::globalInstance()->start(task);
+		}
+
+		work();
+		done.acquire(workers);
+	}
+}
 
 Grabber::Grabber(const QString& configurationPath, const QString& grabberName, int width, int height, int cropLeft, int cropRight, int cropTop, int cropBottom)
 	: _configurationPath(configurationPath)
@@ -56,6 +154,20 @@ Grabber::Grabber(const QString& configurationPath, const QString& grabberName, i
 	, _saturation(0)
 	, _hue(0)
 	, _qframe(false)
+	, _decodeTargetWidth(0)
+	, _decodeStripes(0)
+	, _mjpegScale(0)
+	, _hardwareMjpeg(false)
+	, _mjpegDecoder("turbojpeg")
+	, _streamingIo("mmap")
+	, _streamingIoInUse("")
+	, _latencyBudget(0)
+	, _deepIdle(false)
+	, _idleProbing(false)
+	, _autoFormatSelection(false)
+	, _dedicatedCapture(false)
+	, _realtimeCapture(false)
+	, _lutCacheMisses(-1)
 	, _blocked(false)
 	, _restartNeeded(false)
 	, _initialized(false)
@@ -67,20 +179,37 @@ Grabber::Grabber(const QString& configurationPath, const QString& grabberName, i
 	, _actualDeviceName("")
 	, _lutBuffer(NULL)
 	, _lutBufferInit(false)
+	, _lutCompactGrid(0)
+	, _lutFastCRC(0)
+	, _processingVersion(0)
 	, _lineLength(-1)
 	, _frameByteSize(-1)
 	, _signalDetectionEnabled(false)
 	, _signalAutoDetectionEnabled(false)
 	, _synchro(1)
+	, _unusedArea()
+	, _captureRecorder(_log)
+	, _totalGoodFrames(0)
+	, _totalFrameTime(0)
 {
 	Grabber::setCropping(cropLeft, cropRight, cropTop, cropBottom);
+	publishProcessing();
 }
 
 Grabber::~Grabber()
 {
-	if (_lutBuffer != NULL)
-		free(_lutBuffer);
 	_lutBuffer = NULL;
+	_lutTable = nullptr;
+}
+
+QString Grabber::startCaptureRecording(const QString& fileName, int maxFrames)
+{
+	return _captureRecorder.start(fileName, maxFrames);
+}
+
+void Grabber::stopCaptureRecording()
+{
+	_captureRecorder.stop();
 }
 
 bool sortDevicePropertiesItem(const Grabber::DevicePropertiesItem& v1, const Grabber::DevicePropertiesItem& v2)
@@ -115,6 +244,8 @@ void Grabber::setCropping(unsigned cropLeft, unsigned cropRight, unsigned cropTo
 	_cropTop = cropTop;
 	_cropBottom = cropBottom;
 
+	publishProcessing();
+
 	if (cropLeft >= 0 || cropRight >= 0 || cropTop >= 0 || cropBottom >= 0)
 	{
 		Info(_log, "Cropping image: width=%d height=%d; crop: left=%d right=%d top=%d bottom=%d ", _width, _height, cropLeft, cropRight, cropTop, cropBottom);
@@ -243,7 +374,12 @@ void Grabber::setBrightnessContrastSaturationHue(int brightness, int contrast, i
 
 		Debug(_log, "Set brightness to %i, contrast to %i, saturation to %i, hue to %i", _brightness, _contrast, _saturation, _hue);
 
-		if (_initialized && !_blocked)
+		// the controls are not the format of the stream: a running device takes them without a restart
+		if (_initialized && applyDeviceControls())
+		{
+			Debug(_log, "The video controls are applied to the running device");
+		}
+		else if (_initialized && !_blocked)
 		{
 			Debug(_log, "Restarting video grabber");
 			uninit();
@@ -266,8 +402,169 @@ void Grabber::setQFrameDecimation(int setQframe)
 	Info(_log, QSTRING_CSTR(QString("setQFrameDecimation is now: %1").arg(_qframe ? "enabled" : "disabled")));
 }
 
+void Grabber::setDecodeTargetWidth(int targetWidth)
+{
+	_decodeTargetWidth = qMax(targetWidth, 0);
+	publishProcessing();
+	Info(_log, "Decoding with downscaling to the target width: %s", (_decodeTargetWidth) ? QSTRING_CSTR(QString("%1px").arg(_decodeTargetWidth)) : "disabled");
+}
+
+void Grabber::setDecodeStripes(int stripes)
+{
+	_decodeStripes = qMin(qMax(stripes, 0), StripedDecoder::MAX_STRIPES);
+	publishProcessing();
+	Info(_log, "Multi-threaded decoding of a single frame: %s", (_decodeStripes > 1) ? QSTRING_CSTR(QString("%1 stripes").arg(_decodeStripes)) : "disabled");
+}
+
+void Grabber::setMjpegScale(int scale)
+{
+	if (scale != 0 && scale != 1 && scale != 2 && scale != 4 && scale != 8)
+	{
+		Warning(_log, "Unsupported MJPEG decoding scale: 1/%i. Using automatic selection", scale);
+		scale = 0;
+	}
+
+	_mjpegScale = scale;
+	Info(_log, "MJPEG decoding scale: %s", (_mjpegScale) ? QSTRING_CSTR(QString("1/%1").arg(_mjpegScale)) : "automatic");
+}
+
+void Grabber::setHardwareMjpeg(bool enabled)
+{
+	if (_hardwareMjpeg != enabled)
+	{
+		_hardwareMjpeg = enabled;
+		_restartNeeded = true;
+		Info(_log, "Hardware MJPEG decoder: %s", (_hardwareMjpeg) ? "enabled" : "disabled");
+	}
+}
+
+void Grabber::setStreamingIo(const QString& method)
+{
+	QString newMethod = method.toLower();
+
+	if (newMethod != "mmap" && newMethod != "userptr" && newMethod != "dmabuf")
+	{
+		Warning(_log, "Unsupported streaming I/O method: %s. Using mmap", QSTRING_CSTR(method));
+		newMethod = "mmap";
+	}
+
+	if (_streamingIo != newMethod)
+	{
+		_streamingIo = newMethod;
+		_restartNeeded = true;
+		Info(_log, "Streaming I/O method: %s", QSTRING_CSTR(_streamingIo));
+	}
+}
+
+void Grabber::setCaptureThread(bool enabled, bool realtime)
+{
+	if (_dedicatedCapture != enabled || _realtimeCapture != realtime)
+	{
+		_dedicatedCapture = enabled;
+		_realtimeCapture = realtime;
+		_restartNeeded = true;
+		Info(_log, "Dedicated capture thread: %s%s", (_dedicatedCapture) ? "enabled" : "disabled",
+			(_dedicatedCapture && _realtimeCapture) ? " (realtime priority)" : "");
+	}
+}
+
+void Grabber::setLatencyBudget(int budget)
+{
+	budget = qMax(budget, 0);
+
+	if (_latencyBudget != budget)
+	{
+		_latencyBudget = budget;
+		if (_latencyBudget > 0)
+			Info(_log, "Latency budget: %ims (frames that are older when leaving the grabber are dropped)", _latencyBudget);
+		else
+			Info(_log, "Latency budget: unlimited");
+	}
+}
+
+int Grabber::getMjpegScale()
+{
+	const int width = _actualWidth - _cropLeft - _cropRight;
+	const int height = _actualHeight - _cropTop - _cropBottom;
+	int scale = FrameDecoder::getMjpegScale(width, height, _decodeTargetWidth, getEffectiveQFrame(), _mjpegScale);
+
+	// one DCT scale smaller, still with enough pixels for the LED mapping
+	if (QualityGovernor::isActive(QualityGovernor::MJPEG_SCALE) && scale < 8)
+		scale = FrameDecoder::getMjpegScale(width, height, 0, false, scale * 2);
+
+	return scale;
+}
+
+void Grabber::setDeepIdle(bool enabled)
+{
+	if (_deepIdle != enabled)
+	{
+		_deepIdle = enabled;
+		Info(_log, "Deep idle is %s", (enabled) ? "enabled (the lost signal is probed with 2 frames per second)" : "disabled");
+	}
+}
+
+int Grabber::getEffectiveDecimation()
+{
+	int decimation = _fpsSoftwareDecimation;
+
+	if (QualityGovernor::isActive(QualityGovernor::FRAME_DECIMATION))
+		decimation = qMax(decimation, 1) * 2;
+
+	// no signal: the skipped frames are not decoded, the first probe frame with the signal restores the full rate
+	bool probing = _deepIdle && !isCalibrating() &&
+		((_signalAutoDetectionEnabled && getDetectionAutoSignal()) || (!_signalAutoDetectionEnabled && _signalDetectionEnabled && isManualSignalLost()));
+
+	if (probing != _idleProbing)
+	{
+		_idleProbing = probing;
+		Info(_log, "Deep idle: %s", (probing) ? "no signal, decoding the probe frames only" : "the signal is back, decoding every frame");
+	}
+
+	if (probing)
+		decimation = qMax(decimation, _actualFPS / 2);
+
+	return decimation;
+}
+
+bool Grabber::getEffectiveQFrame()
+{
+	return _qframe || QualityGovernor::isActive(QualityGovernor::FRAME_DECIMATION);
+}
+
+void Grabber::reportCacheMisses()
+{
+	uint64_t average;
+
+	if (CacheMissCounter::takeAverage(average))
+	{
+		_lutCacheMisses = static_cast<int64_t>(average);
+		Info(_log, "LUT layout: %s, CPU cache misses per decoded frame: %llu", FrameDecoder::getLutLayoutName(), static_cast<unsigned long long>(average));
+	}
+}
+
+void Grabber::setLutCompactGrid(int gridSize)
+{
+	if (gridSize != 0 && !CompactLut::isSupportedGrid(gridSize))
+	{
+		Warning(_log, "Unsupported compact LUT grid size: %i. Using the full LUT table.", gridSize);
+		gridSize = 0;
+	}
+
+	if (_lutCompactGrid != gridSize)
+	{
+		_lutCompactGrid = gridSize;
+		Info(_log, "Compact LUT mode is now: %s", (gridSize) ? QSTRING_CSTR(QString("%1^3 grid").arg(gridSize)) : "disabled");
+		_restartNeeded = true;
+	}
+}
+
 void Grabber::unblockAndRestart(bool running)
 {
+	// the processing parameters of the new settings reach the next frame together
+	_blocked = false;
+	publishProcessing();
+
 	if (_restartNeeded && running)
 	{
 		Debug(_log, "Planned restart of video grabber after reloading of the configuration");
@@ -279,7 +576,6 @@ void Grabber::unblockAndRestart(bool running)
 			PerformanceReport(static_cast<int>(PerformanceReportType::VIDEO_GRABBER), -1, "", -1, -1, -1, -1));
 	}
 
-	_blocked = false;
 	_restartNeeded = false;
 }
 
@@ -386,11 +682,19 @@ void Grabber::setDeviceVideoStandard(QString device)
 
 void Grabber::resetCounter(int64_t from)
 {
+	_totalGoodFrames += frameStat.goodFrame;
+	_totalFrameTime += frameStat.averageFrame;
+
 	frameStat.frameBegin = from;
 	frameStat.averageFrame = 0;
 	frameStat.badFrame = 0;
 	frameStat.goodFrame = 0;
 	frameStat.segment = 0;
+	frameStat.queueFullFrame = 0;
+	frameStat.staleFrame = 0;
+	frameStat.overBudgetFrame = 0;
+
+	_decodingLatency.clear();
 }
 
 int Grabber::getHdrToneMappingEnabled()
@@ -399,10 +703,67 @@ int Grabber::getHdrToneMappingEnabled()
 }
 
 void Grabber::loadLutFile(PixelFormat color, const QList<QString>& files)
+{
+	loadLutTables(color, files);
+	publishLut();
+}
+
+LutHandle Grabber::currentLut() const
+{
+	return std::atomic_load(&_lutHandle);
+}
+
+void Grabber::publishLut()
+{
+	LutHandle handle;
+
+	if (_lutBufferInit && (_lutTable != nullptr || _compactLut.isValid()))
+		handle = std::make_shared<const LutSnapshot>(_lutTable, _compactLut);
+
+	std::atomic_store(&_lutHandle, handle);
+}
+
+Grabber::ProcessingHandle Grabber::currentProcessing() const
+{
+	return std::atomic_load(&_processingHandle);
+}
+
+void Grabber::publishProcessing()
+{
+	if (_blocked)
+		return;
+
+	auto config = std::make_shared<ProcessingConfig>();
+
+	config->version = ++_processingVersion;
+	config->cropLeft = _cropLeft;
+	config->cropRight = _cropRight;
+	config->cropTop = _cropTop;
+	config->cropBottom = _cropBottom;
+	config->hdrToneMappingEnabled = _hdrToneMappingEnabled;
+	config->decodeTargetWidth = _decodeTargetWidth;
+	config->decodeStripes = _decodeStripes;
+
+	ProcessingHandle handle = config;
+	std::atomic_store(&_processingHandle, handle);
+}
+
+bool Grabber::applyDeviceControls()
+{
+	return false;
+}
+
+void Grabber::loadLutTables(PixelFormat color, const QList<QString>& files)
 {
 	bool is_yuv = (color == PixelFormat::YUYV);
 
+	// keep the previous table until the new one is acquired, the registry reuses it if nothing has changed
+	std::shared_ptr<const LutTable> previousTable = _lutTable;
+
 	_lutBufferInit = false;
+	_lutBuffer = NULL;
+	_lutTable = nullptr;
+	_compactLut.clear();
 
 	if (color != PixelFormat::NO_CHANGE && color != PixelFormat::RGB24 && color != PixelFormat::YUYV)
 	{
@@ -412,25 +773,8 @@ void Grabber::loadLutFile(PixelFormat color, const QList<QString>& files)
 
 	if (color == PixelFormat::NO_CHANGE)
 	{
-		if (_lutBuffer == NULL)
-			_lutBuffer = (uint8_t*)malloc(LUT_FILE_SIZE + 4);
-
-		if (_lutBuffer != NULL)
-		{
-			for (int y = 0; y < 256; y++)
-				for (int u = 0; u < 256; u++)
-					for (int v = 0; v < 256; v++)
-					{
-						uint32_t ind_lutd = LUT_INDEX(y, u, v);
-						ColorSys::yuv2rgb(y, u, v,
-							_lutBuffer[ind_lutd],
-							_lutBuffer[ind_lutd + 1],
-							_lutBuffer[ind_lutd + 2]);
-					}
-			_lutBufferInit = true;
-		}
-
-		Error(_log, "You have forgotten to put lut_lin_tables.3d file in the HyperHDR configuration folder. Internal LUT table for YUV conversion has been created instead.");
+		Error(_log, "You have forgotten to put lut_lin_tables.3d file in the HyperHDR configuration folder. Internal LUT table for YUV conversion is used instead.");
+		loadInternalLut();
 		return;
 	}
 
@@ -464,19 +808,18 @@ void Grabber::loadLutFile(PixelFormat color, const QList<QString>& files)
 					else
 						Debug(_log, "Index 0 for HDR RGB");
 
-					file.seek(index);
+					_lutTable = LutRegistry::acquire(fileName3d, index, LUT_FILE_SIZE, _log);
 
-					if (_lutBuffer == NULL)
-						_lutBuffer = (unsigned char*)malloc(length + 4);
-
-					if (file.read((char*)_lutBuffer, LUT_FILE_SIZE) != LUT_FILE_SIZE)
+					if (_lutTable == nullptr)
 					{
 						Error(_log, "Error reading LUT file %s", QSTRING_CSTR(fileName3d));
 					}
 					else
 					{
+						_lutBuffer = _lutTable->data();
 						_lutBufferInit = true;
 						Info(_log, "Found and loaded LUT: '%s'", QSTRING_CSTR(fileName3d));
+						compactLutBuffer();
 					}
 				}
 				else
@@ -494,6 +837,89 @@ void Grabber::loadLutFile(PixelFormat color, const QList<QString>& files)
 	}
 }
 
+void Grabber::loadInternalLut()
+{
+	const qint64 start = InternalClock::now();
+	const uint32_t expectedCRC = calculateInternalLutFastCRC();
+
+	// the grid needs only its nodes, the full table is never built
+	if (_lutCompactGrid > 0)
+	{
+		if (_compactLut.build([](uint8_t y, uint8_t u, uint8_t v, uint8_t* rgb) { ColorSys::yuv2rgb(y, u, v, rgb[0], rgb[1], rgb[2]); }, _lutCompactGrid))
+		{
+			_lutFastCRC = expectedCRC;
+			_lutBufferInit = true;
+			Info(_log, "Internal LUT table has been sampled to %i^3 grid (%i bytes)", _lutCompactGrid, (int)_compactLut.memorySize());
+			return;
+		}
+
+		Error(_log, "Could not build the compact LUT table. Using the full LUT table.");
+	}
+
+	// the copy in the configuration folder is mapped like a LUT file, with the padding of the unaligned reads
+	const QString fileName = QString("%1%2").arg(_configurationPath).arg("/lut_internal_yuv.3d");
+	const qint64 fileSize = LUT_FILE_SIZE + 4;
+
+	if (QFile(fileName).size() == fileSize)
+	{
+		_lutTable = LutRegistry::acquire(fileName, 0, LUT_FILE_SIZE, _log);
+
+		// written by another version of the conversion
+		if (_lutTable != nullptr && calculateLutFastCRC(_lutTable->data()) != expectedCRC)
+		{
+			Warning(_log, "The internal LUT table in %s is outdated, generating it again", QSTRING_CSTR(fileName));
+			_lutTable = nullptr;
+		}
+	}
+
+	if (_lutTable == nullptr)
+	{
+		QSaveFile file(fileName);
+		uint8_t* buffer = static_cast<uint8_t*>(calloc(fileSize, 1));
+
+		if (buffer != nullptr && file.open(QIODevice::WriteOnly))
+		{
+			generateInternalLut(buffer, true);
+
+			if (file.write(reinterpret_cast<const char*>(buffer), fileSize) == fileSize && file.commit())
+				_lutTable = LutRegistry::acquire(fileName, 0, LUT_FILE_SIZE, _log);
+			else
+				Warning(_log, "Could not save the internal LUT table: %s (%s)", QSTRING_CSTR(fileName), QSTRING_CSTR(file.errorString()));
+		}
+
+		free(buffer);
+	}
+
+	// read-only configuration folder: the table stays in the memory of the process
+	if (_lutTable == nullptr)
+		_lutTable = LutRegistry::acquireGenerated("yuv2rgb", LUT_FILE_SIZE, [](uint8_t* lutBuffer) { generateInternalLut(lutBuffer, false); }, true);
+
+	if (_lutTable != nullptr)
+	{
+		_lutBuffer = _lutTable->data();
+		_lutBufferInit = true;
+		Info(_log, "Internal LUT table is ready (%s, %lli ms)", (_lutTable->isMapped()) ? "memory-mapped" : "in memory", InternalClock::now() - start);
+		compactLutBuffer();
+	}
+}
+
+void Grabber::compactLutBuffer()
+{
+	if (_lutCompactGrid <= 0 || _lutBuffer == NULL)
+		return;
+
+	_lutFastCRC = calculateLutFastCRC(_lutBuffer);
+
+	if (_compactLut.build(_lutBuffer, _lutCompactGrid))
+	{
+		_lutBuffer = NULL;
+		_lutTable = nullptr;
+		Info(_log, "LUT table has been compacted to %i^3 grid (%i bytes)", _lutCompactGrid, (int)_compactLut.memorySize());
+	}
+	else
+		Error(_log, "Could not build the compact LUT table. Using the full LUT table.");
+}
+
 QMap<Grabber::VideoControls, int> Grabber::getVideoDeviceControls(const QString& devicePath)
 {
 	QMap<Grabber::VideoControls, int> retVal;
@@ -903,19 +1329,28 @@ QJsonObject Grabber::getJsonInfo()
 	else
 		current["videoMode"] = "";
 
+	if (_actualVideoFormat == PixelFormat::MJPEG)
+	{
+		current["mjpegScale"] = QString("1/%1").arg(getMjpegScale());
+		current["mjpegDecoder"] = _mjpegDecoder;
+	}
+
+	if (!_streamingIoInUse.isEmpty())
+		current["streamingIo"] = _streamingIoInUse;
+
 	grabbers["current"] = current;
 
-	if (_lutBuffer != NULL)
+	if (_lutBuffer != NULL || _compactLut.isValid())
 	{
-		uint32_t checkSum = 0;
-		for (int i = 0; i < 256; i += 2)
-			for (int j = 32; j <= 160; j += 64)
-			{
-				checkSum ^= *(reinterpret_cast<uint32_t*>(&(_lutBuffer[LUT_INDEX(j, i, (255 - i))])));
-			}
+		uint32_t checkSum = (_lutBuffer != NULL) ? calculateLutFastCRC(_lutBuffer) : _lutFastCRC;
 		grabbers["lutFastCRC"] = "0x" + QString("%1").arg(checkSum, 4, 16).toUpper();
 	}
 
+	grabbers["lutLayout"] = FrameDecoder::getLutLayoutName();
+
+	if (_lutCacheMisses >= 0)
+		grabbers["lutCacheMissesPerFrame"] = static_cast<qint64>(_lutCacheMisses);
+
 	return grabbers;
 }
 
@@ -923,7 +1358,471 @@ void Grabber::alternativeCaching(bool alternative)
 {
 }
 
+void Grabber::setUnusedArea(const QRectF& unusedArea)
+{
+	if (_unusedArea != unusedArea)
+	{
+		_unusedArea = unusedArea;
+
+		if (_unusedArea.isEmpty())
+			Info(_log, "The whole frame is decoded");
+		else
+			Info(_log, "The frame is decoded without its centre (%.3f, %.3f) - (%.3f, %.3f)",
+				_unusedArea.left(), _unusedArea.top(), _unusedArea.right(), _unusedArea.bottom());
+	}
+}
+
+QRectF Grabber::getSkippedArea()
+{
+	// the calibration points of the automatic detection can be anywhere
+	if (_unusedArea.isEmpty() || _signalAutoDetectionEnabled || isCalibrating())
+		return QRectF();
+
+	if (!_signalDetectionEnabled)
+		return _unusedArea;
+
+	QRectF detection = getSignalDetectionArea();
+
+	if (!_unusedArea.intersects(detection))
+		return _unusedArea;
+
+	// the largest part of the unused area that lies beside the detection area
+	QRectF parts[4] = {
+		QRectF(QPointF(_unusedArea.left(), _unusedArea.top()), QPointF(detection.left(), _unusedArea.bottom())),
+		QRectF(QPointF(detection.right(), _unusedArea.top()), QPointF(_unusedArea.right(), _unusedArea.bottom())),
+		QRectF(QPointF(_unusedArea.left(), _unusedArea.top()), QPointF(_unusedArea.right(), detection.top())),
+		QRectF(QPointF(_unusedArea.left(), detection.bottom()), QPointF(_unusedArea.right(), _unusedArea.bottom()))
+	};
+
+	QRectF best;
+
+	for (const QRectF& part : parts)
+		if (part.isValid() && part.width() * part.height() > best.width() * best.height())
+			best = part;
+
+	return best;
+}
+
 QString Grabber::getConfigurationPath()
 {
 	return _configurationPath;
 }
+
+static bool sortModeTuningCandidate(const Grabber::DevicePropertiesItem& v1, const Grabber::DevicePropertiesItem& v2)
+{
+	if (v1.x * v1.y != v2.x * v2.y)
+		return v1.x * v1.y < v2.x * v2.y;
+
+	return static_cast<int>(v1.pf) < static_cast<int>(v2.pf);
+}
+
+QJsonDocument Grabber::startModeTuning(int targetFps, int duration)
+{
+	if (_modeTuning.active)
+		return getModeTuningInfo();
+
+	QJsonObject error;
+
+	if (!_initialized || _actualDeviceName.isEmpty())
+	{
+		error["error"] = "The video grabber is not running";
+		return QJsonDocument(error);
+	}
+
+	targetFps = qMax(targetFps, 1);
+	duration = qBound(2, duration, 30);
+
+	// for every resolution and format the slowest frame rate that still reaches the target
+	QList<DevicePropertiesItem> modes;
+
+	for (const DevicePropertiesItem& mode : getVideoDeviceModesFullInfo(_actualDeviceName))
+	{
+		if ((_input >= 0 && mode.input != _input) || mode.fps < targetFps)
+			continue;
+
+		auto same = std::find_if(modes.begin(), modes.end(), [&mode](const DevicePropertiesItem& m) {
+			return m.x == mode.x && m.y == mode.y && m.pf == mode.pf;
+		});
+
+		if (same == modes.end())
+			modes.append(mode);
+		else if (mode.fps < same->fps)
+			*same = mode;
+	}
+
+	std::sort(modes.begin(), modes.end(), sortModeTuningCandidate);
+
+	if (modes.isEmpty())
+	{
+		error["error"] = QString("No video mode of %1 reaches %2 fps").arg(_actualDeviceName).arg(targetFps);
+		return QJsonDocument(error);
+	}
+
+	_modeTuning.candidates.clear();
+	for (int i = 0; i < modes.size() && i < 12; i++)
+	{
+		ModeTuningCandidate candidate;
+		candidate.width = modes[i].x;
+		candidate.height = modes[i].y;
+		candidate.fps = modes[i].fps;
+		candidate.format = modes[i].pf;
+		_modeTuning.candidates.append(candidate);
+	}
+
+	// the configured mode is restored when the tuning is cancelled
+	_modeTuning.width = _width;
+	_modeTuning.height = _height;
+	_modeTuning.fps = _fps;
+	_modeTuning.format = _enc;
+	_modeTuning.decimation = _fpsSoftwareDecimation;
+
+	_modeTuning.active = true;
+	_modeTuning.generation++;
+	_modeTuning.targetFps = targetFps;
+	_modeTuning.duration = duration;
+	_modeTuning.current = -1;
+	_modeTuning.selected = -1;
+
+	Info(_log, "Starting the video mode tuning: %i modes, target: %i fps, %i seconds per mode", _modeTuning.candidates.size(), targetFps, duration);
+
+	nextModeTuningStep();
+
+	return getModeTuningInfo();
+}
+
+void Grabber::nextModeTuningStep()
+{
+	if (!_modeTuning.active)
+		return;
+
+	if (++_modeTuning.current >= _modeTuning.candidates.size())
+	{
+		finishModeTuning();
+		return;
+	}
+
+	const ModeTuningCandidate& candidate = _modeTuning.candidates[_modeTuning.current];
+	const int generation = _modeTuning.generation;
+
+	applyVideoMode(candidate.width, candidate.height, candidate.fps, candidate.format, 1);
+
+	// skip the first second: the device and the decoders are warming up
+	QTimer::singleShot(1000, this, [this, generation]() {
+		if (!_modeTuning.active || _modeTuning.generation != generation)
+			return;
+
+		_modeTuning.startFrames = _totalGoodFrames + frameStat.goodFrame;
+		_modeTuning.startFrameTime = _totalFrameTime + frameStat.averageFrame;
+		_modeTuning.startTime = InternalClock::now();
+
+		QTimer::singleShot(_modeTuning.duration * 1000, this, [this, generation]() {
+			if (!_modeTuning.active || _modeTuning.generation != generation)
+				return;
+
+			ModeTuningCandidate& candidate = _modeTuning.candidates[_modeTuning.current];
+			const uint64_t frames = _totalGoodFrames + frameStat.goodFrame - _modeTuning.startFrames;
+			const int64_t frameTime = _totalFrameTime + frameStat.averageFrame - _modeTuning.startFrameTime;
+			const int64_t elapsed = qMax(InternalClock::now() - _modeTuning.startTime, int64_t(1));
+
+			candidate.measured = true;
+			candidate.rate = (frames * 1000.0) / elapsed;
+			candidate.frameTime = (frames > 0) ? double(frameTime) / frames : 0;
+			candidate.meetsTarget = (frames > 0 && candidate.rate >= _modeTuning.targetFps * 0.9);
+
+			// the surplus frames are skipped before the decoding
+			candidate.decimation = (candidate.meetsTarget) ? qMax(1, int(candidate.rate / _modeTuning.targetFps)) : 1;
+			candidate.cost = candidate.frameTime * candidate.rate / candidate.decimation;
+
+			Info(_log, "Video mode tuning: %ix%i@%i %s => %.1f fps, %.2f ms per frame, cost: %.1f ms/s (decimation: %i)",
+				candidate.width, candidate.height, candidate.fps, QSTRING_CSTR(pixelFormatToString(candidate.format)),
+				candidate.rate, candidate.frameTime, candidate.cost, candidate.decimation);
+
+			nextModeTuningStep();
+		});
+	});
+}
+
+void Grabber::finishModeTuning()
+{
+	if (!_modeTuning.formatSignature.isEmpty())
+	{
+		finishFormatSelection();
+		return;
+	}
+
+	_modeTuning.active = false;
+	_modeTuning.selected = -1;
+
+	for (int i = 0; i < _modeTuning.candidates.size(); i++)
+	{
+		const ModeTuningCandidate& candidate = _modeTuning.candidates[i];
+
+		if (candidate.meetsTarget && (_modeTuning.selected < 0 || candidate.cost < _modeTuning.candidates[_modeTuning.selected].cost))
+			_modeTuning.selected = i;
+	}
+
+	if (_modeTuning.selected >= 0)
+	{
+		const ModeTuningCandidate& best = _modeTuning.candidates[_modeTuning.selected];
+
+		Info(_log, "Video mode tuning finished. Selected: %ix%i@%i %s with the software decimation: %i (cost: %.1f ms/s)",
+			best.width, best.height, best.fps, QSTRING_CSTR(pixelFormatToString(best.format)), best.decimation, best.cost);
+
+		applyVideoMode(best.width, best.height, best.fps, best.format, best.decimation);
+	}
+	else
+	{
+		Warning(_log, "Video mode tuning finished. No video mode meets the target of %i fps, restoring the configured mode", _modeTuning.targetFps);
+
+		applyVideoMode(_modeTuning.width, _modeTuning.height, _modeTuning.fps, _modeTuning.format, _modeTuning.decimation);
+	}
+}
+
+QJsonDocument Grabber::stopModeTuning(bool restore)
+{
+	if (_modeTuning.active)
+	{
+		_modeTuning.active = false;
+		_modeTuning.generation++;
+		_modeTuning.formatSignature.clear();
+
+		Info(_log, "Video mode tuning was cancelled");
+
+		if (restore)
+			applyVideoMode(_modeTuning.width, _modeTuning.height, _modeTuning.fps, _modeTuning.format, _modeTuning.decimation);
+	}
+
+	return getModeTuningInfo();
+}
+
+void Grabber::setAutoFormatSelection(bool enabled)
+{
+	if (_autoFormatSelection != enabled)
+	{
+		_autoFormatSelection = enabled;
+		Debug(_log, "Automatic pixel format selection is: %s", (enabled) ? "enabled" : "disabled");
+	}
+}
+
+namespace
+{
+	QString formatCacheFile(const QString& configurationPath)
+	{
+		return QString("%1%2").arg(configurationPath).arg("/pixel_format_cache.json");
+	}
+}
+
+void Grabber::selectPixelFormat()
+{
+	if (!_autoFormatSelection || _enc != PixelFormat::NO_CHANGE || _modeTuning.active || _actualDeviceName.isEmpty())
+		return;
+
+	// the formats that the device delivers in the started mode
+	QList<PixelFormat> formats;
+
+	for (const DevicePropertiesItem& mode : getVideoDeviceModesFullInfo(_actualDeviceName))
+		if (mode.x == _actualWidth && mode.y == _actualHeight && mode.fps == _actualFPS &&
+			(_input < 0 || mode.input == _input) && mode.pf != PixelFormat::NO_CHANGE && !formats.contains(mode.pf))
+			formats.append(mode.pf);
+
+	if (formats.size() < 2)
+		return;
+
+	QStringList formatNames;
+	for (PixelFormat format : formats)
+		formatNames.append(pixelFormatToString(format));
+
+	const QString signature = QString("%1 %2x%3@%4 input %5 [%6]").arg(_actualDeviceName).arg(_actualWidth).arg(_actualHeight)
+		.arg(_actualFPS).arg(_input).arg(formatNames.join(','));
+
+	// the measurement is done once per device signature
+	QFile file(formatCacheFile(_configurationPath));
+	QJsonObject cache;
+
+	if (file.open(QIODevice::ReadOnly))
+		cache = QJsonDocument::fromJson(file.readAll()).object();
+
+	if (cache.contains(signature))
+	{
+		PixelFormat cached = parsePixelFormat(cache[signature].toObject()["videoEncoding"].toString());
+
+		if (formats.contains(cached))
+		{
+			if (cached != _actualVideoFormat)
+			{
+				Info(_log, "Automatic pixel format selection: %s (cached for %s)", QSTRING_CSTR(pixelFormatToString(cached)), QSTRING_CSTR(signature));
+
+				// the device was started a moment ago, restart it out of its init
+				QTimer::singleShot(0, this, [this, cached]() { setEncoding(pixelFormatToString(cached)); });
+			}
+			return;
+		}
+	}
+
+	_modeTuning.candidates.clear();
+	for (PixelFormat format : formats)
+	{
+		ModeTuningCandidate candidate;
+		candidate.width = _actualWidth;
+		candidate.height = _actualHeight;
+		candidate.fps = _actualFPS;
+		candidate.format = format;
+		_modeTuning.candidates.append(candidate);
+	}
+
+	// the configured resolution and decimation are kept, the started format is restored when the selection is cancelled
+	_modeTuning.width = _width;
+	_modeTuning.height = _height;
+	_modeTuning.fps = _fps;
+	_modeTuning.format = _actualVideoFormat;
+	_modeTuning.decimation = _fpsSoftwareDecimation;
+	_modeTuning.formatSignature = signature;
+
+	_modeTuning.active = true;
+	_modeTuning.generation++;
+	_modeTuning.targetFps = _actualFPS;
+	_modeTuning.duration = 3;
+	_modeTuning.current = -1;
+	_modeTuning.selected = -1;
+
+	Info(_log, "Automatic pixel format selection: measuring %s for %s", QSTRING_CSTR(formatNames.join(", ")), QSTRING_CSTR(signature));
+
+	const int generation = _modeTuning.generation;
+	QTimer::singleShot(0, this, [this, generation]() {
+		if (_modeTuning.active && _modeTuning.generation == generation)
+			nextModeTuningStep();
+	});
+}
+
+void Grabber::finishFormatSelection()
+{
+	_modeTuning.active = false;
+	_modeTuning.selected = -1;
+
+	// the cheapest format that delivers the frame rate, else the fastest one
+	for (int i = 0; i < _modeTuning.candidates.size(); i++)
+	{
+		const ModeTuningCandidate& candidate = _modeTuning.candidates[i];
+
+		if (_modeTuning.selected < 0)
+		{
+			if (candidate.measured && candidate.rate > 0)
+				_modeTuning.selected = i;
+			continue;
+		}
+
+		const ModeTuningCandidate& best = _modeTuning.candidates[_modeTuning.selected];
+
+		if (candidate.meetsTarget != best.meetsTarget)
+		{
+			if (candidate.meetsTarget)
+				_modeTuning.selected = i;
+		}
+		else if ((candidate.meetsTarget) ? candidate.cost < best.cost : candidate.rate > best.rate)
+			_modeTuning.selected = i;
+	}
+
+	const QString signature = _modeTuning.formatSignature;
+	PixelFormat format = _modeTuning.format;
+
+	_modeTuning.formatSignature.clear();
+
+	if (_modeTuning.selected >= 0)
+	{
+		const ModeTuningCandidate& best = _modeTuning.candidates[_modeTuning.selected];
+		format = best.format;
+
+		Info(_log, "Automatic pixel format selection finished. Selected: %s => %.1f fps, %.2f ms per frame%s",
+			QSTRING_CSTR(pixelFormatToString(best.format)), best.rate, best.frameTime, (best.meetsTarget) ? "" : " (no format meets the frame rate)");
+
+		QFile file(formatCacheFile(_configurationPath));
+		QJsonObject cache;
+
+		if (file.open(QIODevice::ReadOnly))
+		{
+			cache = QJsonDocument::fromJson(file.readAll()).object();
+			file.close();
+		}
+
+		QJsonObject entry;
+		entry["videoEncoding"] = pixelFormatToString(best.format);
+		entry["rate"] = best.rate;
+		entry["frameTime"] = best.frameTime;
+		cache[signature] = entry;
+
+		QSaveFile saveFile(formatCacheFile(_configurationPath));
+
+		if (!saveFile.open(QIODevice::WriteOnly) || saveFile.write(QJsonDocument(cache).toJson(QJsonDocument::Compact)) < 0 || !saveFile.commit())
+			Warning(_log, "Could not save the pixel format cache: %s (%s)", QSTRING_CSTR(saveFile.fileName()), QSTRING_CSTR(saveFile.errorString()));
+	}
+	else
+		Warning(_log, "Automatic pixel format selection finished. No format was delivered, restoring %s", QSTRING_CSTR(pixelFormatToString(format)));
+
+	applyVideoMode(_modeTuning.width, _modeTuning.height, _modeTuning.fps, format, _modeTuning.decimation);
+}
+
+void Grabber::applyVideoMode(int width, int height, int fps, PixelFormat format, int decimation)
+{
+	setBlocked();
+	setWidthHeight(width, height);
+	setFramerate(fps);
+	setEncoding(pixelFormatToString(format));
+	setFpsSoftwareDecimation(decimation);
+	unblockAndRestart(true);
+}
+
+QJsonDocument Grabber::getModeTuningInfo()
+{
+	QJsonObject info;
+	QJsonArray ranking;
+
+	// the ranking: the modes that meet the target ordered by the cost, then the others ordered by the rate
+	QList<int> order;
+	for (int i = 0; i < _modeTuning.candidates.size(); i++)
+		order.append(i);
+
+	const auto& candidates = _modeTuning.candidates;
+	std::stable_sort(order.begin(), order.end(), [&candidates](int a, int b) {
+		const ModeTuningCandidate& c1 = candidates[a];
+		const ModeTuningCandidate& c2 = candidates[b];
+
+		if (c1.measured != c2.measured)
+			return c1.measured;
+		if (c1.meetsTarget != c2.meetsTarget)
+			return c1.meetsTarget;
+		if (c1.meetsTarget)
+			return c1.cost < c2.cost;
+		return c1.rate > c2.rate;
+	});
+
+	for (int i : order)
+	{
+		const ModeTuningCandidate& candidate = candidates[i];
+		QJsonObject mode;
+
+		mode["width"] = candidate.width;
+		mode["height"] = candidate.height;
+		mode["fps"] = candidate.fps;
+		mode["videoMode"] = QString("%1x%2").arg(candidate.width).arg(candidate.height);
+		mode["videoEncoding"] = pixelFormatToString(candidate.format);
+		mode["measured"] = candidate.measured;
+		mode["meetsTarget"] = candidate.meetsTarget;
+		mode["rate"] = candidate.rate;
+		mode["frameTime"] = candidate.frameTime;
+		mode["fpsSoftwareDecimation"] = candidate.decimation;
+		mode["outputRate"] = candidate.rate / candidate.decimation;
+		mode["cost"] = candidate.cost;
+		mode["selected"] = (i == _modeTuning.selected);
+
+		ranking.append(mode);
+	}
+
+	info["active"] = _modeTuning.active;
+	info["targetFps"] = _modeTuning.targetFps;
+	info["duration"] = _modeTuning.duration;
+	info["progress"] = qMax(_modeTuning.current, 0);
+	info["total"] = _modeTuning.candidates.size();
+	info["ranking"] = ranking;
+
+	return QJsonDocument(info);
+}
@@ -28,11 +28,16 @@
 #include <base/GrabberWrapper.h>
 #include <base/Grabber.h>
 #include <utils/VideoMemoryManager.h>
+#include <utils/PreciseTimer.h>
+#include <utils/ImagePyramid.h>
+#include <leddevice/LatencyBenchmark.h>
 #include <HyperhdrConfig.h>
 
 #include <utils/GlobalSignals.h>
 #include <utils/QStringUtils.h>
 #include <base/HyperHdrIManager.h>
+#include <base/ImageProcessingUnit.h>
+#include <base/QualityGovernor.h>
 
 #include <QTimer>
 #include <QThread>
@@ -40,6 +45,10 @@
 #include <QFileInfo>
 
 GrabberWrapper* GrabberWrapper::instance = nullptr;
+QMutex GrabberWrapper::_routingLock;
+QMap<int, QString> GrabberWrapper::_routing;
+QList<int> GrabberWrapper::_requested_clients;
+QList<GrabberWrapper*> GrabberWrapper::_registry;
 
 GrabberWrapper::GrabberWrapper(const QString& grabberName, Grabber* ggrabber)
 	: _grabberName(grabberName)
@@ -51,11 +60,20 @@ GrabberWrapper::GrabberWrapper(const QString& grabberName, Grabber* ggrabber)
 	, _autoResume(false)
 	, _isPaused(false)
 	, _pausingModeEnabled(false)
+	, _deepIdle(false)
+	, _lightSleep(false)
 	, _benchmarkStatus(-1)
 	, _benchmarkMessage("")
+	, _additional(false)
+	, _regionDecoding(true)
 {
 	GrabberWrapper::instance = this;
 
+	{
+		QMutexLocker locker(&_routingLock);
+		_registry.append(this);
+	}
+
 	// connect the image forwarding
 
 	connect(this, &GrabberWrapper::systemImage, GlobalSignals::getInstance(), &GlobalSignals::setVideoImage);
@@ -63,6 +81,12 @@ GrabberWrapper::GrabberWrapper(const QString& grabberName, Grabber* ggrabber)
 	// listen for source requests
 	connect(GlobalSignals::getInstance(), &GlobalSignals::requestSource, this, &GrabberWrapper::handleSourceRequest);
 
+	// listen for the part of the frame the instances don't use
+	connect(GlobalSignals::getInstance(), &GlobalSignals::requestCaptureRegion, this, &GrabberWrapper::handleRegionRequest);
+
+	// the light sleep of the system stops only the stream
+	connect(GlobalSignals::getInstance(), &GlobalSignals::lightSleep, this, &GrabberWrapper::handleLightSleep);
+
 	connect(this, &GrabberWrapper::cecKeyPressed, this, &GrabberWrapper::cecKeyPressedHandler);
 
 	connect(this, &GrabberWrapper::setBrightnessContrastSaturationHue, this, &GrabberWrapper::setBrightnessContrastSaturationHueHandler);
@@ -75,7 +99,7 @@ void GrabberWrapper::instancePauseChangedHandler(int instance, bool isEnabled)
 	static int signature = 0;
 	int trigger = 0;
 
-	if (!_pausingModeEnabled)
+	if (!_pausingModeEnabled && !_deepIdle)
 		return;
 
 	if (!isEnabled)
@@ -91,7 +115,8 @@ void GrabberWrapper::instancePauseChangedHandler(int instance, bool isEnabled)
 		if (_paused_clients.contains(instance))
 		{
 			_paused_clients.removeOne(instance);
-			trigger = 1000;
+			// the deep idle wakes up the grabber as soon as possible
+			trigger = (_deepIdle) ? 100 : 1000;
 		}
 	}
 
@@ -105,7 +130,7 @@ void GrabberWrapper::instancePauseChangedHandler(int instance, bool isEnabled)
 				{
 					if (!_isPaused)
 					{
-						Warning(_log, "LEDs are off and you have enabled the pausing feature for the USB grabber. Pausing the video grabber now.");
+						Warning(_log, "LEDs are off and you have enabled the %s feature for the USB grabber. Pausing the video grabber now.", (_pausingModeEnabled) ? "pausing" : "deep idle");
 						auto _running_clients_copy = _running_clients;
 						_running_clients.clear();
 						handleSourceRequest(hyperhdr::Components::COMP_VIDEOGRABBER, -1, false);
@@ -159,6 +184,44 @@ QJsonDocument GrabberWrapper::getCalibrationInfo()
 	return _grabber->getCalibrationInfo();
 }
 
+QJsonDocument GrabberWrapper::startModeTuning(int targetFps, int duration)
+{
+	if (_grabber == nullptr)
+		return QJsonDocument();
+
+	return _grabber->startModeTuning(targetFps, duration);
+}
+
+QJsonDocument GrabberWrapper::stopModeTuning()
+{
+	if (_grabber == nullptr)
+		return QJsonDocument();
+
+	return _grabber->stopModeTuning();
+}
+
+QJsonDocument GrabberWrapper::getModeTuningInfo()
+{
+	if (_grabber == nullptr)
+		return QJsonDocument();
+
+	return _grabber->getModeTuningInfo();
+}
+
+QString GrabberWrapper::startCaptureRecording(QString fileName, int maxFrames)
+{
+	if (_grabber == nullptr)
+		return QString("No grabber available");
+
+	return _grabber->startCaptureRecording(fileName, maxFrames);
+}
+
+void GrabberWrapper::stopCaptureRecording()
+{
+	if (_grabber != nullptr)
+		_grabber->stopCaptureRecording();
+}
+
 void GrabberWrapper::cecKeyPressedHandler(int key)
 {
 	if (_grabber != nullptr)
@@ -184,14 +247,10 @@ void GrabberWrapper::newFrame(const Image<ColorRgb>& image)
 	if (_benchmarkStatus >= 0)
 	{
 		ColorRgb pixel = image(image.width() / 2, image.height() / 2);
-		if ((_benchmarkMessage == "white" && pixel.red > 120 && pixel.green > 120 && pixel.blue > 120) ||
-			(_benchmarkMessage == "red" && pixel.red > 120 && pixel.green < 30 && pixel.blue < 30) ||
-			(_benchmarkMessage == "green" && pixel.red < 30 && pixel.green > 120 && pixel.blue < 30) ||
-			(_benchmarkMessage == "blue" && pixel.red < 30 && pixel.green < 40 && pixel.blue > 120) ||
-			(_benchmarkMessage == "black" && pixel.red < 30 && pixel.green < 30 && pixel.blue < 30))
-
+		if (LatencyBenchmark::matches(LatencyBenchmark::parseColor(_benchmarkMessage), pixel))
 		{
-			emit benchmarkUpdate(_benchmarkStatus, _benchmarkMessage);
+			// the benchmark completes the flash, at once or when the LEDs get the color
+			QUEUE_CALL_3(LatencyBenchmark::getInstance(), captured, int, _benchmarkStatus, QString, _benchmarkMessage, qint64, PreciseTimer::now());
 			_benchmarkStatus = -1;
 			_benchmarkMessage = "";
 		}
@@ -199,9 +258,27 @@ void GrabberWrapper::newFrame(const Image<ColorRgb>& image)
 
 	if (image.setBufferCacheSize())
 	{
-		Warning(_log, "Detected the video frame size changed (%ix%i). Cache buffer was cleared.", image.width(), image.height());
+		Info(_log, "Detected the video frame size changed (%ix%i)", image.width(), image.height());
 	}
 
+	// grabbers without a driver timestamp: use the arrival time (the copy shares the metadata with the source image)
+	if (image.timestamp() == 0)
+	{
+		Image<ColorRgb> stamped = image;
+		stamped.setTimestamp(InternalClock::now());
+	}
+
+	// the same for the trace of the grabbers that don't stamp the capture stages
+	if (image.trace().stamps[FrameTrace::DECODED] == 0)
+	{
+		Image<ColorRgb> stamped = image;
+		const int64_t now = FrameTrace::now();
+		stamped.setCaptureTrace(now, now);
+	}
+
+	// the reduced copies for the consumers of the frame, after the timestamp that they are checked with
+	ImagePyramid::attach(image);
+
 	emit systemImage(_grabberName, image);
 }
 
@@ -212,9 +289,87 @@ void GrabberWrapper::readError(const char* err)
 
 GrabberWrapper::~GrabberWrapper()
 {
+	{
+		QMutexLocker locker(&_routingLock);
+		_registry.removeOne(this);
+	}
+
 	Debug(_log, "Closing grabber: %s", QSTRING_CSTR(_grabberName));
 }
 
+QString GrabberWrapper::getGrabberName() const
+{
+	return _grabberName;
+}
+
+void GrabberWrapper::setAdditional(bool additional)
+{
+	_additional = additional;
+}
+
+void GrabberWrapper::setRouting(const QMap<int, QString>& routing)
+{
+	QList<GrabberWrapper*> registry;
+
+	{
+		QMutexLocker locker(&_routingLock);
+		_routing = routing;
+		registry = _registry;
+	}
+
+	for (GrabberWrapper* wrapper : registry)
+		wrapper->updateRouting();
+}
+
+bool GrabberWrapper::isRouted(int instanceIndex, const QString& grabberName)
+{
+	QMutexLocker locker(&_routingLock);
+
+	if (_routing.contains(instanceIndex))
+		return _routing[instanceIndex] == grabberName;
+
+	return instance != nullptr && instance->_grabberName == grabberName;
+}
+
+void GrabberWrapper::reviveRouted(int instanceIndex)
+{
+	QMutexLocker locker(&_routingLock);
+
+	QString grabberName = _routing.value(instanceIndex);
+
+	for (GrabberWrapper* wrapper : _registry)
+		if ((grabberName.isEmpty() && wrapper == instance) || (!grabberName.isEmpty() && wrapper->_grabberName == grabberName))
+		{
+			wrapper->revive();
+			break;
+		}
+}
+
+bool GrabberWrapper::servesInstance(int instanceIndex) const
+{
+	QMutexLocker locker(&_routingLock);
+
+	if (_routing.contains(instanceIndex))
+		return _additional && _routing[instanceIndex] == _grabberName;
+
+	return !_additional;
+}
+
+void GrabberWrapper::updateRouting()
+{
+	// the requests are replayed, so the instances switch to the grabber they are assigned to
+	QList<int> requested;
+
+	{
+		QMutexLocker locker(&_routingLock);
+		requested = _requested_clients;
+	}
+
+	for (int instanceIndex : requested)
+		if (servesInstance(instanceIndex) != _running_clients.contains(instanceIndex))
+			handleSourceRequest(hyperhdr::Components::COMP_VIDEOGRABBER, instanceIndex, true);
+}
+
 QJsonObject GrabberWrapper::getJsonInfo()
 {
 	if (_grabber == nullptr)
@@ -264,6 +419,25 @@ void GrabberWrapper::handleSourceRequest(hyperhdr::Components component, int ins
 	{
 		if (instanceIndex >= 0)
 		{
+			{
+				// shared by all grabbers, so a grabber created later knows the listening instances
+				QMutexLocker locker(&_routingLock);
+
+				if (listen && !_requested_clients.contains(instanceIndex))
+					_requested_clients.append(instanceIndex);
+				else if (!listen)
+					_requested_clients.removeOne(instanceIndex);
+			}
+
+			// the instance is assigned to the other grabber
+			if (!servesInstance(instanceIndex))
+			{
+				if (!_running_clients.contains(instanceIndex))
+					return;
+
+				listen = false;
+			}
+
 			if (listen && !_running_clients.contains(instanceIndex))
 			{
 				_running_clients.append(instanceIndex);
@@ -274,6 +448,8 @@ void GrabberWrapper::handleSourceRequest(hyperhdr::Components component, int ins
 				_running_clients.removeOne(instanceIndex);
 				_paused_clients.removeOne(instanceIndex);
 			}
+
+			updateUnusedArea();
 		}
 
 		if (_running_clients.empty())
@@ -284,7 +460,8 @@ void GrabberWrapper::handleSourceRequest(hyperhdr::Components component, int ins
 			QString currentDevice = "", currentVideoMode = "";
 			emit StateChanged(currentDevice, currentVideoMode);
 
-			emit PerformanceCounters::getInstance()->removeCounter(static_cast<int>(PerformanceReportType::VIDEO_GRABBER), -1);
+			if (!_additional)
+				emit PerformanceCounters::getInstance()->removeCounter(static_cast<int>(PerformanceReportType::VIDEO_GRABBER), -1);
 		}
 		else
 		{
@@ -302,7 +479,9 @@ void GrabberWrapper::handleSourceRequest(hyperhdr::Components component, int ins
 
 			emit StateChanged(currentDevice, currentVideoMode);
 
-			if (result)
+			if (_additional)
+				Info(_log, "Additional grabber %s: %s", QSTRING_CSTR(_grabberName), (result) ? "started" : "could not start");
+			else if (result)
 				emit PerformanceCounters::getInstance()->newCounter(
 					PerformanceReport(static_cast<int>(PerformanceReportType::VIDEO_GRABBER), -1, "", -1, -1, -1, -1));
 			else
@@ -311,6 +490,43 @@ void GrabberWrapper::handleSourceRequest(hyperhdr::Components component, int ins
 	}
 }
 
+void GrabberWrapper::handleRegionRequest(int instanceIndex, const QRectF& unusedArea)
+{
+	_unusedAreas[instanceIndex] = unusedArea;
+
+	if (_running_clients.contains(instanceIndex))
+		updateUnusedArea();
+}
+
+void GrabberWrapper::setRegionDecoding(bool enabled)
+{
+	if (_regionDecoding != enabled)
+	{
+		_regionDecoding = enabled;
+		updateUnusedArea();
+	}
+}
+
+void GrabberWrapper::updateUnusedArea()
+{
+	if (_grabber == nullptr)
+		return;
+
+	// only the part that is unused by every listening instance can be skipped
+	QRectF unusedArea;
+
+	for (int i = 0; _regionDecoding && i < _running_clients.size(); i++)
+	{
+		QRectF area = _unusedAreas.value(_running_clients[i]);
+
+		unusedArea = (i == 0) ? area : unusedArea.intersected(area);
+
+		if (unusedArea.isEmpty())
+			break;
+	}
+
+	_grabber->setUnusedArea(unusedArea);
+}
 
 QMap<Grabber::currentVideoModeInfo, QString> GrabberWrapper::getVideoCurrentMode() const
 {
@@ -320,6 +536,44 @@ QMap<Grabber::currentVideoModeInfo, QString> GrabberWrapper::getVideoCurrentMode
 		return QMap<Grabber::currentVideoModeInfo, QString>();
 }
 
+void GrabberWrapper::handleLightSleep(bool sleep)
+{
+	if (sleep)
+	{
+		if (!_lightSleep && !_running_clients.empty() && !_isPaused)
+		{
+			Info(_log, "Light sleep: stopping the stream, the grabber keeps its configuration and LUT");
+			_lightSleep = true;
+			stop();
+		}
+	}
+	else if (_lightSleep)
+	{
+		_lightSleep = false;
+		resumeAfterSleep(0);
+	}
+}
+
+void GrabberWrapper::resumeAfterSleep(int attempt)
+{
+	if (_lightSleep || _running_clients.empty() || _isPaused)
+		return;
+
+	if (start())
+	{
+		Info(_log, "Light sleep: the stream is restarted");
+		return;
+	}
+
+	// the capture device may come back from the USB resume later than the system
+	if (attempt < 10)
+	{
+		QTimer::singleShot(500, this, [this, attempt]() { resumeAfterSleep(attempt + 1); });
+	}
+	else
+		Error(_log, "Light sleep: could not restart the stream after the wake-up");
+}
+
 bool GrabberWrapper::start()
 {
 	if (_grabber != nullptr)
@@ -331,6 +585,7 @@ bool GrabberWrapper::start()
 void GrabberWrapper::stop()
 {
 	emit PerformanceCounters::getInstance()->removeCounter(static_cast<int>(PerformanceReportType::VIDEO_GRABBER), -1);
+	emit PerformanceCounters::getInstance()->removeCounter(static_cast<int>(PerformanceReportType::FRAME_DROPS), -1);
 
 	if (_grabber != nullptr)
 		_grabber->stop();
@@ -510,6 +765,9 @@ void GrabberWrapper::handleSettingsUpdate(settings::type type, const QJsonDocume
 
 	if (type == settings::type::VIDEOGRABBER && _grabber != nullptr)
 	{
+		// the new configuration replaces the mode that is being tested
+		_grabber->stopModeTuning(false);
+
 		try
 		{
 			_grabber->setBlocked();
@@ -530,6 +788,10 @@ void GrabberWrapper::handleSettingsUpdate(settings::type type, const QJsonDocume
 				Debug(_log, "Pausing mode is: %s", (_pausingModeEnabled) ? "enabled" : "disabled");
 			}
 
+			// deep idle: pause when the LEDs are off, probe the lost signal
+			_deepIdle = obj["deepIdle"].toBool(false);
+			_grabber->setDeepIdle(_deepIdle);
+
 			// crop for video
 			_grabber->setCropping(
 				obj["cropLeft"].toInt(0),
@@ -604,12 +866,41 @@ void GrabberWrapper::handleSettingsUpdate(settings::type type, const QJsonDocume
 
 			_grabber->setEncoding(obj["videoEncoding"].toString(pixelFormatToString(PixelFormat::NO_CHANGE)));
 
+			_grabber->setAutoFormatSelection(obj["autoFormatSelection"].toBool(false));
+
 			_grabber->setQFrameDecimation(obj["qFrame"].toBool(false));
 
+			_grabber->setLutCompactGrid(obj["lutCompactGrid"].toInt(0));
+
+			_grabber->setDecodeTargetWidth(obj["decodeTargetWidth"].toInt(0));
+
+			_grabber->setDecodeStripes(obj["decodeStripes"].toInt(0));
+
+			_grabber->setMjpegScale(obj["mjpegScale"].toInt(0));
+
+			_grabber->setHardwareMjpeg(obj["hardwareMjpeg"].toBool(false));
+
+			_grabber->setStreamingIo(obj["streamingIo"].toString("mmap"));
+
+			_grabber->setCaptureThread(obj["captureThread"].toBool(false), obj["captureRealtime"].toBool(false));
+
+			int latencyBudget = obj["latencyBudget"].toInt(0);
+			_grabber->setLatencyBudget(latencyBudget);
+			ImageProcessingUnit::setLatencyBudget(latencyBudget);
+
+			QMetaObject::invokeMethod(QualityGovernor::getInstance(), "configure", Qt::QueuedConnection,
+				Q_ARG(bool, obj["qualityGovernor"].toBool(false)),
+				Q_ARG(int, obj["governorCpuLimit"].toInt(90)),
+				Q_ARG(int, obj["governorTemperatureLimit"].toInt(75)));
+
 			bool frameCache = obj["videoCache"].toBool(true);
 			Debug(_log, "Frame cache is: %s", (frameCache) ? "enabled" : "disabled");
 			VideoMemoryManager::enableCache(frameCache);
 
+			bool hugePages = obj["videoHugePages"].toBool(false);
+			Debug(_log, "Huge pages for the frame buffers: %s", (hugePages) ? "enabled" : "disabled");
+			VideoMemoryManager::enableHugePages(hugePages);
+
 			_grabber->unblockAndRestart(_configLoaded);
 		}
 		catch (...)
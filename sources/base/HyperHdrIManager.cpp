@@ -3,6 +3,11 @@
 #include <base/HyperHdrInstance.h>
 #include <db/InstanceTable.h>
 #include <base/GrabberWrapper.h>
+#include <base/LinearSmoothing.h>
+#include <utils/ThreadPolicy.h>
+#include <utils/PresentationClock.h>
+#include <utils/InternalClock.h>
+#include <utils/GlobalSignals.h>
 
 // qt
 #include <QThread>
@@ -16,12 +21,49 @@ HyperHdrIManager::HyperHdrIManager(const QString& rootPath, QObject* parent, boo
 	, _rootPath(rootPath)
 	, _readonlyMode(readonlyMode)
 	, _fireStarter(0)
+	, _startAllTime(0)
+	, _startupHdrState(-1)
+	, _lightSleepEnabled(true)
+	, _isLightSleeping(false)
+	, _recentFrameConsumers(0)
 {
 	HIMinstance = this;
 	qRegisterMetaType<InstanceState>("InstanceState");
 	connect(this, &HyperHdrIManager::instanceStateChanged, this, &HyperHdrIManager::handleInstanceStateChange);
 }
 
+std::shared_ptr<FrameContext> HyperHdrIManager::getFrameContext(const Image<ColorRgb>& image)
+{
+	std::lock_guard<std::mutex> lockGuard(_frameContextLock);
+
+	for (auto it = _frameContexts.begin(); it != _frameContexts.end(); )
+	{
+		std::shared_ptr<FrameContext> context = it->lock();
+
+		if (context == nullptr)
+			it = _frameContexts.erase(it);
+		else if (context->isFrame(image))
+		{
+			context->addConsumer();
+			return context;
+		}
+		else
+			++it;
+	}
+
+	// a new frame: the number of instances that consumed the previous one decides if the optional parts are shared
+	std::shared_ptr<FrameContext> previous = _newestFrameContext.lock();
+	if (previous != nullptr)
+		_recentFrameConsumers = previous->getConsumers();
+
+	std::shared_ptr<FrameContext> context = std::make_shared<FrameContext>(image, _recentFrameConsumers);
+
+	_frameContexts.push_back(context);
+	_newestFrameContext = context;
+
+	return context;
+}
+
 void HyperHdrIManager::handleInstanceStateChange(InstanceState state, quint8 instance, const QString& name)
 {
 	switch (state)
@@ -33,6 +75,11 @@ void HyperHdrIManager::handleInstanceStateChange(InstanceState state, quint8 ins
 		case InstanceState::H_STOPPED:
 			emit PerformanceCounters::getInstance()->removeCounter(static_cast<int>(PerformanceReportType::INSTANCE), instance);
 			emit PerformanceCounters::getInstance()->removeCounter(static_cast<int>(PerformanceReportType::LED), instance);
+			emit PerformanceCounters::getInstance()->removeCounter(static_cast<int>(PerformanceReportType::LATENCY), instance);
+			emit PerformanceCounters::getInstance()->removeCounter(static_cast<int>(PerformanceReportType::PIPELINE), instance);
+			emit PerformanceCounters::getInstance()->removeCounter(static_cast<int>(PerformanceReportType::FRAME_QUEUE), instance);
+			emit PerformanceCounters::getInstance()->removeCounter(static_cast<int>(PerformanceReportType::SMOOTHING_TIMER), instance);
+			emit PerformanceCounters::getInstance()->removeCounter(static_cast<int>(PerformanceReportType::REFRESH_TIMER), instance);
 			break;
 		default:
 			break;
@@ -73,14 +120,18 @@ void HyperHdrIManager::startAll()
 	auto instanceList = _instanceTable->getAllInstances(true);
 
 	_fireStarter = instanceList.count();
+	_startAllTime = InternalClock::now();
+
+	// the instances are built by their own threads, so they get the HDR state there once they are started
+	if (GrabberWrapper::getInstance() != nullptr)
+		_startupHdrState = (GrabberWrapper::getInstance()->getHdrToneMappingEnabled() != 0) ? 1 : 0;
 
 	for (const auto& entry : instanceList)
 	{
 		startInstance(entry["instance"].toInt());
 	}
 
-	if (GrabberWrapper::getInstance() != nullptr)
-		emit setNewComponentStateToAllInstances(hyperhdr::Components::COMP_HDR, (GrabberWrapper::getInstance()->getHdrToneMappingEnabled() != 0));
+	_startupHdrState = -1;
 }
 
 void HyperHdrIManager::stopAll()
@@ -101,6 +152,29 @@ void HyperHdrIManager::setSmoothing(int time)
 		QTimer::singleShot(0, instance, [=]() { instance->setSmoothing(time); });
 }
 
+void HyperHdrIManager::handleSettingsUpdate(settings::type type, const QJsonDocument& config)
+{
+	if (type == settings::type::GENERAL)
+	{
+		bool sharedClock = config.object()["sharedSmoothingClock"].toBool(false);
+
+		Info(_log, "Shared smoothing clock: %s", (sharedClock) ? "enabled" : "disabled");
+
+		// the running instances pick it up on their next smoothing update
+		LinearSmoothing::setSharedClock(sharedClock);
+
+		bool synchronizedOutput = config.object()["synchronizedOutput"].toBool(false);
+
+		Info(_log, "Synchronized LED output: %s", (synchronizedOutput) ? "enabled" : "disabled");
+
+		PresentationClock::setEnabled(synchronizedOutput);
+
+		_lightSleepEnabled = config.object()["lightSleep"].toBool(true);
+
+		ThreadPolicy::setConfig(config.object());
+	}
+}
+
 QJsonObject HyperHdrIManager::getAverageColor(quint8 index)
 {
 	HyperHdrInstance* instance = HyperHdrIManager::getHyperHdrInstance(index);
@@ -146,13 +220,30 @@ void HyperHdrIManager::hibernate(bool wakeUp)
 {
 	if (!wakeUp)
 	{
-		Warning(_log, "The system is going to sleep");
-		toggleStateAllInstances(false);
+		if (_lightSleepEnabled)
+		{
+			Warning(_log, "The system is going to sleep (light sleep: the instances, LUTs and devices stay loaded)");
+			_isLightSleeping = true;
+			emit GlobalSignals::getInstance()->lightSleep(true);
+		}
+		else
+		{
+			Warning(_log, "The system is going to sleep");
+			toggleStateAllInstances(false);
+		}
 	}
 	else
 	{
 		Warning(_log, "The system is going to wake up");
-		QTimer::singleShot(3000, [this]() { toggleStateAllInstances(true);  });
+
+		// the mode of the sleep, the setting may have changed in the meantime
+		if (_isLightSleeping)
+		{
+			_isLightSleeping = false;
+			emit GlobalSignals::getInstance()->lightSleep(false);
+		}
+		else
+			QTimer::singleShot(3000, [this]() { toggleStateAllInstances(true);  });
 	}
 }
 
@@ -163,25 +254,38 @@ bool HyperHdrIManager::startInstance(quint8 inst, bool block, QObject* caller, i
 		if (!_runningInstances.contains(inst) && !_startQueue.contains(inst))
 		{
 			QThread* hyperhdrThread = new QThread();
-			hyperhdrThread->setObjectName("HyperHdrThread");
-			HyperHdrInstance* hyperhdr = new HyperHdrInstance(inst, _readonlyMode, _instanceTable->getNamebyIndex(inst));
-			hyperhdr->moveToThread(hyperhdrThread);
-			// setup thread management
-			connect(hyperhdrThread, &QThread::started, hyperhdr, &HyperHdrInstance::start);
-			connect(hyperhdr, &HyperHdrInstance::started, this, &HyperHdrIManager::handleStarted);
-			connect(hyperhdr, &HyperHdrInstance::finished, this, &HyperHdrIManager::handleFinished);
-			connect(hyperhdr, &HyperHdrInstance::finished, hyperhdrThread, &QThread::quit, Qt::DirectConnection);
+			hyperhdrThread->setObjectName(QString("Instance%1").arg(inst));
+			ThreadPolicy::attach(hyperhdrThread, ThreadPolicy::Role::PROCESSING);
+
+			// the instance is constructed by its own thread: the settings, the LED layout and the devices
+			// of the independent instances are loaded concurrently and don't hold the manager
+			const QString name = _instanceTable->getNamebyIndex(inst);
+			const int hdrState = _startupHdrState;
+			connect(hyperhdrThread, &QThread::started, hyperhdrThread, [this, hyperhdrThread, inst, name, hdrState]() {
+				HyperHdrInstance* hyperhdr = new HyperHdrInstance(inst, _readonlyMode, name);
+
+				// setup thread management
+				connect(hyperhdr, &HyperHdrInstance::started, this, &HyperHdrIManager::handleStarted);
+				connect(hyperhdr, &HyperHdrInstance::finished, this, &HyperHdrIManager::handleFinished);
+				connect(hyperhdr, &HyperHdrInstance::finished, hyperhdrThread, &QThread::quit, Qt::DirectConnection);
+
+				// setup further connections
+				// from HyperHDR
+				connect(hyperhdr, &HyperHdrInstance::settingsChanged, this, &HyperHdrIManager::settingsChanged);
 
-			// setup further connections
-			// from HyperHDR
-			connect(hyperhdr, &HyperHdrInstance::settingsChanged, this, &HyperHdrIManager::settingsChanged);
+				connect(hyperhdr, &HyperHdrInstance::compStateChangeRequest, this, &HyperHdrIManager::compStateChangeRequest);
 
-			connect(hyperhdr, &HyperHdrInstance::compStateChangeRequest, this, &HyperHdrIManager::compStateChangeRequest);
+				connect(this, &HyperHdrIManager::setNewComponentStateToAllInstances, hyperhdr, &HyperHdrInstance::setNewComponentState);
 
-			connect(this, &HyperHdrIManager::setNewComponentStateToAllInstances, hyperhdr, &HyperHdrInstance::setNewComponentState);
+				hyperhdr->start();
+
+				if (hdrState >= 0)
+					hyperhdr->setNewComponentState(hyperhdr::Components::COMP_HDR, hdrState != 0);
+			}, Qt::DirectConnection);
 
 			// add to queue and start
 			_startQueue << inst;
+			_startTimes[inst] = InternalClock::now();
 			hyperhdrThread->start();
 
 			// update db
@@ -300,9 +404,20 @@ void HyperHdrIManager::handleStarted()
 	HyperHdrInstance* hyperhdr = qobject_cast<HyperHdrInstance*>(sender());
 	quint8 instance = hyperhdr->getInstanceIndex();
 
-	Info(_log, "HyperHDR instance '%s' has been started", QSTRING_CSTR(_instanceTable->getNamebyIndex(instance)));
+	const qint64 now = InternalClock::now();
+
+	Info(_log, "HyperHDR instance '%s' has been started in %lld ms", QSTRING_CSTR(_instanceTable->getNamebyIndex(instance)),
+		static_cast<long long>(now - _startTimes.value(instance, now)));
 
+	_startTimes.remove(instance);
 	_startQueue.removeAll(instance);
+
+	if (_startAllTime > 0 && _startQueue.isEmpty())
+	{
+		Info(_log, "Startup timing: all the instances are running after %lld ms (%lld ms since the application start)",
+			static_cast<long long>(now - _startAllTime), static_cast<long long>(now));
+		_startAllTime = 0;
+	}
 	_runningInstances.insert(instance, hyperhdr);
 	emit instanceStateChanged(InstanceState::H_STARTED, instance, _instanceTable->getNamebyIndex(instance));
 	emit change();
@@ -7,6 +7,7 @@
 #include <QStringList>
 #include <QThread>
 #include <QPair>
+#include <QMetaMethod>
 
 #include <HyperhdrConfig.h>
 
@@ -26,6 +27,7 @@
 
 #include <base/MultiColorAdjustment.h>
 #include <base/LinearSmoothing.h>
+#include <base/PresentationScheduler.h>
 
 // effect engine includes
 #include <effectengine/EffectEngine.h>
@@ -52,7 +54,10 @@ class BoblightServer {};
 #endif
 
 #include <utils/RawUdpServer.h>
+#include <utils/LedFrameReplay.h>
 #include <utils/ColorSys.h>
+#include <utils/ThreadPolicy.h>
+#include <utils/EventTracer.h>
 
 
 
@@ -61,6 +66,7 @@ HyperHdrInstance::HyperHdrInstance(quint8 instance, bool readonlyMode, QString n
 	, _instIndex(instance)
 	, _bootEffect(QTime::currentTime().addSecs(5))
 	, _imageProcessingUnit(nullptr)
+	, _processingThread(nullptr)
 	, _settingsManager(new SettingsManager(instance, this, readonlyMode))
 	, _componentRegister(this)
 	, _ledString(LedString::createLedString(getSetting(settings::type::LEDS).array(), LedString::createColorOrder(getSetting(settings::type::DEVICE).object())))
@@ -69,6 +75,7 @@ HyperHdrInstance::HyperHdrInstance(quint8 instance, bool readonlyMode, QString n
 	, _raw2ledAdjustment(MultiColorAdjustment::createLedColorsAdjustment(instance, static_cast<int>(_ledString.leds().size()), getSetting(settings::type::COLOR).object()))
 	, _ledDeviceWrapper(nullptr)
 	, _smoothing(nullptr)
+	, _presentation(nullptr)
 	, _effectEngine(nullptr)
 	, _messageForwarder(nullptr)
 	, _log(Logger::getInstance(QString("HYPERHDR%1").arg(instance)))
@@ -77,11 +84,15 @@ HyperHdrInstance::HyperHdrInstance(quint8 instance, bool readonlyMode, QString n
 	, _BGEffectHandler(nullptr)
 	, _videoControl(nullptr)
 	, _systemControl(nullptr)
+	, _globalInput(nullptr)
 	, _globalLedBuffer(_ledString.leds().size(), ColorRgb::BLACK)
 	, _boblightServer(nullptr)
 	, _rawUdpServer(nullptr)
+	, _ledFrameReplay(nullptr)
 	, _name((name.isEmpty()) ? QString("INSTANCE%1").arg(instance) : name)
 	, _readOnlyMode(readonlyMode)
+	, _jsonInfoDirty(JSON_INFO_ALL)
+	, _firstLedFrame(true)
 
 {
 
@@ -122,6 +133,14 @@ void HyperHdrInstance::start()
 
 	connect(_settingsManager, &SettingsManager::settingsChanged, this, &HyperHdrInstance::settingsChanged);
 
+	// the cached sections of getJsonInfo follow their sources
+	connect(this, &HyperHdrInstance::settingsChanged, this, [this]() { _jsonInfoDirty = JSON_INFO_ALL; });
+	connect(this, &HyperHdrInstance::adjustmentChanged, this, [this]() { _jsonInfoDirty |= JSON_INFO_ADJUSTMENT; });
+	connect(this, &HyperHdrInstance::imageToLedsMappingChanged, this, [this]() { _jsonInfoDirty |= JSON_INFO_LEDS; });
+	connect(&_componentRegister, &ComponentRegister::updatedComponentState, this, [this]() { _jsonInfoDirty |= JSON_INFO_COMPONENTS; });
+
+	_ledPipeline.configure(_ledString);
+
 	if (!_raw2ledAdjustment->verifyAdjustments())
 	{
 		Warning(_log, "At least one led has no color calibration, please add all leds from your led layout to an 'LED index' field!");
@@ -143,6 +162,13 @@ void HyperHdrInstance::start()
 	// procesing unit
 	_imageProcessingUnit = std::unique_ptr<ImageProcessingUnit>(new ImageProcessingUnit(this));
 	connect(_imageProcessingUnit.get(), &ImageProcessingUnit::dataReadySignal, this, &HyperHdrInstance::updateResult);
+	connect(_imageProcessingUnit.get(), &ImageProcessingUnit::resultReadySignal, this, &HyperHdrInstance::handleProcessedResult, Qt::QueuedConnection);
+
+	_processingThread = new QThread();
+	_processingThread->setObjectName(QString("Processing%1").arg(_instIndex));
+	_imageProcessingUnit->moveToThread(_processingThread);
+	ThreadPolicy::attach(_processingThread, ThreadPolicy::Role::PROCESSING);
+	_processingThread->start();
 
 	// initialize LED-devices
 	QJsonObject ledDevice = getSetting(settings::type::DEVICE).object();
@@ -152,9 +178,12 @@ void HyperHdrInstance::start()
 	_smoothing = new LinearSmoothing(getSetting(settings::type::SMOOTHING), this);
 	connect(this, &HyperHdrInstance::settingsChanged, _smoothing, &LinearSmoothing::handleSettingsUpdate);
 
+	_presentation = new PresentationScheduler(getSetting(settings::type::SMOOTHING), this);
+	connect(this, &HyperHdrInstance::settingsChanged, _presentation, &PresentationScheduler::handleSettingsUpdate);
+
 	_ledDeviceWrapper = new LedDeviceWrapper(this);
 	connect(this, &HyperHdrInstance::compStateChangeRequest, _ledDeviceWrapper, &LedDeviceWrapper::handleComponentState);
-	connect(this, &HyperHdrInstance::ledDeviceData, _ledDeviceWrapper, &LedDeviceWrapper::updateLeds);
+	connect(this, &HyperHdrInstance::ledDeviceData, _ledDeviceWrapper, &LedDeviceWrapper::updateLeds, Qt::DirectConnection);
 	_ledDeviceWrapper->createLedDevice(ledDevice);
 
 	// create the message forwarder only on main instance
@@ -175,11 +204,13 @@ void HyperHdrInstance::start()
 
 	_systemControl = new SystemControl(this);
 
-	// forwards global signals to the corresponding slots
-	connect(GlobalSignals::getInstance(), &GlobalSignals::registerGlobalInput, this, &HyperHdrInstance::registerInput);
-	connect(GlobalSignals::getInstance(), &GlobalSignals::clearGlobalInput, this, &HyperHdrInstance::clear);
-	connect(GlobalSignals::getInstance(), &GlobalSignals::setGlobalColor, this, &HyperHdrInstance::setColor);
-	connect(GlobalSignals::getInstance(), &GlobalSignals::setGlobalImage, this, &HyperHdrInstance::setInputImage);
+	// forwards the global input targeted at this instance to the corresponding slots
+	_globalInput = new GlobalInputChannel(this);
+	connect(_globalInput, &GlobalInputChannel::registerGlobalInput, this, &HyperHdrInstance::registerInput, Qt::QueuedConnection);
+	connect(_globalInput, &GlobalInputChannel::clearGlobalInput, this, &HyperHdrInstance::clear, Qt::QueuedConnection);
+	connect(_globalInput, &GlobalInputChannel::setGlobalColor, this, &HyperHdrInstance::setColor, Qt::QueuedConnection);
+	connect(_globalInput, &GlobalInputChannel::setGlobalImage, this, &HyperHdrInstance::setInputImage, Qt::QueuedConnection);
+	GlobalSignals::getInstance()->subscribeGlobalInput(_instIndex, _globalInput);
 
 	// if there is no startup / background effect and no sending capture interface we probably want to push once BLACK (as PrioMuxer won't emit a priority change)
 	update();
@@ -193,6 +224,8 @@ void HyperHdrInstance::start()
 	_rawUdpServer = new RawUdpServer(this, getSetting(settings::type::RAWUDPSERVER));
 	connect(this, &HyperHdrInstance::settingsChanged, _rawUdpServer, &RawUdpServer::handleSettingsUpdate);
 
+	_ledFrameReplay = new LedFrameReplay(this);
+
 	// instance initiated, enter thread event loop
 	emit started();
 }
@@ -209,11 +242,24 @@ void HyperHdrInstance::freeObjects()
 {
 	Info(_log, "Freeing the objects...");
 
+	if (_globalInput != nullptr)
+		GlobalSignals::getInstance()->unsubscribeGlobalInput(_instIndex, _globalInput);
+
 	// switch off all leds
 	clear(-1, true);
 
+	// the processing thread uses the image processor of this instance
+	if (_processingThread != nullptr)
+	{
+		_processingThread->quit();
+		_processingThread->wait();
+		delete _processingThread;
+		_processingThread = nullptr;
+	}
+
 	// delete components on exit
 	delete _boblightServer;
+	delete _ledFrameReplay;
 	delete _rawUdpServer;
 	delete _videoControl;
 	delete _systemControl;
@@ -252,6 +298,7 @@ void HyperHdrInstance::handleSettingsUpdate(settings::type type, const QJsonDocu
 
 		// ledstring, img processor, muxer, ledGridSize (effect-engine image based effects), _ledBuffer and ByteOrder of ledstring
 		_ledString = LedString::createLedString(leds, LedString::createColorOrder(getSetting(settings::type::DEVICE).object()));
+		_ledPipeline.configure(_ledString);
 		_imageProcessor->setLedString(_ledString);
 		_muxer.updateLedColorsLength(static_cast<int>(_ledString.leds().size()));
 		_ledGridSize = LedString::getLedLayoutGridSize(leds);
@@ -281,6 +328,7 @@ void HyperHdrInstance::handleSettingsUpdate(settings::type type, const QJsonDocu
 		{
 			Info(_log, "New RGB order is: %s", QSTRING_CSTR(dev["colorOrder"].toString("rgb")));
 			_ledString = LedString::createLedString(getSetting(settings::type::LEDS).array(), LedString::createColorOrder(dev));
+			_ledPipeline.configure(_ledString);
 			_imageProcessor->setLedString(_ledString);
 		}
 
@@ -310,6 +358,20 @@ void HyperHdrInstance::saveCalibration(QString saveData)
 	_settingsManager->saveSetting(settings::type::VIDEODETECTION, saveData);
 }
 
+QString HyperHdrInstance::startReplay(QString fileName, double speed, int priority)
+{
+	if (_ledFrameReplay == nullptr)
+		return "The replay is not available";
+
+	return _ledFrameReplay->start(fileName, speed, priority);
+}
+
+void HyperHdrInstance::stopReplay()
+{
+	if (_ledFrameReplay != nullptr)
+		_ledFrameReplay->stop();
+}
+
 void HyperHdrInstance::setSmoothing(int time)
 {
 	_smoothing->updateCurrentConfig(time);
@@ -389,7 +451,12 @@ void HyperHdrInstance::setNewComponentState(hyperhdr::Components component, bool
 		if (state)
 			emit PerformanceCounters::getInstance()->newCounter(PerformanceReport(static_cast<int>(PerformanceReportType::LED), -1, "", -1, -1, -1, -1, getInstanceIndex()));
 		else
+		{
+			_presentation->clear();
 			emit PerformanceCounters::getInstance()->removeCounter(static_cast<int>(PerformanceReportType::LED), getInstanceIndex());
+			emit PerformanceCounters::getInstance()->removeCounter(static_cast<int>(PerformanceReportType::LATENCY), getInstanceIndex());
+			emit PerformanceCounters::getInstance()->removeCounter(static_cast<int>(PerformanceReportType::REFRESH_TIMER), getInstanceIndex());
+		}
 
 		if (GrabberWrapper::getInstance() != nullptr)
 		{
@@ -418,7 +485,7 @@ void HyperHdrInstance::updateLedsValues(int priority, const std::vector<ColorRgb
 	_muxer.updateLedsValues(priority, ledColors);
 }
 
-bool HyperHdrInstance::setInput(int priority, const std::vector<ColorRgb>& ledColors, int timeout_ms, bool clearEffect)
+bool HyperHdrInstance::setInput(int priority, const std::vector<ColorRgb>& ledColors, int timeout_ms, bool clearEffect, int64_t captureTimestamp)
 {
 	if (_muxer.setInput(priority, ledColors, timeout_ms))
 	{
@@ -431,7 +498,11 @@ bool HyperHdrInstance::setInput(int priority, const std::vector<ColorRgb>& ledCo
 		// if this priority is visible, update immediately
 		if (priority == _muxer.getCurrentPriority())
 		{
-			update();
+			FrameTrace trace;
+			trace.timestamp = captureTimestamp;
+
+			emit _imageProcessingUnit->clearQueueImageSignal();
+			emit _imageProcessingUnit->dataReadySignal(_muxer.getInputInfo(priority).ledColors, trace);
 		}
 
 		return true;
@@ -449,6 +520,13 @@ void HyperHdrInstance::saveGrabberParams(int hardware_brightness, int hardware_c
 	_settingsManager->saveSetting(settings::type::VIDEOGRABBER, QJsonDocument(grabber).toJson(QJsonDocument::Compact));
 }
 
+bool HyperHdrInstance::isImageConsumed()
+{
+	return receivers(SIGNAL(onCurrentImage())) > 0 ||
+		receivers(SIGNAL(forwardV4lProtoMessage(QString, Image<ColorRgb>))) > 0 ||
+		receivers(SIGNAL(forwardSystemProtoMessage(QString, Image<ColorRgb>))) > 0;
+}
+
 bool HyperHdrInstance::setInputImage(int priority, const Image<ColorRgb>& image, int64_t timeout_ms, bool clearEffect)
 {
 	if (!_muxer.hasPriority(priority))
@@ -533,6 +611,7 @@ ColorAdjustment* HyperHdrInstance::getAdjustment(const QString& id) const
 
 void HyperHdrInstance::adjustmentsUpdated()
 {
+	_raw2ledAdjustment->invalidateTables();
 	emit adjustmentChanged();
 	update();
 }
@@ -636,6 +715,11 @@ QString HyperHdrInstance::getActiveDeviceType() const
 	return _ledDeviceWrapper->getActiveDeviceType();
 }
 
+std::shared_ptr<WriteCadence> HyperHdrInstance::getWriteCadence() const
+{
+	return (_ledDeviceWrapper != nullptr) ? _ledDeviceWrapper->getWriteCadence() : nullptr;
+}
+
 void HyperHdrInstance::handleVisibleComponentChanged(hyperhdr::Components comp)
 {
 	_imageProcessor->setBlackbarDetectDisable((comp == hyperhdr::COMP_EFFECT));
@@ -676,17 +760,25 @@ void HyperHdrInstance::update()
 {
 	const PriorityMuxer::InputInfo& priorityInfo = _muxer.getInputInfo(_muxer.getCurrentPriority());
 	emit _imageProcessingUnit->clearQueueImageSignal();
-	emit _imageProcessingUnit->dataReadySignal(priorityInfo.ledColors);
+	emit _imageProcessingUnit->dataReadySignal(priorityInfo.ledColors, FrameTrace());
 }
 
 void HyperHdrInstance::requestForColors()
 {
 	const PriorityMuxer::InputInfo& priorityInfo = _muxer.getInputInfo(_muxer.getCurrentPriority());
-	emit _imageProcessingUnit->dataReadySignal(priorityInfo.ledColors);
+	emit _imageProcessingUnit->dataReadySignal(priorityInfo.ledColors, FrameTrace());
 }
 
-void HyperHdrInstance::updateResult(std::vector<ColorRgb> _ledBuffer)
+void HyperHdrInstance::handleProcessedResult()
 {
+	if (_imageProcessingUnit != nullptr)
+		_imageProcessingUnit->deliverResult();
+}
+
+void HyperHdrInstance::updateResult(const std::vector<ColorRgb>& ledColors, const FrameTrace& trace)
+{
+	TRACE_SCOPE_ARG("adjustment", getInstanceIndex());
+
 	// stats
 	int64_t now = InternalClock::now();
 	int64_t diff = now - _computeStats.statBegin;
@@ -701,69 +793,50 @@ void HyperHdrInstance::updateResult(std::vector<ColorRgb> _ledBuffer)
 	else if (prevToken != (_computeStats.token = PerformanceCounters::currentToken()))
 	{
 
+		qint64 received = 0, coalesced = 0, processed = 0, overBudget = 0;
+
+		_imageProcessingUnit->takeQueueCounters(received, coalesced, processed, overBudget);
+
 		if (diff >= 59000 && diff <= 65000)
+		{
+			PerformanceReport report(static_cast<int>(PerformanceReportType::INSTANCE), _computeStats.token, _name, _computeStats.total / qMax(diff/1000.0, 1.0), _computeStats.total, coalesced, overBudget, getInstanceIndex());
+			report.histogram = _processingLatency.toJson();
+			emit PerformanceCounters::getInstance()->newCounter(report);
+
 			emit PerformanceCounters::getInstance()->newCounter(
-				PerformanceReport(static_cast<int>(PerformanceReportType::INSTANCE), _computeStats.token, _name, _computeStats.total / qMax(diff/1000.0, 1.0), _computeStats.total, 0, 0, getInstanceIndex()));
+				PerformanceReport(static_cast<int>(PerformanceReportType::FRAME_QUEUE), _computeStats.token, _name, (received > 0) ? (100.0 * coalesced) / received : 0, received, coalesced, processed, getInstanceIndex()));
+		}
 
 		_computeStats.statBegin = now;
 		_computeStats.total = 1;
+		_processingLatency.clear();
 	}
 	else
 		_computeStats.total++;
 
-	_globalLedBuffer = _ledBuffer;
+	// both buffers keep their capacity: no allocation as long as the led count doesn't change
+	_globalLedBuffer.assign(ledColors.begin(), ledColors.end());
+	_ledBuffer.assign(ledColors.begin(), ledColors.end());
 
-	for (int disabledProcessing = 0; disabledProcessing < 2; disabledProcessing++)
-	{
-		if (disabledProcessing == 1)
-			_raw2ledAdjustment->applyAdjustment(_ledBuffer);
+	_ledPipeline.maskDisabled(_ledBuffer);
 
-		if (_ledString.hasDisabled)
-		{
-			auto ledIter = _ledString.leds().begin();
-			for (ColorRgb& color : _ledBuffer)
-				if (ledIter != _ledString.leds().end())
-				{
-					if ((*ledIter).disabled)
-						color = ColorRgb::BLACK;
-					++ledIter;
-				}
-		}
+	// the queued signal copies the colors, only for the active led streaming
+	static const QMetaMethod rawLedColorsSignal = QMetaMethod::fromSignal(&HyperHdrInstance::rawLedColors);
+	if (isSignalConnected(rawLedColorsSignal))
+		emit rawLedColors(_ledBuffer);
 
-		if (disabledProcessing == 0)
-			emit rawLedColors(_ledBuffer);
-	}
+	// a direct connection of the forwarder, the colors are sent before they are adjusted
+	static const QMetaMethod renderNodeColorsSignal = QMetaMethod::fromSignal(&HyperHdrInstance::renderNodeColors);
+	if (isSignalConnected(renderNodeColorsSignal))
+		emit renderNodeColors(_ledBuffer, trace.timestamp);
 
-	if (_ledString.colorOrder != ColorOrder::ORDER_RGB)
-	{
-		for (ColorRgb& color : _ledBuffer)
-		{
-			// correct the color byte order
-			switch (_ledString.colorOrder)
-			{
-				case ColorOrder::ORDER_RGB:
-					break;
-				case ColorOrder::ORDER_BGR:
-					std::swap(color.red, color.blue);
-					break;
-				case ColorOrder::ORDER_RBG:
-					std::swap(color.green, color.blue);
-					break;
-				case ColorOrder::ORDER_GRB:
-					std::swap(color.red, color.green);
-					break;
-				case ColorOrder::ORDER_GBR:
-					std::swap(color.red, color.green);
-					std::swap(color.green, color.blue);
-					break;
-
-				case ColorOrder::ORDER_BRG:
-					std::swap(color.red, color.blue);
-					std::swap(color.green, color.blue);
-					break;
-			}
-		}
-	}
+	_raw2ledAdjustment->applyAdjustment(_ledBuffer);
+
+	// the adjustment may give a color to the black (ex. backlight)
+	_ledPipeline.maskDisabled(_ledBuffer);
+
+	// correct the color byte order
+	_ledPipeline.applyColorOrder(_ledBuffer);
 
 	// fill additional hardware LEDs with black
 	if (_hwLedCount > static_cast<int>(_ledBuffer.size()))
@@ -771,13 +844,19 @@ void HyperHdrInstance::updateResult(std::vector<ColorRgb> _ledBuffer)
 		_ledBuffer.resize(_hwLedCount, ColorRgb::BLACK);
 	}
 
+	FrameTrace adjusted = trace;
+	adjusted.mark(FrameTrace::ADJUSTED);
+
+	if (trace.stamps[FrameTrace::QUEUED] > 0)
+		_processingLatency.add((adjusted.stamps[FrameTrace::ADJUSTED] - trace.stamps[FrameTrace::QUEUED]) / 100);
+
 	// Write the data to the device
 	if (_ledDeviceWrapper->enabled())
 	{
 		// Smoothing is disabled
 		if (!_smoothing->enabled())
 		{
-			emit ledDeviceData(_ledBuffer);
+			writeLedDeviceData(_ledBuffer, adjusted);
 		}
 		else
 		{
@@ -789,12 +868,32 @@ void HyperHdrInstance::updateResult(std::vector<ColorRgb> _ledBuffer)
 			// feed smoothing in pause mode to maintain a smooth transition back to smooth mode
 			if (_smoothing->enabled() || _smoothing->pause())
 			{
-				_smoothing->updateLedValues(_ledBuffer);
+				_smoothing->updateLedValues(_ledBuffer, adjusted);
 			}
 		}
 	}
 }
 
+void HyperHdrInstance::writeLedDeviceData(const std::vector<ColorRgb>& ledValues, const FrameTrace& trace)
+{
+	if (_firstLedFrame)
+	{
+		_firstLedFrame = false;
+		Info(_log, "Startup timing: the first LED frame is sent after %lld ms since the application start", static_cast<long long>(InternalClock::now()));
+	}
+
+	FrameTrace smoothed = trace;
+	smoothed.mark(FrameTrace::SMOOTHED);
+
+	if (!_presentation->schedule(ledValues, smoothed))
+		presentLedDeviceData(ledValues, smoothed);
+}
+
+void HyperHdrInstance::presentLedDeviceData(const std::vector<ColorRgb>& ledValues, const FrameTrace& trace)
+{
+	emit ledDeviceData(_ledFramePool.make(ledValues), trace);
+}
+
 void HyperHdrInstance::identifyLed(const QJsonObject& params)
 {
 	_ledDeviceWrapper->handleComponentState(hyperhdr::Components::COMP_LEDDEVICE, true);
@@ -878,70 +977,76 @@ QJsonObject HyperHdrInstance::getJsonInfo(bool full)
 	// collect adjustment information //
 	////////////////////////////////////
 
-	QJsonArray adjustmentArray;
-	for (const QString& adjustmentId : getAdjustmentIds())
+	if (_jsonInfoDirty & JSON_INFO_ADJUSTMENT)
 	{
-		const ColorAdjustment* colorAdjustment = getAdjustment(adjustmentId);
-		if (colorAdjustment == nullptr)
+		QJsonArray adjustmentArray;
+		for (const QString& adjustmentId : getAdjustmentIds())
 		{
-			Error(_log, "Incorrect color adjustment id: %s", QSTRING_CSTR(adjustmentId));
-			continue;
-		}
+			const ColorAdjustment* colorAdjustment = getAdjustment(adjustmentId);
+			if (colorAdjustment == nullptr)
+			{
+				Error(_log, "Incorrect color adjustment id: %s", QSTRING_CSTR(adjustmentId));
+				continue;
+			}
 
-		QJsonObject adjustment;
-		adjustment["id"] = adjustmentId;
+			QJsonObject adjustment;
+			adjustment["id"] = adjustmentId;
 
-		QList<QPair<QString, const RgbChannelAdjustment*>> calibColors;
-		calibColors.append(qMakePair(QString("white"),	&(colorAdjustment->_rgbWhiteAdjustment)));
-		calibColors.append(qMakePair(QString("red"),	&(colorAdjustment->_rgbRedAdjustment)));
-		calibColors.append(qMakePair(QString("green"),	&(colorAdjustment->_rgbGreenAdjustment)));
-		calibColors.append(qMakePair(QString("blue"),	&(colorAdjustment->_rgbBlueAdjustment)));
-		calibColors.append(qMakePair(QString("cyan"),	&(colorAdjustment->_rgbCyanAdjustment)));
-		calibColors.append(qMakePair(QString("magenta"),&(colorAdjustment->_rgbMagentaAdjustment)));
-		calibColors.append(qMakePair(QString("yellow"),	&(colorAdjustment->_rgbYellowAdjustment)));
+			QList<QPair<QString, const RgbChannelAdjustment*>> calibColors;
+			calibColors.append(qMakePair(QString("white"),	&(colorAdjustment->_rgbWhiteAdjustment)));
+			calibColors.append(qMakePair(QString("red"),	&(colorAdjustment->_rgbRedAdjustment)));
+			calibColors.append(qMakePair(QString("green"),	&(colorAdjustment->_rgbGreenAdjustment)));
+			calibColors.append(qMakePair(QString("blue"),	&(colorAdjustment->_rgbBlueAdjustment)));
+			calibColors.append(qMakePair(QString("cyan"),	&(colorAdjustment->_rgbCyanAdjustment)));
+			calibColors.append(qMakePair(QString("magenta"),&(colorAdjustment->_rgbMagentaAdjustment)));
+			calibColors.append(qMakePair(QString("yellow"),	&(colorAdjustment->_rgbYellowAdjustment)));
 
-		for (const QPair<QString, const RgbChannelAdjustment*>& myElemCalib : calibColors)
-		{
-			QJsonArray adj;
-			adj.append(myElemCalib.second->getAdjustmentR());
-			adj.append(myElemCalib.second->getAdjustmentG());
-			adj.append(myElemCalib.second->getAdjustmentB());
-			adjustment.insert(myElemCalib.first, adj);
-		}
+			for (const QPair<QString, const RgbChannelAdjustment*>& myElemCalib : calibColors)
+			{
+				QJsonArray adj;
+				adj.append(myElemCalib.second->getAdjustmentR());
+				adj.append(myElemCalib.second->getAdjustmentG());
+				adj.append(myElemCalib.second->getAdjustmentB());
+				adjustment.insert(myElemCalib.first, adj);
+			}
 
-		adjustment["backlightThreshold"] = colorAdjustment->_rgbTransform.getBacklightThreshold();
-		adjustment["backlightColored"] = colorAdjustment->_rgbTransform.getBacklightColored();
-		adjustment["brightness"] = colorAdjustment->_rgbTransform.getBrightness();
-		adjustment["brightnessCompensation"] = colorAdjustment->_rgbTransform.getBrightnessCompensation();
-		adjustment["gammaRed"] = colorAdjustment->_rgbTransform.getGammaR();
-		adjustment["gammaGreen"] = colorAdjustment->_rgbTransform.getGammaG();
-		adjustment["gammaBlue"] = colorAdjustment->_rgbTransform.getGammaB();
-		adjustment["temperatureRed"] = colorAdjustment->_rgbRedAdjustment.getCorrection();
-		adjustment["temperatureGreen"] = colorAdjustment->_rgbGreenAdjustment.getCorrection();
-		adjustment["temperatureBlue"] = colorAdjustment->_rgbBlueAdjustment.getCorrection();
-		adjustment["saturationGain"] = colorAdjustment->_rgbTransform.getSaturationGain();
-		adjustment["luminanceGain"] = colorAdjustment->_rgbTransform.getLuminanceGain();
-		adjustment["classic_config"] = colorAdjustment->_rgbTransform.getClassicConfig();
-
-		adjustmentArray.append(adjustment);
+			adjustment["backlightThreshold"] = colorAdjustment->_rgbTransform.getBacklightThreshold();
+			adjustment["backlightColored"] = colorAdjustment->_rgbTransform.getBacklightColored();
+			adjustment["brightness"] = colorAdjustment->_rgbTransform.getBrightness();
+			adjustment["brightnessCompensation"] = colorAdjustment->_rgbTransform.getBrightnessCompensation();
+			adjustment["gammaRed"] = colorAdjustment->_rgbTransform.getGammaR();
+			adjustment["gammaGreen"] = colorAdjustment->_rgbTransform.getGammaG();
+			adjustment["gammaBlue"] = colorAdjustment->_rgbTransform.getGammaB();
+			adjustment["temperatureRed"] = colorAdjustment->_rgbRedAdjustment.getCorrection();
+			adjustment["temperatureGreen"] = colorAdjustment->_rgbGreenAdjustment.getCorrection();
+			adjustment["temperatureBlue"] = colorAdjustment->_rgbBlueAdjustment.getCorrection();
+			adjustment["saturationGain"] = colorAdjustment->_rgbTransform.getSaturationGain();
+			adjustment["luminanceGain"] = colorAdjustment->_rgbTransform.getLuminanceGain();
+			adjustment["classic_config"] = colorAdjustment->_rgbTransform.getClassicConfig();
+
+			adjustmentArray.append(adjustment);
+		}
+		_jsonInfoCache["adjustment"] = adjustmentArray;
 	}
-	info["adjustment"] = adjustmentArray;
 
 	////////////////////////////////////
 	//   collect effect information   //
 	////////////////////////////////////
 
-	QJsonArray effects;
-	std::list<EffectDefinition> effectsDefinitions = getEffects();
-
-	for (const EffectDefinition& effectDefinition : effectsDefinitions)
+	if (_jsonInfoDirty & JSON_INFO_EFFECTS)
 	{
-		QJsonObject effect;
-		effect["name"] = effectDefinition.name;
-		effect["args"] = effectDefinition.args;
-		effects.append(effect);
+		QJsonArray effects;
+		std::list<EffectDefinition> effectsDefinitions = getEffects();
+
+		for (const EffectDefinition& effectDefinition : effectsDefinitions)
+		{
+			QJsonObject effect;
+			effect["name"] = effectDefinition.name;
+			effect["args"] = effectDefinition.args;
+			effects.append(effect);
+		}
+		_jsonInfoCache["effects"] = effects;
 	}
-	info["effects"] = effects;
 
 	////////////////////////////////////
 	//    collect running effects     //
@@ -1012,27 +1117,42 @@ QJsonObject HyperHdrInstance::getJsonInfo(bool full)
 	//    collect vailable components    //
 	///////////////////////////////////////
 
-	QJsonArray component;
-	std::map<hyperhdr::Components, bool> components = getComponentRegister().getRegister();
-	for (auto comp : components)
+	if (_jsonInfoDirty & JSON_INFO_COMPONENTS)
 	{
-		QJsonObject item;
-		item["name"] = QString::fromStdString(hyperhdr::componentToIdString(comp.first));
-		item["enabled"] = comp.second;
+		QJsonArray component;
+		std::map<hyperhdr::Components, bool> components = getComponentRegister().getRegister();
+		for (auto comp : components)
+		{
+			QJsonObject item;
+			item["name"] = QString::fromStdString(hyperhdr::componentToIdString(comp.first));
+			item["enabled"] = comp.second;
 
-		component.append(item);
+			component.append(item);
+		}
+		_jsonInfoCache["components"] = component;
 	}
-	info["components"] = component;
 
 	////////////////
 	//    MISC    //
 	////////////////
 
-	// add leds configs
-	info["leds"] = getSetting(settings::type::LEDS).array();
+	if (_jsonInfoDirty & JSON_INFO_LEDS)
+	{
+		// add leds configs
+		_jsonInfoCache["leds"] = getSetting(settings::type::LEDS).array();
+
+		// mapping type
+		_jsonInfoCache["imageToLedMappingType"] = ImageProcessor::mappingTypeToStr(getLedMappingType());
+	}
+
+	// the sections above are built again only after a change of their source
+	_jsonInfoDirty = 0;
+	for (auto section = _jsonInfoCache.constBegin(); section != _jsonInfoCache.constEnd(); ++section)
+		info[section.key()] = section.value();
 
-	// mapping type
-	info["imageToLedMappingType"] = ImageProcessor::mappingTypeToStr(getLedMappingType());
+	// adaptive rate of the black border analysis
+	if (_imageProcessor->blackBorderDetectorEnabled())
+		info["blackborderAnalysisRate"] = _imageProcessor->getBlackBorderAnalysisRate();
 
 	return info;
 }
@@ -25,8 +25,14 @@
 *  SOFTWARE.
  */
 
+#include <QMutexLocker>
+
 #include <utils/Image.h>
+#include <utils/EventTracer.h>
+#include <utils/ImageIngest.h>
 #include <base/HyperHdrInstance.h>
+#include <base/HyperHdrIManager.h>
+#include <base/FrameContext.h>
 #include <base/ImageProcessingUnit.h>
 #include <base/ImageProcessor.h>
 #include <base/ImageToLedsMap.h>
@@ -34,64 +40,233 @@
 
 using namespace hyperhdr;
 
+std::atomic<int> ImageProcessingUnit::_latencyBudget(0);
+std::atomic<qint64> ImageProcessingUnit::_budgetProcessedFrames(0);
+std::atomic<qint64> ImageProcessingUnit::_budgetOverFrames(0);
 
 ImageProcessingUnit::ImageProcessingUnit(HyperHdrInstance* hyperhdr)
-	: QObject(hyperhdr),
+	: QObject(),
 	_priority(-1),
-	_hyperhdr(hyperhdr)
+	_hyperhdr(hyperhdr),
+	_frameQueuedTime(0),
+	_previousQueuedTime(0),
+	_mailbox(nullptr),
+	_result(nullptr),
+	_generation(0),
+	_lastQueuedTime(0),
+	_receivedFrames(0),
+	_coalescedFrames(0),
+	_processedFrames(0),
+	_overBudgetFrames(0),
+	_lastPriority(-1),
+	_lastResultTime(0)
 {
 
 	connect(this, &ImageProcessingUnit::processImageSignal, this, &ImageProcessingUnit::processImage, Qt::ConnectionType::QueuedConnection);
-	connect(this, &ImageProcessingUnit::clearQueueImageSignal, this, &ImageProcessingUnit::clearQueueImage);
-	connect(this, &ImageProcessingUnit::queueImageSignal, this, &ImageProcessingUnit::queueImage);
+	// both are called from the instance thread, the mailbox makes them safe
+	connect(this, &ImageProcessingUnit::clearQueueImageSignal, this, &ImageProcessingUnit::clearQueueImage, Qt::ConnectionType::DirectConnection);
+	connect(this, &ImageProcessingUnit::queueImageSignal, this, &ImageProcessingUnit::queueImage, Qt::ConnectionType::DirectConnection);
 }
 
 ImageProcessingUnit::~ImageProcessingUnit()
 {
 	clearQueueImage();
+
+	delete _result.exchange(nullptr);
+}
+
+void ImageProcessingUnit::setLatencyBudget(int budget)
+{
+	_latencyBudget = qMax(budget, 0);
+}
+
+void ImageProcessingUnit::takeQueueCounters(qint64& received, qint64& coalesced, qint64& processed, qint64& overBudget)
+{
+	received = _receivedFrames.exchange(0);
+	coalesced = _coalescedFrames.exchange(0);
+	processed = _processedFrames.exchange(0);
+	overBudget = _overBudgetFrames.exchange(0);
+}
+
+void ImageProcessingUnit::takeBudgetCounters(qint64& processed, qint64& overBudget)
+{
+	processed = _budgetProcessedFrames.exchange(0);
+	overBudget = _budgetOverFrames.exchange(0);
 }
 
 void ImageProcessingUnit::queueImage(int priority, const Image<ColorRgb>& image)
 {
 	if (image.width() != 1 || image.height() != 1)
 	{
-		_frameBuffer = image;
-		_priority = priority;
+		qint64 now = InternalClock::now();
+
+		PendingFrame* frame = new PendingFrame{ priority, image, now, _lastQueuedTime.exchange(now), _generation, image.trace() };
+		frame->trace.mark(FrameTrace::QUEUED);
+
+		_receivedFrames++;
 
-		emit processImageSignal();
+		// newest frame wins: the one still waiting for processing is replaced and the slot already has its wake-up call
+		PendingFrame* previous = _mailbox.exchange(frame);
+
+		if (previous != nullptr)
+		{
+			_coalescedFrames++;
+			delete previous;
+		}
+		else
+			emit processImageSignal();
 	}
 }
 
 void ImageProcessingUnit::clearQueueImage()
 {
-	_frameBuffer = Image<ColorRgb>();
-	_priority = -1;
+	_generation++;
+
+	delete _mailbox.exchange(nullptr);
 }
 
 
 void ImageProcessingUnit::processImage()
 {
-	if (_priority < 0 || (_frameBuffer.width() == 1 && _frameBuffer.height() == 1))
+	std::unique_ptr<PendingFrame> frame(_mailbox.exchange(nullptr));
+
+	if (frame == nullptr)
 		return;
 
+	TRACE_SCOPE("mapping");
+
+	_frameBuffer = frame->image;
+	_priority = frame->priority;
+	_frameQueuedTime = frame->queuedTime;
+	_previousQueuedTime = frame->previousQueuedTime;
+	const int generation = frame->generation;
+	FrameTrace trace = frame->trace;
+	frame.reset();
+
+	// a newer frame is on the way when the source is streaming: don't waste the time for the outdated one
+	int budget = _latencyBudget;
+	if (budget > 0)
+	{
+		qint64 now = InternalClock::now();
+		qint64 since = (_frameBuffer.timestamp() > 0) ? _frameBuffer.timestamp() : _frameQueuedTime;
+
+		if (now - since > budget && _frameQueuedTime - _previousQueuedTime < 1000)
+		{
+			_overBudgetFrames++;
+			_budgetOverFrames++;
+			releaseFrame();
+			return;
+		}
+	}
+
 	ImageProcessor* imageProcessor = _hyperhdr->getImageProcessor();
 
+	_processedFrames++;
+	_budgetProcessedFrames++;
+
 	if (imageProcessor != nullptr)
 	{
-		imageProcessor->setSize(_frameBuffer);;
-		imageProcessor->verifyBorder(_frameBuffer);
+		// the instances that process the same frame share its analysis
+		std::shared_ptr<FrameContext> context = (HyperHdrIManager::getInstance() != nullptr) ?
+			HyperHdrIManager::getInstance()->getFrameContext(_frameBuffer) : nullptr;
+
+		const bool imageConsumed = _hyperhdr->isImageConsumed();
+
+		// the instance thread changes the settings of the processor under the same lock
+		QMutexLocker locker(&imageProcessor->_lock);
+
+		imageProcessor->setFullFrameRequired(imageConsumed);
+
+		// an instance with its own crop takes a view of the shared frame: the analysis of the whole frame is not its own
+		const ImageView<ColorRgb> view = imageProcessor->cropView(_frameBuffer);
+		const FrameContext* frameContext = (imageProcessor->hasCrop()) ? nullptr : context.get();
+
+		imageProcessor->setSize(view.width(), view.height());
+		imageProcessor->verifyBorder(view, frameContext);
+		imageProcessor->adoptBuiltMapping();
 
 		std::shared_ptr<hyperhdr::ImageToLedsMap> image2leds = imageProcessor->_imageToLedColors;
 
-		if (image2leds != nullptr && image2leds->width() == _frameBuffer.width() && image2leds->height() == _frameBuffer.height())
+		if (image2leds != nullptr && image2leds->width() == view.width() && image2leds->height() == view.height())
 		{
-			std::vector<ColorRgb> colors = image2leds->Process(_frameBuffer, imageProcessor->advanced);
+			// a static frame (menu, pause, desktop) stops here, the result is refreshed only once per keep-alive period
+			qint64 now = InternalClock::now();
+			bool reuse = (_priority == _lastPriority && now - _lastResultTime < KEEP_ALIVE_MS);
+			bool unchanged = false;
 
-			_hyperhdr->updateLedsValues(_priority, colors);
-			emit dataReadySignal(colors);
-			emit _hyperhdr->onCurrentImage();
+			std::vector<ColorRgb> colors = image2leds->Process(view, imageProcessor->advanced, reuse, unchanged, frameContext, imageProcessor->getGpuReducer());
+
+			locker.unlock();
+
+			// the source left the HDR tone mapping to the LED colors
+			ImageIngest::applyDeferred(_frameBuffer, colors);
+
+			const bool notify = (!unchanged || !reuse);
+
+			if (notify)
+			{
+				_lastPriority = _priority;
+				_lastResultTime = now;
+			}
+
+			trace.mark(FrameTrace::MAPPED);
+
+			publishResult(PendingResult{ _priority, std::move(colors), trace, notify, generation });
 		}
 	}
 
-	clearQueueImage();
+	releaseFrame();
+}
+
+void ImageProcessingUnit::publishResult(const PendingResult& result)
+{
+	PendingResult* previous = _result.exchange(new PendingResult(result));
+
+	if (previous == nullptr)
+	{
+		emit resultReadySignal();
+		return;
+	}
+
+	// the instance thread is late: the newer colors are enough, but not the lost notification of the skipped result
+	const bool lostNotify = (previous->notify && !result.notify);
+
+	delete previous;
+
+	if (lostNotify)
+	{
+		// the result may be already taken, then the colors are delivered again, this time with the notification
+		PendingResult* copy = new PendingResult(result);
+		copy->notify = true;
+
+		previous = _result.exchange(copy);
+
+		if (previous == nullptr)
+			emit resultReadySignal();
+		else
+			delete previous;
+	}
+}
+
+void ImageProcessingUnit::deliverResult()
+{
+	std::unique_ptr<PendingResult> result(_result.exchange(nullptr));
+
+	// the queue was cleared (ex. the visible priority changed) after the frame was taken for processing
+	if (result == nullptr || result->generation != _generation)
+		return;
+
+	_hyperhdr->updateLedsValues(result->priority, result->colors);
+
+	if (result->notify)
+		emit dataReadySignal(result->colors, result->trace);
+
+	emit _hyperhdr->onCurrentImage();
+}
+
+void ImageProcessingUnit::releaseFrame()
+{
+	// only the frame that was processed, a newer one may be already waiting in the mailbox
+	_frameBuffer = Image<ColorRgb>();
+	_priority = -1;
 }
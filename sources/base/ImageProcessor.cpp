@@ -1,39 +1,292 @@
 
 
+#include <QMutexLocker>
+#include <QRunnable>
+#include <QThreadPool>
+
+#include <algorithm>
+#include <cmath>
+#include <functional>
+
 #include <base/HyperHdrInstance.h>
 #include <base/ImageProcessor.h>
 #include <base/ImageToLedsMap.h>
+#include <base/GpuLedReducer.h>
+#include <base/QualityGovernor.h>
+#include <utils/GlobalSignals.h>
+#include <utils/ImageIngest.h>
 
 // Blacborder includes
 #include <blackborder/BlackBorderProcessor.h>
 
 using namespace hyperhdr;
 
+namespace
+{
+	/// pixels of the reduced image across the smallest led area, in both directions
+	const double MIN_LED_AREA_PIXELS = 16;
+
+	// builds the led mapping on the shared thread pool, the processing thread never waits for it
+	class MappingBuildTask : public QRunnable
+	{
+	public:
+		MappingBuildTask(const std::function<void()>& build)
+			: _build(build)
+		{
+		}
+
+		void run() override
+		{
+			_build();
+		}
+
+	private:
+		std::function<void()> _build;
+	};
+}
+
 void ImageProcessor::registerProcessingUnit(
 	const unsigned width,
 	const unsigned height,
 	const unsigned horizontalBorder,
 	const unsigned verticalBorder)
 {
-	if (width > 0 && height > 0)
-		_imageToLedColors = std::make_shared<ImageToLedsMap>(
-			_log,
-			_mappingType,
-			_sparseProcessing,
-			width,
-			height,
-			horizontalBorder,
-			verticalBorder,
-			_instanceIndex,
-			_ledString.leds());
-	else
+	if (width == 0 || height == 0)
+	{
+		_wantedKey = MappingKey();
 		_imageToLedColors = nullptr;
+		publishUnusedArea();
+		return;
+	}
+
+	const MappingKey key{ width, height, horizontalBorder, verticalBorder, _mappingType, _sparseProcessing, _parallelThreshold };
+
+	_wantedKey = key;
+
+	// a finished build may be the one we need
+	adoptBuiltMapping();
+
+	std::shared_ptr<ImageToLedsMap> mapping = findCachedMapping(key);
+
+	if (mapping != nullptr)
+	{
+		_mappingCacheHits++;
+		_imageToLedColors = mapping;
+	}
+	else
+	{
+		// the current mapping keeps serving the frames until the new one is swapped in
+		_mappingCacheMisses++;
+		requestMapping(key);
+	}
+
+	publishUnusedArea();
+}
+
+std::shared_ptr<ImageToLedsMap> ImageProcessor::findCachedMapping(const MappingKey& key)
+{
+	// the most recently used mapping is at the front
+	for (auto it = _mappingCache.begin(); it != _mappingCache.end(); ++it)
+		if (it->first == key)
+		{
+			_mappingCache.splice(_mappingCache.begin(), _mappingCache, it);
+			return _mappingCache.front().second;
+		}
+
+	return nullptr;
+}
+
+void ImageProcessor::cacheMapping(const MappingKey& key, const std::shared_ptr<ImageToLedsMap>& mapping)
+{
+	if (findCachedMapping(key) != nullptr)
+		_mappingCache.front().second = mapping;
+	else
+		_mappingCache.emplace_front(key, mapping);
+
+	// drop the least recently used mappings above the limit, the new one always stays
+	size_t memory = 0;
+	for (auto it = _mappingCache.begin(); it != _mappingCache.end(); )
+	{
+		memory += it->second->memoryUsage();
+
+		if (it != _mappingCache.begin() && memory > MAPPING_CACHE_LIMIT)
+		{
+			memory -= it->second->memoryUsage();
+			it = _mappingCache.erase(it);
+		}
+		else
+			++it;
+	}
+
+	Debug(_log, "Led mapping cache: %d entries (memory: %d bytes), hits: %d, misses: %d",
+		_mappingCache.size(), memory, _mappingCacheHits, _mappingCacheMisses);
+}
+
+void ImageProcessor::requestMapping(const MappingKey& key)
+{
+	QMutexLocker locker(&_mappingBuild->lock);
+
+	// a running build picks the newest request up when it's done
+	_mappingBuild->requested = key;
+
+	if (!_mappingBuild->running)
+	{
+		_mappingBuild->running = true;
+
+		std::shared_ptr<MappingBuild> build = _mappingBuild;
+		Logger* log = _log;
+		quint8 instanceIndex = _instanceIndex;
+
+		QThreadPool::globalInstance()->start(new MappingBuildTask([build, log, instanceIndex]() {
+			buildMappings(build, log, instanceIndex);
+		}));
+	}
+}
+
+void ImageProcessor::buildMappings(const std::shared_ptr<MappingBuild>& build, Logger* log, quint8 instanceIndex)
+{
+	QMutexLocker locker(&build->lock);
+
+	while (true)
+	{
+		const MappingKey key = build->requested;
+		const quint64 generation = build->generation;
+		const std::vector<Led> leds = build->leds;
+
+		locker.unlock();
+
+		std::shared_ptr<ImageToLedsMap> mapping = std::make_shared<ImageToLedsMap>(
+			log,
+			key.mappingType,
+			key.sparseProcessing,
+			key.parallelThreshold,
+			key.width,
+			key.height,
+			key.horizontalBorder,
+			key.verticalBorder,
+			instanceIndex,
+			leds);
+
+		locker.relock();
+
+		// the mapping of a previous led layout is useless, the others are cached even if they were superseded
+		if (generation == build->generation)
+		{
+			build->ready = mapping;
+			build->readyKey = key;
+			build->readyGeneration = generation;
+			build->hasReady.store(true, std::memory_order_release);
+		}
+
+		if (generation == build->generation && key == build->requested)
+		{
+			build->running = false;
+			return;
+		}
+	}
+}
+
+void ImageProcessor::adoptBuiltMapping()
+{
+	if (!_mappingBuild->hasReady.load(std::memory_order_acquire))
+		return;
+
+	std::shared_ptr<ImageToLedsMap> mapping;
+	MappingKey key;
+
+	{
+		QMutexLocker locker(&_mappingBuild->lock);
+
+		_mappingBuild->hasReady.store(false, std::memory_order_relaxed);
+
+		if (_mappingBuild->readyGeneration != _mappingBuild->generation)
+		{
+			_mappingBuild->ready = nullptr;
+			return;
+		}
+
+		mapping = std::move(_mappingBuild->ready);
+		key = _mappingBuild->readyKey;
+	}
+
+	if (mapping == nullptr)
+		return;
+
+	cacheMapping(key, mapping);
+
+	if (key == _wantedKey && mapping != _imageToLedColors)
+	{
+		_imageToLedColors = mapping;
+		publishUnusedArea();
+	}
+}
+
+void ImageProcessor::setFullFrameRequired(bool required)
+{
+	if (_fullFrameRequired != required)
+	{
+		_fullFrameRequired = required;
+		publishUnusedArea();
+	}
 }
 
+void ImageProcessor::publishUnusedArea()
+{
+	// tell the grabbers which part of the frame can be skipped
+	QRectF unusedArea = (_imageToLedColors != nullptr && !_fullFrameRequired) ? _imageToLedColors->getUnusedArea() : QRectF();
+
+	// the area is relative to the cropped view, the grabbers skip it in the whole frame
+	if (!unusedArea.isEmpty() && hasCrop())
+	{
+		const double width = (100 - _cropLeft - _cropRight) / 100.0;
+		const double height = (100 - _cropTop - _cropBottom) / 100.0;
+		unusedArea = QRectF(_cropLeft / 100.0 + unusedArea.x() * width, _cropTop / 100.0 + unusedArea.y() * height,
+			unusedArea.width() * width, unusedArea.height() * height);
+	}
+
+	// the black border detector scans the outer thirds of the image
+	if (_borderProcessor->enabled() && !unusedArea.isEmpty())
+		unusedArea = unusedArea.intersected(QRectF(1.0 / 3, 1.0 / 3, 1.0 / 3, 1.0 / 3));
+
+	if (unusedArea != _unusedArea)
+	{
+		_unusedArea = unusedArea;
+		emit GlobalSignals::getInstance()->requestCaptureRegion(int(_instanceIndex), _unusedArea);
+	}
+}
+
+void ImageProcessor::publishIngestSize()
+{
+	double minWidth = 1;
+	double minHeight = 1;
+
+	for (const Led& led : _ledString.leds())
+	{
+		if (led.disabled)
+			continue;
+
+		if (led.maxX_frac > led.minX_frac)
+			minWidth = std::min(minWidth, led.maxX_frac - led.minX_frac);
+		if (led.maxY_frac > led.minY_frac)
+			minHeight = std::min(minHeight, led.maxY_frac - led.minY_frac);
+	}
+
+	// the led areas are parts of the cropped view
+	minWidth *= (100 - _cropLeft - _cropRight) / 100.0;
+	minHeight *= (100 - _cropTop - _cropBottom) / 100.0;
+
+	ImageIngest::setRequiredSize(_instanceIndex, int(std::ceil(MIN_LED_AREA_PIXELS / minWidth)), int(std::ceil(MIN_LED_AREA_PIXELS / minHeight)));
+}
 
 // global transform method
 int ImageProcessor::mappingTypeToInt(const QString& mappingType)
 {
+	if (mappingType == "dominant")
+		return 5;
+
+	if (mappingType == "integral_mean")
+		return 4;
+
 	if (mappingType == "weighted")
 		return 3;
 
@@ -48,6 +301,12 @@ int ImageProcessor::mappingTypeToInt(const QString& mappingType)
 // global transform method
 QString ImageProcessor::mappingTypeToStr(int mappingType)
 {
+	if (mappingType == 5)
+		return "dominant";
+
+	if (mappingType == 4)
+		return "integral_mean";
+
 	if (mappingType == 3)
 		return "weighted";
 
@@ -68,19 +327,41 @@ ImageProcessor::ImageProcessor(const LedString& ledString, HyperHdrInstance* hyp
 	, _imageToLedColors(nullptr)
 	, _mappingType(0)
 	, _sparseProcessing(false)
+	, _sparseSetting(false)
+	, _parallelThreshold(0)
+	, _gpuProcessing(false)
+	, _gpuFailed(false)
+	, _gpuReducer(nullptr)
+	, _unusedArea()
+	, _fullFrameRequired(false)
+	, _cropLeft(0)
+	, _cropRight(0)
+	, _cropTop(0)
+	, _cropBottom(0)
+	, _mappingBuild(std::make_shared<MappingBuild>())
+	, _wantedKey()
+	, _mappingCache()
+	, _mappingCacheHits(0)
+	, _mappingCacheMisses(0)
 	, _instanceIndex(hyperhdr->getInstanceIndex())
 {
+	_mappingBuild->leds = _ledString.leds();
+
 	// init
 	handleSettingsUpdate(settings::type::COLOR, hyperhdr->getSetting(settings::type::COLOR));
 	// listen for changes in color - ledmapping
 	connect(hyperhdr, &HyperHdrInstance::settingsChanged, this, &ImageProcessor::handleSettingsUpdate);
+	connect(QualityGovernor::getInstance(), &QualityGovernor::levelChanged, this, &ImageProcessor::qualityLevelChanged, Qt::QueuedConnection);
 
 	for (int i = 0; i < 256; i++)
 		advanced[i] = i * i;
+
+	publishIngestSize();
 }
 
 ImageProcessor::~ImageProcessor()
 {
+	ImageIngest::setRequiredSize(_instanceIndex, 0, 0);
 }
 
 void ImageProcessor::handleSettingsUpdate(settings::type type, const QJsonDocument& config)
@@ -94,15 +375,75 @@ void ImageProcessor::handleSettingsUpdate(settings::type type, const QJsonDocume
 			setLedMappingType(newType);
 		}
 
-		bool newSparse = obj["sparse_processing"].toBool(false);
-		setSparseProcessing(newSparse);
+		_sparseSetting = obj["sparse_processing"].toBool(false);
+		setSparseProcessing(_sparseSetting || QualityGovernor::isActive(QualityGovernor::SPARSE_PROCESSING));
+
+		int newThreshold = obj["parallel_threshold"].toInt(400);
+		setParallelThreshold(newThreshold);
+
+		setGpuProcessing(obj["gpu_processing"].toBool(false));
+
+		setCrop(obj["crop_left"].toInt(0), obj["crop_right"].toInt(0), obj["crop_top"].toInt(0), obj["crop_bottom"].toInt(0));
+	}
+}
+
+void ImageProcessor::qualityLevelChanged(int level)
+{
+	const bool sparse = _sparseSetting || level >= QualityGovernor::SPARSE_PROCESSING;
+
+	if (sparse != _sparseProcessing)
+		setSparseProcessing(sparse);
+}
+
+void ImageProcessor::setCrop(int left, int right, int top, int bottom)
+{
+	QMutexLocker locker(&_lock);
+
+	left = qBound(0, left, 45);
+	right = qBound(0, right, 45);
+	top = qBound(0, top, 45);
+	bottom = qBound(0, bottom, 45);
+
+	if (_cropLeft != left || _cropRight != right || _cropTop != top || _cropBottom != bottom)
+	{
+		_cropLeft = left;
+		_cropRight = right;
+		_cropTop = top;
+		_cropBottom = bottom;
+
+		Debug(_log, "Set the crop of the frame to left: %i%%, right: %i%%, top: %i%%, bottom: %i%%", left, right, top, bottom);
+
+		// the next frame builds the mapping for the size of the view
+		publishIngestSize();
+		publishUnusedArea();
 	}
 }
 
+bool ImageProcessor::hasCrop() const
+{
+	return _cropLeft != 0 || _cropRight != 0 || _cropTop != 0 || _cropBottom != 0;
+}
+
+ImageView<ColorRgb> ImageProcessor::cropView(const Image<ColorRgb>& image) const
+{
+	const unsigned left = (image.width() * _cropLeft) / 100;
+	const unsigned right = (image.width() * _cropRight) / 100;
+	const unsigned top = (image.height() * _cropTop) / 100;
+	const unsigned bottom = (image.height() * _cropBottom) / 100;
+
+	if (!hasCrop() || left + right >= image.width() || top + bottom >= image.height())
+		return ImageView<ColorRgb>(image);
+
+	const size_t lineStride = static_cast<size_t>(image.width()) * sizeof(ColorRgb);
+
+	return ImageView<ColorRgb>(image.rawMem() + top * lineStride + left * sizeof(ColorRgb),
+		image.width() - left - right, image.height() - top - bottom, static_cast<ptrdiff_t>(lineStride));
+}
+
 void ImageProcessor::setSize(unsigned width, unsigned height)
 {
-	// Check if the existing buffer-image is already the correct dimensions
-	if (_imageToLedColors !=nullptr && _imageToLedColors->width() == width && _imageToLedColors->height() == height)
+	// Check if the requested mapping has already the correct dimensions
+	if (_wantedKey.width == width && _wantedKey.height == height)
 	{
 		return;
 	}
@@ -113,16 +454,30 @@ void ImageProcessor::setSize(unsigned width, unsigned height)
 
 void ImageProcessor::setLedString(const LedString& ledString)
 {
-	if (_imageToLedColors != nullptr)
+	QMutexLocker locker(&_lock);
+
+	const bool countChanged = (_ledString.leds().size() != ledString.leds().size());
+
+	_ledString = ledString;
+
 	{
-		_ledString = ledString;
+		// the running build and the cached mappings belong to the previous layout
+		QMutexLocker buildLocker(&_mappingBuild->lock);
+		_mappingBuild->generation++;
+		_mappingBuild->leds = _ledString.leds();
+	}
+	_mappingCache.clear();
+
+	publishIngestSize();
 
-		// get current width/height
-		unsigned width = _imageToLedColors->width();
-		unsigned height = _imageToLedColors->height();
+	if (_wantedKey.width > 0 && _wantedKey.height > 0)
+	{
+		// the old mapping can serve a moved layout, but never a different number of leds
+		if (countChanged)
+			_imageToLedColors = nullptr;
 
 		// Construct a new buffer and mapping
-		registerProcessingUnit(width, height, 0, 0);
+		registerProcessingUnit(_wantedKey.width, _wantedKey.height, 0, 0);
 	}
 }
 
@@ -136,34 +491,96 @@ bool ImageProcessor::blackBorderDetectorEnabled() const
 	return _borderProcessor->enabled();
 }
 
+double ImageProcessor::getBlackBorderAnalysisRate() const
+{
+	return _borderProcessor->getAnalysisRate();
+}
+
 void ImageProcessor::setSparseProcessing(bool sparseProcessing)
 {
+	QMutexLocker locker(&_lock);
+
 	bool _orgmappingType = _sparseProcessing;
 
 	_sparseProcessing = sparseProcessing;
 
 	Debug(_log, "setSparseProcessing to %d", _sparseProcessing);
-	if (_orgmappingType != _sparseProcessing && _imageToLedColors != nullptr)
+	if (_orgmappingType != _sparseProcessing && _wantedKey.width > 0)
 	{
-		unsigned width = _imageToLedColors->width();
-		unsigned height = _imageToLedColors->height();
+		unsigned width = _wantedKey.width;
+		unsigned height = _wantedKey.height;
 
 		registerProcessingUnit(width, height, 0, 0);
 	}
 }
 
+void ImageProcessor::setParallelThreshold(int parallelThreshold)
+{
+	QMutexLocker locker(&_lock);
+
+	int _orgThreshold = _parallelThreshold;
+
+	_parallelThreshold = parallelThreshold;
+
+	Debug(_log, "setParallelThreshold to %d", _parallelThreshold);
+	if (_orgThreshold != _parallelThreshold && _wantedKey.width > 0)
+	{
+		unsigned width = _wantedKey.width;
+		unsigned height = _wantedKey.height;
+
+		registerProcessingUnit(width, height, 0, 0);
+	}
+}
+
+void ImageProcessor::setGpuProcessing(bool gpuProcessing)
+{
+	QMutexLocker locker(&_lock);
+
+	if (_gpuProcessing != gpuProcessing)
+	{
+		_gpuProcessing = gpuProcessing;
+
+		Debug(_log, "setGpuProcessing to %d", _gpuProcessing);
+
+		// a new attempt after the user toggles the option, the context is never current outside of a frame
+		_gpuReducer = nullptr;
+		_gpuFailed = false;
+	}
+}
+
+GpuLedReducer* ImageProcessor::getGpuReducer()
+{
+	if (!_gpuProcessing || _gpuFailed || _mappingType != mappingTypeToInt(QString("integral_mean")))
+		return nullptr;
+
+	if (_gpuReducer == nullptr)
+	{
+		_gpuReducer = std::unique_ptr<GpuLedReducer>(new GpuLedReducer(_log));
+
+		if (!_gpuReducer->init())
+		{
+			_gpuReducer = nullptr;
+			_gpuFailed = true;
+		}
+	}
+
+	return _gpuReducer.get();
+}
+
 void ImageProcessor::setLedMappingType(int mapType)
 {
+	QMutexLocker locker(&_lock);
+
 	int _orgmappingType = _mappingType;
 
 	_mappingType = mapType;
 
 	Debug(_log, "Set LED mapping type to %s", QSTRING_CSTR(mappingTypeToStr(mapType)));
 
-	if (_orgmappingType != _mappingType && _imageToLedColors != nullptr)
+	if (_orgmappingType != _mappingType && _wantedKey.width > 0)
 	{
-		unsigned width = _imageToLedColors->width();
-		unsigned height = _imageToLedColors->height();
+		unsigned width = _wantedKey.width;
+		unsigned height = _wantedKey.height;
 
 		registerProcessingUnit(width, height, 0, 0);
 	}
@@ -171,6 +588,8 @@ void ImageProcessor::setLedMappingType(int mapType)
 
 bool ImageProcessor::getScanParameters(size_t led, double& hscanBegin, double& hscanEnd, double& vscanBegin, double& vscanEnd) const
 {
+	QMutexLocker locker(&_lock);
+
 	if (led < _ledString.leds().size())
 	{
 		const Led& l = _ledString.leds()[led];
@@ -183,17 +602,17 @@ bool ImageProcessor::getScanParameters(size_t led, double& hscanBegin, double& h
 	return false;
 }
 
-void ImageProcessor::verifyBorder(const Image<ColorRgb>& image)
+void ImageProcessor::verifyBorder(const ImageView<ColorRgb>& image, const FrameContext* context)
 {
-	if (!_borderProcessor->enabled() && (_imageToLedColors->horizontalBorder() != 0 || _imageToLedColors->verticalBorder() != 0))
+	if (!_borderProcessor->enabled() && (_wantedKey.horizontalBorder != 0 || _wantedKey.verticalBorder != 0))
 	{
 		Debug(_log, "Reset border");
-		_borderProcessor->process(image);
+		_borderProcessor->process(image, context);
 
 		registerProcessingUnit(image.width(), image.height(), 0, 0);
 	}
 
-	if (_borderProcessor->enabled() && _borderProcessor->process(image))
+	if (_borderProcessor->enabled() && _borderProcessor->process(image, context))
 	{
 		const hyperhdr::BlackBorder border = _borderProcessor->getCurrentBorder();
 
@@ -1,14 +1,289 @@
 #include <base/ImageToLedsMap.h>
 #include <base/ImageProcessor.h>
-
-#define push_back_index(list, index) list.push_back((index) * 3)
+#include <base/FrameContext.h>
+#include <base/GpuLedReducer.h>
+#include <cstdlib>
+#include <cstring>
+#include <algorithm>
+
+#include <QThreadPool>
+#include <QRunnable>
+#include <QSemaphore>
+
+#if defined(__SSE2__) || defined(__x86_64__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+	#define IMAGETOLEDS_SSE2
+	#include <emmintrin.h>
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__) || defined(__aarch64__)
+	#define IMAGETOLEDS_NEON
+	#include <arm_neon.h>
+#endif
 
 using namespace hyperhdr;
 
+namespace
+{
+	// Span kernels for the packed RGB rows (step of 3 bytes): they add the per-channel sums (or the sums of squares)
+	// of the span to sum[3] and never read past its last pixel. The integer results are identical to the scalar loops.
+
+	void sumSpanScalar(const uint8_t* pixel, int count, uint64_t* sum)
+	{
+		uint_fast32_t red = 0, green = 0, blue = 0;
+
+		for (int i = 0; i < count; i++, pixel += 3)
+		{
+			red += pixel[0];
+			green += pixel[1];
+			blue += pixel[2];
+		}
+
+		sum[0] += red;
+		sum[1] += green;
+		sum[2] += blue;
+	}
+
+	void sumSquaresSpanScalar(const uint8_t* pixel, int count, uint64_t* sum)
+	{
+		uint_fast64_t red = 0, green = 0, blue = 0;
+
+		for (int i = 0; i < count; i++, pixel += 3)
+		{
+			red += pixel[0] * pixel[0];
+			green += pixel[1] * pixel[1];
+			blue += pixel[2] * pixel[2];
+		}
+
+		sum[0] += red;
+		sum[1] += green;
+		sum[2] += blue;
+	}
+
+#if defined(IMAGETOLEDS_SSE2)
+
+	// 16 pixels = 3 vectors, the channel of byte i of vector v is (i + v) % 3 for the byte order R G B
+	inline __m128i channelMask8(int channel)
+	{
+		alignas(16) uint8_t mask[16];
+		for (int i = 0; i < 16; i++)
+			mask[i] = (i % 3 == channel) ? 0xFF : 0;
+		return _mm_load_si128(reinterpret_cast<const __m128i*>(mask));
+	}
+
+	inline __m128i channelMask16(int channel)
+	{
+		alignas(16) uint16_t mask[8];
+		for (int i = 0; i < 8; i++)
+			mask[i] = (i % 3 == channel) ? 0xFFFF : 0;
+		return _mm_load_si128(reinterpret_cast<const __m128i*>(mask));
+	}
+
+	inline uint64_t horizontalSum64(__m128i v)
+	{
+		return static_cast<uint64_t>(_mm_cvtsi128_si32(v)) + static_cast<uint64_t>(_mm_cvtsi128_si32(_mm_srli_si128(v, 8)));
+	}
+
+	inline uint64_t horizontalSum32(__m128i v)
+	{
+		v = _mm_add_epi32(v, _mm_srli_si128(v, 8));
+		v = _mm_add_epi32(v, _mm_srli_si128(v, 4));
+		return static_cast<uint32_t>(_mm_cvtsi128_si32(v));
+	}
+
+	void sumSpan(const uint8_t* pixel, int count, uint64_t* sum)
+	{
+		static const __m128i mask[3] = { channelMask8(0), channelMask8(1), channelMask8(2) };
+		const __m128i zero = _mm_setzero_si128();
+		__m128i acc[3] = { zero, zero, zero };
+		int blocks = count / 16;
+
+		for (int b = 0; b < blocks; b++, pixel += 48)
+		{
+			__m128i v[3] = { _mm_loadu_si128(reinterpret_cast<const __m128i*>(pixel)),
+							 _mm_loadu_si128(reinterpret_cast<const __m128i*>(pixel + 16)),
+							 _mm_loadu_si128(reinterpret_cast<const __m128i*>(pixel + 32)) };
+
+			// the byte sums of the masked vector land in two 64-bit lanes
+			for (int c = 0; c < 3; c++)
+				for (int k = 0; k < 3; k++)
+					acc[c] = _mm_add_epi64(acc[c], _mm_sad_epu8(_mm_and_si128(v[k], mask[(c + 3 - k) % 3]), zero));
+		}
+
+		for (int c = 0; c < 3; c++)
+			sum[c] += horizontalSum64(acc[c]);
+
+		sumSpanScalar(pixel, count - blocks * 16, sum);
+	}
+
+	void sumSquaresSpan(const uint8_t* pixel, int count, uint64_t* sum)
+	{
+		static const __m128i mask[3] = { channelMask16(0), channelMask16(1), channelMask16(2) };
+		const __m128i zero = _mm_setzero_si128();
+		__m128i acc[3] = { zero, zero, zero };
+		int blocks = count / 16;
+
+		// a lane gets at most 2 * 255^2 per block, the shortest image row keeps the 32-bit lanes far from the overflow
+		for (int b = 0; b < blocks; b++, pixel += 48)
+		{
+			for (int k = 0; k < 3; k++)
+			{
+				__m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(pixel + k * 16));
+				const __m128i half[2] = { _mm_unpacklo_epi8(v, zero), _mm_unpackhi_epi8(v, zero) };
+
+				for (int h = 0; h < 2; h++)
+				{
+					// the first 16-bit lane of this half holds the byte k * 16 + h * 8
+					const int shift = (k * 16 + h * 8) % 3;
+
+					for (int c = 0; c < 3; c++)
+						acc[c] = _mm_add_epi32(acc[c], _mm_madd_epi16(half[h], _mm_and_si128(half[h], mask[(c + 3 - shift) % 3])));
+				}
+			}
+		}
+
+		for (int c = 0; c < 3; c++)
+			sum[c] += horizontalSum32(acc[c]);
+
+		sumSquaresSpanScalar(pixel, count - blocks * 16, sum);
+	}
+
+#elif defined(IMAGETOLEDS_NEON)
+
+	void sumSpan(const uint8_t* pixel, int count, uint64_t* sum)
+	{
+		uint32x4_t acc[3] = { vdupq_n_u32(0), vdupq_n_u32(0), vdupq_n_u32(0) };
+		int blocks = count / 16;
+
+		for (int b = 0; b < blocks; )
+		{
+			// a 16-bit lane takes 128 blocks before it could overflow
+			uint16x8_t part[3] = { vdupq_n_u16(0), vdupq_n_u16(0), vdupq_n_u16(0) };
+
+			for (int end = std::min(blocks, b + 128); b < end; b++, pixel += 48)
+			{
+				uint8x16x3_t rgb = vld3q_u8(pixel);
+				part[0] = vpadalq_u8(part[0], rgb.val[0]);
+				part[1] = vpadalq_u8(part[1], rgb.val[1]);
+				part[2] = vpadalq_u8(part[2], rgb.val[2]);
+			}
+
+			for (int c = 0; c < 3; c++)
+				acc[c] = vpadalq_u16(acc[c], part[c]);
+		}
+
+		for (int c = 0; c < 3; c++)
+		{
+			uint64x2_t wide = vpaddlq_u32(acc[c]);
+			sum[c] += vgetq_lane_u64(wide, 0) + vgetq_lane_u64(wide, 1);
+		}
+
+		sumSpanScalar(pixel, count - blocks * 16, sum);
+	}
+
+	void sumSquaresSpan(const uint8_t* pixel, int count, uint64_t* sum)
+	{
+		uint32x4_t acc[3] = { vdupq_n_u32(0), vdupq_n_u32(0), vdupq_n_u32(0) };
+		int blocks = count / 16;
+
+		for (int b = 0; b < blocks; b++, pixel += 48)
+		{
+			uint8x16x3_t rgb = vld3q_u8(pixel);
+
+			for (int c = 0; c < 3; c++)
+			{
+				acc[c] = vpadalq_u16(acc[c], vmull_u8(vget_low_u8(rgb.val[c]), vget_low_u8(rgb.val[c])));
+				acc[c] = vpadalq_u16(acc[c], vmull_u8(vget_high_u8(rgb.val[c]), vget_high_u8(rgb.val[c])));
+			}
+		}
+
+		for (int c = 0; c < 3; c++)
+		{
+			uint64x2_t wide = vpaddlq_u32(acc[c]);
+			sum[c] += vgetq_lane_u64(wide, 0) + vgetq_lane_u64(wide, 1);
+		}
+
+		sumSquaresSpanScalar(pixel, count - blocks * 16, sum);
+	}
+
+#else
+
+	void sumSpan(const uint8_t* pixel, int count, uint64_t* sum)
+	{
+		sumSpanScalar(pixel, count, sum);
+	}
+
+	void sumSquaresSpan(const uint8_t* pixel, int count, uint64_t* sum)
+	{
+		sumSquaresSpanScalar(pixel, count, sum);
+	}
+
+#endif
+
+	// xor-multiply chain in two lanes: every step is a bijection of the lane, so a single changed word always changes the hash
+	inline uint64_t hashBytes(const uint8_t* data, size_t length, uint64_t hash)
+	{
+		const uint64_t prime = 0x9E3779B97F4A7C15ULL;
+		uint64_t lane0 = hash, lane1 = ~hash;
+		size_t i = 0;
+
+		for (; i + 16 <= length; i += 16)
+		{
+			uint64_t a, b;
+			memcpy(&a, data + i, 8);
+			memcpy(&b, data + i + 8, 8);
+			lane0 = (lane0 ^ a) * prime;
+			lane1 = (lane1 ^ b) * prime;
+		}
+
+		if (i < length)
+		{
+			uint64_t a = 0, b = 0;
+			const size_t rest = length - i;
+			memcpy(&a, data + i, std::min(rest, static_cast<size_t>(8)));
+			if (rest > 8)
+				memcpy(&b, data + i + 8, rest - 8);
+			lane0 = (lane0 ^ a) * prime;
+			lane1 = (lane1 ^ b) * prime;
+		}
+
+		return lane0 ^ ((lane1 << 29) | (lane1 >> 35));
+	}
+
+	// one contiguous range of leds reduced on the shared thread pool, the ranges never overlap so the result doesn't depend on the scheduling
+	class LedChunkTask : public QRunnable
+	{
+	public:
+		LedChunkTask(const std::function<void(size_t, size_t)>& reduce, size_t begin, size_t end, QSemaphore* done)
+			: _reduce(reduce), _begin(begin), _end(end), _done(done)
+		{
+		}
+
+		void run() override
+		{
+			_reduce(_begin, _end);
+			_done->release();
+		}
+
+	private:
+		const std::function<void(size_t, size_t)>& _reduce;
+		size_t		_begin;
+		size_t		_end;
+		QSemaphore*	_done;
+	};
+
+	// the 'advanced' table of ImageProcessor holds the squares, the kernels compute them instead of the lookup
+	bool isSquareTable(const uint16_t* lut)
+	{
+		for (int i = 0; i < 256; i++)
+			if (lut[i] != i * i)
+				return false;
+		return true;
+	}
+}
+
 ImageToLedsMap::ImageToLedsMap(
 				Logger* _log,
 				const int mappingType,
 				const bool sparseProcessing,
+				const int parallelThreshold,
 				const unsigned width,
 				const unsigned height,
 				const unsigned horizontalBorder,
@@ -21,8 +296,26 @@ ImageToLedsMap::ImageToLedsMap(
 	, _verticalBorder(verticalBorder)
 	, _colorsMap()
 	, _colorsGroups()
+	, _stridedColorsMap()
+	, _stridedLineStride(0)
+	, _stridedPixelStride(0)
 	, _groupMin(-1)
 	, _groupMax(-1)
+	, _unusedArea()
+	, _integralStrips()
+	, _integralAreas()
+	, _gpuAreas()
+	, _chunks()
+	, _tileColumns(0)
+	, _tiles()
+	, _tileHashes()
+	, _tileChanged()
+	, _tilesValid(false)
+	, _ledTilesBegin()
+	, _ledTiles()
+	, _ledDirty()
+	, _previousColors()
+	, _memory(MemoryAccounting::LED_MAPPING)
 {
 	// Sanity check of the size of the borders (and width and height)
 	Q_ASSERT(_width > 2 * _verticalBorder);
@@ -32,6 +325,8 @@ ImageToLedsMap::ImageToLedsMap(
 
 	_mappingType = mappingType;
 
+	const bool integral = (ImageProcessor::mappingTypeToInt(QString("integral_mean")) == _mappingType);
+
 	// Reserve enough space in the map for the leds
 	_colorsMap.reserve(leds.size());
 
@@ -44,6 +339,13 @@ ImageToLedsMap::ImageToLedsMap(
 	size_t   totalCapasity = 0;
 	int      ledCounter = 0;
 
+	// bands along the edges that contain all the led areas
+	int32_t  scanTop = 0, scanBottom = _height, scanLeft = 0, scanRight = _width;
+
+	// the image rectangle [x0, y0, x1, y1) of each led for the change detection
+	std::vector<std::vector<int32_t>> ledRects;
+	ledRects.reserve(leds.size());
+
 	for (const Led& led : leds)
 	{
 		ledCounter++;
@@ -52,6 +354,9 @@ ImageToLedsMap::ImageToLedsMap(
 		if ((led.maxX_frac - led.minX_frac) < 1e-6 || (led.maxY_frac - led.minY_frac) < 1e-6)
 		{
 			_colorsMap.emplace_back();
+			ledRects.emplace_back();
+			if (integral)
+				_integralAreas.push_back({ -1, -1, 0, 0, 0, 0 });
 			continue;
 		}
 
@@ -79,6 +384,34 @@ ImageToLedsMap::ImageToLedsMap(
 		const int32_t realYLedCount = qAbs(maxYLedCount - minY_idx);
 		const int32_t realXLedCount = qAbs(maxXLedCount - minX_idx);
 
+		ledRects.push_back({ minX_idx, minY_idx, maxXLedCount, maxYLedCount });
+
+		// extend the band of the nearest edge so it covers the area
+		const double distances[4] = { led.minY_frac, 1.0 - led.maxY_frac, led.minX_frac, 1.0 - led.maxX_frac };
+		const int nearest = int(std::min_element(distances, distances + 4) - distances);
+
+		if (nearest == 0)
+			scanTop = qMax(scanTop, maxYLedCount);
+		else if (nearest == 1)
+			scanBottom = qMin(scanBottom, minY_idx);
+		else if (nearest == 2)
+			scanLeft = qMax(scanLeft, maxXLedCount);
+		else
+			scanRight = qMin(scanRight, minX_idx);
+
+		// the mean is read from the summed-area table, the indices are not needed
+		if (integral)
+		{
+			_integralAreas.push_back({ -1, nearest, minX_idx, minY_idx, maxXLedCount, maxYLedCount });
+			_colorsMap.emplace_back();
+			_colorsGroups.push_back(led.group);
+			if (_groupMin == -1 || led.group < _groupMin)
+				_groupMin = led.group;
+			if (_groupMax == -1 || led.group > _groupMax)
+				_groupMax = led.group;
+			continue;
+		}
+
 		bool   sparseIndexes = sparseProcessing;
 		size_t totalSize = static_cast<size_t>(realYLedCount) * realXLedCount;
 
@@ -90,8 +423,15 @@ ImageToLedsMap::ImageToLedsMap(
 
 		const int32_t increment = (sparseIndexes) ? 2 : 1;
 
-		std::vector<int32_t> ledColor;
-		ledColor.reserve((sparseIndexes) ? ((static_cast<unsigned long long>(realYLedCount / 2)) + (realYLedCount % 2)) * ((realXLedCount / 2) + (realXLedCount % 2)) : totalSize);
+		std::vector<ColorSpan> ledColor;
+		ledColor.reserve((static_cast<size_t>(realYLedCount) + increment - 1) / increment * 2);
+
+		// one span per row (two for the split rows of the weighted mode), the second half of the weighted edge leds is marked as low weight
+		auto addSpan = [&](int32_t y, int32_t xFrom, int32_t xTo, bool lowWeight) {
+			if (xTo > xFrom)
+				ledColor.push_back({ (y * int32_t(width) + xFrom) * 3, static_cast<uint16_t>((xTo - xFrom + increment - 1) / increment),
+									static_cast<uint16_t>(increment * 3), lowWeight });
+		};
 
 		if (ImageProcessor::mappingTypeToInt(QString("weighted")) == _mappingType)
 		{
@@ -105,70 +445,31 @@ ImageToLedsMap::ImageToLedsMap(
 			if (isCorner != 1)
 			{
 				for (int32_t y = minY_idx; y < maxYLedCount; y += increment)
-				{
-					for (int32_t x = minX_idx; x < maxXLedCount; x += increment)
-					{
-						push_back_index(ledColor, y * width + x);
-					}
-				}
+					addSpan(y, minX_idx, maxXLedCount, false);
 			}
-			else if (bottom)
+			else if (bottom || top)
 			{
 				int32_t mid = (minY_idx + maxYLedCount) / 2;
 				for (int32_t y = minY_idx; y < mid; y += increment)
-					for (int32_t x = minX_idx; x < maxXLedCount; x += increment)
-						push_back_index(ledColor, -((int32_t)(y * width + x)));
+					addSpan(y, minX_idx, maxXLedCount, bottom);
 
 				for (int32_t y = mid; y < maxYLedCount; y += increment)
-					for (int32_t x = minX_idx; x < maxXLedCount; x += increment)
-						push_back_index(ledColor, y * width + x);
-			}
-			else if (top)
-			{
-				int32_t mid = (minY_idx + maxYLedCount) / 2;
-				for (int32_t y = minY_idx; y < mid; y += increment)
-					for (int32_t x = minX_idx; x < maxXLedCount; x += increment)
-						push_back_index(ledColor, y * width + x);
-
-				for (int32_t y = mid; y < maxYLedCount; y += increment)
-					for (int32_t x = minX_idx; x < maxXLedCount; x += increment)
-						push_back_index(ledColor, -((int32_t)(y * width + x)));
-			}
-
-			else if (left)
-			{
-				int32_t mid = (minX_idx + maxXLedCount) / 2;
-				for (int32_t y = minY_idx; y < maxYLedCount; y += increment)
-				{
-					for (int32_t x = minX_idx; x < mid; x += increment)
-						push_back_index(ledColor, y * width + x);
-					for (int32_t x = mid; x < maxXLedCount; x += increment)
-						push_back_index(ledColor, -((int32_t)(y * width + x)));
-				}
+					addSpan(y, minX_idx, maxXLedCount, top);
 			}
-
-			else if (right)
+			else if (left || right)
 			{
 				int32_t mid = (minX_idx + maxXLedCount) / 2;
 				for (int32_t y = minY_idx; y < maxYLedCount; y += increment)
 				{
-					for (int32_t x = minX_idx; x < mid; x += increment)
-						push_back_index(ledColor, -((int32_t)(y * width + x)));
-					for (int32_t x = mid; x < maxXLedCount; x += increment)
-						push_back_index(ledColor, y * width + x);
+					addSpan(y, minX_idx, mid, right);
+					addSpan(y, mid, maxXLedCount, left);
 				}
 			}
-
 		}
 		else
 		{
 			for (int32_t y = minY_idx; y < maxYLedCount; y += increment)
-			{
-				for (int32_t x = minX_idx; x < maxXLedCount; x += increment)
-				{
-					push_back_index(ledColor, y * width + x);
-				}
-			}
+				addSpan(y, minX_idx, maxXLedCount, false);
 		}
 
 		// Add the constructed vector to the map
@@ -179,13 +480,246 @@ ImageToLedsMap::ImageToLedsMap(
 		if (_groupMax == -1 || led.group > _groupMax)
 			_groupMax = led.group;
 
-		totalCount += ledColor.size();
-		totalCapasity += ledColor.capacity();
+		for (const ColorSpan& span : ledColor)
+			totalCount += span.count;
+		totalCapasity += ledColor.capacity() * sizeof(ColorSpan);
+	}
+	if (ImageProcessor::mappingTypeToInt(QString("unicolor_mean")) != _mappingType && scanLeft < scanRight && scanTop < scanBottom)
+		_unusedArea = QRectF(double(scanLeft) / _width, double(scanTop) / _height,
+			double(scanRight - scanLeft) / _width, double(scanBottom - scanTop) / _height);
+
+	if (integral)
+	{
+		buildIntegralStrips(scanTop, scanBottom, scanLeft, scanRight);
+
+		_gpuAreas.reserve(_integralAreas.size() * 4);
+		for (const IntegralArea& area : _integralAreas)
+		{
+			const bool valid = (area.strip >= 0);
+			_gpuAreas.insert(_gpuAreas.end(), { (valid) ? area.x0 : 0, (valid) ? area.y0 : 0, (valid) ? area.x1 : 0, (valid) ? area.y1 : 0 });
+		}
+
+		size_t tableSize = 0;
+		for (const IntegralStrip& strip : _integralStrips)
+			tableSize += strip.table.size() * sizeof(uint32_t);
+
+		Info(_log, "Summed-area tables: %d (memory: %d), image size: %d x %d, area number: %d",
+			_integralStrips.size(), tableSize, width, height, leds.size());
+	}
+	else
+		Info(_log, "Total index number is: %d (memory: %d bytes). User sparse processing is: %s, image size: %d x %d, area number: %d",
+			totalCount, totalCapasity, (sparseProcessing) ? "enabled" : "disabled", width, height, leds.size());
+
+	buildTiles(ledRects);
+
+	const bool spanMapping = (_mappingType != 1 && !integral);
+
+	if (spanMapping && parallelThreshold > 0 && _colorsMap.size() >= static_cast<size_t>(parallelThreshold))
+	{
+		buildChunks(QThreadPool::globalInstance()->maxThreadCount());
+
+		if (_chunks.size() > 2)
+			Info(_log, "The led colors are computed in %d parallel chunks (threshold: %d leds)", _chunks.size() - 1, parallelThreshold);
+	}
+
+	_memory.set(memoryUsage());
+}
+
+void ImageToLedsMap::buildChunks(int threads)
+{
+	// at least a few dozen leds per chunk, otherwise the hand-off costs more than the reduction
+	const size_t leds = _colorsMap.size();
+	const size_t chunks = std::min(static_cast<size_t>(std::max(threads, 1)), std::max(leds / 32, static_cast<size_t>(1)));
+
+	_chunks.clear();
+	if (chunks < 2)
+		return;
+
+	// the cost of a led is the number of its pixels plus the setup of every span
+	std::vector<uint64_t> cost(leds, 0);
+	uint64_t totalCost = 0;
+
+	for (size_t i = 0; i < leds; i++)
+	{
+		for (const ColorSpan& span : _colorsMap[i])
+			cost[i] += span.count + 4;
+		totalCost += cost[i];
+	}
+
+	// contiguous ranges of about the same cost
+	_chunks.push_back(0);
+
+	uint64_t current = 0;
+	for (size_t i = 0; i < leds && _chunks.size() < chunks; i++)
+	{
+		current += cost[i];
+		if (current * chunks >= totalCost * _chunks.size() && i + 1 < leds)
+			_chunks.push_back(i + 1);
+	}
+
+	_chunks.push_back(leds);
+}
+
+void ImageToLedsMap::buildTiles(const std::vector<std::vector<int32_t>>& ledRects)
+{
+	const int32_t tile = TILE_SIZE;
+	const int32_t columns = (static_cast<int32_t>(_width) + tile - 1) / tile;
+	const int32_t rows = (static_cast<int32_t>(_height) + tile - 1) / tile;
+	const bool unicolor = (_mappingType == 1);
+
+	_tileColumns = columns;
+
+	// the tiles that at least one led area touches: the whole image for the unicolor mapping
+	std::vector<int32_t> position(static_cast<size_t>(columns) * rows, -1);
+
+	if (unicolor)
+	{
+		for (int32_t i = 0; i < columns * rows; i++)
+			position[i] = 1;
+	}
+	else
+	{
+		for (const auto& rect : ledRects)
+			if (!rect.empty() && rect[2] > rect[0] && rect[3] > rect[1])
+				for (int32_t ty = rect[1] / tile; ty <= (rect[3] - 1) / tile; ty++)
+					for (int32_t tx = rect[0] / tile; tx <= (rect[2] - 1) / tile; tx++)
+						position[ty * columns + tx] = 1;
+	}
+
+	_tiles.clear();
+	for (int32_t i = 0; i < columns * rows; i++)
+		if (position[i] >= 0)
+		{
+			position[i] = static_cast<int32_t>(_tiles.size());
+			_tiles.push_back(i);
+		}
+
+	_tileHashes.assign(_tiles.size(), 0);
+	_tileChanged.assign(_tiles.size(), 1);
+	_tilesValid = false;
+
+	// per led list of the covering tiles, the unicolor leds always share the whole image
+	_ledTilesBegin.clear();
+	_ledTiles.clear();
+
+	if (!unicolor)
+	{
+		_ledTilesBegin.reserve(ledRects.size() + 1);
+		for (const auto& rect : ledRects)
+		{
+			_ledTilesBegin.push_back(static_cast<uint32_t>(_ledTiles.size()));
+
+			if (!rect.empty() && rect[2] > rect[0] && rect[3] > rect[1])
+				for (int32_t ty = rect[1] / tile; ty <= (rect[3] - 1) / tile; ty++)
+					for (int32_t tx = rect[0] / tile; tx <= (rect[2] - 1) / tile; tx++)
+						_ledTiles.push_back(static_cast<uint32_t>(position[ty * columns + tx]));
+		}
+		_ledTilesBegin.push_back(static_cast<uint32_t>(_ledTiles.size()));
+	}
+}
+
+size_t ImageToLedsMap::hashTiles(const ImageView<ColorRgb>& image)
+{
+	const unsigned pixelStride = image.pixelStride();
+	size_t changed = 0;
+
+	for (size_t k = 0; k < _tiles.size(); k++)
+	{
+		const unsigned x0 = (_tiles[k] % _tileColumns) * TILE_SIZE;
+		const unsigned y0 = (_tiles[k] / _tileColumns) * TILE_SIZE;
+		const unsigned x1 = std::min(x0 + TILE_SIZE, _width);
+		const unsigned y1 = std::min(y0 + TILE_SIZE, _height);
+		const size_t length = static_cast<size_t>(x1 - x0) * pixelStride;
+		uint64_t hash = _tiles[k];
+
+		for (unsigned y = y0; y < y1; y++)
+			hash = hashBytes(image.row(y) + static_cast<size_t>(x0) * pixelStride, length, hash);
+
+		_tileChanged[k] = (hash != _tileHashes[k] || !_tilesValid) ? 1 : 0;
+		_tileHashes[k] = hash;
+		changed += _tileChanged[k];
+	}
+
+	_tilesValid = true;
+
+	return changed;
+}
+
+void ImageToLedsMap::reduceLeds(const std::function<void(size_t, size_t)>& reduce) const
+{
+	if (_chunks.size() <= 2)
+	{
+		reduce(0, _colorsMap.size());
+		return;
+	}
+
+	QThreadPool* pool = QThreadPool::globalInstance();
+	QSemaphore done;
+	int started = 0;
+
+	// the first range stays on the calling thread, a range that finds no free worker is reduced here too
+	for (size_t k = 1; k + 1 < _chunks.size(); k++)
+	{
+		LedChunkTask* task = new LedChunkTask(reduce, _chunks[k], _chunks[k + 1], &done);
+
+		if (pool->tryStart(task))
+			started++;
+		else
+		{
+			reduce(_chunks[k], _chunks[k + 1]);
+			delete task;
+		}
+	}
+
+	reduce(_chunks[0], _chunks[1]);
+
+	done.acquire(started);
+}
+
+void ImageToLedsMap::buildIntegralStrips(int32_t scanTop, int32_t scanBottom, int32_t scanLeft, int32_t scanRight)
+{
+	const int32_t width = _width;
+	const int32_t height = _height;
+
+	// one band per edge: full width for the top and bottom, full height for the sides, so every area lies inside its band
+	int32_t bands[4][4] = {
+		{ 0, 0, width, scanTop },
+		{ 0, scanBottom, width, height },
+		{ 0, 0, scanLeft, height },
+		{ scanRight, 0, width, height }
+	};
+	int bandStrip[4] = { -1, -1, -1, -1 };
+
+	// the layout covers the centre too: a single table for the whole image
+	const bool single = (scanLeft >= scanRight || scanTop >= scanBottom);
+
+	for (IntegralArea& area : _integralAreas)
+	{
+		if (area.edge < 0)
+			continue;
+
+		const int band = (single) ? 0 : area.edge;
+
+		if (bandStrip[band] < 0)
+		{
+			IntegralStrip strip;
+
+			if (single)
+				strip = { 0, 0, width, height, {} };
+			else
+				strip = { bands[band][0], bands[band][1], bands[band][2], bands[band][3], {} };
+
+			strip.table.resize(static_cast<size_t>(strip.x1 - strip.x0 + 1) * (strip.y1 - strip.y0 + 1) * 3, 0);
+
+			bandStrip[band] = static_cast<int>(_integralStrips.size());
+			_integralStrips.push_back(std::move(strip));
+		}
+
+		area.strip = bandStrip[band];
 	}
-	Info(_log, "Total index number is: %d (memory: %d). User sparse processing is: %s, image size: %d x %d, area number: %d",
-		totalCount, totalCapasity, (sparseProcessing) ? "enabled" : "disabled", width, height, leds.size());
 }
 
+
 unsigned ImageToLedsMap::width() const
 {
 	return _width;
@@ -206,15 +740,104 @@ unsigned ImageToLedsMap::verticalBorder() const {
 	return _verticalBorder;
 }
 
-std::vector<ColorRgb> ImageToLedsMap::Process(const Image<ColorRgb>& image, uint16_t* advanced)
+QRectF ImageToLedsMap::getUnusedArea() const
+{
+	return _unusedArea;
+}
+
+size_t ImageToLedsMap::memoryUsage() const
+{
+	size_t memory = sizeof(ImageToLedsMap);
+
+	for (const auto& map : { &_colorsMap, &_stridedColorsMap })
+	{
+		memory += map->capacity() * sizeof(std::vector<ColorSpan>);
+		for (const auto& colors : *map)
+			memory += colors.capacity() * sizeof(ColorSpan);
+	}
+
+	for (const IntegralStrip& strip : _integralStrips)
+		memory += strip.table.capacity() * sizeof(uint32_t);
+
+	memory += _integralAreas.capacity() * sizeof(IntegralArea) + _gpuAreas.capacity() * sizeof(int32_t) + _colorsGroups.capacity() * sizeof(int) +
+		_chunks.capacity() * sizeof(size_t) + _tiles.capacity() * sizeof(uint32_t) + _tileHashes.capacity() * sizeof(uint64_t) +
+		_tileChanged.capacity() + _ledTilesBegin.capacity() * sizeof(uint32_t) + _ledTiles.capacity() * sizeof(uint32_t) +
+		_ledDirty.capacity() + _previousColors.capacity() * sizeof(ColorRgb);
+
+	return memory;
+}
+
+const std::vector<std::vector<ImageToLedsMap::ColorSpan>>& ImageToLedsMap::getColorsMap(const ImageView<ColorRgb>& image)
+{
+	if (image.isPacked())
+		return _colorsMap;
+
+	if (_stridedLineStride == image.lineStride() && _stridedPixelStride == image.pixelStride())
+		return _stridedColorsMap;
+
+	// the packed indices are relative to the first row, the strided ones to the lowest address of the view
+	const int64_t packedLine = static_cast<int64_t>(_width) * 3;
+	const int64_t baseShift = image.rawMem() - image.memoryBase();
+
+	_stridedColorsMap = _colorsMap;
+	_stridedLineStride = image.lineStride();
+	_stridedPixelStride = image.pixelStride();
+
+	for (auto& colors : _stridedColorsMap)
+		for (auto& span : colors)
+		{
+			const int64_t offset = span.offset;
+			const int64_t strided = (offset / packedLine) * _stridedLineStride + ((offset % packedLine) / 3) * _stridedPixelStride + baseShift;
+			span.offset = static_cast<int32_t>(strided);
+			span.step = static_cast<uint16_t>((span.step / 3) * _stridedPixelStride);
+		}
+
+	_memory.set(memoryUsage());
+
+	return _stridedColorsMap;
+}
+
+std::vector<ColorRgb> ImageToLedsMap::Process(const ImageView<ColorRgb>& image, uint16_t* advanced, bool reuse, bool& unchanged, const FrameContext* context, GpuLedReducer* gpu)
 {
 	std::vector<ColorRgb> colors;
-	switch (_mappingType)
+	const uint8_t* dirty = nullptr;
+
+	// the tile hashes are always updated so the next frame can be compared with this one
+	const bool previous = _tilesValid && _previousColors.size() == _colorsMap.size();
+	const size_t changedTiles = hashTiles(image);
+
+	unchanged = (previous && changedTiles == 0);
+
+	if (unchanged && reuse)
 	{
-		case 3:
-		case 2: colors = getMeanAdvLedColor(image, advanced); break;
-		case 1: colors = getUniLedColor(image); break;
-		default: colors = getMeanLedColor(image);
+		colors = _previousColors;
+	}
+	else
+	{
+		// only the leds whose tiles changed are reduced again
+		if (reuse && previous && !_ledTilesBegin.empty())
+		{
+			_ledDirty.assign(_colorsMap.size(), 0);
+			for (size_t i = 0; i < _colorsMap.size(); i++)
+				for (uint32_t t = _ledTilesBegin[i]; t < _ledTilesBegin[i + 1] && !_ledDirty[i]; t++)
+					_ledDirty[i] = _tileChanged[_ledTiles[t]];
+			dirty = _ledDirty.data();
+		}
+
+		switch (_mappingType)
+		{
+			case 3:
+			case 2: colors = getMeanAdvLedColor(image.memoryBase(), getColorsMap(image), advanced, dirty); break;
+			case 1: colors = getUniLedColor(image); break;
+			case 4:
+				if (gpu == nullptr || image.width() != _width || image.height() != _height || !gpu->reduce(image, _gpuAreas, colors))
+					colors = getIntegralLedColor(image, context);
+				break;
+			case 5: colors = getDominantLedColor(image.memoryBase(), getColorsMap(image), dirty); break;
+			default: colors = getMeanLedColor(image.memoryBase(), getColorsMap(image), dirty);
+		}
+
+		_previousColors = colors;
 	}
 
 	if (_groupMax > 0 && _mappingType != 1)
@@ -254,9 +877,9 @@ std::vector<ColorRgb> ImageToLedsMap::Process(const Image<ColorRgb>& image, uint
 	return colors;
 }
 
-std::vector<ColorRgb> ImageToLedsMap::getMeanLedColor(const Image<ColorRgb>& image) const
+std::vector<ColorRgb> ImageToLedsMap::getMeanLedColor(const uint8_t* imgData, const std::vector<std::vector<ImageToLedsMap::ColorSpan>>& colorsMap, const uint8_t* dirty) const
 {
-	std::vector<ColorRgb> ledColors(_colorsMap.size(), ColorRgb{ 0,0,0 });
+	std::vector<ColorRgb> ledColors(colorsMap.size(), ColorRgb{ 0,0,0 });
 
 	// Sanity check for the number of leds
 	//assert(_colorsMap.size() == ledColors.size());
@@ -267,17 +890,15 @@ std::vector<ColorRgb> ImageToLedsMap::getMeanLedColor(const Image<ColorRgb>& ima
 	}
 
 	// Iterate each led and compute the mean
-	auto led = ledColors.begin();
-	for (auto colors = _colorsMap.begin(); colors != _colorsMap.end(); ++colors, ++led)
-	{
-		const ColorRgb color = calcMeanColor(image, *colors);
-		*led = color;
-	}
+	reduceLeds([&](size_t begin, size_t end) {
+		for (size_t i = begin; i < end; i++)
+			ledColors[i] = (dirty == nullptr || dirty[i]) ? calcMeanColor(imgData, colorsMap[i]) : _previousColors[i];
+	});
 
 	return ledColors;
 }
 
-std::vector<ColorRgb> ImageToLedsMap::getUniLedColor(const Image<ColorRgb>& image) const
+std::vector<ColorRgb> ImageToLedsMap::getUniLedColor(const ImageView<ColorRgb>& image) const
 {
 	std::vector<ColorRgb> ledColors(_colorsMap.size(), ColorRgb{ 0,0,0 });
 
@@ -297,9 +918,9 @@ std::vector<ColorRgb> ImageToLedsMap::getUniLedColor(const Image<ColorRgb>& imag
 }
 
 
-std::vector<ColorRgb> ImageToLedsMap::getMeanAdvLedColor(const Image<ColorRgb>& image, uint16_t* lut) const
+std::vector<ColorRgb> ImageToLedsMap::getMeanAdvLedColor(const uint8_t* imgData, const std::vector<std::vector<ImageToLedsMap::ColorSpan>>& colorsMap, uint16_t* lut, const uint8_t* dirty) const
 {
-	std::vector<ColorRgb> ledColors(_colorsMap.size(), ColorRgb{ 0,0,0 });
+	std::vector<ColorRgb> ledColors(colorsMap.size(), ColorRgb{ 0,0,0 });
 
 	// Sanity check for the number of leds
 	//assert(_colorsMap.size() == ledColors.size());
@@ -309,57 +930,212 @@ std::vector<ColorRgb> ImageToLedsMap::getMeanAdvLedColor(const Image<ColorRgb>&
 		return ledColors;
 	}
 
+	const bool squares = isSquareTable(lut);
+
 	// Iterate each led and compute the mean
-	auto led = ledColors.begin();
-	for (auto colors = _colorsMap.begin(); colors != _colorsMap.end(); ++colors, ++led)
+	reduceLeds([&](size_t begin, size_t end) {
+		for (size_t i = begin; i < end; i++)
+			ledColors[i] = (dirty == nullptr || dirty[i]) ? calcMeanAdvColor(imgData, colorsMap[i], lut, squares) : _previousColors[i];
+	});
+
+	return ledColors;
+}
+
+std::vector<ColorRgb> ImageToLedsMap::getDominantLedColor(const uint8_t* imgData, const std::vector<std::vector<ImageToLedsMap::ColorSpan>>& colorsMap, const uint8_t* dirty) const
+{
+	std::vector<ColorRgb> ledColors(colorsMap.size(), ColorRgb{ 0,0,0 });
+
+	// Sanity check for the number of leds
+	if (_colorsMap.size() != ledColors.size())
 	{
-		const ColorRgb color = calcMeanAdvColor(image, *colors, lut);
-		*led = color;
+		Debug(Logger::getInstance("HYPERHDR"), "ImageToLedsMap: colorsMap.size != ledColors.size -> %d != %d", _colorsMap.size(), ledColors.size());
+		return ledColors;
 	}
 
+	// Iterate each led and compute the dominant color
+	reduceLeds([&](size_t begin, size_t end) {
+		for (size_t i = begin; i < end; i++)
+			ledColors[i] = (dirty == nullptr || dirty[i]) ? calcDominantColor(imgData, colorsMap[i]) : _previousColors[i];
+	});
+
 	return ledColors;
 }
 
-ColorRgb ImageToLedsMap::calcMeanColor(const Image<ColorRgb>& image, const std::vector<int32_t>& colors) const
+std::vector<ColorRgb> ImageToLedsMap::getIntegralLedColor(const ImageView<ColorRgb>& image, const FrameContext* context)
 {
-	const auto colorVecSize = colors.size();
+	std::vector<ColorRgb> ledColors(_integralAreas.size(), ColorRgb{ 0,0,0 });
 
-	if (colorVecSize == 0)
+	if (image.width() != _width || image.height() != _height)
+		return ledColors;
+
+	// several instances read the same frame: one table of the whole frame for all of them
+	if (context != nullptr && context->isShared() && image.isPacked() &&
+		context->image().width() == _width && context->image().height() == _height)
 	{
-		return ColorRgb::BLACK;
+		const std::vector<uint32_t>& table = context->getIntegralImage();
+		const size_t tableLine = static_cast<size_t>(_width + 1) * 3;
+
+		auto led = ledColors.begin();
+		for (const IntegralArea& area : _integralAreas)
+		{
+			if (area.strip >= 0 && area.x1 > area.x0 && area.y1 > area.y0)
+			{
+				const uint32_t* top = table.data() + static_cast<size_t>(area.y0) * tableLine;
+				const uint32_t* bottom = table.data() + static_cast<size_t>(area.y1) * tableLine;
+				const size_t left = static_cast<size_t>(area.x0) * 3;
+				const size_t right = static_cast<size_t>(area.x1) * 3;
+				const uint32_t count = static_cast<uint32_t>(area.x1 - area.x0) * static_cast<uint32_t>(area.y1 - area.y0);
+
+				led->red = uint8_t((bottom[right] - bottom[left] - top[right] + top[left]) / count);
+				led->green = uint8_t((bottom[right + 1] - bottom[left + 1] - top[right + 1] + top[left + 1]) / count);
+				led->blue = uint8_t((bottom[right + 2] - bottom[left + 2] - top[right + 2] + top[left + 2]) / count);
+			}
+			++led;
+		}
+
+		return ledColors;
+	}
+
+	// the first row and column of the table stay zero
+	for (IntegralStrip& strip : _integralStrips)
+	{
+		const size_t tableLine = static_cast<size_t>(strip.x1 - strip.x0 + 1) * 3;
+		const unsigned pixelStride = image.pixelStride();
+
+		for (int32_t y = strip.y0; y < strip.y1; y++)
+		{
+			const uint8_t* source = image.row(y) + static_cast<size_t>(strip.x0) * pixelStride;
+			const uint32_t* above = strip.table.data() + static_cast<size_t>(y - strip.y0) * tableLine + 3;
+			uint32_t* current = strip.table.data() + static_cast<size_t>(y - strip.y0 + 1) * tableLine + 3;
+			uint32_t sumRed = 0, sumGreen = 0, sumBlue = 0;
+
+			for (int32_t x = strip.x0; x < strip.x1; x++, source += pixelStride, above += 3, current += 3)
+			{
+				sumRed += source[0];
+				sumGreen += source[1];
+				sumBlue += source[2];
+
+				current[0] = above[0] + sumRed;
+				current[1] = above[1] + sumGreen;
+				current[2] = above[2] + sumBlue;
+			}
+		}
 	}
 
+	auto led = ledColors.begin();
+	for (const IntegralArea& area : _integralAreas)
+	{
+		if (area.strip >= 0 && area.x1 > area.x0 && area.y1 > area.y0)
+		{
+			const IntegralStrip& strip = _integralStrips[area.strip];
+			const size_t tableLine = static_cast<size_t>(strip.x1 - strip.x0 + 1) * 3;
+			const uint32_t* top = strip.table.data() + static_cast<size_t>(area.y0 - strip.y0) * tableLine;
+			const uint32_t* bottom = strip.table.data() + static_cast<size_t>(area.y1 - strip.y0) * tableLine;
+			const size_t left = static_cast<size_t>(area.x0 - strip.x0) * 3;
+			const size_t right = static_cast<size_t>(area.x1 - strip.x0) * 3;
+			const uint32_t count = static_cast<uint32_t>(area.x1 - area.x0) * static_cast<uint32_t>(area.y1 - area.y0);
+
+			// the unsigned wrap-around cancels out in the sum of the four corners
+			led->red = uint8_t((bottom[right] - bottom[left] - top[right] + top[left]) / count);
+			led->green = uint8_t((bottom[right + 1] - bottom[left + 1] - top[right + 1] + top[left + 1]) / count);
+			led->blue = uint8_t((bottom[right + 2] - bottom[left + 2] - top[right + 2] + top[left + 2]) / count);
+		}
+		++led;
+	}
+
+	return ledColors;
+}
+
+ColorRgb ImageToLedsMap::calcMeanColor(const uint8_t* imgData, const std::vector<ColorSpan>& colors) const
+{
 	// Accumulate the sum of each separate color channel
-	uint_fast32_t sumRed = 0;
-	uint_fast32_t sumGreen = 0;
-	uint_fast32_t sumBlue = 0;
-	const uint8_t* imgData = image.rawMem();
+	uint64_t sum[3] = { 0, 0, 0 };
+	size_t colorVecSize = 0;
+
+	for (const ColorSpan& span : colors)
+	{
+		const uint8_t* pixel = imgData + span.offset;
+		const size_t step = span.step;
 
-	for (const unsigned colorOffset : colors)
+		if (step == 3)
+		{
+			sumSpan(pixel, span.count, sum);
+		}
+		else
+		{
+			uint_fast32_t red = 0, green = 0, blue = 0;
+
+			for (unsigned i = 0; i < span.count; i++, pixel += step)
+			{
+				red += pixel[0];
+				green += pixel[1];
+				blue += pixel[2];
+			}
+
+			sum[0] += red;
+			sum[1] += green;
+			sum[2] += blue;
+		}
+
+		colorVecSize += span.count;
+	}
+
+	if (colorVecSize == 0)
 	{
-		sumRed += imgData[colorOffset];
-		sumGreen += imgData[colorOffset + 1];
-		sumBlue += imgData[colorOffset + 2];
+		return ColorRgb::BLACK;
 	}
 
 	// Compute the average of each color channel
-	const uint8_t avgRed = uint8_t(sumRed / colorVecSize);
-	const uint8_t avgGreen = uint8_t(sumGreen / colorVecSize);
-	const uint8_t avgBlue = uint8_t(sumBlue / colorVecSize);
+	const uint8_t avgRed = uint8_t(sum[0] / colorVecSize);
+	const uint8_t avgGreen = uint8_t(sum[1] / colorVecSize);
+	const uint8_t avgBlue = uint8_t(sum[2] / colorVecSize);
 
 	// Return the computed color
 	return { avgRed, avgGreen, avgBlue };
 }
 
-ColorRgb ImageToLedsMap::calcMeanAdvColor(const Image<ColorRgb>& image, const std::vector<int32_t>& colors, uint16_t* lut) const
+ColorRgb ImageToLedsMap::calcDominantColor(const uint8_t* imgData, const std::vector<ColorSpan>& colors) const
 {
-	const auto colorVecSize = colors.size();
+	// the two top bits of each channel select the bin, beside the count every bin keeps its channel sums for the final mean
+	constexpr unsigned bins = 4 * 4 * 4;
+	uint32_t histogram[bins][4];
 
-	if (colorVecSize == 0)
+	memset(histogram, 0, sizeof(histogram));
+
+	for (const ColorSpan& span : colors)
+	{
+		const uint8_t* pixel = imgData + span.offset;
+		const size_t step = span.step;
+
+		for (unsigned i = 0; i < span.count; i++, pixel += step)
+		{
+			uint32_t* bin = histogram[((pixel[0] >> 6) << 4) | ((pixel[1] >> 6) << 2) | (pixel[2] >> 6)];
+
+			bin[0] += pixel[0];
+			bin[1] += pixel[1];
+			bin[2] += pixel[2];
+			bin[3]++;
+		}
+	}
+
+	// the first bin wins a tie, so a dark area stays dark
+	unsigned dominant = 0;
+	for (unsigned i = 1; i < bins; i++)
+		if (histogram[i][3] > histogram[dominant][3])
+			dominant = i;
+
+	const uint32_t count = histogram[dominant][3];
+
+	if (count == 0)
 	{
 		return ColorRgb::BLACK;
 	}
 
+	return { uint8_t(histogram[dominant][0] / count), uint8_t(histogram[dominant][1] / count), uint8_t(histogram[dominant][2] / count) };
+}
+
+ColorRgb ImageToLedsMap::calcMeanAdvColor(const uint8_t* imgData, const std::vector<ColorSpan>& colors, uint16_t* lut, bool squares) const
+{
 	// Accumulate the sum of each seperate color channel
 	uint_fast64_t sum1 = 0;
 	uint_fast64_t sumRed1 = 0;
@@ -371,24 +1147,49 @@ ColorRgb ImageToLedsMap::calcMeanAdvColor(const Image<ColorRgb>& image, const st
 	uint_fast64_t sumGreen2 = 0;
 	uint_fast64_t sumBlue2 = 0;
 
-	const uint8_t* imgData = image.rawMem();
-
-	for (const int32_t colorOffset : colors)
+	for (const ColorSpan& span : colors)
 	{
-		if (colorOffset >= 0) {
-			sumRed1 += lut[imgData[colorOffset]];
-			sumGreen1 += lut[imgData[colorOffset + 1]];
-			sumBlue1 += lut[imgData[colorOffset + 2]];
-			sum1++;
+		const uint8_t* pixel = imgData + span.offset;
+		const size_t step = span.step;
+		uint_fast64_t red = 0, green = 0, blue = 0;
+
+		if (squares && step == 3)
+		{
+			uint64_t sum[3] = { 0, 0, 0 };
+			sumSquaresSpan(pixel, span.count, sum);
+			red = sum[0];
+			green = sum[1];
+			blue = sum[2];
+		}
+		else
+		{
+			for (unsigned i = 0; i < span.count; i++, pixel += step)
+			{
+				red += lut[pixel[0]];
+				green += lut[pixel[1]];
+				blue += lut[pixel[2]];
+			}
+		}
+
+		if (!span.lowWeight) {
+			sumRed1 += red;
+			sumGreen1 += green;
+			sumBlue1 += blue;
+			sum1 += span.count;
 		}
 		else {
-			sumRed2 += lut[imgData[(-colorOffset)]];
-			sumGreen2 += lut[imgData[(-colorOffset) + 1]];
-			sumBlue2 += lut[imgData[(-colorOffset) + 2]];
-			sum2++;
+			sumRed2 += red;
+			sumGreen2 += green;
+			sumBlue2 += blue;
+			sum2 += span.count;
 		}
 	}
 
+	if (sum1 + sum2 == 0)
+	{
+		return ColorRgb::BLACK;
+	}
+
 
 	if (sum1 > 0 && sum2 > 0)
 	{
@@ -408,27 +1209,34 @@ ColorRgb ImageToLedsMap::calcMeanAdvColor(const Image<ColorRgb>& image, const st
 	}
 }
 
-ColorRgb ImageToLedsMap::calcMeanColor(const Image<ColorRgb>& image) const
+ColorRgb ImageToLedsMap::calcMeanColor(const ImageView<ColorRgb>& image) const
 {
 	// Accumulate the sum of each separate color channel
 	uint_fast32_t sumRed = 0;
 	uint_fast32_t sumGreen = 0;
 	uint_fast32_t sumBlue = 0;
-	const size_t imageSize = image.size();
+	const size_t pixelCount = static_cast<size_t>(image.width()) * image.height();
+	const size_t lineSize = static_cast<size_t>(image.width()) * image.pixelStride();
 
-	const uint8_t* imgData = image.rawMem();
+	if (pixelCount == 0)
+		return ColorRgb::BLACK;
 
-	for (size_t idx = 0; idx < imageSize; idx += 3)
+	for (unsigned y = 0; y < image.height(); y++)
 	{
-		sumRed += imgData[idx];
-		sumGreen += imgData[idx + 1];
-		sumBlue += imgData[idx + 2];
+		const uint8_t* imgData = image.row(y);
+
+		for (size_t idx = 0; idx < lineSize; idx += image.pixelStride())
+		{
+			sumRed += imgData[idx];
+			sumGreen += imgData[idx + 1];
+			sumBlue += imgData[idx + 2];
+		}
 	}
 
 	// Compute the average of each color channel
-	const uint8_t avgRed = uint8_t(sumRed / (imageSize/3));
-	const uint8_t avgGreen = uint8_t(sumGreen / (imageSize/3));
-	const uint8_t avgBlue = uint8_t(sumBlue / (imageSize/3));
+	const uint8_t avgRed = uint8_t(sumRed / pixelCount);
+	const uint8_t avgGreen = uint8_t(sumGreen / pixelCount);
+	const uint8_t avgBlue = uint8_t(sumBlue / pixelCount);
 
 	// Return the computed color
 	return { avgRed, avgGreen, avgBlue };
@@ -0,0 +1,126 @@
+/* LedColorPipeline.cpp
+*
+*  MIT License
+*
+*  Copyright (c) 2023 awawa-dev
+*
+*  Project homesite: https://github.com/awawa-dev/HyperHDR
+*
+*  Permission is hereby granted, free of charge, to any person obtaining a copy
+*  of this software and associated documentation files (the "Software"), to deal
+*  in the Software without restriction, including without limitation the rights
+*  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+*  copies of the Software, and to permit persons to whom the Software is
+*  furnished to do so, subject to the following conditions:
+*
+*  The above copyright notice and this permission notice shall be included in all
+*  copies or substantial portions of the Software.
+
+*  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+*  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+*  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+*  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+*  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+*  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+*  SOFTWARE.
+ */
+
+#include <algorithm>
+#include <cstring>
+
+#include <base/LedColorPipeline.h>
+
+LedColorPipeline::LedColorPipeline()
+	: _colorOrder(ColorOrder::ORDER_RGB),
+	_hasDisabled(false)
+{
+}
+
+void LedColorPipeline::configure(const LedString& ledString)
+{
+	_colorOrder = ledString.colorOrder;
+	_hasDisabled = ledString.hasDisabled;
+
+	_mask.clear();
+
+	if (_hasDisabled)
+	{
+		_mask.reserve(ledString.leds().size() * 3);
+
+		for (const Led& led : ledString.leds())
+		{
+			const uint8_t value = (led.disabled) ? 0x00 : 0xFF;
+			_mask.insert(_mask.end(), 3, value);
+		}
+	}
+}
+
+bool LedColorPipeline::hasDisabled() const
+{
+	return _hasDisabled;
+}
+
+void LedColorPipeline::maskDisabled(std::vector<ColorRgb>& colors) const
+{
+	if (!_hasDisabled)
+		return;
+
+	// the leds outside the layout are left as they are
+	const size_t length = std::min(_mask.size(), colors.size() * 3);
+	uint8_t* data = reinterpret_cast<uint8_t*>(colors.data());
+	const uint8_t* mask = _mask.data();
+
+	size_t i = 0;
+
+	// 8 channels at once, also without the auto vectorization
+	for (; i + sizeof(uint64_t) <= length; i += sizeof(uint64_t))
+	{
+		uint64_t value, valueMask;
+		memcpy(&value, data + i, sizeof(value));
+		memcpy(&valueMask, mask + i, sizeof(valueMask));
+		value &= valueMask;
+		memcpy(data + i, &value, sizeof(value));
+	}
+
+	for (; i < length; i++)
+		data[i] &= mask[i];
+}
+
+template<int R, int G, int B>
+void LedColorPipeline::permute(ColorRgb* colors, size_t count)
+{
+	uint8_t* data = reinterpret_cast<uint8_t*>(colors);
+
+	for (size_t i = 0; i < count * 3; i += 3)
+	{
+		const uint8_t red = data[i + R], green = data[i + G], blue = data[i + B];
+
+		data[i] = red;
+		data[i + 1] = green;
+		data[i + 2] = blue;
+	}
+}
+
+void LedColorPipeline::applyColorOrder(std::vector<ColorRgb>& colors) const
+{
+	switch (_colorOrder)
+	{
+		case ColorOrder::ORDER_RGB:
+			break;
+		case ColorOrder::ORDER_BGR:
+			permute<2, 1, 0>(colors.data(), colors.size());
+			break;
+		case ColorOrder::ORDER_RBG:
+			permute<0, 2, 1>(colors.data(), colors.size());
+			break;
+		case ColorOrder::ORDER_GRB:
+			permute<1, 0, 2>(colors.data(), colors.size());
+			break;
+		case ColorOrder::ORDER_GBR:
+			permute<1, 2, 0>(colors.data(), colors.size());
+			break;
+		case ColorOrder::ORDER_BRG:
+			permute<2, 0, 1>(colors.data(), colors.size());
+			break;
+	}
+}
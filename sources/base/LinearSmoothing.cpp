@@ -1,9 +1,11 @@
 // Qt includes
-#include <QTimer>
 #include <QThread>
 
 #include <base/LinearSmoothing.h>
 #include <base/HyperHdrInstance.h>
+#include <utils/PreciseTimer.h>
+#include <utils/PerformanceCounters.h>
+#include <utils/EventTracer.h>
 
 #include <cmath>
 #include <stdint.h>
@@ -14,7 +16,11 @@ using namespace hyperhdr;
 const int64_t  DEFAUL_SETTLINGTIME		= 200;   // settlingtime in ms
 const double   DEFAUL_UPDATEFREQUENCY	= 25;    // updatefrequncy in hz
 const double   MINIMAL_UPDATEFREQUENCY	= 20;
+const double   DEFAUL_PREDICTIONALPHA	= 0.5;
+const double   DEFAUL_PREDICTIONBETA	= 0.1;
+const int64_t  MAX_PREDICTIONGAP		= 250;   // ms without a new frame that restarts the prediction
 
+std::atomic<bool> LinearSmoothing::_sharedClock(false);
 
 
 LinearSmoothing::LinearSmoothing(const QJsonDocument& config, HyperHdrInstance* hyperhdr)
@@ -24,6 +30,14 @@ LinearSmoothing::LinearSmoothing(const QJsonDocument& config, HyperHdrInstance*
 	_updateInterval(static_cast<int64_t>(1000 / DEFAUL_UPDATEFREQUENCY)),
 	_settlingTime(DEFAUL_SETTLINGTIME),
 	_timer(nullptr),
+	_timerStatsToken(0),
+	_idle(false),
+	_sharedClockActive(false),
+	_predictionTime(0),
+	_predictionArrival(0),
+	_predictionInterval(0),
+	_predictionAlpha(DEFAUL_PREDICTIONALPHA),
+	_predictionBeta(DEFAUL_PREDICTIONBETA),
 	_continuousOutput(false),
 	_antiFlickeringTreshold(0),
 	_antiFlickeringStep(0),
@@ -42,8 +56,7 @@ LinearSmoothing::LinearSmoothing(const QJsonDocument& config, HyperHdrInstance*
 	_debugCounter(0)
 {
 	// timer
-	_timer = new QTimer(this);
-	_timer->setTimerType(Qt::PreciseTimer);
+	_timer = new PreciseTimer(this);
 
 	// init cfg 0 (default)
 	addConfig(DEFAUL_SETTLINGTIME, DEFAUL_UPDATEFREQUENCY);
@@ -56,7 +69,7 @@ LinearSmoothing::LinearSmoothing(const QJsonDocument& config, HyperHdrInstance*
 
 	// listen for comp changes
 	connect(_hyperhdr, &HyperHdrInstance::compStateChangeRequest, this, &LinearSmoothing::componentStateChange);
-	connect(_timer, &QTimer::timeout, this, &LinearSmoothing::updateLeds);
+	connect(_timer, &PreciseTimer::timeout, this, &LinearSmoothing::updateLeds);
 }
 
 LinearSmoothing::~LinearSmoothing()
@@ -88,10 +101,18 @@ void LinearSmoothing::clearQueuedColors(bool deviceEnabled, bool restarting)
 		_previousTime = 0;
 		_targetValues.clear();
 		_targetTime = 0;
+		_targetTrace = FrameTrace();
 		_flushFrame = false;
 		_infoUpdate = true;
 		_infoInput = true;
 		_coolDown = 0;
+		_idle = false;
+		_pacer.reset();
+		_predictedValues.clear();
+		_predictedVelocity.clear();
+		_predictionTime = 0;
+		_predictionArrival = 0;
+		_predictionInterval = 0;
 
 		if (deviceEnabled)
 		{
@@ -133,9 +154,14 @@ void LinearSmoothing::handleSettingsUpdate(settings::type type, const QJsonDocum
 
 		if (smoothingType == "alternative")
 			cfg._type = SmoothingType::Alternative;
+		else if (smoothingType == "predictive")
+			cfg._type = SmoothingType::Predictive;
 		else
 			cfg._type = SmoothingType::Linear;
 
+		cfg._predictionAlpha = std::min(std::max(obj["predictionAlpha"].toDouble(DEFAUL_PREDICTIONALPHA), 0.05), 1.0);
+		cfg._predictionBeta = std::min(std::max(obj["predictionBeta"].toDouble(DEFAUL_PREDICTIONBETA), 0.0), 1.0);
+
 		cfg._antiFlickeringTreshold = obj["lowLightAntiFlickeringTreshold"].toInt(0);
 		cfg._antiFlickeringStep = obj["lowLightAntiFlickeringValue"].toInt(0);
 		cfg._antiFlickeringTimeout = obj["lowLightAntiFlickeringTimeout"].toInt(0);
@@ -193,15 +219,16 @@ void LinearSmoothing::Antiflickering()
 	}
 }
 
-void LinearSmoothing::updateLedValues(const std::vector<ColorRgb>& ledValues)
+void LinearSmoothing::updateLedValues(const std::vector<ColorRgb>& ledValues, const FrameTrace& trace)
 {
 	if (!_enabled)
 		return;
 
-	_coolDown = 1;
-
 	if (_directMode)
 	{
+		_coolDown = 1;
+		_targetTrace = trace;
+
 		if (_timer->remainingTime() >= 0)
 			clearQueuedColors();
 
@@ -213,10 +240,23 @@ void LinearSmoothing::updateLedValues(const std::vector<ColorRgb>& ledValues)
 		return;
 	}
 
+	if (_idle)
+	{
+		// the same colors are already on the leds
+		if (ledValues == _previousValues)
+			return;
+
+		_idle = false;
+		_timer->start();
+	}
+
+	_coolDown = 1;
+	_targetTrace = trace;
+
 	try
 	{
 		if (_infoInput)
-			Info(_log, "Using %s smoothing input (%i)", ((_smoothingType == SmoothingType::Alternative) ? "alternative" : "linear"), _currentConfigId);
+			Info(_log, "Using %s smoothing input (%i)", QSTRING_CSTR(SmoothingCfg::EnumToString(_smoothingType).toLower()), _currentConfigId);
 
 		_infoInput = false;
 		LinearSetup(ledValues);
@@ -252,6 +292,9 @@ void LinearSmoothing::LinearSetup(const std::vector<ColorRgb>& ledValues)
 	}
 
 	Antiflickering();
+
+	if (_smoothingType == SmoothingType::Predictive)
+		PredictiveSetup();
 }
 
 inline uint8_t LinearSmoothing::computeColor(int64_t k, int color)
@@ -285,11 +328,80 @@ inline uint8_t LinearSmoothing::computeAdvColor(int limitMin, int limitAverage,
 		return std::ceil(kMin * val);
 }
 
+void LinearSmoothing::setupStepTable(bool correction, int64_t deltaTime)
+{
+	const int aspectLow = 16;
+	const int aspectMid = 32;
+	const int aspectHigh = 60;
+
+	float kOrg = 0, kMin = 0, kMid = 0, kAbove = 0, kMax = 0;
+	int64_t k = 0;
+
+	if (correction)
+		setupAdvColor(deltaTime, kOrg, kMin, kMid, kAbove, kMax);
+	else
+		k = std::max((1 << 8) - (deltaTime << 8) / (_targetTime - _previousTime), static_cast<int64_t>(1));
+
+	_stepTable[255] = 0;
+
+	for (int delta = 1; delta <= 255; delta++)
+	{
+		int16_t step = (correction) ? computeAdvColor(aspectLow, aspectMid, aspectHigh, kMin, kMid, kAbove, kMax, delta) : computeColor(k, delta);
+
+		_stepTable[255 + delta] = step;
+		_stepTable[255 - delta] = -step;
+	}
+}
+
+void LinearSmoothing::reportTimerStats()
+{
+	int64_t token = PerformanceCounters::currentToken();
+
+	if (token == _timerStatsToken)
+		return;
+
+	PreciseTimer::JitterStats stats = _timer->takeJitterStats();
+
+	// the first period is incomplete
+	if (_timerStatsToken > 0 && stats.ticks > 0)
+		emit PerformanceCounters::getInstance()->newCounter(
+			PerformanceReport(static_cast<int>(PerformanceReportType::SMOOTHING_TIMER), token, "", stats.average, stats.max, stats.ticks, stats.missed, _hyperhdr->getInstanceIndex()));
+
+	_timerStatsToken = token;
+}
+
+void LinearSmoothing::setSharedClock(bool enabled)
+{
+	_sharedClock = enabled;
+}
+
 void LinearSmoothing::updateLeds()
 {
+	TRACE_SCOPE("smoothing tick");
+
+	const int64_t begin = PreciseTimer::now();
+
+	reportTimerStats();
+
+	if (_sharedClockActive != _sharedClock)
+	{
+		_sharedClockActive = _sharedClock;
+		_timer->setPhaseAligned(_sharedClockActive);
+		_pacer.reset();
+		Info(_log, "The update timer %s", (_sharedClockActive) ? "follows the shared smoothing clock" : "follows the led device");
+	}
+
 	try
 	{
-		if (_smoothingType == SmoothingType::Alternative)
+		if (_smoothingType == SmoothingType::Predictive)
+		{
+			if (_infoUpdate)
+				Info(_log, "Using predictive smoothing procedure (%i)", _currentConfigId);
+			_infoUpdate = false;
+
+			PredictiveProcessing();
+		}
+		else if (_smoothingType == SmoothingType::Alternative)
 		{
 			if (_infoUpdate)
 				Info(_log, "Using alternative smoothing procedure (%i)", _currentConfigId);
@@ -310,13 +422,26 @@ void LinearSmoothing::updateLeds()
 	{
 		Debug(_log, "Smoothing error detected");
 	}
+
+	// converged and the final colors are flushed: nothing to do until the input changes
+	if (!_continuousOutput && !_flushFrame && _coolDown <= 0 && _previousValues == _targetValues)
+	{
+		_idle = true;
+		_timer->stop();
+		return;
+	}
+
+	// the shared clock keeps one phase for all the instances, a single device can't move it
+	_pacer.addProcessingTime(PreciseTimer::now() - begin);
+	if (!_sharedClockActive)
+		_pacer.pace(_timer, _hyperhdr->getWriteCadence().get());
 }
 
 void LinearSmoothing::queueColors(const std::vector<ColorRgb>& ledColors)
 {
 	if (!_pause)
 	{
-		emit _hyperhdr->ledDeviceData(ledColors);
+		_hyperhdr->writeLedDeviceData(ledColors, _targetTrace);
 	}
 }
 
@@ -394,6 +519,8 @@ bool LinearSmoothing::selectConfig(unsigned cfg, bool force)
 		_antiFlickeringTreshold = _cfgList[cfg]._antiFlickeringTreshold;
 		_antiFlickeringStep = _cfgList[cfg]._antiFlickeringStep;
 		_antiFlickeringTimeout = _cfgList[cfg]._antiFlickeringTimeout;
+		_predictionAlpha = _cfgList[cfg]._predictionAlpha;
+		_predictionBeta = _cfgList[cfg]._predictionBeta;
 
 		int64_t newUpdateInterval = std::max(_cfgList[cfg]._updateInterval, (int64_t)5);
 
@@ -437,7 +564,9 @@ LinearSmoothing::SmoothingCfg::SmoothingCfg() :
 	_type(SmoothingType::Linear),
 	_antiFlickeringTreshold(0),
 	_antiFlickeringStep(0),
-	_antiFlickeringTimeout(0)
+	_antiFlickeringTimeout(0),
+	_predictionAlpha(DEFAUL_PREDICTIONALPHA),
+	_predictionBeta(DEFAUL_PREDICTIONBETA)
 {
 }
 
@@ -449,7 +578,9 @@ LinearSmoothing::SmoothingCfg::SmoothingCfg(bool pause, int64_t settlingTime, in
 	_type(type),
 	_antiFlickeringTreshold(antiFlickeringTreshold),
 	_antiFlickeringStep(antiFlickeringStep),
-	_antiFlickeringTimeout(antiFlickeringTimeout)
+	_antiFlickeringTimeout(antiFlickeringTimeout),
+	_predictionAlpha(DEFAUL_PREDICTIONALPHA),
+	_predictionBeta(DEFAUL_PREDICTIONBETA)
 {
 }
 
@@ -459,21 +590,16 @@ QString LinearSmoothing::SmoothingCfg::EnumToString(SmoothingType type)
 		return QString("Linear");
 	else if (type == SmoothingType::Alternative)
 		return QString("Alternative");
+	else if (type == SmoothingType::Predictive)
+		return QString("Predictive");
 
 	return QString("Unknown");
 }
 
 void LinearSmoothing::LinearSmoothingProcessing(bool correction)
 {
-	float kOrg, kMin, kMid, kAbove, kMax;
 	int64_t now = InternalClock::nowPrecise();
 	int64_t deltaTime = _targetTime - now;
-	int64_t k;
-
-	int aspectLow = 16;
-	int aspectMid = 32;
-	int aspectHigh = 60;
-
 
 	if (deltaTime <= 0 || _targetTime <= _previousTime)
 	{
@@ -498,45 +624,122 @@ void LinearSmoothing::LinearSmoothingProcessing(bool correction)
 	{
 		_flushFrame = true;
 
-		if (correction)
-			setupAdvColor(deltaTime, kOrg, kMin, kMid, kAbove, kMax);
-		else
-			k = std::max((1 << 8) - (deltaTime << 8) / (_targetTime - _previousTime), static_cast<int64_t>(1));
-
-		int redDiff = 0, greenDiff = 0, blueDiff = 0;
-
 		if (_previousValues.size() != _targetValues.size())
 		{
 			Error(_log, "Detect abnormal state. Previuos value: %d, new value: %d", _previousValues.size(), _targetValues.size());
 		}
 		else
 		{
-			for (size_t i = 0; i < _previousValues.size(); i++)
-			{
-				ColorRgb& prev = _previousValues[i];
-				ColorRgb& target = _targetValues[i];
-
-				redDiff = target.red - prev.red;
-				greenDiff = target.green - prev.green;
-				blueDiff = target.blue - prev.blue;
-
-				if (redDiff != 0)
-					prev.red += (redDiff < 0 ? -1 : 1) *
-					((correction) ? computeAdvColor(aspectLow, aspectMid, aspectHigh, kMin, kMid, kAbove, kMax, redDiff) : computeColor(k, redDiff));
-				if (greenDiff != 0)
-					prev.green += (greenDiff < 0 ? -1 : 1) *
-					((correction) ? computeAdvColor(aspectLow, aspectMid, aspectHigh, kMin, kMid, kAbove, kMax, greenDiff) : computeColor(k, greenDiff));
-				if (blueDiff != 0)
-					prev.blue += (blueDiff < 0 ? -1 : 1) *
-					((correction) ? computeAdvColor(aspectLow, aspectMid, aspectHigh, kMin, kMid, kAbove, kMax, blueDiff) : computeColor(k, blueDiff));
-			}
+			// the step depends only on the difference: the coefficients are evaluated 255 times, not for every led
+			setupStepTable(correction, deltaTime);
+
+			uint8_t* prev = reinterpret_cast<uint8_t*>(_previousValues.data());
+			const uint8_t* target = reinterpret_cast<const uint8_t*>(_targetValues.data());
+			const size_t count = _previousValues.size() * sizeof(ColorRgb);
+
+			for (size_t i = 0; i < count; i++)
+				prev[i] = static_cast<uint8_t>(prev[i] + _stepTable[int(target[i]) - int(prev[i]) + 255]);
 		}
 		_previousTime = now;
 
-		queueColors(_previousValues);
+		// the busy device would replace this intermediate frame with the next one, the flush sends the final colors anyway
+		if (_pacer.isDeviceReady(_timer, _hyperhdr->getWriteCadence().get()))
+			queueColors(_previousValues);
 	}
 }
 
+void LinearSmoothing::PredictiveSetup()
+{
+	// the capture time of the frame, the arrival when the source doesn't provide it
+	_predictionArrival = InternalClock::now();
+	const int64_t measured = (_targetTrace.timestamp > 0 && _targetTrace.timestamp <= _predictionArrival) ? _targetTrace.timestamp : _predictionArrival;
+	const int64_t deltaTime = measured - _predictionTime;
+	const size_t count = _targetValues.size() * sizeof(ColorRgb);
+	const uint8_t* target = reinterpret_cast<const uint8_t*>(_targetValues.data());
+
+	// after a pause (ex. a static picture) the old velocity would only overshoot
+	if (_predictedValues.size() != count || _predictionTime <= 0 || deltaTime > MAX_PREDICTIONGAP ||
+		(_predictionInterval > 0 && deltaTime > 4 * _predictionInterval))
+	{
+		_predictedValues.assign(target, target + count);
+		_predictedVelocity.assign(count, 0.0f);
+		_predictionTime = measured;
+		_predictionInterval = 0;
+		return;
+	}
+
+	// the same capture time or an older frame: nothing new to learn
+	if (deltaTime <= 0)
+		return;
+
+	_predictionInterval = (_predictionInterval <= 0) ? deltaTime : _predictionInterval + (deltaTime - _predictionInterval) / 4;
+
+	const float dt = static_cast<float>(deltaTime);
+	const float alpha = static_cast<float>(_predictionAlpha);
+	const float beta = static_cast<float>(_predictionBeta) / dt;
+	float* position = _predictedValues.data();
+	float* velocity = _predictedVelocity.data();
+
+	for (size_t i = 0; i < count; i++)
+	{
+		const float predicted = position[i] + velocity[i] * dt;
+		const float residual = target[i] - predicted;
+
+		position[i] = predicted + alpha * residual;
+		velocity[i] += beta * residual;
+	}
+
+	_predictionTime = measured;
+}
+
+void LinearSmoothing::PredictiveProcessing()
+{
+	const int64_t now = InternalClock::now();
+	const size_t count = _targetValues.size() * sizeof(ColorRgb);
+
+	// from the capture: the latency of the pipeline is compensated too
+	const int64_t horizon = now - _predictionTime;
+	const bool stale = (now - _predictionArrival > 2 * _predictionInterval || horizon > MAX_PREDICTIONGAP);
+
+	// the input stopped (ex. a static picture) or only one frame is known: the target itself, then the output stops like for the linear types
+	if (_predictedValues.size() != count || _predictionTime <= 0 || _predictionInterval <= 0 || stale)
+	{
+		_previousValues = _targetValues;
+
+		if (_flushFrame)
+			queueColors(_targetValues);
+
+		if (!_continuousOutput && _coolDown > 0)
+		{
+			_coolDown--;
+			_flushFrame = true;
+		}
+		else
+			_flushFrame = _continuousOutput;
+
+		return;
+	}
+
+	_flushFrame = true;
+
+	if (_previousValues.size() != _targetValues.size())
+		_previousValues = _targetValues;
+
+	const float h = static_cast<float>(horizon);
+	const float* position = _predictedValues.data();
+	const float* velocity = _predictedVelocity.data();
+	uint8_t* output = reinterpret_cast<uint8_t*>(_previousValues.data());
+
+	for (size_t i = 0; i < count; i++)
+	{
+		const float value = position[i] + velocity[i] * h + 0.5f;
+		output[i] = static_cast<uint8_t>(std::min(std::max(value, 0.0f), 255.0f));
+	}
+
+	if (_pacer.isDeviceReady(_timer, _hyperhdr->getWriteCadence().get()))
+		queueColors(_previousValues);
+}
+
 void LinearSmoothing::DebugOutput()
 {
 	/*_debugCounter = std::min(_debugCounter+1,900);
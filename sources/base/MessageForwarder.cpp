@@ -9,20 +9,46 @@
 
 // utils includes
 #include <utils/Logger.h>
+#include <utils/InternalClock.h>
+#include <utils/PerformanceCounters.h>
+#include <utils/QStringUtils.h>
+#include <utils/RenderNodeFrame.h>
 
 // qt includes
 #include <QTcpServer>
 #include <QTcpSocket>
+#include <QUdpSocket>
 #include <QThread>
 
 #include <flatbufserver/FlatBufferConnection.h>
 
+namespace
+{
+	/// the messages kept for a json slave while it connects
+	const int MAX_JSON_QUEUE = 32;
+
+	/// a json slave that does not read its socket drops the new messages [bytes]
+	const qint64 MAX_JSON_BACKLOG = 256 * 1024;
+
+	/// the lag of the slaves is reported at most once per interval [ms]
+	const qint64 REPORT_INTERVAL = 1000;
+
+	/// the ids of the reports of an instance: the flatbuffer slaves, then the json slaves
+	const int REPORT_IDS_PER_INSTANCE = 100;
+	const int REPORT_JSON_OFFSET = 50;
+}
+
 MessageForwarder::MessageForwarder(HyperHdrInstance* hyperhdr)
 	: QObject()
 	, _hyperhdr(hyperhdr)
 	, _log(Logger::getInstance("NETFORWARDER"))
 	, _muxer(_hyperhdr->getMuxerInstance())
 	, _forwarder_enabled(true)
+	, _lastJsonReport(0)
+	, _renderNodeSocket(nullptr)
+	, _renderNodePort(0)
+	, _renderNodeZone(0)
+	, _renderNodeSequence(0)
 	, _priority(140)
 	, _messageForwarderHelper(nullptr)
 {
@@ -44,6 +70,10 @@ MessageForwarder::~MessageForwarder()
 	disconnect(_hyperhdr, &HyperHdrInstance::forwardV4lProtoMessage, 0, 0);
 	disconnect(_hyperhdr, &HyperHdrInstance::forwardSystemProtoMessage, 0, 0);
 
+	clearJsonTargets();
+
+	setRenderNodeTarget(false, QString(), 0);
+
 	if (_messageForwarderHelper != nullptr)
 	{
 		delete _messageForwarderHelper;
@@ -51,12 +81,13 @@ MessageForwarder::~MessageForwarder()
 	}
 }
 
-MessageForwarderHelper::MessageForwarderHelper()
+MessageForwarderHelper::MessageForwarderHelper(int instance)
+	: _instance(instance)
+	, _lastReport(0)
+	, _scheduled(false)
 {
-	_free = true;
-
 	QThread* mainThread = new QThread();
-	mainThread->setObjectName("ForwarderHelperThread");
+	mainThread->setObjectName("Forwarder");
 	this->moveToThread(mainThread);
 	mainThread->start();
 
@@ -76,16 +107,23 @@ MessageForwarderHelper::~MessageForwarderHelper()
 	delete oldThread;
 }
 
-void MessageForwarderHelper::addClientHandler(const QString& origin, const QString& address, int priority, bool skipReply)
+void MessageForwarderHelper::addClientHandler(const QString& origin, const QString& address, int priority, bool skipReply, int maxWidth, int format, int quality)
 {
 	FlatBufferConnection* flatbuf = new FlatBufferConnection("Forwarder", address, priority, false);
+	flatbuf->setImageEncoding(maxWidth, static_cast<FlatBufferConnection::ImageFormat>(format), quality);
 	_forwardClients << flatbuf;
+	_forwardNames << address;
 }
 
 void MessageForwarderHelper::clearClientsHandler()
 {
+	for (int i = 0; i < _forwardClients.size(); i++)
+		emit PerformanceCounters::getInstance()->removeCounter(static_cast<int>(PerformanceReportType::FORWARDER), _instance * REPORT_IDS_PER_INSTANCE + i);
+
 	while (!_forwardClients.isEmpty())
 		delete _forwardClients.takeFirst();
+
+	_forwardNames.clear();
 }
 
 void MessageForwarder::handleSettingsUpdate(settings::type type, const QJsonDocument& config)
@@ -99,10 +137,12 @@ void MessageForwarder::handleSettingsUpdate(settings::type type, const QJsonDocu
 		// build new one
 		const QJsonObject& obj = config.object();
 
+		clearJsonTargets();
+
 		if (_messageForwarderHelper == nullptr)
 		{
 			if (obj["enable"].toBool())
-				_messageForwarderHelper = new MessageForwarderHelper();
+				_messageForwarderHelper = new MessageForwarderHelper(_hyperhdr->getInstanceIndex());
 		}
 		else
 			emit _messageForwarderHelper->clearClients();
@@ -157,6 +197,9 @@ void MessageForwarder::handleSettingsUpdate(settings::type type, const QJsonDocu
 			disconnect(_hyperhdr, &HyperHdrInstance::forwardV4lProtoMessage, 0, 0);
 		}
 
+		setRenderNodeTarget(obj["enable"].toBool() && _forwarder_enabled && obj["renderNode"].toBool(false),
+			obj["renderNodeTarget"].toString("239.255.28.12:5568"), obj["renderNodeZone"].toInt(0));
+
 		// update comp state
 		_hyperhdr->setNewComponentState(hyperhdr::COMP_FORWARDER, obj["enable"].toBool(true));
 	}
@@ -254,12 +297,47 @@ void MessageForwarder::addJsonSlave(const QString& slave)
 
 void MessageForwarder::addFlatbufferSlave(const QString& slave)
 {
-	if (slave != HYPERHDR_DOMAIN_SERVER)
+	// "address:port" followed by the optional settings of the target, ex. "192.168.0.10:19400 width=640 format=jpeg quality=75"
+	const QStringList words = QStringUtils::SPLITTER(slave, ' ');
+	if (words.isEmpty())
+		return;
+
+	const QString address = words[0];
+	int maxWidth = 0;
+	int quality = 80;
+	FlatBufferConnection::ImageFormat format = FlatBufferConnection::ImageFormat::RAW;
+
+	for (int i = 1; i < words.size(); i++)
 	{
-		QStringList parts = slave.split(":");
+		const QStringList option = words[i].split("=");
+		bool ok = (option.size() == 2);
+
+		if (ok && option[0] == "width")
+			maxWidth = option[1].toInt(&ok);
+		else if (ok && option[0] == "quality")
+			quality = option[1].toInt(&ok);
+		else if (ok && option[0] == "format" && option[1] == "raw")
+			format = FlatBufferConnection::ImageFormat::RAW;
+		else if (ok && option[0] == "format" && option[1] == "lz4")
+			format = FlatBufferConnection::ImageFormat::LZ4;
+		else if (ok && option[0] == "format" && option[1] == "jpeg")
+			format = FlatBufferConnection::ImageFormat::JPEG;
+		else
+			ok = false;
+
+		if (!ok)
+		{
+			Error(_log, "Unable to parse the option '%s' of the target (%s)", QSTRING_CSTR(words[i]), QSTRING_CSTR(slave));
+			return;
+		}
+	}
+
+	if (address != HYPERHDR_DOMAIN_SERVER)
+	{
+		QStringList parts = address.split(":");
 		if (parts.size() != 2)
 		{
-			Error(_log, "Unable to parse address (%s)", QSTRING_CSTR(slave));
+			Error(_log, "Unable to parse address (%s)", QSTRING_CSTR(address));
 			return;
 		}
 
@@ -275,7 +353,7 @@ void MessageForwarder::addFlatbufferSlave(const QString& slave)
 		const QJsonObject& obj = _hyperhdr->getSetting(settings::type::FLATBUFSERVER).object();
 		if (QHostAddress(parts[0]) == QHostAddress::LocalHost && parts[1].toInt() == obj["port"].toInt())
 		{
-			Error(_log, "Loop between Flatbuffer Server and Forwarder! (%s)", QSTRING_CSTR(slave));
+			Error(_log, "Loop between Flatbuffer Server and Forwarder! (%s)", QSTRING_CSTR(address));
 			return;
 		}
 	}
@@ -284,7 +362,7 @@ void MessageForwarder::addFlatbufferSlave(const QString& slave)
 	{
 		_flatSlaves << slave;
 		if (_messageForwarderHelper != nullptr)
-			emit _messageForwarderHelper->addClient("Forwarder", slave.toLocal8Bit().constData(), _priority, false);
+			emit _messageForwarderHelper->addClient("Forwarder", address, _priority, false, maxWidth, static_cast<int>(format), quality);
 	}
 }
 
@@ -292,87 +370,267 @@ void MessageForwarder::forwardJsonMessage(const QJsonObject& message)
 {
 	if (_forwarder_enabled)
 	{
-		QTcpSocket client;
-		for (int i = 0; i < _jsonSlaves.size(); i++)
+		if (_jsonTargets.isEmpty())
 		{
-			QStringList parts = _jsonSlaves.at(i).split(":");
-			client.connectToHost(QHostAddress(parts[0]), parts[1].toUShort());
-			if (client.waitForConnected(500))
+			for (const QString& slave : _jsonSlaves)
 			{
-				sendJsonMessage(message, &client);
-				client.close();
+				QStringList parts = slave.split(":");
+
+				JsonTarget* target = new JsonTarget{ parts[0], parts[1].toUShort(), new QTcpSocket(this), {}, {}, {}, 0, 0, 0, 0 };
+
+				connect(target->socket, &QTcpSocket::connected, this, [this, target]() {
+					while (!target->queue.isEmpty())
+						sendJsonMessage(target, target->queue.takeFirst());
+				});
+				connect(target->socket, &QTcpSocket::readyRead, this, [this, target]() { readJsonReplies(target); });
+				connect(target->socket, &QTcpSocket::disconnected, this, [target]() { target->inFlight.clear(); target->receiveBuffer.clear(); });
+
+				_jsonTargets << target;
 			}
 		}
+
+		QJsonObject jsonMessage = message;
+		if (jsonMessage.contains("tan") && jsonMessage["tan"].isNull())
+			jsonMessage["tan"] = 100;
+
+		// serialize message once for all the slaves
+		const QByteArray serializedMessage = QJsonDocument(jsonMessage).toJson(QJsonDocument::Compact) + "\n";
+
+		for (JsonTarget* target : _jsonTargets)
+			sendJsonMessage(target, serializedMessage);
+
+		reportJsonTargets();
 	}
 }
 
-void MessageForwarder::forwardFlatbufferMessage(const QString& name, const Image<ColorRgb>& image)
+void MessageForwarder::sendJsonMessage(JsonTarget* target, const QByteArray& message)
 {
-	if (_messageForwarderHelper != nullptr)
+	QTcpSocket* socket = target->socket;
+
+	if (socket->state() != QAbstractSocket::ConnectedState)
 	{
-		bool isfree = _messageForwarderHelper->isFree();
+		if (socket->state() == QAbstractSocket::UnconnectedState)
+			socket->connectToHost(QHostAddress(target->host), target->port);
+
+		if (target->queue.size() >= MAX_JSON_QUEUE)
+		{
+			target->queue.removeFirst();
+			target->dropped++;
+		}
 
-		if (isfree && _forwarder_enabled)
-			QUEUE_CALL_1(_messageForwarderHelper, forwardImage, Image<ColorRgb>, image);
+		target->queue << message;
+		return;
+	}
+
+	// the slave does not keep up: the other slaves are not affected
+	if (socket->bytesToWrite() > MAX_JSON_BACKLOG)
+	{
+		target->dropped++;
+		return;
 	}
+
+	socket->write(message);
+	target->inFlight << InternalClock::now();
 }
 
-bool MessageForwarderHelper::isFree()
+void MessageForwarder::readJsonReplies(JsonTarget* target)
 {
-	return _free;
+	target->receiveBuffer += target->socket->readAll();
+
+	// one reply line per message, its content is not used
+	int newline;
+	while ((newline = target->receiveBuffer.indexOf('\n')) >= 0)
+	{
+		target->receiveBuffer.remove(0, newline + 1);
+
+		if (!target->inFlight.isEmpty())
+		{
+			const qint64 lag = InternalClock::now() - target->inFlight.takeFirst();
+
+			target->sent++;
+			target->lagSum += lag;
+			target->lagMax = qMax(target->lagMax, lag);
+		}
+	}
+
+	if (target->receiveBuffer.size() > 1024 * 1024)
+	{
+		Error(_log, "Error while parsing reply of %s:%d: the reply is too long", QSTRING_CSTR(target->host), target->port);
+		target->receiveBuffer.clear();
+	}
 }
 
-void MessageForwarderHelper::forwardImage(const Image<ColorRgb>& image)
+void MessageForwarder::clearJsonTargets()
 {
-	_free = false;
+	for (int i = 0; i < _jsonTargets.size(); i++)
+	{
+		JsonTarget* target = _jsonTargets[i];
 
-	for (int i = 0; i < _forwardClients.size(); i++)
+		emit PerformanceCounters::getInstance()->removeCounter(static_cast<int>(PerformanceReportType::FORWARDER),
+			_hyperhdr->getInstanceIndex() * REPORT_IDS_PER_INSTANCE + REPORT_JSON_OFFSET + i);
+
+		disconnect(target->socket, nullptr, this, nullptr);
+		target->socket->abort();
+		target->socket->deleteLater();
+		delete target;
+	}
+
+	_jsonTargets.clear();
+}
+
+void MessageForwarder::reportJsonTargets()
+{
+	const qint64 now = InternalClock::now();
+
+	if (now - _lastJsonReport < REPORT_INTERVAL)
+		return;
+
+	_lastJsonReport = now;
+
+	const qint64 token = PerformanceCounters::currentToken();
+
+	for (int i = 0; i < _jsonTargets.size(); i++)
 	{
-		_forwardClients.at(i)->setImage(image);
+		JsonTarget* target = _jsonTargets[i];
+
+		emit PerformanceCounters::getInstance()->newCounter(
+			PerformanceReport(static_cast<int>(PerformanceReportType::FORWARDER), token, QString("json@%1:%2").arg(target->host).arg(target->port),
+				(target->sent > 0) ? static_cast<double>(target->lagSum) / target->sent : 0, target->lagMax, target->sent, target->dropped,
+				_hyperhdr->getInstanceIndex() * REPORT_IDS_PER_INSTANCE + REPORT_JSON_OFFSET + i));
+
+		target->sent = 0;
+		target->dropped = 0;
+		target->lagSum = 0;
+		target->lagMax = 0;
 	}
+}
 
-	_free = true;
+void MessageForwarder::forwardFlatbufferMessage(const QString& name, const Image<ColorRgb>& image)
+{
+	if (_messageForwarderHelper != nullptr && _forwarder_enabled)
+		_messageForwarderHelper->queueImage(image);
 }
 
-void MessageForwarder::sendJsonMessage(const QJsonObject& message, QTcpSocket* socket)
+void MessageForwarder::setRenderNodeTarget(bool enable, const QString& target, int zone)
 {
-	QJsonObject jsonMessage = message;
-	if (jsonMessage.contains("tan") && jsonMessage["tan"].isNull())
-		jsonMessage["tan"] = 100;
+	disconnect(_hyperhdr, &HyperHdrInstance::renderNodeColors, this, &MessageForwarder::forwardRenderNodeColors);
 
-	// serialize message
-	QJsonDocument writer(jsonMessage);
-	QByteArray serializedMessage = writer.toJson(QJsonDocument::Compact) + "\n";
+	if (_renderNodeSocket != nullptr)
+	{
+		Info(_log, "Stopped the render node stream to %s:%d", QSTRING_CSTR(_renderNodeAddress.toString()), _renderNodePort);
+
+		delete _renderNodeSocket;
+		_renderNodeSocket = nullptr;
+	}
 
-	// write message
-	socket->write(serializedMessage);
-	if (!socket->waitForBytesWritten())
+	if (!enable)
+		return;
+
+	const QStringList parts = target.split(":");
+	bool ok = (parts.size() == 2);
+	const quint16 port = (ok) ? parts[1].toUShort(&ok) : 0;
+
+	if (!ok || QHostAddress(parts[0]).isNull())
 	{
-		Debug(_log, "Error while writing data to host");
+		Error(_log, "Unable to parse the address of the render nodes (%s)", QSTRING_CSTR(target));
 		return;
 	}
 
-	// read reply data
-	QByteArray serializedReply;
-	while (!serializedReply.contains('\n'))
+	_renderNodeAddress = QHostAddress(parts[0]);
+	_renderNodePort = port;
+	_renderNodeZone = static_cast<uint8_t>(qBound(0, zone, 255));
+	_renderNodePacket.resize(RenderNodeFrame::MAX_DATAGRAM_SIZE);
+
+	_renderNodeSocket = new QUdpSocket(this);
+
+	// the nodes of a venue are on the local network
+	if (_renderNodeAddress.isMulticast())
+		_renderNodeSocket->setSocketOption(QAbstractSocket::MulticastTtlOption, 1);
+
+	// the colors are sent from the instance thread before the adjustments, the nodes apply their own
+	connect(_hyperhdr, &HyperHdrInstance::renderNodeColors, this, &MessageForwarder::forwardRenderNodeColors, Qt::DirectConnection);
+
+	Info(_log, "Forward now the colors of zone %d to the render nodes at %s:%d", _renderNodeZone, QSTRING_CSTR(_renderNodeAddress.toString()), _renderNodePort);
+}
+
+void MessageForwarder::forwardRenderNodeColors(const std::vector<ColorRgb>& ledColors, int64_t captureTimestamp)
+{
+	if (_renderNodeSocket == nullptr || ledColors.empty())
+		return;
+
+	RenderNodeFrame::Header header;
+	header.zone = _renderNodeZone;
+	header.sequence = ++_renderNodeSequence;
+	header.ledCount = static_cast<uint16_t>(qMin(ledColors.size(), static_cast<size_t>(0xffff)));
+
+	if (captureTimestamp > 0)
+		header.captureAge = static_cast<uint16_t>(qBound(static_cast<int64_t>(0), InternalClock::now() - captureTimestamp, static_cast<int64_t>(RenderNodeFrame::UNKNOWN_AGE - 1)));
+
+	const uint8_t* colors = reinterpret_cast<const uint8_t*>(ledColors.data());
+
+	for (unsigned offset = 0; offset < header.ledCount; offset += RenderNodeFrame::MAX_LEDS_PER_DATAGRAM)
 	{
-		// receive reply
-		if (!socket->waitForReadyRead())
-		{
-			Debug(_log, "Error while writing data from host");
-			return;
-		}
+		const unsigned leds = qMin(header.ledCount - offset, RenderNodeFrame::MAX_LEDS_PER_DATAGRAM);
 
-		serializedReply += socket->readAll();
+		header.offset = static_cast<uint16_t>(offset);
+		RenderNodeFrame::writeHeader(_renderNodePacket.data(), header);
+		memcpy(_renderNodePacket.data() + RenderNodeFrame::HEADER_SIZE, colors + offset * 3, leds * 3);
+
+		_renderNodeSocket->writeDatagram(reinterpret_cast<const char*>(_renderNodePacket.data()), RenderNodeFrame::HEADER_SIZE + leds * 3, _renderNodeAddress, _renderNodePort);
 	}
+}
+
+void MessageForwarderHelper::queueImage(const Image<ColorRgb>& image)
+{
+	QMutexLocker locker(&_pendingLock);
+
+	_pendingImage = image;
+
+	if (!_scheduled)
+	{
+		_scheduled = true;
+		QUEUE_CALL_0(this, forwardImage);
+	}
+}
+
+void MessageForwarderHelper::forwardImage()
+{
+	Image<ColorRgb> image;
+
+	{
+		QMutexLocker locker(&_pendingLock);
 
-	// parse reply data
-	QJsonParseError error;
-	QJsonDocument reply = QJsonDocument::fromJson(serializedReply, &error);
+		image = _pendingImage;
+		_pendingImage = Image<ColorRgb>();
+		_scheduled = false;
+	}
 
-	if (error.error != QJsonParseError::NoError)
+	// every slave sends it now or keeps it as its next image
+	for (int i = 0; i < _forwardClients.size(); i++)
 	{
-		Error(_log, "Error while parsing reply: invalid json");
+		_forwardClients.at(i)->setImage(image);
+	}
+
+	reportClients();
+}
+
+void MessageForwarderHelper::reportClients()
+{
+	const qint64 now = InternalClock::now();
+
+	if (now - _lastReport < REPORT_INTERVAL)
 		return;
+
+	_lastReport = now;
+
+	const qint64 token = PerformanceCounters::currentToken();
+
+	for (int i = 0; i < _forwardClients.size(); i++)
+	{
+		const FlatBufferConnection::ForwardStats stats = _forwardClients.at(i)->takeForwardStats();
+
+		emit PerformanceCounters::getInstance()->newCounter(
+			PerformanceReport(static_cast<int>(PerformanceReportType::FORWARDER), token, QString("flatbuffer@%1").arg(_forwardNames.at(i)),
+				stats.lagAverage, stats.lagMax, stats.sent, stats.dropped, _instance * REPORT_IDS_PER_INSTANCE + i));
 	}
 }
@@ -7,6 +7,7 @@
 
 MultiColorAdjustment::MultiColorAdjustment(quint8 instance, int ledCnt)
 	: _ledAdjustments(ledCnt, nullptr)
+	, _tablesValid(false)
 	, _log(Logger::getInstance("ADJUSTMENT" + QString::number(instance)))
 {
 }
@@ -26,6 +27,7 @@ void MultiColorAdjustment::addAdjustment(ColorAdjustment* adjustment)
 {
 	_adjustmentIds.push_back(adjustment->_id);
 	_adjustment.push_back(adjustment);
+	invalidateTables();
 }
 
 void MultiColorAdjustment::setAdjustmentForLed(const QString& id, int startLed, int endLed)
@@ -52,6 +54,8 @@ void MultiColorAdjustment::setAdjustmentForLed(const QString& id, int startLed,
 		//Debug(_log,"_ledAdjustments [%d] -> [%p]", iLed, adjustment);
 		_ledAdjustments[iLed] = adjustment;
 	}
+
+	invalidateTables();
 }
 
 bool MultiColorAdjustment::verifyAdjustments() const
@@ -96,136 +100,288 @@ void MultiColorAdjustment::setBacklightEnabled(bool enable)
 	{
 		adjustment->_rgbTransform.setBackLightEnabled(enable);
 	}
+
+	invalidateTables();
 }
 
-void MultiColorAdjustment::applyAdjustment(std::vector<ColorRgb>& ledColors)
+void MultiColorAdjustment::adjustColor(ColorAdjustment* adjustment, ColorRgb& color, bool satLumDone)
 {
-	const size_t itCnt = qMin(_ledAdjustments.size(), ledColors.size());
-	for (size_t i = 0; i < itCnt; ++i)
+	if (adjustment->_rgbTransform._classic_config)
 	{
-		ColorAdjustment* adjustment = _ledAdjustments[i];
-		if (adjustment == nullptr)
-		{
-			//std::cout << "MultiColorAdjustment::applyAdjustment() - No transform set for this led : " << i << std::endl;
-			// No transform set for this led (do nothing)
-			continue;
-		}
-		ColorRgb& color = ledColors[i];
-
-		if (adjustment->_rgbTransform._classic_config)
-		{
-			uint8_t ored = color.red;
-			uint8_t ogreen = color.green;
-			uint8_t oblue = color.blue;
+		uint8_t ored = color.red;
+		uint8_t ogreen = color.green;
+		uint8_t oblue = color.blue;
 
+		if (!satLumDone)
 			adjustment->_rgbTransform.transformSatLum(ored, ogreen, oblue);
-			adjustment->_rgbTransform.transform(ored, ogreen, oblue);
+		adjustment->_rgbTransform.transform(ored, ogreen, oblue);
+
+		color.red = ored;
+		color.green = ogreen;
+		color.blue = oblue;
+
+		int RR = adjustment->_rgbRedAdjustment.adjustmentR(color.red);
+		int RG = color.red > color.green ? adjustment->_rgbRedAdjustment.adjustmentG(color.red - color.green) : 0;
+		int RB = color.red > color.blue ? adjustment->_rgbRedAdjustment.adjustmentB(color.red - color.blue) : 0;
+
+		int GR = color.green > color.red ? adjustment->_rgbGreenAdjustment.adjustmentR(color.green - color.red) : 0;
+		int GG = adjustment->_rgbGreenAdjustment.adjustmentG(color.green);
+		int GB = color.green > color.blue ? adjustment->_rgbGreenAdjustment.adjustmentB(color.green - color.blue) : 0;
+
+		int BR = color.blue > color.red ? adjustment->_rgbBlueAdjustment.adjustmentR(color.blue - color.red) : 0;
+		int BG = color.blue > color.green ? adjustment->_rgbBlueAdjustment.adjustmentG(color.blue - color.green) : 0;
+		int BB = adjustment->_rgbBlueAdjustment.adjustmentB(color.blue);
+
+		int ledR = RR + GR + BR;
+		int maxR = (int)adjustment->_rgbRedAdjustment.getAdjustmentR();
+		int ledG = RG + GG + BG;
+		int maxG = (int)adjustment->_rgbGreenAdjustment.getAdjustmentG();
+		int ledB = RB + GB + BB;
+		int maxB = (int)adjustment->_rgbBlueAdjustment.getAdjustmentB();
+
+		if (ledR > maxR)
+			color.red = (uint8_t)maxR;
+		else
+			color.red = (uint8_t)ledR;
+
+		if (ledG > maxG)
+			color.green = (uint8_t)maxG;
+		else
+			color.green = (uint8_t)ledG;
 
+		if (ledB > maxB)
+			color.blue = (uint8_t)maxB;
+		else
+			color.blue = (uint8_t)ledB;
+
+		// temperature
+		color.red = adjustment->_rgbRedAdjustment.correction(color.red);
+		color.green = adjustment->_rgbGreenAdjustment.correction(color.green);
+		color.blue = adjustment->_rgbBlueAdjustment.correction(color.blue);
+	}
+	else
+	{
+		uint8_t ored = color.red;
+		uint8_t ogreen = color.green;
+		uint8_t oblue = color.blue;
+		uint8_t B_RGB = 0, B_CMY = 0, B_W = 0;
+
+
+		adjustment->_rgbTransform.transform(ored, ogreen, oblue);
+		adjustment->_rgbTransform.getBrightnessComponents(B_RGB, B_CMY, B_W);
+
+		if (!adjustment->_rgbBlackAdjustment.isEnabled() &&
+			!adjustment->_rgbRedAdjustment.isEnabled() &&
+			!adjustment->_rgbGreenAdjustment.isEnabled() &&
+			!adjustment->_rgbBlueAdjustment.isEnabled() &&
+			!adjustment->_rgbCyanAdjustment.isEnabled() &&
+			!adjustment->_rgbMagentaAdjustment.isEnabled() &&
+			!adjustment->_rgbYellowAdjustment.isEnabled() &&
+			!adjustment->_rgbWhiteAdjustment.isEnabled())
+		{
 			color.red = ored;
 			color.green = ogreen;
 			color.blue = oblue;
+			if (B_RGB != 255)
+			{
+				color.red = ((uint32_t)color.red * B_RGB)/255;
+				color.green = ((uint32_t)color.green * B_RGB) / 255;
+				color.blue = ((uint32_t)color.blue * B_RGB) / 255;
+			}
+			return;
+		}
 
-			int RR = adjustment->_rgbRedAdjustment.adjustmentR(color.red);
-			int RG = color.red > color.green ? adjustment->_rgbRedAdjustment.adjustmentG(color.red - color.green) : 0;
-			int RB = color.red > color.blue ? adjustment->_rgbRedAdjustment.adjustmentB(color.red - color.blue) : 0;
-
-			int GR = color.green > color.red ? adjustment->_rgbGreenAdjustment.adjustmentR(color.green - color.red) : 0;
-			int GG = adjustment->_rgbGreenAdjustment.adjustmentG(color.green);
-			int GB = color.green > color.blue ? adjustment->_rgbGreenAdjustment.adjustmentB(color.green - color.blue) : 0;
+		uint32_t nrng = (uint32_t)(255 - ored) * (255 - ogreen);
+		uint32_t rng = (uint32_t)(ored) * (255 - ogreen);
+		uint32_t nrg = (uint32_t)(255 - ored) * (ogreen);
+		uint32_t rg = (uint32_t)(ored) * (ogreen);
+
+		uint8_t black = nrng * (255 - oblue) / 65025;
+		uint8_t red = rng * (255 - oblue) / 65025;
+		uint8_t green = nrg * (255 - oblue) / 65025;
+		uint8_t blue = nrng * (oblue) / 65025;
+		uint8_t cyan = nrg * (oblue) / 65025;
+		uint8_t magenta = rng * (oblue) / 65025;
+		uint8_t yellow = rg * (255 - oblue) / 65025;
+		uint8_t white = rg * (oblue) / 65025;
+
+		uint8_t OR, OG, OB, RR, RG, RB, GR, GG, GB, BR, BG, BB;
+		uint8_t CR, CG, CB, MR, MG, MB, YR, YG, YB, WR, WG, WB;
+
+		adjustment->_rgbBlackAdjustment.apply(black, 255, OR, OG, OB);
+		adjustment->_rgbRedAdjustment.apply(red, B_RGB, RR, RG, RB);
+		adjustment->_rgbGreenAdjustment.apply(green, B_RGB, GR, GG, GB);
+		adjustment->_rgbBlueAdjustment.apply(blue, B_RGB, BR, BG, BB);
+		adjustment->_rgbCyanAdjustment.apply(cyan, B_CMY, CR, CG, CB);
+		adjustment->_rgbMagentaAdjustment.apply(magenta, B_CMY, MR, MG, MB);
+		adjustment->_rgbYellowAdjustment.apply(yellow, B_CMY, YR, YG, YB);
+		adjustment->_rgbWhiteAdjustment.apply(white, B_W, WR, WG, WB);
+
+		color.red = OR + RR + GR + BR + CR + MR + YR + WR;
+		color.green = OG + RG + GG + BG + CG + MG + YG + WG;
+		color.blue = OB + RB + GB + BB + CB + MB + YB + WB;
+	}
+}
 
-			int BR = color.blue > color.red ? adjustment->_rgbBlueAdjustment.adjustmentR(color.blue - color.red) : 0;
-			int BG = color.blue > color.green ? adjustment->_rgbBlueAdjustment.adjustmentG(color.blue - color.green) : 0;
-			int BB = adjustment->_rgbBlueAdjustment.adjustmentB(color.blue);
+void MultiColorAdjustment::invalidateTables()
+{
+	_tablesValid = false;
+}
 
-			int ledR = RR + GR + BR;
-			int maxR = (int)adjustment->_rgbRedAdjustment.getAdjustmentR();
-			int ledG = RG + GG + BG;
-			int maxG = (int)adjustment->_rgbGreenAdjustment.getAdjustmentG();
-			int ledB = RB + GB + BB;
-			int maxB = (int)adjustment->_rgbBlueAdjustment.getAdjustmentB();
+void MultiColorAdjustment::bakeTables()
+{
+	_tables.clear();
+	_tables.resize(_adjustment.size());
+	_ledTables.assign(_ledAdjustments.size(), nullptr);
 
-			if (ledR > maxR)
-				color.red = (uint8_t)maxR;
-			else
-				color.red = (uint8_t)ledR;
+	for (size_t a = 0; a < _adjustment.size(); a++)
+	{
+		ColorAdjustment* adjustment = _adjustment[a];
+		AdjustmentTable& table = _tables[a];
+		const RgbTransform& transform = adjustment->_rgbTransform;
+		const bool backlightMixed = transform.getBackLightEnabled() && transform.getBacklightThreshold() > 0 && !transform.getBacklightColored();
 
-			if (ledG > maxG)
-				color.green = (uint8_t)maxG;
-			else
-				color.green = (uint8_t)ledG;
+		table.adjustment = adjustment;
 
-			if (ledB > maxB)
-				color.blue = (uint8_t)maxB;
-			else
-				color.blue = (uint8_t)ledB;
+		// the float HSL round trip of the classic config goes to the grid
+		table.satLumGrid = transform._classic_config &&
+			(transform._saturationGain != 1.0 || transform._luminanceGain != 1.0 || transform._luminanceMinimum != 0.0);
 
-			// temperature
-			color.red = adjustment->_rgbRedAdjustment.correction(color.red);
-			color.green = adjustment->_rgbGreenAdjustment.correction(color.green);
-			color.blue = adjustment->_rgbBlueAdjustment.correction(color.blue);
+		// the rest of the chain is replaced by the channel tables if every output channel depends only on the same input channel
+		if (transform._classic_config)
+		{
+			table.channels = !backlightMixed &&
+				adjustment->_rgbRedAdjustment.getAdjustmentG() == 0 && adjustment->_rgbRedAdjustment.getAdjustmentB() == 0 &&
+				adjustment->_rgbGreenAdjustment.getAdjustmentR() == 0 && adjustment->_rgbGreenAdjustment.getAdjustmentB() == 0 &&
+				adjustment->_rgbBlueAdjustment.getAdjustmentR() == 0 && adjustment->_rgbBlueAdjustment.getAdjustmentG() == 0;
 		}
 		else
 		{
-			uint8_t ored = color.red;
-			uint8_t ogreen = color.green;
-			uint8_t oblue = color.blue;
-			uint8_t B_RGB = 0, B_CMY = 0, B_W = 0;
-
-
-			adjustment->_rgbTransform.transform(ored, ogreen, oblue);
-			adjustment->_rgbTransform.getBrightnessComponents(B_RGB, B_CMY, B_W);
-
-			if (!adjustment->_rgbBlackAdjustment.isEnabled() &&
+			table.channels = !backlightMixed &&
+				!adjustment->_rgbBlackAdjustment.isEnabled() &&
 				!adjustment->_rgbRedAdjustment.isEnabled() &&
 				!adjustment->_rgbGreenAdjustment.isEnabled() &&
 				!adjustment->_rgbBlueAdjustment.isEnabled() &&
 				!adjustment->_rgbCyanAdjustment.isEnabled() &&
 				!adjustment->_rgbMagentaAdjustment.isEnabled() &&
 				!adjustment->_rgbYellowAdjustment.isEnabled() &&
-				!adjustment->_rgbWhiteAdjustment.isEnabled())
+				!adjustment->_rgbWhiteAdjustment.isEnabled();
+		}
+
+		if (table.satLumGrid)
+		{
+			table.grid.resize(GRID_NODES * GRID_NODES * GRID_NODES * 3);
+
+			uint8_t* target = table.grid.data();
+			for (int b = 0; b < GRID_NODES; b++)
+				for (int g = 0; g < GRID_NODES; g++)
+					for (int r = 0; r < GRID_NODES; r++)
+					{
+						uint8_t red = gridNode(r), green = gridNode(g), blue = gridNode(b);
+						adjustment->_rgbTransform.transformSatLum(red, green, blue);
+						*(target++) = red;
+						*(target++) = green;
+						*(target++) = blue;
+					}
+		}
+
+		if (table.channels)
+		{
+			// a gray input gives all three mappings at once
+			for (int i = 0; i < 256; i++)
 			{
-				color.red = ored;
-				color.green = ogreen;
-				color.blue = oblue;
-				if (B_RGB != 255)
-				{
-					color.red = ((uint32_t)color.red * B_RGB)/255;
-					color.green = ((uint32_t)color.green * B_RGB) / 255;
-					color.blue = ((uint32_t)color.blue * B_RGB) / 255;
-				}
-				continue;
+				ColorRgb color(i, i, i);
+				adjustColor(adjustment, color, true);
+				table.channel[0][i] = color.red;
+				table.channel[1][i] = color.green;
+				table.channel[2][i] = color.blue;
 			}
+		}
+
+		Debug(_log, "Color adjustment '%s': saturation/luminance grid: %s, channel tables: %s", QSTRING_CSTR(adjustment->_id),
+			(table.satLumGrid) ? "yes" : "no", (table.channels) ? "yes" : "no");
+	}
+
+	for (size_t i = 0; i < _ledAdjustments.size(); i++)
+		for (size_t a = 0; a < _adjustment.size(); a++)
+			if (_ledAdjustments[i] == _adjustment[a])
+			{
+				_ledTables[i] = &_tables[a];
+				break;
+			}
+
+	// input value -> grid cell and the 8-bit position inside it
+	for (int i = 0; i < 256; i++)
+	{
+		int pos = (i * (GRID_NODES - 1) * 256) / 255;
+		int cell = qMin(pos >> 8, GRID_NODES - 2);
+		_gridCell[i] = static_cast<uint8_t>(cell);
+		_gridFraction[i] = static_cast<uint16_t>(pos - (cell << 8));
+	}
+
+	_tablesValid = true;
+}
+
+uint8_t MultiColorAdjustment::gridNode(int index)
+{
+	return static_cast<uint8_t>((index * 255 + (GRID_NODES - 1) / 2) / (GRID_NODES - 1));
+}
 
-			uint32_t nrng = (uint32_t)(255 - ored) * (255 - ogreen);
-			uint32_t rng = (uint32_t)(ored) * (255 - ogreen);
-			uint32_t nrg = (uint32_t)(255 - ored) * (ogreen);
-			uint32_t rg = (uint32_t)(ored) * (ogreen);
-
-			uint8_t black = nrng * (255 - oblue) / 65025;
-			uint8_t red = rng * (255 - oblue) / 65025;
-			uint8_t green = nrg * (255 - oblue) / 65025;
-			uint8_t blue = nrng * (oblue) / 65025;
-			uint8_t cyan = nrg * (oblue) / 65025;
-			uint8_t magenta = rng * (oblue) / 65025;
-			uint8_t yellow = rg * (255 - oblue) / 65025;
-			uint8_t white = rg * (oblue) / 65025;
-
-			uint8_t OR, OG, OB, RR, RG, RB, GR, GG, GB, BR, BG, BB;
-			uint8_t CR, CG, CB, MR, MG, MB, YR, YG, YB, WR, WG, WB;
-
-			adjustment->_rgbBlackAdjustment.apply(black, 255, OR, OG, OB);
-			adjustment->_rgbRedAdjustment.apply(red, B_RGB, RR, RG, RB);
-			adjustment->_rgbGreenAdjustment.apply(green, B_RGB, GR, GG, GB);
-			adjustment->_rgbBlueAdjustment.apply(blue, B_RGB, BR, BG, BB);
-			adjustment->_rgbCyanAdjustment.apply(cyan, B_CMY, CR, CG, CB);
-			adjustment->_rgbMagentaAdjustment.apply(magenta, B_CMY, MR, MG, MB);
-			adjustment->_rgbYellowAdjustment.apply(yellow, B_CMY, YR, YG, YB);
-			adjustment->_rgbWhiteAdjustment.apply(white, B_W, WR, WG, WB);
-
-			color.red = OR + RR + GR + BR + CR + MR + YR + WR;
-			color.green = OG + RG + GG + BG + CG + MG + YG + WG;
-			color.blue = OB + RB + GB + BB + CB + MB + YB + WB;
+void MultiColorAdjustment::applyGrid(const AdjustmentTable& table, ColorRgb& color) const
+{
+	// trilinear interpolation between the 8 nodes of the cell in 8-bit fixed point
+	const uint32_t fr = _gridFraction[color.red], fg = _gridFraction[color.green], fb = _gridFraction[color.blue];
+	const size_t strideG = GRID_NODES * 3, strideB = GRID_NODES * GRID_NODES * 3;
+	const uint8_t* p000 = table.grid.data() + _gridCell[color.blue] * strideB + _gridCell[color.green] * strideG + _gridCell[color.red] * 3;
+	const uint8_t* p010 = p000 + strideG;
+	const uint8_t* p001 = p000 + strideB;
+	const uint8_t* p011 = p001 + strideG;
+
+	uint8_t result[3];
+	for (int c = 0; c < 3; c++)
+	{
+		uint32_t c00 = p000[c] * (256 - fr) + p000[c + 3] * fr;
+		uint32_t c10 = p010[c] * (256 - fr) + p010[c + 3] * fr;
+		uint32_t c01 = p001[c] * (256 - fr) + p001[c + 3] * fr;
+		uint32_t c11 = p011[c] * (256 - fr) + p011[c + 3] * fr;
+		uint32_t c0 = c00 * (256 - fg) + c10 * fg;
+		uint32_t c1 = c01 * (256 - fg) + c11 * fg;
+		result[c] = static_cast<uint8_t>((c0 * (256 - fb) + c1 * fb + (1u << 23)) >> 24);
+	}
+
+	color.red = result[0];
+	color.green = result[1];
+	color.blue = result[2];
+}
+
+void MultiColorAdjustment::applyAdjustment(std::vector<ColorRgb>& ledColors)
+{
+	if (!_tablesValid)
+		bakeTables();
+
+	const size_t itCnt = qMin(_ledTables.size(), ledColors.size());
+	for (size_t i = 0; i < itCnt; ++i)
+	{
+		AdjustmentTable* table = _ledTables[i];
+		if (table == nullptr)
+		{
+			// No transform set for this led (do nothing)
+			continue;
+		}
+
+		ColorRgb& color = ledColors[i];
+
+		if (table->satLumGrid)
+			applyGrid(*table, color);
+
+		if (table->channels)
+		{
+			color.red = table->channel[0][color.red];
+			color.green = table->channel[1][color.green];
+			color.blue = table->channel[2][color.blue];
 		}
+		else
+			adjustColor(table->adjustment, color, table->satLumGrid);
 	}
 }
 
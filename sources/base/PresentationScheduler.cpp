@@ -0,0 +1,172 @@
+/* PresentationScheduler.cpp
+*
+*  MIT License
+*
+*  Copyright (c) 2023 awawa-dev
+*
+*  Project homesite: https://github.com/awawa-dev/HyperHDR
+*
+*  Permission is hereby granted, free of charge, to any person obtaining a copy
+*  of this software and associated documentation files (the "Software"), to deal
+*  in the Software without restriction, including without limitation the rights
+*  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+*  copies of the Software, and to permit persons to whom the Software is
+*  furnished to do so, subject to the following conditions:
+*
+*  The above copyright notice and this permission notice shall be included in all
+*  copies or substantial portions of the Software.
+
+*  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+*  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+*  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+*  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+*  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+*  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+*  SOFTWARE.
+*/
+
+#include <base/PresentationScheduler.h>
+#include <base/HyperHdrInstance.h>
+#include <utils/PreciseTimer.h>
+#include <utils/InternalClock.h>
+#include <utils/Logger.h>
+
+#include <algorithm>
+
+namespace
+{
+	const int MAX_DELAY = 500;
+}
+
+PresentationScheduler::PresentationScheduler(const QJsonDocument& config, HyperHdrInstance* hyperhdr)
+	: QObject(hyperhdr),
+	_hyperhdr(hyperhdr),
+	_log(Logger::getInstance(QString("SMOOTHING%1").arg(hyperhdr->getInstanceIndex()))),
+	_timer(new PreciseTimer(this)),
+	_delay(0),
+	_ring(RING_SIZE),
+	_head(0),
+	_count(0),
+	_captureTimestamp(0),
+	_captureAge(0),
+	_overflow(0)
+{
+	connect(_timer, &PreciseTimer::timeout, this, &PresentationScheduler::release);
+
+	handleSettingsUpdate(settings::type::SMOOTHING, config);
+}
+
+PresentationScheduler::~PresentationScheduler()
+{
+	_timer->stop();
+}
+
+int PresentationScheduler::delay() const
+{
+	return _delay;
+}
+
+void PresentationScheduler::handleSettingsUpdate(settings::type type, const QJsonDocument& config)
+{
+	if (type == settings::type::SMOOTHING)
+		setDelay(config.object()["avSyncDelay"].toInt(0));
+}
+
+void PresentationScheduler::setDelay(int delay)
+{
+	delay = std::min(std::max(delay, 0), MAX_DELAY);
+
+	if (_delay == delay)
+		return;
+
+	_delay = delay;
+	clear();
+
+	if (_delay > 0)
+		Info(_log, "A/V sync delay: the leds show the colors %i ms after the capture of the frame", _delay);
+	else
+		Info(_log, "A/V sync delay is disabled");
+}
+
+void PresentationScheduler::clear()
+{
+	_timer->stop();
+	_head = 0;
+	_count = 0;
+	_captureTimestamp = 0;
+	_captureAge = 0;
+}
+
+bool PresentationScheduler::schedule(const std::vector<ColorRgb>& ledValues, const FrameTrace& trace)
+{
+	if (_delay <= 0)
+		return false;
+
+	// a new source frame: how long it took to get here, the smoothing steps towards it reuse its offset
+	if (trace.timestamp != _captureTimestamp)
+	{
+		_captureTimestamp = trace.timestamp;
+		_captureAge = (trace.timestamp > 0) ? std::max(InternalClock::now() - trace.timestamp, int64_t(0)) : 0;
+	}
+
+	const qint64 now = PreciseTimer::now();
+	const qint64 showAt = now + std::max(_delay - _captureAge, int64_t(0)) * 1000000;
+
+	// the ring is full: the oldest frame goes out early rather than the newest one being lost
+	if (_count == RING_SIZE)
+	{
+		Slot& oldest = _ring[_head];
+		_head = (_head + 1) % RING_SIZE;
+		_count--;
+
+		if (_overflow++ == 0)
+			Warning(_log, "Too many led frames for the A/V sync delay, the oldest ones are written early");
+
+		_hyperhdr->presentLedDeviceData(oldest.colors, oldest.trace);
+	}
+
+	// the capacity of the slots is kept: no allocation once every slot was used
+	Slot& slot = _ring[(_head + _count) % RING_SIZE];
+	slot.colors.assign(ledValues.begin(), ledValues.end());
+	slot.trace = trace;
+	slot.showAt = std::max(showAt, (_count > 0) ? _ring[(_head + _count - 1) % RING_SIZE].showAt : 0);
+	_count++;
+
+	if (_count == 1)
+		arm(now);
+
+	return true;
+}
+
+void PresentationScheduler::release()
+{
+	const qint64 now = PreciseTimer::now();
+
+	// the deadlines of the timer are whole milliseconds: a frame due within the next half of one goes out now
+	while (_count > 0 && _ring[_head].showAt <= now + 500000)
+	{
+		Slot& slot = _ring[_head];
+		_head = (_head + 1) % RING_SIZE;
+		_count--;
+
+		_hyperhdr->presentLedDeviceData(slot.colors, slot.trace);
+	}
+
+	arm(now);
+}
+
+void PresentationScheduler::arm(qint64 now)
+{
+	if (_count == 0)
+	{
+		_timer->stop();
+		return;
+	}
+
+	const qint64 wait = std::max((_ring[_head].showAt - now + 500000) / 1000000, qint64(1));
+
+	// a running timer starts again with the new interval
+	_timer->setInterval(static_cast<int>(wait));
+	if (!_timer->isActive())
+		_timer->start();
+}
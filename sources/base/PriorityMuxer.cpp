@@ -10,12 +10,47 @@
 
 // utils
 #include <utils/Logger.h>
+#include <utils/ImagePyramid.h>
 
 const int PriorityMuxer::LOWEST_PRIORITY = std::numeric_limits<uint8_t>::max();
 
 const int PriorityMuxer::HIGHEST_EFFECT_PRIORITY = 0;
 const int PriorityMuxer::LOWEST_EFFECT_PRIORITY = 254;
 
+namespace
+{
+	/// the width of the preview kept for a hidden input
+	const unsigned PREVIEW_WIDTH = 320;
+
+	///
+	/// @brief Nearest neighbour downscale of the image to PREVIEW_WIDTH, the preview buffer is reused when it's free
+	///
+	void makePreview(const Image<ColorRgb>& image, Image<ColorRgb>& preview)
+	{
+		const unsigned factor = (image.width() + PREVIEW_WIDTH - 1) / PREVIEW_WIDTH;
+		const unsigned width = image.width() / factor;
+		const unsigned height = std::max(image.height() / factor, 1u);
+
+		if (preview.isShared() || preview.width() != width || preview.height() != height)
+			preview = Image<ColorRgb>(width, height);
+
+		// the level of the frame pyramid does the power of two part of the reduction
+		int step = static_cast<int>(factor);
+		const Image<ColorRgb> level = ImagePyramid::level(image, step);
+		const ColorRgb* source = reinterpret_cast<const ColorRgb*>(level.rawMem());
+		ColorRgb* target = reinterpret_cast<ColorRgb*>(preview.rawMem());
+
+		for (unsigned y = 0; y < height; y++)
+		{
+			const ColorRgb* line = source + static_cast<size_t>(y) * step * level.width();
+			for (unsigned x = 0; x < width; x++)
+				*(target++) = line[x * step];
+		}
+
+		preview.setTimestamp(image.timestamp());
+	}
+}
+
 PriorityMuxer::PriorityMuxer(int instanceIndex, int ledCount, QObject* parent)
 	: QObject(parent)
 	, _log(Logger::getInstance(QString("MUXER%1").arg(instanceIndex)))
@@ -25,6 +60,8 @@ PriorityMuxer::PriorityMuxer(int instanceIndex, int ledCount, QObject* parent)
 	, _activeInputs()
 	, _lowestPriorityInfo()
 	, _sourceAutoSelectEnabled(true)
+	, _memory(MemoryAccounting::MUXER)
+	, _enabled(true)
 	, _updateTimer(new QTimer(this))
 	, _timer(new QTimer(this))
 	, _blockTimer(new QTimer(this))
@@ -38,6 +75,7 @@ PriorityMuxer::PriorityMuxer(int instanceIndex, int ledCount, QObject* parent)
 	_lowestPriorityInfo.owner = "";
 
 	_activeInputs[PriorityMuxer::LOWEST_PRIORITY] = _lowestPriorityInfo;
+	updateMemory();
 
 	// adapt to 1s interval for COLOR and EFFECT timeouts > -1
 	connect(_timer, &QTimer::timeout, this, &PriorityMuxer::timeTrigger);
@@ -47,10 +85,10 @@ PriorityMuxer::PriorityMuxer(int instanceIndex, int ledCount, QObject* parent)
 	connect(this, &PriorityMuxer::timeRunner, this, &PriorityMuxer::prioritiesChanged);
 	connect(this, &PriorityMuxer::signalTimeTrigger, this, &PriorityMuxer::timeTrigger);
 
-	// start muxer timer
+	// the timer is set by the timeouts, there is nothing to poll
 	connect(_updateTimer, &QTimer::timeout, this, &PriorityMuxer::setCurrentTime);
-	_updateTimer->setInterval(250);
-	_updateTimer->start();
+	_updateTimer->setSingleShot(true);
+	_updateTimer->setTimerType(Qt::PreciseTimer);
 }
 
 PriorityMuxer::~PriorityMuxer()
@@ -59,7 +97,49 @@ PriorityMuxer::~PriorityMuxer()
 
 void PriorityMuxer::setEnable(bool enable)
 {
-	enable ? _updateTimer->start() : _updateTimer->stop();
+	_enabled = enable;
+	enable ? _updateTimer->start(0) : _updateTimer->stop();
+}
+
+void PriorityMuxer::queueTimeout(int priority, int64_t previous)
+{
+	const int64_t timeout = _activeInputs[priority].timeoutTime_ms;
+
+	// a later timeout of the same input is found by the entry already queued
+	if (timeout <= 0 || (previous > 0 && previous <= timeout))
+		return;
+
+	_timeouts.emplace(timeout, priority);
+
+	const int delay = static_cast<int>(std::min(std::max(timeout - InternalClock::now(), (int64_t)0), (int64_t)std::numeric_limits<int>::max()));
+	if (_enabled && (!_updateTimer->isActive() || _updateTimer->remainingTime() > delay))
+		_updateTimer->start(delay);
+}
+
+void PriorityMuxer::updateMemory()
+{
+	size_t memory = 0;
+
+	for (const InputInfo& input : _activeInputs)
+		memory += input.image.size() + input.ledColors.capacity() * sizeof(ColorRgb);
+
+	_memory.set(memory);
+}
+
+void PriorityMuxer::scheduleTimeout(int64_t now, bool timedRunner)
+{
+	if (!_enabled)
+		return;
+
+	int64_t next = (timedRunner) ? now + 1000 : -1;
+
+	if (!_timeouts.empty() && (next < 0 || _timeouts.top().first < next))
+		next = _timeouts.top().first;
+
+	if (next < 0)
+		_updateTimer->stop();
+	else
+		_updateTimer->start(static_cast<int>(std::min(std::max(next - now, (int64_t)0), (int64_t)std::numeric_limits<int>::max())));
 }
 
 bool PriorityMuxer::setInputImage(int priority, const Image<ColorRgb>& image, int64_t timeout_ms)
@@ -88,10 +168,17 @@ bool PriorityMuxer::setInputImage(int priority, const Image<ColorRgb>& image, in
 		activeChange = true;
 	}
 
-	// update input
+	// update input, a hidden input keeps only a preview for the moment it becomes visible
+	const bool hidden = priority > _currentPriority || (!_sourceAutoSelectEnabled && priority != _currentPriority);
+	const int64_t previous = input.timeoutTime_ms;
 	input.timeoutTime_ms = timeout_ms;
-	input.image = image;
+	if (hidden && image.width() > PREVIEW_WIDTH)
+		makePreview(image, input.image);
+	else
+		input.image = image;
 	input.ledColors.clear();
+	queueTimeout(priority, previous);
+	updateMemory();
 
 	// emit active change
 	if (activeChange)
@@ -184,7 +271,8 @@ const QMap<int, PriorityMuxer::InputInfo>& PriorityMuxer::getInputInfoTable() co
 
 hyperhdr::Components PriorityMuxer::getComponentOfPriority(int priority) const
 {
-	return _activeInputs[priority].componentId;
+	auto elemIt = _activeInputs.find(priority);
+	return (elemIt != _activeInputs.end()) ? elemIt->componentId : hyperhdr::COMP_INVALID;
 }
 
 void PriorityMuxer::updateLedsValues(int priority, const std::vector<ColorRgb>& ledColors)
@@ -224,9 +312,12 @@ bool PriorityMuxer::setInput(int priority, const std::vector<ColorRgb>& ledColor
 	}
 
 	// update input
+	const int64_t previous = input.timeoutTime_ms;
 	input.timeoutTime_ms = timeout_ms;
 	input.ledColors = ledColors;
-	input.image = Image<ColorRgb>();
+	input.image = _emptyImage;
+	queueTimeout(priority, previous);
+	updateMemory();
 
 	// emit active change
 	if (activeChange)
@@ -277,8 +368,7 @@ void PriorityMuxer::registerInput(int priority, hyperhdr::Components component,
 
 bool PriorityMuxer::setInputInactive(int priority)
 {
-	Image<ColorRgb> image;
-	return setInputImage(priority, image, -100);
+	return setInputImage(priority, _emptyImage, -100);
 }
 
 bool PriorityMuxer::clearInput(int priority)
@@ -288,6 +378,7 @@ bool PriorityMuxer::clearInput(int priority)
 		if (_activeInputs.remove(priority))
 		{
 			Info(_log, "Removed source priority %d", priority);
+			updateMemory();
 			// on clear success update _currentPriority
 			setCurrentTime();
 		}
@@ -304,8 +395,10 @@ void PriorityMuxer::clearAll(bool forceClearAll)
 	{
 		_previousPriority = _currentPriority;
 		_activeInputs.clear();
+		_timeouts = decltype(_timeouts)();
 		_currentPriority = PriorityMuxer::LOWEST_PRIORITY;
 		_activeInputs[_currentPriority] = _lowestPriorityInfo;
+		updateMemory();
 	}
 	else
 	{
@@ -323,33 +416,53 @@ void PriorityMuxer::clearAll(bool forceClearAll)
 void PriorityMuxer::setCurrentTime()
 {
 	const int64_t now = InternalClock::now();
-	int newPriority;
-	_activeInputs.contains(0) ? newPriority = 0 : newPriority = PriorityMuxer::LOWEST_PRIORITY;
 
-	for (auto infoIt = _activeInputs.begin(); infoIt != _activeInputs.end();)
+	// the expired timeouts
+	while (!_timeouts.empty() && _timeouts.top().first <= now)
 	{
-		if (infoIt->timeoutTime_ms > 0 && infoIt->timeoutTime_ms <= now)
+		const int priority = _timeouts.top().second;
+		_timeouts.pop();
+
+		auto infoIt = _activeInputs.find(priority);
+		if (infoIt == _activeInputs.end() || infoIt->timeoutTime_ms <= 0)
+			continue;
+
+		if (infoIt->timeoutTime_ms > now)
 		{
-			int tPrio = infoIt->priority;
-			infoIt = _activeInputs.erase(infoIt);
-			Info(_log, "Timeout clear for priority %d", tPrio);
-			emit prioritiesChanged();
+			// the input was updated with a later timeout
+			_timeouts.emplace(infoIt->timeoutTime_ms, priority);
+			continue;
 		}
-		else
-		{
-			// timeoutTime of -100 is awaiting data (inactive); skip
-			if (infoIt->timeoutTime_ms > -100)
-				newPriority = qMin(newPriority, infoIt->priority);
 
-			// call timeTrigger when effect or color is running with timeout > 0, blacklist prio 255
-			if (infoIt->priority < PriorityMuxer::LOWEST_EFFECT_PRIORITY &&
-				infoIt->timeoutTime_ms > 0 &&
-				(infoIt->componentId == hyperhdr::COMP_EFFECT || infoIt->componentId == hyperhdr::COMP_COLOR || infoIt->componentId == hyperhdr::COMP_IMAGE))
-				emit signalTimeTrigger(); // as signal to prevent Threading issues
+		_activeInputs.erase(infoIt);
+		Info(_log, "Timeout clear for priority %d", priority);
+		updateMemory();
+		emit prioritiesChanged();
+	}
+
+	const QMap<int, InputInfo>& inputs = _activeInputs;
+	bool timedRunner = false;
+	int newPriority = PriorityMuxer::LOWEST_PRIORITY;
 
-			++infoIt;
-		}
+	// the map is ordered by the priority: the first active one is visible (0 even if inactive)
+	for (auto infoIt = inputs.begin(); infoIt != inputs.end(); ++infoIt)
+	{
+		// timeoutTime of -100 is awaiting data (inactive); skip
+		if (newPriority == PriorityMuxer::LOWEST_PRIORITY && (infoIt->priority == 0 || infoIt->timeoutTime_ms > -100))
+			newPriority = infoIt->priority;
+
+		// call timeTrigger when effect or color is running with timeout > 0, blacklist prio 255
+		if (infoIt->priority < PriorityMuxer::LOWEST_EFFECT_PRIORITY &&
+			infoIt->timeoutTime_ms > 0 &&
+			(infoIt->componentId == hyperhdr::COMP_EFFECT || infoIt->componentId == hyperhdr::COMP_COLOR || infoIt->componentId == hyperhdr::COMP_IMAGE))
+			timedRunner = true;
 	}
+
+	if (timedRunner)
+		emit signalTimeTrigger(); // as signal to prevent Threading issues
+
+	scheduleTimeout(now, timedRunner);
+
 	// evaluate, if manual selected priority is still available
 	if (!_sourceAutoSelectEnabled)
 	{
@@ -0,0 +1,222 @@
+/* QualityGovernor.cpp
+*
+*  MIT License
+*
+*  Copyright (c) 2023 awawa-dev
+*
+*  Project homesite: https://github.com/awawa-dev/HyperHDR
+*
+*  Permission is hereby granted, free of charge, to any person obtaining a copy
+*  of this software and associated documentation files (the "Software"), to deal
+*  in the Software without restriction, including without limitation the rights
+*  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+*  copies of the Software, and to permit persons to whom the Software is
+*  furnished to do so, subject to the following conditions:
+*
+*  The above copyright notice and this permission notice shall be included in all
+*  copies or substantial portions of the Software.
+
+*  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+*  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+*  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+*  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+*  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+*  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+*  SOFTWARE.
+*/
+
+
+#include <QCoreApplication>
+
+#include <base/QualityGovernor.h>
+#include <base/ImageProcessingUnit.h>
+#include <utils/PerformanceCounters.h>
+#include <utils/InternalClock.h>
+
+namespace
+{
+	const int POLL_INTERVAL_MS = 5000;
+
+	/// a step down needs 15 seconds of pressure, a step back up a minute without it
+	const int PRESSURE_POLLS = 3;
+	const int RELIEF_POLLS = 12;
+
+	/// the relief is below the limits by these margins, so the level doesn't oscillate around them
+	const double CPU_RELIEF_MARGIN = 15;
+	const double TEMPERATURE_RELIEF_MARGIN = 5;
+
+	/// share of the frames dropped by the latency budget, too few frames tell nothing
+	const double OVER_BUDGET_PRESSURE = 0.05;
+	const double OVER_BUDGET_RELIEF = 0.01;
+	const qint64 OVER_BUDGET_MIN_FRAMES = 25;
+
+	const char* levelName(int level)
+	{
+		switch (level)
+		{
+			case QualityGovernor::FULL_QUALITY: return "full quality";
+			case QualityGovernor::SPARSE_PROCESSING: return "sparse processing";
+			case QualityGovernor::FRAME_DECIMATION: return "frame decimation";
+			case QualityGovernor::MJPEG_SCALE: return "smaller MJPEG scale";
+			case QualityGovernor::IMAGE_STREAM_RATE: return "slower image stream";
+			default: return "unknown";
+		}
+	}
+}
+
+std::unique_ptr<QualityGovernor> QualityGovernor::_instance;
+std::atomic<int> QualityGovernor::_level(QualityGovernor::FULL_QUALITY);
+
+QualityGovernor::QualityGovernor()
+	: _log(Logger::getInstance("GOVERNOR"))
+	, _enabled(false)
+	, _cpuLimit(90)
+	, _temperatureLimit(75)
+	, _pressurePolls(0)
+	, _reliefPolls(0)
+	, _lastReportToken(-1)
+{
+	_timer.setInterval(POLL_INTERVAL_MS);
+	connect(&_timer, &QTimer::timeout, this, &QualityGovernor::poll);
+}
+
+QualityGovernor* QualityGovernor::getInstance()
+{
+	if (_instance == nullptr)
+	{
+		_instance = std::unique_ptr<QualityGovernor>(new QualityGovernor());
+
+		// the timer and the readings of the system live in the main thread, the level is read from any thread
+		if (QCoreApplication::instance() != nullptr)
+			_instance->moveToThread(QCoreApplication::instance()->thread());
+	}
+
+	return _instance.get();
+}
+
+void QualityGovernor::configure(bool enabled, int cpuLimit, int temperatureLimit)
+{
+	_cpuLimit = qBound(10, cpuLimit, 100);
+	_temperatureLimit = qBound(40, temperatureLimit, 110);
+
+	if (_enabled == enabled)
+		return;
+
+	_enabled = enabled;
+	_pressurePolls = 0;
+	_reliefPolls = 0;
+
+	if (_enabled)
+	{
+		Info(_log, "Quality governor is enabled (CPU limit: %i%%, temperature limit: %i C)", _cpuLimit, _temperatureLimit);
+
+		// the first readings start the measurement periods
+		qint64 processed = 0, overBudget = 0;
+		ImageProcessingUnit::takeBudgetCounters(processed, overBudget);
+		_system.getCPU();
+		_system.getUNDERVOLATGE();
+		_timer.start();
+	}
+	else
+	{
+		Info(_log, "Quality governor is disabled");
+		_timer.stop();
+		setLevel(FULL_QUALITY, "disabled");
+		emit PerformanceCounters::getInstance()->removeCounter(static_cast<int>(PerformanceReportType::QUALITY_GOVERNOR), -1);
+		_lastReportToken = -1;
+	}
+}
+
+void QualityGovernor::poll()
+{
+	_system.getCPU();
+	_system.getTEMP();
+	const bool underVoltage = _system.getUNDERVOLATGE().startsWith('1');
+	const SystemPerformanceCounters::Readings& readings = _system.getReadings();
+
+	qint64 processed = 0, overBudget = 0;
+	ImageProcessingUnit::takeBudgetCounters(processed, overBudget);
+	const qint64 frames = processed + overBudget;
+	const double overBudgetShare = (frames >= OVER_BUDGET_MIN_FRAMES) ? static_cast<double>(overBudget) / frames : 0;
+
+	QString reason;
+
+	if (underVoltage)
+		reason = "under-voltage";
+	else if (readings.temperature >= _temperatureLimit)
+		reason = QString("temperature %1 C").arg(readings.temperature, 0, 'f', 1);
+	else if (readings.cpuUsage >= _cpuLimit)
+		reason = QString("CPU usage %1%").arg(readings.cpuUsage, 0, 'f', 0);
+	else if (overBudgetShare >= OVER_BUDGET_PRESSURE)
+		reason = QString("%1% of the frames over the latency budget").arg(overBudgetShare * 100, 0, 'f', 0);
+
+	const bool relief = !underVoltage &&
+		readings.temperature < _temperatureLimit - TEMPERATURE_RELIEF_MARGIN &&
+		readings.cpuUsage < _cpuLimit - CPU_RELIEF_MARGIN &&
+		overBudgetShare < OVER_BUDGET_RELIEF;
+
+	if (!reason.isEmpty())
+	{
+		_reliefPolls = 0;
+		if (++_pressurePolls >= PRESSURE_POLLS && _level < MAX_LEVEL)
+		{
+			_pressurePolls = 0;
+			setLevel(_level + 1, reason);
+		}
+	}
+	else if (relief)
+	{
+		_pressurePolls = 0;
+		if (++_reliefPolls >= RELIEF_POLLS && _level > FULL_QUALITY)
+		{
+			_reliefPolls = 0;
+			setLevel(_level - 1, "the system load is back to normal");
+		}
+	}
+	else
+	{
+		// between the limits: the level holds
+		_pressurePolls = 0;
+		_reliefPolls = 0;
+	}
+
+	if (_lastReportToken != PerformanceCounters::currentToken())
+		report();
+}
+
+void QualityGovernor::setLevel(int level, const QString& reason)
+{
+	level = qBound(static_cast<int>(FULL_QUALITY), level, static_cast<int>(MAX_LEVEL));
+
+	const int previous = _level.exchange(level);
+
+	if (previous == level)
+		return;
+
+	_lastReason = reason;
+
+	if (level > previous)
+		Warning(_log, "Lowering the quality to level %i (%s): %s", level, levelName(level), QSTRING_CSTR(reason));
+	else
+		Info(_log, "Restoring the quality to level %i (%s): %s", level, levelName(level), QSTRING_CSTR(reason));
+
+	emit levelChanged(level);
+
+	if (_enabled)
+		report();
+}
+
+void QualityGovernor::report()
+{
+	const SystemPerformanceCounters::Readings& readings = _system.getReadings();
+
+	_lastReportToken = PerformanceCounters::currentToken();
+
+	QString name = levelName(_level);
+	if (_level > FULL_QUALITY && !_lastReason.isEmpty())
+		name += QString(" (%1)").arg(_lastReason);
+
+	emit PerformanceCounters::getInstance()->newCounter(
+		PerformanceReport(static_cast<int>(PerformanceReportType::QUALITY_GOVERNOR), _lastReportToken, name, _level,
+			static_cast<qint64>(readings.cpuUsage), static_cast<qint64>(readings.temperature), MAX_LEVEL));
+}
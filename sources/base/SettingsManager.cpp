@@ -12,8 +12,41 @@
 // write config to filesystem
 #include <utils/JsonUtils.h>
 
+#include <QCryptographicHash>
+
 QJsonObject SettingsManager::schemaJson;
 
+namespace
+{
+	// the hashes of the sections validated last time, per instance
+	const QString VALIDATION_RECORD = "schemaValidation";
+}
+
+QString SettingsManager::schemaHash()
+{
+	static const QString hash = QString(QCryptographicHash::hash(QJsonDocument(schemaJson).toJson(QJsonDocument::Compact), QCryptographicHash::Sha1).toHex());
+	return hash;
+}
+
+QString SettingsManager::sectionHash(const QJsonValue& section)
+{
+	const QByteArray data = section.isArray() ? QJsonDocument(section.toArray()).toJson(QJsonDocument::Compact) : QJsonDocument(section.toObject()).toJson(QJsonDocument::Compact);
+	return QString(QCryptographicHash::hash(data, QCryptographicHash::Sha1).toHex());
+}
+
+void SettingsManager::saveValidation()
+{
+	QJsonObject sections;
+	for (const auto& key : _qconfig.keys())
+		sections[key] = sectionHash(_qconfig[key]);
+
+	QJsonObject validated;
+	validated["schema"] = schemaHash();
+	validated["sections"] = sections;
+
+	_sTable->createSettingsRecord(VALIDATION_RECORD, QString(QJsonDocument(validated).toJson(QJsonDocument::Compact)));
+}
+
 SettingsManager::SettingsManager(quint8 instance, QObject* parent, bool readonlyMode)
 	: QObject(parent)
 	, _log(Logger::getInstance("SETTINGSMGR"))
@@ -61,7 +94,8 @@ SettingsManager::SettingsManager(quint8 instance, QObject* parent, bool readonly
 		}
 	}
 
-	// fill database with default data if required
+	// fill database with default data if required, in one transaction
+	_sTable->startTransaction();
 	for (const auto& key : keyList)
 	{
 		QString val = defValueList.takeFirst();
@@ -69,6 +103,7 @@ SettingsManager::SettingsManager(quint8 instance, QObject* parent, bool readonly
 		if (!_sTable->recordExist(key))
 			_sTable->createSettingsRecord(key, val);
 	}
+	_sTable->commitTransaction();
 
 	// need to validate all data in database constuct the entire data object
 	// TODO refactor schemaChecker to accept QJsonArray in validate(); QJsonDocument container? To validate them per entry...
@@ -98,29 +133,63 @@ SettingsManager::SettingsManager(quint8 instance, QObject* parent, bool readonly
 			dbConfig[key] = doc.object();
 	}
 
-	// validate full dbconfig against schema, on error we need to rewrite entire table
-	QJsonSchemaChecker schemaChecker;
-	schemaChecker.setSchema(schemaJson);
-	QPair<bool, bool> valid = schemaChecker.validate(dbConfig);
-	// check if our main schema syntax is IO
-	if (!valid.second)
+	// only the sections that changed since the last validation with this schema are validated again
+	const QJsonObject validated = _sTable->getSettingsRecord(VALIDATION_RECORD).object();
+	const bool schemaChanged = (validated["schema"].toString() != schemaHash());
+	const QJsonObject validatedSections = validated["sections"].toObject();
+
+	QJsonObject changedConfig;
+	for (const auto& key : keyList)
+		if (schemaChanged || validatedSections[key].toString() != sectionHash(dbConfig[key]))
+			changedConfig[key] = dbConfig[key];
+
+	if (changedConfig.isEmpty())
 	{
-		for (auto& schemaError : schemaChecker.getMessages())
-			Error(_log, "Schema Syntax Error: %s", QSTRING_CSTR(schemaError));
-		throw std::runtime_error("The config schema has invalid syntax. This should never happen! Go fix it!");
+		Debug(_log, "The configuration has not changed since the last validation");
+		_qconfig = dbConfig;
 	}
-	if (!valid.first)
+	else
 	{
-		Info(_log, "Table upgrade required...");
-		dbConfig = schemaChecker.getAutoCorrectedConfig(dbConfig);
+		// validate the changed sections against their part of the schema, on error we need to rewrite entire table
+		QJsonObject partialSchema = schemaJson;
+		if (!schemaChanged)
+		{
+			QJsonObject properties;
+			for (const auto& key : changedConfig.keys())
+				properties[key] = schemaJson["properties"].toObject()[key];
+			partialSchema["properties"] = properties;
+		}
 
-		for (auto& schemaError : schemaChecker.getMessages())
-			Warning(_log, "Config Fix: %s", QSTRING_CSTR(schemaError));
+		Debug(_log, "Validating %d of %d configuration sections", changedConfig.size(), keyList.size());
+
+		QJsonSchemaChecker schemaChecker;
+		schemaChecker.setSchema(partialSchema);
+		QPair<bool, bool> valid = schemaChecker.validate(changedConfig);
+		// check if our main schema syntax is IO
+		if (!valid.second)
+		{
+			for (auto& schemaError : schemaChecker.getMessages())
+				Error(_log, "Schema Syntax Error: %s", QSTRING_CSTR(schemaError));
+			throw std::runtime_error("The config schema has invalid syntax. This should never happen! Go fix it!");
+		}
+		if (!valid.first)
+		{
+			Info(_log, "Table upgrade required...");
+			changedConfig = schemaChecker.getAutoCorrectedConfig(changedConfig);
+
+			for (auto& schemaError : schemaChecker.getMessages())
+				Warning(_log, "Config Fix: %s", QSTRING_CSTR(schemaError));
 
-		saveSettings(dbConfig, true);
+			for (const auto& key : changedConfig.keys())
+				dbConfig[key] = changedConfig[key];
+
+			saveSettings(dbConfig, true);
+		}
+		else
+			_qconfig = dbConfig;
+
+		saveValidation();
 	}
-	else
-		_qconfig = dbConfig;
 
 	Info(_log, "Settings database initialized");
 }
@@ -185,7 +254,11 @@ bool SettingsManager::saveSettings(QJsonObject config, bool correct)
 	}
 
 	int rc = true;
+	QList<QPair<settings::type, QString>> changes;
+
 	// compare database data with new data to emit/save changes accordingly
+	// a save of the whole UI config is one transaction, so one commit to the storage instead of one for every section
+	_sTable->startTransaction();
 	for (const auto& key : keyList)
 	{
 		QString data = newValueList.takeFirst();
@@ -199,10 +272,21 @@ bool SettingsManager::saveSettings(QJsonObject config, bool correct)
 			}
 			else
 			{
-				emit settingsChanged(settings::stringToType(key), QJsonDocument::fromJson(data.toUtf8()));
+				changes.append(qMakePair(settings::stringToType(key), data));
 			}
 		}
 	}
+	if (!_sTable->commitTransaction())
+		rc = false;
+
+	// the components are notified once the data is stored
+	for (const auto& change : changes)
+		emit settingsChanged(change.first, QJsonDocument::fromJson(change.second.toUtf8()));
+
+	// the saved config has passed the validation, the next start doesn't need to repeat it
+	if (rc)
+		saveValidation();
+
 	return rc;
 }
 
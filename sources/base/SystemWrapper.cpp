@@ -31,6 +31,7 @@
 
 #include <utils/GlobalSignals.h>
 #include <utils/QStringUtils.h>
+#include <utils/ImagePyramid.h>
 #include <base/HyperHdrIManager.h>
 
 #include <QTimer>
@@ -43,6 +44,7 @@ SystemWrapper::SystemWrapper(const QString& grabberName, Grabber* ggrabber)
 	, _log(Logger::getInstance(grabberName))
 	, _configLoaded(false)
 	, _grabber(ggrabber)
+	, _lightSleep(false)
 {
 	SystemWrapper::instance = this;
 
@@ -52,10 +54,25 @@ SystemWrapper::SystemWrapper(const QString& grabberName, Grabber* ggrabber)
 
 	// listen for source requests
 	connect(GlobalSignals::getInstance(), &GlobalSignals::requestSource, this, &SystemWrapper::handleSourceRequest);
+
+	// listen for the part of the frame the instances don't use
+	connect(GlobalSignals::getInstance(), &GlobalSignals::requestCaptureRegion, this, &SystemWrapper::handleRegionRequest);
+
+	// the light sleep of the system stops only the capture
+	connect(GlobalSignals::getInstance(), &GlobalSignals::lightSleep, this, &SystemWrapper::handleLightSleep);
 }
 
 void SystemWrapper::newFrame(const Image<ColorRgb>& image)
 {
+	// no driver timestamp for the system grabbers and some of them reuse the image: always use the arrival time
+	// (the copy shares the metadata with the source image)
+	Image<ColorRgb> stamped = image;
+	stamped.setTimestamp(InternalClock::now());
+	const int64_t arrival = FrameTrace::now();
+	stamped.setCaptureTrace(arrival, arrival);
+
+	ImagePyramid::attach(image);
+
 	emit systemImage(_grabberName, image);
 }
 
@@ -83,6 +100,8 @@ void SystemWrapper::handleSourceRequest(hyperhdr::Components component, int hype
 		else if (!listen)
 			GRABBER_SYSTEM_CLIENTS.removeOne(hyperhdrInd);
 
+		updateUnusedArea();
+
 		if (GRABBER_SYSTEM_CLIENTS.empty())
 			stop();
 		else
@@ -90,6 +109,51 @@ void SystemWrapper::handleSourceRequest(hyperhdr::Components component, int hype
 	}
 }
 
+void SystemWrapper::handleLightSleep(bool sleep)
+{
+	if (sleep && !_lightSleep && !GRABBER_SYSTEM_CLIENTS.empty())
+	{
+		_lightSleep = true;
+		stop();
+	}
+	else if (!sleep && _lightSleep)
+	{
+		_lightSleep = false;
+
+		if (!GRABBER_SYSTEM_CLIENTS.empty())
+			start();
+	}
+}
+
+void SystemWrapper::handleRegionRequest(int hyperhdrInd, const QRectF& unusedArea)
+{
+	_unusedAreas[hyperhdrInd] = unusedArea;
+
+	if (GRABBER_SYSTEM_CLIENTS.contains(hyperhdrInd))
+		updateUnusedArea();
+}
+
+void SystemWrapper::updateUnusedArea()
+{
+	if (_grabber == nullptr)
+		return;
+
+	// only the part that is unused by every listening instance can be skipped
+	QRectF unusedArea;
+
+	for (int i = 0; i < GRABBER_SYSTEM_CLIENTS.size(); i++)
+	{
+		QRectF area = _unusedAreas.value(GRABBER_SYSTEM_CLIENTS[i]);
+
+		unusedArea = (i == 0) ? area : unusedArea.intersected(area);
+
+		if (unusedArea.isEmpty())
+			break;
+	}
+
+	_grabber->setUnusedArea(unusedArea);
+}
+
 bool SystemWrapper::start()
 {
 	if (_grabber != nullptr)
@@ -68,6 +68,10 @@ bool VideoControl::isCEC()
 
 void VideoControl::handleUsbImage(const QString& name, const Image<ColorRgb>& image)
 {
+	// the image comes from the grabber that is assigned to the other instances
+	if (!GrabberWrapper::isRouted(int(_hyperhdr->getInstanceIndex()), name))
+		return;
+
 	_stream = true;
 
 	if (_usbCaptName != name)
@@ -142,8 +146,7 @@ void VideoControl::setUsbInactive()
 		if (_stream)
 		{
 			_stream = false;
-			if (GrabberWrapper::getInstance() != nullptr)
-				GrabberWrapper::getInstance()->revive();
+			GrabberWrapper::reviveRouted(int(_hyperhdr->getInstanceIndex()));
 		}
 	}
 
@@ -4,9 +4,75 @@
 // BlackBorders includes
 #include <blackborder/BlackBorderDetector.h>
 #include <cmath>
+#include <vector>
+#include <algorithm>
+
+#if defined(__SSE2__) || defined(__x86_64__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+	#define BLACKBORDER_SSE2
+	#include <emmintrin.h>
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__) || defined(__aarch64__)
+	#define BLACKBORDER_NEON
+	#include <arm_neon.h>
+#endif
 
 using namespace hyperhdr;
 
+namespace
+{
+	// the decimated plane is at most that wide, 4K frames are sampled every 8th pixel
+	const int HISTOGRAM_PLANE_WIDTH = 480;
+
+	// counts the bytes >= threshold of the row and adds 1 to the column counter of each of them
+	int countRow(const uint8_t* row, int width, uint8_t threshold, uint16_t* columns)
+	{
+		int count = 0;
+		int x = 0;
+
+#if defined(BLACKBORDER_SSE2)
+		const __m128i limit = _mm_set1_epi8(static_cast<char>(threshold));
+		const __m128i one = _mm_set1_epi8(1);
+		const __m128i zero = _mm_setzero_si128();
+
+		for (; x + 16 <= width; x += 16)
+		{
+			const __m128i value = _mm_loadu_si128(reinterpret_cast<const __m128i*>(row + x));
+			// value >= threshold <=> max(value, threshold) == value
+			const __m128i bright = _mm_and_si128(_mm_cmpeq_epi8(_mm_max_epu8(value, limit), value), one);
+
+			const __m128i sum = _mm_sad_epu8(bright, zero);
+			count += _mm_cvtsi128_si32(sum) + _mm_cvtsi128_si32(_mm_srli_si128(sum, 8));
+
+			__m128i* column = reinterpret_cast<__m128i*>(columns + x);
+			_mm_storeu_si128(column, _mm_add_epi16(_mm_loadu_si128(column), _mm_unpacklo_epi8(bright, zero)));
+			_mm_storeu_si128(column + 1, _mm_add_epi16(_mm_loadu_si128(column + 1), _mm_unpackhi_epi8(bright, zero)));
+		}
+#elif defined(BLACKBORDER_NEON)
+		const uint8x16_t limit = vdupq_n_u8(threshold);
+		const uint8x16_t one = vdupq_n_u8(1);
+
+		for (; x + 16 <= width; x += 16)
+		{
+			const uint8x16_t bright = vandq_u8(vcgeq_u8(vld1q_u8(row + x), limit), one);
+			const uint64x2_t sum = vpaddlq_u32(vpaddlq_u16(vpaddlq_u8(bright)));
+
+			count += static_cast<int>(vgetq_lane_u64(sum, 0) + vgetq_lane_u64(sum, 1));
+
+			vst1q_u16(columns + x, vaddw_u8(vld1q_u16(columns + x), vget_low_u8(bright)));
+			vst1q_u16(columns + x + 8, vaddw_u8(vld1q_u16(columns + x + 8), vget_high_u8(bright)));
+		}
+#endif
+
+		for (; x < width; x++)
+			if (row[x] >= threshold)
+			{
+				count++;
+				columns[x]++;
+			}
+
+		return count;
+	}
+}
+
 BlackBorderDetector::BlackBorderDetector(double threshold)
 	: _blackborderThreshold(calculateThreshold(threshold))
 {
@@ -39,7 +105,7 @@ bool BlackBorder::operator== (const BlackBorder& other) const
 	return (other.unknown == false) && (horizontalSize == other.horizontalSize) && (verticalSize == other.verticalSize);
 }
 
-BlackBorder BlackBorderDetector::process(const Image<ColorRgb>& image) const
+BlackBorder BlackBorderDetector::process(const ImageView<ColorRgb>& image) const
 {
 	// test centre and 33%, 66% of width/height
 	// 33 and 66 will check left and top
@@ -97,7 +163,7 @@ BlackBorder BlackBorderDetector::process(const Image<ColorRgb>& image) const
 
 ///
 /// classic detection mode (topleft single line mode)
-BlackBorder BlackBorderDetector::process_classic(const Image<ColorRgb>& image) const
+BlackBorder BlackBorderDetector::process_classic(const ImageView<ColorRgb>& image) const
 {
 	// only test the topleft third of the image
 	int width = image.width() / 3;
@@ -155,7 +221,7 @@ BlackBorder BlackBorderDetector::process_classic(const Image<ColorRgb>& image) c
 
 ///
 /// osd detection mode (find x then y at detected x to avoid changes by osd overlays)
-BlackBorder BlackBorderDetector::process_osd(const Image<ColorRgb>& image) const
+BlackBorder BlackBorderDetector::process_osd(const ImageView<ColorRgb>& image) const
 {
 	// find X position at height33 and height66 we check from the left side, Ycenter will check from right side
 	// then we try to find a pixel at this X position from top and bottom and right side from top
@@ -212,7 +278,7 @@ BlackBorder BlackBorderDetector::process_osd(const Image<ColorRgb>& image) const
 
 ///
 /// letterbox detection mode (5lines top-bottom only detection)
-BlackBorder BlackBorderDetector::process_letterbox(const Image<ColorRgb>& image) const
+BlackBorder BlackBorderDetector::process_letterbox(const ImageView<ColorRgb>& image) const
 {
 	// test center and 25%, 75% of width
 	// 25 and 75 will check both top and bottom
@@ -253,3 +319,67 @@ BlackBorder BlackBorderDetector::process_letterbox(const Image<ColorRgb>& image)
 	return detectedBorder;
 }
 
+///
+/// histogram detection mode (non-black pixel counts of every row and column of a decimated plane)
+BlackBorder BlackBorderDetector::process_histogram(const ImageView<ColorRgb>& image) const
+{
+	// a pixel is black when all its channels are below the threshold, so the plane keeps the brightest channel
+	const int step = std::max(1, static_cast<int>((image.width() + HISTOGRAM_PLANE_WIDTH - 1) / HISTOGRAM_PLANE_WIDTH));
+	const int width = static_cast<int>(image.width()) / step;
+	const int height = static_cast<int>(image.height()) / step;
+
+	BlackBorder detectedBorder;
+	detectedBorder.unknown = true;
+	detectedBorder.horizontalSize = -1;
+	detectedBorder.verticalSize = -1;
+
+	if (width < 3 || height < 3)
+		return detectedBorder;
+
+	std::vector<uint8_t> plane(width);
+	std::vector<uint16_t> columns(width, 0);
+	std::vector<int> rows(height, 0);
+
+	for (int y = 0; y < height; y++)
+	{
+		const uint8_t* source = image.row(y * step);
+		const size_t pixelStep = static_cast<size_t>(step) * image.pixelStride();
+
+		for (int x = 0; x < width; x++, source += pixelStep)
+			plane[x] = std::max(source[0], std::max(source[1], source[2]));
+
+		rows[y] = countRow(plane.data(), width, _blackborderThreshold, columns.data());
+	}
+
+	// a line is a part of the picture when at least 1/8 of it is not black: single bright pixels, logos and noise are ignored
+	const int rowLimit = std::max(width / 8, 1);
+	const int columnLimit = std::max(height / 8, 1);
+
+	int top = -1, bottom = -1, left = -1, right = -1;
+
+	for (int y = 0; y < height / 3 && (top < 0 || bottom < 0); y++)
+	{
+		if (top < 0 && rows[y] >= rowLimit)
+			top = y;
+		if (bottom < 0 && rows[height - 1 - y] >= rowLimit)
+			bottom = y;
+	}
+
+	for (int x = 0; x < width / 3 && (left < 0 || right < 0); x++)
+	{
+		if (left < 0 && columns[x] >= columnLimit)
+			left = x;
+		if (right < 0 && columns[width - 1 - x] >= columnLimit)
+			right = x;
+	}
+
+	// the border is symmetric: the thinner side wins, so a subtitle in one bar never crops the picture
+	if (top < 0 || bottom < 0 || left < 0 || right < 0)
+		return detectedBorder;
+
+	detectedBorder.unknown = false;
+	detectedBorder.horizontalSize = std::min(top, bottom) * step;
+	detectedBorder.verticalSize = std::min(left, right) * step;
+
+	return detectedBorder;
+}
@@ -1,6 +1,13 @@
 #include <iostream>
 
+#include <QMutexLocker>
+
 #include <base/HyperHdrInstance.h>
+#include <base/FrameContext.h>
+#include <utils/InternalClock.h>
+
+#include <algorithm>
+#include <cstdlib>
 
 // Blackborder includes
 #include <blackborder/BlackBorderProcessor.h>
@@ -24,6 +31,13 @@ BlackBorderProcessor::BlackBorderProcessor(HyperHdrInstance* hyperhdr, QObject*
 	, _oldThreshold(-0.1)
 	, _hardDisabled(false)
 	, _userEnabled(false)
+	, _analysisInterval(1)
+	, _framesToSkip(0)
+	, _stableAnalyses(0)
+	, _previousLuma(-1)
+	, _statsBegin(0)
+	, _statsFrames(0)
+	, _statsAnalyses(0)
 {
 	// init
 	handleSettingsUpdate(settings::type::BLACKBORDER, _hyperhdr->getSetting(settings::type::BLACKBORDER));
@@ -45,6 +59,9 @@ void BlackBorderProcessor::handleSettingsUpdate(settings::type type, const QJson
 	if (type == settings::type::BLACKBORDER)
 	{
 		const QJsonObject& obj = config.object();
+
+		QMutexLocker locker(&_lock);
+
 		_unknownSwitchCnt = obj["unknownFrameCnt"].toInt(600);
 		_borderSwitchCnt = obj["borderFrameCnt"].toInt(50);
 		_maxInconsistentCnt = obj["maxInconsistentCnt"].toInt(10);
@@ -63,6 +80,8 @@ void BlackBorderProcessor::handleSettingsUpdate(settings::type type, const QJson
 
 		Info(Logger::getInstance("BLACKBORDER"), "Set mode to: %s", QSTRING_CSTR(_detectionMode));
 
+		locker.unlock();
+
 		// eval the comp state
 		handleCompStateChangeRequest(hyperhdr::COMP_BLACKBORDER, obj["enable"].toBool(true));
 	}
@@ -72,16 +91,20 @@ void BlackBorderProcessor::handleCompStateChangeRequest(hyperhdr::Components com
 {
 	if (component == hyperhdr::COMP_BLACKBORDER)
 	{
-		_userEnabled = enable;
-		if (enable)
 		{
-			// eg effects and probably other components don't want a BB, mimik a wrong comp state to the comp register
-			if (!_hardDisabled)
+			QMutexLocker locker(&_lock);
+
+			_userEnabled = enable;
+			if (enable)
+			{
+				// eg effects and probably other components don't want a BB, mimik a wrong comp state to the comp register
+				if (!_hardDisabled)
+					_enabled = enable;
+			}
+			else
+			{
 				_enabled = enable;
-		}
-		else
-		{
-			_enabled = enable;
+			}
 		}
 
 		_hyperhdr->setNewComponentState(hyperhdr::COMP_BLACKBORDER, enable);
@@ -90,6 +113,8 @@ void BlackBorderProcessor::handleCompStateChangeRequest(hyperhdr::Components com
 
 void BlackBorderProcessor::setHardDisable(bool disable)
 {
+	QMutexLocker locker(&_lock);
+
 	if (disable)
 	{
 		_enabled = false;
@@ -184,8 +209,54 @@ bool BlackBorderProcessor::updateBorder(const BlackBorder& newDetectedBorder)
 	return borderChanged;
 }
 
-bool BlackBorderProcessor::process(const Image<ColorRgb>& image)
+int BlackBorderProcessor::sampleLuma(const ImageView<ColorRgb>& image) const
+{
+	// 8x8 samples are enough to notice a scene or a source switch
+	const unsigned width = image.width();
+	const unsigned height = image.height();
+	int sum = 0;
+
+	for (unsigned j = 0; j < 8; j++)
+		for (unsigned i = 0; i < 8; i++)
+		{
+			const ColorRgb& color = image((2 * i + 1) * width / 16, (2 * j + 1) * height / 16);
+			sum += (color.red * 2 + color.green * 5 + color.blue) / 8;
+		}
+
+	return sum / 64;
+}
+
+void BlackBorderProcessor::updateAnalysisStats(bool analyzed)
+{
+	int64_t now = InternalClock::now();
+
+	_statsFrames++;
+	if (analyzed)
+		_statsAnalyses++;
+
+	if (_statsBegin == 0)
+		_statsBegin = now;
+	else if (now - _statsBegin >= 60000)
+	{
+		Debug(Logger::getInstance("BLACKBORDER"), "Analyzed %d of %d frames in the last minute (%.1f%%), current interval: every %d frame(s)",
+			_statsAnalyses, _statsFrames, (100.0 * _statsAnalyses) / _statsFrames, int(_analysisInterval));
+
+		_statsBegin = now;
+		_statsFrames = 0;
+		_statsAnalyses = 0;
+	}
+}
+
+double BlackBorderProcessor::getAnalysisRate() const
+{
+	return 1.0 / _analysisInterval;
+}
+
+bool BlackBorderProcessor::process(const ImageView<ColorRgb>& image, const FrameContext* context)
 {
+	// the settings are changed from the instance thread
+	QMutexLocker locker(&_lock);
+
 	// get the border for the single image
 	BlackBorder imageBorder;
 	imageBorder.horizontalSize = 0;
@@ -195,10 +266,33 @@ bool BlackBorderProcessor::process(const Image<ColorRgb>& image)
 	{
 		imageBorder.unknown = true;
 		_currentBorder = imageBorder;
+		_analysisInterval = 1;
+		_framesToSkip = 0;
 		return true;
 	}
 
-	if (_detectionMode == "default") {
+	// a sharp change of the mean luminance means a new scene or source: back to the full rate
+	const int luma = sampleLuma(image);
+	const bool lumaJump = (_previousLuma >= 0 && std::abs(luma - _previousLuma) > ANALYSIS_LUMA_JUMP);
+	_previousLuma = luma;
+
+	if (lumaJump)
+	{
+		_analysisInterval = 1;
+		_framesToSkip = 0;
+		_stableAnalyses = 0;
+	}
+	else if (_framesToSkip > 0)
+	{
+		_framesToSkip--;
+		updateAnalysisStats(false);
+		return false;
+	}
+
+	if (context != nullptr) {
+		imageBorder = context->getBlackBorder(_detectionMode, _oldThreshold, *_detector);
+	}
+	else if (_detectionMode == "default") {
 		imageBorder = _detector->process(image);
 	}
 	else if (_detectionMode == "classic") {
@@ -210,6 +304,9 @@ bool BlackBorderProcessor::process(const Image<ColorRgb>& image)
 	else if (_detectionMode == "letterbox") {
 		imageBorder = _detector->process_letterbox(image);
 	}
+	else if (_detectionMode == "histogram") {
+		imageBorder = _detector->process_histogram(image);
+	}
 	// add blur to the border
 	if (imageBorder.horizontalSize > 0)
 	{
@@ -222,5 +319,23 @@ bool BlackBorderProcessor::process(const Image<ColorRgb>& image)
 
 	const bool borderUpdated = updateBorder(imageBorder);
 
+	// back off only while the detection confirms the current border, a pending switch needs every frame
+	if (!borderUpdated && imageBorder == _currentBorder)
+	{
+		if (++_stableAnalyses >= ANALYSIS_STABLE_RUNS)
+		{
+			_analysisInterval = std::min(_analysisInterval * 2, int(ANALYSIS_MAX_INTERVAL));
+			_stableAnalyses = 0;
+		}
+	}
+	else
+	{
+		_analysisInterval = 1;
+		_stableAnalyses = 0;
+	}
+
+	_framesToSkip = _analysisInterval - 1;
+	updateAnalysisStats(true);
+
 	return borderUpdated;
 }
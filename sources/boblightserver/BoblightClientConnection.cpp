@@ -18,7 +18,6 @@
 #include <base/ImageProcessor.h>
 #include <HyperhdrConfig.h>
 #include <base/HyperHdrInstance.h>
-#include <utils/QStringUtils.h>
 
 
 // project includes
@@ -35,7 +34,16 @@ BoblightClientConnection::BoblightClientConnection(HyperHdrInstance* hyperhdr, Q
 	, _ledColors(hyperhdr->getLedCount(), ColorRgb::BLACK)
 	, _log(Logger::getInstance("BOBLIGHT"))
 	, _clientAddress(QHostInfo::fromName(socket->peerAddress().toString()).hostName())
+	, _frameReady(false)
 {
+	// the names of "get lights", most clients send them back
+	char name[16];
+	for (int i = 0; i < static_cast<int>(_ledColors.size()); ++i)
+	{
+		const int n = snprintf(name, sizeof(name), "%03d", i);
+		_lightNames.insert(QByteArray(name, n), i);
+	}
+
 	// initalize the locale. Start with the default C-locale
 	_locale.setNumberOptions(QLocale::OmitGroupSeparator | QLocale::RejectGroupSeparator);
 
@@ -55,55 +63,52 @@ BoblightClientConnection::~BoblightClientConnection()
 
 void BoblightClientConnection::readData()
 {
-	_receiveBuffer.append(_socket->readAll());
+	const qint64 available = _socket->bytesAvailable();
+	const int oldSize = _receiveBuffer.size();
 
-	int bytes = _receiveBuffer.indexOf('\n') + 1;
-	while (bytes > 0)
-	{
-		// create message string (strip the newline)
-		const QString message = readMessage(_receiveBuffer.data(), bytes);
+	// read into the buffer that keeps its capacity between the calls
+	_receiveBuffer.resize(oldSize + static_cast<int>(available));
+	const qint64 read = _socket->read(_receiveBuffer.data() + oldSize, available);
+	_receiveBuffer.resize(oldSize + static_cast<int>(qMax(read, qint64(0))));
 
-		// handle trimmed message
-		handleMessage(message);
+	const char* data = _receiveBuffer.constData();
+	const int size = _receiveBuffer.size();
+	int offset = 0;
 
-		// remove message data from buffer
-		_receiveBuffer.remove(0, bytes);
+	const char* newline;
+	while ((newline = static_cast<const char*>(memchr(data + offset, '\n', size - offset))) != nullptr)
+	{
+		const char* begin = data + offset;
+		const char* end = newline;
 
-		// drop messages if the buffer is too full
-		if (_receiveBuffer.size() > 100 * 1024)
-		{
-			Debug(_log, "server drops messages (buffer full)");
-			_receiveBuffer.clear();
-		}
+		// trim the message
+		while (begin < end && std::isspace(static_cast<unsigned char>(*begin)))
+			++begin;
+		while (end > begin && std::isspace(static_cast<unsigned char>(*(end - 1))))
+			--end;
 
-		// try too look up '\n' again
-		bytes = _receiveBuffer.indexOf('\n') + 1;
+		handleMessage(begin, static_cast<int>(end - begin));
+
+		offset = static_cast<int>(newline - data) + 1;
 	}
-}
 
-QString BoblightClientConnection::readMessage(const char* data, const size_t size) const
-{
-	char* end = (char*)data + size - 1;
+	_receiveBuffer.remove(0, offset);
 
-	// Trim left
-	while (data < end && std::isspace(*data))
+	// drop messages if the buffer is too full
+	if (_receiveBuffer.size() > 100 * 1024)
 	{
-		++data;
+		Debug(_log, "server drops messages (buffer full)");
+		_receiveBuffer.clear();
 	}
 
-	// Trim right
-	while (end > data && std::isspace(*end))
+	// all the frames of the received data are applied at once
+	if (_frameReady)
 	{
-		--end;
-	}
-
-	// create message string (strip the newline)
-	const int len = end - data + 1;
-	const QString message = QString::fromLatin1(data, len);
-
-	//std::cout << bytes << ": \"" << message.toUtf8().constData() << "\"" << std::endl;
+		_frameReady = false;
 
-	return message;
+		if (_priority >= 128 && _priority < 254)
+			_hyperhdr->setInput(_priority, _ledColors);
+	}
 }
 
 void BoblightClientConnection::socketClosed()
@@ -116,44 +121,62 @@ void BoblightClientConnection::socketClosed()
 }
 
 
-void BoblightClientConnection::handleMessage(const QString& message)
+void BoblightClientConnection::handleMessage(const char* data, int size)
 {
-	//std::cout << "boblight message: " << message.toStdString() << std::endl;
-	auto messageParts = QStringUtils::REFSPLITTER(message, ' ');
-	if (messageParts.size() > 0)
+	// the longest message is "set light <name> rgb <r> <g> <b>"
+	const int MAX_TOKENS = 8;
+
+	Token messageParts[MAX_TOKENS];
+	int count = 0;
+
+	for (int i = 0; i < size && count < MAX_TOKENS;)
+	{
+		if (data[i] == ' ')
+		{
+			++i;
+			continue;
+		}
+
+		const int start = i;
+		while (i < size && data[i] != ' ')
+			++i;
+
+		messageParts[count++] = Token{ data + start, i - start };
+	}
+
+	if (count > 0)
 	{
-		if (messageParts[0] == QStringLiteral("hello"))
+		if (messageParts[0] == "hello")
 		{
 			sendMessage("hello\n");
 			return;
 		}
-		else if (messageParts[0] == QStringLiteral("ping"))
+		else if (messageParts[0] == "ping")
 		{
 			sendMessage("ping 1\n");
 			return;
 		}
-		else if (messageParts[0] == QStringLiteral("get") && messageParts.size() > 1)
+		else if (messageParts[0] == "get" && count > 1)
 		{
-			if (messageParts[1] == QStringLiteral("version"))
+			if (messageParts[1] == "version")
 			{
 				sendMessage("version 5\n");
 				return;
 			}
-			else if (messageParts[1] == QStringLiteral("lights"))
+			else if (messageParts[1] == "lights")
 			{
 				sendLightMessage();
 				return;
 			}
 		}
-		else if (messageParts[0] == QStringLiteral("set") && messageParts.size() > 2)
+		else if (messageParts[0] == "set" && count > 2)
 		{
-			if (messageParts.size() > 3 && messageParts[1] == QStringLiteral("light"))
+			if (count > 3 && messageParts[1] == "light")
 			{
-				bool rc;
-				const unsigned ledIndex = parseUInt(messageParts[2], &rc);
-				if (rc && ledIndex < _ledColors.size())
+				const int ledIndex = lightIndex(messageParts[2]);
+				if (ledIndex >= 0)
 				{
-					if (messageParts[3] == QStringLiteral("rgb") && messageParts.size() == 7)
+					if (messageParts[3] == "rgb" && count == 7)
 					{
 						// custom parseByte accepts both ',' and '.' as decimal separator
 						// no need to replace decimal comma with decimal point
@@ -170,29 +193,26 @@ void BoblightClientConnection::handleMessage(const QString& message)
 							rgb.green = green;
 							rgb.blue = blue;
 
-							if (_priority == 0 || _priority < 128 || _priority >= 254)
-								return;
-
 							// send current color values to HyperHDR if this is the last led assuming leds values are send in order of id
-							if (ledIndex == _ledColors.size() - 1)
+							if (ledIndex == static_cast<int>(_ledColors.size()) - 1)
 							{
-								_hyperhdr->setInput(_priority, _ledColors);
+								_frameReady = true;
 							}
 
 							return;
 						}
 					}
-					else if (messageParts[3] == QStringLiteral("speed") ||
-						messageParts[3] == QStringLiteral("interpolation") ||
-						messageParts[3] == QStringLiteral("use") ||
-						messageParts[3] == QStringLiteral("singlechange"))
+					else if (messageParts[3] == "speed" ||
+						messageParts[3] == "interpolation" ||
+						messageParts[3] == "use" ||
+						messageParts[3] == "singlechange")
 					{
 						// these message are ignored by HyperHDR
 						return;
 					}
 				}
 			}
-			else if (messageParts.size() == 3 && messageParts[1] == QStringLiteral("priority"))
+			else if (count == 3 && messageParts[1] == "priority")
 			{
 				bool rc;
 				const int prio = static_cast<int>(parseUInt(messageParts[2], &rc));
@@ -225,16 +245,15 @@ void BoblightClientConnection::handleMessage(const QString& message)
 				}
 			}
 		}
-		else if (messageParts[0] == QStringLiteral("sync"))
+		else if (messageParts[0] == "sync")
 		{
-			if (_priority >= 128 && _priority < 254)
-				_hyperhdr->setInput(_priority, _ledColors); // send current color values to HyperHDR
+			_frameReady = true; // send current color values to HyperHDR
 
 			return;
 		}
 	}
 
-	Debug(_log, "unknown boblight message: %s", QSTRING_CSTR(message));
+	Debug(_log, "unknown boblight message: %s", QSTRING_CSTR(QString::fromLatin1(data, size)));
 }
 
 /// Float values 10 to the power of -p for p in 0 .. 8.
@@ -249,7 +268,7 @@ const float ipows[] = {
 	1.0f / 10000000.0f,
 	1.0f / 100000000.0f };
 
-float BoblightClientConnection::parseFloat(const QStringView& s, bool* ok) const
+float BoblightClientConnection::parseFloat(const Token& s, bool* ok) const
 {
 	// We parse radix 10
 	const char MIN_DIGIT = '0';
@@ -261,20 +280,16 @@ float BoblightClientConnection::parseFloat(const QStringView& s, bool* ok) const
 	/// The maximum number of characters we want to process
 	const int MAX_LEN = 18; // Chosen randomly
 
-	/// The index of the current character
-	int q = 0;
+	const char* it = s.data;
+	const char* end = s.data + qMin(s.size, MAX_LEN);
 
 	/// The integer part of the number
 	int64_t n = 0;
 
-	auto it = s.begin();
-
-#define STEP ((it != s.end()) && (q++ < MAX_LEN))
-
 	// parse the integer-part
-	while (it->unicode() >= MIN_DIGIT && it->unicode() <= MAX_DIGIT && STEP)
+	while (it != end && *it >= MIN_DIGIT && *it <= MAX_DIGIT)
 	{
-		n = (n * 10) + (it->unicode() - MIN_DIGIT);
+		n = (n * 10) + (*it - MIN_DIGIT);
 		++it;
 	}
 
@@ -282,7 +297,7 @@ float BoblightClientConnection::parseFloat(const QStringView& s, bool* ok) const
 	float f = static_cast<float>(n);
 
 	// parse decimal part
-	if ((it->unicode() == SEP_POINT || it->unicode() == SEP_COMMA) && STEP)
+	if (it != end && (*it == SEP_POINT || *it == SEP_COMMA))
 	{
 		/// The decimal part of the number
 		int64_t d = 0;
@@ -291,9 +306,9 @@ float BoblightClientConnection::parseFloat(const QStringView& s, bool* ok) const
 		int e = 0;
 
 		++it;
-		while (it->unicode() >= MIN_DIGIT && it->unicode() <= MAX_DIGIT && STEP)
+		while (it != end && *it >= MIN_DIGIT && *it <= MAX_DIGIT)
 		{
-			d = (d * 10) + (it->unicode() - MIN_DIGIT);
+			d = (d * 10) + (*it - MIN_DIGIT);
 			++e;
 			++it;
 		}
@@ -311,11 +326,10 @@ float BoblightClientConnection::parseFloat(const QStringView& s, bool* ok) const
 		}
 	}
 
-	if (q >= MAX_LEN || q < s.length())
+	if (s.size == 0 || s.size >= MAX_LEN || it != s.data + s.size)
 	{
 		if (ok)
 		{
-			//std::cout << "FAIL L " << q << ": " << s.toUtf8().constData() << std::endl;
 			*ok = false;
 		}
 		return 0;
@@ -323,14 +337,13 @@ float BoblightClientConnection::parseFloat(const QStringView& s, bool* ok) const
 
 	if (ok)
 	{
-		//std::cout << "OK " << d << ": " << s.toUtf8().constData() << std::endl;
 		*ok = true;
 	}
 
 	return f;
 }
 
-unsigned BoblightClientConnection::parseUInt(const QStringView& s, bool* ok) const
+unsigned BoblightClientConnection::parseUInt(const Token& s, bool* ok) const
 {
 	// We parse radix 10
 	const char MIN_DIGIT = '0';
@@ -339,30 +352,28 @@ unsigned BoblightClientConnection::parseUInt(const QStringView& s, bool* ok) con
 	/// The maximum number of characters we want to process
 	const int MAX_LEN = 10;
 
-	/// The index of the current character
-	int q = 0;
+	const char* it = s.data;
+	const char* end = s.data + qMin(s.size, MAX_LEN);
 
 	/// The integer part of the number
-	int n = 0;
-
-	auto it = s.begin();
+	unsigned n = 0;
 
 	// parse the integer-part
-	while (it->unicode() >= MIN_DIGIT && it->unicode() <= MAX_DIGIT && ((it != s.end()) && (q++ < MAX_LEN)))
+	while (it != end && *it >= MIN_DIGIT && *it <= MAX_DIGIT)
 	{
-		n = (n * 10) + (it->unicode() - MIN_DIGIT);
+		n = (n * 10) + static_cast<unsigned>(*it - MIN_DIGIT);
 		++it;
 	}
 
 	if (ok)
 	{
-		*ok = !(q >= MAX_LEN || q < s.length());
+		*ok = !(s.size == 0 || s.size >= MAX_LEN || it != s.data + s.size);
 	}
 
 	return n;
 }
 
-uint8_t BoblightClientConnection::parseByte(const QStringView& s, bool* ok) const
+uint8_t BoblightClientConnection::parseByte(const Token& s, bool* ok) const
 {
 	const int LO = 0;
 	const int HI = 255;
@@ -370,13 +381,27 @@ uint8_t BoblightClientConnection::parseByte(const QStringView& s, bool* ok) cons
 #if defined(FAST_FLOAT_PARSE)
 	const float d = parseFloat(s, ok);
 #else
-	const float d = s.toFloat(ok);
+	const float d = QByteArray::fromRawData(s.data, s.size).toFloat(ok);
 #endif
 
 	// Clamp to byte range 0 to 255
 	return static_cast<uint8_t>(qBound(LO, int(HI * d), HI)); // qBound args are in order min, value, max; see: https://doc.qt.io/qt-5/qtglobal.html#qBound
 }
 
+int BoblightClientConnection::lightIndex(const Token& s) const
+{
+	// the lookup key points into the receive buffer, nothing is copied
+	auto name = _lightNames.find(QByteArray::fromRawData(s.data, s.size));
+
+	if (name != _lightNames.end())
+		return name.value();
+
+	bool ok;
+	const unsigned index = parseUInt(s, &ok);
+
+	return (ok && index < _ledColors.size()) ? static_cast<int>(index) : -1;
+}
+
 void BoblightClientConnection::sendLightMessage()
 {
 	char buffer[256];
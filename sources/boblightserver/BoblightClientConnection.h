@@ -5,8 +5,9 @@
 #include <QTcpSocket>
 #include <QLocale>
 #include <QString>
+#include <QHash>
 
-#include <QStringView>
+#include <cstring>
 
 // utils includes
 #include <utils/Logger.h>
@@ -57,12 +58,22 @@ private slots:
 	void socketClosed();
 
 private:
+	/// A word of a message, points into the receive buffer
+	struct Token
+	{
+		const char* data;
+		int size;
+
+		bool operator==(const char* text) const { return size == static_cast<int>(strlen(text)) && memcmp(data, text, size) == 0; }
+	};
+
 	///
 	/// Handle an incoming boblight message
 	///
-	/// @param message the incoming message as string
+	/// @param data the message in the receive buffer without the newline
+	/// @param size the length of the message
 	///
-	void handleMessage(const QString& message);
+	void handleMessage(const char* data, int size);
 
 	///
 	/// Send a message to the connected client
@@ -77,40 +88,39 @@ private:
 	void sendLightMessage();
 
 	///
-	/// Interpret the float value "0.0" to "1.0" of the QString byte values 0 .. 255
+	/// Interpret the float value "0.0" to "1.0" of the token as byte values 0 .. 255
 	///
-	/// @param s the string to parse
+	/// @param s the token to parse
 	/// @param ok whether the result is ok
 	/// @return the parsed byte value in range 0 to 255, or 0
 	///
-	uint8_t parseByte(const QStringView& s, bool* ok = nullptr) const;
+	uint8_t parseByte(const Token& s, bool* ok = nullptr) const;
 
 	///
-	/// Parse the given QString as unsigned int value.
+	/// Parse the given token as unsigned int value.
 	///
-	/// @param s the string to parse
+	/// @param s the token to parse
 	/// @param ok whether the result is ok
 	/// @return the parsed unsigned int value
 	///
-	unsigned parseUInt(const QStringView& s, bool* ok = nullptr) const;
+	unsigned parseUInt(const Token& s, bool* ok = nullptr) const;
 
 	///
-	/// Parse the given QString as float value, e.g. the 16-bit (wide char) QString "1" shall represent 1, "0.5" is 0.5 and so on.
+	/// Parse the given token as float value, e.g. "1" shall represent 1, "0.5" is 0.5 and so on.
 	///
-	/// @param s the string to parse
+	/// @param s the token to parse
 	/// @param ok whether the result is ok
 	/// @return the parsed float value, or 0
 	///
-	float parseFloat(const QStringView& s, bool* ok = nullptr) const;
+	float parseFloat(const Token& s, bool* ok = nullptr) const;
 
 	///
-	/// Read an incoming boblight message as QString
+	/// The index of the light with the name of the token
 	///
-	/// @param data the char data buffer of the incoming message
-	/// @param size the length of the buffer buffer
-	/// @returns the incoming boblight message as QString
+	/// @param s the name of the light as sent by "get lights", or its index
+	/// @return the index of the light or -1
 	///
-	QString readMessage(const char* data, const size_t size) const;
+	int lightIndex(const Token& s) const;
 
 private:
 	/// Locale used for parsing floating point values
@@ -134,6 +144,12 @@ private:
 	/// The latest led color data
 	std::vector<ColorRgb> _ledColors;
 
+	/// The names of the lights sent by "get lights" and their index
+	QHash<QByteArray, int> _lightNames;
+
+	/// The last light of a frame or a sync was received: the colors are sent once the received data is handled
+	bool _frameReady;
+
 	/// logger instance
 	Logger* _log;
 
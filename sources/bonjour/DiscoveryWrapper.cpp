@@ -29,6 +29,7 @@
 #include <bonjour/DiscoveryWrapper.h>
 #include <leddevice/LedDevice.h>
 #include <leddevice/LedDeviceFactory.h>
+#include <leddevice/DiscoveryCache.h>
 
 #include <QTimer>
 #include <QString>
@@ -54,6 +55,7 @@ DiscoveryWrapper::DiscoveryWrapper(QObject* parent)
 
 	connect(this, &DiscoveryWrapper::discoveryEvent, this, &DiscoveryWrapper::discoveryEventHandler);
 	connect(this, &DiscoveryWrapper::requestToScan, this, &DiscoveryWrapper::requestToScanHandler);	
+	connect(this, &DiscoveryWrapper::foundService, this, &DiscoveryWrapper::publishHosts);
 }
 
 DiscoveryWrapper::~DiscoveryWrapper()
@@ -126,6 +128,21 @@ void DiscoveryWrapper::requestServicesScan()
 	cleanUp(_espDevices);
 	cleanUp(_picoDevices);
 	emit requestToScan(DiscoveryRecord::Service::SerialPort);
+
+	// the SSDP and broadcast scans of the LED devices that the UI asked for recently
+	DiscoveryCache::refresh();
+}
+
+void DiscoveryWrapper::publishHosts()
+{
+	QMap<QString, QString> hosts;
+
+	for (const DiscoveryRecord& rec : getAllServices())
+		if (!rec.hostName.isEmpty() && !rec.address.isEmpty())
+			hosts[rec.hostName] = rec.address;
+
+	// the LED devices resolve their host names from there without a DNS query
+	DiscoveryCache::setHosts(hosts);
 }
 
 void DiscoveryWrapper::gotMessage(QList<DiscoveryRecord>& target, DiscoveryRecord message)
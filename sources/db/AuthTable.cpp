@@ -192,6 +192,30 @@ const QVector<QVariantMap> AuthTable::getTokenList()
 }
 
 
+const QVector<QVariantMap> AuthTable::getTokenRecords()
+{
+	QVector<QVariantMap> records, results;
+	getRecords(records, QStringList() << "token" << "id" << "comment" << "last_use");
+
+	for (const auto& record : records)
+		if (!record["id"].toString().isEmpty())
+			results.append(record);
+
+	return results;
+}
+
+
+void AuthTable::updateTokenUsed(const QByteArray& tokenHash, const QString& lastUse)
+{
+	QVariantMap map;
+	map["last_use"] = lastUse;
+
+	VectorPair cond;
+	cond.append(CPair("token", tokenHash));
+	updateRecord(cond, map);
+}
+
+
 bool AuthTable::idExist(const QString& id)
 {
 
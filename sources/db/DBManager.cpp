@@ -26,9 +26,11 @@
 */
 
 #include <db/DBManager.h>
+#include <db/SettingsTable.h>
 #include <utils/settings.h>
 
 #include <QSqlQuery>
+#include <QHash>
 #include <QDir>
 #include <QSqlError>
 #include <QJsonArray>
@@ -45,6 +47,28 @@
 QString DBManager::_rootPath;
 QThreadStorage<QSqlDatabase> DBManager::_databasePool;
 
+namespace
+{
+	/// the prepared statements of the connection of a thread
+	struct QueryPool
+	{
+		QHash<QString, QSqlQuery*> queries;
+		// the last statement that could not be prepared, it's not reused
+		QSqlQuery* failed = nullptr;
+
+		~QueryPool()
+		{
+			qDeleteAll(queries);
+			delete failed;
+		}
+	};
+
+	QThreadStorage<QueryPool*> queryPool;
+
+	/// the nesting level of the transactions started by the thread
+	QThreadStorage<int> transactionDepth;
+}
+
 DBManager::DBManager(QObject* parent)
 	: QObject(parent)
 	, _log(Logger::getInstance("DB"))
@@ -98,10 +122,91 @@ QSqlDatabase DBManager::getDB() const
 		else
 			Info(_log, "Database opened: %s", QSTRING_CSTR(dbFile.absoluteFilePath()));
 
+		// every thread has its own connection: wait for the writer of another thread instead of failing at once
+		QSqlQuery pragma(db);
+		pragma.exec("PRAGMA busy_timeout = 5000");
+
+		// WAL: the readers don't wait for a writer and a commit costs one sequential write instead of
+		// the rollback journal with its several fsyncs, which is slow on SD cards
+		if (!_readonlyMode)
+		{
+			if (!pragma.exec("PRAGMA journal_mode = WAL"))
+				Warning(_log, "Could not enable the WAL journal mode. Error: %s", QSTRING_CSTR(db.lastError().text()));
+			pragma.exec("PRAGMA synchronous = NORMAL");
+		}
+
 		return db;
 	}
 }
 
+QSqlQuery& DBManager::getQuery(const QSqlDatabase& idb, const QString& sql) const
+{
+	if (!queryPool.hasLocalData())
+		queryPool.setLocalData(new QueryPool());
+
+	QueryPool* pool = queryPool.localData();
+	auto cached = pool->queries.find(sql);
+
+	if (cached != pool->queries.end())
+	{
+		// release the cursor of the previous use
+		(*cached)->finish();
+		return **cached;
+	}
+
+	QSqlQuery* query = new QSqlQuery(idb);
+	query->setForwardOnly(true);
+
+	// a statement that could not be prepared (ex. the table is not created yet) is not kept, its exec() reports the error
+	if (query->prepare(sql))
+		pool->queries.insert(sql, query);
+	else
+	{
+		delete pool->failed;
+		pool->failed = query;
+	}
+
+	return *query;
+}
+
+bool DBManager::startTransaction() const
+{
+	int& depth = transactionDepth.localData();
+
+	if (depth == 0)
+	{
+		QSqlDatabase idb = getDB();
+		if (!idb.transaction())
+		{
+			Error(_log, "Could not create a DB transaction. Error: %s", QSTRING_CSTR(idb.lastError().text()));
+			return false;
+		}
+	}
+
+	depth++;
+	return true;
+}
+
+bool DBManager::commitTransaction() const
+{
+	int& depth = transactionDepth.localData();
+
+	if (depth == 0)
+		return false;
+
+	if (--depth > 0)
+		return true;
+
+	QSqlDatabase idb = getDB();
+	if (!idb.commit())
+	{
+		Error(_log, "Could not commit the DB transaction. Error: %s", QSTRING_CSTR(idb.lastError().text()));
+		return false;
+	}
+
+	return true;
+}
+
 bool DBManager::createRecord(const VectorPair& conditions, const QVariantMap& columns) const
 {
 	if (_readonlyMode)
@@ -122,8 +227,6 @@ bool DBManager::createRecord(const VectorPair& conditions, const QVariantMap& co
 	}
 
 	QSqlDatabase idb = getDB();
-	QSqlQuery query(idb);
-	query.setForwardOnly(true);
 
 	QVariantList cValues;
 	QStringList prep;
@@ -145,7 +248,7 @@ bool DBManager::createRecord(const VectorPair& conditions, const QVariantMap& co
 		cValues << pair.second;
 		placeh.append("?");
 	}
-	query.prepare(QString("INSERT INTO %1 ( %2 ) VALUES ( %3 )").arg(_table, prep.join(", ")).arg(placeh.join(", ")));
+	QSqlQuery& query = getQuery(idb, QString("INSERT INTO %1 ( %2 ) VALUES ( %3 )").arg(_table, prep.join(", ")).arg(placeh.join(", ")));
 	// add column & condition values
 	doAddBindValue(query, cValues);
 	if (!query.exec())
@@ -162,8 +265,6 @@ bool DBManager::recordExists(const VectorPair& conditions) const
 		return false;
 
 	QSqlDatabase idb = getDB();
-	QSqlQuery query(idb);
-	query.setForwardOnly(true);
 
 	QStringList prepCond;
 	QVariantList bindVal;
@@ -174,7 +275,7 @@ bool DBManager::recordExists(const VectorPair& conditions) const
 		prepCond << pair.first + "=?";
 		bindVal << pair.second;
 	}
-	query.prepare(QString("SELECT * FROM %1 %2").arg(_table, prepCond.join(" ")));
+	QSqlQuery& query = getQuery(idb, QString("SELECT * FROM %1 %2").arg(_table, prepCond.join(" ")));
 	doAddBindValue(query, bindVal);
 	if (!query.exec())
 	{
@@ -182,15 +283,12 @@ bool DBManager::recordExists(const VectorPair& conditions) const
 		return false;
 	}
 
-	int entry = 0;
-	while (query.next()) {
-		entry++;
-	}
+	// one row is enough
+	bool entry = query.next();
 
-	if (entry)
-		return true;
+	query.finish();
 
-	return false;
+	return entry;
 }
 
 bool DBManager::updateRecord(const VectorPair& conditions, const QVariantMap& columns) const
@@ -201,12 +299,8 @@ bool DBManager::updateRecord(const VectorPair& conditions, const QVariantMap& co
 	}
 
 	QSqlDatabase idb = getDB();
-	if (idb.transaction())
+	if (startTransaction())
 	{
-
-		QSqlQuery query(idb);
-		query.setForwardOnly(true);
-
 		QVariantList values;
 		QStringList prep;
 
@@ -231,7 +325,7 @@ bool DBManager::updateRecord(const VectorPair& conditions, const QVariantMap& co
 			prepBindVal << pair.second;
 		}
 
-		query.prepare(QString("UPDATE %1 SET %2 %3").arg(_table, prep.join(", ")).arg(prepCond.join(" ")));
+		QSqlQuery& query = getQuery(idb, QString("UPDATE %1 SET %2 %3").arg(_table, prep.join(", ")).arg(prepCond.join(" ")));
 		// add column values
 		doAddBindValue(query, values);
 		// add condition values
@@ -239,20 +333,15 @@ bool DBManager::updateRecord(const VectorPair& conditions, const QVariantMap& co
 		if (!query.exec())
 		{
 			Error(_log, "Failed to update record: '%s' in table: '%s' Error: %s", QSTRING_CSTR(prepCond.join(" ")), QSTRING_CSTR(_table), QSTRING_CSTR(idb.lastError().text()));
-			idb.rollback();
+			// the failed statement changed nothing, the other writes of an outer transaction are kept
+			commitTransaction();
 			return false;
 		}
 	}
 	else
-	{
-		Error(_log, "Could not create a DB transaction. Error: %s", QSTRING_CSTR(idb.lastError().text()));
 		return false;
-	}
 
-	if (!idb.commit())
-	{
-		Error(_log, "Could not commit the DB transaction. Error: %s", QSTRING_CSTR(idb.lastError().text()));
-	}
+	commitTransaction();
 
 	return true;
 }
@@ -260,8 +349,6 @@ bool DBManager::updateRecord(const VectorPair& conditions, const QVariantMap& co
 bool DBManager::getRecord(const VectorPair& conditions, QVariantMap& results, const QStringList& tColumns, const QStringList& tOrder) const
 {
 	QSqlDatabase idb = getDB();
-	QSqlQuery query(idb);
-	query.setForwardOnly(true);
 
 	QString sColumns("*");
 	if (!tColumns.isEmpty())
@@ -284,7 +371,7 @@ bool DBManager::getRecord(const VectorPair& conditions, QVariantMap& results, co
 		prepCond << pair.first + "=?";
 		bindVal << pair.second;
 	}
-	query.prepare(QString("SELECT %1 FROM %2%3%4").arg(sColumns, _table).arg(prepCond.join(" ")).arg(sOrder));
+	QSqlQuery& query = getQuery(idb, QString("SELECT %1 FROM %2%3%4").arg(sColumns, _table).arg(prepCond.join(" ")).arg(sOrder));
 	doAddBindValue(query, bindVal);
 
 	if (!query.exec())
@@ -302,14 +389,14 @@ bool DBManager::getRecord(const VectorPair& conditions, QVariantMap& results, co
 		results[rec.fieldName(i)] = rec.value(i);
 	}
 
+	query.finish();
+
 	return true;
 }
 
 bool DBManager::getRecords(QVector<QVariantMap>& results, const QStringList& tColumns, const QStringList& tOrder) const
 {
 	QSqlDatabase idb = getDB();
-	QSqlQuery query(idb);
-	query.setForwardOnly(true);
 
 	QString sColumns("*");
 	if (!tColumns.isEmpty())
@@ -322,7 +409,7 @@ bool DBManager::getRecords(QVector<QVariantMap>& results, const QStringList& tCo
 		sOrder.append(tOrder.join(", "));
 	}
 
-	query.prepare(QString("SELECT %1 FROM %2%3").arg(sColumns, _table, sOrder));
+	QSqlQuery& query = getQuery(idb, QString("SELECT %1 FROM %2%3").arg(sColumns, _table, sOrder));
 
 	if (!query.exec())
 	{
@@ -342,6 +429,8 @@ bool DBManager::getRecords(QVector<QVariantMap>& results, const QStringList& tCo
 		results.append(entry);
 	}
 
+	query.finish();
+
 	return true;
 }
 
@@ -362,7 +451,6 @@ bool DBManager::deleteRecord(const VectorPair& conditions) const
 	if (recordExists(conditions))
 	{
 		QSqlDatabase idb = getDB();
-		QSqlQuery query(idb);
 
 		// prep conditions
 		QStringList prepCond("WHERE");
@@ -374,7 +462,7 @@ bool DBManager::deleteRecord(const VectorPair& conditions) const
 			bindValues << pair.second;
 		}
 
-		query.prepare(QString("DELETE FROM %1 %2").arg(_table, prepCond.join(" ")));
+		QSqlQuery& query = getQuery(idb, QString("DELETE FROM %1 %2").arg(_table, prepCond.join(" ")));
 		doAddBindValue(query, bindValues);
 		if (!query.exec())
 		{
@@ -692,5 +780,8 @@ QString DBManager::restoreBackup(const QJsonObject& backupData)
 		return  "Could not commit the DB transaction. Error: " + idb.lastError().text();
 	}
 
+	// the settings were replaced behind the settings tables
+	SettingsTable::clearCache();
+
 	return "";
 }
@@ -3,6 +3,9 @@
 
 #define INSTANCE_COLUMN QString("hyperhdr_instance")
 
+QMutex SettingsTable::_cacheLock;
+QMap<QString, QString> SettingsTable::_cache;
+
 SettingsTable::SettingsTable(quint8 instance, QObject* parent)
 	: DBManager(parent)
 	, _hyperhdr_inst(instance)
@@ -30,7 +33,15 @@ bool SettingsTable::createSettingsRecord(const QString& type, const QString& con
 	// when a setting is not global we are searching also for the instance
 	if (!isSettingGlobal(type))
 		cond.append(CPair("AND " + INSTANCE_COLUMN, _hyperhdr_inst));
-	return createRecord(cond, map);
+
+	// the DB is written without the lock, the readers only wait for the cache update
+	if (!createRecord(cond, map))
+		return false;
+
+	QMutexLocker lock(&_cacheLock);
+
+	_cache[cacheKey(type)] = config;
+	return true;
 }
 
 ///
@@ -41,6 +52,13 @@ bool SettingsTable::createSettingsRecord(const QString& type, const QString& con
 ///
 bool SettingsTable::recordExist(const QString& type) const
 {
+	{
+		QMutexLocker lock(&_cacheLock);
+
+		if (!_cache.value(cacheKey(type)).isEmpty())
+			return true;
+	}
+
 	VectorPair cond;
 	cond.append(CPair("type", type));
 	// when a setting is not global we are searching also for the instance
@@ -56,14 +74,7 @@ bool SettingsTable::recordExist(const QString& type) const
 ///
 QJsonDocument SettingsTable::getSettingsRecord(const QString& type) const
 {
-	QVariantMap results;
-	VectorPair cond;
-	cond.append(CPair("type", type));
-	// when a setting is not global we are searching also for the instance
-	if (!isSettingGlobal(type))
-		cond.append(CPair("AND " + INSTANCE_COLUMN, _hyperhdr_inst));
-	getRecord(cond, results, QStringList("config"));
-	return QJsonDocument::fromJson(results["config"].toByteArray());
+	return QJsonDocument::fromJson(getSettingsRecordString(type).toUtf8());
 }
 
 ///
@@ -73,14 +84,36 @@ QJsonDocument SettingsTable::getSettingsRecord(const QString& type) const
 ///
 QString SettingsTable::getSettingsRecordString(const QString& type) const
 {
+	const QString key = cacheKey(type);
+
+	{
+		QMutexLocker lock(&_cacheLock);
+
+		auto cached = _cache.constFind(key);
+		if (cached != _cache.constEnd())
+			return cached.value();
+	}
+
 	QVariantMap results;
 	VectorPair cond;
 	cond.append(CPair("type", type));
 	// when a setting is not global we are searching also for the instance
 	if (!isSettingGlobal(type))
 		cond.append(CPair("AND " + INSTANCE_COLUMN, _hyperhdr_inst));
-	getRecord(cond, results, QStringList("config"));
-	return results["config"].toString();
+
+	// a failed query is not cached
+	if (!getRecord(cond, results, QStringList("config")))
+		return QString();
+
+	const QString config = results["config"].toString();
+
+	// a writer that came in the meantime has already stored the newer data
+	QMutexLocker lock(&_cacheLock);
+
+	if (!_cache.contains(key))
+		_cache.insert(key, config);
+
+	return config;
 }
 
 bool SettingsTable::deleteSettingsRecordString(const QString& type) const
@@ -91,7 +124,13 @@ bool SettingsTable::deleteSettingsRecordString(const QString& type) const
 	// when a setting is not global we are searching also for the instance
 	if (!isSettingGlobal(type))
 		cond.append(CPair("AND " + INSTANCE_COLUMN, _hyperhdr_inst));
-	return deleteRecord(cond);
+
+	bool result = deleteRecord(cond);
+
+	QMutexLocker lock(&_cacheLock);
+
+	_cache.remove(cacheKey(type));
+	return result;
 }
 
 bool SettingsTable::purge(const QString& type) const
@@ -99,8 +138,19 @@ bool SettingsTable::purge(const QString& type) const
 	QVariantMap results;
 	VectorPair cond;
 	cond.append(CPair("type", type));
-	// when a setting is not global we are searching also for the instance
-	return deleteRecord(cond);
+
+	bool result = deleteRecord(cond);
+
+	QMutexLocker lock(&_cacheLock);
+
+	// the records of all the instances
+	for (auto it = _cache.begin(); it != _cache.end(); )
+		if (it.key() == type || it.key().startsWith(type + "@"))
+			it = _cache.erase(it);
+		else
+			++it;
+
+	return result;
 }
 ///
 /// @brief Delete all settings entries associated with this instance, called from InstanceTable of HyperHDRIManager
@@ -109,7 +159,17 @@ void SettingsTable::deleteInstance() const
 {
 	VectorPair cond;
 	cond.append(CPair(INSTANCE_COLUMN, _hyperhdr_inst));
+
 	deleteRecord(cond);
+
+	QMutexLocker lock(&_cacheLock);
+
+	const QString suffix = QString("@%1").arg(_hyperhdr_inst);
+	for (auto it = _cache.begin(); it != _cache.end(); )
+		if (it.key().endsWith(suffix))
+			it = _cache.erase(it);
+		else
+			++it;
 }
 
 bool SettingsTable::isSettingGlobal(const QString& type) const
@@ -129,3 +189,15 @@ bool SettingsTable::isSettingGlobal(const QString& type) const
 
 	return list.contains(type);
 }
+
+void SettingsTable::clearCache()
+{
+	QMutexLocker lock(&_cacheLock);
+
+	_cache.clear();
+}
+
+QString SettingsTable::cacheKey(const QString& type) const
+{
+	return (isSettingGlobal(type)) ? type : QString("%1@%2").arg(type).arg(_hyperhdr_inst);
+}
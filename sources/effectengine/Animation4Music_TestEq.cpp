@@ -64,7 +64,7 @@ bool Animation4Music_TestEq::hasOwnImage()
 bool Animation4Music_TestEq::getImage(Image<ColorRgb>& newImage)
 {
 	uint8_t  buffScaledResult[SOUNDCAP_RESULT_RES];
-	auto r = SoundCapture::getInstance()->hasResult(_internalIndex);
+	auto r = SoundCapture::getInstance()->hasResult(this, _internalIndex);
 
 	if (r == NULL)
 		return false;
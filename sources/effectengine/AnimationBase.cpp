@@ -87,3 +87,18 @@ bool AnimationBase::hasLedData(QVector<ColorRgb>& buffer)
 	return false;
 }
 
+bool AnimationBase::hasLedRender()
+{
+	return false;
+}
+
+bool AnimationBase::render(ColorRgb* leds, int count, qint64 time)
+{
+	return false;
+}
+
+int AnimationBase::getPeriodFrames()
+{
+	return 0;
+}
+
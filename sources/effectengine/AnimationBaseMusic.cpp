@@ -26,11 +26,17 @@
 */
 
 #include <effectengine/AnimationBaseMusic.h>
+#include <base/SoundCapture.h>
 
 AnimationBaseMusic::AnimationBaseMusic(QString name) :
-	AnimationBase(name)
+	AnimationBase(name),
+	_soundResult(new SoundCaptureResult()),
+	_missedResults(0)
+{
+};
+
+AnimationBaseMusic::~AnimationBaseMusic()
 {
-	_myTarget.Clear();
 };
 
 QJsonObject AnimationBaseMusic::GetArgs() {
@@ -45,12 +51,9 @@ bool AnimationBaseMusic::isSoundEffect()
 	return true;
 };
 
-void AnimationBaseMusic::store(MovingTarget* source) {
-	_myTarget.CopyFrom(source);
-};
-
-void AnimationBaseMusic::restore(MovingTarget* target) {
-	target->CopyFrom(&_myTarget);
+uint32_t AnimationBaseMusic::getMissedResults() const
+{
+	return _missedResults;
 };
 
 void MovingTarget::Clear()
@@ -146,7 +146,12 @@ bool Animation_Fade::Play(QPainter* painter)
 	return true;
 }
 
-bool Animation_Fade::hasLedData(QVector<ColorRgb>& buffer)
+bool Animation_Fade::hasLedRender()
+{
+	return true;
+}
+
+bool Animation_Fade::render(ColorRgb* leds, int count, qint64 time)
 {
 	if (currentStep == STEP_1)
 	{
@@ -241,6 +246,6 @@ bool Animation_Fade::hasLedData(QVector<ColorRgb>& buffer)
 			return false;
 	}
 
-	buffer.fill({ current.x, current.y, current.z });
+	std::fill(leds, leds + count, ColorRgb{ current.x, current.y, current.z });
 	return true;
 }
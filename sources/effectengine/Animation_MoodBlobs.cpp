@@ -77,6 +77,28 @@ bool Animation_MoodBlobs::Play(QPainter* painter)
 	return true;
 }
 
+void Animation_MoodBlobs::buildColorData(double baseHue)
+{
+	// the hue changes along one sine period of the leds
+	if (static_cast<int>(hueWave.size()) != hyperledCount)
+	{
+		hueWave.resize(hyperledCount);
+		EffectMath::sinSeries(0, 2 * M_PI / hyperledCount, hyperledCount, hueWave.data());
+	}
+
+	hueTable.build(baseHsv.y, baseHsv.z);
+
+	colorData.clear();
+	for (int i = 0; i < hyperledCount; i++)
+	{
+		int hue = (int(360.0 * fmod((baseHue + hueChange * hueWave[i]), 1.0)));
+		while (hue < 0)
+			hue += 360;
+		const ColorRgb& rgb = hueTable[hue % 360];
+		colorData.append(Point3d{ rgb.red, rgb.green, rgb.blue });
+	}
+}
+
 bool Animation_MoodBlobs::hasLedData(QVector<ColorRgb>& buffer)
 {
 	if (buffer.length() != hyperledCount && buffer.length() > 1)
@@ -109,16 +131,7 @@ bool Animation_MoodBlobs::hasLedData(QVector<ColorRgb>& buffer)
 			baseHsvx = int((360.0 * static_cast <float> (rand())) / static_cast <float> (RAND_MAX));
 		}
 
-		colorData.clear();
-		for (int i = 0; i < hyperledCount; i++)
-		{
-			Point3d rgb;
-			int hue = (int(360.0 * fmod((baseHsvx + hueChange * std::sin(2 * M_PI * i / hyperledCount)), 1.0)));
-			while (hue < 0)
-				hue += 360;
-			ColorSys::hsv2rgb(hue, baseHsv.y, baseHsv.z, rgb.x, rgb.y, rgb.z);
-			colorData.append(rgb);
-		}
+		buildColorData(baseHsvx);
 
 
 		sleepTime = 0.1;
@@ -162,16 +175,7 @@ bool Animation_MoodBlobs::hasLedData(QVector<ColorRgb>& buffer)
 					baseHSVValue = fmod((baseHSVValue + baseColorChangeIncreaseValue), 1.0);
 				}
 
-				colorData.clear();
-				for (int i = 0; i < hyperledCount; i++)
-				{
-					Point3d rgb;
-					int hue = (int(360.0 * fmod((baseHSVValue + hueChange * std::sin(2 * M_PI * i / hyperledCount)), 1.0)));
-					while (hue < 0)
-						hue += 360;
-					ColorSys::hsv2rgb(hue, baseHsv.y, baseHsv.z, rgb.x, rgb.y, rgb.z);
-					colorData.append(rgb);
-				}
+				buildColorData(baseHSVValue);
 
 				if (colorDataIncrement >= 0)
 					for (int i = 0; i < colorDataIncrement * numberOfRotates; i++)
@@ -183,9 +187,12 @@ bool Animation_MoodBlobs::hasLedData(QVector<ColorRgb>& buffer)
 			baseColorChangeStepCount += 1;
 		}
 
+		amplitudeWave.resize(hyperledCount);
+		EffectMath::sinSeries(-amplitudePhase, (2 * M_PI * blobs) / double(hyperledCount), hyperledCount, amplitudeWave.data());
+
 		for (int i = 0; i < hyperledCount; i++)
 		{
-			double amplitude = std::max(0.0, std::sin(-amplitudePhase + (2 * M_PI * blobs * i) / double(hyperledCount)));
+			double amplitude = std::max(0.0, amplitudeWave[i]);
 			buffer[i].red = int(colorData[i].x * amplitude);
 			buffer[i].green = int(colorData[i].y * amplitude);
 			buffer[i].blue = int(colorData[i].z * amplitude);
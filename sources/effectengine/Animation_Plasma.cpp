@@ -100,18 +100,39 @@ bool Animation_Plasma::Play(QPainter* painter)
 {
 	bool ret = true;
 
-	qint64 mod = start++;
+	qint64 mod = start;
+	start = (start + 1) % PAL_LEN;
+
+	// the pixels are written to the image directly, a pen and a point per pixel cost much more
+	QImage* image = (painter->device()->devType() == QInternal::Image) ? static_cast<QImage*>(painter->device()) : nullptr;
+	const bool direct = image != nullptr && image->width() >= PLASMA_WIDTH && image->height() >= PLASMA_HEIGHT &&
+						(image->format() == QImage::Format_ARGB32_Premultiplied || image->format() == QImage::Format_ARGB32 || image->format() == QImage::Format_RGB32);
+
 	for (int y = 0; y < PLASMA_HEIGHT; y++)
+	{
+		int delta = y * PLASMA_WIDTH;
+		QRgb* scanline = (direct) ? reinterpret_cast<QRgb*>(image->scanLine(y)) : nullptr;
+
 		for (int x = 0; x < PLASMA_WIDTH; x++) {
-			int delta = y * PLASMA_WIDTH;
 			int palIndex = int((plasma[delta + x] + mod) % PAL_LEN) * 3;
 
-			painter->setPen(qRgb(pal[palIndex], pal[palIndex + 1], pal[palIndex + 2]));
-			painter->drawPoint(x, y);
+			if (direct)
+				scanline[x] = qRgb(pal[palIndex], pal[palIndex + 1], pal[palIndex + 2]);
+			else
+			{
+				painter->setPen(qRgb(pal[palIndex], pal[palIndex + 1], pal[palIndex + 2]));
+				painter->drawPoint(x, y);
+			}
 		}
+	}
 	return ret;
 }
 
+int Animation_Plasma::getPeriodFrames()
+{
+	return PAL_LEN;
+}
+
 QJsonObject Animation_Plasma::GetArgs() {
 	QJsonObject doc;
 	doc["smoothing-custom-settings"] = false;
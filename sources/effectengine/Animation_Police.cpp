@@ -37,6 +37,7 @@ Animation_Police::Animation_Police(QString name) :
 	ledData.resize(0);
 	colorsCount = 1000;
 	increment = 1;
+	shift = 0;
 };
 
 
@@ -54,11 +55,16 @@ bool Animation_Police::Play(QPainter* painter)
 	return true;
 }
 
-bool Animation_Police::hasLedData(QVector<ColorRgb>& buffer)
+bool Animation_Police::hasLedRender()
 {
-	if (buffer.length() != ledData.length() && buffer.length() > 1)
+	return true;
+}
+
+bool Animation_Police::render(ColorRgb* leds, int count, qint64 time)
+{
+	if (count != ledData.length() && count > 1)
 	{
-		int hledCount = buffer.length();
+		int hledCount = count;
 		ledData.clear();
 
 		rotationTime = std::max(0.1, rotationTime);
@@ -90,22 +96,16 @@ bool Animation_Police::hasLedData(QVector<ColorRgb>& buffer)
 		SetSleepTime(int(round(sleepTime * 1000.0)));
 
 		increment %= hledCount;
-		ledData.swap(buffer);
+		shift = 0;
 	}
 
-	if (buffer.length() == ledData.length())
+	if (count == ledData.length())
 	{
-		if (reverse)
-		{
-			for (int i = 0; i < increment; i++)
-				buffer.move(0, buffer.size() - 1);
-		}
-		else
-		{
-			for (int i = 0; i < increment; i++)
-				buffer.move(buffer.size() - 1, 0);
-		}
+		// the pattern rotates by the increment on every frame, to the end or (reverse) to the start
+		shift = (shift + (reverse ? count - increment : increment)) % count;
 
+		for (int i = 0, source = count - shift; i < count; i++, source++)
+			leds[i] = ledData[(source < count) ? source : source - count];
 	}
 	return true;
 }
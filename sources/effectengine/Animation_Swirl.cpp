@@ -219,6 +219,11 @@ bool Animation_Swirl::Play(QPainter* painter)
 	return ret;
 }
 
+int Animation_Swirl::getPeriodFrames()
+{
+	// both angles step through 0..360, a random center is new for every run
+	return (random_center || (S2 && random_center2)) ? 0 : 361;
+}
 
 bool Animation_Swirl::imageConicalGradient(QPainter* painter, int centerX, int centerY, int angle, const QList<Animation_Swirl::SwirlGradient>& bytearray)
 {
@@ -161,6 +161,11 @@ bool Animation_Waves::Play(QPainter* painter)
 	return ret;
 }
 
+int Animation_Waves::getPeriodFrames()
+{
+	// the positions step through 0..255, the random reverse time and center are not repeatable
+	return (reverse_time >= 1 || random_center) ? 0 : 256;
+}
 
 bool Animation_Waves::imageRadialGradient(QPainter* painter, int centerX, int centerY, int angle, const QList<Animation_Swirl::SwirlGradient>& bytearray)
 {
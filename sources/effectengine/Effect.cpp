@@ -32,7 +32,11 @@
 
 // effect engin eincludes
 #include <effectengine/Effect.h>
+#include <effectengine/EffectScheduler.h>
+#include <effectengine/EffectFrameCache.h>
 #include <utils/Logger.h>
+#include <utils/PreciseTimer.h>
+#include <utils/PerformanceCounters.h>
 #include <base/HyperHdrInstance.h>
 #include <effectengine/Animation_RainbowSwirl.h>
 #include <effectengine/Animation_RainbowWaves.h>
@@ -94,8 +98,14 @@
 
 #include <base/SoundCapture.h>
 
+namespace
+{
+	/// the next check of a parked effect [ms], it is woken up earlier by the visible priority
+	const qint64 PARKED_TIME = 60000;
+}
+
 Effect::Effect(HyperHdrInstance* hyperhdr, int visiblePriority, int priority, int timeout, const QString& name, const QJsonObject& args, const QString& imageData)
-	: QThread()
+	: QObject()
 	, _hyperhdr(hyperhdr)
 	, _visiblePriority(visiblePriority)
 	, _priority(priority)
@@ -110,6 +120,12 @@ Effect::Effect(HyperHdrInstance* hyperhdr, int visiblePriority, int priority, in
 	, _painter(NULL)
 	, _effect(NULL)
 	, _soundHandle(0)
+	, _started(false)
+	, _playing(false)
+	, _nextTime(-1)
+	, _reportId(hyperhdr->getInstanceIndex() * 256 + priority)
+	, _cachedIndex(0)
+	, _ownImageIndex(0)
 {
 	_ledCount = _hyperhdr->getLedCount();
 	_colors.resize(_ledCount);
@@ -363,12 +379,22 @@ Effect::~Effect()
 	Info(_log, "Effect named: '%s' is deleted", QSTRING_CSTR(_name));
 }
 
-void Effect::run()
+void Effect::start()
+{
+	EffectScheduler::getInstance()->add(this);
+}
+
+void Effect::wait()
+{
+	EffectScheduler::getInstance()->waitFor(this);
+}
+
+bool Effect::begin()
 {
 	if (_effect == NULL)
 	{
 		Error(_log, "Unable to find effect by this name. Please review configuration. Effect name: '%s'", QSTRING_CSTR(_name));
-		return;
+		return false;
 	}
 
 	int latchTime = 10;
@@ -379,6 +405,24 @@ void Effect::run()
 
 	_painter = new QPainter(&_image);
 
+	const int periodFrames = (!_effect->hasOwnImage() && !_effect->hasLedRender()) ? _effect->getPeriodFrames() : 0;
+	if (periodFrames > 0)
+	{
+		const QString key = EffectFrameCache::makeKey(_name, _args, _image.size());
+
+		_cachedFrames = EffectFrameCache::getInstance()->find(key);
+		if (_cachedFrames.isValid())
+		{
+			Debug(_log, "Playing back %i cached frames of the effect", _cachedFrames.count);
+		}
+		else if (static_cast<qint64>(periodFrames) * _image.width() * _image.height() * 3 <= EffectFrameCache::MAX_CACHE_SIZE)
+		{
+			_cacheKey = key;
+			_recording.size = _image.size();
+			_recording.data.reserve(periodFrames * _image.width() * _image.height() * 3);
+		}
+	}
+
 	if (_timeout > 0)
 	{
 		_endTime = InternalClock::now() + _timeout;
@@ -389,81 +433,174 @@ void Effect::run()
 		if (!_interupt)
 			SAFE_CALL_0_RET(SoundCapture::getInstance(), getCaptureInstance, uint32_t, _soundHandle)
 		else
-			return;
+			return false;
 	}
 
 	Info(_log, "Begin playing the effect with priority: %i", _priority);
-	while (!_interupt && (_timeout <= 0 || InternalClock::now() < _endTime))
+	_playing = true;
+	_nextTime = InternalClock::now();
+	reportStats();
+
+	return true;
+}
+
+void Effect::end()
+{
+	if (_playing)
+	{
+		Info(_log, "The effect quits with priority: %i", _priority);
+		emit PerformanceCounters::getInstance()->removeCounter(static_cast<int>(PerformanceReportType::EFFECT), _reportId);
+	}
+
+	if (_soundHandle != 0)
+	{
+		Info(_log, "Releasing sound handle %i for effect named: '%s'", _soundHandle, QSTRING_CSTR(_name));
+		auto music = qobject_cast<AnimationBaseMusic*>(_effect);
+		if (music != nullptr && music->getMissedResults() > 0)
+			Debug(_log, "The effect missed %u sound analyses", music->getMissedResults());
+		QUEUE_CALL_1(SoundCapture::getInstance(), releaseCaptureInstance, uint32_t, _soundHandle);
+		_soundHandle = 0;
+	}
+
+	emit finished();
+}
+
+qint64 Effect::step()
+{
+	if (!_started)
 	{
-		if (_priority > 0)
+		_started = true;
+		if (!begin())
 		{
-			if (_visiblePriority < _priority)
-			{				
-				if (!_interupt && (_timeout <= 0 || InternalClock::now() < _endTime))
-					QThread::msleep(500);
-				continue;
-			}
+			end();
+			return -1;
 		}
+	}
 
-		bool   hasLedData = false;
+	if (_interupt || (_timeout > 0 && InternalClock::now() >= _endTime))
+	{
+		end();
+		return -1;
+	}
 
-		if (!_effect->hasOwnImage())
-		{
-			_effect->Play(_painter);
+	if (!isVisible(_visiblePriority))
+	{
+		// parked until the priority is visible again or the effect is interrupted, both wake it up
+		_nextTime = -1;
+		return (_timeout > 0) ? _endTime : InternalClock::now() + PARKED_TIME;
+	}
 
-			hasLedData = _effect->hasLedData(_ledBuffer);
-		}
+	// the schedule starts again after the effect was parked
+	if (_nextTime < 0)
+		_nextTime = InternalClock::now();
 
-		int    micro = _effect->GetSleepTime();
-		qint64 dieTime = InternalClock::now() + micro;
+	const qint64 renderBegin = PreciseTimer::now();
+	bool   hasLedData = false;
 
-		if (_effect->hasOwnImage())
+	if (_cachedFrames.isValid())
+	{
+		// ImageShow plays back the recorded period instead of the painter
+	}
+	else if (_effect->hasLedRender())
+	{
+		// the colors go straight to the leds, without the image of the painter
+		const int ledCount = _ledCount;
+		if (static_cast<int>(_ledColors.size()) != ledCount)
+			_ledColors.resize(ledCount, ColorRgb::BLACK);
+
+		hasLedData = _effect->render(_ledColors.data(), ledCount, InternalClock::now());
+	}
+	else if (!_effect->hasOwnImage())
+	{
+		_effect->Play(_painter);
+
+		hasLedData = _effect->hasLedData(_ledBuffer);
+		if (hasLedData)
+			_ledColors.assign(_ledBuffer.begin(), _ledBuffer.end());
+	}
+
+	if (_effect->hasOwnImage())
+	{
+		int timeout = _timeout;
+		if (timeout > 0)
 		{
-			Image<ColorRgb> image(80, 45);
-			int timeout = _timeout;
-			if (timeout > 0)
+			timeout = _endTime - InternalClock::now();
+			if (timeout <= 0)
 			{
-				timeout = _endTime - InternalClock::now();
-				if (timeout <= 0)
-					break;
+				end();
+				return -1;
 			}
-
-			if (_effect->getImage(image))
-				emit setInputImage(_priority, image, timeout, false);
-		}
-		else if (hasLedData)
-		{
-			if (!LedShow())
-				break;
-		}
-		else
-		{
-			ImageShow();
 		}
 
-		if (_effect->isStop())
-			break;
+		Image<ColorRgb>& image = getOwnImage();
+		if (_effect->getImage(image))
+			emit setInputImage(_priority, image, timeout, false);
+	}
+	else if (hasLedData)
+	{
+		// only the images are recorded
+		_cacheKey.clear();
+		_recording = EffectFrameCache::Frames();
 
-		while (!_interupt && InternalClock::now() < dieTime &&
-			(_timeout <= 0 || InternalClock::now() < _endTime))
+		if (!LedShow())
 		{
-			micro = dieTime - InternalClock::now();
-			while (micro > 200)
-				micro /= 2;
-
-			if (micro > 0)
-				QThread::msleep(micro);
+			end();
+			return -1;
 		}
 	}
+	else
+	{
+		ImageShow();
+	}
 
-	Info(_log, "The effect quits with priority: %i", _priority);
+	if (_effect->isStop())
+	{
+		end();
+		return -1;
+	}
 
-	if (_soundHandle != 0)
+	const qint64 renderTime = (PreciseTimer::now() - renderBegin) / 1000;
+	_stats.frames++;
+	_stats.renderSum += renderTime;
+	_stats.renderMax = qMax(_stats.renderMax, renderTime);
+	reportStats();
+
+	// the deadlines follow the period of the effect, so the render time does not add to it.
+	// A frame that is already late is not caught up: the schedule continues from now.
+	const qint64 now = InternalClock::now();
+	_nextTime += _effect->GetSleepTime();
+	if (_nextTime < now)
 	{
-		Info(_log, "Releasing sound handle %i for effect named: '%s'", _soundHandle, QSTRING_CSTR(_name));
-		QUEUE_CALL_1(SoundCapture::getInstance(), releaseCaptureInstance, uint32_t, _soundHandle);
-		_soundHandle = 0;
+		_stats.late++;
+		_nextTime = now;
 	}
+
+	return (_timeout > 0) ? qMin(_nextTime, _endTime) : _nextTime;
+}
+
+bool Effect::isVisible(int visiblePriority) const
+{
+	return _priority <= 0 || visiblePriority >= _priority;
+}
+
+void Effect::reportStats()
+{
+	const qint64 token = PerformanceCounters::currentToken();
+
+	if (token == _stats.token)
+		return;
+
+	const qint64 now = InternalClock::now();
+	const qint64 diff = now - _stats.begin;
+
+	if (_stats.token >= 0 && _stats.frames > 0 && diff > 0)
+		emit PerformanceCounters::getInstance()->newCounter(
+			PerformanceReport(static_cast<int>(PerformanceReportType::EFFECT), token, _name, _stats.frames * 1000.0 / diff,
+				_stats.renderSum / _stats.frames, _stats.renderMax, _stats.late, _reportId));
+
+	_stats = EffectStats();
+	_stats.token = token;
+	_stats.begin = now;
 }
 
 bool Effect::LedShow()
@@ -479,10 +616,9 @@ bool Effect::LedShow()
 			return false;
 	}
 
-	if (_ledCount == _ledBuffer.length())
+	if (_ledCount == static_cast<int>(_ledColors.size()))
 	{
-		QVector<ColorRgb> _cQV = _ledBuffer;
-		emit setInput(_priority, std::vector<ColorRgb>(_cQV.begin(), _cQV.end()), timeout, false);
+		emit setInput(_priority, _ledColors, timeout, false);
 	}
 	else
 	{
@@ -510,28 +646,72 @@ bool Effect::ImageShow()
 	int height = _image.height();
 
 	Image<ColorRgb> image(width, height);
-	QByteArray binaryImage;
 
-	for (int i = 0; i < height; ++i)
+	if (_cachedFrames.isValid())
 	{
-		const QRgb* scanline = reinterpret_cast<const QRgb*>(_image.scanLine(i));
-		for (int j = 0; j < width; ++j)
+		memcpy(image.rawMem(), _cachedFrames.frame(_cachedIndex), image.size());
+		_cachedIndex = (_cachedIndex + 1) % _cachedFrames.count;
+	}
+	else
+	{
+		uint8_t* target = image.rawMem();
+
+		for (int i = 0; i < height; ++i)
 		{
-			binaryImage.append((char)qRed(scanline[j]));
-			binaryImage.append((char)qGreen(scanline[j]));
-			binaryImage.append((char)qBlue(scanline[j]));
+			const QRgb* scanline = reinterpret_cast<const QRgb*>(_image.scanLine(i));
+			for (int j = 0; j < width; ++j)
+			{
+				*(target++) = qRed(scanline[j]);
+				*(target++) = qGreen(scanline[j]);
+				*(target++) = qBlue(scanline[j]);
+			}
 		}
+
+		if (!_cacheKey.isEmpty())
+			recordFrame(image);
 	}
 
-	memcpy(image.rawMem(), binaryImage.data(), binaryImage.size());
 	emit setInputImage(_priority, image, timeout, false);
 
 	return true;
 }
 
+Image<ColorRgb>& Effect::getOwnImage()
+{
+	// the muxer keeps the last frame, so the one before it is usually free again
+	for (Image<ColorRgb>& image : _ownImages)
+		if (!image.isShared() && image.width() == static_cast<unsigned>(_imageSize.width()) && image.height() == static_cast<unsigned>(_imageSize.height()))
+			return image;
+
+	_ownImageIndex = (_ownImageIndex + 1) % 2;
+	_ownImages[_ownImageIndex] = Image<ColorRgb>(_imageSize.width(), _imageSize.height());
+
+	return _ownImages[_ownImageIndex];
+}
+
+void Effect::recordFrame(const Image<ColorRgb>& image)
+{
+	_recording.data.append(reinterpret_cast<const char*>(image.rawMem()), static_cast<int>(image.size()));
+
+	if (++_recording.count < _effect->getPeriodFrames())
+		return;
+
+	// the next frame of the painter would be the first one again
+	EffectFrameCache::getInstance()->insert(_cacheKey, _recording);
+	Debug(_log, "Recorded %i frames of the effect", _recording.count);
+
+	_cachedFrames = _recording;
+	_cachedIndex = 0;
+	_recording = EffectFrameCache::Frames();
+	_cacheKey.clear();
+}
+
 void Effect::visiblePriorityChanged(quint8 priority)
 {
-	_visiblePriority = priority;
+	const bool wasVisible = isVisible(_visiblePriority.exchange(priority));
+
+	if (!wasVisible && isVisible(priority))
+		EffectScheduler::getInstance()->wake(this);
 }
 
 void Effect::setLedCount(int newCount)
@@ -545,6 +725,7 @@ int  Effect::getPriority() const {
 
 void Effect::requestInterruption() {
 	_interupt = true;
+	EffectScheduler::getInstance()->wake(this);
 }
 
 bool Effect::isInterruptionRequested() {
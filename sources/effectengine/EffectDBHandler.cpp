@@ -101,19 +101,26 @@ EffectDBHandler::EffectDBHandler(const QString& rootPath, const QJsonDocument& e
 	, _effectConfig()
 	, _log(Logger::getInstance("EFFECTDB"))
 	, _rootPath(rootPath)
+	, _effectsLoaded(false)
 {
 	EffectDBHandler::efhInstance = this;
 
-	// init
-	handleSettingsUpdate(settings::type::EFFECTS, effectConfig);
+	// the definitions are collected on the first use
+	_effectConfig = effectConfig.object();
 }
 
 void EffectDBHandler::handleSettingsUpdate(settings::type type, const QJsonDocument& config)
 {
 	if (type == settings::type::EFFECTS)
 	{
-		_effectConfig = config.object();
-		updateEffects();
+		{
+			std::lock_guard<std::mutex> lockGuard(_effectsLock);
+
+			_effectConfig = config.object();
+			_effectsLoaded = false;
+		}
+
+		emit effectListChanged();
 	}
 }
 
@@ -237,7 +244,7 @@ void EffectDBHandler::updateEffects()
 
 	ErrorIf(_availableEffects.size() == 0, _log, "No effects found... something gone wrong");
 
-	emit effectListChanged();
+	_effectsLoaded = true;
 }
 
 EffectDBHandler* EffectDBHandler::getInstance()
@@ -245,7 +252,12 @@ EffectDBHandler* EffectDBHandler::getInstance()
 	return efhInstance;
 }
 
-std::list<EffectDefinition> EffectDBHandler::getEffects() const
+std::list<EffectDefinition> EffectDBHandler::getEffects()
 {
+	std::lock_guard<std::mutex> lockGuard(_effectsLock);
+
+	if (!_effectsLoaded)
+		updateEffects();
+
 	return _availableEffects;
 }
@@ -41,6 +41,7 @@
 EffectEngine::EffectEngine(HyperHdrInstance* hyperhdr)
 	: _hyperInstance(hyperhdr)
 	, _availableEffects()
+	, _effectsLoaded(false)
 	, _activeEffects()
 	, _log(Logger::getInstance(QString("EFFECTENGINE%1").arg(hyperhdr->getInstanceIndex())))
 	, _effectDBHandler(EffectDBHandler::getInstance())
@@ -51,11 +52,8 @@ EffectEngine::EffectEngine(HyperHdrInstance* hyperhdr)
 	connect(_hyperInstance, &HyperHdrInstance::channelCleared, this, &EffectEngine::channelCleared);
 	connect(_hyperInstance, &HyperHdrInstance::allChannelsCleared, this, &EffectEngine::allChannelsCleared);
 
-	// get notifications about refreshed effect list
+	// get notifications about refreshed effect list, the smooth cfgs are registered when an effect is needed
 	connect(_effectDBHandler, &EffectDBHandler::effectListChanged, this, &EffectEngine::handleUpdatedEffectList);
-
-	// register smooth cfgs and fill available effects
-	handleUpdatedEffectList();
 }
 
 EffectEngine::~EffectEngine()
@@ -65,10 +63,7 @@ EffectEngine::~EffectEngine()
 	_activeEffects.clear();
 
 	for (Effect* effect : copy)
-	{
 		effect->requestInterruption();
-		effect->quit();
-	}
 
 	for (Effect* effect : copy)
 	{
@@ -88,7 +83,7 @@ int EffectEngine::runEffectScript(const QString& name, const QJsonObject& args,
 	Effect* effect = new Effect(_hyperInstance, _hyperInstance->getCurrentPriority(), priority, timeout, name, args, imageData);
 	connect(effect, &Effect::setInput, this, &EffectEngine::gotLedsHandler, Qt::QueuedConnection);
 	connect(effect, &Effect::setInputImage, _hyperInstance, &HyperHdrInstance::setInputImage, Qt::QueuedConnection);
-	connect(effect, &QThread::finished, this, &EffectEngine::effectFinished);
+	connect(effect, &Effect::finished, this, &EffectEngine::effectFinished);
 	connect(_hyperInstance, &HyperHdrInstance::finished, effect, &Effect::requestInterruption, Qt::DirectConnection);
 	_activeEffects.push_back(effect);
 
@@ -132,8 +127,10 @@ void EffectEngine::visiblePriorityChanged(quint8 priority)
 	}
 }
 
-std::list<EffectDefinition> EffectEngine::getEffects() const
+std::list<EffectDefinition> EffectEngine::getEffects()
 {
+	loadEffects();
+
 	return _availableEffects;
 }
 
@@ -193,6 +190,15 @@ void EffectEngine::startCachedEffects()
 
 void EffectEngine::handleUpdatedEffectList()
 {
+	_effectsLoaded = false;
+}
+
+void EffectEngine::loadEffects()
+{
+	if (_effectsLoaded)
+		return;
+
+	_effectsLoaded = true;
 	_availableEffects.clear();
 
 	unsigned id = 2;
@@ -222,6 +228,9 @@ void EffectEngine::handleUpdatedEffectList()
 int EffectEngine::runEffect(const QString& effectName, int priority, int timeout, const QString& origin)
 {
 	unsigned smoothCfg = 0;
+
+	loadEffects();
+
 	for (auto def : _availableEffects)
 	{
 		if (def.name == effectName)
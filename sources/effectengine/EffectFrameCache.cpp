@@ -0,0 +1,86 @@
+/* EffectFrameCache.cpp
+*
+*  MIT License
+*
+*  Copyright (c) 2023 awawa-dev
+*
+*  Project homesite: https://github.com/awawa-dev/HyperHDR
+*
+*  Permission is hereby granted, free of charge, to any person obtaining a copy
+*  of this software and associated documentation files (the "Software"), to deal
+*  in the Software without restriction, including without limitation the rights
+*  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+*  copies of the Software, and to permit persons to whom the Software is
+*  furnished to do so, subject to the following conditions:
+*
+*  The above copyright notice and this permission notice shall be included in all
+*  copies or substantial portions of the Software.
+
+*  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+*  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+*  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+*  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+*  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+*  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+*  SOFTWARE.
+*/
+
+
+#include <QJsonDocument>
+
+#include <effectengine/EffectFrameCache.h>
+
+EffectFrameCache* EffectFrameCache::getInstance()
+{
+	static EffectFrameCache instance;
+	return &instance;
+}
+
+EffectFrameCache::EffectFrameCache() :
+	_size(0)
+{
+}
+
+QString EffectFrameCache::makeKey(const QString& name, const QJsonObject& args, const QSize& size)
+{
+	return QString("%1|%2x%3|%4").arg(name).arg(size.width()).arg(size.height()).arg(QString::fromUtf8(QJsonDocument(args).toJson(QJsonDocument::Compact)));
+}
+
+EffectFrameCache::Frames EffectFrameCache::find(const QString& key)
+{
+	QMutexLocker locker(&_mutex);
+
+	auto found = _frames.find(key);
+	if (found == _frames.end())
+		return Frames();
+
+	_usage.removeOne(key);
+	_usage.append(key);
+
+	return found.value();
+}
+
+void EffectFrameCache::insert(const QString& key, const Frames& frames)
+{
+	if (!frames.isValid() || frames.data.size() > MAX_CACHE_SIZE)
+		return;
+
+	QMutexLocker locker(&_mutex);
+
+	auto found = _frames.find(key);
+	if (found != _frames.end())
+	{
+		_size -= found.value().data.size();
+		_usage.removeOne(key);
+	}
+
+	while (!_usage.isEmpty() && _size + frames.data.size() > MAX_CACHE_SIZE)
+	{
+		const QString oldest = _usage.takeFirst();
+		_size -= _frames.take(oldest).data.size();
+	}
+
+	_frames.insert(key, frames);
+	_usage.append(key);
+	_size += frames.data.size();
+}
@@ -0,0 +1,177 @@
+/* EffectScheduler.cpp
+*
+*  MIT License
+*
+*  Copyright (c) 2023 awawa-dev
+*
+*  Project homesite: https://github.com/awawa-dev/HyperHDR
+*
+*  Permission is hereby granted, free of charge, to any person obtaining a copy
+*  of this software and associated documentation files (the "Software"), to deal
+*  in the Software without restriction, including without limitation the rights
+*  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+*  copies of the Software, and to permit persons to whom the Software is
+*  furnished to do so, subject to the following conditions:
+*
+*  The above copyright notice and this permission notice shall be included in all
+*  copies or substantial portions of the Software.
+
+*  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+*  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+*  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+*  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+*  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+*  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+*  SOFTWARE.
+*/
+
+
+#include <QThread>
+
+#include <effectengine/EffectScheduler.h>
+#include <effectengine/Effect.h>
+#include <utils/InternalClock.h>
+
+namespace
+{
+	/// the effects mostly sleep between the frames, two workers cover several running at once
+	const int WORKER_COUNT = 2;
+}
+
+class EffectWorker : public QThread
+{
+public:
+	EffectWorker(EffectScheduler* scheduler) :
+		_scheduler(scheduler)
+	{
+	}
+
+private:
+	void run() override
+	{
+		_scheduler->work();
+	}
+
+	EffectScheduler* _scheduler;
+};
+
+EffectScheduler* EffectScheduler::getInstance()
+{
+	static EffectScheduler instance;
+	return &instance;
+}
+
+EffectScheduler::EffectScheduler() :
+	_quit(false)
+{
+}
+
+EffectScheduler::~EffectScheduler()
+{
+	{
+		QMutexLocker locker(&_mutex);
+		_quit = true;
+		_condition.wakeAll();
+	}
+
+	for (EffectWorker* worker : _workers)
+	{
+		worker->wait();
+		delete worker;
+	}
+}
+
+void EffectScheduler::add(Effect* effect)
+{
+	QMutexLocker locker(&_mutex);
+
+	_entries.push_back(Entry{ effect, 0, false, false });
+
+	if (_workers.isEmpty())
+		for (int i = 0; i < WORKER_COUNT; i++)
+		{
+			EffectWorker* worker = new EffectWorker(this);
+			worker->setObjectName(QString("EffectWorker%1").arg(i));
+			worker->start();
+			_workers.append(worker);
+		}
+
+	_condition.wakeAll();
+}
+
+void EffectScheduler::wake(Effect* effect)
+{
+	QMutexLocker locker(&_mutex);
+
+	for (Entry& entry : _entries)
+		if (entry.effect == effect)
+		{
+			// a running step is followed at once by the next one
+			if (entry.busy)
+				entry.woken = true;
+			else
+				entry.deadline = 0;
+		}
+
+	_condition.wakeAll();
+}
+
+void EffectScheduler::waitFor(Effect* effect)
+{
+	QMutexLocker locker(&_mutex);
+
+	auto isScheduled = [&]() {
+		for (const Entry& entry : _entries)
+			if (entry.effect == effect)
+				return true;
+		return false;
+	};
+
+	while (!_quit && isScheduled())
+		_condition.wait(&_mutex);
+}
+
+void EffectScheduler::work()
+{
+	QMutexLocker locker(&_mutex);
+
+	while (!_quit)
+	{
+		auto next = _entries.end();
+		for (auto it = _entries.begin(); it != _entries.end(); ++it)
+			if (!it->busy && (next == _entries.end() || it->deadline < next->deadline))
+				next = it;
+
+		if (next == _entries.end())
+		{
+			_condition.wait(&_mutex);
+			continue;
+		}
+
+		const qint64 remaining = next->deadline - InternalClock::now();
+		if (remaining > 0)
+		{
+			// wakes up earlier for a new or woken effect, then the schedule is evaluated again
+			_condition.wait(&_mutex, static_cast<unsigned long>(remaining));
+			continue;
+		}
+
+		// the iterators of the list stay valid while the other entries come and go
+		next->busy = true;
+		next->woken = false;
+		Effect* effect = next->effect;
+
+		locker.unlock();
+		const qint64 deadline = effect->step();
+		locker.relock();
+
+		next->busy = false;
+		if (deadline < 0)
+			_entries.erase(next);
+		else
+			next->deadline = (next->woken) ? 0 : deadline;
+
+		// the other worker may have a closer deadline now, and waitFor may be done
+		_condition.wakeAll();
+	}
+}
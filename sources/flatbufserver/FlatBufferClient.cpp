@@ -9,8 +9,291 @@
 
 // util includes
 #include <utils/FrameDecoder.h>
+#include <utils/PerformanceCounters.h>
+#include <utils/PreciseTimer.h>
+#include <utils/ImageIngest.h>
 
-FlatBufferClient::FlatBufferClient(QTcpSocket* socket, QLocalSocket* domain, int timeout, int hdrToneMappingEnabled, uint8_t* lutBuffer, QObject* parent)
+#include <QThread>
+#include <QMutex>
+#include <QWaitCondition>
+#include <QSharedMemory>
+
+#include <functional>
+
+#include "HyperhdrConfig.h"
+
+#if defined(ENABLE_V4L2) || defined(ENABLE_MF)
+	#include <turbojpeg.h>
+	#define FLATBUFFER_JPEG
+#endif
+
+namespace
+{
+	enum ImageFormat { FORMAT_LZ4 = 0, FORMAT_JPEG = 1 };
+
+	/// 8K: larger sizes in a compressed request are rejected before anything is allocated
+	const qint64 MAX_IMAGE_PIXELS = 7680 * 4320;
+
+	/// the LZ4 block format, the output must fill the image exactly
+	bool decompressLz4Block(const uint8_t* source, size_t sourceSize, uint8_t* target, size_t targetSize)
+	{
+		const uint8_t* in = source;
+		const uint8_t* const inEnd = source + sourceSize;
+		uint8_t* out = target;
+		uint8_t* const outEnd = target + targetSize;
+
+		while (in < inEnd)
+		{
+			const unsigned token = *in++;
+
+			size_t literals = token >> 4;
+			if (literals == 15)
+			{
+				uint8_t next;
+				do
+				{
+					if (in >= inEnd)
+						return false;
+					next = *in++;
+					literals += next;
+				} while (next == 255);
+			}
+
+			if (literals > static_cast<size_t>(inEnd - in) || literals > static_cast<size_t>(outEnd - out))
+				return false;
+
+			memcpy(out, in, literals);
+			in += literals;
+			out += literals;
+
+			// the last sequence has no match
+			if (in == inEnd)
+				break;
+
+			if (inEnd - in < 2)
+				return false;
+
+			const size_t offset = static_cast<size_t>(in[0]) | (static_cast<size_t>(in[1]) << 8);
+			in += 2;
+
+			if (offset == 0 || offset > static_cast<size_t>(out - target))
+				return false;
+
+			size_t match = (token & 15) + 4;
+			if ((token & 15) == 15)
+			{
+				uint8_t next;
+				do
+				{
+					if (in >= inEnd)
+						return false;
+					next = *in++;
+					match += next;
+				} while (next == 255);
+			}
+
+			if (match > static_cast<size_t>(outEnd - out))
+				return false;
+
+			const uint8_t* reference = out - offset;
+			if (offset >= match)
+				memcpy(out, reference, match);
+			else
+			{
+				// the match overlaps its own output: a repeated pattern
+				for (size_t i = 0; i < match; i++)
+					out[i] = reference[i];
+			}
+			out += match;
+		}
+
+		return out == outEnd;
+	}
+}
+
+///
+/// Decodes the compressed images of one client, so the socket thread only copies the payload.
+/// A single image waits for the decoder: a newer one replaces it, the stream stays live when the decoding
+/// is slower than the sender.
+///
+class FlatBufferDecoderThread : public QThread
+{
+public:
+	struct Job
+	{
+		int format = FORMAT_LZ4;
+		QByteArray data;
+		int width = 0;
+		int height = 0;
+		int duration = -1;
+		int priority = 0;
+		int toneMapping = 0;
+		LutHandle lut;
+	};
+
+	struct Stats
+	{
+		qint64 decoded = 0;
+		qint64 replaced = 0;
+		qint64 failed = 0;
+		qint64 durationSum = 0;
+		qint64 durationMax = 0;
+		QString lastError;
+	};
+
+	typedef std::function<void(int priority, const Image<ColorRgb>& image, int duration)> DeliverFunc;
+
+	FlatBufferDecoderThread(FrameRing* frameRing, const DeliverFunc& deliver) :
+		_frameRing(frameRing),
+		_deliver(deliver),
+		_hasJob(false),
+		_quit(false)
+	{
+	}
+
+	~FlatBufferDecoderThread()
+	{
+		{
+			QMutexLocker locker(&_mutex);
+			_quit = true;
+			_condition.wakeAll();
+		}
+		wait();
+	}
+
+	void queue(Job& job)
+	{
+		QMutexLocker locker(&_mutex);
+
+		if (_hasJob)
+			_stats.replaced++;
+
+		_job = std::move(job);
+		_hasJob = true;
+		_condition.wakeAll();
+	}
+
+	Stats takeStats()
+	{
+		QMutexLocker locker(&_mutex);
+
+		Stats stats = _stats;
+		_stats = Stats();
+		return stats;
+	}
+
+protected:
+	void run() override
+	{
+#ifdef FLATBUFFER_JPEG
+		tjhandle decompress = nullptr;
+#endif
+
+		while (true)
+		{
+			Job job;
+
+			{
+				QMutexLocker locker(&_mutex);
+
+				while (!_hasJob && !_quit)
+					_condition.wait(&_mutex);
+
+				if (_quit)
+					break;
+
+				job = std::move(_job);
+				_hasJob = false;
+			}
+
+			const qint64 begin = PreciseTimer::now();
+			Image<ColorRgb> image;
+			QString error;
+
+			// the image is decoded in full, then reduced to the size of the led mappings into a frame of the ring
+			if (job.format == FORMAT_LZ4)
+			{
+				_decoded.resize(job.width, job.height);
+
+				if (!decompressLz4Block(reinterpret_cast<const uint8_t*>(job.data.constData()), job.data.size(), _decoded.rawMem(), _decoded.size()))
+					error = "Invalid LZ4 data or size of the image";
+			}
+#ifdef FLATBUFFER_JPEG
+			else if (job.format == FORMAT_JPEG)
+			{
+				int width = 0, height = 0, subsamp = 0;
+				uint8_t* jpeg = reinterpret_cast<uint8_t*>(job.data.data());
+
+				if (decompress == nullptr)
+					decompress = tjInitDecompress();
+
+				if (decompress == nullptr ||
+					(tjDecompressHeader2(decompress, jpeg, job.data.size(), &width, &height, &subsamp) != 0 && tjGetErrorCode(decompress) == TJERR_FATAL))
+					error = QString(tjGetErrorStr());
+				else if (width <= 0 || height <= 0 || static_cast<qint64>(width) * height > MAX_IMAGE_PIXELS)
+					error = QString("Unsupported size of the JPEG image: %1x%2").arg(width).arg(height);
+				else
+				{
+					_decoded.resize(width, height);
+
+					if (tjDecompress2(decompress, jpeg, job.data.size(), _decoded.rawMem(), width, 0, height, TJPF_RGB, TJFLAG_FASTDCT | TJFLAG_FASTUPSAMPLE) != 0 &&
+						tjGetErrorCode(decompress) == TJERR_FATAL)
+						error = QString(tjGetErrorStr());
+				}
+			}
+#endif
+
+			if (error.isEmpty())
+			{
+				const int factor = ImageIngest::getFactor(_decoded.width(), _decoded.height());
+
+				image = _frameRing->acquire(_decoded.width() / factor, _decoded.height() / factor);
+				ImageIngest::reduce(_decoded.rawMem(), _decoded.width(), _decoded.height(), factor, job.lut, job.toneMapping, image);
+			}
+
+			const qint64 duration = PreciseTimer::now() - begin;
+
+			{
+				QMutexLocker locker(&_mutex);
+
+				if (error.isEmpty())
+				{
+					_stats.decoded++;
+					_stats.durationSum += duration;
+					_stats.durationMax = qMax(_stats.durationMax, duration);
+				}
+				else
+				{
+					_stats.failed++;
+					_stats.lastError = error;
+				}
+			}
+
+			if (error.isEmpty())
+				_deliver(job.priority, image, job.duration);
+		}
+
+#ifdef FLATBUFFER_JPEG
+		if (decompress != nullptr)
+			tjDestroy(decompress);
+#endif
+	}
+
+private:
+	FrameRing*		_frameRing;
+	DeliverFunc		_deliver;
+	/// the full decoded image, reused
+	Image<ColorRgb>	_decoded;
+
+	QMutex			_mutex;
+	QWaitCondition	_condition;
+	Job				_job;
+	bool			_hasJob;
+	bool			_quit;
+	Stats			_stats;
+};
+
+FlatBufferClient::FlatBufferClient(QTcpSocket* socket, QLocalSocket* domain, int timeout, int hdrToneMappingEnabled, const LutHandle& lut, QObject* parent)
 	: QObject(parent)
 	, _log(Logger::getInstance("FLATBUFSERVER"))
 	, _socket(socket)
@@ -20,8 +303,13 @@ FlatBufferClient::FlatBufferClient(QTcpSocket* socket, QLocalSocket* domain, int
 	, _timeout(timeout * 1000)
 	, _priority()
 	, _hdrToneMappingMode(hdrToneMappingEnabled)
-	, _lutBuffer(lutBuffer)
+	, _lut(lut)
+	, _statsToken(0)
+	, _sharedLayout()
 {
+	// one frame made by the client (or its decoder) on top of the frames held by the consumers
+	_frameRing.init(FrameRingConsumerSlots + 1);
+
 	if (_socket != nullptr)
 		_clientAddress = "@" + _socket->peerAddress().toString();
 
@@ -43,6 +331,12 @@ FlatBufferClient::FlatBufferClient(QTcpSocket* socket, QLocalSocket* domain, int
 	}
 }
 
+FlatBufferClient::~FlatBufferClient()
+{
+	// joins the decoder: nothing is delivered to a deleted client
+	_decoder.reset();
+}
+
 void FlatBufferClient::readyRead()
 {
 	_timeoutTimer->start();
@@ -52,23 +346,22 @@ void FlatBufferClient::readyRead()
 	else if (_domain != nullptr)
 		_receiveBuffer += _domain->readAll();
 
+	// the messages are parsed in place, the processed ones are removed from the buffer at once
+	int offset = 0;
+
 	// check if we can read a header
-	while (_receiveBuffer.size() >= 4)
+	while (_receiveBuffer.size() - offset >= 4)
 	{
-		uint32_t messageSize =
-			((_receiveBuffer[0] << 24) & 0xFF000000) |
-			((_receiveBuffer[1] << 16) & 0x00FF0000) |
-			((_receiveBuffer[2] << 8) & 0x0000FF00) |
-			((_receiveBuffer[3]) & 0x000000FF);
+		const auto* header = reinterpret_cast<const uint8_t*>(_receiveBuffer.constData()) + offset;
+		const uint32_t messageSize = (uint32_t(header[0]) << 24) | (uint32_t(header[1]) << 16) | (uint32_t(header[2]) << 8) | uint32_t(header[3]);
 
 		// check if we can read a complete message
-		if ((uint32_t)_receiveBuffer.size() < messageSize + 4) return;
+		if (uint64_t(_receiveBuffer.size() - offset) < uint64_t(messageSize) + 4)
+			break;
 
-		// extract message only and remove header + msg from buffer :: QByteArray::remove() does not return the removed data
-		const QByteArray msg = _receiveBuffer.mid(4, messageSize);
-		_receiveBuffer.remove(0, messageSize + 4);
+		const uint8_t* msgData = header + 4;
+		offset += messageSize + 4;
 
-		const auto* msgData = reinterpret_cast<const uint8_t*>(msg.constData());
 		flatbuffers::Verifier verifier(msgData, messageSize);
 
 		if (hyperhdrnet::VerifyRequestBuffer(verifier))
@@ -79,6 +372,9 @@ void FlatBufferClient::readyRead()
 		}
 		sendErrorReply("Unable to parse message");
 	}
+
+	if (offset > 0)
+		_receiveBuffer.remove(0, offset);
 }
 
 void FlatBufferClient::forceClose()
@@ -89,10 +385,10 @@ void FlatBufferClient::forceClose()
 		_domain->close();
 }
 
-void FlatBufferClient::setHdrToneMappingEnabled(int mode, uint8_t* lutBuffer)
+void FlatBufferClient::setHdrToneMappingEnabled(int mode, LutHandle lut)
 {
 	_hdrToneMappingMode = mode;
-	_lutBuffer = lutBuffer;
+	_lut = lut;
 }
 
 void FlatBufferClient::disconnected()
@@ -104,6 +400,8 @@ void FlatBufferClient::disconnected()
 	if (_domain != nullptr)
 		_domain->deleteLater();
 
+	_sharedMemory.reset();
+
 	if (_priority != 0 && _priority >= 100 && _priority < 200)
 		emit clearGlobalInput(_priority);
 
@@ -125,6 +423,9 @@ void FlatBufferClient::handleMessage(const hyperhdrnet::Request* req)
 	else if ((reqPtr = req->command_as_Register()) != nullptr) {
 		handleRegisterCommand(static_cast<const hyperhdrnet::Register*>(reqPtr));
 	}
+	else if ((reqPtr = req->command_as_SharedMemory()) != nullptr) {
+		handleSharedMemoryCommand(static_cast<const hyperhdrnet::SharedMemory*>(reqPtr));
+	}
 	else {
 		sendErrorReply("Received invalid packet.");
 	}
@@ -191,17 +492,74 @@ void FlatBufferClient::handleImageCommand(const hyperhdrnet::Image* image)
 		const int width = img->width();
 		const int height = img->height();
 
-		if ((int)imageData->size() != width * height * 3)
+		if (imageData == nullptr || width <= 0 || height <= 0 || (qint64)imageData->size() != (qint64)width * height * 3)
 		{
 			sendErrorReply("Size of image data does not match with the width and height");
 			return;
 		}
 
-		Image<ColorRgb> imageDest(width, height);
-		memmove(imageDest.rawMem(), imageData->data(), imageData->size());
+		// the only copy: from the receive buffer to a frame of the ring, reduced to the size of the led mappings and tone mapped
+		const int factor = ImageIngest::getFactor(width, height);
+		Image<ColorRgb> imageDest = _frameRing.acquire(width / factor, height / factor);
+		ImageIngest::reduce(imageData->data(), width, height, factor, _lut, _hdrToneMappingMode, imageDest);
+
+		emit setGlobalInputImage(_priority, imageDest, duration);
+	}
+	else if ((reqPtr = image->data_as_Lz4Image()) != nullptr)
+	{
+		const auto* img = static_cast<const hyperhdrnet::Lz4Image*>(reqPtr);
+		const int width = img->width();
+		const int height = img->height();
+
+		if (img->data() == nullptr || width <= 0 || height <= 0 || (qint64)width * height > MAX_IMAGE_PIXELS)
+		{
+			sendErrorReply("Invalid width and height of the LZ4 image");
+			return;
+		}
+
+		queueDecoding(FORMAT_LZ4, img->data(), width, height, duration);
+	}
+	else if ((reqPtr = image->data_as_JpegImage()) != nullptr)
+	{
+#ifdef FLATBUFFER_JPEG
+		const auto* img = static_cast<const hyperhdrnet::JpegImage*>(reqPtr);
 
-		// tone mapping
-		FrameDecoder::applyLUT(imageDest.rawMem(), imageDest.width(), imageDest.height(), _lutBuffer, _hdrToneMappingMode);
+		if (img->data() == nullptr)
+		{
+			sendErrorReply("The JPEG image is empty");
+			return;
+		}
+
+		queueDecoding(FORMAT_JPEG, img->data(), 0, 0, duration);
+#else
+		sendErrorReply("JPEG images are not supported by this build");
+		return;
+#endif
+	}
+	else if ((reqPtr = image->data_as_SharedImage()) != nullptr)
+	{
+		const auto* img = static_cast<const hyperhdrnet::SharedImage*>(reqPtr);
+		const int slot = img->slot();
+		const int width = img->width();
+		const int height = img->height();
+
+		if (_sharedMemory == nullptr)
+		{
+			sendErrorReply("The shared memory is not attached");
+			return;
+		}
+
+		if (slot < 0 || slot >= (int)_sharedLayout.slots || width <= 0 || height <= 0 || (qint64)width * height * 3 > (qint64)_sharedLayout.slotSize)
+		{
+			sendErrorReply("Invalid slot or size of the shared image");
+			return;
+		}
+
+		// the only copy: from the slot to a frame of the ring like a raw image, the reply releases the slot
+		const uint8_t* source = static_cast<const uint8_t*>(_sharedMemory->constData()) + FlatBufferSharedMemory::slotOffset(slot, _sharedLayout.slotSize);
+		const int factor = ImageIngest::getFactor(width, height);
+		Image<ColorRgb> imageDest = _frameRing.acquire(width / factor, height / factor);
+		ImageIngest::reduce(source, width, height, factor, _lut, _hdrToneMappingMode, imageDest);
 
 		emit setGlobalInputImage(_priority, imageDest, duration);
 	}
@@ -210,6 +568,95 @@ void FlatBufferClient::handleImageCommand(const hyperhdrnet::Image* image)
 	sendSuccessReply();
 }
 
+void FlatBufferClient::queueDecoding(int format, const flatbuffers::Vector<uint8_t>* data, int width, int height, int duration)
+{
+	if (_decoder == nullptr)
+	{
+		// the image is sent from the client thread
+		_decoder = std::unique_ptr<FlatBufferDecoderThread>(new FlatBufferDecoderThread(&_frameRing,
+			[this](int priority, const Image<ColorRgb>& image, int timeout) {
+				QMetaObject::invokeMethod(this, [this, priority, image, timeout]() {
+					emit setGlobalInputImage(priority, image, timeout);
+				}, Qt::QueuedConnection);
+			}));
+		_decoder->start();
+	}
+
+	FlatBufferDecoderThread::Job job;
+	job.format = format;
+	// the compressed payload is small: copied, so the receive buffer can be reused
+	job.data = QByteArray(reinterpret_cast<const char*>(data->data()), static_cast<int>(data->size()));
+	job.width = width;
+	job.height = height;
+	job.duration = duration;
+	job.priority = _priority;
+	job.toneMapping = _hdrToneMappingMode;
+	job.lut = _lut;
+
+	_decoder->queue(job);
+
+	int64_t token = PerformanceCounters::currentToken();
+	if (token != _statsToken)
+	{
+		FlatBufferDecoderThread::Stats stats = _decoder->takeStats();
+
+		if (_statsToken > 0 && (stats.decoded > 0 || stats.failed > 0))
+		{
+			Debug(_log, "Decoded images from %s: %lld (%.2f ms average, %.2f ms max), %lld replaced by a newer image, %lld failed%s%s",
+				QSTRING_CSTR(_clientAddress), static_cast<long long>(stats.decoded),
+				(stats.decoded > 0) ? stats.durationSum / 1000000.0 / stats.decoded : 0.0, stats.durationMax / 1000000.0,
+				static_cast<long long>(stats.replaced), static_cast<long long>(stats.failed),
+				(stats.failed > 0) ? ": " : "", QSTRING_CSTR(stats.lastError));
+		}
+
+		_statsToken = token;
+	}
+}
+
+
+void FlatBufferClient::handleSharedMemoryCommand(const hyperhdrnet::SharedMemory* sharedMemory)
+{
+	if (_domain == nullptr)
+	{
+		sendErrorReply("The shared memory is available for the local domain socket only");
+		return;
+	}
+
+	const QString key = QString::fromStdString(sharedMemory->key()->str());
+	std::unique_ptr<QSharedMemory> segment(new QSharedMemory());
+	segment->setKey(key);
+
+	if (!segment->attach(QSharedMemory::ReadOnly))
+	{
+		Error(_log, "Could not attach the shared memory '%s' of the client: %s", QSTRING_CSTR(key), QSTRING_CSTR(segment->errorString()));
+		sendErrorReply("Could not attach the shared memory: " + segment->errorString().toStdString());
+		return;
+	}
+
+	FlatBufferSharedMemory::Header layout;
+	const size_t mappedSize = static_cast<size_t>(segment->size());
+	bool isValid = mappedSize >= sizeof(layout);
+
+	if (isValid)
+	{
+		memcpy(&layout, segment->constData(), sizeof(layout));
+		isValid = FlatBufferSharedMemory::isValid(layout, mappedSize);
+	}
+
+	if (!isValid)
+	{
+		Error(_log, "Invalid layout of the shared memory '%s' of the client", QSTRING_CSTR(key));
+		sendErrorReply("Invalid layout of the shared memory");
+		return;
+	}
+
+	Info(_log, "Frames of the client%s are read from the shared memory '%s': %u slots of %u bytes", QSTRING_CSTR(_clientAddress), QSTRING_CSTR(key), layout.slots, layout.slotSize);
+
+	_sharedMemory = std::move(segment);
+	_sharedLayout = layout;
+
+	sendSuccessReply();
+}
 
 void FlatBufferClient::handleClearCommand(const hyperhdrnet::Clear* clear)
 {
@@ -5,6 +5,12 @@
 #include <utils/Image.h>
 #include <utils/ColorRgb.h>
 #include <utils/Components.h>
+#include <utils/CompactLut.h>
+#include <utils/LutRegistry.h>
+#include <utils/FrameRing.h>
+#include <flatbufserver/FlatBufferSharedMemory.h>
+
+#include <memory>
 
 // flatbuffer FBS
 #include "hyperhdr_reply_generated.h"
@@ -13,6 +19,8 @@
 class QTcpSocket;
 class QLocalSocket;
 class QTimer;
+class QSharedMemory;
+class FlatBufferDecoderThread;
 
 ///
 /// @brief Socket (client) of FlatBufferServer
@@ -27,7 +35,8 @@ public:
 	/// @param timeout  The timeout when a client is automatically disconnected and the priority unregistered
 	/// @param parent   The parent
 	///
-	explicit FlatBufferClient(QTcpSocket* socket, QLocalSocket* domain, int timeout, int hdrToneMappingEnabled, uint8_t* lutBuffer, QObject* parent = nullptr);
+	explicit FlatBufferClient(QTcpSocket* socket, QLocalSocket* domain, int timeout, int hdrToneMappingEnabled, const LutHandle& lut, QObject* parent = nullptr);
+	~FlatBufferClient() override;
 
 signals:
 	///
@@ -69,7 +78,7 @@ public slots:
 	///
 	/// @brief Change HDR tone mapping
 	///
-	void setHdrToneMappingEnabled(int mode, uint8_t* lutBuffer);
+	void setHdrToneMappingEnabled(int mode, LutHandle lut);
 
 private slots:
 	///
@@ -105,6 +114,16 @@ private:
 	///
 	void handleImageCommand(const hyperhdrnet::Image* image);
 
+	///
+	/// Hands a compressed image over to the decoder thread, a waiting one is replaced
+	///
+	void queueDecoding(int format, const flatbuffers::Vector<uint8_t>* data, int width, int height, int duration);
+
+	///
+	/// @brief Attach the shared memory of a local client
+	///
+	void handleSharedMemoryCommand(const hyperhdrnet::SharedMemory* sharedMemory);
+
 	///
 	/// @brief Handle clear command
 	///
@@ -150,5 +169,14 @@ private:
 
 	// tone mapping
 	int _hdrToneMappingMode;
-	uint8_t* _lutBuffer;
+	LutHandle _lut;
+
+	// the images of the client, shared with the decoder thread
+	FrameRing _frameRing;
+	std::unique_ptr<FlatBufferDecoderThread> _decoder;
+	int64_t _statsToken;
+
+	// the frames of a local client, the layout is copied when it's attached
+	std::unique_ptr<QSharedMemory> _sharedMemory;
+	FlatBufferSharedMemory::Header _sharedLayout;
 };
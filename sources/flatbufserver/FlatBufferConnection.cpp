@@ -1,16 +1,127 @@
 // stl includes
 #include <stdexcept>
+#include <cstring>
+#include <climits>
 
 // Qt includes
 #include <QRgb>
+#include <QCoreApplication>
 
 // flatbuffer includes
 #include <flatbufserver/FlatBufferConnection.h>
+#include <flatbufserver/FlatBufferSharedMemory.h>
+#include <utils/ImagePyramid.h>
 
 // flatbuffer FBS
 #include "hyperhdr_reply_generated.h"
 #include "hyperhdr_request_generated.h"
 
+#include "HyperhdrConfig.h"
+
+#if defined(ENABLE_V4L2) || defined(ENABLE_MF)
+	#include <turbojpeg.h>
+	#define FLATBUFFER_JPEG
+#endif
+
+namespace
+{
+	/// one frame is in flight, the next one is written to the other slot
+	const uint32_t SHARED_MEMORY_SLOTS = 2;
+
+	/// an image is not queued behind more unsent bytes: a slow link drops the frames instead of buffering them
+	const qint64 MAX_BACKLOG = 64 * 1024;
+
+	size_t lz4Bound(size_t size)
+	{
+		return size + size / 255 + 16;
+	}
+
+	uint32_t read32(const uint8_t* source)
+	{
+		uint32_t value;
+		memcpy(&value, source, sizeof(value));
+		return value;
+	}
+
+	uint8_t* writeLength(uint8_t* out, size_t length)
+	{
+		for (; length >= 255; length -= 255)
+			*out++ = 255;
+		*out++ = static_cast<uint8_t>(length);
+		return out;
+	}
+
+	/// one LZ4 block (no frame header) with a greedy hash of 4 byte sequences, the target holds lz4Bound(size)
+	size_t compressLz4Block(const uint8_t* source, size_t size, uint8_t* target)
+	{
+		const int HASH_BITS = 12;
+		// the format: the last 5 bytes are literals and the last match starts 12 bytes before the end
+		const size_t LAST_LITERALS = 5;
+		const size_t MF_LIMIT = 12;
+
+		uint32_t table[1 << HASH_BITS];
+		memset(table, 0, sizeof(table));
+
+		const uint8_t* ip = source;
+		const uint8_t* anchor = source;
+		const uint8_t* const end = source + size;
+		uint8_t* out = target;
+
+		if (size > MF_LIMIT)
+		{
+			const uint8_t* const limit = end - MF_LIMIT;
+			const uint8_t* const matchLimit = end - LAST_LITERALS;
+
+			while (ip < limit)
+			{
+				const uint32_t sequence = read32(ip);
+				const uint32_t hash = (sequence * 2654435761u) >> (32 - HASH_BITS);
+				const uint8_t* reference = source + table[hash];
+				table[hash] = static_cast<uint32_t>(ip - source);
+
+				if (reference >= ip || ip - reference > 65535 || read32(reference) != sequence)
+				{
+					// skip faster through data that does not compress
+					ip += 1 + ((ip - anchor) >> 6);
+					continue;
+				}
+
+				const uint8_t* matchEnd = ip + 4;
+				for (const uint8_t* r = reference + 4; matchEnd < matchLimit && *matchEnd == *r; ++matchEnd, ++r);
+
+				const size_t literals = static_cast<size_t>(ip - anchor);
+				const size_t match = static_cast<size_t>(matchEnd - ip) - 4;
+				const size_t offset = static_cast<size_t>(ip - reference);
+
+				uint8_t* token = out++;
+				*token = static_cast<uint8_t>(qMin(literals, size_t(15)) << 4);
+				if (literals >= 15)
+					out = writeLength(out, literals - 15);
+				memcpy(out, anchor, literals);
+				out += literals;
+
+				*out++ = static_cast<uint8_t>(offset);
+				*out++ = static_cast<uint8_t>(offset >> 8);
+
+				*token |= static_cast<uint8_t>(qMin(match, size_t(15)));
+				if (match >= 15)
+					out = writeLength(out, match - 15);
+
+				ip = anchor = matchEnd;
+			}
+		}
+
+		const size_t literals = static_cast<size_t>(end - anchor);
+		*out++ = static_cast<uint8_t>(qMin(literals, size_t(15)) << 4);
+		if (literals >= 15)
+			out = writeLength(out, literals - 15);
+		memcpy(out, anchor, literals);
+		out += literals;
+
+		return static_cast<size_t>(out - target);
+	}
+}
+
 FlatBufferConnection::FlatBufferConnection(const QString& origin, const QString& address, int priority, bool skipReply)
 	: _socket((address == HYPERHDR_DOMAIN_SERVER) ? nullptr : new QTcpSocket())
 	, _domain((address == HYPERHDR_DOMAIN_SERVER) ? new QLocalSocket() : nullptr)
@@ -20,8 +131,24 @@ FlatBufferConnection::FlatBufferConnection(const QString& origin, const QString&
 	, _prevLocalState(QLocalSocket::UnconnectedState)
 	, _log(Logger::getInstance("FLATBUFCONN"))
 	, _registered(false)
+	, _skipReply(skipReply)
 	, _sent(false)
 	, _lastSendImage(0)
+	, _sharedState(SHARED_OFF)
+	, _sharedSlotSize(0)
+	, _sharedSlot(0)
+	, _hasPending(false)
+	, _pendingTime(0)
+	, _inFlightTime(0)
+	, _maxWidth(0)
+	, _format(ImageFormat::RAW)
+	, _quality(80)
+	, _jpegEncoder(nullptr)
+	, _statSent(0)
+	, _statDropped(0)
+	, _statLagSum(0)
+	, _statLagMax(0)
+	, _statRejected(0)
 {
 	if (_socket == nullptr)
 		Info(_log, "Connection using local domain socket. Ignoring port.");
@@ -58,6 +185,11 @@ FlatBufferConnection::FlatBufferConnection(const QString& origin, const QString&
 			connect(_domain, &QLocalSocket::readyRead, this, &FlatBufferConnection::readData, Qt::UniqueConnection);
 	}
 
+	if (_socket != nullptr)
+		connect(_socket, &QTcpSocket::bytesWritten, this, &FlatBufferConnection::flushPending);
+	else if (_domain != nullptr)
+		connect(_domain, &QLocalSocket::bytesWritten, this, &FlatBufferConnection::flushPending);
+
 	// init connect
 	if (_socket == nullptr)
 		Info(_log, "Connecting to HyperHDR local domain: %s", _host.toStdString().c_str());
@@ -83,6 +215,11 @@ FlatBufferConnection::~FlatBufferConnection()
 		_socket->close();
 	if (_domain != nullptr)
 		_domain->close();
+
+#ifdef FLATBUFFER_JPEG
+	if (_jpegEncoder != nullptr)
+		tjDestroy(_jpegEncoder);
+#endif
 }
 
 void FlatBufferConnection::readData()
@@ -102,7 +239,7 @@ void FlatBufferConnection::readData()
 			((_receiveBuffer[3]) & 0x000000FF);
 
 		// check if we can read a complete message
-		if ((uint32_t)_receiveBuffer.size() < messageSize + 4) return;
+		if ((uint32_t)_receiveBuffer.size() < messageSize + 4) break;
 
 		// extract message only and remove header + msg from buffer :: QByteArray::remove() does not return the removed data
 		const QByteArray msg = _receiveBuffer.mid(4, messageSize);
@@ -118,10 +255,71 @@ void FlatBufferConnection::readData()
 		}
 		Error(_log, "Unable to parse reply");
 	}
+
+	flushPending();
+}
+
+void FlatBufferConnection::flushPending()
+{
+	// the reply released the connection and the socket drained: the newest image that waited goes now
+	if (_hasPending && !_sent && bytesToWrite() <= MAX_BACKLOG)
+	{
+		_hasPending = false;
+		sendImage(_pendingImage, _pendingTime);
+		_pendingImage = Image<ColorRgb>();
+	}
+}
+
+qint64 FlatBufferConnection::bytesToWrite() const
+{
+	if (_socket != nullptr)
+		return _socket->bytesToWrite();
+	else if (_domain != nullptr)
+		return _domain->bytesToWrite();
+	return 0;
+}
+
+void FlatBufferConnection::setImageEncoding(int maxWidth, ImageFormat format, int quality)
+{
+	_maxWidth = qMax(maxWidth, 0);
+	_quality = qBound(1, quality, 100);
+
+#ifndef FLATBUFFER_JPEG
+	if (format == ImageFormat::JPEG)
+	{
+		Warning(_log, "JPEG is not supported by this build, the images are sent as LZ4");
+		format = ImageFormat::LZ4;
+	}
+#endif
+
+	_format = format;
+}
+
+FlatBufferConnection::ForwardStats FlatBufferConnection::takeForwardStats()
+{
+	ForwardStats stats;
+
+	stats.sent = _statSent;
+	stats.dropped = _statDropped;
+	stats.lagAverage = (_statSent > 0) ? static_cast<double>(_statLagSum) / _statSent : 0;
+	stats.lagMax = _statLagMax;
+	stats.rejected = _statRejected;
+	stats.lag = _statLag;
+
+	_statSent = 0;
+	_statDropped = 0;
+	_statLagSum = 0;
+	_statLagMax = 0;
+	_statRejected = 0;
+	_statLag.clear();
+
+	return stats;
 }
 
 void FlatBufferConnection::setSkipReply(bool skip)
 {
+	_skipReply = skip;
+
 	if (_socket != nullptr)
 	{
 		if (skip)
@@ -188,8 +386,32 @@ void FlatBufferConnection::setImage(const Image<ColorRgb>& image)
 	if (_domain != nullptr && _domain->state() != QLocalSocket::ConnectedState)
 		return;
 
-	if (_sent && outOfTime < 1000)
+	if ((_sent && outOfTime < 1000) || bytesToWrite() > MAX_BACKLOG)
+	{
+		// one image waits for the reply, a newer one replaces it
+		if (_hasPending)
+			_statDropped++;
+
+		_pendingImage = image;
+		_pendingTime = current;
+		_hasPending = true;
 		return;
+	}
+
+	if (_hasPending)
+	{
+		_statDropped++;
+		_hasPending = false;
+		_pendingImage = Image<ColorRgb>();
+	}
+
+	sendImage(image, current);
+}
+
+void FlatBufferConnection::sendImage(const Image<ColorRgb>& source, uint64_t offered)
+{
+	auto current = InternalClock::now();
+	auto outOfTime = (current - _lastSendImage);
 
 	if (_lastSendImage > 0)
 	{
@@ -199,12 +421,83 @@ void FlatBufferConnection::setImage(const Image<ColorRgb>& image)
 			Warning(_log, "Poor network performance for Flatbuffers stream (frame sent time: %ims)", int(outOfTime));
 	}
 
-	_sent = true;
+	const Image<ColorRgb>& image = downscale(source);
+
+	// the first frame after the registration offers the shared memory to the local server
+	if (_domain != nullptr && _registered && !_skipReply && _sharedState == SHARED_OFF && requestSharedMemory(image.size()))
+		return;
+
 	_lastSendImage = current;
 
-	auto imgData = _builder.CreateVector(image.rawMem(), image.size());
-	auto rawImg = hyperhdrnet::CreateRawImage(_builder, imgData, image.width(), image.height());
-	auto imageReq = hyperhdrnet::CreateImage(_builder, hyperhdrnet::ImageType_RawImage, rawImg.Union(), -1);
+	if (_skipReply)
+	{
+		// no reply to wait for, only the backlog of the socket holds the next image
+		_statSent++;
+	}
+	else
+	{
+		_sent = true;
+		_inFlightTime = offered;
+	}
+
+	if (_sharedState == SHARED_ACTIVE && image.size() <= _sharedSlotSize)
+	{
+		// one frame is in flight: the slots are written in turn and the reply releases the slot
+		const uint32_t slot = _sharedSlot;
+		_sharedSlot = (_sharedSlot + 1) % SHARED_MEMORY_SLOTS;
+
+		memcpy(static_cast<uint8_t*>(_sharedMemory->data()) + FlatBufferSharedMemory::slotOffset(slot, _sharedSlotSize), image.rawMem(), image.size());
+
+		auto sharedImg = hyperhdrnet::CreateSharedImage(_builder, slot, image.width(), image.height());
+		auto imageReq = hyperhdrnet::CreateImage(_builder, hyperhdrnet::ImageType_SharedImage, sharedImg.Union(), -1);
+		auto req = hyperhdrnet::CreateRequest(_builder, hyperhdrnet::Command_Image, imageReq.Union());
+
+		_builder.Finish(req);
+		sendMessage(_builder.GetBufferPointer(), _builder.GetSize());
+		_builder.Clear();
+		return;
+	}
+
+	flatbuffers::Offset<hyperhdrnet::Image> imageReq;
+
+	// the local domain socket is not worth the compression
+	const ImageFormat format = (_socket != nullptr) ? _format : ImageFormat::RAW;
+
+#ifdef FLATBUFFER_JPEG
+	if (format == ImageFormat::JPEG)
+	{
+		if (_jpegEncoder == nullptr)
+			_jpegEncoder = tjInitCompress();
+
+		unsigned long jpegSize = tjBufSize(image.width(), image.height(), TJSAMP_420);
+		_compressed.resize(jpegSize);
+		unsigned char* jpeg = _compressed.data();
+
+		if (_jpegEncoder != nullptr &&
+			tjCompress2(_jpegEncoder, image.rawMem(), image.width(), 0, image.height(), TJPF_RGB, &jpeg, &jpegSize, TJSAMP_420, _quality, TJFLAG_FASTDCT | TJFLAG_NOREALLOC) == 0)
+		{
+			auto jpegImg = hyperhdrnet::CreateJpegImage(_builder, _builder.CreateVector(_compressed.data(), jpegSize));
+			imageReq = hyperhdrnet::CreateImage(_builder, hyperhdrnet::ImageType_JpegImage, jpegImg.Union(), -1);
+		}
+	}
+#endif
+
+	if (imageReq.IsNull() && format != ImageFormat::RAW)
+	{
+		_compressed.resize(lz4Bound(image.size()));
+		const size_t compressedSize = compressLz4Block(image.rawMem(), image.size(), _compressed.data());
+
+		auto lz4Img = hyperhdrnet::CreateLz4Image(_builder, _builder.CreateVector(_compressed.data(), compressedSize), image.width(), image.height());
+		imageReq = hyperhdrnet::CreateImage(_builder, hyperhdrnet::ImageType_Lz4Image, lz4Img.Union(), -1);
+	}
+
+	if (imageReq.IsNull())
+	{
+		auto imgData = _builder.CreateVector(image.rawMem(), image.size());
+		auto rawImg = hyperhdrnet::CreateRawImage(_builder, imgData, image.width(), image.height());
+		imageReq = hyperhdrnet::CreateImage(_builder, hyperhdrnet::ImageType_RawImage, rawImg.Union(), -1);
+	}
+
 	auto req = hyperhdrnet::CreateRequest(_builder, hyperhdrnet::Command_Image, imageReq.Union());
 
 	_builder.Finish(req);
@@ -212,6 +505,34 @@ void FlatBufferConnection::setImage(const Image<ColorRgb>& image)
 	_builder.Clear();
 }
 
+const Image<ColorRgb>& FlatBufferConnection::downscale(const Image<ColorRgb>& image)
+{
+	if (_maxWidth <= 0 || image.width() <= static_cast<unsigned>(_maxWidth))
+		return image;
+
+	const unsigned factor = (image.width() + _maxWidth - 1) / _maxWidth;
+	const unsigned width = image.width() / factor;
+	const unsigned height = qMax(image.height() / factor, 1u);
+
+	if (_scaled.width() != width || _scaled.height() != height)
+		_scaled = Image<ColorRgb>(width, height);
+
+	// one pixel of every block of the remaining factor, the level of the frame pyramid did the rest
+	int step = static_cast<int>(factor);
+	const Image<ColorRgb> level = ImagePyramid::level(image, step);
+	const ColorRgb* source = reinterpret_cast<const ColorRgb*>(level.rawMem());
+	ColorRgb* target = reinterpret_cast<ColorRgb*>(_scaled.rawMem());
+
+	for (unsigned y = 0; y < height; y++)
+	{
+		const ColorRgb* row = source + static_cast<size_t>(y) * step * level.width();
+		for (unsigned x = 0; x < width; x++)
+			*target++ = row[x * step];
+	}
+
+	return _scaled;
+}
+
 void FlatBufferConnection::clear(int priority)
 {
 	auto clearReq = hyperhdrnet::CreateClear(_builder, priority);
@@ -262,6 +583,7 @@ void FlatBufferConnection::sendMessage(const uint8_t* buffer, uint32_t size)
 	if (_domain != nullptr && _domain->state() != _prevLocalState)
 	{
 		_registered = false;
+		releaseSharedMemory();
 		switch (_domain->state())
 		{
 			case QLocalSocket::UnconnectedState:
@@ -310,6 +632,32 @@ bool FlatBufferConnection::parseReply(const hyperhdrnet::Reply* reply)
 {
 	_sent = false;
 
+	if (_inFlightTime > 0)
+	{
+		const qint64 lag = static_cast<qint64>(InternalClock::now() - _inFlightTime);
+
+		_statSent++;
+		_statLagSum += lag;
+		_statLagMax = qMax(_statLagMax, lag);
+		_statLag.add(lag);
+		_inFlightTime = 0;
+	}
+
+	// nothing else is in flight while the shared memory is negotiated
+	if (_sharedState == SHARED_REQUESTED)
+	{
+		if (reply->error())
+		{
+			Warning(_log, "The server refused the shared memory, the frames are sent through the socket: %s", reply->error()->c_str());
+			releaseSharedMemory();
+			_sharedState = SHARED_REFUSED;
+			return false;
+		}
+
+		Info(_log, "The frames are sent through the shared memory");
+		_sharedState = SHARED_ACTIVE;
+	}
+
 	if (!reply->error())
 	{
 		// no error set must be a success or registered or video
@@ -331,7 +679,53 @@ bool FlatBufferConnection::parseReply(const hyperhdrnet::Reply* reply)
 		return true;
 	}
 	else
-		throw std::runtime_error(reply->error()->str());
+	{
+		// a refused frame (ex. an invalid size) must not take down the event loop of the sender
+		_statRejected++;
+		WarningThrottled(_log, "The server refused the request: %s", reply->error()->c_str());
+	}
 
 	return false;
 }
+
+bool FlatBufferConnection::requestSharedMemory(size_t slotSize)
+{
+	const QString key = QString("hyperhdr-flatbuffer-%1-%2").arg(QCoreApplication::applicationPid()).arg(reinterpret_cast<quintptr>(this), 0, 16);
+
+	_sharedMemory = std::unique_ptr<QSharedMemory>(new QSharedMemory(key));
+
+	if (slotSize == 0 || slotSize > (INT_MAX - FlatBufferSharedMemory::DATA_OFFSET) / SHARED_MEMORY_SLOTS ||
+		!_sharedMemory->create(static_cast<int>(FlatBufferSharedMemory::segmentSize(SHARED_MEMORY_SLOTS, static_cast<uint32_t>(slotSize)))))
+	{
+		Warning(_log, "Could not create the shared memory, the frames are sent through the socket: %s", QSTRING_CSTR(_sharedMemory->errorString()));
+		releaseSharedMemory();
+		_sharedState = SHARED_REFUSED;
+		return false;
+	}
+
+	const FlatBufferSharedMemory::Header header = FlatBufferSharedMemory::makeHeader(SHARED_MEMORY_SLOTS, static_cast<uint32_t>(slotSize));
+	memcpy(_sharedMemory->data(), &header, sizeof(header));
+
+	_sharedSlotSize = static_cast<uint32_t>(slotSize);
+	_sharedSlot = 0;
+	_sharedState = SHARED_REQUESTED;
+	_sent = true;
+
+	auto sharedReq = hyperhdrnet::CreateSharedMemory(_builder, _builder.CreateString(QSTRING_CSTR(key)));
+	auto req = hyperhdrnet::CreateRequest(_builder, hyperhdrnet::Command_SharedMemory, sharedReq.Union());
+
+	_builder.Finish(req);
+	sendMessage(_builder.GetBufferPointer(), _builder.GetSize());
+	_builder.Clear();
+
+	return true;
+}
+
+void FlatBufferConnection::releaseSharedMemory()
+{
+	// the server keeps its own attachment until the client is closed
+	_sharedMemory.reset();
+	_sharedState = SHARED_OFF;
+	_sharedSlotSize = 0;
+	_sharedSlot = 0;
+}
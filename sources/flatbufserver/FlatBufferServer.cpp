@@ -7,9 +7,11 @@
 #include <utils/GlobalSignals.h>
 #include <base/HyperHdrIManager.h>
 #include <utils/FrameDecoder.h>
+#include <utils/ImageIngest.h>
 
 // qt
 #include <QJsonObject>
+#include <QJsonArray>
 #include <QTcpServer>
 #include <QLocalServer>
 #include <QTcpSocket>
@@ -34,6 +36,7 @@ FlatBufferServer::FlatBufferServer(const QJsonDocument& config, const QString& c
 	, _realHdrToneMappingMode(0)
 	, _lutBuffer(nullptr)
 	, _lutBufferInit(false)
+	, _lutCompactGrid(0)
 	, _configurationPath(configurationPath)
 	, _userLutFile("")
 {
@@ -47,9 +50,9 @@ FlatBufferServer::~FlatBufferServer()
 	delete _server;
 	delete _domain;
 
-	if (_lutBuffer != NULL)
-		free(_lutBuffer);
 	_lutBuffer = NULL;
+	_lutTable = nullptr;
+	_lutHandle = nullptr;
 
 	FlatBufferServer::instance = nullptr;
 }
@@ -79,7 +82,7 @@ void FlatBufferServer::setHdrToneMappingEnabled(int mode)
 	_realHdrToneMappingMode = (_lutBufferInit && status) ? mode : 0;
 
 	// inform clients
-	emit hdrToneMappingChanged(_realHdrToneMappingMode, _lutBuffer);
+	emit hdrToneMappingChanged(_realHdrToneMappingMode, _lutHandle);
 
 
 #if !defined(ENABLE_MF) && !defined(ENABLE_AVF) && !defined(ENABLE_V4L2)
@@ -111,9 +114,16 @@ void FlatBufferServer::handleSettingsUpdate(settings::type type, const QJsonDocu
 
 		// HDR tone mapping
 		_hdrToneMappingMode = obj["hdrToneMapping"].toBool(false) ? obj["hdrToneMappingMode"].toInt(1) : 0;
+		_lutCompactGrid = obj["lutCompactGrid"].toInt(0);
 
 		setHdrToneMappingEnabled(_hdrToneMappingMode);
 
+		// the instances that receive the images, all of them when the list is empty
+		QList<int> instances;
+		for (const QJsonValue& instance : obj["instances"].toArray())
+			instances.append(instance.toInt());
+		GlobalSignals::getInstance()->setGlobalInputTargets(hyperhdr::COMP_FLATBUFSERVER, instances);
+
 		// new timeout just for new connections
 		_timeout = obj["timeout"].toInt(5000);
 		// enable check
@@ -124,10 +134,15 @@ void FlatBufferServer::handleSettingsUpdate(settings::type type, const QJsonDocu
 void FlatBufferServer::setupClient(FlatBufferClient* client)
 {
 	connect(client, &FlatBufferClient::clientDisconnected, this, &FlatBufferServer::clientDisconnected);
-	connect(client, &FlatBufferClient::registerGlobalInput, GlobalSignals::getInstance(), &GlobalSignals::registerGlobalInput);
-	connect(client, &FlatBufferClient::clearGlobalInput, GlobalSignals::getInstance(), &GlobalSignals::clearGlobalInput);
-	connect(client, &FlatBufferClient::setGlobalInputImage, GlobalSignals::getInstance(), &GlobalSignals::setGlobalImage);
-	connect(client, &FlatBufferClient::setGlobalInputColor, GlobalSignals::getInstance(), &GlobalSignals::setGlobalColor);
+	// delivered only to the target instances, in the thread of the client
+	connect(client, &FlatBufferClient::registerGlobalInput, client, [](int priority, hyperhdr::Components component, const QString& origin, const QString& owner, unsigned smooth_cfg) {
+		GlobalSignals::getInstance()->routeRegisterInput(priority, component, origin, owner, smooth_cfg); });
+	connect(client, &FlatBufferClient::clearGlobalInput, client, [](int priority, bool forceClearAll) {
+		GlobalSignals::getInstance()->routeClearInput(hyperhdr::COMP_FLATBUFSERVER, priority, forceClearAll); });
+	connect(client, &FlatBufferClient::setGlobalInputImage, client, [](int priority, const Image<ColorRgb>& image, int timeout_ms, bool clearEffect) {
+		GlobalSignals::getInstance()->routeImage(hyperhdr::COMP_FLATBUFSERVER, priority, image, timeout_ms, clearEffect); });
+	connect(client, &FlatBufferClient::setGlobalInputColor, client, [](int priority, const std::vector<ColorRgb>& ledColor, int timeout_ms, const QString& origin, bool clearEffects) {
+		GlobalSignals::getInstance()->routeColor(hyperhdr::COMP_FLATBUFSERVER, priority, ledColor, timeout_ms, origin, clearEffects); });
 	connect(GlobalSignals::getInstance(), &GlobalSignals::globalRegRequired, client, &FlatBufferClient::registationRequired);
 	connect(this, &FlatBufferServer::hdrToneMappingChanged, client, &FlatBufferClient::setHdrToneMappingEnabled);
 	_openConnections.append(client);
@@ -142,7 +157,7 @@ void FlatBufferServer::newConnection()
 			if (_netOrigin->accessAllowed(socket->peerAddress(), socket->localAddress()))
 			{
 				Debug(_log, "New connection from %s", QSTRING_CSTR(socket->peerAddress().toString()));
-				FlatBufferClient* client = new FlatBufferClient(socket, nullptr, _timeout, _hdrToneMappingMode, _lutBuffer, this);
+				FlatBufferClient* client = new FlatBufferClient(socket, nullptr, _timeout, _hdrToneMappingMode, _lutHandle, this);
 				// internal
 				setupClient(client);
 			}
@@ -155,7 +170,7 @@ void FlatBufferServer::newConnection()
 		if (QLocalSocket* socket = _domain->nextPendingConnection())
 		{
 			Debug(_log, "New local domain connection");
-			FlatBufferClient* client = new FlatBufferClient(nullptr, socket, _timeout, _hdrToneMappingMode, _lutBuffer, this);
+			FlatBufferClient* client = new FlatBufferClient(nullptr, socket, _timeout, _hdrToneMappingMode, _lutHandle, this);
 			// internal
 			setupClient(client);
 		}
@@ -248,7 +263,21 @@ void FlatBufferServer::loadLutFile()
 		Debug(_log, "Adding user LUT file for searching: %s", QSTRING_CSTR(userFile));
 	}
 
+	loadLutTables(files);
+
+	// the clients get the new table with hdrToneMappingChanged, the frames already queued finish with the previous one
+	_lutHandle = (_lutBufferInit) ? std::make_shared<const LutSnapshot>(_lutTable, _compactLut) : nullptr;
+}
+
+void FlatBufferServer::loadLutTables(const QList<QString>& files)
+{
+	// keep the previous table until the new one is acquired, the registry reuses it if nothing has changed
+	std::shared_ptr<const LutTable> previousTable = _lutTable;
+
 	_lutBufferInit = false;
+	_lutBuffer = NULL;
+	_lutTable = nullptr;
+	_compactLut.clear();
 
 	if (_hdrToneMappingMode)
 	{
@@ -267,19 +296,24 @@ void FlatBufferServer::loadLutFile()
 				{
 					qint64 index = 0; // RGB24
 
-					file.seek(index);
-
-					if (_lutBuffer == NULL)
-						_lutBuffer = (unsigned char*)malloc(length + 4);
+					_lutTable = LutRegistry::acquire(fileName3d, index, LUT_FILE_SIZE, _log);
 
-					if (file.read((char*)_lutBuffer, LUT_FILE_SIZE) != LUT_FILE_SIZE)
+					if (_lutTable == nullptr)
 					{
 						Error(_log, "Error reading LUT file %s", QSTRING_CSTR(fileName3d));
 					}
 					else
 					{
+						_lutBuffer = _lutTable->data();
 						_lutBufferInit = true;
 						Info(_log, "Found and loaded LUT: '%s'", QSTRING_CSTR(fileName3d));
+
+						if (CompactLut::isSupportedGrid(_lutCompactGrid) && _compactLut.build(_lutBuffer, _lutCompactGrid))
+						{
+							_lutBuffer = NULL;
+							_lutTable = nullptr;
+							Info(_log, "LUT table has been compacted to %i^3 grid (%i bytes)", _lutCompactGrid, (int)_compactLut.memorySize());
+						}
 					}
 				}
 				else
@@ -299,9 +333,14 @@ void FlatBufferServer::loadLutFile()
 
 void FlatBufferServer::importFromProtoHandler(int priority, int duration, const Image<ColorRgb>& image)
 {
-	FrameDecoder::applyLUT((uint8_t*)image.rawMem(), image.width(), image.height(), _lutBuffer, _hdrToneMappingMode);
+	// reduced to the size of the led mappings and tone mapped in one pass
+	const int factor = ImageIngest::getFactor(image.width(), image.height());
+	Image<ColorRgb> imageDest(image.width() / factor, image.height() / factor);
+
+	ImageIngest::reduce(image.rawMem(), image.width(), image.height(), factor, _lutHandle, _hdrToneMappingMode, imageDest);
 
-	emit GlobalSignals::getInstance()->setGlobalImage(priority, image, duration);
+	// the image of a proto client goes to the targets of the proto server
+	GlobalSignals::getInstance()->routeImage(hyperhdr::COMP_PROTOSERVER, priority, imageDest, duration);
 }
 
 void FlatBufferServer::setUserLut(QString filename)
@@ -38,6 +38,7 @@
 #include <sys/types.h>
 #include <limits.h>
 #include <stdio.h>
+#include <vector>
 
 #include <base/HyperHdrInstance.h>
 #include <base/HyperHdrIManager.h>
@@ -67,10 +68,57 @@
 }
 - (void)captureOutput:(AVCaptureOutput *)output didOutputSampleBuffer:(CMSampleBufferRef)sampleBuffer fromConnection:(AVCaptureConnection *)connection;
 - (void)captureOutput:(AVCaptureOutput *)output didDropSampleBuffer:(CMSampleBufferRef)sampleBuffer fromConnection:(AVCaptureConnection *)connection;
+- (void)receivePlanes:(CVPixelBufferRef)systemBuffer;
 @end
 
+// the planes of NV12 and P010 frames gathered when they are padded, used on the serial queue of the delegate only
+static std::vector<uint8_t> _planarFrame;
+
 @implementation VideoStreamDelegate
 
+- (void)receivePlanes:(CVPixelBufferRef)systemBuffer
+{
+	// the decoder expects the chroma plane right after the luma plane and the rows without padding
+	const size_t bytesPerSample = (CVPixelBufferGetPixelFormatType(systemBuffer) == kCVPixelFormatType_420YpCbCr10BiPlanarVideoRange) ? 2 : 1;
+	const size_t planes = CVPixelBufferGetPlaneCount(systemBuffer);
+	size_t frameBytes = 0;
+	bool contiguous = true;
+
+	for (size_t plane = 0; plane < planes; plane++)
+	{
+		const size_t rowBytes = CVPixelBufferGetWidthOfPlane(systemBuffer, plane) * ((plane == 0) ? 1 : 2) * bytesPerSample;
+		const uint8_t* expected = static_cast<const uint8_t*>(CVPixelBufferGetBaseAddressOfPlane(systemBuffer, 0)) + frameBytes;
+
+		if (CVPixelBufferGetBytesPerRowOfPlane(systemBuffer, plane) != rowBytes || CVPixelBufferGetBaseAddressOfPlane(systemBuffer, plane) != expected)
+			contiguous = false;
+
+		frameBytes += rowBytes * CVPixelBufferGetHeightOfPlane(systemBuffer, plane);
+	}
+
+	if (contiguous)
+	{
+		_avfGrabber->receive_image(CVPixelBufferGetBaseAddressOfPlane(systemBuffer, 0), static_cast<int>(frameBytes), QString(""));
+		return;
+	}
+
+	if (_planarFrame.size() < frameBytes)
+		_planarFrame.resize(frameBytes);
+
+	uint8_t* target = _planarFrame.data();
+
+	for (size_t plane = 0; plane < planes; plane++)
+	{
+		const size_t rowBytes = CVPixelBufferGetWidthOfPlane(systemBuffer, plane) * ((plane == 0) ? 1 : 2) * bytesPerSample;
+		const size_t stride = CVPixelBufferGetBytesPerRowOfPlane(systemBuffer, plane);
+		const uint8_t* source = static_cast<const uint8_t*>(CVPixelBufferGetBaseAddressOfPlane(systemBuffer, plane));
+
+		for (size_t y = 0, height = CVPixelBufferGetHeightOfPlane(systemBuffer, plane); y < height; y++, source += stride, target += rowBytes)
+			memcpy(target, source, rowBytes);
+	}
+
+	_avfGrabber->receive_image(_planarFrame.data(), static_cast<int>(frameBytes), QString(""));
+}
+
 - (void)captureOutput:(AVCaptureOutput *)output didDropSampleBuffer:(CMSampleBufferRef)sampleBuffer fromConnection:(AVCaptureConnection *)connection
 {
 }
@@ -85,14 +133,19 @@
 	if (_avfGrabber != nullptr)
 	{
 		CVPixelBufferRef systemBuffer = CMSampleBufferGetImageBuffer(sampleBuffer);
-		if (CVPixelBufferLockBaseAddress(systemBuffer, 0) == kCVReturnSuccess)
+		if (CVPixelBufferLockBaseAddress(systemBuffer, kCVPixelBufferLock_ReadOnly) == kCVReturnSuccess)
 		{
-			const uint8_t* rawVideoData = static_cast<const uint8_t*>(CVPixelBufferGetBaseAddress(systemBuffer));
-			uint32_t frameBytes = CVPixelBufferGetHeight(systemBuffer) * CVPixelBufferGetBytesPerRow(systemBuffer);
+			if (CVPixelBufferIsPlanar(systemBuffer))
+				[self receivePlanes : systemBuffer];
+			else
+			{
+				const uint8_t* rawVideoData = static_cast<const uint8_t*>(CVPixelBufferGetBaseAddress(systemBuffer));
+				uint32_t frameBytes = CVPixelBufferGetHeight(systemBuffer) * CVPixelBufferGetBytesPerRow(systemBuffer);
 
-			_avfGrabber->receive_image(rawVideoData, frameBytes, QString(""));
+				_avfGrabber->receive_image(rawVideoData, frameBytes, QString(""));
+			}
 
-			CVPixelBufferUnlockBaseAddress(systemBuffer, 0);
+			CVPixelBufferUnlockBaseAddress(systemBuffer, kCVPixelBufferLock_ReadOnly);
 		}
 	}
 }
@@ -105,6 +158,7 @@ AVFGrabber::format_t fmt_array[] =
 {
 	{ "YUVS",  PixelFormat::YUYV },
 	{ "420V",  PixelFormat::NV12 },
+	{ "X420",  PixelFormat::P010 },
 	{ "DMB1",  PixelFormat::MJPEG }
 };
 
@@ -188,23 +242,22 @@ void AVFGrabber::loadLutFile(PixelFormat color)
 
 void AVFGrabber::setHdrToneMappingEnabled(int mode)
 {
-	if (_hdrToneMappingEnabled != mode || _lutBuffer == NULL)
+	if (_hdrToneMappingEnabled != mode || !_lutBufferInit)
 	{
 		_hdrToneMappingEnabled = mode;
-		if (_lutBuffer != NULL || !mode)
+		if (_lutBufferInit || !mode)
 			Debug(_log, "setHdrToneMappingMode to: %s", (mode == 0) ? "Disabled" : ((mode == 1) ? "Fullscreen" : "Border mode"));
 		else
 			Warning(_log, "setHdrToneMappingMode to: enable, but the LUT file is currently unloaded");
 
 		if (_AVFWorkerManager.isActive())
 		{
-			Debug(_log, "setHdrToneMappingMode replacing LUT and restarting");
-			_AVFWorkerManager.Stop();
-			if ((_actualVideoFormat == PixelFormat::YUYV) || (_actualVideoFormat == PixelFormat::I420) || (_actualVideoFormat == PixelFormat::NV12))
+			// the workers keep decoding with the previous table, the next frame gets the new one
+			Debug(_log, "setHdrToneMappingMode replacing LUT");
+			if ((_actualVideoFormat == PixelFormat::YUYV) || (_actualVideoFormat == PixelFormat::I420) || (_actualVideoFormat == PixelFormat::NV12) || (_actualVideoFormat == PixelFormat::P010))
 				loadLutFile(PixelFormat::YUYV);
 			else
 				loadLutFile(PixelFormat::RGB24);
-			_AVFWorkerManager.Start();
 		}
 	}
 	else
@@ -336,7 +389,10 @@ bool AVFGrabber::init()
 			Info(_log, "*************************************************************************************************");
 
 			if (init_device(foundDevice, dev.valid[foundIndex]))
+			{
 				_initialized = true;
+				selectPixelFormat();
+			}
 		}
 		else
 			Error(_log, "Could not find any capture device settings");
@@ -477,6 +533,8 @@ bool AVFGrabber::start()
 		else
 			Info(_log, "Multithreading for AVF is enabled. Available thread's count %d", _AVFWorkerManager.workersCount);
 
+		Info(_log, "YUV decoder is using %s kernels", FrameDecoder::getSimdKernelName());
+
 		if (init())
 		{
 			start_capturing();
@@ -610,13 +668,35 @@ bool AVFGrabber::init_device(QString selectedDeviceName, DevicePropertiesItem pr
 											nil];
 									}
 									break;
-									case PixelFormat::MJPEG:
+									case PixelFormat::P010:
 									{
 										output.videoSettings = [NSDictionary dictionaryWithObjectsAndKeys :
-										[NSNumber numberWithUnsignedInt : kCMPixelFormat_422YpCbCr8_yuvs] , (id)kCVPixelBufferPixelFormatTypeKey,
+										[NSNumber numberWithUnsignedInt : kCVPixelFormatType_420YpCbCr10BiPlanarVideoRange] , (id)kCVPixelBufferPixelFormatTypeKey,
 											nil];
-										pixelformat = PixelFormat::YUYV;
-										Warning(_log, "Let macOS do accelerated MJPEG decoding to YUYV");
+									}
+									break;
+									case PixelFormat::MJPEG:
+									{
+										// the output decodes MJPEG with VideoToolbox: NV12 is what the hardware decoder produces
+										// and it is 25% smaller than YUYV, older systems without it get YUYV
+										NSNumber* nv12 = [NSNumber numberWithUnsignedInt : kCVPixelFormatType_420YpCbCr8BiPlanarVideoRange];
+
+										if ([output.availableVideoCVPixelFormatTypes containsObject : nv12])
+										{
+											output.videoSettings = [NSDictionary dictionaryWithObjectsAndKeys :
+												nv12, (id)kCVPixelBufferPixelFormatTypeKey,
+												nil];
+											pixelformat = PixelFormat::NV12;
+											Info(_log, "Let macOS do hardware MJPEG decoding to NV12");
+										}
+										else
+										{
+											output.videoSettings = [NSDictionary dictionaryWithObjectsAndKeys :
+											[NSNumber numberWithUnsignedInt : kCMPixelFormat_422YpCbCr8_yuvs] , (id)kCVPixelBufferPixelFormatTypeKey,
+												nil];
+											pixelformat = PixelFormat::YUYV;
+											Warning(_log, "Let macOS do accelerated MJPEG decoding to YUYV");
+										}
 									}
 									break;
 									default:
@@ -652,6 +732,14 @@ bool AVFGrabber::init_device(QString selectedDeviceName, DevicePropertiesItem pr
 										}
 										break;
 
+										case PixelFormat::P010:
+										{
+											loadLutFile(PixelFormat::YUYV);
+											_frameByteSize = props.x * props.y * 3;
+											_lineLength = props.x * 2;
+										}
+										break;
+
 										default:
 										{
 											Error(_log, "Unsupported encoding");
@@ -744,7 +832,8 @@ bool AVFGrabber::process_image(const void* frameImageBuffer, int size)
 	uint64_t	processFrameIndex = _currentFrame++;
 
 	// frame skipping
-	if ((processFrameIndex % _fpsSoftwareDecimation != 0) && (_fpsSoftwareDecimation > 1))
+	const int decimation = getEffectiveDecimation();
+	if ((processFrameIndex % decimation != 0) && (decimation > 1))
 		return frameSend;
 
 	// We do want a new frame...
@@ -777,6 +866,8 @@ bool AVFGrabber::process_image(const void* frameImageBuffer, int size)
 				
 				resetCounter(now);
 
+				reportCacheMisses();
+
 				QString currentCache = Image<ColorRgb>::adjustCache();
 
 				if (!currentCache.isEmpty())
@@ -805,7 +896,7 @@ bool AVFGrabber::process_image(const void* frameImageBuffer, int size)
 						AVFWorker* _workerThread = _AVFWorkerManager.workers[i];
 
 						if ((_actualVideoFormat == PixelFormat::YUYV || _actualVideoFormat == PixelFormat::I420 ||
-							_actualVideoFormat == PixelFormat::NV12) && !_lutBufferInit)
+							_actualVideoFormat == PixelFormat::NV12 || _actualVideoFormat == PixelFormat::P010) && !_lutBufferInit)
 						{
 							loadLutFile();
 						}
@@ -816,7 +907,7 @@ bool AVFGrabber::process_image(const void* frameImageBuffer, int size)
 							(uint8_t*)frameImageBuffer, size, _actualWidth, _actualHeight, _lineLength,
 							_cropLeft, _cropTop, _cropBottom, _cropRight,
 							processFrameIndex, InternalClock::nowPrecise(), _hdrToneMappingEnabled,
-							(_lutBufferInit) ? _lutBuffer : NULL, _qframe);
+							currentLut(), getEffectiveQFrame(), _decodeTargetWidth, _decodeStripes);
 
 						if (_AVFWorkerManager.workersCount > 1)
 							_AVFWorkerManager.workers[i]->start();
@@ -838,7 +929,7 @@ void AVFGrabber::newWorkerFrameError(unsigned int workerIndex, QString error, qu
 {
 
 	frameStat.badFrame++;
-	//Debug(_log, "Error occured while decoding mjpeg frame %d = %s", sourceCount, QSTRING_CSTR(error));	
+	DebugThrottled(_log, "Error occured while decoding mjpeg frame %llu = %s", static_cast<unsigned long long>(sourceCount), QSTRING_CSTR(error));
 
 	// get next frame	
 	if (workerIndex > _AVFWorkerManager.workersCount)
@@ -144,7 +144,10 @@ AVFWorker::AVFWorker() :
 	_frameBegin(0),
 	_hdrToneMappingEnabled(0),
 	_lutBuffer(nullptr),
-	_qframe(false)
+	_compactLut(nullptr),
+	_qframe(false),
+	_decodeTargetWidth(0),
+	_decodeStripes(0)
 {
 
 }
@@ -163,7 +166,7 @@ void AVFWorker::setup(unsigned int __workerIndex, PixelFormat __pixelFormat,
 	uint8_t* __sharedData, int __size, int __width, int __height, int __lineLength,
 	uint __cropLeft, uint  __cropTop, uint __cropBottom, uint __cropRight,
 	quint64 __currentFrame, qint64 __frameBegin,
-	int __hdrToneMappingEnabled, uint8_t* __lutBuffer, bool __qframe)
+	int __hdrToneMappingEnabled, const LutHandle& __lut, bool __qframe, int __decodeTargetWidth, int __decodeStripes)
 {
 	_workerIndex = __workerIndex;
 	_lineLength = __lineLength;
@@ -178,8 +181,12 @@ void AVFWorker::setup(unsigned int __workerIndex, PixelFormat __pixelFormat,
 	_currentFrame = __currentFrame;
 	_frameBegin = __frameBegin;
 	_hdrToneMappingEnabled = __hdrToneMappingEnabled;
-	_lutBuffer = __lutBuffer;
+	_lut = __lut;
+	_lutBuffer = (_lut != nullptr) ? _lut->buffer() : nullptr;
+	_compactLut = (_lut != nullptr) ? _lut->compactLut() : nullptr;
 	_qframe = __qframe;
+	_decodeTargetWidth = __decodeTargetWidth;
+	_decodeStripes = __decodeStripes;
 
 	if (__size > _localDataSize)
 	{
@@ -201,17 +208,33 @@ void AVFWorker::setup(unsigned int __workerIndex, PixelFormat __pixelFormat,
 void AVFWorker::run()
 {
 	runMe();
+
+	// the previous table is released as soon as its last frame is decoded
+	_lut = nullptr;
 }
 
 void AVFWorker::runMe()
 {
 	if (_isActive && _width > 0 && _height > 0)
 	{
-		if (_qframe)
+		CacheMissCounter cacheMisses;
+
+		if (_decodeTargetWidth > 0)
+		{
+			Image<ColorRgb> image;
+			int factor = FrameDecoder::getDownscaleFactor(_width - _cropLeft - _cropRight, _height - _cropTop - _cropBottom, _decodeTargetWidth, _qframe);
+
+			FrameDecoder::processImageDownscaled(
+				_cropLeft, _cropRight, _cropTop, _cropBottom,
+				_localData, _width, _height, _lineLength, _pixelFormat, _lutBuffer, factor, image, _compactLut);
+
+			emit newFrame(_workerIndex, image, _currentFrame, _frameBegin);
+		}
+		else if (_qframe)
 		{
 			Image<ColorRgb> image(_width >> 1, _height >> 1);
 			FrameDecoder::processQImage(
-				_localData, _width, _height, _lineLength, _pixelFormat, _lutBuffer, image);
+				_localData, _width, _height, _lineLength, _pixelFormat, _lutBuffer, image, _compactLut);
 
 			emit newFrame(_workerIndex, image, _currentFrame, _frameBegin);
 
@@ -222,9 +245,14 @@ void AVFWorker::runMe()
 			int outputHeight = (_height - _cropTop - _cropBottom);
 			Image<ColorRgb> image(outputWidth, outputHeight);
 
-			FrameDecoder::processImage(
-				_cropLeft, _cropRight, _cropTop, _cropBottom,
-				_localData, _width, _height, _lineLength, _pixelFormat, _lutBuffer, image);
+			if (_decodeStripes > 1)
+				StripedDecoder::processImage(_decodeStripes,
+					_cropLeft, _cropRight, _cropTop, _cropBottom,
+					_localData, _width, _height, _lineLength, _pixelFormat, _lutBuffer, image, _compactLut);
+			else
+				FrameDecoder::processImage(
+					_cropLeft, _cropRight, _cropTop, _cropBottom,
+					_localData, _width, _height, _lineLength, _pixelFormat, _lutBuffer, image, _compactLut);
 
 			emit newFrame(_workerIndex, image, _currentFrame, _frameBegin);
 		}
@@ -234,6 +262,7 @@ void AVFWorker::runMe()
 void AVFWorker::startOnThisThread()
 {
 	runMe();
+	_lut = nullptr;
 }
 
 bool AVFWorker::isBusy()
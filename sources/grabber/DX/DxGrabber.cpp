@@ -47,6 +47,7 @@
 
 #include <grabber/DxGrabber.h>
 #include <utils/ColorSys.h>
+#include <utils/PerformanceCounters.h>
 
 
 #pragma comment (lib, "ole32.lib")
@@ -76,7 +77,16 @@ DxGrabber::DxGrabber(const QString& device, const QString& configurationPath)
 	, _alternative(false)
 	, _d3dDevice(nullptr)
 	, _d3dContext(nullptr)
-	, _sourceTexture(nullptr)
+	, _sourceTexture{}
+	, _mipTexture(nullptr)
+	, _mipView(nullptr)
+	, _mipLevels(0)
+	, _sourceLevel{}
+	, _sourceReady{}
+	, _sourceIndex(0)
+	, _sourceLatest(0)
+	, _desktopWidth(0)
+	, _desktopHeight(0)
 	, _d3dDuplicate(nullptr)
 {
 	_timer.setTimerType(Qt::PreciseTimer);
@@ -134,7 +144,18 @@ void DxGrabber::uninit()
 	}
 
 	_d3dCache = false;
-	SafeRelease(&_sourceTexture);
+	for (int i = 0; i < DX_STAGING_TEXTURES; i++)
+	{
+		SafeRelease(&_sourceTexture[i]);
+		_sourceLevel[i] = 0;
+		_sourceReady[i] = false;
+	}
+	_sourceIndex = 0;
+	_sourceLatest = 0;
+	_stallStat = {};
+	SafeRelease(&_mipView);
+	SafeRelease(&_mipTexture);
+	_mipLevels = 0;
 	SafeRelease(&_d3dDuplicate);
 	SafeRelease(&_d3dContext);
 	SafeRelease(&_d3dDevice);
@@ -358,20 +379,19 @@ bool DxGrabber::init_device(QString selectedDeviceName)
 						{
 							_d3dDuplicate->GetDesc(&duplicateDesc);
 
-							D3D11_TEXTURE2D_DESC sourceTextureDesc;
-							sourceTextureDesc.Width = duplicateDesc.ModeDesc.Width;
-							sourceTextureDesc.Height = duplicateDesc.ModeDesc.Height;
-							sourceTextureDesc.ArraySize = 1;
-							sourceTextureDesc.MipLevels = 1;
-							sourceTextureDesc.Format = DXGI_FORMAT_B8G8R8A8_UNORM;
-							sourceTextureDesc.SampleDesc.Count = 1;
-							sourceTextureDesc.SampleDesc.Quality = 0;
-							sourceTextureDesc.Usage = D3D11_USAGE_STAGING;
-							sourceTextureDesc.CPUAccessFlags = D3D11_CPU_ACCESS_READ;
-							sourceTextureDesc.MiscFlags = 0;
-							sourceTextureDesc.BindFlags = 0;
-
-							if (CHECK(_d3dDevice->CreateTexture2D(&sourceTextureDesc, NULL, &_sourceTexture)))
+							_desktopWidth = duplicateDesc.ModeDesc.Width;
+							_desktopHeight = duplicateDesc.ModeDesc.Height;
+
+							if (createMipTexture())
+								Info(_log, "The desktop will be downscaled by the GPU (%i mip levels)", _mipLevels);
+							else
+								Warning(_log, "The GPU can't generate mipmaps for the desktop. The full frame will be copied to the system memory");
+
+							bool created = true;
+							for (int i = 0; i < DX_STAGING_TEXTURES && created; i++)
+								created = createSourceTexture(i, 0);
+
+							if (created)
 							{
 								_actualVideoFormat = PixelFormat::XRGB;
 								_actualWidth = duplicateDesc.ModeDesc.Width;
@@ -449,16 +469,39 @@ void DxGrabber::grabFrame()
 				status = resourceDesktop->QueryInterface(__uuidof(ID3D11Texture2D), (void**)&texDesktop);
 				if (CHECK(status) && texDesktop != nullptr)
 				{
-					_d3dContext->CopyResource(_sourceTexture, texDesktop);
+					int level = getMipLevel();
 
+					int write = _sourceIndex;
 
-					if (CHECK(_d3dContext->Map(_sourceTexture, 0, D3D11_MAP_READ, 0, &internalMap)))
+					if (level != _sourceLevel[write] && !createSourceTexture(write, level) && !createSourceTexture(write, level = 0))
 					{
-						uint8_t* data = (unsigned char*)internalMap.pData;
+						Error(_log, "CreateTexture2D failed");
+						_dxRestartNow = true;
+					}
+					else
+					{
+						if (level == 0)
+							_d3dContext->CopyResource(_sourceTexture[write], texDesktop);
+						else
+						{
+							// reduce the desktop on the GPU: only the selected mip level is copied to the system memory
+							_d3dContext->CopySubresourceRegion(_mipTexture, 0, 0, 0, 0, texDesktop, 0, nullptr);
+							_d3dContext->GenerateMips(_mipView);
+							_d3dContext->CopySubresourceRegion(_sourceTexture[write], 0, 0, 0, 0, _mipTexture, level, nullptr);
+						}
+
+						_sourceReady[write] = true;
+						_sourceLatest = write;
+						_sourceIndex = (write + 1) % DX_STAGING_TEXTURES;
+
+						// the previous copy had the whole capture interval to finish: mapping it doesn't stall
+						int read = (write + DX_STAGING_TEXTURES - 1) % DX_STAGING_TEXTURES;
+
+						if (!_sourceReady[read])
+							read = write;
 
-						_d3dCache = true;
-						processSystemFrameBGRA((uint8_t*)internalMap.pData, (int)internalMap.RowPitch);
-						_d3dContext->Unmap(_sourceTexture, 0);
+						if (mapSourceTexture(read))
+							_d3dCache = true;
 					}
 
 					SafeRelease(&texDesktop);
@@ -477,10 +520,6 @@ void DxGrabber::grabFrame()
 		}
 		else if (status == DXGI_ERROR_WAIT_TIMEOUT && _d3dCache)
 		{
-			D3D11_MAPPED_SUBRESOURCE internalMap;
-
-			CLEAR(internalMap);
-
 			if (_warningCounter > 0)
 			{
 				Debug(_log, "AcquireNextFrame didn't return the frame. Just warning: the screen has not changed?");
@@ -494,12 +533,10 @@ void DxGrabber::grabFrame()
 					emit newFrame(_cacheImage);
 				}
 			}
-			else if (CHECK(_d3dContext->Map(_sourceTexture, 0, D3D11_MAP_READ, 0, &internalMap)))
+			else if (_sourceReady[_sourceLatest])
 			{
-				uint8_t* data = (unsigned char*)internalMap.pData;
-
-				processSystemFrameBGRA((uint8_t*)internalMap.pData);
-				_d3dContext->Unmap(_sourceTexture, 0);
+				// the screen has not changed: the newest copy is not delivered yet by the ring
+				mapSourceTexture(_sourceLatest);
 			}
 		}
 		else if (status == DXGI_ERROR_ACCESS_LOST)
@@ -526,6 +563,134 @@ void DxGrabber::grabFrame()
 	}
 }
 
+bool DxGrabber::createMipTexture()
+{
+	UINT support = 0;
+
+	if (FAILED(_d3dDevice->CheckFormatSupport(DXGI_FORMAT_B8G8R8A8_UNORM, &support)) || !(support & D3D11_FORMAT_SUPPORT_MIP_AUTOGEN))
+		return false;
+
+	D3D11_TEXTURE2D_DESC mipTextureDesc;
+	mipTextureDesc.Width = _desktopWidth;
+	mipTextureDesc.Height = _desktopHeight;
+	mipTextureDesc.ArraySize = 1;
+	mipTextureDesc.MipLevels = 0;
+	mipTextureDesc.Format = DXGI_FORMAT_B8G8R8A8_UNORM;
+	mipTextureDesc.SampleDesc.Count = 1;
+	mipTextureDesc.SampleDesc.Quality = 0;
+	mipTextureDesc.Usage = D3D11_USAGE_DEFAULT;
+	mipTextureDesc.CPUAccessFlags = 0;
+	mipTextureDesc.MiscFlags = D3D11_RESOURCE_MISC_GENERATE_MIPS;
+	mipTextureDesc.BindFlags = D3D11_BIND_RENDER_TARGET | D3D11_BIND_SHADER_RESOURCE;
+
+	if (!CHECK(_d3dDevice->CreateTexture2D(&mipTextureDesc, NULL, &_mipTexture)) ||
+		!CHECK(_d3dDevice->CreateShaderResourceView(_mipTexture, NULL, &_mipView)))
+	{
+		SafeRelease(&_mipView);
+		SafeRelease(&_mipTexture);
+		return false;
+	}
+
+	_mipTexture->GetDesc(&mipTextureDesc);
+	_mipLevels = mipTextureDesc.MipLevels;
+
+	return true;
+}
+
+bool DxGrabber::createSourceTexture(int index, int level)
+{
+	SafeRelease(&_sourceTexture[index]);
+
+	D3D11_TEXTURE2D_DESC sourceTextureDesc;
+	sourceTextureDesc.Width = qMax(_desktopWidth >> level, 1);
+	sourceTextureDesc.Height = qMax(_desktopHeight >> level, 1);
+	sourceTextureDesc.ArraySize = 1;
+	sourceTextureDesc.MipLevels = 1;
+	sourceTextureDesc.Format = DXGI_FORMAT_B8G8R8A8_UNORM;
+	sourceTextureDesc.SampleDesc.Count = 1;
+	sourceTextureDesc.SampleDesc.Quality = 0;
+	sourceTextureDesc.Usage = D3D11_USAGE_STAGING;
+	sourceTextureDesc.CPUAccessFlags = D3D11_CPU_ACCESS_READ;
+	sourceTextureDesc.MiscFlags = 0;
+	sourceTextureDesc.BindFlags = 0;
+
+	// the content of the previous staging texture is lost
+	_sourceReady[index] = false;
+	_sourceLevel[index] = level;
+
+	return CHECK(_d3dDevice->CreateTexture2D(&sourceTextureDesc, NULL, &_sourceTexture[index]));
+}
+
+bool DxGrabber::mapSourceTexture(int index)
+{
+	D3D11_MAPPED_SUBRESOURCE internalMap;
+
+	CLEAR(internalMap);
+
+	auto mapStart = std::chrono::high_resolution_clock::now();
+
+	if (!CHECK(_d3dContext->Map(_sourceTexture[index], 0, D3D11_MAP_READ, 0, &internalMap)))
+		return false;
+
+	qint64 stall = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::high_resolution_clock::now() - mapStart).count();
+
+	processScaledFrameBGRA((uint8_t*)internalMap.pData, (int)internalMap.RowPitch, _sourceLevel[index]);
+	_d3dContext->Unmap(_sourceTexture[index], 0);
+
+	qint64 token = PerformanceCounters::currentToken();
+	if (_stallStat.token != token)
+	{
+		if (_stallStat.token > 0 && _stallStat.frames > 0)
+			Info(_log, "Staging texture map stall: average = %.3fms, max = %.3fms (%i frames)",
+				(_stallStat.total / 1000.0) / _stallStat.frames, _stallStat.maximum / 1000.0, _stallStat.frames);
+
+		_stallStat = {};
+		_stallStat.token = token;
+	}
+
+	_stallStat.total += stall;
+	_stallStat.maximum = qMax(_stallStat.maximum, stall);
+	_stallStat.frames++;
+
+	return true;
+}
+
+int DxGrabber::getMipLevel()
+{
+	int realSizeX = _desktopWidth - _cropLeft - _cropRight;
+	int level = 0;
+
+	if (realSizeX <= 16)
+		realSizeX = _desktopWidth;
+
+	// the smallest mip level that is still at least as wide as the target: the rest is done by the decimation
+	while (_mipTexture != nullptr && level + 1 < _mipLevels && (realSizeX >> (level + 1)) >= _width)
+		level++;
+
+	return level;
+}
+
+void DxGrabber::processScaledFrameBGRA(uint8_t* source, int lineSize, int level)
+{
+	int cropLeft = _cropLeft, cropRight = _cropRight, cropTop = _cropTop, cropBottom = _cropBottom;
+
+	// the cropping is given in the desktop pixels
+	_actualWidth = qMax(_desktopWidth >> level, 1);
+	_actualHeight = qMax(_desktopHeight >> level, 1);
+	_cropLeft >>= level;
+	_cropRight >>= level;
+	_cropTop >>= level;
+	_cropBottom >>= level;
+
+	processSystemFrameBGRA(source, lineSize);
+
+	_actualWidth = _desktopWidth;
+	_actualHeight = _desktopHeight;
+	_cropLeft = cropLeft;
+	_cropRight = cropRight;
+	_cropTop = cropTop;
+	_cropBottom = cropBottom;
+}
 
 void DxGrabber::setCropping(unsigned cropLeft, unsigned cropRight, unsigned cropTop, unsigned cropBottom)
 {
@@ -55,6 +55,7 @@
 
 #include <grabber/MFGrabber.h>
 #include <utils/ColorSys.h>
+#include <utils/EventTracer.h>
 #include <grabber/MFCallback.h>
 
 
@@ -92,7 +93,7 @@ MFGrabber::VideoFormat fmt_array[] =
 	{ MFVideoFormat_YV12,	"YV12", PixelFormat::NO_CHANGE },
 	{ MFVideoFormat_I420,	"I420", PixelFormat::I420 },
 	{ MFVideoFormat_IYUV,	"IYUV", PixelFormat::NO_CHANGE },
-	{ MFVideoFormat_Y210,	"Y210", PixelFormat::NO_CHANGE },
+	{ MFVideoFormat_Y210,	"Y210", PixelFormat::Y210 },
 	{ MFVideoFormat_Y216,	"Y216", PixelFormat::NO_CHANGE },
 	{ MFVideoFormat_Y410,	"Y410", PixelFormat::NO_CHANGE },
 	{ MFVideoFormat_Y416,	"Y416", PixelFormat::NO_CHANGE },
@@ -101,7 +102,7 @@ MFGrabber::VideoFormat fmt_array[] =
 	{ MFVideoFormat_Y42T,	"Y42T", PixelFormat::NO_CHANGE },
 	{ MFVideoFormat_P210,	"P210", PixelFormat::NO_CHANGE },
 	{ MFVideoFormat_P216,	"P216", PixelFormat::NO_CHANGE },
-	{ MFVideoFormat_P010,	"P010", PixelFormat::NO_CHANGE },
+	{ MFVideoFormat_P010,	"P010", PixelFormat::P010 },
 	{ MFVideoFormat_P016,	"P016", PixelFormat::NO_CHANGE },
 	{ MFVideoFormat_v210,	"v210", PixelFormat::NO_CHANGE },
 	{ MFVideoFormat_v216,	"v216", PixelFormat::NO_CHANGE },
@@ -167,23 +168,23 @@ void MFGrabber::loadLutFile(PixelFormat color)
 
 void MFGrabber::setHdrToneMappingEnabled(int mode)
 {
-	if (_hdrToneMappingEnabled != mode || _lutBuffer == NULL)
+	if (_hdrToneMappingEnabled != mode || !_lutBufferInit)
 	{
 		_hdrToneMappingEnabled = mode;
-		if (_lutBuffer != NULL || !mode)
+		if (_lutBufferInit || !mode)
 			Debug(_log, "setHdrToneMappingMode to: %s", (mode == 0) ? "Disabled" : ((mode == 1) ? "Fullscreen" : "Border mode"));
 		else
 			Warning(_log, "setHdrToneMappingMode to: enable, but the LUT file is currently unloaded");
 
 		if (_MFWorkerManager.isActive())
 		{
-			Debug(_log, "setHdrToneMappingMode replacing LUT and restarting");
-			_MFWorkerManager.Stop();
-			if ((_actualVideoFormat == PixelFormat::YUYV) || (_actualVideoFormat == PixelFormat::I420) || (_actualVideoFormat == PixelFormat::NV12) || (_actualVideoFormat == PixelFormat::MJPEG))
+			// the workers keep decoding with the previous table, the next frame gets the new one
+			Debug(_log, "setHdrToneMappingMode replacing LUT");
+			if ((_actualVideoFormat == PixelFormat::YUYV) || (_actualVideoFormat == PixelFormat::I420) || (_actualVideoFormat == PixelFormat::NV12) || (_actualVideoFormat == PixelFormat::MJPEG) ||
+				(_actualVideoFormat == PixelFormat::P010) || (_actualVideoFormat == PixelFormat::Y210))
 				loadLutFile(PixelFormat::YUYV);
 			else
 				loadLutFile(PixelFormat::RGB24);
-			_MFWorkerManager.Start();
 		}
 	}
 	else
@@ -333,7 +334,10 @@ bool MFGrabber::init()
 			Info(_log, "*************************************************************************************************");
 
 			if (init_device(foundDevice, dev.valid[foundIndex]))
+			{
 				_initialized = true;
+				selectPixelFormat();
+			}
 		}
 		else
 			Error(_log, "Could not find any capture device settings");
@@ -591,6 +595,8 @@ bool MFGrabber::start()
 		else
 			Info(_log, "Multithreading for MEDIA_FOUNDATION is enabled. Available thread's count %d", _MFWorkerManager.workersCount);
 
+		Info(_log, "YUV decoder is using %s kernels", FrameDecoder::getSimdKernelName());
+
 		if (init())
 		{
 			start_capturing();
@@ -723,11 +729,20 @@ bool MFGrabber::init_device(QString selectedDeviceName, DevicePropertiesItem pro
 			pProcAmp->Release();
 		}
 
-		hr1 = MFCreateAttributes(&pAttributes, 1);
+		bool hardwareMjpeg = (props.pf == PixelFormat::MJPEG && _hardwareMjpeg);
+
+		hr1 = MFCreateAttributes(&pAttributes, 3);
 
 		if (CHECK(hr1))
 			hr2 = pAttributes->SetUnknown(MF_SOURCE_READER_ASYNC_CALLBACK, (IMFSourceReaderCallback*)_sourceReaderCB);
 
+		// let the source reader insert the (hardware if available) MJPEG decoder and the color converter
+		if (CHECK(hr1) && CHECK(hr2) && hardwareMjpeg)
+		{
+			pAttributes->SetUINT32(MF_READWRITE_ENABLE_HARDWARE_TRANSFORMS, TRUE);
+			pAttributes->SetUINT32(MF_SOURCE_READER_ENABLE_ADVANCED_VIDEO_PROCESSING, TRUE);
+		}
+
 
 		if (CHECK(hr1) && CHECK(hr2))
 			hr = MFCreateSourceReaderFromMediaSource(device, pAttributes, &_sourceReader);
@@ -743,6 +758,7 @@ bool MFGrabber::init_device(QString selectedDeviceName, DevicePropertiesItem pro
 		{
 			IMFMediaType* type;
 			bool setStreamParamOK = false;
+			bool decodedNV12 = false;
 
 			hr = MFCreateMediaType(&type);
 			if (CHECK(hr))
@@ -768,6 +784,14 @@ bool MFGrabber::init_device(QString selectedDeviceName, DevicePropertiesItem pro
 									if (CHECK(hr))
 									{
 										setStreamParamOK = true;
+
+										if (hardwareMjpeg)
+										{
+											decodedNV12 = setDecodedOutput(props.x, props.y);
+
+											if (!decodedNV12)
+												_sourceReader->SetCurrentMediaType(MF_SOURCE_READER_FIRST_VIDEO_STREAM, NULL, type);
+										}
 									}
 									else
 										error = QString("SetCurrentMediaType %1").arg(hr);
@@ -798,6 +822,21 @@ bool MFGrabber::init_device(QString selectedDeviceName, DevicePropertiesItem pro
 			if (setStreamParamOK)
 			{
 				result = true;
+
+				if (hardwareMjpeg)
+				{
+					_mjpegDecoder = (decodedNV12) ? QString("Media Foundation (NV12)") : QString("turbojpeg");
+
+					if (decodedNV12)
+					{
+						props.pf = PixelFormat::NV12;
+						Info(_log, "MJPEG decoder: %s", QSTRING_CSTR(_mjpegDecoder));
+					}
+					else
+						Warning(_log, "Hardware MJPEG decoder is enabled but Media Foundation could not provide the NV12 output. Using turbojpeg");
+				}
+				else
+					_mjpegDecoder = "turbojpeg";
 			}
 			else
 				Error(_log, "Could not stream set params (%s)", QSTRING_CSTR(error));
@@ -858,6 +897,22 @@ bool MFGrabber::init_device(QString selectedDeviceName, DevicePropertiesItem pro
 		}
 		break;
 
+		case PixelFormat::P010:
+		{
+			loadLutFile(PixelFormat::YUYV);
+			_frameByteSize = props.x * props.y * 3;
+			_lineLength = props.x * 2;
+		}
+		break;
+
+		case PixelFormat::Y210:
+		{
+			loadLutFile(PixelFormat::YUYV);
+			_frameByteSize = props.x * props.y * 4;
+			_lineLength = props.x * 4;
+		}
+		break;
+
 		case PixelFormat::RGB24:
 		{
 			loadLutFile(PixelFormat::RGB24);
@@ -886,6 +941,48 @@ bool MFGrabber::init_device(QString selectedDeviceName, DevicePropertiesItem pro
 	return result;
 }
 
+bool MFGrabber::setDecodedOutput(int width, int height)
+{
+	IMFMediaType* type = nullptr;
+	IMFMediaType* current = nullptr;
+	bool result = false;
+
+	HRESULT hr = MFCreateMediaType(&type);
+	if (CHECK(hr))
+	{
+		type->SetGUID(MF_MT_MAJOR_TYPE, MFMediaType_Video);
+		type->SetGUID(MF_MT_SUBTYPE, MFVideoFormat_NV12);
+		MFSetAttributeSize(type, MF_MT_FRAME_SIZE, width, height);
+
+		hr = _sourceReader->SetCurrentMediaType(MF_SOURCE_READER_FIRST_VIDEO_STREAM, NULL, type);
+		if (CHECK(hr))
+		{
+			hr = _sourceReader->GetCurrentMediaType(MF_SOURCE_READER_FIRST_VIDEO_STREAM, &current);
+			if (CHECK(hr))
+			{
+				UINT32 outWidth = 0, outHeight = 0;
+				UINT32 stride = MFGetAttributeUINT32(current, MF_MT_DEFAULT_STRIDE, width);
+
+				MFGetAttributeSize(current, MF_MT_FRAME_SIZE, &outWidth, &outHeight);
+
+				// the workers expect a packed NV12 frame
+				if ((int)outWidth == width && (int)outHeight == height && (int)stride == width)
+					result = true;
+				else
+					Debug(_log, "Unexpected NV12 output layout: %ix%i (stride: %i)", outWidth, outHeight, (int)stride);
+
+				current->Release();
+			}
+		}
+		else
+			Debug(_log, "No decoder for the NV12 output (%i)", hr);
+
+		type->Release();
+	}
+
+	return result;
+}
+
 void MFGrabber::uninit_device()
 {
 	_sourceReader->Flush(MF_SOURCE_READER_FIRST_VIDEO_STREAM);
@@ -927,8 +1024,11 @@ bool MFGrabber::process_image(const void* frameImageBuffer, int size)
 	bool		frameSend = false;
 	uint64_t	processFrameIndex = _currentFrame++;
 
+	TRACE_SCOPE_ARG("MF dispatch", processFrameIndex);
+
 	// frame skipping
-	if ((processFrameIndex % _fpsSoftwareDecimation != 0) && (_fpsSoftwareDecimation > 1))
+	const int decimation = getEffectiveDecimation();
+	if ((processFrameIndex % decimation != 0) && (decimation > 1))
 		return frameSend;
 
 	// We do want a new frame...
@@ -938,6 +1038,8 @@ bool MFGrabber::process_image(const void* frameImageBuffer, int size)
 	}
 	else
 	{
+		_captureRecorder.record(_actualVideoFormat, _actualWidth, _actualHeight, _lineLength, static_cast<const uint8_t*>(frameImageBuffer), size);
+
 		if (_MFWorkerManager.isActive())
 		{			
 			// stats
@@ -956,11 +1058,16 @@ bool MFGrabber::process_image(const void* frameImageBuffer, int size)
 				int av = (frameStat.goodFrame > 0) ? frameStat.averageFrame / frameStat.goodFrame : 0;
 
 				if (diff >= 59000 && diff <= 65000)
-					emit PerformanceCounters::getInstance()->newCounter(
-					PerformanceReport(static_cast<int>(PerformanceReportType::VIDEO_GRABBER), frameStat.token, this->_actualDeviceName, total / qMax(diff / 1000.0, 1.0), av, frameStat.goodFrame, frameStat.badFrame));
+				{
+					PerformanceReport report(static_cast<int>(PerformanceReportType::VIDEO_GRABBER), frameStat.token, this->_actualDeviceName, total / qMax(diff / 1000.0, 1.0), av, frameStat.goodFrame, frameStat.badFrame);
+					report.histogram = _decodingLatency.toJson();
+					emit PerformanceCounters::getInstance()->newCounter(report);
+				}
 				
 				resetCounter(now);
 
+				reportCacheMisses();
+
 				QString currentCache = Image<ColorRgb>::adjustCache();
 
 				if (!currentCache.isEmpty())
@@ -1000,7 +1107,8 @@ bool MFGrabber::process_image(const void* frameImageBuffer, int size)
 							(uint8_t*)frameImageBuffer, size, _actualWidth, _actualHeight, _lineLength,
 							_cropLeft, _cropTop, _cropBottom, _cropRight,
 							processFrameIndex, InternalClock::nowPrecise(), _hdrToneMappingEnabled,
-							(_lutBufferInit) ? _lutBuffer : NULL, _qframe);
+							currentLut(), getEffectiveQFrame(), _decodeTargetWidth, _decodeStripes, getMjpegScale(),
+							getSkippedArea());
 
 						if (_MFWorkerManager.workersCount > 1)
 							_MFWorkerManager.workers[i]->start();
@@ -1024,9 +1132,9 @@ void MFGrabber::newWorkerFrameError(unsigned int workerIndex, QString error, qui
 	frameStat.badFrame++;
 	if (error.indexOf(QString(UNSUPPORTED_DECODER)) == 0)
 	{
-		Error(_log, "Unsupported MJPEG/YUV format. Please contact HyperHDR developers! (info: %s)", QSTRING_CSTR(error));
+		ErrorThrottled(_log, "Unsupported MJPEG/YUV format. Please contact HyperHDR developers! (info: %s)", QSTRING_CSTR(error));
 	}
-	//Debug(_log, "Error occured while decoding mjpeg frame %d = %s", sourceCount, QSTRING_CSTR(error));	
+	DebugThrottled(_log, "Error occured while decoding mjpeg frame %llu = %s", static_cast<unsigned long long>(sourceCount), QSTRING_CSTR(error));
 
 	// get next frame	
 	if (workerIndex > _MFWorkerManager.workersCount)
@@ -1040,8 +1148,11 @@ void MFGrabber::newWorkerFrameError(unsigned int workerIndex, QString error, qui
 
 void MFGrabber::newWorkerFrame(unsigned int workerIndex, Image<ColorRgb> image, quint64 sourceCount, qint64 _frameBegin)
 {
+	qint64 latency = InternalClock::nowPrecise() - _frameBegin;
+
 	frameStat.goodFrame++;
-	frameStat.averageFrame += InternalClock::nowPrecise() - _frameBegin;
+	frameStat.averageFrame += latency;
+	_decodingLatency.add(latency);
 
 	if (_signalAutoDetectionEnabled || isCalibrating())
 	{
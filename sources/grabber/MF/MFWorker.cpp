@@ -49,6 +49,7 @@
 #include <QFileInfo>
 
 #include <grabber/MFWorker.h>
+#include <utils/EventTracer.h>
 
 
 
@@ -101,6 +102,7 @@ void MFWorkerManager::InitWorkers()
 		for (unsigned i = 0; i < workersCount; i++)
 		{
 			workers[i] = new MFWorker();
+			workers[i]->setObjectName(QString("MFWorker%1").arg(i));
 		}
 	}
 }
@@ -145,7 +147,12 @@ MFWorker::MFWorker() :
 	_frameBegin(0),
 	_hdrToneMappingEnabled(0),
 	_lutBuffer(nullptr),
-	_qframe(false)
+	_compactLut(nullptr),
+	_qframe(false),
+	_decodeTargetWidth(0),
+	_decodeStripes(0),
+	_mjpegScale(1),
+	_skippedArea()
 {
 
 }
@@ -167,7 +174,8 @@ void MFWorker::setup(unsigned int __workerIndex, PixelFormat __pixelFormat,
 	uint8_t* __sharedData, int __size, int __width, int __height, int __lineLength,
 	uint __cropLeft, uint  __cropTop, uint __cropBottom, uint __cropRight,
 	quint64 __currentFrame, qint64 __frameBegin,
-	int __hdrToneMappingEnabled, uint8_t* __lutBuffer, bool __qframe)
+	int __hdrToneMappingEnabled, const LutHandle& __lut, bool __qframe, int __decodeTargetWidth, int __decodeStripes, int __mjpegScale,
+	const QRectF& __skippedArea)
 {
 	_workerIndex = __workerIndex;
 	_lineLength = __lineLength;
@@ -182,8 +190,14 @@ void MFWorker::setup(unsigned int __workerIndex, PixelFormat __pixelFormat,
 	_currentFrame = __currentFrame;
 	_frameBegin = __frameBegin;
 	_hdrToneMappingEnabled = __hdrToneMappingEnabled;
-	_lutBuffer = __lutBuffer;
+	_lut = __lut;
+	_lutBuffer = (_lut != nullptr) ? _lut->buffer() : nullptr;
+	_compactLut = (_lut != nullptr) ? _lut->compactLut() : nullptr;
 	_qframe = __qframe;
+	_decodeTargetWidth = __decodeTargetWidth;
+	_decodeStripes = __decodeStripes;
+	_mjpegScale = __mjpegScale;
+	_skippedArea = __skippedArea;
 
 	if (__size > _localDataSize)
 	{
@@ -204,10 +218,15 @@ void MFWorker::setup(unsigned int __workerIndex, PixelFormat __pixelFormat,
 void MFWorker::run()
 {
 	runMe();
+
+	// the previous table is released as soon as its last frame is decoded
+	_lut = nullptr;
 }
 
 void MFWorker::runMe()
 {
+	TRACE_SCOPE_ARG("MF decode", _currentFrame);
+
 	if (_isActive && _width > 0 && _height > 0)
 	{
 		if (_pixelFormat == PixelFormat::MJPEG)
@@ -216,11 +235,24 @@ void MFWorker::runMe()
 		}
 		else
 		{
-			if (_qframe)
+			CacheMissCounter cacheMisses;
+
+			if (_decodeTargetWidth > 0)
+			{
+				Image<ColorRgb> image;
+				int factor = FrameDecoder::getDownscaleFactor(_width - _cropLeft - _cropRight, _height - _cropTop - _cropBottom, _decodeTargetWidth, _qframe);
+
+				FrameDecoder::processImageRegion(
+					_cropLeft, _cropRight, _cropTop, _cropBottom,
+					_localData, _width, _height, _lineLength, _pixelFormat, _lutBuffer, factor, _skippedArea, image, _compactLut);
+
+				emit newFrame(_workerIndex, image, _currentFrame, _frameBegin);
+			}
+			else if (_qframe)
 			{
 				Image<ColorRgb> image(_width >> 1, _height >> 1);
 				FrameDecoder::processQImage(
-					_localData, _width, _height, _lineLength, _pixelFormat, _lutBuffer, image);
+					_localData, _width, _height, _lineLength, _pixelFormat, _lutBuffer, image, _compactLut);
 
 				emit newFrame(_workerIndex, image, _currentFrame, _frameBegin);
 
@@ -231,9 +263,19 @@ void MFWorker::runMe()
 				int outputHeight = (_height - _cropTop - _cropBottom);
 				Image<ColorRgb> image(outputWidth, outputHeight);
 
-				FrameDecoder::processImage(
-					_cropLeft, _cropRight, _cropTop, _cropBottom,
-					_localData, _width, _height, _lineLength, _pixelFormat, _lutBuffer, image);
+				// the skipped centre leaves too little work to split it into stripes
+				if (!_skippedArea.isEmpty())
+					FrameDecoder::processImageRegion(
+						_cropLeft, _cropRight, _cropTop, _cropBottom,
+						_localData, _width, _height, _lineLength, _pixelFormat, _lutBuffer, 1, _skippedArea, image, _compactLut);
+				else if (_decodeStripes > 1)
+					StripedDecoder::processImage(_decodeStripes,
+						_cropLeft, _cropRight, _cropTop, _cropBottom,
+						_localData, _width, _height, _lineLength, _pixelFormat, _lutBuffer, image, _compactLut);
+				else
+					FrameDecoder::processImage(
+						_cropLeft, _cropRight, _cropTop, _cropBottom,
+						_localData, _width, _height, _lineLength, _pixelFormat, _lutBuffer, image, _compactLut);
 
 				emit newFrame(_workerIndex, image, _currentFrame, _frameBegin);
 			}
@@ -244,6 +286,7 @@ void MFWorker::runMe()
 void MFWorker::startOnThisThread()
 {
 	runMe();
+	_lut = nullptr;
 }
 
 bool MFWorker::isBusy()
@@ -279,13 +322,29 @@ void MFWorker::process_image_jpg_mt()
 		return;
 	}
 
-	tjscalingfactor sca{ 1, 2 };
+	// let the DCT do the downscaling, turbojpeg only accepts its own scaling factors
+	tjscalingfactor sca{ 1, 1 };
+	int scalingFactorsCount = 0;
+	tjscalingfactor* scalingFactors = tjGetScalingFactors(&scalingFactorsCount);
 
-	_width = (_qframe) ? TJSCALED(_width, sca) : _width;
-	_height = (_qframe) ? TJSCALED(_height, sca) : _height;
+	for (int i = 0; scalingFactors != nullptr && i < scalingFactorsCount; i++)
+		if (scalingFactors[i].num == 1 && scalingFactors[i].denom == _mjpegScale)
+			sca = scalingFactors[i];
+
+	if (sca.denom > 1)
+	{
+		_width = TJSCALED(_width, sca);
+		_height = TJSCALED(_height, sca);
+		_cropLeft /= sca.denom;
+		_cropRight /= sca.denom;
+		_cropTop /= sca.denom;
+		_cropBottom /= sca.denom;
+	}
 
 	Image<ColorRgb> image(_width - _cropLeft - _cropRight, _height - _cropTop - _cropBottom);
 
+	int factor = (_decodeTargetWidth > 0) ? FrameDecoder::getDownscaleFactor(image.width(), image.height(), _decodeTargetWidth, false) : 1;
+
 	if (_hdrToneMappingEnabled > 0)
 	{
 		size_t yuvSize = tjBufSizeYUV2(_width, 2, _height, _subsamp);
@@ -300,12 +359,12 @@ void MFWorker::process_image_jpg_mt()
 				return;
 			}		
 
-		FrameDecoder::processImage(_cropLeft, _cropRight, _cropTop, _cropBottom,
-			jpegBuffer, _width, _height, _width, (_subsamp == TJSAMP_422) ? PixelFormat::MJPEG : PixelFormat::I420, _lutBuffer, image);
+		FrameDecoder::processImageDownscaled(_cropLeft, _cropRight, _cropTop, _cropBottom,
+			jpegBuffer, _width, _height, _width, (_subsamp == TJSAMP_422) ? PixelFormat::MJPEG : PixelFormat::I420, _lutBuffer, factor, image, _compactLut);
 
 		free(jpegBuffer);
 	}
-	else if (image.width() != (uint)_width || image.height() != (uint)_height)
+	else if (image.width() != (uint)_width || image.height() != (uint)_height || factor > 1)
 	{
 		uint8_t* jpegBuffer = (uint8_t*)malloc(_width * _height * 3);
 
@@ -318,8 +377,8 @@ void MFWorker::process_image_jpg_mt()
 				return;
 			}					
 		
-		FrameDecoder::processImage(_cropLeft, _cropRight, _cropTop, _cropBottom,
-			jpegBuffer, _width, _height, _width * 3, PixelFormat::RGB24, nullptr, image);
+		FrameDecoder::processImageDownscaled(_cropLeft, _cropRight, _cropTop, _cropBottom,
+			jpegBuffer, _width, _height, _width * 3, PixelFormat::RGB24, nullptr, factor, image);
 
 		free(jpegBuffer);
 	}
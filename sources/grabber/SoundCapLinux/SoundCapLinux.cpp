@@ -27,19 +27,24 @@
 
 #include <grabber/SoundCapLinux.h>
 #include <utils/Logger.h>
+#include <utils/PreciseTimer.h>
 #include <cmath>
 #include <QString>
 #include <stdexcept>
 #include <iostream>
 #include <unistd.h>
 #include <cstring>
+#include <cerrno>
 
 int16_t    SoundCapLinux::_soundBuffer[(1<<SOUNDCAPLINUX_BUF_LENP)*2];
 
 SoundCapLinux::SoundCapLinux(const QJsonDocument& effectConfig, QObject* parent)
                                         : SoundCapture(effectConfig, parent),
                                         _handle(NULL),
-										_pcmCallback(NULL)
+										_pcmCallback(NULL),
+										_mmap(false),
+										_pending(0),
+										_lastPeriod(0)
 {		
 	ListDevices();
 }
@@ -90,25 +95,120 @@ void SoundCapLinux::RecordCallback(snd_async_handler_t *audioHandler)
 	{		
 		if (_isRunning && audioHandler != NULL)
 		{
-			snd_pcm_sframes_t periodSize = (1 << SOUNDCAPLINUX_BUF_LENP);
-			snd_pcm_t* shandle = snd_async_handler_get_pcm(audioHandler);
-			if (shandle != NULL)
+			SoundCapLinux* capture = static_cast<SoundCapLinux*>(snd_async_handler_get_callback_private(audioHandler));
+			if (capture != NULL && capture->_handle != NULL)
+				capture->ReadPeriods();
+		}
+	}
+	catch(...)
+	{
+	}
+}
+
+void SoundCapLinux::ReadPeriods()
+{
+	const snd_pcm_uframes_t periodSize = (1 << SOUNDCAPLINUX_BUF_LENP);
+
+	// all the periods that are ready, a late signal does not leave them to an overrun
+	for (;;)
+	{
+		snd_pcm_sframes_t incoming = snd_pcm_avail_update(_handle);
+
+		if (incoming < 0)
+		{
+			Recover(incoming);
+			return;
+		}
+
+		if ((snd_pcm_uframes_t)incoming < periodSize - _pending)
+			return;
+
+		if (!_mmap)
+		{
+			snd_pcm_sframes_t total = snd_pcm_readi(_handle, _soundBuffer, periodSize);
+			if (total < 0)
 			{
-				snd_pcm_sframes_t incoming = snd_pcm_avail_update(shandle);
-
-				if (incoming >= periodSize) {
-					int total = snd_pcm_readi(shandle, _soundBuffer, periodSize);
-					if (total == periodSize) {
-						if (AnaliseSpectrum(_soundBuffer, SOUNDCAPLINUX_BUF_LENP))
-							_resultIndex++;
-					}
-				}
+				Recover(total);
+				return;
+			}
+			if ((snd_pcm_uframes_t)total == periodSize)
+				Analise(_soundBuffer);
+			continue;
+		}
+
+		const snd_pcm_channel_area_t* areas;
+		snd_pcm_uframes_t offset, frames = periodSize - _pending;
+		int status = snd_pcm_mmap_begin(_handle, &areas, &offset, &frames);
+
+		if (status < 0)
+		{
+			Recover(status);
+			return;
+		}
+
+		// mono S16: the samples of the area are contiguous
+		int16_t* samples = reinterpret_cast<int16_t*>(static_cast<uint8_t*>(areas[0].addr) + areas[0].first / 8) + offset;
+
+		if (_pending == 0 && frames == periodSize)
+			Analise(samples);
+		else
+		{
+			memcpy(_soundBuffer + _pending, samples, frames * sizeof(int16_t));
+			_pending += frames;
+			if (_pending == periodSize)
+			{
+				_pending = 0;
+				Analise(_soundBuffer);
 			}
 		}
+
+		snd_pcm_sframes_t committed = snd_pcm_mmap_commit(_handle, offset, frames);
+		if (committed < 0 || (snd_pcm_uframes_t)committed != frames)
+		{
+			Recover(committed < 0 ? committed : -EPIPE);
+			return;
+		}
 	}
-	catch(...)
+}
+
+void SoundCapLinux::Analise(int16_t* samples)
+{
+	const qint64 now = PreciseTimer::now();
+	const qint64 period = ((qint64)(1 << SOUNDCAPLINUX_BUF_LENP) * 1000000000) / SOUNDCAP_SAMPLE_RATE;
+
+	// the interarrival jitter of RFC 3550: the mean deviation of the periods from their length, smoothed by 1/16
+	if (_lastPeriod != 0)
+	{
+		const qint64 deviation = std::abs((now - _lastPeriod) - period) / 1000;
+		_periodJitter = _periodJitter + (deviation - _periodJitter) / 16;
+	}
+	_lastPeriod = now;
+
+	AnaliseSpectrum(samples, SOUNDCAPLINUX_BUF_LENP);
+}
+
+bool SoundCapLinux::Recover(int status)
+{
+	if (_overruns++ == 0)
+		Warning(Logger::getInstance("HYPERHDR"), "Sound capture overrun, restarting the stream: '%s'", snd_strerror(status));
+
+	_pending = 0;
+	_lastPeriod = 0;
+
+	if ((status = snd_pcm_recover(_handle, status, 1)) < 0)
 	{
+		Error(Logger::getInstance("HYPERHDR"), "Cannot recover the sound stream: '%s'", snd_strerror(status));
+		return false;
 	}
+
+	// a prepared capture stream does not start by itself
+	if (snd_pcm_state(_handle) == SND_PCM_STATE_PREPARED && (status = snd_pcm_start(_handle)) < 0)
+	{
+		Error(Logger::getInstance("HYPERHDR"), "Cannot restart the sound stream: '%s'", snd_strerror(status));
+		return false;
+	}
+
+	return true;
 }
 
 void SoundCapLinux::Start()
@@ -117,10 +217,11 @@ void SoundCapLinux::Start()
 	{
 		int				status;		
 		bool    		error = false;		
-		unsigned int 	exactRate = 22050;		
+		unsigned int 	exactRate = SOUNDCAP_SAMPLE_RATE;		
 				
-		snd_pcm_uframes_t periodSize = (1 << SOUNDCAPLINUX_BUF_LENP) * 2;
-		snd_pcm_uframes_t bufferSize = periodSize * 2;
+		// a period is one analysis, the buffer leaves the signal handler three more
+		snd_pcm_uframes_t periodSize = (1 << SOUNDCAPLINUX_BUF_LENP);
+		snd_pcm_uframes_t bufferSize = periodSize * 4;
 		snd_pcm_hw_params_t *hw_params;
 
 		QStringList deviceList = _selectedDevice.split('|');
@@ -152,9 +253,20 @@ void SoundCapLinux::Start()
 				throw 1;
 			}
 
-			if ((status = snd_pcm_hw_params_set_access (_handle, hw_params, SND_PCM_ACCESS_RW_INTERLEAVED)) < 0) {
-				Error(Logger::getInstance("HYPERHDR"), "Cannot set snd_pcm_hw_params_set_access: '%s'", snd_strerror (status));
-				throw 2;
+			_mmap = true;
+			_pending = 0;
+			_lastPeriod = 0;
+			_periodJitter = 0;
+			_overruns = 0;
+
+			if ((status = snd_pcm_hw_params_set_access (_handle, hw_params, SND_PCM_ACCESS_MMAP_INTERLEAVED)) < 0) {
+				_mmap = false;
+				Info(Logger::getInstance("HYPERHDR"), "The device has no mmap access, reading the samples instead: '%s'", snd_strerror (status));
+
+				if ((status = snd_pcm_hw_params_set_access (_handle, hw_params, SND_PCM_ACCESS_RW_INTERLEAVED)) < 0) {
+					Error(Logger::getInstance("HYPERHDR"), "Cannot set snd_pcm_hw_params_set_access: '%s'", snd_strerror (status));
+					throw 2;
+				}
 			}
 
 			if ((status = snd_pcm_hw_params_set_format (_handle, hw_params,  SND_PCM_FORMAT_S16_LE )) < 0) {
@@ -166,7 +278,7 @@ void SoundCapLinux::Start()
 				Error(Logger::getInstance("HYPERHDR"), "Cannot set snd_pcm_hw_params_set_rate_near: '%s'", snd_strerror (status));
 				throw 4;
 			}
-			else if (exactRate != 22050)
+			else if (exactRate != SOUNDCAP_SAMPLE_RATE)
 			{
 				Error(Logger::getInstance("HYPERHDR"), "Cannot set rate to 22050");
 				throw 5;
@@ -204,7 +316,7 @@ void SoundCapLinux::Start()
 				throw 10;			
 			}			
 
-			if ((status = snd_async_add_pcm_handler(&_pcmCallback, _handle, RecordCallback, NULL)) < 0) {			
+			if ((status = snd_async_add_pcm_handler(&_pcmCallback, _handle, RecordCallback, this)) < 0) {			
 				Error(Logger::getInstance("HYPERHDR"),  "Registering record callback error, probably you chose wrong or virtual audio capture device: '%s'", snd_strerror(status));
 				throw 11;
 			}
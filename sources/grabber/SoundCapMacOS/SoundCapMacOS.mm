@@ -147,7 +147,6 @@ void SoundCapMacOS::RecordCallback(uint32_t frameBytes, uint8_t* rawAudioData)
 			
 			if (_soundBufferIndex == destSize && AnaliseSpectrum(_soundBuffer, SOUNDCAPMACOS_BUF_LENP))
 			{
-				_resultIndex++;
 				_soundBufferIndex = 0;
 				destStart = (uint8_t*)(&_soundBuffer);
 			}
@@ -220,7 +219,7 @@ void SoundCapMacOS::Start()
 						output.audioSettings = [NSDictionary dictionaryWithObjectsAndKeys:
 												[ NSNumber numberWithInt: kAudioFormatLinearPCM ], AVFormatIDKey,
 												[ NSNumber numberWithInt: 1 ], AVNumberOfChannelsKey,
-												[ NSNumber numberWithFloat: 22050.0 ], AVSampleRateKey,
+												[ NSNumber numberWithFloat: SOUNDCAP_SAMPLE_RATE ], AVSampleRateKey,
 												[ NSNumber numberWithBool: NO], AVLinearPCMIsFloatKey,
 												[ NSNumber numberWithBool: NO], AVLinearPCMIsNonInterleaved,
 												[ NSNumber numberWithInt: 16], AVLinearPCMBitDepthKey,
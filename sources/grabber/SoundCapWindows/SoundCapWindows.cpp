@@ -27,16 +27,93 @@
 
 #include <grabber/SoundCapWindows.h>
 #include <utils/Logger.h>
+#include <utils/PreciseTimer.h>
 #include <cmath>
 
-#pragma comment(lib, "winmm.lib")
+#include <initguid.h>
+#include <functiondiscoverykeys_devpkey.h>
+#include <avrt.h>
 
-WAVEHDR    SoundCapWindows::_header;
-HWAVEIN    SoundCapWindows::_hWaveIn;
-int16_t    SoundCapWindows::_soundBuffer[(1 << SOUNDCAPWINDOWS_BUF_LENP) + 64];
+#pragma comment(lib, "ole32.lib")
+#pragma comment(lib, "avrt.lib")
+
+namespace
+{
+	// the render endpoints are captured in the loopback mode: the sound that the PC plays
+	const QString LOOPBACK_SUFFIX = " [loopback]";
+	// the names of the old waveIn devices were cut to that length
+	const int WAVEIN_NAME_LENGTH = 31;
+	// the engine event is the wake-up, the timeout only notices a stream that stopped signalling
+	const DWORD EVENT_TIMEOUT = 500;
+
+	template <class T> void SafeRelease(T** ppT)
+	{
+		if (*ppT)
+		{
+			(*ppT)->Release();
+			*ppT = nullptr;
+		}
+	}
+
+	QString friendlyName(IMMDevice* device)
+	{
+		QString name;
+		IPropertyStore* properties = nullptr;
+
+		if (SUCCEEDED(device->OpenPropertyStore(STGM_READ, &properties)))
+		{
+			PROPVARIANT value;
+			PropVariantInit(&value);
+
+			if (SUCCEEDED(properties->GetValue(PKEY_Device_FriendlyName, &value)) && value.vt == VT_LPWSTR)
+				name = QString::fromWCharArray(value.pwszVal);
+
+			PropVariantClear(&value);
+			SafeRelease(&properties);
+		}
+
+		return name;
+	}
+
+	bool isSelected(const QString& name, const QString& selected)
+	{
+		return name.compare(selected) == 0 ||
+			(selected.length() == WAVEIN_NAME_LENGTH && name.startsWith(selected));
+	}
+
+	bool isFloat(const WAVEFORMATEX* format)
+	{
+		if (format->wFormatTag == WAVE_FORMAT_IEEE_FLOAT)
+			return true;
+
+		// the subtypes of the extensible format carry the format tag in their first field
+		return format->wFormatTag == WAVE_FORMAT_EXTENSIBLE &&
+			reinterpret_cast<const WAVEFORMATEXTENSIBLE*>(format)->SubFormat.Data1 == WAVE_FORMAT_IEEE_FLOAT;
+	}
+
+	// the COM apartment of the thread, an already initialized one is kept as it is
+	class ComScope
+	{
+	public:
+		ComScope() : _initialized(SUCCEEDED(CoInitializeEx(NULL, COINIT_MULTITHREADED))) {}
+		~ComScope() { if (_initialized) CoUninitialize(); }
+
+	private:
+		bool _initialized;
+	};
+}
 
 SoundCapWindows::SoundCapWindows(const QJsonDocument& effectConfig, QObject* parent)
-	: SoundCapture(effectConfig, parent)
+	: SoundCapture(effectConfig, parent),
+	_stopEvent(CreateEvent(NULL, TRUE, FALSE, NULL)),
+	_readyEvent(CreateEvent(NULL, FALSE, FALSE, NULL)),
+	_dataEvent(CreateEvent(NULL, FALSE, FALSE, NULL)),
+	_startResult(false),
+	_phase(0),
+	_sum(0),
+	_sumCount(0),
+	_pending(0),
+	_lastPeriod(0)
 {
 	ListDevices();
 }
@@ -44,86 +121,330 @@ SoundCapWindows::SoundCapWindows(const QJsonDocument& effectConfig, QObject* par
 
 void SoundCapWindows::ListDevices()
 {
-	UINT deviceCount = waveInGetNumDevs();
+	ComScope com;
+	IMMDeviceEnumerator* enumerator = nullptr;
+
+	if (FAILED(CoCreateInstance(__uuidof(MMDeviceEnumerator), NULL, CLSCTX_ALL, __uuidof(IMMDeviceEnumerator), (void**)&enumerator)))
+	{
+		Error(Logger::getInstance("HYPERHDR"), "Could not find sound devices for enumerating");
+		return;
+	}
 
-	for (UINT i = 0; i < deviceCount; i++)
+	for (EDataFlow flow : { eCapture, eRender })
 	{
-		WAVEINCAPSW waveCaps;
-		memset(&waveCaps, 0, sizeof(waveCaps));
-		waveInGetDevCapsW(i, &waveCaps, sizeof(WAVEINCAPSW));
+		IMMDeviceCollection* collection = nullptr;
+		UINT count = 0;
+
+		if (FAILED(enumerator->EnumAudioEndpoints(flow, DEVICE_STATE_ACTIVE, &collection)))
+			continue;
+
+		collection->GetCount(&count);
+		for (UINT i = 0; i < count; i++)
+		{
+			IMMDevice* device = nullptr;
+
+			if (SUCCEEDED(collection->Item(i, &device)))
+			{
+				QString name = friendlyName(device);
+				if (!name.isEmpty())
+					_availableDevices.append((flow == eRender) ? name + LOOPBACK_SUFFIX : name);
+				SafeRelease(&device);
+			}
+		}
 
-		if (waveCaps.dwFormats & WAVE_FORMAT_2M16)
-			_availableDevices.append(QString::fromWCharArray(waveCaps.szPname));
+		SafeRelease(&collection);
 	}
+
+	SafeRelease(&enumerator);
 }
 
 SoundCapWindows::~SoundCapWindows()
 {
 	Stop();
+
+	CloseHandle(_stopEvent);
+	CloseHandle(_readyEvent);
+	CloseHandle(_dataEvent);
 }
 
-void CALLBACK SoundCapWindows::soundInProc(HWAVEIN hwi, UINT uMsg, DWORD dwInstance, DWORD dwParam1, DWORD dwParam2)
+bool SoundCapWindows::OpenStream(IMMDeviceEnumerator* enumerator, IAudioClient** client, IAudioCaptureClient** capture, WAVEFORMATEX** format)
 {
-	if (AnaliseSpectrum(_soundBuffer, SOUNDCAPWINDOWS_BUF_LENP))
-		_resultIndex++;
+	IMMDevice* device = nullptr;
+	bool loopback = false;
 
-	if (_isRunning)
-		waveInAddBuffer(_hWaveIn, &_header, sizeof(WAVEHDR));
+	for (EDataFlow flow : { eCapture, eRender })
+	{
+		IMMDeviceCollection* collection = nullptr;
+		UINT count = 0;
+
+		if (FAILED(enumerator->EnumAudioEndpoints(flow, DEVICE_STATE_ACTIVE, &collection)))
+			continue;
+
+		collection->GetCount(&count);
+		for (UINT i = 0; i < count && device == nullptr; i++)
+		{
+			IMMDevice* candidate = nullptr;
+
+			if (SUCCEEDED(collection->Item(i, &candidate)))
+			{
+				QString name = friendlyName(candidate);
+				if (flow == eRender)
+					name += LOOPBACK_SUFFIX;
+
+				if (isSelected(name, _selectedDevice))
+				{
+					device = candidate;
+					loopback = (flow == eRender);
+				}
+				else
+					SafeRelease(&candidate);
+			}
+		}
+
+		SafeRelease(&collection);
+
+		if (device != nullptr)
+			break;
+	}
+
+	if (device == nullptr)
+	{
+		Error(Logger::getInstance("HYPERHDR"), "Could not find '%s' device for open", QSTRING_CSTR(_selectedDevice));
+		return false;
+	}
+
+	HRESULT result = device->Activate(__uuidof(IAudioClient), CLSCTX_ALL, NULL, (void**)client);
+
+	if (SUCCEEDED(result))
+		result = (*client)->GetMixFormat(format);
+
+	if (SUCCEEDED(result) && !isFloat(*format) && (*format)->wBitsPerSample != 16 && (*format)->wBitsPerSample != 32)
+	{
+		Error(Logger::getInstance("HYPERHDR"), "Unsupported format of the sound device '%s': %i bits", QSTRING_CSTR(_selectedDevice), (*format)->wBitsPerSample);
+		SafeRelease(&device);
+		return false;
+	}
+
+	if (SUCCEEDED(result))
+	{
+		// the small period of the engine (Windows 10), the loopback streams follow the period of their render endpoint
+		IAudioClient3* client3 = nullptr;
+		UINT32 defaultPeriod = 0, fundamentalPeriod = 0, minPeriod = 0, maxPeriod = 0;
+
+		if (!loopback && SUCCEEDED((*client)->QueryInterface(__uuidof(IAudioClient3), (void**)&client3)) &&
+			SUCCEEDED(client3->GetSharedModeEnginePeriod(*format, &defaultPeriod, &fundamentalPeriod, &minPeriod, &maxPeriod)) &&
+			SUCCEEDED(client3->InitializeSharedAudioStream(AUDCLNT_STREAMFLAGS_EVENTCALLBACK, minPeriod, *format, NULL)))
+		{
+			Info(Logger::getInstance("HYPERHDR"), "Sound device '%s' uses the engine period of %i frames", QSTRING_CSTR(_selectedDevice), minPeriod);
+		}
+		else
+		{
+			REFERENCE_TIME devicePeriod = 0;
+			(*client)->GetDevicePeriod(NULL, &devicePeriod);
+
+			result = (*client)->Initialize(AUDCLNT_SHAREMODE_SHARED,
+				AUDCLNT_STREAMFLAGS_EVENTCALLBACK | ((loopback) ? AUDCLNT_STREAMFLAGS_LOOPBACK : 0),
+				devicePeriod, 0, *format, NULL);
+		}
+
+		SafeRelease(&client3);
+	}
+
+	if (SUCCEEDED(result))
+		result = (*client)->SetEventHandle(_dataEvent);
+
+	if (SUCCEEDED(result))
+		result = (*client)->GetService(__uuidof(IAudioCaptureClient), (void**)capture);
+
+	if (SUCCEEDED(result))
+		result = (*client)->Start();
+
+	SafeRelease(&device);
+
+	if (FAILED(result))
+	{
+		Error(Logger::getInstance("HYPERHDR"), "Error during opening sound device '%s'. Error code: %x", QSTRING_CSTR(_selectedDevice), result);
+		return false;
+	}
+
+	Info(Logger::getInstance("HYPERHDR"), "Opened sound device '%s': %i Hz, %i channels%s", QSTRING_CSTR(_selectedDevice),
+		(*format)->nSamplesPerSec, (*format)->nChannels, (loopback) ? ", loopback" : "");
+
+	return true;
 }
 
-void SoundCapWindows::Start()
+void SoundCapWindows::Capture()
 {
-	if (_isActive && !_isRunning)
+	ComScope com;
+	IMMDeviceEnumerator* enumerator = nullptr;
+	IAudioClient* client = nullptr;
+	IAudioCaptureClient* capture = nullptr;
+	WAVEFORMATEX* format = nullptr;
+
+	_startResult = SUCCEEDED(CoCreateInstance(__uuidof(MMDeviceEnumerator), NULL, CLSCTX_ALL, __uuidof(IMMDeviceEnumerator), (void**)&enumerator)) &&
+		OpenStream(enumerator, &client, &capture, &format);
+
+	SetEvent(_readyEvent);
+
+	if (_startResult)
 	{
-		UINT deviceCount = waveInGetNumDevs(), found = 0;
-		for (found = 0; found < deviceCount; found++)
+		// the scheduler of the multimedia class keeps the wake-ups on time under load
+		DWORD taskIndex = 0;
+		HANDLE task = AvSetMmThreadCharacteristicsW(L"Pro Audio", &taskIndex);
+		HANDLE events[2] = { _stopEvent, _dataEvent };
+
+		for (;;)
 		{
-			WAVEINCAPSW waveCaps;
-			memset(&waveCaps, 0, sizeof(waveCaps));
-			waveInGetDevCapsW(found, &waveCaps, sizeof(WAVEINCAPSW));
+			DWORD signalled = WaitForMultipleObjects(2, events, FALSE, EVENT_TIMEOUT);
 
-			if (QString::fromWCharArray(waveCaps.szPname).compare(_selectedDevice) == 0)
+			if (signalled == WAIT_OBJECT_0 || signalled == WAIT_FAILED)
 				break;
+
+			ReadPackets(capture, format);
 		}
 
-		if (found >= deviceCount)
+		client->Stop();
+
+		if (task != NULL)
+			AvRevertMmThreadCharacteristics(task);
+	}
+
+	SafeRelease(&capture);
+	SafeRelease(&client);
+	SafeRelease(&enumerator);
+
+	if (format != nullptr)
+		CoTaskMemFree(format);
+}
+
+void SoundCapWindows::ReadPackets(IAudioCaptureClient* capture, const WAVEFORMATEX* format)
+{
+	UINT32 packetSize = 0;
+	HRESULT result;
+
+	while (SUCCEEDED(result = capture->GetNextPacketSize(&packetSize)) && packetSize > 0)
+	{
+		BYTE* data = nullptr;
+		UINT32 frames = 0;
+		DWORD flags = 0;
+
+		if (FAILED(result = capture->GetBuffer(&data, &frames, &flags, NULL, NULL)))
+			break;
+
+		if (flags & AUDCLNT_BUFFERFLAGS_DATA_DISCONTINUITY)
 		{
-			Error(Logger::getInstance("HYPERHDR"), "Could not find '%s' device for open", QSTRING_CSTR(_selectedDevice));
-			return;
+			if (_overruns++ == 0)
+				Warning(Logger::getInstance("HYPERHDR"), "Sound capture overrun, the samples were not read on time");
+			_lastPeriod = 0;
 		}
 
-		WAVEFORMATEX pFormat;
-		pFormat.wFormatTag = WAVE_FORMAT_PCM;
-		pFormat.nChannels = 1;
-		pFormat.nSamplesPerSec = 22050;
-		pFormat.wBitsPerSample = 16;
-		pFormat.nBlockAlign = (pFormat.nChannels * pFormat.wBitsPerSample) / 8;
-		pFormat.nAvgBytesPerSec = (pFormat.nSamplesPerSec * pFormat.nChannels * pFormat.wBitsPerSample) / 8;
-		pFormat.cbSize = 0;
+		AddFrames(data, frames, format, (flags & AUDCLNT_BUFFERFLAGS_SILENT) != 0);
 
-		MMRESULT result = waveInOpen(&_hWaveIn, WAVE_MAPPER, &pFormat, (DWORD_PTR) & (soundInProc), 0L, CALLBACK_FUNCTION);
+		capture->ReleaseBuffer(frames);
+	}
 
-		if (result != MMSYSERR_NOERROR)
+	if (result == AUDCLNT_E_DEVICE_INVALIDATED)
+	{
+		Error(Logger::getInstance("HYPERHDR"), "The sound device '%s' was removed", QSTRING_CSTR(_selectedDevice));
+		SetEvent(_stopEvent);
+	}
+}
+
+void SoundCapWindows::AddFrames(const BYTE* data, UINT32 frames, const WAVEFORMATEX* format, bool silent)
+{
+	const int channels = format->nChannels;
+	const UINT32 rate = format->nSamplesPerSec;
+	const bool floatFormat = isFloat(format);
+
+	for (UINT32 frame = 0; frame < frames; frame++)
+	{
+		// the channels are mixed to mono in the range of 16-bit samples
+		float value = 0;
+
+		if (!silent)
 		{
-			Error(Logger::getInstance("HYPERHDR"), "Error during opening sound device '%s'. Error code: %i", QSTRING_CSTR(_selectedDevice), result);
-			return;
+			for (int channel = 0; channel < channels; channel++)
+			{
+				const int index = frame * channels + channel;
+
+				if (floatFormat)
+					value += reinterpret_cast<const float*>(data)[index] * 32767.0f;
+				else if (format->wBitsPerSample == 16)
+					value += reinterpret_cast<const int16_t*>(data)[index];
+				else
+					value += reinterpret_cast<const int32_t*>(data)[index] / 65536.0f;
+			}
+			value /= channels;
 		}
 
-		_header.lpData = (LPSTR)&_soundBuffer[0];
-		_header.dwBufferLength = (1 << SOUNDCAPWINDOWS_BUF_LENP) * 2;
-		_header.dwFlags = 0L;
-		_header.dwLoops = 0L;
-		waveInPrepareHeader(_hWaveIn, &_header, sizeof(WAVEHDR));
+		// the frames of the engine rate are averaged into the samples of the analysis rate
+		_sum += value;
+		_sumCount++;
+		_phase += SOUNDCAP_SAMPLE_RATE;
 
-		waveInAddBuffer(_hWaveIn, &_header, sizeof(WAVEHDR));
+		if (_phase < rate)
+			continue;
 
-		result = waveInStart(_hWaveIn);
-		if (result != MMSYSERR_NOERROR)
+		// no std::min/max, windows.h defines their macros
+		float sample = _sum / _sumCount;
+		sample = (sample > 32767.0f) ? 32767.0f : ((sample < -32768.0f) ? -32768.0f : sample);
+		_sum = 0;
+		_sumCount = 0;
+
+		// a device slower than the analysis rate repeats its frames
+		while (_phase >= rate)
 		{
-			Error(Logger::getInstance("HYPERHDR"), "Error during starting sound device '%s'. Error code: %i", QSTRING_CSTR(_selectedDevice), result);
+			_phase -= rate;
+			_soundBuffer[_pending++] = static_cast<int16_t>(sample);
+
+			if (_pending == (1 << SOUNDCAPWINDOWS_BUF_LENP))
+			{
+				_pending = 0;
+				Analise();
+			}
+		}
+	}
+}
+
+void SoundCapWindows::Analise()
+{
+	const qint64 now = PreciseTimer::now();
+	const qint64 period = ((qint64)(1 << SOUNDCAPWINDOWS_BUF_LENP) * 1000000000) / SOUNDCAP_SAMPLE_RATE;
+
+	// the interarrival jitter of RFC 3550: the mean deviation of the periods from their length, smoothed by 1/16
+	if (_lastPeriod != 0)
+	{
+		const qint64 deviation = std::abs((now - _lastPeriod) - period) / 1000;
+		_periodJitter = _periodJitter + (deviation - _periodJitter) / 16;
+	}
+	_lastPeriod = now;
+
+	AnaliseSpectrum(_soundBuffer, SOUNDCAPWINDOWS_BUF_LENP);
+}
+
+void SoundCapWindows::Start()
+{
+	if (_isActive && !_isRunning)
+	{
+		_phase = 0;
+		_sum = 0;
+		_sumCount = 0;
+		_pending = 0;
+		_lastPeriod = 0;
+		_periodJitter = 0;
+		_overruns = 0;
+
+		ResetEvent(_stopEvent);
+		_isRunning = true;
+		_thread = std::thread(&SoundCapWindows::Capture, this);
+
+		WaitForSingleObject(_readyEvent, INFINITE);
+
+		if (!_startResult)
+		{
+			_isRunning = false;
+			_thread.join();
 		}
-		else
-			_isRunning = true;
 	}
 }
 
@@ -132,6 +453,9 @@ void SoundCapWindows::Stop()
 	if (_isRunning)
 	{
 		_isRunning = false;
-		waveInClose(_hWaveIn);
+		SetEvent(_stopEvent);
 	}
+
+	if (_thread.joinable())
+		_thread.join();
 }
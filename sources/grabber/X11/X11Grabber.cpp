@@ -37,6 +37,7 @@
 #include <sys/stat.h>
 #include <sys/types.h>
 #include <limits.h>
+#include <algorithm>
 
 #include <base/HyperHdrInstance.h>
 #include <base/HyperHdrIManager.h>
@@ -48,8 +49,14 @@
 #include <grabber/X11Grabber.h>
 #include <grabber/smartX11.h>
 #include <utils/ColorSys.h>
+#include <utils/FrameDecoder.h>
+#include <utils/InternalClock.h>
+#include <utils/PerformanceCounters.h>
 #include <dlfcn.h>
 
+// the unchanged frame is sent again so the system capture is not considered inactive
+#define X11_KEEPALIVE_INTERVAL 500
+
 struct x11Displays* (*_enumerateX11Displays)() = nullptr;
 void (*_releaseX11Displays)(struct x11Displays* buffer) = nullptr;
 x11Handle* (*_initX11Display)(int display) = nullptr;
@@ -64,6 +71,8 @@ X11Grabber::X11Grabber(const QString& device, const QString& configurationPath)
 	, _library(nullptr)
 	, _actualDisplay(0)
 	, _handle(nullptr)
+	, _lastFrameTime(0)
+	, _lastFrameGeometry{}
 {
 	_timer.setTimerType(Qt::PreciseTimer);
 	connect(&_timer, &QTimer::timeout, this, &X11Grabber::grabFrame);
@@ -265,6 +274,9 @@ void X11Grabber::stop()
 			_handle = nullptr;
 			_initialized = false;
 		}
+		_lastFrame = Image<ColorRgb>();
+		_lastFrameTime = 0;
+		_captureStat = {};
 		_semaphore.release();
 		Info(_log, "Stopped");
 	}
@@ -301,7 +313,7 @@ void X11Grabber::grabFrame()
 				_actualWidth = _handle->width;
 				_actualHeight = _handle->height;
 
-				processSystemFrameBGRA(data);
+				processDamagedFrameBGRA(data, _handle->lineSize, _handle->changed != 0, _handle->damageTop, _handle->damageBottom);
 
 				_releaseFrame(_handle);
 			}
@@ -315,6 +327,100 @@ void X11Grabber::grabFrame()
 	}
 }
 
+void X11Grabber::processDamagedFrameBGRA(uint8_t* source, int lineSize, bool changed, int damageTop, int damageBottom)
+{
+	int startX = _cropLeft;
+	int startY = _cropTop;
+	int realSizeX = _actualWidth - startX - _cropRight;
+	int realSizeY = _actualHeight - startY - _cropBottom;
+
+	if (realSizeX <= 16 || realSizeY <= 16)
+	{
+		realSizeX = _actualWidth;
+		realSizeY = _actualHeight;
+	}
+
+	int checkWidth = realSizeX;
+	int division = 1;
+
+	while (checkWidth > _width)
+	{
+		division++;
+		checkWidth = realSizeX / division;
+	}
+
+	int targetSizeX = realSizeX / division;
+	int targetSizeY = realSizeY / division;
+	const uint8_t* lut = (_hdrToneMappingEnabled == 0 || !_lutBufferInit) ? nullptr : _lutBuffer;
+	qint64 now = InternalClock::now();
+
+	int geometry[5] = { startX, startY, targetSizeX, targetSizeY, division };
+	bool sameGeometry = (_lastFrame.width() > 1) && memcmp(geometry, _lastFrameGeometry, sizeof(geometry)) == 0;
+
+	// output row j samples the source row startY + j * division
+	int firstRow = 0, lastRow = targetSizeY;
+	if (sameGeometry && changed)
+	{
+		firstRow = std::max(0, (damageTop - startY + division - 1) / division);
+		lastRow = std::min(targetSizeY, (damageBottom - startY + division - 1) / division);
+		changed = (firstRow < lastRow);
+	}
+
+	int64_t token = PerformanceCounters::currentToken();
+	if (_captureStat.token != token)
+	{
+		int total = _captureStat.full + _captureStat.partial + _captureStat.skipped;
+		if (_captureStat.token > 0 && total > 0)
+			Info(_log, "Capture statistics: skipped = %.1f%%, partially updated = %.1f%%, full = %.1f%% (%i frames)",
+				(_captureStat.skipped * 100.0) / total, (_captureStat.partial * 100.0) / total, (_captureStat.full * 100.0) / total, total);
+
+		_captureStat = {};
+		_captureStat.token = token;
+	}
+
+	Image<ColorRgb> image;
+
+	if (sameGeometry && !changed)
+	{
+		_captureStat.skipped++;
+
+		if (now - _lastFrameTime < X11_KEEPALIVE_INTERVAL)
+			return;
+
+		image = _lastFrame;
+	}
+	else if (sameGeometry)
+	{
+		_captureStat.partial++;
+
+		image = Image<ColorRgb>(targetSizeX, targetSizeY);
+		memcpy(image.rawMem(), _lastFrame.rawMem(), image.size());
+
+		Image<ColorRgb> band(targetSizeX, lastRow - firstRow);
+		FrameDecoder::processSystemImageBGRA(band, targetSizeX, lastRow - firstRow, startX, startY + firstRow * division, source, _actualWidth, _actualHeight, division, lut, lineSize);
+		memcpy(image.rawMem() + static_cast<size_t>(firstRow) * targetSizeX * 3, band.rawMem(), band.size());
+	}
+	else
+	{
+		_captureStat.full++;
+
+		image = Image<ColorRgb>(targetSizeX, targetSizeY);
+		FrameDecoder::processSystemImageBGRA(image, targetSizeX, targetSizeY, startX, startY, source, _actualWidth, _actualHeight, division, lut, lineSize);
+
+		memcpy(_lastFrameGeometry, geometry, sizeof(geometry));
+	}
+
+	_lastFrame = image;
+	_lastFrameTime = now;
+
+	if (_signalDetectionEnabled)
+	{
+		if (checkSignalDetectionManual(image))
+			emit newFrame(image);
+	}
+	else
+		emit newFrame(image);
+}
 
 void X11Grabber::setCropping(unsigned cropLeft, unsigned cropRight, unsigned cropTop, unsigned cropBottom)
 {
@@ -31,6 +31,35 @@
 #include <stdlib.h>
 #include <stdio.h>
 
+#ifdef HAS_XSHM
+	#include <sys/ipc.h>
+	#include <sys/shm.h>
+	#include <X11/extensions/XShm.h>
+#endif
+
+#ifdef HAS_XDAMAGE
+	#include <X11/extensions/Xdamage.h>
+	#include <X11/extensions/Xfixes.h>
+#endif
+
+// persistent capture state: the shared memory segment and the damage tracking
+struct x11Capture
+{
+	int width;
+	int height;
+	bool fullFrame;
+	bool useShm;
+	bool useDamage;
+#ifdef HAS_XSHM
+	XShmSegmentInfo shm;
+	XImage* shmImage;
+#endif
+#ifdef HAS_XDAMAGE
+	Damage damage;
+	XserverRegion region;
+#endif
+};
+
 struct x11Displays* enumerateX11Displays()
 {
 	Display* myDisplay = XOpenDisplay(nullptr);
@@ -78,13 +107,66 @@ void releaseX11Displays(struct x11Displays* buffer)
 	free(buffer);
 }
 
+static bool x11errorFlag = false;
+
 static int x11errorHandler(Display* d, XErrorEvent* e)
 {
+	x11errorFlag = true;
 	return 0;
 }
 
 static XErrorHandler oldHandler = nullptr;
 
+#ifdef HAS_XSHM
+static void releaseShmImage(Display* display, x11Capture* capture)
+{
+	if (capture->shmImage == nullptr)
+		return;
+
+	XShmDetach(display, &capture->shm);
+	XDestroyImage(capture->shmImage);
+	shmdt(capture->shm.shmaddr);
+	capture->shmImage = nullptr;
+}
+
+static bool createShmImage(Display* display, int screen, x11Capture* capture)
+{
+	releaseShmImage(display, capture);
+
+	capture->shmImage = XShmCreateImage(display, DefaultVisual(display, screen), DefaultDepth(display, screen), ZPixmap, nullptr, &capture->shm, capture->width, capture->height);
+	if (capture->shmImage == nullptr)
+		return false;
+
+	capture->shm.shmid = shmget(IPC_PRIVATE, capture->shmImage->bytes_per_line * capture->shmImage->height, IPC_CREAT | 0600);
+	if (capture->shm.shmid < 0)
+	{
+		XDestroyImage(capture->shmImage);
+		capture->shmImage = nullptr;
+		return false;
+	}
+
+	capture->shm.shmaddr = capture->shmImage->data = (char*)shmat(capture->shm.shmid, nullptr, 0);
+	capture->shm.readOnly = False;
+
+	// the attach fails for the remote displays: the error is reported asynchronously
+	x11errorFlag = false;
+	bool attached = (capture->shm.shmaddr != (char*)-1) && XShmAttach(display, &capture->shm);
+	XSync(display, False);
+	shmctl(capture->shm.shmid, IPC_RMID, nullptr);
+
+	if (!attached || x11errorFlag)
+	{
+		if (capture->shm.shmaddr != (char*)-1)
+			shmdt(capture->shm.shmaddr);
+		XDestroyImage(capture->shmImage);
+		capture->shmImage = nullptr;
+		return false;
+	}
+
+	return true;
+}
+#endif
+
 x11Handle* initX11Display(int display)
 {	
 	Display* maindisplay = XOpenDisplay(NULL);
@@ -100,9 +182,36 @@ x11Handle* initX11Display(int display)
 	retVal->width = 0;
 	retVal->height = 0;
 	retVal->size = 0;
+	retVal->lineSize = 0;
+	retVal->changed = 1;
+	retVal->damageTop = 0;
+	retVal->damageBottom = 0;
 
 	oldHandler = XSetErrorHandler(x11errorHandler);
 
+	struct x11Capture* capture = (struct x11Capture*)calloc(1, sizeof(struct x11Capture));
+	retVal->capture = (void*)capture;
+
+	capture->fullFrame = true;
+
+#ifdef HAS_XSHM
+	capture->useShm = XShmQueryExtension(maindisplay);
+#endif
+
+#ifdef HAS_XDAMAGE
+	int damageEvent = 0, damageError = 0;
+
+	// without the persistent shared memory image there is no previous frame to keep when nothing changed
+	if (capture->useShm && XDamageQueryExtension(maindisplay, &damageEvent, &damageError))
+	{
+		x11errorFlag = false;
+		capture->damage = XDamageCreate(maindisplay, RootWindow(maindisplay, display), XDamageReportNonEmpty);
+		capture->region = XFixesCreateRegion(maindisplay, nullptr, 0);
+		XSync(maindisplay, False);
+		capture->useDamage = !x11errorFlag;
+	}
+#endif
+
 	return retVal;
 }
 
@@ -111,7 +220,8 @@ void releaseFrame(x11Handle* retVal)
 	if (retVal == nullptr)
 		return;
 
-	if (retVal->image != nullptr)
+	// the shared memory image is reused by the next capture
+	if (retVal->image != nullptr && (retVal->capture == nullptr || !((x11Capture*)retVal->capture)->useShm))
 		XDestroyImage((XImage*)retVal->image);
 
 	retVal->image = nullptr;
@@ -119,17 +229,47 @@ void releaseFrame(x11Handle* retVal)
 
 void uninitX11Display(x11Handle* retVal)
 {
+	if (retVal == nullptr)
+	{
+		if (oldHandler != nullptr)
+		{
+			XSetErrorHandler(oldHandler);
+			oldHandler = nullptr;
+		}
+		return;
+	}
+
+	releaseFrame(retVal);
+
+	x11Capture* capture = (x11Capture*)retVal->capture;
+
+	if (capture != nullptr && retVal->handle != nullptr)
+	{
+		Display* display = (Display*)retVal->handle;
+
+#ifdef HAS_XDAMAGE
+		if (capture->useDamage)
+		{
+			XDamageDestroy(display, capture->damage);
+			XFixesDestroyRegion(display, capture->region);
+		}
+#endif
+
+#ifdef HAS_XSHM
+		releaseShmImage(display, capture);
+#endif
+		XSync(display, False);
+	}
+
+	free(capture);
+	retVal->capture = nullptr;
+
 	if (oldHandler != nullptr)
 	{
 		XSetErrorHandler(oldHandler);
 		oldHandler = nullptr;
 	}
 
-	if (retVal == nullptr)
-		return;
-
-	releaseFrame(retVal);
-
 	if (retVal->handle != nullptr)
 		XCloseDisplay((Display*)retVal->handle);
 
@@ -145,18 +285,90 @@ unsigned char* getFrame(x11Handle* retVal)
 
 	releaseFrame(retVal);
 
-	Window window = RootWindow((Display*)retVal->handle, retVal->index);
+	Display* display = (Display*)retVal->handle;
+	x11Capture* capture = (x11Capture*)retVal->capture;
+	Window window = RootWindow(display, retVal->index);
 	XWindowAttributes attr = {};
 
-	XGetWindowAttributes((Display*)retVal->handle, window, &attr);
+	XGetWindowAttributes(display, window, &attr);
+
+	if (capture->width != attr.width || capture->height != attr.height)
+	{
+		capture->width = attr.width;
+		capture->height = attr.height;
+		capture->fullFrame = true;
+
+#ifdef HAS_XSHM
+		if (capture->useShm && !createShmImage(display, retVal->index, capture))
+		{
+			printf("X11: shared memory capture is not available. Falling back to XGetImage\n");
+			capture->useShm = false;
+			capture->useDamage = false;
+		}
+#endif
+	}
+
+	retVal->changed = 1;
+	retVal->damageTop = 0;
+	retVal->damageBottom = attr.height;
+
+#ifdef HAS_XDAMAGE
+	if (capture->useDamage)
+	{
+		// only the damage events are selected: drain them, the accumulated region is read below
+		while (XPending(display) > 0)
+		{
+			XEvent event;
+			XNextEvent(display, &event);
+		}
+
+		int count = 0;
+		XDamageSubtract(display, capture->damage, None, capture->region);
+		XRectangle* rects = XFixesFetchRegion(display, capture->region, &count);
+
+		if (!capture->fullFrame)
+		{
+			int top = attr.height, bottom = 0;
+
+			for (int i = 0; i < count; i++)
+			{
+				if (rects[i].y < top)
+					top = rects[i].y;
+				if (rects[i].y + rects[i].height > bottom)
+					bottom = rects[i].y + rects[i].height;
+			}
+
+			retVal->changed = (count > 0 && bottom > top) ? 1 : 0;
+			retVal->damageTop = (top < 0) ? 0 : top;
+			retVal->damageBottom = (bottom > attr.height) ? attr.height : bottom;
+		}
+
+		if (rects != nullptr)
+			XFree(rects);
+	}
+#endif
+
+	XImage* img = nullptr;
+
+#ifdef HAS_XSHM
+	if (capture->useShm)
+	{
+		if (!retVal->changed || XShmGetImage(display, window, capture->shmImage, 0, 0, AllPlanes))
+			img = capture->shmImage;
+	}
+	else
+#endif
+		img = XGetImage(display, window, 0, 0, attr.width, attr.height, AllPlanes, ZPixmap);
 
-	XImage *img = XGetImage((Display*)retVal->handle, window, 0, 0, attr.width, attr.height, AllPlanes, ZPixmap);
 	retVal->image = (void*)img;
 
 	if (retVal->image != nullptr)
 	{
+		capture->fullFrame = false;
+
 		retVal->width = img->width;
 		retVal->height = img->height;
+		retVal->lineSize = img->bytes_per_line;
 		retVal->size = img->bytes_per_line * img->height;
 
 		return (unsigned char*)img->data;
@@ -164,5 +376,3 @@ unsigned char* getFrame(x11Handle* retVal)
 	else
 		return nullptr;
 }
-
-
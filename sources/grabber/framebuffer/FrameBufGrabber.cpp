@@ -51,12 +51,18 @@
 
 #include <grabber/FrameBufGrabber.h>
 #include <utils/ColorSys.h>
+#include <utils/FrameDecoder.h>
+#include <utils/PerformanceCounters.h>
+
+#include <cmath>
 
 FrameBufGrabber::FrameBufGrabber(const QString& device, const QString& configurationPath)
 	: Grabber("FRAMEBUFFER_SYSTEM:" + device.left(14))
 	, _configurationPath(configurationPath)
 	, _semaphore(1)
 	, _handle(-1)
+	, _memHandle(nullptr)
+	, _memSize(0)
 {
 	_timer.setTimerType(Qt::PreciseTimer);
 	connect(&_timer, &QTimer::timeout, this, &FrameBufGrabber::grabFrame);
@@ -234,6 +240,8 @@ void FrameBufGrabber::stop()
 		_semaphore.acquire();
 		_timer.stop();
 
+		unmapMemory();
+
 		if (_handle >= 0)
 		{
 			close(_handle);
@@ -266,6 +274,7 @@ void FrameBufGrabber::grabFrame()
 			{
 				Warning(_log, "The handle is lost. Trying to restart the driver.");
 
+				unmapMemory();
 				close(_handle);
 				_handle = open(QSTRING_CSTR(_actualDeviceName), O_RDONLY);
 
@@ -286,24 +295,15 @@ void FrameBufGrabber::grabFrame()
 
 					if (ioctl(_handle, FBIOGET_FSCREENINFO, &format) >= 0)
 					{
-						uint8_t* memHandle = static_cast<uint8_t*>(mmap(nullptr, format.smem_len, PROT_READ, MAP_PRIVATE | MAP_NORESERVE, _handle, 0));
-
-						if (memHandle == MAP_FAILED)
+						if (!mapMemory(format.smem_len))
 						{
 							Error(_log, "Could not map the framebuffer memory.");
 							stopNow = true;
 						}
 						else
 						{
-							if (scr.bits_per_pixel == 32)
-								processSystemFrameBGRA(memHandle, format.line_length);
-							else if (scr.bits_per_pixel == 24)
-								processSystemFrameBGR(memHandle, format.line_length);
-							else if (scr.bits_per_pixel == 16)
-								processSystemFrameBGR16(memHandle, format.line_length);
-
-							munmap(memHandle, format.smem_len);
-						}						
+							processRegionFrame(_memHandle, format.line_length, scr.bits_per_pixel);
+						}
 					}
 					else
 					{
@@ -328,6 +328,149 @@ void FrameBufGrabber::grabFrame()
 }
 
 
+bool FrameBufGrabber::mapMemory(size_t size)
+{
+	if (_memHandle != nullptr && _memSize == size)
+		return true;
+
+	unmapMemory();
+
+	void* memHandle = mmap(nullptr, size, PROT_READ, MAP_PRIVATE | MAP_NORESERVE, _handle, 0);
+
+	if (memHandle == MAP_FAILED)
+		return false;
+
+	_memHandle = static_cast<uint8_t*>(memHandle);
+	_memSize = size;
+
+	Debug(_log, "Mapped %i bytes of the framebuffer memory", int(_memSize));
+
+	return true;
+}
+
+void FrameBufGrabber::unmapMemory()
+{
+	if (_memHandle != nullptr)
+	{
+		munmap(_memHandle, _memSize);
+		_memHandle = nullptr;
+		_memSize = 0;
+	}
+}
+
+void FrameBufGrabber::decodeRegion(Image<ColorRgb>& image, int targetSizeX, int targetSizeY, int startX, int startY, uint8_t* source, int lineSize, int bitsPerPixel, int division)
+{
+	const uint8_t* lut = (_hdrToneMappingEnabled == 0 || !_lutBufferInit) ? nullptr : _lutBuffer;
+
+	if (bitsPerPixel == 32)
+		FrameDecoder::processSystemImageBGRA(image, targetSizeX, targetSizeY, startX, startY, source, _actualWidth, _actualHeight, division, lut, lineSize);
+	else if (bitsPerPixel == 24)
+		FrameDecoder::processSystemImageBGR(image, targetSizeX, targetSizeY, startX, startY, source, _actualWidth, _actualHeight, division, lut, lineSize);
+	else
+		FrameDecoder::processSystemImageBGR16(image, targetSizeX, targetSizeY, startX, startY, source, _actualWidth, _actualHeight, division, lut, lineSize);
+}
+
+void FrameBufGrabber::processRegionFrame(uint8_t* source, int lineSize, int bitsPerPixel)
+{
+	int startX = _cropLeft;
+	int startY = _cropTop;
+	int realSizeX = _actualWidth - startX - _cropRight;
+	int realSizeY = _actualHeight - startY - _cropBottom;
+
+	if (realSizeX <= 16 || realSizeY <= 16)
+	{
+		startX = startY = 0;
+		realSizeX = _actualWidth;
+		realSizeY = _actualHeight;
+	}
+
+	int checkWidth = realSizeX;
+	int division = 1;
+
+	while (checkWidth > _width)
+	{
+		division++;
+		checkWidth = realSizeX / division;
+	}
+
+	int targetSizeX = realSizeX / division;
+	int targetSizeY = realSizeY / division;
+
+	// the skipped rectangle with one pixel of margin for the rounding of the led areas
+	int holeLeft = 0, holeRight = 0, holeTop = 0, holeBottom = 0;
+	QRectF skippedArea = getSkippedArea();
+
+	if (!skippedArea.isEmpty())
+	{
+		holeLeft = int(std::ceil(skippedArea.left() * targetSizeX)) + 1;
+		holeRight = int(std::floor(skippedArea.right() * targetSizeX)) - 1;
+		holeTop = int(std::ceil(skippedArea.top() * targetSizeY)) + 1;
+		holeBottom = int(std::floor(skippedArea.bottom() * targetSizeY)) - 1;
+	}
+
+	bool partial = (holeLeft > 0 && holeLeft < holeRight && holeRight < targetSizeX &&
+					holeTop > 0 && holeTop < holeBottom && holeBottom < targetSizeY);
+
+	int64_t token = PerformanceCounters::currentToken();
+	if (_regionStat.token != token)
+	{
+		if (_regionStat.token > 0 && _regionStat.total > 0)
+			Info(_log, "Region capture: %.1f%% of the frame was sampled", (_regionStat.sampled * 100.0) / _regionStat.total);
+
+		_regionStat = {};
+		_regionStat.token = token;
+	}
+
+	Image<ColorRgb> image(targetSizeX, targetSizeY);
+
+	if (!partial)
+	{
+		decodeRegion(image, targetSizeX, targetSizeY, startX, startY, source, lineSize, bitsPerPixel, division);
+
+		_regionStat.sampled += static_cast<qint64>(targetSizeX) * targetSizeY;
+	}
+	else
+	{
+		const int middleHeight = holeBottom - holeTop;
+		const int rightWidth = targetSizeX - holeRight;
+		const size_t stride = static_cast<size_t>(targetSizeX) * 3;
+
+		// the top band is decoded in place, the other parts are copied from their own buffers
+		decodeRegion(image, targetSizeX, holeTop, startX, startY, source, lineSize, bitsPerPixel, division);
+
+		Image<ColorRgb> bottom(targetSizeX, targetSizeY - holeBottom);
+		decodeRegion(bottom, targetSizeX, targetSizeY - holeBottom, startX, startY + holeBottom * division, source, lineSize, bitsPerPixel, division);
+		memcpy(image.rawMem() + holeBottom * stride, bottom.rawMem(), bottom.size());
+
+		Image<ColorRgb> left(holeLeft, middleHeight);
+		decodeRegion(left, holeLeft, middleHeight, startX, startY + holeTop * division, source, lineSize, bitsPerPixel, division);
+
+		Image<ColorRgb> right(rightWidth, middleHeight);
+		decodeRegion(right, rightWidth, middleHeight, startX + holeRight * division, startY + holeTop * division, source, lineSize, bitsPerPixel, division);
+
+		for (int j = 0; j < middleHeight; j++)
+		{
+			uint8_t* dLine = image.rawMem() + (holeTop + j) * stride;
+
+			memcpy(dLine, left.rawMem() + static_cast<size_t>(j) * holeLeft * 3, static_cast<size_t>(holeLeft) * 3);
+			memset(dLine + static_cast<size_t>(holeLeft) * 3, 0, static_cast<size_t>(holeRight - holeLeft) * 3);
+			memcpy(dLine + static_cast<size_t>(holeRight) * 3, right.rawMem() + static_cast<size_t>(j) * rightWidth * 3, static_cast<size_t>(rightWidth) * 3);
+		}
+
+		_regionStat.sampled += static_cast<qint64>(targetSizeX) * targetSizeY - static_cast<qint64>(holeRight - holeLeft) * middleHeight;
+	}
+
+	_regionStat.total += static_cast<qint64>(targetSizeX) * targetSizeY;
+
+	if (_signalDetectionEnabled)
+	{
+		if (checkSignalDetectionManual(image))
+			emit newFrame(image);
+	}
+	else
+		emit newFrame(image);
+}
+
 void FrameBufGrabber::setCropping(unsigned cropLeft, unsigned cropRight, unsigned cropTop, unsigned cropBottom)
 {
 	_cropLeft = cropLeft;
@@ -47,20 +47,89 @@
 
 #include <grabber/macOsGrabber.h>
 #include <utils/ColorSys.h>
+#include <utils/InternalClock.h>
 
 #import <Foundation/Foundation.h>
 #import <Foundation/NSProcessInfo.h>
 
+// the unchanged screen delivers no frames: the last one is sent again so the system capture is not considered inactive
+#define MACOS_KEEPALIVE_INTERVAL 500
+
 id activity;
 
+#ifdef HAVE_SCREENCAPTUREKIT
+
+#import <ScreenCaptureKit/ScreenCaptureKit.h>
+#import <CoreMedia/CoreMedia.h>
+#import <CoreVideo/CoreVideo.h>
+
+API_AVAILABLE(macos(12.3))
+@interface ScreenStreamDelegate : NSObject<SCStreamOutput, SCStreamDelegate>
+{
+@public
+	macOsGrabber*		_grabber;
+	dispatch_queue_t	_sequencer;
+	SCStream*			_stream;
+}
+@end
+
+@implementation ScreenStreamDelegate
+
+- (void)stream:(SCStream *)stream didOutputSampleBuffer:(CMSampleBufferRef)sampleBuffer ofType:(SCStreamOutputType)type
+{
+	if (type != SCStreamOutputTypeScreen || !CMSampleBufferIsValid(sampleBuffer))
+		return;
+
+	// idle and blank updates carry no pixels
+	CFArrayRef attachments = CMSampleBufferGetSampleAttachmentsArray(sampleBuffer, false);
+	if (attachments == NULL || CFArrayGetCount(attachments) < 1)
+		return;
+
+	NSDictionary* frameInfo = (NSDictionary*)CFArrayGetValueAtIndex(attachments, 0);
+	NSNumber* frameStatus = frameInfo[SCStreamFrameInfoStatus];
+	if (frameStatus == nil || [frameStatus integerValue] != SCFrameStatusComplete)
+		return;
+
+	CVPixelBufferRef systemBuffer = CMSampleBufferGetImageBuffer(sampleBuffer);
+	if (systemBuffer == NULL || CVPixelBufferLockBaseAddress(systemBuffer, kCVPixelBufferLock_ReadOnly) != kCVReturnSuccess)
+		return;
+
+	@synchronized(self)
+	{
+		if (_grabber != nullptr)
+			_grabber->processStreamFrame(static_cast<uint8_t*>(CVPixelBufferGetBaseAddress(systemBuffer)),
+				(int)CVPixelBufferGetWidth(systemBuffer), (int)CVPixelBufferGetHeight(systemBuffer), (int)CVPixelBufferGetBytesPerRow(systemBuffer));
+	}
+
+	CVPixelBufferUnlockBaseAddress(systemBuffer, kCVPixelBufferLock_ReadOnly);
+}
+
+- (void)stream:(SCStream *)stream didStopWithError:(NSError *)error
+{
+	@synchronized(self)
+	{
+		if (_grabber != nullptr)
+			QMetaObject::invokeMethod(_grabber, "streamStopped", Qt::QueuedConnection);
+	}
+}
+
+@end
+
+#endif
+
 macOsGrabber::macOsGrabber(const QString& device, const QString& configurationPath)
 	: Grabber("MACOS_SYSTEM:" + device.left(14))
 	, _configurationPath(configurationPath)
 	, _semaphore(1)
 	, _actualDisplay(0)
+	, _streamHandler(nullptr)
+	, _streamActive(false)
+	, _streamScale(1)
+	, _lastFrameTime(0)
 {
 	_timer.setTimerType(Qt::PreciseTimer);
 	connect(&_timer, &QTimer::timeout, this, &macOsGrabber::grabFrame);
+	connect(this, &Grabber::newFrame, this, &macOsGrabber::cacheHandler, Qt::DirectConnection);
 
 	// Refresh devices
 	getDevices();
@@ -205,6 +274,7 @@ bool macOsGrabber::start()
 		{
 			_timer.setInterval(1000/_fps);
 			_timer.start();
+			startStream();
 			Info(_log, "Started");
 			return true;
 		}
@@ -223,6 +293,9 @@ void macOsGrabber::stop()
 	{
 		_semaphore.acquire();
 		_timer.stop();
+		stopStream();
+		_lastFrame = Image<ColorRgb>();
+		_lastFrameTime = 0;
 		_semaphore.release();
 		Info(_log, "Stopped");
 	}
@@ -237,7 +310,17 @@ void macOsGrabber::grabFrame()
 {
 	bool stopNow = false;
 
-	if (_semaphore.tryAcquire())
+	if (_streamActive)
+	{
+		if (_semaphore.tryAcquire())
+		{
+			if (_lastFrame.width() > 1 && InternalClock::now() - _lastFrameTime >= MACOS_KEEPALIVE_INTERVAL)
+				emit newFrame(_lastFrame);
+
+			_semaphore.release();
+		}
+	}
+	else if (_semaphore.tryAcquire())
 	{		
 		CGImageRef display;
 		CFDataRef sysData;
@@ -260,7 +343,7 @@ void macOsGrabber::grabFrame()
 				_actualWidth = CGImageGetWidth(display);
 				_actualHeight = CGImageGetHeight(display);
 
-				processSystemFrameBGRA(rawData);
+				processSystemFrameBGRA(rawData, (int)CGImageGetBytesPerRow(display));
 
 				CFRelease(sysData);
 			}
@@ -277,6 +360,174 @@ void macOsGrabber::grabFrame()
 	}
 }
 
+void macOsGrabber::processStreamFrame(uint8_t* source, int width, int height, int lineSize)
+{
+	if (!_semaphore.tryAcquire())
+		return;
+
+	int cropLeft = _cropLeft, cropRight = _cropRight, cropTop = _cropTop, cropBottom = _cropBottom;
+
+	// the frame is already scaled by the OS: the cropping is given in the display pixels
+	_actualWidth = width;
+	_actualHeight = height;
+	_cropLeft /= _streamScale;
+	_cropRight /= _streamScale;
+	_cropTop /= _streamScale;
+	_cropBottom /= _streamScale;
+
+	processSystemFrameBGRA(source, lineSize);
+
+	_cropLeft = cropLeft;
+	_cropRight = cropRight;
+	_cropTop = cropTop;
+	_cropBottom = cropBottom;
+
+	_semaphore.release();
+}
+
+void macOsGrabber::cacheHandler(const Image<ColorRgb>& image)
+{
+	_lastFrame = image;
+	_lastFrameTime = InternalClock::now();
+}
+
+void macOsGrabber::streamStopped()
+{
+	Error(_log, "ScreenCaptureKit stream has stopped. Lost connection to the display or user didn't grant access rights");
+	uninit();
+}
+
+void macOsGrabber::startStream()
+{
+#ifdef HAVE_SCREENCAPTUREKIT
+	if (@available(macOS 12.3, *))
+	{
+		CGDisplayModeRef mode = CGDisplayCopyDisplayMode(_actualDisplay);
+
+		if (mode == NULL)
+			return;
+
+		int pixelWidth = (int)CGDisplayModeGetPixelWidth(mode);
+		int pixelHeight = (int)CGDisplayModeGetPixelHeight(mode);
+		CGDisplayModeRelease(mode);
+
+		// the largest integer reduction that still leaves at least the target width, the rest is done by the decimation
+		_streamScale = qMax(pixelWidth / qMax(_width, 1), 1);
+
+		int outputWidth = qMax(pixelWidth / _streamScale, 1);
+		int outputHeight = qMax(pixelHeight / _streamScale, 1);
+		int fps = qMax(_fps, 1);
+		CGDirectDisplayID displayId = _actualDisplay;
+		Logger* log = _log;
+		std::atomic<bool>* streamActive = &_streamActive;
+
+		ScreenStreamDelegate* delegate = [ScreenStreamDelegate new];
+		delegate->_grabber = this;
+		delegate->_sequencer = dispatch_queue_create("ScreenStreamQueue", DISPATCH_QUEUE_SERIAL);
+		delegate->_stream = nil;
+		_streamHandler = delegate;
+
+		[SCShareableContent getShareableContentWithCompletionHandler:^(SCShareableContent* content, NSError* error)
+		{
+			SCDisplay* target = nil;
+
+			for (SCDisplay* display in content.displays)
+				if (display.displayID == displayId)
+					target = display;
+
+			@synchronized(delegate)
+			{
+				if (delegate->_grabber == nullptr || target == nil)
+				{
+					if (delegate->_grabber != nullptr)
+						Warning(log, "ScreenCaptureKit could not find the display (%s). Using CoreGraphics capture.", (error != nil) ? [[error localizedDescription] UTF8String] : "unknown");
+					return;
+				}
+
+				SCContentFilter* filter = [[[SCContentFilter alloc] initWithDisplay:target excludingWindows:@[]] autorelease];
+				SCStreamConfiguration* config = [[SCStreamConfiguration new] autorelease];
+
+				config.width = outputWidth;
+				config.height = outputHeight;
+				config.pixelFormat = kCVPixelFormatType_32BGRA;
+				config.minimumFrameInterval = CMTimeMake(1, fps);
+				config.queueDepth = 3;
+				config.showsCursor = NO;
+
+				delegate->_stream = [[SCStream alloc] initWithFilter:filter configuration:config delegate:delegate];
+
+				NSError* outputError = nil;
+				if (![delegate->_stream addStreamOutput:delegate type:SCStreamOutputTypeScreen sampleHandlerQueue:delegate->_sequencer error:&outputError])
+				{
+					Warning(log, "ScreenCaptureKit could not add the stream output. Using CoreGraphics capture.");
+					[delegate->_stream release];
+					delegate->_stream = nil;
+					return;
+				}
+
+				[delegate->_stream startCaptureWithCompletionHandler:^(NSError* startError)
+				{
+					@synchronized(delegate)
+					{
+						if (delegate->_grabber == nullptr)
+							return;
+
+						if (startError != nil)
+						{
+							Warning(log, "ScreenCaptureKit could not start the capture (%s). Using CoreGraphics capture.", [[startError localizedDescription] UTF8String]);
+							return;
+						}
+
+						Info(log, "ScreenCaptureKit capture started: %d x %d (scale: 1/%d) @ %d fps", outputWidth, outputHeight, pixelWidth / outputWidth, fps);
+						*streamActive = true;
+					}
+				}];
+			}
+		}];
+	}
+#endif
+}
+
+void macOsGrabber::stopStream()
+{
+	_streamActive = false;
+
+#ifdef HAVE_SCREENCAPTUREKIT
+	if (@available(macOS 12.3, *))
+	{
+		ScreenStreamDelegate* delegate = (ScreenStreamDelegate*)_streamHandler;
+
+		if (delegate == nil)
+			return;
+
+		// the callbacks can still be pending on the dispatch queue
+		@synchronized(delegate)
+		{
+			delegate->_grabber = nullptr;
+
+			if (delegate->_stream != nil)
+			{
+				SCStream* stream = delegate->_stream;
+				delegate->_stream = nil;
+
+				[stream stopCaptureWithCompletionHandler:^(NSError* error)
+				{
+					[stream release];
+					dispatch_release(delegate->_sequencer);
+					[delegate release];
+				}];
+			}
+			else
+			{
+				dispatch_release(delegate->_sequencer);
+				[delegate release];
+			}
+		}
+
+		_streamHandler = nullptr;
+	}
+#endif
+}
 
 void macOsGrabber::setCropping(unsigned cropLeft, unsigned cropRight, unsigned cropTop, unsigned cropBottom)
 {
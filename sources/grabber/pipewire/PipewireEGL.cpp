@@ -0,0 +1,416 @@
+/* PipewireEGL.cpp
+*
+*  MIT License
+*
+*  Copyright (c) 2023 awawa-dev
+*
+*  Project homesite: https://github.com/awawa-dev/HyperHDR
+*
+*  Permission is hereby granted, free of charge, to any person obtaining a copy
+*  of this software and associated documentation files (the "Software"), to deal
+*  in the Software without restriction, including without limitation the rights
+*  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+*  copies of the Software, and to permit persons to whom the Software is
+*  furnished to do so, subject to the following conditions:
+*
+*  The above copyright notice and this permission notice shall be included in all
+*  copies or substantial portions of the Software.
+
+*  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+*  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+*  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+*  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+*  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+*  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+*  SOFTWARE.
+ */
+
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+
+#include <spa/buffer/buffer.h>
+
+#include "PipewireEGL.h"
+
+// implicit modifier: the layout is agreed on by the driver
+#define PIPEWIRE_DRM_FORMAT_MOD_INVALID	0x00ffffffffffffffULL
+#define PIPEWIRE_EGL_MAX_PLANES 4
+#define PIPEWIRE_EGL_MAX_MODIFIERS 64
+
+#ifndef EGL_PLATFORM_SURFACELESS_MESA
+	#define EGL_PLATFORM_SURFACELESS_MESA 0x31DD
+#endif
+
+namespace
+{
+	const EGLint planeAttribs[PIPEWIRE_EGL_MAX_PLANES][5] = {
+		{ EGL_DMA_BUF_PLANE0_FD_EXT, EGL_DMA_BUF_PLANE0_OFFSET_EXT, EGL_DMA_BUF_PLANE0_PITCH_EXT, EGL_DMA_BUF_PLANE0_MODIFIER_LO_EXT, EGL_DMA_BUF_PLANE0_MODIFIER_HI_EXT },
+		{ EGL_DMA_BUF_PLANE1_FD_EXT, EGL_DMA_BUF_PLANE1_OFFSET_EXT, EGL_DMA_BUF_PLANE1_PITCH_EXT, EGL_DMA_BUF_PLANE1_MODIFIER_LO_EXT, EGL_DMA_BUF_PLANE1_MODIFIER_HI_EXT },
+		{ EGL_DMA_BUF_PLANE2_FD_EXT, EGL_DMA_BUF_PLANE2_OFFSET_EXT, EGL_DMA_BUF_PLANE2_PITCH_EXT, EGL_DMA_BUF_PLANE2_MODIFIER_LO_EXT, EGL_DMA_BUF_PLANE2_MODIFIER_HI_EXT },
+		{ EGL_DMA_BUF_PLANE3_FD_EXT, EGL_DMA_BUF_PLANE3_OFFSET_EXT, EGL_DMA_BUF_PLANE3_PITCH_EXT, EGL_DMA_BUF_PLANE3_MODIFIER_LO_EXT, EGL_DMA_BUF_PLANE3_MODIFIER_HI_EXT }
+	};
+
+	const char* vertexShader =
+		"attribute vec2 position;\n"
+		"varying vec2 texCoord;\n"
+		"void main() {\n"
+		"	texCoord = position * 0.5 + 0.5;\n"
+		"	gl_Position = vec4(position, 0.0, 1.0);\n"
+		"}\n";
+
+	const char* fragmentShader =
+		"#extension GL_OES_EGL_image_external : require\n"
+		"precision mediump float;\n"
+		"uniform samplerExternalOES frame;\n"
+		"varying vec2 texCoord;\n"
+		"void main() {\n"
+		"	gl_FragColor = vec4(texture2D(frame, texCoord).rgb, 1.0);\n"
+		"}\n";
+
+	const GLfloat quad[] = { -1.0f, -1.0f, 1.0f, -1.0f, -1.0f, 1.0f, 1.0f, 1.0f };
+
+	bool hasExtension(const char* extensions, const char* name)
+	{
+		if (extensions == nullptr)
+			return false;
+
+		size_t len = strlen(name);
+		for (const char* pos = strstr(extensions, name); pos != nullptr; pos = strstr(pos + len, name))
+			if ((pos == extensions || pos[-1] == ' ') && (pos[len] == ' ' || pos[len] == '\0'))
+				return true;
+
+		return false;
+	}
+
+	GLuint compileShader(GLenum type, const char* source)
+	{
+		GLuint shader = glCreateShader(type);
+		GLint status = GL_FALSE;
+
+		glShaderSource(shader, 1, &source, nullptr);
+		glCompileShader(shader);
+		glGetShaderiv(shader, GL_COMPILE_STATUS, &status);
+
+		if (status != GL_TRUE)
+		{
+			char log[512] = {};
+			glGetShaderInfoLog(shader, sizeof(log) - 1, nullptr, log);
+			std::cout << "Pipewire: EGL shader compilation failed: " << log << std::endl;
+			glDeleteShader(shader);
+			return 0;
+		}
+
+		return shader;
+	}
+}
+
+PipewireEGL::PipewireEGL() :
+	_display(EGL_NO_DISPLAY),
+	_context(EGL_NO_CONTEXT),
+	_ready(false),
+	_hasModifiers(false),
+	_program(0),
+	_texture(0),
+	_targetTexture(0),
+	_fbo(0),
+	_targetWidth(0),
+	_targetHeight(0),
+	_eglCreateImageKHR(nullptr),
+	_eglDestroyImageKHR(nullptr),
+	_eglQueryDmaBufModifiersEXT(nullptr),
+	_glEGLImageTargetTexture2DOES(nullptr)
+{
+}
+
+PipewireEGL::~PipewireEGL()
+{
+	release();
+}
+
+bool PipewireEGL::isReady() const
+{
+	return _ready;
+}
+
+bool PipewireEGL::init()
+{
+	if (_ready)
+		return true;
+
+	const char* clientExtensions = eglQueryString(EGL_NO_DISPLAY, EGL_EXTENSIONS);
+	auto getPlatformDisplay = reinterpret_cast<PFNEGLGETPLATFORMDISPLAYEXTPROC>(eglGetProcAddress("eglGetPlatformDisplayEXT"));
+
+	if (getPlatformDisplay != nullptr && hasExtension(clientExtensions, "EGL_MESA_platform_surfaceless"))
+		_display = getPlatformDisplay(EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, nullptr);
+
+	if (_display == EGL_NO_DISPLAY)
+		_display = eglGetDisplay(EGL_DEFAULT_DISPLAY);
+
+	EGLint major = 0, minor = 0;
+	if (_display == EGL_NO_DISPLAY || !eglInitialize(_display, &major, &minor))
+	{
+		std::cout << "Pipewire: could not initialize EGL display. DMA-BUF import is disabled" << std::endl;
+		_display = EGL_NO_DISPLAY;
+		return false;
+	}
+
+	const char* extensions = eglQueryString(_display, EGL_EXTENSIONS);
+	if (!hasExtension(extensions, "EGL_EXT_image_dma_buf_import") || !hasExtension(extensions, "EGL_KHR_surfaceless_context"))
+	{
+		std::cout << "Pipewire: EGL " << major << "." << minor << " does not support DMA-BUF import. DMA-BUF import is disabled" << std::endl;
+		release();
+		return false;
+	}
+
+	_eglCreateImageKHR = reinterpret_cast<PFNEGLCREATEIMAGEKHRPROC>(eglGetProcAddress("eglCreateImageKHR"));
+	_eglDestroyImageKHR = reinterpret_cast<PFNEGLDESTROYIMAGEKHRPROC>(eglGetProcAddress("eglDestroyImageKHR"));
+	_glEGLImageTargetTexture2DOES = reinterpret_cast<PFNGLEGLIMAGETARGETTEXTURE2DOESPROC>(eglGetProcAddress("glEGLImageTargetTexture2DOES"));
+
+	if (hasExtension(extensions, "EGL_EXT_image_dma_buf_import_modifiers"))
+	{
+		_eglQueryDmaBufModifiersEXT = reinterpret_cast<PFNEGLQUERYDMABUFMODIFIERSEXTPROC>(eglGetProcAddress("eglQueryDmaBufModifiersEXT"));
+		_hasModifiers = (_eglQueryDmaBufModifiersEXT != nullptr);
+	}
+
+	if (_eglCreateImageKHR == nullptr || _eglDestroyImageKHR == nullptr || _glEGLImageTargetTexture2DOES == nullptr ||
+		!initContext() || !initProgram())
+	{
+		std::cout << "Pipewire: could not create EGL context. DMA-BUF import is disabled" << std::endl;
+		release();
+		return false;
+	}
+
+	std::cout << "Pipewire: EGL " << major << "." << minor << " DMA-BUF import is enabled (explicit modifiers: " << ((_hasModifiers) ? "yes" : "no") << ")" << std::endl;
+
+	_ready = true;
+	return true;
+}
+
+bool PipewireEGL::initContext()
+{
+	const EGLint configAttribs[] = {
+		EGL_RENDERABLE_TYPE, EGL_OPENGL_ES2_BIT,
+		EGL_NONE
+	};
+	const EGLint contextAttribs[] = {
+		EGL_CONTEXT_CLIENT_VERSION, 2,
+		EGL_NONE
+	};
+
+	EGLConfig config = nullptr;
+	EGLint configs = 0;
+
+	if (!eglBindAPI(EGL_OPENGL_ES_API) || !eglChooseConfig(_display, configAttribs, &config, 1, &configs) || configs < 1)
+		return false;
+
+	_context = eglCreateContext(_display, config, EGL_NO_CONTEXT, contextAttribs);
+	if (_context == EGL_NO_CONTEXT)
+		return false;
+
+	return eglMakeCurrent(_display, EGL_NO_SURFACE, EGL_NO_SURFACE, _context);
+}
+
+bool PipewireEGL::initProgram()
+{
+	GLuint vertex = compileShader(GL_VERTEX_SHADER, vertexShader);
+	GLuint fragment = compileShader(GL_FRAGMENT_SHADER, fragmentShader);
+	GLint status = GL_FALSE;
+
+	if (vertex == 0 || fragment == 0)
+	{
+		glDeleteShader(vertex);
+		glDeleteShader(fragment);
+		return false;
+	}
+
+	_program = glCreateProgram();
+	glAttachShader(_program, vertex);
+	glAttachShader(_program, fragment);
+	glBindAttribLocation(_program, 0, "position");
+	glLinkProgram(_program);
+	glDeleteShader(vertex);
+	glDeleteShader(fragment);
+	glGetProgramiv(_program, GL_LINK_STATUS, &status);
+
+	if (status != GL_TRUE)
+		return false;
+
+	glGenTextures(1, &_texture);
+	glBindTexture(GL_TEXTURE_EXTERNAL_OES, _texture);
+	glTexParameteri(GL_TEXTURE_EXTERNAL_OES, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_EXTERNAL_OES, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_EXTERNAL_OES, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_EXTERNAL_OES, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+
+	glGenFramebuffers(1, &_fbo);
+
+	return glGetError() == GL_NO_ERROR;
+}
+
+bool PipewireEGL::setTarget(int width, int height)
+{
+	if (_targetTexture != 0 && _targetWidth == width && _targetHeight == height)
+		return true;
+
+	if (_targetTexture != 0)
+		glDeleteTextures(1, &_targetTexture);
+
+	glGenTextures(1, &_targetTexture);
+	glBindTexture(GL_TEXTURE_2D, _targetTexture);
+	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+
+	glBindFramebuffer(GL_FRAMEBUFFER, _fbo);
+	glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, _targetTexture, 0);
+
+	_targetWidth = width;
+	_targetHeight = height;
+
+	if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+	{
+		glDeleteTextures(1, &_targetTexture);
+		_targetTexture = 0;
+		return false;
+	}
+
+	return true;
+}
+
+void PipewireEGL::release()
+{
+	if (_display != EGL_NO_DISPLAY)
+	{
+		if (_context != EGL_NO_CONTEXT)
+		{
+			eglMakeCurrent(_display, EGL_NO_SURFACE, EGL_NO_SURFACE, _context);
+
+			if (_targetTexture != 0)
+				glDeleteTextures(1, &_targetTexture);
+			if (_texture != 0)
+				glDeleteTextures(1, &_texture);
+			if (_fbo != 0)
+				glDeleteFramebuffers(1, &_fbo);
+			if (_program != 0)
+				glDeleteProgram(_program);
+
+			eglMakeCurrent(_display, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+			eglDestroyContext(_display, _context);
+		}
+
+		eglTerminate(_display);
+	}
+
+	_display = EGL_NO_DISPLAY;
+	_context = EGL_NO_CONTEXT;
+	_ready = false;
+	_hasModifiers = false;
+	_program = 0;
+	_texture = 0;
+	_targetTexture = 0;
+	_fbo = 0;
+	_targetWidth = 0;
+	_targetHeight = 0;
+}
+
+std::vector<uint64_t> PipewireEGL::getModifiers(uint32_t drmFormat)
+{
+	std::vector<uint64_t> modifiers;
+
+	if (!_ready)
+		return modifiers;
+
+	if (_hasModifiers)
+	{
+		EGLuint64KHR supported[PIPEWIRE_EGL_MAX_MODIFIERS];
+		EGLBoolean externalOnly[PIPEWIRE_EGL_MAX_MODIFIERS];
+		EGLint count = 0;
+
+		if (_eglQueryDmaBufModifiersEXT(_display, static_cast<EGLint>(drmFormat), PIPEWIRE_EGL_MAX_MODIFIERS, supported, externalOnly, &count))
+			for (EGLint i = 0; i < count; i++)
+				modifiers.push_back(supported[i]);
+	}
+
+	// the driver can always fall back to the implicit layout
+	modifiers.push_back(PIPEWIRE_DRM_FORMAT_MOD_INVALID);
+
+	return modifiers;
+}
+
+bool PipewireEGL::scaleFrame(const spa_buffer* buffer, int width, int height, uint32_t drmFormat, uint64_t modifier, int scale, std::vector<uint8_t>& output)
+{
+	if (!_ready || buffer == nullptr || buffer->n_datas < 1 || width <= 0 || height <= 0)
+		return false;
+
+	if (!eglMakeCurrent(_display, EGL_NO_SURFACE, EGL_NO_SURFACE, _context))
+		return false;
+
+	EGLint attribs[6 + PIPEWIRE_EGL_MAX_PLANES * 10 + 1];
+	int index = 0;
+
+	attribs[index++] = EGL_WIDTH;
+	attribs[index++] = width;
+	attribs[index++] = EGL_HEIGHT;
+	attribs[index++] = height;
+	attribs[index++] = EGL_LINUX_DRM_FOURCC_EXT;
+	attribs[index++] = static_cast<EGLint>(drmFormat);
+
+	for (uint32_t plane = 0; plane < buffer->n_datas && plane < PIPEWIRE_EGL_MAX_PLANES; plane++)
+	{
+		const spa_data& data = buffer->datas[plane];
+
+		attribs[index++] = planeAttribs[plane][0];
+		attribs[index++] = static_cast<EGLint>(data.fd);
+		attribs[index++] = planeAttribs[plane][1];
+		attribs[index++] = static_cast<EGLint>(data.chunk->offset);
+		attribs[index++] = planeAttribs[plane][2];
+		attribs[index++] = static_cast<EGLint>(data.chunk->stride);
+
+		if (modifier != PIPEWIRE_DRM_FORMAT_MOD_INVALID && _hasModifiers)
+		{
+			attribs[index++] = planeAttribs[plane][3];
+			attribs[index++] = static_cast<EGLint>(modifier & 0xffffffff);
+			attribs[index++] = planeAttribs[plane][4];
+			attribs[index++] = static_cast<EGLint>(modifier >> 32);
+		}
+	}
+	attribs[index] = EGL_NONE;
+
+	EGLImageKHR image = _eglCreateImageKHR(_display, EGL_NO_CONTEXT, EGL_LINUX_DMA_BUF_EXT, nullptr, attribs);
+	if (image == EGL_NO_IMAGE_KHR)
+	{
+		std::cout << "Pipewire: could not import DMA-BUF frame (EGL error: 0x" << std::hex << eglGetError() << std::dec << ")" << std::endl;
+		return false;
+	}
+
+	int targetWidth = std::max(width / std::max(scale, 1), 1);
+	int targetHeight = std::max(height / std::max(scale, 1), 1);
+	bool result = setTarget(targetWidth, targetHeight);
+
+	if (result)
+	{
+		glBindTexture(GL_TEXTURE_EXTERNAL_OES, _texture);
+		_glEGLImageTargetTexture2DOES(GL_TEXTURE_EXTERNAL_OES, static_cast<GLeglImageOES>(image));
+
+		glBindFramebuffer(GL_FRAMEBUFFER, _fbo);
+		glViewport(0, 0, targetWidth, targetHeight);
+		glUseProgram(_program);
+		glUniform1i(glGetUniformLocation(_program, "frame"), 0);
+		glActiveTexture(GL_TEXTURE0);
+		glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 0, quad);
+		glEnableVertexAttribArray(0);
+		glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
+
+		// the framebuffer rows are read bottom-up and the quad maps the first memory row to the bottom, so no flip is needed
+		output.resize(static_cast<size_t>(targetWidth) * targetHeight * 4);
+		glPixelStorei(GL_PACK_ALIGNMENT, 4);
+		glReadPixels(0, 0, targetWidth, targetHeight, GL_RGBA, GL_UNSIGNED_BYTE, output.data());
+
+		result = (glGetError() == GL_NO_ERROR);
+	}
+
+	_eglDestroyImageKHR(_display, image);
+
+	return result;
+}
@@ -0,0 +1,51 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+#include <GLES2/gl2.h>
+#include <GLES2/gl2ext.h>
+
+struct spa_buffer;
+
+///
+/// Imports PipeWire DMA-BUF frames as EGL images and downscales them on the GPU,
+/// so only the reduced RGBA frame is read back to the system memory.
+///
+class PipewireEGL
+{
+public:
+	PipewireEGL();
+	~PipewireEGL();
+
+	bool init();
+	void release();
+	bool isReady() const;
+
+	std::vector<uint64_t> getModifiers(uint32_t drmFormat);
+	bool scaleFrame(const spa_buffer* buffer, int width, int height, uint32_t drmFormat, uint64_t modifier, int scale, std::vector<uint8_t>& output);
+
+private:
+	bool initContext();
+	bool initProgram();
+	bool setTarget(int width, int height);
+
+	EGLDisplay	_display;
+	EGLContext	_context;
+	bool		_ready;
+	bool		_hasModifiers;
+
+	GLuint		_program;
+	GLuint		_texture;
+	GLuint		_targetTexture;
+	GLuint		_fbo;
+	int			_targetWidth;
+	int			_targetHeight;
+
+	PFNEGLCREATEIMAGEKHRPROC				_eglCreateImageKHR;
+	PFNEGLDESTROYIMAGEKHRPROC				_eglDestroyImageKHR;
+	PFNEGLQUERYDMABUFMODIFIERSEXTPROC		_eglQueryDmaBufModifiersEXT;
+	PFNGLEGLIMAGETARGETTEXTURE2DOESPROC		_glEGLImageTargetTexture2DOES;
+};
@@ -57,6 +57,7 @@ void (*_initPipewireDisplay)(const char* restorationToken) = nullptr;
 void (*_uninitPipewireDisplay)() = nullptr;
 PipewireImage (*_getFramePipewire)() = nullptr;
 void (*_releaseFramePipewire)() = nullptr;
+void (*_setTargetWidthPipewire)(int width) = nullptr;
 const char* (*_getPipewireToken)() = nullptr;
 
 PipewireGrabber::PipewireGrabber(const QString& device, const QString& configurationPath)
@@ -84,11 +85,12 @@ PipewireGrabber::PipewireGrabber(const QString& device, const QString& configura
 		_uninitPipewireDisplay = (void (*)()) dlsym(_library, "uniniPipewireDisplay");
 		_getFramePipewire = (PipewireImage (*)()) dlsym(_library, "getFramePipewire");
 		_releaseFramePipewire = (void (*)()) dlsym(_library, "releaseFramePipewire");
+		_setTargetWidthPipewire = (void (*)(int)) dlsym(_library, "setTargetWidthPipewire");
 	}
 	else
 		Warning(_log, "Could not load Pipewire proxy library. Error: %s", dlerror());
 
-	if (_library && (_getPipewireToken == nullptr || _hasPipewire == nullptr || _releaseFramePipewire == nullptr || _initPipewireDisplay == nullptr || _uninitPipewireDisplay == nullptr || _getFramePipewire == nullptr))
+	if (_library && (_getPipewireToken == nullptr || _hasPipewire == nullptr || _releaseFramePipewire == nullptr || _initPipewireDisplay == nullptr || _uninitPipewireDisplay == nullptr || _getFramePipewire == nullptr || _setTargetWidthPipewire == nullptr))
 	{
 		Error(_log, "Could not load Pipewire proxy library definition. Error: %s", dlerror());
 
@@ -321,6 +323,8 @@ void PipewireGrabber::grabFrame()
 	{
 		if (_initialized && _isActive)
 		{
+			_setTargetWidthPipewire(_width);
+
 			PipewireImage data = _getFramePipewire();
 
 			if (!_versionCheck)
@@ -365,11 +369,27 @@ void PipewireGrabber::grabFrame()
 				_actualWidth = data.width;
 				_actualHeight = data.height;
 
+				// the frame was already downscaled on the GPU: the cropping is given in the original pixels
+				int cropLeft = _cropLeft, cropRight = _cropRight, cropTop = _cropTop, cropBottom = _cropBottom;
+
+				if (data.scale > 1)
+				{
+					_cropLeft /= data.scale;
+					_cropRight /= data.scale;
+					_cropTop /= data.scale;
+					_cropBottom /= data.scale;
+				}
+
 				if (data.isOrderRgb)
 					processSystemFrameRGBA(data.data);
 				else
 					processSystemFrameBGRA(data.data);
 
+				_cropLeft = cropLeft;
+				_cropRight = cropRight;
+				_cropTop = cropTop;
+				_cropBottom = cropBottom;
+
 				_releaseFramePipewire();
 			}
 		}
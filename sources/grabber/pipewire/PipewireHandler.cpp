@@ -58,10 +58,15 @@
 #include <time.h>
 #include <cstring>
 #include <iostream>
+#include <algorithm>
 
 #include <grabber/smartPipewire.h>
 #include "PipewireHandler.h"
 
+#ifdef ENABLE_PIPEWIRE_EGL
+	#include "PipewireEGL.h"
+#endif
+
 // Pipewire screen grabber using Portal access interface
 
 Q_DECLARE_METATYPE(QList<PipewireHandler::PipewireStructure>);
@@ -77,13 +82,28 @@ const QString PORTAL_SESSION	 = QStringLiteral("org.freedesktop.portal.Session")
 const QString PORTAL_RESPONSE	 = QStringLiteral("Response");
 
 
+#define PIPEWIRE_FOURCC(a, b, c, d) (static_cast<uint32_t>(a) | (static_cast<uint32_t>(b) << 8) | (static_cast<uint32_t>(c) << 16) | (static_cast<uint32_t>(d) << 24))
+
+// supported SPA video formats and their DRM fourcc equivalents used for the DMA-BUF import
+const struct
+{
+	spa_video_format	spaFormat;
+	uint32_t			drmFormat;
+} SUPPORTED_FORMATS[] = {
+	{ SPA_VIDEO_FORMAT_BGRx, PIPEWIRE_FOURCC('X', 'R', '2', '4') },
+	{ SPA_VIDEO_FORMAT_BGRA, PIPEWIRE_FOURCC('A', 'R', '2', '4') },
+	{ SPA_VIDEO_FORMAT_RGBx, PIPEWIRE_FOURCC('X', 'B', '2', '4') },
+	{ SPA_VIDEO_FORMAT_RGBA, PIPEWIRE_FOURCC('A', 'B', '2', '4') }
+};
+
 const QString REQUEST_TEMPLATE = QStringLiteral("/org/freedesktop/portal/desktop/request/%1/%2");
 
 PipewireHandler::PipewireHandler() :	_sessionHandle(""), _restorationToken(""), _errorMessage(""), _portalStatus(false), _isError(false), _version(0), _streamNodeId(0),
 									_sender(""), _replySessionPath(""), _sourceReplyPath(""), _startReplyPath(""),
 									_pwMainThreadLoop(nullptr), _pwNewContext(nullptr), _pwContextConnection(nullptr), _pwStream(nullptr),
 									_backupFrame(nullptr), _workingFrame(nullptr),
-									_frameWidth(0),_frameHeight(0),_frameOrderRgb(false), _framePaused(false)
+									_frameWidth(0),_frameHeight(0),_frameOrderRgb(false), _framePaused(false),
+									_frameDmaBuf(false), _frameDrmFormat(0), _frameModifier(0), _targetWidth(0)
 {	
 	_pwStreamListener = {};
 	_pwCoreListener = {};
@@ -210,6 +230,14 @@ void PipewireHandler::closeSession()
 	_backupFrame = nullptr;
 	_workingFrame = nullptr;
 	_framePaused = false;
+	_frameDmaBuf = false;
+	_frameDrmFormat = 0;
+	_frameModifier = 0;
+	_scaledFrame.clear();
+
+#ifdef ENABLE_PIPEWIRE_EGL
+	_egl = nullptr;
+#endif
 
 	if (_version > 0)
 	{
@@ -578,9 +606,41 @@ void PipewireHandler::onParamsChanged(uint32_t id, const struct spa_pod* param)
 	_frameHeight = format.info.raw.size.height;
 	_frameOrderRgb = (format.info.raw.format == SPA_VIDEO_FORMAT_RGBx || format.info.raw.format == SPA_VIDEO_FORMAT_RGBA);
 
+	// the modifier property is present only if the producer selected one of our DMA-BUF formats
+	_frameDmaBuf = false;
+	_frameDrmFormat = 0;
+	_frameModifier = 0;
+
+#ifdef ENABLE_PIPEWIRE_EGL
+	if (_egl != nullptr && _egl->isReady() && spa_pod_find_prop(param, nullptr, SPA_FORMAT_VIDEO_modifier) != nullptr)
+	{
+		for (const auto& supported : SUPPORTED_FORMATS)
+			if (supported.spaFormat == format.info.raw.format)
+			{
+				_frameDmaBuf = true;
+				_frameDrmFormat = supported.drmFormat;
+				_frameModifier = format.info.raw.modifier;
+			}
+	}
+#endif
+
 	printf("Pipewire: video format = %d (%s)\n", format.info.raw.format, spa_debug_type_find_name(spa_type_video_format, format.info.raw.format));
 	printf("Pipewire: video size = %dx%d (RGB order = %s)\n", _frameWidth, _frameHeight, (_frameOrderRgb) ? "true" : "false");
-	printf("Pipewire: framerate = %d/%d\n", format.info.raw.framerate.num, format.info.raw.framerate.denom);	
+	printf("Pipewire: framerate = %d/%d\n", format.info.raw.framerate.num, format.info.raw.framerate.denom);
+	printf("Pipewire: DMA-BUF = %s (modifier = 0x%llx)\n", (_frameDmaBuf) ? "true" : "false", static_cast<unsigned long long>(_frameModifier));
+
+	uint8_t spaBuffer[1024];
+	auto spaBuilder = SPA_POD_BUILDER_INIT(spaBuffer, sizeof(spaBuffer));
+	int dataType = (_frameDmaBuf) ? (1 << SPA_DATA_DmaBuf) : ((1 << SPA_DATA_MemPtr) | (1 << SPA_DATA_MemFd));
+
+	const spa_pod* bufferParams[1];
+	bufferParams[0] = reinterpret_cast<spa_pod*> (spa_pod_builder_add_object(&spaBuilder,
+										   SPA_TYPE_OBJECT_ParamBuffers, SPA_PARAM_Buffers,
+										   SPA_PARAM_BUFFERS_dataType, SPA_POD_CHOICE_FLAGS_Int(dataType)));
+
+	pw_thread_loop_lock(_pwMainThreadLoop);
+	pw_stream_update_params(_pwStream, bufferParams, 1);
+	pw_thread_loop_unlock(_pwMainThreadLoop);
 };
 
 void PipewireHandler::onProcessFrame()
@@ -593,9 +653,13 @@ void PipewireHandler::onProcessFrame()
 		return;
 	}
 
-	if (newFrame->buffer->datas[0].data == nullptr)
+	// DMA-BUF frames stay in the GPU memory and are not mapped
+	bool isDmaBuf = (newFrame->buffer->datas[0].type == SPA_DATA_DmaBuf && newFrame->buffer->datas[0].fd >= 0);
+
+	if (newFrame->buffer->datas[0].data == nullptr && !isDmaBuf)
 	{
 		std::cout << "Pipewire: empty buffer" << std::endl;
+		pw_stream_queue_buffer(_pwStream, newFrame);
 		return;
 	}
 
@@ -636,14 +700,6 @@ pw_stream* PipewireHandler::createCapturingStream()
 		},
 	};
 
-	spa_rectangle pwScreenBoundsMin = SPA_RECTANGLE(1, 1);
-	spa_rectangle pwScreenBoundsDefault = SPA_RECTANGLE(320, 200);
-	spa_rectangle pwScreenBoundsMax = SPA_RECTANGLE(8192, 8192);
-
-	spa_fraction pwFramerateMin = SPA_FRACTION(0, 1);
-	spa_fraction pwFramerateDefault = SPA_FRACTION(25, 1);
-	spa_fraction pwFramerateMax = SPA_FRACTION(60, 1);
-
 	pw_properties* reuseProps = pw_properties_new_string("pipewire.client.reuse=1");
 	
 	pw_core_add_listener(_pwContextConnection, &_pwCoreListener, &pwCoreEvents, this);
@@ -652,26 +708,24 @@ pw_stream* PipewireHandler::createCapturingStream()
 
 	if (stream != nullptr)
 	{
-		const int spaBufferSize = 1024;
-		const spa_pod*	streamParams[1];
+		const int spaBufferSize = 16384;
+		const uint32_t maxParams = (sizeof(SUPPORTED_FORMATS) / sizeof(SUPPORTED_FORMATS[0])) + 1;
+		const spa_pod*	streamParams[maxParams];
+
+#ifdef ENABLE_PIPEWIRE_EGL
+		_egl = std::unique_ptr<PipewireEGL>(new PipewireEGL());
+		_egl->init();
+#endif
 
 		uint8_t* spaBuffer = static_cast<uint8_t*>(calloc(spaBufferSize, 1));
 
 		auto spaBuilder = SPA_POD_BUILDER_INIT(spaBuffer, spaBufferSize);
 
-		streamParams[0] = reinterpret_cast<spa_pod*> (spa_pod_builder_add_object(&spaBuilder,
-											   SPA_TYPE_OBJECT_Format, SPA_PARAM_EnumFormat,
-											   SPA_FORMAT_mediaType, SPA_POD_Id(SPA_MEDIA_TYPE_video),
-											   SPA_FORMAT_mediaSubtype, SPA_POD_Id(SPA_MEDIA_SUBTYPE_raw),
-											   SPA_FORMAT_VIDEO_format, SPA_POD_CHOICE_ENUM_Id(5,
-													  SPA_VIDEO_FORMAT_BGRx, SPA_VIDEO_FORMAT_BGRx, SPA_VIDEO_FORMAT_BGRA,
-													  SPA_VIDEO_FORMAT_RGBx, SPA_VIDEO_FORMAT_RGBA),
-											   SPA_FORMAT_VIDEO_size, SPA_POD_CHOICE_RANGE_Rectangle( &pwScreenBoundsDefault, &pwScreenBoundsMin, &pwScreenBoundsMax),
-											   SPA_FORMAT_VIDEO_framerate, SPA_POD_CHOICE_RANGE_Fraction( &pwFramerateDefault, &pwFramerateMin, &pwFramerateMax)));		
+		uint32_t paramsCount = buildFormats(&spaBuilder, streamParams, maxParams);
 
 		pw_stream_add_listener(stream, &_pwStreamListener, &pwStreamEvents, this);
 
-		if (pw_stream_connect(stream, PW_DIRECTION_INPUT, _streamNodeId, static_cast<pw_stream_flags>(PW_STREAM_FLAG_AUTOCONNECT | PW_STREAM_FLAG_MAP_BUFFERS), streamParams, 1) != 0)
+		if (pw_stream_connect(stream, PW_DIRECTION_INPUT, _streamNodeId, static_cast<pw_stream_flags>(PW_STREAM_FLAG_AUTOCONNECT | PW_STREAM_FLAG_MAP_BUFFERS), streamParams, paramsCount) != 0)
 		{
 			pw_stream_destroy(stream);
 			stream = nullptr;
@@ -683,12 +737,129 @@ pw_stream* PipewireHandler::createCapturingStream()
 	return stream;
 }
 
+uint32_t PipewireHandler::buildFormats(spa_pod_builder* builder, const spa_pod** params, uint32_t maxParams)
+{
+	spa_rectangle pwScreenBoundsMin = SPA_RECTANGLE(1, 1);
+	spa_rectangle pwScreenBoundsDefault = SPA_RECTANGLE(320, 200);
+	spa_rectangle pwScreenBoundsMax = SPA_RECTANGLE(8192, 8192);
+
+	spa_fraction pwFramerateMin = SPA_FRACTION(0, 1);
+	spa_fraction pwFramerateDefault = SPA_FRACTION(25, 1);
+	spa_fraction pwFramerateMax = SPA_FRACTION(60, 1);
+
+	uint32_t count = 0;
+
+#ifdef ENABLE_PIPEWIRE_EGL
+	// DMA-BUF formats go first so the producer prefers them: one entry per format with the modifiers that EGL can import
+	if (_egl != nullptr && _egl->isReady())
+	{
+		for (const auto& supported : SUPPORTED_FORMATS)
+		{
+			std::vector<uint64_t> modifiers = _egl->getModifiers(supported.drmFormat);
+
+			if (modifiers.empty() || count + 1 >= maxParams)
+				continue;
+
+			spa_pod_frame formatFrame, modifierFrame;
+
+			spa_pod_builder_push_object(builder, &formatFrame, SPA_TYPE_OBJECT_Format, SPA_PARAM_EnumFormat);
+			spa_pod_builder_add(builder,
+								SPA_FORMAT_mediaType, SPA_POD_Id(SPA_MEDIA_TYPE_video),
+								SPA_FORMAT_mediaSubtype, SPA_POD_Id(SPA_MEDIA_SUBTYPE_raw),
+								SPA_FORMAT_VIDEO_format, SPA_POD_Id(supported.spaFormat), 0);
+			spa_pod_builder_prop(builder, SPA_FORMAT_VIDEO_modifier, SPA_POD_PROP_FLAG_MANDATORY);
+			spa_pod_builder_push_choice(builder, &modifierFrame, SPA_CHOICE_Enum, 0);
+			spa_pod_builder_long(builder, static_cast<int64_t>(modifiers.front()));
+			for (uint64_t modifier : modifiers)
+				spa_pod_builder_long(builder, static_cast<int64_t>(modifier));
+			spa_pod_builder_pop(builder, &modifierFrame);
+			spa_pod_builder_add(builder,
+								SPA_FORMAT_VIDEO_size, SPA_POD_CHOICE_RANGE_Rectangle(&pwScreenBoundsDefault, &pwScreenBoundsMin, &pwScreenBoundsMax),
+								SPA_FORMAT_VIDEO_framerate, SPA_POD_CHOICE_RANGE_Fraction(&pwFramerateDefault, &pwFramerateMin, &pwFramerateMax), 0);
+
+			params[count++] = reinterpret_cast<spa_pod*>(spa_pod_builder_pop(builder, &formatFrame));
+		}
+	}
+#endif
+
+	params[count++] = reinterpret_cast<spa_pod*> (spa_pod_builder_add_object(builder,
+											   SPA_TYPE_OBJECT_Format, SPA_PARAM_EnumFormat,
+											   SPA_FORMAT_mediaType, SPA_POD_Id(SPA_MEDIA_TYPE_video),
+											   SPA_FORMAT_mediaSubtype, SPA_POD_Id(SPA_MEDIA_SUBTYPE_raw),
+											   SPA_FORMAT_VIDEO_format, SPA_POD_CHOICE_ENUM_Id(5,
+													  SPA_VIDEO_FORMAT_BGRx, SPA_VIDEO_FORMAT_BGRx, SPA_VIDEO_FORMAT_BGRA,
+													  SPA_VIDEO_FORMAT_RGBx, SPA_VIDEO_FORMAT_RGBA),
+											   SPA_FORMAT_VIDEO_size, SPA_POD_CHOICE_RANGE_Rectangle( &pwScreenBoundsDefault, &pwScreenBoundsMin, &pwScreenBoundsMax),
+											   SPA_FORMAT_VIDEO_framerate, SPA_POD_CHOICE_RANGE_Fraction( &pwFramerateDefault, &pwFramerateMin, &pwFramerateMax)));
+
+	return count;
+}
+
+void PipewireHandler::disableDmaBuf()
+{
+#ifdef ENABLE_PIPEWIRE_EGL
+	if (_egl == nullptr || _pwStream == nullptr)
+		return;
+
+	std::cout << "Pipewire: DMA-BUF import failed, renegotiating the stream to use the shared memory" << std::endl;
+
+	_egl->release();
+	_frameDmaBuf = false;
+
+	// only the shared memory format is left now that EGL is released
+	uint8_t spaBuffer[1024];
+	auto spaBuilder = SPA_POD_BUILDER_INIT(spaBuffer, sizeof(spaBuffer));
+	const spa_pod* streamParams[1];
+	uint32_t paramsCount = buildFormats(&spaBuilder, streamParams, 1);
+
+	pw_thread_loop_lock(_pwMainThreadLoop);
+	pw_stream_update_params(_pwStream, streamParams, paramsCount);
+	pw_thread_loop_unlock(_pwMainThreadLoop);
+#endif
+}
+
+void PipewireHandler::setTargetWidth(int width)
+{
+	_targetWidth = width;
+}
+
 void PipewireHandler::getImage(PipewireImage* image)
 {
 	image->version = getVersion();
 	image->isError = hasError();
 	image->data = nullptr;
-	if (_workingFrame == nullptr && _backupFrame != nullptr)
+	image->scale = 1;
+
+#ifdef ENABLE_PIPEWIRE_EGL
+	if (_workingFrame == nullptr && _backupFrame != nullptr && _frameDmaBuf)
+	{
+		// the largest integer reduction that still leaves the grabber with at least its target width
+		int scale = 1;
+		while (_targetWidth > 0 && _frameWidth / (scale + 1) >= _targetWidth)
+			scale++;
+
+		if (_egl->scaleFrame(_backupFrame->buffer, _frameWidth, _frameHeight, _frameDrmFormat, _frameModifier, scale, _scaledFrame))
+		{
+			_workingFrame = _backupFrame;
+			_backupFrame = nullptr;
+
+			image->width = std::max(_frameWidth / scale, 1);
+			image->height = std::max(_frameHeight / scale, 1);
+			image->isOrderRgb = true;
+			image->scale = scale;
+
+			image->data = _scaledFrame.data();
+		}
+		else
+		{
+			pw_stream_queue_buffer(_pwStream, _backupFrame);
+			_backupFrame = nullptr;
+			disableDmaBuf();
+		}
+	}
+	else
+#endif
+	if (_workingFrame == nullptr && _backupFrame != nullptr && !_frameDmaBuf)
 	{
 		if (static_cast<int>(_backupFrame->buffer->datas[0].chunk->size) == (_frameWidth * _frameHeight * 4))
 		{
@@ -6,8 +6,11 @@
 #include <spa/param/video/type-info.h>
 #include <spa/utils/hook.h>
 #include <spa/debug/types.h>
+#include <memory>
+#include <vector>
 
 struct PipewireImage;
+class PipewireEGL;
 
 class PipewireHandler : public QObject
 {
@@ -27,6 +30,7 @@ public:
 
 	void getImage(PipewireImage* image);
 	void releaseWorkingFrame();
+	void setTargetWidth(int width);
 
 	static int	readVersion();
 
@@ -58,6 +62,8 @@ private:
 	void reportError(const QString& input);
 
 	pw_stream*	createCapturingStream();
+	uint32_t	buildFormats(spa_pod_builder* builder, const spa_pod** params, uint32_t maxParams);
+	void		disableDmaBuf();
 	QString		getSessionToken();
 	QString		getRequestToken();
 
@@ -87,4 +93,14 @@ private:
 	int		_frameHeight;
 	bool	_frameOrderRgb;
 	bool	_framePaused;
+
+	bool		_frameDmaBuf;
+	uint32_t	_frameDrmFormat;
+	uint64_t	_frameModifier;
+	int			_targetWidth;
+	std::vector<uint8_t>	_scaledFrame;
+
+#ifdef ENABLE_PIPEWIRE_EGL
+	std::unique_ptr<PipewireEGL> _egl;
+#endif
 };
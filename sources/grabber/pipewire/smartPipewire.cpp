@@ -63,6 +63,12 @@ void releaseFramePipewire()
 	_pipewireHandler->releaseWorkingFrame();
 }
 
+void setTargetWidthPipewire(int width)
+{
+	if (_pipewireHandler != nullptr)
+		_pipewireHandler->setTargetWidth(width);
+}
+
 const char* getPipewireToken()
 {
 	static QByteArray tokenData;
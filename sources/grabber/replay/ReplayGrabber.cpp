@@ -0,0 +1,394 @@
+/* ReplayGrabber.cpp
+*
+*  MIT License
+*
+*  Copyright (c) 2023 awawa-dev
+*
+*  Project homesite: https://github.com/awawa-dev/HyperHDR
+*
+*  Permission is hereby granted, free of charge, to any person obtaining a copy
+*  of this software and associated documentation files (the "Software"), to deal
+*  in the Software without restriction, including without limitation the rights
+*  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+*  copies of the Software, and to permit persons to whom the Software is
+*  furnished to do so, subject to the following conditions:
+*
+*  The above copyright notice and this permission notice shall be included in all
+*  copies or substantial portions of the Software.
+
+*  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+*  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+*  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+*  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+*  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+*  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+*  SOFTWARE.
+*/
+
+
+#include <QFile>
+#include <QFileInfo>
+#include <QCoreApplication>
+
+#include <grabber/ReplayGrabber.h>
+#include <utils/FrameDecoder.h>
+#include <utils/FrameTrace.h>
+#include <utils/InternalClock.h>
+#include <utils/PreciseTimer.h>
+
+#if defined(ENABLE_V4L2) || defined(ENABLE_MF)
+	#include <turbojpeg.h>
+	#define REPLAY_TURBOJPEG
+#endif
+
+namespace
+{
+	bool isYuvFormat(PixelFormat format)
+	{
+		return format == PixelFormat::YUYV || format == PixelFormat::I420 || format == PixelFormat::NV12 ||
+			format == PixelFormat::MJPEG || format == PixelFormat::P010 || format == PixelFormat::Y210;
+	}
+
+	bool readHeader(QFile& file, QString& error)
+	{
+		CaptureRecording::Header header;
+
+		if (!file.open(QIODevice::ReadOnly))
+			error = QString("Could not open the recording: %1").arg(file.errorString());
+		else if (file.read(reinterpret_cast<char*>(&header), sizeof(header)) != sizeof(header) || !CaptureRecording::isValid(header))
+			error = QString("Not a HyperHDR capture recording: %1").arg(file.fileName());
+
+		return error.isEmpty();
+	}
+}
+
+ReplayThread::ReplayThread(ReplayGrabber* grabber, Logger* log, const QString& fileName, double speed, bool loop)
+	: _grabber(grabber)
+	, _log(log)
+	, _fileName(fileName)
+	, _speed(speed)
+	, _loop(loop)
+	, _slots(2)
+{
+}
+
+ReplayThread::~ReplayThread()
+{
+	stopReplay();
+}
+
+void ReplayThread::stopReplay()
+{
+	requestInterruption();
+	wait();
+}
+
+void ReplayThread::frameDone()
+{
+	_slots.release();
+}
+
+bool ReplayThread::waitUntil(int64_t due)
+{
+	// short sleeps, so a stop request is not delayed by a long pause of the recording
+	for (int64_t left = due - PreciseTimer::now(); left > 0 && !isInterruptionRequested(); left = due - PreciseTimer::now())
+		QThread::usleep(static_cast<unsigned long>(qMin<int64_t>(left / 1000, 20000)));
+
+	return !isInterruptionRequested();
+}
+
+void ReplayThread::run()
+{
+	QFile file(_fileName);
+	QString error;
+
+	if (!readHeader(file, error))
+	{
+		Error(_log, "%s", QSTRING_CSTR(error));
+		return;
+	}
+
+	std::vector<uint8_t> buffer;
+	quint64 sourceCount = 0;
+
+	for (int pass = 1; !isInterruptionRequested(); pass++)
+	{
+		const int64_t passStart = PreciseTimer::now();
+		qint64 frames = 0, failed = 0;
+		CaptureRecording::Record record;
+
+		file.seek(sizeof(CaptureRecording::Header));
+
+		while (!isInterruptionRequested() && file.read(reinterpret_cast<char*>(&record), sizeof(record)) == sizeof(record))
+		{
+			if (!CaptureRecording::isValid(record))
+			{
+				Error(_log, "Corrupted record %lld of the recording, the replay is stopped", static_cast<long long>(frames));
+				return;
+			}
+
+			buffer.resize(CaptureRecording::paddedSize(record.size));
+			if (file.read(reinterpret_cast<char*>(buffer.data()), buffer.size()) != static_cast<qint64>(buffer.size()))
+				break;
+
+			if (_speed > 0 && !waitUntil(passStart + static_cast<int64_t>(record.time / _speed)))
+				return;
+
+			// the grabber's thread must take the previous frames first
+			while (!_slots.tryAcquire(1, 100))
+				if (isInterruptionRequested())
+					return;
+
+			const int64_t dequeued = FrameTrace::now();
+			const qint64 frameBegin = InternalClock::nowPrecise();
+			Image<ColorRgb> image;
+
+			error = _grabber->decodeFrame(record, buffer.data(), image);
+
+			if (error.isEmpty())
+			{
+				image.setTimestamp(InternalClock::now());
+				image.setCaptureTrace(dequeued, FrameTrace::now());
+				emit newFrame(0, image, sourceCount++, frameBegin);
+			}
+			else
+			{
+				failed++;
+				emit newFrameError(0, error, sourceCount++);
+			}
+
+			frames++;
+		}
+
+		const double duration = (PreciseTimer::now() - passStart) / 1000000000.0;
+		Info(_log, "Replay pass %d: %lld frames (%lld failed) in %.2f s, %.1f fps",
+			pass, static_cast<long long>(frames), static_cast<long long>(failed), duration, (duration > 0) ? frames / duration : 0.0);
+
+		if (!_loop || frames == 0)
+			break;
+	}
+}
+
+ReplayGrabber::ReplayGrabber(const QString& fileName, double speed, bool loop, const QString& configurationPath)
+	: Grabber(configurationPath, "CAPTURE_REPLAY")
+	, _fileName(fileName)
+	, _speed(qMax(speed, 0.0))
+	, _loop(loop)
+	, _thread(nullptr)
+	, _lutYuv(false)
+	, _decompress(nullptr)
+{
+	_deviceName = Grabber::AUTO_SETTING;
+}
+
+ReplayGrabber::~ReplayGrabber()
+{
+	uninit();
+
+#ifdef REPLAY_TURBOJPEG
+	if (_decompress != nullptr)
+		tjDestroy(_decompress);
+#endif
+}
+
+bool ReplayGrabber::init()
+{
+	if (_initialized)
+		return true;
+
+	QFile file(_fileName);
+	QString error;
+	CaptureRecording::Record record;
+
+	if (!readHeader(file, error))
+	{
+		Error(_log, "%s", QSTRING_CSTR(error));
+		return false;
+	}
+
+	if (file.read(reinterpret_cast<char*>(&record), sizeof(record)) != sizeof(record) || !CaptureRecording::isValid(record))
+	{
+		Error(_log, "The recording is empty: %s", QSTRING_CSTR(_fileName));
+		return false;
+	}
+
+	_actualVideoFormat = static_cast<PixelFormat>(record.pixelFormat);
+	_actualWidth = record.width;
+	_actualHeight = record.height;
+	_actualFPS = 0;
+	_actualDeviceName = "Replay:" + QFileInfo(_fileName).fileName();
+	_lineLength = record.lineLength;
+	_frameByteSize = record.size;
+
+	Info(_log, "Replaying %s (%s %dx%d) %s%s", QSTRING_CSTR(_fileName), QSTRING_CSTR(pixelFormatToString(_actualVideoFormat)),
+		_actualWidth, _actualHeight, (_speed > 0) ? QSTRING_CSTR(QString("at %1 x speed").arg(_speed)) : "as fast as possible",
+		(_loop) ? ", looped" : "");
+
+	loadLutFile(isYuvFormat(_actualVideoFormat) ? PixelFormat::YUYV : PixelFormat::RGB24);
+
+	resetCounter(InternalClock::now());
+
+	_thread = new ReplayThread(this, _log, _fileName, _speed, _loop);
+	connect(_thread, &ReplayThread::newFrame, this, &ReplayGrabber::newWorkerFrame, Qt::QueuedConnection);
+	connect(_thread, &ReplayThread::newFrameError, this, &ReplayGrabber::newWorkerFrameError, Qt::QueuedConnection);
+
+	_initialized = true;
+	return true;
+}
+
+void ReplayGrabber::uninit()
+{
+	if (_thread != nullptr)
+	{
+		_thread->stopReplay();
+		delete _thread;
+		_thread = nullptr;
+	}
+
+	_initialized = false;
+}
+
+bool ReplayGrabber::start()
+{
+	if (!_initialized && !init())
+		return false;
+
+	if (!_thread->isRunning())
+		_thread->start();
+
+	return true;
+}
+
+void ReplayGrabber::stop()
+{
+	uninit();
+}
+
+void ReplayGrabber::loadLutFile(PixelFormat color)
+{
+	QString fileName1 = QString("%1%2").arg(_configurationPath).arg("/lut_lin_tables.3d");
+	QString fileName2 = QString("%1%2").arg(QCoreApplication::applicationDirPath()).arg("/../lut/lut_lin_tables.3d");
+	QString fileName3 = QString("/usr/share/hyperhdr/lut/lut_lin_tables.3d");
+
+	Grabber::loadLutFile(color, QList<QString>{fileName1, fileName2, fileName3});
+	_lutYuv = (color == PixelFormat::YUYV);
+}
+
+void ReplayGrabber::setHdrToneMappingEnabled(int mode)
+{
+	if (_hdrToneMappingEnabled != mode || !_lutBufferInit)
+	{
+		QMutexLocker locker(&_decodeLock);
+
+		_hdrToneMappingEnabled = mode;
+		Debug(_log, "setHdrToneMappingMode to: %s", (mode == 0) ? "Disabled" : ((mode == 1) ? "Fullscreen" : "Border mode"));
+
+		if (_initialized)
+			loadLutFile(_lutYuv ? PixelFormat::YUYV : PixelFormat::RGB24);
+	}
+}
+
+QString ReplayGrabber::decodeFrame(const CaptureRecording::Record& record, const uint8_t* data, Image<ColorRgb>& image)
+{
+	const PixelFormat format = static_cast<PixelFormat>(record.pixelFormat);
+
+	QMutexLocker locker(&_decodeLock);
+
+	// the recording may switch the video mode
+	if (isYuvFormat(format) != _lutYuv)
+		loadLutFile(isYuvFormat(format) ? PixelFormat::YUYV : PixelFormat::RGB24);
+
+	const uint8_t* lutBuffer = (_lutBufferInit) ? _lutBuffer : nullptr;
+	const CompactLut* compactLut = (_lutBufferInit && _compactLut.isValid()) ? &_compactLut : nullptr;
+
+	if (format == PixelFormat::MJPEG)
+	{
+#ifdef REPLAY_TURBOJPEG
+		int width = 0, height = 0, subsamp = 0;
+
+		if (_decompress == nullptr)
+			_decompress = tjInitDecompress();
+
+		if (tjDecompressHeader2(_decompress, const_cast<uint8_t*>(data), record.size, &width, &height, &subsamp) != 0 &&
+			tjGetErrorCode(_decompress) == TJERR_FATAL)
+			return QString(tjGetErrorStr());
+
+		if (_hdrToneMappingEnabled > 0)
+		{
+			if (subsamp != TJSAMP_422 && subsamp != TJSAMP_420)
+				return QString("%1: %2").arg(UNSUPPORTED_DECODER).arg(subsamp);
+
+			_jpegBuffer.resize(tjBufSizeYUV2(width, 2, height, subsamp));
+			if (tjDecompressToYUV2(_decompress, const_cast<uint8_t*>(data), record.size, _jpegBuffer.data(), width, 2, height, TJFLAG_FASTDCT | TJFLAG_FASTUPSAMPLE) != 0 &&
+				tjGetErrorCode(_decompress) == TJERR_FATAL)
+				return QString(tjGetErrorStr());
+
+			FrameDecoder::processImage(_cropLeft, _cropRight, _cropTop, _cropBottom, _jpegBuffer.data(), width, height, width,
+				(subsamp == TJSAMP_422) ? PixelFormat::MJPEG : PixelFormat::I420, lutBuffer, image, compactLut);
+		}
+		else
+		{
+			_jpegBuffer.resize(static_cast<size_t>(width) * height * 3);
+			if (tjDecompress2(_decompress, const_cast<uint8_t*>(data), record.size, _jpegBuffer.data(), width, 0, height, TJPF_RGB, TJFLAG_FASTDCT | TJFLAG_FASTUPSAMPLE) != 0 &&
+				tjGetErrorCode(_decompress) == TJERR_FATAL)
+				return QString(tjGetErrorStr());
+
+			FrameDecoder::processImage(_cropLeft, _cropRight, _cropTop, _cropBottom, _jpegBuffer.data(), width, height, width * 3,
+				PixelFormat::RGB24, nullptr, image);
+		}
+#else
+		return QString("MJPEG recordings need a build with turbojpeg");
+#endif
+	}
+	else
+	{
+		// the size of the frame is checked like the grabbers do for the live buffers
+		const size_t lines = (format == PixelFormat::I420 || format == PixelFormat::NV12 || format == PixelFormat::P010) ? (record.height * 3) / 2 : record.height;
+		if (static_cast<size_t>(record.lineLength) * lines > record.size)
+			return QString("Frame too small: %1 < %2").arg(record.size).arg(static_cast<size_t>(record.lineLength) * lines);
+
+		FrameDecoder::processImage(_cropLeft, _cropRight, _cropTop, _cropBottom, data, record.width, record.height, record.lineLength,
+			format, lutBuffer, image, compactLut);
+	}
+
+	if (image.width() == 0 || image.height() == 0)
+		return QString("Could not decode the %1 frame").arg(pixelFormatToString(format));
+
+	return QString();
+}
+
+void ReplayGrabber::newWorkerFrame(unsigned int workerIndex, Image<ColorRgb> image, quint64 sourceCount, qint64 _frameBegin)
+{
+	Q_UNUSED(workerIndex);
+	Q_UNUSED(sourceCount);
+
+	if (_thread != nullptr)
+		_thread->frameDone();
+
+	frameStat.goodFrame++;
+	frameStat.averageFrame += InternalClock::nowPrecise() - _frameBegin;
+
+	if (_signalAutoDetectionEnabled || isCalibrating())
+	{
+		if (checkSignalDetectionAutomatic(image))
+			emit newFrame(image);
+	}
+	else if (_signalDetectionEnabled)
+	{
+		if (checkSignalDetectionManual(image))
+			emit newFrame(image);
+	}
+	else
+		emit newFrame(image);
+}
+
+void ReplayGrabber::newWorkerFrameError(unsigned int workerIndex, QString error, quint64 sourceCount)
+{
+	Q_UNUSED(workerIndex);
+
+	if (_thread != nullptr)
+		_thread->frameDone();
+
+	frameStat.badFrame++;
+	ErrorThrottled(_log, "Could not decode the recorded frame %llu: %s", static_cast<unsigned long long>(sourceCount), QSTRING_CSTR(error));
+}
@@ -0,0 +1,11 @@
+#include <QMetaType>
+#include <grabber/ReplayWrapper.h>
+
+ReplayWrapper::ReplayWrapper(const QString& fileName, double speed, bool loop, const QString& configurationPath)
+	: GrabberWrapper("CAPTURE_REPLAY", &_grabber)
+	, _grabber(fileName, speed, loop, configurationPath)
+{
+	qRegisterMetaType<Image<ColorRgb>>("Image<ColorRgb>");
+	connect(&_grabber, &ReplayGrabber::newFrame, this, &GrabberWrapper::newFrame, Qt::DirectConnection);
+	connect(&_grabber, &ReplayGrabber::readError, this, &GrabberWrapper::readError, Qt::DirectConnection);
+}
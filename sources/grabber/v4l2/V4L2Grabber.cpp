@@ -38,9 +38,15 @@
 #include <sys/stat.h>
 #include <sys/types.h>
 #include <sys/time.h>
+#include <time.h>
 #include <sys/mman.h>
 #include <sys/ioctl.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <pthread.h>
+#include <sched.h>
 #include <linux/videodev2.h>
+#include <linux/dma-buf.h>
 #include <limits.h>
 
 #include <base/HyperHdrInstance.h>
@@ -51,6 +57,8 @@
 
 #include <grabber/V4L2Grabber.h>
 #include <utils/ColorSys.h>
+#include <utils/ThreadPolicy.h>
+#include <utils/EventTracer.h>
 
 #define CLEAR(x) memset(&(x), 0, sizeof(x))
 
@@ -58,6 +66,38 @@
 	#define V4L2_CAP_META_CAPTURE 0x00800000 // Specified in kernel header v4.16. Required for backward compatibility.
 #endif
 
+#if defined(__has_include)
+	#if __has_include(<linux/dma-heap.h>)
+		#include <linux/dma-heap.h>
+	#endif
+#endif
+
+#ifndef DMA_HEAP_IOCTL_ALLOC
+	// Specified in kernel header v5.6. Required for backward compatibility.
+	struct dma_heap_allocation_data
+	{
+		__u64 len;
+		__u32 fd;
+		__u32 fd_flags;
+		__u64 heap_flags;
+	};
+	#define DMA_HEAP_IOCTL_ALLOC _IOWR('H', 0x0, struct dma_heap_allocation_data)
+#endif
+
+// the contiguous heap is preferred: hardware decoders without IOMMU can import only such buffers
+const char* dmaHeaps[] = { "/dev/dma_heap/linux,cma", "/dev/dma_heap/reserved", "/dev/dma_heap/system" };
+
+#ifndef V4L2_PIX_FMT_P010
+	#define V4L2_PIX_FMT_P010 v4l2_fourcc('P', '0', '1', '0') // Specified in kernel header v5.12. Required for backward compatibility.
+#endif
+
+#ifndef V4L2_PIX_FMT_Y210
+	#define V4L2_PIX_FMT_Y210 v4l2_fourcc('Y', '2', '1', '0') // Specified in kernel header v5.11. Required for backward compatibility.
+#endif
+
+// SCHED_FIFO priority of the dedicated capture thread: above the normal threads, below the kernel's IRQ threads (50)
+#define V4L2_CAPTURE_REALTIME_PRIORITY 10
+
 // some stuff for HDR tone mapping
 #define LUT_FILE_SIZE 50331648
 
@@ -68,16 +108,40 @@ const V4L2Grabber::HyperHdrFormat supportedFormats[] =
 	{ V4L2_PIX_FMT_RGB24,  PixelFormat::RGB24 },
 	{ V4L2_PIX_FMT_YUV420, PixelFormat::I420 },
 	{ V4L2_PIX_FMT_NV12,   PixelFormat::NV12 },
-	{ V4L2_PIX_FMT_MJPEG,  PixelFormat::MJPEG }
+	{ V4L2_PIX_FMT_MJPEG,  PixelFormat::MJPEG },
+	{ V4L2_PIX_FMT_P010,   PixelFormat::P010 },
+	{ V4L2_PIX_FMT_Y210,   PixelFormat::Y210 }
 };
 
+// the driver's timestamp of the first captured byte translated to InternalClock::now(), the arrival time if it isn't usable
+static int64_t captureTime(const v4l2_buffer& buf)
+{
+	int64_t now = InternalClock::now();
+	timespec monotonic;
+
+	if ((buf.flags & V4L2_BUF_FLAG_TIMESTAMP_MASK) == V4L2_BUF_FLAG_TIMESTAMP_MONOTONIC &&
+		(buf.timestamp.tv_sec != 0 || buf.timestamp.tv_usec != 0) &&
+		clock_gettime(CLOCK_MONOTONIC, &monotonic) == 0)
+	{
+		int64_t age = (static_cast<int64_t>(monotonic.tv_sec) - buf.timestamp.tv_sec) * 1000 +
+			(static_cast<int64_t>(monotonic.tv_nsec / 1000) - buf.timestamp.tv_usec) / 1000;
+
+		if (age >= 0 && age < 1000)
+			return now - age;
+	}
+
+	return now;
+}
+
 
 V4L2Grabber::V4L2Grabber(const QString& device, const QString& configurationPath)
 	: Grabber(configurationPath, "V4L2:" + device.left(14))
 	, _fileDescriptor(-1)
 	, _buffers()
+	, _memoryType(V4L2_MEMORY_MMAP)
 	, _streamNotifier(nullptr)
-
+	, _captureThread(nullptr)
+	, _appliedProcessing(0)
 {
 	// Refresh devices
 	getV4L2devices();
@@ -117,24 +181,29 @@ void V4L2Grabber::loadLutFile(PixelFormat color)
 
 void V4L2Grabber::setHdrToneMappingEnabled(int mode)
 {
-	if (_hdrToneMappingEnabled != mode || _lutBuffer == NULL)
+	if (_hdrToneMappingEnabled != mode || !_lutBufferInit)
 	{
 		_hdrToneMappingEnabled = mode;
-		if (_lutBuffer != NULL || !mode)
+		if (_lutBufferInit || !mode)
 			Debug(_log, "setHdrToneMappingMode to: %s", (mode == 0) ? "Disabled" : ((mode == 1) ? "Fullscreen" : "Border mode"));
 		else
 			Warning(_log, "setHdrToneMappingMode to: enable, but the LUT file is currently unloaded");
 
 		if (_V4L2WorkerManager.isActive())
 		{
-			Debug(_log, "setHdrToneMappingMode replacing LUT and restarting");
-			_V4L2WorkerManager.Stop();
-			if ((_actualVideoFormat == PixelFormat::YUYV) || (_actualVideoFormat == PixelFormat::I420) || (_actualVideoFormat == PixelFormat::NV12) || (_actualVideoFormat == PixelFormat::MJPEG))
+			QMutexLocker locker(&_captureLock);
+
+			// the workers keep decoding with the previous table, the next frame gets the new one
+			Debug(_log, "setHdrToneMappingMode replacing LUT");
+			if ((_actualVideoFormat == PixelFormat::YUYV) || (_actualVideoFormat == PixelFormat::I420) || (_actualVideoFormat == PixelFormat::NV12) || (_actualVideoFormat == PixelFormat::MJPEG) ||
+				(_actualVideoFormat == PixelFormat::P010) || (_actualVideoFormat == PixelFormat::Y210))
 				loadLutFile(PixelFormat::YUYV);
 			else
 				loadLutFile(PixelFormat::RGB24);
-			_V4L2WorkerManager.Start();
 		}
+
+		// the mode follows the table to the next frame, the stream keeps running
+		publishProcessing();
 	}
 	else
 		Debug(_log, "setHdrToneMappingMode nothing changed: %s", (mode == 0) ? "Disabled" : ((mode == 1) ? "Fullscreen" : "Border mode"));
@@ -282,6 +351,7 @@ bool V4L2Grabber::init()
 				if (init_device(foundDevice, dev.valid[foundIndex]))
 				{
 					_initialized = true;
+					selectPixelFormat();
 				}
 			}
 			catch (std::exception& e)
@@ -576,6 +646,7 @@ bool V4L2Grabber::start()
 	try
 	{
 		resetCounter(InternalClock::now());
+		_V4L2WorkerManager.resetOrder();
 		_V4L2WorkerManager.Start();
 
 		if (_V4L2WorkerManager.workersCount <= 1)
@@ -583,11 +654,23 @@ bool V4L2Grabber::start()
 		else
 			Info(_log, "Multithreading for V4L2 is enabled. Available thread's count %d", _V4L2WorkerManager.workersCount);
 
-		if (init() && _streamNotifier != nullptr && !_streamNotifier->isEnabled())
+		Info(_log, "YUV decoder is using %s kernels", FrameDecoder::getSimdKernelName());
+
+		if (init() && _streamNotifier != nullptr && !_streamNotifier->isEnabled() && _captureThread == nullptr)
 		{
-			_streamNotifier->setEnabled(true);
-			start_capturing();
-			Info(_log, "Started");
+			if (_dedicatedCapture)
+			{
+				start_capturing();
+				_captureThread = new V4L2CaptureThread(this, _log, _fileDescriptor, _realtimeCapture);
+				_captureThread->start();
+				Info(_log, "Started (dedicated capture thread)");
+			}
+			else
+			{
+				_streamNotifier->setEnabled(true);
+				start_capturing();
+				Info(_log, "Started");
+			}
 			return true;
 		}
 	}
@@ -601,12 +684,21 @@ bool V4L2Grabber::start()
 
 void V4L2Grabber::stop()
 {
-	if (_streamNotifier != nullptr && _streamNotifier->isEnabled())
+	if (_captureThread != nullptr || (_streamNotifier != nullptr && _streamNotifier->isEnabled()))
 	{
+		if (_captureThread != nullptr)
+		{
+			_captureThread->stopCapture();
+			delete _captureThread;
+			_captureThread = nullptr;
+		}
+
 		_V4L2WorkerManager.Stop();
+		_V4L2WorkerManager.frameRing.clear();
 
 		stop_capturing();
-		_streamNotifier->setEnabled(false);
+		if (_streamNotifier != nullptr)
+			_streamNotifier->setEnabled(false);
 		uninit_device();
 		close_device();
 		_initialized = false;
@@ -628,39 +720,88 @@ void V4L2Grabber::close_device()
 	_streamNotifier = nullptr;
 }
 
-bool V4L2Grabber::init_mmap()
+bool V4L2Grabber::request_buffers(uint32_t memory, uint32_t& count)
 {
 	struct v4l2_requestbuffers req;
 
 	CLEAR(req);
 
-	req.count = 4;
+	req.count = count;
 	req.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
-	req.memory = V4L2_MEMORY_MMAP;
+	req.memory = memory;
 
 	if (xioctl(VIDIOC_REQBUFS, &req) == -1)
 	{
-		if (EINVAL == errno)
+		if (EINVAL != errno)
+			throw_errno_exception("VIDIOC_REQBUFS");
+
+		return false;
+	}
+
+	count = req.count;
+	_memoryType = memory;
+
+	return true;
+}
+
+bool V4L2Grabber::init_buffers()
+{
+	struct v4l2_format fmt;
+
+	CLEAR(fmt);
+	fmt.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+
+	size_t bufferSize = (xioctl(VIDIOC_G_FMT, &fmt) == 0) ? fmt.fmt.pix.sizeimage : 0;
+
+	if (_streamingIo == "userptr")
+	{
+		if (bufferSize > 0 && init_userptr(bufferSize))
 		{
-			throw_exception("'" + _deviceName + "' does not support memory mapping");
-			return false;
+			_streamingIoInUse = "userptr";
+			return true;
 		}
-		else
+
+		Warning(_log, "'%s' does not support user pointer streaming. Falling back to memory mapping", QSTRING_CSTR(_deviceName));
+	}
+	else if (_streamingIo == "dmabuf")
+	{
+		if (bufferSize > 0 && init_dmabuf(bufferSize))
 		{
-			throw_errno_exception("VIDIOC_REQBUFS");
-			return false;
+			_streamingIoInUse = "dmabuf (imported)";
+			return true;
 		}
+
+		Warning(_log, "Could not import DMA-BUF buffers to '%s'. Exporting the memory mapped buffers instead", QSTRING_CSTR(_deviceName));
+	}
+
+	if (!init_mmap(_streamingIo == "dmabuf"))
+		return false;
+
+	bool exported = (!_buffers.empty() && _buffers[0].dmabufFd >= 0);
+	_streamingIoInUse = (exported) ? "dmabuf (exported)" : "mmap";
+
+	return true;
+}
+
+bool V4L2Grabber::init_mmap(bool exportDmaBuf)
+{
+	uint32_t count = 4;
+
+	if (!request_buffers(V4L2_MEMORY_MMAP, count))
+	{
+		throw_exception("'" + _deviceName + "' does not support memory mapping");
+		return false;
 	}
 
-	if (req.count < 2)
+	if (count < 2)
 	{
 		throw_exception("Insufficient buffer memory on " + _deviceName);
 		return false;
 	}
 
-	_buffers.resize(req.count);
+	_buffers.resize(count);
 
-	for (size_t n_buffers = 0; n_buffers < req.count; ++n_buffers)
+	for (size_t n_buffers = 0; n_buffers < count; ++n_buffers)
 	{
 		struct v4l2_buffer buf;
 
@@ -676,8 +817,7 @@ bool V4L2Grabber::init_mmap()
 			return false;
 		}
 
-		_buffers[n_buffers].length = buf.length;
-		_buffers[n_buffers].start = mmap(
+		void* mapped = mmap(
 			NULL,
 			buf.length,
 			PROT_READ | PROT_WRITE,
@@ -686,16 +826,157 @@ bool V4L2Grabber::init_mmap()
 			buf.m.offset
 		);
 
-		if (MAP_FAILED == _buffers[n_buffers].start)
+		if (MAP_FAILED == mapped)
 		{
 			throw_errno_exception("mmap");
 			return false;
 		}
+
+		_buffers[n_buffers].start = mapped;
+		_buffers[n_buffers].length = buf.length;
+
+		if (exportDmaBuf)
+		{
+			struct v4l2_exportbuffer expbuf;
+
+			CLEAR(expbuf);
+			expbuf.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+			expbuf.index = n_buffers;
+			expbuf.flags = O_RDONLY | O_CLOEXEC;
+
+			if (xioctl(VIDIOC_EXPBUF, &expbuf) == 0)
+				_buffers[n_buffers].dmabufFd = expbuf.fd;
+			else
+				Warning(_log, "VIDIOC_EXPBUF failed for buffer %i: %s", (int)n_buffers, strerror(errno));
+		}
+	}
+
+	return true;
+}
+
+bool V4L2Grabber::init_userptr(size_t bufferSize)
+{
+	uint32_t count = 4;
+	const size_t pageSize = sysconf(_SC_PAGESIZE);
+
+	if (!request_buffers(V4L2_MEMORY_USERPTR, count) || count < 2)
+		return false;
+
+	// page aligned: some drivers DMA directly into the user memory
+	bufferSize = ((bufferSize + pageSize - 1) / pageSize) * pageSize;
+
+	_buffers.resize(count);
+
+	for (size_t n_buffers = 0; n_buffers < count; ++n_buffers)
+	{
+		void* memory = nullptr;
+
+		if (posix_memalign(&memory, pageSize, bufferSize) != 0)
+		{
+			uninit_device();
+			return false;
+		}
+
+		_buffers[n_buffers].start = memory;
+		_buffers[n_buffers].length = bufferSize;
+	}
+
+	return true;
+}
+
+bool V4L2Grabber::init_dmabuf(size_t bufferSize)
+{
+	int heapFd = -1;
+
+	for (const char* heap : dmaHeaps)
+		if ((heapFd = open(heap, O_RDWR | O_CLOEXEC)) >= 0)
+		{
+			Debug(_log, "Using DMA heap: %s", heap);
+			break;
+		}
+
+	if (heapFd < 0)
+		return false;
+
+	uint32_t count = 4;
+
+	if (!request_buffers(V4L2_MEMORY_DMABUF, count) || count < 2)
+	{
+		close(heapFd);
+		return false;
+	}
+
+	_buffers.resize(count);
+
+	for (size_t n_buffers = 0; n_buffers < count; ++n_buffers)
+	{
+		struct dma_heap_allocation_data alloc;
+
+		CLEAR(alloc);
+		alloc.len = bufferSize;
+		alloc.fd_flags = O_RDWR | O_CLOEXEC;
+
+		void* mapped = MAP_FAILED;
+
+		if (xioctl(heapFd, DMA_HEAP_IOCTL_ALLOC, &alloc) == 0)
+		{
+			_buffers[n_buffers].dmabufFd = (int)alloc.fd;
+			mapped = mmap(NULL, bufferSize, PROT_READ | PROT_WRITE, MAP_SHARED, _buffers[n_buffers].dmabufFd, 0);
+		}
+
+		if (mapped == MAP_FAILED)
+		{
+			Warning(_log, "Could not allocate a DMA-BUF buffer: %s", strerror(errno));
+			close(heapFd);
+			uninit_device();
+			return false;
+		}
+
+		_buffers[n_buffers].start = mapped;
+		_buffers[n_buffers].length = bufferSize;
 	}
 
+	close(heapFd);
+
 	return true;
 }
 
+void V4L2Grabber::sync_dmabuf(const v4l2_buffer* buf, bool start)
+{
+	if (_memoryType != V4L2_MEMORY_DMABUF || buf->index >= _buffers.size())
+		return;
+
+	// make the data written by the device visible to the CPU (start) and hand the buffer back (end)
+	struct dma_buf_sync sync;
+
+	sync.flags = ((start) ? DMA_BUF_SYNC_START : DMA_BUF_SYNC_END) | DMA_BUF_SYNC_READ;
+	xioctl(_buffers[buf->index].dmabufFd, DMA_BUF_IOCTL_SYNC, &sync);
+}
+
+int V4L2Grabber::queue_buffer(unsigned int index)
+{
+	struct v4l2_buffer buf;
+
+	CLEAR(buf);
+	buf.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+	buf.memory = _memoryType;
+	buf.index = index;
+
+	if (_memoryType == V4L2_MEMORY_USERPTR)
+	{
+		buf.m.userptr = reinterpret_cast<unsigned long>(_buffers[index].start);
+		buf.length = _buffers[index].length;
+	}
+	else if (_memoryType == V4L2_MEMORY_DMABUF)
+	{
+		buf.m.fd = _buffers[index].dmabufFd;
+		buf.length = _buffers[index].length;
+	}
+
+	sync_dmabuf(&buf, false);
+
+	return xioctl(VIDIOC_QBUF, &buf);
+}
 
 bool V4L2Grabber::getControl(int _fd, __u32 controlId, long& minVal, long& maxVal, long& defVal)
 {
@@ -745,6 +1026,73 @@ bool V4L2Grabber::setControl(__u32 controlId, __s32 newValue)
 		return true;
 }
 
+bool V4L2Grabber::setVideoControls(const DeviceProperties& device)
+{
+	bool result = true;
+
+	if (device.brightness.enabled)
+	{
+		long selVal = (_brightness != 0) ? _brightness : device.brightness.defVal;
+
+		if (setControl(V4L2_CID_BRIGHTNESS, selVal))
+			Info(_log, "Brightness set to: %i (%s)", selVal, (selVal == device.brightness.defVal) ? "default" : "user");
+		else
+		{
+			Error(_log, "Could not set brightness to: %i", selVal);
+			result = false;
+		}
+	}
+
+	if (device.contrast.enabled)
+	{
+		long selVal = (_contrast != 0) ? _contrast : device.contrast.defVal;
+
+		if (setControl(V4L2_CID_CONTRAST, selVal))
+			Info(_log, "Contrast set to: %i (%s)", selVal, (selVal == device.contrast.defVal) ? "default" : "user");
+		else
+		{
+			Error(_log, "Could not set contrast to: %i", selVal);
+			result = false;
+		}
+	}
+
+	if (device.saturation.enabled)
+	{
+		long selVal = (_saturation != 0) ? _saturation : device.saturation.defVal;
+
+		if (setControl(V4L2_CID_SATURATION, selVal))
+			Info(_log, "Saturation set to: %i (%s)", selVal, (selVal == device.saturation.defVal) ? "default" : "user");
+		else
+		{
+			Error(_log, "Could not set saturation to: %i", selVal);
+			result = false;
+		}
+	}
+
+	if (device.hue.enabled)
+	{
+		long selVal = (_hue != 0) ? _hue : device.hue.defVal;
+
+		if (setControl(V4L2_CID_HUE, selVal))
+			Info(_log, "Hue set to: %i (%s)", selVal, (selVal == device.hue.defVal) ? "default" : "user");
+		else
+		{
+			Error(_log, "Could not set hue to: %i", selVal);
+			result = false;
+		}
+	}
+
+	return result;
+}
+
+bool V4L2Grabber::applyDeviceControls()
+{
+	if (_fileDescriptor < 0 || !_deviceProperties.contains(_actualDeviceName))
+		return false;
+
+	return setVideoControls(_deviceProperties[_actualDeviceName]);
+}
+
 bool V4L2Grabber::init_device(QString selectedDeviceName, DevicePropertiesItem props)
 {
 	struct stat st;
@@ -902,45 +1250,7 @@ bool V4L2Grabber::init_device(QString selectedDeviceName, DevicePropertiesItem p
 	// set the line length
 	_lineLength = fmt.fmt.pix.bytesperline;
 
-	if (actDevice.brightness.enabled)
-	{
-		long selVal = (_brightness != 0) ? _brightness : actDevice.brightness.defVal;
-
-		if (setControl(V4L2_CID_BRIGHTNESS, selVal))
-			Info(_log, "Brightness set to: %i (%s)", selVal, (selVal == actDevice.brightness.defVal) ? "default" : "user");
-		else
-			Error(_log, "Could not set brightness to: %i", selVal);
-	}
-
-	if (actDevice.contrast.enabled)
-	{
-		long selVal = (_contrast != 0) ? _contrast : actDevice.contrast.defVal;
-
-		if (setControl(V4L2_CID_CONTRAST, selVal))
-			Info(_log, "Contrast set to: %i (%s)", selVal, (selVal == actDevice.contrast.defVal) ? "default" : "user");
-		else
-			Error(_log, "Could not set contrast to: %i", selVal);
-	}
-
-	if (actDevice.saturation.enabled)
-	{
-		long selVal = (_saturation != 0) ? _saturation : actDevice.saturation.defVal;
-
-		if (setControl(V4L2_CID_SATURATION, selVal))
-			Info(_log, "Saturation set to: %i (%s)", selVal, (selVal == actDevice.saturation.defVal) ? "default" : "user");
-		else
-			Error(_log, "Could not set saturation to: %i", selVal);
-	}
-
-	if (actDevice.hue.enabled)
-	{
-		long selVal = (_hue != 0) ? _hue : actDevice.hue.defVal;
-
-		if (setControl(V4L2_CID_HUE, selVal))
-			Info(_log, "Hue set to: %i (%s)", selVal, (selVal == actDevice.hue.defVal) ? "default" : "user");
-		else
-			Error(_log, "Could not set hue to: %i", selVal);
-	}
+	setVideoControls(actDevice);
 
 	// check pixel format and frame size
 	switch (fmt.fmt.pix.pixelformat)
@@ -990,17 +1300,44 @@ bool V4L2Grabber::init_device(QString selectedDeviceName, DevicePropertiesItem p
 		}
 		break;
 
+		case V4L2_PIX_FMT_P010:
+		{
+			loadLutFile(PixelFormat::YUYV);
+			_actualVideoFormat = PixelFormat::P010;
+			_frameByteSize = props.x * props.y * 3;
+			Info(_log, "Video pixel format is set to: P010");
+		}
+		break;
+
+		case V4L2_PIX_FMT_Y210:
+		{
+			loadLutFile(PixelFormat::YUYV);
+			_actualVideoFormat = PixelFormat::Y210;
+			_frameByteSize = props.x * props.y * 4;
+			Info(_log, "Video pixel format is set to: Y210");
+		}
+		break;
+
 		case V4L2_PIX_FMT_MJPEG:
 		{
 			loadLutFile(PixelFormat::YUYV);
 			_actualVideoFormat = PixelFormat::MJPEG;
 			Info(_log, "Video pixel format is set to: MJPEG");
+
+			V4L2M2MDecoder::setDisabled(false);
+			_hwMjpegDevice = (_hardwareMjpeg) ? V4L2M2MDecoder::findDevice() : QString();
+			_mjpegDecoder = (_hwMjpegDevice.isEmpty()) ? QString("turbojpeg") : QString("V4L2 M2M (%1)").arg(_hwMjpegDevice);
+
+			if (_hardwareMjpeg && _hwMjpegDevice.isEmpty())
+				Warning(_log, "Hardware MJPEG decoder is enabled but no V4L2 M2M JPEG decoder was found. Using turbojpeg");
+			else
+				Info(_log, "MJPEG decoder: %s", QSTRING_CSTR(_mjpegDecoder));
 		}
 		break;
 
 		default:
 		{
-			throw_exception("Only pixel formats MJPEG, YUYV, RGB24, XRGB, I420 and NV12 are supported");
+			throw_exception("Only pixel formats MJPEG, YUYV, RGB24, XRGB, I420, NV12, P010 and Y210 are supported");
 
 			return false;
 		}
@@ -1011,19 +1348,37 @@ bool V4L2Grabber::init_device(QString selectedDeviceName, DevicePropertiesItem p
 	_actualFPS = props.fps;
 	_actualDeviceName = selectedDeviceName;
 
-	return init_mmap();
+	return init_buffers();
 }
 
 void V4L2Grabber::uninit_device()
 {
+	bool failed = false;
+
+	// the driver must drop its references before the user memory is released
 	for (size_t i = 0; i < _buffers.size(); i++)
-		if (-1 == munmap(_buffers[i].start, _buffers[i].length))
-		{
-			throw_errno_exception("Error while releasing device: munmap");
-			return;
-		}
+		if (_buffers[i].start != nullptr && _memoryType != V4L2_MEMORY_USERPTR && -1 == munmap(_buffers[i].start, _buffers[i].length))
+			failed = true;
+
+	uint32_t count = 0;
+	if (!_buffers.empty())
+		request_buffers(_memoryType, count);
+
+	for (size_t i = 0; i < _buffers.size(); i++)
+	{
+		if (_memoryType == V4L2_MEMORY_USERPTR)
+			free(_buffers[i].start);
+
+		if (_buffers[i].dmabufFd >= 0)
+			close(_buffers[i].dmabufFd);
+	}
 
 	_buffers.resize(0);
+	_memoryType = V4L2_MEMORY_MMAP;
+	_streamingIoInUse = "";
+
+	if (failed)
+		throw_errno_exception("Error while releasing device: munmap");
 }
 
 void V4L2Grabber::start_capturing()
@@ -1032,14 +1387,7 @@ void V4L2Grabber::start_capturing()
 
 	for (size_t i = 0; i < _buffers.size(); ++i)
 	{
-		struct v4l2_buffer buf;
-
-		CLEAR(buf);
-		buf.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
-		buf.memory = V4L2_MEMORY_MMAP;
-		buf.index = i;
-
-		if (-1 == xioctl(VIDIOC_QBUF, &buf))
+		if (-1 == queue_buffer(i))
 		{
 			throw_errno_exception("VIDIOC_QBUF failed");
 			return;
@@ -1065,6 +1413,8 @@ int V4L2Grabber::read_frame()
 {
 	bool rc = false;
 
+	QMutexLocker locker(&_captureLock);
+
 	try
 	{
 		struct v4l2_buffer buf;
@@ -1072,7 +1422,7 @@ int V4L2Grabber::read_frame()
 		CLEAR(buf);
 
 		buf.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
-		buf.memory = V4L2_MEMORY_MMAP;
+		buf.memory = _memoryType;
 
 		if (-1 == xioctl(VIDIOC_DQBUF, &buf))
 		{
@@ -1085,8 +1435,18 @@ int V4L2Grabber::read_frame()
 				default:
 					{
 						throw_errno_exception("VIDIOC_DQBUF error. Video stream is probably broken. Refreshing list of the devices.");
-						stop();
-						getV4L2devices();
+
+						// the capture thread can't stop itself: leave it to the grabber's thread
+						if (_captureThread != nullptr && QThread::currentThread() == _captureThread)
+						{
+							_captureThread->requestInterruption();
+							QMetaObject::invokeMethod(this, "streamBroken", Qt::QueuedConnection);
+						}
+						else
+						{
+							locker.unlock();
+							streamBroken();
+						}
 					}
 					return 0;
 			}
@@ -1094,9 +1454,14 @@ int V4L2Grabber::read_frame()
 
 		assert(buf.index < _buffers.size());
 
+		sync_dmabuf(&buf, true);
+
+		_buffers[buf.index].timestamp = captureTime(buf);
+		_buffers[buf.index].dequeued = FrameTrace::now();
+
 		rc = process_image(&buf, _buffers[buf.index].start, buf.bytesused);
 
-		if (!rc && -1 == xioctl(VIDIOC_QBUF, &buf))
+		if (!rc && -1 == queue_buffer(buf.index))
 		{
 			throw_errno_exception("VIDIOC_QBUF error. Video stream is probably broken.");
 			return 0;
@@ -1111,13 +1476,22 @@ int V4L2Grabber::read_frame()
 	return rc ? 1 : 0;
 }
 
+void V4L2Grabber::streamBroken()
+{
+	stop();
+	getV4L2devices();
+}
+
 bool V4L2Grabber::process_image(v4l2_buffer* buf, const void* frameImageBuffer, int size)
 {
 	bool		frameSend = false;
 	uint64_t	processFrameIndex = _currentFrame++;
 
+	TRACE_SCOPE_ARG("V4L2 dispatch", processFrameIndex);
+
 	// frame skipping
-	if ((processFrameIndex % _fpsSoftwareDecimation != 0) && (_fpsSoftwareDecimation > 1))
+	const int decimation = getEffectiveDecimation();
+	if ((processFrameIndex % decimation != 0) && (decimation > 1))
 		return frameSend;
 
 	// We do want a new frame...
@@ -1127,6 +1501,8 @@ bool V4L2Grabber::process_image(v4l2_buffer* buf, const void* frameImageBuffer,
 	}
 	else
 	{
+		_captureRecorder.record(_actualVideoFormat, _actualWidth, _actualHeight, _lineLength, static_cast<const uint8_t*>(frameImageBuffer), size);
+
 		if (_V4L2WorkerManager.isActive())
 		{
 			// stats
@@ -1145,15 +1521,33 @@ bool V4L2Grabber::process_image(v4l2_buffer* buf, const void* frameImageBuffer,
 				int av = (frameStat.goodFrame > 0) ? frameStat.averageFrame / frameStat.goodFrame : 0;
 
 				if (diff >= 59000 && diff <= 65000)
+				{
+					PerformanceReport report(static_cast<int>(PerformanceReportType::VIDEO_GRABBER), frameStat.token, this->_actualDeviceName, total / qMax(diff / 1000.0, 1.0), av, frameStat.goodFrame, frameStat.badFrame);
+					report.histogram = _decodingLatency.toJson();
+					emit PerformanceCounters::getInstance()->newCounter(report);
+
 					emit PerformanceCounters::getInstance()->newCounter(
-					PerformanceReport(static_cast<int>(PerformanceReportType::VIDEO_GRABBER), frameStat.token, this->_actualDeviceName, total / qMax(diff / 1000.0, 1.0), av, frameStat.goodFrame, frameStat.badFrame));
+					PerformanceReport(static_cast<int>(PerformanceReportType::FRAME_DROPS), frameStat.token, this->_actualDeviceName, _latencyBudget, frameStat.queueFullFrame, frameStat.staleFrame, frameStat.overBudgetFrame));
+				}
 
 				resetCounter(now);
 
+				reportCacheMisses();
+
 				QString currentCache = Image<ColorRgb>::adjustCache();
 
 				if (!currentCache.isEmpty())
 					Info(_log, "%s", QSTRING_CSTR(currentCache));
+
+				QString ringStats = _V4L2WorkerManager.frameRing.getStats();
+
+				if (!ringStats.isEmpty())
+					Info(_log, "%s", QSTRING_CSTR(ringStats));
+
+				QString workerStats = _V4L2WorkerManager.getStats();
+
+				if (!workerStats.isEmpty())
+					Info(_log, "%s", QSTRING_CSTR(workerStats));
 			}
 
 			if (_V4L2WorkerManager.workers == nullptr)
@@ -1171,103 +1565,131 @@ bool V4L2Grabber::process_image(v4l2_buffer* buf, const void* frameImageBuffer,
 
 			frameStat.segment |= (1 << buf->index);
 
-			for (unsigned int i = 0; _V4L2WorkerManager.isActive() && i < _V4L2WorkerManager.workersCount && _V4L2WorkerManager.workers != nullptr; i++)
+			if ((_actualVideoFormat == PixelFormat::YUYV || _actualVideoFormat == PixelFormat::I420 ||
+				_actualVideoFormat == PixelFormat::NV12 || _actualVideoFormat == PixelFormat::P010 ||
+				_actualVideoFormat == PixelFormat::Y210) && !_lutBufferInit)
 			{
-				if (_V4L2WorkerManager.workers[i]->isFinished() || !_V4L2WorkerManager.workers[i]->isRunning())
-				{
-					if (_V4L2WorkerManager.workers[i]->isBusy() == false)
-					{
-						V4L2Worker* _workerThread = _V4L2WorkerManager.workers[i];
-
-						if ((_actualVideoFormat == PixelFormat::YUYV || _actualVideoFormat == PixelFormat::I420 ||
-							_actualVideoFormat == PixelFormat::NV12) && !_lutBufferInit)
-						{
-							loadLutFile();
-						}
+				loadLutFile();
+			}
 
-						_workerThread->setup(
-							i,
-							buf,
-							_actualVideoFormat,
-							(uint8_t*)frameImageBuffer, size, _actualWidth, _actualHeight, _lineLength,
-							_cropLeft, _cropTop, _cropBottom, _cropRight,
-							processFrameIndex, InternalClock::nowPrecise(), _hdrToneMappingEnabled,
-							(_lutBufferInit) ? _lutBuffer : NULL, _qframe);
-
-						if (_V4L2WorkerManager.workersCount > 1)
-							_V4L2WorkerManager.workers[i]->start();
-						else
-							_V4L2WorkerManager.workers[i]->startOnThisThread();
+			// one snapshot for the whole frame: the settings may replace it at any moment
+			ProcessingHandle processing = currentProcessing();
 
-						frameSend = true;
-						break;
-					}
-				}
+			if (processing->version != _appliedProcessing)
+			{
+				_appliedProcessing = processing->version;
+				Debug(_log, "Processing parameters #%llu applied from frame %llu: crop %d/%d/%d/%d, HDR mode %d",
+					static_cast<unsigned long long>(processing->version), static_cast<unsigned long long>(processFrameIndex),
+					processing->cropLeft, processing->cropRight, processing->cropTop, processing->cropBottom, processing->hdrToneMappingEnabled);
 			}
+
+			V4L2WorkerJob job;
+
+			job.bufferIndex = buf->index;
+			job.pixelFormat = _actualVideoFormat;
+			job.sharedData = (uint8_t*)frameImageBuffer;
+			job.size = size;
+			job.width = _actualWidth;
+			job.height = _actualHeight;
+			job.lineLength = _lineLength;
+			job.cropLeft = processing->cropLeft;
+			job.cropTop = processing->cropTop;
+			job.cropBottom = processing->cropBottom;
+			job.cropRight = processing->cropRight;
+			job.currentFrame = processFrameIndex;
+			job.frameBegin = InternalClock::nowPrecise();
+			job.hdrToneMappingEnabled = processing->hdrToneMappingEnabled;
+			job.lut = currentLut();
+			job.qframe = getEffectiveQFrame();
+			job.decodeTargetWidth = processing->decodeTargetWidth;
+			job.decodeStripes = processing->decodeStripes;
+			job.mjpegScale = getMjpegScale();
+			job.hwMjpegDevice = _hwMjpegDevice;
+			job.skippedArea = getSkippedArea();
+
+			frameSend = _V4L2WorkerManager.submit(job);
+
+			// newest frame wins: the busy workers don't queue up the latency, the buffer goes back to the driver
+			if (!frameSend)
+				frameStat.queueFullFrame++;
 		}
 	}
 
 	return frameSend;
 }
 
-void V4L2Grabber::newWorkerFrameError(unsigned int workerIndex, QString error, quint64 sourceCount)
+void V4L2Grabber::newWorkerFrameError(unsigned int bufferIndex, QString error, quint64 sourceCount)
 {
 	frameStat.badFrame++;
 	if (error.indexOf(QString(UNSUPPORTED_DECODER)) == 0)
 	{
-		Error(_log, "Unsupported MJPEG/YUV format. Please contact HyperHDR developers! (info: %s)", QSTRING_CSTR(error));
+		ErrorThrottled(_log, "Unsupported MJPEG/YUV format. Please contact HyperHDR developers! (info: %s)", QSTRING_CSTR(error));
 	}
-	//Debug(_log, "Error occured while decoding mjpeg frame %d = %s", sourceCount, QSTRING_CSTR(error));	
+	DebugThrottled(_log, "Error occured while decoding mjpeg frame %llu = %s", static_cast<unsigned long long>(sourceCount), QSTRING_CSTR(error));
 
 	// get next frame
-	if (workerIndex > _V4L2WorkerManager.workersCount)
-		Error(_log, "Frame index = %d, index out of range", sourceCount);
-
-	else if (_V4L2WorkerManager.workers == nullptr ||
-		_V4L2WorkerManager.isActive() == false ||
-		xioctl(VIDIOC_QBUF, _V4L2WorkerManager.workers[workerIndex]->GetV4L2Buffer()))
-	{
-		Error(_log, "Frame index = %d, inactive or critical VIDIOC_QBUF error in v4l2 driver. Buf index = %d, worker = %d, is_active = %d.",
-			sourceCount, _V4L2WorkerManager.workers[workerIndex]->GetV4L2Buffer()->index, workerIndex, _V4L2WorkerManager.isActive());
-	}
-
-	if (workerIndex <= _V4L2WorkerManager.workersCount)
-		_V4L2WorkerManager.workers[workerIndex]->noBusy();
+	requeueWorkerBuffer(bufferIndex, sourceCount);
 }
 
 
-void V4L2Grabber::newWorkerFrame(unsigned int workerIndex, Image<ColorRgb> image, quint64 sourceCount, qint64 _frameBegin)
+void V4L2Grabber::newWorkerFrame(unsigned int bufferIndex, Image<ColorRgb> image, quint64 sourceCount, qint64 _frameBegin)
 {
+	qint64 latency = InternalClock::nowPrecise() - _frameBegin;
+	int64_t timestamp = (bufferIndex < _buffers.size()) ? _buffers[bufferIndex].timestamp : 0;
+
 	frameStat.goodFrame++;
-	frameStat.averageFrame += InternalClock::nowPrecise() - _frameBegin;
+	frameStat.averageFrame += latency;
+	_decodingLatency.add(latency);
 
-	if (_signalAutoDetectionEnabled || isCalibrating())
+	if (!_hwMjpegDevice.isEmpty() && V4L2M2MDecoder::isDisabled())
 	{
-		if (checkSignalDetectionAutomatic(image))
-			emit newFrame(image);
+		Warning(_log, "Hardware MJPEG decoder %s has failed. Falling back to turbojpeg", QSTRING_CSTR(_hwMjpegDevice));
+		_hwMjpegDevice.clear();
+		_mjpegDecoder = "turbojpeg";
+	}
+
+	// the workers finish out of order: a frame older than the last emitted one is dropped
+	if (!_V4L2WorkerManager.acceptFrame(sourceCount))
+	{
+		frameStat.staleFrame++;
 	}
-	else if (_signalDetectionEnabled)
+	else if (_latencyBudget > 0 && timestamp > 0 && InternalClock::now() - timestamp > _latencyBudget)
 	{
-		if (checkSignalDetectionManual(image))
-			emit newFrame(image);
+		frameStat.overBudgetFrame++;
 	}
 	else
-		emit newFrame(image);
+	{
+		image.setTimestamp(timestamp);
+		image.setCaptureTrace((bufferIndex < _buffers.size()) ? _buffers[bufferIndex].dequeued : 0, FrameTrace::now());
+
+		if (_signalAutoDetectionEnabled || isCalibrating())
+		{
+			if (checkSignalDetectionAutomatic(image))
+				emit newFrame(image);
+		}
+		else if (_signalDetectionEnabled)
+		{
+			if (checkSignalDetectionManual(image))
+				emit newFrame(image);
+		}
+		else
+			emit newFrame(image);
+	}
 
 	// get next frame
-	if (workerIndex > _V4L2WorkerManager.workersCount)
-		Error(_log, "Frame index = %d, index out of range", sourceCount);
+	requeueWorkerBuffer(bufferIndex, sourceCount);
+}
 
-	else if (_V4L2WorkerManager.workers == nullptr ||
-		_V4L2WorkerManager.isActive() == false ||
-		xioctl(VIDIOC_QBUF, _V4L2WorkerManager.workers[workerIndex]->GetV4L2Buffer()))
+void V4L2Grabber::requeueWorkerBuffer(unsigned int bufferIndex, quint64 sourceCount)
+{
+	if (bufferIndex >= _buffers.size())
+		Error(_log, "Frame index = %d, buffer index %d out of range", sourceCount, bufferIndex);
+
+	else if (_V4L2WorkerManager.isActive() == false || queue_buffer(bufferIndex))
 	{
-		Error(_log, "Frame index = %d, inactive or critical VIDIOC_QBUF error in v4l2 driver. Buf index = %d, worker = %d, is_active = %d.",
-			sourceCount, _V4L2WorkerManager.workers[workerIndex]->GetV4L2Buffer()->index, workerIndex, _V4L2WorkerManager.isActive());
+		Error(_log, "Frame index = %d, inactive or critical VIDIOC_QBUF error in v4l2 driver. Buf index = %d, is_active = %d.",
+			sourceCount, bufferIndex, _V4L2WorkerManager.isActive());
 	}
-
-	if (workerIndex <= _V4L2WorkerManager.workersCount)
-		_V4L2WorkerManager.workers[workerIndex]->noBusy();
 }
 
 int V4L2Grabber::xioctl(int request, void* arg)
@@ -1304,4 +1726,107 @@ void V4L2Grabber::throw_errno_exception(const QString& error)
 	Error(_log, "Throws error nr: %s", QSTRING_CSTR(QString(error + " error code " + QString::number(errno) + ", " + strerror(errno))));
 }
 
+V4L2CaptureThread::V4L2CaptureThread(V4L2Grabber* grabber, Logger* log, int fileDescriptor, bool realtime) :
+	_grabber(grabber),
+	_log(log),
+	_fileDescriptor(fileDescriptor),
+	_wakeupDescriptor(eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK)),
+	_realtime(realtime)
+{
+	setObjectName("V4L2Capture");
+}
+
+V4L2CaptureThread::~V4L2CaptureThread()
+{
+	stopCapture();
+
+	if (_wakeupDescriptor >= 0)
+		close(_wakeupDescriptor);
+}
+
+void V4L2CaptureThread::stopCapture()
+{
+	requestInterruption();
+
+	if (_wakeupDescriptor >= 0)
+	{
+		uint64_t value = 1;
+		if (write(_wakeupDescriptor, &value, sizeof(value)) < 0)
+			Debug(_log, "Could not wake up the capture thread (%s)", strerror(errno));
+	}
+
+	wait();
+}
+
+void V4L2CaptureThread::run()
+{
+	if (_realtime)
+	{
+		sched_param param;
+		CLEAR(param);
+		param.sched_priority = V4L2_CAPTURE_REALTIME_PRIORITY;
+
+		int error = pthread_setschedparam(pthread_self(), SCHED_FIFO, &param);
+		if (error != 0)
+			Warning(_log, "Could not set the realtime priority for the capture thread (%s). Using the normal priority", strerror(error));
+		else
+			Info(_log, "Capture thread is running with the realtime priority (SCHED_FIFO %i)", param.sched_priority);
+	}
+
+	// the thread policy of the general settings, when configured, comes after the option of the grabber
+	ThreadPolicy::apply(ThreadPolicy::Role::CAPTURE);
+
+	int epollDescriptor = epoll_create1(EPOLL_CLOEXEC);
+
+	if (epollDescriptor < 0)
+	{
+		Error(_log, "Could not create epoll instance for the capture thread (%s)", strerror(errno));
+		return;
+	}
+
+	epoll_event event;
+
+	CLEAR(event);
+	event.events = EPOLLIN;
+	event.data.fd = _fileDescriptor;
+
+	bool ready = (epoll_ctl(epollDescriptor, EPOLL_CTL_ADD, _fileDescriptor, &event) == 0);
+
+	if (ready && _wakeupDescriptor >= 0)
+	{
+		CLEAR(event);
+		event.events = EPOLLIN;
+		event.data.fd = _wakeupDescriptor;
+		ready = (epoll_ctl(epollDescriptor, EPOLL_CTL_ADD, _wakeupDescriptor, &event) == 0);
+	}
+
+	if (!ready)
+		Error(_log, "Could not register the video device for the capture thread (%s)", strerror(errno));
+
+	while (ready && !isInterruptionRequested())
+	{
+		epoll_event events[2];
+
+		// the timeout only guards against a lost wake-up
+		int count = epoll_wait(epollDescriptor, events, 2, 1000);
+
+		if (count < 0)
+		{
+			if (errno == EINTR)
+				continue;
+
+			Error(_log, "Capture thread epoll error (%s)", strerror(errno));
+			break;
+		}
+
+		for (int i = 0; i < count && !isInterruptionRequested(); i++)
+			if (events[i].data.fd == _fileDescriptor && _grabber->read_frame() == 0 && (events[i].events & EPOLLERR))
+			{
+				// every buffer is held by the workers: the driver signals an error until one is requeued
+				QThread::usleep(1000);
+			}
+	}
+
+	close(epollDescriptor);
+}
 
@@ -0,0 +1,501 @@
+/* V4L2M2MDecoder.cpp
+*
+*  MIT License
+*
+*  Copyright (c) 2023 awawa-dev
+*
+*  Project homesite: https://github.com/awawa-dev/HyperHDR
+*
+*  Permission is hereby granted, free of charge, to any person obtaining a copy
+*  of this software and associated documentation files (the "Software"), to deal
+*  in the Software without restriction, including without limitation the rights
+*  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+*  copies of the Software, and to permit persons to whom the Software is
+*  furnished to do so, subject to the following conditions:
+*
+*  The above copyright notice and this permission notice shall be included in all
+*  copies or substantial portions of the Software.
+
+*  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+*  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+*  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+*  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+*  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+*  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+*  SOFTWARE.
+*/
+
+#include <cstring>
+#include <cerrno>
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <poll.h>
+#include <sys/ioctl.h>
+#include <sys/mman.h>
+#include <linux/videodev2.h>
+
+#include <QDir>
+#include <QMutexLocker>
+
+#include <grabber/V4L2M2MDecoder.h>
+
+#define CLEAR(x) memset(&(x), 0, sizeof(x))
+
+// maximum time for the hardware to decode a single frame
+#define DECODE_TIMEOUT_MS 500
+
+QMutex				V4L2M2MDecoder::_probeLocker;
+bool				V4L2M2MDecoder::_probed = false;
+QString				V4L2M2MDecoder::_device;
+std::atomic<bool>	V4L2M2MDecoder::_disabled(false);
+
+namespace
+{
+	int ioctlRetry(int fd, unsigned long request, void* arg)
+	{
+		int r;
+
+		do
+		{
+			r = ioctl(fd, request, arg);
+		} while (-1 == r && EINTR == errno);
+
+		return r;
+	}
+
+	bool hasFormat(int fd, uint32_t type, uint32_t pixelFormat)
+	{
+		struct v4l2_fmtdesc desc;
+		CLEAR(desc);
+		desc.type = type;
+
+		for (desc.index = 0; ioctlRetry(fd, VIDIOC_ENUM_FMT, &desc) == 0; desc.index++)
+			if (desc.pixelformat == pixelFormat)
+				return true;
+
+		return false;
+	}
+}
+
+V4L2M2MDecoder::V4L2M2MDecoder() :
+	_fd(-1),
+	_mplane(false),
+	_streaming(false),
+	_jpegFormat(V4L2_PIX_FMT_MJPEG),
+	_width(0),
+	_height(0),
+	_lineLength(0),
+	_planeHeight(0),
+	_output{ nullptr, 0 },
+	_capture{ nullptr, 0 }
+{
+}
+
+V4L2M2MDecoder::~V4L2M2MDecoder()
+{
+	close();
+}
+
+bool V4L2M2MDecoder::probeDevice(const QString& device, uint32_t& jpegFormat)
+{
+	int fd = ::open(device.toLocal8Bit().constData(), O_RDWR | O_NONBLOCK, 0);
+
+	if (fd < 0)
+		return false;
+
+	bool found = false;
+	struct v4l2_capability cap;
+	CLEAR(cap);
+
+	if (ioctlRetry(fd, VIDIOC_QUERYCAP, &cap) == 0)
+	{
+		uint32_t caps = (cap.capabilities & V4L2_CAP_DEVICE_CAPS) ? cap.device_caps : cap.capabilities;
+
+		if ((caps & V4L2_CAP_STREAMING) && (caps & (V4L2_CAP_VIDEO_M2M | V4L2_CAP_VIDEO_M2M_MPLANE)))
+		{
+			bool mplane = (caps & V4L2_CAP_VIDEO_M2M_MPLANE);
+			uint32_t outputType = (mplane) ? V4L2_BUF_TYPE_VIDEO_OUTPUT_MPLANE : V4L2_BUF_TYPE_VIDEO_OUTPUT;
+			uint32_t captureType = (mplane) ? V4L2_BUF_TYPE_VIDEO_CAPTURE_MPLANE : V4L2_BUF_TYPE_VIDEO_CAPTURE;
+
+			if (hasFormat(fd, captureType, V4L2_PIX_FMT_NV12))
+			{
+				if (hasFormat(fd, outputType, V4L2_PIX_FMT_MJPEG))
+				{
+					jpegFormat = V4L2_PIX_FMT_MJPEG;
+					found = true;
+				}
+				else if (hasFormat(fd, outputType, V4L2_PIX_FMT_JPEG))
+				{
+					jpegFormat = V4L2_PIX_FMT_JPEG;
+					found = true;
+				}
+			}
+		}
+	}
+
+	::close(fd);
+	return found;
+}
+
+QString V4L2M2MDecoder::findDevice()
+{
+	QMutexLocker locker(&_probeLocker);
+
+	if (!_probed)
+	{
+		_probed = true;
+
+		QStringList devices = QDir("/dev").entryList(QStringList() << "video*", QDir::System);
+
+		for (const QString& name : devices)
+		{
+			uint32_t jpegFormat;
+
+			if (probeDevice("/dev/" + name, jpegFormat))
+			{
+				_device = "/dev/" + name;
+				break;
+			}
+		}
+	}
+
+	return _device;
+}
+
+void V4L2M2MDecoder::setDisabled(bool disabled)
+{
+	_disabled = disabled;
+}
+
+bool V4L2M2MDecoder::isDisabled()
+{
+	return _disabled;
+}
+
+int V4L2M2MDecoder::xioctl(unsigned long request, void* arg)
+{
+	return ioctlRetry(_fd, request, arg);
+}
+
+bool V4L2M2MDecoder::open(const QString& device)
+{
+	close();
+
+	if (!probeDevice(device, _jpegFormat))
+		return false;
+
+	_fd = ::open(device.toLocal8Bit().constData(), O_RDWR | O_NONBLOCK, 0);
+
+	if (_fd < 0)
+		return false;
+
+	struct v4l2_capability cap;
+	CLEAR(cap);
+
+	if (xioctl(VIDIOC_QUERYCAP, &cap) < 0)
+	{
+		close();
+		return false;
+	}
+
+	uint32_t caps = (cap.capabilities & V4L2_CAP_DEVICE_CAPS) ? cap.device_caps : cap.capabilities;
+	_mplane = (caps & V4L2_CAP_VIDEO_M2M_MPLANE);
+
+	return true;
+}
+
+void V4L2M2MDecoder::release()
+{
+	if (_fd >= 0 && _streaming)
+	{
+		int type = (_mplane) ? V4L2_BUF_TYPE_VIDEO_OUTPUT_MPLANE : V4L2_BUF_TYPE_VIDEO_OUTPUT;
+		xioctl(VIDIOC_STREAMOFF, &type);
+		type = (_mplane) ? V4L2_BUF_TYPE_VIDEO_CAPTURE_MPLANE : V4L2_BUF_TYPE_VIDEO_CAPTURE;
+		xioctl(VIDIOC_STREAMOFF, &type);
+	}
+	_streaming = false;
+
+	if (_output.start != nullptr)
+		munmap(_output.start, _output.length);
+	if (_capture.start != nullptr)
+		munmap(_capture.start, _capture.length);
+
+	_output = { nullptr, 0 };
+	_capture = { nullptr, 0 };
+
+	if (_fd >= 0)
+	{
+		struct v4l2_requestbuffers req;
+
+		CLEAR(req);
+		req.type = (_mplane) ? V4L2_BUF_TYPE_VIDEO_OUTPUT_MPLANE : V4L2_BUF_TYPE_VIDEO_OUTPUT;
+		req.memory = V4L2_MEMORY_MMAP;
+		xioctl(VIDIOC_REQBUFS, &req);
+
+		CLEAR(req);
+		req.type = (_mplane) ? V4L2_BUF_TYPE_VIDEO_CAPTURE_MPLANE : V4L2_BUF_TYPE_VIDEO_CAPTURE;
+		req.memory = V4L2_MEMORY_MMAP;
+		xioctl(VIDIOC_REQBUFS, &req);
+	}
+
+	_width = 0;
+	_height = 0;
+}
+
+void V4L2M2MDecoder::close()
+{
+	release();
+
+	if (_fd >= 0)
+		::close(_fd);
+
+	_fd = -1;
+}
+
+bool V4L2M2MDecoder::configure(int width, int height)
+{
+	release();
+
+	struct v4l2_format fmt;
+	const uint32_t outputType = (_mplane) ? V4L2_BUF_TYPE_VIDEO_OUTPUT_MPLANE : V4L2_BUF_TYPE_VIDEO_OUTPUT;
+	const uint32_t captureType = (_mplane) ? V4L2_BUF_TYPE_VIDEO_CAPTURE_MPLANE : V4L2_BUF_TYPE_VIDEO_CAPTURE;
+
+	// compressed input: a MJPEG frame never exceeds the size of the raw YUYV frame
+	const uint32_t inputSize = static_cast<uint32_t>(width) * height * 2;
+
+	CLEAR(fmt);
+	fmt.type = outputType;
+	if (_mplane)
+	{
+		fmt.fmt.pix_mp.width = width;
+		fmt.fmt.pix_mp.height = height;
+		fmt.fmt.pix_mp.pixelformat = _jpegFormat;
+		fmt.fmt.pix_mp.num_planes = 1;
+		fmt.fmt.pix_mp.plane_fmt[0].sizeimage = inputSize;
+	}
+	else
+	{
+		fmt.fmt.pix.width = width;
+		fmt.fmt.pix.height = height;
+		fmt.fmt.pix.pixelformat = _jpegFormat;
+		fmt.fmt.pix.sizeimage = inputSize;
+	}
+
+	if (xioctl(VIDIOC_S_FMT, &fmt) < 0)
+		return false;
+
+	CLEAR(fmt);
+	fmt.type = captureType;
+	if (_mplane)
+	{
+		fmt.fmt.pix_mp.width = width;
+		fmt.fmt.pix_mp.height = height;
+		fmt.fmt.pix_mp.pixelformat = V4L2_PIX_FMT_NV12;
+		fmt.fmt.pix_mp.num_planes = 1;
+	}
+	else
+	{
+		fmt.fmt.pix.width = width;
+		fmt.fmt.pix.height = height;
+		fmt.fmt.pix.pixelformat = V4L2_PIX_FMT_NV12;
+	}
+
+	if (xioctl(VIDIOC_S_FMT, &fmt) < 0)
+		return false;
+
+	// the UV plane must follow the Y plane in the same buffer (NV12, not NV12M)
+	if (_mplane)
+	{
+		if (fmt.fmt.pix_mp.pixelformat != V4L2_PIX_FMT_NV12 || fmt.fmt.pix_mp.num_planes != 1 ||
+			(int)fmt.fmt.pix_mp.width < width || (int)fmt.fmt.pix_mp.height < height)
+			return false;
+
+		_lineLength = fmt.fmt.pix_mp.plane_fmt[0].bytesperline;
+		_planeHeight = fmt.fmt.pix_mp.height;
+	}
+	else
+	{
+		if (fmt.fmt.pix.pixelformat != V4L2_PIX_FMT_NV12 || (int)fmt.fmt.pix.width < width || (int)fmt.fmt.pix.height < height)
+			return false;
+
+		_lineLength = fmt.fmt.pix.bytesperline;
+		_planeHeight = fmt.fmt.pix.height;
+	}
+
+	if (_lineLength < width)
+		return false;
+
+	MappedBuffer* targets[2] = { &_output, &_capture };
+	uint32_t types[2] = { outputType, captureType };
+
+	for (int i = 0; i < 2; i++)
+	{
+		struct v4l2_requestbuffers req;
+		CLEAR(req);
+		req.count = 1;
+		req.type = types[i];
+		req.memory = V4L2_MEMORY_MMAP;
+
+		if (xioctl(VIDIOC_REQBUFS, &req) < 0 || req.count < 1)
+			return false;
+
+		struct v4l2_buffer buf;
+		struct v4l2_plane planes[VIDEO_MAX_PLANES];
+		CLEAR(buf);
+		CLEAR(planes);
+		buf.type = types[i];
+		buf.memory = V4L2_MEMORY_MMAP;
+		buf.index = 0;
+		if (_mplane)
+		{
+			buf.m.planes = planes;
+			buf.length = VIDEO_MAX_PLANES;
+		}
+
+		if (xioctl(VIDIOC_QUERYBUF, &buf) < 0)
+			return false;
+
+		size_t length = (_mplane) ? planes[0].length : buf.length;
+		off_t offset = (_mplane) ? planes[0].m.mem_offset : buf.m.offset;
+
+		void* start = mmap(NULL, length, PROT_READ | PROT_WRITE, MAP_SHARED, _fd, offset);
+
+		if (start == MAP_FAILED)
+			return false;
+
+		*targets[i] = { start, length };
+	}
+
+	// the decoded frame must fit: Y plane + UV plane
+	if (_capture.length < static_cast<size_t>(_lineLength) * _planeHeight * 3 / 2)
+		return false;
+
+	for (int i = 0; i < 2; i++)
+	{
+		int type = types[i];
+		if (xioctl(VIDIOC_STREAMON, &type) < 0)
+			return false;
+	}
+
+	_streaming = true;
+	_width = width;
+	_height = height;
+
+	return true;
+}
+
+bool V4L2M2MDecoder::queueBuffer(uint32_t type, size_t bytesUsed)
+{
+	struct v4l2_buffer buf;
+	struct v4l2_plane planes[VIDEO_MAX_PLANES];
+
+	CLEAR(buf);
+	CLEAR(planes);
+	buf.type = type;
+	buf.memory = V4L2_MEMORY_MMAP;
+	buf.index = 0;
+
+	if (_mplane)
+	{
+		planes[0].bytesused = static_cast<uint32_t>(bytesUsed);
+		planes[0].length = static_cast<uint32_t>((bytesUsed) ? _output.length : _capture.length);
+		buf.m.planes = planes;
+		buf.length = 1;
+	}
+	else
+		buf.bytesused = static_cast<uint32_t>(bytesUsed);
+
+	return xioctl(VIDIOC_QBUF, &buf) == 0;
+}
+
+bool V4L2M2MDecoder::dequeueBuffer(uint32_t type, uint32_t& flags)
+{
+	struct v4l2_buffer buf;
+	struct v4l2_plane planes[VIDEO_MAX_PLANES];
+
+	for (int retry = 0; retry < 2; retry++)
+	{
+		CLEAR(buf);
+		CLEAR(planes);
+		buf.type = type;
+		buf.memory = V4L2_MEMORY_MMAP;
+
+		if (_mplane)
+		{
+			buf.m.planes = planes;
+			buf.length = VIDEO_MAX_PLANES;
+		}
+
+		if (xioctl(VIDIOC_DQBUF, &buf) == 0)
+		{
+			flags = buf.flags;
+			return true;
+		}
+
+		if (errno != EAGAIN)
+			return false;
+
+		struct pollfd pfd;
+		pfd.fd = _fd;
+		pfd.events = POLLIN | POLLOUT;
+		pfd.revents = 0;
+
+		if (poll(&pfd, 1, DECODE_TIMEOUT_MS) <= 0)
+			return false;
+	}
+
+	return false;
+}
+
+bool V4L2M2MDecoder::decode(const uint8_t* jpeg, size_t size, int width, int height)
+{
+	if (_fd < 0 || width <= 0 || height <= 0)
+		return false;
+
+	if ((width != _width || height != _height || !_streaming) && !configure(width, height))
+	{
+		release();
+		return false;
+	}
+
+	if (size > _output.length)
+		return false;
+
+	const uint32_t outputType = (_mplane) ? V4L2_BUF_TYPE_VIDEO_OUTPUT_MPLANE : V4L2_BUF_TYPE_VIDEO_OUTPUT;
+	const uint32_t captureType = (_mplane) ? V4L2_BUF_TYPE_VIDEO_CAPTURE_MPLANE : V4L2_BUF_TYPE_VIDEO_CAPTURE;
+
+	memcpy(_output.start, jpeg, size);
+
+	if (!queueBuffer(captureType, 0) || !queueBuffer(outputType, size))
+	{
+		release();
+		return false;
+	}
+
+	uint32_t captureFlags = 0, outputFlags = 0;
+
+	if (!dequeueBuffer(captureType, captureFlags) || !dequeueBuffer(outputType, outputFlags))
+	{
+		// the buffers are still owned by the driver, start from scratch on the next frame
+		release();
+		return false;
+	}
+
+	return (captureFlags & V4L2_BUF_FLAG_ERROR) == 0;
+}
+
+const uint8_t* V4L2M2MDecoder::data() const
+{
+	return static_cast<const uint8_t*>(_capture.start);
+}
+
+int V4L2M2MDecoder::lineLength() const
+{
+	return _lineLength;
+}
+
+int V4L2M2MDecoder::planeHeight() const
+{
+	return _planeHeight;
+}
@@ -54,30 +54,38 @@
 #include <QFileInfo>
 
 #include <grabber/V4L2Worker.h>
+#include <utils/ThreadPolicy.h>
+#include <utils/EventTracer.h>
 
 
 
 std::atomic<bool>	V4L2Worker::_isActive(false);
 
 V4L2WorkerManager::V4L2WorkerManager() :
-	workers(nullptr)
+	workers(nullptr),
+	_orderValid(false),
+	_lastFrame(0),
+	_submitted(0),
+	_queueDepth(0),
+	_peakQueueDepth(0),
+	_queueFull(0),
+	_staleFrames(0),
+	_statsBegin(InternalClock::nowPrecise())
 {
 	workersCount = std::max(QThread::idealThreadCount(), 1);
 }
 
 V4L2WorkerManager::~V4L2WorkerManager()
 {
-	V4L2Worker::_isActive = false;
+	Stop();
 
 	if (workers != nullptr)
 	{
 		for (unsigned i = 0; i < workersCount; i++)
-			if (workers[i] != nullptr)
-			{
-				workers[i]->wait();
-				delete workers[i];
-				workers[i] = nullptr;
-			}
+		{
+			delete workers[i];
+			workers[i] = nullptr;
+		}
 		delete[] workers;
 		workers = nullptr;
 	}
@@ -86,6 +94,12 @@ V4L2WorkerManager::~V4L2WorkerManager()
 void V4L2WorkerManager::Start()
 {
 	V4L2Worker::_isActive = true;
+
+	// explicit priority: the workers can be started by the realtime capture thread and must not inherit its policy
+	if (workers != nullptr && workersCount > 1)
+		for (unsigned i = 0; i < workersCount; i++)
+			if (!workers[i]->isRunning())
+				workers[i]->start(QThread::NormalPriority);
 }
 
 void V4L2WorkerManager::InitWorkers()
@@ -94,16 +108,34 @@ void V4L2WorkerManager::InitWorkers()
 	{
 		workers = new V4L2Worker*[workersCount];
 
+		frameRing.init(workersCount + FrameRingConsumerSlots);
+
 		for (unsigned i = 0; i < workersCount; i++)
 		{
-			workers[i] = new V4L2Worker();
+			workers[i] = new V4L2Worker(this, i);
+			workers[i]->setObjectName(QString("V4L2Worker%1").arg(i));
+			workers[i]->_frameRing = &frameRing;
 		}
+
+		if (isActive())
+			Start();
 	}
 }
 
 void V4L2WorkerManager::Stop()
 {
-	V4L2Worker::_isActive = false;
+	{
+		QMutexLocker locker(&_queueLock);
+
+		V4L2Worker::_isActive = false;
+
+		// the jobs that didn't start hold V4L2 buffers, the grabber can requeue them
+		for (const V4L2WorkerJob& job : _queue)
+			_droppedBuffers.push_back(job.bufferIndex);
+		_queue.clear();
+
+		_queueCondition.wakeAll();
+	}
 
 	if (workers != nullptr)
 	{
@@ -120,11 +152,119 @@ bool V4L2WorkerManager::isActive()
 	return V4L2Worker::_isActive;
 }
 
-V4L2Worker::V4L2Worker() :
+bool V4L2WorkerManager::submit(const V4L2WorkerJob& job)
+{
+	if (workers == nullptr || !isActive())
+		return false;
+
+	if (workersCount <= 1)
+	{
+		_submitted++;
+		workers[0]->setup(job);
+		workers[0]->startOnThisThread();
+		return true;
+	}
+
+	QMutexLocker locker(&_queueLock);
+
+	// every waiting job holds a V4L2 buffer: don't let a burst starve the driver
+	if (_queue.size() >= workersCount)
+	{
+		_queueFull++;
+		return false;
+	}
+
+	_queue.push_back(job);
+
+	_submitted++;
+	_queueDepth += _queue.size();
+	_peakQueueDepth = std::max(_peakQueueDepth, static_cast<int>(_queue.size()));
+
+	_queueCondition.wakeOne();
+
+	return true;
+}
+
+bool V4L2WorkerManager::takeJob(V4L2WorkerJob& job)
+{
+	QMutexLocker locker(&_queueLock);
+
+	while (isActive() && _queue.empty())
+		_queueCondition.wait(&_queueLock);
+
+	if (!isActive())
+		return false;
+
+	job = _queue.front();
+	_queue.pop_front();
+
+	return true;
+}
+
+std::vector<unsigned int> V4L2WorkerManager::takeDroppedBuffers()
+{
+	QMutexLocker locker(&_queueLock);
+
+	std::vector<unsigned int> retVal;
+	retVal.swap(_droppedBuffers);
+
+	return retVal;
+}
+
+bool V4L2WorkerManager::acceptFrame(quint64 sourceCount)
+{
+	if (_orderValid && sourceCount <= _lastFrame)
+	{
+		_staleFrames++;
+		return false;
+	}
+
+	_orderValid = true;
+	_lastFrame = sourceCount;
+
+	return true;
+}
+
+void V4L2WorkerManager::resetOrder()
+{
+	_orderValid = false;
+
+	takeDroppedBuffers();
+}
+
+QString V4L2WorkerManager::getStats()
+{
+	QMutexLocker locker(&_queueLock);
+
+	int64_t now = InternalClock::nowPrecise();
+	int64_t elapsed = std::max(now - _statsBegin, int64_t(1)) * 1000;
+	QString utilization;
+
+	for (unsigned i = 0; workers != nullptr && i < workersCount; i++)
+		utilization += QString("%1%2%").arg((i > 0) ? " " : "").arg((100 * workers[i]->_busyTime.exchange(0)) / elapsed);
+
+	QString retVal = (_submitted == 0) ? QString() :
+		QString("V4L2 workers: queue depth: %1 average / %2 peak, worker utilization: %3, dropped: %4 (queue full) %5 (stale)").
+		arg(_queueDepth / static_cast<double>(_submitted), 0, 'f', 1).arg(_peakQueueDepth).arg(utilization).arg(_queueFull).arg(_staleFrames);
+
+	_statsBegin = now;
+	_submitted = 0;
+	_queueDepth = 0;
+	_peakQueueDepth = 0;
+	_queueFull = 0;
+	_staleFrames = 0;
+
+	return retVal;
+}
+
+V4L2Worker::V4L2Worker(V4L2WorkerManager* manager, unsigned int workerIndex) :
+	_manager(manager),
 	_decompress(nullptr),
-	_isBusy(false),
-	_semaphore(1),
-	_workerIndex(0),
+	_hwDecoder(nullptr),
+	_frameRing(nullptr),
+	_busyTime(0),
+	_workerIndex(workerIndex),
+	_bufferIndex(0),
 	_pixelFormat(PixelFormat::NO_CHANGE),
 	_sharedData(nullptr),
 	_size(0),
@@ -140,7 +280,11 @@ V4L2Worker::V4L2Worker() :
 	_frameBegin(0),
 	_hdrToneMappingEnabled(0),
 	_lutBuffer(nullptr),
-	_qframe(false)
+	_compactLut(nullptr),
+	_qframe(false),
+	_decodeTargetWidth(0),
+	_decodeStripes(0),
+	_mjpegScale(1)
 {
 
 }
@@ -149,60 +293,91 @@ V4L2Worker::~V4L2Worker()
 {
 	if (_decompress != nullptr)
 		tjDestroy(_decompress);
-}
 
-void V4L2Worker::setup(unsigned int __workerIndex, v4l2_buffer* __v4l2Buf, PixelFormat __pixelFormat,
-	uint8_t* __sharedData, int __size, int __width, int __height, int __lineLength,
-	uint __cropLeft, uint  __cropTop, uint __cropBottom, uint __cropRight,
-	quint64 __currentFrame, qint64 __frameBegin,
-	int __hdrToneMappingEnabled, uint8_t* __lutBuffer, bool __qframe)
-{
-	_workerIndex = __workerIndex;
-	memcpy(&_v4l2Buf, __v4l2Buf, sizeof(v4l2_buffer));
-	_lineLength = __lineLength;
-	_pixelFormat = __pixelFormat;
-	_sharedData = __sharedData;
-	_size = __size;
-	_width = __width;
-	_height = __height;
-	_cropLeft = __cropLeft;
-	_cropTop = __cropTop;
-	_cropBottom = __cropBottom;
-	_cropRight = __cropRight;
-	_currentFrame = __currentFrame;
-	_frameBegin = __frameBegin;
-	_hdrToneMappingEnabled = __hdrToneMappingEnabled;
-	_lutBuffer = __lutBuffer;
-	_qframe = __qframe;
+	delete _hwDecoder;
 }
 
-v4l2_buffer* V4L2Worker::GetV4L2Buffer()
+void V4L2Worker::setup(const V4L2WorkerJob& job)
 {
-	return &_v4l2Buf;
+	_bufferIndex = job.bufferIndex;
+	_lineLength = job.lineLength;
+	_pixelFormat = job.pixelFormat;
+	_sharedData = job.sharedData;
+	_size = job.size;
+	_width = job.width;
+	_height = job.height;
+	_cropLeft = job.cropLeft;
+	_cropTop = job.cropTop;
+	_cropBottom = job.cropBottom;
+	_cropRight = job.cropRight;
+	_currentFrame = job.currentFrame;
+	_frameBegin = job.frameBegin;
+	_hdrToneMappingEnabled = job.hdrToneMappingEnabled;
+	_lut = job.lut;
+	_lutBuffer = (_lut != nullptr) ? _lut->buffer() : nullptr;
+	_compactLut = (_lut != nullptr) ? _lut->compactLut() : nullptr;
+	_qframe = job.qframe;
+	_decodeTargetWidth = job.decodeTargetWidth;
+	_decodeStripes = job.decodeStripes;
+	_mjpegScale = job.mjpegScale;
+	_hwMjpegDevice = job.hwMjpegDevice;
+	_skippedArea = job.skippedArea;
 }
 
 void V4L2Worker::run()
 {
-	runMe();
+	V4L2WorkerJob job;
+
+	ThreadPolicy::apply(ThreadPolicy::Role::PROCESSING);
+
+	while (_manager->takeJob(job))
+	{
+		auto begin = std::chrono::steady_clock::now();
+
+		setup(job);
+		runMe();
+
+		// the previous table is released as soon as its last frame is decoded
+		job.lut = nullptr;
+		_lut = nullptr;
+
+		_busyTime += std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - begin).count();
+	}
 }
 
 void V4L2Worker::runMe()
 {
+	TRACE_SCOPE_ARG("V4L2 decode", _currentFrame);
+
 	if (_isActive)
 	{
 		if (_pixelFormat == PixelFormat::MJPEG)
-		{			
-			process_image_jpg_mt();
+		{
+			if (_hwMjpegDevice.isEmpty() || V4L2M2MDecoder::isDisabled() || !process_image_jpg_hw())
+				process_image_jpg_mt();
 		}
 		else
 		{
-			if (_qframe)
+			CacheMissCounter cacheMisses;
+
+			if (_decodeTargetWidth > 0)
 			{
-				Image<ColorRgb> image(_width >> 1, _height >> 1);
+				int factor = FrameDecoder::getDownscaleFactor(_width - _cropLeft - _cropRight, _height - _cropTop - _cropBottom, _decodeTargetWidth, _qframe);
+				Image<ColorRgb> image = acquireFrame((_width - _cropLeft - _cropRight) / factor, (_height - _cropTop - _cropBottom) / factor);
+
+				FrameDecoder::processImageRegion(
+					_cropLeft, _cropRight, _cropTop, _cropBottom,
+					_sharedData, _width, _height, _lineLength, _pixelFormat, _lutBuffer, factor, _skippedArea, image, _compactLut);
+
+				emit newFrame(_bufferIndex, image, _currentFrame, _frameBegin);
+			}
+			else if (_qframe)
+			{
+				Image<ColorRgb> image = acquireFrame(_width >> 1, _height >> 1);
 				FrameDecoder::processQImage(
-					_sharedData, _width, _height, _lineLength, _pixelFormat, _lutBuffer, image);
+					_sharedData, _width, _height, _lineLength, _pixelFormat, _lutBuffer, image, _compactLut);
 
-				emit newFrame(_workerIndex, image, _currentFrame, _frameBegin);
+				emit newFrame(_bufferIndex, image, _currentFrame, _frameBegin);
 
 			}
 			else
@@ -210,39 +385,93 @@ void V4L2Worker::runMe()
 				int outputWidth = (_width - _cropLeft - _cropRight);
 				int outputHeight = (_height - _cropTop - _cropBottom);
 
-				Image<ColorRgb> image(outputWidth, outputHeight);
-
-				FrameDecoder::processImage(
-					_cropLeft, _cropRight, _cropTop, _cropBottom,
-					_sharedData, _width, _height, _lineLength, _pixelFormat, _lutBuffer, image);
-
-				emit newFrame(_workerIndex, image, _currentFrame, _frameBegin);
+				Image<ColorRgb> image = acquireFrame(outputWidth, outputHeight);
+
+				// the skipped centre leaves too little work to split it into stripes
+				if (!_skippedArea.isEmpty())
+					FrameDecoder::processImageRegion(
+						_cropLeft, _cropRight, _cropTop, _cropBottom,
+						_sharedData, _width, _height, _lineLength, _pixelFormat, _lutBuffer, 1, _skippedArea, image, _compactLut);
+				else if (_decodeStripes > 1)
+					StripedDecoder::processImage(_decodeStripes,
+						_cropLeft, _cropRight, _cropTop, _cropBottom,
+						_sharedData, _width, _height, _lineLength, _pixelFormat, _lutBuffer, image, _compactLut);
+				else
+					FrameDecoder::processImage(
+						_cropLeft, _cropRight, _cropTop, _cropBottom,
+						_sharedData, _width, _height, _lineLength, _pixelFormat, _lutBuffer, image, _compactLut);
+
+				emit newFrame(_bufferIndex, image, _currentFrame, _frameBegin);
 			}
 		}
 	}
 }
 
-void V4L2Worker::startOnThisThread()
+Image<ColorRgb> V4L2Worker::acquireFrame(unsigned width, unsigned height)
 {
-	runMe();
+	if (_frameRing != nullptr)
+		return _frameRing->acquire(width, height);
+
+	return Image<ColorRgb>(width, height);
 }
 
-bool V4L2Worker::isBusy()
+uint8_t* V4L2Worker::getJpegBuffer(size_t size)
 {
-	bool temp = false;
+	// grows only, so the steady-state capture doesn't allocate
+	if (_jpegBuffer.size() < size)
+		_jpegBuffer.resize(size);
 
-	if (_isBusy.compare_exchange_strong(temp, true))
-		return false;
-	else
-		return true;
+	return _jpegBuffer.data();
 }
 
-void V4L2Worker::noBusy()
+void V4L2Worker::startOnThisThread()
 {
-	_isBusy = false;
+	runMe();
+	_lut = nullptr;
 }
 
 
+bool V4L2Worker::process_image_jpg_hw()
+{
+	// the NV12 output requires the YUV LUT
+	if (_lutBuffer == nullptr && (_compactLut == nullptr || !_compactLut->isValid()))
+		return false;
+
+	if (_hwDecoder == nullptr)
+	{
+		_hwDecoder = new V4L2M2MDecoder();
+
+		if (!_hwDecoder->open(_hwMjpegDevice))
+		{
+			delete _hwDecoder;
+			_hwDecoder = nullptr;
+			V4L2M2MDecoder::setDisabled(true);
+			return false;
+		}
+	}
+
+	if (!_hwDecoder->decode(_sharedData, _size, _width, _height))
+	{
+		delete _hwDecoder;
+		_hwDecoder = nullptr;
+		V4L2M2MDecoder::setDisabled(true);
+		return false;
+	}
+
+	// the NV12 output goes to the regular LUT path, the rows aligned by the driver below the frame are cropped
+	const int planeHeight = _hwDecoder->planeHeight();
+	const uint cropBottom = _cropBottom + (planeHeight - _height);
+
+	int factor = FrameDecoder::getDownscaleFactor(_width - _cropLeft - _cropRight, _height - _cropTop - _cropBottom, _decodeTargetWidth, _qframe);
+	Image<ColorRgb> image = acquireFrame((_width - _cropLeft - _cropRight) / factor, (_height - _cropTop - _cropBottom) / factor);
+
+	FrameDecoder::processImageDownscaled(_cropLeft, _cropRight, _cropTop, cropBottom,
+		_hwDecoder->data(), _width, planeHeight, _hwDecoder->lineLength(), PixelFormat::NV12, _lutBuffer, factor, image, _compactLut);
+
+	emit newFrame(_bufferIndex, image, _currentFrame, _frameBegin);
+	return true;
+}
+
 void V4L2Worker::process_image_jpg_mt()
 {
 	if (_decompress == nullptr)
@@ -251,70 +480,80 @@ void V4L2Worker::process_image_jpg_mt()
 	if (tjDecompressHeader2(_decompress, const_cast<uint8_t*>(_sharedData), _size, &_width, &_height, &_subsamp) != 0 &&
 		tjGetErrorCode(_decompress) == TJERR_FATAL)
 	{
-		emit newFrameError(_workerIndex, QString(tjGetErrorStr()), _currentFrame);
+		emit newFrameError(_bufferIndex, QString(tjGetErrorStr()), _currentFrame);
 		return;
 	}
 
 	if ((_subsamp != TJSAMP_422 && _subsamp != TJSAMP_420) && _hdrToneMappingEnabled > 0)
 	{
-		emit newFrameError(_workerIndex, QString("%1: %2").arg(UNSUPPORTED_DECODER).arg(_subsamp), _currentFrame);
+		emit newFrameError(_bufferIndex, QString("%1: %2").arg(UNSUPPORTED_DECODER).arg(_subsamp), _currentFrame);
 		return;
 	}
 
-	tjscalingfactor sca{ 1, 2 };
+	// let the DCT do the downscaling, turbojpeg only accepts its own scaling factors
+	tjscalingfactor sca{ 1, 1 };
+	int scalingFactorsCount = 0;
+	tjscalingfactor* scalingFactors = tjGetScalingFactors(&scalingFactorsCount);
+
+	for (int i = 0; scalingFactors != nullptr && i < scalingFactorsCount; i++)
+		if (scalingFactors[i].num == 1 && scalingFactors[i].denom == _mjpegScale)
+			sca = scalingFactors[i];
 
-	_width = (_qframe) ? TJSCALED(_width, sca) : _width;
-	_height = (_qframe) ? TJSCALED(_height, sca) : _height;
+	if (sca.denom > 1)
+	{
+		_width = TJSCALED(_width, sca);
+		_height = TJSCALED(_height, sca);
+		_cropLeft /= sca.denom;
+		_cropRight /= sca.denom;
+		_cropTop /= sca.denom;
+		_cropBottom /= sca.denom;
+	}
 
-	Image<ColorRgb> image(_width - _cropLeft - _cropRight, _height - _cropTop - _cropBottom);
+	Image<ColorRgb> image = acquireFrame(_width - _cropLeft - _cropRight, _height - _cropTop - _cropBottom);
+
+	int factor = (_decodeTargetWidth > 0) ? FrameDecoder::getDownscaleFactor(image.width(), image.height(), _decodeTargetWidth, false) : 1;
 
 	if (_hdrToneMappingEnabled > 0)
 	{
 		size_t yuvSize = tjBufSizeYUV2(_width, 2, _height, _subsamp);
-		uint8_t* jpegBuffer = (uint8_t*)malloc(yuvSize);
+		uint8_t* jpegBuffer = getJpegBuffer(yuvSize);
 
 		if (tjDecompressToYUV2(_decompress, const_cast<uint8_t*>(_sharedData), _size, jpegBuffer, _width, 2, _height, TJFLAG_FASTDCT | TJFLAG_FASTUPSAMPLE) != 0 &&
 			tjGetErrorCode(_decompress) == TJERR_FATAL)
 		{
-			free(jpegBuffer);
-
-			emit newFrameError(_workerIndex, QString(tjGetErrorStr()), _currentFrame);
+			emit newFrameError(_bufferIndex, QString(tjGetErrorStr()), _currentFrame);
 			return;
 		}
 
-		FrameDecoder::processImage(_cropLeft, _cropRight, _cropTop, _cropBottom,
-			jpegBuffer, _width, _height, _width, (_subsamp == TJSAMP_422) ? PixelFormat::MJPEG : PixelFormat::I420, _lutBuffer, image);
+		FrameDecoder::processImageDownscaled(_cropLeft, _cropRight, _cropTop, _cropBottom,
+			jpegBuffer, _width, _height, _width, (_subsamp == TJSAMP_422) ? PixelFormat::MJPEG : PixelFormat::I420, _lutBuffer, factor, image, _compactLut);
 
-		free(jpegBuffer);
 	}
-	else if (image.width() != (uint)_width || image.height() != (uint)_height)
+	else if (image.width() != (uint)_width || image.height() != (uint)_height || factor > 1)
 	{
-		uint8_t* jpegBuffer = (uint8_t*)malloc(static_cast<size_t>(_width) * _height * 3);
+		uint8_t* jpegBuffer = getJpegBuffer(static_cast<size_t>(_width) * _height * 3);
 
 		if (tjDecompress2(_decompress, const_cast<uint8_t*>(_sharedData), _size, (uint8_t*)jpegBuffer, _width, 0, _height, TJPF_BGR, TJFLAG_BOTTOMUP | TJFLAG_FASTDCT | TJFLAG_FASTUPSAMPLE) != 0 &&
 			tjGetErrorCode(_decompress) == TJERR_FATAL)
 		{
-			free(jpegBuffer);
-
-			emit newFrameError(_workerIndex, QString(tjGetErrorStr()), _currentFrame);
+			emit newFrameError(_bufferIndex, QString(tjGetErrorStr()), _currentFrame);
 			return;
 		}
 
-		FrameDecoder::processImage(_cropLeft, _cropRight, _cropTop, _cropBottom,
-			jpegBuffer, _width, _height, _width * 3, PixelFormat::RGB24, nullptr, image);
+		FrameDecoder::processImageDownscaled(_cropLeft, _cropRight, _cropTop, _cropBottom,
+			jpegBuffer, _width, _height, _width * 3, PixelFormat::RGB24, nullptr, factor, image);
 
-		free(jpegBuffer);
 	}
 	else
 	{
 		if (tjDecompress2(_decompress, const_cast<uint8_t*>(_sharedData), _size, image.rawMem(), _width, 0, _height, TJPF_RGB, TJFLAG_FASTDCT | TJFLAG_FASTUPSAMPLE) != 0 &&
 			tjGetErrorCode(_decompress) == TJERR_FATAL)
 		{
-			emit newFrameError(_workerIndex, QString(tjGetErrorStr()), _currentFrame);
+			emit newFrameError(_bufferIndex, QString(tjGetErrorStr()), _currentFrame);
 			return;
 		}
 	}
 
 
-	emit newFrame(_workerIndex, image, _currentFrame, _frameBegin);
+	emit newFrame(_bufferIndex, image, _currentFrame, _frameBegin);
 }
@@ -0,0 +1,582 @@
+// stl includes
+#include <deque>
+#include <iostream>
+
+// Qt includes
+#include <QHostInfo>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QMap>
+#include <QStringList>
+#include <QTcpSocket>
+#include <QUdpSocket>
+
+// hyperhdr-remote includes
+#include "LoadGenerator.h"
+
+// hyperhdr includes
+#include <flatbufserver/FlatBufferConnection.h>
+#include <utils/PreciseTimer.h>
+#include <utils/QStringUtils.h>
+
+namespace
+{
+	/// the frames sent in turn by every client
+	const int FRAME_CYCLE = 8;
+
+	/// the frames of a TCP client waiting for the reply, a tick with a full window drops its frame
+	const int MAX_IN_FLIGHT = 4;
+
+	/// the network servers register the priorities 100 .. 199, every client gets its own one
+	const int FIRST_PRIORITY = 100;
+	const int MAX_CLIENTS = 100;
+
+	void appendVarint(QByteArray& target, uint64_t value)
+	{
+		while (value >= 0x80)
+		{
+			target.append(static_cast<char>((value & 0x7F) | 0x80));
+			value >>= 7;
+		}
+		target.append(static_cast<char>(value));
+	}
+
+	bool readVarint(const uint8_t*& data, const uint8_t* end, uint64_t& value)
+	{
+		value = 0;
+		for (int shift = 0; data < end && shift < 64; shift += 7)
+		{
+			const uint8_t byte = *(data++);
+			value |= static_cast<uint64_t>(byte & 0x7F) << shift;
+			if ((byte & 0x80) == 0)
+				return true;
+		}
+		return false;
+	}
+}
+
+struct LoadGenerator::Client
+{
+	Client(Protocol _protocol, int _priority) :
+		protocol(_protocol),
+		priority(_priority),
+		period((_protocol == FLATBUFFER) ? 1000 : 100)
+	{
+	}
+
+	Protocol	protocol;
+	int			priority;
+	unsigned	frame = 0;
+
+	std::unique_ptr<PreciseTimer> timer;
+	std::unique_ptr<QTcpSocket> socket;
+	std::unique_ptr<QUdpSocket> udp;
+	std::unique_ptr<FlatBufferConnection> flatbuffer;
+
+	/// the partial reply of the server
+	QByteArray	received;
+	/// the send time of the frames in flight [ns]: by the tan for JSON, in order for proto
+	QMap<int, qint64> jsonPending;
+	std::deque<qint64> protoPending;
+	int			nextTan = 1;
+
+	Totals		period;
+};
+
+LoadGenerator::Totals::Totals(int resolution_us) :
+	latency(resolution_us)
+{
+}
+
+void LoadGenerator::Totals::add(const Totals& other)
+{
+	offered += other.offered;
+	sent += other.sent;
+	accepted += other.accepted;
+	rejected += other.rejected;
+	dropped += other.dropped;
+	missed += other.missed;
+	bytes += other.bytes;
+	latency.merge(other.latency);
+}
+
+QString LoadGenerator::parseClients(const QString& spec, Config& config)
+{
+	int total = 0;
+
+	for (const QString& entry : QStringUtils::SPLITTER(spec, ','))
+	{
+		const QStringList parts = entry.trimmed().split('=');
+		if (parts.size() != 2)
+			return QString("Wrong client list entry: '%1', expected protocol=count[:port]").arg(entry);
+
+		int protocol = 0;
+		while (protocol < PROTOCOLS && protocolName(static_cast<Protocol>(protocol)) != parts[0].trimmed().toLower())
+			protocol++;
+
+		if (protocol == PROTOCOLS)
+			return QString("Unknown protocol: '%1', use json, flatbuffer, proto or udp").arg(parts[0]);
+
+		const QStringList value = parts[1].split(':');
+		bool ok = false;
+		const int count = value[0].toInt(&ok);
+		if (!ok || count < 0 || value.size() > 2)
+			return QString("Wrong number of clients: '%1'").arg(parts[1]);
+
+		if (value.size() == 2)
+		{
+			const quint16 port = value[1].toUShort(&ok);
+			if (!ok || port == 0)
+				return QString("Wrong port: '%1'").arg(value[1]);
+			config.ports[protocol] = port;
+		}
+
+		config.clients[protocol] = count;
+	}
+
+	for (int protocol = 0; protocol < PROTOCOLS; protocol++)
+		total += config.clients[protocol];
+
+	if (total == 0)
+		return "No clients for the stress test";
+
+	if (total > MAX_CLIENTS)
+		return QString("Too many clients: %1, the servers register at most %2 priorities").arg(total).arg(MAX_CLIENTS);
+
+	return QString();
+}
+
+LoadGenerator::LoadGenerator(const Config& config, QObject* parent)
+	: QObject(parent)
+	, _config(config)
+	, _totals{ Totals(100), Totals(1000), Totals(100), Totals(100) }
+	, _startTime(0)
+	, _lastReport(0)
+{
+	_config.width = qMax(_config.width, 1);
+	_config.height = qMax(_config.height, 1);
+	_config.leds = qMax(_config.leds, 1);
+	_config.rate = qBound(1, _config.rate, 1000);
+
+	_reportTimer.setInterval(1000);
+	connect(&_reportTimer, &QTimer::timeout, this, &LoadGenerator::report);
+
+	_stopTimer.setSingleShot(true);
+	connect(&_stopTimer, &QTimer::timeout, this, &LoadGenerator::stop);
+}
+
+LoadGenerator::~LoadGenerator()
+{
+	// the timers first: no tick reaches a client that is being destroyed
+	for (auto& client : _clients)
+		client->timer.reset();
+}
+
+QString LoadGenerator::protocolName(Protocol protocol)
+{
+	switch (protocol)
+	{
+		case JSON: return "json";
+		case FLATBUFFER: return "flatbuffer";
+		case PROTO: return "proto";
+		default: return "udp";
+	}
+}
+
+void LoadGenerator::createFrames()
+{
+	for (int f = 0; f < FRAME_CYCLE; f++)
+	{
+		const int shift = f * 256 / FRAME_CYCLE;
+
+		// a gradient moving with every frame, the mapping and the smoothing get real work
+		Image<ColorRgb> image(_config.width, _config.height);
+		uint8_t* pixel = image.rawMem();
+		for (int y = 0; y < _config.height; y++)
+			for (int x = 0; x < _config.width; x++)
+			{
+				*(pixel++) = static_cast<uint8_t>(x * 255 / _config.width + shift);
+				*(pixel++) = static_cast<uint8_t>(y * 255 / _config.height + shift);
+				*(pixel++) = static_cast<uint8_t>(shift);
+			}
+
+		QByteArray colors(_config.leds * 3, Qt::Uninitialized);
+		for (int i = 0; i < _config.leds; i++)
+		{
+			colors[i * 3] = static_cast<char>(i * 255 / _config.leds + shift);
+			colors[i * 3 + 1] = static_cast<char>(255 - i * 255 / _config.leds);
+			colors[i * 3 + 2] = static_cast<char>(shift);
+		}
+
+		_base64.push_back(QByteArray::fromRawData(reinterpret_cast<const char*>(image.rawMem()), static_cast<int>(image.size())).toBase64());
+		_images.push_back(image);
+		_ledColors.push_back(colors);
+	}
+}
+
+void LoadGenerator::start()
+{
+	createFrames();
+
+	if (_config.clients[UDP] > 0)
+	{
+		_udpAddress = QHostAddress(_config.host);
+		if (_udpAddress.isNull())
+		{
+			const QHostInfo info = QHostInfo::fromName(_config.host);
+			if (!info.addresses().isEmpty())
+				_udpAddress = info.addresses().first();
+		}
+	}
+
+	const QString address = QString("%1:%2").arg(_config.host).arg(_config.ports[FLATBUFFER]);
+	int priority = FIRST_PRIORITY;
+
+	for (int protocol = 0; protocol < PROTOCOLS; protocol++)
+		for (int i = 0; i < _config.clients[protocol]; i++)
+		{
+			_clients.emplace_back(new Client(static_cast<Protocol>(protocol), priority++));
+			Client* client = _clients.back().get();
+
+			if (protocol == FLATBUFFER)
+			{
+				client->flatbuffer.reset(new FlatBufferConnection(QString("Stress flatbuffer %1").arg(i + 1), address, client->priority, false));
+			}
+			else if (protocol == UDP)
+			{
+				client->udp.reset(new QUdpSocket());
+			}
+			else
+			{
+				client->socket.reset(new QTcpSocket());
+				client->socket->setSocketOption(QAbstractSocket::LowDelayOption, 1);
+
+				if (protocol == JSON)
+				{
+					connect(client->socket.get(), &QTcpSocket::readyRead, this, [this, client]() { readJson(client); });
+
+					if (!_config.token.isEmpty())
+						connect(client->socket.get(), &QTcpSocket::connected, this, [this, client]() {
+							// the reply (tan 0) is not one of the frames
+							client->socket->write("{\"command\":\"authorize\",\"subcommand\":\"login\",\"tan\":0,\"token\":\"" + _config.token.toUtf8() + "\"}\n");
+						});
+				}
+				else
+					connect(client->socket.get(), &QTcpSocket::readyRead, this, [this, client]() { readProto(client); });
+
+				client->socket->connectToHost(_config.host, _config.ports[protocol]);
+			}
+
+			client->timer.reset(new PreciseTimer());
+			client->timer->setInterval(qMax(1000 / _config.rate, 1));
+			connect(client->timer.get(), &PreciseTimer::timeout, this, [this, client]() { tick(client); });
+		}
+
+	std::cout << "Stress test of " << _config.host.toStdString() << " for " << _config.duration << "s: " <<
+		_config.rate << " fps per client, images " << _config.width << "x" << _config.height << ", " << _config.leds << " LEDs for UDP" << std::endl;
+
+	for (auto& client : _clients)
+		client->timer->start();
+
+	_startTime = _lastReport = PreciseTimer::now();
+	_reportTimer.start();
+	_stopTimer.start(qMax(_config.duration, 1) * 1000);
+}
+
+void LoadGenerator::tick(Client* client)
+{
+	client->period.offered++;
+
+	switch (client->protocol)
+	{
+		case JSON:
+			sendJson(client);
+			break;
+		case FLATBUFFER:
+			// latest wins: the connection counts the dropped frames and the replies
+			client->flatbuffer->setImage(_images[client->frame % FRAME_CYCLE]);
+			break;
+		case PROTO:
+			sendProto(client);
+			break;
+		default:
+			sendUdp(client);
+	}
+
+	client->frame++;
+}
+
+void LoadGenerator::sendJson(Client* client)
+{
+	if (client->socket->state() != QAbstractSocket::ConnectedState || client->jsonPending.size() >= MAX_IN_FLIGHT)
+	{
+		client->period.dropped++;
+		return;
+	}
+
+	const int tan = client->nextTan++;
+
+	// the megabytes of base64 are not parsed again by the QJsonDocument of every frame
+	QByteArray message;
+	message.reserve(_base64[0].size() + 192);
+	message.append("{\"command\":\"image\",\"origin\":\"hyperhdr-remote\",\"tan\":");
+	message.append(QByteArray::number(tan));
+	message.append(",\"priority\":");
+	message.append(QByteArray::number(client->priority));
+	message.append(",\"imagewidth\":");
+	message.append(QByteArray::number(_config.width));
+	message.append(",\"imageheight\":");
+	message.append(QByteArray::number(_config.height));
+	message.append(",\"imagedata\":\"");
+	message.append(_base64[client->frame % FRAME_CYCLE]);
+	message.append("\"}\n");
+
+	client->jsonPending[tan] = PreciseTimer::now();
+	client->socket->write(message);
+	client->period.sent++;
+	client->period.bytes += message.size();
+}
+
+void LoadGenerator::sendProto(Client* client)
+{
+	if (client->socket->state() != QAbstractSocket::ConnectedState || client->protoPending.size() >= MAX_IN_FLIGHT)
+	{
+		client->period.dropped++;
+		return;
+	}
+
+	const Image<ColorRgb>& image = _images[client->frame % FRAME_CYCLE];
+
+	// HyperhdrRequest { command = IMAGE, imageRequest (extension 11) = ImageRequest { priority, width, height, data } }
+	QByteArray request;
+	request.append(char(0x08));
+	appendVarint(request, static_cast<uint64_t>(client->priority));
+	request.append(char(0x10));
+	appendVarint(request, static_cast<uint64_t>(_config.width));
+	request.append(char(0x18));
+	appendVarint(request, static_cast<uint64_t>(_config.height));
+	request.append(char(0x22));
+	appendVarint(request, image.size());
+
+	QByteArray header;
+	header.append(char(0x08));
+	header.append(char(0x02));
+	header.append(char(0x5A));
+	appendVarint(header, request.size() + image.size());
+	header.append(request);
+
+	const uint32_t size = static_cast<uint32_t>(header.size() + image.size());
+	const char length[] = { char(size >> 24), char(size >> 16), char(size >> 8), char(size) };
+
+	client->protoPending.push_back(PreciseTimer::now());
+	client->socket->write(length, sizeof(length));
+	client->socket->write(header);
+	client->socket->write(reinterpret_cast<const char*>(image.rawMem()), static_cast<qint64>(image.size()));
+	client->period.sent++;
+	client->period.bytes += sizeof(length) + size;
+}
+
+void LoadGenerator::sendUdp(Client* client)
+{
+	const QByteArray& colors = _ledColors[client->frame % FRAME_CYCLE];
+
+	if (_udpAddress.isNull() || client->udp->writeDatagram(colors, _udpAddress, _config.ports[UDP]) < 0)
+	{
+		client->period.dropped++;
+		return;
+	}
+
+	client->period.sent++;
+	client->period.bytes += colors.size();
+}
+
+void LoadGenerator::readJson(Client* client)
+{
+	client->received.append(client->socket->readAll());
+
+	int end;
+	while ((end = client->received.indexOf('\n')) >= 0)
+	{
+		const QJsonObject reply = QJsonDocument::fromJson(client->received.left(end)).object();
+		client->received.remove(0, end + 1);
+
+		// the other messages (ex. the reply of the login) are not the frames
+		auto frame = client->jsonPending.find(reply["tan"].toInt(-1));
+		if (frame == client->jsonPending.end())
+			continue;
+
+		client->period.latency.add((PreciseTimer::now() - frame.value()) / 100000);
+		client->jsonPending.erase(frame);
+
+		if (reply["success"].toBool(false))
+			client->period.accepted++;
+		else
+		{
+			client->period.rejected++;
+			if (_firstError.isEmpty())
+				_firstError = "json: " + reply["error"].toString("no error info");
+		}
+	}
+}
+
+void LoadGenerator::readProto(Client* client)
+{
+	client->received.append(client->socket->readAll());
+
+	while (client->received.size() >= 4)
+	{
+		const uint8_t* data = reinterpret_cast<const uint8_t*>(client->received.constData());
+		const uint32_t size = (uint32_t(data[0]) << 24) | (uint32_t(data[1]) << 16) | (uint32_t(data[2]) << 8) | uint32_t(data[3]);
+
+		if (static_cast<uint32_t>(client->received.size()) < size + 4)
+			break;
+
+		// HyperhdrReply { type = 1, success = 2, error = 3, video = 4 }
+		const uint8_t* position = data + 4;
+		const uint8_t* end = position + size;
+		uint64_t type = 0, success = 0;
+		QString error;
+
+		while (position < end)
+		{
+			uint64_t key, value;
+			if (!readVarint(position, end, key))
+				break;
+
+			const int wire = static_cast<int>(key & 7);
+			if (wire == 0)
+			{
+				if (!readVarint(position, end, value))
+					break;
+				if ((key >> 3) == 1)
+					type = value;
+				else if ((key >> 3) == 2)
+					success = value;
+			}
+			else if (wire == 2)
+			{
+				if (!readVarint(position, end, value) || value > static_cast<uint64_t>(end - position))
+					break;
+				if ((key >> 3) == 3)
+					error = QString::fromUtf8(reinterpret_cast<const char*>(position), static_cast<int>(value));
+				position += value;
+			}
+			else if (wire == 5 && end - position >= 4)
+				position += 4;
+			else if (wire == 1 && end - position >= 8)
+				position += 8;
+			else
+				break;
+		}
+
+		client->received.remove(0, static_cast<int>(size) + 4);
+
+		// the replies come in the order of the requests, the video mode messages are not one of them
+		if (type != 1 || client->protoPending.empty())
+			continue;
+
+		client->period.latency.add((PreciseTimer::now() - client->protoPending.front()) / 100000);
+		client->protoPending.pop_front();
+
+		if (success)
+			client->period.accepted++;
+		else
+		{
+			client->period.rejected++;
+			if (_firstError.isEmpty())
+				_firstError = "proto: " + error;
+		}
+	}
+}
+
+void LoadGenerator::collect(Client* client, Totals& period)
+{
+	if (client->flatbuffer != nullptr)
+	{
+		FlatBufferConnection::ForwardStats stats = client->flatbuffer->takeForwardStats();
+
+		client->period.sent += stats.sent;
+		client->period.accepted += stats.sent - stats.rejected;
+		client->period.rejected += stats.rejected;
+		client->period.dropped += stats.dropped;
+		client->period.bytes += stats.sent * static_cast<qint64>(_images[0].size());
+		client->period.latency.merge(stats.lag);
+	}
+
+	client->period.missed += client->timer->takeJitterStats().missed;
+
+	period.add(client->period);
+	client->period = Totals(client->period.latency.resolution());
+}
+
+void LoadGenerator::printTotals(const QString& label, Protocol protocol, const Totals& totals, double seconds) const
+{
+	QString line = QString("%1 %2 x%3: %4 fps, %5 MB/s").arg(label, 6).arg(protocolName(protocol), -10).arg(_config.clients[protocol], -3).
+		arg(totals.sent / seconds, 7, 'f', 1).arg(totals.bytes / seconds / (1024 * 1024), 6, 'f', 2);
+
+	if (protocol != UDP)
+	{
+		const qint64 replied = totals.accepted + totals.rejected;
+		line += QString(", accepted %1%").arg((replied > 0) ? totals.accepted * 100.0 / replied : 0.0, 5, 'f', 1);
+		line += QString(", rejected %1, dropped %2").arg(totals.rejected).arg(totals.dropped);
+	}
+	else
+		line += QString(", dropped %1").arg(totals.dropped);
+
+	if (totals.missed > 0)
+		line += QString(", missed ticks %1").arg(totals.missed);
+
+	if (protocol != UDP)
+		line += ", latency " + ((totals.latency.count() > 0) ? totals.latency.toString() : QString("none"));
+
+	std::cout << line.toStdString() << std::endl;
+}
+
+void LoadGenerator::report()
+{
+	const qint64 now = PreciseTimer::now();
+	const double seconds = qMax((now - _lastReport) / 1e9, 0.001);
+	const QString label = QString("%1s").arg((now - _startTime) / 1000000000);
+
+	_lastReport = now;
+
+	for (int protocol = 0; protocol < PROTOCOLS; protocol++)
+	{
+		if (_config.clients[protocol] == 0)
+			continue;
+
+		Totals period(_totals[protocol].latency.resolution());
+
+		for (auto& client : _clients)
+			if (client->protocol == protocol)
+				collect(client.get(), period);
+
+		_totals[protocol].add(period);
+		printTotals(label, static_cast<Protocol>(protocol), period, seconds);
+	}
+}
+
+void LoadGenerator::stop()
+{
+	for (auto& client : _clients)
+		client->timer->stop();
+
+	_reportTimer.stop();
+	report();
+
+	const double seconds = qMax((_lastReport - _startTime) / 1e9, 0.001);
+
+	std::cout << "Summary:" << std::endl;
+	for (int protocol = 0; protocol < PROTOCOLS; protocol++)
+		if (_config.clients[protocol] > 0)
+			printTotals("total", static_cast<Protocol>(protocol), _totals[protocol], seconds);
+
+	if (!_firstError.isEmpty())
+		std::cout << "First refused frame: " << _firstError.toStdString() << std::endl;
+
+	for (auto& client : _clients)
+		if (client->socket != nullptr)
+			client->socket->disconnectFromHost();
+
+	emit finished();
+}
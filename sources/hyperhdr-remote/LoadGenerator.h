@@ -0,0 +1,126 @@
+#pragma once
+
+// stl includes
+#include <memory>
+#include <vector>
+
+// Qt includes
+#include <QObject>
+#include <QString>
+#include <QByteArray>
+#include <QHostAddress>
+#include <QTimer>
+
+// util includes
+#include <utils/Image.h>
+#include <utils/ColorRgb.h>
+#include <utils/LatencyHistogram.h>
+
+///
+/// Stress test of the servers of HyperHDR: every client is a separate connection that sends a synthetic
+/// frame on each tick of its own timer, like an independent sender (ex. a grabber on another host).
+/// The JSON, flatbuffer and proto clients count the replies of the server, so the report tells the
+/// throughput, how many frames the server accepted and the round trip latency of the frames. The raw UDP
+/// clients get no reply, only their throughput is known.
+///
+/// A TCP client keeps at most a few frames in flight: a tick with a full window is a dropped frame, the
+/// server does not keep up with the offered rate. A missed tick is a frame the generator itself was
+/// too late to send, the numbers of that client are not the limit of the server then.
+///
+class LoadGenerator : public QObject
+{
+	Q_OBJECT
+
+public:
+	enum Protocol { JSON = 0, FLATBUFFER, PROTO, UDP, PROTOCOLS };
+
+	struct Config
+	{
+		QString	host = "127.0.0.1";
+		int		clients[PROTOCOLS] = { 0, 0, 0, 0 };
+		quint16	ports[PROTOCOLS] = { 19444, 19400, 19445, 5568 };
+		/// the size of the images, the UDP clients send the colors of the LEDs
+		int		width = 160;
+		int		height = 90;
+		int		leds = 100;
+		/// frames per second of every client
+		int		rate = 25;
+		/// [s]
+		int		duration = 10;
+		QString	token;
+	};
+
+	///
+	/// @brief Parse the clients of the stress test, ex. "json=2,flatbuffer=4:19401,udp=1"
+	/// @param spec The comma separated protocol=count[:port] list
+	/// @param config The configuration that gets the clients and the ports
+	/// @return empty on success, else the error
+	///
+	static QString parseClients(const QString& spec, Config& config);
+
+	explicit LoadGenerator(const Config& config, QObject* parent = nullptr);
+	~LoadGenerator() override;
+
+	///
+	/// @brief Connect the clients and start the ticks, finished() is emitted after the duration
+	///
+	void start();
+
+signals:
+	void finished();
+
+private slots:
+	void report();
+	void stop();
+
+private:
+	struct Client;
+
+	/// the frames of one client or protocol, the latency is the round trip to the reply
+	struct Totals
+	{
+		explicit Totals(int resolution_us);
+		void add(const Totals& other);
+
+		qint64	offered = 0;
+		qint64	sent = 0;
+		qint64	accepted = 0;
+		qint64	rejected = 0;
+		qint64	dropped = 0;
+		qint64	missed = 0;
+		qint64	bytes = 0;
+		LatencyHistogram latency;
+	};
+
+	void createFrames();
+
+	void tick(Client* client);
+	void sendJson(Client* client);
+	void sendProto(Client* client);
+	void sendUdp(Client* client);
+	void readJson(Client* client);
+	void readProto(Client* client);
+	void collect(Client* client, Totals& period);
+
+	void printTotals(const QString& label, Protocol protocol, const Totals& totals, double seconds) const;
+
+	static QString protocolName(Protocol protocol);
+
+private:
+	Config		_config;
+	QHostAddress _udpAddress;
+
+	/// the frames are prepared once and sent in turn, the generator costs no more than the sockets
+	std::vector<Image<ColorRgb>> _images;
+	std::vector<QByteArray> _base64;
+	std::vector<QByteArray> _ledColors;
+
+	std::vector<std::unique_ptr<Client>> _clients;
+	Totals		_totals[PROTOCOLS];
+
+	QTimer		_reportTimer;
+	QTimer		_stopTimer;
+	qint64		_startTime;
+	qint64		_lastReport;
+	QString		_firstError;
+};
@@ -11,6 +11,7 @@
 
 // hyperhdr-remote include
 #include "JsonConnection.h"
+#include "LoadGenerator.h"
 
 // ssdp discover
 #include <ssdp/SSDPDiscover.h>
@@ -130,6 +131,11 @@ int main(int argc, char* argv[])
 		BooleanOption&    argConfigGet          = parser.add<BooleanOption>(0x0, "configGet"              , "Print the current loaded HyperHDR configuration file");
 		BooleanOption&    argSchemaGet          = parser.add<BooleanOption>(0x0, "schemaGet"              , "Print the JSON schema for HyperHDR configuration");
 		Option&           argConfigSet          = parser.add<Option>       (0x0, "configSet"              , "Write to the actual loaded configuration file. Should be a JSON object string.");
+		Option&           argStress             = parser.add<Option>       (0x0, "stress"                 , "Stress test the servers with clients sending frames, ex. json=2,flatbuffer=4,proto=1,udp=2 (protocol=count[:port])");
+		IntOption&        argStressRate         = parser.add<IntOption>    (0x0, "stressRate"             , "Frames per second of every stress test client [default: %1]", "25");
+		IntOption&        argStressDuration     = parser.add<IntOption>    (0x0, "stressDuration"         , "Duration of the stress test in seconds [default: %1]", "10");
+		Option&           argStressSize         = parser.add<Option>       (0x0, "stressSize"             , "Size of the images of the stress test as WIDTHxHEIGHT [default: %1]", "160x90");
+		IntOption&        argStressLeds         = parser.add<IntOption>    (0x0, "stressLeds"             , "Number of the LED colors in the datagrams of the UDP stress test clients [default: %1]", "100");
 
 		// parse all _options
 		parser.process(app);
@@ -149,7 +155,7 @@ int main(int argc, char* argv[])
 		int commandCount = count({ parser.isSet(argColor), parser.isSet(argImage), parser.isSet(argEffect),
 			parser.isSet(argServerInfo), parser.isSet(argSysInfo),parser.isSet(argClear), parser.isSet(argClearAll), parser.isSet(argEnableComponent), parser.isSet(argDisableComponent), colorAdjust,
 			parser.isSet(argSource), parser.isSet(argSourceAuto), parser.isSet(argOff), parser.isSet(argOn), parser.isSet(argConfigGet), parser.isSet(argSchemaGet), parser.isSet(argConfigSet),
-			parser.isSet(argMapping), parser.isSet(argHdr) });
+			parser.isSet(argMapping), parser.isSet(argHdr), parser.isSet(argStress) });
 		if (commandCount != 1)
 		{
 			qWarning() << (commandCount == 0 ? "No command found." : "Multiple commands found.") << " Provide exactly one of the following options:";
@@ -166,6 +172,7 @@ int main(int argc, char* argv[])
 			showHelp(argSourceAuto);
 			showHelp(argConfigGet);
 			showHelp(argHdr);
+			showHelp(argStress);
 			qWarning() << "or one or more of the available color modding operations:";
 			showHelp(argId);
 			showHelp(argBrightness);
@@ -197,6 +204,39 @@ int main(int argc, char* argv[])
 			}
 		}
 
+		// the stress test runs its own clients in the event loop
+		if (parser.isSet(argStress))
+		{
+			LoadGenerator::Config config;
+			const QStringList parts = address.split(":");
+			const QStringList size = argStressSize.value(parser).split("x");
+
+			if (parts.size() != 2 || parts[1].toUShort() == 0)
+				throw std::runtime_error(QString("Wrong address: unable to parse address (%1)").arg(address).toStdString());
+
+			if (size.size() != 2 || size[0].toInt() <= 0 || size[1].toInt() <= 0)
+				throw std::runtime_error(QString("Wrong image size: %1").arg(argStressSize.value(parser)).toStdString());
+
+			config.host = parts[0];
+			config.ports[LoadGenerator::JSON] = parts[1].toUShort();
+			config.width = size[0].toInt();
+			config.height = size[1].toInt();
+			config.leds = argStressLeds.getInt(parser);
+			config.rate = argStressRate.getInt(parser);
+			config.duration = argStressDuration.getInt(parser);
+			config.token = argToken.value(parser);
+
+			const QString error = LoadGenerator::parseClients(argStress.value(parser), config);
+			if (!error.isEmpty())
+				throw std::runtime_error(error.toStdString());
+
+			LoadGenerator generator(config);
+			QObject::connect(&generator, &LoadGenerator::finished, &app, &QCoreApplication::quit, Qt::QueuedConnection);
+			generator.start();
+
+			return app.exec();
+		}
+
 		// create the connection to the hyperhdr server
 		JsonConnection connection(address, parser.isSet(argPrint));
 
@@ -0,0 +1,368 @@
+/* KernelBenchmark.cpp
+*
+*  MIT License
+*
+*  Copyright (c) 2023 awawa-dev
+*
+*  Project homesite: https://github.com/awawa-dev/HyperHDR
+*
+*  Permission is hereby granted, free of charge, to any person obtaining a copy
+*  of this software and associated documentation files (the "Software"), to deal
+*  in the Software without restriction, including without limitation the rights
+*  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+*  copies of the Software, and to permit persons to whom the Software is
+*  furnished to do so, subject to the following conditions:
+*
+*  The above copyright notice and this permission notice shall be included in all
+*  copies or substantial portions of the Software.
+
+*  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+*  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+*  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+*  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+*  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+*  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+*  SOFTWARE.
+*/
+
+
+#include <chrono>
+#include <iostream>
+#include <iomanip>
+#include <functional>
+#include <vector>
+#include <memory>
+#include <cstring>
+
+#include <QJsonObject>
+#include <QJsonArray>
+
+#include <base/Grabber.h>
+#include <base/ImageToLedsMap.h>
+#include <base/MultiColorAdjustment.h>
+#include <blackborder/BlackBorderDetector.h>
+#include <utils/FrameDecoder.h>
+#include <utils/Logger.h>
+
+#include "KernelBenchmark.h"
+
+using namespace hyperhdr;
+
+namespace
+{
+	// every benchmark is repeated for at least this long, after one untimed call
+	const double MIN_DURATION_MS = 400.0;
+
+	struct Resolution
+	{
+		const char* name;
+		int width;
+		int height;
+	};
+
+	const Resolution RESOLUTIONS[] = { { "720p", 1280, 720 }, { "1080p", 1920, 1080 }, { "4K", 3840, 2160 } };
+
+	struct FormatInfo
+	{
+		PixelFormat format;
+		const char* name;
+		// bytes of a line of the luma plane (or of the packed line)
+		int lineBytesPerPixel;
+		// size of the whole frame relatively to width * height
+		double frameBytesPerPixel;
+	};
+
+	// MJPEG needs a real compressed stream and is left out
+	const FormatInfo FORMATS[] = {
+		{ PixelFormat::YUYV,  "YUYV",  2, 2.0 },
+		{ PixelFormat::RGB24, "RGB24", 3, 3.0 },
+		{ PixelFormat::XRGB,  "XRGB",  4, 4.0 },
+		{ PixelFormat::I420,  "I420",  1, 1.5 },
+		{ PixelFormat::NV12,  "NV12",  1, 1.5 },
+		{ PixelFormat::P010,  "P010",  2, 3.0 },
+		{ PixelFormat::Y210,  "Y210",  4, 4.0 }
+	};
+
+	class Runner
+	{
+	public:
+		Runner(const QString& filter) :
+			_filter(filter),
+			_executed(0)
+		{
+		}
+
+		void measure(const std::string& name, const std::function<void()>& kernel)
+		{
+			if (!_filter.isEmpty() && !QString::fromStdString(name).contains(_filter, Qt::CaseInsensitive))
+				return;
+
+			using clock = std::chrono::steady_clock;
+
+			kernel();
+
+			long iterations = 0;
+			double best = -1, total = 0;
+
+			while (total < MIN_DURATION_MS)
+			{
+				auto start = clock::now();
+				kernel();
+				double elapsed = std::chrono::duration<double, std::milli>(clock::now() - start).count();
+
+				best = (best < 0 || elapsed < best) ? elapsed : best;
+				total += elapsed;
+				iterations++;
+			}
+
+			std::cout << std::left << std::setw(48) << name << std::right
+				<< std::fixed << std::setprecision(1)
+				<< std::setw(12) << (total * 1000.0 / iterations) << " us/iter"
+				<< std::setw(12) << (best * 1000.0) << " us best"
+				<< std::setw(10) << iterations << " iter" << std::endl;
+
+			_executed++;
+		}
+
+		int executed() const
+		{
+			return _executed;
+		}
+
+	private:
+		QString _filter;
+		int     _executed;
+	};
+
+	// a gradient with some noise, so the LUT lookups and the tile hashes are not served from one cache line
+	std::vector<uint8_t> syntheticBuffer(size_t size, uint32_t seed)
+	{
+		std::vector<uint8_t> buffer(size);
+		uint32_t state = seed;
+		for (size_t i = 0; i < size; i++)
+		{
+			state = state * 1664525u + 1013904223u;
+			buffer[i] = static_cast<uint8_t>((i / 7) + (state >> 28));
+		}
+		return buffer;
+	}
+
+	// leds along the four edges, the depth of every area is 8% of the frame like the default layouts
+	std::vector<Led> borderLayout(int horizontal, int vertical)
+	{
+		std::vector<Led> leds;
+		const double depth = 0.08;
+
+		auto add = [&](double minX, double maxX, double minY, double maxY)
+		{
+			Led led;
+			led.minX_frac = minX;
+			led.maxX_frac = maxX;
+			led.minY_frac = minY;
+			led.maxY_frac = maxY;
+			led.disabled = false;
+			led.group = 0;
+			leds.push_back(led);
+		};
+
+		for (int i = 0; i < horizontal; i++)
+			add(double(i) / horizontal, double(i + 1) / horizontal, 0, depth);
+		for (int i = 0; i < vertical; i++)
+			add(1 - depth, 1, double(i) / vertical, double(i + 1) / vertical);
+		for (int i = horizontal - 1; i >= 0; i--)
+			add(double(i) / horizontal, double(i + 1) / horizontal, 1 - depth, 1);
+		for (int i = vertical - 1; i >= 0; i--)
+			add(0, depth, double(i) / vertical, double(i + 1) / vertical);
+
+		return leds;
+	}
+
+	Image<ColorRgb> syntheticImage(int width, int height, int border)
+	{
+		Image<ColorRgb> image(width, height);
+		std::vector<uint8_t> content = syntheticBuffer(image.size(), width);
+		memcpy(image.rawMem(), content.data(), image.size());
+
+		// a letterbox for the black border detector
+		for (int y = 0; y < border; y++)
+		{
+			memset(image.rawMem() + static_cast<size_t>(y) * width * 3, 0, static_cast<size_t>(width) * 3);
+			memset(image.rawMem() + static_cast<size_t>(height - 1 - y) * width * 3, 0, static_cast<size_t>(width) * 3);
+		}
+		return image;
+	}
+
+	std::string caseName(const char* kernel, const char* variant, const Resolution& resolution)
+	{
+		return std::string(kernel) + "/" + variant + "/" + resolution.name;
+	}
+
+	void benchmarkDecoder(Runner& runner, const std::vector<uint8_t>& lut)
+	{
+		for (const Resolution& resolution : RESOLUTIONS)
+			for (const FormatInfo& info : FORMATS)
+			{
+				const std::vector<uint8_t> frame = syntheticBuffer(static_cast<size_t>(resolution.width * resolution.height * info.frameBytesPerPixel), 1);
+				const int lineLength = resolution.width * info.lineBytesPerPixel;
+				Image<ColorRgb> output;
+
+				runner.measure(caseName("processImage", info.name, resolution), [&]()
+				{
+					FrameDecoder::processImage(0, 0, 0, 0, frame.data(), resolution.width, resolution.height, lineLength,
+						info.format, lut.data(), output);
+				});
+
+				const int cropX = resolution.width / 16, cropY = resolution.height / 8;
+				runner.measure(caseName("processImage", (std::string(info.name) + "+crop").c_str(), resolution), [&]()
+				{
+					FrameDecoder::processImage(cropX, cropX, cropY, cropY, frame.data(), resolution.width, resolution.height, lineLength,
+						info.format, lut.data(), output);
+				});
+			}
+	}
+
+	void benchmarkLut(Runner& runner, const std::vector<uint8_t>& lut)
+	{
+		for (const Resolution& resolution : RESOLUTIONS)
+		{
+			Image<ColorRgb> image = syntheticImage(resolution.width, resolution.height, 0);
+			const std::vector<uint8_t> source(image.rawMem(), image.rawMem() + image.size());
+
+			for (int mode = 1; mode <= 2; mode++)
+				runner.measure(caseName("applyLUT", (mode == 1) ? "full" : "border", resolution), [&]()
+				{
+					// the LUT is applied in place: start every call from the same content
+					memcpy(image.rawMem(), source.data(), source.size());
+					FrameDecoder::applyLUT(image.rawMem(), resolution.width, resolution.height, lut.data(), mode);
+				});
+		}
+	}
+
+	void benchmarkLedMapping(Runner& runner)
+	{
+		const char* MAPPING_NAMES[] = { "multicolor_mean", "unicolor_mean", "advanced", "weighted", "integral_mean", "dominant" };
+		const struct { const char* name; int horizontal; int vertical; } LAYOUTS[] = { { "120leds", 40, 20 }, { "400leds", 120, 80 } };
+
+		uint16_t advanced[256];
+		for (int i = 0; i < 256; i++)
+			advanced[i] = i * i;
+
+		Logger* log = Logger::getInstance("BENCHMARK");
+
+		for (const Resolution& resolution : RESOLUTIONS)
+		{
+			// the led colors are computed on the downscaled frame of the grabbers
+			const int width = resolution.width / 8, height = resolution.height / 8;
+			Image<ColorRgb> image = syntheticImage(width, height, 0);
+
+			for (const auto& layout : LAYOUTS)
+				for (int mappingType = 0; mappingType <= 5; mappingType++)
+					for (int sparse = 0; sparse <= 1; sparse++)
+					{
+						const std::vector<Led> leds = borderLayout(layout.horizontal, layout.vertical);
+						ImageToLedsMap map(log, mappingType, sparse, 400, width, height, 0, 0, 0, leds);
+						const std::string variant = std::string(MAPPING_NAMES[mappingType]) + ((sparse) ? "+sparse" : "") + "/" + layout.name;
+
+						runner.measure(caseName("ImageToLedsMap", variant.c_str(), resolution), [&]()
+						{
+							bool unchanged = false;
+							std::vector<ColorRgb> colors = map.Process(image, advanced, false, unchanged);
+						});
+					}
+		}
+	}
+
+	void benchmarkBlackBorder(Runner& runner)
+	{
+		const char* MODES[] = { "default", "classic", "osd", "letterbox", "histogram" };
+
+		for (const Resolution& resolution : RESOLUTIONS)
+		{
+			const int width = resolution.width / 8, height = resolution.height / 8;
+			Image<ColorRgb> image = syntheticImage(width, height, height / 8);
+			BlackBorderDetector detector(0.05);
+
+			for (int mode = 0; mode < 5; mode++)
+				runner.measure(caseName("BlackBorderDetector", MODES[mode], resolution), [&]()
+				{
+					switch (mode)
+					{
+						case 0: detector.process(image); break;
+						case 1: detector.process_classic(image); break;
+						case 2: detector.process_osd(image); break;
+						case 3: detector.process_letterbox(image); break;
+						default: detector.process_histogram(image); break;
+					}
+				});
+		}
+	}
+
+	void benchmarkAdjustment(Runner& runner)
+	{
+		QJsonObject channel;
+		channel["id"] = "default";
+		channel["leds"] = "*";
+		channel["gammaRed"] = 1.8;
+		channel["gammaGreen"] = 1.8;
+		channel["gammaBlue"] = 1.8;
+		channel["brightness"] = 80;
+		channel["saturationGain"] = 1.2;
+		channel["temperatureRed"] = 250;
+		channel["temperatureBlue"] = 230;
+
+		QJsonObject config;
+		config["channelAdjustment"] = QJsonArray{ channel };
+
+		for (int ledCount : { 120, 400, 1000 })
+		{
+			std::unique_ptr<MultiColorAdjustment> adjustment(MultiColorAdjustment::createLedColorsAdjustment(0, ledCount, config));
+			const std::vector<uint8_t> content = syntheticBuffer(ledCount * sizeof(ColorRgb), ledCount);
+			std::vector<ColorRgb> source(ledCount), colors;
+			memcpy(source.data(), content.data(), content.size());
+
+			runner.measure("MultiColorAdjustment/" + std::to_string(ledCount) + "leds", [&]()
+			{
+				colors = source;
+				adjustment->applyAdjustment(colors);
+			});
+		}
+	}
+
+	void benchmarkAllocation(Runner& runner)
+	{
+		for (const Resolution& resolution : RESOLUTIONS)
+			runner.measure(caseName("Image", "allocation", resolution), [&]()
+			{
+				Image<ColorRgb> image(resolution.width, resolution.height);
+				image.rawMem()[0] = 0;
+			});
+	}
+}
+
+int KernelBenchmark::run(const QString& filter)
+{
+	// the constructors of the mappers report their layout, the numbers are enough here
+	Logger::setLogLevel(Logger::WARNING);
+
+	Runner runner(filter);
+
+	std::cout << "HyperHDR kernel benchmark (SIMD: " << FrameDecoder::getSimdKernelName()
+		<< ", LUT layout: " << FrameDecoder::getLutLayoutName() << ")" << std::endl;
+
+	const std::vector<uint8_t> lut = syntheticBuffer(LUT_FILE_SIZE, 7);
+
+	benchmarkDecoder(runner, lut);
+	benchmarkLut(runner, lut);
+	benchmarkLedMapping(runner);
+	benchmarkBlackBorder(runner);
+	benchmarkAdjustment(runner);
+	benchmarkAllocation(runner);
+
+	if (runner.executed() == 0)
+	{
+		std::cout << "No benchmark matches: " << filter.toStdString() << std::endl;
+		return 1;
+	}
+
+	return 0;
+}
@@ -0,0 +1,18 @@
+#pragma once
+
+#include <QString>
+
+///
+/// Measures the hot processing kernels (frame decoding, HDR LUT, led mapping, black border detection,
+/// color adjustment and the frame allocation) on synthetic frames and prints the time per call.
+/// Started from the command line with --benchmark, so the numbers of a vendor patch can be compared
+/// on the target device with the same build.
+///
+namespace KernelBenchmark
+{
+	///
+	/// @param filter Run only the benchmarks whose name contains this text (empty = all)
+	/// @return The exit code of the process
+	///
+	int run(const QString& filter);
+}
@@ -10,10 +10,12 @@
 #include <QJsonDocument>
 #include <QJsonObject>
 #include <QJsonValue>
+#include <QJsonArray>
 #include <QPair>
 #include <cstdint>
 #include <limits>
 #include <QThread>
+#include <QRegularExpression>
 
 #include <utils/Components.h>
 #include <utils/JsonUtils.h>
@@ -53,6 +55,8 @@
 
 // InstanceManager HyperHDR
 #include <base/HyperHdrIManager.h>
+#include <base/GrabberWrapper.h>
+#include <grabber/ReplayWrapper.h>
 
 // NetOrigin checks
 #include <utils/NetOrigin.h>
@@ -74,6 +78,8 @@
 #endif
 
 #include <utils/PerformanceCounters.h>
+#include <utils/ThreadPolicy.h>
+#include <utils/InternalClock.h>
 
 #include "hyperhdr.h"
 
@@ -98,6 +104,7 @@ HyperHdrDaemon::HyperHdrDaemon(const QString& rootPath, QObject* parent, bool lo
 	, _x11Grabber(nullptr)
 	, _fbGrabber(nullptr)
 	, _pipewireGrabber(nullptr)
+	, _replayGrabber(nullptr)
 	, _cecHandler(nullptr)
 	, _ssdp(nullptr)
 	, _flatBufferServer(nullptr)
@@ -120,6 +127,8 @@ HyperHdrDaemon::HyperHdrDaemon(const QString& rootPath, QObject* parent, bool lo
 	qRegisterMetaType<settings::type>("settings::type");
 	qRegisterMetaType<QMap<quint8, QJsonObject>>("QMap<quint8,QJsonObject>");
 	qRegisterMetaType<std::vector<ColorRgb>>("std::vector<ColorRgb>");
+	qRegisterMetaType<LedFrame>("LedFrame");
+	qRegisterMetaType<FrameTrace>("FrameTrace");
 
 	// init settings
 	_settingsManager = new SettingsManager(0, this, readonlyMode);
@@ -133,6 +142,9 @@ HyperHdrDaemon::HyperHdrDaemon(const QString& rootPath, QObject* parent, bool lo
 	// performance counter
 	PerformanceCounters::getInstance();
 
+	// the startup timing report [ms since the application start]
+	const qint64 settingsTime = InternalClock::now();
+
 #if defined(ENABLE_SOUNDCAPWINDOWS)
 	// init SoundHandler
 	_snd = new SoundCapWindows(getSetting(settings::type::SNDEFFECT), this);
@@ -157,10 +169,19 @@ HyperHdrDaemon::HyperHdrDaemon(const QString& rootPath, QObject* parent, bool lo
 	connect(this, &HyperHdrDaemon::settingsChanged, _netOrigin, &NetOrigin::handleSettingsUpdate);
 	_netOrigin->handleSettingsUpdate(settings::type::NETWORK, _settingsManager->getSetting(settings::type::NETWORK));
 
+	// global options of the instances
+	connect(this, &HyperHdrDaemon::settingsChanged, _instanceManager, &HyperHdrIManager::handleSettingsUpdate);
+	_instanceManager->handleSettingsUpdate(settings::type::GENERAL, getSetting(settings::type::GENERAL));
+
+	const qint64 servicesTime = InternalClock::now();
+
 	// spawn all Hyperhdr instances (non blocking)
 	handleSettingsUpdate(settings::type::VIDEOGRABBER, getSetting(settings::type::VIDEOGRABBER));
 	handleSettingsUpdate(settings::type::SYSTEMGRABBER, getSetting(settings::type::SYSTEMGRABBER));
+	const qint64 grabbersTime = InternalClock::now();
+
 	_instanceManager->startAll();
+	const qint64 instancesTime = InternalClock::now();
 
 	//Cleaning up Hyperhdr before quit
 	connect(parent, SIGNAL(aboutToQuit()), this, SLOT(freeObjects()));
@@ -177,6 +198,10 @@ HyperHdrDaemon::HyperHdrDaemon(const QString& rootPath, QObject* parent, bool lo
 	// ---- network services -----
 	startNetworkServices();
 
+	Info(_log, "Startup timing: settings ready after %lld ms, sound & effects & auth %lld ms, grabbers %lld ms, spawning instances %lld ms, network services %lld ms",
+		static_cast<long long>(settingsTime), static_cast<long long>(servicesTime - settingsTime), static_cast<long long>(grabbersTime - servicesTime),
+		static_cast<long long>(instancesTime - grabbersTime), static_cast<long long>(InternalClock::now() - instancesTime));
+
 	_suspendHandler = std::unique_ptr<SuspendHandler>(new SuspendHandler());
 
 #ifdef _WIN32
@@ -291,6 +316,8 @@ void HyperHdrDaemon::freeObjects()
 #endif	
 
 	delete _mqtt;
+	qDeleteAll(_additionalGrabbers);
+	_additionalGrabbers.clear();
 	delete _v4l2Grabber;
 	delete _mfGrabber;
 	delete _dxGrabber;
@@ -299,6 +326,7 @@ void HyperHdrDaemon::freeObjects()
 	delete _x11Grabber;
 	delete _fbGrabber;
 	delete _pipewireGrabber;
+	delete _replayGrabber;
 
 	_v4l2Grabber = nullptr;
 	_mfGrabber = nullptr;
@@ -308,6 +336,7 @@ void HyperHdrDaemon::freeObjects()
 	_x11Grabber = nullptr;
 	_fbGrabber = nullptr;
 	_pipewireGrabber = nullptr;
+	_replayGrabber = nullptr;
 }
 
 void HyperHdrDaemon::startNetworkServices()
@@ -319,7 +348,8 @@ void HyperHdrDaemon::startNetworkServices()
 	// Create FlatBuffer server in thread
 	_flatBufferServer = new FlatBufferServer(getSetting(settings::type::FLATBUFSERVER), _rootPath);
 	QThread* fbThread = new QThread(this);
-	fbThread->setObjectName("FlatBufferServerThread");
+	fbThread->setObjectName("FlatBufServer");
+	ThreadPolicy::attach(fbThread, ThreadPolicy::Role::NETWORK);
 	_flatBufferServer->moveToThread(fbThread);
 	connect(fbThread, &QThread::started, _flatBufferServer, &FlatBufferServer::initServer);
 	connect(fbThread, &QThread::finished, _flatBufferServer, &FlatBufferServer::deleteLater);
@@ -330,7 +360,8 @@ void HyperHdrDaemon::startNetworkServices()
 	// Create Proto server in thread
 	_protoServer = new ProtoServer(getSetting(settings::type::PROTOSERVER));
 	QThread* pThread = new QThread(this);
-	pThread->setObjectName("ProtoServerThread");
+	pThread->setObjectName("ProtoServer");
+	ThreadPolicy::attach(pThread, ThreadPolicy::Role::NETWORK);
 	_protoServer->moveToThread(pThread);
 	connect(pThread, &QThread::started, _protoServer, &ProtoServer::initServer);
 	connect(pThread, &QThread::finished, _protoServer, &ProtoServer::deleteLater);
@@ -341,7 +372,8 @@ void HyperHdrDaemon::startNetworkServices()
 	// Create Webserver in thread
 	_webserver = new WebServer(getSetting(settings::type::WEBSERVER), false);
 	QThread* wsThread = new QThread(this);
-	wsThread->setObjectName("WebServerThread");
+	wsThread->setObjectName("WebServer");
+	ThreadPolicy::attach(wsThread, ThreadPolicy::Role::NETWORK);
 	_webserver->moveToThread(wsThread);
 	connect(wsThread, &QThread::started, _webserver, &WebServer::initServer);
 	connect(wsThread, &QThread::finished, _webserver, &WebServer::deleteLater);
@@ -350,7 +382,8 @@ void HyperHdrDaemon::startNetworkServices()
 	// Create SSL Webserver in thread
 	_sslWebserver = new WebServer(getSetting(settings::type::WEBSERVER), true);
 	QThread* sslWsThread = new QThread(this);
-	sslWsThread->setObjectName("SSLWebServerThread");
+	sslWsThread->setObjectName("SslWebServer");
+	ThreadPolicy::attach(sslWsThread, ThreadPolicy::Role::NETWORK);
 	_sslWebserver->moveToThread(sslWsThread);
 	connect(sslWsThread, &QThread::started, _sslWebserver, &WebServer::initServer);
 	connect(sslWsThread, &QThread::finished, _sslWebserver, &WebServer::deleteLater);
@@ -364,7 +397,8 @@ void HyperHdrDaemon::startNetworkServices()
 		getSetting(settings::type::WEBSERVER).object()["sslPort"].toInt(),
 		getSetting(settings::type::GENERAL).object()["name"].toString());
 	QThread* ssdpThread = new QThread(this);
-	ssdpThread->setObjectName("SSDPThread");
+	ssdpThread->setObjectName("SsdpServer");
+	ThreadPolicy::attach(ssdpThread, ThreadPolicy::Role::NETWORK);
 	_ssdp->moveToThread(ssdpThread);
 	connect(ssdpThread, &QThread::started, _ssdp, &SSDPHandler::initServer);
 	connect(ssdpThread, &QThread::finished, _ssdp, &SSDPHandler::deleteLater);
@@ -375,11 +409,95 @@ void HyperHdrDaemon::startNetworkServices()
 #ifdef ENABLE_MQTT
 	_mqtt = new mqtt(this);
 	connect(this, &HyperHdrDaemon::settingsChanged, _mqtt, &mqtt::handleSettingsUpdate);
-	emit _mqtt->handleSettingsUpdate(settings::type::WEBSERVER, _settingsManager->getSetting(settings::type::WEBSERVER));
 	QTimer::singleShot(1500, [this]() {emit _mqtt->handleSettingsUpdate(settings::type::MQTT, _settingsManager->getSetting(settings::type::MQTT)); });
 #endif
 }
 
+void HyperHdrDaemon::updateAdditionalGrabbers(const QJsonDocument& config)
+{
+	const QJsonObject& grabberConfig = config.object();
+	const QJsonArray additionalDevices = grabberConfig["additionalDevices"].toArray();
+
+	QMap<QString, GrabberWrapper*> current;
+	QMap<int, QString> routing;
+	QList<QPair<GrabberWrapper*, QJsonDocument>> configs;
+
+	for (const auto& item : additionalDevices)
+	{
+		const QJsonObject device = item.toObject();
+		const QString path = device["device"].toString();
+
+		if (path.isEmpty() || QString::compare(path, "auto", Qt::CaseInsensitive) == 0 || current.contains(path))
+		{
+			Warning(_log, "Skipping the additional video grabber '%s': it requires an unique device path", QSTRING_CSTR(path));
+			continue;
+		}
+
+		GrabberWrapper* wrapper = _additionalGrabbers.take(path);
+
+#if defined(ENABLE_V4L2) || defined(ENABLE_MF)
+		if (wrapper == nullptr)
+		{
+			// the main grabber stays the default instance for the API
+			auto backupInst = GrabberWrapper::instance;
+
+#if defined(ENABLE_V4L2)
+			wrapper = new V4L2Wrapper(path, _rootPath);
+#else
+			wrapper = new MFWrapper(path, _rootPath);
+#endif
+
+			GrabberWrapper::instance = backupInst;
+			wrapper->setAdditional(true);
+
+			// the capture settings of the additional grabber are merged below
+			connect(this, &HyperHdrDaemon::settingsChanged, wrapper, [wrapper](settings::type type, const QJsonDocument& cfg) {
+				if (type != settings::type::VIDEOGRABBER)
+					wrapper->handleSettingsUpdate(type, cfg);
+			});
+
+			wrapper->handleSettingsUpdate(settings::type::VIDEODETECTION, getSetting(settings::type::VIDEODETECTION));
+
+			Info(_log, "Created the additional video grabber: %s", QSTRING_CSTR(path));
+		}
+#endif
+
+		if (wrapper == nullptr)
+		{
+			Warning(_log, "The additional video grabber '%s' can not be instantiated on this platform", QSTRING_CSTR(path));
+			continue;
+		}
+
+		// the device inherits the main capture settings except its own device, mode and input
+		QJsonObject merged = grabberConfig;
+		merged.remove("additionalDevices");
+		merged["device"] = path;
+		for (const QString& key : { QString("videoMode"), QString("fps"), QString("input") })
+			if (device.contains(key))
+				merged[key] = device[key];
+
+		for (const auto& instance : device["instances"].toArray())
+			routing[instance.toInt()] = wrapper->getGrabberName();
+
+		current.insert(path, wrapper);
+		configs.append(qMakePair(wrapper, QJsonDocument(merged)));
+	}
+
+	// devices that were removed from the configuration
+	for (GrabberWrapper* wrapper : _additionalGrabbers)
+	{
+		Info(_log, "Removing the additional video grabber: %s", QSTRING_CSTR(wrapper->getGrabberName()));
+		delete wrapper;
+	}
+
+	_additionalGrabbers = current;
+
+	for (auto& cfg : configs)
+		cfg.first->handleSettingsUpdate(settings::type::VIDEOGRABBER, cfg.second);
+
+	GrabberWrapper::setRouting(routing);
+}
+
 quint16 HyperHdrDaemon::getWebPort()
 {
 	return (quint16)getSetting(settings::type::WEBSERVER).object()["port"].toInt(8090);
@@ -427,9 +545,22 @@ void HyperHdrDaemon::handleSettingsUpdate(settings::type settingsType, const QJs
 	{
 		const QJsonObject& grabberConfig = config.object();
 
+		// a capture recording given on the command line replaces the video grabber of the platform
+		const int replayParam = _params.indexOf(QRegularExpression("^replay=.*"));
+		if (replayParam >= 0 && _replayGrabber == nullptr)
+		{
+			const int speedParam = _params.indexOf(QRegularExpression("^replay-speed=.*"));
+			const double speed = (speedParam >= 0) ? _params[speedParam].mid(13).toDouble() : 1.0;
+
+			_replayGrabber = new ReplayWrapper(_params[replayParam].mid(7), speed, _params.contains("replay-loop"), _rootPath);
+
+			_replayGrabber->handleSettingsUpdate(settings::type::VIDEOGRABBER, config);
+			connect(this, &HyperHdrDaemon::settingsChanged, _replayGrabber, &ReplayWrapper::handleSettingsUpdate);
+		}
+
 #if defined(ENABLE_AVF)
 
-		if (_avfGrabber == nullptr)
+		if (_avfGrabber == nullptr && _replayGrabber == nullptr)
 		{
 			_avfGrabber = new AVFWrapper(grabberConfig["device"].toString("auto"), _rootPath);
 
@@ -443,7 +574,7 @@ void HyperHdrDaemon::handleSettingsUpdate(settings::type settingsType, const QJs
 
 
 #if defined(ENABLE_MF)
-		if (_mfGrabber == nullptr)
+		if (_mfGrabber == nullptr && _replayGrabber == nullptr)
 		{
 			_mfGrabber = new MFWrapper(grabberConfig["device"].toString("auto"), _rootPath);
 
@@ -456,7 +587,7 @@ void HyperHdrDaemon::handleSettingsUpdate(settings::type settingsType, const QJs
 
 
 #if defined(ENABLE_V4L2)
-		if (_v4l2Grabber == nullptr)
+		if (_v4l2Grabber == nullptr && _replayGrabber == nullptr)
 		{
 			_v4l2Grabber = new V4L2Wrapper(grabberConfig["device"].toString("auto"), _rootPath);
 
@@ -467,6 +598,8 @@ void HyperHdrDaemon::handleSettingsUpdate(settings::type settingsType, const QJs
 		Warning(_log, "!The v4l2 grabber can not be instantiated, because it has been left out from the build");
 #endif
 
+		updateAdditionalGrabbers(config);
+
 		emit settingsChanged(settings::type::VIDEODETECTION, getSetting(settings::type::VIDEODETECTION));
 	}
 
@@ -4,6 +4,10 @@
 #include <QObject>
 #include <QJsonObject>
 #include <QStringList>
+#include <QMap>
+
+class GrabberWrapper;
+class ReplayWrapper;
 
 #ifdef ENABLE_V4L2
 	#include <grabber/V4L2Wrapper.h>
@@ -162,6 +166,7 @@ public slots:
 	void instanceStateChanged(hyperhdr::InstanceState state, quint8 instance, const QString& name = QString());
 	void handleSettingsUpdateGlobal(settings::type type, const QJsonDocument& config);
 private:
+	void updateAdditionalGrabbers(const QJsonDocument& config);
 	void loadCEC();
 	void unloadCEC();
 	void updateCEC();
@@ -182,6 +187,8 @@ private:
 	X11Wrapper*				_x11Grabber;
 	FrameBufWrapper*		_fbGrabber;
 	PipewireWrapper*		_pipewireGrabber;
+	ReplayWrapper*			_replayGrabber;
+	QMap<QString, GrabberWrapper*>	_additionalGrabbers;
 	cecHandler*				_cecHandler;
 	SSDPHandler*			_ssdp;
 	FlatBufferServer*		_flatBufferServer;
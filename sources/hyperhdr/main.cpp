@@ -25,6 +25,7 @@
 #include <QString>
 #include <QResource>
 #include <QDir>
+#include <QFileInfo>
 #include <QStringList>
 #include <QSystemTrayIcon>
 #include <QStringList>
@@ -40,6 +41,7 @@
 #include "detectProcess.h"
 
 #include "hyperhdr.h"
+#include "KernelBenchmark.h"
 #include "systray.h"
 
 using namespace commandline;
@@ -188,6 +190,11 @@ int main(int argc, char** argv)
 	BooleanOption& silentOption = parser.add<BooleanOption>('s', "silent", "Do not print any outputs");
 	BooleanOption& verboseOption = parser.add<BooleanOption>('v', "verbose", "Increase verbosity");
 	BooleanOption& debugOption = parser.add<BooleanOption>('d', "debug", "Show debug messages");
+	BooleanOption& benchmarkOption = parser.add<BooleanOption>(0x0, "benchmark", "Measure the processing kernels on synthetic frames and exit");
+	Option& benchmarkFilterOption = parser.add<Option>(0x0, "benchmark-filter", "Run only the benchmarks whose name contains this text");
+	Option& replayOption = parser.add<Option>(0x0, "replay-capture", "Use a raw capture recording as the video grabber");
+	Option& replaySpeedOption = parser.add<Option>(0x0, "replay-speed", "Speed factor of the replayed recording, 0 = as fast as the processing allows", "1");
+	BooleanOption& replayLoopOption = parser.add<BooleanOption>(0x0, "replay-loop", "Start the replayed recording again when it ends");
 #ifdef ENABLE_PIPEWIRE
 	BooleanOption& pipewireOption = parser.add<BooleanOption>(0x0, "pipewire", "Force pipewire screen grabber if it's available");
 #endif
@@ -212,6 +219,11 @@ int main(int argc, char** argv)
 		return 0;
 	}
 
+	if (parser.isSet(benchmarkOption))
+	{
+		return KernelBenchmark::run(benchmarkFilterOption.value(parser));
+	}
+
 	if (!parser.isSet(waitOption))
 	{
 		if (getProcessIdsByProcessName(processName).size() > 1)
@@ -260,6 +272,14 @@ int main(int argc, char** argv)
 		return 0;
 	}
 
+	if (parser.isSet(replayOption))
+	{
+		params.append("replay=" + QFileInfo(replayOption.value(parser)).absoluteFilePath());
+		params.append("replay-speed=" + replaySpeedOption.value(parser));
+		if (parser.isSet(replayLoopOption))
+			params.append("replay-loop");
+	}
+
 #ifdef ENABLE_PIPEWIRE
 	if (parser.isSet(pipewireOption))
 	{
@@ -1,6 +1,7 @@
 // project includes
 #include "JsonClientConnection.h"
 #include <api/JsonAPI.h>
+#include <api/ClientSendQueue.h>
 
 // qt inc
 #include <QTcpSocket>
@@ -9,11 +10,14 @@
 JsonClientConnection::JsonClientConnection(QTcpSocket* socket, bool localConnection)
 	: QObject()
 	, _socket(socket)
+	, _jsonAPI(nullptr)
+	, _sendQueue(nullptr)
 	, _receiveBuffer()
 	, _log(Logger::getInstance("JSONCLIENTCONNECTION"))
 {
 	connect(_socket, &QTcpSocket::disconnected, this, &JsonClientConnection::disconnected);
 	connect(_socket, &QTcpSocket::readyRead, this, &JsonClientConnection::readRequest);
+	_sendQueue = new ClientSendQueue(_socket, _log, socket->peerAddress().toString(), this);
 	// create a new instance of JsonAPI
 	_jsonAPI = new JsonAPI(socket->peerAddress().toString(), _log, localConnection, this);
 	// get the callback messages from JsonAPI and send it to the client
@@ -50,7 +54,9 @@ qint64 JsonClientConnection::sendMessage(QJsonObject message)
 	QByteArray data = writer.toJson(QJsonDocument::Compact) + "\n";
 
 	if (!_socket || (_socket->state() != QAbstractSocket::ConnectedState)) return 0;
-	return _socket->write(data.data(), data.size());
+
+	_sendQueue->send(ClientSendQueue::streamOf(message), data);
+	return data.size();
 }
 
 void JsonClientConnection::disconnected()
@@ -9,6 +9,7 @@
 #include <utils/Logger.h>
 
 class JsonAPI;
+class ClientSendQueue;
 class QTcpSocket;
 
 ///
@@ -44,6 +45,9 @@ private:
 	/// new instance of JsonAPI
 	JsonAPI* _jsonAPI;
 
+	/// the messages for a slow client wait here by the policy of their stream
+	ClientSendQueue* _sendQueue;
+
 	/// The buffer used for reading data from the socket
 	QByteArray _receiveBuffer;
 
@@ -0,0 +1,177 @@
+#include <leddevice/DiscoveryCache.h>
+#include <utils/InternalClock.h>
+
+#include <QHash>
+#include <QMutex>
+#include <QMutexLocker>
+#include <QWaitCondition>
+#include <QThreadPool>
+#include <QRunnable>
+#include <QJsonObject>
+#include <QMap>
+
+namespace
+{
+	// a result newer than that is returned without a rescan
+	const qint64 REFRESH_AGE = 15000;
+	// the searches requested in that time are kept fresh by refresh()
+	const qint64 KEEP_ALIVE = 5 * 60 * 1000;
+	// the first search of a kind waits at most that long for its scan
+	const qint64 FIRST_SCAN_TIMEOUT = 10000;
+
+	struct Entry
+	{
+		Entry() : updated(0), requested(0), valid(false), scanning(false) {}
+
+		QJsonArray	devices;
+		qint64		updated;
+		qint64		requested;
+		bool		valid;
+		bool		scanning;
+		DiscoveryCache::Scanner scanner;
+	};
+
+	QMutex cacheLock;
+	QWaitCondition scanFinished;
+	QHash<QString, Entry> cache;
+	QMap<QString, QString> hosts;
+
+	// the scans wait for the answers for seconds, they don't belong to the global pool of the frame processing
+	QThreadPool* createScanPool()
+	{
+		QThreadPool* pool = new QThreadPool();
+		pool->setMaxThreadCount(2);
+		return pool;
+	}
+
+	QThreadPool* scanPool()
+	{
+		static QThreadPool* pool = createScanPool();
+		return pool;
+	}
+
+	class ScanTask : public QRunnable
+	{
+	public:
+		ScanTask(const QString& search, const DiscoveryCache::Scanner& scanner)
+			: _search(search)
+			, _scanner(scanner)
+		{
+		}
+
+		void run() override
+		{
+			const QJsonArray devices = _scanner();
+
+			QMutexLocker locker(&cacheLock);
+
+			Entry& entry = cache[_search];
+			entry.devices = devices;
+			entry.updated = InternalClock::now();
+			entry.valid = true;
+			entry.scanning = false;
+
+			scanFinished.wakeAll();
+		}
+
+	private:
+		QString _search;
+		DiscoveryCache::Scanner _scanner;
+	};
+
+	// called with the lock held
+	void startScan(const QString& search, Entry& entry)
+	{
+		entry.scanning = true;
+		scanPool()->start(new ScanTask(search, entry.scanner));
+	}
+
+	bool isSameHost(const QString& host, const QString& name)
+	{
+		if (name.isEmpty())
+			return false;
+
+		return QString::compare(host, name, Qt::CaseInsensitive) == 0 ||
+			QString::compare(host + ".local", name, Qt::CaseInsensitive) == 0 ||
+			QString::compare(host, name + ".local", Qt::CaseInsensitive) == 0;
+	}
+}
+
+QJsonArray DiscoveryCache::get(const QString& search, const Scanner& scanner)
+{
+	QMutexLocker locker(&cacheLock);
+
+	const qint64 now = InternalClock::now();
+
+	{
+		Entry& entry = cache[search];
+		entry.requested = now;
+		entry.scanner = scanner;
+
+		if (!entry.scanning && (!entry.valid || now - entry.updated > REFRESH_AGE))
+			startScan(search, entry);
+	}
+
+	// only the first search waits, the others get the last result and the fresh one comes with the next request
+	while (!cache[search].valid)
+	{
+		const qint64 remaining = FIRST_SCAN_TIMEOUT - (InternalClock::now() - now);
+
+		if (remaining <= 0 || !scanFinished.wait(&cacheLock, static_cast<unsigned long>(remaining)))
+			break;
+	}
+
+	return cache[search].devices;
+}
+
+void DiscoveryCache::refresh()
+{
+	QMutexLocker locker(&cacheLock);
+
+	const qint64 now = InternalClock::now();
+
+	for (auto it = cache.begin(); it != cache.end(); ++it)
+	{
+		Entry& entry = it.value();
+
+		if (!entry.scanning && now - entry.requested < KEEP_ALIVE && now - entry.updated > REFRESH_AGE)
+			startScan(it.key(), entry);
+	}
+}
+
+void DiscoveryCache::setHosts(const QMap<QString, QString>& mdnsHosts)
+{
+	QMutexLocker locker(&cacheLock);
+
+	hosts = mdnsHosts;
+}
+
+QHostAddress DiscoveryCache::resolve(const QString& host)
+{
+	QMutexLocker locker(&cacheLock);
+
+	for (const Entry& entry : cache)
+		for (const QJsonValue& device : entry.devices)
+		{
+			const QJsonObject record = device.toObject();
+			const QString hostname = record["hostname"].toString();
+			const QString domain = record["domain"].toString();
+
+			if (isSameHost(host, hostname) || (!domain.isEmpty() && isSameHost(host, hostname + "." + domain)))
+			{
+				QHostAddress address(record["ip"].toString());
+				if (!address.isNull())
+					return address;
+			}
+		}
+
+	for (auto it = hosts.constBegin(); it != hosts.constEnd(); ++it)
+		if (isSameHost(host, it.key()))
+		{
+			QHostAddress address(it.value());
+			if (!address.isNull())
+				return address;
+		}
+
+	return QHostAddress();
+}
@@ -0,0 +1,335 @@
+/* LatencyBenchmark.cpp
+*
+*  MIT License
+*
+*  Copyright (c) 2023 awawa-dev
+*
+*  Project homesite: https://github.com/awawa-dev/HyperHDR
+*
+*  Permission is hereby granted, free of charge, to any person obtaining a copy
+*  of this software and associated documentation files (the "Software"), to deal
+*  in the Software without restriction, including without limitation the rights
+*  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+*  copies of the Software, and to permit persons to whom the Software is
+*  furnished to do so, subject to the following conditions:
+*
+*  The above copyright notice and this permission notice shall be included in all
+*  copies or substantial portions of the Software.
+
+*  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+*  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+*  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+*  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+*  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+*  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+*  SOFTWARE.
+*/
+
+
+#include <leddevice/LatencyBenchmark.h>
+
+#include <QCoreApplication>
+#include <QThread>
+
+#ifdef HAVE_SERIAL_LED
+	#include <QSerialPort>
+#endif
+
+#include <utils/Macros.h>
+#include <utils/PreciseTimer.h>
+
+namespace
+{
+	/// a flash that gets no LED colors in time is lost, the page goes on with the next color
+	const int FLASH_TIMEOUT_MS = 2000;
+
+	/// a change between two colors may stay on the same side of the threshold of the photodiode
+	const int LIGHT_TIMEOUT_MS = 500;
+
+	/// the stages are measured in 100us
+	const int RESOLUTION_US = 100;
+}
+
+std::unique_ptr<LatencyBenchmark> LatencyBenchmark::_instance;
+std::atomic<int> LatencyBenchmark::_watchColor(LatencyBenchmark::NONE);
+std::atomic<int> LatencyBenchmark::_watchStatus(-1);
+
+LatencyBenchmark::LatencyBenchmark()
+	: _log(Logger::getInstance("BENCHMARK"))
+	, _leds(false)
+	, _sensor(nullptr)
+	, _flashes(0)
+	, _lost(0)
+	, _unconfirmed(0)
+	, _capture(RESOLUTION_US)
+	, _processing(RESOLUTION_US)
+	, _light(RESOLUTION_US)
+	, _total(RESOLUTION_US)
+{
+	_timeout.setSingleShot(true);
+	connect(&_timeout, &QTimer::timeout, this, &LatencyBenchmark::flashTimeout);
+}
+
+LatencyBenchmark* LatencyBenchmark::getInstance()
+{
+	if (_instance == nullptr)
+	{
+		_instance = std::unique_ptr<LatencyBenchmark>(new LatencyBenchmark());
+
+		// the slots are queued calls from the grabber, the LED and the API threads: they run in the main thread
+		if (QCoreApplication::instance() != nullptr)
+			_instance->moveToThread(QCoreApplication::instance()->thread());
+	}
+
+	return _instance.get();
+}
+
+LatencyBenchmark::TestColor LatencyBenchmark::parseColor(const QString& name)
+{
+	if (name == "black")
+		return BLACK;
+	else if (name == "white")
+		return WHITE;
+	else if (name == "red")
+		return RED;
+	else if (name == "green")
+		return GREEN;
+	else if (name == "blue")
+		return BLUE;
+
+	return NONE;
+}
+
+bool LatencyBenchmark::matches(TestColor color, const ColorRgb& pixel)
+{
+	switch (color)
+	{
+		case WHITE: return pixel.red > 120 && pixel.green > 120 && pixel.blue > 120;
+		case RED: return pixel.red > 120 && pixel.green < 30 && pixel.blue < 30;
+		case GREEN: return pixel.red < 30 && pixel.green > 120 && pixel.blue < 30;
+		case BLUE: return pixel.red < 30 && pixel.green < 40 && pixel.blue > 120;
+		case BLACK: return pixel.red < 30 && pixel.green < 30 && pixel.blue < 30;
+		default: return false;
+	}
+}
+
+void LatencyBenchmark::checkWrite(const std::vector<ColorRgb>& ledValues, qint64 time)
+{
+	int color = _watchColor.load(std::memory_order_acquire);
+
+	if (color == NONE || ledValues.empty())
+		return;
+
+	// the mean of all LEDs: with the smoothing it passes the thresholds in the middle of the transition
+	uint64_t red = 0, green = 0, blue = 0;
+	for (const ColorRgb& led : ledValues)
+	{
+		red += led.red;
+		green += led.green;
+		blue += led.blue;
+	}
+
+	const size_t count = ledValues.size();
+	const ColorRgb mean{ static_cast<uint8_t>(red / count), static_cast<uint8_t>(green / count), static_cast<uint8_t>(blue / count) };
+
+	if (!matches(static_cast<TestColor>(color), mean))
+		return;
+
+	// the first device that writes the color completes the stage
+	const int status = _watchStatus.load(std::memory_order_relaxed);
+	if (_watchColor.compare_exchange_strong(color, NONE, std::memory_order_acq_rel))
+		QUEUE_CALL_2(getInstance(), written, int, status, qint64, time);
+}
+
+void LatencyBenchmark::begin(bool leds, QString photodiode)
+{
+	closeSensor();
+	_timeout.stop();
+	_watchColor.store(NONE, std::memory_order_release);
+
+	_leds = leds;
+	_flash = Flash();
+	_flashes = 0;
+	_lost = 0;
+	_unconfirmed = 0;
+	_capture.clear();
+	_processing.clear();
+	_light.clear();
+	_total.clear();
+
+	if (leds && !photodiode.isEmpty())
+	{
+#ifdef HAVE_SERIAL_LED
+		_sensor = new QSerialPort(photodiode, this);
+		_sensor->setBaudRate(QSerialPort::Baud115200);
+
+		if (_sensor->open(QIODevice::ReadOnly))
+		{
+			_sensor->clear();
+			connect(_sensor, &QSerialPort::readyRead, this, &LatencyBenchmark::sensorData);
+			Info(_log, "The light of the LEDs is confirmed by the photodiode at: %s", QSTRING_CSTR(photodiode));
+		}
+		else
+		{
+			Error(_log, "Could not open the photodiode at %s: %s", QSTRING_CSTR(photodiode), QSTRING_CSTR(_sensor->errorString()));
+			closeSensor();
+		}
+#else
+		Error(_log, "The photodiode is not supported: HyperHDR was built without the serial port support");
+#endif
+	}
+
+	Info(_log, "Started the %s benchmark", (leds) ? "glass-to-LED" : "video capture");
+}
+
+void LatencyBenchmark::request(int status, QString color, qint64 time)
+{
+	_timeout.stop();
+	_watchColor.store(NONE, std::memory_order_release);
+
+	_flash = Flash();
+	_flash.status = status;
+	_flash.color = color;
+	_flash.requested = time;
+}
+
+void LatencyBenchmark::captured(int status, QString color, qint64 time)
+{
+	if (status != _flash.status || color != _flash.color || _flash.captured > 0)
+	{
+		// no request (ex. an older page): only the capture is known
+		if (_flash.status != status)
+			emit flashCompleted(status, color);
+		return;
+	}
+
+	_flash.captured = time;
+
+	if (!_leds)
+	{
+		complete(false);
+		return;
+	}
+
+	_watchStatus.store(status, std::memory_order_relaxed);
+	_watchColor.store(parseColor(color), std::memory_order_release);
+	_timeout.start(FLASH_TIMEOUT_MS);
+}
+
+void LatencyBenchmark::written(int status, qint64 time)
+{
+	if (status != _flash.status || _flash.captured == 0 || _flash.written > 0)
+		return;
+
+	_flash.written = time;
+
+	if (_sensor == nullptr)
+		complete(false);
+	else
+		_timeout.start(LIGHT_TIMEOUT_MS);
+}
+
+void LatencyBenchmark::sensorData()
+{
+#ifdef HAVE_SERIAL_LED
+	if (_sensor == nullptr)
+		return;
+
+	const qint64 now = PreciseTimer::now();
+
+	// only the first change after the write is the light of the flash
+	if (_sensor->readAll().size() > 0 && _flash.written > 0 && _flash.lit == 0)
+	{
+		_flash.lit = now;
+		complete(false);
+	}
+#endif
+}
+
+void LatencyBenchmark::flashTimeout()
+{
+	_watchColor.store(NONE, std::memory_order_release);
+
+	if (_flash.written > 0)
+	{
+		// the LEDs have the color, only the light stage of this flash is unknown
+		_unconfirmed++;
+		complete(false);
+		return;
+	}
+
+	Warning(_log, "The LEDs did not get the color of the flash %i (%s) in %ims", _flash.status, QSTRING_CSTR(_flash.color), FLASH_TIMEOUT_MS);
+
+	complete(true);
+}
+
+void LatencyBenchmark::complete(bool lost)
+{
+	_timeout.stop();
+
+	if (lost)
+		_lost++;
+	else
+	{
+		const qint64 last = qMax(qMax(_flash.captured, _flash.written), _flash.lit);
+
+		_flashes++;
+		if (_flash.requested > 0)
+		{
+			_capture.add((_flash.captured - _flash.requested) / (RESOLUTION_US * 1000));
+			_total.add((last - _flash.requested) / (RESOLUTION_US * 1000));
+		}
+		if (_flash.written > 0)
+			_processing.add((_flash.written - _flash.captured) / (RESOLUTION_US * 1000));
+		if (_flash.lit > 0)
+			_light.add((_flash.lit - _flash.written) / (RESOLUTION_US * 1000));
+	}
+
+	const int status = _flash.status;
+	const QString color = _flash.color;
+
+	_flash.captured = _flash.written = _flash.lit = 0;
+	_flash.requested = 0;
+	_flash.status = -1;
+
+	emit flashCompleted(status, color);
+}
+
+void LatencyBenchmark::finish()
+{
+	QJsonObject stats;
+
+	_timeout.stop();
+	_watchColor.store(NONE, std::memory_order_release);
+
+	stats["leds"] = _leds;
+	stats["photodiode"] = (_sensor != nullptr);
+	stats["flashes"] = _flashes;
+	stats["lost"] = _lost;
+	stats["unconfirmed"] = _unconfirmed;
+	stats["capture"] = _capture.toJson();
+	stats["processing"] = _processing.toJson();
+	stats["light"] = _light.toJson();
+	stats["total"] = _total.toJson();
+
+	if (_flashes > 0)
+		Info(_log, "Benchmark finished, %i flashes (%i lost), total latency: %s", _flashes, _lost, QSTRING_CSTR(_total.toString()));
+
+	closeSensor();
+	_leds = false;
+	_flash = Flash();
+
+	emit statsUpdated(stats);
+}
+
+void LatencyBenchmark::closeSensor()
+{
+#ifdef HAVE_SERIAL_LED
+	if (_sensor != nullptr)
+	{
+		_sensor->close();
+		_sensor->deleteLater();
+		_sensor = nullptr;
+	}
+#endif
+}
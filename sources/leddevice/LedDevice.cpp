@@ -1,4 +1,5 @@
 #include <leddevice/LedDevice.h>
+#include <leddevice/LatencyBenchmark.h>
 
 //QT include
 #include <QResource>
@@ -8,11 +9,34 @@
 
 #include <base/HyperHdrInstance.h>
 #include <utils/JsonUtils.h>
+#include <utils/EventTracer.h>
+#include <utils/PresentationClock.h>
 
 //std includes
 #include <sstream>
 #include <iomanip>
 
+namespace
+{
+	/// [ms] without a change of the colors before the refresh switches to the idle interval
+	const int64_t IDLE_REFRESH_DELAY_MS = 2000;
+
+	/// the writes take from tens of microseconds (SPI) to tens of milliseconds (slow network devices)
+	const int WRITE_TIME_RESOLUTION_US = 100;
+
+	/// the stages of the pipeline take from microseconds (the adjustments) to a frame period or more (the smoothing)
+	const int TRACE_RESOLUTION_US = 200;
+
+	/// [ms] of the writes evaluated by one step of the adaptive refresh
+	const int64_t ADAPTIVE_WINDOW_MS = 2000;
+
+	/// after a slowdown the interval stays for this many windows, so it doesn't oscillate at the limit of the device
+	const int ADAPTIVE_HOLD_WINDOWS = 5;
+
+	/// [%] of the reported packet loss in a window that slows down the adaptive refresh
+	const int ADAPTIVE_MAX_LOSS_PERCENT = 2;
+}
+
 std::atomic<bool> LedDevice::_signalTerminate(false);
 
 LedDevice::LedDevice(const QJsonObject& deviceConfig, QObject* parent)
@@ -22,6 +46,7 @@ LedDevice::LedDevice(const QJsonObject& deviceConfig, QObject* parent)
 	, _ledBuffer(0)
 	, _refreshTimer(nullptr)
 	, _refreshTimerInterval_ms(0)
+	, _idleRefreshInterval_ms(0)
 	, _ledCount(0)
 	, _isRestoreOrigState(false)
 	, _isEnabled(false)
@@ -29,22 +54,44 @@ LedDevice::LedDevice(const QJsonObject& deviceConfig, QObject* parent)
 	, _isDeviceReady(false)
 	, _isOn(false)
 	, _isDeviceInError(false)
+	, _isLightSleep(false)
 	, _retryMode(false)
 	, _maxRetry(60)
 	, _currentRetry(0)
+	, _presentationSync(false)
 	, _isRefreshEnabled(false)
+	, _isRefreshIdle(false)
+	, _lastChangeTime(0)
 	, _newFrame2Send(false)
 	, _newFrame2SendTime(0)
+	, _measuredTimestamp(0)
+	, _measuredTrace(0)
+	, _ledMailbox(nullptr)
+	, _coalescedFrames(0)
+	, _adaptiveRefresh(false)
+	, _adaptiveRefreshMin_ms(10)
+	, _adaptiveRefreshMax_ms(200)
+	, _stageLatency(FrameTrace::STAGES, LatencyHistogram(TRACE_RESOLUTION_US))
+	, _pipelineLatency(TRACE_RESOLUTION_US)
+	, _writeTime(WRITE_TIME_RESOLUTION_US)
+	, _writeCadence(std::make_shared<WriteCadence>())
+	, _asyncWrites(false)
+	, _presentedTrace(0)
 	, _blinkIndex(-1)
 {
 	_activeDeviceType = deviceConfig["type"].toString("UNSPECIFIED").toLower();
 
 	connect(this, &LedDevice::manualUpdate, this, &LedDevice::rewriteLEDs, Qt::QueuedConnection);
+	connect(this, &LedDevice::ledsQueued, this, &LedDevice::processQueuedLeds, Qt::QueuedConnection);
 }
 
 LedDevice::~LedDevice()
 {
 	stopRefreshTimer();
+
+	PresentationClock::leave(_writeCadence);
+
+	delete _ledMailbox.exchange(nullptr);
 }
 
 int LedDevice::open()
@@ -117,6 +164,8 @@ void LedDevice::enableDevice(bool toEmit)
 				_isDeviceReady = true;
 				_isEnabled = true;
 
+				PresentationClock::join(_writeCadence);
+
 				if (toEmit)
 					emit enableStateChanged(_isEnabled);
 			}
@@ -139,6 +188,32 @@ void LedDevice::stop()
 	Info(_log, " Stopped LedDevice '%s'", QSTRING_CSTR(_activeDeviceType));
 }
 
+void LedDevice::lightSleep(bool sleep)
+{
+	if (sleep && !_isLightSleep && _isEnabled && _isOn && _isDeviceReady)
+	{
+		Info(_log, "Light sleep: the output is paused, the device stays open");
+
+		this->stopRefreshTimer();
+		writeBlack();
+
+		_isLightSleep = true;
+		_newFrame2Send = false;
+	}
+	else if (!sleep && _isLightSleep)
+	{
+		Info(_log, "Light sleep: the output is resumed");
+
+		_isLightSleep = false;
+
+		// the first frame after the wake-up is written as a change, not as a refresh of the black LEDs
+		_lastLedValues = nullptr;
+
+		if (_isRefreshEnabled)
+			this->startRefreshTimer();
+	}
+}
+
 void LedDevice::disable()
 {
 	Debug(_log, "Disable the device");
@@ -150,6 +225,9 @@ void LedDevice::disableDevice(bool toEmit)
 	if (_isEnabled)
 	{
 		_isEnabled = false;
+		_isLightSleep = false;
+
+		PresentationClock::leave(_writeCadence);
 
 		if (_isRefreshEnabled)
 			this->stopRefreshTimer();
@@ -187,8 +265,28 @@ bool LedDevice::init(const QJsonObject& deviceConfig)
 	Debug(_log, "deviceConfig: [%s]", QString(QJsonDocument(_devConfig).toJson(QJsonDocument::Compact)).toUtf8().constData());
 
 	setLedCount(deviceConfig["currentLedCount"].toInt(1)); // property injected to reflect real led count
+	_idleRefreshInterval_ms = qMax(deviceConfig["idleRefreshTime"].toInt(_idleRefreshInterval_ms), 0);
 	setRefreshTime(deviceConfig["refreshTime"].toInt(_refreshTimerInterval_ms));
 
+	_adaptiveRefresh = deviceConfig["adaptiveRefresh"].toBool(false);
+	_adaptiveRefreshMin_ms = qMax(deviceConfig["adaptiveRefreshMin"].toInt(_adaptiveRefreshMin_ms), 1);
+	_adaptiveRefreshMax_ms = qMax(deviceConfig["adaptiveRefreshMax"].toInt(_adaptiveRefreshMax_ms), _adaptiveRefreshMin_ms);
+	_adaptive = {};
+
+	if (_adaptiveRefresh)
+	{
+		if (_refreshTimerInterval_ms > 0)
+		{
+			Debug(_log, "Adaptive refresh time: %d - %d ms", _adaptiveRefreshMin_ms, _adaptiveRefreshMax_ms);
+			setRefreshTime(qBound(_adaptiveRefreshMin_ms, _refreshTimerInterval_ms, _adaptiveRefreshMax_ms));
+		}
+		else
+		{
+			Warning(_log, "The adaptive refresh time requires the refresh time: it's disabled");
+			_adaptiveRefresh = false;
+		}
+	}
+
 	return true;
 }
 
@@ -199,16 +297,17 @@ void LedDevice::startRefreshTimer()
 		// setup refreshTimer
 		if (_refreshTimer == nullptr)
 		{
-			_refreshTimer = new QTimer(this);
-			_refreshTimer->setTimerType(Qt::PreciseTimer);
+			_refreshTimer = new PreciseTimer(this);
 			_refreshTimer->setInterval(_refreshTimerInterval_ms);
-			connect(_refreshTimer, &QTimer::timeout, this, &LedDevice::rewriteLEDs);
+			connect(_refreshTimer, &PreciseTimer::timeout, this, &LedDevice::rewriteLEDs);
 		}
 		else
 			_refreshTimer->setInterval(_refreshTimerInterval_ms);
 
 		Debug(_log, "Starting timer with interval = %ims", _refreshTimer->interval());
 
+		_isRefreshIdle = false;
+		_lastChangeTime = InternalClock::now();
 		_refreshTimer->start();
 	}
 	else if (_refreshTimerInterval_ms > 0)
@@ -232,6 +331,7 @@ void LedDevice::stopRefreshTimer()
 void LedDevice::setRefreshTime(int refreshTime_ms)
 {
 	_refreshTimerInterval_ms = qMax(refreshTime_ms, 0);
+	_writeCadence->setRefreshInterval(_refreshTimerInterval_ms);
 
 	if (_refreshTimerInterval_ms > 0)
 	{
@@ -251,7 +351,31 @@ void LedDevice::setRefreshTime(int refreshTime_ms)
 	Debug(_log, "RefreshTime updated to %dms", _refreshTimerInterval_ms);
 }
 
-int LedDevice::updateLeds(std::vector<ColorRgb> ledValues)
+void LedDevice::queueLeds(const LedFrame& ledValues, const FrameTrace& trace)
+{
+	PendingLeds* frame = new PendingLeds{ ledValues, trace };
+
+	// newest frame wins: the one still waiting is replaced and the slot already has its wake-up call
+	PendingLeds* previous = _ledMailbox.exchange(frame);
+
+	if (previous != nullptr)
+	{
+		_coalescedFrames++;
+		delete previous;
+	}
+	else
+		emit ledsQueued();
+}
+
+void LedDevice::processQueuedLeds()
+{
+	std::unique_ptr<PendingLeds> frame(_ledMailbox.exchange(nullptr));
+
+	if (frame != nullptr)
+		updateLeds(frame->ledValues, frame->trace);
+}
+
+int LedDevice::updateLeds(const LedFrame& ledValues, const FrameTrace& trace)
 {
 	// stats
 	int64_t now = InternalClock::now();
@@ -268,15 +392,60 @@ int LedDevice::updateLeds(std::vector<ColorRgb> ledValues)
 	}
 	else if (prevToken != (_computeStats.token = PerformanceCounters::currentToken()))
 	{
-		if (_isRefreshEnabled && _refreshTimerInterval_ms > 0)
+		if (_isRefreshEnabled && !_isRefreshIdle && _refreshTimerInterval_ms > 0)
 		{
 			qint64 wanted = (1000.0/_refreshTimerInterval_ms) * 60.0 * diff / 60000.0;
 			_computeStats.droppedFrames = std::max(wanted - _computeStats.frames - 1, 0ll);
 		}
 
+		// the frames replaced in the mailbox arrived too, but their colors were never written
+		qint64 coalesced = _coalescedFrames.exchange(0);
+		_computeStats.incomingframes += coalesced;
+		_computeStats.droppedFrames += coalesced;
+
+		PreciseTimer::JitterStats refreshStats;
+		if (_refreshTimer != nullptr)
+			refreshStats = _refreshTimer->takeJitterStats();
+
 		if (diff >= 59000 && diff <= 65000)
-			emit this->newCounter(
-				PerformanceReport(static_cast<int>(PerformanceReportType::LED), _computeStats.token, this->_activeDeviceType, _computeStats.frames / qMax(diff / 1000.0, 1.0), _computeStats.frames, _computeStats.incomingframes, _computeStats.droppedFrames));
+		{
+			// before the LED report: it completes the console summary
+			if (_latency.count() > 0)
+			{
+				PerformanceReport latencyReport(static_cast<int>(PerformanceReportType::LATENCY), _computeStats.token, _latency.toString(), _latency.average(), _latency.percentile(50), _latency.percentile(95), _latency.percentile(99));
+				latencyReport.histogram = _latency.toJson();
+				emit this->newCounter(latencyReport);
+			}
+
+			if (refreshStats.ticks > 0)
+				emit this->newCounter(
+					PerformanceReport(static_cast<int>(PerformanceReportType::REFRESH_TIMER), _computeStats.token, "", refreshStats.average, refreshStats.max, refreshStats.ticks, refreshStats.missed));
+
+			if (_pipelineLatency.count() > 0)
+			{
+				PerformanceReport pipelineReport(static_cast<int>(PerformanceReportType::PIPELINE), _computeStats.token, traceToString(), _pipelineLatency.average() * TRACE_RESOLUTION_US / 1000.0,
+					_pipelineLatency.percentile(50) * TRACE_RESOLUTION_US / 1000, _pipelineLatency.percentile(95) * TRACE_RESOLUTION_US / 1000, _pipelineLatency.percentile(99) * TRACE_RESOLUTION_US / 1000);
+				pipelineReport.histogram = _pipelineLatency.toJson();
+				emit this->newCounter(pipelineReport);
+			}
+
+			PerformanceReport ledReport(static_cast<int>(PerformanceReportType::LED), _computeStats.token, this->_activeDeviceType, _computeStats.frames / qMax(diff / 1000.0, 1.0), _computeStats.frames, _computeStats.incomingframes, _computeStats.droppedFrames);
+
+			// the averages hide the slow writes, ex. a network device that stalls now and then
+			if (_writeTime.count() > 0)
+			{
+				ledReport.detail = _writeTime.toString();
+				ledReport.histogram = _writeTime.toJson();
+			}
+
+			emit this->newCounter(ledReport);
+		}
+
+		_latency.clear();
+		_writeTime.clear();
+		_pipelineLatency.clear();
+		for (LatencyHistogram& stage : _stageLatency)
+			stage.clear();
 
 		_computeStats.statBegin = now;
 		_computeStats.frames = 0;
@@ -287,14 +456,31 @@ int LedDevice::updateLeds(std::vector<ColorRgb> ledValues)
 		_computeStats.incomingframes++;
 
 
-	if (!_isEnabled || !_isOn || !_isDeviceReady || _isDeviceInError)
+	if (!_isEnabled || !_isOn || !_isDeviceReady || _isDeviceInError || _isLightSleep)
 	{
 		return -1;
 	}
 	else
 	{
 		if (_blinkIndex < 0)
+		{
+			if (_isRefreshEnabled && (_lastLedValues == nullptr || *ledValues != *_lastLedValues))
+			{
+				_lastChangeTime = now;
+
+				// back to the normal refresh rate, the new colors are written at once
+				if (_isRefreshIdle && _refreshTimer != nullptr)
+				{
+					_isRefreshIdle = false;
+					_refreshTimer->setInterval(_refreshTimerInterval_ms);
+					emit manualUpdate();
+				}
+			}
+
+			// the frame is shared, not copied: the refresh writes it again from the same buffer
 			_lastLedValues = ledValues;
+			_lastLedTrace = trace;
+		}
 
 		if (!_isRefreshEnabled && (!_newFrame2Send || now - _newFrame2SendTime > 1000 || now < _newFrame2SendTime))
 		{
@@ -309,34 +495,230 @@ int LedDevice::updateLeds(std::vector<ColorRgb> ledValues)
 	return 0;
 }
 
+std::shared_ptr<WriteCadence> LedDevice::getWriteCadence() const
+{
+	return _writeCadence;
+}
+
+void LedDevice::setAsyncWrites(bool asyncWrites)
+{
+	_asyncWrites = asyncWrites;
+}
+
+void LedDevice::writeCompleted()
+{
+	_writeCadence->writeFinished(PreciseTimer::now());
+}
+
+void LedDevice::reportDeliveryLoss(int delivered, int lost)
+{
+	if (_adaptiveRefresh && _adaptive.windowBegin > 0)
+	{
+		_adaptive.delivered += qMax(delivered, 0);
+		_adaptive.lost += qMax(lost, 0);
+	}
+}
+
 int LedDevice::rewriteLEDs()
 {
 	int retval = -1;
 
 	_newFrame2Send = false;
 
-	if (_isEnabled && _isOn && _isDeviceReady && !_isDeviceInError && !_signalTerminate)
+	if (_isEnabled && _isOn && _isDeviceReady && !_isDeviceInError && !_isLightSleep && !_signalTerminate)
 	{
-		if (_lastLedValues.size() > 0)
-			retval = write(_lastLedValues);
+		if (_lastLedValues != nullptr && _lastLedValues->size() > 0)
+		{
+			TRACE_SCOPE("device write");
+
+			// the first write of a frame waits for its presentation time, the repeats are written at once
+			qint64 presentAt = 0;
+			const int64_t smoothed = _lastLedTrace.stamps[FrameTrace::SMOOTHED];
+			const bool present = (smoothed == 0 || smoothed != _presentedTrace) && PresentationClock::presentationTime(smoothed, presentAt);
+
+			_presentedTrace = smoothed;
+			_presentationSync = PresentationClock::isEnabled() && hasSyncTrigger();
+
+			if (present && !_presentationSync)
+				PresentationClock::sleepUntil(presentAt - _writeCadence->duration());
+
+			const qint64 writeBegin = PreciseTimer::now();
+			_writeCadence->writeStarted(writeBegin);
+			retval = write(*_lastLedValues);
+			const qint64 writeEnd = PreciseTimer::now();
+			if (!_asyncWrites)
+				_writeCadence->writeFinished(writeEnd);
+
+			if (_presentationSync && retval >= 0)
+			{
+				if (present)
+					PresentationClock::sleepUntil(presentAt);
+				writeSyncTrigger();
+			}
+
+			_writeTime.add((writeEnd - writeBegin) / (WRITE_TIME_RESOLUTION_US * 1000));
+
+			LatencyBenchmark::checkWrite(*_lastLedValues, writeEnd);
+
+			if (_adaptiveRefresh)
+				adaptRefreshTime(retval);
+
+			// the refresh timer and the smoothing repeat the colors: measure only the first write of the frame
+			if (_lastLedTrace.timestamp > 0 && _lastLedTrace.timestamp != _measuredTimestamp)
+			{
+				_measuredTimestamp = _lastLedTrace.timestamp;
+				_latency.add(InternalClock::now() - _lastLedTrace.timestamp);
+			}
+
+			// the same for the stages, also of the frames without a capture time (ex. effects)
+			if (_lastLedTrace.stamps[FrameTrace::ADJUSTED] > 0 && _lastLedTrace.stamps[FrameTrace::ADJUSTED] != _measuredTrace)
+			{
+				_measuredTrace = _lastLedTrace.stamps[FrameTrace::ADJUSTED];
+
+				FrameTrace trace = _lastLedTrace;
+				trace.stamps[FrameTrace::WRITE_BEGIN] = writeBegin / 1000;
+				trace.stamps[FrameTrace::WRITE_END] = writeEnd / 1000;
+				addTrace(trace);
+			}
+		}
 
 		_computeStats.frames++;
+
+		// the colors are static: only the keep-alive of the device is needed
+		if (_isRefreshEnabled && !_isRefreshIdle && _refreshTimer != nullptr && _idleRefreshInterval_ms > _refreshTimerInterval_ms &&
+			InternalClock::now() - _lastChangeTime > IDLE_REFRESH_DELAY_MS)
+		{
+			_isRefreshIdle = true;
+			_refreshTimer->setInterval(_idleRefreshInterval_ms);
+			Debug(_log, "The colors are static, refresh interval = %dms", _idleRefreshInterval_ms);
+		}
 	}
 
 	return retval;
 }
 
+void LedDevice::addTrace(const FrameTrace& trace)
+{
+	int64_t first = 0;
+	int64_t previous = 0;
+
+	// a stage that the frame didn't pass is measured together with the next one
+	for (int stage = 0; stage < FrameTrace::STAGES; stage++)
+	{
+		const int64_t stamp = trace.stamps[stage];
+
+		if (stamp <= 0)
+			continue;
+
+		if (previous > 0)
+			_stageLatency[stage].add(qMax(stamp - previous, static_cast<int64_t>(0)) / TRACE_RESOLUTION_US);
+		else
+			first = stamp;
+
+		previous = stamp;
+	}
+
+	if (first > 0 && previous > first)
+		_pipelineLatency.add((previous - first) / TRACE_RESOLUTION_US);
+}
+
+QString LedDevice::traceToString() const
+{
+	const double unit = TRACE_RESOLUTION_US / 1000.0;
+	QStringList stages;
+
+	for (int stage = 0; stage < FrameTrace::STAGES; stage++)
+		if (_stageLatency[stage].count() > 0)
+			stages.append(QString("%1 p50 %2ms, p95 %3ms").arg(FrameTrace::stageName(stage)).
+				arg(_stageLatency[stage].percentile(50) * unit, 0, 'f', 1).arg(_stageLatency[stage].percentile(95) * unit, 0, 'f', 1));
+
+	stages.append(QString("total %1").arg(_pipelineLatency.toString()));
+
+	return stages.join(" | ");
+}
+
+void LedDevice::adaptRefreshTime(int writeResult)
+{
+	// the keep-alive of the static colors says nothing about the capacity
+	if (!_isRefreshEnabled || _refreshTimer == nullptr || _isRefreshIdle)
+	{
+		_adaptive.windowBegin = 0;
+		return;
+	}
+
+	const int64_t now = InternalClock::now();
+
+	if (_adaptive.windowBegin <= 0 || now < _adaptive.windowBegin)
+	{
+		_adaptive.windowBegin = now;
+		_adaptive.writes = 0;
+		_adaptive.errors = 0;
+		_adaptive.delivered = 0;
+		_adaptive.lost = 0;
+	}
+
+	_adaptive.writes++;
+	if (writeResult < 0)
+		_adaptive.errors++;
+
+	if (now - _adaptive.windowBegin < ADAPTIVE_WINDOW_MS)
+		return;
+
+	// the cadence measures the whole transfer, also for the devices that send in the background
+	const double duration = _writeCadence->duration() / 1000000.0;
+	const int interval = _refreshTimerInterval_ms;
+	int target = interval;
+	const bool lossy = _adaptive.lost * 100 > (_adaptive.delivered + _adaptive.lost) * ADAPTIVE_MAX_LOSS_PERCENT;
+
+	if (_adaptive.errors > 0 || lossy || duration > interval * 0.8)
+	{
+		// back off fast
+		target = qMin(interval + qMax(interval / 4, 1), _adaptiveRefreshMax_ms);
+		_adaptive.hold = ADAPTIVE_HOLD_WINDOWS;
+	}
+	else if (_adaptive.hold > 0)
+	{
+		_adaptive.hold--;
+	}
+	else if (duration < interval * 0.5)
+	{
+		// and probe the higher rate slowly
+		target = qMax(interval - qMax(interval / 10, 1), _adaptiveRefreshMin_ms);
+	}
+
+	if (target != interval)
+	{
+		Debug(_log, "Adaptive refresh time: %d ms -> %d ms (write %.2f ms, %d errors in %d writes, %d of %d packets lost)", interval, target, duration, _adaptive.errors, _adaptive.writes,
+			_adaptive.lost, _adaptive.delivered + _adaptive.lost);
+
+		// the smoothing paces its frames by the refresh interval of the cadence
+		_refreshTimerInterval_ms = target;
+		_writeCadence->setRefreshInterval(target);
+		_refreshTimer->setInterval(target);
+	}
+
+	_adaptive.windowBegin = now;
+	_adaptive.writes = 0;
+	_adaptive.errors = 0;
+	_adaptive.delivered = 0;
+	_adaptive.lost = 0;
+}
+
 int LedDevice::writeBlack(int numberOfBlack)
 {
 	int rc = -1;
 
 	Debug(_log, "Set LED strip to black/power off");
 
-	_lastLedValues = std::vector<ColorRgb>(static_cast<unsigned long>(_ledCount), ColorRgb::BLACK);
+	_lastLedValues = std::make_shared<const std::vector<ColorRgb>>(static_cast<unsigned long>(_ledCount), ColorRgb::BLACK);
 
 	for (int i = 0; i < numberOfBlack; i++)
 	{
-		rc = write(_lastLedValues);
+		rc = write(*_lastLedValues);
+
+		// the receiver still waits for the trigger of the data packets
+		if (_presentationSync && rc >= 0)
+			writeSyncTrigger();
 	}
 
 	return rc;
@@ -461,7 +843,7 @@ void LedDevice::identifyLed(const QJsonObject& params)
 {
 	_blinkIndex = params["blinkIndex"].toInt(-1);
 
-	if (_blinkIndex < 0 || _blinkIndex >= (int)_lastLedValues.size())
+	if (_blinkIndex < 0 || _lastLedValues == nullptr || _blinkIndex >= (int)_lastLedValues->size())
 	{
 		_blinkIndex = -1;
 	}
@@ -469,19 +851,19 @@ void LedDevice::identifyLed(const QJsonObject& params)
 	{
 		const int blinkOrg = _blinkIndex;
 
-		for (auto iter = _lastLedValues.begin(); iter != _lastLedValues.end(); ++iter)
-		{
-			*iter = ColorRgb::BLACK;
-		}
+		// the shared frame may still be read by others: the blinking uses its own one
+		_lastLedValues = std::make_shared<const std::vector<ColorRgb>>(_lastLedValues->size(), ColorRgb::BLACK);
 
 		for (int i = 0; i < 6; i++)
 		{
 			ColorRgb color = (i % 3 == 0) ? ColorRgb::RED : (i % 3 == 1) ? ColorRgb::GREEN : ColorRgb::BLUE;
 
 			QTimer::singleShot(800 * i, this, [this, color, blinkOrg]() {
-				if (_blinkIndex == blinkOrg && _blinkIndex >= 0 && _blinkIndex < (int)_lastLedValues.size())
+				if (_blinkIndex == blinkOrg && _blinkIndex >= 0 && _lastLedValues != nullptr && _blinkIndex < (int)_lastLedValues->size())
 				{
-					_lastLedValues[_blinkIndex] = color;
+					std::shared_ptr<std::vector<ColorRgb>> frame = std::make_shared<std::vector<ColorRgb>>(*_lastLedValues);
+					(*frame)[_blinkIndex] = color;
+					_lastLedValues = frame;
 					rewriteLEDs();
 				}
 			});
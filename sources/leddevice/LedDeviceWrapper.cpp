@@ -9,6 +9,8 @@
 // util
 #include <base/HyperHdrInstance.h>
 #include <utils/JsonUtils.h>
+#include <utils/ThreadPolicy.h>
+#include <utils/GlobalSignals.h>
 
 // qt
 #include <QMutexLocker>
@@ -52,26 +54,36 @@ void LedDeviceWrapper::createLedDevice(const QJsonObject& config)
 
 	// create thread and device
 	QThread* thread = new QThread(this);
-	thread->setObjectName("LedDeviceThread");
+	thread->setObjectName(QString("LedDevice%1").arg(_hyperhdr->getInstanceIndex()));
+	ThreadPolicy::attach(thread, ThreadPolicy::Role::OUTPUT);
 	_ledDevice = LedDeviceFactory::construct(config);
+	_writeCadence = _ledDevice->getWriteCadence();
 	_ledDevice->moveToThread(thread);
 
 	// setup thread management
 	connect(thread, &QThread::started, _ledDevice, &LedDevice::start, Qt::QueuedConnection);
 
 	// further signals
-	connect(this, &LedDeviceWrapper::updateLeds, _ledDevice, &LedDevice::updateLeds);
-
 	connect(this, &LedDeviceWrapper::stopLedDevice, _ledDevice, &LedDevice::stop, Qt::BlockingQueuedConnection);
 
 	connect(_ledDevice, &LedDevice::enableStateChanged, this, &LedDeviceWrapper::handleInternalEnableState, Qt::QueuedConnection);
 
+	// the light sleep of the system pauses the output in the device thread, the device stays open
+	connect(GlobalSignals::getInstance(), &GlobalSignals::lightSleep, _ledDevice, &LedDevice::lightSleep, Qt::QueuedConnection);
+
 	connect(_ledDevice, &LedDevice::newCounter, this, [=](PerformanceReport pr) {pr.id = this->_hyperhdr->getInstanceIndex(); emit PerformanceCounters::getInstance()->newCounter(pr); });
 
 	// start the thread
 	thread->start();
 }
 
+void LedDeviceWrapper::updateLeds(const LedFrame& ledValues, const FrameTrace& trace)
+{
+	// the device thread takes only the newest frame, there is no queue of colors behind a slow device
+	if (_ledDevice != nullptr)
+		_ledDevice->queueLeds(ledValues, trace);
+}
+
 void LedDeviceWrapper::handleComponentState(hyperhdr::Components component, bool state)
 {
 	if (component == hyperhdr::COMP_LEDDEVICE)
@@ -115,6 +127,7 @@ void LedDeviceWrapper::stopDeviceThread()
 	disconnect(_ledDevice, nullptr, nullptr, nullptr);
 	delete _ledDevice;
 	_ledDevice = nullptr;
+	_writeCadence = nullptr;
 }
 
 unsigned int LedDeviceWrapper::getLedCount() const
@@ -124,6 +137,11 @@ unsigned int LedDeviceWrapper::getLedCount() const
 	return value;
 }
 
+std::shared_ptr<WriteCadence> LedDeviceWrapper::getWriteCadence() const
+{
+	return _writeCadence;
+}
+
 QString LedDeviceWrapper::getActiveDeviceType() const
 {
 	QString value = 0;
@@ -159,6 +177,15 @@ const LedDeviceRegistry& LedDeviceWrapper::getDeviceMap()
 
 QJsonObject LedDeviceWrapper::getLedDeviceSchemas()
 {
+	// the schemas are parsed on the first request of the API and kept: they can't change at runtime
+	static QMutex schemasLock;
+	static QJsonObject schemas;
+
+	QMutexLocker lock(&schemasLock);
+
+	if (!schemas.isEmpty())
+		return schemas;
+
 	// make sure the resources are loaded (they may be left out after static linking)
 	Q_INIT_RESOURCE(LedDeviceSchemas);
 
@@ -189,5 +216,7 @@ QJsonObject LedDeviceWrapper::getLedDeviceSchemas()
 		result[devName] = schemaJson;
 	}
 
+	schemas = result;
+
 	return result;
 }
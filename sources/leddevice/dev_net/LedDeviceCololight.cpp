@@ -4,8 +4,10 @@
 #include <QtEndian>
 #include <QEventLoop>
 #include <utils/QStringUtils.h>
+#include <leddevice/DiscoveryCache.h>
 
 #include <chrono>
+#include <cstring>
 
 // Constants
 namespace {
@@ -15,6 +17,7 @@ namespace {
 	// Configuration settings
 
 	const char CONFIG_HW_LED_COUNT[] = "hardwareLedCount";
+	const char CONFIG_ADDITIONAL_HOSTS[] = "additionalHosts";
 
 	// Cololight discovery service
 
@@ -37,6 +40,12 @@ namespace {
 	const int COLOLIGHT_BEADS_PER_MODULE = 19;
 	const int COLOLIGHT_MIN_STRIP_SEGMENT_SIZE = 30;
 
+	// the packet sequence number follows the header and the SECU part, then the direct color command
+	const unsigned PACKET_SN_OFFSET = sizeof(PACKET_HEADER) + sizeof(PACKET_SECU);
+	const unsigned DIRECT_COLOR_COMMAND_OFFSET = PACKET_SN_OFFSET + 1;
+	// mode, then start, end, red, green, blue for every LED
+	const unsigned DIRECT_COLOR_LED_SIZE = 5;
+
 } //End of constants
 
 LedDeviceCololight::LedDeviceCololight(const QJsonObject& deviceConfig)
@@ -45,6 +54,8 @@ LedDeviceCololight::LedDeviceCololight(const QJsonObject& deviceConfig)
 	, _ledLayoutType(STRIP_LAYOUT)
 	, _ledBeadCount(0)
 	, _distance(0)
+	, _hostLedCount(0)
+	, _directColorPacketSize(0)
 	, _sequenceNumber(1)
 {
 	_packetFixPart.append(reinterpret_cast<const char*>(PACKET_HEADER), sizeof(PACKET_HEADER));
@@ -61,6 +72,7 @@ bool LedDeviceCololight::init(const QJsonObject& deviceConfig)
 	bool isInitOK = false;
 
 	_port = API_DEFAULT_PORT;
+	_additionalTargets.clear();
 
 	if (ProviderUdp::init(deviceConfig))
 	{
@@ -69,7 +81,7 @@ bool LedDeviceCololight::init(const QJsonObject& deviceConfig)
 
 		if (initLedsConfiguration())
 		{
-			initDirectColorCmdTemplate();
+			initDirectColorPackets();
 			isInitOK = true;
 		}
 	}
@@ -119,8 +131,12 @@ bool LedDeviceCololight::initLedsConfiguration()
 				.arg(COLOLIGHT_MIN_STRIP_SEGMENT_SIZE);
 			this->setInError(errorReason);
 		}
-		else
+		else if (initAdditionalHosts())
 		{
+			// every additional host is the same model with the same LEDs, they follow the LEDs of the main one
+			_hostLedCount = getLedCount();
+			setLedCount(_hostLedCount * static_cast<int>(_additionalTargets.size() + 1));
+
 			Debug(_log, "LedCount     : %d", getLedCount());
 
 			int configuredLedCount = _devConfig["currentLedCount"].toInt(1);
@@ -146,26 +162,71 @@ bool LedDeviceCololight::initLedsConfiguration()
 	return isInitOK;
 }
 
-void LedDeviceCololight::initDirectColorCmdTemplate()
+bool LedDeviceCololight::initAdditionalHosts()
 {
-	int ledNumber = static_cast<int>(this->getLedCount());
+	_additionalTargets.clear();
 
-	_directColorCommandTemplate.clear();
+	for (const QJsonValue& value : _devConfig[CONFIG_ADDITIONAL_HOSTS].toArray())
+	{
+		const QString host = value.toString().trimmed();
+		QHostAddress address;
 
-	//Packet
-	_directColorCommandTemplate.append(static_cast<char>(bufferMode::LIGHTBEAD)); // idx
+		if (host.isEmpty())
+			continue;
 
-	int beads = 1;
+		if (!address.setAddress(host) && (address = DiscoveryCache::resolve(host)).isNull())
+		{
+			QHostInfo hostInfo = QHostInfo::fromName(host);
+			if (hostInfo.error() != QHostInfo::NoError || hostInfo.addresses().isEmpty())
+			{
+				QString errorReason = QString("Failed resolving IP-address for the additional Cololight [%1], (%2) %3").arg(host).arg(hostInfo.error()).arg(hostInfo.errorString());
+				this->setInError(errorReason);
+				return false;
+			}
+			address = hostInfo.addresses().first();
+		}
+
+		Debug(_log, "Additional Cololight: %s (%s)", QSTRING_CSTR(host), QSTRING_CSTR(address.toString()));
+		_additionalTargets.push_back(address);
+	}
+
+	return true;
+}
+
+void LedDeviceCololight::initDirectColorPackets()
+{
+	const unsigned hosts = static_cast<unsigned>(_additionalTargets.size() + 1);
+	const unsigned ledNumber = static_cast<unsigned>(_hostLedCount);
+	const quint32 size = static_cast<quint32>(sizeof(PACKET_SECU) + 1 + 1 + ledNumber * DIRECT_COLOR_LED_SIZE);
+
+	unsigned beads = 1;
 	if (_ledLayoutType == MODLUE_LAYOUT)
 	{
 		beads = COLOLIGHT_BEADS_PER_MODULE;
 	}
 
-	for (int i = 0; i < ledNumber; ++i)
+	_directColorPacketSize = DIRECT_COLOR_COMMAND_OFFSET + 1 + ledNumber * DIRECT_COLOR_LED_SIZE;
+	_directColorPackets.assign(hosts * _directColorPacketSize, 0);
+	_directColorDatagrams.clear();
+
+	for (unsigned host = 0; host < hosts; ++host)
 	{
-		_directColorCommandTemplate.append(static_cast<char>(i * beads + 1));
-		_directColorCommandTemplate.append(static_cast<char>(i * beads + beads));
-		_directColorCommandTemplate.append(3, static_cast<char>(0x00));
+		uint8_t* packet = _directColorPackets.data() + host * _directColorPacketSize;
+
+		memcpy(packet, _packetFixPart.constData(), static_cast<size_t>(_packetFixPart.size()));
+		qToBigEndian<quint16>(DIRECT_CONTROL, packet + 4);
+		qToBigEndian<quint32>(size, packet + 6);
+
+		uint8_t* command = packet + DIRECT_COLOR_COMMAND_OFFSET;
+		*(command++) = static_cast<uint8_t>(bufferMode::LIGHTBEAD); // idx
+
+		for (unsigned i = 0; i < ledNumber; ++i, command += DIRECT_COLOR_LED_SIZE)
+		{
+			command[0] = static_cast<uint8_t>(i * beads + 1);
+			command[1] = static_cast<uint8_t>(i * beads + beads);
+		}
+
+		_directColorDatagrams.push_back({ packet, _directColorPacketSize, host });
 	}
 }
 
@@ -332,21 +393,33 @@ bool LedDeviceCololight::setStateDirect(bool isOn)
 
 bool LedDeviceCololight::setColor(const std::vector<ColorRgb>& ledValues)
 {
-	int ledNumber = static_cast<int>(ledValues.size());
+	if (_directColorDatagrams.empty())
+	{
+		return false;
+	}
 
-	QByteArray command = _directColorCommandTemplate;
+	const size_t ledNumber = ledValues.size();
+	const size_t hostLedCount = static_cast<size_t>(_hostLedCount);
+	const uint8_t sequenceNumber = static_cast<uint8_t>(_sequenceNumber++);
 
-	//Update LED values, start from offset (mode + first start/stop pair) = 3
-	for (int i = 0; i < ledNumber; ++i)
+	for (size_t host = 0; host < _directColorDatagrams.size(); ++host)
 	{
-		command[3 + i * 5] = static_cast<char>(ledValues[i].red);
-		command[3 + i * 5 + 1] = static_cast<char>(ledValues[i].green);
-		command[3 + i * 5 + 2] = static_cast<char>(ledValues[i].blue);
-	}
+		uint8_t* packet = _directColorPackets.data() + host * _directColorPacketSize;
+		packet[PACKET_SN_OFFSET] = sequenceNumber;
 
-	bool isCmdOK = sendRequest(DIRECT_CONTROL, command);
+		//Update LED values, start from offset (mode + first start/stop pair) = 3
+		uint8_t* color = packet + DIRECT_COLOR_COMMAND_OFFSET + 3;
 
-	return isCmdOK;
+		for (size_t i = host * hostLedCount; i < (host + 1) * hostLedCount && i < ledNumber; ++i, color += DIRECT_COLOR_LED_SIZE)
+		{
+			color[0] = ledValues[i].red;
+			color[1] = ledValues[i].green;
+			color[2] = ledValues[i].blue;
+		}
+	}
+
+	// all the hosts in one gathered send
+	return writeDatagrams(_directColorDatagrams) >= 0;
 }
 
 bool LedDeviceCololight::setTL1CommandMode(bool isOn)
@@ -401,7 +474,14 @@ bool LedDeviceCololight::sendRequest(const appID appID, const QByteArray& comman
 
 	DebugIf(verbose3, _log, "packet: ([0x%x], [%u])[%s]", size, size, QSTRING_CSTR(toHex(packet, 64)));
 
-	if (writeBytes(packet) < 0)
+	// the commands (state, mode...) go to all the hosts driven by the instance
+	std::vector<Datagram> datagrams;
+	for (unsigned host = 0; host <= _additionalTargets.size(); ++host)
+	{
+		datagrams.push_back({ reinterpret_cast<const uint8_t*>(packet.constData()), static_cast<unsigned>(packet.size()), host });
+	}
+
+	if (writeDatagrams(datagrams) < 0)
 	{
 		isSendOK = false;
 	}
@@ -547,102 +627,112 @@ QJsonObject LedDeviceCololight::discover(const QJsonObject& /*params*/)
 	QJsonObject devicesDiscovered;
 	devicesDiscovered.insert("ledDeviceType", _activeDeviceType);
 
-	QJsonArray deviceList;
+	// the broadcast waits seconds for the answers, the last background scan is returned
+	Logger* log = _log;
+	QJsonArray deviceList = DiscoveryCache::get("cololight", [log]()
+		{
+			QJsonArray devices;
 
-	QUdpSocket udpSocket;
+			//Cololights discovered and their response message details
+			QMultiMap<QString, QMap <QString, QString>> services;
 
-	udpSocket.writeDatagram(QString(DISCOVERY_MESSAGE).toUtf8(), QHostAddress(DISCOVERY_ADDRESS), DISCOVERY_PORT);
+			QUdpSocket udpSocket;
 
-	if (udpSocket.waitForReadyRead(DEFAULT_DISCOVERY_TIMEOUT.count()))
-	{
-		while (udpSocket.waitForReadyRead(500))
-		{
-			QByteArray datagram;
+			udpSocket.writeDatagram(QString(DISCOVERY_MESSAGE).toUtf8(), QHostAddress(DISCOVERY_ADDRESS), DISCOVERY_PORT);
 
-			while (udpSocket.hasPendingDatagrams())
+			if (udpSocket.waitForReadyRead(DEFAULT_DISCOVERY_TIMEOUT.count()))
 			{
-				datagram.resize(static_cast<int>(udpSocket.pendingDatagramSize()));
-				QHostAddress senderIP;
-				quint16 senderPort;
+				while (udpSocket.waitForReadyRead(500))
+				{
+					QByteArray datagram;
 
-				udpSocket.readDatagram(datagram.data(), datagram.size(), &senderIP, &senderPort);
+					while (udpSocket.hasPendingDatagrams())
+					{
+						datagram.resize(static_cast<int>(udpSocket.pendingDatagramSize()));
+						QHostAddress senderIP;
+						quint16 senderPort;
 
-				QString data(datagram);
+						udpSocket.readDatagram(datagram.data(), datagram.size(), &senderIP, &senderPort);
 
-				QMap<QString, QString> headers;
-				// parse request
-				QStringList entries = QStringUtils::SPLITTER(data, '\n');
-				for (auto entry : entries)
-				{
-					// split into key=value, be aware that value field may contain also a "="
-					entry = entry.simplified();
-					int pos = entry.indexOf("=");
-					if (pos == -1)
-					{
-						continue;
-					}
+						QString data(datagram);
 
-					const QString key = entry.left(pos).trimmed().toLower();
-					const QString value = entry.mid(pos + 1).trimmed();
-					headers[key] = value;
-				}
+						QMap<QString, QString> headers;
+						// parse request
+						QStringList entries = QStringUtils::SPLITTER(data, '\n');
+						for (auto entry : entries)
+						{
+							// split into key=value, be aware that value field may contain also a "="
+							entry = entry.simplified();
+							int pos = entry.indexOf("=");
+							if (pos == -1)
+							{
+								continue;
+							}
 
-				if (headers.value("mod") == COLOLIGHT_MODEL_IDENTIFIER)
-				{
-					QString ipAddress = QHostAddress(senderIP.toIPv4Address()).toString();
-					_services.insert(ipAddress, headers);
+							const QString key = entry.left(pos).trimmed().toLower();
+							const QString value = entry.mid(pos + 1).trimmed();
+							headers[key] = value;
+						}
 
-					Debug(_log, "Cololight discovered at [%s]", QSTRING_CSTR(ipAddress));
-					DebugIf(verbose3, _log, "_data: [%s]", QSTRING_CSTR(data));
+						if (headers.value("mod") == COLOLIGHT_MODEL_IDENTIFIER)
+						{
+							QString ipAddress = QHostAddress(senderIP.toIPv4Address()).toString();
+							services.insert(ipAddress, headers);
+
+							Debug(log, "Cololight discovered at [%s]", QSTRING_CSTR(ipAddress));
+							DebugIf(verbose3, log, "_data: [%s]", QSTRING_CSTR(data));
+						}
+					}
 				}
 			}
-		}
-	}
 
-	for (auto i = _services.begin(); i != _services.end(); ++i)
-	{
-		QJsonObject obj;
+			for (auto i = services.begin(); i != services.end(); ++i)
+			{
+				QJsonObject obj;
 
-		QString ipAddress = i.key();
-		obj.insert("ip", ipAddress);
-		obj.insert("model", i.value().value(COLOLIGHT_MODEL));
-		obj.insert("type", i.value().value(COLOLIGHT_MODEL_TYPE));
-		obj.insert("mac", i.value().value(COLOLIGHT_MAC));
-		obj.insert("name", i.value().value(COLOLIGHT_NAME));
+				QString ipAddress = i.key();
+				obj.insert("ip", ipAddress);
+				obj.insert("model", i.value().value(COLOLIGHT_MODEL));
+				obj.insert("type", i.value().value(COLOLIGHT_MODEL_TYPE));
+				obj.insert("mac", i.value().value(COLOLIGHT_MAC));
+				obj.insert("name", i.value().value(COLOLIGHT_NAME));
 
-		QHostInfo hostInfo = QHostInfo::fromName(i.key());
-		if (hostInfo.error() == QHostInfo::NoError)
-		{
-			QString hostname = hostInfo.hostName();
-			if (!QHostInfo::localDomainName().isEmpty())
-			{
-				obj.insert("hostname", hostname.remove("." + QHostInfo::localDomainName()));
-				obj.insert("domain", QHostInfo::localDomainName());
-			}
-			else
-			{
-				if (hostname.startsWith(ipAddress))
+				QHostInfo hostInfo = QHostInfo::fromName(i.key());
+				if (hostInfo.error() == QHostInfo::NoError)
 				{
-					obj.insert("hostname", ipAddress);
-
-					QString domain = hostname.remove(ipAddress);
-					if (domain.at(0) == '.')
+					QString hostname = hostInfo.hostName();
+					if (!QHostInfo::localDomainName().isEmpty())
 					{
-						domain.remove(0, 1);
+						obj.insert("hostname", hostname.remove("." + QHostInfo::localDomainName()));
+						obj.insert("domain", QHostInfo::localDomainName());
+					}
+					else
+					{
+						if (hostname.startsWith(ipAddress))
+						{
+							obj.insert("hostname", ipAddress);
+
+							QString domain = hostname.remove(ipAddress);
+							if (domain.at(0) == '.')
+							{
+								domain.remove(0, 1);
+							}
+							obj.insert("domain", domain);
+						}
+						else
+						{
+							int domainPos = hostname.indexOf('.');
+							obj.insert("hostname", hostname.left(domainPos));
+							obj.insert("domain", hostname.mid(domainPos + 1));
+						}
 					}
-					obj.insert("domain", domain);
-				}
-				else
-				{
-					int domainPos = hostname.indexOf('.');
-					obj.insert("hostname", hostname.left(domainPos));
-					obj.insert("domain", hostname.mid(domainPos + 1));
 				}
+
+				devices << obj;
 			}
-		}
 
-		deviceList << obj;
-	}
+			return devices;
+		});
 
 	devicesDiscovered.insert("devices", deviceList);
 	DebugIf(verbose, _log, "devicesDiscovered: [%s]", QString(QJsonDocument(devicesDiscovered).toJson(QJsonDocument::Compact)).toUtf8().constData());
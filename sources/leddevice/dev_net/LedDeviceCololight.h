@@ -186,7 +186,18 @@ protected:
 private:
 
 	bool initLedsConfiguration();
-	void initDirectColorCmdTemplate();
+
+	///
+	/// @brief Resolve the additional Cololight hosts, they get the next segments of the LEDs
+	///
+	/// @return True if success
+	///
+	bool initAdditionalHosts();
+
+	///
+	/// @brief Build the direct color packet of every host once, a frame only patches the sequence number and the colors
+	///
+	void initDirectColorPackets();
 
 	///
 	/// @brief Read additional information from Cololight
@@ -299,12 +310,15 @@ private:
 	QByteArray _packetFixPart;
 	QByteArray _DataPart;
 
-	QByteArray _directColorCommandTemplate;
+	// LEDs of one host, the instance drives them for every host one after another
+	int _hostLedCount;
 
-	quint32 _sequenceNumber;
+	// the complete direct color packets of all the hosts and their datagrams for the gathered send
+	std::vector<uint8_t> _directColorPackets;
+	std::vector<Datagram> _directColorDatagrams;
+	unsigned _directColorPacketSize;
 
-	//Cololights discovered and their response message details
-	QMultiMap<QString, QMap <QString, QString>> _services;
+	quint32 _sequenceNumber;
 };
 
 #endif // LEDEVICECOLOLIGHT_H
@@ -3,6 +3,7 @@
 #include <QtEndian>
 
 #include <chrono>
+#include <cstring>
 
 // https://docs.microsoft.com/en-us/windows/win32/winprog/windows-data-types#ssize-t
 #if defined(_MSC_VER)
@@ -18,6 +19,9 @@ namespace {
 	const int OPC_SET_PIXELS = 0; // OPC command codes
 	const int OPC_SYS_EX = 255; // OPC command codes
 	const int OPC_HEADER_SIZE = 4; // OPC header size
+	const int MAX_CHANNEL = 255;
+	// more frames than that wait in the socket: the next ones are skipped until they are sent
+	const qint64 MAX_BACKLOG_FRAMES = 1;
 } //End of constants
 
 // TCP elements
@@ -28,6 +32,9 @@ LedDeviceFadeCandy::LedDeviceFadeCandy(const QJsonObject& deviceConfig)
 	, _client(nullptr)
 	, _host()
 	, _port(STREAM_DEFAULT_PORT)
+	, _channel(0)
+	, _ledsPerChannel(0)
+	, _droppedFrames(0)
 {
 }
 
@@ -66,6 +73,7 @@ bool LedDeviceFadeCandy::init(const QJsonObject& deviceConfig)
 			else
 			{
 				_channel = deviceConfig["channel"].toInt(0);
+				_ledsPerChannel = deviceConfig["ledsPerChannel"].toInt(0);
 				_gamma = deviceConfig["gamma"].toDouble(1.0);
 				_noDither = !deviceConfig["dither"].toBool(false);
 				_noInterp = !deviceConfig["interpolation"].toBool(false);
@@ -85,14 +93,23 @@ bool LedDeviceFadeCandy::init(const QJsonObject& deviceConfig)
 					_whitePoint_b = whitePointConfig[2].toDouble() / 255.0;
 				}
 
-				_opc_data.resize(static_cast<int>(_ledRGBCount) + OPC_HEADER_SIZE);
-				_opc_data[0] = static_cast<char>(_channel);
-				_opc_data[1] = OPC_SET_PIXELS;
-				qToBigEndian<quint16>(static_cast<quint16>(_ledRGBCount), _opc_data.data() + 2);
+				if (_ledsPerChannel <= 0 || _ledsPerChannel >= static_cast<int>(_ledCount))
+					_ledsPerChannel = static_cast<int>(_ledCount);
 
-				if (initNetwork())
+				const int channels = (static_cast<int>(_ledCount) + _ledsPerChannel - 1) / qMax(_ledsPerChannel, 1);
+
+				if (_channel + channels - 1 > MAX_CHANNEL)
+				{
+					this->setInError(QString("The LEDs need %1 OPC channels from channel %2, the last channel is %3").arg(channels).arg(_channel).arg(MAX_CHANNEL));
+				}
+				else
 				{
-					isInitOK = true;
+					buildPackets();
+
+					if (initNetwork())
+					{
+						isInitOK = true;
+					}
 				}
 			}
 		}
@@ -100,6 +117,30 @@ bool LedDeviceFadeCandy::init(const QJsonObject& deviceConfig)
 	return isInitOK;
 }
 
+void LedDeviceFadeCandy::buildPackets()
+{
+	// every channel has its header followed by its colors, the whole frame leaves in one write
+	const int ledCount = static_cast<int>(_ledCount);
+	const int channels = (ledCount + _ledsPerChannel - 1) / qMax(_ledsPerChannel, 1);
+
+	_opc_data.fill(0, ledCount * 3 + channels * OPC_HEADER_SIZE);
+
+	char* packet = _opc_data.data();
+	for (int channel = 0; channel < channels; channel++)
+	{
+		const int leds = qMin(_ledsPerChannel, ledCount - channel * _ledsPerChannel);
+
+		packet[0] = static_cast<char>(_channel + channel);
+		packet[1] = OPC_SET_PIXELS;
+		qToBigEndian<quint16>(static_cast<quint16>(leds * 3), packet + 2);
+
+		packet += OPC_HEADER_SIZE + leds * 3;
+	}
+
+	if (channels > 1)
+		Debug(_log, "fadecandy/opc: %d LEDs on the channels %d-%d", ledCount, _channel, _channel + channels - 1);
+}
+
 bool LedDeviceFadeCandy::initNetwork()
 {
 	bool isInitOK = false;
@@ -165,6 +206,10 @@ bool LedDeviceFadeCandy::tryConnect()
 			_client->connectToHost(_host, static_cast<quint16>(_port));
 			if (_client->waitForConnected(CONNECT_TIMEOUT.count()))
 			{
+				// a frame is sent at once instead of waiting for the ack of the previous one (Nagle)
+				_client->setSocketOption(QAbstractSocket::LowDelayOption, 1);
+				_droppedFrames = 0;
+
 				Info(_log, "fadecandy/opc: connected to %s:%d on channel %d", QSTRING_CSTR(_host), _port, _channel);
 				if (_setFcConfig)
 				{
@@ -178,13 +223,34 @@ bool LedDeviceFadeCandy::tryConnect()
 
 int LedDeviceFadeCandy::write(const std::vector<ColorRgb>& ledValues)
 {
-	uint idx = OPC_HEADER_SIZE;
-	for (const ColorRgb& color : ledValues)
+	// the server can't keep up: the newest frame is skipped instead of queuing the frames behind each other
+	if (isConnected() && _client->bytesToWrite() > MAX_BACKLOG_FRAMES * _opc_data.size())
 	{
-		_opc_data[idx] = static_cast<char>(color.red);
-		_opc_data[idx + 1] = static_cast<char>(color.green);
-		_opc_data[idx + 2] = static_cast<char>(color.blue);
-		idx += 3;
+		if (_droppedFrames++ == 0)
+			Debug(_log, "fadecandy/opc: the server is slow, skipping the frames while %lld bytes wait to be sent", _client->bytesToWrite());
+		return 0;
+	}
+
+	if (_droppedFrames > 0)
+	{
+		Debug(_log, "fadecandy/opc: the server caught up, %d frames were skipped", _droppedFrames);
+		_droppedFrames = 0;
+	}
+
+	// the colors are patched into the packets of the channels, the headers stay as they were built
+	const int ledCount = static_cast<int>(_ledCount);
+	const int colorCount = qMin(static_cast<int>(ledValues.size()), ledCount);
+	const ColorRgb* colors = ledValues.data();
+	char* packet = _opc_data.data();
+
+	for (int first = 0; first < ledCount; first += _ledsPerChannel)
+	{
+		const int leds = qMin(_ledsPerChannel, ledCount - first);
+
+		if (first < colorCount)
+			memcpy(packet + OPC_HEADER_SIZE, colors + first, static_cast<size_t>(qMin(leds, colorCount - first)) * sizeof(ColorRgb));
+
+		packet += OPC_HEADER_SIZE + leds * 3;
 	}
 
 	int retval = transferData() < 0 ? -1 : 0;
@@ -195,7 +261,13 @@ qint64 LedDeviceFadeCandy::transferData()
 {
 	if (isConnected() || tryConnect())
 	{
-		return _client->write(_opc_data);
+		const qint64 written = _client->write(_opc_data);
+
+		// out now, not when the event loop of the device thread gets to it
+		if (written > 0)
+			_client->flush();
+
+		return written;
 	}
 	return -2;
 }
@@ -27,6 +27,8 @@ public:
 	/// 	"name"          : "MyPi",
 	/// 	"type"          : "fadecandy",
 	/// 	"output"        : "localhost",
+	/// 	"channel"       : 0,
+	/// 	"ledsPerChannel": 0,
 	/// 	"colorOrder"    : "rgb",
 	/// 	"setFcConfig"   : false,
 	/// 	"gamma"         : 1.0,
@@ -115,6 +117,11 @@ private:
 	///
 	qint64 transferData();
 
+	///
+	/// @brief Prepares the OPC packets of all the channels in one buffer, only the colors are patched by write()
+	///
+	void buildPackets();
+
 	///
 	/// @brief Send system exclusive commands
 	///
@@ -133,7 +140,11 @@ private:
 	QString     _host;
 	int    _port;
 	int    _channel;
+	/// the LEDs of one OPC channel (one fadecandy board of the fcserver), 0 for a single channel
+	int    _ledsPerChannel;
 	QByteArray  _opc_data;
+	/// the frames skipped while the socket was still sending
+	int    _droppedFrames;
 
 	// fadecandy sysEx
 	bool        _setFcConfig;
@@ -1,7 +1,9 @@
 // Local-HyperHDR includes
 #include "LedDeviceNanoleaf.h"
 #include <utils/QStringUtils.h>
+#include <utils/InternalClock.h>
 #include <ssdp/SSDPDiscover.h>
+#include <leddevice/DiscoveryCache.h>
 
 // Qt includes
 #include <QEventLoop>
@@ -11,6 +13,8 @@
 //std includes
 #include <sstream>
 #include <iomanip>
+#include <chrono>
+#include <cstring>
 
 // Constants
 namespace {
@@ -67,6 +71,8 @@ namespace {
 	//Nanoleaf Control data stream
 	const int STREAM_FRAME_PANEL_NUM_SIZE = 2;
 	const int STREAM_FRAME_PANEL_INFO_SIZE = 8;
+	const int STREAM_FRAME_TRANSITION_TIME = 1; // currently fixed at value 1 which corresponds to 100ms
+	constexpr std::chrono::milliseconds STREAM_FULL_FRAME_INTERVAL{ 1000 }; // all panels are sent again after this period
 
 	// Nanoleaf ssdp services
 	const char SSDP_ID[] = "ssdp:all";
@@ -101,6 +107,7 @@ LedDeviceNanoleaf::LedDeviceNanoleaf(const QJsonObject& deviceConfig)
 	, _endPos(0)
 	, _extControlVersion(EXTCTRLVER_V2),
 	_panelLedCount(0)
+	, _lastFullFrameTime(0)
 {
 }
 
@@ -221,6 +228,8 @@ bool LedDeviceNanoleaf::initLedsConfiguration()
 		Debug(_log, "PanelsNum      : %d", panelNum);
 		Debug(_log, "PanelLedCount  : %d", _panelLedCount);
 
+		buildStreamFrame();
+
 		// Check. if enough panels were found.
 		int configuredLedCount = this->getLedCount();
 		_endPos = _startPos + configuredLedCount - 1;
@@ -367,6 +376,9 @@ int LedDeviceNanoleaf::open()
 
 	if (ProviderUdp::open() == 0)
 	{
+		// a new stream starts with all panels
+		_lastFullFrameTime = 0;
+
 		// Everything is OK, device is ready
 		_isDeviceReady = true;
 		retval = 0;
@@ -395,21 +407,24 @@ QJsonObject LedDeviceNanoleaf::discover(const QJsonObject& /*params*/)
 	QJsonObject devicesDiscovered;
 	devicesDiscovered.insert("ledDeviceType", _activeDeviceType);
 
-	QJsonArray deviceList;
-
-	// Discover Nanoleaf Devices
-	SSDPDiscover discover;
+	// Discover Nanoleaf Devices, from the last background scan
+	QJsonArray deviceList = DiscoveryCache::get("ssdp:nanoleaf", []()
+		{
+			QJsonArray devices;
+			SSDPDiscover discover;
 
-	// Search for Canvas and Light-Panels
-	QString searchTargetFilter = QString("%1|%2").arg(SSDP_CANVAS, SSDP_LIGHTPANELS);
+			// Search for Canvas and Light-Panels
+			QString searchTargetFilter = QString("%1|%2").arg(SSDP_CANVAS, SSDP_LIGHTPANELS);
 
-	discover.setSearchFilter(searchTargetFilter, SSDP_FILTER_HEADER);
-	QString searchTarget = SSDP_ID;
+			discover.setSearchFilter(searchTargetFilter, SSDP_FILTER_HEADER);
+			QString searchTarget = SSDP_ID;
 
-	if (discover.discoverServices(searchTarget) > 0)
-	{
-		deviceList = discover.getServicesDiscoveredJson();
-	}
+			if (discover.discoverServices(searchTarget) > 0)
+			{
+				devices = discover.getServicesDiscoveredJson();
+			}
+			return devices;
+		});
 
 	devicesDiscovered.insert("devices", deviceList);
 	Debug(_log, "devicesDiscovered: [%s]", QString(QJsonDocument(devicesDiscovered).toJson(QJsonDocument::Compact)).toUtf8().constData());
@@ -529,10 +544,8 @@ bool LedDeviceNanoleaf::powerOff()
 
 
 
-int LedDeviceNanoleaf::write(const std::vector<ColorRgb>& ledValues)
+void LedDeviceNanoleaf::buildStreamFrame()
 {
-	int retVal = 0;
-
 	//
 	//    nPanels         2B
 	//    panelID         2B
@@ -542,24 +555,53 @@ int LedDeviceNanoleaf::write(const std::vector<ColorRgb>& ledValues)
 	//
 	// Note: Nanoleaf Light Panels (Aurora) now support External Control V2 (tested with FW 3.2.0)
 
-	int udpBufferSize = STREAM_FRAME_PANEL_NUM_SIZE + _panelLedCount * STREAM_FRAME_PANEL_INFO_SIZE;
-
-	QByteArray udpbuffer;
-	udpbuffer.resize(udpBufferSize);
+	_streamFrame.fill(0, STREAM_FRAME_PANEL_NUM_SIZE + _panelLedCount * STREAM_FRAME_PANEL_INFO_SIZE);
+	_deltaFrame.fill(0, _streamFrame.size());
 
-	int i = 0;
+	char* record = _streamFrame.data();
 
 	// Set number of panels
-	qToBigEndian<quint16>(static_cast<quint16>(_panelLedCount), udpbuffer.data() + i);
-	i += 2;
+	qToBigEndian<quint16>(static_cast<quint16>(_panelLedCount), record);
+	record += STREAM_FRAME_PANEL_NUM_SIZE;
+
+	for (int panelCounter = 0; panelCounter < _panelLedCount; panelCounter++)
+	{
+		// Set panelID, the color and the white LED (not set manually) are patched at every frame
+		qToBigEndian<quint16>(static_cast<quint16>(_panelIds[panelCounter]), record);
+
+		// Set transition time
+		qToBigEndian<quint16>(static_cast<quint16>(STREAM_FRAME_TRANSITION_TIME), record + 6);
+
+		record += STREAM_FRAME_PANEL_INFO_SIZE;
+	}
+
+	_lastFullFrameTime = 0;
+}
+
+int LedDeviceNanoleaf::write(const std::vector<ColorRgb>& ledValues)
+{
+	int retVal = 0;
+
+	int udpBufferSize = STREAM_FRAME_PANEL_NUM_SIZE + _panelLedCount * STREAM_FRAME_PANEL_INFO_SIZE;
+
+	if (_streamFrame.size() != udpBufferSize)
+	{
+		buildStreamFrame();
+	}
+
+	// the panels keep their color, so only the changed ones are sent between the full frames that cover lost packets
+	qint64 now = InternalClock::now();
+	bool fullFrame = (now - _lastFullFrameTime >= STREAM_FULL_FRAME_INTERVAL.count());
 
-	ColorRgb color;
+	char* record = _streamFrame.data() + STREAM_FRAME_PANEL_NUM_SIZE;
+	char* delta = _deltaFrame.data() + STREAM_FRAME_PANEL_NUM_SIZE;
+	int changedPanels = 0;
 
 	//Maintain LED counter independent from PanelCounter
 	int ledCounter = 0;
-	for (int panelCounter = 0; panelCounter < _panelLedCount; panelCounter++)
+	for (int panelCounter = 0; panelCounter < _panelLedCount; panelCounter++, record += STREAM_FRAME_PANEL_INFO_SIZE)
 	{
-		int panelID = _panelIds[panelCounter];
+		ColorRgb color;
 
 		// Set panels configured
 		if (panelCounter >= _startPos && panelCounter <= _endPos) {
@@ -573,32 +615,50 @@ int LedDeviceNanoleaf::write(const std::vector<ColorRgb>& ledValues)
 			DebugIf(verbose3, _log, "[%d] >= panelLedCount [%d] => Set to BLACK", panelCounter, _panelLedCount);
 		}
 
-		// Set panelID
-		qToBigEndian<quint16>(static_cast<quint16>(panelID), udpbuffer.data() + i);
-		i += 2;
-
 		// Set panel's color LEDs
-		udpbuffer[i++] = static_cast<char>(color.red);
-		udpbuffer[i++] = static_cast<char>(color.green);
-		udpbuffer[i++] = static_cast<char>(color.blue);
-
-		// Set white LED
-		udpbuffer[i++] = 0; // W not set manually
+		if (record[2] != static_cast<char>(color.red) || record[3] != static_cast<char>(color.green) || record[4] != static_cast<char>(color.blue))
+		{
+			record[2] = static_cast<char>(color.red);
+			record[3] = static_cast<char>(color.green);
+			record[4] = static_cast<char>(color.blue);
+		}
+		else if (!fullFrame)
+		{
+			continue;
+		}
 
-		// Set transition time
-		unsigned char tranitionTime = 1; // currently fixed at value 1 which corresponds to 100ms
-		qToBigEndian<quint16>(static_cast<quint16>(tranitionTime), udpbuffer.data() + i);
-		i += 2;
+		if (!fullFrame)
+		{
+			memcpy(delta, record, STREAM_FRAME_PANEL_INFO_SIZE);
+			delta += STREAM_FRAME_PANEL_INFO_SIZE;
+		}
+		++changedPanels;
 
 		DebugIf(verbose3, _log, "[%u] Color: {%u,%u,%u}", panelCounter, color.red, color.green, color.blue);
 	}
 
-	if (verbose3)
+	if (fullFrame)
+	{
+		_lastFullFrameTime = now;
+
+		if (verbose3)
+		{
+			Debug(_log, "UDP-Address [%s], UDP-Port [%u], udpBufferSize[%d], Bytes to send [%d]", QSTRING_CSTR(_address.toString()), _port, udpBufferSize, udpBufferSize);
+			Debug(_log, "packet: [%s]", QSTRING_CSTR(toHex(_streamFrame, 64)));
+		}
+
+		retVal = writeBytes(static_cast<unsigned>(udpBufferSize), reinterpret_cast<const uint8_t*>(_streamFrame.constData()));
+	}
+	else if (changedPanels > 0)
 	{
-		Debug(_log, "UDP-Address [%s], UDP-Port [%u], udpBufferSize[%d], Bytes to send [%d]", QSTRING_CSTR(_address.toString()), _port, udpBufferSize, i);
-		Debug(_log, "packet: [%s]", QSTRING_CSTR(toHex(udpbuffer, 64)));
+		// Set number of panels
+		qToBigEndian<quint16>(static_cast<quint16>(changedPanels), _deltaFrame.data());
+
+		int deltaSize = STREAM_FRAME_PANEL_NUM_SIZE + changedPanels * STREAM_FRAME_PANEL_INFO_SIZE;
+		DebugIf(verbose3, _log, "UDP-Address [%s], UDP-Port [%u], changed panels [%d], Bytes to send [%d]", QSTRING_CSTR(_address.toString()), _port, changedPanels, deltaSize);
+
+		retVal = writeBytes(static_cast<unsigned>(deltaSize), reinterpret_cast<const uint8_t*>(_deltaFrame.constData()));
 	}
 
-	retVal = writeBytes(udpbuffer);
 	return retVal;
 }
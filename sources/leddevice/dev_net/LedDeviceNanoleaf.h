@@ -160,6 +160,11 @@ private:
 	///
 	QString getOnOffRequest(bool isOn) const;
 
+	///
+	/// @brief Build the stream packet template from the panel layout
+	///
+	void buildStreamFrame();
+
 	///REST-API wrapper
 	ProviderRestApi* _restApi;
 
@@ -182,6 +187,12 @@ private:
 
 	/// Array of the panel ids.
 	QVector<int> _panelIds;
+
+	/// The stream packet of all panels: the ids and the transition time are set once, the colors at every frame
+	QByteArray _streamFrame;
+	/// The packet of the changed panels only
+	QByteArray _deltaFrame;
+	qint64 _lastFullFrameTime;
 };
 
 #endif // LEDEVICENANOLEAF_H
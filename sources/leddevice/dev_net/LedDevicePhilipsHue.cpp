@@ -6,6 +6,7 @@
 	#include <bonjour/DiscoveryWrapper.h>
 #endif
 #include <ssdp/SSDPDiscover.h>
+#include <leddevice/DiscoveryCache.h>
 
 #include <chrono>
 #include <cmath>
@@ -103,6 +104,7 @@ namespace {
 	const char API_CHANNELS_V2[] = "channels";
 	const char API_GROUPS_V2[] = "entertainment_configuration";
 	const char API_BASE_PATH_V2[] = "/clip/v2/resource";
+	const int MAX_CHANNELS_V2 = 20;
 	const char API_HEADER_KEY_V2[] = "hue-application-key";
 	const char API_HEADER_ID_V2[] = "hue-application-id";
 	const char API_LIGHT_V2[] = "light";
@@ -628,6 +630,16 @@ void LedDevicePhilipsHueBridge::setLightState(unsigned int lightId, const QStrin
 	post(QString("%1/%2/%3").arg(API_LIGHTS).arg(lightId).arg(API_STATE), state);
 }
 
+void LedDevicePhilipsHueBridge::setLightStateAsync(unsigned int lightId, const QString& state)
+{
+	if (_restApi == nullptr)
+		return;
+
+	DebugIf(verbose, _log, "SetLightStateAsync [%u]: %s", lightId, QSTRING_CSTR(state));
+	_restApi->setPath(QString("%1/%2/%3").arg(API_LIGHTS).arg(lightId).arg(API_STATE));
+	_restApi->putAsync(state);
+}
+
 QJsonDocument LedDevicePhilipsHueBridge::getGroupState(unsigned int groupId)
 {
 	DebugIf(verbose, _log, "GetGroupState [%u]", groupId);
@@ -750,6 +762,10 @@ QJsonArray LedDevicePhilipsHueBridge::getGroupChannelsV2(QString groupId) const
 		Info(_log, "Entertainment Group [%s] \"%s\" with %d channels found", QSTRING_CSTR(groupId),
 			QSTRING_CSTR(groupName),
 			groupLights.size());
+
+		// an Entertainment API v2 stream message carries up to 20 channels
+		if (groupLights.size() > MAX_CHANNELS_V2)
+			Warning(_log, "The entertainment area has %d channels, the bridge streams only the first %d", groupLights.size(), MAX_CHANNELS_V2);
 	}
 	else
 	{
@@ -2119,13 +2135,13 @@ void LedDevicePhilipsHue::setState(PhilipsHueLight& light, bool on, const CiColo
 			_lastConfirm = _currentTime;
 		}
 
+		// the requests of a light are sent in order, the device thread doesn't wait for the bridge
 		if (!stateCmd.isEmpty())
-			setLightState(light.getId(), "{" + stateCmd + "}");
+			setLightStateAsync(light.getId(), "{" + stateCmd + "}");
 
 		if (!powerCmd.isEmpty() && !on)
 		{
-			QThread::msleep(50);
-			setLightState(light.getId(), "{" + powerCmd + "}");
+			setLightStateAsync(light.getId(), "{" + powerCmd + "}");
 		}
 	}
 }
@@ -2233,17 +2249,22 @@ QJsonObject LedDevicePhilipsHue::discover(const QJsonObject& /*params*/)
 #endif
 	if (deviceList.isEmpty())
 	{
-		// Discover Devices
-		SSDPDiscover discover;
+		// Discover Devices, from the last background scan
+		deviceList = DiscoveryCache::get("ssdp:hue", []()
+			{
+				QJsonArray devices;
+				SSDPDiscover discover;
 
-		discover.skipDuplicateKeys(false);
-		discover.setSearchFilter(SSDP_FILTER, SSDP_FILTER_HEADER);
-		QString searchTarget = SSDP_ID;
+				discover.skipDuplicateKeys(false);
+				discover.setSearchFilter(SSDP_FILTER, SSDP_FILTER_HEADER);
+				QString searchTarget = SSDP_ID;
 
-		if (discover.discoverServices(searchTarget) > 0)
-		{
-			deviceList = discover.getServicesDiscoveredJson();
-		}
+				if (discover.discoverServices(searchTarget) > 0)
+				{
+					devices = discover.getServicesDiscoveredJson();
+				}
+				return devices;
+			});
 	}
 
 	devicesDiscovered.insert("devices", deviceList);
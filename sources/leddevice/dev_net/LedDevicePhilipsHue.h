@@ -260,6 +260,8 @@ public:
 
 	QJsonDocument getLightState(unsigned int lightId);
 	void setLightState(unsigned int lightId = 0, const QString& state = "");
+	/// the same without waiting for the bridge, a newer state replaces the one that is still waiting
+	void setLightStateAsync(unsigned int lightId, const QString& state);
 
 	QMap<quint16, QJsonObject> getLightMap() const;
 
@@ -32,6 +32,7 @@ bool LedDeviceUdpArtNet::init(const QJsonObject& deviceConfig)
 	{
 		_artnet_universe = deviceConfig["universe"].toInt(1);
 		_artnet_channelsPerFixture = deviceConfig["channelsPerFixture"].toInt(3);
+		_artnet_channelCount = 0;
 
 		isInitOK = true;
 	}
@@ -39,7 +40,7 @@ bool LedDeviceUdpArtNet::init(const QJsonObject& deviceConfig)
 }
 
 // populates the headers
-void LedDeviceUdpArtNet::prepare(unsigned this_universe, unsigned this_sequence, unsigned this_dmxChannelCount)
+void LedDeviceUdpArtNet::prepare(artnet_packet_t& artnet_packet, unsigned this_universe, unsigned this_sequence, unsigned this_dmxChannelCount)
 {
 	// WTF? why do the specs say:
 	// "This value should be an even number in the range 2 – 512. "
@@ -59,12 +60,49 @@ void LedDeviceUdpArtNet::prepare(unsigned this_universe, unsigned this_sequence,
 	artnet_packet.Length = htons(this_dmxChannelCount);
 }
 
-int LedDeviceUdpArtNet::write(const std::vector<ColorRgb>& ledValues)
+void LedDeviceUdpArtNet::preparePackets()
 {
-	int retVal = 0;
 	int thisUniverse = _artnet_universe;
+	int dmxIdx = 0;			// offset into the current dmx packet
+
+	_artnet_packets.clear();
+	_artnet_datagrams.clear();
+
+	// the same walk as the colors take in write(): it decides the universes and the sizes of the packets
+	for (unsigned int ledIdx = 0; ledIdx < _ledRGBCount; ledIdx++)
+	{
+		dmxIdx++;
+		if ((ledIdx % 3 == 2) && (ledIdx > 0))
+		{
+			dmxIdx += (_artnet_channelsPerFixture - 3);
+		}
+
+		//     is this the   last byte of last packet   ||   last byte of other packets
+		if ((ledIdx == _ledRGBCount - 1) || (dmxIdx >= DMX_MAX))
+		{
+			artnet_packet_t packet;
+			memset(packet.raw, 0, sizeof(packet.raw));
+			prepare(packet, thisUniverse, _artnet_seq, dmxIdx);
+			_artnet_packets.push_back(packet);
+			_artnet_datagrams.push_back({ nullptr, static_cast<unsigned>(18 + qMin(dmxIdx, DMX_MAX)) });
+			thisUniverse++;
+			dmxIdx = 0;
+		}
+	}
+
+	for (size_t i = 0; i < _artnet_packets.size(); i++)
+		_artnet_datagrams[i].data = _artnet_packets[i].raw;
+
+	_artnet_channelCount = _ledRGBCount;
+}
+
+int LedDeviceUdpArtNet::write(const std::vector<ColorRgb>& ledValues)
+{
 	const uint8_t* rawdata = reinterpret_cast<const uint8_t*>(ledValues.data());
 
+	if (_artnet_channelCount != _ledRGBCount || _artnet_packets.empty())
+		preparePackets();
+
 	/*
 	This field is incremented in the range 0x01 to 0xff to allow the receiving node to resequence packets.
 	The Sequence field is set to 0x00 to disable this feature.
@@ -74,30 +112,50 @@ int LedDeviceUdpArtNet::write(const std::vector<ColorRgb>& ledValues)
 		_artnet_seq = 1;
 	}
 
-	int dmxIdx = 0;			// offset into the current dmx packet
-
-	memset(artnet_packet.raw, 0, sizeof(artnet_packet.raw));
-	for (unsigned int ledIdx = 0; ledIdx < _ledRGBCount; ledIdx++)
+	// the headers are ready and the gaps between the fixtures stay zero: only the sequence and the colors change
+	if (_artnet_channelsPerFixture == 3)
 	{
-
-		artnet_packet.Data[dmxIdx++] = rawdata[ledIdx];
-		if ((ledIdx % 3 == 2) && (ledIdx > 0))
+		for (size_t i = 0; i < _artnet_packets.size(); i++)
 		{
-			dmxIdx += (_artnet_channelsPerFixture - 3);
+			_artnet_packets[i].Sequence = _artnet_seq;
+			memcpy(_artnet_packets[i].Data, rawdata + i * DMX_MAX, _artnet_datagrams[i].size - 18);
 		}
+	}
+	else
+	{
+		size_t packetIdx = 0;
+		int dmxIdx = 0;			// offset into the current dmx packet
 
-		//     is this the   last byte of last packet   ||   last byte of other packets
-		if ((ledIdx == _ledRGBCount - 1) || (dmxIdx >= DMX_MAX))
+		for (unsigned int ledIdx = 0; ledIdx < _ledRGBCount; ledIdx++)
 		{
-			prepare(thisUniverse, _artnet_seq, dmxIdx);
-			retVal &= writeBytes(18 + qMin(dmxIdx, DMX_MAX), artnet_packet.raw);
-
-			memset(artnet_packet.raw, 0, sizeof(artnet_packet.raw));
-			thisUniverse++;
-			dmxIdx = 0;
+			_artnet_packets[packetIdx].Data[dmxIdx++] = rawdata[ledIdx];
+			if ((ledIdx % 3 == 2) && (ledIdx > 0))
+			{
+				dmxIdx += (_artnet_channelsPerFixture - 3);
+			}
+
+			//     is this the   last byte of last packet   ||   last byte of other packets
+			if ((ledIdx == _ledRGBCount - 1) || (dmxIdx >= DMX_MAX))
+			{
+				_artnet_packets[packetIdx].Sequence = _artnet_seq;
+				packetIdx++;
+				dmxIdx = 0;
+			}
 		}
-
 	}
 
-	return retVal;
+	return writeDatagrams(_artnet_datagrams);
+}
+
+int LedDeviceUdpArtNet::writeSyncTrigger()
+{
+	// ArtSync: the nodes that received it once keep the OpDmx data until the next one
+	uint8_t artSync[14] = { 'A', 'r', 't', '-', 'N', 'e', 't', 0 };
+	const uint16_t opCode = htons(0x0052);
+	const uint16_t protVer = htons(0x000e);
+
+	memcpy(&artSync[8], &opCode, sizeof(opCode));
+	memcpy(&artSync[10], &protVer, sizeof(protVer));
+
+	return writeBytes(sizeof(artSync), artSync);
 }
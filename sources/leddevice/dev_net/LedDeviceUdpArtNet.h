@@ -77,12 +77,25 @@ private:
 	///
 	int write(const std::vector<ColorRgb>& ledValues) override;
 
+	///
+	/// @brief ArtSync after the OpDmx packets of all the universes
+	///
+	bool hasSyncTrigger() const override { return true; }
+	int writeSyncTrigger() override;
+
 	///
 	/// @brief Generate Art-Net communication header
 	///
-	void prepare(unsigned this_universe, unsigned this_sequence, unsigned this_dmxChannelCount);
+	void prepare(artnet_packet_t& artnet_packet, unsigned this_universe, unsigned this_sequence, unsigned this_dmxChannelCount);
+
+	///
+	/// @brief Build the packets of all the universes for the current LED count, a frame only patches the sequence and the colors
+	///
+	void preparePackets();
 
-	artnet_packet_t artnet_packet;
+	std::vector<artnet_packet_t> _artnet_packets;
+	std::vector<Datagram> _artnet_datagrams;
+	unsigned _artnet_channelCount = 0;
 	uint8_t _artnet_seq = 1;
 	int _artnet_channelsPerFixture = 3;
 	int _artnet_universe = 1;
@@ -0,0 +1,142 @@
+/* LedDeviceUdpDdp.cpp
+*
+*  MIT License
+*
+*  Copyright (c) 2023 awawa-dev
+*
+*  Project homesite: https://github.com/awawa-dev/HyperHDR
+*
+*  Permission is hereby granted, free of charge, to any person obtaining a copy
+*  of this software and associated documentation files (the "Software"), to deal
+*  in the Software without restriction, including without limitation the rights
+*  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+*  copies of the Software, and to permit persons to whom the Software is
+*  furnished to do so, subject to the following conditions:
+*
+*  The above copyright notice and this permission notice shall be included in all
+*  copies or substantial portions of the Software.
+
+*  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+*  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+*  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+*  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+*  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+*  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+*  SOFTWARE.
+*/
+
+
+#include <cstring>
+
+// hyperhdr local includes
+#include "LedDeviceUdpDdp.h"
+
+const ushort DDP_DEFAULT_PORT = 4048;
+
+/* DDP header, http://www.3waylabs.com/ddp/ */
+const unsigned DDP_HEADER_SIZE = 10;
+const uint8_t DDP_FLAGS_VER1 = 0x40;
+const uint8_t DDP_FLAGS_PUSH = 0x01;
+const uint8_t DDP_TYPE_RGB24 = 0x0B;	// RGB, 8 bits per channel
+const int DDP_MAX_CHANNELS_PER_PACKET = 1440;	// 480 RGB pixels, fits in a standard ethernet frame
+
+LedDeviceUdpDdp::LedDeviceUdpDdp(const QJsonObject& deviceConfig)
+	: ProviderUdp(deviceConfig)
+{
+}
+
+LedDevice* LedDeviceUdpDdp::construct(const QJsonObject& deviceConfig)
+{
+	return new LedDeviceUdpDdp(deviceConfig);
+}
+
+bool LedDeviceUdpDdp::init(const QJsonObject& deviceConfig)
+{
+	bool isInitOK = false;
+
+	_port = DDP_DEFAULT_PORT;
+
+	// Initialise sub-class
+	if (ProviderUdp::init(deviceConfig))
+	{
+		// a whole number of pixels in every packet
+		int ledsPerPacket = qBound(1, deviceConfig["ledsPerPacket"].toInt(DDP_MAX_CHANNELS_PER_PACKET / 3), DDP_MAX_CHANNELS_PER_PACKET / 3);
+
+		_ddp_channelsPerPacket = static_cast<unsigned>(ledsPerPacket * 3);
+		_ddp_destination = static_cast<uint8_t>(qBound(1, deviceConfig["destination"].toInt(1), 255));
+		_ddp_channelCount = 0;
+
+		Debug(_log, "DDP packets: %d leds per packet, destination: %d", ledsPerPacket, _ddp_destination);
+
+		isInitOK = true;
+	}
+	return isInitOK;
+}
+
+void LedDeviceUdpDdp::preparePackets()
+{
+	const unsigned channelCount = _ledRGBCount;
+	const unsigned packetCount = qMax((channelCount + _ddp_channelsPerPacket - 1) / _ddp_channelsPerPacket, 1u);
+	const unsigned packetSize = DDP_HEADER_SIZE + _ddp_channelsPerPacket;
+
+	_ddp_buffer.assign(static_cast<size_t>(packetCount) * packetSize, 0);
+	_ddp_datagrams.resize(packetCount);
+
+	for (unsigned i = 0; i < packetCount; i++)
+	{
+		uint8_t* packet = &_ddp_buffer[static_cast<size_t>(i) * packetSize];
+		const unsigned offset = i * _ddp_channelsPerPacket;
+		const unsigned length = qMin(channelCount - offset, _ddp_channelsPerPacket);
+
+		packet[0] = DDP_FLAGS_VER1 | ((i == packetCount - 1) ? DDP_FLAGS_PUSH : 0);
+		packet[1] = 0;	// sequence
+		packet[2] = DDP_TYPE_RGB24;
+		packet[3] = _ddp_destination;
+		packet[4] = static_cast<uint8_t>(offset >> 24);
+		packet[5] = static_cast<uint8_t>(offset >> 16);
+		packet[6] = static_cast<uint8_t>(offset >> 8);
+		packet[7] = static_cast<uint8_t>(offset);
+		packet[8] = static_cast<uint8_t>(length >> 8);
+		packet[9] = static_cast<uint8_t>(length);
+
+		_ddp_datagrams[i].data = packet;
+		_ddp_datagrams[i].size = DDP_HEADER_SIZE + length;
+	}
+
+	_ddp_channelCount = channelCount;
+}
+
+int LedDeviceUdpDdp::write(const std::vector<ColorRgb>& ledValues)
+{
+	if (ledValues.size() != _ledCount)
+		setLedCount(static_cast<int>(ledValues.size()));
+
+	if (_ddp_channelCount != _ledRGBCount || _ddp_datagrams.empty())
+		preparePackets();
+
+	// 1..15, the receiver can detect lost or reordered packets
+	_ddp_seq = (_ddp_seq % 15) + 1;
+
+	const uint8_t* rawdata = reinterpret_cast<const uint8_t*>(ledValues.data());
+	const unsigned packetSize = DDP_HEADER_SIZE + _ddp_channelsPerPacket;
+
+	for (unsigned i = 0; i < _ddp_datagrams.size(); i++)
+	{
+		uint8_t* packet = &_ddp_buffer[static_cast<size_t>(i) * packetSize];
+
+		packet[1] = _ddp_seq;
+		if (i == _ddp_datagrams.size() - 1)
+			packet[0] = DDP_FLAGS_VER1 | (_presentationSync ? 0 : DDP_FLAGS_PUSH);
+		memcpy(packet + DDP_HEADER_SIZE, rawdata + i * _ddp_channelsPerPacket, _ddp_datagrams[i].size - DDP_HEADER_SIZE);
+	}
+
+	return writeDatagrams(_ddp_datagrams);
+}
+
+int LedDeviceUdpDdp::writeSyncTrigger()
+{
+	// no data, only the push: the receiver shows the colors it already has
+	uint8_t header[DDP_HEADER_SIZE] = { DDP_FLAGS_VER1 | DDP_FLAGS_PUSH, _ddp_seq, DDP_TYPE_RGB24, _ddp_destination, 0, 0, 0, 0, 0, 0 };
+
+	return writeBytes(DDP_HEADER_SIZE, header);
+}
@@ -0,0 +1,70 @@
+#ifndef LEDEVICEUDPDDP_H
+#define LEDEVICEUDPDDP_H
+
+// hyperhdr includes
+#include "ProviderUdp.h"
+
+#include <vector>
+
+///
+/// Implementation of the LedDevice interface for sending LED colors via UDP/DDP (Distributed Display Protocol) packets,
+/// ex. for WLED or ESPixelStick. The colors are split in offset addressed chunks and the last packet of the frame
+/// carries the PUSH flag, so the receiver shows the whole frame at once.
+///
+class LedDeviceUdpDdp : public ProviderUdp
+{
+public:
+
+	///
+	/// @brief Constructs a DDP LED-device fed via UDP
+	///
+	/// @param deviceConfig Device's configuration as JSON-Object
+	///
+	explicit LedDeviceUdpDdp(const QJsonObject& deviceConfig);
+
+	///
+	/// @brief Constructs the LED-device
+	///
+	/// @param[in] deviceConfig Device's configuration as JSON-Object
+	/// @return LedDevice constructed
+	///
+	static LedDevice* construct(const QJsonObject& deviceConfig);
+
+private:
+
+	///
+	/// @brief Initialise the device's configuration
+	///
+	/// @param[in] deviceConfig the JSON device configuration
+	/// @return True, if success
+	///
+	bool init(const QJsonObject& deviceConfig) override;
+
+	///
+	/// @brief Writes the RGB-Color values to the LEDs.
+	///
+	/// @param[in] ledValues The RGB-color per LED
+	/// @return Zero on success, else negative
+	///
+	int write(const std::vector<ColorRgb>& ledValues) override;
+
+	///
+	/// @brief The data packets of the synchronized output keep the push flag clear, this empty packet sets it
+	///
+	bool hasSyncTrigger() const override { return true; }
+	int writeSyncTrigger() override;
+
+	///
+	/// @brief Build the headers of all the packets for the current LED count, a frame only patches the sequence and the colors
+	///
+	void preparePackets();
+
+	std::vector<uint8_t> _ddp_buffer;
+	std::vector<Datagram> _ddp_datagrams;
+	unsigned _ddp_channelCount = 0;
+	unsigned _ddp_channelsPerPacket = 1440;
+	uint8_t _ddp_destination = 1;
+	uint8_t _ddp_seq = 0;
+};
+
+#endif // LEDEVICEUDPDDP_H
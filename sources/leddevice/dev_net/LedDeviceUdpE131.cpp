@@ -5,6 +5,7 @@
 #endif
 
 #include <QHostInfo>
+#include <utils/InternalClock.h>
 
 // hyperhdr local includes
 #include "LedDeviceUdpE131.h"
@@ -13,10 +14,10 @@ const ushort E131_DEFAULT_PORT = 5568;
 
 /* defined parameters from http://tsp.esta.org/tsp/documents/docs/BSR_E1-31-20xx_CP-2014-1009r2.pdf */
 const uint32_t VECTOR_ROOT_E131_DATA = 0x00000004;
-//#define VECTOR_ROOT_E131_EXTENDED               0x00000008
+const uint32_t VECTOR_ROOT_E131_EXTENDED = 0x00000008;
 const uint8_t VECTOR_DMP_SET_PROPERTY = 0x02;
 const uint32_t VECTOR_E131_DATA_PACKET = 0x00000002;
-//#define VECTOR_E131_EXTENDED_SYNCHRONIZATION    0x00000001
+const uint32_t VECTOR_E131_EXTENDED_SYNCHRONIZATION = 0x00000001;
 //#define VECTOR_E131_EXTENDED_DISCOVERY          0x00000002
 //#define VECTOR_UNIVERSE_DISCOVERY_UNIVERSE_LIST 0x00000001
 //#define E131_E131_UNIVERSE_DISCOVERY_INTERVAL   10         // seconds
@@ -24,6 +25,10 @@ const uint32_t VECTOR_E131_DATA_PACKET = 0x00000002;
 //#define E131_DISCOVERY_UNIVERSE                 64214
 const int DMX_MAX = 512; // 512 usable slots
 
+/* a universe with static colors is sent 3 times, then only as the keep-alive (6.6.1 of ANSI E1.31-2018) */
+const int E131_UNCHANGED_REPEATS = 3;
+const int64_t E131_KEEPALIVE_INTERVAL = 800;	// milliseconds
+
 LedDeviceUdpE131::LedDeviceUdpE131(const QJsonObject& deviceConfig)
 	: ProviderUdp(deviceConfig)
 {
@@ -44,6 +49,9 @@ bool LedDeviceUdpE131::init(const QJsonObject& deviceConfig)
 	if (ProviderUdp::init(deviceConfig))
 	{
 		_e131_universe = deviceConfig["universe"].toInt(1);
+		_e131_suppressUnchanged = deviceConfig["suppressUnchanged"].toBool(false);
+		_e131_syncUniverse = static_cast<uint16_t>(qBound(0, deviceConfig["syncUniverse"].toInt(0), 63999));
+		_e131_channelCount = 0;
 		_e131_source_name = deviceConfig["source-name"].toString("hyperhdr on " + QHostInfo::localHostName());
 		QString _json_cid = deviceConfig["cid"].toString("");
 
@@ -71,7 +79,7 @@ bool LedDeviceUdpE131::init(const QJsonObject& deviceConfig)
 }
 
 // populates the headers
-void LedDeviceUdpE131::prepare(unsigned this_universe, unsigned this_dmxChannelCount)
+void LedDeviceUdpE131::prepare(e131_packet_t& e131_packet, unsigned this_universe, unsigned this_dmxChannelCount)
 {
 	memset(e131_packet.raw, 0, sizeof(e131_packet.raw));
 
@@ -105,43 +113,95 @@ void LedDeviceUdpE131::prepare(unsigned this_universe, unsigned this_dmxChannelC
 	e131_packet.property_values[0] = 0;	// start code
 }
 
+void LedDeviceUdpE131::preparePackets()
+{
+	const unsigned dmxChannelCount = _ledRGBCount;
+	const unsigned packetCount = (dmxChannelCount + DMX_MAX - 1) / DMX_MAX;
+
+	_e131_packets.resize(packetCount);
+	_e131_datagrams.resize(packetCount);
+	_e131_batch.reserve(packetCount);
+	_e131_repeats.assign(packetCount, 0);
+	_e131_lastSent.assign(packetCount, 0);
+
+	for (unsigned i = 0; i < packetCount; i++)
+	{
+		//                                 is this the last packet?                 ?       ^^ last packet      : ^^ earlier packets
+		const unsigned thisChannelCount = (dmxChannelCount - i * DMX_MAX < DMX_MAX) ? dmxChannelCount % DMX_MAX : DMX_MAX;
+
+		prepare(_e131_packets[i], _e131_universe + i, thisChannelCount);
+
+		_e131_datagrams[i].data = _e131_packets[i].raw;
+		_e131_datagrams[i].size = E131_DMP_DATA + 1 + thisChannelCount;
+	}
+
+	_e131_channelCount = dmxChannelCount;
+}
+
 int LedDeviceUdpE131::write(const std::vector<ColorRgb>& ledValues)
 {
-	int retVal = 0;
-	int thisChannelCount = 0;
-	int dmxChannelCount = _ledRGBCount;
+	const unsigned dmxChannelCount = _ledRGBCount;
 	const uint8_t* rawdata = reinterpret_cast<const uint8_t*>(ledValues.data());
+	const int64_t now = InternalClock::now();
+
+	if (_e131_channelCount != dmxChannelCount || _e131_packets.empty())
+		preparePackets();
 
 	_e131_seq++;
+	_e131_batch.clear();
 
-	for (int rawIdx = 0; rawIdx < dmxChannelCount; rawIdx++)
+	// the headers are ready: only the sequence and the colors of every universe change
+	for (unsigned i = 0; i < _e131_packets.size(); i++)
 	{
-		if (rawIdx % DMX_MAX == 0) // start of new packet
-		{
-			thisChannelCount = (dmxChannelCount - rawIdx < DMX_MAX) ? dmxChannelCount % DMX_MAX : DMX_MAX;
-			//			                       is this the last packet?         ?       ^^ last packet      : ^^ earlier packets
-
-			prepare(_e131_universe + rawIdx / DMX_MAX, thisChannelCount);
-			e131_packet.sequence_number = _e131_seq;
-		}
-
-		e131_packet.property_values[1 + rawIdx % DMX_MAX] = rawdata[rawIdx];
+		e131_packet_t& packet = _e131_packets[i];
+		const unsigned offset = i * DMX_MAX;
+		const unsigned length = qMin(dmxChannelCount - offset, static_cast<unsigned>(DMX_MAX));
 
-		//     is this the      last byte of last packet    ||   last byte of other packets
-		if ((rawIdx == dmxChannelCount - 1) || (rawIdx % DMX_MAX == DMX_MAX - 1))
+		// the packet still holds the previous colors of the universe
+		if (memcmp(&packet.property_values[1], rawdata + offset, length) != 0)
 		{
-#undef e131debug
-#if e131debug
-			Debug(_log, "send packet: rawidx %d dmxchannelcount %d universe: %d, packetsz %d"
-				, rawIdx
-				, dmxChannelCount
-				, _e131_universe + rawIdx / DMX_MAX
-				, E131_DMP_DATA + 1 + thisChannelCount
-			);
-#endif
-			retVal &= writeBytes(E131_DMP_DATA + 1 + thisChannelCount, e131_packet.raw);
+			memcpy(&packet.property_values[1], rawdata + offset, length);
+			_e131_repeats[i] = 1;
 		}
+		else if (_e131_suppressUnchanged && _e131_repeats[i] >= E131_UNCHANGED_REPEATS &&
+				 now - _e131_lastSent[i] < E131_KEEPALIVE_INTERVAL && now >= _e131_lastSent[i])
+			continue;
+		else
+			_e131_repeats[i] = qMin(_e131_repeats[i] + 1, E131_UNCHANGED_REPEATS);
+
+		packet.sequence_number = _e131_seq;
+		// the receiver holds the colors until the sync packet of the address
+		packet.reserved = htons(_presentationSync ? _e131_syncUniverse : 0);
+		_e131_lastSent[i] = now;
+		_e131_batch.push_back(_e131_datagrams[i]);
 	}
 
-	return retVal;
+	return writeDatagrams(_e131_batch);
+}
+
+int LedDeviceUdpE131::writeSyncTrigger()
+{
+	// E1.31 synchronization packet (6.3 of ANSI E1.31-2018): the root layer and the framing layer only
+	uint8_t sync[49] = { 0 };
+	uint16_t value16;
+	uint32_t value32;
+
+	value16 = htons(16);
+	memcpy(&sync[0], &value16, 2);
+	memcpy(&sync[4], _acn_id, 12);
+	value16 = htons(0x7000 | 33);
+	memcpy(&sync[16], &value16, 2);
+	value32 = htonl(VECTOR_ROOT_E131_EXTENDED);
+	memcpy(&sync[18], &value32, 4);
+	memcpy(&sync[22], _e131_cid.toRfc4122().constData(), 16);
+
+	value16 = htons(0x7000 | 11);
+	memcpy(&sync[38], &value16, 2);
+	value32 = htonl(VECTOR_E131_EXTENDED_SYNCHRONIZATION);
+	memcpy(&sync[40], &value32, 4);
+	sync[44] = ++_e131_syncSeq;
+	value16 = htons(_e131_syncUniverse);
+	memcpy(&sync[45], &value16, 2);
+
+	return writeBytes(sizeof(sync), sync);
 }
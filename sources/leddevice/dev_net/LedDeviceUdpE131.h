@@ -122,13 +122,34 @@ private:
 	///
 	int write(const std::vector<ColorRgb>& ledValues) override;
 
+	///
+	/// @brief The synchronization packet of the sync universe, the data packets of the synchronized output carry its address
+	///
+	bool hasSyncTrigger() const override { return _e131_syncUniverse > 0; }
+	int writeSyncTrigger() override;
+
 	///
 	/// @brief Generate E1.31 communication header
 	///
-	void prepare(unsigned this_universe, unsigned this_dmxChannelCount);
+	void prepare(e131_packet_t& e131_packet, unsigned this_universe, unsigned this_dmxChannelCount);
+
+	///
+	/// @brief Build the packets of all the universes for the current LED count, a frame only patches the sequence and the colors
+	///
+	void preparePackets();
+
+	std::vector<e131_packet_t> _e131_packets;
+	std::vector<Datagram> _e131_datagrams;
+	unsigned _e131_channelCount = 0;
 
-	e131_packet_t e131_packet;
+	/// the universes to send in the current frame, then per universe: how many times the same colors were sent and when the last packet went out
+	std::vector<Datagram> _e131_batch;
+	std::vector<int> _e131_repeats;
+	std::vector<int64_t> _e131_lastSent;
+	bool _e131_suppressUnchanged = false;
 	uint8_t _e131_seq = 0;
+	uint8_t _e131_syncSeq = 0;
+	uint16_t _e131_syncUniverse = 0;
 	uint8_t _e131_universe = 1;
 	uint8_t _acn_id[12] = { 0x41, 0x53, 0x43, 0x2d, 0x45, 0x31, 0x2e, 0x31, 0x37, 0x00, 0x00, 0x00 };
 	QString _e131_source_name;
@@ -49,6 +49,8 @@ bool LedDeviceUdpH801::init(const QJsonObject& deviceConfig)
 
 		Debug(_log, "H801 using %s:%d", _address.toString().toStdString().c_str(), _port);
 
+		setSequenceHeader(deviceConfig["sequenceHeader"].toBool(false));
+
 		isInitOK = true;
 	}
 	return isInitOK;
@@ -61,5 +63,5 @@ int LedDeviceUdpH801::write(const std::vector<ColorRgb>& ledValues)
 	_message[_prefix_size + 1] = color.green;
 	_message[_prefix_size + 2] = color.blue;
 
-	return writeBytes(_message.size(), reinterpret_cast<const uint8_t*>(_message.data()));
+	return writeSequenced(_message.size(), reinterpret_cast<const uint8_t*>(_message.data()));
 }
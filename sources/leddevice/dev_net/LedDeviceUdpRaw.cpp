@@ -18,6 +18,10 @@ bool LedDeviceUdpRaw::init(const QJsonObject& deviceConfig)
 
 	// Initialise sub-class
 	bool isInitOK = ProviderUdp::init(deviceConfig);
+
+	if (isInitOK)
+		setSequenceHeader(deviceConfig["sequenceHeader"].toBool(false));
+
 	return isInitOK;
 }
 
@@ -28,5 +32,5 @@ int LedDeviceUdpRaw::write(const std::vector<ColorRgb>& ledValues)
 	if (ledValues.size() != _ledCount)
 		setLedCount(static_cast<int>(ledValues.size()));
 
-	return writeBytes(_ledRGBCount, dataPtr);
+	return writeSequenced(_ledRGBCount, dataPtr);
 }
@@ -1,6 +1,8 @@
 #include "LedDeviceYeelight.h"
 #include <utils/QStringUtils.h>
+#include <utils/PerformanceCounters.h>
 #include <ssdp/SSDPDiscover.h>
+#include <leddevice/DiscoveryCache.h>
 
 // Qt includes
 #include <QEventLoop>
@@ -8,6 +10,7 @@
 #include <QtNetwork>
 #include <QTcpServer>
 #include <QColor>
+#include <QTimer>
 
 #include <chrono>
 #include <thread>
@@ -42,10 +45,12 @@ namespace {
 	const char CONFIG_RESTORE_STATE[] = "restoreOriginalState";
 
 	const char CONFIG_QUOTA_WAIT_TIME[] = "quotaWait";
+	const char CONFIG_STREAM_INTERVAL[] = "streamInterval";
 
 	// Yeelights API
 	const int API_DEFAULT_PORT = 55443;
 	const quint16 API_DEFAULT_QUOTA_WAIT_TIME = 1000;
+	const int API_DEFAULT_STREAM_INTERVAL = 20;
 
 	// Yeelight API Command
 	const char API_COMMAND_ID[] = "id";
@@ -105,6 +110,9 @@ YeelightLight::YeelightLight(Logger* log, const QString& hostname, quint16 port
 	, _brightnessFactor(1.0)
 	, _transitionEffectParam(API_PARAM_EFFECT_SMOOTH)
 	, _waitTimeQuota(API_DEFAULT_QUOTA_WAIT_TIME)
+	, _streamInterval(API_DEFAULT_STREAM_INTERVAL)
+	, _lastStreamTime(0)
+	, _replacedStreamCommands(0)
 	, _isOn(false)
 	, _isInMusicMode(false)
 {
@@ -130,6 +138,13 @@ void YeelightLight::setStreamSocket(QTcpSocket* socket)
 {
 	log(3, "setStreamSocket()", "");
 	_tcpStreamSocket = socket;
+	_pendingStreamCommand.clear();
+
+	// the commands are small and written one by one
+	if (_tcpStreamSocket != nullptr)
+	{
+		_tcpStreamSocket->setSocketOption(QAbstractSocket::LowDelayOption, 1);
+	}
 }
 
 bool YeelightLight::open()
@@ -324,6 +339,9 @@ bool YeelightLight::streamCommand(const QJsonDocument& command)
 
 	if (!_isInError && _tcpStreamSocket->isOpen())
 	{
+		// a held back color must not overwrite this command later
+		_pendingStreamCommand.clear();
+
 		qint64 bytesWritten = _tcpStreamSocket->write(command.toJson(QJsonDocument::Compact) + "\r\n");
 		if (bytesWritten == -1)
 		{
@@ -364,6 +382,90 @@ bool YeelightLight::streamCommand(const QJsonDocument& command)
 	return rc;
 }
 
+bool YeelightLight::streamCommand(const QByteArray& command)
+{
+	if (_debugLevel >= 2)
+	{
+		log(3, "streamCommand()", "%s", command.trimmed().constData());
+	}
+
+	if (_isInError || _tcpStreamSocket == nullptr || !_tcpStreamSocket->isOpen())
+	{
+		log(2, "Info:", "Skip write. Device is in error");
+		return false;
+	}
+
+	if (_tcpStreamSocket->state() != QAbstractSocket::ConnectedState)
+	{
+		log(1, "streamCommand()", "Stream socket is not connected -  Give it a retry");
+		_pendingStreamCommand.clear();
+		_isInMusicMode = false;
+		return true;
+	}
+
+	// the socket still sends the previous command or the light would be flooded: hold back the newest one
+	if (_tcpStreamSocket->bytesToWrite() > 0 || !_pendingStreamCommand.isEmpty() ||
+		InternalClock::now() - _lastStreamTime < _streamInterval)
+	{
+		if (!_pendingStreamCommand.isEmpty())
+		{
+			++_replacedStreamCommands;
+		}
+		_pendingStreamCommand = command;
+		return true;
+	}
+
+	return writeStreamCommand(command);
+}
+
+bool YeelightLight::flushStream()
+{
+	if (_pendingStreamCommand.isEmpty())
+	{
+		return false;
+	}
+
+	if (_isInError || _tcpStreamSocket == nullptr || _tcpStreamSocket->state() != QAbstractSocket::ConnectedState)
+	{
+		_pendingStreamCommand.clear();
+		return false;
+	}
+
+	if (_tcpStreamSocket->bytesToWrite() > 0 || InternalClock::now() - _lastStreamTime < _streamInterval)
+	{
+		return true;
+	}
+
+	QByteArray command;
+	command.swap(_pendingStreamCommand);
+	writeStreamCommand(command);
+
+	return false;
+}
+
+bool YeelightLight::writeStreamCommand(const QByteArray& command)
+{
+	qint64 bytesWritten = _tcpStreamSocket->write(command);
+	if (bytesWritten == -1)
+	{
+		this->setInError(QString("Streaming Error %1").arg(_tcpStreamSocket->errorString()));
+		return false;
+	}
+
+	_tcpStreamSocket->flush();
+	_lastStreamTime = InternalClock::now();
+	log(3, "Success:", "Bytes written   [%ll]", bytesWritten);
+
+	return true;
+}
+
+qint64 YeelightLight::takeReplacedStreamCommands()
+{
+	qint64 replaced = _replacedStreamCommands;
+	_replacedStreamCommands = 0;
+	return replaced;
+}
+
 YeelightResponse YeelightLight::handleResponse(int correlationID, QByteArray const& response)
 {
 	log(3, "handleResponse()", "");
@@ -499,6 +601,34 @@ QJsonDocument YeelightLight::getCommand(const QString& method, const QJsonArray&
 	return QJsonDocument(obj);
 }
 
+QByteArray YeelightLight::getSceneCommand(const char* colorClass, std::initializer_list<int> values, int duration)
+{
+	//Increment Correlation-ID
+	++_correlationID;
+
+	// the same as getCommand(API_METHOD_SETSCENE, ...) in compact JSON
+	QByteArray command;
+	command.reserve(96);
+	command.append("{\"").append(API_COMMAND_ID).append("\":").append(QByteArray::number(_correlationID));
+	command.append(",\"").append(API_COMMAND_METHOD).append("\":\"").append(API_METHOD_SETSCENE);
+	command.append("\",\"").append(API_COMMAND_PARAMS).append("\":[\"").append(colorClass).append('"');
+
+	for (int value : values)
+	{
+		command.append(',').append(QByteArray::number(value));
+	}
+
+	// Only add transition effect and duration, if device smoothing is configured (older FW do not support this parameters in set_scene
+	if (_transitionEffect == YeelightLight::API_EFFECT_SMOOTH)
+	{
+		command.append(",\"").append(_transitionEffectParam.toLatin1()).append("\",").append(QByteArray::number(duration));
+	}
+
+	command.append("]}\r\n");
+
+	return command;
+}
+
 QJsonObject YeelightLight::getProperties()
 {
 	log(3, "getProperties()", "");
@@ -759,21 +889,22 @@ bool YeelightLight::setColorRGB(const ColorRgb& color)
 		}
 
 		log(3, "Set Color RGB:", "{%u,%u,%u} -> [%d], [%d], [%d], [%d]", color.red, color.green, color.blue, colorParam, bri, _transitionEffect, _transitionDuration);
-		QJsonArray paramlist = { API_PARAM_CLASS_COLOR, colorParam, bri };
-
-		// Only add transition effect and duration, if device smoothing is configured (older FW do not support this parameters in set_scene
-		if (_transitionEffect == YeelightLight::API_EFFECT_SMOOTH)
-		{
-			paramlist << _transitionEffectParam << duration;
-		}
 
 		bool writeOK = false;
 		if (_isInMusicMode)
 		{
-			writeOK = streamCommand(getCommand(API_METHOD_SETSCENE, paramlist));
+			writeOK = streamCommand(getSceneCommand(API_PARAM_CLASS_COLOR, { colorParam, bri }, duration));
 		}
 		else
 		{
+			QJsonArray paramlist = { API_PARAM_CLASS_COLOR, colorParam, bri };
+
+			// Only add transition effect and duration, if device smoothing is configured (older FW do not support this parameters in set_scene
+			if (_transitionEffect == YeelightLight::API_EFFECT_SMOOTH)
+			{
+				paramlist << _transitionEffectParam << duration;
+			}
+
 			if (writeCommand(getCommand(API_METHOD_SETSCENE, paramlist)) >= 0)
 			{
 				writeOK = true;
@@ -845,21 +976,22 @@ bool YeelightLight::setColorHSV(const ColorRgb& colorRGB)
 			bri = (qMin(_brightnessMax, static_cast<int> (_brightnessFactor * qMax(_brightnessMin, bri))));
 		}
 		log(2, "Set Color HSV:", "{%u,%u,%u}, [%d], [%d]", hue, sat, bri, _transitionEffect, duration);
-		QJsonArray paramlist = { API_PARAM_CLASS_HSV, hue, sat, bri };
-
-		// Only add transition effect and duration, if device smoothing is configured (older FW do not support this parameters in set_scene
-		if (_transitionEffect == YeelightLight::API_EFFECT_SMOOTH)
-		{
-			paramlist << _transitionEffectParam << duration;
-		}
 
 		bool writeOK = false;
 		if (_isInMusicMode)
 		{
-			writeOK = streamCommand(getCommand(API_METHOD_SETSCENE, paramlist));
+			writeOK = streamCommand(getSceneCommand(API_PARAM_CLASS_HSV, { hue, sat, bri }, duration));
 		}
 		else
 		{
+			QJsonArray paramlist = { API_PARAM_CLASS_HSV, hue, sat, bri };
+
+			// Only add transition effect and duration, if device smoothing is configured (older FW do not support this parameters in set_scene
+			if (_transitionEffect == YeelightLight::API_EFFECT_SMOOTH)
+			{
+				paramlist << _transitionEffectParam << duration;
+			}
+
 			if (writeCommand(getCommand(API_METHOD_SETSCENE, paramlist)) >= 0)
 			{
 				writeOK = true;
@@ -973,7 +1105,10 @@ LedDeviceYeelight::LedDeviceYeelight(const QJsonObject& deviceConfig)
 	, _brightnessMax(100)
 	, _brightnessFactor(1.0)
 	, _waitTimeQuota(API_DEFAULT_QUOTA_WAIT_TIME)
+	, _streamInterval(API_DEFAULT_STREAM_INTERVAL)
 	, _debuglevel(0)
+	, _flushScheduled(false)
+	, _statsToken(0)
 	, _musicModeServerPort(-1)
 {
 }
@@ -1065,6 +1200,9 @@ bool LedDeviceYeelight::init(const QJsonObject& deviceConfig)
 		_waitTimeQuota = _devConfig[CONFIG_QUOTA_WAIT_TIME].toInt(0);
 		Debug(_log, "Wait time (quota) : %d", _waitTimeQuota);
 
+		_streamInterval = _devConfig[CONFIG_STREAM_INTERVAL].toInt(API_DEFAULT_STREAM_INTERVAL);
+		Debug(_log, "Stream interval   : %d", _streamInterval);
+
 		Debug(_log, "Debuglevel        : %d", _debuglevel);
 
 		QJsonArray configuredYeelightLights = _devConfig[CONFIG_LIGHTS].toArray();
@@ -1225,6 +1363,7 @@ int LedDeviceYeelight::open()
 				light.setTransitionEffect(_transitionEffect, _transitionDuration);
 				light.setBrightnessConfig(_brightnessMin, _brightnessMax, _isBrightnessSwitchOffMinimum, _extraTimeDarkness, _brightnessFactor);
 				light.setQuotaWaitTime(_waitTimeQuota);
+				light.setStreamInterval(_streamInterval);
 				light.setDebuglevel(_debuglevel);
 
 				if (!light.open())
@@ -1370,19 +1509,22 @@ QJsonObject LedDeviceYeelight::discover(const QJsonObject& /*params*/)
 	QJsonObject devicesDiscovered;
 	devicesDiscovered.insert("ledDeviceType", _activeDeviceType);
 
-	QJsonArray deviceList;
-
-	// Discover Yeelight Devices
-	SSDPDiscover discover;
-	discover.setPort(SSDP_PORT);
-	discover.skipDuplicateKeys(true);
-	discover.setSearchFilter(SSDP_FILTER, SSDP_FILTER_HEADER);
-	QString searchTarget = SSDP_ID;
-
-	if (discover.discoverServices(searchTarget) > 0)
-	{
-		deviceList = discover.getServicesDiscoveredJson();
-	}
+	// Discover Yeelight Devices, from the last background scan
+	QJsonArray deviceList = DiscoveryCache::get("ssdp:yeelight", []()
+		{
+			QJsonArray devices;
+			SSDPDiscover discover;
+			discover.setPort(SSDP_PORT);
+			discover.skipDuplicateKeys(true);
+			discover.setSearchFilter(SSDP_FILTER, SSDP_FILTER_HEADER);
+			QString searchTarget = SSDP_ID;
+
+			if (discover.discoverServices(searchTarget) > 0)
+			{
+				devices = discover.getServicesDiscoveredJson();
+			}
+			return devices;
+		});
 
 	devicesDiscovered.insert("devices", deviceList);
 	Debug(_log, "devicesDiscovered: [%s]", QString(QJsonDocument(devicesDiscovered).toJson(QJsonDocument::Compact)).toUtf8().constData());
@@ -1436,6 +1578,31 @@ void LedDeviceYeelight::identify(const QJsonObject& params)
 	}
 }
 
+void LedDeviceYeelight::flushStreams()
+{
+	bool pending = false;
+	for (YeelightLight& light : _lights)
+	{
+		if (light.flushStream())
+		{
+			pending = true;
+		}
+	}
+
+	// the held back colors go out as soon as the lights can take them, not with the next frame
+	if (pending && !_flushScheduled)
+	{
+		_flushScheduled = true;
+		QTimer::singleShot(qMax(_streamInterval / 2, 1), this, [this]() {
+			_flushScheduled = false;
+			if (_isDeviceReady)
+			{
+				flushStreams();
+			}
+		});
+	}
+}
+
 int LedDeviceYeelight::write(const std::vector<ColorRgb>& ledValues)
 {
 	//DebugIf(verbose, _log, "enabled [%d], _isDeviceReady [%d]", _isEnabled, _isDeviceReady);
@@ -1466,12 +1633,12 @@ int LedDeviceYeelight::write(const std::vector<ColorRgb>& ledValues)
 						QString errorReason = QString("(%1) %2").arg(_tcpMusicModeServer->serverError()).arg(_tcpMusicModeServer->errorString());
 						if (_tcpMusicModeServer->serverError() == QAbstractSocket::TemporaryError)
 						{
-							Info(_log, "Ignore write Error [%s]: _tcpMusicModeServer: %s", QSTRING_CSTR(light.getName()), QSTRING_CSTR(errorReason));
+							InfoThrottled(_log, "Ignore write Error [%s]: _tcpMusicModeServer: %s", QSTRING_CSTR(light.getName()), QSTRING_CSTR(errorReason));
 							skipWrite = true;
 						}
 						else
 						{
-							Warning(_log, "write Error [%s]: _tcpMusicModeServer: %s", QSTRING_CSTR(light.getName()), QSTRING_CSTR(errorReason));
+							WarningThrottled(_log, "write Error [%s]: _tcpMusicModeServer: %s", QSTRING_CSTR(light.getName()), QSTRING_CSTR(errorReason));
 							light.setInError("Failed to get stream socket");
 						}
 					}
@@ -1511,6 +1678,26 @@ int LedDeviceYeelight::write(const std::vector<ColorRgb>& ledValues)
 	{
 		// Minimum one Yeelight device is working, continue updating devices
 		rc = 0;
+
+		flushStreams();
+	}
+
+	// once per performance counters period
+	int64_t token = PerformanceCounters::currentToken();
+	if (token != _statsToken)
+	{
+		qint64 replaced = 0;
+		for (YeelightLight& light : _lights)
+		{
+			replaced += light.takeReplacedStreamCommands();
+		}
+
+		if (_statsToken > 0 && replaced > 0)
+		{
+			Debug(_log, "Stream commands replaced by a newer color while a light was busy: %lld", static_cast<long long>(replaced));
+		}
+
+		_statsToken = token;
 	}
 
 	//DebugIf(verbose, _log, "rc [%d]", rc );
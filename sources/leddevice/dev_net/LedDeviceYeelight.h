@@ -11,6 +11,7 @@
 #include <QColor>
 
 #include <chrono>
+#include <initializer_list>
 
 // Constants
 namespace {
@@ -174,6 +175,32 @@ public:
 	///
 	bool streamCommand(const QJsonDocument& command);
 
+	///
+	/// @brief Stream a preformatted Yeelight-API command line
+	///
+	/// The write does not wait for the socket. While the previous command is still in the socket
+	/// or the stream interval has not elapsed, the command is held back and replaces the one that
+	/// was held back before (the newest color wins).
+	///
+	/// @param[in] command The API command request, terminated by CRLF
+	/// @return True, on success
+	///
+	bool streamCommand(const QByteArray& command);
+
+	///
+	/// @brief Write the held back stream command, if the socket and the stream interval allow it
+	///
+	/// @return True, if a command is still held back
+	///
+	bool flushStream();
+
+	///
+	/// @brief Get the number of stream commands replaced by a newer one since the last call
+	///
+	/// @return Number of replaced commands
+	///
+	qint64 takeReplacedStreamCommands();
+
 	///
 	/// @brief Set the Yeelight light streaming socket
 	///
@@ -259,6 +286,13 @@ public:
 	///
 	void setQuotaWaitTime(int waitTime) { _waitTimeQuota = waitTime; }
 
+	///
+	/// @brief Set the minimum time between two streamed commands
+	///
+	/// @param[in] interval in milliseconds, 0 = only limited by the socket
+	///
+	void setStreamInterval(int interval) { _streamInterval = interval; }
+
 	///
 	/// @brief Get the Yeelight light properties
 	///
@@ -335,6 +369,25 @@ private:
 	///
 	QJsonDocument getCommand(const QString& method, const QJsonArray& params);
 
+	///
+	/// @brief Build a set_scene command line without the JSON document, as used for streaming
+	///
+	/// @param[in] colorClass The color class (color, hsv)
+	/// @param[in] values The values of the color class
+	/// @param[in] duration Duration of the transition, if smooth
+	///
+	/// @return The command, terminated by CRLF
+	///
+	QByteArray getSceneCommand(const char* colorClass, std::initializer_list<int> values, int duration);
+
+	///
+	/// @brief Write a stream command to the socket
+	///
+	/// @param[in] command The command, terminated by CRLF
+	/// @return True, on success
+	///
+	bool writeStreamCommand(const QByteArray& command);
+
 	///
 	/// @brief Map Yeelight light properties into the Yeelight light members for direct access
 	///
@@ -392,6 +445,13 @@ private:
 	/// Wait time to avoid quota exceed scenario
 	int _waitTimeQuota;
 
+	/// Minimum time between two streamed commands [ms]
+	int _streamInterval;
+	qint64 _lastStreamTime;
+	/// The newest command held back while the socket is busy
+	QByteArray _pendingStreamCommand;
+	qint64 _replacedStreamCommands;
+
 	/// Yeelight light properties
 	QJsonObject _originalStateProperties;
 	QString _name;
@@ -591,6 +651,11 @@ private:
 	///
 	uint getLightsCount() const { return _lightsCount; }
 
+	///
+	/// @brief Write the held back stream commands of all lights and schedule a retry for the rest
+	///
+	void flushStreams();
+
 	/// Array of the Yeelight addresses handled by the LED-device
 	QVector<yeelightAddress> _lightsAddressList;
 
@@ -610,9 +675,14 @@ private:
 	double _brightnessFactor;
 
 	int _waitTimeQuota;
+	int _streamInterval;
 
 	int _debuglevel;
 
+	/// A retry of the held back stream commands is scheduled
+	bool _flushScheduled;
+	int64_t _statsToken;
+
 	///Music mode Server details
 	QHostAddress _musicModeServerAddress;
 	int _musicModeServerPort;
@@ -35,11 +35,16 @@
 #include <QTimer>
 #include <QCoreApplication>
 #include <QElapsedTimer>
+#include <QJsonObject>
+
+#include <utils/PerformanceCounters.h>
 
 //std includes
 #include <iostream>
 
 const int TIMEOUT = (500);
+// the queued requests are not waited for, only a stuck connection is dropped
+const int ASYNC_TIMEOUT = (2000);
 
 std::unique_ptr<networkHelper> ProviderRestApi::_networkWorker(nullptr);
 
@@ -200,20 +205,10 @@ httpResponse ProviderRestApi::executeOperation(QNetworkAccessManager::Operation
 
 
 	// Perform request
-	QNetworkRequest request(url);
+	QNetworkRequest request = createRequest(url);
 	QNetworkReply* networkReply = nullptr;
 
 	request.setOriginatingObject(this);
-	QMapIterator<QString, QString> i(_headers);
-	while (i.hasNext())
-	{
-		i.next();
-		request.setRawHeader(i.key().toUtf8(), i.value().toUtf8());
-	}
-
-	QSslConfiguration conf = request.sslConfiguration();
-	conf.setPeerVerifyMode(QSslSocket::VerifyNone);
-	request.setSslConfiguration(conf);
 
 	SAFE_CALL_3_RET(_networkWorker.get(), executeOperation,
 		QNetworkReply*, networkReply, QNetworkAccessManager::Operation, op, QNetworkRequest, request, QByteArray, body.toUtf8());
@@ -232,6 +227,35 @@ httpResponse ProviderRestApi::executeOperation(QNetworkAccessManager::Operation
 }
 
 
+QNetworkRequest ProviderRestApi::createRequest(const QUrl& url) const
+{
+	QNetworkRequest request(url);
+
+	QMapIterator<QString, QString> i(_headers);
+	while (i.hasNext())
+	{
+		i.next();
+		request.setRawHeader(i.key().toUtf8(), i.value().toUtf8());
+	}
+
+	QSslConfiguration conf = request.sslConfiguration();
+	conf.setPeerVerifyMode(QSslSocket::VerifyNone);
+	request.setSslConfiguration(conf);
+
+	return request;
+}
+
+void ProviderRestApi::putAsync(const QString& body)
+{
+	QNetworkRequest request = createRequest(getUrl());
+
+#if (QT_VERSION >= QT_VERSION_CHECK(5, 15, 0))
+	request.setTransferTimeout(ASYNC_TIMEOUT);
+#endif
+
+	QUEUE_CALL_3(_networkWorker.get(), queueOperation, QNetworkAccessManager::Operation, QNetworkAccessManager::PutOperation, QNetworkRequest, request, QByteArray, body.toUtf8());
+}
+
 void ProviderRestApi::aquireResultLock()
 {	
 	_resultLocker.tryLock();
@@ -336,6 +360,10 @@ httpResponse ProviderRestApi::getResponse(QNetworkReply* const& reply, bool time
 }
 
 networkHelper::networkHelper()
+	: _log(Logger::getInstance("LEDDEVICE"))
+	, _sent(0)
+	, _superseded(0)
+	, _statsToken(0)
 {
 	QThread* parent = new QThread();
 	parent->setObjectName("RestApiThread");
@@ -433,3 +461,94 @@ void httpResponse::setHeaders(const QMap<QString, QString> &h)
 {
 	_headers = h;
 }
+
+void networkHelper::queueOperation(QNetworkAccessManager::Operation op, QNetworkRequest request, QByteArray body)
+{
+	const QString key = request.url().toString();
+	RequestQueue& queue = _queues[key];
+
+	// the state that is still waiting is out of date
+	if (!queue.waiting.empty() && queue.waiting.back().op == op && supersedes(body, queue.waiting.back().body))
+	{
+		queue.waiting.back().request = request;
+		queue.waiting.back().body = body;
+		_superseded++;
+	}
+	else
+	{
+		queue.waiting.push_back(QueuedRequest{ op, request, body });
+	}
+
+	if (!queue.inFlight)
+		sendNext(key);
+
+	// once per performance counters period
+	int64_t token = PerformanceCounters::currentToken();
+	if (token != _statsToken)
+	{
+		if (_statsToken > 0 && _sent > 0)
+			Debug(_log, "Queued REST requests: %lld sent, %lld superseded by a newer state before sending", static_cast<long long>(_sent), static_cast<long long>(_superseded));
+
+		_sent = 0;
+		_superseded = 0;
+		_statsToken = token;
+	}
+}
+
+void networkHelper::sendNext(const QString& key)
+{
+	auto queue = _queues.find(key);
+	if (queue == _queues.end())
+		return;
+
+	if (queue->waiting.empty())
+	{
+		_queues.erase(queue);
+		return;
+	}
+
+	QueuedRequest next = queue->waiting.front();
+	queue->waiting.pop_front();
+	queue->inFlight = true;
+	_sent++;
+
+	QNetworkReply* reply = (next.op == QNetworkAccessManager::PostOperation) ? _networkManager->post(next.request, next.body) :
+							(next.op == QNetworkAccessManager::GetOperation) ? _networkManager->get(next.request) : _networkManager->put(next.request, next.body);
+
+	connect(reply, &QNetworkReply::finished, this, [this, reply, key]() {
+		if (reply->error() != QNetworkReply::NoError)
+			Warning(_log, "Queued request to [%s] failed: %s", QSTRING_CSTR(key), QSTRING_CSTR(reply->errorString()));
+
+		reply->deleteLater();
+
+		auto queue = _queues.find(key);
+		if (queue != _queues.end())
+		{
+			queue->inFlight = false;
+			sendNext(key);
+		}
+	});
+}
+
+bool networkHelper::supersedes(const QByteArray& newer, const QByteArray& older)
+{
+	if (newer == older)
+		return true;
+
+	QJsonParseError newerError, olderError;
+	QJsonDocument newerDoc = QJsonDocument::fromJson(newer, &newerError);
+	QJsonDocument olderDoc = QJsonDocument::fromJson(older, &olderError);
+
+	if (newerError.error != QJsonParseError::NoError || olderError.error != QJsonParseError::NoError ||
+		!newerDoc.isObject() || !olderDoc.isObject())
+		return false;
+
+	const QJsonObject newerObj = newerDoc.object();
+	for (const QString& property : olderDoc.object().keys())
+	{
+		if (!newerObj.contains(property))
+			return false;
+	}
+
+	return true;
+}
@@ -10,6 +10,7 @@
 #include <QThread>
 #include <QJsonDocument>
 #include <memory>
+#include <list>
 #include <QMutex>
 
 class httpResponse;
@@ -107,6 +108,17 @@ public:
 
 	httpResponse post(const QUrl& url, const QString& body);
 
+	///
+	/// @brief Queue a PUT request to the current URL without waiting for the reply, ex. a state update while streaming
+	///
+	/// The requests to the same URL are sent one after another over the kept-alive connection of the shared
+	/// network manager. A request that is still waiting is replaced by a newer one that sets at least the same
+	/// JSON properties (the newer state supersedes it); errors are only logged.
+	///
+	/// @param[in] body The body of the request in JSON
+	///
+	void putAsync(const QString& body);
+
 	///
 	/// @brief Handle responses for REST requests
 	///
@@ -130,6 +142,11 @@ private:
 
 	httpResponse executeOperation(QNetworkAccessManager::Operation op, const QUrl& url, const QString& body = "");
 
+	///
+	/// @brief Build the request with the configured headers
+	///
+	QNetworkRequest createRequest(const QUrl& url) const;
+
 	bool waitForResult(QNetworkReply* networkReply);
 
 	Logger* _log;
@@ -164,6 +181,35 @@ public:
 
 public slots:
 	QNetworkReply* executeOperation(QNetworkAccessManager::Operation op, QNetworkRequest request, QByteArray body);
+
+	/// see ProviderRestApi::putAsync
+	void queueOperation(QNetworkAccessManager::Operation op, QNetworkRequest request, QByteArray body);
+
+private:
+	struct QueuedRequest
+	{
+		QNetworkAccessManager::Operation op;
+		QNetworkRequest request;
+		QByteArray body;
+	};
+
+	/// per URL: the request on the way is the first one, the rest waits
+	struct RequestQueue
+	{
+		bool inFlight = false;
+		std::list<QueuedRequest> waiting;
+	};
+
+	void sendNext(const QString& key);
+
+	/// true if the newer body sets all the properties of the older one
+	static bool supersedes(const QByteArray& newer, const QByteArray& older);
+
+	Logger* _log;
+	QMap<QString, RequestQueue> _queues;
+	qint64 _sent;
+	qint64 _superseded;
+	int64_t _statsToken;
 };
 
 
@@ -32,6 +32,11 @@
 #include <exception>
 // Linux includes
 #include <fcntl.h>
+#if defined(__linux__)
+	#include <sys/socket.h>
+	#include <netinet/in.h>
+	#include <errno.h>
+#endif
 
 #include <QStringList>
 #include <QUdpSocket>
@@ -39,14 +44,109 @@
 
 // Local HyperHDR includes
 #include "ProviderUdp.h"
+#include <utils/PerformanceCounters.h>
+#include <utils/PreciseTimer.h>
+#include <leddevice/DiscoveryCache.h>
 
 const ushort MAX_PORT = 65535;
 
+namespace
+{
+	const uint8_t SEQUENCE_VERSION = 1;
+	const unsigned SEQUENCE_HEADER_SIZE = 12;
+	const unsigned ACK_SIZE = 16;
+
+	/// a round trip time above it is an acknowledgement of a packet from a previous stream [us]
+	const uint32_t MAX_RTT_US = 10000000;
+
+	void putUint32(uint8_t* target, uint32_t value)
+	{
+		target[0] = static_cast<uint8_t>(value >> 24);
+		target[1] = static_cast<uint8_t>(value >> 16);
+		target[2] = static_cast<uint8_t>(value >> 8);
+		target[3] = static_cast<uint8_t>(value);
+	}
+
+	uint32_t getUint32(const uint8_t* source)
+	{
+		return (static_cast<uint32_t>(source[0]) << 24) | (static_cast<uint32_t>(source[1]) << 16) |
+			(static_cast<uint32_t>(source[2]) << 8) | static_cast<uint32_t>(source[3]);
+	}
+
+	uint32_t nowUs()
+	{
+		return static_cast<uint32_t>(PreciseTimer::now() / 1000);
+	}
+}
+
+#if defined(__linux__)
+namespace
+{
+	/// packets per sendmmsg call, the arrays live on the stack
+	const unsigned MAX_BATCH = 64;
+
+	/// the destination in the family of the socket: Qt binds QHostAddress::Any as a dual stack IPv6 socket
+	socklen_t makeSocketAddress(int socket, const QHostAddress& address, quint16 port, sockaddr_storage& target)
+	{
+		sockaddr_storage local;
+		socklen_t localLength = sizeof(local);
+
+		memset(&target, 0, sizeof(target));
+
+		if (getsockname(socket, reinterpret_cast<sockaddr*>(&local), &localLength) != 0)
+			return 0;
+
+		bool isIPv4 = false;
+		const quint32 ipv4 = address.toIPv4Address(&isIPv4);
+
+		if (local.ss_family == AF_INET && isIPv4)
+		{
+			sockaddr_in* in = reinterpret_cast<sockaddr_in*>(&target);
+			in->sin_family = AF_INET;
+			in->sin_port = htons(port);
+			in->sin_addr.s_addr = htonl(ipv4);
+			return sizeof(sockaddr_in);
+		}
+		else if (local.ss_family == AF_INET6)
+		{
+			sockaddr_in6* in6 = reinterpret_cast<sockaddr_in6*>(&target);
+			in6->sin6_family = AF_INET6;
+			in6->sin6_port = htons(port);
+
+			if (isIPv4)
+			{
+				// IPv4-mapped IPv6 address
+				in6->sin6_addr.s6_addr[10] = 0xff;
+				in6->sin6_addr.s6_addr[11] = 0xff;
+				in6->sin6_addr.s6_addr[12] = static_cast<uint8_t>(ipv4 >> 24);
+				in6->sin6_addr.s6_addr[13] = static_cast<uint8_t>(ipv4 >> 16);
+				in6->sin6_addr.s6_addr[14] = static_cast<uint8_t>(ipv4 >> 8);
+				in6->sin6_addr.s6_addr[15] = static_cast<uint8_t>(ipv4);
+			}
+			else
+			{
+				const Q_IPV6ADDR ipv6 = address.toIPv6Address();
+				memcpy(in6->sin6_addr.s6_addr, &ipv6, sizeof(in6->sin6_addr.s6_addr));
+				in6->sin6_scope_id = address.scopeId().toUInt();
+			}
+			return sizeof(sockaddr_in6);
+		}
+
+		return 0;
+	}
+}
+#endif
+
 ProviderUdp::ProviderUdp(const QJsonObject& deviceConfig)
 	: LedDevice(deviceConfig)
 	, _udpSocket(nullptr)
 	, _port(1)
 	, _defaultHost("127.0.0.1")
+	, _batchSocket(-1)
+	, _batchValid(false)
+	, _sequenceHeader(false)
+	, _sequence(0)
+	, _statsToken(0)
 {
 }
 
@@ -68,6 +168,10 @@ bool ProviderUdp::init(const QJsonObject& deviceConfig)
 		{
 			Debug(_log, "Successfully parsed %s as an IP-address.", QSTRING_CSTR(_address.toString()));
 		}
+		else if (!(_address = DiscoveryCache::resolve(host)).isNull())
+		{
+			Debug(_log, "Found the IP-address (%s) of the hostname (%s) in the network discovery.", QSTRING_CSTR(_address.toString()), QSTRING_CSTR(host));
+		}
 		else
 		{
 			QHostInfo hostInfo = QHostInfo::fromName(host);
@@ -125,6 +229,10 @@ int ProviderUdp::open()
 				Warning(_log, "%s", QSTRING_CSTR(warntext));
 			}
 		}
+		// a new stream: the acknowledgements of the previous one don't count
+		_sequence = 0;
+		_lastAck.valid = false;
+
 		// Everything is OK, device is ready
 		_isDeviceReady = true;
 		retval = 0;
@@ -140,6 +248,7 @@ int ProviderUdp::close()
 {
 	int retval = 0;
 	_isDeviceReady = false;
+	_batchSocket = -1;
 
 	if (_udpSocket != nullptr)
 	{
@@ -155,13 +264,18 @@ int ProviderUdp::close()
 }
 
 int ProviderUdp::writeBytes(const unsigned size, const uint8_t* data)
+{
+	return writeTo(_address, size, data);
+}
+
+int ProviderUdp::writeTo(const QHostAddress& address, const unsigned size, const uint8_t* data)
 {
 	int rc = 0;
-	qint64 bytesWritten = _udpSocket->writeDatagram(reinterpret_cast<const char*>(data), size, _address, _port);
+	qint64 bytesWritten = _udpSocket->writeDatagram(reinterpret_cast<const char*>(data), size, address, _port);
 
 	if (bytesWritten == -1 || bytesWritten != size)
 	{
-		Warning(_log, "%s", QSTRING_CSTR(QString("(%1:%2) Write Error: (%3) %4").arg(_address.toString()).arg(_port).arg(_udpSocket->error()).arg(_udpSocket->errorString())));
+		WarningThrottled(_log, "%s", QSTRING_CSTR(QString("(%1:%2) Write Error: (%3) %4").arg(address.toString()).arg(_port).arg(_udpSocket->error()).arg(_udpSocket->errorString())));
 		rc = -1;
 	}
 	return  rc;
@@ -174,8 +288,182 @@ int ProviderUdp::writeBytes(const QByteArray& bytes)
 
 	if (bytesWritten == -1 || bytesWritten != bytes.size())
 	{
-		Warning(_log, "%s", QSTRING_CSTR(QString("(%1:%2) Write Error: (%3) %4").arg(_address.toString()).arg(_port).arg(_udpSocket->error()).arg(_udpSocket->errorString())));
+		WarningThrottled(_log, "%s", QSTRING_CSTR(QString("(%1:%2) Write Error: (%3) %4").arg(_address.toString()).arg(_port).arg(_udpSocket->error()).arg(_udpSocket->errorString())));
 		rc = -1;
 	}
 	return  rc;
 }
+
+int ProviderUdp::writeDatagrams(const std::vector<Datagram>& datagrams)
+{
+	size_t sent = 0;
+
+#if defined(__linux__)
+	const int socket = (_udpSocket != nullptr) ? static_cast<int>(_udpSocket->socketDescriptor()) : -1;
+
+	if (socket >= 0 && (socket != _batchSocket || _batchTargets.size() != _additionalTargets.size() + 1))
+	{
+		_batchValid = true;
+		_batchTargets.resize(_additionalTargets.size() + 1);
+
+		for (size_t i = 0; i < _batchTargets.size(); i++)
+		{
+			sockaddr_storage target;
+			const socklen_t targetLength = makeSocketAddress(socket, (i == 0) ? _address : _additionalTargets[i - 1], _port, target);
+
+			_batchTargets[i].assign(reinterpret_cast<uint8_t*>(&target), reinterpret_cast<uint8_t*>(&target) + targetLength);
+			// ex. an IPv6 target on an IPv4 socket: all the frame goes through Qt
+			_batchValid = _batchValid && targetLength > 0;
+		}
+
+		_batchSocket = socket;
+	}
+
+	while (socket >= 0 && _batchValid && sent < datagrams.size())
+	{
+		mmsghdr messages[MAX_BATCH];
+		iovec vectors[MAX_BATCH];
+		const unsigned count = static_cast<unsigned>(qMin(datagrams.size() - sent, static_cast<size_t>(MAX_BATCH)));
+
+		memset(messages, 0, sizeof(messages[0]) * count);
+
+		for (unsigned i = 0; i < count; i++)
+		{
+			const std::vector<uint8_t>& target = _batchTargets[datagrams[sent + i].target];
+
+			vectors[i].iov_base = const_cast<uint8_t*>(datagrams[sent + i].data);
+			vectors[i].iov_len = datagrams[sent + i].size;
+			messages[i].msg_hdr.msg_name = const_cast<uint8_t*>(target.data());
+			messages[i].msg_hdr.msg_namelen = static_cast<socklen_t>(target.size());
+			messages[i].msg_hdr.msg_iov = &vectors[i];
+			messages[i].msg_hdr.msg_iovlen = 1;
+		}
+
+		int result;
+		while ((result = sendmmsg(socket, messages, count, 0)) < 0 && errno == EINTR);
+
+		// ex. the send buffer is full: the rest goes through Qt that reports the error
+		if (result <= 0)
+			break;
+
+		sent += static_cast<size_t>(result);
+	}
+#endif
+
+	int rc = 0;
+
+	for (; sent < datagrams.size(); sent++)
+	{
+		const unsigned target = datagrams[sent].target;
+
+		if (writeTo((target == 0) ? _address : _additionalTargets[target - 1], datagrams[sent].size, datagrams[sent].data) < 0)
+			rc = -1;
+	}
+
+	return rc;
+}
+
+void ProviderUdp::setSequenceHeader(bool enabled)
+{
+	if (_sequenceHeader == enabled || _udpSocket == nullptr)
+		return;
+
+	_sequenceHeader = enabled;
+
+	if (_sequenceHeader)
+	{
+		Debug(_log, "Packets are sent with the sequence header");
+		connect(_udpSocket, &QUdpSocket::readyRead, this, [this]() { readAcknowledgements(); });
+	}
+	else
+		disconnect(_udpSocket, &QUdpSocket::readyRead, this, nullptr);
+}
+
+int ProviderUdp::writeSequenced(const unsigned size, const uint8_t* data)
+{
+	if (!_sequenceHeader)
+		return writeBytes(size, data);
+
+	_sequencedPacket.resize(SEQUENCE_HEADER_SIZE + size);
+
+	uint8_t* packet = _sequencedPacket.data();
+	packet[0] = 'H';
+	packet[1] = 'S';
+	packet[2] = SEQUENCE_VERSION;
+	packet[3] = SEQUENCE_HEADER_SIZE;
+	putUint32(&packet[4], _sequence++);
+	putUint32(&packet[8], nowUs());
+	memcpy(&packet[SEQUENCE_HEADER_SIZE], data, size);
+
+	_delivery.packets++;
+	reportDeliveryStats();
+
+	return writeBytes(static_cast<unsigned>(_sequencedPacket.size()), packet);
+}
+
+void ProviderUdp::readAcknowledgements()
+{
+	uint8_t ack[ACK_SIZE + 1];
+
+	while (_udpSocket->hasPendingDatagrams())
+	{
+		const qint64 size = _udpSocket->readDatagram(reinterpret_cast<char*>(ack), sizeof(ack));
+
+		if (size != ACK_SIZE || ack[0] != 'H' || ack[1] != 'A' || ack[2] != SEQUENCE_VERSION)
+			continue;
+
+		const uint32_t sequence = getUint32(&ack[4]);
+		const uint32_t rtt = nowUs() - getUint32(&ack[8]);
+		const uint32_t received = getUint32(&ack[12]);
+
+		// ex. the receiver restarted or an acknowledgement of the previous stream: only a new base
+		const uint32_t sent = sequence - _lastAck.sequence;
+		const uint32_t arrived = received - _lastAck.received;
+
+		if (rtt <= MAX_RTT_US && sequence < _sequence && _lastAck.valid && sent <= _sequence && arrived <= _sequence)
+		{
+			// the reordered packets may arrive after the newest one of the acknowledgement
+			const int lost = (sent > arrived) ? static_cast<int>(sent - arrived) : 0;
+			const int delivered = static_cast<int>(qMin(sent, arrived));
+
+			_delivery.acks++;
+			_delivery.delivered += delivered;
+			_delivery.lost += lost;
+			_delivery.rttSum += rtt;
+			_delivery.rttMax = qMax(_delivery.rttMax, static_cast<qint64>(rtt));
+
+			reportDeliveryLoss(delivered, lost);
+		}
+
+		_lastAck.valid = (rtt <= MAX_RTT_US && sequence < _sequence);
+		_lastAck.sequence = sequence;
+		_lastAck.received = received;
+	}
+}
+
+void ProviderUdp::reportDeliveryStats()
+{
+	int64_t token = PerformanceCounters::currentToken();
+	if (token == _statsToken)
+		return;
+
+	if (_statsToken > 0)
+	{
+		if (_delivery.acks > 0)
+		{
+			const qint64 counted = _delivery.delivered + _delivery.lost;
+
+			Debug(_log, "Delivery: %lld packets sent, %lld of %lld lost (%.1f%%), round trip %.2f ms (max %.2f ms) from %lld acknowledgements",
+				static_cast<long long>(_delivery.packets), static_cast<long long>(_delivery.lost), static_cast<long long>(counted),
+				(counted > 0) ? _delivery.lost * 100.0 / counted : 0.0,
+				_delivery.rttSum / 1000.0 / _delivery.acks, _delivery.rttMax / 1000.0, static_cast<long long>(_delivery.acks));
+		}
+		else if (_delivery.packets > 0)
+		{
+			Debug(_log, "Delivery: %lld packets sent, no acknowledgements from the receiver", static_cast<long long>(_delivery.packets));
+		}
+	}
+
+	_delivery = {};
+	_statsToken = token;
+}
@@ -11,6 +11,8 @@
 #include <QHostAddress>
 #include <QUdpSocket>
 
+#include <vector>
+
 ///
 /// The ProviderUdp implements an abstract base-class for LedDevices using UDP packets.
 ///
@@ -18,6 +20,15 @@ class ProviderUdp : public LedDevice
 {
 public:
 
+	/// one packet of a batch, the memory is owned by the caller
+	struct Datagram
+	{
+		const uint8_t* data;
+		unsigned size;
+		/// 0 for the host of the device, else the index + 1 in _additionalTargets
+		unsigned target;
+	};
+
 	///
 	/// @brief Constructs an UDP LED-device
 	///
@@ -73,11 +84,79 @@ protected:
 	///
 	int writeBytes(const QByteArray& bytes);
 
+	///
+	/// @brief Writes all the packets of a frame (ex. one per universe) with as few system calls as possible:
+	/// sendmmsg on Linux, one datagram after another elsewhere
+	///
+	/// @param[in] datagrams The packets in the sending order, each one to its target
+	///
+	/// @return Zero on success, else negative
+	///
+	int writeDatagrams(const std::vector<Datagram>& datagrams);
+
+	///
+	/// @brief Optional telemetry of a raw stream for a compatible firmware. Every packet of writeSequenced starts with
+	/// a 12 byte header: "HS", version 1, header length, the sequence number and the send time [us, lower 32 bits].
+	/// The receiver may answer sparsely (ex. every 100 ms) to the source port with a 16 byte acknowledgement:
+	/// "HA", version 1, reserved, the sequence number and the echoed send time of the newest packet received,
+	/// then the count of all the packets received. All fields are big endian.
+	/// The loss between two acknowledgements and the round trip time are logged and feed the adaptive refresh.
+	///
+	/// @param[in] enabled Send the header, only for the devices with a raw payload
+	///
+	void setSequenceHeader(bool enabled);
+
+	///
+	/// @brief Writes the given bytes to the UDP-device, after the sequence header when it's enabled
+	///
+	/// @param[in] size The length of the data
+	/// @param[in] data The data
+	///
+	/// @return Zero on success, else negative
+	///
+	int writeSequenced(const unsigned size, const uint8_t* data);
+
 	///
 	QUdpSocket* _udpSocket;
 	QHostAddress _address;
 	quint16       _port;
 	QString      _defaultHost;
+	/// more hosts of the same device kind driven by one instance on the same port, only by writeDatagrams
+	std::vector<QHostAddress> _additionalTargets;
+
+private:
+	/// the destinations of writeDatagrams in the format of the socket, built again for a new socket
+	std::vector<std::vector<uint8_t>> _batchTargets;
+	qintptr		_batchSocket;
+	bool		_batchValid;
+
+	int writeTo(const QHostAddress& address, const unsigned size, const uint8_t* data);
+	void readAcknowledgements();
+	void reportDeliveryStats();
+
+	bool		_sequenceHeader;
+	uint32_t	_sequence;
+	std::vector<uint8_t> _sequencedPacket;
+
+	/// the previous acknowledgement, the loss is counted between two of them
+	struct
+	{
+		bool		valid = false;
+		uint32_t	sequence = 0;
+		uint32_t	received = 0;
+	} _lastAck;
+
+	/// the current statistics period, the round trip times in us
+	struct
+	{
+		qint64	packets = 0;
+		qint64	acks = 0;
+		qint64	delivered = 0;
+		qint64	lost = 0;
+		qint64	rttSum = 0;
+		qint64	rttMax = 0;
+	} _delivery;
+	int64_t		_statsToken;
 };
 
 #endif // PROVIDERUDP_H
@@ -38,13 +38,160 @@
 
 #include <QUdpSocket>
 #include <QThread>
+#include <QMutex>
+#include <QWaitCondition>
 
 // Local HyperHDR includes
 #include "ProviderUdpSSL.h"
+#include <utils/InternalClock.h>
+#include <utils/PerformanceCounters.h>
+#include <utils/PreciseTimer.h>
+#include <leddevice/DiscoveryCache.h>
 
 const int MAX_RETRY = 20;
 const ushort MAX_PORT_SSL = 65535;
 
+///
+/// Writes the DTLS stream: the device thread only hands over the newest frame. The handshake
+/// is done by the device thread before the sender starts and after it's stopped.
+///
+class DtlsSenderThread : public QThread
+{
+public:
+	struct Stats
+	{
+		qint64 frames = 0;
+		qint64 replaced = 0;
+		qint64 durationSum = 0;
+		qint64 durationMax = 0;
+	};
+
+	DtlsSenderThread(Logger* log, mbedtls_ssl_context* ssl, QObject* owner, std::shared_ptr<WriteCadence> writeCadence) :
+		_log(log),
+		_ssl(ssl),
+		_owner(owner),
+		_writeCadence(writeCadence),
+		_hasPending(false),
+		_busy(false),
+		_quit(false),
+		_failed(false)
+	{
+	}
+
+	~DtlsSenderThread()
+	{
+		flush();
+		{
+			QMutexLocker locker(&_mutex);
+			_quit = true;
+			_condition.wakeAll();
+		}
+		wait();
+	}
+
+	void queue(unsigned size, const uint8_t* data)
+	{
+		QMutexLocker locker(&_mutex);
+
+		// the stream is broken, the owner is already notified
+		if (_failed)
+			return;
+
+		if (_hasPending)
+			_stats.replaced++;
+
+		_pending.assign(data, data + size);
+		_hasPending = true;
+		_condition.wakeAll();
+	}
+
+	/// waits until the queued frame is sent, ex. the last frame before the stream is closed
+	void flush()
+	{
+		QMutexLocker locker(&_mutex);
+
+		while ((_hasPending || _busy) && isRunning())
+			_done.wait(&_mutex);
+	}
+
+	Stats takeStats()
+	{
+		QMutexLocker locker(&_mutex);
+
+		Stats stats = _stats;
+		_stats = Stats();
+		return stats;
+	}
+
+private:
+	void run() override
+	{
+		QMutexLocker locker(&_mutex);
+
+		while (!_quit)
+		{
+			if (!_hasPending)
+			{
+				_condition.wait(&_mutex);
+				continue;
+			}
+
+			std::swap(_active, _pending);
+			_hasPending = false;
+			_busy = true;
+
+			locker.unlock();
+			const qint64 begin = PreciseTimer::now();
+			int ret = 0;
+			do
+			{
+				ret = mbedtls_ssl_write(_ssl, _active.data(), _active.size());
+			} while (ret == MBEDTLS_ERR_SSL_WANT_READ || ret == MBEDTLS_ERR_SSL_WANT_WRITE);
+			const qint64 end = PreciseTimer::now();
+			if (_writeCadence != nullptr)
+				_writeCadence->writeFinished(end);
+			locker.relock();
+
+			_busy = false;
+			_stats.frames++;
+			_stats.durationSum += end - begin;
+			_stats.durationMax = qMax(_stats.durationMax, end - begin);
+
+			if (ret <= 0)
+			{
+				char error_buf[1024];
+				mbedtls_strerror(ret, error_buf, sizeof(error_buf));
+				ErrorThrottled(_log, "Error while writing UDP SSL stream updates. mbedtls_ssl_write returned: code = %i, description = %s", ret, error_buf);
+
+				// the device thread restores the connection, the frames are dropped until then
+				_failed = true;
+				_hasPending = false;
+				QMetaObject::invokeMethod(_owner, "handleStreamError", Qt::QueuedConnection);
+			}
+
+			_done.wakeAll();
+		}
+
+		_done.wakeAll();
+	}
+
+	Logger*			_log;
+	mbedtls_ssl_context*	_ssl;
+	QObject*		_owner;
+	std::shared_ptr<WriteCadence> _writeCadence;
+
+	QMutex			_mutex;
+	QWaitCondition	_condition;
+	QWaitCondition	_done;
+	std::vector<uint8_t>	_pending;
+	std::vector<uint8_t>	_active;
+	bool			_hasPending;
+	bool			_busy;
+	bool			_quit;
+	bool			_failed;
+	Stats			_stats;
+};
+
 ProviderUdpSSL::ProviderUdpSSL(const QJsonObject& deviceConfig)
 	: LedDevice(deviceConfig)
 	, client_fd()
@@ -69,7 +216,12 @@ ProviderUdpSSL::ProviderUdpSSL(const QJsonObject& deviceConfig)
 	, _streamPaused(false)
 	, _handshake_timeout_min(300)
 	, _handshake_timeout_max(1000)
+	, _session()
+	, _hasSession(false)
+	, _senderThread(nullptr)
+	, _senderStatsToken(0)
 {
+	mbedtls_ssl_session_init(&_session);
 
 	bool error = false;
 
@@ -91,6 +243,7 @@ ProviderUdpSSL::~ProviderUdpSSL()
 {
 	closeConnection();
 
+	mbedtls_ssl_session_free(&_session);
 	mbedtls_ctr_drbg_free(&ctr_drbg);
 	mbedtls_entropy_free(&entropy);
 }
@@ -115,12 +268,19 @@ bool ProviderUdpSSL::init(const QJsonObject& deviceConfig)
 		if (deviceConfig.contains("hs_timeout_min"))  _handshake_timeout_min = deviceConfig["hs_timeout_min"].toInt(300);
 		if (deviceConfig.contains("hs_timeout_max"))  _handshake_timeout_max = deviceConfig["hs_timeout_max"].toInt(1000);
 
+		// the saved session belongs to the previous host and key
+		forgetSession();
+
 		QString host = deviceConfig["host"].toString(_defaultHost);
 
 		if (_address.setAddress(host))
 		{
 			Debug(_log, "Successfully parsed %s as an ip address.", QSTRING_CSTR(host));
 		}
+		else if (!(_address = DiscoveryCache::resolve(host)).isNull())
+		{
+			Debug(_log, "Found the ip address (%s) of %s in the network discovery.", QSTRING_CSTR(_address.toString()), QSTRING_CSTR(host));
+		}
 		else
 		{
 			Debug(_log, "Failed to parse [%s] as an ip address.", QSTRING_CSTR(host));
@@ -197,16 +357,37 @@ bool ProviderUdpSSL::initConnection()
 		_streamReady = true;
 		_streamPaused = false;
 		_isDeviceReady = true;
+
+		// the sender thread reports the end of every write
+		setAsyncWrites(true);
+		_senderThread = new DtlsSenderThread(_log, &ssl, this, getWriteCadence());
+		_senderThread->start(QThread::HighPriority);
 		return true;
 	}
 	else
 		return false;
 }
 
+void ProviderUdpSSL::stopSender()
+{
+	// the queued frame (ex. the last one before pausing the stream) is sent before
+	delete _senderThread;
+	_senderThread = nullptr;
+	setAsyncWrites(false);
+}
+
+void ProviderUdpSSL::forgetSession()
+{
+	mbedtls_ssl_session_free(&_session);
+	mbedtls_ssl_session_init(&_session);
+	_hasSession = false;
+}
+
 void ProviderUdpSSL::closeConnection()
 {
 	if (_streamReady)
 	{
+		stopSender();
 		closeSSLNotify();
 		freeSSLConnection();
 		_streamReady = false;
@@ -255,6 +436,10 @@ bool ProviderUdpSSL::setupStructure()
 	mbedtls_ssl_conf_ciphersuites(&conf, ciphersuites);
 	mbedtls_ssl_conf_rng(&conf, mbedtls_ctr_drbg_random, &ctr_drbg);
 
+#if defined(MBEDTLS_SSL_SESSION_TICKETS)
+	mbedtls_ssl_conf_session_tickets(&conf, MBEDTLS_SSL_SESSION_TICKETS_ENABLED);
+#endif
+
 	if ((ret = mbedtls_ssl_setup(&ssl, &conf)) != 0)
 	{
 		Error(_log, "%s", QSTRING_CSTR(QString("mbedtls_ssl_setup FAILED %1").arg(errorMsg(ret))));
@@ -282,7 +467,25 @@ bool ProviderUdpSSL::startUPDConnection()
 	mbedtls_ssl_set_bio(&ssl, &client_fd, mbedtls_net_send, mbedtls_net_recv, mbedtls_net_recv_timeout);
 	mbedtls_ssl_set_timer_cb(&ssl, &timer, mbedtls_timing_set_delay, mbedtls_timing_get_delay);
 
-	return startSSLHandshake();
+	// offer the previous session (ticket or id): the bridge can resume it with an abbreviated handshake
+	if (_hasSession && mbedtls_ssl_set_session(&ssl, &_session) != 0)
+		forgetSession();
+
+	const bool resuming = _hasSession;
+	const qint64 begin = InternalClock::now();
+
+	if (!startSSLHandshake())
+	{
+		forgetSession();
+		return false;
+	}
+
+	forgetSession();
+	_hasSession = (mbedtls_ssl_get_session(&ssl, &_session) == 0);
+
+	Info(_log, "DTLS handshake finished in %lld ms (%s)", static_cast<long long>(InternalClock::now() - begin), (resuming) ? "session offered for resumption" : "full handshake");
+
+	return true;
 }
 
 bool ProviderUdpSSL::setupPSK()
@@ -372,64 +575,80 @@ void ProviderUdpSSL::freeSSLConnection()
 
 void ProviderUdpSSL::writeBytes(unsigned int size, const uint8_t* data, bool flush)
 {
-	if (!_streamReady || _streamPaused)
-		return;
-
-	if (!_streamReady || _streamPaused)
+	if (!_streamReady || _streamPaused || _senderThread == nullptr)
 		return;
 
 	_streamPaused = flush;
 
-	int ret = 0;
+	_senderThread->queue(size, data);
 
-	do
+	// once per performance counters period: the time spent in mbedtls_ssl_write
+	int64_t token = PerformanceCounters::currentToken();
+	if (token != _senderStatsToken)
 	{
-		ret = mbedtls_ssl_write(&ssl, data, size);
-	} while (ret == MBEDTLS_ERR_SSL_WANT_READ || ret == MBEDTLS_ERR_SSL_WANT_WRITE);
+		DtlsSenderThread::Stats stats = _senderThread->takeStats();
 
-	if (ret <= 0)
-	{
-		Error(_log, "Error while writing UDP SSL stream updates. mbedtls_ssl_write returned: %s", QSTRING_CSTR(errorMsg(ret)));
+		if (_senderStatsToken > 0 && stats.frames > 0)
+			Info(_log, "DTLS stream: %lld frames, %.2f ms average, %.2f ms max, %lld replaced by a newer frame before sending",
+				static_cast<long long>(stats.frames), stats.durationSum / 1000000.0 / stats.frames, stats.durationMax / 1000000.0, static_cast<long long>(stats.replaced));
 
-		if (_streamReady)
-		{
-			closeConnection();
+		_senderStatsToken = token;
+	}
+}
 
-			// look for the host
-			QUdpSocket socket;
+void ProviderUdpSSL::handleStreamError()
+{
+	if (!_streamReady || _signalTerminate)
+		return;
 
-			for (int i = 1; i <= _retry_left; i++)
-			{
-				if (_signalTerminate)
-					return;
+	// a short Wi-Fi glitch: the bridge keeps the entertainment stream, only the DTLS session is restored
+	const qint64 begin = InternalClock::now();
 
-				Warning(_log, "Searching the host: %s (trial %i/%i)", QSTRING_CSTR(this->_address.toString()), i, _retry_left);
+	stopSender();
+	freeSSLConnection();
+	_streamReady = false;
 
-				socket.connectToHost(_address, _ssl_port);
+	if (initConnection())
+	{
+		Warning(_log, "The DTLS stream was restored in %lld ms", static_cast<long long>(InternalClock::now() - begin));
+		return;
+	}
 
-				if (socket.waitForConnected(1000))
-				{
-					Warning(_log, "Found host: %s", QSTRING_CSTR(this->_address.toString()));
-					socket.close();
-					break;
-				}
-				else if (!_signalTerminate)
-					QThread::msleep(1000);
-			}
+	freeSSLConnection();
 
-			Warning(_log, "Hard restart of the LED device (host: %s).", QSTRING_CSTR(this->_address.toString()));
+	// look for the host
+	QUdpSocket socket;
 
-			// hard reset
-			Warning(_log, "Disabling...");
-			this->disableDevice(false);
+	for (int i = 1; i <= _retry_left; i++)
+	{
+		if (_signalTerminate)
+			return;
 
-			Warning(_log, "Enabling...");
-			this->enableDevice(false);
+		Warning(_log, "Searching the host: %s (trial %i/%i)", QSTRING_CSTR(this->_address.toString()), i, _retry_left);
 
-			if (!_isOn)
-				emit enableStateChanged(false);
+		socket.connectToHost(_address, _ssl_port);
+
+		if (socket.waitForConnected(1000))
+		{
+			Warning(_log, "Found host: %s", QSTRING_CSTR(this->_address.toString()));
+			socket.close();
+			break;
 		}
+		else if (!_signalTerminate)
+			QThread::msleep(1000);
 	}
+
+	Warning(_log, "Hard restart of the LED device (host: %s).", QSTRING_CSTR(this->_address.toString()));
+
+	// hard reset
+	Warning(_log, "Disabling...");
+	this->disableDevice(false);
+
+	Warning(_log, "Enabling...");
+	this->enableDevice(false);
+
+	if (!_isOn)
+		emit enableStateChanged(false);
 }
 
 QString ProviderUdpSSL::errorMsg(int ret)
@@ -32,6 +32,8 @@
 #include <mbedtls/error.h>
 #include <mbedtls/debug.h>
 
+class DtlsSenderThread;
+
 class ProviderUdpSSL : public LedDevice
 {
 	Q_OBJECT
@@ -87,6 +89,12 @@ protected:
 	///
 	virtual const int* getCiphersuites() const;
 
+private slots:
+	///
+	/// @brief The sender thread failed to write: the session is resumed, then the device is restarted if it fails
+	///
+	void handleStreamError();
+
 private:
 
 	bool initConnection();
@@ -99,6 +107,8 @@ private:
 	QString errorMsg(int ret);
 	void closeSSLNotify();
 	void freeSSLConnection();
+	void stopSender();
+	void forgetSession();
 
 	mbedtls_net_context          client_fd;
 	mbedtls_entropy_context      entropy;
@@ -123,6 +133,13 @@ private:
 	bool         _streamPaused;
 	uint32_t     _handshake_timeout_min;
 	uint32_t     _handshake_timeout_max;
+
+	/// the last negotiated session, offered for resumption by the next handshake
+	mbedtls_ssl_session _session;
+	bool         _hasSession;
+
+	DtlsSenderThread* _senderThread;
+	int64_t      _senderStatsToken;
 };
 
 #endif // PROVIDERUDPSSL_H
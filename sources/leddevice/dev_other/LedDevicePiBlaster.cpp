@@ -2,6 +2,11 @@
 // STL includes
 #include <cstring>
 #include <csignal>
+#include <cerrno>
+
+// Linux includes
+#include <fcntl.h>
+#include <unistd.h>
 
 // QT includes
 #include <QFile>
@@ -11,7 +16,7 @@
 
 LedDevicePiBlaster::LedDevicePiBlaster(const QJsonObject &deviceConfig)
 	: LedDevice(deviceConfig)
-	, _fid(nullptr)
+	, _fid(-1)
 {
 	// initialise the mapping tables
 	// -1 is invalid
@@ -23,15 +28,16 @@ LedDevicePiBlaster::LedDevicePiBlaster(const QJsonObject &deviceConfig)
 	{
 		_gpio_to_led[i] = -1;
 		_gpio_to_color[i] = 'z';
+		_gpio_duty[i] = -1;
 	}
 }
 
 LedDevicePiBlaster::~LedDevicePiBlaster()
 {
-	if (_fid != nullptr)
+	if (_fid >= 0)
 	{
-		fclose(_fid);
-		_fid = nullptr;
+		::close(_fid);
+		_fid = -1;
 	}
 }
 
@@ -82,9 +88,9 @@ int LedDevicePiBlaster::open()
 	QString errortext;
 	_isDeviceReady = false;
 
-	if (_fid != nullptr)
+	if (_fid >= 0)
 	{
-		// The file pointer is already open
+		// The file descriptor is already open
 		errortext = QString ("Device (%1) is already open.").arg(_deviceName);
 	}
 	else
@@ -95,8 +101,8 @@ int LedDevicePiBlaster::open()
 		}
 		else
 		{
-			_fid = fopen(QSTRING_CSTR(_deviceName), "w");
-			if (_fid == nullptr)
+			_fid = ::open(QSTRING_CSTR(_deviceName), O_WRONLY | O_CLOEXEC);
+			if (_fid < 0)
 			{
 				errortext = QString ("Failed to open device (%1). Error message: %2").arg(_deviceName, strerror(errno));
 			}
@@ -104,6 +110,10 @@ int LedDevicePiBlaster::open()
 			{
 				Info( _log, "Connected to device(%s)", QSTRING_CSTR(_deviceName));
 
+				// the pins are set again after opening, pi-blaster may have been restarted
+				for (unsigned i = 0; i < TABLE_SZ; i++)
+					_gpio_duty[i] = -1;
+
 				// Everything is OK, device is ready
 				_isDeviceReady = true;
 				retval = 0;
@@ -125,10 +135,10 @@ int LedDevicePiBlaster::close()
 	_isDeviceReady = false;
 
 	// Test, if device requires closing
-	if (_fid != nullptr)
+	if (_fid >= 0)
 	{
-		fclose(_fid);
-		_fid = nullptr;
+		::close(_fid);
+		_fid = -1;
 	}
 	return retval;
 }
@@ -136,49 +146,75 @@ int LedDevicePiBlaster::close()
 int LedDevicePiBlaster::write(const std::vector<ColorRgb> & ledValues)
 {
 	// Attempt to open if not yet opened
-	if (_fid == nullptr && open() < 0)
+	if (_fid < 0 && open() < 0)
 	{
 		return -1;
 	}
 
+	// the changed pins of the frame go in one write, pi-blaster reads its commands line by line
+	char* command = _frameBuffer;
+
 	for (unsigned int i=0; i < TABLE_SZ; i++ )
 	{
 		int valueIdx = _gpio_to_led[ i ];
-		if ( (valueIdx >= 0) && (valueIdx < static_cast<int>( _ledCount)) )
+		if ( (valueIdx >= 0) && (valueIdx < static_cast<int>( _ledCount)) && (valueIdx < static_cast<int>(ledValues.size())) )
 		{
-			double pwmDutyCycle = 0.0;
+			// the duty cycle in 1/1000, rounded
+			int pwmDutyCycle = 0;
 			switch (_gpio_to_color[ i ])
 			{
 				case 'r':
-					pwmDutyCycle = ledValues[valueIdx].red / 255.0;
+					pwmDutyCycle = (ledValues[valueIdx].red * 1000 + 127) / 255;
 					break;
 				case 'g':
-					pwmDutyCycle = ledValues[valueIdx].green / 255.0;
+					pwmDutyCycle = (ledValues[valueIdx].green * 1000 + 127) / 255;
 					break;
 				case 'b':
-					pwmDutyCycle = ledValues[valueIdx].blue / 255.0;
+					pwmDutyCycle = (ledValues[valueIdx].blue * 1000 + 127) / 255;
 					break;
 				case 'w':
-					pwmDutyCycle = ledValues[valueIdx].red;
-					pwmDutyCycle += ledValues[valueIdx].green;
-					pwmDutyCycle += ledValues[valueIdx].blue;
-					pwmDutyCycle /= (3.0*255.0);
+					pwmDutyCycle = ((ledValues[valueIdx].red + ledValues[valueIdx].green + ledValues[valueIdx].blue) * 1000 + 382) / (3 * 255);
 					break;
 				default:
 					continue;
 			}
 
-//			fprintf(_fid, "%i=%f\n", iPins[iPin], pwmDutyCycle);
+			if (pwmDutyCycle == _gpio_duty[i])
+				continue;
+
+			_gpio_duty[i] = pwmDutyCycle;
+
+			// "pin=0.500" without printf: the pin has 1 or 2 digits, the duty cycle is 0.000 to 1.000
+			if (i >= 10)
+				*(command++) = static_cast<char>('0' + i / 10);
+			*(command++) = static_cast<char>('0' + i % 10);
+			*(command++) = '=';
+			*(command++) = static_cast<char>('0' + pwmDutyCycle / 1000);
+			*(command++) = '.';
+			*(command++) = static_cast<char>('0' + (pwmDutyCycle / 100) % 10);
+			*(command++) = static_cast<char>('0' + (pwmDutyCycle / 10) % 10);
+			*(command++) = static_cast<char>('0' + pwmDutyCycle % 10);
+			*(command++) = '\n';
+		}
+	}
 
-			if ( (fprintf(_fid, "%i=%f\n", i, pwmDutyCycle) < 0) || (fflush(_fid) < 0))
-			{
-				if (_fid != nullptr)
-				{
-					fclose(_fid);
-					_fid = nullptr;
-					return -1;
-				}
-			}
+	const size_t size = static_cast<size_t>(command - _frameBuffer);
+
+	if (size > 0)
+	{
+		ssize_t written;
+		do
+		{
+			written = ::write(_fid, _frameBuffer, size);
+		} while (written < 0 && errno == EINTR);
+
+		// the frame is smaller than PIPE_BUF: the FIFO takes it whole or not at all
+		if (written != static_cast<ssize_t>(size))
+		{
+			Error(_log, "Failed to write to the device (%s): %s", QSTRING_CSTR(_deviceName), strerror(errno));
+			::close(_fid);
+			_fid = -1;
+			return -1;
 		}
 	}
 
@@ -67,9 +67,14 @@ private:
 
 	int _gpio_to_led[64];
 	char _gpio_to_color[64];
+	/// the duty cycle sent last to the pin [1/1000], -1 if it's unknown
+	int _gpio_duty[64];
 
-	/// File-Pointer to the PiBlaster device
-	FILE * _fid;
+	/// the commands of a frame, "pin=0.500\n" for every pin at most
+	char _frameBuffer[64 * 10];
+
+	/// File descriptor of the PiBlaster device
+	int _fid;
 
 };
 
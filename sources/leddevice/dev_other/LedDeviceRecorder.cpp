@@ -0,0 +1,343 @@
+/* LedDeviceRecorder.cpp
+*
+*  MIT License
+*
+*  Copyright (c) 2023 awawa-dev
+*
+*  Project homesite: https://github.com/awawa-dev/HyperHDR
+*
+*  Permission is hereby granted, free of charge, to any person obtaining a copy
+*  of this software and associated documentation files (the "Software"), to deal
+*  in the Software without restriction, including without limitation the rights
+*  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+*  copies of the Software, and to permit persons to whom the Software is
+*  furnished to do so, subject to the following conditions:
+*
+*  The above copyright notice and this permission notice shall be included in all
+*  copies or substantial portions of the Software.
+
+*  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+*  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+*  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+*  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+*  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+*  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+*  SOFTWARE.
+*/
+
+
+#include "LedDeviceRecorder.h"
+
+#include <utils/LedFrameRecording.h>
+#include <utils/PerformanceCounters.h>
+#include <utils/PreciseTimer.h>
+
+// Qt includes
+#include <QDateTime>
+#include <QFile>
+#include <QMutex>
+#include <QThread>
+#include <QWaitCondition>
+
+#include <vector>
+
+namespace
+{
+	const char CONFIG_OUTPUT[] = "output";
+
+	// a block is handed over when it is full or older than the period
+	constexpr size_t BLOCK_SIZE = 256 * 1024;
+	constexpr qint64 BLOCK_PERIOD_NS = 1000000000;
+
+	// the blocks waiting for a slow disk, the frames are dropped above it
+	constexpr size_t MAX_PENDING_BLOCKS = 16;
+}
+
+///
+/// Writes the blocks of records to the recording: the device thread only hands over full blocks
+///
+class RecorderWriterThread : public QThread
+{
+public:
+	struct Stats
+	{
+		qint64 blocks = 0;
+		qint64 bytes = 0;
+		qint64 dropped = 0;
+		qint64 durationMax = 0;
+		bool   failed = false;
+	};
+
+	RecorderWriterThread(QFile* file) :
+		_file(file),
+		_busy(false),
+		_quit(false)
+	{
+	}
+
+	~RecorderWriterThread()
+	{
+		flush();
+		{
+			QMutexLocker locker(&_mutex);
+			_quit = true;
+			_condition.wakeAll();
+		}
+		wait();
+	}
+
+	/// false if the disk does not keep up and the block is dropped
+	bool queue(QByteArray& block)
+	{
+		QMutexLocker locker(&_mutex);
+
+		if (_pending.size() >= MAX_PENDING_BLOCKS)
+		{
+			_stats.dropped++;
+			return false;
+		}
+
+		_pending.emplace_back();
+		_pending.back().swap(block);
+		_condition.wakeAll();
+		return true;
+	}
+
+	/// waits until the queued blocks are written, ex. before closing the recording
+	void flush()
+	{
+		QMutexLocker locker(&_mutex);
+
+		while ((!_pending.empty() || _busy) && isRunning())
+			_done.wait(&_mutex);
+	}
+
+	Stats takeStats()
+	{
+		QMutexLocker locker(&_mutex);
+
+		Stats stats = _stats;
+		_stats = Stats();
+		return stats;
+	}
+
+private:
+	void run() override
+	{
+		QMutexLocker locker(&_mutex);
+
+		while (!_quit)
+		{
+			if (_pending.empty())
+			{
+				_condition.wait(&_mutex);
+				continue;
+			}
+
+			// the blocks are swapped, the device thread can queue the next ones meanwhile
+			std::swap(_active, _pending);
+			_busy = true;
+
+			locker.unlock();
+			const qint64 begin = PreciseTimer::now();
+			qint64 bytes = 0;
+			bool failed = false;
+			for (const QByteArray& block : _active)
+			{
+				if (_file->write(block) != block.size())
+					failed = true;
+				bytes += block.size();
+			}
+			_file->flush();
+			const qint64 duration = PreciseTimer::now() - begin;
+			locker.relock();
+
+			_stats.blocks += static_cast<qint64>(_active.size());
+			_stats.bytes += bytes;
+			_stats.durationMax = qMax(_stats.durationMax, duration);
+			_stats.failed |= failed;
+			_active.clear();
+			_busy = false;
+			_done.wakeAll();
+		}
+
+		_done.wakeAll();
+	}
+
+	QFile*					_file;
+	QMutex					_mutex;
+	QWaitCondition			_condition;
+	QWaitCondition			_done;
+	std::vector<QByteArray>	_pending;
+	std::vector<QByteArray>	_active;
+	bool					_busy;
+	bool					_quit;
+	Stats					_stats;
+};
+
+LedDeviceRecorder::LedDeviceRecorder(const QJsonObject& deviceConfig)
+	: LedDevice(deviceConfig)
+	, _recordLedCount(0)
+	, _recordSize(0)
+	, _file(nullptr)
+	, _firstFrameTime(-1)
+	, _blockTime(0)
+	, _frames(0)
+	, _statsToken(0)
+{
+}
+
+LedDeviceRecorder::~LedDeviceRecorder()
+{
+	_writer.reset();
+	delete _file;
+}
+
+LedDevice* LedDeviceRecorder::construct(const QJsonObject& deviceConfig)
+{
+	return new LedDeviceRecorder(deviceConfig);
+}
+
+bool LedDeviceRecorder::init(const QJsonObject& deviceConfig)
+{
+	bool initOK = LedDevice::init(deviceConfig);
+
+	_fileName = deviceConfig[CONFIG_OUTPUT].toString();
+
+	if (_fileName.isEmpty())
+	{
+		this->setInError("The output file of the recording is not set");
+		return false;
+	}
+
+	Debug(_log, "Recording file: %s", QSTRING_CSTR(_fileName));
+
+	return initOK;
+}
+
+int LedDeviceRecorder::open()
+{
+	int retval = -1;
+	_isDeviceReady = false;
+
+	if (_file == nullptr)
+	{
+		_file = new QFile(_fileName);
+	}
+
+	if (!_file->open(QIODevice::WriteOnly | QIODevice::Truncate))
+	{
+		QString errortext = QString("(%1) %2, file: (%3)").arg(_file->error()).arg(_file->errorString(), _fileName);
+		this->setInError(errortext);
+		return retval;
+	}
+
+	// the header with the wall clock time of the first frame is written when it comes
+	_recordLedCount = static_cast<uint32_t>(qMax(getLedCount(), 1));
+	_recordSize = LedFrameRecording::recordSize(_recordLedCount);
+	_firstFrameTime = -1;
+	_frames = 0;
+	_block.clear();
+	_block.reserve(static_cast<int>(BLOCK_SIZE + _recordSize));
+
+	_writer.reset(new RecorderWriterThread(_file));
+	_writer->start(QThread::LowPriority);
+
+	Info(_log, "Recording %d LEDs per frame to: %s", static_cast<int>(_recordLedCount), QSTRING_CSTR(_fileName));
+
+	_isDeviceReady = true;
+	retval = 0;
+
+	return retval;
+}
+
+int LedDeviceRecorder::close()
+{
+	_isDeviceReady = false;
+
+	if (_writer != nullptr)
+	{
+		flushBlock();
+		_writer.reset();
+		_file->close();
+
+		Info(_log, "Recorded %lld frames to: %s", static_cast<long long>(_frames), QSTRING_CSTR(_fileName));
+	}
+
+	return 0;
+}
+
+int LedDeviceRecorder::write(const std::vector<ColorRgb>& ledValues)
+{
+	if (_writer == nullptr)
+		return -1;
+
+	const qint64 now = PreciseTimer::now();
+
+	if (_firstFrameTime < 0)
+	{
+		LedFrameRecording::Header header = LedFrameRecording::makeHeader(_recordLedCount, QDateTime::currentMSecsSinceEpoch());
+		_block.append(reinterpret_cast<const char*>(&header), sizeof(header));
+		_firstFrameTime = now;
+		_blockTime = now;
+	}
+
+	// fixed size record: the time, then the colors padded with black
+	const int offset = _block.size();
+	_block.resize(offset + static_cast<int>(_recordSize));
+	char* record = _block.data() + offset;
+
+	const int64_t frameTime = now - _firstFrameTime;
+	memcpy(record, &frameTime, sizeof(frameTime));
+
+	const size_t colorSize = qMin(ledValues.size(), static_cast<size_t>(_recordLedCount)) * 3;
+	memcpy(record + sizeof(frameTime), ledValues.data(), colorSize);
+	memset(record + sizeof(frameTime) + colorSize, 0, _recordSize - sizeof(frameTime) - colorSize);
+
+	_frames++;
+
+	if (static_cast<size_t>(_block.size()) >= BLOCK_SIZE || now - _blockTime >= BLOCK_PERIOD_NS)
+	{
+		flushBlock();
+		_blockTime = now;
+	}
+
+	// once per performance counters period
+	int64_t token = PerformanceCounters::currentToken();
+	if (token != _statsToken)
+	{
+		RecorderWriterThread::Stats stats = _writer->takeStats();
+
+		if (_statsToken > 0 && (stats.blocks > 0 || stats.dropped > 0))
+		{
+			Debug(_log, "Recording: %lld frames, written %lld kB in %lld blocks, dropped blocks: %lld, longest write: %lld ms",
+				static_cast<long long>(_frames), static_cast<long long>(stats.bytes / 1024), static_cast<long long>(stats.blocks),
+				static_cast<long long>(stats.dropped), static_cast<long long>(stats.durationMax / 1000000));
+		}
+
+		if (stats.dropped > 0)
+			Warning(_log, "The disk does not keep up with the recording, %lld blocks of frames were dropped", static_cast<long long>(stats.dropped));
+
+		if (stats.failed)
+		{
+			this->setInError(QString("Failed to write the recording: %1").arg(_fileName));
+			return -1;
+		}
+
+		_statsToken = token;
+	}
+
+	return 0;
+}
+
+void LedDeviceRecorder::flushBlock()
+{
+	if (_block.isEmpty() || _writer == nullptr)
+		return;
+
+	// a dropped block of a slow disk is lost, the next one starts over
+	if (!_writer->queue(_block))
+		_block.clear();
+
+	_block.reserve(static_cast<int>(BLOCK_SIZE + _recordSize));
+}
@@ -0,0 +1,91 @@
+#ifndef LEDEVICERECORDER_H
+#define LEDEVICERECORDER_H
+
+// LedDevice includes
+#include <leddevice/LedDevice.h>
+
+#include <memory>
+
+class RecorderWriterThread;
+class QFile;
+
+///
+/// Implementation of the LedDevice that records the frames into a binary file (see LedFrameRecording.h)
+/// for a later replay. The records are collected in blocks and written by a background thread,
+/// so the file system never delays the device thread.
+///
+class LedDeviceRecorder : public LedDevice
+{
+public:
+
+	///
+	/// @brief Constructs the recorder LED-device
+	///
+	/// @param deviceConfig Device's configuration as JSON-Object
+	///
+	explicit LedDeviceRecorder(const QJsonObject& deviceConfig);
+
+	///
+	/// @brief Destructor of the LedDevice
+	///
+	~LedDeviceRecorder() override;
+
+	///
+	/// @brief Constructs the LED-device
+	///
+	/// @param[in] deviceConfig Device's configuration as JSON-Object
+	/// @return LedDevice constructed
+	static LedDevice* construct(const QJsonObject& deviceConfig);
+
+protected:
+
+	///
+	/// @brief Initialise the device's configuration
+	///
+	/// @param[in] deviceConfig the JSON device configuration
+	/// @return True, if success
+	///
+	bool init(const QJsonObject& deviceConfig) override;
+
+	///
+	/// @brief Creates the recording and starts the writer thread
+	///
+	/// @return Zero on success (i.e. device is ready), else negative
+	///
+	int open() override;
+
+	///
+	/// @brief Writes the remaining records and closes the recording
+	///
+	/// @return Zero on success (i.e. device is closed), else negative
+	///
+	int close() override;
+
+	///
+	/// @brief Appends the frame to the current block of records
+	///
+	/// @param[in] ledValues The RGB-color per LED
+	/// @return Zero on success, else negative
+	///
+	int write(const std::vector<ColorRgb>& ledValues) override;
+
+private:
+
+	/// hands the current block over to the writer thread
+	void flushBlock();
+
+	QString _fileName;
+	uint32_t _recordLedCount;
+	size_t _recordSize;
+
+	QFile* _file;
+	std::unique_ptr<RecorderWriterThread> _writer;
+	QByteArray _block;
+	qint64 _firstFrameTime;
+	qint64 _blockTime;
+
+	qint64 _frames;
+	int64_t _statsToken;
+};
+
+#endif // LEDEVICERECORDER_H
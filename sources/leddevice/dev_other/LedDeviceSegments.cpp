@@ -0,0 +1,276 @@
+/* LedDeviceSegments.cpp
+*
+*  MIT License
+*
+*  Copyright (c) 2023 awawa-dev
+*
+*  Project homesite: https://github.com/awawa-dev/HyperHDR
+*
+*  Permission is hereby granted, free of charge, to any person obtaining a copy
+*  of this software and associated documentation files (the "Software"), to deal
+*  in the Software without restriction, including without limitation the rights
+*  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+*  copies of the Software, and to permit persons to whom the Software is
+*  furnished to do so, subject to the following conditions:
+*
+*  The above copyright notice and this permission notice shall be included in all
+*  copies or substantial portions of the Software.
+
+*  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+*  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+*  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+*  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+*  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+*  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+*  SOFTWARE.
+*/
+
+
+#include "LedDeviceSegments.h"
+
+#include <leddevice/LedDeviceFactory.h>
+#include <utils/Macros.h>
+#include <utils/PerformanceCounters.h>
+#include <utils/PreciseTimer.h>
+
+// Qt includes
+#include <QThread>
+#include <QTimer>
+
+namespace
+{
+	const char CONFIG_SEGMENTS[] = "segments";
+	const char CONFIG_FIRST[] = "first";
+	const char CONFIG_COUNT[] = "count";
+	const char CONFIG_DEVICE[] = "device";
+}
+
+LedDeviceSegments::LedDeviceSegments(const QJsonObject& deviceConfig)
+	: LedDevice(deviceConfig)
+	, _statsToken(0)
+{
+}
+
+LedDeviceSegments::~LedDeviceSegments()
+{
+	stopSegments();
+}
+
+LedDevice* LedDeviceSegments::construct(const QJsonObject& deviceConfig)
+{
+	return new LedDeviceSegments(deviceConfig);
+}
+
+bool LedDeviceSegments::init(const QJsonObject& deviceConfig)
+{
+	bool isInitOK = false;
+
+	if (LedDevice::init(deviceConfig))
+	{
+		createSegments(deviceConfig[CONFIG_SEGMENTS].toArray());
+
+		if (_segments.empty())
+		{
+			this->setInError("No usable segment is configured");
+		}
+		else
+			isInitOK = true;
+	}
+
+	return isInitOK;
+}
+
+void LedDeviceSegments::createSegments(const QJsonArray& segments)
+{
+	stopSegments();
+
+	for (const QJsonValue& item : segments)
+	{
+		QJsonObject segmentConfig = item.toObject();
+		int first = segmentConfig[CONFIG_FIRST].toInt(0);
+		int count = segmentConfig[CONFIG_COUNT].toInt(0);
+
+		// the device configuration may be edited as a JSON text
+		QJsonObject deviceConfig = segmentConfig[CONFIG_DEVICE].toObject();
+		if (segmentConfig[CONFIG_DEVICE].isString())
+			deviceConfig = QJsonDocument::fromJson(segmentConfig[CONFIG_DEVICE].toString().toUtf8()).object();
+
+		QString type = deviceConfig["type"].toString().toLower();
+
+		if (first < 0 || count <= 0 || first + count > static_cast<int>(_ledCount))
+		{
+			Error(_log, "Segment %d-%d is outside of the %d LEDs. Skipping.", first, first + count - 1, _ledCount);
+			continue;
+		}
+
+		if (type.isEmpty() || type == "segments")
+		{
+			Error(_log, "Segment %d-%d has an invalid device type: '%s'. Skipping.", first, first + count - 1, QSTRING_CSTR(type));
+			continue;
+		}
+
+		deviceConfig["currentLedCount"] = count;
+
+		std::unique_ptr<Segment> segment(new Segment());
+		segment->first = first;
+		segment->count = count;
+		segment->type = type;
+		segment->colors.resize(count);
+
+		segment->thread = new QThread();
+		segment->thread->setObjectName("LedSegmentThread");
+		segment->device = LedDeviceFactory::construct(deviceConfig);
+		segment->device->setActiveDeviceType(type);
+		segment->device->moveToThread(segment->thread);
+
+		connect(segment->thread, &QThread::started, segment->device, &LedDevice::start, Qt::QueuedConnection);
+
+		Info(_log, "Segment %d-%d: '%s'", first, first + count - 1, QSTRING_CSTR(type));
+
+		segment->thread->start();
+		_segments.push_back(std::move(segment));
+	}
+}
+
+void LedDeviceSegments::stopSegments()
+{
+	for (auto& segment : _segments)
+	{
+		// turns the LEDs off & stops the refresh timer of the segment
+		QMetaObject::invokeMethod(segment->device, "stop", Qt::BlockingQueuedConnection);
+
+		segment->thread->quit();
+		segment->thread->wait();
+		delete segment->thread;
+
+		delete segment->device;
+	}
+
+	_segments.clear();
+}
+
+int LedDeviceSegments::open()
+{
+	for (auto& segment : _segments)
+		QUEUE_CALL_0(segment->device, enable);
+
+	_isDeviceReady = true;
+
+	return 0;
+}
+
+int LedDeviceSegments::close()
+{
+	_isDeviceReady = false;
+
+	for (auto& segment : _segments)
+		QUEUE_CALL_0(segment->device, disable);
+
+	return 0;
+}
+
+int LedDeviceSegments::updateLeds(const LedFrame& ledValues, const FrameTrace& trace)
+{
+	_frameTrace = trace;
+
+	return LedDevice::updateLeds(ledValues, trace);
+}
+
+int LedDeviceSegments::write(const std::vector<ColorRgb>& ledValues)
+{
+	for (auto& segment : _segments)
+		dispatch(segment.get(), ledValues);
+
+	// once per performance counters period
+	int64_t token = PerformanceCounters::currentToken();
+	if (token != _statsToken)
+	{
+		if (_statsToken > 0)
+			reportSegments();
+
+		_statsToken = token;
+	}
+
+	return 0;
+}
+
+void LedDeviceSegments::dispatch(Segment* segment, const std::vector<ColorRgb>& ledValues)
+{
+	if (segment->first + segment->count > static_cast<int>(ledValues.size()))
+		return;
+
+	std::copy(ledValues.begin() + segment->first, ledValues.begin() + segment->first + segment->count, segment->colors.begin());
+
+	LedFrame frame = segment->pool.make(segment->colors);
+	bool post = false;
+
+	{
+		QMutexLocker locker(&segment->mutex);
+
+		// the segment device is still busy with an older frame: the newest one replaces the waiting one
+		if (segment->hasPending)
+			segment->replaced++;
+		else
+			post = true;
+
+		segment->pending = frame;
+		segment->pendingTrace = _frameTrace;
+		segment->pendingQueued = PreciseTimer::now();
+		segment->hasPending = true;
+	}
+
+	if (post)
+		QTimer::singleShot(0, segment->device, [segment]() { deliver(segment); });
+}
+
+void LedDeviceSegments::deliver(Segment* segment)
+{
+	LedFrame frame;
+	FrameTrace trace;
+
+	{
+		QMutexLocker locker(&segment->mutex);
+
+		if (!segment->hasPending)
+			return;
+
+		const qint64 delay = PreciseTimer::now() - segment->pendingQueued;
+
+		frame.swap(segment->pending);
+		trace = segment->pendingTrace;
+		segment->hasPending = false;
+
+		segment->frames++;
+		segment->delaySum += delay;
+		segment->delayMax = qMax(segment->delayMax, delay);
+	}
+
+	segment->device->updateLeds(frame, trace);
+}
+
+void LedDeviceSegments::reportSegments()
+{
+	for (auto& segment : _segments)
+	{
+		qint64 frames, replaced, delaySum, delayMax;
+
+		{
+			QMutexLocker locker(&segment->mutex);
+
+			frames = segment->frames;
+			replaced = segment->replaced;
+			delaySum = segment->delaySum;
+			delayMax = segment->delayMax;
+
+			segment->frames = 0;
+			segment->replaced = 0;
+			segment->delaySum = 0;
+			segment->delayMax = 0;
+		}
+
+		if (frames > 0 || replaced > 0)
+			Info(_log, "Segment %d-%d '%s': %lld frames, %.2f ms average delay, %.2f ms max, %lld replaced while the device was busy",
+				segment->first, segment->first + segment->count - 1, QSTRING_CSTR(segment->type), static_cast<long long>(frames),
+				(frames > 0) ? delaySum / 1000000.0 / frames : 0.0, delayMax / 1000000.0, static_cast<long long>(replaced));
+	}
+}
@@ -0,0 +1,116 @@
+#ifndef LEDEVICESEGMENTS_H
+#define LEDEVICESEGMENTS_H
+
+// LedDevice includes
+#include <leddevice/LedDevice.h>
+
+// Qt includes
+#include <QMutex>
+
+#include <memory>
+
+class QThread;
+
+///
+/// Implementation of the LedDevice that splits the LEDs into ranges and sends every range to its own
+/// LED-device. Every segment device runs in its own thread, so the slow ones don't delay the others.
+///
+class LedDeviceSegments : public LedDevice
+{
+	Q_OBJECT
+
+public:
+
+	///
+	/// @brief Constructs the composite LED-device
+	///
+	/// @param deviceConfig Device's configuration as JSON-Object
+	///
+	explicit LedDeviceSegments(const QJsonObject& deviceConfig);
+
+	///
+	/// @brief Destructor of the LedDevice, stops the segment devices
+	///
+	~LedDeviceSegments() override;
+
+	///
+	/// @brief Constructs the LED-device
+	///
+	/// @param[in] deviceConfig Device's configuration as JSON-Object
+	/// @return LedDevice constructed
+	static LedDevice* construct(const QJsonObject& deviceConfig);
+
+public slots:
+
+	int updateLeds(const LedFrame& ledValues, const FrameTrace& trace) override;
+
+protected:
+
+	///
+	/// @brief Initialise the device's configuration and creates the segment devices
+	///
+	/// @param[in] deviceConfig the JSON device configuration
+	/// @return True, if success
+	///
+	bool init(const QJsonObject& deviceConfig) override;
+
+	///
+	/// @brief Enables the segment devices
+	///
+	/// @return Zero on success (i.e. device is ready), else negative
+	///
+	int open() override;
+
+	///
+	/// @brief Disables the segment devices
+	///
+	/// @return Zero on success (i.e. device is closed), else negative
+	///
+	int close() override;
+
+	///
+	/// @brief Hands the ranges of the colors to the segment devices
+	///
+	/// @param[in] ledValues The RGB-color per LED
+	/// @return Zero on success, else negative
+	///
+	int write(const std::vector<ColorRgb>& ledValues) override;
+
+private:
+
+	/// one range of the LEDs and its device: the newest colors wait in the mailbox until the device thread takes them
+	struct Segment
+	{
+		int				first = 0;
+		int				count = 0;
+		QString			type;
+		LedDevice*		device = nullptr;
+		QThread*		thread = nullptr;
+		LedFramePool	pool;
+		std::vector<ColorRgb>	colors;
+
+		QMutex			mutex;
+		LedFrame		pending;
+		FrameTrace		pendingTrace;
+		qint64			pendingQueued = 0;
+		bool			hasPending = false;
+
+		/// since the last report, the delay [ns] is from write() to the segment device thread
+		qint64			frames = 0;
+		qint64			replaced = 0;
+		qint64			delaySum = 0;
+		qint64			delayMax = 0;
+	};
+
+	void createSegments(const QJsonArray& segments);
+	void stopSegments();
+	void dispatch(Segment* segment, const std::vector<ColorRgb>& ledValues);
+	static void deliver(Segment* segment);
+	void reportSegments();
+
+	std::vector<std::unique_ptr<Segment>> _segments;
+	FrameTrace	_frameTrace;
+	int64_t	_statsToken;
+};
+
+#endif // LEDEVICESEGMENTS_H
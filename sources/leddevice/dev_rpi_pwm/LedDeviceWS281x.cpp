@@ -1,7 +1,24 @@
 #include "LedDeviceWS281x.h"
+#include <utils/PreciseTimer.h>
+#include <utils/PerformanceCounters.h>
+
+#include <QTimer>
+
+#include <algorithm>
+
+namespace
+{
+	// the low time that latches the frame, as waited by the library after the transfer
+	constexpr int64_t RESET_TIME_NS = 300000;
+}
 
 LedDeviceWS281x::LedDeviceWS281x(const QJsonObject& deviceConfig)
 	: LedDevice(deviceConfig)
+	, _frameTransferTime(0)
+	, _dmaEnd(0)
+	, _renderPending(false)
+	, _renderScheduled(false)
+	, _statsToken(0)
 {
 }
 
@@ -58,6 +75,16 @@ bool LedDeviceWS281x::init(const QJsonObject& deviceConfig)
 
 				Debug(_log, "ws281x strip type : %d", _led_string.channel[_channel].strip_type);
 
+				// 24 or 32 bits per LED at the given bit rate
+				int bitsPerLed = (_led_string.channel[_channel].strip_type == SK6812_STRIP_GRBW) ? 32 : 24;
+				if (_led_string.freq > 0)
+					_frameTransferTime = static_cast<int64_t>(_led_string.channel[_channel].count) * bitsPerLed * 1000000000LL / _led_string.freq + RESET_TIME_NS;
+
+				Debug(_log, "ws281x frame time : %lld us", static_cast<long long>(_frameTransferTime / 1000));
+
+				// the frame is handed over to the DMA, the transfer itself runs in the background
+				setAsyncWrites(true);
+
 				if (_refreshTimerInterval_ms > 0)
 					Error(_log, "The refresh timer is enabled ('Refresh time' > 0) and may limit the performance of the LED driver. Ignore this error if you set it on purpose for some reason (but you almost never need it).");
 
@@ -88,6 +115,9 @@ int LedDeviceWS281x::open()
 	}
 	else
 	{
+		_dmaEnd = 0;
+		_renderPending = false;
+
 		// Everything is OK, device is ready
 		_isDeviceReady = true;
 		retval = 0;
@@ -103,6 +133,7 @@ int LedDeviceWS281x::close()
 	// LedDevice specific closing activities
 	if (isInitialised())
 	{
+		_renderPending = false;
 		ws2811_fini(&_led_string);
 	}
 
@@ -113,25 +144,18 @@ int LedDeviceWS281x::close()
 int LedDeviceWS281x::write(const std::vector<ColorRgb>& ledValues)
 {
 	int idx = 0;
-	for (const ColorRgb& color : ledValues)
+
+	RGBW::Rgb_to_Rgbw(ledValues, _rgbwBuffer, (_led_string.channel[_channel].strip_type == SK6812_STRIP_GRBW) ? _whiteAlgorithm : RGBW::WhiteAlgorithm::WHITE_OFF);
+
+	for (const ColorRgbw& color : _rgbwBuffer)
 	{
 		if (idx >= _led_string.channel[_channel].count)
 		{
 			break;
 		}
 
-		_temp_rgbw.red = color.red;
-		_temp_rgbw.green = color.green;
-		_temp_rgbw.blue = color.blue;
-		_temp_rgbw.white = 0;
-
-		if (_led_string.channel[_channel].strip_type == SK6812_STRIP_GRBW)
-		{
-			Rgb_to_Rgbw(color, &_temp_rgbw, _whiteAlgorithm);
-		}
-
 		_led_string.channel[_channel].leds[idx++] =
-			((uint32_t)_temp_rgbw.white << 24) + ((uint32_t)_temp_rgbw.red << 16) + ((uint32_t)_temp_rgbw.green << 8) + _temp_rgbw.blue;
+			((uint32_t)color.white << 24) + ((uint32_t)color.red << 16) + ((uint32_t)color.green << 8) + color.blue;
 
 	}
 	while (idx < _led_string.channel[_channel].count)
@@ -139,5 +163,71 @@ int LedDeviceWS281x::write(const std::vector<ColorRgb>& ledValues)
 		_led_string.channel[_channel].leds[idx++] = 0;
 	}
 
-	return ws2811_render(&_led_string) ? -1 : 0;
+	// once per performance counters period
+	int64_t token = PerformanceCounters::currentToken();
+	if (token != _statsToken)
+	{
+		if (_statsToken > 0 && _stats.renders > 0)
+		{
+			Debug(_log, "Rendered frames: %lld, deferred: %lld, replaced while waiting for the DMA: %lld, DMA wait: avg %lld us, max %lld us",
+				static_cast<long long>(_stats.renders), static_cast<long long>(_stats.deferred), static_cast<long long>(_stats.replaced),
+				static_cast<long long>(_stats.waitSum / _stats.renders / 1000), static_cast<long long>(_stats.waitMax / 1000));
+		}
+
+		_stats = {};
+		_statsToken = token;
+	}
+
+	// the library encodes the LED buffer into its DMA buffer only when rendering, so the new frame
+	// can wait in the LED buffer while the DMA still sends the previous one
+	int64_t now = PreciseTimer::now();
+	if (now < _dmaEnd)
+	{
+		if (_renderPending)
+			_stats.replaced++;
+		else
+			_stats.deferred++;
+
+		_renderPending = true;
+
+		if (!_renderScheduled)
+		{
+			_renderScheduled = true;
+			int delay = static_cast<int>((_dmaEnd - now + 999999) / 1000000);
+			QTimer::singleShot(delay, Qt::PreciseTimer, this, [this]() {
+				_renderScheduled = false;
+				if (_renderPending && _isDeviceReady)
+				{
+					if (render() < 0)
+						this->setInError("Failed to render the deferred frame");
+				}
+			});
+		}
+
+		return 0;
+	}
+
+	return render();
+}
+
+int LedDeviceWS281x::render()
+{
+	_renderPending = false;
+
+	// normally the DMA is done by now and this does not block
+	int64_t waitBegin = PreciseTimer::now();
+	ws2811_wait(&_led_string);
+	int64_t waited = PreciseTimer::now() - waitBegin;
+
+	_stats.renders++;
+	_stats.waitSum += waited;
+	_stats.waitMax = std::max(_stats.waitMax, waited);
+
+	ws2811_return_t rc = ws2811_render(&_led_string);
+
+	int64_t renderEnd = PreciseTimer::now();
+	_dmaEnd = renderEnd + _frameTransferTime;
+	writeCompleted();
+
+	return (rc != WS2811_SUCCESS) ? -1 : 0;
 }
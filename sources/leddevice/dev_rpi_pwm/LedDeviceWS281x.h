@@ -63,10 +63,35 @@ protected:
 
 private:
 
+	///
+	/// @brief Waits for the DMA transfer of the previous frame and renders the LED buffer
+	///
+	/// @return Zero on success, else negative
+	///
+	int render();
+
 	ws2811_t    _led_string;
 	int         _channel;
 	RGBW::WhiteAlgorithm _whiteAlgorithm;
-	ColorRgbw   _temp_rgbw;
+	std::vector<ColorRgbw> _rgbwBuffer;
+
+	/// the PWM DMA needs this time for one frame including the reset [ns]
+	int64_t     _frameTransferTime;
+	/// the estimated end of the running DMA transfer [ns]
+	int64_t     _dmaEnd;
+	/// the LED buffer holds a frame that still waits for the DMA
+	bool        _renderPending;
+	bool        _renderScheduled;
+
+	struct
+	{
+		int64_t renders = 0;
+		int64_t deferred = 0;
+		int64_t replaced = 0;
+		int64_t waitSum = 0;
+		int64_t waitMax = 0;
+	} _stats;
+	int64_t     _statsToken;
 };
 
 #endif // LEDEVICEWS281X_H
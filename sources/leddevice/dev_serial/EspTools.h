@@ -38,7 +38,8 @@ public:
 		_rs232Port.write((char*)comBuffer, sizeof(comBuffer));
 	}
 
-	static void initializeEsp(QSerialPort& _rs232Port, QSerialPortInfo& serialPortInfo, Logger*& _log)
+	// returns the welcome message of the HyperSerial firmware (it lists the supported protocol extensions), empty if not detected
+	static QString initializeEsp(QSerialPort& _rs232Port, QSerialPortInfo& serialPortInfo, Logger*& _log)
 	{
 		uint8_t comBuffer[] = { 0x41, 0x77, 0x41, 0x2a, 0xa2, 0x15, 0x68, 0x79, 0x70, 0x65, 0x72, 0x68, 0x64, 0x72 };
 
@@ -94,6 +95,7 @@ public:
 
 		// read the reset message, search for AWA tag
 		auto start = InternalClock::now();
+		QString welcome;
 
 		while (InternalClock::now() - start < 1000)
 		{
@@ -112,6 +114,7 @@ public:
 				if (result.indexOf("Awa driver", Qt::CaseInsensitive) >= 0)
 				{
 					Info(_log, "DETECTED DEVICE USING HyperSerialEsp8266/HyperSerialESP32/HyperSerialPico FIRMWARE (%s) at %i msec", QSTRING_CSTR(result), int(InternalClock::now() - start));
+					welcome = result;
 					start = 0;
 					break;
 				}
@@ -122,6 +125,8 @@ public:
 
 		if (start != 0)
 			Error(_log, "Could not detect HyperSerialEsp8266/HyperSerialESP32/HyperSerialPico device");
+
+		return welcome;
 	}
 };
 
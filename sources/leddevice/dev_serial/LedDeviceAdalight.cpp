@@ -3,12 +3,34 @@
 #include <QtEndian>
 
 #include <cassert>
+#include <utils/InternalClock.h>
+
+namespace
+{
+	// the HyperSerial firmware lists the protocol extension in its welcome message
+	const char DELTA_FIRMWARE_TAG[] = "delta";
+
+	// a full frame is sent at least this often [ms]: a corrupted delta frame is dropped by the firmware
+	const qint64 DELTA_KEYFRAME_INTERVAL = 1000;
+
+	// shorter runs of the same color are cheaper as a part of the literal record
+	const size_t DELTA_MIN_RUN = 3;
+
+	// a record: the first led and the length of the range (15 bits, the top bit marks a run of one color)
+	const size_t DELTA_RECORD_SIZE = 4;
+	const size_t DELTA_MAX_LENGTH = 0x7FFF;
+	const quint16 DELTA_RUN_FLAG = 0x8000;
+}
 
 LedDeviceAdalight::LedDeviceAdalight(const QJsonObject& deviceConfig)
 	: ProviderRs232(deviceConfig)
 	, _headerSize(6)
 	, _ligthBerryAPA102Mode(false)
 	, _awa_mode(false)
+	, _awa_delta(false)
+	, _deltaActive(false)
+	, _deltaChecked(false)
+	, _lastKeyframe(0)
 {
 	_white_channel_calibration = false;
 	_white_channel_limit = 255;
@@ -32,6 +54,7 @@ bool LedDeviceAdalight::init(const QJsonObject& deviceConfig)
 
 		_ligthBerryAPA102Mode = deviceConfig["lightberry_apa102_mode"].toBool(false);
 		_awa_mode = deviceConfig["awa_mode"].toBool(false);
+		_awa_delta = _awa_mode && deviceConfig["awa_delta"].toBool(false);
 
 		_white_channel_calibration = deviceConfig["white_channel_calibration"].toBool(false);
 		_white_channel_limit = qMin(qRound(deviceConfig["white_channel_limit"].toDouble(1) * 255.0 / 100.0), 255);
@@ -44,6 +67,9 @@ bool LedDeviceAdalight::init(const QJsonObject& deviceConfig)
 		if (_white_channel_calibration && _awa_mode)
 			Debug(_log, "White channel limit: %i, red: %i, green: %i, blue: %i", _white_channel_limit, _white_channel_red, _white_channel_green, _white_channel_blue);
 
+		if (_awa_delta)
+			Debug(_log, "Delta frames: requested, the firmware must confirm them in the ESP handshake");
+
 		isInitOK = true;
 	}
 	return isInitOK;
@@ -79,6 +105,10 @@ void LedDeviceAdalight::CreateHeader()
 			Debug(_log, "Adalight driver with activated high speeed & data integration check AWA protocol");
 	}
 
+	_deltaBuffer.resize(_ledBuffer.size(), 0x00);
+	_deltaReference.clear();
+	_deltaBaseline.clear();
+
 	_ledBuffer[0] = 'A';
 	_ledBuffer[1] = (_awa_mode) ? 'w' : 'd';
 	_ledBuffer[2] = (_awa_mode && _white_channel_calibration) ? 'A' : 'a';
@@ -121,32 +151,193 @@ int LedDeviceAdalight::write(const std::vector<ColorRgb>& ledValues)
 			return 0;
 		}
 
-		uint8_t* writer = _ledBuffer.data() + _headerSize;
-		uint8_t* hasher = writer;
+		if (_awa_delta)
+		{
+			updateDeltaMode();
 
-		memcpy(writer, ledValues.data(), ledValues.size() * sizeof(ColorRgb));
-		writer += ledValues.size() * sizeof(ColorRgb);
+			if (_deltaActive)
+			{
+				// the waiting frame is going to be replaced: the new one must be relative to the frame before it
+				if (!hasPendingFrame())
+					_deltaBaseline.swap(_deltaReference);
 
-		if (_awa_mode)
+				qint64 deltaLength = 0;
+				int rc = 0;
+
+				if (InternalClock::now() - _lastKeyframe < DELTA_KEYFRAME_INTERVAL && encodeDelta(ledValues, deltaLength))
+				{
+					rc = writeBytes(deltaLength, _deltaBuffer.data());
+				}
+				else
+				{
+					rc = writeFrame(ledValues);
+					_lastKeyframe = InternalClock::now();
+				}
+
+				if (rc < 0)
+				{
+					_deltaReference.clear();
+					_deltaBaseline.clear();
+				}
+				else
+					_deltaReference = ledValues;
+
+				return rc;
+			}
+		}
+
+		return writeFrame(ledValues);
+	}
+}
+
+int LedDeviceAdalight::writeFrame(const std::vector<ColorRgb>& ledValues)
+{
+	uint8_t* writer = _ledBuffer.data() + _headerSize;
+	uint8_t* hasher = writer;
+
+	memcpy(writer, ledValues.data(), ledValues.size() * sizeof(ColorRgb));
+	writer += ledValues.size() * sizeof(ColorRgb);
+
+	if (_awa_mode)
+	{
+		whiteChannelExtension(writer);
+		appendChecksum(hasher, writer);
+	}
+	auto bufferLength = writer - _ledBuffer.data();
+
+	return writeBytes(bufferLength, _ledBuffer.data());
+}
+
+void LedDeviceAdalight::appendChecksum(const uint8_t* hasher, uint8_t*& writer)
+{
+	uint16_t fletcher1 = 0, fletcher2 = 0, fletcherExt = 0;
+	uint8_t position = 0;
+	while (hasher < writer)
+	{
+		fletcherExt = (fletcherExt + (*(hasher) ^ (position++))) % 255;
+		fletcher1 = (fletcher1 + *(hasher++)) % 255;
+		fletcher2 = (fletcher2 + fletcher1) % 255;
+	}
+	*(writer++) = (uint8_t)fletcher1;
+	*(writer++) = (uint8_t)fletcher2;
+	*(writer++) = (uint8_t)((fletcherExt != 0x41) ? fletcherExt : 0xaa);
+}
+
+void LedDeviceAdalight::updateDeltaMode()
+{
+	bool deltaActive = espFirmware().contains(DELTA_FIRMWARE_TAG, Qt::CaseInsensitive);
+
+	if (!_deltaChecked || deltaActive != _deltaActive)
+	{
+		if (deltaActive)
+			Info(_log, "The firmware supports delta frames: only the changed leds are sent, a full frame every %i ms", int(DELTA_KEYFRAME_INTERVAL));
+		else
+			Warning(_log, "The firmware did not confirm delta frames in the ESP handshake (enable the handshake and update HyperSerial). Sending full frames.");
+
+		_deltaChecked = true;
+		_deltaActive = deltaActive;
+		_deltaReference.clear();
+		_deltaBaseline.clear();
+		_lastKeyframe = 0;
+	}
+}
+
+bool LedDeviceAdalight::encodeDelta(const std::vector<ColorRgb>& ledValues, qint64& length)
+{
+	const size_t count = ledValues.size();
+
+	if (_deltaBaseline.size() != count || _deltaBuffer.size() < _ledBuffer.size())
+		return false;
+
+	// the delta frame is worth sending only while it's not longer than the full frame
+	uint8_t* writer = _deltaBuffer.data();
+	uint8_t* limit = _deltaBuffer.data() + _headerSize + count * sizeof(ColorRgb);
+	quint16 records = 0;
+
+	memcpy(writer, _ledBuffer.data(), _headerSize);
+	writer[2] = (_white_channel_calibration) ? 'D' : 'd';
+	writer += _headerSize + 2;
+
+	uint8_t* hasher = writer - 2;
+
+	auto addRecord = [&](size_t first, size_t size, bool run) -> bool
+	{
+		while (size > 0)
 		{
-			whiteChannelExtension(writer);
+			const size_t part = qMin(size, DELTA_MAX_LENGTH);
+			const size_t needed = DELTA_RECORD_SIZE + ((run) ? 1 : part) * sizeof(ColorRgb);
+
+			if (static_cast<size_t>(limit - writer) < needed)
+				return false;
+
+			qToBigEndian<quint16>(static_cast<quint16>(first), writer);
+			qToBigEndian<quint16>(static_cast<quint16>(part | ((run) ? DELTA_RUN_FLAG : 0)), writer + 2);
+			writer += DELTA_RECORD_SIZE;
+
+			memcpy(writer, &ledValues[first], ((run) ? 1 : part) * sizeof(ColorRgb));
+			writer += ((run) ? 1 : part) * sizeof(ColorRgb);
 
-			uint16_t fletcher1 = 0, fletcher2 = 0, fletcherExt = 0;
-			uint8_t position = 0;
-			while (hasher < writer)
+			records++;
+			first += part;
+			size -= part;
+		}
+		return true;
+	};
+
+	size_t index = 0;
+	while (index < count)
+	{
+		if (ledValues[index] == _deltaBaseline[index])
+		{
+			index++;
+			continue;
+		}
+
+		// the changed range, one unchanged led between the changes is cheaper than a new record
+		size_t end = index + 1;
+		while (end < count)
+		{
+			if (ledValues[end] != _deltaBaseline[end])
+				end++;
+			else if (end + 1 < count && ledValues[end + 1] != _deltaBaseline[end + 1])
+				end += 2;
+			else
+				break;
+		}
+
+		// the runs of one color are sent once
+		size_t literal = index;
+		for (size_t current = index; current < end; )
+		{
+			size_t run = current + 1;
+			while (run < end && ledValues[run] == ledValues[current])
+				run++;
+
+			if (run - current >= DELTA_MIN_RUN)
 			{
-				fletcherExt = (fletcherExt + (*(hasher) ^ (position++))) % 255;
-				fletcher1 = (fletcher1 + *(hasher++)) % 255;
-				fletcher2 = (fletcher2 + fletcher1) % 255;
+				if (current > literal && !addRecord(literal, current - literal, false))
+					return false;
+				if (!addRecord(current, run - current, true))
+					return false;
+				literal = run;
 			}
-			*(writer++) = (uint8_t)fletcher1;
-			*(writer++) = (uint8_t)fletcher2;
-			*(writer++) = (uint8_t)((fletcherExt != 0x41) ? fletcherExt : 0xaa);
+			current = run;
 		}
-		bufferLength = writer - _ledBuffer.data();
 
-		return writeBytes(bufferLength, _ledBuffer.data());
+		if (end > literal && !addRecord(literal, end - literal, false))
+			return false;
+
+		index = end;
 	}
+
+	qToBigEndian<quint16>(records, _deltaBuffer.data() + _headerSize);
+
+	whiteChannelExtension(writer);
+	appendChecksum(hasher, writer);
+
+	length = writer - _deltaBuffer.data();
+
+	return true;
 }
 
 void LedDeviceAdalight::whiteChannelExtension(uint8_t*& writer)
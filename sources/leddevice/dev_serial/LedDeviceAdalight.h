@@ -49,10 +49,39 @@ private:
 
 	void whiteChannelExtension(uint8_t*& writer);
 
+	///
+	/// @brief Writes the full AWA/Adalight frame
+	///
+	int writeFrame(const std::vector<ColorRgb>& ledValues);
+
+	void appendChecksum(const uint8_t* hasher, uint8_t*& writer);
+
+	///
+	/// @brief The delta frames are used only when the firmware confirmed them in the ESP handshake
+	///
+	void updateDeltaMode();
+
+	///
+	/// @brief Encodes the changes against _deltaBaseline: 'Awd' header, the record count and the records
+	/// (first led, length with the run flag, the colors or one color of the run), then the AWA checksum
+	///
+	/// @return False, if the delta frame wouldn't be shorter than the full one
+	///
+	bool encodeDelta(const std::vector<ColorRgb>& ledValues, qint64& length);
+
 	const short _headerSize;
 	bool        _ligthBerryAPA102Mode;
 	bool		_awa_mode;
 
+	bool		_awa_delta;
+	bool		_deltaActive;
+	bool		_deltaChecked;
+	qint64		_lastKeyframe;
+	std::vector<uint8_t>	_deltaBuffer;
+	/// the colors of the last frame handed to the port and of the frame before it
+	std::vector<ColorRgb>	_deltaReference;
+	std::vector<ColorRgb>	_deltaBaseline;
+
 	bool _white_channel_calibration;
 	uint8_t _white_channel_limit;
 	uint8_t _white_channel_red;
@@ -14,7 +14,9 @@
 #include <QThread>
 
 #include <chrono>
+#include <cmath>
 #include <utils/InternalClock.h>
+#include <utils/PreciseTimer.h>
 
 #include "EspTools.h"
 
@@ -22,6 +24,7 @@
 constexpr std::chrono::milliseconds WRITE_TIMEOUT{ 1000 };	// device write timeout in ms
 constexpr std::chrono::milliseconds OPEN_TIMEOUT{ 5000 };		// device open timeout in ms
 const int MAX_WRITE_TIMEOUTS = 5;	// Maximum number of allowed timeouts
+const int THROUGHPUT_FRAMES = 16;	// Frames measured before the sustainable frame rate is estimated
 const int NUM_POWEROFF_WRITE_BLACK = 3;	// Number of write "BLACK" during powering off
 
 ProviderRs232::ProviderRs232(const QJsonObject& deviceConfig)
@@ -32,7 +35,17 @@ ProviderRs232::ProviderRs232(const QJsonObject& deviceConfig)
 	, _delayAfterConnect_ms(0)
 	, _frameDropCounter(0)
 	, _espHandshake(true)
+	, _hasPendingFrame(false)
+	, _replacedFrames(0)
+	, _frameStart(0)
+	, _frameSize(0)
+	, _throughput(0)
+	, _measuredFrames(0)
+	, _refreshChecked(false)
 {
+	// the port sends in the background, the end of every frame is reported by handleBytesWritten
+	setAsyncWrites(true);
+	connect(&_rs232Port, &QSerialPort::bytesWritten, this, &ProviderRs232::handleBytesWritten);
 }
 
 bool ProviderRs232::init(const QJsonObject& deviceConfig)
@@ -152,6 +165,17 @@ int ProviderRs232::close()
 	// Test, if device requires closing
 	if (_rs232Port.isOpen())
 	{
+		// the last frame (ex. black) is written before closing
+		if (_hasPendingFrame)
+		{
+			_hasPendingFrame = false;
+			_rs232Port.write(_pendingFrame);
+		}
+		_frameSize = 0;
+
+		if (_rs232Port.bytesToWrite() > 0)
+			_rs232Port.waitForBytesWritten(WRITE_TIMEOUT.count());
+
 		if (_rs232Port.flush())
 		{
 			Debug(_log, "Flush was successful");
@@ -218,6 +242,13 @@ bool ProviderRs232::tryOpen(int delayAfterConnect_ms)
 		Info(_log, "Opening UART: %s", QSTRING_CSTR(_deviceName));
 
 		_frameDropCounter = 0;
+		_espFirmware.clear();
+		_hasPendingFrame = false;
+		_replacedFrames = 0;
+		_frameSize = 0;
+		_throughput = 0;
+		_measuredFrames = 0;
+		_refreshChecked = false;
 
 		_rs232Port.setBaudRate(_baudRate_Hz);
 
@@ -246,7 +277,7 @@ bool ProviderRs232::tryOpen(int delayAfterConnect_ms)
 			{
 				disconnect(&_rs232Port, &QSerialPort::readyRead, nullptr, nullptr);
 
-				EspTools::initializeEsp(_rs232Port, serialPortInfo, _log);
+				_espFirmware = EspTools::initializeEsp(_rs232Port, serialPortInfo, _log);
 			}
 		}
 		else
@@ -283,7 +314,6 @@ void ProviderRs232::setInError(const QString& errorMsg)
 
 int ProviderRs232::writeBytes(const qint64 size, const uint8_t* data)
 {
-	int rc = 0;
 	if (!_rs232Port.isOpen())
 	{
 		Debug(_log, "!_rs232Port.isOpen()");
@@ -293,41 +323,75 @@ int ProviderRs232::writeBytes(const qint64 size, const uint8_t* data)
 			return -1;
 		}
 	}
-	qint64 bytesWritten = _rs232Port.write(reinterpret_cast<const char*>(data), size);
-	if (bytesWritten == -1 || bytesWritten != size)
-	{
-		this->setInError(QString("Rs232 SerialPortError: %1").arg(_rs232Port.errorString()));
-		rc = -1;
-	}
-	else
+
+	// the previous frame is still on the way: the device thread doesn't wait for it, the newest frame waits instead
+	if (_frameSize > 0 && _rs232Port.bytesToWrite() > 0)
 	{
-		if (!_rs232Port.waitForBytesWritten(WRITE_TIMEOUT.count()))
+		int rc = 0;
+
+		if (PreciseTimer::now() - _frameStart > std::chrono::duration_cast<std::chrono::nanoseconds>(WRITE_TIMEOUT).count())
 		{
-			if (_rs232Port.error() == QSerialPort::TimeoutError)
-			{
-				Debug(_log, "Timeout after %dms: %d frames already dropped", WRITE_TIMEOUT, _frameDropCounter);
+			Debug(_log, "Timeout after %dms: %d frames already dropped", static_cast<int>(WRITE_TIMEOUT.count()), _frameDropCounter);
 
-				++_frameDropCounter;
+			++_frameDropCounter;
+			_frameStart = PreciseTimer::now();
 
-				// Check,if number of timeouts in a given time frame is greater than defined
-				// TODO: ProviderRs232::writeBytes - Add time frame to check for timeouts that devices does not close after absolute number of timeouts
-				if (_frameDropCounter > MAX_WRITE_TIMEOUTS)
-				{
-					this->setInError(QString("Timeout writing data to %1").arg(_deviceName));
-					rc = -1;
-				}
-				else
-				{
-					//give it another try
-					_rs232Port.clearError();
-				}
+			// Check,if number of timeouts in a given time frame is greater than defined
+			// TODO: ProviderRs232::writeBytes - Add time frame to check for timeouts that devices does not close after absolute number of timeouts
+			if (_frameDropCounter > MAX_WRITE_TIMEOUTS)
+			{
+				this->setInError(QString("Timeout writing data to %1").arg(_deviceName));
+				rc = -1;
 			}
 			else
 			{
-				this->setInError(QString("Rs232 SerialPortError: %1").arg(_rs232Port.errorString()));
-				rc = -1;
+				//give it another try
+				_rs232Port.clearError();
 			}
 		}
+
+		if (rc == 0)
+		{
+			if (_hasPendingFrame)
+				_replacedFrames++;
+
+			_pendingFrame = QByteArray(reinterpret_cast<const char*>(data), static_cast<int>(size));
+			_hasPendingFrame = true;
+		}
+		else if (_maxRetry > 0 && !_signalTerminate)
+		{
+			QTimer::singleShot(2000, this, [=]() { if (!_signalTerminate) enable(); });
+		}
+
+		return rc;
+	}
+
+	return startFrame(size, data);
+}
+
+bool ProviderRs232::hasPendingFrame() const
+{
+	return _hasPendingFrame;
+}
+
+const QString& ProviderRs232::espFirmware() const
+{
+	return _espFirmware;
+}
+
+int ProviderRs232::startFrame(const qint64 size, const uint8_t* data)
+{
+	int rc = 0;
+
+	_frameStart = PreciseTimer::now();
+	_frameSize = size;
+
+	qint64 bytesWritten = _rs232Port.write(reinterpret_cast<const char*>(data), size);
+	if (bytesWritten == -1 || bytesWritten != size)
+	{
+		_frameSize = 0;
+		this->setInError(QString("Rs232 SerialPortError: %1").arg(_rs232Port.errorString()));
+		rc = -1;
 	}
 
 	if (_maxRetry > 0 && rc == -1 && !_signalTerminate)
@@ -338,6 +402,53 @@ int ProviderRs232::writeBytes(const qint64 size, const uint8_t* data)
 	return rc;
 }
 
+void ProviderRs232::handleBytesWritten(qint64 /*bytes*/)
+{
+	if (_frameSize <= 0 || _rs232Port.bytesToWrite() > 0)
+		return;
+
+	const qint64 now = PreciseTimer::now();
+	const qint64 duration = now - _frameStart;
+
+	writeCompleted();
+
+	// the serial link can't be faster than the baud rate (8N1: 10 bits per byte), the OS buffer may accept a frame at once
+	if (duration > 0)
+	{
+		const double measured = qMin(_frameSize * 1e9 / duration, _baudRate_Hz / 10.0);
+		_throughput = (_throughput <= 0) ? measured : _throughput + (measured - _throughput) / 8;
+
+		if (_measuredFrames < THROUGHPUT_FRAMES)
+			_measuredFrames++;
+	}
+
+	// the refresh timer would only pile up the writes above the sustainable frame rate
+	if (!_refreshChecked && _measuredFrames >= THROUGHPUT_FRAMES && _throughput > 0)
+	{
+		const double maxFps = _throughput / _frameSize;
+		const int minInterval = static_cast<int>(std::ceil(1000.0 / maxFps));
+
+		_refreshChecked = true;
+
+		Info(_log, "Serial throughput: %.1f KB/s, up to %.1f fps for %lld bytes per frame. Frames replaced while the port was busy: %lld",
+			_throughput / 1024.0, maxFps, static_cast<long long>(_frameSize), static_cast<long long>(_replacedFrames));
+
+		if (_refreshTimerInterval_ms > 0 && _refreshTimerInterval_ms < minInterval)
+		{
+			Warning(_log, "The refresh time (%d ms) is shorter than the serial link can sustain, it's limited to %d ms", _refreshTimerInterval_ms, minInterval);
+			setRefreshTime(minInterval);
+		}
+	}
+
+	_frameSize = 0;
+
+	if (_hasPendingFrame)
+	{
+		_hasPendingFrame = false;
+		startFrame(_pendingFrame.size(), reinterpret_cast<const uint8_t*>(_pendingFrame.constData()));
+	}
+}
+
 QString ProviderRs232::discoverFirst()
 {
 	for (int round = 0; round < 4; round++)
@@ -81,6 +81,16 @@ protected:
 	///
 	int writeBytes(const qint64 size, const uint8_t* data);
 
+	///
+	/// @brief The next writeBytes() replaces the frame that waits for the busy port: that frame is never sent
+	///
+	bool hasPendingFrame() const;
+
+	///
+	/// @brief The welcome message of the HyperSerial firmware from the ESP handshake, empty if not detected
+	///
+	const QString& espFirmware() const;
+
 	/// The name of the output device
 	QString _deviceName;
 	/// The RS232 serial-device
@@ -100,6 +110,12 @@ protected slots:
 public slots:
 	void waitForExitStats(bool force);
 
+private slots:
+	///
+	/// @brief The port sent a part of the frame: the end of the frame sends the waiting one
+	///
+	void handleBytesWritten(qint64 bytes);
+
 private:
 
 	///
@@ -118,7 +134,23 @@ private:
 	/// Frames dropped, as write failed
 	int _frameDropCounter;
 
+	/// starts the transfer of the frame, the port sends it in the background
+	int startFrame(const qint64 size, const uint8_t* data);
+
+	/// the frame that waits for the end of the current transfer, a newer one replaces it
+	QByteArray _pendingFrame;
+	bool	_hasPendingFrame;
+	qint64	_replacedFrames;
+
+	/// the current transfer [ns of PreciseTimer::now()] and the measured throughput [bytes/s]
+	qint64	_frameStart;
+	qint64	_frameSize;
+	double	_throughput;
+	int		_measuredFrames;
+	bool	_refreshChecked;
+
 	bool _espHandshake;
+	QString _espFirmware;
 };
 
 #endif // PROVIDERRS232_H
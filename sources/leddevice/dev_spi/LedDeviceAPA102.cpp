@@ -1,5 +1,7 @@
 #include "LedDeviceAPA102.h"
 
+#include <cstring>
+
 LedDeviceAPA102::LedDeviceAPA102(const QJsonObject& deviceConfig)
 	: ProviderSpi(deviceConfig)
 {
@@ -49,13 +51,23 @@ int LedDeviceAPA102::write(const std::vector<ColorRgb>& ledValues)
 		CreateHeader();
 	}
 
-	for (signed iLed = 0; iLed < static_cast<int>(_ledCount); ++iLed) {
-		const ColorRgb& rgb = ledValues[iLed];
-		_ledBuffer[4 + iLed * 4] = 0xFF;
-		_ledBuffer[4 + iLed * 4 + 1] = rgb.red;
-		_ledBuffer[4 + iLed * 4 + 2] = rgb.green;
-		_ledBuffer[4 + iLed * 4 + 3] = rgb.blue;
-	}
+	// encoded once, straight into the buffer of the SPI transfer: the start and the end frame come from the template
+	return writeEncoded(static_cast<unsigned>(_ledBuffer.size()), [&](uint8_t* buffer) {
+		const unsigned int startFrameSize = 4;
+		const size_t ledsSize = static_cast<size_t>(_ledCount) * 4;
+
+		memcpy(buffer, _ledBuffer.data(), startFrameSize);
+
+		uint8_t* led = buffer + startFrameSize;
+		for (const ColorRgb& rgb : ledValues)
+		{
+			led[0] = 0xFF;
+			led[1] = rgb.red;
+			led[2] = rgb.green;
+			led[3] = rgb.blue;
+			led += 4;
+		}
 
-	return writeBytes(_ledBuffer.size(), _ledBuffer.data());
+		memcpy(led, _ledBuffer.data() + startFrameSize + ledsSize, _ledBuffer.size() - startFrameSize - ledsSize);
+	});
 }
@@ -65,14 +65,15 @@ int LedDeviceSk6812SPI::write(const std::vector<ColorRgb>& ledValues)
 		_ledBuffer.resize(_ledRGBWCount * SPI_BYTES_PER_COLOUR + SPI_FRAME_END_LATCH_BYTES, 0x00);
 	}
 
-	for (const ColorRgb& color : ledValues)
+	RGBW::Rgb_to_Rgbw(ledValues, _rgbwBuffer, _whiteAlgorithm);
+
+	for (const ColorRgbw& color : _rgbwBuffer)
 	{
-		RGBW::Rgb_to_Rgbw(color, &_temp_rgbw, _whiteAlgorithm);
 		uint32_t colorBits =
-			((uint32_t)_temp_rgbw.red << 24) +
-			((uint32_t)_temp_rgbw.green << 16) +
-			((uint32_t)_temp_rgbw.blue << 8) +
-			_temp_rgbw.white;
+			((uint32_t)color.red << 24) +
+			((uint32_t)color.green << 16) +
+			((uint32_t)color.blue << 8) +
+			color.white;
 
 		for (int j = SPI_BYTES_PER_LED - 1; j >= 0; j--)
 		{
@@ -48,7 +48,8 @@ private:
 	const int SPI_BYTES_PER_COLOUR;
 	uint8_t bitpair_to_byte[4];
 
-	ColorRgbw _temp_rgbw;
+	/// The converted colors of the last frame
+	std::vector<ColorRgbw> _rgbwBuffer;
 };
 
 #endif // LEDEVICESK6812SPI_H
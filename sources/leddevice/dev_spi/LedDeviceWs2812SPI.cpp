@@ -1,5 +1,7 @@
 #include "LedDeviceWs2812SPI.h"
 
+#include <cstring>
+
 /*
 From the data sheet:
 
@@ -45,6 +47,14 @@ LedDeviceWs2812SPI::LedDeviceWs2812SPI(const QJsonObject& deviceConfig)
 		0b11001100,
 }
 {
+	// every colour byte becomes 4 SPI bytes, one per bit pair starting with the highest one
+	for (int value = 0; value < 256; value++)
+	{
+		for (int j = 0; j < 4; j++)
+		{
+			byte_to_spi[value][j] = bitpair_to_byte[(value >> (6 - 2 * j)) & 0x3];
+		}
+	}
 }
 
 LedDevice* LedDeviceWs2812SPI::construct(const QJsonObject& deviceConfig)
@@ -63,8 +73,6 @@ bool LedDeviceWs2812SPI::init(const QJsonObject& deviceConfig)
 	{
 		WarningIf((_baudRate_Hz < 2106000 || _baudRate_Hz > 3075000), _log, "SPI rate %d outside recommended range (2106000 -> 3075000)", _baudRate_Hz);
 
-		_ledBuffer.resize(_ledRGBCount * SPI_BYTES_PER_COLOUR + SPI_FRAME_END_LATCH_BYTES, 0x00);
-
 		isInitOK = true;
 	}
 
@@ -73,36 +81,27 @@ bool LedDeviceWs2812SPI::init(const QJsonObject& deviceConfig)
 
 int LedDeviceWs2812SPI::write(const std::vector<ColorRgb>& ledValues)
 {
-	unsigned spi_ptr = 0;
 	const int SPI_BYTES_PER_LED = sizeof(ColorRgb) * SPI_BYTES_PER_COLOUR;
 
 	if (_ledCount != ledValues.size())
 	{
 		Warning(_log, "Ws2812SPI led's number has changed (old: %d, new: %d). Rebuilding buffer.", _ledCount, ledValues.size());
 		_ledCount = ledValues.size();
-
-		_ledBuffer.resize(0, 0x00);
-		_ledBuffer.resize(_ledRGBCount * SPI_BYTES_PER_COLOUR + SPI_FRAME_END_LATCH_BYTES, 0x00);
+		_ledRGBCount = _ledCount * sizeof(ColorRgb);
 	}
 
-	for (const ColorRgb& color : ledValues)
-	{
-		uint32_t colorBits = ((unsigned int)color.red << 16)
-			| ((unsigned int)color.green << 8)
-			| color.blue;
+	const unsigned frameSize = static_cast<unsigned>(ledValues.size() * SPI_BYTES_PER_LED + SPI_FRAME_END_LATCH_BYTES);
+
+	// encoded once, straight into the buffer of the SPI transfer
+	return writeEncoded(frameSize, [&](uint8_t* spi_ptr) {
+		const uint8_t* colour = reinterpret_cast<const uint8_t*>(ledValues.data());
+		const uint8_t* colourEnd = colour + ledValues.size() * sizeof(ColorRgb);
 
-		for (int j = SPI_BYTES_PER_LED - 1; j >= 0; j--)
+		for (; colour < colourEnd; colour++, spi_ptr += SPI_BYTES_PER_COLOUR)
 		{
-			_ledBuffer[spi_ptr + j] = bitpair_to_byte[colorBits & 0x3];
-			colorBits >>= 2;
+			memcpy(spi_ptr, byte_to_spi[*colour], SPI_BYTES_PER_COLOUR);
 		}
-		spi_ptr += SPI_BYTES_PER_LED;
-	}
-
-	for (int j = 0; j < SPI_FRAME_END_LATCH_BYTES; j++)
-	{
-		_ledBuffer[spi_ptr++] = 0;
-	}
 
-	return writeBytes(_ledBuffer.size(), _ledBuffer.data());
+		memset(spi_ptr, 0, SPI_FRAME_END_LATCH_BYTES);
+	});
 }
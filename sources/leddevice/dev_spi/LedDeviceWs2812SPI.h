@@ -47,6 +47,7 @@ private:
 	const int SPI_FRAME_END_LATCH_BYTES;
 
 	uint8_t bitpair_to_byte[4];
+	uint8_t byte_to_spi[256][4];
 };
 
 #endif // LEDEVICEWS2812_H
@@ -13,8 +13,281 @@
 // Local HyperHDR includes
 #include "ProviderSpi.h"
 #include <utils/Logger.h>
+#include <utils/PerformanceCounters.h>
+#include <utils/PreciseTimer.h>
 
 #include <QDirIterator>
+#include <QFile>
+#include <QThread>
+#include <QMutex>
+#include <QWaitCondition>
+
+namespace
+{
+	enum SpiProtocol { SPI_GENERIC = 0, SPI_ESP8266, SPI_ESP32 };
+
+	/// the limit of one SPI_IOC_MESSAGE call of spidev, /sys/module/spidev/parameters/bufsiz
+	const unsigned DEFAULT_SPIDEV_BUFSIZ = 4096;
+
+	/// transfers per SPI_IOC_MESSAGE call, the array lives on the stack
+	const unsigned MAX_TRANSFERS = 64;
+
+	const unsigned ESP8266_MESSAGE = 34;
+	const unsigned ESP8266_PAYLOAD = 32;
+	const unsigned ESP32_MESSAGE = 1536 + 8;
+	const unsigned ESP32_PAYLOAD = 1536;
+
+	unsigned readSpidevBufsiz()
+	{
+		QFile file("/sys/module/spidev/parameters/bufsiz");
+		if (file.open(QIODevice::ReadOnly))
+		{
+			bool ok = false;
+			const unsigned value = QString(file.readAll()).trimmed().toUInt(&ok);
+			if (ok && value > 0)
+				return value;
+		}
+		return DEFAULT_SPIDEV_BUFSIZ;
+	}
+}
+
+///
+/// Sends the frames of one SPI device: the device thread only hands over the newest frame
+///
+class SpiTransferThread : public QThread
+{
+public:
+	struct Stats
+	{
+		qint64 frames = 0;
+		qint64 replaced = 0;
+		qint64 durationSum = 0;
+		qint64 durationMax = 0;
+	};
+
+	SpiTransferThread(Logger* log, int fid, bool invert, std::shared_ptr<WriteCadence> writeCadence) :
+		_log(log),
+		_writeCadence(writeCadence),
+		_fid(fid),
+		_invert(invert),
+		_bufsiz(readSpidevBufsiz()),
+		_pendingProtocol(SPI_GENERIC),
+		_hasPending(false),
+		_busy(false),
+		_quit(false),
+		_warnedSize(false)
+	{
+	}
+
+	~SpiTransferThread()
+	{
+		flush();
+		{
+			QMutexLocker locker(&_mutex);
+			_quit = true;
+			_condition.wakeAll();
+		}
+		wait();
+	}
+
+	void queue(int protocol, unsigned size, const uint8_t* data)
+	{
+		QMutexLocker locker(&_mutex);
+
+		if (_hasPending)
+			_stats.replaced++;
+
+		_pending.resize(size);
+		if (_invert && protocol == SPI_GENERIC)
+		{
+			for (unsigned i = 0; i < size; i++)
+				_pending[i] = data[i] ^ 0xff;
+		}
+		else if (size > 0)
+			memcpy(_pending.data(), data, size);
+
+		_pendingProtocol = protocol;
+		_hasPending = true;
+		_condition.wakeAll();
+	}
+
+	/// the encoder writes the frame straight into the buffer that is sent, no intermediate copy
+	void queueEncoded(int protocol, unsigned size, const std::function<void(uint8_t*)>& encoder)
+	{
+		QMutexLocker locker(&_mutex);
+
+		if (_hasPending)
+			_stats.replaced++;
+
+		_pending.resize(size);
+		if (size > 0)
+			encoder(_pending.data());
+
+		if (_invert && protocol == SPI_GENERIC)
+		{
+			for (unsigned i = 0; i < size; i++)
+				_pending[i] ^= 0xff;
+		}
+
+		_pendingProtocol = protocol;
+		_hasPending = true;
+		_condition.wakeAll();
+	}
+
+	/// waits until the queued frame is sent, ex. the black frame before closing the device
+	void flush()
+	{
+		QMutexLocker locker(&_mutex);
+
+		while ((_hasPending || _busy) && isRunning())
+			_done.wait(&_mutex);
+	}
+
+	Stats takeStats()
+	{
+		QMutexLocker locker(&_mutex);
+
+		Stats stats = _stats;
+		_stats = Stats();
+		return stats;
+	}
+
+private:
+	void run() override
+	{
+		QMutexLocker locker(&_mutex);
+
+		while (!_quit)
+		{
+			if (!_hasPending)
+			{
+				_condition.wait(&_mutex);
+				continue;
+			}
+
+			// the buffers are swapped, the device thread can queue the next frame meanwhile
+			std::swap(_active, _pending);
+			const int protocol = _pendingProtocol;
+			_hasPending = false;
+			_busy = true;
+
+			locker.unlock();
+			const qint64 begin = PreciseTimer::now();
+			transfer(protocol);
+			const qint64 end = PreciseTimer::now();
+			const qint64 duration = end - begin;
+			if (_writeCadence != nullptr)
+				_writeCadence->writeFinished(end);
+			locker.relock();
+
+			_busy = false;
+			_stats.frames++;
+			_stats.durationSum += duration;
+			_stats.durationMax = qMax(_stats.durationMax, duration);
+			_done.wakeAll();
+		}
+
+		_done.wakeAll();
+	}
+
+	void transfer(int protocol)
+	{
+		if (protocol == SPI_ESP8266)
+		{
+			// every message: 2, 0, 32 bytes of the colors
+			encodeMessages(ESP8266_MESSAGE, ESP8266_PAYLOAD, 2, 0);
+			sendMessages(_messages.data(), static_cast<unsigned>(_messages.size()), ESP8266_MESSAGE);
+		}
+		else if (protocol == SPI_ESP32)
+		{
+			// every message: 1536 bytes of the colors, 0xAA, padding
+			encodeMessages(ESP32_MESSAGE, ESP32_PAYLOAD, 0, 0xAA);
+			sendMessages(_messages.data(), static_cast<unsigned>(_messages.size()), ESP32_MESSAGE);
+		}
+		else
+		{
+			if (_active.size() > _bufsiz && !_warnedSize)
+			{
+				_warnedSize = true;
+				Warning(_log, "The frame (%d bytes) exceeds the spidev buffer (%d bytes) and is split into several transfers. Increase spidev.bufsiz if the LEDs flicker.", static_cast<int>(_active.size()), static_cast<int>(_bufsiz));
+			}
+			sendMessages(_active.data(), static_cast<unsigned>(_active.size()), _bufsiz);
+		}
+	}
+
+	void encodeMessages(unsigned messageSize, unsigned payloadSize, uint8_t header, uint8_t trailer)
+	{
+		const unsigned size = static_cast<unsigned>(_active.size());
+		const unsigned count = (size + payloadSize - 1) / payloadSize;
+		const unsigned offset = (header != 0) ? 2 : 0;
+
+		_messages.assign(static_cast<size_t>(count) * messageSize, 0);
+
+		for (unsigned i = 0; i < count; i++)
+		{
+			uint8_t* message = &_messages[static_cast<size_t>(i) * messageSize];
+
+			if (header != 0)
+				message[0] = header;
+			memcpy(message + offset, _active.data() + i * payloadSize, qMin(size - i * payloadSize, payloadSize));
+			if (trailer != 0)
+				message[payloadSize] = trailer;
+		}
+	}
+
+	/// as many messages in one ioctl as the spidev buffer allows, the chip select is released between them like for separate calls
+	void sendMessages(const uint8_t* data, unsigned size, unsigned messageSize)
+	{
+		const unsigned perCall = qBound(1u, _bufsiz / qMax(messageSize, 1u), MAX_TRANSFERS);
+		spi_ioc_transfer transfers[MAX_TRANSFERS];
+
+		for (unsigned position = 0; position < size; )
+		{
+			unsigned count = 0;
+
+			memset(transfers, 0, sizeof(transfers[0]) * perCall);
+
+			for (; count < perCall && position < size; count++)
+			{
+				const unsigned length = qMin(size - position, messageSize);
+
+				transfers[count].tx_buf = __u64(data + position);
+				transfers[count].len = __u32(length);
+				transfers[count].cs_change = 1;
+				position += length;
+			}
+
+			// for the last transfer cs_change would keep the chip selected after the call
+			transfers[count - 1].cs_change = 0;
+
+			int retVal = ioctl(_fid, _IOC(_IOC_WRITE, SPI_IOC_MAGIC, 0, SPI_MSGSIZE(count)), transfers);
+			if (retVal < 0)
+			{
+				ErrorThrottled(_log, "SPI failed to write. errno: %d, %s", errno, strerror(errno));
+				return;
+			}
+		}
+	}
+
+	Logger*			_log;
+	std::shared_ptr<WriteCadence> _writeCadence;
+	int				_fid;
+	bool			_invert;
+	unsigned		_bufsiz;
+
+	QMutex			_mutex;
+	QWaitCondition	_condition;
+	QWaitCondition	_done;
+	std::vector<uint8_t>	_pending;
+	std::vector<uint8_t>	_active;
+	std::vector<uint8_t>	_messages;
+	int				_pendingProtocol;
+	bool			_hasPending;
+	bool			_busy;
+	bool			_quit;
+	bool			_warnedSize;
+	Stats			_stats;
+};
 
 ProviderSpi::ProviderSpi(const QJsonObject& deviceConfig)
 	: LedDevice(deviceConfig)
@@ -24,12 +297,16 @@ ProviderSpi::ProviderSpi(const QJsonObject& deviceConfig)
 	, _spiMode(SPI_MODE_0)
 	, _spiDataInvert(false)
 	, _spiType("")
+	, _transferThread(nullptr)
+	, _transferStatsToken(0)
 {
-	memset(&_spi, 0, sizeof(_spi));
+	// the transfer thread reports the end of every frame
+	setAsyncWrites(true);
 }
 
 ProviderSpi::~ProviderSpi()
 {
+	delete _transferThread;
 }
 
 bool ProviderSpi::init(const QJsonObject& deviceConfig)
@@ -92,6 +369,10 @@ int ProviderSpi::open()
 				else
 				{
 					// Everything OK -> enable device
+					delete _transferThread;
+					_transferThread = new SpiTransferThread(_log, _fid, _spiDataInvert, getWriteCadence());
+					_transferThread->start(QThread::HighPriority);
+
 					_isDeviceReady = true;
 					retval = 0;
 				}
@@ -117,6 +398,10 @@ int ProviderSpi::close()
 	int retval = 0;
 	_isDeviceReady = false;
 
+	// the last queued frame (ex. black) is sent before
+	delete _transferThread;
+	_transferThread = nullptr;
+
 	// Test, if device requires closing
 	if (_fid > -1)
 	{
@@ -132,100 +417,59 @@ int ProviderSpi::close()
 
 int ProviderSpi::writeBytes(unsigned size, const uint8_t* data)
 {
-	uint8_t* newdata = nullptr;
+	return queueTransfer(SPI_GENERIC, size, data);
+}
 
-	if (_fid < 0)
+int ProviderSpi::writeEncoded(unsigned size, const std::function<void(uint8_t*)>& encoder)
+{
+	if (_fid < 0 || _transferThread == nullptr)
 	{
 		return -1;
 	}
 
-	_spi.tx_buf = __u64(data);
-	_spi.len = __u32(size);
-
-	if (_spiDataInvert)
-	{
-		newdata = (uint8_t*)malloc(size);
-		for (unsigned i = 0; i < size; i++) {
-			newdata[i] = data[i] ^ 0xff;
-		}
-		_spi.tx_buf = __u64(newdata);
-	}
-
-	int retVal = ioctl(_fid, SPI_IOC_MESSAGE(1), &_spi);
-	ErrorIf((retVal < 0), _log, "SPI failed to write. errno: %d, %s", errno, strerror(errno));
+	_transferThread->queueEncoded(SPI_GENERIC, size, encoder);
+	reportTransferStats();
 
-	if (newdata != nullptr)
-		free(newdata);
-
-	return retVal;
+	return 0;
 }
 
 int ProviderSpi::writeBytesEsp8266(unsigned size, const uint8_t* data)
 {
-	uint8_t* startData = (uint8_t*)data;
-	uint8_t* endData = (uint8_t*)data + size;
-	uint8_t buffer[34];
-
-	if (_fid < 0)
-	{
-		return -1;
-	}
-
-	_spi.tx_buf = __u64(&buffer);
-	_spi.len = __u32(34);
-	_spi.delay_usecs = 0;
-
-	int retVal = 0;
-
-	while (retVal >= 0 && startData < endData)
-	{
-		memset(buffer, 0, sizeof(buffer));
-		buffer[0] = 2;
-		buffer[1] = 0;
-		for (int i = 0; i < 32 && startData < endData; i++, startData++)
-		{
-			buffer[2 + i] = *startData;
-		}
-		retVal = ioctl(_fid, SPI_IOC_MESSAGE(1), &_spi);
-		ErrorIf((retVal < 0), _log, "SPI failed to write. errno: %d, %s", errno, strerror(errno));
-	}
-
-	return retVal;
+	return queueTransfer(SPI_ESP8266, size, data);
 }
 
 int ProviderSpi::writeBytesEsp32(unsigned size, const uint8_t* data)
 {
-	static const int      REAL_BUFFER = 1536;
-	static const uint32_t BUFFER_SIZE = REAL_BUFFER + 8;
-
-	uint8_t* startData = (uint8_t*)data;
-	uint8_t* endData = (uint8_t*)data + size;
-	uint8_t buffer[BUFFER_SIZE];
+	return queueTransfer(SPI_ESP32, size, data);
+}
 
-	if (_fid < 0)
+int ProviderSpi::queueTransfer(int protocol, unsigned size, const uint8_t* data)
+{
+	if (_fid < 0 || _transferThread == nullptr)
 	{
 		return -1;
 	}
 
-	_spi.tx_buf = __u64(&buffer);
-	_spi.len = __u32(BUFFER_SIZE);
-	_spi.delay_usecs = 0;
+	_transferThread->queue(protocol, size, data);
+	reportTransferStats();
 
-	int retVal = 0;
+	return 0;
+}
 
-	while (retVal >= 0 && startData < endData)
+void ProviderSpi::reportTransferStats()
+{
+	// once per performance counters period: the time on the bus
+	int64_t token = PerformanceCounters::currentToken();
+	if (token != _transferStatsToken)
 	{
-		memset(buffer, 0, sizeof(buffer));
-		for (int i = 0; i < REAL_BUFFER && startData < endData; i++, startData++)
-		{
-			buffer[i] = *startData;
-		}
-		buffer[REAL_BUFFER] = 0xAA;
-		retVal = ioctl(_fid, SPI_IOC_MESSAGE(1), &_spi);
-		ErrorIf((retVal < 0), _log, "SPI failed to write. errno: %d, %s", errno, strerror(errno));
-	}
+		SpiTransferThread::Stats stats = _transferThread->takeStats();
+
+		if (_transferStatsToken > 0 && stats.frames > 0)
+			Info(_log, "SPI transfer: %lld frames, %.2f ms average, %.2f ms max, %lld replaced by a newer frame before sending",
+				static_cast<long long>(stats.frames), stats.durationSum / 1000000.0 / stats.frames, stats.durationMax / 1000000.0, static_cast<long long>(stats.replaced));
 
-	return retVal;
+		_transferStatsToken = token;
+	}
 }
 
 QJsonObject ProviderSpi::discover(const QJsonObject& /*params*/)
@@ -6,6 +6,10 @@
 // HyperHDR includes
 #include <leddevice/LedDevice.h>
 
+#include <functional>
+
+class SpiTransferThread;
+
 ///
 /// The ProviderSpi implements an abstract base-class for LedDevices using the SPI-device.
 ///
@@ -47,8 +51,8 @@ public slots:
 
 protected:
 	///
-	/// Writes the given bytes/bits to the SPI-device and sleeps the latch time to ensure that the
-	/// values are latched.
+	/// Queues the given bytes/bits for the SPI-device. The transfer thread sends them, so the next frame
+	/// is encoded while this one is on the bus. A frame that is still waiting is replaced by the newer one.
 	///
 	/// @param[in[ size The length of the data
 	/// @param[in] data The data
@@ -57,6 +61,16 @@ protected:
 	///
 	int writeBytes(unsigned size, const uint8_t* data);
 
+	///
+	/// @brief Writes a frame of the given size that the encoder builds directly in the transfer buffer
+	///
+	/// @param[in] size The size of the frame
+	/// @param[in] encoder Fills the buffer, called from the device thread
+	///
+	/// @return Zero on success, else negative
+	///
+	int writeEncoded(unsigned size, const std::function<void(uint8_t*)>& encoder);
+
 	// esp spi is pripriotary protocol
 	int writeBytesEsp8266(unsigned size, const uint8_t* data);
 
@@ -80,6 +94,11 @@ protected:
 
 	QString _spiType;
 
-	/// The transfer structure for writing to the spi-device
-	spi_ioc_transfer _spi;
+private:
+	int queueTransfer(int protocol, unsigned size, const uint8_t* data);
+	void reportTransferStats();
+
+	/// sends the queued frames while the device is open
+	SpiTransferThread* _transferThread;
+	int64_t _transferStatsToken;
 };
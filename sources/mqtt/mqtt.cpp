@@ -2,10 +2,7 @@
 #include <mqtt/mqtt.h>
 
 #include <base/HyperHdrInstance.h>
-#include <QNetworkAccessManager>
-#include <QNetworkRequest>
-#include <QNetworkReply>
-#include <QUrl>
+#include <api/JsonAPI.h>
 #include <QHostInfo>
 
 QString HYPERHDRAPI = QStringLiteral("HyperHDR/JsonAPI");
@@ -13,10 +10,14 @@ QString HYPERHDRAPI_RESPONSE = QStringLiteral("HyperHDR/JsonAPI/response");
 
 mqtt::mqtt(QObject* _parent)
 	: QObject(_parent)
-	, _jsonPort(8090)
 	, _log(Logger::getInstance("MQTT"))
 	, _clientInstance(nullptr)
+	, _jsonAPI(nullptr)
 {
+	// a local client like the JSON-RPC requests from localhost did, without the push events
+	_jsonAPI = new JsonAPI("MQTT", _log, true, this, true);
+	connect(_jsonAPI, &JsonAPI::callbackMessage, this, &mqtt::publishReply);
+	_jsonAPI->initialize();
 }
 
 mqtt::~mqtt()
@@ -152,43 +153,28 @@ void mqtt::handleSettingsUpdate(settings::type type, const QJsonDocument& config
 		if (enabled)
 			start(host, port, username, password, is_ssl, ignore_ssl_errors);
 	}
-	else if (type == settings::type::WEBSERVER)
-	{
-		QJsonObject obj = config.object();
-		_jsonPort = obj["port"].toInt();
-	}
 }
 
 void mqtt::received(const QMQTT::Message& message)
 {
 	QString topic = message.topic();
-	QString payload = QString().fromLocal8Bit(message.payload());
 
-	if (QString::compare(HYPERHDRAPI, topic) == 0 && payload.length() > 0)
+	if (QString::compare(HYPERHDRAPI, topic) == 0 && message.payload().length() > 0)
 	{
-		QString address = QString("http://localhost:%1/json-rpc").arg(_jsonPort);
-		QNetworkAccessManager* manager = new QNetworkAccessManager(this);
-
-		QObject::connect(manager, &QNetworkAccessManager::finished, [manager, this](QNetworkReply* reply) {
-			if (_clientInstance != nullptr && reply != nullptr)
-			{
-				QByteArray bytes = reply->readAll();
-				QMQTT::Message report;
-
-				report.setTopic(HYPERHDRAPI_RESPONSE);
-				report.setQos(2);
-				if (reply->error() == QNetworkReply::NoError && bytes.length() > 0)
-					report.setPayload(bytes);
-				else
-					report.setPayload("{\n\t\"success\" : false\n}");
-
-				_clientInstance->publish(report);
-			}
-
-			reply->deleteLater();
-			manager->deleteLater();
-		});
-
-		manager->post(QNetworkRequest(QUrl(address)), message.payload());
+		_jsonAPI->handleMessage(QString::fromUtf8(message.payload()));
+	}
+}
+
+void mqtt::publishReply(QJsonObject reply)
+{
+	if (_clientInstance != nullptr)
+	{
+		QMQTT::Message report;
+
+		report.setTopic(HYPERHDRAPI_RESPONSE);
+		report.setQos(2);
+		report.setPayload(QJsonDocument(reply).toJson(QJsonDocument::Compact));
+
+		_clientInstance->publish(report);
 	}
 }
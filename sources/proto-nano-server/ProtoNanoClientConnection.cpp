@@ -35,6 +35,13 @@
 #include <pb_encode.h>
 #include <ProtoNanoClientConnection.h>
 #include <flatbufserver/FlatBufferServer.h>
+#include <utils/ImageIngest.h>
+
+namespace
+{
+	/// 8K: larger sizes are rejected before anything is allocated
+	const qint64 MAX_IMAGE_PIXELS = 7680 * 4320;
+}
 
 ProtoNanoClientConnection::ProtoNanoClientConnection(QTcpSocket* socket, int timeout, QObject* parent)
 	: QObject(parent)
@@ -50,6 +57,9 @@ ProtoNanoClientConnection::ProtoNanoClientConnection(QTcpSocket* socket, int tim
 	_timeoutTimer->setInterval(_timeout);
 	connect(_timeoutTimer, &QTimer::timeout, this, &ProtoNanoClientConnection::forceClose);
 
+	// the decoded frame and its reduced copy for every consumer
+	_frameRing.init(FrameRingConsumerSlots + 2);
+
 	// connect socket signals
 	connect(_socket, &QTcpSocket::readyRead, this, &ProtoNanoClientConnection::readyRead);
 	connect(_socket, &QTcpSocket::disconnected, this, &ProtoNanoClientConnection::disconnected);
@@ -59,41 +69,52 @@ void ProtoNanoClientConnection::readyRead()
 {
 	_receiveBuffer += _socket->readAll();
 
+	// the messages are decoded in place, the buffer is shortened once
+	int offset = 0;
+
 	// check if we can read a message size
-	if (_receiveBuffer.size() <= 4)
+	while (_receiveBuffer.size() - offset > 4)
 	{
-		return;
-	}
+		const uint8_t* header = reinterpret_cast<const uint8_t*>(_receiveBuffer.constData() + offset);
 
-	// read the message size
-	uint32_t messageSize =
-		((_receiveBuffer[0] << 24) & 0xFF000000) |
-		((_receiveBuffer[1] << 16) & 0x00FF0000) |
-		((_receiveBuffer[2] << 8) & 0x0000FF00) |
-		((_receiveBuffer[3]) & 0x000000FF);
+		// read the message size
+		uint32_t messageSize =
+			((header[0] << 24) & 0xFF000000) |
+			((header[1] << 16) & 0x00FF0000) |
+			((header[2] << 8) & 0x0000FF00) |
+			((header[3]) & 0x000000FF);
 
-	// check if we can read a complete message
-	if ((uint32_t)_receiveBuffer.size() < messageSize + 4)
-	{
-		return;
-	}
+		// check if we can read a complete message
+		if ((uint32_t)(_receiveBuffer.size() - offset) < messageSize + 4)
+		{
+			break;
+		}
 
-	processData((const uint8_t*)(_receiveBuffer.data() + 4), messageSize);
+		processData(header + 4, messageSize);
 
-	_receiveBuffer = _receiveBuffer.mid(messageSize + 4);
+		offset += messageSize + 4;
+	}
+
+	if (offset > 0)
+		_receiveBuffer.remove(0, offset);
 }
 
 bool ProtoNanoClientConnection::readImage(pb_istream_t* stream, const pb_field_t* field, void** arg)
 {
-	int sizeRgb = (int)((stream->bytes_left) / 3);
-	Image<ColorRgb>* image = (Image<ColorRgb>*) * arg;
+	ImageTarget* target = (ImageTarget*) * arg;
+	const qint64 width = target->request->imagewidth;
+	const qint64 height = target->request->imageheight;
 
-	image->resize(sizeRgb, 1);
-
-	if (!pb_read(stream, image->rawMem(), sizeRgb * 3))
+	// validate the size before anything is allocated
+	if (width <= 0 || height <= 0 || width * height > MAX_IMAGE_PIXELS || static_cast<qint64>(stream->bytes_left) != width * height * 3)
+	{
+		target->sizeMismatch = true;
 		return false;
+	}
+
+	target->image = target->ring->acquire(static_cast<unsigned>(width), static_cast<unsigned>(height));
 
-	return true;
+	return pb_read(stream, target->image.rawMem(), stream->bytes_left);
 }
 
 void ProtoNanoClientConnection::processData(const uint8_t* buffer, uint32_t messageSize)
@@ -106,10 +127,10 @@ void ProtoNanoClientConnection::processData(const uint8_t* buffer, uint32_t mess
 	proto_ImageRequest imageReq = proto_ImageRequest_init_zero;
 	proto_ClearRequest clearReq = proto_ClearRequest_init_zero;
 
-	Image<ColorRgb> image;
+	ImageTarget target{ &_frameRing, &imageReq, Image<ColorRgb>(), false };
 
 	imageReq.imagedata.funcs.decode = &ProtoNanoClientConnection::readImage;
-	imageReq.imagedata.arg = &image;
+	imageReq.imagedata.arg = &target;
 
 	mainMessage.extensions = &imageExt;
 	imageExt.type = &proto_ImageRequest_imageRequest;
@@ -128,7 +149,7 @@ void ProtoNanoClientConnection::processData(const uint8_t* buffer, uint32_t mess
 		if (imageExt.found)
 		{
 			status = true;
-			handleImageCommand(imageReq, image);
+			handleImageCommand(imageReq, target.image);
 		}
 
 		if (clearExt.found)
@@ -140,6 +161,11 @@ void ProtoNanoClientConnection::processData(const uint8_t* buffer, uint32_t mess
 		if (!status)
 			Warning(_log, "Unsupported request");
 	}
+	else if (target.sizeMismatch)
+	{
+		sendErrorReply("Size of image data does not match with the width and height");
+		Error(_log, "Size of image data does not match with the width and height");
+	}
 	else
 		Error(_log, "Error while decoding the message");
 }
@@ -180,17 +206,6 @@ void ProtoNanoClientConnection::handleImageCommand(const proto_ImageRequest& mes
 		_priority = priority;
 	}
 
-	// check consistency of the size of the received data
-	if ((int)image.size() != width * height * 3)
-	{
-		sendErrorReply("Size of image data does not match with the width and height");
-		Error(_log, "Size of image data does not match with the width and height");
-		return;
-	}
-
-	// must resize
-	image.resize(width, height);
-
 	auto flat = FlatBufferServer::getInstance();
 	if (flat != nullptr)
 	{
@@ -198,12 +213,22 @@ void ProtoNanoClientConnection::handleImageCommand(const proto_ImageRequest& mes
 
 		if (hdrEnabled)
 		{
+			// reduced together with the tone mapping
 			AUTO_CALL_3(flat, importFromProtoHandler, int, priority, int, duration, const Image<ColorRgb>&, image);
 			sendSuccessReply();
 			return;
 		}
 	}
 
+	// reduced to the size of the led mappings
+	const int factor = ImageIngest::getFactor(width, height);
+	if (factor > 1)
+	{
+		Image<ColorRgb> reduced = _frameRing.acquire(width / factor, height / factor);
+		ImageIngest::reduce(image.rawMem(), width, height, factor, nullptr, 0, nullptr, reduced);
+		image = reduced;
+	}
+
 	emit setGlobalInputImage(_priority, image, duration);
 
 	// send reply
@@ -7,6 +7,7 @@
 
 // qt
 #include <QJsonObject>
+#include <QJsonArray>
 #include <QTcpServer>
 #include <QTcpSocket>
 
@@ -50,6 +51,12 @@ void ProtoServer::handleSettingsUpdate(settings::type type, const QJsonDocument&
 			_port = port;
 		}
 
+		// the instances that receive the images, all of them when the list is empty
+		QList<int> instances;
+		for (const QJsonValue& instance : obj["instances"].toArray())
+			instances.append(instance.toInt());
+		GlobalSignals::getInstance()->setGlobalInputTargets(hyperhdr::COMP_PROTOSERVER, instances);
+
 		// new timeout just for new connections
 		_timeout = obj["timeout"].toInt(5000);
 		// enable check
@@ -69,10 +76,15 @@ void ProtoServer::newConnection()
 				ProtoNanoClientConnection* client = new ProtoNanoClientConnection(socket, _timeout, this);
 				// internal
 				connect(client, &ProtoNanoClientConnection::clientDisconnected, this, &ProtoServer::clientDisconnected);
-				connect(client, &ProtoNanoClientConnection::registerGlobalInput, GlobalSignals::getInstance(), &GlobalSignals::registerGlobalInput);
-				connect(client, &ProtoNanoClientConnection::clearGlobalInput, GlobalSignals::getInstance(), &GlobalSignals::clearGlobalInput);
-				connect(client, &ProtoNanoClientConnection::setGlobalInputImage, GlobalSignals::getInstance(), &GlobalSignals::setGlobalImage);
-				connect(client, &ProtoNanoClientConnection::setGlobalInputColor, GlobalSignals::getInstance(), &GlobalSignals::setGlobalColor);
+				// delivered only to the target instances, in the thread of the client
+				connect(client, &ProtoNanoClientConnection::registerGlobalInput, client, [](int priority, hyperhdr::Components component, const QString& origin, const QString& owner, unsigned smooth_cfg) {
+					GlobalSignals::getInstance()->routeRegisterInput(priority, component, origin, owner, smooth_cfg); });
+				connect(client, &ProtoNanoClientConnection::clearGlobalInput, client, [](int priority, bool forceClearAll) {
+					GlobalSignals::getInstance()->routeClearInput(hyperhdr::COMP_PROTOSERVER, priority, forceClearAll); });
+				connect(client, &ProtoNanoClientConnection::setGlobalInputImage, client, [](int priority, const Image<ColorRgb>& image, int timeout_ms, bool clearEffect) {
+					GlobalSignals::getInstance()->routeImage(hyperhdr::COMP_PROTOSERVER, priority, image, timeout_ms, clearEffect); });
+				connect(client, &ProtoNanoClientConnection::setGlobalInputColor, client, [](int priority, const std::vector<ColorRgb>& ledColor, int timeout_ms, const QString& origin, bool clearEffects) {
+					GlobalSignals::getInstance()->routeColor(hyperhdr::COMP_PROTOSERVER, priority, ledColor, timeout_ms, origin, clearEffects); });
 				connect(GlobalSignals::getInstance(), &GlobalSignals::globalRegRequired, client, &ProtoNanoClientConnection::registationRequired);
 				_openConnections.append(client);
 			}
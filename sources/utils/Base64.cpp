@@ -0,0 +1,110 @@
+/* Base64.cpp
+*
+*  MIT License
+*
+*  Copyright (c) 2023 awawa-dev
+*
+*  Project homesite: https://github.com/awawa-dev/HyperHDR
+*
+*  Permission is hereby granted, free of charge, to any person obtaining a copy
+*  of this software and associated documentation files (the "Software"), to deal
+*  in the Software without restriction, including without limitation the rights
+*  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+*  copies of the Software, and to permit persons to whom the Software is
+*  furnished to do so, subject to the following conditions:
+*
+*  The above copyright notice and this permission notice shall be included in all
+*  copies or substantial portions of the Software.
+
+*  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+*  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+*  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+*  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+*  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+*  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+*  SOFTWARE.
+*/
+
+#include <utils/Base64.h>
+
+namespace
+{
+	struct DecodeTable
+	{
+		int8_t value[128];
+
+		DecodeTable()
+		{
+			const char* alphabet = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+
+			for (int i = 0; i < 128; i++)
+				value[i] = -1;
+			for (int i = 0; i < 64; i++)
+				value[static_cast<uint8_t>(alphabet[i])] = static_cast<int8_t>(i);
+		}
+	};
+
+	const DecodeTable table;
+
+	/// the 6 bits of a character, negative for anything else than the alphabet
+	inline int32_t sextet(ushort c)
+	{
+		return (c < 128) ? table.value[c] : -1;
+	}
+}
+
+namespace Base64
+{
+	int decodedSize(const QString& encoded)
+	{
+		const int length = encoded.size();
+
+		if (length % 4 != 0)
+			return -1;
+		if (length == 0)
+			return 0;
+
+		const int padding = (encoded[length - 1] == '=') ? ((encoded[length - 2] == '=') ? 2 : 1) : 0;
+
+		return length / 4 * 3 - padding;
+	}
+
+	bool decode(const QString& encoded, uint8_t* target)
+	{
+		const int size = decodedSize(encoded);
+		if (size <= 0)
+			return size == 0;
+
+		const ushort* source = encoded.utf16();
+		const int quads = encoded.size() / 4 - 1;
+
+		// every quad except the last one: 24 bits, one check of the sign catches any invalid character
+		for (int i = 0; i < quads; i++, source += 4, target += 3)
+		{
+			const int32_t a = sextet(source[0]), b = sextet(source[1]), c = sextet(source[2]), d = sextet(source[3]);
+			if ((a | b | c | d) < 0)
+				return false;
+
+			const uint32_t bits = (static_cast<uint32_t>(a) << 18) | (static_cast<uint32_t>(b) << 12) | (static_cast<uint32_t>(c) << 6) | static_cast<uint32_t>(d);
+			target[0] = static_cast<uint8_t>(bits >> 16);
+			target[1] = static_cast<uint8_t>(bits >> 8);
+			target[2] = static_cast<uint8_t>(bits);
+		}
+
+		// the last quad with the padding
+		const int tail = size - quads * 3;
+		const int32_t a = sextet(source[0]), b = sextet(source[1]);
+		const int32_t c = (tail > 1) ? sextet(source[2]) : 0, d = (tail > 2) ? sextet(source[3]) : 0;
+		if ((a | b | c | d) < 0)
+			return false;
+
+		const uint32_t bits = (static_cast<uint32_t>(a) << 18) | (static_cast<uint32_t>(b) << 12) | (static_cast<uint32_t>(c) << 6) | static_cast<uint32_t>(d);
+		target[0] = static_cast<uint8_t>(bits >> 16);
+		if (tail > 1)
+			target[1] = static_cast<uint8_t>(bits >> 8);
+		if (tail > 2)
+			target[2] = static_cast<uint8_t>(bits);
+
+		return true;
+	}
+}
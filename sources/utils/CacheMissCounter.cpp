@@ -0,0 +1,101 @@
+/* CacheMissCounter.cpp
+*
+*  MIT License
+*
+*  Copyright (c) 2023 awawa-dev
+*
+*  Project homesite: https://github.com/awawa-dev/HyperHDR
+*
+*  Permission is hereby granted, free of charge, to any person obtaining a copy
+*  of this software and associated documentation files (the "Software"), to deal
+*  in the Software without restriction, including without limitation the rights
+*  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+*  copies of the Software, and to permit persons to whom the Software is
+*  furnished to do so, subject to the following conditions:
+*
+*  The above copyright notice and this permission notice shall be included in all
+*  copies or substantial portions of the Software.
+
+*  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+*  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+*  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+*  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+*  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+*  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+*  SOFTWARE.
+*/
+#include <utils/CacheMissCounter.h>
+
+#if defined(__linux__)
+	#include <cstring>
+	#include <unistd.h>
+	#include <sys/ioctl.h>
+	#include <sys/syscall.h>
+	#include <linux/perf_event.h>
+#endif
+
+std::atomic<bool>		CacheMissCounter::_available(true);
+std::atomic<uint64_t>	CacheMissCounter::_misses(0);
+std::atomic<uint64_t>	CacheMissCounter::_samples(0);
+
+CacheMissCounter::CacheMissCounter() :
+	_fd(-1)
+{
+#if defined(__linux__)
+	if (!_available)
+		return;
+
+	struct perf_event_attr attr;
+	memset(&attr, 0, sizeof(attr));
+	attr.size = sizeof(attr);
+	attr.type = PERF_TYPE_HARDWARE;
+	attr.config = PERF_COUNT_HW_CACHE_MISSES;
+	attr.disabled = 1;
+	attr.exclude_kernel = 1;
+	attr.exclude_hv = 1;
+
+	// the workers run on short-lived threads: the counter is opened for the current scope only
+	_fd = static_cast<int>(syscall(__NR_perf_event_open, &attr, 0, -1, -1, 0));
+
+	if (_fd < 0)
+	{
+		_available = false;
+		return;
+	}
+
+	ioctl(_fd, PERF_EVENT_IOC_RESET, 0);
+	ioctl(_fd, PERF_EVENT_IOC_ENABLE, 0);
+#endif
+}
+
+CacheMissCounter::~CacheMissCounter()
+{
+#if defined(__linux__)
+	if (_fd < 0)
+		return;
+
+	uint64_t count = 0;
+
+	ioctl(_fd, PERF_EVENT_IOC_DISABLE, 0);
+
+	if (read(_fd, &count, sizeof(count)) == sizeof(count))
+	{
+		_misses += count;
+		_samples++;
+	}
+
+	close(_fd);
+#endif
+}
+
+bool CacheMissCounter::takeAverage(uint64_t& average)
+{
+	uint64_t samples = _samples.exchange(0);
+	uint64_t misses = _misses.exchange(0);
+
+	if (samples == 0)
+		return false;
+
+	average = misses / samples;
+	return true;
+}
@@ -0,0 +1,203 @@
+/* CaptureRecorder.cpp
+*
+*  MIT License
+*
+*  Copyright (c) 2023 awawa-dev
+*
+*  Project homesite: https://github.com/awawa-dev/HyperHDR
+*
+*  Permission is hereby granted, free of charge, to any person obtaining a copy
+*  of this software and associated documentation files (the "Software"), to deal
+*  in the Software without restriction, including without limitation the rights
+*  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+*  copies of the Software, and to permit persons to whom the Software is
+*  furnished to do so, subject to the following conditions:
+*
+*  The above copyright notice and this permission notice shall be included in all
+*  copies or substantial portions of the Software.
+
+*  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+*  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+*  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+*  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+*  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+*  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+*  SOFTWARE.
+*/
+
+
+#include <utils/CaptureRecorder.h>
+#include <utils/CaptureRecording.h>
+#include <utils/PreciseTimer.h>
+
+#include <QDateTime>
+
+#include <cstring>
+
+namespace
+{
+	// the frames waiting for a slow disk, the next ones are dropped above it
+	constexpr size_t MAX_PENDING_FRAMES = 8;
+}
+
+CaptureRecorder::CaptureRecorder(Logger* log)
+	: _log(log)
+	, _active(false)
+	, _maxFrames(0)
+	, _frames(0)
+	, _dropped(0)
+	, _bytes(0)
+	, _firstFrameTime(-1)
+	, _finishing(false)
+	, _failed(false)
+{
+}
+
+CaptureRecorder::~CaptureRecorder()
+{
+	stop();
+}
+
+QString CaptureRecorder::start(const QString& fileName, int maxFrames)
+{
+	stop();
+
+	QMutexLocker locker(&_mutex);
+
+	_file.setFileName(fileName);
+	if (!_file.open(QIODevice::WriteOnly | QIODevice::Truncate))
+	{
+		return QString("Could not create the recording: %1").arg(_file.errorString());
+	}
+
+	CaptureRecording::Header header = CaptureRecording::makeHeader(QDateTime::currentMSecsSinceEpoch());
+	if (_file.write(reinterpret_cast<const char*>(&header), sizeof(header)) != sizeof(header))
+	{
+		_file.close();
+		return QString("Could not write the recording: %1").arg(_file.errorString());
+	}
+
+	_maxFrames = qMax(maxFrames, 1);
+	_frames = 0;
+	_dropped = 0;
+	_bytes = sizeof(header);
+	_firstFrameTime = -1;
+	_finishing = false;
+	_failed = false;
+	_pending.clear();
+
+	Info(_log, "Recording up to %d raw frames to: %s", _maxFrames, QSTRING_CSTR(fileName));
+
+	_active = true;
+	QThread::start();
+
+	return QString();
+}
+
+void CaptureRecorder::stop()
+{
+	{
+		QMutexLocker locker(&_mutex);
+
+		_active = false;
+		_finishing = true;
+		_condition.wakeAll();
+	}
+
+	wait();
+}
+
+void CaptureRecorder::record(PixelFormat pixelFormat, int width, int height, int lineLength, const uint8_t* data, int size)
+{
+	if (!isActive() || data == nullptr || size <= 0 || static_cast<uint32_t>(size) > CaptureRecording::MAX_FRAME_SIZE)
+		return;
+
+	const int64_t now = PreciseTimer::now();
+
+	QMutexLocker locker(&_mutex);
+
+	if (!isActive())
+		return;
+
+	if (_pending.size() >= MAX_PENDING_FRAMES)
+	{
+		_dropped++;
+		return;
+	}
+
+	if (_firstFrameTime < 0)
+		_firstFrameTime = now;
+
+	CaptureRecording::Record record;
+	record.time = now - _firstFrameTime;
+	record.pixelFormat = static_cast<uint32_t>(pixelFormat);
+	record.width = width;
+	record.height = height;
+	record.lineLength = lineLength;
+	record.size = size;
+	record.reserved = 0;
+
+	QByteArray block;
+	block.resize(static_cast<int>(sizeof(record) + CaptureRecording::paddedSize(record.size)));
+	memcpy(block.data(), &record, sizeof(record));
+	memcpy(block.data() + sizeof(record), data, size);
+	memset(block.data() + sizeof(record) + size, 0, block.size() - sizeof(record) - size);
+
+	_pending.push_back(std::move(block));
+	_condition.wakeAll();
+
+	// the last frame: the thread closes the recording when it is written
+	if (++_frames >= _maxFrames)
+		_active = false;
+}
+
+void CaptureRecorder::run()
+{
+	std::vector<QByteArray> active;
+
+	QMutexLocker locker(&_mutex);
+
+	while (true)
+	{
+		if (_pending.empty())
+		{
+			// stopped, the last frame was queued or the write failed
+			if (_finishing || !isActive())
+				break;
+
+			_condition.wait(&_mutex);
+			continue;
+		}
+
+		// the capture thread can queue the next frames meanwhile
+		std::swap(active, _pending);
+
+		locker.unlock();
+		qint64 bytes = 0;
+		bool failed = false;
+		for (const QByteArray& block : active)
+		{
+			if (_file.write(block) != block.size())
+				failed = true;
+			bytes += block.size();
+		}
+		_file.flush();
+		locker.relock();
+
+		_bytes += bytes;
+		_failed |= failed;
+		active.clear();
+
+		if (failed)
+			_active = false;
+	}
+
+	if (_failed)
+		Error(_log, "Failed to write the recording: %s", QSTRING_CSTR(_file.fileName()));
+
+	Info(_log, "Recording finished: %lld frames (%lld MB), dropped as the disk did not keep up: %lld",
+		static_cast<long long>(_frames), static_cast<long long>(_bytes / (1024 * 1024)), static_cast<long long>(_dropped));
+
+	_file.close();
+	_pending.clear();
+}
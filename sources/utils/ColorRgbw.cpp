@@ -1,3 +1,6 @@
+// STL includes
+#include <algorithm>
+
 // Local includes
 #include <utils/ColorRgbw.h>
 
@@ -87,4 +90,95 @@ namespace RGBW {
 		}
 	}
 
+	namespace {
+
+		///
+		/// The white calibration of the adjusted algorithms as tables: the truncation is monotonic,
+		/// so the white is the minimum of the truncated products of the channels and the result is exact
+		///
+		struct WhiteCalibration
+		{
+			uint8_t white[3][256];
+			uint8_t subtract[3][256];
+
+			WhiteCalibration(double f1, double f2, double f3)
+			{
+				const double factor[3] = { f1, f2, f3 };
+
+				for (int c = 0; c < 3; c++)
+					for (int v = 0; v < 256; v++)
+					{
+						white[c][v] = static_cast<uint8_t>(qMin(v * factor[c], 255.0));
+						subtract[c][v] = static_cast<uint8_t>(qMin(v / factor[c], 255.0));
+					}
+			}
+		};
+
+		const WhiteCalibration& warmCalibration()
+		{
+			static const WhiteCalibration calibration(0.274, 0.454, 2.333);
+			return calibration;
+		}
+
+		const WhiteCalibration& coolCalibration()
+		{
+			static const WhiteCalibration calibration(0.299, 0.587, 0.114);
+			return calibration;
+		}
+
+		void applyCalibration(const WhiteCalibration& calibration, const ColorRgb* source, ColorRgbw* target, size_t count)
+		{
+			for (size_t i = 0; i < count; i++)
+			{
+				const uint8_t white = std::min(std::min(calibration.white[0][source[i].red], calibration.white[1][source[i].green]), calibration.white[2][source[i].blue]);
+				target[i].red = source[i].red - calibration.subtract[0][white];
+				target[i].green = source[i].green - calibration.subtract[1][white];
+				target[i].blue = source[i].blue - calibration.subtract[2][white];
+				target[i].white = white;
+			}
+		}
+	}
+
+	void Rgb_to_Rgbw(const std::vector<ColorRgb>& input, std::vector<ColorRgbw>& output, WhiteAlgorithm algorithm)
+	{
+		output.resize(input.size());
+
+		const ColorRgb* source = input.data();
+		ColorRgbw* target = output.data();
+		const size_t count = input.size();
+
+		// no floating point per led: the adjusted algorithms use the precomputed tables with the same rounding as the single color version
+		switch (algorithm)
+		{
+		case WhiteAlgorithm::SUBTRACT_MINIMUM:
+			for (size_t i = 0; i < count; i++)
+			{
+				const uint8_t white = std::min(std::min(source[i].red, source[i].green), source[i].blue);
+				target[i].red = source[i].red - white;
+				target[i].green = source[i].green - white;
+				target[i].blue = source[i].blue - white;
+				target[i].white = white;
+			}
+			break;
+
+		case WhiteAlgorithm::SUB_MIN_WARM_ADJUST:
+			applyCalibration(warmCalibration(), source, target, count);
+			break;
+
+		case WhiteAlgorithm::SUB_MIN_COOL_ADJUST:
+			applyCalibration(coolCalibration(), source, target, count);
+			break;
+
+		default:
+			// WHITE_OFF, the invalid one is rejected by the devices earlier
+			for (size_t i = 0; i < count; i++)
+			{
+				target[i].red = source[i].red;
+				target[i].green = source[i].green;
+				target[i].blue = source[i].blue;
+				target[i].white = 0;
+			}
+		}
+	}
+
 };
@@ -0,0 +1,129 @@
+/* CompactLut.cpp
+*
+*  MIT License
+*
+*  Copyright (c) 2023 awawa-dev
+*
+*  Project homesite: https://github.com/awawa-dev/HyperHDR
+*
+*  Permission is hereby granted, free of charge, to any person obtaining a copy
+*  of this software and associated documentation files (the "Software"), to deal
+*  in the Software without restriction, including without limitation the rights
+*  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+*  copies of the Software, and to permit persons to whom the Software is
+*  furnished to do so, subject to the following conditions:
+*
+*  The above copyright notice and this permission notice shall be included in all
+*  copies or substantial portions of the Software.
+
+*  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+*  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+*  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+*  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+*  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+*  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+*  SOFTWARE.
+*/
+
+#include <cstring>
+#include <utils/CompactLut.h>
+#include <utils/FrameDecoder.h>
+
+CompactLut::CompactLut() :
+	_gridSize(0),
+	_strideX(0),
+	_strideY(0),
+	_strideZ(0)
+{
+	memset(_offsetX, 0, sizeof(_offsetX));
+	memset(_offsetY, 0, sizeof(_offsetY));
+	memset(_offsetZ, 0, sizeof(_offsetZ));
+	memset(_frac, 0, sizeof(_frac));
+}
+
+bool CompactLut::isSupportedGrid(int gridSize)
+{
+	return gridSize >= MIN_GRID && gridSize <= MAX_GRID;
+}
+
+bool CompactLut::build(const uint8_t* lutBuffer, int gridSize)
+{
+	if (lutBuffer == nullptr)
+	{
+		clear();
+		return false;
+	}
+
+	return build([lutBuffer](uint8_t x, uint8_t y, uint8_t z, uint8_t* rgb) { memcpy(rgb, &lutBuffer[LUT_INDEX(x, y, z)], 3); }, gridSize);
+}
+
+bool CompactLut::build(const std::function<void(uint8_t x, uint8_t y, uint8_t z, uint8_t* rgb)>& sample, int gridSize)
+{
+	clear();
+
+	if (!isSupportedGrid(gridSize))
+		return false;
+
+	const int last = gridSize - 1;
+
+	_gridSize = gridSize;
+	_strideX = 3;
+	_strideY = _strideX * gridSize;
+	_strideZ = _strideY * gridSize;
+	_table.resize(static_cast<size_t>(_strideZ) * gridSize);
+
+	// sample the full table in the grid nodes
+	for (int k = 0; k < gridSize; k++)
+		for (int j = 0; j < gridSize; j++)
+			for (int i = 0; i < gridSize; i++)
+			{
+				uint32_t x = (i * 255 + last / 2) / last;
+				uint32_t y = (j * 255 + last / 2) / last;
+				uint32_t z = (k * 255 + last / 2) / last;
+
+				sample(x, y, z, &_table[i * _strideX + j * _strideY + k * _strideZ]);
+			}
+
+	// split every input value into the lower node and 8-bit fraction to the next one
+	for (int v = 0; v < 256; v++)
+	{
+		uint32_t position = (static_cast<uint32_t>(v) * last * 256 + 127) / 255;
+		uint32_t node = position >> 8;
+		uint32_t frac = position & 0xFF;
+
+		if (node >= static_cast<uint32_t>(last))
+		{
+			node = last - 1;
+			frac = 256;
+		}
+
+		_offsetX[v] = node * _strideX;
+		_offsetY[v] = node * _strideY;
+		_offsetZ[v] = node * _strideZ;
+		_frac[v] = static_cast<uint16_t>(frac);
+	}
+
+	return true;
+}
+
+void CompactLut::clear()
+{
+	_table.clear();
+	_table.shrink_to_fit();
+	_gridSize = 0;
+}
+
+bool CompactLut::isValid() const
+{
+	return _gridSize > 0;
+}
+
+int CompactLut::gridSize() const
+{
+	return _gridSize;
+}
+
+size_t CompactLut::memorySize() const
+{
+	return _table.size();
+}
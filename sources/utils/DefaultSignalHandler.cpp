@@ -100,6 +100,9 @@ namespace DefaultSignalHandler
 		}
 
 		free(symbols);
+
+		// the trace must be printed before the process is killed
+		Logger::flush();
 	}
 
 	void install_default_handler(int signum)
@@ -0,0 +1,180 @@
+/* EventTracer.cpp
+*
+*  MIT License
+*
+*  Copyright (c) 2023 awawa-dev
+*
+*  Project homesite: https://github.com/awawa-dev/HyperHDR
+*
+*  Permission is hereby granted, free of charge, to any person obtaining a copy
+*  of this software and associated documentation files (the "Software"), to deal
+*  in the Software without restriction, including without limitation the rights
+*  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+*  copies of the Software, and to permit persons to whom the Software is
+*  furnished to do so, subject to the following conditions:
+*
+*  The above copyright notice and this permission notice shall be included in all
+*  copies or substantial portions of the Software.
+
+*  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+*  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+*  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+*  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+*  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+*  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+*  SOFTWARE.
+*/
+
+
+#include <utils/EventTracer.h>
+#include <utils/FrameTrace.h>
+
+#include <QJsonArray>
+#include <QMap>
+#include <QMutex>
+#include <QMutexLocker>
+#include <QThread>
+
+#include <algorithm>
+#include <memory>
+
+namespace
+{
+	struct Slot
+	{
+		/// index of the event + 1 once it's written, so a reader skips the slot being overwritten
+		std::atomic<uint64_t>	sequence;
+		const char*				name;
+		int64_t					timestamp;
+		int64_t					argument;
+		uint32_t				thread;
+		char					phase;
+	};
+
+	std::unique_ptr<Slot[]>	_ring;
+	uint64_t				_capacity = 0;
+	std::atomic<uint64_t>	_next(0);
+	uint64_t				_first = 0;
+
+	std::atomic<uint32_t>	_threadCounter(0);
+	QMutex					_threadsLock;
+	QMap<uint32_t, QString>	_threads;
+
+	uint32_t currentThread()
+	{
+		thread_local uint32_t thread = 0;
+
+		if (thread == 0)
+		{
+			thread = ++_threadCounter;
+
+			QString name = (QThread::currentThread() != nullptr) ? QThread::currentThread()->objectName() : QString();
+			if (name.isEmpty())
+				name = QString("Thread %1").arg(thread);
+
+			QMutexLocker locker(&_threadsLock);
+			_threads[thread] = name;
+		}
+
+		return thread;
+	}
+}
+
+std::atomic<bool> EventTracer::_enabled(false);
+
+int EventTracer::start(int capacity)
+{
+	_enabled = false;
+
+	// the writers may still hold the ring that was seen before the flag was cleared: it's never released
+	if (_ring == nullptr)
+	{
+		_capacity = static_cast<uint64_t>(std::max(capacity, 1024));
+		_ring.reset(new Slot[_capacity]);
+		for (uint64_t i = 0; i < _capacity; i++)
+			_ring[i].sequence.store(0, std::memory_order_relaxed);
+	}
+
+	_first = _next.load();
+	_enabled = true;
+
+	return static_cast<int>(_capacity);
+}
+
+void EventTracer::stop()
+{
+	_enabled = false;
+}
+
+void EventTracer::record(char phase, const char* name, int64_t argument)
+{
+	if (_ring == nullptr)
+		return;
+
+	const uint64_t index = _next.fetch_add(1, std::memory_order_relaxed);
+	Slot& slot = _ring[index % _capacity];
+
+	slot.sequence.store(0, std::memory_order_relaxed);
+	slot.name = name;
+	slot.timestamp = FrameTrace::now();
+	slot.argument = argument;
+	slot.thread = currentThread();
+	slot.phase = phase;
+	slot.sequence.store(index + 1, std::memory_order_release);
+}
+
+QJsonObject EventTracer::toChromeTrace()
+{
+	QJsonArray events;
+
+	if (_ring != nullptr)
+	{
+		const uint64_t last = _next.load();
+		const uint64_t first = std::max(_first, (last > _capacity) ? last - _capacity : 0);
+
+		for (uint64_t index = first; index < last; index++)
+		{
+			const Slot& slot = _ring[index % _capacity];
+
+			if (slot.sequence.load(std::memory_order_acquire) != index + 1)
+				continue;
+
+			QJsonObject event;
+			event["name"] = slot.name;
+			event["ph"] = QString(QChar(slot.phase));
+			event["ts"] = static_cast<qint64>(slot.timestamp);
+			event["pid"] = 1;
+			event["tid"] = static_cast<int>(slot.thread);
+			if (slot.phase == 'i')
+				event["s"] = "t";
+			if (slot.argument >= 0)
+				event["args"] = QJsonObject{ {"value", static_cast<qint64>(slot.argument)} };
+			events.append(event);
+		}
+	}
+
+	QMutexLocker locker(&_threadsLock);
+	for (auto thread = _threads.constBegin(); thread != _threads.constEnd(); ++thread)
+	{
+		QJsonObject event;
+		event["name"] = "thread_name";
+		event["ph"] = "M";
+		event["pid"] = 1;
+		event["tid"] = static_cast<int>(thread.key());
+		event["args"] = QJsonObject{ {"name", thread.value()} };
+		events.append(event);
+	}
+
+	QJsonObject trace;
+	trace["traceEvents"] = events;
+	trace["displayTimeUnit"] = "ms";
+	return trace;
+}
+
+QString EventTracer::getStats()
+{
+	const uint64_t recorded = _next.load() - _first;
+
+	return QString("Event trace: %1, recorded events: %2, kept: %3").arg((isEnabled()) ? "running" : "stopped").
+		arg(recorded).arg(std::min(recorded, _capacity));
+}
@@ -28,6 +28,10 @@
 #include <utils/FrameDecoder.h>
 #include <utils/ColorSys.h>
 #include <utils/Logger.h>
+#include <cstring>
+#include <cmath>
+#include <vector>
+#include <algorithm>
 
 //#define TAKE_SCREEN_SHOT
 
@@ -36,248 +40,1231 @@
 	int screenShotTaken = 300;
 #endif
 
-void FrameDecoder::processImage(
-	int _cropLeft, int _cropRight, int _cropTop, int _cropBottom,
-	const uint8_t* data, int width, int height, int lineLength,
-	const PixelFormat pixelFormat, const uint8_t* lutBuffer, Image<ColorRgb>& outputImage)
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+	#define FRAMEDECODER_X86
+	#include <immintrin.h>
+	#if defined(_MSC_VER)
+		#include <intrin.h>
+		#define FRAMEDECODER_TARGET(x)
+	#else
+		#define FRAMEDECODER_TARGET(x) __attribute__((target(x)))
+	#endif
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__) || defined(__aarch64__)
+	#define FRAMEDECODER_NEON
+	#include <arm_neon.h>
+#endif
+
+namespace
 {
-	uint32_t ind_lutd, ind_lutd2;
-	uint8_t  buffer[8];
+	// Row kernels return the number of processed pixels (always even). The caller finishes the row using the scalar loop.
+	// Kernels never write past the end of the row so they can be safely used on the partial (cropped) lines.
+	typedef int (*YuyvRowKernel)(uint8_t* dest, int pixels, const uint8_t* source, const uint8_t* lut);
+	typedef int (*Nv12RowKernel)(uint8_t* dest, int pixels, const uint8_t* sourceY, const uint8_t* sourceUV, const uint8_t* lut);
+	typedef int (*PlanarRowKernel)(uint8_t* dest, int pixels, const uint8_t* sourceY, const uint8_t* sourceU, const uint8_t* sourceV, const uint8_t* lut);
+	// BGR24 / BGRX to RGB byte shuffles for the RGB sources without LUT
+	typedef int (*RgbRowKernel)(uint8_t* dest, int pixels, const uint8_t* source);
+	// adds the bytes of a row to 16-bit sums for the box filter, returns the number of processed bytes
+	typedef int (*AccumulateRowKernel)(uint16_t* sums, int bytes, const uint8_t* source);
+
+	struct YuvRowKernels
+	{
+		const char*     name;
+		YuyvRowKernel   yuyv;
+		Nv12RowKernel   nv12;
+		PlanarRowKernel planar;
+		RgbRowKernel    bgr24;
+		RgbRowKernel    bgrx;
+		AccumulateRowKernel accumulate;
+	};
+
+#ifdef FRAMEDECODER_X86
+
+#ifdef USE_BLOCKED_LUT
+	// vectorized LUT_BLOCKED
+	FRAMEDECODER_TARGET("avx2") inline __m256i blockedIndexAVX2(__m256i i)
+	{
+		__m256i result = _mm256_and_si256(i, _mm256_set1_epi32(0xF0000F));
+		result = _mm256_or_si256(result, _mm256_srli_epi32(_mm256_and_si256(i, _mm256_set1_epi32(0xF00)), 4));
+		result = _mm256_or_si256(result, _mm256_srli_epi32(_mm256_and_si256(i, _mm256_set1_epi32(0xF0000)), 8));
+		result = _mm256_or_si256(result, _mm256_slli_epi32(_mm256_and_si256(i, _mm256_set1_epi32(0xF0)), 8));
+		return _mm256_or_si256(result, _mm256_slli_epi32(_mm256_and_si256(i, _mm256_set1_epi32(0xF000)), 4));
+	}
 
-	// validate format
-	if (pixelFormat != PixelFormat::YUYV &&
-		pixelFormat != PixelFormat::XRGB && pixelFormat != PixelFormat::RGB24 &&
-		pixelFormat != PixelFormat::I420 && pixelFormat != PixelFormat::NV12 && pixelFormat != PixelFormat::MJPEG)
+	FRAMEDECODER_TARGET("sse4.1") inline __m128i blockedIndexSSE41(__m128i i)
 	{
-		Error(Logger::getInstance("FrameDecoder"), "Invalid pixel format given");
-		return;
+		__m128i result = _mm_and_si128(i, _mm_set1_epi32(0xF0000F));
+		result = _mm_or_si128(result, _mm_srli_epi32(_mm_and_si128(i, _mm_set1_epi32(0xF00)), 4));
+		result = _mm_or_si128(result, _mm_srli_epi32(_mm_and_si128(i, _mm_set1_epi32(0xF0000)), 8));
+		result = _mm_or_si128(result, _mm_slli_epi32(_mm_and_si128(i, _mm_set1_epi32(0xF0)), 8));
+		return _mm_or_si128(result, _mm_slli_epi32(_mm_and_si128(i, _mm_set1_epi32(0xF000)), 4));
 	}
+#endif
 
-	// validate format LUT
-	if ((pixelFormat == PixelFormat::YUYV || pixelFormat == PixelFormat::I420 || pixelFormat == PixelFormat::MJPEG ||
-		pixelFormat == PixelFormat::NV12) && lutBuffer == NULL)
+	FRAMEDECODER_TARGET("avx2") inline void lookupAndStoreAVX2(uint8_t* dest, __m256i base, __m256i y0, __m256i y1, const uint8_t* lut)
 	{
-		Error(Logger::getInstance("FrameDecoder"), "Missing LUT table for YUV colorspace");
-		return;
+		const __m256i pack = _mm256_setr_epi8(0, 1, 2, 4, 5, 6, 8, 9, 10, 12, 13, 14, -1, -1, -1, -1,
+											  0, 1, 2, 4, 5, 6, 8, 9, 10, 12, 13, 14, -1, -1, -1, -1);
+
+		__m256i index0 = _mm256_or_si256(base, y0);
+		__m256i index1 = _mm256_or_si256(base, y1);
+
+	#ifdef USE_BLOCKED_LUT
+		index0 = blockedIndexAVX2(index0);
+		index1 = blockedIndexAVX2(index1);
+	#endif
+
+		// LUT_INDEX multiplies by 3
+		index0 = _mm256_add_epi32(index0, _mm256_add_epi32(index0, index0));
+		index1 = _mm256_add_epi32(index1, _mm256_add_epi32(index1, index1));
+
+		__m256i rgb0 = _mm256_i32gather_epi32(reinterpret_cast<const int*>(lut), index0, 1);
+		__m256i rgb1 = _mm256_i32gather_epi32(reinterpret_cast<const int*>(lut), index1, 1);
+
+		// restore the order of the pixels: Y0 Y1 of each sample pair
+		__m256i low = _mm256_unpacklo_epi32(rgb0, rgb1);
+		__m256i high = _mm256_unpackhi_epi32(rgb0, rgb1);
+		__m256i first = _mm256_shuffle_epi8(_mm256_permute2x128_si256(low, high, 0x20), pack);
+		__m256i second = _mm256_shuffle_epi8(_mm256_permute2x128_si256(low, high, 0x31), pack);
+
+		// each store carries 12 valid bytes, the garbage tail is overwritten by the next one
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(dest), _mm256_castsi256_si128(first));
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(dest + 12), _mm256_extracti128_si256(first, 1));
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(dest + 24), _mm256_castsi256_si128(second));
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(dest + 36), _mm256_extracti128_si256(second, 1));
 	}
 
-	// sanity check, odd values doesnt work for yuv either way
-	_cropLeft = (_cropLeft >> 1) << 1;
-	_cropRight = (_cropRight >> 1) << 1;
+	FRAMEDECODER_TARGET("avx2") int yuyvRowAVX2(uint8_t* dest, int pixels, const uint8_t* source, const uint8_t* lut)
+	{
+		const __m256i maskY = _mm256_set1_epi32(0xFF);
+		const __m256i maskU = _mm256_set1_epi32(0xFF00);
+		int done = 0;
 
-	// calculate the output size
-	int outputWidth = (width - _cropLeft - _cropRight);
-	int outputHeight = (height - _cropTop - _cropBottom);
+		for (; done + 18 <= pixels; done += 16, dest += 48, source += 32)
+		{
+			__m256i yuyv = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(source));
+			__m256i y0 = _mm256_and_si256(yuyv, maskY);
+			__m256i y1 = _mm256_and_si256(_mm256_srli_epi32(yuyv, 16), maskY);
+			__m256i base = _mm256_or_si256(_mm256_and_si256(yuyv, maskU), _mm256_slli_epi32(_mm256_srli_epi32(yuyv, 24), 16));
 
-	outputImage.resize(outputWidth, outputHeight);
+			lookupAndStoreAVX2(dest, base, y0, y1, lut);
+		}
 
-	uint8_t* destMemory = outputImage.rawMem();
-	int 		destLineSize = outputImage.width() * 3;
+		return done;
+	}
 
+	FRAMEDECODER_TARGET("avx2") int nv12RowAVX2(uint8_t* dest, int pixels, const uint8_t* sourceY, const uint8_t* sourceUV, const uint8_t* lut)
+	{
+		const __m256i maskY = _mm256_set1_epi32(0xFF);
+		int done = 0;
 
-	if (pixelFormat == PixelFormat::YUYV)
+		for (; done + 18 <= pixels; done += 16, dest += 48, sourceY += 16, sourceUV += 16)
+		{
+			__m256i y = _mm256_cvtepu16_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i*>(sourceY)));
+			__m256i uv = _mm256_cvtepu16_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i*>(sourceUV)));
+
+			lookupAndStoreAVX2(dest, _mm256_slli_epi32(uv, 8), _mm256_and_si256(y, maskY), _mm256_srli_epi32(y, 8), lut);
+		}
+
+		return done;
+	}
+
+	FRAMEDECODER_TARGET("avx2") int planarRowAVX2(uint8_t* dest, int pixels, const uint8_t* sourceY, const uint8_t* sourceU, const uint8_t* sourceV, const uint8_t* lut)
 	{
-		for (int yDest = 0, ySource = _cropTop; yDest < outputHeight; ++ySource, ++yDest)
+		const __m256i maskY = _mm256_set1_epi32(0xFF);
+		int done = 0;
+
+		for (; done + 18 <= pixels; done += 16, dest += 48, sourceY += 16, sourceU += 8, sourceV += 8)
 		{
-			uint8_t* currentDest = destMemory + ((uint64_t)destLineSize) * yDest;
-			uint8_t* endDest = currentDest + destLineSize;
-			uint8_t* currentSource = (uint8_t*)data + (((uint64_t)lineLength * ySource) + (((uint64_t)_cropLeft) << 1));
+			__m256i y = _mm256_cvtepu16_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i*>(sourceY)));
+			__m256i u = _mm256_cvtepu8_epi32(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(sourceU)));
+			__m256i v = _mm256_cvtepu8_epi32(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(sourceV)));
+			__m256i base = _mm256_or_si256(_mm256_slli_epi32(u, 8), _mm256_slli_epi32(v, 16));
+
+			lookupAndStoreAVX2(dest, base, _mm256_and_si256(y, maskY), _mm256_srli_epi32(y, 8), lut);
+		}
+
+		return done;
+	}
+
+	FRAMEDECODER_TARGET("sse4.1") inline void lookupAndStoreSSE41(uint8_t* dest, __m128i base, __m128i y0, __m128i y1, const uint8_t* lut)
+	{
+		const __m128i pack = _mm_setr_epi8(0, 1, 2, 4, 5, 6, 8, 9, 10, 12, 13, 14, -1, -1, -1, -1);
+
+		__m128i index0 = _mm_or_si128(base, y0);
+		__m128i index1 = _mm_or_si128(base, y1);
+
+	#ifdef USE_BLOCKED_LUT
+		index0 = blockedIndexSSE41(index0);
+		index1 = blockedIndexSSE41(index1);
+	#endif
+
+		index0 = _mm_add_epi32(index0, _mm_add_epi32(index0, index0));
+		index1 = _mm_add_epi32(index1, _mm_add_epi32(index1, index1));
+
+		// no gather on SSE: fetch the LUT entries one by one but keep the index math and the stores vectorized
+		alignas(16) uint32_t i0[4], i1[4];
+		_mm_store_si128(reinterpret_cast<__m128i*>(i0), index0);
+		_mm_store_si128(reinterpret_cast<__m128i*>(i1), index1);
+
+		__m128i first = _mm_setr_epi32(*((const int*)&lut[i0[0]]), *((const int*)&lut[i1[0]]), *((const int*)&lut[i0[1]]), *((const int*)&lut[i1[1]]));
+		__m128i second = _mm_setr_epi32(*((const int*)&lut[i0[2]]), *((const int*)&lut[i1[2]]), *((const int*)&lut[i0[3]]), *((const int*)&lut[i1[3]]));
+
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(dest), _mm_shuffle_epi8(first, pack));
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(dest + 12), _mm_shuffle_epi8(second, pack));
+	}
+
+	FRAMEDECODER_TARGET("sse4.1") int yuyvRowSSE41(uint8_t* dest, int pixels, const uint8_t* source, const uint8_t* lut)
+	{
+		const __m128i maskY = _mm_set1_epi32(0xFF);
+		const __m128i maskU = _mm_set1_epi32(0xFF00);
+		int done = 0;
+
+		for (; done + 10 <= pixels; done += 8, dest += 24, source += 16)
+		{
+			__m128i yuyv = _mm_loadu_si128(reinterpret_cast<const __m128i*>(source));
+			__m128i y0 = _mm_and_si128(yuyv, maskY);
+			__m128i y1 = _mm_and_si128(_mm_srli_epi32(yuyv, 16), maskY);
+			__m128i base = _mm_or_si128(_mm_and_si128(yuyv, maskU), _mm_slli_epi32(_mm_srli_epi32(yuyv, 24), 16));
+
+			lookupAndStoreSSE41(dest, base, y0, y1, lut);
+		}
+
+		return done;
+	}
+
+	FRAMEDECODER_TARGET("sse4.1") int nv12RowSSE41(uint8_t* dest, int pixels, const uint8_t* sourceY, const uint8_t* sourceUV, const uint8_t* lut)
+	{
+		const __m128i maskY = _mm_set1_epi32(0xFF);
+		int done = 0;
+
+		for (; done + 10 <= pixels; done += 8, dest += 24, sourceY += 8, sourceUV += 8)
+		{
+			__m128i y = _mm_cvtepu16_epi32(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(sourceY)));
+			__m128i uv = _mm_cvtepu16_epi32(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(sourceUV)));
+
+			lookupAndStoreSSE41(dest, _mm_slli_epi32(uv, 8), _mm_and_si128(y, maskY), _mm_srli_epi32(y, 8), lut);
+		}
+
+		return done;
+	}
+
+	FRAMEDECODER_TARGET("sse4.1") int planarRowSSE41(uint8_t* dest, int pixels, const uint8_t* sourceY, const uint8_t* sourceU, const uint8_t* sourceV, const uint8_t* lut)
+	{
+		const __m128i maskY = _mm_set1_epi32(0xFF);
+		int done = 0;
+
+		for (; done + 10 <= pixels; done += 8, dest += 24, sourceY += 8, sourceU += 4, sourceV += 4)
+		{
+			int32_t u4, v4;
+			memcpy(&u4, sourceU, sizeof(u4));
+			memcpy(&v4, sourceV, sizeof(v4));
+
+			__m128i y = _mm_cvtepu16_epi32(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(sourceY)));
+			__m128i u = _mm_cvtepu8_epi32(_mm_cvtsi32_si128(u4));
+			__m128i v = _mm_cvtepu8_epi32(_mm_cvtsi32_si128(v4));
+			__m128i base = _mm_or_si128(_mm_slli_epi32(u, 8), _mm_slli_epi32(v, 16));
+
+			lookupAndStoreSSE41(dest, base, _mm_and_si128(y, maskY), _mm_srli_epi32(y, 8), lut);
+		}
+
+		return done;
+	}
+
+	// 16-byte stores carry 12 valid bytes so the row must have 2 more pixels, as for the YUV kernels
+	FRAMEDECODER_TARGET("sse4.1") int bgr24RowSSE41(uint8_t* dest, int pixels, const uint8_t* source)
+	{
+		const __m128i shuffle = _mm_setr_epi8(2, 1, 0, 5, 4, 3, 8, 7, 6, 11, 10, 9, -1, -1, -1, -1);
+		int done = 0;
+
+		for (; done + 10 <= pixels; done += 8, dest += 24, source += 24)
+		{
+			__m128i first = _mm_loadu_si128(reinterpret_cast<const __m128i*>(source));
+			__m128i second = _mm_loadu_si128(reinterpret_cast<const __m128i*>(source + 12));
+
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(dest), _mm_shuffle_epi8(first, shuffle));
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(dest + 12), _mm_shuffle_epi8(second, shuffle));
+		}
+
+		return done;
+	}
+
+	FRAMEDECODER_TARGET("sse4.1") int bgrxRowSSE41(uint8_t* dest, int pixels, const uint8_t* source)
+	{
+		const __m128i shuffle = _mm_setr_epi8(2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1);
+		int done = 0;
+
+		for (; done + 10 <= pixels; done += 8, dest += 24, source += 32)
+		{
+			__m128i first = _mm_loadu_si128(reinterpret_cast<const __m128i*>(source));
+			__m128i second = _mm_loadu_si128(reinterpret_cast<const __m128i*>(source + 16));
+
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(dest), _mm_shuffle_epi8(first, shuffle));
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(dest + 12), _mm_shuffle_epi8(second, shuffle));
+		}
+
+		return done;
+	}
+
+	FRAMEDECODER_TARGET("sse4.1") int accumulateRowSSE41(uint16_t* sums, int bytes, const uint8_t* source)
+	{
+		int done = 0;
+
+		for (; done + 16 <= bytes; done += 16, sums += 16, source += 16)
+		{
+			__m128i pixels = _mm_loadu_si128(reinterpret_cast<const __m128i*>(source));
+			__m128i low = _mm_loadu_si128(reinterpret_cast<const __m128i*>(sums));
+			__m128i high = _mm_loadu_si128(reinterpret_cast<const __m128i*>(sums + 8));
+
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(sums), _mm_add_epi16(low, _mm_cvtepu8_epi16(pixels)));
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(sums + 8), _mm_add_epi16(high, _mm_cvtepu8_epi16(_mm_srli_si128(pixels, 8))));
+		}
+
+		return done;
+	}
+
+	bool cpuSupports(bool avx2)
+	{
+	#if defined(_MSC_VER)
+		int info[4];
+		__cpuid(info, 1);
+		bool sse41 = (info[2] & (1 << 19)) != 0;
+		bool osAvx = (info[2] & (1 << 27)) && (info[2] & (1 << 28)) && ((_xgetbv(0) & 0x6) == 0x6);
+		if (!avx2)
+			return sse41;
+		__cpuidex(info, 7, 0);
+		return osAvx && (info[1] & (1 << 5)) != 0;
+	#else
+		__builtin_cpu_init();
+		return (avx2) ? __builtin_cpu_supports("avx2") : __builtin_cpu_supports("sse4.1");
+	#endif
+	}
+
+#endif // FRAMEDECODER_X86
+
+#ifdef FRAMEDECODER_NEON
+
+	// linear LUT entry index to the byte offset of LUT_INDEX
+	inline uint32x4_t lutOffsetNEON(uint32x4_t i)
+	{
+	#ifdef USE_BLOCKED_LUT
+		uint32x4_t result = vandq_u32(i, vdupq_n_u32(0xF0000F));
+		result = vorrq_u32(result, vshrq_n_u32(vandq_u32(i, vdupq_n_u32(0xF00)), 4));
+		result = vorrq_u32(result, vshrq_n_u32(vandq_u32(i, vdupq_n_u32(0xF0000)), 8));
+		result = vorrq_u32(result, vshlq_n_u32(vandq_u32(i, vdupq_n_u32(0xF0)), 8));
+		i = vorrq_u32(result, vshlq_n_u32(vandq_u32(i, vdupq_n_u32(0xF000)), 4));
+	#endif
+		return vmulq_n_u32(i, 3);
+	}
+
+	inline void lookupAndStoreNEON(uint8_t* dest, uint16x8_t u, uint16x8_t v, uint16x8_t y0, uint16x8_t y1, const uint8_t* lut)
+	{
+		uint32_t index0[8], index1[8];
+
+		uint32x4_t baseLow = vorrq_u32(vshlq_n_u32(vmovl_u16(vget_low_u16(u)), 8), vshlq_n_u32(vmovl_u16(vget_low_u16(v)), 16));
+		uint32x4_t baseHigh = vorrq_u32(vshlq_n_u32(vmovl_u16(vget_high_u16(u)), 8), vshlq_n_u32(vmovl_u16(vget_high_u16(v)), 16));
+
+		vst1q_u32(index0, lutOffsetNEON(vorrq_u32(baseLow, vmovl_u16(vget_low_u16(y0)))));
+		vst1q_u32(index0 + 4, lutOffsetNEON(vorrq_u32(baseHigh, vmovl_u16(vget_high_u16(y0)))));
+		vst1q_u32(index1, lutOffsetNEON(vorrq_u32(baseLow, vmovl_u16(vget_low_u16(y1)))));
+		vst1q_u32(index1 + 4, lutOffsetNEON(vorrq_u32(baseHigh, vmovl_u16(vget_high_u16(y1)))));
+
+		for (int i = 0; i < 8; i++, dest += 6)
+		{
+			*((uint32_t*)dest) = *((uint32_t*)(&lut[index0[i]]));
+			*((uint32_t*)(dest + 3)) = *((uint32_t*)(&lut[index1[i]]));
+		}
+	}
+
+	int yuyvRowNEON(uint8_t* dest, int pixels, const uint8_t* source, const uint8_t* lut)
+	{
+		int done = 0;
+
+		for (; done + 18 <= pixels; done += 16, dest += 48, source += 32)
+		{
+			uint8x8x4_t yuyv = vld4_u8(source);
+
+			lookupAndStoreNEON(dest, vmovl_u8(yuyv.val[1]), vmovl_u8(yuyv.val[3]), vmovl_u8(yuyv.val[0]), vmovl_u8(yuyv.val[2]), lut);
+		}
+
+		return done;
+	}
+
+	int nv12RowNEON(uint8_t* dest, int pixels, const uint8_t* sourceY, const uint8_t* sourceUV, const uint8_t* lut)
+	{
+		int done = 0;
+
+		for (; done + 18 <= pixels; done += 16, dest += 48, sourceY += 16, sourceUV += 16)
+		{
+			uint8x8x2_t y = vld2_u8(sourceY);
+			uint8x8x2_t uv = vld2_u8(sourceUV);
+
+			lookupAndStoreNEON(dest, vmovl_u8(uv.val[0]), vmovl_u8(uv.val[1]), vmovl_u8(y.val[0]), vmovl_u8(y.val[1]), lut);
+		}
+
+		return done;
+	}
+
+	int planarRowNEON(uint8_t* dest, int pixels, const uint8_t* sourceY, const uint8_t* sourceU, const uint8_t* sourceV, const uint8_t* lut)
+	{
+		int done = 0;
+
+		for (; done + 18 <= pixels; done += 16, dest += 48, sourceY += 16, sourceU += 8, sourceV += 8)
+		{
+			uint8x8x2_t y = vld2_u8(sourceY);
+
+			lookupAndStoreNEON(dest, vmovl_u8(vld1_u8(sourceU)), vmovl_u8(vld1_u8(sourceV)), vmovl_u8(y.val[0]), vmovl_u8(y.val[1]), lut);
+		}
+
+		return done;
+	}
+
+	int bgr24RowNEON(uint8_t* dest, int pixels, const uint8_t* source)
+	{
+		int done = 0;
+
+		for (; done + 16 <= pixels; done += 16, dest += 48, source += 48)
+		{
+			uint8x16x3_t bgr = vld3q_u8(source);
+			uint8x16x3_t rgb = { { bgr.val[2], bgr.val[1], bgr.val[0] } };
+
+			vst3q_u8(dest, rgb);
+		}
+
+		return done;
+	}
+
+	int bgrxRowNEON(uint8_t* dest, int pixels, const uint8_t* source)
+	{
+		int done = 0;
+
+		for (; done + 16 <= pixels; done += 16, dest += 48, source += 64)
+		{
+			uint8x16x4_t bgrx = vld4q_u8(source);
+			uint8x16x3_t rgb = { { bgrx.val[2], bgrx.val[1], bgrx.val[0] } };
+
+			vst3q_u8(dest, rgb);
+		}
+
+		return done;
+	}
+
+	int accumulateRowNEON(uint16_t* sums, int bytes, const uint8_t* source)
+	{
+		int done = 0;
+
+		for (; done + 16 <= bytes; done += 16, sums += 16, source += 16)
+		{
+			uint8x16_t pixels = vld1q_u8(source);
+
+			vst1q_u16(sums, vaddw_u8(vld1q_u16(sums), vget_low_u8(pixels)));
+			vst1q_u16(sums + 8, vaddw_u8(vld1q_u16(sums + 8), vget_high_u8(pixels)));
+		}
+
+		return done;
+	}
+
+#endif // FRAMEDECODER_NEON
+
+	YuvRowKernels selectYuvRowKernels()
+	{
+	#if defined(FRAMEDECODER_X86)
+		if (cpuSupports(true))
+			return YuvRowKernels{ "AVX2", yuyvRowAVX2, nv12RowAVX2, planarRowAVX2, bgr24RowSSE41, bgrxRowSSE41, accumulateRowSSE41 };
+		if (cpuSupports(false))
+			return YuvRowKernels{ "SSE4.1", yuyvRowSSE41, nv12RowSSE41, planarRowSSE41, bgr24RowSSE41, bgrxRowSSE41, accumulateRowSSE41 };
+	#elif defined(FRAMEDECODER_NEON)
+		return YuvRowKernels{ "NEON", yuyvRowNEON, nv12RowNEON, planarRowNEON, bgr24RowNEON, bgrxRowNEON, accumulateRowNEON };
+	#endif
+		return YuvRowKernels{ "scalar", nullptr, nullptr, nullptr, nullptr, nullptr, nullptr };
+	}
+
+	const YuvRowKernels& yuvRowKernels()
+	{
+		static const YuvRowKernels kernels = selectYuvRowKernels();
+		return kernels;
+	}
+
+	// P010/Y210 carry 10-bit samples MSB aligned in little-endian 16-bit words
+	inline uint8_t quantizeHighBitDepth(uint16_t sample)
+	{
+		uint32_t value = (static_cast<uint32_t>(sample) + 0x80) >> 8;
+		return static_cast<uint8_t>((value > 255) ? 255 : value);
+	}
+
+	// fused 10-bit lookup without an intermediate 8-bit frame: the luma is interpolated between two neighbouring LUT entries
+	// using its 2 extra bits, the chroma is rounded to the nearest LUT node. Writes exactly 3 bytes.
+	inline void lookupHighBitDepth(const uint8_t* lutBuffer, uint16_t y, uint16_t u, uint16_t v, uint8_t* currentDest)
+	{
+		const uint32_t y10 = y >> 6;
+		const uint32_t yLow = y10 >> 2;
+		const uint32_t weight = y10 & 3;
+		const uint8_t u8 = quantizeHighBitDepth(u);
+		const uint8_t v8 = quantizeHighBitDepth(v);
+		const uint8_t* low = &lutBuffer[LUT_INDEX(yLow, u8, v8)];
+
+		if (weight == 0 || yLow == 255)
+		{
+			memcpy(currentDest, low, 3);
+			return;
+		}
+
+		const uint8_t* high = &lutBuffer[LUT_INDEX(yLow + 1, u8, v8)];
+		for (int i = 0; i < 3; i++)
+			currentDest[i] = static_cast<uint8_t>((low[i] * (4 - weight) + high[i] * weight + 2) >> 2);
+	}
+
+	// decodes one source row using the compact (interpolated) LUT, step = 2 gives the quarter frame used by processQImage
+	void decodeCompactLine(const CompactLut& lut, const PixelFormat pixelFormat, const uint8_t* data, int height, int lineLength,
+		uint64_t ySource, int cropLeft, int step, int pixels, uint8_t* currentDest)
+	{
+		const uint8_t* line = data + lineLength * ySource;
+
+		switch (pixelFormat)
+		{
+			case PixelFormat::YUYV:
+				for (int x = 0, xSource = cropLeft; x < pixels; x++, xSource += step, currentDest += 3)
+				{
+					const uint8_t* pair = line + ((xSource >> 1) << 2);
+					lut.lookup(pair[(xSource & 1) << 1], pair[1], pair[3], currentDest);
+				}
+				break;
+
+			case PixelFormat::RGB24:
+			case PixelFormat::XRGB:
+			{
+				const int bpp = (pixelFormat == PixelFormat::RGB24) ? 3 : 4;
+				for (int x = 0, xSource = cropLeft; x < pixels; x++, xSource += step, currentDest += 3)
+				{
+					const uint8_t* pixel = line + xSource * bpp;
+					lut.lookup(pixel[2], pixel[1], pixel[0], currentDest);
+				}
+				break;
+			}
+
+			case PixelFormat::I420:
+			case PixelFormat::MJPEG:
+			{
+				const bool mjpeg = (pixelFormat == PixelFormat::MJPEG);
+				const uint64_t deltaU = static_cast<uint64_t>(lineLength) * height;
+				const uint64_t deltaV = (mjpeg) ? deltaU * 6 / 4 : deltaU * 5 / 4;
+				const uint64_t chromaLine = ((mjpeg) ? ySource : ySource / 2) * lineLength / 2;
+				const uint8_t* lineU = data + deltaU + chromaLine;
+				const uint8_t* lineV = data + deltaV + chromaLine;
+				for (int x = 0, xSource = cropLeft; x < pixels; x++, xSource += step, currentDest += 3)
+					lut.lookup(line[xSource], lineU[xSource >> 1], lineV[xSource >> 1], currentDest);
+				break;
+			}
+
+			case PixelFormat::NV12:
+			{
+				const uint8_t* lineUV = data + static_cast<uint64_t>(lineLength) * height + (ySource / 2) * lineLength;
+				for (int x = 0, xSource = cropLeft; x < pixels; x++, xSource += step, currentDest += 3)
+				{
+					const uint8_t* uv = lineUV + ((xSource >> 1) << 1);
+					lut.lookup(line[xSource], uv[0], uv[1], currentDest);
+				}
+				break;
+			}
+
+			case PixelFormat::P010:
+			{
+				const uint16_t* lineY = reinterpret_cast<const uint16_t*>(line);
+				const uint16_t* lineUV = reinterpret_cast<const uint16_t*>(data + static_cast<uint64_t>(lineLength) * height + (ySource / 2) * lineLength);
+				for (int x = 0, xSource = cropLeft; x < pixels; x++, xSource += step, currentDest += 3)
+				{
+					const uint16_t* uv = lineUV + ((xSource >> 1) << 1);
+					lut.lookup(quantizeHighBitDepth(lineY[xSource]), quantizeHighBitDepth(uv[0]), quantizeHighBitDepth(uv[1]), currentDest);
+				}
+				break;
+			}
+
+			case PixelFormat::Y210:
+			{
+				const uint16_t* lineYUV = reinterpret_cast<const uint16_t*>(line);
+				for (int x = 0, xSource = cropLeft; x < pixels; x++, xSource += step, currentDest += 3)
+				{
+					const uint16_t* pair = lineYUV + ((xSource >> 1) << 2);
+					lut.lookup(quantizeHighBitDepth(pair[(xSource & 1) << 1]), quantizeHighBitDepth(pair[1]), quantizeHighBitDepth(pair[3]), currentDest);
+				}
+				break;
+			}
+
+			default:
+				break;
+		}
+	}
+
+	void processImageCompact(const CompactLut& lut, int cropLeft, int cropTop, int cropBottom,
+		const uint8_t* data, int height, int lineLength, const PixelFormat pixelFormat, int step,
+		Image<ColorRgb>& outputImage)
+	{
+		const int outputWidth = outputImage.width();
+		const int outputHeight = outputImage.height();
+		uint8_t* destMemory = outputImage.rawMem();
+		const uint64_t destLineSize = static_cast<uint64_t>(outputWidth) * 3;
+		const bool flipped = (pixelFormat == PixelFormat::RGB24 || pixelFormat == PixelFormat::XRGB);
+
+		for (int yDest = 0; yDest < outputHeight; ++yDest)
+		{
+			uint64_t ySource = (flipped) ? cropBottom + static_cast<uint64_t>(outputHeight - 1 - yDest) * step :
+										   cropTop + static_cast<uint64_t>(yDest) * step;
+
+			decodeCompactLine(lut, pixelFormat, data, height, lineLength, ySource, cropLeft, step, outputWidth, destMemory + destLineSize * yDest);
+		}
+	}
+
+	// decodes one cropped source row to RGB, the destination requires 4 bytes of padding after the last pixel
+	// the format and the presence of the LUT are template parameters so every variant is compiled without per-pixel branches
+	template<PixelFormat FORMAT, bool LUT>
+	void decodeLineT(const uint8_t* data, int height, int lineLength,
+		uint64_t ySource, int cropLeft, int pixels, const uint8_t* lutBuffer, uint8_t* currentDest)
+	{
+		const YuvRowKernels& kernels = yuvRowKernels();
+		const uint8_t* line = data + lineLength * ySource;
+		uint8_t* endDest = currentDest + static_cast<size_t>(pixels) * 3;
+		uint8_t  buffer[8];
+
+		if (FORMAT == PixelFormat::YUYV)
+		{
+			const uint8_t* currentSource = line + (static_cast<uint64_t>(cropLeft) << 1);
+
+			if (kernels.yuyv != nullptr)
+			{
+				int done = kernels.yuyv(currentDest, pixels, currentSource, lutBuffer);
+				currentDest += done * 3;
+				currentSource += done * 2;
+			}
 
 			while (currentDest < endDest)
 			{
 				*((uint32_t*)&buffer) = *((uint32_t*)currentSource);
+				*((uint32_t*)currentDest) = *((uint32_t*)(&lutBuffer[LUT_INDEX(buffer[0], buffer[1], buffer[3])]));
+				currentDest += 3;
+				*((uint32_t*)currentDest) = *((uint32_t*)(&lutBuffer[LUT_INDEX(buffer[2], buffer[1], buffer[3])]));
+				currentDest += 3;
+				currentSource += 4;
+			}
+		}
+		else if (FORMAT == PixelFormat::RGB24 || FORMAT == PixelFormat::XRGB)
+		{
+			const int bpp = (FORMAT == PixelFormat::RGB24) ? 3 : 4;
+			const uint8_t* currentSource = line + static_cast<uint64_t>(cropLeft) * bpp;
+			RgbRowKernel shuffle = (FORMAT == PixelFormat::RGB24) ? kernels.bgr24 : kernels.bgrx;
 
-				ind_lutd = LUT_INDEX(buffer[0], buffer[1], buffer[3]);
-				ind_lutd2 = LUT_INDEX(buffer[2], buffer[1], buffer[3]);
+			if (!LUT && shuffle != nullptr)
+			{
+				int done = shuffle(currentDest, pixels, currentSource);
+				currentDest += done * 3;
+				currentSource += done * bpp;
+			}
 
-				*((uint32_t*)currentDest) = *((uint32_t*)(&lutBuffer[ind_lutd]));
+			for (; currentDest < endDest; currentDest += 3, currentSource += bpp)
+			{
+				if (LUT)
+					*((uint32_t*)currentDest) = *((uint32_t*)(&lutBuffer[LUT_INDEX(currentSource[2], currentSource[1], currentSource[0])]));
+				else
+				{
+					currentDest[0] = currentSource[2];
+					currentDest[1] = currentSource[1];
+					currentDest[2] = currentSource[0];
+				}
+			}
+		}
+		else if (FORMAT == PixelFormat::I420 || FORMAT == PixelFormat::MJPEG)
+		{
+			const bool mjpeg = (FORMAT == PixelFormat::MJPEG);
+			const uint64_t deltaU = static_cast<uint64_t>(lineLength) * height;
+			const uint64_t deltaV = (mjpeg) ? deltaU * 6 / 4 : deltaU * 5 / 4;
+			const uint64_t chromaLine = (((mjpeg) ? ySource : ySource / 2) * lineLength + cropLeft) / 2;
+			const uint8_t* currentSource = line + cropLeft;
+			const uint8_t* currentSourceU = data + deltaU + chromaLine;
+			const uint8_t* currentSourceV = data + deltaV + chromaLine;
+
+			if (kernels.planar != nullptr)
+			{
+				int done = kernels.planar(currentDest, pixels, currentSource, currentSourceU, currentSourceV, lutBuffer);
+				currentDest += done * 3;
+				currentSource += done;
+				currentSourceU += done / 2;
+				currentSourceV += done / 2;
+			}
+
+			while (currentDest < endDest)
+			{
+				uint8_t u = *(currentSourceU++);
+				uint8_t v = *(currentSourceV++);
+
+				*((uint32_t*)currentDest) = *((uint32_t*)(&lutBuffer[LUT_INDEX(currentSource[0], u, v)]));
 				currentDest += 3;
-				*((uint32_t*)currentDest) = *((uint32_t*)(&lutBuffer[ind_lutd2]));
+				*((uint32_t*)currentDest) = *((uint32_t*)(&lutBuffer[LUT_INDEX(currentSource[1], u, v)]));
 				currentDest += 3;
-				currentSource += 4;
+				currentSource += 2;
 			}
 		}
+		else if (FORMAT == PixelFormat::NV12)
+		{
+			const uint8_t* currentSource = line + cropLeft;
+			const uint8_t* currentSourceUV = data + static_cast<uint64_t>(lineLength) * height + (ySource / 2) * lineLength + cropLeft;
 
-#ifdef TAKE_SCREEN_SHOT
-		if (screenShotTaken > 0 && screenShotTaken-- == 1)
+			if (kernels.nv12 != nullptr)
+			{
+				int done = kernels.nv12(currentDest, pixels, currentSource, currentSourceUV, lutBuffer);
+				currentDest += done * 3;
+				currentSource += done;
+				currentSourceUV += done;
+			}
+
+			while (currentDest < endDest)
+			{
+				*((uint32_t*)currentDest) = *((uint32_t*)(&lutBuffer[LUT_INDEX(currentSource[0], currentSourceUV[0], currentSourceUV[1])]));
+				currentDest += 3;
+				*((uint32_t*)currentDest) = *((uint32_t*)(&lutBuffer[LUT_INDEX(currentSource[1], currentSourceUV[0], currentSourceUV[1])]));
+				currentDest += 3;
+				currentSource += 2;
+				currentSourceUV += 2;
+			}
+		}
+		else if (FORMAT == PixelFormat::P010)
 		{
-			QImage jpgImage((const uint8_t*)outputImage.memptr(), outputImage.width(), outputImage.height(), 3 * outputImage.width(), QImage::Format_RGB888);
-			jpgImage.save("D:/grabber_yuv.png", "png");
+			const uint16_t* currentSource = reinterpret_cast<const uint16_t*>(line) + cropLeft;
+			const uint16_t* currentSourceUV = reinterpret_cast<const uint16_t*>(data + static_cast<uint64_t>(lineLength) * height + (ySource / 2) * lineLength) + cropLeft;
+
+			for (; currentDest < endDest; currentDest += 6, currentSource += 2, currentSourceUV += 2)
+			{
+				lookupHighBitDepth(lutBuffer, currentSource[0], currentSourceUV[0], currentSourceUV[1], currentDest);
+				lookupHighBitDepth(lutBuffer, currentSource[1], currentSourceUV[0], currentSourceUV[1], currentDest + 3);
+			}
 		}
-#endif
+		else if (FORMAT == PixelFormat::Y210)
+		{
+			const uint16_t* currentSource = reinterpret_cast<const uint16_t*>(line) + (static_cast<uint64_t>(cropLeft) << 1);
 
-		return;
+			for (; currentDest < endDest; currentDest += 6, currentSource += 4)
+			{
+				lookupHighBitDepth(lutBuffer, currentSource[0], currentSource[1], currentSource[3], currentDest);
+				lookupHighBitDepth(lutBuffer, currentSource[2], currentSource[1], currentSource[3], currentDest + 3);
+			}
+		}
 	}
 
+	// decodes the whole (already sized) image, the rows are always written from top to bottom so the 4-byte LUT store never reaches a finished row
+	template<PixelFormat FORMAT, bool LUT>
+	void decodeImageT(int cropLeft, int cropTop, int cropBottom, const uint8_t* data, int height, int lineLength,
+		const uint8_t* lutBuffer, Image<ColorRgb>& outputImage)
+	{
+		const bool flipped = (FORMAT == PixelFormat::RGB24 || FORMAT == PixelFormat::XRGB);
+		const int outputWidth = outputImage.width();
+		const int outputHeight = outputImage.height();
+		const size_t destLineSize = static_cast<size_t>(outputWidth) * 3;
+		uint8_t* destMemory = outputImage.rawMem();
 
-	if (pixelFormat == PixelFormat::RGB24)
+		for (int yDest = 0; yDest < outputHeight; ++yDest)
+		{
+			uint64_t ySource = (flipped) ? cropBottom + static_cast<uint64_t>(outputHeight - 1 - yDest) : cropTop + static_cast<uint64_t>(yDest);
+
+			decodeLineT<FORMAT, LUT>(data, height, lineLength, ySource, cropLeft, outputWidth, lutBuffer, destMemory + destLineSize * yDest);
+		}
+	}
+
+	typedef void (*DecodeImageFunction)(int cropLeft, int cropTop, int cropBottom, const uint8_t* data, int height, int lineLength,
+		const uint8_t* lutBuffer, Image<ColorRgb>& outputImage);
+
+	struct DecodeImageEntry
 	{
-		for (int yDest = outputHeight - 1, ySource = _cropBottom; yDest >= 0; ++ySource, --yDest)
+		PixelFormat		format;
+		DecodeImageFunction withLut;
+		DecodeImageFunction withoutLut;
+	};
+
+	const DecodeImageEntry decodeImageTable[] = {
+		{ PixelFormat::YUYV,  decodeImageT<PixelFormat::YUYV, true>,  nullptr },
+		{ PixelFormat::RGB24, decodeImageT<PixelFormat::RGB24, true>, decodeImageT<PixelFormat::RGB24, false> },
+		{ PixelFormat::XRGB,  decodeImageT<PixelFormat::XRGB, true>,  decodeImageT<PixelFormat::XRGB, false> },
+		{ PixelFormat::I420,  decodeImageT<PixelFormat::I420, true>,  nullptr },
+		{ PixelFormat::NV12,  decodeImageT<PixelFormat::NV12, true>,  nullptr },
+		{ PixelFormat::MJPEG, decodeImageT<PixelFormat::MJPEG, true>, nullptr },
+		{ PixelFormat::P010,  decodeImageT<PixelFormat::P010, true>,  nullptr },
+		{ PixelFormat::Y210,  decodeImageT<PixelFormat::Y210, true>,  nullptr }
+	};
+
+	DecodeImageFunction selectDecodeImage(PixelFormat pixelFormat, bool lut)
+	{
+		for (const DecodeImageEntry& entry : decodeImageTable)
+			if (entry.format == pixelFormat)
+				return (lut) ? entry.withLut : entry.withoutLut;
+		return nullptr;
+	}
+
+	void decodeLine(const PixelFormat pixelFormat, const uint8_t* data, int height, int lineLength,
+		uint64_t ySource, int cropLeft, int pixels, const uint8_t* lutBuffer, const CompactLut* compactLut, uint8_t* currentDest)
+	{
+		if (compactLut != nullptr && compactLut->isValid())
 		{
-			uint8_t* currentDest = destMemory + ((uint64_t)destLineSize) * yDest;
-			uint8_t* endDest = currentDest + destLineSize;
-			uint8_t* currentSource = (uint8_t*)data + (((uint64_t)lineLength * ySource) + (((uint64_t)_cropLeft) * 3));
+			decodeCompactLine(*compactLut, pixelFormat, data, height, lineLength, ySource, cropLeft, 1, pixels, currentDest);
+			return;
+		}
 
-			if (lutBuffer == NULL)
-				currentSource += 2;
+		switch (pixelFormat)
+		{
+			case PixelFormat::YUYV:
+				decodeLineT<PixelFormat::YUYV, true>(data, height, lineLength, ySource, cropLeft, pixels, lutBuffer, currentDest);
+				break;
 
-			while (currentDest < endDest)
-			{
+			case PixelFormat::RGB24:
 				if (lutBuffer != NULL)
+					decodeLineT<PixelFormat::RGB24, true>(data, height, lineLength, ySource, cropLeft, pixels, lutBuffer, currentDest);
+				else
+					decodeLineT<PixelFormat::RGB24, false>(data, height, lineLength, ySource, cropLeft, pixels, lutBuffer, currentDest);
+				break;
+
+			case PixelFormat::XRGB:
+				if (lutBuffer != NULL)
+					decodeLineT<PixelFormat::XRGB, true>(data, height, lineLength, ySource, cropLeft, pixels, lutBuffer, currentDest);
+				else
+					decodeLineT<PixelFormat::XRGB, false>(data, height, lineLength, ySource, cropLeft, pixels, lutBuffer, currentDest);
+				break;
+
+			case PixelFormat::I420:
+				decodeLineT<PixelFormat::I420, true>(data, height, lineLength, ySource, cropLeft, pixels, lutBuffer, currentDest);
+				break;
+
+			case PixelFormat::MJPEG:
+				decodeLineT<PixelFormat::MJPEG, true>(data, height, lineLength, ySource, cropLeft, pixels, lutBuffer, currentDest);
+				break;
+
+			case PixelFormat::NV12:
+				decodeLineT<PixelFormat::NV12, true>(data, height, lineLength, ySource, cropLeft, pixels, lutBuffer, currentDest);
+				break;
+
+			case PixelFormat::P010:
+				decodeLineT<PixelFormat::P010, true>(data, height, lineLength, ySource, cropLeft, pixels, lutBuffer, currentDest);
+				break;
+
+			case PixelFormat::Y210:
+				decodeLineT<PixelFormat::Y210, true>(data, height, lineLength, ySource, cropLeft, pixels, lutBuffer, currentDest);
+				break;
+
+			default:
+				break;
+		}
+	}
+
+	// applies the LUT to the RGB image, BORDER = HDR mode 2: only the frame used by the LED border is tone mapped
+	template<bool BORDER>
+	void applyLutT(uint8_t* _source, unsigned int width, unsigned int height, const uint8_t* lutBuffer)
+	{
+		uint8_t buffer[8];
+		const unsigned int sizeX = (width * 10) / 100;
+		const unsigned int sizeY = (height * 25) / 100;
+
+		for (unsigned int y = 0; y < height; y++)
+		{
+			unsigned char* startSource = _source + static_cast<size_t>(width) * 3 * y;
+			unsigned char* endSource = startSource + static_cast<size_t>(width) * 3;
+
+			if (!BORDER || y < sizeY || y > height - sizeY)
+			{
+				while (startSource < endSource)
 				{
-					*((uint32_t*)&buffer) = *((uint32_t*)currentSource);
-					currentSource += 3;
-					ind_lutd = LUT_INDEX(buffer[2], buffer[1], buffer[0]);
-					*((uint32_t*)currentDest) = *((uint32_t*)(&lutBuffer[ind_lutd]));
-					currentDest += 3;
+					*((uint32_t*)&buffer) = *((uint32_t*)startSource);
+					uint32_t ind_lutd = LUT_INDEX(buffer[0], buffer[1], buffer[2]);
+					memcpy(startSource, &(lutBuffer[ind_lutd]), 3);
+					startSource += 3;
 				}
-				else
+			}
+			else
+			{
+				unsigned int x = 0;
+				while (startSource < endSource)
 				{
-					*currentDest++ = *currentSource--;
-					*currentDest++ = *currentSource--;
-					*currentDest++ = *currentSource;
-					currentSource += 5;
+					if (x++ == sizeX)
+						startSource += (width - 2 * static_cast<size_t>(sizeX)) * 3;
+
+					*((uint32_t*)&buffer) = *((uint32_t*)startSource);
+					uint32_t ind_lutd = LUT_INDEX(buffer[0], buffer[1], buffer[2]);
+					memcpy(startSource, &(lutBuffer[ind_lutd]), 3);
+					startSource += 3;
 				}
 			}
 		}
+	}
+}
+
+const char* FrameDecoder::getSimdKernelName()
+{
+	return yuvRowKernels().name;
+}
+
+const char* FrameDecoder::getLutLayoutName()
+{
+#ifdef USE_BLOCKED_LUT
+	return "blocked 16x16x16";
+#else
+	return "linear";
+#endif
+}
+
+void FrameDecoder::convertLinearLut(const uint8_t* linear, uint8_t* dest)
+{
+#ifdef USE_BLOCKED_LUT
+	// 16 consecutive y values stay contiguous in a brick
+	for (int v = 0; v < 256; v++)
+		for (int u = 0; u < 256; u++)
+			for (int y = 0; y < 256; y += 16)
+				memcpy(&dest[LUT_INDEX(y, u, v)], &linear[LUT_LINEAR_INDEX(y, u, v)], 16 * 3);
+#else
+	memcpy(dest, linear, 256 * 256 * 256 * 3);
+#endif
+}
+
+void FrameDecoder::processImage(
+	int _cropLeft, int _cropRight, int _cropTop, int _cropBottom,
+	const uint8_t* data, int width, int height, int lineLength,
+	const PixelFormat pixelFormat, const uint8_t* lutBuffer, Image<ColorRgb>& outputImage,
+	const CompactLut* compactLut)
+{
+	// validate format
+	if (pixelFormat != PixelFormat::YUYV &&
+		pixelFormat != PixelFormat::XRGB && pixelFormat != PixelFormat::RGB24 &&
+		pixelFormat != PixelFormat::I420 && pixelFormat != PixelFormat::NV12 && pixelFormat != PixelFormat::MJPEG &&
+		pixelFormat != PixelFormat::P010 && pixelFormat != PixelFormat::Y210)
+	{
+		ErrorThrottled(Logger::getInstance("FrameDecoder"), "Invalid pixel format given");
+		return;
+	}
+
+	// validate format LUT
+	if ((pixelFormat == PixelFormat::YUYV || pixelFormat == PixelFormat::I420 || pixelFormat == PixelFormat::MJPEG ||
+		pixelFormat == PixelFormat::NV12 || pixelFormat == PixelFormat::P010 || pixelFormat == PixelFormat::Y210) && lutBuffer == NULL && compactLut == nullptr)
+	{
+		ErrorThrottled(Logger::getInstance("FrameDecoder"), "Missing LUT table for YUV colorspace");
+		return;
+	}
+
+	// sanity check, odd values doesnt work for yuv either way
+	_cropLeft = (_cropLeft >> 1) << 1;
+	_cropRight = (_cropRight >> 1) << 1;
+
+	// calculate the output size
+	int outputWidth = (width - _cropLeft - _cropRight);
+	int outputHeight = (height - _cropTop - _cropBottom);
+
+	outputImage.resize(outputWidth, outputHeight);
+
+	if (compactLut != nullptr && compactLut->isValid())
+	{
+		processImageCompact(*compactLut, _cropLeft, _cropTop, _cropBottom, data, height, lineLength, pixelFormat, 1, outputImage);
+		return;
+	}
+
+	DecodeImageFunction decoder = selectDecodeImage(pixelFormat, lutBuffer != NULL);
+
+	if (decoder != nullptr)
+		decoder(_cropLeft, _cropTop, _cropBottom, data, height, lineLength, lutBuffer, outputImage);
+
+#ifdef TAKE_SCREEN_SHOT
+	if ((pixelFormat == PixelFormat::YUYV || pixelFormat == PixelFormat::NV12) && screenShotTaken > 0 && screenShotTaken-- == 1)
+	{
+		QImage jpgImage((const uint8_t*)outputImage.memptr(), outputImage.width(), outputImage.height(), 3 * outputImage.width(), QImage::Format_RGB888);
+		jpgImage.save((pixelFormat == PixelFormat::YUYV) ? "D:/grabber_yuv.png" : "D:/grabber_nv12.png", "png");
+	}
+#endif
+}
+
+int FrameDecoder::getDownscaleFactor(int width, int height, int targetWidth, bool qframe)
+{
+	int factor = (qframe) ? 2 : 1;
+
+	if (targetWidth > 0 && width > targetWidth)
+		factor = std::max(factor, (width + targetWidth - 1) / targetWidth);
+
+	// keep enough pixels for the LED mapping
+	while (factor > 1 && (width / factor < 16 || height / factor < 16))
+		factor--;
+
+	return factor;
+}
+
+int FrameDecoder::getMjpegScale(int width, int height, int targetWidth, bool qframe, int requestedScale)
+{
+	int scale = (requestedScale > 0) ? requestedScale : 1;
+
+	if (qframe)
+		scale = std::max(scale, 2);
+
+	// the largest DCT scaling that still delivers the target width, the rest is done by the box filter
+	if (requestedScale == 0 && targetWidth > 0)
+		while (scale < 8 && width / (scale * 2) >= targetWidth)
+			scale *= 2;
+
+	// keep enough pixels for the LED mapping
+	while (scale > 1 && (width / scale < 16 || height / scale < 16))
+		scale /= 2;
+
+	return scale;
+}
+
+void FrameDecoder::processImageDownscaled(
+	int _cropLeft, int _cropRight, int _cropTop, int _cropBottom,
+	const uint8_t* data, int width, int height, int lineLength,
+	const PixelFormat pixelFormat, const uint8_t* lutBuffer, int factor, Image<ColorRgb>& outputImage,
+	const CompactLut* compactLut)
+{
+	if (factor <= 1)
+	{
+		processImage(_cropLeft, _cropRight, _cropTop, _cropBottom, data, width, height, lineLength, pixelFormat, lutBuffer, outputImage, compactLut);
+		return;
+	}
+
+	// validate format
+	if (pixelFormat != PixelFormat::YUYV &&
+		pixelFormat != PixelFormat::XRGB && pixelFormat != PixelFormat::RGB24 &&
+		pixelFormat != PixelFormat::I420 && pixelFormat != PixelFormat::NV12 && pixelFormat != PixelFormat::MJPEG &&
+		pixelFormat != PixelFormat::P010 && pixelFormat != PixelFormat::Y210)
+	{
+		ErrorThrottled(Logger::getInstance("FrameDecoder"), "Invalid pixel format given");
+		return;
+	}
+
+	// validate format LUT
+	if ((pixelFormat == PixelFormat::YUYV || pixelFormat == PixelFormat::I420 || pixelFormat == PixelFormat::MJPEG ||
+		pixelFormat == PixelFormat::NV12 || pixelFormat == PixelFormat::P010 || pixelFormat == PixelFormat::Y210) && lutBuffer == NULL && compactLut == nullptr)
+	{
+		ErrorThrottled(Logger::getInstance("FrameDecoder"), "Missing LUT table for YUV colorspace");
 		return;
 	}
 
-	if (pixelFormat == PixelFormat::XRGB)
+	// sanity check, odd values doesnt work for yuv either way
+	_cropLeft = (_cropLeft >> 1) << 1;
+	_cropRight = (_cropRight >> 1) << 1;
+
+	int sourceWidth = (width - _cropLeft - _cropRight);
+	int sourceHeight = (height - _cropTop - _cropBottom);
+
+	// the decoded row must hold whole pixel pairs and the 4-byte LUT store
+	sourceWidth = (sourceWidth >> 1) << 1;
+
+	int outputWidth = sourceWidth / factor;
+	int outputHeight = sourceHeight / factor;
+
+	outputImage.resize(outputWidth, outputHeight);
+
+	if (outputWidth <= 0 || outputHeight <= 0)
+		return;
+
+	const bool flipped = (pixelFormat == PixelFormat::RGB24 || pixelFormat == PixelFormat::XRGB);
+	const uint32_t area = static_cast<uint32_t>(factor) * factor;
+	const size_t usedSourceWidth = static_cast<size_t>(outputWidth) * factor;
+
+	std::vector<uint8_t>  line(static_cast<size_t>(sourceWidth) * 3 + 8);
+	std::vector<uint32_t> sum(static_cast<size_t>(outputWidth) * 3);
+
+	uint8_t* destMemory = outputImage.rawMem();
+
+	for (int yDest = 0; yDest < outputHeight; ++yDest)
 	{
-		for (int yDest = outputHeight - 1, ySource = _cropBottom; yDest >= 0; ++ySource, --yDest)
+		std::fill(sum.begin(), sum.end(), 0);
+
+		for (int k = 0; k < factor; k++)
 		{
-			uint8_t* currentDest = destMemory + ((uint64_t)destLineSize) * yDest;
-			uint8_t* endDest = currentDest + destLineSize;
-			uint8_t* currentSource = (uint8_t*)data + (((uint64_t)lineLength * ySource) + (((uint64_t)_cropLeft) * 4));
+			int yCropped = yDest * factor + k;
+			uint64_t ySource = (flipped) ? _cropBottom + static_cast<uint64_t>(sourceHeight - 1 - yCropped) : _cropTop + static_cast<uint64_t>(yCropped);
 
-			if (lutBuffer == NULL)
-				currentSource += 2;
+			decodeLine(pixelFormat, data, height, lineLength, ySource, _cropLeft, sourceWidth, lutBuffer, compactLut, line.data());
 
-			while (currentDest < endDest)
-			{
-				if (lutBuffer != NULL)
-				{
-					*((uint32_t*)&buffer) = *((uint32_t*)currentSource);
-					currentSource += 4;
-					ind_lutd = LUT_INDEX(buffer[2], buffer[1], buffer[0]);
-					*((uint32_t*)currentDest) = *((uint32_t*)(&lutBuffer[ind_lutd]));
-					currentDest += 3;
-				}
-				else
+			const uint8_t* pixel = line.data();
+			uint32_t* acc = sum.data();
+			for (size_t x = 0; x < usedSourceWidth; x += factor, acc += 3)
+				for (int i = 0; i < factor; i++, pixel += 3)
 				{
-					*currentDest++ = *currentSource--;
-					*currentDest++ = *currentSource--;
-					*currentDest++ = *currentSource;
-					currentSource += 6;
+					acc[0] += pixel[0];
+					acc[1] += pixel[1];
+					acc[2] += pixel[2];
 				}
-			}
 		}
+
+		uint8_t* currentDest = destMemory + static_cast<size_t>(outputWidth) * 3 * yDest;
+		for (size_t i = 0; i < sum.size(); i++)
+			currentDest[i] = static_cast<uint8_t>((sum[i] + area / 2) / area);
+	}
+}
+
+void FrameDecoder::processImageRegion(
+	int _cropLeft, int _cropRight, int _cropTop, int _cropBottom,
+	const uint8_t* data, int width, int height, int lineLength,
+	const PixelFormat pixelFormat, const uint8_t* lutBuffer, int factor,
+	const QRectF& skippedArea, Image<ColorRgb>& outputImage,
+	const CompactLut* compactLut)
+{
+	factor = std::max(factor, 1);
+
+	if (skippedArea.isEmpty())
+	{
+		processImageDownscaled(_cropLeft, _cropRight, _cropTop, _cropBottom, data, width, height, lineLength, pixelFormat, lutBuffer, factor, outputImage, compactLut);
 		return;
 	}
 
-	if (pixelFormat == PixelFormat::I420)
+	// validate format
+	if (pixelFormat != PixelFormat::YUYV &&
+		pixelFormat != PixelFormat::XRGB && pixelFormat != PixelFormat::RGB24 &&
+		pixelFormat != PixelFormat::I420 && pixelFormat != PixelFormat::NV12 && pixelFormat != PixelFormat::MJPEG &&
+		pixelFormat != PixelFormat::P010 && pixelFormat != PixelFormat::Y210)
 	{
-		int deltaU = lineLength * height;
-		int deltaV = lineLength * height * 5 / 4;
-		for (int yDest = 0, ySource = _cropTop; yDest < outputHeight; ++ySource, ++yDest)
-		{
-			uint8_t* currentDest = destMemory + ((uint64_t)destLineSize) * yDest;
-			uint8_t* endDest = currentDest + destLineSize;
-			uint8_t* currentSource = (uint8_t*)data + (((uint64_t)lineLength * ySource) + ((uint64_t)_cropLeft));
-			uint8_t* currentSourceU = (uint8_t*)data + deltaU + ((((uint64_t)ySource / 2) * lineLength) + ((uint64_t)_cropLeft)) / 2;
-			uint8_t* currentSourceV = (uint8_t*)data + deltaV + ((((uint64_t)ySource / 2) * lineLength) + ((uint64_t)_cropLeft)) / 2;
+		ErrorThrottled(Logger::getInstance("FrameDecoder"), "Invalid pixel format given");
+		return;
+	}
 
-			while (currentDest < endDest)
-			{
-				*((uint16_t*)&buffer) = *((uint16_t*)currentSource);
-				currentSource += 2;
-				buffer[2] = *(currentSourceU++);
-				buffer[3] = *(currentSourceV++);
+	// validate format LUT
+	if ((pixelFormat == PixelFormat::YUYV || pixelFormat == PixelFormat::I420 || pixelFormat == PixelFormat::MJPEG ||
+		pixelFormat == PixelFormat::NV12 || pixelFormat == PixelFormat::P010 || pixelFormat == PixelFormat::Y210) && lutBuffer == NULL && compactLut == nullptr)
+	{
+		ErrorThrottled(Logger::getInstance("FrameDecoder"), "Missing LUT table for YUV colorspace");
+		return;
+	}
 
-				ind_lutd = LUT_INDEX(buffer[0], buffer[2], buffer[3]);
-				ind_lutd2 = LUT_INDEX(buffer[1], buffer[2], buffer[3]);
+	// sanity check, odd values doesnt work for yuv either way
+	_cropLeft = (_cropLeft >> 1) << 1;
+	_cropRight = (_cropRight >> 1) << 1;
 
-				*((uint32_t*)currentDest) = *((uint32_t*)(&lutBuffer[ind_lutd]));
-				currentDest += 3;
-				*((uint32_t*)currentDest) = *((uint32_t*)(&lutBuffer[ind_lutd2]));
-				currentDest += 3;
-			}
-		}
+	int sourceWidth = (width - _cropLeft - _cropRight);
+	int sourceHeight = (height - _cropTop - _cropBottom);
+
+	if (factor > 1)
+		sourceWidth = (sourceWidth >> 1) << 1;
+
+	int outputWidth = sourceWidth / factor;
+	int outputHeight = sourceHeight / factor;
+
+	outputImage.resize(outputWidth, outputHeight);
+
+	if (outputWidth <= 0 || outputHeight <= 0)
 		return;
+
+	int skipLeft = int(std::ceil(skippedArea.left() * outputWidth)) + 1;
+	int skipRight = std::min(int(std::floor(skippedArea.right() * outputWidth)) - 1, outputWidth);
+	int skipTop = int(std::ceil(skippedArea.top() * outputHeight)) + 1;
+	int skipBottom = std::min(int(std::floor(skippedArea.bottom() * outputHeight)) - 1, outputHeight);
+
+	// the spans must start at the even column: the chroma of YUYV, NV12 and I420 is shared by the pixel pairs
+	skipLeft = ((skipLeft + 1) >> 1) << 1;
+	skipRight = (skipRight >> 1) << 1;
+
+	if (skipLeft >= skipRight || skipTop >= skipBottom)
+	{
+		skipLeft = skipRight = outputWidth;
+		skipTop = skipBottom = outputHeight;
 	}
 
-	if (pixelFormat == PixelFormat::MJPEG)
+	const bool flipped = (pixelFormat == PixelFormat::RGB24 || pixelFormat == PixelFormat::XRGB);
+	const size_t destLineSize = static_cast<size_t>(outputWidth) * 3;
+	uint8_t* destMemory = outputImage.rawMem();
+
+	auto sourceRow = [&](int yCropped) -> uint64_t {
+		return (flipped) ? _cropBottom + static_cast<uint64_t>(sourceHeight - 1 - yCropped) : _cropTop + static_cast<uint64_t>(yCropped);
+	};
+
+	if (factor == 1)
 	{
-		int deltaU = lineLength * height;
-		int deltaV = lineLength * height * 6 / 4;
-		for (int yDest = 0, ySource = _cropTop; yDest < outputHeight; ++ySource, ++yDest)
+		// the rows are written from top to bottom: the 4-byte LUT store of a span only reaches the skipped pixel or the row that follows
+		for (int yDest = 0; yDest < outputHeight; ++yDest)
 		{
-			uint8_t* currentDest = destMemory + ((uint64_t)destLineSize) * yDest;
-			uint8_t* endDest = currentDest + destLineSize;
-			uint8_t* currentSource = (uint8_t*)data + (((uint64_t)lineLength * ySource) + ((uint64_t)_cropLeft));
-			uint8_t* currentSourceU = (uint8_t*)data + deltaU + ((((uint64_t)ySource) * lineLength) + ((uint64_t)_cropLeft)) / 2;
-			uint8_t* currentSourceV = (uint8_t*)data + deltaV + ((((uint64_t)ySource) * lineLength) + ((uint64_t)_cropLeft)) / 2;
+			uint8_t* currentDest = destMemory + destLineSize * yDest;
+			uint64_t ySource = sourceRow(yDest);
 
-			while (currentDest < endDest)
+			if (yDest < skipTop || yDest >= skipBottom)
+				decodeLine(pixelFormat, data, height, lineLength, ySource, _cropLeft, outputWidth, lutBuffer, compactLut, currentDest);
+			else
 			{
-				*((uint16_t*)&buffer) = *((uint16_t*)currentSource);
-				currentSource += 2;
-				buffer[2] = *(currentSourceU++);
-				buffer[3] = *(currentSourceV++);
-
-				ind_lutd = LUT_INDEX(buffer[0], buffer[2], buffer[3]);
-				ind_lutd2 = LUT_INDEX(buffer[1], buffer[2], buffer[3]);
-
-				*((uint32_t*)currentDest) = *((uint32_t*)(&lutBuffer[ind_lutd]));
-				currentDest += 3;
-				*((uint32_t*)currentDest) = *((uint32_t*)(&lutBuffer[ind_lutd2]));
-				currentDest += 3;
+				decodeLine(pixelFormat, data, height, lineLength, ySource, _cropLeft, skipLeft, lutBuffer, compactLut, currentDest);
+				if (skipRight < outputWidth)
+					decodeLine(pixelFormat, data, height, lineLength, ySource, _cropLeft + skipRight, outputWidth - skipRight, lutBuffer, compactLut, currentDest + static_cast<size_t>(skipRight) * 3);
 			}
 		}
 		return;
 	}
 
-	if (pixelFormat == PixelFormat::NV12)
+	const uint32_t area = static_cast<uint32_t>(factor) * factor;
+	const size_t usedSourceWidth = static_cast<size_t>(outputWidth) * factor;
+	const int sourceSkipLeft = skipLeft * factor;
+	const int sourceSkipRight = skipRight * factor;
+
+	std::vector<uint8_t>  line(static_cast<size_t>(sourceWidth) * 3 + 8);
+	std::vector<uint32_t> sum(static_cast<size_t>(outputWidth) * 3);
+
+	for (int yDest = 0; yDest < outputHeight; ++yDest)
 	{
-		int deltaU = lineLength * height;
-		for (int yDest = 0, ySource = _cropTop; yDest < outputHeight; ++ySource, ++yDest)
-		{
-			uint8_t* currentDest = destMemory + ((uint64_t)destLineSize) * yDest;
-			uint8_t* endDest = currentDest + destLineSize;
-			uint8_t* currentSource = (uint8_t*)data + (((uint64_t)lineLength * ySource) + ((uint64_t)_cropLeft));
-			uint8_t* currentSourceU = (uint8_t*)data + deltaU + (((uint64_t)ySource / 2) * lineLength) + ((uint64_t)_cropLeft);
+		const bool partial = (yDest >= skipTop && yDest < skipBottom);
 
-			while (currentDest < endDest)
-			{
-				*((uint16_t*)&buffer) = *((uint16_t*)currentSource);
-				currentSource += 2;
-				*((uint16_t*)&(buffer[2])) = *((uint16_t*)currentSourceU);
-				currentSourceU += 2;
+		std::fill(sum.begin(), sum.end(), 0);
 
-				ind_lutd = LUT_INDEX(buffer[0], buffer[2], buffer[3]);
-				ind_lutd2 = LUT_INDEX(buffer[1], buffer[2], buffer[3]);
+		for (int k = 0; k < factor; k++)
+		{
+			uint64_t ySource = sourceRow(yDest * factor + k);
 
-				*((uint32_t*)currentDest) = *((uint32_t*)(&lutBuffer[ind_lutd]));
-				currentDest += 3;
-				*((uint32_t*)currentDest) = *((uint32_t*)(&lutBuffer[ind_lutd2]));
-				currentDest += 3;
+			if (!partial)
+				decodeLine(pixelFormat, data, height, lineLength, ySource, _cropLeft, sourceWidth, lutBuffer, compactLut, line.data());
+			else
+			{
+				decodeLine(pixelFormat, data, height, lineLength, ySource, _cropLeft, sourceSkipLeft, lutBuffer, compactLut, line.data());
+				if (sourceSkipRight < sourceWidth)
+					decodeLine(pixelFormat, data, height, lineLength, ySource, _cropLeft + sourceSkipRight, sourceWidth - sourceSkipRight, lutBuffer, compactLut, line.data() + static_cast<size_t>(sourceSkipRight) * 3);
 			}
+
+			const uint8_t* pixel = line.data();
+			uint32_t* acc = sum.data();
+			for (size_t x = 0; x < usedSourceWidth; x += factor, acc += 3)
+				for (int i = 0; i < factor; i++, pixel += 3)
+				{
+					acc[0] += pixel[0];
+					acc[1] += pixel[1];
+					acc[2] += pixel[2];
+				}
 		}
-#ifdef TAKE_SCREEN_SHOT
-		if (screenShotTaken > 0 && screenShotTaken-- == 1)
+
+		uint8_t* currentDest = destMemory + destLineSize * yDest;
+		const size_t holeBegin = (partial) ? static_cast<size_t>(skipLeft) * 3 : sum.size();
+		const size_t holeEnd = (partial) ? static_cast<size_t>(skipRight) * 3 : sum.size();
+
+		for (size_t i = 0; i < holeBegin; i++)
+			currentDest[i] = static_cast<uint8_t>((sum[i] + area / 2) / area);
+		for (size_t i = holeEnd; i < sum.size(); i++)
+			currentDest[i] = static_cast<uint8_t>((sum[i] + area / 2) / area);
+	}
+}
+
+void FrameDecoder::processImageRows(
+	int _cropLeft, int _cropTop,
+	const uint8_t* data, int height, int lineLength,
+	const PixelFormat pixelFormat, const uint8_t* lutBuffer, Image<ColorRgb>& outputImage,
+	int firstRow, int lastRow, const CompactLut* compactLut)
+{
+	const int outputWidth = outputImage.width();
+	const size_t destLineSize = static_cast<size_t>(outputWidth) * 3;
+	uint8_t* destMemory = outputImage.rawMem();
+
+	lastRow = std::min(lastRow, static_cast<int>(outputImage.height()));
+
+	for (int yDest = firstRow; yDest < lastRow; ++yDest)
+	{
+		uint8_t* currentDest = destMemory + destLineSize * yDest;
+		uint64_t ySource = static_cast<uint64_t>(_cropTop) + yDest;
+
+		// the 4-byte LUT store of the last pixel reaches the first row of the next stripe which can be decoded concurrently
+		if (yDest == lastRow - 1 && lastRow < static_cast<int>(outputImage.height()))
 		{
-			QImage jpgImage((const uint8_t*)outputImage.memptr(), outputImage.width(), outputImage.height(), 3 * outputImage.width(), QImage::Format_RGB888);
-			jpgImage.save("D:/grabber_nv12.png", "png");
+			std::vector<uint8_t> line(destLineSize + 4);
+			decodeLine(pixelFormat, data, height, lineLength, ySource, _cropLeft, outputWidth, lutBuffer, compactLut, line.data());
+			memcpy(currentDest, line.data(), destLineSize);
 		}
-#endif
-		return;
+		else
+			decodeLine(pixelFormat, data, height, lineLength, ySource, _cropLeft, outputWidth, lutBuffer, compactLut, currentDest);
 	}
 }
 
 void FrameDecoder::processQImage(
 	const uint8_t* data, int width, int height, int lineLength,
-	const PixelFormat pixelFormat, const uint8_t* lutBuffer, Image<ColorRgb>& outputImage)
+	const PixelFormat pixelFormat, const uint8_t* lutBuffer, Image<ColorRgb>& outputImage,
+	const CompactLut* compactLut)
 {
 	uint32_t ind_lutd;
 	uint8_t  buffer[8];
@@ -285,17 +1272,18 @@ void FrameDecoder::processQImage(
 	// validate format
 	if (pixelFormat != PixelFormat::YUYV &&
 		pixelFormat != PixelFormat::XRGB && pixelFormat != PixelFormat::RGB24 &&
-		pixelFormat != PixelFormat::I420 && pixelFormat != PixelFormat::NV12)
+		pixelFormat != PixelFormat::I420 && pixelFormat != PixelFormat::NV12 &&
+		pixelFormat != PixelFormat::P010 && pixelFormat != PixelFormat::Y210)
 	{
-		Error(Logger::getInstance("FrameDecoder"), "Invalid pixel format given");
+		ErrorThrottled(Logger::getInstance("FrameDecoder"), "Invalid pixel format given");
 		return;
 	}
 
 	// validate format LUT
 	if ((pixelFormat == PixelFormat::YUYV || pixelFormat == PixelFormat::I420 ||
-		pixelFormat == PixelFormat::NV12) && lutBuffer == NULL)
+		pixelFormat == PixelFormat::NV12 || pixelFormat == PixelFormat::P010 || pixelFormat == PixelFormat::Y210) && lutBuffer == NULL && compactLut == nullptr)
 	{
-		Error(Logger::getInstance("FrameDecoder"), "Missing LUT table for YUV colorspace");
+		ErrorThrottled(Logger::getInstance("FrameDecoder"), "Missing LUT table for YUV colorspace");
 		return;
 	}
 
@@ -305,6 +1293,12 @@ void FrameDecoder::processQImage(
 
 	outputImage.resize(outputWidth, outputHeight);
 
+	if (compactLut != nullptr && compactLut->isValid())
+	{
+		processImageCompact(*compactLut, 0, 0, 0, data, height, lineLength, pixelFormat, 2, outputImage);
+		return;
+	}
+
 	uint8_t* destMemory = outputImage.rawMem();
 	int 		destLineSize = outputImage.width() * 3;
 
@@ -334,7 +1328,8 @@ void FrameDecoder::processQImage(
 
 	if (pixelFormat == PixelFormat::RGB24)
 	{
-		for (int yDest = outputHeight - 1, ySource = 0; yDest >= 0; ySource += 2, --yDest)
+		// rows are written top-down so the 4-byte store never clobbers the already decoded row below
+		for (int yDest = 0, ySource = (outputHeight - 1) * 2; yDest < outputHeight; ySource -= 2, ++yDest)
 		{
 			uint8_t* currentDest = destMemory + ((uint64_t)destLineSize) * yDest;
 			uint8_t* endDest = currentDest + destLineSize;
@@ -367,7 +1362,8 @@ void FrameDecoder::processQImage(
 
 	if (pixelFormat == PixelFormat::XRGB)
 	{
-		for (int yDest = outputHeight - 1, ySource = 0; yDest >= 0; ySource += 2, --yDest)
+		// rows are written top-down so the 4-byte store never clobbers the already decoded row below
+		for (int yDest = 0, ySource = (outputHeight - 1) * 2; yDest < outputHeight; ySource -= 2, ++yDest)
 		{
 			uint8_t* currentDest = destMemory + ((uint64_t)destLineSize) * yDest;
 			uint8_t* endDest = currentDest + destLineSize;
@@ -451,17 +1447,55 @@ void FrameDecoder::processQImage(
 		}
 		return;
 	}
+
+	if (pixelFormat == PixelFormat::P010)
+	{
+		uint64_t deltaUV = (uint64_t)lineLength * height;
+		for (int yDest = 0, ySource = 0; yDest < outputHeight; ySource += 2, ++yDest)
+		{
+			uint8_t* currentDest = destMemory + ((uint64_t)destLineSize) * yDest;
+			uint8_t* endDest = currentDest + destLineSize;
+			const uint16_t* currentSource = (const uint16_t*)(data + ((uint64_t)lineLength * ySource));
+			const uint16_t* currentSourceUV = (const uint16_t*)(data + deltaUV + (((uint64_t)ySource / 2) * lineLength));
+
+			while (currentDest < endDest)
+			{
+				lookupHighBitDepth(lutBuffer, currentSource[0], currentSourceUV[0], currentSourceUV[1], currentDest);
+				currentSource += 2;
+				currentSourceUV += 2;
+				currentDest += 3;
+			}
+		}
+		return;
+	}
+
+	if (pixelFormat == PixelFormat::Y210)
+	{
+		for (int yDest = 0, ySource = 0; yDest < outputHeight; ySource += 2, ++yDest)
+		{
+			uint8_t* currentDest = destMemory + ((uint64_t)destLineSize) * yDest;
+			uint8_t* endDest = currentDest + destLineSize;
+			const uint16_t* currentSource = (const uint16_t*)(data + ((uint64_t)lineLength * ySource));
+
+			while (currentDest < endDest)
+			{
+				lookupHighBitDepth(lutBuffer, currentSource[0], currentSource[1], currentSource[3], currentDest);
+				currentSource += 4;
+				currentDest += 3;
+			}
+		}
+		return;
+	}
 }
 
 
 
 
 
-void FrameDecoder::applyLUT(uint8_t* _source, unsigned int width, unsigned int height, const uint8_t* lutBuffer, const int _hdrToneMappingEnabled)
+void FrameDecoder::applyLUT(uint8_t* _source, unsigned int width, unsigned int height, const uint8_t* lutBuffer, const int _hdrToneMappingEnabled,
+	const CompactLut* compactLut)
 {
-	uint8_t buffer[8];
-
-	if (lutBuffer != NULL && _hdrToneMappingEnabled)
+	if (compactLut != nullptr && compactLut->isValid() && _hdrToneMappingEnabled)
 	{
 		unsigned int sizeX = (width * 10) / 100;
 		unsigned int sizeY = (height * 25) / 100;
@@ -469,34 +1503,17 @@ void FrameDecoder::applyLUT(uint8_t* _source, unsigned int width, unsigned int h
 		for (unsigned int y = 0; y < height; y++)
 		{
 			unsigned char* startSource = _source + static_cast<size_t>(width) * 3 * y;
-			unsigned char* endSource = startSource + static_cast<size_t>(width) * 3;
-
-			if (_hdrToneMappingEnabled != 2 || y < sizeY || y > height - sizeY)
-			{
-				while (startSource < endSource)
-				{
-					*((uint32_t*)&buffer) = *((uint32_t*)startSource);
-					uint32_t ind_lutd = LUT_INDEX(buffer[0], buffer[1], buffer[2]);
-					memcpy(startSource, &(lutBuffer[ind_lutd]), 3);
-					startSource += 3;
-				}
-			}
-			else
-			{
-				unsigned int x = 0;
-				while (startSource < endSource)
-				{
-					if (x++ == sizeX)
-						startSource += (width - 2 * static_cast<size_t>(sizeX)) * 3;
+			bool border = (_hdrToneMappingEnabled == 2 && y >= sizeY && y <= height - sizeY);
 
-					*((uint32_t*)&buffer) = *((uint32_t*)startSource);
-					uint32_t ind_lutd = LUT_INDEX(buffer[0], buffer[1], buffer[2]);
-					memcpy(startSource, &(lutBuffer[ind_lutd]), 3);
-					startSource += 3;
-				}
-			}
+			for (unsigned int x = 0; x < width; x++, startSource += 3)
+				if (!border || x < sizeX || x >= width - sizeX)
+					compactLut->lookup(startSource[0], startSource[1], startSource[2], startSource);
 		}
 	}
+	else if (lutBuffer != NULL && _hdrToneMappingEnabled == 2)
+		applyLutT<true>(_source, width, height, lutBuffer);
+	else if (lutBuffer != NULL && _hdrToneMappingEnabled)
+		applyLutT<false>(_source, width, height, lutBuffer);
 #ifdef TAKE_SCREEN_SHOT
 	if (screenShotTaken > 0 && screenShotTaken-- == 1)
 	{
@@ -506,10 +1523,87 @@ void FrameDecoder::applyLUT(uint8_t* _source, unsigned int width, unsigned int h
 #endif
 }
 
+namespace
+{
+	// a cell of the system capture is averaged from up to BOX_TAPS x BOX_TAPS pixels spread over it:
+	// the whole area for the small divisions, a bounded cost for the large ones
+	const int BOX_TAPS = 4;
+
+	void boxTapOffsets(int division, int taps, int* offsets)
+	{
+		for (int k = 0; k < taps; k++)
+			offsets[k] = ((2 * k + 1) * division) / (2 * taps);
+	}
+
+	inline void storeBoxPixel(uint8_t* dest, uint32_t red, uint32_t green, uint32_t blue, uint32_t area, const uint8_t* lutBuffer)
+	{
+		const uint8_t r = static_cast<uint8_t>((red + area / 2) / area);
+		const uint8_t g = static_cast<uint8_t>((green + area / 2) / area);
+		const uint8_t b = static_cast<uint8_t>((blue + area / 2) / area);
+
+		if (lutBuffer != nullptr)
+			memcpy(dest, &lutBuffer[LUT_INDEX(r, g, b)], 3);
+		else
+		{
+			dest[0] = r;
+			dest[1] = g;
+			dest[2] = b;
+		}
+	}
+
+	// the rows of the taps are summed per byte by the SIMD kernel, the columns of the taps are summed per cell, the LUT is applied to the mean
+	template<int BPP, int RED, int GREEN, int BLUE>
+	void processSystemImageBox(Image<ColorRgb>& image, int targetSizeX, int targetSizeY, int startX, int startY,
+		const uint8_t* source, int actualHeight, int division, const uint8_t* lutBuffer, int lineSize)
+	{
+		const int taps = std::min(division, BOX_TAPS);
+		const uint32_t area = static_cast<uint32_t>(taps) * taps;
+		const int rowBytes = targetSizeX * division * BPP;
+		const AccumulateRowKernel accumulate = yuvRowKernels().accumulate;
+		int offsets[BOX_TAPS];
+		std::vector<uint16_t> sums(rowBytes);
+
+		boxTapOffsets(division, taps, offsets);
+
+		for (int j = 0; j < targetSizeY; j++)
+		{
+			std::fill(sums.begin(), sums.end(), 0);
+
+			for (int k = 0; k < taps; k++)
+			{
+				const size_t lineSource = std::min(startY + j * division + offsets[k], actualHeight - 1);
+				const uint8_t* sLine = source + lineSource * lineSize + static_cast<size_t>(startX) * BPP;
+				int done = (accumulate != nullptr) ? accumulate(sums.data(), rowBytes, sLine) : 0;
+
+				for (; done < rowBytes; done++)
+					sums[done] += sLine[done];
+			}
+
+			uint8_t* dLine = image.rawMem() + static_cast<size_t>(j) * targetSizeX * 3;
+
+			for (int x = 0; x < targetSizeX; x++, dLine += 3)
+			{
+				const uint16_t* cell = sums.data() + static_cast<size_t>(x) * division * BPP;
+				uint32_t red = 0, green = 0, blue = 0;
+
+				for (int k = 0; k < taps; k++)
+				{
+					const uint16_t* pixel = cell + offsets[k] * BPP;
+					red += pixel[RED];
+					green += pixel[GREEN];
+					blue += pixel[BLUE];
+				}
+
+				storeBoxPixel(dLine, red, green, blue, area, lutBuffer);
+			}
+		}
+	}
+}
+
 void FrameDecoder::processSystemImageBGRA(Image<ColorRgb>& image, int targetSizeX, int targetSizeY,
 	int startX, int startY,
 	uint8_t* source, int _actualWidth, int _actualHeight,
-	int division, uint8_t* _lutBuffer, int lineSize)
+	int division, const uint8_t* _lutBuffer, int lineSize)
 {
 	uint32_t	ind_lutd;
 	uint8_t		buffer[8];
@@ -518,6 +1612,12 @@ void FrameDecoder::processSystemImageBGRA(Image<ColorRgb>& image, int targetSize
 	if (lineSize == 0)
 		lineSize = _actualWidth * 4;
 
+	if (division > 1)
+	{
+		processSystemImageBox<4, 2, 1, 0>(image, targetSizeX, targetSizeY, startX, startY, source, _actualHeight, division, _lutBuffer, lineSize);
+		return;
+	}
+
 	for (int j = 0; j < targetSizeY; j++)
 	{
 		size_t lineSource = std::min(startY + j * division, _actualHeight - 1);
@@ -550,7 +1650,7 @@ void FrameDecoder::processSystemImageBGRA(Image<ColorRgb>& image, int targetSize
 void FrameDecoder::processSystemImageBGR(Image<ColorRgb>& image, int targetSizeX, int targetSizeY,
 	int startX, int startY,
 	uint8_t* source, int _actualWidth, int _actualHeight,
-	int division, uint8_t* _lutBuffer, int lineSize)
+	int division, const uint8_t* _lutBuffer, int lineSize)
 {
 	uint32_t	ind_lutd;
 	uint8_t		buffer[8];
@@ -559,6 +1659,12 @@ void FrameDecoder::processSystemImageBGR(Image<ColorRgb>& image, int targetSizeX
 	if (lineSize == 0)
 		lineSize = _actualWidth * 3;
 
+	if (division > 1)
+	{
+		processSystemImageBox<3, 2, 1, 0>(image, targetSizeX, targetSizeY, startX, startY, source, _actualHeight, division, _lutBuffer, lineSize);
+		return;
+	}
+
 	for (int j = 0; j < targetSizeY; j++)
 	{
 		size_t lineSource = std::min(startY + j * division, _actualHeight - 1);
@@ -592,7 +1698,7 @@ void FrameDecoder::processSystemImageBGR(Image<ColorRgb>& image, int targetSizeX
 void FrameDecoder::processSystemImageBGR16(Image<ColorRgb>& image, int targetSizeX, int targetSizeY,
 	int startX, int startY,
 	uint8_t* source, int _actualWidth, int _actualHeight,
-	int division, uint8_t* _lutBuffer, int lineSize)
+	int division, const uint8_t* _lutBuffer, int lineSize)
 {
 	uint32_t	ind_lutd;
 	uint8_t		buffer[8];
@@ -601,6 +1707,43 @@ void FrameDecoder::processSystemImageBGR16(Image<ColorRgb>& image, int targetSiz
 	if (lineSize == 0)
 		lineSize = _actualWidth * 2;
 
+	if (division > 1)
+	{
+		// the 5-6-5 pixels are unpacked before they are summed
+		const int taps = std::min(division, BOX_TAPS);
+		const uint32_t area = static_cast<uint32_t>(taps) * taps;
+		int offsets[BOX_TAPS];
+
+		boxTapOffsets(division, taps, offsets);
+
+		for (int j = 0; j < targetSizeY; j++)
+		{
+			uint8_t* dLine = image.rawMem() + static_cast<size_t>(j) * targetSizeX * 3;
+
+			for (int x = 0; x < targetSizeX; x++, dLine += 3)
+			{
+				uint32_t red = 0, green = 0, blue = 0;
+
+				for (int ky = 0; ky < taps; ky++)
+				{
+					const size_t lineSource = std::min(startY + j * division + offsets[ky], _actualHeight - 1);
+					const uint8_t* cell = source + lineSource * lineSize + (static_cast<size_t>(startX) + static_cast<size_t>(x) * division) * 2;
+
+					for (int kx = 0; kx < taps; kx++)
+					{
+						const uint8_t* pixel = cell + offsets[kx] * 2;
+						red += (pixel[1] & 0xF8);
+						green += (((pixel[1] & 0x7) << 3) | (pixel[0] & 0xE0) >> 5) << 2;
+						blue += (pixel[0] & 0x1f) << 3;
+					}
+				}
+
+				storeBoxPixel(dLine, red, green, blue, area, _lutBuffer);
+			}
+		}
+		return;
+	}
+
 	for (int j = 0; j < targetSizeY; j++)
 	{
 		size_t lineSource = std::min(startY + j * division, _actualHeight - 1);
@@ -643,7 +1786,7 @@ void FrameDecoder::processSystemImageBGR16(Image<ColorRgb>& image, int targetSiz
 void FrameDecoder::processSystemImageRGBA(Image<ColorRgb>& image, int targetSizeX, int targetSizeY,
 											int startX, int startY,
 											uint8_t* source, int _actualWidth, int _actualHeight,
-											int division, uint8_t* _lutBuffer, int lineSize)
+											int division, const uint8_t* _lutBuffer, int lineSize)
 {
 	uint32_t	ind_lutd;
 	uint8_t		buffer[8];
@@ -652,6 +1795,12 @@ void FrameDecoder::processSystemImageRGBA(Image<ColorRgb>& image, int targetSize
 	if (lineSize == 0)
 		lineSize = _actualWidth * 4;
 
+	if (division > 1)
+	{
+		processSystemImageBox<4, 0, 1, 2>(image, targetSizeX, targetSizeY, startX, startY, source, _actualHeight, division, _lutBuffer, lineSize);
+		return;
+	}
+
 	for (int j = 0; j < targetSizeY; j++)
 	{
 		size_t lineSource = std::min(startY + j * division, _actualHeight - 1);
@@ -673,7 +1822,7 @@ void FrameDecoder::processSystemImageRGBA(Image<ColorRgb>& image, int targetSize
 		{
 			*((uint32_t*)&buffer) = *((uint32_t*)sLine);
 			sLine += divisionX;
-			ind_lutd = LUT_INDEX(buffer[2], buffer[1], buffer[0]);
+			ind_lutd = LUT_INDEX(buffer[0], buffer[1], buffer[2]);
 			*((uint32_t*)dLine) = *((uint32_t*)(&_lutBuffer[ind_lutd]));
 			dLine += 3;
 		}
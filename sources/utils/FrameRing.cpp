@@ -0,0 +1,112 @@
+/* FrameRing.cpp
+*
+*  MIT License
+*
+*  Copyright (c) 2023 awawa-dev
+*
+*  Project homesite: https://github.com/awawa-dev/HyperHDR
+*
+*  Permission is hereby granted, free of charge, to any person obtaining a copy
+*  of this software and associated documentation files (the "Software"), to deal
+*  in the Software without restriction, including without limitation the rights
+*  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+*  copies of the Software, and to permit persons to whom the Software is
+*  furnished to do so, subject to the following conditions:
+*
+*  The above copyright notice and this permission notice shall be included in all
+*  copies or substantial portions of the Software.
+
+*  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+*  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+*  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+*  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+*  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+*  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+*  SOFTWARE.
+*/
+
+#include <algorithm>
+
+#include <utils/FrameRing.h>
+
+FrameRing::FrameRing() :
+	_next(0),
+	_acquired(0),
+	_stalls(0),
+	_occupancy(0),
+	_peakOccupancy(0)
+{
+}
+
+void FrameRing::init(int slots)
+{
+	QMutexLocker locker(&_mutex);
+
+	// frames still held by the consumers stay valid, they are only detached from the ring
+	_slots.clear();
+	for (int i = 0; i < slots; i++)
+		_slots.push_back(Image<ColorRgb>());
+
+	_next = 0;
+}
+
+void FrameRing::clear()
+{
+	init(static_cast<int>(_slots.size()));
+}
+
+Image<ColorRgb> FrameRing::acquire(unsigned width, unsigned height)
+{
+	QMutexLocker locker(&_mutex);
+
+	const size_t count = _slots.size();
+	int busy = 0;
+	int found = -1;
+
+	for (size_t i = 0; i < count; i++)
+	{
+		size_t index = (_next + i) % count;
+
+		if (_slots[index].isShared())
+			busy++;
+		else if (found < 0)
+			found = static_cast<int>(index);
+	}
+
+	_acquired++;
+	_occupancy += busy + 1;
+	_peakOccupancy = std::max(_peakOccupancy, busy + 1);
+
+	if (found < 0)
+	{
+		_stalls++;
+		locker.unlock();
+
+		return Image<ColorRgb>(width, height);
+	}
+
+	// the copy is taken under the lock so the slot is seen as busy by the other workers
+	Image<ColorRgb>& slot = _slots[found];
+	slot.resize(width, height);
+	_next = found + 1;
+
+	return slot;
+}
+
+QString FrameRing::getStats()
+{
+	QMutexLocker locker(&_mutex);
+
+	if (_acquired == 0)
+		return "";
+
+	QString retVal = QString("Frame ring: %1 slots, occupancy: %2 average / %3 peak, stalls: %4 of %5 frames").
+		arg(_slots.size()).arg(_occupancy / static_cast<double>(_acquired), 0, 'f', 1).arg(_peakOccupancy).arg(_stalls).arg(_acquired);
+
+	_acquired = 0;
+	_stalls = 0;
+	_occupancy = 0;
+	_peakOccupancy = 0;
+
+	return retVal;
+}
@@ -0,0 +1,123 @@
+/* GlobalSignals.cpp
+*
+*  MIT License
+*
+*  Copyright (c) 2023 awawa-dev
+*
+*  Project homesite: https://github.com/awawa-dev/HyperHDR
+*
+*  Permission is hereby granted, free of charge, to any person obtaining a copy
+*  of this software and associated documentation files (the "Software"), to deal
+*  in the Software without restriction, including without limitation the rights
+*  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+*  copies of the Software, and to permit persons to whom the Software is
+*  furnished to do so, subject to the following conditions:
+*
+*  The above copyright notice and this permission notice shall be included in all
+*  copies or substantial portions of the Software.
+
+*  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+*  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+*  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+*  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+*  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+*  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+*  SOFTWARE.
+*/
+
+
+#include <QMutexLocker>
+
+#include <utils/GlobalSignals.h>
+
+void GlobalSignals::setGlobalInputTargets(hyperhdr::Components component, const QList<int>& instances)
+{
+	QMutexLocker locker(&_routeLock);
+
+	if (instances.isEmpty())
+		_targets.remove(component);
+	else
+		_targets[component] = instances;
+}
+
+void GlobalSignals::subscribeGlobalInput(int instance, GlobalInputChannel* channel)
+{
+	QMutexLocker locker(&_routeLock);
+
+	_channels[instance] = channel;
+}
+
+void GlobalSignals::unsubscribeGlobalInput(int instance, GlobalInputChannel* channel)
+{
+	QMutexLocker locker(&_routeLock);
+
+	// the index may already belong to a new instance
+	if (_channels.value(instance) == channel)
+		_channels.remove(instance);
+}
+
+QList<GlobalInputChannel*> GlobalSignals::targetChannels(hyperhdr::Components component) const
+{
+	auto targets = _targets.find(component);
+
+	if (targets == _targets.end())
+		return _channels.values();
+
+	QList<GlobalInputChannel*> channels;
+	for (int instance : targets.value())
+	{
+		GlobalInputChannel* channel = _channels.value(instance, nullptr);
+		if (channel != nullptr)
+			channels.append(channel);
+	}
+
+	return channels;
+}
+
+void GlobalSignals::routeRegisterInput(int priority, hyperhdr::Components component, const QString& origin, const QString& owner, unsigned smooth_cfg)
+{
+	{
+		QMutexLocker locker(&_routeLock);
+
+		for (GlobalInputChannel* channel : targetChannels(component))
+			emit channel->registerGlobalInput(priority, component, origin, owner, smooth_cfg);
+	}
+
+	emit registerGlobalInput(priority, component, origin, owner, smooth_cfg);
+}
+
+void GlobalSignals::routeClearInput(hyperhdr::Components component, int priority, bool forceClearAll)
+{
+	{
+		QMutexLocker locker(&_routeLock);
+
+		for (GlobalInputChannel* channel : targetChannels(component))
+			emit channel->clearGlobalInput(priority, forceClearAll);
+	}
+
+	emit clearGlobalInput(priority, forceClearAll);
+}
+
+void GlobalSignals::routeImage(hyperhdr::Components component, int priority, const Image<ColorRgb>& image, int timeout_ms, bool clearEffect)
+{
+	{
+		QMutexLocker locker(&_routeLock);
+
+		for (GlobalInputChannel* channel : targetChannels(component))
+			emit channel->setGlobalImage(priority, image, timeout_ms, clearEffect);
+	}
+
+	emit setGlobalImage(priority, image, timeout_ms, clearEffect);
+}
+
+void GlobalSignals::routeColor(hyperhdr::Components component, int priority, const std::vector<ColorRgb>& ledColor, int timeout_ms, const QString& origin, bool clearEffects)
+{
+	{
+		QMutexLocker locker(&_routeLock);
+
+		for (GlobalInputChannel* channel : targetChannels(component))
+			emit channel->setGlobalColor(priority, ledColor, timeout_ms, origin, clearEffects);
+	}
+
+	emit setGlobalColor(priority, ledColor, timeout_ms, origin, clearEffects);
+}
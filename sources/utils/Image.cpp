@@ -142,4 +142,62 @@ void Image<ColorSpace>::clear()
 	_d_ptr->clear();
 }
 
+template <typename ColorSpace>
+bool Image<ColorSpace>::isShared() const
+{
+	return _d_ptr->ref.loadAcquire() > 1;
+}
+
+template <typename ColorSpace>
+int64_t Image<ColorSpace>::timestamp() const
+{
+	return _d_ptr->timestamp();
+}
+
+template <typename ColorSpace>
+void Image<ColorSpace>::setTimestamp(int64_t timestamp)
+{
+	_d_ptr->setTimestamp(timestamp);
+}
+
+template <typename ColorSpace>
+void Image<ColorSpace>::setCaptureTrace(int64_t dequeued, int64_t decoded)
+{
+	_d_ptr->setCaptureTrace(dequeued, decoded);
+}
+
+template <typename ColorSpace>
+FrameTrace Image<ColorSpace>::trace() const
+{
+	FrameTrace trace;
+	trace.timestamp = _d_ptr->timestamp();
+	trace.stamps[FrameTrace::DEQUEUED] = _d_ptr->dequeuedTime();
+	trace.stamps[FrameTrace::DECODED] = _d_ptr->decodedTime();
+	return trace;
+}
+
+template <typename ColorSpace>
+const std::shared_ptr<const LutSnapshot>& Image<ColorSpace>::deferredToneMapping() const
+{
+	return _d_ptr->deferredToneMapping();
+}
+
+template <typename ColorSpace>
+void Image<ColorSpace>::setDeferredToneMapping(const std::shared_ptr<const LutSnapshot>& lut)
+{
+	_d_ptr->setDeferredToneMapping(lut);
+}
+
+template <typename ColorSpace>
+const std::shared_ptr<const ImagePyramid>& Image<ColorSpace>::pyramid() const
+{
+	return _d_ptr->pyramid();
+}
+
+template <typename ColorSpace>
+void Image<ColorSpace>::setPyramid(const std::shared_ptr<const ImagePyramid>& pyramid)
+{
+	_d_ptr->setPyramid(pyramid);
+}
+
 template class Image<ColorRgb>;
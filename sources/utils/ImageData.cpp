@@ -35,7 +35,7 @@
 
 #include <utils/ImageData.h>
 
-#define LOCAL_VID_ALIGN_SIZE       16
+#define LOCAL_VID_ALIGN_SIZE       VideoMemoryManagerAlignment
 
 static_assert (sizeof(ColorRgb) < LOCAL_VID_ALIGN_SIZE && sizeof(ColorRgb) <= sizeof(uint64_t), "Unexpected image size");
 
@@ -47,7 +47,10 @@ ImageData<ColorSpace>::ImageData(unsigned width, unsigned height) :
 	_width(width),
 	_height(height),
 	_initData(0),
-	_pixels(getMemory(width, height))
+	_pixels(getMemory(width, height)),
+	_timestamp(0),
+	_dequeuedTime(0),
+	_decodedTime(0)
 {
 }
 
@@ -58,7 +61,12 @@ ImageData<ColorSpace>::ImageData(const ImageData<ColorSpace>& other) :
 	_height(other._height),
 	_initData(other._initData),
 	_pixels(other._pixels),
-	_bufferSize(other._bufferSize)
+	_bufferSize(other._bufferSize),
+	_timestamp(other._timestamp),
+	_dequeuedTime(other._dequeuedTime),
+	_decodedTime(other._decodedTime),
+	_deferredLut(other._deferredLut),
+	_pyramid(other._pyramid)
 {
 }
 
@@ -104,7 +112,12 @@ void ImageData<ColorSpace>::resize(unsigned width, unsigned height)
 	if (width == _width && height == _height)
 		return;
 
-	if ((width * height) > unsigned((_width * _height)))
+	_pyramid.reset();
+
+	// keep the current buffer if it is large enough: frame slots are resized often
+	const size_t capacity = (_bufferSize > LOCAL_VID_ALIGN_SIZE) ? _bufferSize - LOCAL_VID_ALIGN_SIZE : _bufferSize;
+
+	if (static_cast<size_t>(width) * height * sizeof(ColorSpace) > capacity)
 	{
 		freeMemory();
 		_pixels = getMemory(width, height);
@@ -135,6 +148,61 @@ void ImageData<ColorRgb>::toRgb(ImageData<ColorRgb>& image) const
 	memcpy(image.rawMem(), _pixels, static_cast<size_t>(_width) * _height * 3);
 }
 
+template <typename ColorSpace>
+int64_t ImageData<ColorSpace>::timestamp() const
+{
+	return _timestamp;
+}
+
+template <typename ColorSpace>
+void ImageData<ColorSpace>::setTimestamp(int64_t timestamp)
+{
+	_timestamp = timestamp;
+}
+
+template <typename ColorSpace>
+int64_t ImageData<ColorSpace>::dequeuedTime() const
+{
+	return _dequeuedTime;
+}
+
+template <typename ColorSpace>
+int64_t ImageData<ColorSpace>::decodedTime() const
+{
+	return _decodedTime;
+}
+
+template <typename ColorSpace>
+void ImageData<ColorSpace>::setCaptureTrace(int64_t dequeued, int64_t decoded)
+{
+	_dequeuedTime = dequeued;
+	_decodedTime = decoded;
+}
+
+template <typename ColorSpace>
+const std::shared_ptr<const LutSnapshot>& ImageData<ColorSpace>::deferredToneMapping() const
+{
+	return _deferredLut;
+}
+
+template <typename ColorSpace>
+void ImageData<ColorSpace>::setDeferredToneMapping(const std::shared_ptr<const LutSnapshot>& lut)
+{
+	_deferredLut = lut;
+}
+
+template <typename ColorSpace>
+const std::shared_ptr<const ImagePyramid>& ImageData<ColorSpace>::pyramid() const
+{
+	return _pyramid;
+}
+
+template <typename ColorSpace>
+void ImageData<ColorSpace>::setPyramid(const std::shared_ptr<const ImagePyramid>& pyramid)
+{
+	_pyramid = pyramid;
+}
+
 template <typename ColorSpace>
 size_t ImageData<ColorSpace>::size() const
 {
@@ -0,0 +1,195 @@
+/* ImageIngest.cpp
+*
+*  MIT License
+*
+*  Copyright (c) 2023 awawa-dev
+*
+*  Project homesite: https://github.com/awawa-dev/HyperHDR
+*
+*  Permission is hereby granted, free of charge, to any person obtaining a copy
+*  of this software and associated documentation files (the "Software"), to deal
+*  in the Software without restriction, including without limitation the rights
+*  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+*  copies of the Software, and to permit persons to whom the Software is
+*  furnished to do so, subject to the following conditions:
+*
+*  The above copyright notice and this permission notice shall be included in all
+*  copies or substantial portions of the Software.
+
+*  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+*  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+*  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+*  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+*  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+*  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+*  SOFTWARE.
+*/
+
+
+#include <algorithm>
+#include <cstring>
+#include <vector>
+
+#include <QMutexLocker>
+
+#include <utils/ImageIngest.h>
+#include <utils/FrameDecoder.h>
+
+namespace
+{
+	/// the smallest reduced image, the same limit as FrameDecoder::getDownscaleFactor
+	const int MIN_INGEST_SIZE = 16;
+}
+
+QMutex ImageIngest::_locker;
+std::map<int, std::pair<int, int>> ImageIngest::_sizes;
+
+void ImageIngest::setRequiredSize(int owner, int width, int height)
+{
+	QMutexLocker locker(&_locker);
+
+	if (width <= 0 || height <= 0)
+		_sizes.erase(owner);
+	else
+		_sizes[owner] = std::make_pair(width, height);
+}
+
+int ImageIngest::getFactor(int width, int height)
+{
+	int requiredWidth = 0;
+	int requiredHeight = 0;
+
+	{
+		QMutexLocker locker(&_locker);
+
+		for (const auto& size : _sizes)
+		{
+			requiredWidth = std::max(requiredWidth, size.second.first);
+			requiredHeight = std::max(requiredHeight, size.second.second);
+		}
+	}
+
+	if (requiredWidth <= 0 || requiredHeight <= 0)
+		return 1;
+
+	int factor = std::min(width / requiredWidth, height / requiredHeight);
+
+	while (factor > 1 && (width / factor < MIN_INGEST_SIZE || height / factor < MIN_INGEST_SIZE))
+		factor--;
+
+	return std::max(factor, 1);
+}
+
+void ImageIngest::reduce(const uint8_t* source, unsigned width, unsigned height, int factor, const uint8_t* lutBuffer, int hdrToneMappingEnabled,
+	const CompactLut* compactLut, Image<ColorRgb>& output)
+{
+	if (factor <= 1)
+	{
+		memcpy(output.rawMem(), source, output.size());
+		FrameDecoder::applyLUT(output.rawMem(), output.width(), output.height(), lutBuffer, hdrToneMappingEnabled, compactLut);
+		return;
+	}
+
+	const unsigned outputWidth = output.width();
+	const unsigned outputHeight = output.height();
+	const size_t usedWidth = static_cast<size_t>(outputWidth) * factor;
+	const uint32_t area = static_cast<uint32_t>(factor) * factor;
+	const bool toneMapping = hdrToneMappingEnabled && (lutBuffer != nullptr || (compactLut != nullptr && compactLut->isValid()));
+
+	// the HDR mode 2 maps only the frame used by the led border: the same area as FrameDecoder::applyLUT of the full image
+	const unsigned sizeX = (width * 10) / 100;
+	const unsigned sizeY = (height * 25) / 100;
+
+	// padding for the 4 byte reads of the LUT
+	std::vector<uint8_t>  line(usedWidth * 3 + 8);
+	std::vector<uint32_t> sum(static_cast<size_t>(outputWidth) * 3);
+
+	uint8_t* destMemory = output.rawMem();
+
+	for (unsigned yDest = 0; yDest < outputHeight; yDest++)
+	{
+		std::fill(sum.begin(), sum.end(), 0);
+
+		for (int k = 0; k < factor; k++)
+		{
+			const unsigned y = yDest * factor + k;
+			const uint8_t* pixel = source + static_cast<size_t>(width) * 3 * y;
+
+			if (toneMapping)
+			{
+				memcpy(line.data(), pixel, usedWidth * 3);
+
+				if (hdrToneMappingEnabled != 2 || y < sizeY || y > height - sizeY)
+					FrameDecoder::applyLUT(line.data(), static_cast<unsigned>(usedWidth), 1, lutBuffer, 1, compactLut);
+				else
+				{
+					FrameDecoder::applyLUT(line.data(), std::min(sizeX, static_cast<unsigned>(usedWidth)), 1, lutBuffer, 1, compactLut);
+					if (width - sizeX < usedWidth)
+						FrameDecoder::applyLUT(line.data() + static_cast<size_t>(width - sizeX) * 3, static_cast<unsigned>(usedWidth - (width - sizeX)), 1, lutBuffer, 1, compactLut);
+				}
+
+				pixel = line.data();
+			}
+
+			uint32_t* acc = sum.data();
+			for (size_t x = 0; x < usedWidth; x += factor, acc += 3)
+				for (int i = 0; i < factor; i++, pixel += 3)
+				{
+					acc[0] += pixel[0];
+					acc[1] += pixel[1];
+					acc[2] += pixel[2];
+				}
+		}
+
+		uint8_t* currentDest = destMemory + static_cast<size_t>(outputWidth) * 3 * yDest;
+		for (size_t i = 0; i < sum.size(); i++)
+			currentDest[i] = static_cast<uint8_t>((sum[i] + area / 2) / area);
+	}
+}
+
+void ImageIngest::reduce(const uint8_t* source, unsigned width, unsigned height, int factor, const LutHandle& lut, int hdrToneMappingEnabled,
+	Image<ColorRgb>& output)
+{
+	const bool deferred = (hdrToneMappingEnabled == LED_TONE_MAPPING && lut != nullptr);
+
+	if (deferred || lut == nullptr)
+		reduce(source, width, height, factor, nullptr, 0, nullptr, output);
+	else
+		reduce(source, width, height, factor, lut->buffer(), hdrToneMappingEnabled, lut->compactLut(), output);
+
+	// the frames of the rings are reused, the LUT of the previous one must not stay
+	output.setDeferredToneMapping((deferred) ? lut : nullptr);
+}
+
+void ImageIngest::applyDeferred(const Image<ColorRgb>& image, std::vector<ColorRgb>& colors)
+{
+	const LutHandle& lut = image.deferredToneMapping();
+
+	if (lut == nullptr)
+		return;
+
+	const uint8_t* lutBuffer = lut->buffer();
+	const CompactLut* compactLut = lut->compactLut();
+
+	for (ColorRgb& color : colors)
+	{
+		if (compactLut != nullptr)
+			compactLut->lookup(color.red, color.green, color.blue, &color.red);
+		else if (lutBuffer != nullptr)
+			memcpy(&color.red, &lutBuffer[LUT_INDEX(color.red, color.green, color.blue)], 3);
+	}
+}
+
+Image<ColorRgb> ImageIngest::resolveDeferred(const Image<ColorRgb>& image)
+{
+	const LutHandle& lut = image.deferredToneMapping();
+
+	if (lut == nullptr)
+		return image;
+
+	Image<ColorRgb> mapped(image.width(), image.height());
+	reduce(image.rawMem(), image.width(), image.height(), 1, lut->buffer(), 1, lut->compactLut(), mapped);
+	mapped.setTimestamp(image.timestamp());
+
+	return mapped;
+}
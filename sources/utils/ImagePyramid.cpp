@@ -0,0 +1,116 @@
+#include <utils/ImagePyramid.h>
+#include <utils/InternalClock.h>
+
+#include <algorithm>
+#include <memory>
+
+namespace
+{
+	// a level that no consumer asked for in that time is not built anymore
+	const int64_t DEMAND_TIMEOUT = 3000;
+
+	// 2x2 box filter, the odd last row and column are dropped
+	void halve(const Image<ColorRgb>& source, Image<ColorRgb>& target)
+	{
+		const unsigned width = target.width();
+		const unsigned height = target.height();
+		const size_t sourceLine = static_cast<size_t>(source.width()) * 3;
+		uint8_t* output = target.rawMem();
+
+		for (unsigned y = 0; y < height; y++)
+		{
+			const uint8_t* upper = source.rawMem() + 2 * y * sourceLine;
+			const uint8_t* lower = upper + sourceLine;
+
+			for (unsigned x = 0; x < width; x++, upper += 6, lower += 6)
+			{
+				*(output++) = static_cast<uint8_t>((upper[0] + upper[3] + lower[0] + lower[3] + 2) >> 2);
+				*(output++) = static_cast<uint8_t>((upper[1] + upper[4] + lower[1] + lower[4] + 2) >> 2);
+				*(output++) = static_cast<uint8_t>((upper[2] + upper[5] + lower[2] + lower[5] + 2) >> 2);
+			}
+		}
+	}
+}
+
+std::atomic<int64_t> ImagePyramid::_requested[ImagePyramid::LEVELS];
+
+ImagePyramid::ImagePyramid(const Image<ColorRgb>& image, int levels)
+	: _levels()
+	, _timestamp(image.timestamp())
+	, _width(image.width())
+	, _height(image.height())
+{
+	const Image<ColorRgb>* source = &image;
+
+	// every level is reduced from the previous one, they must not move
+	_levels.reserve(levels);
+
+	for (int level = 1; level <= levels && source->width() >= 2 && source->height() >= 2; level++)
+	{
+		_levels.push_back(Image<ColorRgb>(source->width() / 2, source->height() / 2));
+
+		Image<ColorRgb>& target = _levels.back();
+		halve(*source, target);
+
+		// the level is the same frame: the consumers keep its time and the tone mapping that is still to be applied
+		target.setTimestamp(image.timestamp());
+		target.setDeferredToneMapping(image.deferredToneMapping());
+
+		source = &target;
+	}
+}
+
+int ImagePyramid::levelCount() const
+{
+	return static_cast<int>(_levels.size());
+}
+
+const Image<ColorRgb>& ImagePyramid::get(int level) const
+{
+	return _levels[level - 1];
+}
+
+void ImagePyramid::attach(const Image<ColorRgb>& image)
+{
+	const int64_t now = InternalClock::now();
+	int levels = 0;
+
+	for (int level = LEVELS; level > 0 && levels == 0; level--)
+		if (now - _requested[level - 1] < DEMAND_TIMEOUT)
+			levels = level;
+
+	// the copy of the handle shares the data: the pyramid of a reused frame is always replaced
+	Image<ColorRgb> frame = image;
+
+	if (levels == 0 || image.width() < 2 || image.height() < 2)
+		frame.setPyramid(nullptr);
+	else
+		frame.setPyramid(std::make_shared<const ImagePyramid>(image, levels));
+}
+
+Image<ColorRgb> ImagePyramid::level(const Image<ColorRgb>& image, int& factor)
+{
+	// the largest power of two that divides the factor, so the rest of the reduction is an integer
+	int wanted = 0;
+	while (wanted < LEVELS && factor % (2 << wanted) == 0)
+		wanted++;
+
+	if (wanted == 0)
+		return image;
+
+	_requested[wanted - 1] = InternalClock::now();
+
+	const std::shared_ptr<const ImagePyramid>& pyramid = image.pyramid();
+
+	if (pyramid == nullptr || pyramid->_timestamp != image.timestamp() ||
+		pyramid->_width != image.width() || pyramid->_height != image.height())
+		return image;
+
+	const int available = std::min(wanted, pyramid->levelCount());
+
+	if (available == 0)
+		return image;
+
+	factor >>= available;
+	return pyramid->get(available);
+}
@@ -0,0 +1,155 @@
+/* LatencyHistogram.cpp
+*
+*  MIT License
+*
+*  Copyright (c) 2023 awawa-dev
+*
+*  Project homesite: https://github.com/awawa-dev/HyperHDR
+*
+*  Permission is hereby granted, free of charge, to any person obtaining a copy
+*  of this software and associated documentation files (the "Software"), to deal
+*  in the Software without restriction, including without limitation the rights
+*  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+*  copies of the Software, and to permit persons to whom the Software is
+*  furnished to do so, subject to the following conditions:
+*
+*  The above copyright notice and this permission notice shall be included in all
+*  copies or substantial portions of the Software.
+
+*  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+*  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+*  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+*  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+*  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+*  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+*  SOFTWARE.
+ */
+
+#include <cstring>
+#include <algorithm>
+
+#include <utils/LatencyHistogram.h>
+
+LatencyHistogram::LatencyHistogram(int resolution_us)
+	: _resolution_us(std::max(resolution_us, 1))
+{
+	clear();
+}
+
+int LatencyHistogram::bucketIndex(uint32_t value)
+{
+	if (value < 2 * LatencyHistogramSubBuckets)
+		return static_cast<int>(value);
+
+	// the highest bit selects the power of two, the next 5 bits the bucket inside it
+	int msb = 31;
+	while ((value & (1u << msb)) == 0)
+		msb--;
+
+	const int shift = msb - 5;
+	return 2 * LatencyHistogramSubBuckets + (msb - 6) * LatencyHistogramSubBuckets + static_cast<int>((value >> shift) - LatencyHistogramSubBuckets);
+}
+
+uint32_t LatencyHistogram::bucketUpperBound(int index)
+{
+	if (index < 2 * LatencyHistogramSubBuckets)
+		return static_cast<uint32_t>(index);
+
+	const int octave = (index - 2 * LatencyHistogramSubBuckets) / LatencyHistogramSubBuckets;
+	const int sub = (index - 2 * LatencyHistogramSubBuckets) % LatencyHistogramSubBuckets;
+	const uint64_t bound = ((static_cast<uint64_t>(LatencyHistogramSubBuckets + sub + 1)) << (octave + 1)) - 1;
+
+	return static_cast<uint32_t>(std::min(bound, static_cast<uint64_t>(UINT32_MAX)));
+}
+
+void LatencyHistogram::add(int64_t latency)
+{
+	const uint32_t value = static_cast<uint32_t>(std::min(std::max(latency, int64_t(0)), int64_t(INT32_MAX)));
+
+	_buckets[bucketIndex(value)]++;
+	_count++;
+	_sum += value;
+	_maximum = std::max(_maximum, static_cast<int>(value));
+}
+
+void LatencyHistogram::clear()
+{
+	memset(_buckets, 0, sizeof(_buckets));
+	_count = 0;
+	_sum = 0;
+	_maximum = 0;
+}
+
+void LatencyHistogram::merge(const LatencyHistogram& other)
+{
+	for (int i = 0; i < LatencyHistogramBuckets; i++)
+		_buckets[i] += other._buckets[i];
+
+	_count += other._count;
+	_sum += other._sum;
+	_maximum = std::max(_maximum, other._maximum);
+}
+
+uint64_t LatencyHistogram::count() const
+{
+	return _count;
+}
+
+double LatencyHistogram::average() const
+{
+	return (_count > 0) ? static_cast<double>(_sum) / _count : 0.0;
+}
+
+int LatencyHistogram::percentile(int percent) const
+{
+	if (_count == 0)
+		return 0;
+
+	uint64_t wanted = std::max((_count * percent + 99) / 100, uint64_t(1));
+	uint64_t total = 0;
+
+	for (int i = 0; i < LatencyHistogramBuckets; i++)
+	{
+		total += _buckets[i];
+		if (total >= wanted)
+			return std::min(static_cast<int>(bucketUpperBound(i)), _maximum);
+	}
+
+	return _maximum;
+}
+
+int LatencyHistogram::maximum() const
+{
+	return _maximum;
+}
+
+int LatencyHistogram::resolution() const
+{
+	return _resolution_us;
+}
+
+QString LatencyHistogram::toString() const
+{
+	// whole milliseconds for the default resolution
+	const double unit = _resolution_us / 1000.0;
+	const int precision = (_resolution_us < 1000) ? 1 : 0;
+
+	return QString("avg %1ms, p50 %2ms, p90 %3ms, p99 %4ms, max %5ms").arg(average() * unit, 0, 'f', precision + 1).
+		arg(percentile(50) * unit, 0, 'f', precision).arg(percentile(90) * unit, 0, 'f', precision).
+		arg(percentile(99) * unit, 0, 'f', precision).arg(maximum() * unit, 0, 'f', precision);
+}
+
+QJsonObject LatencyHistogram::toJson() const
+{
+	const double unit = _resolution_us / 1000.0;
+	QJsonObject distribution;
+
+	distribution["count"] = static_cast<qint64>(_count);
+	distribution["avg"] = average() * unit;
+	distribution["p50"] = percentile(50) * unit;
+	distribution["p90"] = percentile(90) * unit;
+	distribution["p99"] = percentile(99) * unit;
+	distribution["max"] = maximum() * unit;
+
+	return distribution;
+}
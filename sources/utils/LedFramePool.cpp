@@ -0,0 +1,55 @@
+/* LedFramePool.cpp
+*
+*  MIT License
+*
+*  Copyright (c) 2023 awawa-dev
+*
+*  Project homesite: https://github.com/awawa-dev/HyperHDR
+*
+*  Permission is hereby granted, free of charge, to any person obtaining a copy
+*  of this software and associated documentation files (the "Software"), to deal
+*  in the Software without restriction, including without limitation the rights
+*  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+*  copies of the Software, and to permit persons to whom the Software is
+*  furnished to do so, subject to the following conditions:
+*
+*  The above copyright notice and this permission notice shall be included in all
+*  copies or substantial portions of the Software.
+
+*  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+*  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+*  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+*  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+*  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+*  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+*  SOFTWARE.
+*/
+
+#include <atomic>
+
+#include <utils/LedFramePool.h>
+
+LedFramePool::LedFramePool()
+{
+	_frames.reserve(POOL_SIZE);
+}
+
+LedFrame LedFramePool::make(const std::vector<ColorRgb>& colors)
+{
+	for (std::shared_ptr<std::vector<ColorRgb>>& frame : _frames)
+		if (frame.use_count() == 1)
+		{
+			// the receiver has finished reading the frame before it dropped the last reference
+			std::atomic_thread_fence(std::memory_order_acquire);
+
+			frame->assign(colors.begin(), colors.end());
+			return frame;
+		}
+
+	std::shared_ptr<std::vector<ColorRgb>> frame = std::make_shared<std::vector<ColorRgb>>(colors);
+
+	if (_frames.size() < POOL_SIZE)
+		_frames.push_back(frame);
+
+	return frame;
+}
@@ -0,0 +1,197 @@
+/* LedFrameReplay.cpp
+*
+*  MIT License
+*
+*  Copyright (c) 2023 awawa-dev
+*
+*  Project homesite: https://github.com/awawa-dev/HyperHDR
+*
+*  Permission is hereby granted, free of charge, to any person obtaining a copy
+*  of this software and associated documentation files (the "Software"), to deal
+*  in the Software without restriction, including without limitation the rights
+*  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+*  copies of the Software, and to permit persons to whom the Software is
+*  furnished to do so, subject to the following conditions:
+*
+*  The above copyright notice and this permission notice shall be included in all
+*  copies or substantial portions of the Software.
+
+*  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+*  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+*  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+*  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+*  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+*  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+*  SOFTWARE.
+*/
+
+
+// util
+#include <utils/LedFrameReplay.h>
+#include <utils/LedFrameRecording.h>
+#include <utils/PreciseTimer.h>
+#include <base/HyperHdrInstance.h>
+
+// qt
+#include <QTimer>
+#include <QFileInfo>
+
+#include <cstring>
+
+LedFrameReplay::LedFrameReplay(HyperHdrInstance* hyperhdr, QObject* parent)
+	: QObject(parent)
+	, _hyperhdr(hyperhdr)
+	, _log(Logger::getInstance("REPLAY"))
+	, _timer(new QTimer(this))
+	, _data(nullptr)
+	, _ledCount(0)
+	, _recordSize(0)
+	, _frames(0)
+	, _next(0)
+	, _speed(1.0)
+	, _priority(0)
+	, _startTime(0)
+	, _played(0)
+	, _skipped(0)
+{
+	_timer->setSingleShot(true);
+	_timer->setTimerType(Qt::PreciseTimer);
+	connect(_timer, &QTimer::timeout, this, &LedFrameReplay::playNext);
+}
+
+LedFrameReplay::~LedFrameReplay()
+{
+	stop();
+}
+
+QString LedFrameReplay::start(const QString& fileName, double speed, int priority)
+{
+	stop();
+
+	_file.setFileName(fileName);
+	if (!_file.open(QIODevice::ReadOnly))
+	{
+		return QString("Could not open the recording: %1").arg(_file.errorString());
+	}
+
+	LedFrameRecording::Header header;
+	if (_file.size() < static_cast<qint64>(sizeof(header)) ||
+		_file.read(reinterpret_cast<char*>(&header), sizeof(header)) != sizeof(header) ||
+		!LedFrameRecording::isValid(header))
+	{
+		_file.close();
+		return QString("Not a HyperHDR LED recording: %1").arg(fileName);
+	}
+
+	_ledCount = header.ledCount;
+	_recordSize = LedFrameRecording::recordSize(_ledCount);
+	_frames = (_file.size() - static_cast<qint64>(sizeof(header))) / static_cast<qint64>(_recordSize);
+
+	_data = (_frames > 0) ? _file.map(0, _file.size()) : nullptr;
+	if (_data == nullptr)
+	{
+		_file.close();
+		return (_frames > 0) ? QString("Could not map the recording: %1").arg(_file.errorString()) : QString("The recording is empty");
+	}
+
+	_speed = qBound(0.1, speed, 10.0);
+	_priority = priority;
+	_next = 0;
+	_played = 0;
+	_skipped = 0;
+	_colors.resize(qMax(_hyperhdr->getLedCount(), 1));
+
+	Info(_log, "Replaying %lld frames of %d LEDs (%.1f s) at %.1f x speed, priority %d: %s",
+		static_cast<long long>(_frames), static_cast<int>(_ledCount), frameTime(_frames - 1) / 1000000000.0, _speed, _priority, QSTRING_CSTR(fileName));
+
+	if (static_cast<int>(_ledCount) != static_cast<int>(_colors.size()))
+		Warning(_log, "The recording has %d LEDs, the instance %d: the frames are cut or padded with black", static_cast<int>(_ledCount), static_cast<int>(_colors.size()));
+
+	_hyperhdr->registerInput(_priority, hyperhdr::COMP_COLOR, QString("Replay@%1").arg(QFileInfo(fileName).fileName()));
+
+	_startTime = PreciseTimer::now();
+	playNext();
+
+	return QString();
+}
+
+void LedFrameReplay::stop()
+{
+	if (!isActive())
+		return;
+
+	_timer->stop();
+
+	const double elapsed = (PreciseTimer::now() - _startTime) / 1000000000.0;
+	Info(_log, "Replay finished: %lld frames sent, %lld skipped as late, %.1f s", static_cast<long long>(_played), static_cast<long long>(_skipped), elapsed);
+
+	_file.unmap(const_cast<uchar*>(_data));
+	_file.close();
+	_data = nullptr;
+
+	_hyperhdr->clear(_priority);
+}
+
+bool LedFrameReplay::isActive() const
+{
+	return _data != nullptr;
+}
+
+const uchar* LedFrameReplay::record(qint64 index) const
+{
+	return _data + sizeof(LedFrameRecording::Header) + static_cast<size_t>(index) * _recordSize;
+}
+
+int64_t LedFrameReplay::frameTime(qint64 index) const
+{
+	int64_t time;
+	memcpy(&time, record(index), sizeof(time));
+	return time;
+}
+
+void LedFrameReplay::playNext()
+{
+	if (!isActive())
+		return;
+
+	if (_next >= _frames)
+	{
+		stop();
+		return;
+	}
+
+	const int64_t now = PreciseTimer::now();
+	const int64_t elapsed = static_cast<int64_t>((now - _startTime) * _speed);
+
+	// the newest frame that is due, the older ones are late
+	qint64 current = _next;
+	while (current + 1 < _frames && frameTime(current + 1) <= elapsed)
+	{
+		current++;
+		_skipped++;
+	}
+
+	if (frameTime(current) <= elapsed)
+	{
+		const uchar* colors = record(current) + sizeof(int64_t);
+		const size_t count = qMin(_colors.size(), static_cast<size_t>(_ledCount));
+
+		memcpy(_colors.data(), colors, count * 3);
+		if (count < _colors.size())
+			memset(_colors.data() + count, 0, (_colors.size() - count) * 3);
+
+		_hyperhdr->setInput(_priority, _colors);
+
+		_played++;
+		_next = current + 1;
+	}
+
+	if (_next >= _frames)
+	{
+		stop();
+		return;
+	}
+
+	const int64_t due = _startTime + static_cast<int64_t>(frameTime(_next) / _speed);
+	_timer->start(static_cast<int>(qMax<int64_t>((due - PreciseTimer::now() + 999999) / 1000000, 0)));
+}
@@ -3,6 +3,11 @@
 
 #include <iostream>
 #include <algorithm>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
+#include <cstring>
 
 #ifndef _WIN32
 	#include <syslog.h>
@@ -15,13 +20,15 @@
 #include <QDateTime>
 #include <QFileInfo>
 #include <QMutexLocker>
+#include <QReadLocker>
+#include <QWriteLocker>
 #include <QThreadStorage>
 
 #include <time.h>
 
 
 
-QMutex                 Logger::_mapLock;
+QReadWriteLock         Logger::_mapLock;
 QMap<QString, Logger*> Logger::_loggerMap;
 QAtomicInteger<int>    Logger::GLOBAL_MIN_LOG_LEVEL{ static_cast<int>(Logger::UNSET) };
 
@@ -39,8 +46,25 @@ namespace
 	QAtomicInteger<unsigned int> LoggerId = 0;
 
 	const int MaxRepeatCountSize = 200;
-	QThreadStorage<int> RepeatCount;
-	QThreadStorage<Logger::T_LOG_MESSAGE> RepeatMessage;
+
+	const size_t MAX_MESSAGE_LENGTH = 1024;
+
+	/// a preformatted message waiting for the logger thread
+	struct LogRecord
+	{
+		Logger*          logger = nullptr;
+		// string literals of the call site
+		const char*      file = "";
+		const char*      function = "";
+		unsigned int     line = 0;
+		Logger::LogLevel level = Logger::INFO;
+		qint64           utime = 0;
+		char             message[MAX_MESSAGE_LENGTH] = {};
+	};
+
+	// the last message of the thread, to fold the repeated lines
+	thread_local LogRecord RepeatMessage;
+	thread_local int       RepeatCount = 0;
 
 	QString getApplicationName()
 	{
@@ -48,9 +72,237 @@ namespace
 	}
 }
 
+/**
+ * The backend of the loggers: the callers put the preformatted records into a bounded multi-producer
+ * ring (Vyukov's queue, a sequence number per slot) and one thread builds the messages, prints them and
+ * emits them to the UI buffer and the JSON API. A full ring drops the debug/info records (they are counted
+ * and reported), the warnings and errors are written by the caller then so they are never lost.
+ */
+class LogWriter
+{
+public:
+	static LogWriter& getInstance()
+	{
+		static LogWriter instance;
+		return instance;
+	}
+
+	bool push(const LogRecord& record)
+	{
+		if (!_running.load(std::memory_order_acquire))
+			return false;
+
+		size_t pos = _enqueuePos.load(std::memory_order_relaxed);
+		Slot* slot;
+
+		for (;;)
+		{
+			slot = &_slots[pos & (SLOTS - 1)];
+			const size_t sequence = slot->sequence.load(std::memory_order_acquire);
+			const intptr_t diff = static_cast<intptr_t>(sequence) - static_cast<intptr_t>(pos);
+
+			if (diff == 0)
+			{
+				if (_enqueuePos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+					break;
+			}
+			else if (diff < 0)
+			{
+				// full
+				if (record.level < Logger::WARNING)
+				{
+					_dropped.fetch_add(1, std::memory_order_relaxed);
+					return true;
+				}
+				return false;
+			}
+			else
+				pos = _enqueuePos.load(std::memory_order_relaxed);
+		}
+
+		copyRecord(slot->record, record);
+		slot->sequence.store(pos + 1, std::memory_order_release);
+
+		// wake up the writer only when it's waiting
+		std::atomic_thread_fence(std::memory_order_seq_cst);
+		if (_sleeping.load(std::memory_order_relaxed))
+		{
+			std::lock_guard<std::mutex> lock(_wakeLock);
+			_wake.notify_one();
+		}
+
+		return true;
+	}
+
+	///
+	/// @brief Wait until the records queued so far are written (max 2s)
+	///
+	void flush()
+	{
+		const size_t target = _enqueuePos.load(std::memory_order_acquire);
+
+		for (int i = 0; i < 2000 && _running.load(std::memory_order_acquire) && _written.load(std::memory_order_acquire) < target; i++)
+		{
+			{
+				std::lock_guard<std::mutex> lock(_wakeLock);
+				_wake.notify_one();
+			}
+			std::this_thread::sleep_for(std::chrono::milliseconds(1));
+		}
+	}
+
+	///
+	/// @brief Write the queued records and stop the thread, the later messages are written by the callers
+	///
+	void stop()
+	{
+		if (!_running.exchange(false))
+			return;
+
+		{
+			std::lock_guard<std::mutex> lock(_wakeLock);
+			_wake.notify_one();
+		}
+
+		if (_thread.joinable())
+			_thread.join();
+	}
+
+	static void write(const LogRecord& record)
+	{
+		Logger::T_LOG_MESSAGE logMsg;
+
+		logMsg.appName = record.logger->_appname;
+		logMsg.loggerName = record.logger->_name;
+		logMsg.function = QString(record.function);
+		logMsg.line = record.line;
+		logMsg.fileName = FileUtils::getBaseName(record.file);
+		logMsg.utime = record.utime;
+		logMsg.message = QString(record.message);
+		logMsg.level = record.level;
+		logMsg.levelString = LogLevelStrings[record.level];
+
+		record.logger->write(logMsg);
+#ifndef _WIN32
+		if (record.logger->_syslogEnabled && record.level >= Logger::WARNING)
+			syslog(LogLevelSysLog[record.level], "%s", record.message);
+#endif
+	}
+
+	static void copyRecord(LogRecord& target, const LogRecord& source)
+	{
+		target.logger = source.logger;
+		target.file = source.file;
+		target.function = source.function;
+		target.line = source.line;
+		target.level = source.level;
+		target.utime = source.utime;
+		// the message only, not the whole buffer
+		strncpy(target.message, source.message, MAX_MESSAGE_LENGTH - 1);
+		target.message[MAX_MESSAGE_LENGTH - 1] = 0;
+	}
+
+private:
+	// a power of 2
+	static const size_t SLOTS = 512;
+
+	struct Slot
+	{
+		std::atomic<size_t> sequence;
+		LogRecord           record;
+	};
+
+	LogWriter()
+		: _slots(new Slot[SLOTS])
+		, _enqueuePos(0)
+		, _dequeuePos(0)
+		, _written(0)
+		, _dropped(0)
+		, _sleeping(false)
+		, _running(true)
+	{
+		for (size_t i = 0; i < SLOTS; i++)
+			_slots[i].sequence.store(i, std::memory_order_relaxed);
+
+		_thread = std::thread(&LogWriter::run, this);
+	}
+
+	~LogWriter()
+	{
+		stop();
+		delete[] _slots;
+	}
+
+	bool drain()
+	{
+		bool any = false;
+
+		for (;;)
+		{
+			Slot& slot = _slots[_dequeuePos & (SLOTS - 1)];
+
+			if (slot.sequence.load(std::memory_order_acquire) != _dequeuePos + 1)
+				break;
+
+			write(slot.record);
+
+			slot.sequence.store(_dequeuePos + SLOTS, std::memory_order_release);
+			_written.store(++_dequeuePos, std::memory_order_release);
+			any = true;
+		}
+
+		const uint64_t dropped = _dropped.exchange(0, std::memory_order_relaxed);
+		if (dropped > 0)
+			std::cout << "Logger: the log queue was full, " << dropped << " debug/info messages are dropped" << std::endl;
+
+		return any;
+	}
+
+	void run()
+	{
+		while (_running.load(std::memory_order_acquire))
+		{
+			if (drain())
+				continue;
+
+			std::unique_lock<std::mutex> lock(_wakeLock);
+			_sleeping.store(true, std::memory_order_seq_cst);
+
+			// a record published before the flag was visible is caught by the check
+			if (_slots[_dequeuePos & (SLOTS - 1)].sequence.load(std::memory_order_acquire) != _dequeuePos + 1 &&
+				_running.load(std::memory_order_acquire))
+				_wake.wait_for(lock, std::chrono::milliseconds(100));
+
+			_sleeping.store(false, std::memory_order_relaxed);
+		}
+
+		// the records of the producers that started before the stop
+		drain();
+	}
+
+	Slot*                   _slots;
+	alignas(64) std::atomic<size_t> _enqueuePos;
+	alignas(64) size_t      _dequeuePos;
+	std::atomic<size_t>     _written;
+	std::atomic<uint64_t>   _dropped;
+	std::atomic<bool>       _sleeping;
+	std::atomic<bool>       _running;
+	std::mutex              _wakeLock;
+	std::condition_variable _wake;
+	std::thread             _thread;
+};
+
 Logger* Logger::getInstance(const QString& name, Logger::LogLevel minLevel)
 {
-	QMutexLocker lock(&_mapLock);
+	{
+		QReadLocker readLock(&_mapLock);
+
+		Logger* log = _loggerMap.value(name, nullptr);
+		if (log != nullptr)
+			return log;
+	}
+
+	QWriteLocker lock(&_mapLock);
 
 	Logger* log = _loggerMap.value(name, nullptr);
 	if (log == nullptr)
@@ -67,7 +319,13 @@ Logger* Logger::getInstance(const QString& name, Logger::LogLevel minLevel)
 
 void Logger::deleteInstance(const QString& name)
 {
-	QMutexLocker lock(&_mapLock);
+	// the queued records point to the loggers
+	if (name.isEmpty())
+		LogWriter::getInstance().stop();
+	else
+		LogWriter::getInstance().flush();
+
+	QWriteLocker lock(&_mapLock);
 
 	if (name.isEmpty())
 	{
@@ -88,6 +346,11 @@ void Logger::setLogLevel(LogLevel level, const QString& name)
 	if (name.isEmpty())
 	{
 		GLOBAL_MIN_LOG_LEVEL = static_cast<int>(level);
+
+		QReadLocker lock(&_mapLock);
+
+		for (auto logger : _loggerMap)
+			logger->updateEffectiveLevel();
 	}
 	else
 	{
@@ -124,9 +387,12 @@ Logger::Logger(const QString& name, LogLevel minLevel)
 	, _syslogEnabled(false)
 	, _loggerId(LoggerId++)
 	, _minLevel(static_cast<int>(minLevel))
+	, _effectiveLevel(static_cast<int>(minLevel))
 {
 	qRegisterMetaType<Logger::T_LOG_MESSAGE>();
 
+	updateEffectiveLevel();
+
 	if (LoggerCount.fetchAndAddOrdered(1) == 1)
 	{
 #ifndef _WIN32
@@ -182,82 +448,80 @@ void Logger::write(const Logger::T_LOG_MESSAGE& message)
 
 void Logger::Message(LogLevel level, const char* sourceFile, const char* func, unsigned int line, const char* fmt, ...)
 {
-	Logger::LogLevel globalLevel = static_cast<Logger::LogLevel>(int(GLOBAL_MIN_LOG_LEVEL));
-	bool writeAnyway = false;
-	bool repeatMessage = false;
-
-	if ((globalLevel == Logger::UNSET && level < _minLevel) // no global level, use level from logger
-		|| (globalLevel > Logger::UNSET && level < globalLevel)) // global level set, use global level
+	if (!isEnabled(level))
 		return;
 
-	const size_t max_msg_length = 1024;
-	char msg[max_msg_length];
+	LogRecord record;
+	record.logger = this;
+	record.file = sourceFile;
+	record.function = func;
+	record.line = line;
+	record.level = level;
+	record.utime = QDateTime::currentMSecsSinceEpoch();
+
 	va_list args;
 	va_start(args, fmt);
-	vsnprintf(msg, max_msg_length, fmt, args);
+	vsnprintf(record.message, MAX_MESSAGE_LENGTH, fmt, args);
 	va_end(args);
 
+	bool writeAnyway = false;
+	bool repeatMessage = false;
+
+	// the writer thread when it's running, else the caller
+	const auto submit = [](const LogRecord& message)
+	{
+		if (!LogWriter::getInstance().push(message))
+			LogWriter::write(message);
+	};
+
 	const auto repeatedSummary = [&]
 	{
-		if (RepeatCount.localData() > 10)
+		if (RepeatCount > 10)
 		{
-			Logger::T_LOG_MESSAGE repMsg = RepeatMessage.localData();
-			repMsg.message = "Previous line repeats " + QString::number(RepeatCount.localData() - 10) + " times";
+			LogRecord repMsg;
+			LogWriter::copyRecord(repMsg, RepeatMessage);
+			snprintf(repMsg.message, MAX_MESSAGE_LENGTH, "Previous line repeats %d times", RepeatCount - 10);
 			repMsg.utime = QDateTime::currentMSecsSinceEpoch();
 
-			write(repMsg);
-#ifndef _WIN32
-			if (_syslogEnabled && repMsg.level >= Logger::WARNING)
-				syslog(LogLevelSysLog[repMsg.level], "Previous line repeats %d times", RepeatCount.localData() - 10);
-#endif
+			submit(repMsg);
 		}
-		RepeatCount.setLocalData(0);
+		RepeatCount = 0;
 	};
 
-	if (RepeatMessage.localData().loggerName == _name &&
-		RepeatMessage.localData().function == func &&
-		RepeatMessage.localData().message == msg &&
-		RepeatMessage.localData().line == line)
+	if (RepeatMessage.logger == this &&
+		RepeatMessage.line == line &&
+		strcmp(RepeatMessage.function, func) == 0 &&
+		strcmp(RepeatMessage.message, record.message) == 0)
 	{
 		repeatMessage = true;
-		if (RepeatCount.localData() >= MaxRepeatCountSize)
+		if (RepeatCount >= MaxRepeatCountSize)
 			repeatedSummary();
 		else
-			RepeatCount.setLocalData(RepeatCount.localData() + 1);
+			RepeatCount++;
 
-		if (RepeatCount.localData() < 10)
+		if (RepeatCount < 10)
 			writeAnyway = true;
 	}
 
 	if (!repeatMessage || writeAnyway)
 	{
-		if (!repeatMessage && RepeatCount.localData())
+		if (!repeatMessage && RepeatCount)
 			repeatedSummary();
 
-		Logger::T_LOG_MESSAGE logMsg;
+		submit(record);
 
-		logMsg.appName = _appname;
-		logMsg.loggerName = _name;
-		logMsg.function = QString(func);
-		logMsg.line = line;
-		logMsg.fileName = FileUtils::getBaseName(sourceFile);
-		logMsg.utime = QDateTime::currentMSecsSinceEpoch();
-		logMsg.message = QString(msg);
-		logMsg.level = level;
-		logMsg.levelString = LogLevelStrings[level];
-
-		write(logMsg);
-#ifndef _WIN32
-		if (_syslogEnabled && level >= Logger::WARNING)
-			syslog(LogLevelSysLog[level], "%s", msg);
-#endif
 		if (level == Logger::ERRORR)
-			_lastError = QString("%1 [%2] %3").arg(QDateTime::currentDateTime().toString("yyyy-MM-dd hh:mm:ss")).arg(_name).arg(QString(msg));
+			_lastError = QString("%1 [%2] %3").arg(QDateTime::currentDateTime().toString("yyyy-MM-dd hh:mm:ss")).arg(_name).arg(QString(record.message));
 
-		RepeatMessage.setLocalData(logMsg);
+		LogWriter::copyRecord(RepeatMessage, record);
 	}
 }
 
+void Logger::flush()
+{
+	LogWriter::getInstance().flush();
+}
+
 QString Logger::_lastError;
 
 QString Logger::getLastError()
@@ -268,6 +532,14 @@ QString Logger::getLastError()
 void Logger::setMinLevel(Logger::LogLevel level)
 {
 	_minLevel = static_cast<int>(level);
+	updateEffectiveLevel();
+}
+
+void Logger::updateEffectiveLevel()
+{
+	const int globalLevel = int(GLOBAL_MIN_LOG_LEVEL);
+
+	_effectiveLevel.store((globalLevel > Logger::UNSET) ? globalLevel : int(_minLevel), std::memory_order_relaxed);
 }
 
 Logger::LogLevel Logger::getMinLevel() const
@@ -285,10 +557,20 @@ QString Logger::getAppName() const
 	return _appname;
 }
 
+namespace
+{
+	size_t messageSize(const Logger::T_LOG_MESSAGE& msg)
+	{
+		return sizeof(Logger::T_LOG_MESSAGE) + sizeof(QChar) * static_cast<size_t>(msg.appName.capacity() + msg.loggerName.capacity() +
+			msg.function.capacity() + msg.fileName.capacity() + msg.message.capacity() + msg.levelString.capacity());
+	}
+}
+
 LoggerManager::LoggerManager()
 	: QObject()
 	, _loggerMaxMsgBufferSize(350)
 	, _enable(true)
+	, _memory(MemoryAccounting::LOG_BUFFER)
 {
 	_logMessageBuffer.reserve(_loggerMaxMsgBufferSize);
 }
@@ -299,11 +581,16 @@ void LoggerManager::handleNewLogMessage(const Logger::T_LOG_MESSAGE& msg)
 		return;
 
 	_logMessageBuffer.push_back(msg);
+	size_t memory = _memory.bytes() + messageSize(msg);
+
 	if (_logMessageBuffer.length() > _loggerMaxMsgBufferSize)
 	{
+		memory -= messageSize(_logMessageBuffer.front());
 		_logMessageBuffer.pop_front();
 	}
 
+	_memory.set(memory);
+
 	emit newLogMessage(msg);
 }
 
@@ -26,6 +26,7 @@
 */
 #include <utils/LutCalibrator.h>
 #include <utils/GlobalSignals.h>
+#include <utils/ImageIngest.h>
 #include <utils/Logger.h>
 #include <base/GrabberWrapper.h>
 #include <api/JsonAPI.h>
@@ -35,13 +36,18 @@
 #include <cmath>
 #include <cfloat>
 #include <climits>
+#include <atomic>
 
 #include <QCoreApplication>
 #include <QJsonArray>
 #include <QJsonObject>
 #include <QFile>
+#include <QSaveFile>
 #include <QDateTime>
 #include <QThread>
+#include <QThreadPool>
+#include <QRunnable>
+#include <QSemaphore>
 
 ColorRgb LutCalibrator::primeColors[] = {
 				ColorRgb(255, 0, 0), ColorRgb(0, 255, 0), ColorRgb(0, 0, 255), ColorRgb(255, 255, 0),
@@ -83,7 +89,10 @@ LutCalibrator::LutCalibrator()
 		_colorBalance[(int)selector].reset();
 	_maxColor = ColorRgb(0, 0, 0);
 	_timeStamp = 0;
+	_waiting = false;
+	_patchesPending = false;
 
+	connect(this, &LutCalibrator::patchesSampled, this, &LutCalibrator::handlePatches);
 	connect(this, &LutCalibrator::assign, this, &LutCalibrator::assignHandler, Qt::ConnectionType::UniqueConnection);
 	connect(this, &LutCalibrator::stop, this, &LutCalibrator::stopHandler, Qt::ConnectionType::UniqueConnection);
 }
@@ -162,6 +171,8 @@ void LutCalibrator::assignHandler(hyperhdr::Components defaultComp, int checksum
 			{
 				_log->disable();
 
+				// the test board covers the whole frame
+				BLOCK_CALL_1(wrapperInstance, setRegionDecoding, bool, false);
 				BLOCK_CALL_0(wrapperInstance, stop);
 				BLOCK_CALL_0(wrapperInstance, start);
 
@@ -176,17 +187,19 @@ void LutCalibrator::assignHandler(hyperhdr::Components defaultComp, int checksum
 			if (defaultComp == hyperhdr::COMP_VIDEOGRABBER)
 			{
 				Debug(_log, "Using video grabber as a source");
-				connect(GlobalSignals::getInstance(), &GlobalSignals::setVideoImage, this, &LutCalibrator::setVideoImage, Qt::ConnectionType::UniqueConnection);
+				connect(GlobalSignals::getInstance(), &GlobalSignals::setVideoImage, this, &LutCalibrator::setVideoImage, Qt::ConnectionType(Qt::DirectConnection | Qt::UniqueConnection));
 			}
 			else if (defaultComp == hyperhdr::COMP_SYSTEMGRABBER)
 			{
 				Debug(_log, "Using system grabber as a source");
-				connect(GlobalSignals::getInstance(), &GlobalSignals::setSystemImage, this, &LutCalibrator::setSystemImage, Qt::ConnectionType::UniqueConnection);
+				connect(GlobalSignals::getInstance(), &GlobalSignals::setSystemImage, this, &LutCalibrator::setSystemImage, Qt::ConnectionType(Qt::DirectConnection | Qt::UniqueConnection));
 			}
 			else
 			{
 				Debug(_log, "Using flatbuffers/protobuffers as a source");
-				connect(GlobalSignals::getInstance(), &GlobalSignals::setGlobalImage, this, &LutCalibrator::setGlobalInputImage, Qt::ConnectionType::UniqueConnection);
+				// the network sources must not reduce the test pattern
+				ImageIngest::setRequiredSize(ImageIngest::FULL_FRAME_OWNER, INT_MAX, INT_MAX);
+				connect(GlobalSignals::getInstance(), &GlobalSignals::setGlobalImage, this, &LutCalibrator::setGlobalInputImage, Qt::ConnectionType(Qt::DirectConnection | Qt::UniqueConnection));
 			}
 		}
 		else
@@ -204,6 +217,7 @@ void LutCalibrator::assignHandler(hyperhdr::Components defaultComp, int checksum
 	_startColor = startColor;
 	_endColor = endColor;
 	_timeStamp = InternalClock::now();
+	_waiting = (_checksum >= 0);
 
 	if (_checksum % 19 == 1)
 		Debug(_log, "Requested section: %i, %s, %s, YUV: %s, Coef: %s, Saturation: %f, Luminance: %f, Gammas: (%f, %f, %f)",
@@ -213,8 +227,16 @@ void LutCalibrator::assignHandler(hyperhdr::Components defaultComp, int checksum
 
 void LutCalibrator::stopHandler()
 {
+	_waiting = false;
 	disconnect(GlobalSignals::getInstance(), &GlobalSignals::setVideoImage, this, &LutCalibrator::setVideoImage);
+	disconnect(GlobalSignals::getInstance(), &GlobalSignals::setSystemImage, this, &LutCalibrator::setSystemImage);
 	disconnect(GlobalSignals::getInstance(), &GlobalSignals::setGlobalImage, this, &LutCalibrator::setGlobalInputImage);
+	ImageIngest::setRequiredSize(ImageIngest::FULL_FRAME_OWNER, 0, 0);
+
+	auto wrapperInstance = GrabberWrapper::getInstance();
+	if (wrapperInstance != nullptr)
+		QUEUE_CALL_1(wrapperInstance, setRegionDecoding, bool, true);
+
 	_mjpegCalibration = false;
 	_finish = false;
 	_checksum = -1;
@@ -230,43 +252,89 @@ void LutCalibrator::stopHandler()
 
 void LutCalibrator::setVideoImage(const QString& name, const Image<ColorRgb>& image)
 {
-	handleImage(image);
+	samplePatches(image);
 }
 
 void LutCalibrator::setSystemImage(const QString& name, const Image<ColorRgb>& image)
 {
-	handleImage(image);
+	samplePatches(image);
 }
 
 void LutCalibrator::setGlobalInputImage(int priority, const Image<ColorRgb>& image, int timeout_ms, bool clearEffect)
 {
-	handleImage(image);
+	samplePatches(image);
 }
 
-void LutCalibrator::handleImage(const Image<ColorRgb>& image)
+void LutCalibrator::samplePatches(const Image<ColorRgb>& image)
+{
+	if (!_waiting || _patchesPending.exchange(true))
+		return;
+
+	std::vector<ColorRgb> patches;
+	const int width = image.width();
+	const int height = image.height();
+
+	// a frame of a wrong size is only reported, the calibrator stops then
+	if (width >= 3 * BOARD_WIDTH && height >= 3 * BOARD_HEIGHT)
+	{
+		const double scaleX = width / double(BOARD_WIDTH);
+		const double scaleY = height / double(BOARD_HEIGHT);
+
+		patches.resize(BOARD_WIDTH * BOARD_HEIGHT);
+
+		for (int py = 0; py < BOARD_HEIGHT; py++)
+		{
+			const int sY = (qRound(py * scaleY) + qRound((py + 1) * scaleY)) / 2;
+
+			for (int px = 0; px < BOARD_WIDTH; px++)
+			{
+				const int sX = (qRound(px * scaleX) + qRound((px + 1) * scaleX)) / 2;
+				int cR = 0, cG = 0, cB = 0;
+
+				for (int j = -1; j <= 1; j++)
+				{
+					const ColorRgb* line = &image(sX - 1, sY + j);
+
+					for (int i = 0; i < 3; i++)
+					{
+						cR += line[i].red;
+						cG += line[i].green;
+						cB += line[i].blue;
+					}
+				}
+
+				patches[py * BOARD_WIDTH + px] = ColorRgb((uint8_t)qMin(qRound(cR / 9.0), 255), (uint8_t)qMin(qRound(cG / 9.0), 255), (uint8_t)qMin(qRound(cB / 9.0), 255));
+			}
+		}
+	}
+
+	emit patchesSampled(width, height, patches);
+}
+
+void LutCalibrator::handlePatches(int width, int height, const std::vector<ColorRgb>& patches)
 {
 	int validate = 0;
 	int diffColor = 0;
 	QJsonObject report;
 	QJsonArray colors;
 	ColorRgb white{ 128,128,128 }, black{ 16,16,16 };
-	double scaleX = image.width() / 128.0;
-	double scaleY = image.height() / 72.0;
+
+	_patchesPending = false;
 
 	if (_checksum < 0)
 		return;
 
-	if (image.width() < 3 * 128 || image.height() < 3 * 72)
+	if (width < 3 * BOARD_WIDTH || height < 3 * BOARD_HEIGHT)
 	{
 		stopHandler();
-		Error(_log, "Too low resolution: 384x216 is the minimum. Received video frame: %ix%i. Stopped.", image.width(), image.height());
+		Error(_log, "Too low resolution: 384x216 is the minimum. Received video frame: %ix%i. Stopped.", width, height);
 		report["status"] = 1;
 		report["error"] = "Too low resolution: 384x216 is the minimum. Received video frame: %ix%i. Stopped.";
 		lutCalibrationUpdate(report);
 		return;
 	}
 
-	if (image.width() * 1080 != image.height() * 1920)
+	if (width * 1080 != height * 1920)
 	{
 		stopHandler();
 		Error(_log, "Invalid resolution width/height ratio. Expected aspect: 1920/1080 (or the same 1280/720 etc). Stopped.");
@@ -276,26 +344,11 @@ void LutCalibrator::handleImage(const Image<ColorRgb>& image)
 		return;
 	}
 
-	for (int py = 0; py < 72;)
+	for (int py = 0; py < BOARD_HEIGHT;)
 	{
-		for (int px = (py < 71 && py > 0) ? _checksum % 2 : 0; px < 128; px++)
+		for (int px = (py < 71 && py > 0) ? _checksum % 2 : 0; px < BOARD_WIDTH; px++)
 		{
-			ColorRgb	color;
-			int sX = (qRound(px * scaleX) + qRound((px + 1) * scaleX)) / 2;
-			int sY = (qRound(py * scaleY) + qRound((py + 1) * scaleY)) / 2;
-			int cR = 0, cG = 0, cB = 0;
-
-			for (int i = -1; i <= 1; i++)
-				for (int j = -1; j <= 1; j++)
-				{
-					ColorRgb cur = image(sX + i, sY + j);
-					cR += cur.red;
-					cG += cur.green;
-					cB += cur.blue;
-				}
-
-			color = ColorRgb((uint8_t)qMin(qRound(cR / 9.0), 255), (uint8_t)qMin(qRound(cG / 9.0), 255), (uint8_t)qMin(qRound(cB / 9.0), 255));
-
+			const ColorRgb& color = patches[py * BOARD_WIDTH + px];
 
 			if (py < 71 && py > 0)
 			{
@@ -391,6 +444,7 @@ void LutCalibrator::handleImage(const Image<ColorRgb>& image)
 	}
 
 	_checksum = -1;
+	_waiting = false;
 
 	if (_finish)
 	{
@@ -881,6 +935,7 @@ bool LutCalibrator::correctionEnd()
 	disconnect(GlobalSignals::getInstance(), &GlobalSignals::setVideoImage, this, &LutCalibrator::setVideoImage);
 	disconnect(GlobalSignals::getInstance(), &GlobalSignals::setSystemImage, this, &LutCalibrator::setSystemImage);
 	disconnect(GlobalSignals::getInstance(), &GlobalSignals::setGlobalImage, this, &LutCalibrator::setGlobalInputImage);
+	ImageIngest::setRequiredSize(ImageIngest::FULL_FRAME_OWNER, 0, 0);
 
 	double floor = qMax(_minColor.red, qMax(_minColor.green, _minColor.blue));
 	double ceiling = qMin(_maxColor.red, qMin(_maxColor.green, _maxColor.blue));
@@ -963,30 +1018,35 @@ bool LutCalibrator::correctionEnd()
 	Debug(_log, "YUV range: %s", (floor >= 2 || _limitedRange) ? "LIMITED" : "FULL");
 	Debug(_log, "YUV coefs: %s", REC(_currentCoef));
 
-	// build LUT table
-	for (int g = 0; g <= 255; g++)
+	// the transfer functions before the BT2020 matrix depend on one channel only: 3 x 256 evaluations instead of 3 x 256^3
+	double transfer[3][256];
+	const double balance[3] = { whiteBalance.scaledRed, whiteBalance.scaledGreen, whiteBalance.scaledBlue };
+
+	for (int channel = 0; channel < 3; channel++)
+		for (int x = 0; x <= 255; x++)
+		{
+			double v = clampDouble((x * balance[channel] - floor) / scale, 0, 1.0);
+
+			// ootf
+			if (strategy == 1)
+				v = ootf(v);
+
+			// eotf
+			if (strategy == 0 || strategy == 1)
+				v = eotf(range, v);
+
+			transfer[channel][x] = v;
+		}
+
+	// build LUT table, the green slices are independent
+	parallelSlices("rgb", 256, [&](int g)
+	{
 		for (int b = 0; b <= 255; b++)
 			for (int r = 0; r <= 255; r++)
 			{
-				double Ri = clampDouble((r * whiteBalance.scaledRed - floor) / scale, 0, 1.0);
-				double Gi = clampDouble((g * whiteBalance.scaledGreen - floor) / scale, 0, 1.0);
-				double Bi = clampDouble((b * whiteBalance.scaledBlue - floor) /scale, 0, 1.0);
-
-				// ootf
-				if (strategy == 1)
-				{
-					Ri = ootf(Ri);
-					Gi = ootf(Gi);
-					Bi = ootf(Bi);
-				}
-
-				// eotf
-				if (strategy == 0 || strategy == 1)
-				{
-					Ri = eotf(range, Ri);
-					Gi = eotf(range, Gi);
-					Bi = eotf(range, Bi);
-				}
+				double Ri = transfer[0][r];
+				double Gi = transfer[1][g];
+				double Bi = transfer[2][b];
 
 				// bt2020
 				if (strategy == 0 || strategy == 1)
@@ -1026,6 +1086,7 @@ bool LutCalibrator::correctionEnd()
 				_lutBuffer[ind_lutd + 1] = clampToInt(((finalG) * 255), 0, 255);
 				_lutBuffer[ind_lutd + 2] = clampToInt(((finalB) * 255), 0, 255);
 			}
+	});
 
 	// display final colors
 	displayPostCalibrationInfo();
@@ -1039,7 +1100,9 @@ void LutCalibrator::applyFilter()
 
 	memset(_secondBuffer, 0, LUT_FILE_SIZE);
 
-	for (int r = 0; r < 256; r++)
+	// the red slices read the source table and write only their own entries of the second one
+	parallelSlices("filter", 256, [&](int r)
+	{
 		for (int g = 0; g < 256; g++)
 			for (int b = 0; b < 256; b++)
 			{
@@ -1080,10 +1143,83 @@ void LutCalibrator::applyFilter()
 				_secondBuffer[index + 1] = clampToInt(((avG / (double)avCount)), 0, 255);
 				_secondBuffer[index + 2] = clampToInt(((avB / (double)avCount)), 0, 255);
 			}
+	});
 
 	memcpy(_lutBuffer, _secondBuffer, LUT_FILE_SIZE);
 }
 
+namespace
+{
+	class LutSliceTask : public QRunnable
+	{
+	public:
+		LutSliceTask(const std::function<void()>& work, QSemaphore* done)
+			: _work(work), _done(done)
+		{
+		}
+
+		void run() override
+		{
+			_work();
+			_done->release();
+		}
+
+	private:
+		const std::function<void()>& _work;
+		QSemaphore* _done;
+	};
+}
+
+void LutCalibrator::parallelSlices(const QString& stage, int count, const std::function<void(int)>& job)
+{
+	const qint64 start = InternalClock::now();
+	const int workers = qMax(qMin(QThreadPool::globalInstance()->maxThreadCount(), count) - 1, 0);
+
+	std::atomic<int> next(0);
+	std::atomic<int> finished(0);
+
+	const std::function<void()> work = [&]()
+	{
+		for (int slice = next++; slice < count; slice = next++)
+		{
+			job(slice);
+			finished++;
+		}
+	};
+
+	QSemaphore done;
+
+	for (int i = 0; i < workers; i++)
+	{
+		LutSliceTask* task = new LutSliceTask(work, &done);
+		task->setAutoDelete(true);
+		QThreadPool::globalInstance()->start(task);
+	}
+
+	// the calling thread takes the slices too and reports the progress between them
+	int reported = 0;
+
+	for (int slice = next++; slice < count; slice = next++)
+	{
+		job(slice);
+
+		const int progress = (++finished) * 100 / count;
+		if (progress >= reported + 10)
+		{
+			reported = progress - progress % 10;
+
+			QJsonObject report;
+			report["stage"] = stage;
+			report["progress"] = reported;
+			lutCalibrationUpdate(report);
+		}
+	}
+
+	done.acquire(workers);
+
+	Debug(_log, "LUT generation, %s: %i slices in %lli ms (threads: %i)", QSTRING_CSTR(stage), count, InternalClock::now() - start, workers + 1);
+}
+
 double LutCalibrator::fineTune(double& optimalRange, double& optimalScale, int& optimalWhite, int& optimalStrategy)
 {
 	QString optimalColor;
@@ -1099,121 +1235,148 @@ double LutCalibrator::fineTune(double& optimalRange, double& optimalScale, int&
 	optimalRange = ceiling;
 
 	double rangeStart = 20, rangeLimit = 150;
-	bool restart = false;
 
-	for (int whiteIndex = capColors::Gray1; whiteIndex <= capColors::White; whiteIndex++)
+	// the best candidate of one white balance
+	struct Candidate
 	{
-		ColorStat whiteBalance = _colorBalance[whiteIndex];
+		double	error = (double)LLONG_MAX;
+		double	range = 0;
+		int		strategy = 0;
+		int		scale = 0;
+		QString	color;
+	};
 
-		for (int scale = (qRound(ceiling) / 8) * 8, limitScale = 512; scale <= limitScale; scale = (scale == limitScale) ? limitScale + 1 : qMin(scale + 4, limitScale))
-			for (int strategy = 0; strategy < 3; strategy++)
-				for (double range = rangeStart; range <= rangeLimit; range += (range < 5) ? 0.1 : 0.5)
-					if (strategy != 2 || range == rangeLimit)
-					{
-						double currentError = 0;
-						QList<QString> colors;
-						double lR = -1, lG = -1, lB = -1;
+	constexpr int whites = capColors::White - capColors::Gray1 + 1;
 
-						for (int ind : primaries)
-						{
-							ColorStat calculated, normalized = _colorBalance[ind];
-							normalized /= (double)scale;
+	for (int pass = 0; pass < 2 && maxError == LLONG_MAX; pass++)
+	{
+		if (pass > 0)
+		{
+			rangeStart = 0.1;
+			rangeLimit = 20;
+			Debug(_log, "Restarting calculation");
+		}
 
-							normalized.red *= whiteBalance.scaledRed;
-							normalized.green *= whiteBalance.scaledGreen;
-							normalized.blue *= whiteBalance.scaledBlue;
+		// every white balance is searched by another thread, the candidates are compared in the order of the sequential search
+		Candidate candidates[whites];
 
-							// ootf
-							if (strategy == 1)
-							{
-								normalized.red = ootf(normalized.red);
-								normalized.green = ootf(normalized.green);
-								normalized.blue = ootf(normalized.blue);
-							}
+		parallelSlices("fine tune", whites, [&](int slice)
+		{
+			const int whiteIndex = capColors::Gray1 + slice;
+			ColorStat whiteBalance = _colorBalance[whiteIndex];
+			Candidate& best = candidates[slice];
+
+			for (int scale = (qRound(ceiling) / 8) * 8, limitScale = 512; scale <= limitScale; scale = (scale == limitScale) ? limitScale + 1 : qMin(scale + 4, limitScale))
+				for (int strategy = 0; strategy < 3; strategy++)
+					for (double range = rangeStart; range <= rangeLimit; range += (range < 5) ? 0.1 : 0.5)
+						if (strategy != 2 || range == rangeLimit)
+						{
+							double currentError = 0;
+							QList<QString> colors;
+							double lR = -1, lG = -1, lB = -1;
 
-							// eotf
-							if (strategy == 0 || strategy == 1)
+							for (int ind : primaries)
 							{
-								normalized.red = eotf(range, normalized.red);
-								normalized.green = eotf(range, normalized.green);
-								normalized.blue = eotf(range, normalized.blue);
-							}
+								ColorStat calculated, normalized = _colorBalance[ind];
+								normalized /= (double)scale;
 
-							// bt2020
-							if (strategy == 0 || strategy == 1)
-							{
-								fromBT2020toBT709(normalized.red, normalized.green, normalized.blue, calculated.red, calculated.green, calculated.blue);
-							}
+								normalized.red *= whiteBalance.scaledRed;
+								normalized.green *= whiteBalance.scaledGreen;
+								normalized.blue *= whiteBalance.scaledBlue;
 
-							// ootf
-							if (strategy == 0 || strategy == 1)
-							{
-								calculated.red = ootf(calculated.red);
-								calculated.green = ootf(calculated.green);
-								calculated.blue = ootf(calculated.blue);
-							}
-							else
-							{
-								calculated.red = normalized.red;
-								calculated.green = normalized.green;
-								calculated.blue = normalized.blue;
-							}
+								// ootf
+								if (strategy == 1)
+								{
+									normalized.red = ootf(normalized.red);
+									normalized.green = ootf(normalized.green);
+									normalized.blue = ootf(normalized.blue);
+								}
 
-							calculated.red = clampDouble(calculated.red, 0, 1.0) * 255.0;
-							calculated.green = clampDouble(calculated.green, 0, 1.0) * 255.0;
-							calculated.blue = clampDouble(calculated.blue, 0, 1.0) * 255.0;
+								// eotf
+								if (strategy == 0 || strategy == 1)
+								{
+									normalized.red = eotf(range, normalized.red);
+									normalized.green = eotf(range, normalized.green);
+									normalized.blue = eotf(range, normalized.blue);
+								}
 
-							if ((ind != capColors::HighestGray ||
-									((calculated.red <= 250.0 && calculated.green <= 250.0 && calculated.blue <= 250.0) && (calculated.red >= 200.0 && calculated.green >= 200.0 && calculated.blue >= 200.0)))  &&
-								(ind != capColors::LowestGray ||
-									((calculated.red >= 4 && calculated.green >= 4 && calculated.blue >= 4) && (calculated.red <= 28 && calculated.green <= 28 && calculated.blue <= 28))))
-							{
-								if (ind == capColors::LowRed)
-									lR = calculated.red;
-								if (ind == capColors::LowGreen)
-									lG = calculated.green;
-								if (ind == capColors::LowBlue)
-									lB = calculated.blue;
-
-								currentError += getError(primeColors[ind], calculated);
-								colors.push_back(calculated.toQString());
+								// bt2020
+								if (strategy == 0 || strategy == 1)
+								{
+									fromBT2020toBT709(normalized.red, normalized.green, normalized.blue, calculated.red, calculated.green, calculated.blue);
+								}
+
+								// ootf
+								if (strategy == 0 || strategy == 1)
+								{
+									calculated.red = ootf(calculated.red);
+									calculated.green = ootf(calculated.green);
+									calculated.blue = ootf(calculated.blue);
+								}
+								else
+								{
+									calculated.red = normalized.red;
+									calculated.green = normalized.green;
+									calculated.blue = normalized.blue;
+								}
+
+								calculated.red = clampDouble(calculated.red, 0, 1.0) * 255.0;
+								calculated.green = clampDouble(calculated.green, 0, 1.0) * 255.0;
+								calculated.blue = clampDouble(calculated.blue, 0, 1.0) * 255.0;
+
+								if ((ind != capColors::HighestGray ||
+										((calculated.red <= 250.0 && calculated.green <= 250.0 && calculated.blue <= 250.0) && (calculated.red >= 200.0 && calculated.green >= 200.0 && calculated.blue >= 200.0)))  &&
+									(ind != capColors::LowestGray ||
+										((calculated.red >= 4 && calculated.green >= 4 && calculated.blue >= 4) && (calculated.red <= 28 && calculated.green <= 28 && calculated.blue <= 28))))
+								{
+									if (ind == capColors::LowRed)
+										lR = calculated.red;
+									if (ind == capColors::LowGreen)
+										lG = calculated.green;
+									if (ind == capColors::LowBlue)
+										lB = calculated.blue;
+
+									currentError += getError(primeColors[ind], calculated);
+									colors.push_back(calculated.toQString());
+								}
+								else
+								{
+									currentError = best.error + 1;
+									break;
+								}
 							}
-							else
+
+							if (lR >= 0 && lG >= 0 && lB >= 0)
 							{
-								currentError = maxError +1;
-								break;
+								double m = qMax(lR, qMax(lG, lB));
+								double n = qMin(lR, qMin(lG, lB));
+								currentError += 8 * std::pow(m - n, 2);
 							}
-						}
 
-						if (lR >= 0 && lG >= 0 && lB >= 0)
-						{
-							double m = qMax(lR, qMax(lG, lB));
-							double n = qMin(lR, qMin(lG, lB));
-							currentError += 8 * std::pow(m - n, 2);
-						}
-
-						if (maxError > currentError)
-						{
-							maxError = currentError;
-							optimalRange = range;
-							optimalStrategy = strategy;
-							optimalScale = scale;
-							optimalWhite = whiteIndex;
-							optimalColor = "";
-							for (auto c : colors)
-								optimalColor += QString("%1 ,").arg(c);
-							optimalColor += QString(" range: %1, strategy: %2, scale: %3, white: %4, error: %5").arg(optimalRange).arg(optimalStrategy).arg(optimalScale).arg(optimalWhite).arg(currentError);
+							if (best.error > currentError)
+							{
+								best.error = currentError;
+								best.range = range;
+								best.strategy = strategy;
+								best.scale = scale;
+								best.color = "";
+								for (auto c : colors)
+									best.color += QString("%1 ,").arg(c);
+								best.color += QString(" range: %1, strategy: %2, scale: %3, white: %4, error: %5").arg(range).arg(strategy).arg(scale).arg(whiteIndex).arg(currentError);
+							}
 						}
-					}
+		});
 
-		if (whiteIndex == capColors::White && maxError == LLONG_MAX && !restart)
-		{
-			restart = true;
-			whiteIndex = capColors::LowestGray;
-			rangeStart = 0.1;
-			rangeLimit = 20;
-			Debug(_log, "Restarting calculation");
-		}
+		for (int slice = 0; slice < whites; slice++)
+			if (maxError > candidates[slice].error)
+			{
+				maxError = candidates[slice].error;
+				optimalRange = candidates[slice].range;
+				optimalStrategy = candidates[slice].strategy;
+				optimalScale = candidates[slice].scale;
+				optimalWhite = capColors::Gray1 + slice;
+				optimalColor = candidates[slice].color;
+			}
 	}
 
 	Debug(_log, "Best result => %s", QSTRING_CSTR(optimalColor));
@@ -1224,7 +1387,8 @@ double LutCalibrator::fineTune(double& optimalRange, double& optimalScale, int&
 bool LutCalibrator::finalize(bool fastTrack)
 {
 	QString fileName = QString("%1%2").arg(HyperHdrIManager::getInstance()->getRootPath()).arg("/lut_lin_tables.3d");
-	QFile file(fileName);
+	// the current LUT file can be memory-mapped by the grabbers: replace it atomically instead of truncating
+	QSaveFile file(fileName);
 
 	bool ok = true;
 
@@ -1233,9 +1397,10 @@ bool LutCalibrator::finalize(bool fastTrack)
 		disconnect(GlobalSignals::getInstance(), &GlobalSignals::setVideoImage, this, &LutCalibrator::setVideoImage);
 		disconnect(GlobalSignals::getInstance(), &GlobalSignals::setSystemImage, this, &LutCalibrator::setSystemImage);
 		disconnect(GlobalSignals::getInstance(), &GlobalSignals::setGlobalImage, this, &LutCalibrator::setGlobalInputImage);
+		ImageIngest::setRequiredSize(ImageIngest::FULL_FRAME_OWNER, 0, 0);
 	}
 
-	if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate))
+	if (!file.open(QIODevice::WriteOnly))
 	{
 		Error(_log, "Could not open: %s for writing (read-only file system or lack of rights)", QSTRING_CSTR(fileName));
 		ok = false;
@@ -1268,42 +1433,49 @@ bool LutCalibrator::finalize(bool fastTrack)
 		uint8_t* _yuvBuffer = &(_lutBuffer[LUT_FILE_SIZE]);
 
 		memset(_yuvBuffer, 0, LUT_FILE_SIZE);
-		for (int y = 0; y < 256 && !fastTrack; y++)
-			for (int u = 0; u < 256; u++)
-				for (int v = 0; v < 256; v++)
-				{
-					double r, g, b;
 
-					if (_limitedRange)
-					{
-						r = (255.0 / 219.0) * y + (255.0 / 112) * v * (1 - Kr) - (255.0 * 16.0 / 219 + 255.0 * 128.0 / 112.0 * (1 - Kr));
-						g = (255.0 / 219.0) * y - (255.0 / 112) * u * (1 - Kb) * Kb / Kg - (255.0 / 112.0) * v * (1 - Kr) * Kr / Kg
-							- (255.0 * 16.0 / 219.0 - 255.0 / 112.0 * 128.0 * (1 - Kb) * Kb / Kg - 255.0 / 112.0 * 128.0 * (1 - Kr) * Kr / Kg);
-						b = (255.0 / 219.0) * y + (255.0 / 112.0) * u * (1 - Kb) - (255.0 * 16 / 219.0 + 255.0 * 128.0 / 112.0 * (1 - Kb));
-					}
-					else
+		// the luma slices only read the RGB table
+		if (!fastTrack)
+			parallelSlices("yuv hdr", 256, [&](int y)
+			{
+				for (int u = 0; u < 256; u++)
+					for (int v = 0; v < 256; v++)
 					{
-						r = y + 2 * (v - 128) * (1 - Kr);
-						g = y - 2 * (u - 128) * (1 - Kb) * Kb / Kg - 2 * (v - 128) * (1 - Kr) * Kr / Kg;
-						b = y + 2 * (u - 128) * (1 - Kb);
-					}
+						double r, g, b;
 
-					int _R = clampToInt(r, 0, 255);
-					int _G = clampToInt(g, 0, 255);
-					int _B = clampToInt(b, 0, 255);
+						if (_limitedRange)
+						{
+							r = (255.0 / 219.0) * y + (255.0 / 112) * v * (1 - Kr) - (255.0 * 16.0 / 219 + 255.0 * 128.0 / 112.0 * (1 - Kr));
+							g = (255.0 / 219.0) * y - (255.0 / 112) * u * (1 - Kb) * Kb / Kg - (255.0 / 112.0) * v * (1 - Kr) * Kr / Kg
+								- (255.0 * 16.0 / 219.0 - 255.0 / 112.0 * 128.0 * (1 - Kb) * Kb / Kg - 255.0 / 112.0 * 128.0 * (1 - Kr) * Kr / Kg);
+							b = (255.0 / 219.0) * y + (255.0 / 112.0) * u * (1 - Kb) - (255.0 * 16 / 219.0 + 255.0 * 128.0 / 112.0 * (1 - Kb));
+						}
+						else
+						{
+							r = y + 2 * (v - 128) * (1 - Kr);
+							g = y - 2 * (u - 128) * (1 - Kb) * Kb / Kg - 2 * (v - 128) * (1 - Kr) * Kr / Kg;
+							b = y + 2 * (u - 128) * (1 - Kb);
+						}
 
-					uint32_t indexRgb = LUT_INDEX(_R, _G, _B);
-					uint32_t index = LUT_INDEX(y, u, v);
+						int _R = clampToInt(r, 0, 255);
+						int _G = clampToInt(g, 0, 255);
+						int _B = clampToInt(b, 0, 255);
+
+						uint32_t indexRgb = LUT_INDEX(_R, _G, _B);
+						uint32_t index = LUT_INDEX(y, u, v);
+
+						_yuvBuffer[index] = _lutBuffer[indexRgb];
+						_yuvBuffer[index + 1] = _lutBuffer[indexRgb + 1];
+						_yuvBuffer[index + 2] = _lutBuffer[indexRgb + 2];
+					}
+			});
 
-					_yuvBuffer[index] = _lutBuffer[indexRgb];
-					_yuvBuffer[index + 1] = _lutBuffer[indexRgb + 1];
-					_yuvBuffer[index + 2] = _lutBuffer[indexRgb + 2];
-				}
 		file.write((const char*)_yuvBuffer, LUT_FILE_SIZE);
 		Debug(_log, "LUT YUV HDR table (2/3) is ready");
 
 		// YUV
-		for (int y = 0; y < 256; y++)
+		parallelSlices("yuv", 256, [&](int y)
+		{
 			for (int u = 0; u < 256; u++)
 				for (int v = 0; v < 256; v++)
 				{
@@ -1329,6 +1501,8 @@ bool LutCalibrator::finalize(bool fastTrack)
 					_lutBuffer[ind_lutd + 2] = clampToInt(b, 0, 255);
 
 				}
+		});
+
 		file.write((const char*)_lutBuffer, LUT_FILE_SIZE);
 
 		if (_mjpegCalibration && fastTrack)
@@ -1341,7 +1515,11 @@ bool LutCalibrator::finalize(bool fastTrack)
 		Debug(_log, "LUT YUV table (3/3) is ready");
 
 		// finish
-		file.close();
+		if (!file.commit())
+		{
+			Error(_log, "Could not save: %s (%s)", QSTRING_CSTR(fileName), QSTRING_CSTR(file.errorString()));
+			ok = false;
+		}
 		Debug(_log, "Your new LUT file is saved as %s. Is ready for usage: %s.", QSTRING_CSTR(fileName), (fastTrack) ? "NO. It's temporary LUT table without HDR information." : "YES");
 		Debug(_log, "---------------------- LUT table is saved -----------------------");
 		Debug(_log, "");
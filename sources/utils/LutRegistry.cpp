@@ -0,0 +1,219 @@
+/* LutRegistry.cpp
+*
+*  MIT License
+*
+*  Copyright (c) 2023 awawa-dev
+*
+*  Project homesite: https://github.com/awawa-dev/HyperHDR
+*
+*  Permission is hereby granted, free of charge, to any person obtaining a copy
+*  of this software and associated documentation files (the "Software"), to deal
+*  in the Software without restriction, including without limitation the rights
+*  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+*  copies of the Software, and to permit persons to whom the Software is
+*  furnished to do so, subject to the following conditions:
+*
+*  The above copyright notice and this permission notice shall be included in all
+*  copies or substantial portions of the Software.
+
+*  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+*  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+*  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+*  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+*  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+*  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+*  SOFTWARE.
+*/
+
+#include <utils/LutRegistry.h>
+#include <utils/Logger.h>
+#include <utils/FrameDecoder.h>
+
+#include <QFileInfo>
+#include <QDateTime>
+#include <QMutexLocker>
+
+#include <cstdlib>
+#include <cstring>
+
+// padding for the unaligned 32-bit reads of the last LUT entry
+#define LUT_PADDING 4
+
+QMutex LutRegistry::_locker;
+std::map<QString, std::weak_ptr<const LutTable>> LutRegistry::_tables;
+std::vector<std::shared_ptr<const LutTable>> LutRegistry::_kept;
+
+LutTable::LutTable() :
+	_mapped(nullptr),
+	_buffer(nullptr),
+	_size(0),
+	_memory(MemoryAccounting::LUT)
+{
+}
+
+LutTable::~LutTable()
+{
+	if (_mapped != nullptr)
+		_file.unmap(_mapped);
+	_mapped = nullptr;
+
+	if (_file.isOpen())
+		_file.close();
+
+	if (_buffer != nullptr)
+		free(_buffer);
+	_buffer = nullptr;
+}
+
+const uint8_t* LutTable::data() const
+{
+	return (_mapped != nullptr) ? _mapped : _buffer;
+}
+
+qint64 LutTable::size() const
+{
+	return _size;
+}
+
+bool LutTable::isMapped() const
+{
+	return _mapped != nullptr;
+}
+
+LutSnapshot::LutSnapshot(const std::shared_ptr<const LutTable>& table, const CompactLut& compactLut) :
+	_table((compactLut.isValid()) ? nullptr : table),
+	_compactLut(compactLut)
+{
+}
+
+const uint8_t* LutSnapshot::buffer() const
+{
+	return (_table != nullptr) ? _table->data() : nullptr;
+}
+
+const CompactLut* LutSnapshot::compactLut() const
+{
+	return (_compactLut.isValid()) ? &_compactLut : nullptr;
+}
+
+std::shared_ptr<const LutTable> LutRegistry::acquire(const QString& fileName, qint64 offset, qint64 size, Logger* log)
+{
+	QFileInfo info(fileName);
+
+	if (!info.exists() || info.size() < offset + size)
+		return nullptr;
+
+	// the file could be replaced by the calibrator or the LUT installer: the modification time is part of the key
+	QString key = QString("%1:%2:%3:%4").arg(info.canonicalFilePath()).arg(offset).arg(size).arg(info.lastModified().toMSecsSinceEpoch());
+
+	QMutexLocker lockme(&_locker);
+
+	auto cached = _tables.find(key);
+	if (cached != _tables.end())
+	{
+		std::shared_ptr<const LutTable> table = cached->second.lock();
+		if (table != nullptr)
+		{
+			Debug(log, "Reusing shared LUT table: %s (offset: %lli)", QSTRING_CSTR(fileName), offset);
+			return table;
+		}
+	}
+
+	std::shared_ptr<LutTable> table(new LutTable());
+	table->_size = size;
+	table->_file.setFileName(fileName);
+
+	if (!table->_file.open(QIODevice::ReadOnly))
+	{
+		Error(log, "Could not open LUT file: %s", QSTRING_CSTR(fileName));
+		return nullptr;
+	}
+
+#if !defined(_WIN32) && !defined(WIN32) && !defined(USE_BLOCKED_LUT)
+	// Windows locks mapped files so they could not be replaced by a new LUT: always use a private copy there
+	if (offset + size + LUT_PADDING <= table->_file.size())
+		table->_mapped = table->_file.map(offset, size + LUT_PADDING);
+#endif
+
+	if (table->_mapped == nullptr)
+	{
+		table->_buffer = (uint8_t*)malloc(size + LUT_PADDING);
+
+		if (table->_buffer == nullptr || !table->_file.seek(offset) || table->_file.read((char*)table->_buffer, size) != size)
+		{
+			Error(log, "Error reading LUT file %s", QSTRING_CSTR(fileName));
+			return nullptr;
+		}
+
+		memset(table->_buffer + size, 0, LUT_PADDING);
+		table->_file.close();
+
+	#ifdef USE_BLOCKED_LUT
+		// the file is always stored in the linear layout
+		if (size == 256 * 256 * 256 * 3)
+		{
+			uint8_t* blocked = (uint8_t*)malloc(size + LUT_PADDING);
+
+			if (blocked == nullptr)
+			{
+				Error(log, "Could not allocate memory for the LUT table");
+				return nullptr;
+			}
+
+			FrameDecoder::convertLinearLut(table->_buffer, blocked);
+			memset(blocked + size, 0, LUT_PADDING);
+			free(table->_buffer);
+			table->_buffer = blocked;
+		}
+	#endif
+	}
+
+	Debug(log, "LUT table %s: %s (offset: %lli)", (table->isMapped()) ? "is memory-mapped" : "has been loaded", QSTRING_CSTR(fileName), offset);
+
+	// drop expired entries
+	for (auto it = _tables.begin(); it != _tables.end();)
+	{
+		if (it->second.expired())
+			it = _tables.erase(it);
+		else
+			++it;
+	}
+
+	_tables[key] = table;
+	table->_memory.set(size + LUT_PADDING);
+
+	return table;
+}
+
+std::shared_ptr<const LutTable> LutRegistry::acquireGenerated(const QString& name, qint64 size, const std::function<void(uint8_t*)>& generator, bool keep)
+{
+	QString key = QString("generated:%1:%2").arg(name).arg(size);
+
+	QMutexLocker lockme(&_locker);
+
+	auto cached = _tables.find(key);
+	if (cached != _tables.end())
+	{
+		std::shared_ptr<const LutTable> table = cached->second.lock();
+		if (table != nullptr)
+			return table;
+	}
+
+	std::shared_ptr<LutTable> table(new LutTable());
+	table->_size = size;
+	table->_buffer = (uint8_t*)malloc(size + LUT_PADDING);
+
+	if (table->_buffer == nullptr)
+		return nullptr;
+
+	memset(table->_buffer + size, 0, LUT_PADDING);
+	generator(table->_buffer);
+
+	_tables[key] = table;
+	table->_memory.set(size + LUT_PADDING);
+
+	if (keep)
+		_kept.push_back(table);
+
+	return table;
+}
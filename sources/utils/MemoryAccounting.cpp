@@ -0,0 +1,186 @@
+/* MemoryAccounting.cpp
+*
+*  MIT License
+*
+*  Copyright (c) 2023 awawa-dev
+*
+*  Project homesite: https://github.com/awawa-dev/HyperHDR
+*
+*  Permission is hereby granted, free of charge, to any person obtaining a copy
+*  of this software and associated documentation files (the "Software"), to deal
+*  in the Software without restriction, including without limitation the rights
+*  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+*  copies of the Software, and to permit persons to whom the Software is
+*  furnished to do so, subject to the following conditions:
+*
+*  The above copyright notice and this permission notice shall be included in all
+*  copies or substantial portions of the Software.
+
+*  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+*  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+*  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+*  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+*  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+*  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+*  SOFTWARE.
+*/
+
+#include <algorithm>
+#include <iterator>
+
+#include <utils/MemoryAccounting.h>
+#include <utils/InternalClock.h>
+
+#include <QJsonArray>
+#include <QMutex>
+#include <QMutexLocker>
+#include <QStringList>
+
+MemoryAccounting::Counters MemoryAccounting::_counters[MemoryAccounting::SUBSYSTEMS] = {};
+
+namespace
+{
+	// the allocation rate of the last complete second
+	QMutex		_rateLock;
+	qint64		_rateTime = 0;
+	uint64_t	_rateAllocations[MemoryAccounting::SUBSYSTEMS] = {};
+	double		_rate[MemoryAccounting::SUBSYSTEMS] = {};
+
+	const char* const _names[MemoryAccounting::SUBSYSTEMS] = {
+		"lut", "video_buffers", "video_cache", "led_mapping", "muxer", "log_buffer", "web_sessions"
+	};
+}
+
+void MemoryAccounting::allocated(Subsystem subsystem, size_t bytes)
+{
+	Counters& counters = _counters[subsystem];
+	const int64_t held = counters.held.fetch_add(static_cast<int64_t>(bytes), std::memory_order_relaxed) + static_cast<int64_t>(bytes);
+
+	counters.allocations.fetch_add(1, std::memory_order_relaxed);
+
+	int64_t peak = counters.peak.load(std::memory_order_relaxed);
+	while (held > peak && !counters.peak.compare_exchange_weak(peak, held, std::memory_order_relaxed))
+	{
+	}
+}
+
+void MemoryAccounting::released(Subsystem subsystem, size_t bytes)
+{
+	_counters[subsystem].held.fetch_sub(static_cast<int64_t>(bytes), std::memory_order_relaxed);
+}
+
+QString MemoryAccounting::subsystemName(Subsystem subsystem)
+{
+	return (subsystem >= 0 && subsystem < SUBSYSTEMS) ? QString(_names[subsystem]) : QString("unknown");
+}
+
+QJsonObject MemoryAccounting::toJson()
+{
+	double rate[SUBSYSTEMS];
+
+	{
+		QMutexLocker locker(&_rateLock);
+
+		const qint64 now = InternalClock::now();
+		const qint64 elapsed = now - _rateTime;
+
+		if (elapsed >= 1000)
+		{
+			for (int i = 0; i < SUBSYSTEMS; i++)
+			{
+				const uint64_t allocations = _counters[i].allocations.load(std::memory_order_relaxed);
+				_rate[i] = (_rateTime > 0) ? (allocations - _rateAllocations[i]) * 1000.0 / elapsed : 0.0;
+				_rateAllocations[i] = allocations;
+			}
+			_rateTime = now;
+		}
+
+		std::copy(std::begin(_rate), std::end(_rate), std::begin(rate));
+	}
+
+	QJsonArray subsystems;
+	int64_t totalHeld = 0;
+	double totalRate = 0;
+
+	for (int i = 0; i < SUBSYSTEMS; i++)
+	{
+		const int64_t held = _counters[i].held.load(std::memory_order_relaxed);
+		QJsonObject entry;
+
+		entry["name"] = _names[i];
+		entry["held"] = static_cast<qint64>(held);
+		entry["peak"] = static_cast<qint64>(_counters[i].peak.load(std::memory_order_relaxed));
+		entry["allocations"] = static_cast<qint64>(_counters[i].allocations.load(std::memory_order_relaxed));
+		entry["allocationsPerSecond"] = rate[i];
+		subsystems.append(entry);
+
+		totalHeld += held;
+		totalRate += rate[i];
+	}
+
+	QJsonObject result;
+	result["subsystems"] = subsystems;
+	result["held"] = static_cast<qint64>(totalHeld);
+	result["allocationsPerSecond"] = totalRate;
+	return result;
+}
+
+QString MemoryAccounting::toString()
+{
+	const QJsonObject usage = toJson();
+	QStringList list;
+
+	for (const auto& item : usage["subsystems"].toArray())
+	{
+		const QJsonObject entry = item.toObject();
+		list.append(QString("%1: %2 kB (peak: %3 kB, %4 alloc/s)").arg(entry["name"].toString())
+			.arg(entry["held"].toDouble() / 1024, 0, 'f', 1).arg(entry["peak"].toDouble() / 1024, 0, 'f', 1)
+			.arg(entry["allocationsPerSecond"].toDouble(), 0, 'f', 1));
+	}
+
+	return QString("Memory held: %1 kB. %2").arg(usage["held"].toDouble() / 1024, 0, 'f', 1).arg(list.join(", "));
+}
+
+MemoryAccounting::Tag::Tag(Subsystem subsystem)
+	: _subsystem(subsystem)
+	, _bytes(0)
+{
+}
+
+MemoryAccounting::Tag::Tag(const Tag& other)
+	: _subsystem(other._subsystem)
+	, _bytes(0)
+{
+	set(other._bytes);
+}
+
+MemoryAccounting::Tag& MemoryAccounting::Tag::operator=(const Tag& other)
+{
+	if (this != &other)
+	{
+		set(0);
+		_subsystem = other._subsystem;
+		set(other._bytes);
+	}
+	return *this;
+}
+
+MemoryAccounting::Tag::~Tag()
+{
+	set(0);
+}
+
+void MemoryAccounting::Tag::set(size_t bytes)
+{
+	if (bytes > _bytes)
+		allocated(_subsystem, bytes - _bytes);
+	else if (bytes < _bytes)
+		released(_subsystem, _bytes - bytes);
+
+	_bytes = bytes;
+}
+
+size_t MemoryAccounting::Tag::bytes() const
+{
+	return _bytes;
+}
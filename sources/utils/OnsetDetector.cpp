@@ -0,0 +1,153 @@
+/* OnsetDetector.cpp
+*
+*  MIT License
+*
+*  Copyright (c) 2023 awawa-dev
+*
+*  Project homesite: https://github.com/awawa-dev/HyperHDR
+*
+*  Permission is hereby granted, free of charge, to any person obtaining a copy
+*  of this software and associated documentation files (the "Software"), to deal
+*  in the Software without restriction, including without limitation the rights
+*  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+*  copies of the Software, and to permit persons to whom the Software is
+*  furnished to do so, subject to the following conditions:
+*
+*  The above copyright notice and this permission notice shall be included in all
+*  copies or substantial portions of the Software.
+
+*  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+*  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+*  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+*  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+*  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+*  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+*  SOFTWARE.
+*/
+
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+#include <utils/OnsetDetector.h>
+
+namespace
+{
+	/// flux values in the median of the threshold
+	const int HISTORY = 32;
+	/// the threshold is the median times FACTOR plus FLOOR, the floor ignores the flux of a noise
+	const float FACTOR = 1.5f;
+	const float FLOOR = 0.5f;
+	/// minimum distance between two onsets [ms]
+	const int64_t MIN_GAP = 100;
+	/// compression of the magnitudes before the difference: log(1 + COMPRESSION * magnitude)
+	const float COMPRESSION = 0.1f;
+}
+
+OnsetDetector::OnsetDetector(int windowSize, int hop, int sampleRate) :
+	_windowSize(windowSize),
+	_hop(hop),
+	_sampleRate(sampleRate),
+	_fft(windowSize),
+	_window(windowSize),
+	_magnitudes(windowSize / 2),
+	_previous(windowSize / 2),
+	_history(HISTORY),
+	_sorted(HISTORY)
+{
+	reset();
+}
+
+void OnsetDetector::reset()
+{
+	std::fill(_window.begin(), _window.end(), 0);
+	std::fill(_previous.begin(), _previous.end(), 0.0f);
+	_historyPos = 0;
+	_historyCount = 0;
+	_lastFlux = 0;
+	_peakFlux = 0;
+	_peakThreshold = 0;
+	_peakTime = 0;
+	_lastOnset = 0;
+}
+
+int OnsetDetector::hopTime() const
+{
+	return (_hop * 1000) / _sampleRate;
+}
+
+float OnsetDetector::flux()
+{
+	_fft.magnitudes(_window.data(), _magnitudes.data());
+
+	float sum = 0;
+	for (size_t i = 0; i < _magnitudes.size(); i++)
+	{
+		const float current = std::log1p(COMPRESSION * _magnitudes[i]);
+		sum += std::max(current - _previous[i], 0.0f);
+		_previous[i] = current;
+	}
+
+	return sum;
+}
+
+float OnsetDetector::threshold()
+{
+	if (_historyCount == 0)
+		return FLOOR;
+
+	std::copy(_history.begin(), _history.begin() + _historyCount, _sorted.begin());
+	auto middle = _sorted.begin() + _historyCount / 2;
+	std::nth_element(_sorted.begin(), middle, _sorted.begin() + _historyCount);
+
+	return (*middle) * FACTOR + FLOOR;
+}
+
+bool OnsetDetector::process(const int16_t* samples, int count, int64_t endTime, Onset& onset)
+{
+	bool found = false;
+
+	for (int offset = 0; offset + _hop <= count; offset += _hop)
+	{
+		memmove(_window.data(), _window.data() + _hop, (_windowSize - _hop) * sizeof(int16_t));
+		memcpy(_window.data() + _windowSize - _hop, samples + offset, _hop * sizeof(int16_t));
+
+		const int64_t time = endTime - ((int64_t)(count - offset - _hop) * 1000) / _sampleRate;
+		const float current = flux();
+
+		// the previous hop is a peak if it rose above the threshold and this one is lower
+		if (_peakFlux > _peakThreshold && current < _peakFlux && _peakTime - _lastOnset >= MIN_GAP)
+		{
+			const float strength = 1.0f - _peakThreshold / _peakFlux;
+
+			if (!found || strength > onset.strength)
+			{
+				onset.time = _peakTime;
+				onset.strength = strength;
+			}
+
+			found = true;
+			_lastOnset = _peakTime;
+		}
+
+		const float limit = threshold();
+
+		if (current > _lastFlux)
+		{
+			_peakFlux = current;
+			_peakThreshold = limit;
+			_peakTime = time;
+		}
+		else
+			_peakFlux = 0;
+
+		_lastFlux = current;
+
+		_history[_historyPos] = current;
+		_historyPos = (_historyPos + 1) % HISTORY;
+		_historyCount = std::min(_historyCount + 1, HISTORY);
+	}
+
+	return found;
+}
@@ -27,18 +27,110 @@
 
 #include <utils/PerformanceCounters.h>
 #include <utils/Logger.h>
+#include <utils/MemoryAccounting.h>
 #include <QFile>
 #include <QJsonArray>
+#include <QMap>
 #include <QMutableListIterator>
 #include <QTextStream>
 #include <HyperhdrConfig.h>
 
+#include <algorithm>
+
 #ifdef ENABLE_BONJOUR
 	#include <bonjour/DiscoveryWrapper.h>
 #endif
 
 std::unique_ptr<PerformanceCounters> PerformanceCounters::_instance = nullptr;
 
+namespace
+{
+	QString histogramToString(const QJsonObject& histogram)
+	{
+		if (histogram.isEmpty())
+			return QString();
+
+		return QString(", p50 = %1ms, p90 = %2ms, p99 = %3ms, max = %4ms").arg(histogram["p50"].toDouble(), 0, 'f', 1).
+			arg(histogram["p90"].toDouble(), 0, 'f', 1).arg(histogram["p99"].toDouble(), 0, 'f', 1).arg(histogram["max"].toDouble(), 0, 'f', 1);
+	}
+
+	// the busiest threads, a thread below 1% of a core is skipped
+	QString threadUsageToString(QList<SystemPerformanceCounters::ThreadUsage> threads)
+	{
+		QStringList list;
+
+		std::sort(threads.begin(), threads.end(), [](const SystemPerformanceCounters::ThreadUsage& a, const SystemPerformanceCounters::ThreadUsage& b) { return a.usage > b.usage; });
+
+		for (const auto& thread : threads)
+		{
+			if (thread.usage < 1 || list.size() >= 8)
+				break;
+
+			QString color = (thread.usage < 50) ? "cpu_low_usage" : ((thread.usage < 90) ? "cpu_medium_usage" : "cpu_high_usage");
+			list.append(QString("%1 <span class='%2'>%3%</span>").arg(thread.name.toHtmlEscaped()).arg(color).arg(qRound(thread.usage)));
+		}
+
+		return list.join(", ");
+	}
+
+	// the samples of a metric family must be written together, after its TYPE and HELP
+	class OpenMetricsWriter
+	{
+	public:
+		void add(const QString& family, const QString& type, const QString& help, const QString& labels, double value, const QString& suffix = QString())
+		{
+			if (!_families.contains(family))
+			{
+				_order.append(family);
+				_families[family] = QString("# TYPE %1 %2\n# HELP %1 %3\n").arg(family).arg(type).arg(help);
+			}
+
+			// the labels are appended as they are: a report name may contain a placeholder of QString::arg
+			QString& samples = _families[family];
+			samples += family + suffix;
+			if (!labels.isEmpty())
+				samples += "{" + labels + "}";
+			samples += " " + QString::number(value, 'g', 12) + "\n";
+		}
+
+		void addSummary(const QString& family, const QString& help, const QString& labels, const QJsonObject& histogram)
+		{
+			if (histogram.isEmpty())
+				return;
+
+			const QString separator = (labels.isEmpty()) ? "" : ",";
+			const double count = histogram["count"].toDouble();
+
+			add(family, "summary", help, labels + separator + "quantile=\"0.5\"", histogram["p50"].toDouble() / 1000.0);
+			add(family, "summary", help, labels + separator + "quantile=\"0.9\"", histogram["p90"].toDouble() / 1000.0);
+			add(family, "summary", help, labels + separator + "quantile=\"0.99\"", histogram["p99"].toDouble() / 1000.0);
+			add(family, "summary", help, labels, count, "_count");
+			add(family, "summary", help, labels, count * histogram["avg"].toDouble() / 1000.0, "_sum");
+		}
+
+		static QString label(const QString& name, const QString& value)
+		{
+			QString escaped = value;
+			escaped.replace("\\", "\\\\").replace("\"", "\\\"").replace("\n", "\\n");
+			return QString("%1=\"%2\"").arg(name).arg(escaped);
+		}
+
+		QString toString() const
+		{
+			QString result;
+
+			for (const QString& family : _order)
+				result += _families[family];
+
+			return result + "# EOF\n";
+		}
+
+	private:
+		QStringList				_order;
+		QMap<QString, QString>	_families;
+	};
+}
+
 PerformanceReport::PerformanceReport(int _type, qint64 _token, QString _name, double _param1, qint64 _param2, qint64 _param3, qint64 _param4, int _id)
 {
 	PerformanceReportType _testType = PerformanceReportType::UNKNOWN;
@@ -52,6 +144,17 @@ PerformanceReport::PerformanceReport(int _type, qint64 _token, QString _name, do
 		case static_cast<int>(PerformanceReportType::RAM_USAGE):
 		case static_cast<int>(PerformanceReportType::CPU_TEMPERATURE):
 		case static_cast<int>(PerformanceReportType::SYSTEM_UNDERVOLTAGE):
+		case static_cast<int>(PerformanceReportType::FRAME_POOL):
+		case static_cast<int>(PerformanceReportType::FRAME_DROPS):
+		case static_cast<int>(PerformanceReportType::LATENCY):
+		case static_cast<int>(PerformanceReportType::FRAME_QUEUE):
+		case static_cast<int>(PerformanceReportType::SMOOTHING_TIMER):
+		case static_cast<int>(PerformanceReportType::REFRESH_TIMER):
+		case static_cast<int>(PerformanceReportType::FORWARDER):
+		case static_cast<int>(PerformanceReportType::EFFECT):
+		case static_cast<int>(PerformanceReportType::PIPELINE):
+		case static_cast<int>(PerformanceReportType::THREAD_USAGE):
+		case static_cast<int>(PerformanceReportType::QUALITY_GOVERNOR):
 			_testType = static_cast<PerformanceReportType>(_type);
 			break;
 	}
@@ -131,6 +234,15 @@ void PerformanceCounters::request(bool all)
 		createUpdate(pr);
 	}
 
+	_threadUsage = _system.getThreads();
+	if (!_threadUsage.isEmpty())
+	{
+		PerformanceReport pr;
+		pr.type = static_cast<int>(PerformanceReportType::THREAD_USAGE);
+		pr.name = threadUsageToString(_threadUsage);
+		createUpdate(pr);
+	}
+
 	QString under = _system.getUNDERVOLATGE();
 	if (under != "")
 	{
@@ -149,6 +261,126 @@ void PerformanceCounters::request(bool all)
 	}
 }
 
+QString PerformanceCounters::getOpenMetrics()
+{
+	OpenMetricsWriter metrics;
+
+	for (const PerformanceReport& pr : _reports)
+	{
+		// the placeholder of a source that waits for its first statistics period
+		if (pr.token <= 0)
+			continue;
+
+		const QString instance = OpenMetricsWriter::label("instance", QString::number(pr.id));
+
+		switch (static_cast<PerformanceReportType>(pr.type))
+		{
+			case PerformanceReportType::VIDEO_GRABBER:
+			{
+				const QString device = OpenMetricsWriter::label("device", pr.name);
+				metrics.add("hyperhdr_capture_fps", "gauge", "Captured frames per second", device, pr.param1);
+				metrics.add("hyperhdr_capture_frames", "gauge", "Decoded frames in the last statistics period", device, pr.param3);
+				metrics.add("hyperhdr_capture_invalid_frames", "gauge", "Invalid frames in the last statistics period", device, pr.param4);
+				metrics.addSummary("hyperhdr_capture_decoding_seconds", "Decoding time of the captured frames", device, pr.histogram);
+				break;
+			}
+			case PerformanceReportType::FRAME_DROPS:
+			{
+				const QString device = OpenMetricsWriter::label("device", pr.name);
+				const QString help = "Captured frames dropped in the last statistics period";
+				metrics.add("hyperhdr_capture_dropped_frames", "gauge", help, device + "," + OpenMetricsWriter::label("reason", "queue_full"), pr.param2);
+				metrics.add("hyperhdr_capture_dropped_frames", "gauge", help, device + "," + OpenMetricsWriter::label("reason", "stale"), pr.param3);
+				metrics.add("hyperhdr_capture_dropped_frames", "gauge", help, device + "," + OpenMetricsWriter::label("reason", "over_budget"), pr.param4);
+				break;
+			}
+			case PerformanceReportType::INSTANCE:
+			{
+				const QString labels = instance + "," + OpenMetricsWriter::label("name", pr.name);
+				metrics.add("hyperhdr_instance_fps", "gauge", "Processed frames per second", labels, pr.param1);
+				metrics.add("hyperhdr_instance_frames", "gauge", "Processed frames in the last statistics period", labels, pr.param2);
+				metrics.addSummary("hyperhdr_instance_processing_seconds", "Time from the queueing of a frame to the adjusted LED colors", labels, pr.histogram);
+				break;
+			}
+			case PerformanceReportType::FRAME_QUEUE:
+			{
+				const QString help = "Frames of the processing queue in the last statistics period";
+				metrics.add("hyperhdr_instance_queue_frames", "gauge", help, instance + "," + OpenMetricsWriter::label("state", "received"), pr.param2);
+				metrics.add("hyperhdr_instance_queue_frames", "gauge", help, instance + "," + OpenMetricsWriter::label("state", "coalesced"), pr.param3);
+				metrics.add("hyperhdr_instance_queue_frames", "gauge", help, instance + "," + OpenMetricsWriter::label("state", "processed"), pr.param4);
+				break;
+			}
+			case PerformanceReportType::LED:
+			{
+				const QString labels = instance + "," + OpenMetricsWriter::label("device", pr.name);
+				const QString help = "LED frames in the last statistics period";
+				metrics.add("hyperhdr_device_fps", "gauge", "LED frames written per second", labels, pr.param1);
+				metrics.add("hyperhdr_device_frames", "gauge", help, labels + "," + OpenMetricsWriter::label("state", "sent"), pr.param2);
+				metrics.add("hyperhdr_device_frames", "gauge", help, labels + "," + OpenMetricsWriter::label("state", "processed"), pr.param3);
+				metrics.add("hyperhdr_device_frames", "gauge", help, labels + "," + OpenMetricsWriter::label("state", "dropped"), pr.param4);
+				metrics.addSummary("hyperhdr_device_write_seconds", "Duration of the LED device writes", labels, pr.histogram);
+				break;
+			}
+			case PerformanceReportType::LATENCY:
+				metrics.addSummary("hyperhdr_glass_to_wire_seconds", "Time from the capture of a frame to the write of its LED colors", instance, pr.histogram);
+				break;
+			case PerformanceReportType::PIPELINE:
+				metrics.addSummary("hyperhdr_pipeline_seconds", "Time between the first and the last traced stage of a frame", instance, pr.histogram);
+				break;
+			case PerformanceReportType::FRAME_POOL:
+				metrics.add("hyperhdr_frame_pool_hit_ratio", "gauge", "Hit ratio of the video memory pool", "", pr.param1 / 100.0);
+				metrics.add("hyperhdr_frame_pool_requests", "gauge", "Video memory pool requests in the last statistics period", OpenMetricsWriter::label("result", "hit"), pr.param2);
+				metrics.add("hyperhdr_frame_pool_requests", "gauge", "Video memory pool requests in the last statistics period", OpenMetricsWriter::label("result", "miss"), pr.param3);
+				metrics.add("hyperhdr_frame_pool_bytes", "gauge", "Footprint of the video memory pool", "", pr.param4);
+				break;
+			case PerformanceReportType::QUALITY_GOVERNOR:
+				metrics.add("hyperhdr_quality_governor_level", "gauge", "Quality step of the governor, 0 is the full quality", "", pr.param1);
+				break;
+			default:
+				break;
+		}
+	}
+
+	// the dashboard refreshes the readings every second, otherwise the scrape does it
+	if (InternalClock::now() - _lastRead >= 980)
+	{
+		_system.getCPU();
+		_system.getRAM();
+		_system.getTEMP();
+		_threadUsage = _system.getThreads();
+	}
+
+	for (const auto& thread : _threadUsage)
+		metrics.add("hyperhdr_thread_cpu_usage_ratio", "gauge", "CPU usage of a thread of HyperHDR, 1 is a busy core",
+			OpenMetricsWriter::label("thread", thread.name) + "," + OpenMetricsWriter::label("tid", QString::number(thread.id)), thread.usage / 100.0);
+
+	const SystemPerformanceCounters::Readings& readings = _system.getReadings();
+
+	if (readings.cpuUsage >= 0)
+		metrics.add("hyperhdr_system_cpu_usage_ratio", "gauge", "CPU usage of the system", "", readings.cpuUsage / 100.0);
+
+	if (readings.ramTotal > 0)
+	{
+		metrics.add("hyperhdr_system_memory_used_bytes", "gauge", "Memory used by the system", "", readings.ramUsed * 1024.0 * 1024.0);
+		metrics.add("hyperhdr_system_memory_total_bytes", "gauge", "Memory of the system", "", readings.ramTotal * 1024.0 * 1024.0);
+	}
+
+	if (readings.temperature >= 0)
+		metrics.add("hyperhdr_system_temperature_celsius", "gauge", "CPU temperature", "", readings.temperature);
+
+	const QJsonObject memory = MemoryAccounting::toJson();
+	for (const auto& item : memory["subsystems"].toArray())
+	{
+		const QJsonObject entry = item.toObject();
+		const QString subsystem = OpenMetricsWriter::label("subsystem", entry["name"].toString());
+
+		metrics.add("hyperhdr_memory_bytes", "gauge", "Memory held by a subsystem of HyperHDR", subsystem, entry["held"].toDouble());
+		metrics.add("hyperhdr_memory_peak_bytes", "gauge", "Peak of the memory held by a subsystem of HyperHDR", subsystem, entry["peak"].toDouble());
+		metrics.add("hyperhdr_memory_allocations_rate", "gauge", "Allocations per second of a subsystem of HyperHDR", subsystem, entry["allocationsPerSecond"].toDouble());
+	}
+
+	return metrics.toString();
+}
+
 PerformanceCounters* PerformanceCounters::getInstance()
 {
 	if (PerformanceCounters::_instance == nullptr)
@@ -243,17 +475,49 @@ void PerformanceCounters::consoleReport(int type, int token)
 		if (del.type == static_cast<int>(PerformanceReportType::VIDEO_GRABBER))
 		{
 			if (del.token > 0)
-				list.append(QString("[USB capturing: FPS = %1, decoding = %2ms, frames = %3, invalid = %4]").arg(del.param1, 0, 'f', 2).arg(del.param2).arg(del.param3).arg(del.param4));
+				list.append(QString("[USB capturing: FPS = %1, decoding = %2ms, frames = %3, invalid = %4%5]").arg(del.param1, 0, 'f', 2).arg(del.param2).arg(del.param3).arg(del.param4).arg(histogramToString(del.histogram)));
 		}
 		else if (del.type == static_cast<int>(PerformanceReportType::INSTANCE))
 		{
 			if (del.token > 0)
-				list.append(QString("[INSTANCE%1: FPS = %2, processed = %3]").arg(del.id).arg(del.param1, 0, 'f', 2).arg(del.param2));
+				list.append(QString("[INSTANCE%1: FPS = %2, processed = %3, superseded = %4, over budget = %5%6]").arg(del.id).arg(del.param1, 0, 'f', 2).arg(del.param2).arg(del.param3).arg(del.param4).arg(histogramToString(del.histogram)));
 		}
 		else if (del.type == static_cast<int>(PerformanceReportType::LED))
 		{
 			if (del.token > 0)
-				list.append(QString("[LED%1: FPS = %2, send = %3, processed = %4, dropped = %5]").arg(del.id).arg(del.param1, 0, 'f', 2).arg(del.param2).arg(del.param3).arg(del.param4));
+				list.append(QString("[LED%1: FPS = %2, send = %3, processed = %4, dropped = %5%6]").arg(del.id).arg(del.param1, 0, 'f', 2).arg(del.param2).arg(del.param3).arg(del.param4).
+					arg((del.detail.isEmpty()) ? QString() : QString(", write: %1").arg(del.detail)));
+		}
+		else if (del.type == static_cast<int>(PerformanceReportType::LATENCY))
+		{
+			if (del.token > 0)
+				list.append(QString("[LATENCY%1: %2]").arg(del.id).arg(del.name));
+		}
+		else if (del.type == static_cast<int>(PerformanceReportType::PIPELINE))
+		{
+			if (del.token > 0)
+				list.append(QString("[PIPELINE%1: %2]").arg(del.id).arg(del.name));
+		}
+		else if (del.type == static_cast<int>(PerformanceReportType::FRAME_QUEUE))
+		{
+			if (del.token > 0)
+				list.append(QString("[QUEUE%1: received = %2, coalesced = %3, processed = %4]").arg(del.id).arg(del.param2).arg(del.param3).arg(del.param4));
+		}
+		else if (del.type == static_cast<int>(PerformanceReportType::SMOOTHING_TIMER) ||
+				 del.type == static_cast<int>(PerformanceReportType::REFRESH_TIMER))
+		{
+			if (del.token > 0)
+				list.append(QString("[%1%2 timer: ticks = %3, jitter avg = %4us, max = %5us, missed = %6]").arg((del.type == static_cast<int>(PerformanceReportType::SMOOTHING_TIMER)) ? "SMOOTHING" : "REFRESH").arg(del.id).arg(del.param3).arg(del.param1, 0, 'f', 0).arg(del.param2).arg(del.param4));
+		}
+		else if (del.type == static_cast<int>(PerformanceReportType::FORWARDER))
+		{
+			if (del.token > 0)
+				list.append(QString("[FORWARD %1: sent = %2, dropped = %3, lag avg = %4ms, max = %5ms]").arg(del.name).arg(del.param3).arg(del.param4).arg(del.param1, 0, 'f', 1).arg(del.param2));
+		}
+		else if (del.type == static_cast<int>(PerformanceReportType::EFFECT))
+		{
+			if (del.token > 0)
+				list.append(QString("[EFFECT %1: FPS = %2, render avg = %3us, max = %4us, late = %5]").arg(del.name).arg(del.param1, 0, 'f', 2).arg(del.param2).arg(del.param3).arg(del.param4));
 		}
 	}
 
@@ -275,6 +539,9 @@ void PerformanceCounters::createUpdate(PerformanceReport pr)
 	report["param2"] = pr.param2;
 	report["param3"] = pr.param3;
 	report["param4"] = pr.param4;
+	report["detail"] = pr.detail;
+	if (!pr.histogram.isEmpty())
+		report["histogram"] = pr.histogram;
 	report["id"] = pr.id;
 	if (pr.token > 0)
 		report["refresh"] = 60 - (helper % 60);
@@ -311,6 +578,9 @@ void PerformanceCounters::broadcast()
 		report["param2"] = pr.param2;
 		report["param3"] = pr.param3;
 		report["param4"] = pr.param4;
+		report["detail"] = pr.detail;
+		if (!pr.histogram.isEmpty())
+			report["histogram"] = pr.histogram;
 		report["id"] = pr.id;
 
 		if (pr.token > 0)
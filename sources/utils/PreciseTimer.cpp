@@ -0,0 +1,377 @@
+/* PreciseTimer.cpp
+*
+*  MIT License
+*
+*  Copyright (c) 2023 awawa-dev
+*
+*  Project homesite: https://github.com/awawa-dev/HyperHDR
+*
+*  Permission is hereby granted, free of charge, to any person obtaining a copy
+*  of this software and associated documentation files (the "Software"), to deal
+*  in the Software without restriction, including without limitation the rights
+*  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+*  copies of the Software, and to permit persons to whom the Software is
+*  furnished to do so, subject to the following conditions:
+*
+*  The above copyright notice and this permission notice shall be included in all
+*  copies or substantial portions of the Software.
+
+*  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+*  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+*  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+*  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+*  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+*  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+*  SOFTWARE.
+*/
+
+
+#include <chrono>
+#include <thread>
+
+#include <QThread>
+#include <QMutex>
+#include <QWaitCondition>
+
+#if defined(__linux__)
+	#include <time.h>
+	#include <errno.h>
+	#include <sys/prctl.h>
+#elif defined(_WIN32)
+	#include <windows.h>
+	#ifndef CREATE_WAITABLE_TIMER_HIGH_RESOLUTION
+		#define CREATE_WAITABLE_TIMER_HIGH_RESOLUTION 0x00000002
+	#endif
+#endif
+
+#include <utils/PreciseTimer.h>
+
+namespace
+{
+	/// the last part of the wait is a high resolution sleep, the condition variable only covers the coarse part
+	const qint64 PRECISE_SLEEP_NS = 2000000;
+}
+
+///
+/// The scheduling thread shared by all the timers
+///
+class PreciseTimerThread : public QThread
+{
+public:
+	static PreciseTimerThread* getInstance()
+	{
+		static PreciseTimerThread instance;
+		return &instance;
+	}
+
+	QMutex	_mutex;
+
+	void schedule(PreciseTimer* timer)
+	{
+		if (!_timers.contains(timer))
+			_timers.append(timer);
+
+		if (!isRunning())
+			start(QThread::TimeCriticalPriority);
+
+		_condition.wakeAll();
+	}
+
+	void unschedule(PreciseTimer* timer)
+	{
+		_timers.removeAll(timer);
+		_condition.wakeAll();
+	}
+
+private:
+	PreciseTimerThread() :
+		_quit(false)
+	{
+	}
+
+	~PreciseTimerThread()
+	{
+		{
+			QMutexLocker locker(&_mutex);
+			_quit = true;
+			_condition.wakeAll();
+		}
+		wait();
+	}
+
+	void run() override
+	{
+#if defined(__linux__)
+		// the default 50us slack of the thread would be added to every wake-up
+		prctl(PR_SET_TIMERSLACK, 1UL, 0, 0, 0);
+#elif defined(_WIN32)
+		HANDLE waitableTimer = CreateWaitableTimerExW(nullptr, nullptr, CREATE_WAITABLE_TIMER_HIGH_RESOLUTION, TIMER_ALL_ACCESS);
+		if (waitableTimer == nullptr)
+			waitableTimer = CreateWaitableTimerExW(nullptr, nullptr, 0, TIMER_ALL_ACCESS);
+#endif
+
+		QMutexLocker locker(&_mutex);
+
+		while (!_quit)
+		{
+			if (_timers.isEmpty())
+			{
+				_condition.wait(&_mutex);
+				continue;
+			}
+
+			qint64 deadline = _timers.first()->_deadline;
+			for (PreciseTimer* timer : _timers)
+				deadline = qMin(deadline, timer->_deadline);
+
+			qint64 remaining = deadline - PreciseTimer::now();
+
+			if (remaining > PRECISE_SLEEP_NS)
+			{
+				// wakes up earlier for a new or removed timer, then the schedule is evaluated again
+				_condition.wait(&_mutex, static_cast<unsigned long>((remaining - PRECISE_SLEEP_NS) / 1000000));
+				continue;
+			}
+
+			if (remaining > 0)
+			{
+				locker.unlock();
+#if defined(__linux__)
+				// steady_clock is CLOCK_MONOTONIC
+				timespec ts;
+				ts.tv_sec = static_cast<time_t>(deadline / 1000000000);
+				ts.tv_nsec = static_cast<long>(deadline % 1000000000);
+				while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, nullptr) == EINTR);
+#elif defined(_WIN32)
+				LARGE_INTEGER due;
+				due.QuadPart = -static_cast<LONGLONG>(remaining / 100);
+				if (waitableTimer != nullptr && SetWaitableTimer(waitableTimer, &due, 0, nullptr, nullptr, FALSE))
+					WaitForSingleObject(waitableTimer, INFINITE);
+				else
+					std::this_thread::sleep_for(std::chrono::nanoseconds(remaining));
+#else
+				std::this_thread::sleep_for(std::chrono::nanoseconds(remaining));
+#endif
+				locker.relock();
+				continue;
+			}
+
+			const qint64 now = PreciseTimer::now();
+
+			for (PreciseTimer* timer : _timers)
+			{
+				if (timer->_deadline > now)
+					continue;
+
+				// the previous tick still waits for the event loop: this one is merged with it
+				if (!timer->_pending.exchange(true))
+					emit timer->tickSignal(timer->_deadline, timer->_generation);
+				else
+					timer->_missed++;
+
+				// the next deadline follows the schedule, not the moment of the wake-up
+				const qint64 interval = static_cast<qint64>(timer->_interval) * 1000000;
+				timer->_deadline += interval;
+				while (timer->_deadline <= now)
+				{
+					timer->_deadline += interval;
+					timer->_missed++;
+				}
+			}
+		}
+
+#if defined(_WIN32)
+		if (waitableTimer != nullptr)
+			CloseHandle(waitableTimer);
+#endif
+	}
+
+	QWaitCondition			_condition;
+	QList<PreciseTimer*>	_timers;
+	bool					_quit;
+};
+
+PreciseTimer::PreciseTimer(QObject* parent) :
+	QObject(parent),
+	_interval(1),
+	_active(false),
+	_aligned(false),
+	_deadline(0),
+	_missed(0),
+	_generation(0),
+	_pending(false),
+	_ticks(0),
+	_delaySum(0),
+	_delayMax(0)
+{
+	connect(this, &PreciseTimer::tickSignal, this, &PreciseTimer::handleTick, Qt::QueuedConnection);
+}
+
+PreciseTimer::~PreciseTimer()
+{
+	stop();
+}
+
+void PreciseTimer::setInterval(int interval)
+{
+	PreciseTimerThread* thread = PreciseTimerThread::getInstance();
+	QMutexLocker locker(&thread->_mutex);
+
+	_interval = qMax(interval, 1);
+
+	// like QTimer: a running timer starts again with the new interval
+	if (_active)
+	{
+		_deadline = firstDeadline();
+		thread->schedule(this);
+	}
+}
+
+int PreciseTimer::interval() const
+{
+	QMutexLocker locker(&PreciseTimerThread::getInstance()->_mutex);
+
+	return _interval;
+}
+
+void PreciseTimer::start()
+{
+	PreciseTimerThread* thread = PreciseTimerThread::getInstance();
+	QMutexLocker locker(&thread->_mutex);
+
+	_active = true;
+	_generation++;
+	_pending = false;
+	_deadline = firstDeadline();
+	thread->schedule(this);
+}
+
+void PreciseTimer::stop()
+{
+	PreciseTimerThread* thread = PreciseTimerThread::getInstance();
+	QMutexLocker locker(&thread->_mutex);
+
+	_active = false;
+	_generation++;
+	thread->unschedule(this);
+}
+
+bool PreciseTimer::isActive() const
+{
+	QMutexLocker locker(&PreciseTimerThread::getInstance()->_mutex);
+
+	return _active;
+}
+
+int PreciseTimer::remainingTime() const
+{
+	QMutexLocker locker(&PreciseTimerThread::getInstance()->_mutex);
+
+	if (!_active)
+		return -1;
+
+	return static_cast<int>(qMax((_deadline - PreciseTimer::now() + 999999) / 1000000, static_cast<qint64>(0)));
+}
+
+qint64 PreciseTimer::now()
+{
+	return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+qint64 PreciseTimer::nextTick() const
+{
+	QMutexLocker locker(&PreciseTimerThread::getInstance()->_mutex);
+
+	return (_active) ? _deadline : -1;
+}
+
+void PreciseTimer::shiftSchedule(qint64 shift)
+{
+	PreciseTimerThread* thread = PreciseTimerThread::getInstance();
+	QMutexLocker locker(&thread->_mutex);
+
+	if (!_active || _aligned)
+		return;
+
+	// never into the past, then the tick would be only late
+	_deadline = qMax(_deadline + shift, now());
+	thread->schedule(this);
+}
+
+void PreciseTimer::setPhaseAligned(bool aligned)
+{
+	PreciseTimerThread* thread = PreciseTimerThread::getInstance();
+	QMutexLocker locker(&thread->_mutex);
+
+	if (_aligned == aligned)
+		return;
+
+	_aligned = aligned;
+
+	if (_active)
+	{
+		_deadline = firstDeadline();
+		thread->schedule(this);
+	}
+}
+
+bool PreciseTimer::isPhaseAligned() const
+{
+	QMutexLocker locker(&PreciseTimerThread::getInstance()->_mutex);
+
+	return _aligned;
+}
+
+qint64 PreciseTimer::firstDeadline() const
+{
+	const qint64 period = static_cast<qint64>(_interval) * 1000000;
+	const qint64 current = now();
+
+	// the schedule never drifts, so the whole multiples stay common to all the aligned timers
+	if (_aligned)
+		return (current / period + 1) * period;
+
+	return current + period;
+}
+
+PreciseTimer::JitterStats PreciseTimer::takeJitterStats()
+{
+	JitterStats stats;
+
+	stats.ticks = _ticks;
+	stats.average = (_ticks > 0) ? static_cast<double>(_delaySum) / _ticks : 0;
+	stats.max = _delayMax;
+
+	{
+		QMutexLocker locker(&PreciseTimerThread::getInstance()->_mutex);
+		stats.missed = _missed;
+		_missed = 0;
+	}
+
+	_ticks = 0;
+	_delaySum = 0;
+	_delayMax = 0;
+
+	return stats;
+}
+
+void PreciseTimer::handleTick(qint64 deadline, int generation)
+{
+	{
+		QMutexLocker locker(&PreciseTimerThread::getInstance()->_mutex);
+
+		// a tick of the previous schedule that was already queued when the timer was stopped or restarted
+		if (!_active || generation != _generation)
+			return;
+
+		_pending = false;
+	}
+
+	const qint64 delay = qMax((PreciseTimer::now() - deadline) / 1000, static_cast<qint64>(0));
+
+	_ticks++;
+	_delaySum += delay;
+	_delayMax = qMax(_delayMax, delay);
+
+	emit timeout();
+}
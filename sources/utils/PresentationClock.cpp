@@ -0,0 +1,132 @@
+/* PresentationClock.cpp
+*
+*  MIT License
+*
+*  Copyright (c) 2023 awawa-dev
+*
+*  Project homesite: https://github.com/awawa-dev/HyperHDR
+*
+*  Permission is hereby granted, free of charge, to any person obtaining a copy
+*  of this software and associated documentation files (the "Software"), to deal
+*  in the Software without restriction, including without limitation the rights
+*  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+*  copies of the Software, and to permit persons to whom the Software is
+*  furnished to do so, subject to the following conditions:
+*
+*  The above copyright notice and this permission notice shall be included in all
+*  copies or substantial portions of the Software.
+
+*  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+*  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+*  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+*  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+*  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+*  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+*  SOFTWARE.
+*/
+
+
+#include <algorithm>
+#include <chrono>
+#include <thread>
+
+#if defined(__linux__)
+	#include <time.h>
+	#include <errno.h>
+#endif
+
+#include <QMutexLocker>
+
+#include <utils/PresentationClock.h>
+#include <utils/PreciseTimer.h>
+#include <utils/WriteCadence.h>
+
+std::atomic<bool> PresentationClock::_enabled(false);
+QMutex PresentationClock::_lock;
+std::vector<std::weak_ptr<WriteCadence>> PresentationClock::_members;
+
+void PresentationClock::setEnabled(bool enabled)
+{
+	_enabled = enabled;
+}
+
+bool PresentationClock::isEnabled()
+{
+	return _enabled;
+}
+
+void PresentationClock::join(const std::shared_ptr<WriteCadence>& cadence)
+{
+	QMutexLocker locker(&_lock);
+
+	for (const auto& member : _members)
+		if (member.lock() == cadence)
+			return;
+
+	_members.push_back(cadence);
+}
+
+void PresentationClock::leave(const std::shared_ptr<WriteCadence>& cadence)
+{
+	QMutexLocker locker(&_lock);
+
+	_members.erase(std::remove_if(_members.begin(), _members.end(),
+		[&cadence](const std::weak_ptr<WriteCadence>& member) {
+			auto device = member.lock();
+			return device == nullptr || device == cadence;
+		}), _members.end());
+}
+
+bool PresentationClock::presentationTime(int64_t smoothedStamp, qint64& target)
+{
+	if (!_enabled)
+		return false;
+
+	qint64 latency = 0;
+	int devices = 0;
+
+	{
+		QMutexLocker locker(&_lock);
+
+		for (const auto& member : _members)
+		{
+			auto cadence = member.lock();
+
+			if (cadence != nullptr)
+			{
+				latency = std::max(latency, cadence->duration());
+				devices++;
+			}
+		}
+	}
+
+	if (devices < 2)
+		return false;
+
+	const qint64 now = PreciseTimer::now();
+	const qint64 origin = (smoothedStamp > 0) ? smoothedStamp * 1000 : now;
+
+	// a frame that waited in the queue of a busy device is presented late rather than never
+	target = std::min(origin + latency + MARGIN, now + MAX_WAIT);
+	return true;
+}
+
+void PresentationClock::sleepUntil(qint64 deadline)
+{
+	deadline = std::min(deadline, PreciseTimer::now() + MAX_WAIT);
+
+	const qint64 remaining = deadline - PreciseTimer::now();
+
+	if (remaining <= 0)
+		return;
+
+#if defined(__linux__)
+	// steady_clock is CLOCK_MONOTONIC
+	timespec ts;
+	ts.tv_sec = static_cast<time_t>(deadline / 1000000000);
+	ts.tv_nsec = static_cast<long>(deadline % 1000000000);
+	while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, nullptr) == EINTR);
+#else
+	std::this_thread::sleep_for(std::chrono::nanoseconds(remaining));
+#endif
+}
@@ -29,15 +29,32 @@
 #include <utils/NetOrigin.h>
 #include <utils/GlobalSignals.h>
 #include <utils/RawUdpServer.h>
+#include <utils/RenderNodeFrame.h>
+#include <utils/InternalClock.h>
 #include <base/HyperHdrInstance.h>
 
 // qt
 #include <QJsonObject>
 #include <QUdpSocket>
 #include <QCoreApplication>
-#include <QNetworkDatagram>
 #include <QTimer>
 
+#include <cstring>
+
+#if defined(__linux__)
+	#include <sys/socket.h>
+	#include <errno.h>
+#endif
+
+namespace
+{
+	/// datagrams received with one recvmmsg call, including the first one read by Qt
+	const int MAX_BATCH = 32;
+	const qint64 MAX_DATAGRAM_SIZE = 1500;
+	/// a longer datagram is truncated to it and refused as malformed
+	const qint64 BUFFER_SIZE = 1504;
+}
+
 RawUdpServer::RawUdpServer(HyperHdrInstance* hyperhdr, const QJsonDocument& config, QObject* parent)
 	: QObject(parent)
 	, _server(new QUdpSocket(this))
@@ -48,6 +65,18 @@ RawUdpServer::RawUdpServer(HyperHdrInstance* hyperhdr, const QJsonDocument& conf
 	, _hyperhdr(hyperhdr)
 	, _config(config)
 	, _inactiveTimer(new QTimer(this))
+	, _buffer(MAX_BATCH * BUFFER_SIZE)
+	, _newestSlot(-1)
+	, _newestLength(0)
+	, _renderNode(false)
+	, _renderNodeZone(0)
+	, _nodeSequence(-1)
+	, _nodeReceived(0)
+	, _nodeComplete(false)
+	, _nodeCaptureTimestamp(0)
+	, _received(0)
+	, _coalesced(0)
+	, _malformed(0)
 {
 	initServer();
 }
@@ -77,6 +106,18 @@ void RawUdpServer::initServer()
 void RawUdpServer::dataTimeout()
 {
 	_hyperhdr->setInputInactive(_priority);
+
+	reportStatistics();
+}
+
+void RawUdpServer::reportStatistics()
+{
+	if (_received > 0)
+		Debug(_log, "Received %llu datagrams: %llu coalesced into newer frames, %llu malformed", _received, _coalesced, _malformed);
+
+	_received = 0;
+	_coalesced = 0;
+	_malformed = 0;
 }
 
 
@@ -87,14 +128,21 @@ void RawUdpServer::handleSettingsUpdate(settings::type type, const QJsonDocument
 		const QJsonObject& obj = config.object();
 
 		quint16 port = obj["port"].toInt(5568);
+		bool renderNode = obj["renderNode"].toBool(false);
+		QString renderNodeGroup = obj["renderNodeGroup"].toString("239.255.28.12");
 
-		// port check
-		if (_server != nullptr && _server->localPort() != port && _initialized)
+		// port or mode check
+		if (_server != nullptr && _initialized &&
+			(_server->localPort() != port || _renderNode != renderNode || (renderNode && _renderNodeGroup != renderNodeGroup)))
 		{
 			stopServer();
 		}
 
 		_port = port;
+		_renderNode = renderNode;
+		_renderNodeGroup = renderNodeGroup;
+		_renderNodeZone = obj["renderNodeZone"].toInt(0);
+		_nodeSequence = -1;
 		_priority = obj["priority"].toInt(109);
 
 		// enable check
@@ -116,39 +164,188 @@ void RawUdpServer::handleSettingsUpdate(settings::type type, const QJsonDocument
 
 void RawUdpServer::readPendingDatagrams()
 {
-	while (_server->hasPendingDatagrams()) {
-		QNetworkDatagram datagram = _server->receiveDatagram();
+	// only the newest frame of a burst is applied: a fast sender can't queue up work for the instance
+	// the first datagram goes through Qt, that enables the read notifier again
+	while (_server->hasPendingDatagrams())
+	{
+		QHostAddress sender;
+
+		_newestSlot = -1;
+		_nodeComplete = false;
+		acceptDatagram(0, _server->readDatagram(reinterpret_cast<char*>(_buffer.data()), BUFFER_SIZE, &sender));
 
-		auto dataLen = datagram.data().length();
+		receiveBurst();
 
-		if (dataLen % 3 > 0 || dataLen > 1500 || dataLen == 0)
+		if (_newestSlot < 0 && !_nodeComplete)
 			continue;
 
 		if (_hyperhdr->getPriorityInfo(_priority).componentId != hyperhdr::COMP_RAWUDPSERVER)
-			_hyperhdr->registerInput(_priority, hyperhdr::COMP_RAWUDPSERVER, QString("%1").arg(datagram.senderAddress().toString()));
-
-		std::vector<ColorRgb> _ledColors;
+			_hyperhdr->registerInput(_priority, hyperhdr::COMP_RAWUDPSERVER, QString("%1").arg(sender.toString()));
 
-		for (int i = 0; i < dataLen;)
+		if (_nodeComplete)
 		{
-			ColorRgb c;
-			c.red = datagram.data().at(i++);
-			c.green = datagram.data().at(i++);
-			c.blue = datagram.data().at(i++);
-			_ledColors.push_back(c);
+			_hyperhdr->setInput(_priority, _ledColors, -1, true, _nodeCaptureTimestamp);
+			_inactiveTimer->start();
+			continue;
 		}
 
+		const uint8_t* data = _buffer.data() + _newestSlot * BUFFER_SIZE;
+
+		_ledColors.resize(static_cast<size_t>(_newestLength / 3));
+		memcpy(_ledColors.data(), data, static_cast<size_t>(_newestLength));
+
 		_hyperhdr->setInput(_priority, _ledColors);
 
 		_inactiveTimer->start();
 	}
 }
 
+void RawUdpServer::acceptDatagram(int slot, qint64 length)
+{
+	if (length < 0)
+		return;
+
+	_received++;
+
+	if (_renderNode)
+	{
+		acceptNodeDatagram(_buffer.data() + slot * BUFFER_SIZE, length);
+		return;
+	}
+
+	if (length % 3 > 0 || length > MAX_DATAGRAM_SIZE || length == 0)
+	{
+		_malformed++;
+		return;
+	}
+
+	if (_newestSlot >= 0)
+		_coalesced++;
+
+	_newestSlot = slot;
+	_newestLength = length;
+}
+
+void RawUdpServer::acceptNodeDatagram(const uint8_t* data, qint64 length)
+{
+	RenderNodeFrame::Header header;
+	const unsigned leds = (length <= MAX_DATAGRAM_SIZE) ? RenderNodeFrame::readHeader(data, static_cast<size_t>(length), header) : 0;
+
+	if (leds == 0)
+	{
+		_malformed++;
+		return;
+	}
+
+	// the stream of the other zones
+	if (header.zone != _renderNodeZone)
+		return;
+
+	// the parts come in order: a new sequence drops the rest of an incomplete frame
+	if (header.sequence != _nodeSequence || header.ledCount != _nodeFrame.size())
+	{
+		if (_nodeReceived > 0)
+			_coalesced++;
+
+		_nodeSequence = header.sequence;
+		_nodeFrame.resize(header.ledCount);
+		_nodeCovered.assign(header.ledCount, false);
+		_nodeReceived = 0;
+	}
+
+	memcpy(_nodeFrame.data() + header.offset, data + RenderNodeFrame::HEADER_SIZE, static_cast<size_t>(leds) * 3);
+
+	// a repeated or overlapping part doesn't count twice, the frame is complete when every LED was received
+	for (unsigned i = header.offset; i < header.offset + leds; i++)
+		if (!_nodeCovered[i])
+		{
+			_nodeCovered[i] = true;
+			_nodeReceived++;
+		}
+
+	if (_nodeReceived >= _nodeFrame.size())
+	{
+		// the newest complete frame of the burst wins
+		if (_nodeComplete)
+			_coalesced++;
+
+		_ledColors.swap(_nodeFrame);
+		_nodeFrame.resize(_ledColors.size());
+		_nodeCovered.assign(_nodeFrame.size(), false);
+		_nodeReceived = 0;
+		_nodeSequence = -1;
+		_nodeComplete = true;
+		_nodeCaptureTimestamp = (header.captureAge != RenderNodeFrame::UNKNOWN_AGE) ? InternalClock::now() - header.captureAge : 0;
+	}
+}
+
+void RawUdpServer::receiveBurst()
+{
+#if defined(__linux__)
+	const int socket = static_cast<int>(_server->socketDescriptor());
+
+	if (socket < 0)
+		return;
+
+	for (;;)
+	{
+		// the slots of the previous call are reused: keep its newest frame in the first slot
+		if (_newestSlot > 0)
+		{
+			memcpy(_buffer.data(), _buffer.data() + _newestSlot * BUFFER_SIZE, static_cast<size_t>(_newestLength));
+			_newestSlot = 0;
+		}
+
+		mmsghdr messages[MAX_BATCH - 1];
+		iovec vectors[MAX_BATCH - 1];
+
+		memset(messages, 0, sizeof(messages));
+
+		for (int i = 0; i < MAX_BATCH - 1; i++)
+		{
+			vectors[i].iov_base = _buffer.data() + (i + 1) * BUFFER_SIZE;
+			vectors[i].iov_len = BUFFER_SIZE;
+			messages[i].msg_hdr.msg_iov = &vectors[i];
+			messages[i].msg_hdr.msg_iovlen = 1;
+		}
+
+		int result;
+		while ((result = recvmmsg(socket, messages, MAX_BATCH - 1, MSG_DONTWAIT, nullptr)) < 0 && errno == EINTR);
+
+		if (result <= 0)
+			return;
+
+		for (int i = 0; i < result; i++)
+			acceptDatagram(i + 1, (messages[i].msg_hdr.msg_flags & MSG_TRUNC) ? BUFFER_SIZE : messages[i].msg_len);
+
+		if (result < MAX_BATCH - 1)
+			return;
+	}
+#else
+	// one datagram per call, only the buffer of the frame is saved
+	for (int slot = 1; _server->hasPendingDatagrams(); slot = (slot % (MAX_BATCH - 1)) + 1)
+	{
+		if (_newestSlot == slot)
+		{
+			memcpy(_buffer.data(), _buffer.data() + _newestSlot * BUFFER_SIZE, static_cast<size_t>(_newestLength));
+			_newestSlot = 0;
+		}
+
+		acceptDatagram(slot, _server->readDatagram(reinterpret_cast<char*>(_buffer.data() + slot * BUFFER_SIZE), BUFFER_SIZE));
+	}
+#endif
+}
+
 void RawUdpServer::startServer()
 {
 	if (_server != nullptr && !_initialized)
 	{
-		if (!_server->bind(QHostAddress::Any, _port))
+		// the nodes of a venue share the multicast group and the port
+		if (_renderNode && !_server->bind(QHostAddress::AnyIPv4, _port, QUdpSocket::ShareAddress | QUdpSocket::ReuseAddressHint))
+		{
+			Error(_log, "Failed to bind port %d", _port);
+		}
+		else if (!_renderNode && !_server->bind(QHostAddress::Any, _port))
 		{
 			Error(_log, "Failed to bind port %d", _port);
 		}
@@ -157,6 +354,16 @@ void RawUdpServer::startServer()
 			_initialized = true;
 
 			Info(_log, "Started on port %d. Using network interface: %s", _server->localPort(), QSTRING_CSTR(_server->localAddress().toString()));
+
+			if (_renderNode)
+			{
+				QHostAddress group(_renderNodeGroup);
+
+				if (group.isMulticast() && !_server->joinMulticastGroup(group))
+					Error(_log, "Failed to join the multicast group %s of the render nodes", QSTRING_CSTR(_renderNodeGroup));
+				else
+					Info(_log, "Render node of zone %d%s", _renderNodeZone, (group.isMulticast()) ? QSTRING_CSTR(QString(", multicast group %1").arg(_renderNodeGroup)) : "");
+			}
 		}
 	}
 }
@@ -171,6 +378,8 @@ void RawUdpServer::stopServer()
 
 		_initialized = false;
 
+		reportStatistics();
+
 		Info(_log, "Stopped");
 	}
 }
@@ -0,0 +1,137 @@
+/* RealFft.cpp
+*
+*  MIT License
+*
+*  Copyright (c) 2023 awawa-dev
+*
+*  Project homesite: https://github.com/awawa-dev/HyperHDR
+*
+*  Permission is hereby granted, free of charge, to any person obtaining a copy
+*  of this software and associated documentation files (the "Software"), to deal
+*  in the Software without restriction, including without limitation the rights
+*  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+*  copies of the Software, and to permit persons to whom the Software is
+*  furnished to do so, subject to the following conditions:
+*
+*  The above copyright notice and this permission notice shall be included in all
+*  copies or substantial portions of the Software.
+
+*  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+*  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+*  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+*  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+*  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+*  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+*  SOFTWARE.
+*/
+
+
+#include <cmath>
+
+#include <utils/RealFft.h>
+
+#ifndef M_PI
+#define M_PI 3.14159265358979323846
+#endif
+
+RealFft::RealFft(int size) :
+	_size(size)
+{
+	const int half = _size / 2;
+
+	_window.resize(_size);
+	for (int i = 0; i < _size; i++)
+		_window[i] = static_cast<float>(0.5 - 0.5 * std::cos(2.0 * M_PI * i / _size));
+
+	int bits = 0;
+	while ((1 << bits) < half)
+		bits++;
+
+	_bitReverse.resize(half);
+	for (int i = 0; i < half; i++)
+	{
+		int reversed = 0;
+		for (int b = 0; b < bits; b++)
+			if (i & (1 << b))
+				reversed |= 1 << (bits - 1 - b);
+		_bitReverse[i] = reversed;
+	}
+
+	_twiddleRe.resize(half / 2);
+	_twiddleIm.resize(half / 2);
+	for (int k = 0; k < half / 2; k++)
+	{
+		_twiddleRe[k] = static_cast<float>(std::cos(2.0 * M_PI * k / half));
+		_twiddleIm[k] = static_cast<float>(-std::sin(2.0 * M_PI * k / half));
+	}
+
+	_splitRe.resize(half);
+	_splitIm.resize(half);
+	for (int k = 0; k < half; k++)
+	{
+		_splitRe[k] = static_cast<float>(std::cos(2.0 * M_PI * k / _size));
+		_splitIm[k] = static_cast<float>(-std::sin(2.0 * M_PI * k / _size));
+	}
+
+	_re.resize(half);
+	_im.resize(half);
+}
+
+int RealFft::size() const
+{
+	return _size;
+}
+
+void RealFft::magnitudes(const int16_t* samples, float* out)
+{
+	const int half = _size / 2;
+
+	// the even samples are the real part and the odd samples the imaginary part
+	for (int i = 0; i < half; i++)
+	{
+		const int j = _bitReverse[i];
+		_re[j] = samples[2 * i] * _window[2 * i];
+		_im[j] = samples[2 * i + 1] * _window[2 * i + 1];
+	}
+
+	for (int length = 2; length <= half; length <<= 1)
+	{
+		const int middle = length / 2;
+		const int stride = half / length;
+
+		for (int start = 0; start < half; start += length)
+			for (int k = 0; k < middle; k++)
+			{
+				const float wr = _twiddleRe[k * stride];
+				const float wi = _twiddleIm[k * stride];
+				const int a = start + k;
+				const int b = a + middle;
+
+				const float tr = _re[b] * wr - _im[b] * wi;
+				const float ti = _re[b] * wi + _im[b] * wr;
+
+				_re[b] = _re[a] - tr;
+				_im[b] = _im[a] - ti;
+				_re[a] += tr;
+				_im[a] += ti;
+			}
+	}
+
+	// 2 * X[k] = (Z[k] + conj(Z[half-k])) - i * w^k * (Z[k] - conj(Z[half-k])), then |X| / size
+	const float scale = 0.5f / _size;
+
+	for (int k = 0; k < half; k++)
+	{
+		const int m = (k == 0) ? 0 : half - k;
+
+		const float evenRe = _re[k] + _re[m];
+		const float evenIm = _im[k] - _im[m];
+		const float oddRe = _im[k] + _im[m];
+		const float oddIm = _re[m] - _re[k];
+
+		const float re = evenRe + _splitRe[k] * oddRe - _splitIm[k] * oddIm;
+		const float im = evenIm + _splitRe[k] * oddIm + _splitIm[k] * oddRe;
+
+		out[k] = std::sqrt(re * re + im * im) * scale;
+	}
+}
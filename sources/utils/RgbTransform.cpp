@@ -2,6 +2,7 @@
 #include <utils/RgbTransform.h>
 #include <utils/ColorSys.h>
 #include <cmath>
+#include <algorithm>
 
 RgbTransform::RgbTransform() :
 	_log(Logger::getInstance(QString("RGB_TRANSFORM")))
@@ -51,6 +52,7 @@ void RgbTransform::init(
 	_saturationGain = saturationGain;
 	_luminanceGain = luminanceGain;
 	_luminanceMinimum = 0;
+	updateSatLumFixed();
 	_brightness = brightness;
 	_brightnessCompensation = brightnessCompensation;
 	_backLightEnabled = true;
@@ -97,6 +99,7 @@ void RgbTransform::setSaturationGain(double saturationGain)
 		Debug(_log, "set saturationGain to %f", saturationGain);
 
 	_saturationGain = saturationGain;
+	updateSatLumFixed();
 }
 
 void RgbTransform::setLuminanceGain(double luminanceGain)
@@ -105,6 +108,7 @@ void RgbTransform::setLuminanceGain(double luminanceGain)
 		Debug(_log, "set luminanceGain to %f", luminanceGain);
 
 	_luminanceGain = luminanceGain;
+	updateSatLumFixed();
 }
 
 double RgbTransform::getSaturationGain() const
@@ -254,10 +258,28 @@ void RgbTransform::transform(uint8_t& red, uint8_t& green, uint8_t& blue)
 	}
 }
 
+void RgbTransform::updateSatLumFixed()
+{
+	// the deviation from the float path was verified for all the colors in the range of the settings schema
+	_satLumFixed = (_saturationGain >= 0.0 && _saturationGain <= 10.0 &&
+		_luminanceGain >= 0.0 && _luminanceGain <= 10.0 &&
+		_luminanceMinimum >= 0.0 && _luminanceMinimum <= 1.0);
+
+	_saturationGainQ16 = (_satLumFixed) ? int32_t(_saturationGain * 65536.0 + 0.5) : 0;
+	_luminanceGainQ16 = (_satLumFixed) ? int32_t(_luminanceGain * 65536.0 + 0.5) : 0;
+	_luminanceMinimumQ16 = (_satLumFixed) ? int32_t(_luminanceMinimum * 65536.0 + 0.5) : 0;
+}
+
 void RgbTransform::transformSatLum(uint8_t& red, uint8_t& green, uint8_t& blue)
 {
 	if (_saturationGain != 1.0 || _luminanceGain != 1.0 || _luminanceMinimum != 0.0)
 	{
+		if (_satLumFixed)
+		{
+			transformSatLumFixed(red, green, blue);
+			return;
+		}
+
 		uint16_t hue;
 		float saturation, luminance;
 		rgb2hsl(red, green, blue, hue, saturation, luminance);
@@ -283,6 +305,82 @@ void RgbTransform::transformSatLum(uint8_t& red, uint8_t& green, uint8_t& blue)
 	}
 }
 
+void RgbTransform::transformSatLumFixed(uint8_t& red, uint8_t& green, uint8_t& blue) const
+{
+	const int32_t ONE = 1 << 16;
+
+	const int32_t rgbMax = std::max(red, std::max(green, blue));
+	const int32_t rgbMin = std::min(red, std::min(green, blue));
+	const int32_t diff = rgbMax - rgbMin;
+	const int32_t sum = rgbMax + rgbMin;
+
+	// the same integer hue in degrees as rgb2hsl, the saturation and the luminance in 16.16
+	int32_t hue = 0;
+	int32_t saturation = 0;
+	int32_t luminance = (sum * ONE + 255) / 510;
+
+	if (diff != 0)
+	{
+		auto floorDiv = [](int32_t a, int32_t b) { return (a >= 0) ? a / b : -((-a + b - 1) / b); };
+
+		saturation = (sum < 255) ? (diff * ONE) / sum : (diff * ONE) / (510 - sum);
+
+		if (rgbMax == red)
+		{
+			hue = 360 + floorDiv(60 * (green - blue), diff);
+			if (hue > 359)
+				hue -= 360;
+		}
+		else if (rgbMax == green)
+			hue = 120 + floorDiv(60 * (blue - red), diff);
+		else
+			hue = 240 + floorDiv(60 * (red - green), diff);
+	}
+
+	saturation = int32_t(std::min<int64_t>((int64_t(saturation) * _saturationGainQ16) >> 16, ONE));
+
+	int64_t l = (int64_t(luminance) * _luminanceGainQ16) >> 16;
+	if (l < _luminanceMinimumQ16)
+	{
+		saturation = 0;
+		l = _luminanceMinimumQ16;
+	}
+	luminance = int32_t(std::min<int64_t>(l, ONE));
+
+	if (saturation == 0)
+	{
+		red = green = blue = uint8_t((luminance * 255) >> 16);
+		return;
+	}
+
+	const int32_t q = (luminance < ONE / 2) ? int32_t((int64_t(luminance) * (ONE + saturation)) >> 16) :
+		luminance + saturation - int32_t((int64_t(luminance) * saturation) >> 16);
+	const int32_t p = 2 * luminance - q;
+
+	int32_t t[3] = { hue + 120, hue, hue - 120 };
+	uint8_t* out[3] = { &red, &green, &blue };
+
+	for (int i = 0; i < 3; i++)
+	{
+		if (t[i] < 0)
+			t[i] += 360;
+		if (t[i] > 360)
+			t[i] -= 360;
+
+		int32_t v;
+		if (t[i] < 60)
+			v = p + (q - p) * t[i] / 60;
+		else if (t[i] < 180)
+			v = q;
+		else if (t[i] < 240)
+			v = p + (q - p) * (240 - t[i]) / 60;
+		else
+			v = p;
+
+		*out[i] = uint8_t((int64_t(v) * 255) >> 16);
+	}
+}
+
 void RgbTransform::rgb2hsl(uint8_t red, uint8_t green, uint8_t blue, uint16_t& hue, float& saturation, float& luminance)
 {
 	float r = red / 255.0f;
@@ -0,0 +1,152 @@
+/* SampleCompare.cpp
+*
+*  MIT License
+*
+*  Copyright (c) 2023 awawa-dev
+*
+*  Project homesite: https://github.com/awawa-dev/HyperHDR
+*
+*  Permission is hereby granted, free of charge, to any person obtaining a copy
+*  of this software and associated documentation files (the "Software"), to deal
+*  in the Software without restriction, including without limitation the rights
+*  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+*  copies of the Software, and to permit persons to whom the Software is
+*  furnished to do so, subject to the following conditions:
+*
+*  The above copyright notice and this permission notice shall be included in all
+*  copies or substantial portions of the Software.
+
+*  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+*  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+*  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+*  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+*  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+*  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+*  SOFTWARE.
+*/
+
+#include <cstring>
+
+#include <utils/SampleCompare.h>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+	#define SAMPLECOMPARE_SSE2
+	#include <emmintrin.h>
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__) || defined(__aarch64__)
+	#define SAMPLECOMPARE_NEON
+	#include <arm_neon.h>
+#endif
+
+bool SampleCompare::rowBelow(const uint8_t* rgb, int pixels, const ColorRgb& threshold)
+{
+	int done = 0;
+
+#if defined(SAMPLECOMPARE_SSE2) || defined(SAMPLECOMPARE_NEON)
+	// 16 pixels are 3 vectors, the threshold repeats in the same phase in each of them
+	uint8_t pattern[48];
+	for (int i = 0; i < 48; i += 3)
+	{
+		pattern[i] = threshold.red;
+		pattern[i + 1] = threshold.green;
+		pattern[i + 2] = threshold.blue;
+	}
+#endif
+
+#if defined(SAMPLECOMPARE_SSE2)
+	const __m128i t0 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(pattern));
+	const __m128i t1 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(pattern + 16));
+	const __m128i t2 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(pattern + 32));
+
+	for (; done + 16 <= pixels; done += 16, rgb += 48)
+	{
+		__m128i v0 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(rgb));
+		__m128i v1 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(rgb + 16));
+		__m128i v2 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(rgb + 32));
+
+		__m128i below = _mm_and_si128(_mm_cmpeq_epi8(_mm_max_epu8(v0, t0), t0),
+			_mm_and_si128(_mm_cmpeq_epi8(_mm_max_epu8(v1, t1), t1), _mm_cmpeq_epi8(_mm_max_epu8(v2, t2), t2)));
+
+		if (_mm_movemask_epi8(below) != 0xFFFF)
+			return false;
+	}
+#elif defined(SAMPLECOMPARE_NEON)
+	const uint8x16_t t0 = vld1q_u8(pattern);
+	const uint8x16_t t1 = vld1q_u8(pattern + 16);
+	const uint8x16_t t2 = vld1q_u8(pattern + 32);
+
+	for (; done + 16 <= pixels; done += 16, rgb += 48)
+	{
+		uint8x16_t above = vorrq_u8(vcgtq_u8(vld1q_u8(rgb), t0), vorrq_u8(vcgtq_u8(vld1q_u8(rgb + 16), t1), vcgtq_u8(vld1q_u8(rgb + 32), t2)));
+		uint64x2_t any = vreinterpretq_u64_u8(above);
+
+		if ((vgetq_lane_u64(any, 0) | vgetq_lane_u64(any, 1)) != 0)
+			return false;
+	}
+#endif
+
+	for (; done < pixels; done++, rgb += 3)
+		if (rgb[0] > threshold.red || rgb[1] > threshold.green || rgb[2] > threshold.blue)
+			return false;
+
+	return true;
+}
+
+void SampleCompare::gather(const uint8_t* base, const ptrdiff_t* offsets, int count, uint8_t* quads)
+{
+	for (int i = 0; i < count; i++, quads += 4)
+	{
+		memcpy(quads, base + offsets[i], 3);
+		quads[3] = 0;
+	}
+}
+
+int SampleCompare::countAbove(const uint8_t* quads, const uint8_t* reference, int count, int tolerance)
+{
+	int above = 0;
+	int done = 0;
+
+#if defined(SAMPLECOMPARE_SSE2)
+	const __m128i zero = _mm_setzero_si128();
+	const __m128i ones = _mm_set1_epi16(1);
+	const __m128i limit = _mm_set1_epi32(tolerance);
+
+	for (; done + 4 <= count; done += 4, quads += 16, reference += 16)
+	{
+		__m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(quads));
+		__m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i*>(reference));
+		__m128i diff = _mm_or_si128(_mm_subs_epu8(a, b), _mm_subs_epu8(b, a));
+
+		// pairs of channels, then the pairs of every quad: the sums land in the even lanes
+		__m128i low = _mm_madd_epi16(_mm_unpacklo_epi8(diff, zero), ones);
+		__m128i high = _mm_madd_epi16(_mm_unpackhi_epi8(diff, zero), ones);
+		low = _mm_add_epi32(low, _mm_srli_epi64(low, 32));
+		high = _mm_add_epi32(high, _mm_srli_epi64(high, 32));
+
+		int maskLow = _mm_movemask_ps(_mm_castsi128_ps(_mm_cmpgt_epi32(low, limit)));
+		int maskHigh = _mm_movemask_ps(_mm_castsi128_ps(_mm_cmpgt_epi32(high, limit)));
+
+		above += (maskLow & 1) + ((maskLow >> 2) & 1) + (maskHigh & 1) + ((maskHigh >> 2) & 1);
+	}
+#elif defined(SAMPLECOMPARE_NEON)
+	const uint32x4_t limit = vdupq_n_u32(static_cast<uint32_t>((tolerance < 0) ? 0 : tolerance));
+	uint32x4_t counter = vdupq_n_u32(0);
+
+	for (; done + 4 <= count; done += 4, quads += 16, reference += 16)
+	{
+		uint32x4_t sums = vpaddlq_u16(vpaddlq_u8(vabdq_u8(vld1q_u8(quads), vld1q_u8(reference))));
+
+		counter = vaddq_u32(counter, vshrq_n_u32(vcgtq_u32(sums, limit), 31));
+	}
+
+	above += static_cast<int>(vgetq_lane_u32(counter, 0) + vgetq_lane_u32(counter, 1) + vgetq_lane_u32(counter, 2) + vgetq_lane_u32(counter, 3));
+#endif
+
+	for (; done < count; done++, quads += 4, reference += 4)
+	{
+		int sum = std::abs(quads[0] - reference[0]) + std::abs(quads[1] - reference[1]) + std::abs(quads[2] - reference[2]);
+		if (sum > tolerance)
+			above++;
+	}
+
+	return above;
+}
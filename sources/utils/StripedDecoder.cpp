@@ -0,0 +1,209 @@
+/* StripedDecoder.cpp
+*
+*  MIT License
+*
+*  Copyright (c) 2023 awawa-dev
+*
+*  Project homesite: https://github.com/awawa-dev/HyperHDR
+*
+*  Permission is hereby granted, free of charge, to any person obtaining a copy
+*  of this software and associated documentation files (the "Software"), to deal
+*  in the Software without restriction, including without limitation the rights
+*  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+*  copies of the Software, and to permit persons to whom the Software is
+*  furnished to do so, subject to the following conditions:
+*
+*  The above copyright notice and this permission notice shall be included in all
+*  copies or substantial portions of the Software.
+
+*  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+*  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+*  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+*  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+*  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+*  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+*  SOFTWARE.
+*/
+
+#include <utils/StripedDecoder.h>
+#include <utils/FrameDecoder.h>
+
+#include <vector>
+
+#include <QThread>
+#include <QMutex>
+#include <QSemaphore>
+
+// every stripe should be big enough to pay off the thread hand-over
+#define MIN_STRIPE_ROWS 64
+
+namespace
+{
+	struct StripeJob
+	{
+		int cropLeft;
+		int cropTop;
+		const uint8_t* data;
+		int height;
+		int lineLength;
+		PixelFormat pixelFormat;
+		const uint8_t* lutBuffer;
+		const CompactLut* compactLut;
+		Image<ColorRgb>* outputImage;
+		int stripes;
+		int rowsPerStripe;
+
+		void decode(int stripe) const
+		{
+			int firstRow = stripe * rowsPerStripe;
+			int lastRow = (stripe == stripes - 1) ? outputImage->height() : firstRow + rowsPerStripe;
+
+			FrameDecoder::processImageRows(cropLeft, cropTop, data, height, lineLength, pixelFormat, lutBuffer, *outputImage,
+				firstRow, lastRow, compactLut);
+		}
+	};
+
+	class StripeThread : public QThread
+	{
+	public:
+		StripeThread() :
+			_quit(false),
+			_job(nullptr),
+			_stripe(0),
+			_done(nullptr)
+		{
+		}
+
+		void post(const StripeJob* job, int stripe, QSemaphore* done)
+		{
+			_job = job;
+			_stripe = stripe;
+			_done = done;
+			_start.release();
+		}
+
+		void finish()
+		{
+			_quit = true;
+			_start.release();
+			wait();
+		}
+
+	protected:
+		void run() override
+		{
+			for (;;)
+			{
+				_start.acquire();
+
+				if (_quit)
+					break;
+
+				_job->decode(_stripe);
+				_done->release();
+			}
+		}
+
+	private:
+		bool			_quit;
+		const StripeJob* _job;
+		int				_stripe;
+		QSemaphore*		_done;
+		QSemaphore		_start;
+	};
+
+	class StripePool
+	{
+	public:
+		~StripePool()
+		{
+			for (StripeThread* thread : _threads)
+			{
+				thread->finish();
+				delete thread;
+			}
+			_threads.clear();
+		}
+
+		bool run(const StripeJob& job)
+		{
+			if (!_locker.tryLock())
+				return false;
+
+			while (static_cast<int>(_threads.size()) < job.stripes - 1)
+			{
+				_threads.push_back(new StripeThread());
+				_threads.back()->start();
+			}
+
+			for (int i = 1; i < job.stripes; i++)
+				_threads[i - 1]->post(&job, i, &_done);
+
+			job.decode(0);
+
+			_done.acquire(job.stripes - 1);
+
+			_locker.unlock();
+			return true;
+		}
+
+	private:
+		QMutex						_locker;
+		QSemaphore					_done;
+		std::vector<StripeThread*>	_threads;
+	};
+
+	StripePool& stripePool()
+	{
+		static StripePool pool;
+		return pool;
+	}
+}
+
+bool StripedDecoder::isSupported(PixelFormat pixelFormat)
+{
+	return (pixelFormat == PixelFormat::YUYV || pixelFormat == PixelFormat::NV12 || pixelFormat == PixelFormat::I420 ||
+		pixelFormat == PixelFormat::P010 || pixelFormat == PixelFormat::Y210);
+}
+
+void StripedDecoder::processImage(int stripes,
+	int _cropLeft, int _cropRight, int _cropTop, int _cropBottom,
+	const uint8_t* data, int width, int height, int lineLength,
+	const PixelFormat pixelFormat, const uint8_t* lutBuffer, Image<ColorRgb>& outputImage,
+	const CompactLut* compactLut)
+{
+	// sanity check, odd values doesnt work for yuv either way
+	_cropLeft = (_cropLeft >> 1) << 1;
+	_cropRight = (_cropRight >> 1) << 1;
+
+	int outputWidth = (width - _cropLeft - _cropRight);
+	int outputHeight = (height - _cropTop - _cropBottom);
+
+	stripes = qMin(qMin(stripes, MAX_STRIPES), outputHeight / MIN_STRIPE_ROWS);
+
+	if (stripes <= 1 || !isSupported(pixelFormat) || outputWidth <= 0 ||
+		(lutBuffer == nullptr && (compactLut == nullptr || !compactLut->isValid())))
+	{
+		FrameDecoder::processImage(_cropLeft, _cropRight, _cropTop, _cropBottom, data, width, height, lineLength, pixelFormat, lutBuffer, outputImage, compactLut);
+		return;
+	}
+
+	outputImage.resize(outputWidth, outputHeight);
+
+	StripeJob job;
+	job.cropLeft = _cropLeft;
+	job.cropTop = _cropTop;
+	job.data = data;
+	job.height = height;
+	job.lineLength = lineLength;
+	job.pixelFormat = pixelFormat;
+	job.lutBuffer = lutBuffer;
+	job.compactLut = compactLut;
+	job.outputImage = &outputImage;
+	job.stripes = stripes;
+	job.rowsPerStripe = outputHeight / stripes;
+
+	// another worker is decoding its frame on the pool: the frames are already processed in parallel
+	if (!stripePool().run(job))
+		FrameDecoder::processImage(_cropLeft, _cropRight, _cropTop, _cropBottom, data, width, height, lineLength, pixelFormat, lutBuffer, outputImage, compactLut);
+}
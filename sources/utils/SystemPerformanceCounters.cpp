@@ -28,6 +28,8 @@
 #include <utils/SystemPerformanceCounters.h>
 #include <utils/InternalClock.h>
 
+#include <chrono>
+
 #ifdef _WIN32
 
 #include <windows.h>
@@ -48,7 +50,9 @@ PDH_HCOUNTER cpuPerfTotal = nullptr;
 #include <sys/klog.h>
 #include <QTextStream>
 #include <QFile>
+#include <QDir>
 #include <vector>
+#include <unistd.h>
 
 #endif
 
@@ -213,10 +217,13 @@ QString SystemPerformanceCounters::getCPU()
 			if (convertedStr != "_Total")
 				retVal += QString("%1").arg(getChar(valCPU / 100.0f));
 			else
+			{
+				readings.cpuUsage = valCPU;
 				retTotal = QString(
 					(valCPU < 50) ? "<span class='cpu_low_usage'>%1%</span>" :
 					((valCPU < 90) ? "<span class='cpu_medium_usage'>%1%</span>" :
 						"<span class='cpu_high_usage'>%1%</span>")).arg(QString::number(valCPU), 2);
+			}
 		}
 
 		free(buffer);
@@ -263,6 +270,7 @@ QString SystemPerformanceCounters::getCPU()
 					}
 					else
 					{
+						readings.cpuUsage = valCPU;
 						retTotal = QString(
 							(valCPU < 50) ? "<span class='cpu_low_usage'>%1%</span>" :
 							((valCPU < 90) ? "<span class='cpu_medium_usage'>%1%</span>" :
@@ -303,6 +311,8 @@ QString SystemPerformanceCounters::getRAM()
 		qint64 physMemAv = qint64(memInfo.ullAvailPhys) / (1024 * 1024);
 		qint64 takenMem = totalPhysMem - physMemAv;
 		qint64 aspect = (takenMem * 100) / totalPhysMem;
+		readings.ramUsed = takenMem;
+		readings.ramTotal = totalPhysMem;
 		QString color = (aspect < 50) ? "cpu_low_usage" : ((aspect < 90) ? "cpu_medium_usage" : "cpu_high_usage");
 		return QString("%1 / %2MB (<span class='%3'>%4%</span>)").arg(takenMem).arg(totalPhysMem).arg(color).arg(aspect, 2);
 
@@ -336,6 +346,8 @@ QString SystemPerformanceCounters::getRAM()
 
 		long long takenMem = totalPhysMem - physMemAv;
 		qint64 aspect = (takenMem * 100) / totalPhysMem;
+		readings.ramUsed = takenMem;
+		readings.ramTotal = totalPhysMem;
 		QString color = (aspect < 50) ? "cpu_low_usage" : ((aspect < 90) ? "cpu_medium_usage" : "cpu_high_usage");
 		return QString("%1 / %2MB (<span class='%3'>%4%</span>)").arg(takenMem).arg(totalPhysMem).arg(color).arg(aspect, 2);
 
@@ -365,6 +377,7 @@ QString SystemPerformanceCounters::getTEMP()
 			if (fscanf(fp, "%lli", &temp) >= 1)
 			{
 				double tempVal = temp / 1000.0f;
+				readings.temperature = tempVal;
 				QString color = (tempVal <= 65) ? "stats-report-ok" : ((tempVal <= 75) ? "stats-report-warning" : "stats-report-error");
 				result = QString("<span class='%1 fw-bold'>%2</span>").arg(color).arg(QString::number(tempVal, 'f', 2));
 			}
@@ -411,3 +424,49 @@ QString SystemPerformanceCounters::getUNDERVOLATGE()
 
 	return "";
 }
+
+QList<SystemPerformanceCounters::ThreadUsage> SystemPerformanceCounters::getThreads()
+{
+	QMap<qint64, ThreadTime> current;
+
+	try
+	{
+#ifdef __linux__
+		const long ticks = sysconf(_SC_CLK_TCK);
+		const QStringList tasks = QDir("/proc/self/task").entryList(QDir::Dirs | QDir::NoDotAndDotDot);
+
+		for (const QString& task : tasks)
+		{
+			QFile file(QString("/proc/self/task/%1/stat").arg(task));
+
+			if (ticks <= 0 || !file.open(QFile::ReadOnly))
+				continue;
+
+			// "tid (name) state ppid ...": the name may contain spaces and brackets
+			const QByteArray stat = file.readAll();
+			const int nameBegin = stat.indexOf('(');
+			const int nameEnd = stat.lastIndexOf(')');
+
+			if (nameBegin < 0 || nameEnd < nameBegin)
+				continue;
+
+			const QList<QByteArray> fields = stat.mid(nameEnd + 2).split(' ');
+
+			// utime and stime are the 14th and 15th field of the stat
+			if (fields.size() <= 12)
+				continue;
+
+			ThreadTime thread;
+			thread.name = QString::fromUtf8(stat.mid(nameBegin + 1, nameEnd - nameBegin - 1));
+			thread.time = (fields[11].toLongLong() + fields[12].toLongLong()) * 1000000000ll / ticks;
+			current[task.toLongLong()] = thread;
+		}
+#endif
+	}
+	catch (...)
+	{
+
+	}
+
+	return updateThreadUsage(current, std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count());
+}
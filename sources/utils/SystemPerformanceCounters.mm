@@ -32,6 +32,7 @@
 #include <mach/processor_info.h>
 #include <sys/types.h>
 #include <sys/sysctl.h>
+#include <chrono>
 
 mach_msg_type_number_t prevPerfNum = 0U;
 processor_info_array_t prevPerfStats = NULL;
@@ -135,6 +136,7 @@ QString SystemPerformanceCounters::getCPU()
 					valCPU = (totUsage * 100.0f) / std::max(totTotal, 0.00001);
 
 					valCPU = std::min(std::max(valCPU, 0.0), 100.0);
+					readings.cpuUsage = valCPU;
 
 					retTotal = QString(
 							(valCPU < 50) ? "<span style='color:ForestGreen'>%1%</span>" :
@@ -187,6 +189,8 @@ QString SystemPerformanceCounters::getRAM()
 				qint64 totalPhysMem = qint64(physicalMemory) / (1024 * 1024);
 				qint64 takenMem = qint64(usedMemory) / (1024 * 1024);
 				qint64 aspect = (takenMem * 100) / totalPhysMem;
+				readings.ramUsed = takenMem;
+				readings.ramTotal = totalPhysMem;
 				QString color = (aspect < 50) ? "ForestGreen" : ((aspect < 90) ? "orange" : "red");
 				return QString("%1 / %2MB (<span style='color:%3'><b>%4%</b></span>)").arg(takenMem).arg(totalPhysMem).arg(color).arg(aspect, 2);				
 			}
@@ -209,3 +213,43 @@ QString SystemPerformanceCounters::getUNDERVOLATGE()
 	return "";
 }
 
+QList<SystemPerformanceCounters::ThreadUsage> SystemPerformanceCounters::getThreads()
+{
+	QMap<qint64, ThreadTime> current;
+
+	try
+	{
+		thread_act_array_t threads = nullptr;
+		mach_msg_type_number_t count = 0;
+
+		if (task_threads(mach_task_self(), &threads, &count) == KERN_SUCCESS)
+		{
+			for (mach_msg_type_number_t i = 0; i < count; i++)
+			{
+				thread_extended_info_data_t info;
+				mach_msg_type_number_t infoCount = THREAD_EXTENDED_INFO_COUNT;
+				thread_identifier_info_data_t identifier;
+				mach_msg_type_number_t identifierCount = THREAD_IDENTIFIER_INFO_COUNT;
+
+				if (thread_info(threads[i], THREAD_EXTENDED_INFO, (thread_info_t)&info, &infoCount) == KERN_SUCCESS &&
+					thread_info(threads[i], THREAD_IDENTIFIER_INFO, (thread_info_t)&identifier, &identifierCount) == KERN_SUCCESS)
+				{
+					ThreadTime thread;
+					thread.name = QString::fromUtf8(info.pth_name);
+					thread.time = static_cast<qint64>(info.pth_user_time + info.pth_system_time);
+					current[static_cast<qint64>(identifier.thread_id)] = thread;
+				}
+
+				mach_port_deallocate(mach_task_self(), threads[i]);
+			}
+
+			vm_deallocate(mach_task_self(), (vm_address_t)threads, sizeof(thread_t) * count);
+		}
+	}
+	catch (...)
+	{
+
+	}
+
+	return updateThreadUsage(current, std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count());
+}
@@ -0,0 +1,180 @@
+/* ThreadPolicy.cpp
+*
+*  MIT License
+*
+*  Copyright (c) 2023 awawa-dev
+*
+*  Project homesite: https://github.com/awawa-dev/HyperHDR
+*
+*  Permission is hereby granted, free of charge, to any person obtaining a copy
+*  of this software and associated documentation files (the "Software"), to deal
+*  in the Software without restriction, including without limitation the rights
+*  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+*  copies of the Software, and to permit persons to whom the Software is
+*  furnished to do so, subject to the following conditions:
+*
+*  The above copyright notice and this permission notice shall be included in all
+*  copies or substantial portions of the Software.
+
+*  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+*  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+*  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+*  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+*  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+*  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+*  SOFTWARE.
+*/
+
+
+#include <cerrno>
+#include <cstring>
+
+#ifdef _WIN32
+	#include <windows.h>
+#else
+	#include <pthread.h>
+	#include <sched.h>
+#endif
+
+#include <QMutex>
+#include <QMutexLocker>
+#include <QThread>
+
+#include <utils/ThreadPolicy.h>
+#include <utils/Logger.h>
+
+namespace
+{
+	const char* ROLE_NAMES[] = { "capture", "processing", "output", "network" };
+
+	/// the realtime priority of the roles, the capture one is the former priority of the V4L2 capture thread
+	const int REALTIME_PRIORITY[] = { 10, 9, 8, 2 };
+
+	QMutex		policyLock;
+	QJsonObject	policyConfig;
+}
+
+void ThreadPolicy::setConfig(const QJsonObject& config)
+{
+	QMutexLocker locker(&policyLock);
+
+	policyConfig = config;
+
+	for (int i = 0; i < 4; i++)
+	{
+		QString cpus = config[QString("thread_%1_cpus").arg(ROLE_NAMES[i])].toString();
+		QString policy = config[QString("thread_%1_policy").arg(ROLE_NAMES[i])].toString("default");
+
+		if (!cpus.isEmpty() || policy != "default")
+			Info(Logger::getInstance("HYPERHDR"), "Threads of the role '%s': CPUs '%s', policy '%s' (applied to the threads started from now)",
+				ROLE_NAMES[i], (cpus.isEmpty()) ? "all" : QSTRING_CSTR(cpus), QSTRING_CSTR(policy));
+	}
+}
+
+QList<int> ThreadPolicy::parseCpus(const QString& cpus)
+{
+	QList<int> list;
+
+	for (const QString& range : cpus.split(','))
+	{
+		if (range.trimmed().isEmpty())
+			continue;
+
+		QStringList bounds = range.trimmed().split('-');
+		bool okBegin = false, okEnd = false;
+		int begin = bounds.first().toInt(&okBegin);
+		int end = (bounds.size() == 2) ? bounds.last().toInt(&okEnd) : begin;
+
+		if (!okBegin || (bounds.size() == 2 && !okEnd) || bounds.size() > 2 || begin < 0 || end < begin || end >= 1024)
+			continue;
+
+		for (int cpu = begin; cpu <= end; cpu++)
+			if (!list.contains(cpu))
+				list.append(cpu);
+	}
+
+	return list;
+}
+
+ThreadPolicy::Setting ThreadPolicy::getSetting(Role role)
+{
+	QMutexLocker locker(&policyLock);
+
+	Setting setting;
+	const char* name = ROLE_NAMES[static_cast<int>(role)];
+
+	setting.cpus = parseCpus(policyConfig[QString("thread_%1_cpus").arg(name)].toString());
+	setting.policy = policyConfig[QString("thread_%1_policy").arg(name)].toString("default");
+
+	return setting;
+}
+
+void ThreadPolicy::attach(QThread* thread, Role role)
+{
+	// the started signal is emitted by the new thread itself
+	QObject::connect(thread, &QThread::started, [role]() { ThreadPolicy::apply(role); });
+}
+
+void ThreadPolicy::apply(Role role)
+{
+	const Setting setting = getSetting(role);
+	const char* name = ROLE_NAMES[static_cast<int>(role)];
+	Logger* log = Logger::getInstance("HYPERHDR");
+
+	if (setting.cpus.isEmpty() && setting.policy == "default")
+		return;
+
+	if (!setting.cpus.isEmpty())
+	{
+#if defined(__linux__)
+		cpu_set_t cpuSet;
+		CPU_ZERO(&cpuSet);
+		for (int cpu : setting.cpus)
+			if (cpu < CPU_SETSIZE)
+				CPU_SET(cpu, &cpuSet);
+
+		int error = pthread_setaffinity_np(pthread_self(), sizeof(cpuSet), &cpuSet);
+		if (error != 0)
+			Warning(log, "Could not set the CPUs of the '%s' thread (%s)", name, strerror(error));
+#elif defined(_WIN32)
+		DWORD_PTR mask = 0;
+		for (int cpu : setting.cpus)
+			if (cpu < static_cast<int>(sizeof(DWORD_PTR) * 8))
+				mask |= (static_cast<DWORD_PTR>(1) << cpu);
+
+		if (mask == 0 || SetThreadAffinityMask(GetCurrentThread(), mask) == 0)
+			Warning(log, "Could not set the CPUs of the '%s' thread (%lu)", name, GetLastError());
+#else
+		Debug(log, "The system doesn't support the CPUs of the '%s' thread", name);
+#endif
+	}
+
+	if (setting.policy == "fifo" || setting.policy == "rr")
+	{
+#if defined(_WIN32)
+		bool realtime = SetThreadPriority(GetCurrentThread(), THREAD_PRIORITY_TIME_CRITICAL) != 0;
+		QString reason = QString::number(GetLastError());
+#else
+		sched_param param;
+		memset(&param, 0, sizeof(param));
+		param.sched_priority = REALTIME_PRIORITY[static_cast<int>(role)];
+
+		int error = pthread_setschedparam(pthread_self(), (setting.policy == "fifo") ? SCHED_FIFO : SCHED_RR, &param);
+		bool realtime = (error == 0);
+		QString reason = strerror(error);
+#endif
+		if (realtime)
+		{
+			Info(log, "The '%s' thread is running with the realtime policy (%s)", name, QSTRING_CSTR(setting.policy));
+			return;
+		}
+
+		Warning(log, "Could not set the realtime policy of the '%s' thread (%s). Using the high priority", name, QSTRING_CSTR(reason));
+		if (QThread::currentThread() != nullptr)
+			QThread::currentThread()->setPriority(QThread::HighestPriority);
+	}
+	else if (setting.policy == "high" && QThread::currentThread() != nullptr)
+		QThread::currentThread()->setPriority(QThread::HighPriority);
+	else if (setting.policy == "low" && QThread::currentThread() != nullptr)
+		QThread::currentThread()->setPriority(QThread::LowPriority);
+}
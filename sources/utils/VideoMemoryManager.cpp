@@ -26,162 +26,369 @@
 */
 
 #include <utils/VideoMemoryManager.h>
+#include <utils/PerformanceCounters.h>
+#include <utils/MemoryAccounting.h>
 
-#define BUFFER_LOWER_LIMIT 1
+#if defined(_WIN32)
+	#include <malloc.h>
+#endif
 
-bool VideoMemoryManager::_enabled(false);
-bool VideoMemoryManager::_dirty(false);
+#ifdef __linux__
+	#include <sys/mman.h>
+#endif
+
+#define POOL_MIN_CLASS_SIZE 4096
+#define POOL_MIN_CLASS_SHIFT 12
+
+std::atomic<bool> VideoMemoryManager::_enabled(false);
+std::atomic<bool> VideoMemoryManager::_hugePages(false);
+std::atomic<int>  VideoMemoryManager::_hugePageBuffers(0);
+thread_local VideoMemoryManager::ThreadCache VideoMemoryManager::_threadCache;
 
 VideoMemoryManager::VideoMemoryManager(int bufferSize) :
-	_currentSize(0),
-	_prevSize(0),
 	_hits(0),
-	_needed(false),
-	_prevNeeded(true),
-	_bufferLimit(bufferSize)
+	_misses(0),
+	_footprint(0),
+	_currentSize(0),
+	_bufferLimit(qBound(1, bufferSize, VideoMemoryManagerBufferSize))
 {
-
+	for (int i = 0; i < VideoMemoryManagerSizeClasses; i++)
+	{
+		_requests[i] = 0;
+		for (int j = 0; j < VideoMemoryManagerBufferSize; j++)
+			_depot[i][j] = nullptr;
+	}
 };
 
 VideoMemoryManager::~VideoMemoryManager()
 {
-	QMutexLocker lockme(&_locker);
+	if (_threadCache.owner == this)
+	{
+		_threadCache.flush();
+		_threadCache.owner = nullptr;
+	}
 
 	releaseBuffer();
 }
 
-bool VideoMemoryManager::setFrameSize(size_t size)
+void VideoMemoryManager::ThreadCache::flush()
+{
+	if (owner == nullptr || total == 0)
+		return;
+
+	for (int i = 0; i < VideoMemoryManagerSizeClasses; i++)
+		while (count[i] > 0)
+			owner->releaseToDepot(i, buffers[i][--count[i]]);
+
+	total = 0;
+}
+
+VideoMemoryManager::ThreadCache::~ThreadCache()
 {
-	if (_currentSize != size || (!_enabled && _dirty))
+	flush();
+}
+
+namespace
+{
+	// stored in front of every buffer so it can be released correctly even if the huge pages option changed in the meantime
+	struct AllocationHeader
 	{
-		QMutexLocker lockme(&_locker);
+		uint8_t* base;
+		size_t   mappedSize;
+		size_t   size;
+	};
 
-		releaseBuffer();
+	static_assert(sizeof(AllocationHeader) <= VideoMemoryManagerAlignment, "Allocation header doesn't fit");
+}
 
-		_dirty = false;
+uint8_t* VideoMemoryManager::allocateMemory(size_t size)
+{
+	const size_t total = size + VideoMemoryManagerAlignment;
+	uint8_t* base = nullptr;
+	size_t mappedSize = 0;
 
-		_hits = 0;
+#ifdef __linux__
+	if (_hugePages && size >= VideoMemoryManagerHugePageSize)
+	{
+		mappedSize = ((total + VideoMemoryManagerHugePageSize - 1) / VideoMemoryManagerHugePageSize) * VideoMemoryManagerHugePageSize;
+
+		void* mapped = mmap(nullptr, mappedSize, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+
+		// no reserved huge pages: try transparent huge pages
+		if (mapped == MAP_FAILED)
+		{
+			mapped = mmap(nullptr, mappedSize, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+			if (mapped != MAP_FAILED)
+				madvise(mapped, mappedSize, MADV_HUGEPAGE);
+		}
+
+		if (mapped != MAP_FAILED)
+		{
+			base = static_cast<uint8_t*>(mapped);
+			_hugePageBuffers++;
+		}
+		else
+			mappedSize = 0;
+	}
+#endif
 
-		_needed = false;
+	if (base == nullptr)
+	{
+#if defined(_WIN32)
+		base = static_cast<uint8_t*>(_aligned_malloc(total, VideoMemoryManagerAlignment));
+#else
+		void* aligned = nullptr;
+		base = (posix_memalign(&aligned, VideoMemoryManagerAlignment, total) == 0) ? static_cast<uint8_t*>(aligned) : nullptr;
+#endif
+		if (base == nullptr)
+			return nullptr;
+	}
 
-		_prevNeeded = true;
+	uint8_t* buffer = base + VideoMemoryManagerAlignment;
+	AllocationHeader* header = reinterpret_cast<AllocationHeader*>(buffer - sizeof(AllocationHeader));
+	header->base = base;
+	header->mappedSize = mappedSize;
+	header->size = size;
 
-		_bufferLimit = VideoMemoryManagerBufferSize;
+	MemoryAccounting::allocated(MemoryAccounting::VIDEO_BUFFERS, size);
 
-		_currentSize = size;
+	return buffer;
+}
 
-		_prevSize = 0;
+void VideoMemoryManager::freeMemory(uint8_t* buffer)
+{
+	if (buffer == nullptr)
+		return;
 
-		return true;
+	const AllocationHeader* header = reinterpret_cast<const AllocationHeader*>(buffer - sizeof(AllocationHeader));
+	uint8_t* base = header->base;
+
+	MemoryAccounting::released(MemoryAccounting::VIDEO_BUFFERS, header->size);
+
+#ifdef __linux__
+	if (header->mappedSize > 0)
+	{
+		munmap(base, header->mappedSize);
+		_hugePageBuffers--;
+		return;
 	}
+#endif
 
-	return false;
+#if defined(_WIN32)
+	_aligned_free(base);
+#else
+	free(base);
+#endif
 }
 
-uint8_t* VideoMemoryManager::request(size_t size)
+int VideoMemoryManager::sizeClass(size_t size)
+{
+	if (size <= POOL_MIN_CLASS_SIZE)
+		return -1;
+
+	int shift = 0;
+	for (size_t value = size - 1; value > 1; value >>= 1)
+		shift++;
+
+	// 4 classes per power of two: the overhead is below 25%
+	size_t step = size_t(1) << (shift - 2);
+	int index = (shift - POOL_MIN_CLASS_SHIFT) * 4 + static_cast<int>((size - 1) / step) - 4;
+
+	return (index < VideoMemoryManagerSizeClasses) ? index : -1;
+}
+
+size_t VideoMemoryManager::classSize(int index)
 {
-	uint8_t* retVal;
+	return static_cast<size_t>(5 + (index & 3)) << (POOL_MIN_CLASS_SHIFT - 2 + (index >> 2));
+}
 
-	if (size != _currentSize || !_enabled)
+bool VideoMemoryManager::setFrameSize(size_t size)
+{
+	// buffers of the previous frame size are not needed anymore and will be trimmed by adjustCache
+	if (_currentSize != size)
 	{
-		return static_cast<uint8_t*>(malloc(size));
+		_currentSize = size;
+		return true;
 	}
 
-	QMutexLocker lockme(&_locker);
+	return false;
+}
 
-	if (_stack.isEmpty())
+uint8_t* VideoMemoryManager::takeFromDepot(int index)
+{
+	for (int i = 0; i < _bufferLimit; i++)
 	{
-		retVal = static_cast<uint8_t*>(malloc(size));
+		std::atomic<uint8_t*>& slot = _depot[index][i];
+
+		if (slot.load(std::memory_order_relaxed) != nullptr)
+		{
+			uint8_t* buffer = slot.exchange(nullptr, std::memory_order_acquire);
+			if (buffer != nullptr)
+				return buffer;
+		}
 	}
-	else
+
+	return nullptr;
+}
+
+void VideoMemoryManager::releaseToDepot(int index, uint8_t* buffer)
+{
+	for (int i = 0; i < _bufferLimit; i++)
 	{
-		_hits++;
+		uint8_t* empty = nullptr;
+		if (_depot[index][i].compare_exchange_strong(empty, buffer, std::memory_order_release, std::memory_order_relaxed))
+			return;
+	}
 
-		retVal = _stack.pop();
+	_footprint -= classSize(index);
+	MemoryAccounting::released(MemoryAccounting::VIDEO_CACHE, classSize(index));
+	freeMemory(buffer);
+}
 
-		if (_stack.length() <= BUFFER_LOWER_LIMIT)
-			_needed = true;
+uint8_t* VideoMemoryManager::request(size_t size)
+{
+	int index = sizeClass(size);
+
+	if (index < 0)
+		return allocateMemory(size);
+
+	if (_enabled)
+	{
+		_requests[index].fetch_add(1, std::memory_order_relaxed);
+
+		ThreadCache& cache = _threadCache;
+		uint8_t* retVal = nullptr;
+
+		if (cache.owner == this && cache.count[index] > 0)
+		{
+			retVal = cache.buffers[index][--cache.count[index]];
+			cache.total--;
+		}
+		else
+			retVal = takeFromDepot(index);
+
+		if (retVal != nullptr)
+		{
+			_hits.fetch_add(1, std::memory_order_relaxed);
+			_footprint -= classSize(index);
+			MemoryAccounting::released(MemoryAccounting::VIDEO_CACHE, classSize(index));
+			return retVal;
+		}
+
+		_misses.fetch_add(1, std::memory_order_relaxed);
 	}
 
-	return retVal;
+	// always allocate the whole class so the buffer can be cached later, even if the cache is enabled in the meantime
+	return allocateMemory(classSize(index));
 }
 
 void VideoMemoryManager::release(size_t size, uint8_t* buffer)
 {
-	if (size != _currentSize || !_enabled)
+	int index = sizeClass(size);
+
+	if (index < 0 || !_enabled)
 	{
-		free(buffer);
+		freeMemory(buffer);
+
+		// the depot is released by adjustCache, the cache of the current thread is released here
+		if (!_enabled && _threadCache.owner == this)
+			_threadCache.flush();
+
 		return;
 	}
 
-	QMutexLocker lockme(&_locker);
+	const size_t bytes = classSize(index);
 
-	if (_stack.length() >= _bufferLimit)
+	if (_footprint.fetch_add(bytes) + bytes > VideoMemoryManagerCacheLimit)
 	{
-		free(buffer);
+		_footprint -= bytes;
+		freeMemory(buffer);
 		return;
 	}
 
-	_stack.push(buffer);
+	MemoryAccounting::allocated(MemoryAccounting::VIDEO_CACHE, bytes);
+
+	ThreadCache& cache = _threadCache;
+
+	if (cache.owner == nullptr)
+		cache.owner = this;
+
+	if (cache.owner == this && cache.count[index] < VideoMemoryManagerThreadCache)
+	{
+		cache.buffers[index][cache.count[index]++] = buffer;
+		cache.total++;
+		return;
+	}
+
+	releaseToDepot(index, buffer);
 }
 
 void VideoMemoryManager::releaseBuffer()
 {
-	while (!_stack.isEmpty())
+	for (int i = 0; i < VideoMemoryManagerSizeClasses; i++)
 	{
-		auto pointer = _stack.pop();
-		free(pointer);
+		uint8_t* buffer;
+		while ((buffer = takeFromDepot(i)) != nullptr)
+		{
+			_footprint -= classSize(i);
+			MemoryAccounting::released(MemoryAccounting::VIDEO_CACHE, classSize(i));
+			freeMemory(buffer);
+		}
 	}
 }
 
 void VideoMemoryManager::enableCache(bool frameCache)
 {
-	if (_enabled == frameCache)
-		return;
-
 	_enabled = frameCache;
+}
 
-	_dirty = true;
+void VideoMemoryManager::enableHugePages(bool hugePages)
+{
+	_hugePages = hugePages;
 }
 
 QString VideoMemoryManager::adjustCache()
 {
-	int curSize = -1, hits = -1;
-	bool needed = false, cleanup = false;
-	bool info = false;
-
-	QMutexLocker lockme(&_locker);
-
-	if (_prevNeeded != _needed || _prevSize != _stack.length())
-		info = true;
+	int cleanup = 0;
 
-	// clean up buffer if neccesery
-	if (!_needed && !_prevNeeded && _stack.length() > 0)
+	if (!_enabled)
 	{
-		auto pointer = _stack.pop();
-		free(pointer);
-		cleanup = true;
-		_prevNeeded = true;
+		if (_threadCache.owner == this)
+			_threadCache.flush();
+
+		releaseBuffer();
 	}
 	else
-		_prevNeeded = _needed;
-
-	_prevSize = _stack.length();
-
-	// get stats
-	curSize = _stack.length();
+	{
+		// gradually trim the size classes that were not used since the last call
+		for (int i = 0; i < VideoMemoryManagerSizeClasses; i++)
+			if (_requests[i].exchange(0, std::memory_order_relaxed) == 0)
+			{
+				uint8_t* buffer = takeFromDepot(i);
+				if (buffer != nullptr)
+				{
+					_footprint -= classSize(i);
+					MemoryAccounting::released(MemoryAccounting::VIDEO_CACHE, classSize(i));
+					freeMemory(buffer);
+					cleanup++;
+				}
+			}
+	}
 
-	hits = _hits;
-	needed = _needed;
+	// get and clear stats
+	uint64_t hits = _hits.exchange(0);
+	uint64_t misses = _misses.exchange(0);
+	size_t   footprint = _footprint;
+	double   hitRatio = (hits + misses > 0) ? (100.0 * hits) / (hits + misses) : 100.0;
 
-	// clear stats
-	_hits = 0;
-	_needed = false;
+	PerformanceReport pr(static_cast<int>(PerformanceReportType::FRAME_POOL), PerformanceCounters::currentToken(),
+		QString("%1% hits, %2 MB").arg(hitRatio, 0, 'f', 1).arg(footprint / (1024.0 * 1024.0), 0, 'f', 1),
+		hitRatio, hits, misses, footprint);
+	emit PerformanceCounters::getInstance()->newCounter(pr);
 
-	if (info || cleanup)
-		return QString("Video cache: %1, size: %2, hits: %3, needed: %4, cleanup: %5, limit: %6").
-						arg((_enabled) ? "enabled" : "disabled").arg(curSize).arg(hits).arg(needed).arg(cleanup).arg(_bufferLimit);
+	if (misses > 0 || cleanup > 0)
+		return QString("Video cache: %1, hits: %2, misses: %3, footprint: %4 kB, cleanup: %5, limit: %6 MB, huge page buffers: %7").
+						arg((_enabled) ? "enabled" : "disabled").arg(hits).arg(misses).arg(footprint / 1024).arg(cleanup).arg(VideoMemoryManagerCacheLimit / (1024 * 1024)).arg(_hugePageBuffers.load());
 	else
 		return "";
 }
-
@@ -0,0 +1,135 @@
+/* WriteCadence.cpp
+*
+*  MIT License
+*
+*  Copyright (c) 2023 awawa-dev
+*
+*  Project homesite: https://github.com/awawa-dev/HyperHDR
+*
+*  Permission is hereby granted, free of charge, to any person obtaining a copy
+*  of this software and associated documentation files (the "Software"), to deal
+*  in the Software without restriction, including without limitation the rights
+*  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+*  copies of the Software, and to permit persons to whom the Software is
+*  furnished to do so, subject to the following conditions:
+*
+*  The above copyright notice and this permission notice shall be included in all
+*  copies or substantial portions of the Software.
+
+*  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+*  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+*  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+*  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+*  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+*  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+*  SOFTWARE.
+*/
+
+
+#include <utils/WriteCadence.h>
+
+WriteCadence::WriteCadence() :
+	_refreshInterval(0),
+	_phase(0),
+	_period(0),
+	_duration(0),
+	_lastStart(0),
+	_samples(0)
+{
+}
+
+void WriteCadence::setRefreshInterval(int interval)
+{
+	_refreshInterval = static_cast<qint64>(qMax(interval, 0)) * 1000000;
+	reset();
+}
+
+void WriteCadence::reset()
+{
+	_samples = 0;
+	_lastStart = 0;
+	_phase = 0;
+	_period = 0;
+	_duration = 0;
+}
+
+void WriteCadence::writeStarted(qint64 now)
+{
+	const qint64 lastStart = _lastStart.exchange(now);
+	const qint64 refresh = _refreshInterval;
+	qint64 period = _period;
+
+	if (lastStart <= 0 || now <= lastStart)
+	{
+		_phase = now;
+		_period = refresh;
+		return;
+	}
+
+	const qint64 interval = now - lastStart;
+
+	// a pause (ex. the device was disabled) starts the learning again
+	if (refresh > 0 && interval > 4 * refresh)
+	{
+		_samples = 0;
+		_phase = now;
+		_period = refresh;
+		return;
+	}
+
+	if (period <= 0)
+		period = interval;
+
+	// both follow the observed writes slowly, the jitter of a single write hardly moves them
+	period += (interval - period) / 8;
+
+	qint64 predicted = _phase + period;
+	while (predicted + period / 2 < now)
+		predicted += period;
+
+	_phase = predicted + (now - predicted) / 4;
+	_period = period;
+
+	if (_samples < LEARNING_WRITES)
+		_samples++;
+}
+
+void WriteCadence::writeFinished(qint64 now)
+{
+	const qint64 lastStart = _lastStart;
+
+	if (lastStart <= 0 || now < lastStart)
+		return;
+
+	const qint64 duration = _duration;
+	_duration = (duration <= 0) ? now - lastStart : duration + (now - lastStart - duration) / 8;
+}
+
+bool WriteCadence::nextSlot(qint64 now, qint64& slot, qint64& period) const
+{
+	if (_refreshInterval <= 0 || _samples < LEARNING_WRITES)
+		return false;
+
+	period = _period;
+	const qint64 phase = _phase;
+
+	if (period <= 0)
+		return false;
+
+	slot = (now >= phase) ? phase + ((now - phase) / period + 1) * period : phase;
+
+	return true;
+}
+
+qint64 WriteCadence::readyTime() const
+{
+	if (_refreshInterval > 0 || _samples < LEARNING_WRITES)
+		return 0;
+
+	return _lastStart + _duration;
+}
+
+qint64 WriteCadence::duration() const
+{
+	return _duration;
+}
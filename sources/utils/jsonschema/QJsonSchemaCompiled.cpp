@@ -0,0 +1,234 @@
+// stdlib includes
+#include <math.h>
+
+// Utils-Jsonschema includes
+#include <utils/jsonschema/QJsonSchemaCompiled.h>
+
+namespace
+{
+	/// the keywords without a check in QJsonSchemaChecker ("options" may hold dependencies, so it is not one of them)
+	bool isAnnotation(const QString& keyword)
+	{
+		return keyword == "title" || keyword == "description" || keyword == "default" || keyword == "format"
+			|| keyword == "defaultProperties" || keyword == "propertyOrder" || keyword == "append" || keyword == "step"
+			|| keyword == "access" || keyword == "script" || keyword == "allowEmptyArray" || keyword == "comment" || keyword == "id";
+	}
+}
+
+QJsonSchemaCompiled::QJsonSchemaCompiled() :
+	_additionalProperties(true),
+	_compiled(false)
+{
+	// empty
+}
+
+QJsonSchemaCompiled::QJsonSchemaCompiled(const QJsonObject& schema) :
+	_additionalProperties(true),
+	_compiled(false)
+{
+	for (auto i = schema.begin(); i != schema.end(); ++i)
+	{
+		const QString& keyword = i.key();
+
+		if (keyword == "type")
+		{
+			if (i.value().toString() != "object")
+				return;
+		}
+		else if (keyword == "properties")
+		{
+			const QJsonObject properties = i.value().toObject();
+			for (auto property = properties.begin(); property != properties.end(); ++property)
+				if (!property.value().isObject() || !compileProperty(property.key(), property.value().toObject()))
+				{
+					_properties.clear();
+					return;
+				}
+		}
+		else if (keyword == "additionalProperties")
+		{
+			if (!i.value().isBool())
+				return;
+			_additionalProperties = i.value().toBool();
+		}
+		else if (keyword != "required" && !isAnnotation(keyword))
+			return;
+	}
+
+	_compiled = true;
+}
+
+bool QJsonSchemaCompiled::isCompiled() const
+{
+	return _compiled;
+}
+
+bool QJsonSchemaCompiled::parseType(const QJsonValue& schema, Type& type)
+{
+	const QString name = schema.toString();
+
+	if (name == "string" || name == "enum")
+		type = Type::STRING;
+	else if (name == "number" || name == "double")
+		type = Type::NUMBER;
+	else if (name == "integer")
+		type = Type::INTEGER;
+	else if (name == "boolean")
+		type = Type::BOOLEAN;
+	else if (name == "object")
+		type = Type::OBJECT;
+	else if (name == "array")
+		type = Type::ARRAY;
+	else if (name == "null")
+		type = Type::NULLTYPE;
+	else if (name == "any")
+		type = Type::ANY;
+	else
+		return false;
+
+	return true;
+}
+
+bool QJsonSchemaCompiled::checkType(const QJsonValue& value, Type type)
+{
+	switch (type)
+	{
+		case Type::STRING: return value.isString();
+		case Type::NUMBER: return value.isDouble();
+		case Type::INTEGER: return value.isDouble() && rint(value.toDouble()) == value.toDouble();
+		case Type::BOOLEAN: return value.isBool();
+		case Type::OBJECT: return value.isObject();
+		case Type::ARRAY: return value.isArray();
+		case Type::NULLTYPE: return value.isNull();
+		default: return true;
+	}
+}
+
+bool QJsonSchemaCompiled::compileProperty(const QString& name, const QJsonObject& schema)
+{
+	Property property;
+	property.name = name;
+
+	for (auto i = schema.begin(); i != schema.end(); ++i)
+	{
+		const QString& keyword = i.key();
+		const QJsonValue& value = i.value();
+
+		if (keyword == "type")
+		{
+			// an unknown type is accepted by QJsonSchemaChecker
+			property.hasType = parseType(value, property.type);
+		}
+		else if (keyword == "required")
+			property.required = value.toBool();
+		else if (keyword == "minimum")
+		{
+			property.hasMinimum = true;
+			property.minimum = value.toDouble();
+		}
+		else if (keyword == "maximum")
+		{
+			property.hasMaximum = true;
+			property.maximum = value.toDouble();
+		}
+		else if (keyword == "minLength")
+			property.minLength = value.toInt();
+		else if (keyword == "maxLength")
+			property.maxLength = value.toInt();
+		else if (keyword == "minItems")
+			property.minItems = value.toInt();
+		else if (keyword == "maxItems")
+			property.maxItems = value.toInt();
+		else if (keyword == "items")
+		{
+			// only the items of a single type
+			const QJsonObject items = value.toObject();
+			property.hasItems = true;
+			for (auto item = items.begin(); item != items.end(); ++item)
+				if (item.key() == "type")
+					parseType(item.value(), property.itemType);
+				else if (!isAnnotation(item.key()))
+					return false;
+		}
+		else if (keyword == "enum")
+		{
+			property.hasEnum = true;
+			property.enumValues = value.toArray();
+		}
+		else if (!isAnnotation(keyword))
+			return false;
+	}
+
+	_properties.append(property);
+	return true;
+}
+
+bool QJsonSchemaCompiled::checkProperty(const Property& property, const QJsonValue& value) const
+{
+	if (property.hasType && !checkType(value, property.type))
+		return false;
+
+	if (property.hasMinimum && (!value.isDouble() || value.toDouble() < property.minimum))
+		return false;
+
+	if (property.hasMaximum && (!value.isDouble() || value.toDouble() > property.maximum))
+		return false;
+
+	if (property.minLength >= 0 || property.maxLength >= 0)
+	{
+		if (!value.isString())
+			return false;
+
+		const int length = value.toString().size();
+		if ((property.minLength >= 0 && length < property.minLength) || (property.maxLength >= 0 && length > property.maxLength))
+			return false;
+	}
+
+	if (property.minItems >= 0 || property.maxItems >= 0 || property.hasItems)
+	{
+		if (!value.isArray())
+			return false;
+
+		const QJsonArray items = value.toArray();
+		if ((property.minItems >= 0 && items.size() < property.minItems) || (property.maxItems >= 0 && items.size() > property.maxItems))
+			return false;
+
+		if (property.itemType != Type::ANY)
+			for (const QJsonValue& item : items)
+				if (!checkType(item, property.itemType))
+					return false;
+	}
+
+	if (property.hasEnum && !property.enumValues.contains(value))
+		return false;
+
+	return true;
+}
+
+bool QJsonSchemaCompiled::validate(const QJsonObject& value) const
+{
+	if (!_compiled)
+		return false;
+
+	int known = 0;
+
+	for (const Property& property : _properties)
+	{
+		auto field = value.find(property.name);
+
+		if (field == value.end())
+		{
+			if (property.required)
+				return false;
+			continue;
+		}
+
+		known++;
+
+		if (!checkProperty(property, field.value()))
+			return false;
+	}
+
+	// every key that is not a property is an additional one
+	return _additionalProperties || known == value.size();
+}
@@ -12,10 +12,24 @@
 #include <QStringBuilder>
 #include <QStringList>
 #include <QHostAddress>
+#include <QTimer>
 
 #define REQ "request="
 #define RPC "json-rpc"
 
+namespace
+{
+	// persistent connections: closed after the idle time or the number of requests
+	const int KEEP_ALIVE_TIMEOUT = 15;
+	const int KEEP_ALIVE_MAX_REQUESTS = 1000;
+
+	// the replies are written as the socket drains, in pieces of this size
+	const int STREAM_CHUNK_SIZE = 64 * 1024;
+
+	// a header line without the end of line is refused above this size
+	const qint64 MAX_LINE_SIZE = 64 * 1024;
+}
+
 const QByteArray& QtHttpClientWrapper::CRLF = QByteArrayLiteral("\r\n");
 
 QtHttpClientWrapper::QtHttpClientWrapper(QTcpSocket* sock, const bool& localConnection, QtHttpServer* parent)
@@ -28,8 +42,21 @@ QtHttpClientWrapper::QtHttpClientWrapper(QTcpSocket* sock, const bool& localConn
 	, m_localConnection(localConnection)
 	, m_websocketClient(nullptr)
 	, m_webJsonRpc(nullptr)
+	, m_handledRequests(0)
+	, m_idleTimer(new QTimer(this))
+	, m_awaitingReply(false)
+	, m_closeAfterWrite(false)
+	, m_pendingOffset(0)
+	, m_memory(MemoryAccounting::WEB_SESSIONS)
 {
+	m_idleTimer->setSingleShot(true);
+	m_idleTimer->setInterval(KEEP_ALIVE_TIMEOUT * 1000);
+	connect(m_idleTimer, &QTimer::timeout, this, &QtHttpClientWrapper::onClientIdle);
+	m_idleTimer->start();
+	updateMemory();
+
 	connect(m_sockClient, &QTcpSocket::readyRead, this, &QtHttpClientWrapper::onClientDataReceived);
+	connect(m_sockClient, &QTcpSocket::bytesWritten, this, &QtHttpClientWrapper::writePendingData);
 }
 
 QString QtHttpClientWrapper::getGuid(void)
@@ -51,102 +78,120 @@ void QtHttpClientWrapper::onClientDataReceived(void)
 {
 	if (m_sockClient != Q_NULLPTR)
 	{
-		while (m_sockClient->bytesAvailable())
-		{
-			QByteArray line = m_sockClient->readLine();
+		m_idleTimer->start();
 
-			switch (m_parsingStatus) // handle parsing steps
-			{
-			case AwaitingRequest: // "command url version" × 1
+		// a pipelined request stays in the socket until the reply of the previous one is on the way
+		while (!m_awaitingReply && !m_closeAfterWrite && m_websocketClient == Q_NULLPTR && m_sockClient->bytesAvailable())
+		{
+			if (m_parsingStatus == AwaitingContent) // raw data × Content-Length
 			{
-				QString str = QString::fromUtf8(line).trimmed();
-				QStringList parts = QStringUtils::SPLITTER(str, SPACE);
-				if (parts.size() == 3)
-				{
-					QString command = parts.at(0);
-					QString url = parts.at(1);
-					QString version = parts.at(2);
+				const int missing = m_currentRequest->getHeader(QtHttpHeader::ContentLength).toInt() - m_currentRequest->getRawDataSize();
 
-					if (version == QtHttpServer::HTTP_VERSION)
-					{
-						m_currentRequest = new QtHttpRequest(this, m_serverHandle);
-						m_currentRequest->setClientInfo(m_sockClient->localAddress(), m_sockClient->peerAddress());
-						m_currentRequest->setUrl(QUrl(url));
-						m_currentRequest->setCommand(command);
-						m_parsingStatus = AwaitingHeaders;
-					}
-					else
-					{
-						m_parsingStatus = ParsingError;
-						//qWarning () << "Error : unhandled HTTP version :" << version;
-					}
-				}
-				else
+				m_currentRequest->appendRawData(m_sockClient->read(missing));
+
+				if (m_currentRequest->getRawDataSize() == m_currentRequest->getHeader(QtHttpHeader::ContentLength).toInt())
 				{
-					m_parsingStatus = ParsingError;
-					//qWarning () << "Error : incorrect HTTP command line :" << line;
+					m_parsingStatus = RequestParsed;
 				}
+			}
+			else if (!m_sockClient->canReadLine()) // only complete lines, the rest waits for the next read
+			{
+				if (m_sockClient->bytesAvailable() <= MAX_LINE_SIZE)
+					break;
 
-				break;
+				m_parsingStatus = ParsingError;
 			}
-			case AwaitingHeaders: // "header: value" × N (until empty line)
+			else
 			{
-				QByteArray raw = line.trimmed();
+				QByteArray line = m_sockClient->readLine();
 
-				if (!raw.isEmpty()) // parse headers
+				switch (m_parsingStatus) // handle parsing steps
 				{
-					int pos = raw.indexOf(COLON);
+				case AwaitingRequest: // "command url version" × 1
+				{
+					QString str = QString::fromUtf8(line).trimmed();
 
-					if (pos > 0)
+					// an empty line between the requests is ignored
+					if (str.isEmpty())
+						break;
+
+					QStringList parts = QStringUtils::SPLITTER(str, SPACE);
+					if (parts.size() == 3)
 					{
-						QByteArray header = raw.left(pos).trimmed();
-						QByteArray value = raw.mid(pos + 1).trimmed();
-						m_currentRequest->addHeader(header, value);
-						if (header == QtHttpHeader::ContentLength)
+						QString command = parts.at(0);
+						QString url = parts.at(1);
+						QString version = parts.at(2);
+
+						if (version == QtHttpServer::HTTP_VERSION)
 						{
-							bool ok = false;
-							const int len = value.toInt(&ok, 10);
-							if (ok)
-							{
-								m_currentRequest->addHeader(QtHttpHeader::ContentLength, QByteArray::number(len));
-							}
+							m_currentRequest = new QtHttpRequest(this, m_serverHandle);
+							m_currentRequest->setClientInfo(m_sockClient->localAddress(), m_sockClient->peerAddress());
+							m_currentRequest->setUrl(QUrl(url));
+							m_currentRequest->setCommand(command);
+							m_parsingStatus = AwaitingHeaders;
+						}
+						else
+						{
+							m_parsingStatus = ParsingError;
+							//qWarning () << "Error : unhandled HTTP version :" << version;
 						}
 					}
 					else
 					{
 						m_parsingStatus = ParsingError;
-						qWarning() << "Error : incorrect HTTP headers line :" << line;
+						//qWarning () << "Error : incorrect HTTP command line :" << line;
 					}
+
+					break;
 				}
-				else // end of headers
+				case AwaitingHeaders: // "header: value" × N (until empty line)
 				{
-					if (m_currentRequest->getHeader(QtHttpHeader::ContentLength).toInt() > 0)
+					QByteArray raw = line.trimmed();
+
+					if (!raw.isEmpty()) // parse headers
 					{
-						m_parsingStatus = AwaitingContent;
+						int pos = raw.indexOf(COLON);
+
+						if (pos > 0)
+						{
+							QByteArray header = raw.left(pos).trimmed();
+							QByteArray value = raw.mid(pos + 1).trimmed();
+							m_currentRequest->addHeader(header, value);
+							if (header == QtHttpHeader::ContentLength)
+							{
+								bool ok = false;
+								const int len = value.toInt(&ok, 10);
+								if (ok)
+								{
+									m_currentRequest->addHeader(QtHttpHeader::ContentLength, QByteArray::number(len));
+								}
+							}
+						}
+						else
+						{
+							m_parsingStatus = ParsingError;
+							qWarning() << "Error : incorrect HTTP headers line :" << line;
+						}
 					}
-					else
+					else // end of headers
 					{
-						m_parsingStatus = RequestParsed;
+						if (m_currentRequest->getHeader(QtHttpHeader::ContentLength).toInt() > 0)
+						{
+							m_parsingStatus = AwaitingContent;
+						}
+						else
+						{
+							m_parsingStatus = RequestParsed;
+						}
 					}
-				}
-
-				break;
-			}
-			case AwaitingContent: // raw data × N (until EOF ??)
-			{
-				m_currentRequest->appendRawData(line);
 
-				if (m_currentRequest->getRawDataSize() == m_currentRequest->getHeader(QtHttpHeader::ContentLength).toInt())
+					break;
+				}
+				default:
 				{
-					m_parsingStatus = RequestParsed;
+					break;
+				}
 				}
-
-				break;
-			}
-			default:
-			{
-				break;
-			}
 			}
 
 			switch (m_parsingStatus) // handle parsing status end/error
@@ -158,8 +203,19 @@ void QtHttpClientWrapper::onClientDataReceived(void)
 				{
 					if (m_websocketClient == Q_NULLPTR)
 					{
+						// the replies of the previous requests go first, the WebSocket writes to the socket directly
+						for (const QByteArray& data : m_pendingData)
+						{
+							m_sockClient->write(data.constData() + m_pendingOffset, data.size() - m_pendingOffset);
+							m_pendingOffset = 0;
+						}
+						m_pendingData.clear();
+						updateMemory();
+						m_idleTimer->stop();
+
 						// disconnect this slot from socket for further requests
 						disconnect(m_sockClient, &QTcpSocket::readyRead, this, &QtHttpClientWrapper::onClientDataReceived);
+						disconnect(m_sockClient, &QTcpSocket::bytesWritten, this, &QtHttpClientWrapper::writePendingData);
 						// disabling packet bunching
 						m_sockClient->setSocketOption(QAbstractSocket::LowDelayOption, 1);
 						m_sockClient->setSocketOption(QAbstractSocket::KeepAliveOption, 1);
@@ -219,6 +275,11 @@ void QtHttpClientWrapper::onClientDataReceived(void)
 						}
 
 						m_webJsonRpc->handleMessage(m_currentRequest, query);
+
+						// not answered yet: the next requests wait for the reply
+						if (m_currentRequest != Q_NULLPTR)
+							m_awaitingReply = true;
+
 						break;
 					}
 				}
@@ -236,10 +297,14 @@ void QtHttpClientWrapper::onClientDataReceived(void)
 				m_sockClient->readAll(); // clear remaining buffer to ignore content
 				QtHttpReply reply(m_serverHandle);
 				reply.setStatusCode(QtHttpReply::BadRequest);
+				reply.addHeader(QtHttpHeader::Connection, QByteArrayLiteral("close"));
 				reply.appendRawData(QByteArrayLiteral("<h1>Bad Request (HTTP parsing error) !</h1>"));
 				reply.appendRawData(CRLF);
 				m_parsingStatus = sendReplyToClient(&reply);
 
+				// the stream can't be followed any more
+				closeAfterWrite();
+
 				break;
 			}
 			default:
@@ -266,6 +331,22 @@ void QtHttpClientWrapper::onReplySendHeadersRequested(void)
 		data.append(QtHttpReply::getStatusTextForCode(reply->getStatusCode()));
 		data.append(CRLF);
 
+		// persistent connection unless the reply, the client or the limit of the requests closes it
+		static const QByteArray& CLOSE = QByteArrayLiteral("close");
+		if (reply->getHeader(QtHttpHeader::Connection).isEmpty())
+		{
+			if ((m_currentRequest != Q_NULLPTR && m_currentRequest->getHeader(QtHttpHeader::Connection).toLower() == CLOSE) ||
+				m_handledRequests + 1 >= KEEP_ALIVE_MAX_REQUESTS)
+			{
+				reply->addHeader(QtHttpHeader::Connection, CLOSE);
+			}
+			else
+			{
+				reply->addHeader(QtHttpHeader::Connection, QByteArrayLiteral("keep-alive"));
+				reply->addHeader(QtHttpHeader::KeepAlive, QString("timeout=%1, max=%2").arg(KEEP_ALIVE_TIMEOUT).arg(KEEP_ALIVE_MAX_REQUESTS - m_handledRequests - 1).toLatin1());
+			}
+		}
+
 		if (reply->useChunked()) // Header name: header value
 		{
 			static const QByteArray& CHUNKED = QByteArrayLiteral("chunked");
@@ -289,8 +370,7 @@ void QtHttpClientWrapper::onReplySendHeadersRequested(void)
 
 		// empty line
 		data.append(CRLF);
-		m_sockClient->write(data);
-		m_sockClient->flush();
+		writeToClient(data);
 	}
 }
 
@@ -310,8 +390,7 @@ void QtHttpClientWrapper::onReplySendDataRequested(void)
 		}
 
 		// write to socket
-		m_sockClient->write(data);
-		m_sockClient->flush();
+		writeToClient(data);
 	}
 }
 
@@ -320,6 +399,13 @@ void QtHttpClientWrapper::sendToClientWithReply(QtHttpReply* reply)
 	connect(reply, &QtHttpReply::requestSendHeaders, this, &QtHttpClientWrapper::onReplySendHeadersRequested, Qt::UniqueConnection);
 	connect(reply, &QtHttpReply::requestSendData, this, &QtHttpClientWrapper::onReplySendDataRequested, Qt::UniqueConnection);
 	m_parsingStatus = sendReplyToClient(reply);
+
+	// the reply came later, continue with the pipelined requests
+	if (m_awaitingReply)
+	{
+		m_awaitingReply = false;
+		QTimer::singleShot(0, this, &QtHttpClientWrapper::onClientDataReceived);
+	}
 }
 
 QtHttpClientWrapper::ParsingStatus QtHttpClientWrapper::sendReplyToClient(QtHttpReply* reply)
@@ -336,18 +422,19 @@ QtHttpClientWrapper::ParsingStatus QtHttpClientWrapper::sendReplyToClient(QtHttp
 		else
 		{
 			// last chunk
-			m_sockClient->write("0" % CRLF % CRLF);
-			m_sockClient->flush();
+			writeToClient("0" % CRLF % CRLF);
 		}
 
+		m_handledRequests++;
+
 		if (m_currentRequest != Q_NULLPTR)
 		{
 			static const QByteArray& CLOSE = QByteArrayLiteral("close");
 
-			if (m_currentRequest->getHeader(QtHttpHeader::Connection).toLower() == CLOSE)
+			if (m_currentRequest->getHeader(QtHttpHeader::Connection).toLower() == CLOSE || m_handledRequests >= KEEP_ALIVE_MAX_REQUESTS)
 			{
 				// must close connection after this request
-				m_sockClient->close();
+				closeAfterWrite();
 			}
 
 			m_currentRequest->deleteLater();
@@ -365,11 +452,78 @@ void QtHttpClientWrapper::closeConnection()
 	{
 		QtHttpReply reply(m_serverHandle);
 		reply.setStatusCode(QtHttpReply::StatusCode::Forbidden);
+		reply.addHeader(QtHttpHeader::Connection, QByteArrayLiteral("close"));
 
 		connect(&reply, &QtHttpReply::requestSendHeaders, this, &QtHttpClientWrapper::onReplySendHeadersRequested, Qt::UniqueConnection);
 		connect(&reply, &QtHttpReply::requestSendData, this, &QtHttpClientWrapper::onReplySendDataRequested, Qt::UniqueConnection);
 
 		m_parsingStatus = sendReplyToClient(&reply);
 	}
-	m_sockClient->close();
+	closeAfterWrite();
+}
+
+void QtHttpClientWrapper::onClientIdle(void)
+{
+	if (m_websocketClient == Q_NULLPTR)
+		closeAfterWrite();
+}
+
+void QtHttpClientWrapper::writeToClient(const QByteArray& data)
+{
+	if (!data.isEmpty())
+	{
+		m_pendingData.append(data);
+		writePendingData();
+	}
+}
+
+void QtHttpClientWrapper::writePendingData(void)
+{
+	while (!m_pendingData.isEmpty() && m_sockClient->bytesToWrite() < STREAM_CHUNK_SIZE)
+	{
+		const QByteArray& data = m_pendingData.first();
+		const qint64 written = m_sockClient->write(data.constData() + m_pendingOffset, qMin(data.size() - m_pendingOffset, STREAM_CHUNK_SIZE));
+
+		if (written <= 0)
+		{
+			// the socket is closed
+			m_pendingData.clear();
+			m_pendingOffset = 0;
+			break;
+		}
+
+		m_pendingOffset += static_cast<int>(written);
+
+		if (m_pendingOffset >= data.size())
+		{
+			m_pendingData.removeFirst();
+			m_pendingOffset = 0;
+		}
+
+		// a slow client is not idle while its reply drains
+		if (m_websocketClient == Q_NULLPTR && !m_closeAfterWrite)
+			m_idleTimer->start();
+	}
+
+	updateMemory();
+
+	// disconnectFromHost still sends what is in the socket
+	if (m_pendingData.isEmpty() && m_closeAfterWrite && m_sockClient->state() == QAbstractSocket::ConnectedState)
+		m_sockClient->disconnectFromHost();
+}
+
+void QtHttpClientWrapper::updateMemory(void)
+{
+	size_t memory = sizeof(QtHttpClientWrapper);
+
+	for (const QByteArray& data : m_pendingData)
+		memory += data.size();
+
+	m_memory.set(memory);
+}
+
+void QtHttpClientWrapper::closeAfterWrite(void)
+{
+	m_closeAfterWrite = true;
+	writePendingData();
 }
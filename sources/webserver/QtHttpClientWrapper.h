@@ -3,8 +3,13 @@
 
 #include <QObject>
 #include <QString>
+#include <QList>
+#include <QByteArray>
+
+#include <utils/MemoryAccounting.h>
 
 class QTcpSocket;
+class QTimer;
 
 class QtHttpRequest;
 class QtHttpReply;
@@ -41,6 +46,12 @@ public:
 
 private slots:
 	void onClientDataReceived(void);
+	void onClientIdle(void);
+
+	///
+	/// @brief Streams the queued replies to the socket as it drains, a large body is never copied into the socket at once
+	///
+	void writePendingData(void);
 
 protected:
 	ParsingStatus sendReplyToClient(QtHttpReply* reply);
@@ -58,6 +69,24 @@ private:
 	const bool			m_localConnection;
 	WebSocketClient*	m_websocketClient;
 	WebJsonRpc*			m_webJsonRpc;
+
+	/// persistent connection: the number of the replies sent and the idle timer
+	int					m_handledRequests;
+	QTimer*				m_idleTimer;
+	/// the reply of a request is sent later (JSON-RPC), the pipelined requests wait to keep the order of the replies
+	bool				m_awaitingReply;
+	/// close the connection when the queued data is sent
+	bool				m_closeAfterWrite;
+
+	QList<QByteArray>	m_pendingData;
+	int					m_pendingOffset;
+
+	/// the session and the replies that wait for the socket
+	MemoryAccounting::Tag m_memory;
+
+	void writeToClient(const QByteArray& data);
+	void updateMemory(void);
+	void closeAfterWrite(void);
 };
 
 #endif // QTHTTPCLIENTWRAPPER_H
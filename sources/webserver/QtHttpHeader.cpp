@@ -11,6 +11,7 @@ const QByteArray & QtHttpHeader::Cookie               = QByteArrayLiteral ("Cook
 const QByteArray & QtHttpHeader::ContentType          = QByteArrayLiteral ("Content-Type");
 const QByteArray & QtHttpHeader::ContentLength        = QByteArrayLiteral ("Content-Length");
 const QByteArray & QtHttpHeader::Connection           = QByteArrayLiteral ("Connection");
+const QByteArray & QtHttpHeader::KeepAlive            = QByteArrayLiteral ("Keep-Alive");
 const QByteArray & QtHttpHeader::UserAgent            = QByteArrayLiteral ("User-Agent");
 const QByteArray & QtHttpHeader::AcceptCharset        = QByteArrayLiteral ("Accept-Charset");
 const QByteArray & QtHttpHeader::AcceptEncoding       = QByteArrayLiteral ("Accept-Encoding");
@@ -31,6 +32,10 @@ const QByteArray & QtHttpHeader::SetCookie            = QByteArrayLiteral ("Set-
 const QByteArray & QtHttpHeader::TransferEncoding     = QByteArrayLiteral ("Transfer-Encoding");
 const QByteArray & QtHttpHeader::ContentDisposition   = QByteArrayLiteral ("Content-Disposition");
 const QByteArray & QtHttpHeader::AccessControlAllow   = QByteArrayLiteral ("Access-Control-Allow-Origin");
+const QByteArray & QtHttpHeader::ETag                 = QByteArrayLiteral ("ETag");
+const QByteArray & QtHttpHeader::IfNoneMatch          = QByteArrayLiteral ("If-None-Match");
+const QByteArray & QtHttpHeader::IfModifiedSince      = QByteArrayLiteral ("If-Modified-Since");
+const QByteArray & QtHttpHeader::Vary                 = QByteArrayLiteral ("Vary");
 const QByteArray & QtHttpHeader::Upgrade              = QByteArrayLiteral ("Upgrade");
 const QByteArray & QtHttpHeader::SecWebSocketKey      = QByteArrayLiteral ("Sec-WebSocket-Key");
 const QByteArray & QtHttpHeader::SecWebSocketProtocol = QByteArrayLiteral ("Sec-WebSocket-Protocol");
@@ -13,6 +13,7 @@ public:
 	static const QByteArray& ContentType;
 	static const QByteArray& ContentLength;
 	static const QByteArray& Connection;
+	static const QByteArray& KeepAlive;
 	static const QByteArray& Cookie;
 	static const QByteArray& UserAgent;
 	static const QByteArray& AcceptCharset;
@@ -34,6 +35,11 @@ public:
 	static const QByteArray& TransferEncoding;
 	static const QByteArray& ContentDisposition;
 	static const QByteArray& AccessControlAllow;
+	// cache validators
+	static const QByteArray& ETag;
+	static const QByteArray& IfNoneMatch;
+	static const QByteArray& IfModifiedSince;
+	static const QByteArray& Vary;
 	// Websocket specific headers
 	static const QByteArray& Upgrade;
 	static const QByteArray& SecWebSocketKey;
@@ -22,6 +22,7 @@ const QByteArray QtHttpReply::getStatusTextForCode(QtHttpReply::StatusCode statu
 	switch (statusCode)
 	{
 	case Ok:         return QByteArrayLiteral("OK.");
+	case NotModified: return QByteArrayLiteral("Not Modified");
 	case BadRequest: return QByteArrayLiteral("Bad request !");
 	case Forbidden:  return QByteArrayLiteral("Forbidden !");
 	case NotFound:   return QByteArrayLiteral("Not found !");
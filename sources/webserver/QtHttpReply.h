@@ -20,6 +20,7 @@ public:
 	{
 		Ok = 200,
 		SeeOther = 303,
+		NotModified = 304,
 		BadRequest = 400,
 		Forbidden = 403,
 		NotFound = 404,
@@ -1,5 +1,8 @@
 #include <utils/QStringUtils.h>
+#include <utils/PerformanceCounters.h>
+#include <utils/Macros.h>
 #include "StaticFileServing.h"
+#include <HyperhdrConfig.h>
 
 #include <QStringBuilder>
 #include <QUrlQuery>
@@ -8,15 +11,30 @@
 #include <QFile>
 #include <QFileInfo>
 #include <QResource>
+#include <QCryptographicHash>
+#include <QLocale>
 #include <exception>
 
+namespace
+{
+	// the in-memory cache keeps the assets of the web UI, a larger file is read on every request
+	const qint64 CACHE_MAX_FILE_SIZE = 1024 * 1024;
+	const qint64 CACHE_MAX_SIZE = 16 * 1024 * 1024;
+}
+
 StaticFileServing::StaticFileServing(QObject* parent)
 	: QObject(parent)
 	, _baseUrl()
 	, _cgi(this)
 	, _log(Logger::getInstance("WEBSERVER"))
+	, _openMetrics(false)
+	, _bundle()
+	, _bundleMode(false)
+	, _cacheSize(0)
 {
+#ifndef ENABLE_WEB_BUNDLE
 	Q_INIT_RESOURCE(WebConfig);
+#endif
 
 	_mimeDb = new QMimeDatabase;
 }
@@ -30,6 +48,14 @@ void StaticFileServing::setBaseUrl(const QString& url)
 {
 	_baseUrl = url;
 	_cgi.setBaseUrl(url);
+
+#ifdef ENABLE_WEB_BUNDLE
+	// the build has no embedded UI, the bundle takes its place
+	_bundleMode = url.startsWith(':');
+#endif
+
+	_cache.clear();
+	_cacheSize = 0;
 }
 
 void StaticFileServing::setSSDPDescription(const QString& desc)
@@ -40,39 +66,55 @@ void StaticFileServing::setSSDPDescription(const QString& desc)
 		_ssdpDescription = desc.toLocal8Bit();
 }
 
+void StaticFileServing::setOpenMetrics(bool enabled)
+{
+	_openMetrics = enabled;
+}
+
 void StaticFileServing::printErrorToReply(QtHttpReply* reply, QtHttpReply::StatusCode code, QString errorMessage)
 {
 	reply->setStatusCode(code);
 	reply->addHeader("Content-Type", QByteArrayLiteral("text/html"));
-	QFile errorPageHeader(_baseUrl % "/errorpages/header.html");
-	QFile errorPageFooter(_baseUrl % "/errorpages/footer.html");
-	QFile errorPage(_baseUrl % "/errorpages/" % QString::number((int)code) % ".html");
 
-	if (errorPageHeader.open(QFile::ReadOnly))
-	{
-		QByteArray data = errorPageHeader.readAll();
+	QByteArray data;
+
+	if (readFile("/errorpages/header.html", data))
 		reply->appendRawData(data);
-		errorPageHeader.close();
-	}
 
-	if (errorPage.open(QFile::ReadOnly))
+	if (readFile("/errorpages/" % QString::number((int)code) % ".html", data))
 	{
-		QByteArray data = errorPage.readAll();
 		data = data.replace("{MESSAGE}", errorMessage.toLocal8Bit());
 		reply->appendRawData(data);
-		errorPage.close();
 	}
 	else
 	{
 		reply->appendRawData(QString(QString::number(code) + " - " + errorMessage).toLocal8Bit());
 	}
 
-	if (errorPageFooter.open(QFile::ReadOnly))
-	{
-		QByteArray data = errorPageFooter.readAll();
+	if (readFile("/errorpages/footer.html", data))
 		reply->appendRawData(data);
-		errorPageFooter.close();
+}
+
+bool StaticFileServing::readFile(const QString& path, QByteArray& data)
+{
+	if (_bundleMode)
+	{
+		QByteArray gzip;
+		if (!_bundle.find(path, data, gzip))
+			return false;
+
+		// a deep copy, the caller may modify it
+		data = QByteArray(data.constData(), data.size());
+		return true;
 	}
+
+	QFile file(_baseUrl % path);
+	if (!file.open(QFile::ReadOnly))
+		return false;
+
+	data = file.readAll();
+	file.close();
+	return true;
 }
 
 void StaticFileServing::onRequestNeedsReply(QtHttpRequest* request, QtHttpReply* reply)
@@ -105,6 +147,47 @@ void StaticFileServing::onRequestNeedsReply(QtHttpRequest* request, QtHttpReply*
 				reply->appendRawData(_ssdpDescription);
 				return;
 			}
+			else if (_openMetrics && uri_parts.at(0) == "metrics" && uri_parts.size() == 1)
+			{
+				// built from the last reports of the performance counters: nothing is measured for the scrape
+				QString metrics;
+				SAFE_CALL_0_RET(PerformanceCounters::getInstance(), getOpenMetrics, QString, metrics);
+
+				reply->addHeader("Content-Type", "application/openmetrics-text; version=1.0.0; charset=utf-8");
+				reply->addHeader("Cache-Control", "no-store");
+				reply->appendRawData(metrics.toUtf8());
+				return;
+			}
+		}
+
+		if (_bundleMode)
+		{
+			if (path.isEmpty() || path.endsWith("/"))
+				path += "index.html";
+			else if (!_bundle.contains(path) && _bundle.contains(path + "/index.html"))
+				path += "/index.html";
+
+			const QString fileName = _baseUrl % "/" % path;
+			auto cached = _cache.constFind(fileName);
+
+			if (cached != _cache.constEnd())
+			{
+				sendAsset(request, reply, cached.value());
+				return;
+			}
+
+			// the data stays in the mapping, only the validators take the heap
+			CachedAsset asset;
+			if (loadBundleAsset(path, asset))
+			{
+				_cache.insert(fileName, asset);
+				sendAsset(request, reply, asset);
+			}
+			else
+			{
+				printErrorToReply(reply, QtHttpReply::NotFound, "Requested file: " % path);
+			}
+			return;
 		}
 
 		QFileInfo info(_baseUrl % "/" % path);
@@ -122,16 +205,43 @@ void StaticFileServing::onRequestNeedsReply(QtHttpRequest* request, QtHttpReply*
 		}
 
 		// get static files
-		QFile file(_baseUrl % "/" % path);
+		const QString fileName = _baseUrl % "/" % path;
+		auto cached = _cache.constFind(fileName);
+
+		// the embedded files never change, a document root on the disk is checked
+		if (cached != _cache.constEnd())
+		{
+			if (fileName.startsWith(':'))
+			{
+				sendAsset(request, reply, cached.value());
+				return;
+			}
+
+			QFileInfo current(fileName);
+			if (current.size() == cached.value().size && current.lastModified() == cached.value().modified)
+			{
+				sendAsset(request, reply, cached.value());
+				return;
+			}
+		}
+
+		QFile file(fileName);
 		if (file.exists())
 		{
-			QMimeType mime = _mimeDb->mimeTypeForFile(file.fileName());
-			if (file.open(QFile::ReadOnly)) {
-				QByteArray data = file.readAll();
-				reply->addHeader("Content-Type", mime.name().toLocal8Bit());
-				reply->addHeader(QtHttpHeader::AccessControlAllow, "*");
-				reply->appendRawData(data);
-				file.close();
+			CachedAsset asset;
+
+			if (loadAsset(fileName, asset))
+			{
+				const qint64 assetSize = asset.data.size() + asset.gzip.size();
+				const qint64 replaced = (cached != _cache.constEnd()) ? cached.value().data.size() + cached.value().gzip.size() : 0;
+
+				if (assetSize <= CACHE_MAX_FILE_SIZE && _cacheSize - replaced + assetSize <= CACHE_MAX_SIZE)
+				{
+					_cacheSize += assetSize - replaced;
+					_cache.insert(fileName, asset);
+				}
+
+				sendAsset(request, reply, asset);
 			}
 			else
 			{
@@ -148,3 +258,97 @@ void StaticFileServing::onRequestNeedsReply(QtHttpRequest* request, QtHttpReply*
 		printErrorToReply(reply, QtHttpReply::MethodNotAllowed, "Unhandled HTTP/1.1 method " % command);
 	}
 }
+
+bool StaticFileServing::loadAsset(const QString& fileName, CachedAsset& asset)
+{
+	QFile file(fileName);
+
+	if (!file.open(QFile::ReadOnly))
+		return false;
+
+	QFileInfo info(fileName);
+
+	asset.data = file.readAll();
+	asset.mime = _mimeDb->mimeTypeForFile(fileName).name().toLocal8Bit();
+	asset.modified = info.lastModified();
+	asset.size = info.size();
+
+	setValidators(asset);
+
+	file.close();
+
+	// the variant compressed at build time
+	QFile gzipFile(fileName % ".gz");
+	if (gzipFile.open(QFile::ReadOnly))
+	{
+		QByteArray gzip = gzipFile.readAll();
+
+		if (gzip.size() < asset.data.size())
+			asset.gzip = gzip;
+
+		gzipFile.close();
+	}
+
+	return true;
+}
+
+bool StaticFileServing::loadBundleAsset(const QString& path, CachedAsset& asset)
+{
+	if (!_bundle.find(path, asset.data, asset.gzip))
+		return false;
+
+	asset.mime = _mimeDb->mimeTypeForFile(path, QMimeDatabase::MatchExtension).name().toLocal8Bit();
+	asset.modified = _bundle.modified();
+	asset.size = asset.data.size();
+
+	setValidators(asset);
+
+	return true;
+}
+
+void StaticFileServing::setValidators(CachedAsset& asset)
+{
+	asset.etag = "W/\"" + QCryptographicHash::hash(asset.data, QCryptographicHash::Md5).toHex().left(16) + "\"";
+
+	if (asset.modified.isValid())
+		asset.lastModified = QLocale::c().toString(asset.modified.toUTC(), "ddd, dd MMM yyyy hh:mm:ss").toLatin1() + " GMT";
+}
+
+void StaticFileServing::sendAsset(QtHttpRequest* request, QtHttpReply* reply, const CachedAsset& asset)
+{
+	// the code of the UI is revalidated on every load, so an update is never hidden by the cache
+	const bool revalidate = asset.mime.startsWith("text/") || asset.mime.contains("javascript") || asset.mime.contains("json");
+
+	reply->addHeader(QtHttpHeader::AccessControlAllow, "*");
+	reply->addHeader(QtHttpHeader::ETag, asset.etag);
+	reply->addHeader(QtHttpHeader::CacheControl, (revalidate) ? QByteArrayLiteral("no-cache") : QByteArrayLiteral("max-age=86400"));
+
+	if (!asset.lastModified.isEmpty())
+		reply->addHeader(QtHttpHeader::LastModified, asset.lastModified);
+
+	if (!asset.gzip.isEmpty())
+		reply->addHeader(QtHttpHeader::Vary, QtHttpHeader::AcceptEncoding);
+
+	const QByteArray ifNoneMatch = request->getHeader(QtHttpHeader::IfNoneMatch);
+	const bool notModified = (!ifNoneMatch.isEmpty()) ?
+		(ifNoneMatch.contains(asset.etag) || ifNoneMatch.trimmed() == "*") :
+		(!asset.lastModified.isEmpty() && request->getHeader(QtHttpHeader::IfModifiedSince) == asset.lastModified);
+
+	if (notModified)
+	{
+		reply->setStatusCode(QtHttpReply::NotModified);
+		return;
+	}
+
+	reply->addHeader(QtHttpHeader::ContentType, asset.mime);
+
+	if (!asset.gzip.isEmpty() && request->getHeader(QtHttpHeader::AcceptEncoding).contains("gzip"))
+	{
+		reply->addHeader(QtHttpHeader::ContentEncoding, QByteArrayLiteral("gzip"));
+		reply->appendRawData(asset.gzip);
+	}
+	else
+	{
+		reply->appendRawData(asset.data);
+	}
+}
@@ -2,12 +2,15 @@
 #define STATICFILESERVING_H
 
 #include <QMimeDatabase>
+#include <QHash>
+#include <QDateTime>
 
 //#include "QtHttpServer.h"
 #include "QtHttpRequest.h"
 #include "QtHttpReply.h"
 #include "QtHttpHeader.h"
 #include "CgiHandler.h"
+#include "WebBundle.h"
 
 #include <utils/Logger.h>
 
@@ -28,16 +31,50 @@ public:
 	/// @param The description
 	///
 	void setSSDPDescription(const QString& desc);
+	///
+	/// @brief Serve the performance counters on /metrics, it's off by default: the scrape needs no authorization
+	///
+	void setOpenMetrics(bool enabled);
 
 public slots:
 	void onRequestNeedsReply(QtHttpRequest* request, QtHttpReply* reply);
 
 private:
+	///
+	/// @brief A static file with its precompressed variant and the validators, kept in memory while it is small
+	///
+	struct CachedAsset
+	{
+		QByteArray	data;
+		QByteArray	gzip;
+		QByteArray	mime;
+		QByteArray	etag;
+		QByteArray	lastModified;
+		QDateTime	modified;
+		qint64		size = 0;
+	};
+
 	QString         _baseUrl;
 	QMimeDatabase*  _mimeDb;
 	CgiHandler      _cgi;
 	Logger*         _log;
 	QByteArray      _ssdpDescription;
+	bool            _openMetrics;
+
+	/// the embedded document root is served from the bundle file (ENABLE_WEB_BUNDLE), the cache points into its mapping
+	WebBundle       _bundle;
+	bool            _bundleMode;
+
+	QHash<QString, CachedAsset> _cache;
+	qint64          _cacheSize;
+
+	bool loadAsset(const QString& fileName, CachedAsset& asset);
+	bool loadBundleAsset(const QString& path, CachedAsset& asset);
+	void setValidators(CachedAsset& asset);
+
+	/// a whole file of the document root, ex. an error page
+	bool readFile(const QString& path, QByteArray& data);
+	void sendAsset(QtHttpRequest* request, QtHttpReply* reply, const CachedAsset& asset);
 
 	void printErrorToReply(QtHttpReply* reply, QtHttpReply::StatusCode code, QString errorMessage);
 
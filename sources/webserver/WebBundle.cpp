@@ -0,0 +1,128 @@
+#include "WebBundle.h"
+
+#include <QCoreApplication>
+#include <QDir>
+#include <QFileInfo>
+
+#include <climits>
+#include <cstring>
+
+namespace
+{
+	const QByteArray BUNDLE_SIGNATURE = "HYPERHDR-WWW 1\n";
+	const QString BUNDLE_NAME = "hyperhdr-www.bundle";
+}
+
+WebBundle::WebBundle()
+	: _log(Logger::getInstance("WEBSERVER"))
+	, _file()
+	, _data(nullptr)
+	, _size(0)
+	, _opened(false)
+	, _index()
+{
+}
+
+WebBundle::~WebBundle()
+{
+	if (_data != nullptr)
+		_file.unmap(const_cast<uchar*>(_data));
+}
+
+QString WebBundle::location()
+{
+	const QString binaryDir = QCoreApplication::applicationDirPath();
+
+	if (QFileInfo::exists(binaryDir + "/" + BUNDLE_NAME))
+		return binaryDir + "/" + BUNDLE_NAME;
+
+	return QDir::cleanPath(binaryDir + "/../" + BUNDLE_NAME);
+}
+
+bool WebBundle::open()
+{
+	if (_opened)
+		return _data != nullptr;
+
+	_opened = true;
+
+	_file.setFileName(location());
+	if (!_file.open(QIODevice::ReadOnly))
+	{
+		Error(_log, "The web UI bundle '%s' is not available: %s", QSTRING_CSTR(_file.fileName()), QSTRING_CSTR(_file.errorString()));
+		return false;
+	}
+
+	_size = _file.size();
+	const uchar* data = (_size > 0) ? _file.map(0, _size) : nullptr;
+
+	if (data == nullptr || _size < BUNDLE_SIGNATURE.size() || memcmp(data, BUNDLE_SIGNATURE.constData(), BUNDLE_SIGNATURE.size()) != 0)
+	{
+		Error(_log, "The web UI bundle '%s' is invalid", QSTRING_CSTR(_file.fileName()));
+		if (data != nullptr)
+			_file.unmap(const_cast<uchar*>(data));
+		return false;
+	}
+
+	// the header ends with an empty line, the offsets count from there
+	const QByteArray content = QByteArray::fromRawData(reinterpret_cast<const char*>(data), static_cast<int>(qMin(_size, static_cast<qint64>(INT_MAX))));
+	const int headerEnd = content.indexOf("\n\n");
+
+	if (headerEnd < 0)
+	{
+		Error(_log, "The web UI bundle '%s' has no index", QSTRING_CSTR(_file.fileName()));
+		_file.unmap(const_cast<uchar*>(data));
+		return false;
+	}
+
+	const qint64 dataStart = headerEnd + 2;
+
+	for (const QByteArray& line : content.mid(BUNDLE_SIGNATURE.size(), headerEnd - BUNDLE_SIGNATURE.size() + 1).split('\n'))
+	{
+		const QList<QByteArray> fields = line.split('\t');
+		if (fields.size() != 5)
+			continue;
+
+		Entry entry{ dataStart + fields[1].toLongLong(), fields[2].toLongLong(), dataStart + fields[3].toLongLong(), fields[4].toLongLong() };
+
+		if (entry.offset + entry.size > _size || entry.gzipOffset + entry.gzipSize > _size)
+			continue;
+
+		_index.insert(QString::fromUtf8(fields[0]), entry);
+	}
+
+	_data = data;
+
+	Info(_log, "The web UI is served from the bundle '%s' (%i assets)", QSTRING_CSTR(_file.fileName()), _index.size());
+
+	return true;
+}
+
+bool WebBundle::contains(const QString& path)
+{
+	return open() && _index.contains(QDir::cleanPath("/" + path));
+}
+
+bool WebBundle::find(const QString& path, QByteArray& data, QByteArray& gzip)
+{
+	if (!open())
+		return false;
+
+	auto entry = _index.constFind(QDir::cleanPath("/" + path));
+	if (entry == _index.constEnd())
+		return false;
+
+	data = QByteArray::fromRawData(reinterpret_cast<const char*>(_data + entry->offset), static_cast<int>(entry->size));
+
+	if (entry->gzipSize > 0)
+		gzip = QByteArray::fromRawData(reinterpret_cast<const char*>(_data + entry->gzipOffset), static_cast<int>(entry->gzipSize));
+	else
+		gzip.clear();
+
+	return true;
+}
+
+QDateTime WebBundle::modified()
+{
+	return QFileInfo(_file.fileName()).lastModified();
+}
@@ -0,0 +1,61 @@
+#ifndef WEBBUNDLE_H
+#define WEBBUNDLE_H
+
+#include <QFile>
+#include <QHash>
+#include <QString>
+#include <QByteArray>
+#include <QDateTime>
+
+#include <utils/Logger.h>
+
+///
+/// The web UI packed into one indexed file (cmake/WebBundle.cmake). The file is mapped read-only on the first
+/// request and the assets are served from the mapping without a copy: an asset that is never requested costs
+/// no memory and the kernel can drop the pages of the others at any time.
+///
+class WebBundle
+{
+public:
+	WebBundle();
+	~WebBundle();
+
+	/// the bundle next to the binary or in the share folder of the installation
+	static QString location();
+
+	bool contains(const QString& path);
+
+	///
+	/// @brief Get an asset, the data points into the mapping and lives as long as this object
+	/// @param path  The path of the asset in the UI (ex. /index.html)
+	/// @param data  The asset
+	/// @param gzip  Its precompressed variant, empty when the bundle has none
+	/// @return false when the asset or the bundle is missing
+	///
+	bool find(const QString& path, QByteArray& data, QByteArray& gzip);
+
+	/// the modification time of the bundle file, the time of every asset
+	QDateTime modified();
+
+private:
+	struct Entry
+	{
+		qint64	offset;
+		qint64	size;
+		qint64	gzipOffset;
+		qint64	gzipSize;
+	};
+
+	/// map the file and read its index, once
+	bool open();
+
+	Logger*		_log;
+	QFile		_file;
+	const uchar* _data;
+	qint64		_size;
+	bool		_opened;
+
+	QHash<QString, Entry> _index;
+};
+
+#endif // WEBBUNDLE_H
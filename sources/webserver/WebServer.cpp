@@ -106,6 +106,7 @@ void WebServer::handleSettingsUpdate(settings::type type, QJsonDocument config)
 
 		Info(_log, "Set document root to: %s", QSTRING_CSTR(_baseUrl));
 		_staticFileServing->setBaseUrl(_baseUrl);
+		_staticFileServing->setOpenMetrics(obj["openMetrics"].toBool(false));
 
 		// ssl different port
 		quint16 newPort = _useSsl ? obj["sslPort"].toInt(WEBSERVER_DEFAULT_PORT) : obj["port"].toInt(WEBSERVER_DEFAULT_PORT);
@@ -10,10 +10,42 @@
 #include <QCryptographicHash>
 #include <QJsonObject>
 
+#include <cstring>
+
+namespace
+{
+	// a message (all its frames) above it closes the connection
+	const quint64 MAX_MESSAGE_SIZE = 64 * 1024 * 1024;
+
+	// the receive buffer keeps this capacity between the messages
+	const int RECEIVE_BUFFER_RESERVE = 64 * 1024;
+
+	/// unmasks the payload in place, 8 bytes at a time with the key repeated over the word
+	void unmask(char* data, quint64 size, const char key[4])
+	{
+		uint32_t key32;
+		memcpy(&key32, key, 4);
+		const uint64_t key64 = (static_cast<uint64_t>(key32) << 32) | key32;
+
+		quint64 i = 0;
+		for (; i + 8 <= size; i += 8)
+		{
+			uint64_t word;
+			memcpy(&word, data + i, 8);
+			word ^= key64;
+			memcpy(data + i, &word, 8);
+		}
+
+		for (; i < size; i++)
+			data[i] ^= key[i % 4];
+	}
+}
+
 WebSocketClient::WebSocketClient(QtHttpRequest* request, QTcpSocket* sock, bool localConnection, QObject* parent)
 	: QObject(parent)
 	, _socket(sock)
 	, _log(Logger::getInstance("WEBSOCKET"))
+	, _memory(MemoryAccounting::WEB_SESSIONS)
 {
 	// connect socket; disconnect handled from QtHttpServer
 	connect(_socket, &QTcpSocket::readyRead, this, &WebSocketClient::handleWebSocketFrame);
@@ -22,9 +54,18 @@ WebSocketClient::WebSocketClient(QtHttpRequest* request, QTcpSocket* sock, bool
 	QByteArray secWebSocketKey = request->getHeader(QtHttpHeader::SecWebSocketKey);
 	const QString client = request->getClientInfo().clientAddress.toString();
 
+	// the frames of a message are read straight into it, the reserved capacity survives resize(0)
+	_wsReceiveBuffer.reserve(RECEIVE_BUFFER_RESERVE);
+	_memory.set(sizeof(WebSocketClient) + _wsReceiveBuffer.capacity());
+
 	// Json processor
 	_jsonAPI = new JsonAPI(client, _log, localConnection, this);
 	connect(_jsonAPI, &JsonAPI::callbackMessage, this, &WebSocketClient::sendMessage);
+	connect(_jsonAPI, &JsonAPI::callbackBinaryMessage, this, &WebSocketClient::sendBinaryMessage);
+	connect(_jsonAPI, &JsonAPI::callbackBinaryImage, this, &WebSocketClient::sendBinaryImage);
+	// the queue refills the socket before the image stream checks the drain
+	_sendQueue = new ClientSendQueue(_socket, _log, client, this);
+	connect(_socket, &QTcpSocket::bytesWritten, this, &WebSocketClient::checkImageDrained);
 	connect(_jsonAPI, &JsonAPI::forceClose, this, [this]() { this->sendClose(CLOSECODE::NORMAL); });
 
 	Debug(_log, "New connection from %s", QSTRING_CSTR(client));
@@ -62,8 +103,6 @@ void WebSocketClient::handleWebSocketFrame()
 		}
 		_notEnoughData = false;
 
-		QByteArray buf = _socket->read(_wsh.payloadLength);
-
 		if (OPCODE::invalid((OPCODE::value)_wsh.opCode))
 		{
 			sendClose(CLOSECODE::INV_TYPE, "invalid opcode");
@@ -95,48 +134,58 @@ void WebSocketClient::handleWebSocketFrame()
 						return;
 					}
 
-					// unmask data
-					for (int i = 0; i < buf.size(); i++)
+					// the first frame of a message starts the buffer and tells the type of the whole message
+					if (!isContinuation)
 					{
-						buf[i] = buf[i] ^ _wsh.key[i % 4];
+						_wsReceiveBuffer.resize(0);
+						_messageOpCode = _wsh.opCode;
 					}
 
-					_onContinuation = !_wsh.fin || isContinuation;
-
-					// frame contains text, extract it, append data if this is a continuation
-					if (_wsh.fin && !isContinuation) // one frame
+					const quint64 offset = static_cast<quint64>(_wsReceiveBuffer.size());
+					if (offset + _wsh.payloadLength > MAX_MESSAGE_SIZE)
 					{
-						_wsReceiveBuffer.clear();
+						sendClose(CLOSECODE::BIG_MSG, "message too big");
+						return;
 					}
-					_wsReceiveBuffer.append(buf);
+
+					// the frame is appended in place and unmasked there
+					_wsReceiveBuffer.resize(static_cast<int>(offset + _wsh.payloadLength));
+					char* payload = _wsReceiveBuffer.data() + offset;
+					_socket->read(payload, _wsh.payloadLength);
+
+					if (_wsh.masked)
+						unmask(payload, _wsh.payloadLength, _wsh.key);
+
+					_onContinuation = !_wsh.fin;
 
 					// this is the final frame, decode and handle data
 					if (_wsh.fin)
 					{
-						_onContinuation = false;
-						if (_wsh.opCode == OPCODE::TEXT)
+						if (_messageOpCode == OPCODE::TEXT)
 						{
-
-							_jsonAPI->handleMessage(QString(_wsReceiveBuffer));
+							_jsonAPI->handleMessage(QString::fromUtf8(_wsReceiveBuffer.constData(), _wsReceiveBuffer.size()));
 						}
 						else
 						{
-							handleBinaryMessage(_wsReceiveBuffer);
+							handleBinaryMessage(_wsReceiveBuffer.constData(), _wsReceiveBuffer.size());
 						}
-						_wsReceiveBuffer.clear();
-
+						_wsReceiveBuffer.resize(0);
+						_memory.set(sizeof(WebSocketClient) + _wsReceiveBuffer.capacity());
 					}
 				}
 				break;
 
 			case OPCODE::CLOSE:
 				{
+					_socket->read(_wsh.payloadLength);
 					sendClose(CLOSECODE::NORMAL);
 				}
 				break;
 
 			case OPCODE::PING:
 				{
+					_socket->read(_wsh.payloadLength);
+
 					// ping received, send pong
 					quint8 pong[] = { OPCODE::PONG, 0 };
 					_socket->write((const char*)pong, 2);
@@ -146,12 +195,16 @@ void WebSocketClient::handleWebSocketFrame()
 
 			case OPCODE::PONG:
 				{
+					_socket->read(_wsh.payloadLength);
 					Error(_log, "Pong received, protocol violation!");
 				}
 				break;
 
-			default:				
+			default:
+				{
+					QByteArray buf = _socket->read(_wsh.payloadLength);
 					Warning(_log, "Unexpected %d\n%s\n", _wsh.opCode, QSTRING_CSTR(QString(buf)));
+				}
 		}
 	}
 }
@@ -228,22 +281,29 @@ void WebSocketClient::sendClose(int status, QString reason)
 }
 
 
-void WebSocketClient::handleBinaryMessage(QByteArray& data)
+void WebSocketClient::handleBinaryMessage(const char* data, int size)
 {
-	unsigned imgSize = data.size() - 4;
-	unsigned width = ((data.at(2) << 8) & 0xFF00) | (data.at(3) & 0xFF);
-	unsigned height = imgSize / width;
+	if (size < 4)
+	{
+		Error(_log, "binary message too short");
+		return;
+	}
+
+	unsigned imgSize = size - 4;
+	unsigned width = ((data[2] << 8) & 0xFF00) | (data[3] & 0xFF);
 
-	if (imgSize % width > 0)
+	if (width == 0 || imgSize % width > 0)
 	{
 		Error(_log, "data size is not multiple of width");
 		return;
 	}
 
+	unsigned height = imgSize / width;
+
 	Image<ColorRgb> image;
 	image.resize(width, height);
 
-	memcpy(image.rawMem(), data.data() + 4, imgSize);
+	memcpy(image.rawMem(), data + 4, imgSize);
 }
 
 
@@ -252,63 +312,86 @@ qint64 WebSocketClient::sendMessage(QJsonObject obj)
 	QJsonDocument writer(obj);
 	QByteArray data = writer.toJson(QJsonDocument::Compact) + "\n";
 
+	// the next image is requested once this one is handed to the socket
+	std::function<void()> sent = nullptr;
+	if (obj.contains("isImage"))
+	{
+		JsonAPI* jsonAPI = _jsonAPI;
+		sent = [jsonAPI]() { QUEUE_CALL_0(jsonAPI, releaseLock); };
+	}
+
+	return sendFrames(OPCODE::TEXT, data, ClientSendQueue::streamOf(obj), sent);
+}
+
+qint64 WebSocketClient::sendBinaryMessage(QByteArray data)
+{
+	// a led delta needs the frame before it: behind a waiting frame it's dropped and the stream restarts with all the leds
+	if (data.size() > 1 && data[0] == 'L' && data[1] == 1 && _sendQueue->pending(ClientSendQueue::LED_COLORS) > 0)
+	{
+		QUEUE_CALL_0(_jsonAPI, resyncLedStream);
+		return 0;
+	}
+
+	return sendFrames(OPCODE::BINARY, data, ClientSendQueue::LED_COLORS);
+}
+
+qint64 WebSocketClient::sendBinaryImage(QByteArray data)
+{
+	_imageDraining = true;
+
+	qint64 payloadWritten = sendFrames(OPCODE::BINARY, data, ClientSendQueue::IMAGE);
+
+	checkImageDrained();
+
+	return payloadWritten;
+}
+
+void WebSocketClient::checkImageDrained()
+{
+	// the image stream adapts to the time the frame needs to leave the socket
+	if (_imageDraining && (_socket == nullptr || _socket->state() != QAbstractSocket::ConnectedState ||
+		(_socket->bytesToWrite() == 0 && _sendQueue->pending(ClientSendQueue::IMAGE) == 0)))
+	{
+		_imageDraining = false;
+		QUEUE_CALL_0(_jsonAPI, releaseImageStream);
+	}
+}
+
+qint64 WebSocketClient::sendFrames(quint8 opCode, const QByteArray& data, ClientSendQueue::Stream stream, const std::function<void()>& sent)
+{
 	if (!_socket || (_socket->state() != QAbstractSocket::ConnectedState))
+	{
+		if (sent)
+			sent();
 		return 0;
-	
-	qint64 payloadWritten = 0;
+	}
+
 	quint32 payloadSize = data.size();
 	const char* payload = data.data();
 
 	qint32 numFrames = payloadSize / FRAME_SIZE_IN_BYTES + ((quint64(payloadSize) % FRAME_SIZE_IN_BYTES) > 0 ? 1 : 0);
-	
+
+	// the whole message leaves at once, the queue never splits it
+	QByteArray message;
+	message.reserve(static_cast<int>(payloadSize + numFrames * 10));
+
 	for (int i = 0; i < numFrames; i++)
 	{
 		const bool isLastFrame = (i == (numFrames - 1));
 
 		quint64 position = i * FRAME_SIZE_IN_BYTES;
 		quint32 frameSize = (payloadSize - position >= FRAME_SIZE_IN_BYTES) ? FRAME_SIZE_IN_BYTES : (payloadSize - position);
-		quint8 headerType = (i) ? OPCODE::CONTINUATION : OPCODE::TEXT;
-		QByteArray buf = makeFrameHeader(headerType, frameSize, isLastFrame);		
-		sendMessage_Raw(buf);
-
-		qint64 written = sendMessage_Raw(payload + position, frameSize);
-		if (written > 0)
-		{
-			payloadWritten += written;
-		}
-		else
-		{
-			_socket->flush();
-			Error(_log, "Error writing bytes to socket: %s", QSTRING_CSTR(_socket->errorString()));
-			break;
-		}
-	}
-
-	if (payloadSize != payloadWritten)
-	{
-		Error(_log, "Error writing bytes to socket %d bytes from %d written", payloadWritten, payloadSize);
-		return -1;
-	}
+		quint8 headerType = (i) ? OPCODE::CONTINUATION : opCode;
 
-	if (obj.contains("isImage"))
-	{
-		QUEUE_CALL_0(_jsonAPI, releaseLock);
+		message.append(makeFrameHeader(headerType, frameSize, isLastFrame));
+		message.append(payload + position, frameSize);
 	}
 
-	return payloadWritten;
-}
-
-qint64 WebSocketClient::sendMessage_Raw(const char* data, quint64 size)
-{
-	return _socket->write(data, size);
-}
+	_sendQueue->send(stream, message, sent);
 
-qint64 WebSocketClient::sendMessage_Raw(QByteArray& data)
-{
-	return _socket->write(data.data(), data.size());
+	return payloadSize;
 }
 
-
 QByteArray WebSocketClient::makeFrameHeader(quint8 opCode, quint64 payloadLength, bool lastFrame)
 {
 	QByteArray header;
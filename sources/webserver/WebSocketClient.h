@@ -1,6 +1,8 @@
 #pragma once
 
 #include <utils/Logger.h>
+#include <utils/MemoryAccounting.h>
+#include <api/ClientSendQueue.h>
 #include "WebSocketUtils.h"
 
 class QTcpSocket;
@@ -28,23 +30,32 @@ private:
 	QTcpSocket* _socket;
 	Logger*     _log;
 	JsonAPI*    _jsonAPI;
+	ClientSendQueue* _sendQueue;
 
 	void getWsFrameHeader(WebSocketHeader* header);
 	void sendClose(int status, QString reason = "");
-	void handleBinaryMessage(QByteArray& data);
-	qint64 sendMessage_Raw(const char* data, quint64 size);
-	qint64 sendMessage_Raw(QByteArray& data);
+	void handleBinaryMessage(const char* data, int size);
 	QByteArray makeFrameHeader(quint8 opCode, quint64 payloadLength, bool lastFrame);
+	qint64 sendFrames(quint8 opCode, const QByteArray& data, ClientSendQueue::Stream stream, const std::function<void()>& sent = nullptr);
 
 	/// The buffer used for reading data from the socket
 	QByteArray _receiveBuffer;
 
-	/// buffer for websockets multi frame receive
+	/// buffer for websockets multi frame receive, the frames are appended and unmasked in place
 	QByteArray _wsReceiveBuffer;
 	quint8 _maskKey[4];
 
+	/// the session and its receive buffer, it keeps the capacity of the largest message
+	MemoryAccounting::Tag _memory;
+
+	/// the opcode of the first frame of the message, the continuations carry none
+	quint8 _messageOpCode = OPCODE::TEXT;
+
 	bool _onContinuation = false;
 
+	// a binary image frame is still waiting in the socket
+	bool _imageDraining = false;
+
 	// true when data is missing for parsing
 	bool _notEnoughData = false;
 
@@ -69,4 +80,7 @@ private:
 private slots:
 	void handleWebSocketFrame();
 	qint64 sendMessage(QJsonObject obj);
+	qint64 sendBinaryMessage(QByteArray data);
+	qint64 sendBinaryImage(QByteArray data);
+	void checkImageDrained();
 };
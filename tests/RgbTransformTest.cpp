@@ -0,0 +1,92 @@
+#include <utils/RgbTransform.h>
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+
+///
+/// The fixed point saturation/luminance step must stay within 5 levels per channel of the float one
+/// for the whole range of the gains in the settings schema (0..10).
+///
+class RgbTransformTest
+{
+public:
+	static int maxDeviation(double saturationGain, double luminanceGain, double luminanceMinimum)
+	{
+		RgbTransform transform;
+
+		transform._saturationGain = saturationGain;
+		transform._luminanceGain = luminanceGain;
+		transform._luminanceMinimum = luminanceMinimum;
+		transform.updateSatLumFixed();
+
+		if (!transform._satLumFixed)
+		{
+			printf("The fixed point path is not selected for saturationGain: %f, luminanceGain: %f\n", saturationGain, luminanceGain);
+			return MAX_DEVIATION + 1;
+		}
+
+		int result = 0;
+
+		for (int r = 0; r <= 255; r = nextLevel(r))
+			for (int g = 0; g <= 255; g = nextLevel(g))
+				for (int b = 0; b <= 255; b = nextLevel(b))
+				{
+					uint8_t fixedR = r, fixedG = g, fixedB = b;
+					transform.transformSatLumFixed(fixedR, fixedG, fixedB);
+
+					// the reference: transformSatLum with the fixed point path turned off
+					uint8_t floatR = r, floatG = g, floatB = b;
+					transform._satLumFixed = false;
+					transform.transformSatLum(floatR, floatG, floatB);
+					transform._satLumFixed = true;
+
+					result = std::max(result, std::abs(int(fixedR) - int(floatR)));
+					result = std::max(result, std::abs(int(fixedG) - int(floatG)));
+					result = std::max(result, std::abs(int(fixedB) - int(floatB)));
+				}
+
+		return result;
+	}
+
+	static const int MAX_DEVIATION = 5;
+
+private:
+	/// every 5th level and always the brightest one
+	static int nextLevel(int level)
+	{
+		return (level == 255) ? 256 : std::min(level + 5, 255);
+	}
+};
+
+int main()
+{
+	int failed = 0;
+	int worst = 0;
+
+	for (double luminanceMinimum : { 0.0, 0.1 })
+		for (int saturation = 0; saturation <= 20; saturation++)
+			for (int luminance = 0; luminance <= 20; luminance++)
+			{
+				// the float path is skipped for the neutral gains
+				if (saturation == 2 && luminance == 2 && luminanceMinimum == 0.0)
+					continue;
+
+				const double saturationGain = saturation / 2.0;
+				const double luminanceGain = luminance / 2.0;
+				const int deviation = RgbTransformTest::maxDeviation(saturationGain, luminanceGain, luminanceMinimum);
+
+				worst = std::max(worst, deviation);
+
+				if (deviation > RgbTransformTest::MAX_DEVIATION)
+				{
+					printf("FAILED saturationGain: %.1f, luminanceGain: %.1f, luminanceMinimum: %.1f, deviation: %i\n",
+						saturationGain, luminanceGain, luminanceMinimum, deviation);
+					failed++;
+				}
+			}
+
+	printf("The largest deviation of the fixed point path: %i (allowed: %i)\n", worst, RgbTransformTest::MAX_DEVIATION);
+
+	return (failed == 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -20,7 +20,13 @@ $(document).ready( function(){
 	const ctx = canvas.getContext("2d");
 
 	performTranslation();
-	$("#grabber_benchmark_intro").html($.i18n("grabber_benchmark_intro"));
+	$("#grabber_benchmark_intro").html($.i18n("grabber_benchmark_intro") + $.i18n("benchmark_leds_intro"));
+	$("#benchmarkPhotodiode").attr("placeholder", $.i18n("benchmark_photodiode"));
+
+	$("#benchmarkLeds").off('change').on('change', function()
+	{
+		$("#benchmarkPhotodiode").prop("disabled", !this.checked);
+	});
 		
 	ctx.fillStyle = "black";
 	ctx.fillRect(0, 0, canvas.width, canvas.height);
@@ -55,6 +61,12 @@ $(document).ready( function(){
 	
 	function handleMessage(event)
 	{
+		if (event.response.data.message == "stats")
+		{
+			showStats(event.response.data.stats);
+			return;
+		}
+
 		if (mode == "ping")
 		{
 			if (event.response.data.message == "pong" && indexer == event.response.data.status)
@@ -196,6 +208,13 @@ $(document).ready( function(){
 		mode = "ping";
 		
 		$("#logmessages").empty();
+
+		const leds = $("#benchmarkLeds").is(":checked");
+		requestBenchmarkStart(leds, (leds) ? $("#benchmarkPhotodiode").val().trim() : "");
+
+		// the LEDs see the colors only when they fill the screen
+		if (leds && canvas.requestFullscreen)
+			canvas.requestFullscreen();
 		
 		internalLatency = (new Date()).getTime();
 		pingInternal();
@@ -328,10 +347,38 @@ $(document).ready( function(){
 		
 		resetData();
 		requestBenchmark("stop", -1);
+
+		if (document.fullscreenElement && document.exitFullscreen)
+			document.exitFullscreen();
 		
 		$('#logmessages').stop().animate({
 						scrollTop: $('#logmessages')[0].scrollHeight
 					}, 800);
 	};
 
+	function showStats(stats)
+	{
+		const stages = [["capture", "benchmark_stage_capture"], ["processing", "benchmark_stage_processing"], ["light", "benchmark_stage_light"], ["total", "benchmark_stage_total"]];
+
+		if (stats.flashes == 0)
+			return;
+
+		$("#logmessages").append("<code class='db_info'>"+$.i18n("benchmark_flashes")+": "+stats.flashes+", "+$.i18n("benchmark_lost")+": "+stats.lost+
+			((stats.photodiode) ? ", "+$.i18n("benchmark_unconfirmed")+": "+stats.unconfirmed : "")+"</code><br/>");
+
+		for (const [key, label] of stages)
+		{
+			const stage = stats[key];
+			if (stage == null || stage.count == 0)
+				continue;
+
+			$("#logmessages").append("<code class='db_info'>"+$.i18n(label)+": avg "+stage.avg.toFixed(1)+"ms, p50 "+stage.p50.toFixed(1)+"ms, p90 "+stage.p90.toFixed(1)+
+				"ms, p99 "+stage.p99.toFixed(1)+"ms, max "+stage.max.toFixed(1)+"ms</code><br/>");
+		}
+
+		$('#logmessages').stop().animate({
+						scrollTop: $('#logmessages')[0].scrollHeight
+					}, 800);
+	};
+
 });
\ No newline at end of file
@@ -109,6 +109,12 @@ $(document).ready( function(){
 		if (!running)
 			return;
 		
+		if (typeof json.progress != 'undefined')
+		{
+			console.log(`LUT generation, ${json.stage}: ${json.progress}%`);
+			return;
+		}
+		
 		if (json.limited == 1 && !limited)
 		{
 			limited = true;
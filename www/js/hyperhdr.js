@@ -150,8 +150,13 @@ function initWebSocket()
 				alert("Connection to websocket failed. Please open this page in a new page/tab in your browser or use secure port 8092 (for example https://localhost:8092).");
 			}
 
+			window.websocket.binaryType = "arraybuffer";
+
 			window.websocket.onopen = function (event)
 			{
+				// a new connection knows no serverinfo yet
+				window.serverInfoVersion = undefined;
+
 				$(window.hyperhdr).trigger({ type: "open" });
 
 				$(window.hyperhdr).on("cmd-serverinfo", function (event)
@@ -188,6 +193,12 @@ function initWebSocket()
 
 			window.websocket.onmessage = function (event)
 			{
+				if (event.data instanceof ArrayBuffer)
+				{
+					handleBinaryMessage(event.data);
+					return;
+				}
+
 				try
 				{
 					var response = JSON.parse(event.data);
@@ -403,7 +414,9 @@ function requestInstanceSwitch(inst)
 
 function requestServerInfo()
 {
-	sendToHyperhdr("serverinfo", "", '"subscribe":["components-update","sessions-update","priorities-update", "imageToLedMapping-update", "adjustment-update", "videomode-update", "videomodehdr-update", "settings-update", "instance-update", "grabberstate-update", "benchmark-update"]');
+	// only the changes since the last serverinfo of this connection
+	var since = (window.serverInfoVersion !== undefined) ? '"since":' + window.serverInfoVersion + ',' : '';
+	sendToHyperhdr("serverinfo", "", since + '"subscribe":["components-update","sessions-update","priorities-update", "imageToLedMapping-update", "adjustment-update", "videomode-update", "videomodehdr-update", "settings-update", "instance-update", "grabberstate-update", "benchmark-update"]');
 }
 
 function requestSysInfo()
@@ -421,10 +434,56 @@ function requestServerConfig()
 	sendToHyperhdr("config", "getconfig");
 }
 
+// Binary messages: JPEG frames of the image stream or the led stream
+function handleBinaryMessage(buffer)
+{
+	var data = new Uint8Array(buffer);
+
+	if (data.length > 2 && data[0] == 0xFF && data[1] == 0xD8)
+	{
+		if (typeof window.imageStreamUrl != 'undefined')
+			URL.revokeObjectURL(window.imageStreamUrl);
+
+		window.imageStreamUrl = URL.createObjectURL(new Blob([data], { type: "image/jpeg" }));
+		$(window.hyperhdr).trigger({ type: "cmd-ledcolors-imagestream-update", response: { success: true, result: { image: window.imageStreamUrl } } });
+	}
+	else
+		handleBinaryLedColors(data);
+}
+
+// Binary led stream: 'L', type (0 = all the leds, 1 = delta), led count (uint16, big endian),
+// then RGB of all the leds or the changed runs: first led (uint16), length (uint16), RGB of the run
+function handleBinaryLedColors(data)
+{
+	if (data.length < 4 || data[0] != 0x4C)
+		return;
+
+	var count = (data[2] << 8) | data[3];
+
+	if (data[1] == 0)
+		window.ledStreamColors = data.slice(4, 4 + count * 3);
+	else if (typeof window.ledStreamColors != 'undefined' && window.ledStreamColors.length == count * 3)
+	{
+		for (var pos = 4; pos + 4 <= data.length; )
+		{
+			var start = (data[pos] << 8) | data[pos + 1];
+			var length = (data[pos + 2] << 8) | data[pos + 3];
+			pos += 4;
+			window.ledStreamColors.set(data.subarray(pos, pos + length * 3), start * 3);
+			pos += length * 3;
+		}
+	}
+	else
+		return;
+
+	$(window.hyperhdr).trigger({ type: "cmd-ledcolors-ledstream-update", response: { success: true, result: { leds: window.ledStreamColors } } });
+}
+
 function requestLedColorsStart()
 {
 	window.ledStreamActive = true;
-	sendToHyperhdr("ledcolors", "ledstream-start");
+	window.ledStreamColors = undefined;
+	sendToHyperhdr("ledcolors", "ledstream-start", '"binary":true,"delta":true');
 }
 
 function requestLedColorsStop()
@@ -436,7 +495,7 @@ function requestLedColorsStop()
 function requestLedImageStart()
 {
 	window.imageStreamActive = true;
-	sendToHyperhdr("ledcolors", "imagestream-start");
+	sendToHyperhdr("ledcolors", "imagestream-start", '"binary":true');
 }
 
 function requestLedImageStop()
@@ -630,6 +689,11 @@ function requestBenchmark(mode, status)
 	sendToHyperhdr("benchmark", mode, '"status": ' + status);
 }
 
+function requestBenchmarkStart(leds, photodiode)
+{
+	sendToHyperhdr("benchmark", "start", '"leds": ' + leds + ', "photodiode": ' + JSON.stringify(photodiode));
+}
+
 function requestLutInstall(address, hardware_brightness, hardware_contrast, hardware_saturation, now)
 {
 	sendToHyperhdr("lut-install", address, `"hardware_brightness":${hardware_brightness},
@@ -36,14 +36,27 @@ $(document).ready(function () {
 		if (event.response.info == null)
 			return;
 
-		window.serverInfo = event.response.info;
+		var info = event.response.info;
+
+		if (info.hasOwnProperty("removed"))
+		{
+			// the changes since the version of the previous serverinfo
+			info.removed.forEach(function (key) { delete window.serverInfo[key]; });
+			delete info.removed;
+			window.serverInfo = Object.assign(window.serverInfo, info);
+		}
+		else
+			window.serverInfo = info;
+
+		window.serverInfoVersion = info.version;
 		
 		window.readOnlyMode = window.sysInfo.hyperhdr.readOnlyMode;
 	
 		// comps
-		window.comps = event.response.info.components;
+		window.comps = window.serverInfo.components;
 
-		window.serverInfo.grabberstate = event.response.info.grabbers.current;
+		if (info.hasOwnProperty("grabbers"))
+			window.serverInfo.grabberstate = info.grabbers.current;
 
 		$(window.hyperhdr).trigger("ready");
 
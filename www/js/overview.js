@@ -98,6 +98,14 @@ $(document).ready(function ()
 								holder.parentNode.removeChild(holder);
 						}
 					}
+					else if (report.type == 18)
+					{
+						let holderGOVERNOR = document.getElementById("perf_cell_quality_governor");
+						if (holderGOVERNOR != null)
+						{
+							holderGOVERNOR.classList.add("d-none");
+						}
+					}
 
 					return;
 				}
@@ -128,6 +136,14 @@ $(document).ready(function ()
 		renderReport();
 	}
 
+	function histogramTitle(label, histogram)
+	{
+		if (histogram == null || !(histogram.count > 0))
+			return "";
+
+		return ` title="${$.i18n(label)}: p50 ${histogram.p50.toFixed(1)}ms, p90 ${histogram.p90.toFixed(1)}ms, p99 ${histogram.p99.toFixed(1)}ms, max ${histogram.max.toFixed(1)}ms"`;
+	}
+
 	function renderReport()
 	{
 		const waitingSpinner = '<svg data-src="svg/spinner_small.svg" fill="currentColor" class="svg4hyperhdr ms-1"></svg>' + $.i18n("perf_please_wait");
@@ -146,7 +162,7 @@ $(document).ready(function ()
 			{
 				let render = (curElem.token <= 0) ? waitingSpinner :
 					`<span class="card-tools"><span class="badge bg-secondary" style="font-size: 1em;font-weight: normal;">${curElem.param1.toFixed(1)} fps</span></span>` +
-					` <small>&nbsp;${curElem.param2}ms</small><svg data-src="svg/performance_clock.svg" fill="currentColor" class="svg4hyperhdr ms-1 me-2"></svg><small>${curElem.param3}</small><svg data-src="svg/performance_two_ways.svg" fill="currentColor" class="svg4hyperhdr ms-0 me-0"></svg>`+
+					` <small${histogramTitle("perf_decoding_time", curElem.histogram)}>&nbsp;${curElem.param2}ms</small><svg data-src="svg/performance_clock.svg" fill="currentColor" class="svg4hyperhdr ms-1 me-2"></svg><small>${curElem.param3}</small><svg data-src="svg/performance_two_ways.svg" fill="currentColor" class="svg4hyperhdr ms-0 me-0"></svg>`+
 					((curElem.param4 != 0)?`, ${$.i18n("perf_invalid_frames")}: <small>${curElem.param4}</small>`:``);
 				render += ` <span class='perf_counter small text-muted'>(${curElem.refresh})</span>`;
 
@@ -189,9 +205,12 @@ $(document).ready(function ()
 						 	warningM = ` <small>${curElem.param4}</small><svg data-src="svg/trash.svg" fill="currentColor" class="svg4hyperhdr"></svg>`;
 						if (curElem.param4 > 120)
 							warningM = `<span style="color:red">${warningM}</span>`;
+						let droppedM = "";
+						if (curElem.type == 2 && curElem.param3 + curElem.param4 > 0)
+							droppedM = ` <small>${curElem.param3 + curElem.param4}</small><svg data-src="svg/trash.svg" fill="currentColor" class="svg4hyperhdr"></svg>`;
 						let render = (curElem.token <= 0) ? ((curElem.type == 2) ? `<span class="card-tools"><span class="badge bg-danger" style="font-size: 1em;font-weight: normal;">${curElem.name}</span></span>&nbsp;` : "") + waitingSpinner : (curElem.type == 2) ?
-							`<span class="card-tools"><span class="badge bg-danger" style="font-size: 1em;font-weight: normal;">${curElem.name}</span></span> <span class="card-tools me-1"><span class="badge bg-secondary" style="font-size: 1em;font-weight: normal;">${curElem.param1.toFixed(1)} fps</span></span> <small>${curElem.param2}</small><svg data-src="svg/performance_two_ways.svg" fill="currentColor" class="svg4hyperhdr ms-0 me-0"></svg>` :
-							`<span class="card-tools"><span class="badge bg-success" style="font-size: 1em;font-weight: normal;">${curElem.name}</span></span> <span class="card-tools me-1"><span class="badge bg-secondary" style="font-size: 1em;font-weight: normal;">${curElem.param1.toFixed(1)} fps</span></span> <small>${curElem.param3}</small><svg data-src="svg/performance_in.svg" style="width:8px;top:0px;" fill="currentColor" class="svg4hyperhdr ms-0 me-0"></svg> <small>${curElem.param2}</small><svg data-src="svg/performance_out.svg" style="width:8px;top:-2.5px;" fill="currentColor" class="svg4hyperhdr ms-0 me-0"></svg>${warningM}`;
+							`<span class="card-tools"><span class="badge bg-danger" style="font-size: 1em;font-weight: normal;">${curElem.name}</span></span> <span class="card-tools me-1"><span class="badge bg-secondary" style="font-size: 1em;font-weight: normal;"${histogramTitle("perf_processing_time", curElem.histogram)}>${curElem.param1.toFixed(1)} fps</span></span> <small>${curElem.param2}</small><svg data-src="svg/performance_two_ways.svg" fill="currentColor" class="svg4hyperhdr ms-0 me-0"></svg>${droppedM}` :
+							`<span class="card-tools"><span class="badge bg-success" style="font-size: 1em;font-weight: normal;">${curElem.name}</span></span> <span class="card-tools me-1"><span class="badge bg-secondary" style="font-size: 1em;font-weight: normal;"${(curElem.histogram != null) ? histogramTitle("perf_write_time", curElem.histogram) : ((curElem.detail) ? ` title="write: ${curElem.detail}"` : "")}>${curElem.param1.toFixed(1)} fps</span></span> <small>${curElem.param3}</small><svg data-src="svg/performance_in.svg" style="width:8px;top:0px;" fill="currentColor" class="svg4hyperhdr ms-0 me-0"></svg> <small>${curElem.param2}</small><svg data-src="svg/performance_out.svg" style="width:8px;top:-2.5px;" fill="currentColor" class="svg4hyperhdr ms-0 me-0"></svg>${warningM}`;
 						render += ` <span class='perf_counter small text-muted'>(${curElem.refresh})</span>`;
 						placer.innerHTML = render;
 					}
@@ -233,6 +252,61 @@ $(document).ready(function ()
 					holderRAM.classList.remove("d-none");
 				}
 			}
+			else if (curElem.type == 8)
+			{
+				let holderPOOL = document.getElementById("perf_frame_pool");
+				if (holderPOOL != null)
+				{
+					holderPOOL.innerHTML = curElem.name;
+				}
+				holderPOOL = document.getElementById("perf_cell_frame_pool");
+				if (holderPOOL != null)
+				{
+					holderPOOL.classList.remove("d-none");
+				}
+				holderPOOL = document.getElementById("perf_cell_hardware");
+				if (holderPOOL != null)
+				{
+					holderPOOL.classList.remove("d-none");
+				}
+			}
+			else if (curElem.type == 17)
+			{
+				let holderTHREADS = document.getElementById("perf_thread_usage");
+				if (holderTHREADS != null)
+				{
+					holderTHREADS.innerHTML = curElem.name;
+				}
+				holderTHREADS = document.getElementById("perf_cell_thread_usage");
+				if (holderTHREADS != null)
+				{
+					holderTHREADS.classList.remove("d-none");
+				}
+				holderTHREADS = document.getElementById("perf_cell_hardware");
+				if (holderTHREADS != null)
+				{
+					holderTHREADS.classList.remove("d-none");
+				}
+			}
+			else if (curElem.type == 18)
+			{
+				let holderGOVERNOR = document.getElementById("perf_quality_governor");
+				if (holderGOVERNOR != null)
+				{
+					let level = `<span class="badge ${(curElem.param1 > 0) ? "bg-warning" : "bg-success"}" style="font-size: 1em;font-weight: normal;">${curElem.param1}/${curElem.param4}</span>`;
+					holderGOVERNOR.innerHTML = `${level} ${curElem.name}`;
+				}
+				holderGOVERNOR = document.getElementById("perf_cell_quality_governor");
+				if (holderGOVERNOR != null)
+				{
+					holderGOVERNOR.classList.remove("d-none");
+				}
+				holderGOVERNOR = document.getElementById("perf_cell_hardware");
+				if (holderGOVERNOR != null)
+				{
+					holderGOVERNOR.classList.remove("d-none");
+				}
+			}
 			else if (curElem.type == 6)
 			{				
 				let holderTEMP = document.getElementById("perf_temperature");
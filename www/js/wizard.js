@@ -567,6 +567,12 @@ function startWizardCC()
 	$('#editor_container_wiz .btn-group').toggle(false);
 	$('#editor_container_wiz [data-schemapath="root.color.imageToLedMappingType"]').toggle(false);
 	$('#editor_container_wiz [data-schemapath="root.color.sparse_processing"]').toggle(false);
+	$('#editor_container_wiz [data-schemapath="root.color.parallel_threshold"]').toggle(false);
+	$('#editor_container_wiz [data-schemapath="root.color.gpu_processing"]').toggle(false);
+	$('#editor_container_wiz [data-schemapath="root.color.crop_left"]').toggle(false);
+	$('#editor_container_wiz [data-schemapath="root.color.crop_right"]').toggle(false);
+	$('#editor_container_wiz [data-schemapath="root.color.crop_top"]').toggle(false);
+	$('#editor_container_wiz [data-schemapath="root.color.crop_bottom"]').toggle(false);
 	for (var i = 0; i < colorLength.length; i++)
 		$('#editor_container_wiz [data-schemapath*="root.color.channelAdjustment.' + i + '."]').toggle(false);
 }